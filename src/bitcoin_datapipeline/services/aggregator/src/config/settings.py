@@ -2,7 +2,7 @@
 
 import os
 import yaml
-from dataclasses import dataclass
+from dataclasses import dataclass, field
 from typing import List, Dict, Optional
 
 
@@ -19,6 +19,14 @@ class KinesisConfig:
     streams: Dict[str, str]  # stream_type -> stream_name mapping
     polling_interval_seconds: float
     max_records_per_request: int
+    # zstd dictionaries for compressed records, every one still in use by a
+    # writer; records name theirs by id
+    zstd_dictionary_paths: List[str] = field(default_factory=list)
+    # Put back in order the records of symbols the ingestor spreads over
+    # several shards (kinesis_hot_symbols), waiting up to
+    # merge_max_wait_seconds for a missing one before skipping it
+    merge_hot_partitions: bool = False
+    merge_max_wait_seconds: float = 0.5
 
 
 @dataclass
@@ -32,6 +40,10 @@ class RedisConfig:
     ttl_seconds: int
     socket_timeout: int
     socket_connect_timeout: int
+    # Rows per compressed feature history chunk ({prefix}:history:{symbol});
+    # a full chunk moves to ':prev', so reads see one to two chunks. 0 keeps
+    # one JSON key per snapshot instead.
+    history_chunk_rows: int = 720
 
 
 @dataclass
@@ -40,6 +52,20 @@ class AggregationConfig:
     min_messages: int
     max_interval_seconds: int
     check_interval_seconds: float
+    # Shared-memory FeatureBus (e.g. /dev/shm/btc_features) for inference on
+    # the same host; unset writes to Redis only
+    feature_bus_path: Optional[str] = None
+    # Binary checkpoint of the native trade windows and Kinesis positions,
+    # written every window_checkpoint_interval_seconds and on shutdown; a
+    # restart resumes from it. Unset starts cold.
+    window_checkpoint_path: Optional[str] = None
+    window_checkpoint_interval_seconds: float = 10.0
+    # Snapshot each buffer's features on a fixed grid of this period (e.g.
+    # 2.0 fires at every even second), timed by the native timer wheel and
+    # stamped with the grid time; 0 keeps the min_messages/max_interval
+    # polling. Per-type periods override it, e.g. {"trade": 10.0}.
+    snapshot_interval_seconds: float = 0.0
+    snapshot_type_intervals: Dict[str, float] = field(default_factory=dict)
 
 
 @dataclass
@@ -13,6 +13,15 @@ from .config.settings import AggregatorConfig
 logger = logging.getLogger(__name__)
 
 
+def numeric_feature_names(features: Dict[str, Any]) -> tuple:
+    """Names of the numeric features in a feature map, sorted: the value
+    order of its binary record and FeatureBus vector."""
+    return tuple(sorted(
+        name for name, value in features.items()
+        if isinstance(value, (int, float)) and not isinstance(value, bool) and name != "timestamp"
+    ))
+
+
 class FeatureBuilder:
     """Builds aggregated features from real-time market data messages."""
     
@@ -65,19 +74,7 @@ class FeatureBuilder:
                 return None
             
             if features:
-                # Add metadata
-                features.update({
-                    "symbol": symbol,
-                    "timestamp": int(time.time()),
-                    "message_count": len(messages),
-                    "message_type": message_type,
-                    "feature_version": "1.0"
-                })
-                
-                self.stats["features_built"] += 1
-                self.stats["messages_processed"] += len(messages)
-                
-                return features
+                return self._finish_features(features, symbol, len(messages), message_type)
             
         except Exception as e:
             logger.error(f"Error building features for {symbol}: {e}", exc_info=True)
@@ -85,6 +82,46 @@ class FeatureBuilder:
         
         return None
     
+    def build_ring_features(
+        self,
+        symbol: str,
+        ring: Any,
+        message_type: str
+    ) -> Optional[Dict[str, Any]]:
+        """Build features from a native TradeRing/QuoteRing, read in place."""
+        
+        try:
+            features = ring.features()
+            if features:
+                return self._finish_features(features, symbol, len(ring), message_type)
+        
+        except Exception as e:
+            logger.error(f"Error building features for {symbol}: {e}", exc_info=True)
+            self.stats["computation_errors"] += 1
+        
+        return None
+    
+    def _finish_features(
+        self,
+        features: Dict[str, Any],
+        symbol: str,
+        message_count: int,
+        message_type: str
+    ) -> Dict[str, Any]:
+        """Add metadata and count a built feature set."""
+        features.update({
+            "symbol": symbol,
+            "timestamp": int(time.time()),
+            "message_count": message_count,
+            "message_type": message_type,
+            "feature_version": "1.0"
+        })
+        
+        self.stats["features_built"] += 1
+        self.stats["messages_processed"] += message_count
+        
+        return features
+    
     async def _build_trade_features(
         self, 
         symbol: str, 
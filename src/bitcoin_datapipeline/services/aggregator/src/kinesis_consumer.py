@@ -11,15 +11,40 @@ from botocore.exceptions import ClientError
 
 from .config.settings import AggregatorConfig
 
+# KPL deaggregation, record decompression, depth delta decoding and the
+# hot-symbol merge from the SBE decoder extension, when it is installed;
+# without it aggregated, compressed and delta-encoded records fail to parse
+# and are skipped
+try:
+    from sbe_decoder_cpp import (
+        kpl_deaggregate, is_compressed_record, RecordDecompressor, DepthDeltaDecoder, is_depth_delta_record,
+        SequenceMerger
+    )
+    KPL_DEAGGREGATION_AVAILABLE = True
+except ImportError:
+    KPL_DEAGGREGATION_AVAILABLE = False
+
 
 logger = logging.getLogger(__name__)
 
 
+def read_dictionaries(paths: List[str]) -> List[bytes]:
+    """The zstd dictionaries at `paths`, for RecordDecompressor/RecordIngestor."""
+    dictionaries = []
+    for path in paths:
+        with open(path, 'rb') as f:
+            dictionaries.append(f.read())
+    return dictionaries
+
+
 class KinesisConsumer:
     """Consumes messages from Kinesis Data Streams."""
     
-    def __init__(self, config: AggregatorConfig):
+    def __init__(self, config: AggregatorConfig, record_ingestor=None):
         self.config = config
+        # RecordIngestor that decodes whole GetRecords batches into the
+        # aggregator's rings; None decodes every record in Python
+        self.record_ingestor = record_ingestor
         
         # Initialize Kinesis client
         session = boto3.Session()
@@ -33,10 +58,23 @@ class KinesisConsumer:
         self._running = False
         self._shard_iterators = {}
         self._last_sequence_numbers = {}
+        self._decompressor = self._load_decompressor(config.kinesis.zstd_dictionary_paths)
+        # Rebuilds the top-N of delta-encoded depth records, across both paths
+        self._depth_delta = DepthDeltaDecoder() if KPL_DEAGGREGATION_AVAILABLE else None
+        # One SequenceMerger per stream, restoring hot symbols' order
+        # across their shards before anything is decoded
+        self._merge_hot_partitions = config.kinesis.merge_hot_partitions and KPL_DEAGGREGATION_AVAILABLE
+        if config.kinesis.merge_hot_partitions and not self._merge_hot_partitions:
+            logger.warning("sbe_decoder_cpp not installed; hot-symbol records are consumed unmerged")
+        self._mergers: Dict[str, Any] = {}
         
         # Statistics
         self.stats = {
             "records_consumed": 0,
+            "aggregated_records": 0,
+            "compressed_records": 0,
+            "native_records": 0,
+            "depth_delta_records": 0,
             "shards_active": 0,
             "connection_errors": 0,
             "last_record_time": None
@@ -44,6 +82,15 @@ class KinesisConsumer:
         
         logger.info(f"KinesisConsumer initialized for streams: {list(config.kinesis.streams.values())}")
     
+    @staticmethod
+    def _load_decompressor(dictionary_paths: List[str]):
+        """Decompressor holding every configured zstd dictionary."""
+        if not KPL_DEAGGREGATION_AVAILABLE:
+            if dictionary_paths:
+                logger.warning("sbe_decoder_cpp not installed; compressed records will be skipped")
+            return None
+        return RecordDecompressor(read_dictionaries(dictionary_paths))
+    
     async def start(self):
         """Start the Kinesis consumer."""
         self._running = True
@@ -82,20 +129,14 @@ class KinesisConsumer:
             # Initialize iterator for each shard
             for shard in shards:
                 shard_id = shard['ShardId']
+                iterator_key = f"{stream_name}:{shard_id}"
                 
-                # Get shard iterator starting from latest
-                iterator_response = await asyncio.get_event_loop().run_in_executor(
-                    None,
-                    lambda: self.kinesis_client.get_shard_iterator(
-                        StreamName=stream_name,
-                        ShardId=shard_id,
-                        ShardIteratorType='LATEST'
-                    )
+                # Resume after a restored position (resume_from), else
+                # start from latest
+                shard_iterator = await self._initial_shard_iterator(
+                    stream_name, shard_id, self._last_sequence_numbers.get(iterator_key)
                 )
                 
-                shard_iterator = iterator_response['ShardIterator']
-                iterator_key = f"{stream_name}:{shard_id}"
-                
                 self._shard_iterators[iterator_key] = {
                     "iterator": shard_iterator,
                     "stream_name": stream_name,
@@ -110,6 +151,43 @@ class KinesisConsumer:
             self.stats["connection_errors"] += 1
             raise
     
+    async def _initial_shard_iterator(
+        self, stream_name: str, shard_id: str, last_seq: Optional[str]
+    ) -> str:
+        """Iterator after last_seq, or at LATEST if there is none or it has expired."""
+        loop = asyncio.get_event_loop()
+        if last_seq:
+            try:
+                response = await loop.run_in_executor(
+                    None,
+                    lambda: self.kinesis_client.get_shard_iterator(
+                        StreamName=stream_name,
+                        ShardId=shard_id,
+                        ShardIteratorType='AFTER_SEQUENCE_NUMBER',
+                        StartingSequenceNumber=last_seq
+                    )
+                )
+                return response['ShardIterator']
+            except ClientError as e:
+                logger.warning(f"Cannot resume {stream_name}:{shard_id} after {last_seq}, starting from latest: {e}")
+        response = await loop.run_in_executor(
+            None,
+            lambda: self.kinesis_client.get_shard_iterator(
+                StreamName=stream_name,
+                ShardId=shard_id,
+                ShardIteratorType='LATEST'
+            )
+        )
+        return response['ShardIterator']
+    
+    def positions(self) -> Dict[str, str]:
+        """Last sequence number read per "{stream}:{shard}", for checkpoints."""
+        return dict(self._last_sequence_numbers)
+    
+    def resume_from(self, positions: Dict[str, str]):
+        """Start the shards in positions after their sequence number; call before start()."""
+        self._last_sequence_numbers.update(positions)
+    
     async def consume_messages(self) -> AsyncIterator[Dict[str, Any]]:
         """Consume messages from all Kinesis streams."""
         while self._running:
@@ -134,6 +212,11 @@ class KinesisConsumer:
                         # Try to refresh the shard iterator
                         await self._refresh_shard_iterator(iterator_key, iterator_info)
                 
+                # Records held back by a gap that has waited long enough
+                for stream_name, merger in self._mergers.items():
+                    for record in self._decode_entries(stream_name, merger.expire()):
+                        yield record
+                
                 # Small delay to prevent busy waiting
                 await asyncio.sleep(self.config.kinesis.polling_interval_seconds)
             
@@ -172,37 +255,44 @@ class KinesisConsumer:
             iterator_info["iterator"] = next_iterator
             iterator_info["last_activity"] = time.time()
             
-            # Process records
-            processed_records = []
+            if self.record_ingestor is not None:
+                processed_records = self._ingest_records(stream_name, records)
+                if records:
+                    self._last_sequence_numbers[iterator_key] = records[-1]['SequenceNumber']
+                return processed_records
+            
+            # (partition key, payload, sequence number, arrival) per payload
+            entries = []
             
             for record in records:
                 try:
-                    # Decode record data
-                    data = json.loads(record['Data'].decode('utf-8'))
+                    # An aggregated record carries many (partition key, payload) pairs
+                    payloads = kpl_deaggregate(record['Data']) if KPL_DEAGGREGATION_AVAILABLE else None
+                    if payloads is None:
+                        payloads = [(record['PartitionKey'], record['Data'])]
+                    else:
+                        self.stats["aggregated_records"] += 1
                     
-                    processed_record = {
-                        "stream_name": stream_name,
-                        "partition_key": record['PartitionKey'],
-                        "sequence_number": record['SequenceNumber'],
-                        "data": data,
-                        "approximate_arrival_timestamp": record.get('ApproximateArrivalTimestamp'),
-                        "processing_timestamp": datetime.now()
-                    }
-                    
-                    processed_records.append(processed_record)
-                    
-                    # Update statistics
-                    self.stats["records_consumed"] += 1
-                    self.stats["last_record_time"] = datetime.now()
+                    for partition_key, payload in payloads:
+                        # Plain payloads pass through
+                        if self._decompressor is not None and is_compressed_record(payload):
+                            payload = self._decompressor.decompress(payload)
+                            self.stats["compressed_records"] += 1
+                        entries.append((
+                            partition_key, payload, record['SequenceNumber'], record.get('ApproximateArrivalTimestamp')
+                        ))
+                        
+                        # Update statistics
+                        self.stats["records_consumed"] += 1
+                        self.stats["last_record_time"] = datetime.now()
                     
                     # Store last sequence number for resumption
                     self._last_sequence_numbers[iterator_key] = record['SequenceNumber']
                 
-                except json.JSONDecodeError as e:
-                    logger.warning(f"Invalid JSON in Kinesis record: {e}")
                 except Exception as e:
                     logger.warning(f"Error processing Kinesis record: {e}")
             
+            processed_records = self._decode_entries(stream_name, self._merge(stream_name, entries))
             if processed_records:
                 logger.debug(f"Retrieved {len(processed_records)} records from {iterator_key}")
             
@@ -228,6 +318,80 @@ class KinesisConsumer:
             self.stats["connection_errors"] += 1
             return []
     
+    def _ingest_records(self, stream_name: str, records: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
+        """
+        Route one GetRecords batch through the native ingestor in a single
+        call: trades and best bid/ask land in its rings, and the records it
+        hands back (depth) are decoded here like any other.
+        """
+        before = self.record_ingestor.counts
+        returned = self.record_ingestor.ingest(records)
+        counts = self.record_ingestor.counts
+        for stat, count in (("aggregated_records", "aggregated"), ("compressed_records", "compressed")):
+            self.stats[stat] += counts[count] - before[count]
+        self.stats["native_records"] += (counts["trades"] + counts["quotes"]) - (before["trades"] + before["quotes"])
+        self.stats["records_consumed"] += counts["payloads"] - before["payloads"]
+        if records:
+            self.stats["last_record_time"] = datetime.now()
+        
+        sequence_number = records[-1]['SequenceNumber'] if records else None
+        entries = [(partition_key, payload, sequence_number, None) for partition_key, payload in returned]
+        return self._decode_entries(stream_name, self._merge(stream_name, entries))
+    
+    def _merge(self, stream_name: str, entries: List[tuple]) -> List[tuple]:
+        """
+        Entries in the order to decode them: with merge_hot_partitions, a
+        hot symbol's are put back in sequence (its key's '#<seq>') and may
+        be held back for a later batch; other keys pass straight through.
+        """
+        if not self._merge_hot_partitions:
+            return entries
+        merger = self._mergers.get(stream_name)
+        if merger is None:
+            merger = self._mergers[stream_name] = SequenceMerger(
+                max_wait=self.config.kinesis.merge_max_wait_seconds
+            )
+        released = []
+        for entry in entries:
+            released.extend(merger.push(entry[0], entry))
+        return released
+    
+    def _decode_entries(self, stream_name: str, entries: List[tuple]) -> List[Dict[str, Any]]:
+        """Processed records of (partition key, payload, sequence number,
+        arrival) entries, skipping payloads that do not decode."""
+        processed_records = []
+        for partition_key, payload, sequence_number, arrival in entries:
+            try:
+                data = self._decode_payload(payload)
+            except (UnicodeDecodeError, json.JSONDecodeError) as e:
+                logger.warning(f"Invalid JSON in Kinesis record: {e}")
+                continue
+            except ValueError as e:
+                logger.warning(f"Invalid depth delta record: {e}")
+                continue
+            if data is None:
+                continue
+            processed_records.append({
+                "stream_name": stream_name,
+                "partition_key": partition_key,
+                "sequence_number": sequence_number,
+                "data": data,
+                "approximate_arrival_timestamp": arrival,
+                "processing_timestamp": datetime.now()
+            })
+        return processed_records
+    
+    def _decode_payload(self, payload: bytes) -> Optional[Dict[str, Any]]:
+        """
+        A decompressed payload as a dict: JSON records are parsed, depth
+        delta records rebuilt into the full top-N. None for a delta record
+        that waits for its symbol's next keyframe after a lost record.
+        """
+        if self._depth_delta is not None and is_depth_delta_record(payload):
+            self.stats["depth_delta_records"] += 1
+            return self._depth_delta.decode(payload)
+        return json.loads(payload.decode('utf-8'))
+    
     async def _refresh_shard_iterator(self, iterator_key: str, iterator_info: Dict[str, Any]):
         """Refresh an expired shard iterator."""
         
@@ -315,6 +479,7 @@ class KinesisConsumer:
         """Get consumer statistics."""
         return {
             **self.stats,
+            "hot_partition_merge": {stream: merger.stats for stream, merger in self._mergers.items()},
             "active_iterators": len(self._shard_iterators),
             "streams_configured": len(self.config.kinesis.streams)
         }
\ No newline at end of file
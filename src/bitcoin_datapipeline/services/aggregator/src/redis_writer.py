@@ -4,11 +4,28 @@ import asyncio
 import json
 import logging
 from datetime import datetime
-from typing import Dict, Any, Optional
+from typing import Dict, Any, List, Optional
 import redis.asyncio as redis
 from redis.exceptions import ConnectionError, TimeoutError
 
 from .config.settings import AggregatorConfig
+from .feature_builder import numeric_feature_names
+
+# Fixed-layout binary feature records and compressed feature history from
+# the SBE decoder extension, when it is installed; otherwise only the JSON
+# maps are written
+try:
+    from sbe_decoder_cpp import (
+        FeatureHistoryChunk,
+        decode_feature_history,
+        decode_feature_record,
+        encode_feature_record,
+        feature_records_to_matrix,
+        feature_schema_hash,
+    )
+    FEATURE_RECORDS_AVAILABLE = True
+except ImportError:
+    FEATURE_RECORDS_AVAILABLE = False
 
 
 logger = logging.getLogger(__name__)
@@ -20,12 +37,21 @@ class RedisWriter:
     def __init__(self, config: AggregatorConfig):
         self.config = config
         self.redis_client: Optional[redis.Redis] = None
+        # Binary feature records need a client that returns bytes
+        self.binary_client: Optional[redis.Redis] = None
+        # Schema hashes whose name lists are already in Redis, and back
+        self._published_schemas: Dict[tuple, int] = {}
+        self._schema_names: Dict[int, tuple] = {}
+        # Per-symbol compressed history in place of one JSON key per snapshot
+        self.history_enabled = FEATURE_RECORDS_AVAILABLE and config.redis.history_chunk_rows > 0
+        self._history: Dict[str, "FeatureHistoryChunk"] = {}
         
         # Statistics
         self.stats = {
             "features_written": 0,
             "write_errors": 0,
             "connection_errors": 0,
+            "history_restarts": 0,
             "last_write_time": None
         }
         
@@ -35,17 +61,9 @@ class RedisWriter:
         """Initialize Redis connection."""
         try:
             # Create Redis connection
-            self.redis_client = redis.Redis(
-                host=self.config.redis.host,
-                port=self.config.redis.port,
-                password=self.config.redis.password,
-                db=self.config.redis.db,
-                socket_timeout=self.config.redis.socket_timeout,
-                socket_connect_timeout=self.config.redis.socket_connect_timeout,
-                health_check_interval=30,
-                retry_on_timeout=True,
-                decode_responses=True
-            )
+            self.redis_client = self._connect(decode_responses=True)
+            if FEATURE_RECORDS_AVAILABLE:
+                self.binary_client = self._connect(decode_responses=False)
             
             # Test connection
             await self.redis_client.ping()
@@ -57,12 +75,28 @@ class RedisWriter:
             self.stats["connection_errors"] += 1
             raise
     
+    def _connect(self, decode_responses: bool) -> redis.Redis:
+        return redis.Redis(
+            host=self.config.redis.host,
+            port=self.config.redis.port,
+            password=self.config.redis.password,
+            db=self.config.redis.db,
+            socket_timeout=self.config.redis.socket_timeout,
+            socket_connect_timeout=self.config.redis.socket_connect_timeout,
+            health_check_interval=30,
+            retry_on_timeout=True,
+            decode_responses=decode_responses
+        )
+    
     async def close(self):
         """Close Redis connection."""
         if self.redis_client:
             logger.info("Closing Redis connection")
             await self.redis_client.close()
             self.redis_client = None
+        if self.binary_client:
+            await self.binary_client.close()
+            self.binary_client = None
     
     async def write_features(self, symbol: str, features: Dict[str, Any]) -> bool:
         """Write features to Redis with TTL."""
@@ -79,12 +113,14 @@ class RedisWriter:
             # Serialize features to JSON
             features_json = json.dumps(features, default=str)
             
-            # Write to Redis with TTL
-            await self.redis_client.setex(
-                redis_key,
-                self.config.redis.ttl_seconds,
-                features_json
-            )
+            # Write to Redis with TTL; with compressed history the snapshot
+            # is appended to the symbol's history blob instead
+            if not self.history_enabled:
+                await self.redis_client.setex(
+                    redis_key,
+                    self.config.redis.ttl_seconds,
+                    features_json
+                )
             
             # Also write latest features with a fixed key for easy access
             latest_key = f"{self.config.redis.key_prefix}:{symbol}:latest"
@@ -94,6 +130,9 @@ class RedisWriter:
                 features_json
             )
             
+            if self.binary_client:
+                await self._write_feature_record(symbol, features)
+            
             # Update statistics
             self.stats["features_written"] += 1
             self.stats["last_write_time"] = datetime.now()
@@ -111,6 +150,181 @@ class RedisWriter:
             self.stats["write_errors"] += 1
             return False
     
+    async def _write_feature_record(self, symbol: str, features: Dict[str, Any]):
+        """Write the numeric features as a binary record next to the JSON,
+        and append them to the symbol's history when that is enabled.
+        
+        Values are packed in sorted name order; the name list is stored once
+        per schema under its hash, for readers to resolve positions.
+        """
+        names = numeric_feature_names(features)
+        schema_hash = self._published_schemas.get(names)
+        if schema_hash is None:
+            schema_hash = feature_schema_hash(list(names))
+            await self.binary_client.set(
+                f"{self.config.redis.key_prefix}:schema:{schema_hash:016x}", json.dumps(names)
+            )
+            self._published_schemas[names] = schema_hash
+            self._schema_names[schema_hash] = names
+        
+        values = [float(features[name]) for name in names]
+        event_ts_us = int(features.get("timestamp", 0)) * 1_000_000
+        record = encode_feature_record(values, symbol, event_ts_us, schema_hash)
+        await self.binary_client.setex(
+            f"{self.config.redis.key_prefix}:record:{symbol}",
+            self.config.redis.ttl_seconds,
+            record
+        )
+        if self.history_enabled:
+            await self._append_history(symbol, schema_hash, event_ts_us, values)
+    
+    def _history_key(self, symbol: str) -> str:
+        return f"{self.config.redis.key_prefix}:history:{symbol}"
+    
+    async def _append_history(self, symbol: str, schema_hash: int, event_ts_us: int, values: List[float]):
+        """Append one row to the symbol's compressed history blob.
+        
+        Only the row's compressed bytes go over the wire (APPEND). A blob
+        length other than the chunk's own means the key expired or was
+        rewritten, and the chunk starts over with a fresh blob; a full chunk
+        is renamed to ':prev', keeping its TTL.
+        """
+        key = self._history_key(symbol)
+        ttl = self.config.redis.ttl_seconds
+        chunk = self._history.get(symbol)
+        if chunk is None:
+            # Continue what a previous run left, if it is readable
+            chunk = FeatureHistoryChunk()
+            existing = await self.binary_client.get(key)
+            if existing:
+                try:
+                    chunk.resume(existing)
+                except ValueError as e:
+                    logger.warning(f"Starting a new feature history for {symbol}: {e}")
+            self._history[symbol] = chunk
+        
+        piece = chunk.append(schema_hash, event_ts_us, values)
+        async with self.binary_client.pipeline(transaction=False) as pipe:
+            pipe.append(key, piece)
+            pipe.expire(key, ttl)
+            length, _ = await pipe.execute()
+        if length != chunk.size:
+            self.stats["history_restarts"] += 1
+            chunk.reset()
+            await self.binary_client.setex(key, ttl, chunk.append(schema_hash, event_ts_us, values))
+        
+        if chunk.rows >= self.config.redis.history_chunk_rows or chunk.full:
+            await self.binary_client.rename(key, f"{key}:prev")
+            chunk.reset()
+    
+    async def _schema_names_of(self, schema_hash: int) -> Optional[tuple]:
+        names = self._schema_names.get(schema_hash)
+        if names is None:
+            data = await self.binary_client.get(f"{self.config.redis.key_prefix}:schema:{schema_hash:016x}")
+            if data:
+                names = tuple(json.loads(data))
+                self._schema_names[schema_hash] = names
+        return names
+    
+    async def get_feature_history(self, symbol: str) -> List[Dict[str, Any]]:
+        """Get the symbol's compressed history with one MGET and a native
+        decode: per schema, its 'names', int64 'timestamps_us' and a float64
+        (rows, len(names)) 'values' matrix, oldest row first."""
+        
+        if not self.history_enabled or not self.binary_client:
+            logger.error("Feature history not available")
+            return []
+        
+        try:
+            key = self._history_key(symbol)
+            series = decode_feature_history(await self.binary_client.mget([f"{key}:prev", key]))
+            for entry in series:
+                entry["names"] = await self._schema_names_of(entry["schema_hash"])
+            return [entry for entry in series if entry["names"] is not None]
+            
+        except Exception as e:
+            logger.error(f"Error getting feature history for {symbol}: {e}")
+            return []
+    
+    async def _history_rows(self, symbol: str) -> List[Dict[str, Any]]:
+        """The history as feature maps (numeric features, symbol and
+        timestamp in seconds), oldest first."""
+        rows = []
+        for entry in await self.get_feature_history(symbol):
+            names = entry["names"]
+            for ts_us, values in zip(entry["timestamps_us"].tolist(), entry["values"].tolist()):
+                row = dict(zip(names, values))
+                row["symbol"] = symbol
+                row["timestamp"] = ts_us // 1_000_000
+                rows.append(row)
+        rows.sort(key=lambda row: row["timestamp"])
+        return rows
+    
+    async def get_latest_feature_record(self, symbol: str) -> Optional[Dict[str, Any]]:
+        """Get the latest binary feature record: header fields, a 'values'
+        array and the schema's 'names'."""
+        
+        if not self.binary_client:
+            logger.error("Binary feature records not available")
+            return None
+        
+        try:
+            data = await self.binary_client.get(f"{self.config.redis.key_prefix}:record:{symbol}")
+            if not data:
+                return None
+            
+            record = decode_feature_record(data)
+            names = await self.binary_client.get(
+                f"{self.config.redis.key_prefix}:schema:{record['schema_hash']:016x}"
+            )
+            record["names"] = json.loads(names) if names else None
+            return record
+            
+        except Exception as e:
+            logger.error(f"Error getting feature record for {symbol}: {e}")
+            return None
+    
+    async def get_latest_feature_matrix(
+        self, symbols: List[str], width: int, schema_hash: Optional[int] = None
+    ) -> Optional[tuple]:
+        """Get every symbol's latest feature record with one MGET, stacked as
+        (event_ts_us, float32 (len(symbols), width) matrix) for a batched
+        prediction. Missing symbols and records of another schema are NaN
+        rows with ts 0."""
+        
+        if not self.binary_client:
+            logger.error("Binary feature records not available")
+            return None
+        
+        try:
+            prefix = self.config.redis.key_prefix
+            records = await self.binary_client.mget([f"{prefix}:record:{symbol}" for symbol in symbols])
+            return feature_records_to_matrix(records, width, schema_hash)
+            
+        except Exception as e:
+            logger.error(f"Error getting feature matrix for {len(symbols)} symbols: {e}")
+            return None
+    
+    async def get_model_inputs(self, symbols: List[str], assembler) -> Optional[tuple]:
+        """Get every symbol's latest feature record with one MGET as the
+        model's normalized inputs, (event_ts_us, float32 (len(symbols),
+        assembler.width) matrix), through a one-source FeatureAssembler.
+        Missing symbols and records of another schema get the manifest's
+        fill values with ts 0."""
+        
+        if not self.binary_client:
+            logger.error("Binary feature records not available")
+            return None
+        
+        try:
+            prefix = self.config.redis.key_prefix
+            records = await self.binary_client.mget([f"{prefix}:record:{symbol}" for symbol in symbols])
+            return assembler.from_records(records)
+            
+        except Exception as e:
+            logger.error(f"Error getting model inputs for {len(symbols)} symbols: {e}")
+            return None
+    
     async def get_latest_features(self, symbol: str) -> Optional[Dict[str, Any]]:
         """Get the latest features for a symbol."""
         
@@ -136,13 +350,22 @@ class RedisWriter:
         symbol: str, 
         timestamp: int
     ) -> Optional[Dict[str, Any]]:
-        """Get features for a specific timestamp."""
+        """Get features for a specific timestamp. From the compressed
+        history, these are the numeric features of every snapshot at that
+        timestamp, merged."""
         
         if not self.redis_client:
             logger.error("Redis client not initialized")
             return None
         
         try:
+            if self.history_enabled:
+                merged: Dict[str, Any] = {}
+                for row in await self._history_rows(symbol):
+                    if row["timestamp"] == timestamp:
+                        merged.update(row)
+                return merged or None
+            
             redis_key = f"{self.config.redis.key_prefix}:{symbol}:{timestamp}"
             features_json = await self.redis_client.get(redis_key)
             
@@ -160,13 +383,17 @@ class RedisWriter:
         symbol: str, 
         limit: int = 10
     ) -> List[Dict[str, Any]]:
-        """Get recent features for a symbol."""
+        """Get recent features for a symbol, newest first."""
         
         if not self.redis_client:
             logger.error("Redis client not initialized")
             return []
         
         try:
+            if self.history_enabled:
+                rows = await self._history_rows(symbol)
+                return rows[::-1][:limit]
+            
             # Pattern to match timestamped keys for the symbol
             pattern = f"{self.config.redis.key_prefix}:{symbol}:*"
             
@@ -215,9 +442,11 @@ class RedisWriter:
                 # Delete all features for symbol
                 pattern = f"{self.config.redis.key_prefix}:{symbol}:*"
                 keys = await self.redis_client.keys(pattern)
+                history_key = self._history_key(symbol)
+                keys += [history_key, f"{history_key}:prev"]
+                self._history.pop(symbol, None)
                 
-                if keys:
-                    await self.redis_client.delete(*keys)
+                await self.redis_client.delete(*keys)
             
             return True
             
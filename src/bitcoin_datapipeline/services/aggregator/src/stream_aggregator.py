@@ -2,20 +2,50 @@
 
 import asyncio
 import logging
+import os
 from datetime import datetime
 from typing import Dict, Any, Optional, List
 import json
 import time
 from collections import defaultdict, deque
 
-from .kinesis_consumer import KinesisConsumer
-from .feature_builder import FeatureBuilder
+from .kinesis_consumer import KinesisConsumer, read_dictionaries
+from .feature_builder import FeatureBuilder, numeric_feature_names
 from .redis_writer import RedisWriter
 from .config.settings import AggregatorConfig
 
+# Native struct-of-arrays buffers from the SBE decoder extension, when it is
+# installed; otherwise every stream is buffered as message dicts
+try:
+    from sbe_decoder_cpp import (
+        TradeRing, QuoteRing, MultiHorizonWindow, QuantileWindow, FeatureBus, RecordIngestor, feature_schema_hash,
+        WindowCheckpoint, save_window_checkpoint, TraceCollector, TRACE_STAGES, TimerWheel
+    )
+    NATIVE_RINGS_AVAILABLE = True
+except ImportError:
+    NATIVE_RINGS_AVAILABLE = False
+
 
 logger = logging.getLogger(__name__)
 
+BUFFER_CAPACITY = 1000
+# Trade feature horizons of the 10-second-ahead model, fed from one pass
+HORIZONS_SECONDS = (1, 2, 10, 60)
+# Percentiles of trade size, inter-arrival time and spread, from t-digests
+QUANTILE_HORIZONS_SECONDS = (10, 60)
+QUANTILES = (0.5, 0.9, 0.99)
+# Quantile metrics published with each message type's features
+QUANTILE_METRICS = {"trade": ("trade_size", "inter_arrival_ms"), "bestBidAsk": ("spread_bps",)}
+# Slots this service stamps in a traced message's "trace" block
+if NATIVE_RINGS_AVAILABLE:
+    TRACE_KINESIS_PUT = TRACE_STAGES.index("kinesis_put")
+    TRACE_CONSUME = TRACE_STAGES.index("consume")
+    TRACE_PUBLISH = TRACE_STAGES.index("publish")
+
+
+def now_us() -> int:
+    return time.time_ns() // 1000
+
 
 class StreamAggregator:
     """Aggregates real-time streams and writes features to Redis."""
@@ -23,15 +53,50 @@ class StreamAggregator:
     def __init__(self, config: AggregatorConfig):
         self.config = config
         
+        # Native decode of whole GetRecords batches into rings it owns;
+        # they are adopted into _message_buffers as they appear
+        self.record_ingestor = None
+        if NATIVE_RINGS_AVAILABLE:
+            self.record_ingestor = RecordIngestor(
+                BUFFER_CAPACITY, list(HORIZONS_SECONDS),
+                dictionaries=read_dictionaries(config.kinesis.zstd_dictionary_paths),
+                quantile_horizons_seconds=list(QUANTILE_HORIZONS_SECONDS)
+            )
+        self._native_messages = 0
+        
         # Initialize components
-        self.kinesis_consumer = KinesisConsumer(config)
+        self.kinesis_consumer = KinesisConsumer(config, record_ingestor=self.record_ingestor)
         self.feature_builder = FeatureBuilder(config)
         self.redis_writer = RedisWriter(config)
         
         # Aggregation state
         self._running = False
-        self._message_buffers = defaultdict(lambda: deque(maxlen=1000))
+        # Per "{symbol}_{type}" buffer: a TradeRing/QuoteRing for trades and
+        # best bid/ask when the native module is available, else a deque
+        self._message_buffers: Dict[str, Any] = {}
+        # Per-symbol MultiHorizonWindow over the trades, when native
+        self._horizon_windows: Dict[str, Any] = {}
+        # Per-symbol QuantileWindow over the trades and quotes this process
+        # appends; the ingestor keeps its own for what it routes
+        self._quantile_windows: Dict[str, Any] = {}
+        # Latest features for co-located readers, next to Redis
+        self.feature_bus = None
+        if config.aggregation.feature_bus_path and NATIVE_RINGS_AVAILABLE:
+            self.feature_bus = FeatureBus.create(config.aggregation.feature_bus_path)
+        self._schema_hashes: Dict[tuple, int] = {}
+        # Per-hop latency of traced messages: the newest trace consumed per
+        # buffer is closed when that buffer's features are published
+        self.trace_collector = TraceCollector() if NATIVE_RINGS_AVAILABLE else None
+        self._open_traces: Dict[str, list] = {}
         self._last_aggregation_time = defaultdict(lambda: time.time())
+        self._last_window_checkpoint = time.time()
+        # Grid-aligned snapshots: one wheel timer per buffer
+        self.snapshot_wheel = None
+        if config.aggregation.snapshot_interval_seconds > 0 and NATIVE_RINGS_AVAILABLE:
+            self.snapshot_wheel = TimerWheel(now_ts_us=now_us())
+        self._snapshot_timers: Dict[int, str] = {}
+        self._scheduled_buffers: set = set()
+        self._restore_window_checkpoint()
         
         # Statistics
         self.stats = {
@@ -58,7 +123,10 @@ class StreamAggregator:
             await self.kinesis_consumer.start()
             
             # Start aggregation loop
-            aggregation_task = asyncio.create_task(self._aggregation_loop())
+            if self.snapshot_wheel is not None:
+                aggregation_task = asyncio.create_task(self._snapshot_loop())
+            else:
+                aggregation_task = asyncio.create_task(self._aggregation_loop())
             
             # Start message consumption
             async for message in self.kinesis_consumer.consume_messages():
@@ -87,6 +155,7 @@ class StreamAggregator:
         
         # Flush remaining features
         await self._flush_all_features()
+        self._save_window_checkpoint()
         
         # Stop components
         if self.kinesis_consumer:
@@ -109,8 +178,8 @@ class StreamAggregator:
                 self.stats["errors"] += 1
                 return
             
-            # Determine message type and symbol
-            message_type = data.get("type", "unknown")
+            # Determine message type and symbol; SBE records carry msg_type
+            message_type = data.get("type", data.get("msg_type", "unknown"))
             symbol = data.get("symbol")
             
             if not symbol:
@@ -118,14 +187,29 @@ class StreamAggregator:
                 self.stats["errors"] += 1
                 return
             
+            trace = None
+            if self.trace_collector is not None and "trace" in data:
+                trace = self._stamp_consume(data["trace"], message.get("approximate_arrival_timestamp"))
+            
             # Add to appropriate buffer
             buffer_key = f"{symbol}_{message_type}"
-            self._message_buffers[buffer_key].append({
-                "timestamp": time.time(),
-                "data": data,
-                "stream_name": stream_name,
-                "message_type": message_type
-            })
+            buffer = self._message_buffers.get(buffer_key)
+            if buffer is None:
+                buffer = self._new_buffer(message_type)
+                self._message_buffers[buffer_key] = buffer
+            
+            if isinstance(buffer, deque):
+                buffer.append({
+                    "timestamp": time.time(),
+                    "data": data,
+                    "stream_name": stream_name,
+                    "message_type": message_type
+                })
+            elif not self._append_to_ring(buffer, data, symbol):
+                self.stats["errors"] += 1
+                return
+            if trace is not None:
+                self._open_traces[buffer_key] = trace
             
             # Update statistics
             self.stats["messages_consumed"] += 1
@@ -139,11 +223,78 @@ class StreamAggregator:
             logger.error(f"Error processing message: {e}", exc_info=True)
             self.stats["errors"] += 1
     
+    @staticmethod
+    def _stamp_consume(trace: Any, arrival: Optional[datetime]) -> Optional[list]:
+        """
+        Fill the Kinesis put (the record's arrival time) and consume stamps;
+        None if the record's trace block is malformed.
+        """
+        if not isinstance(trace, list) or len(trace) != len(TRACE_STAGES):
+            return None
+        if arrival is not None:
+            trace[TRACE_KINESIS_PUT] = int(arrival.timestamp() * 1_000_000)
+        trace[TRACE_CONSUME] = now_us()
+        return trace
+    
+    def _close_trace(self, buffer_key: str):
+        """Stamp publish on the buffer's newest trace and record its hops."""
+        trace = self._open_traces.pop(buffer_key, None)
+        if trace is None:
+            return
+        trace[TRACE_PUBLISH] = now_us()
+        try:
+            self.trace_collector.record(trace)
+        except (TypeError, ValueError) as e:
+            logger.debug(f"Dropping malformed trace for {buffer_key}: {e}")
+    
+    def _new_buffer(self, message_type: str):
+        """Create the buffer for one (symbol, type) stream."""
+        if NATIVE_RINGS_AVAILABLE:
+            if message_type == "trade":
+                return TradeRing(BUFFER_CAPACITY)
+            if message_type == "bestBidAsk":
+                return QuoteRing(BUFFER_CAPACITY)
+        return deque(maxlen=BUFFER_CAPACITY)
+    
+    def _append_to_ring(self, ring, data: Dict[str, Any], symbol: str) -> bool:
+        """Copy the fields the features read into a native ring."""
+        try:
+            event_ts = int(data.get('event_ts', data.get('timestamp', 0)))
+            if isinstance(ring, TradeRing):
+                trade = (
+                    event_ts,
+                    float(data.get('price', 0)),
+                    float(data.get('qty', data.get('volume', 0))),
+                    bool(data.get('is_buyer_maker', False))
+                )
+                ring.append(*trade)
+                window = self._horizon_windows.get(symbol)
+                if window is None:
+                    window = MultiHorizonWindow(HORIZONS_SECONDS)
+                    self._horizon_windows[symbol] = window
+                window.add(*trade)
+                self._quantile_window(symbol).add_trade(event_ts, trade[2])
+            else:
+                quote = (
+                    event_ts,
+                    float(data.get('bid_px', data.get('bid_price', 0))),
+                    float(data.get('bid_sz', data.get('bid_size', 0))),
+                    float(data.get('ask_px', data.get('ask_price', 0))),
+                    float(data.get('ask_sz', data.get('ask_size', 0)))
+                )
+                ring.append(*quote)
+                self._quantile_window(symbol).add_quote(event_ts, quote[1], quote[3])
+            return True
+        except (ValueError, TypeError) as e:
+            logger.warning(f"Invalid message data: {data}, error: {e}")
+            return False
+    
     async def _aggregation_loop(self):
         """Main aggregation loop that runs periodically."""
         while self._running:
             try:
                 current_time = time.time()
+                self._adopt_native_buffers()
                 
                 # Check each buffer for aggregation
                 for buffer_key, buffer in self._message_buffers.items():
@@ -163,6 +314,8 @@ class StreamAggregator:
                         await self._aggregate_buffer(buffer_key, buffer)
                         self._last_aggregation_time[buffer_key] = current_time
                 
+                self._maybe_save_window_checkpoint(current_time)
+                
                 # Sleep for aggregation interval
                 await asyncio.sleep(self.config.aggregation.check_interval_seconds)
             
@@ -170,8 +323,111 @@ class StreamAggregator:
                 logger.error(f"Aggregation loop error: {e}", exc_info=True)
                 await asyncio.sleep(5)  # Brief pause on error
     
-    async def _aggregate_buffer(self, buffer_key: str, buffer: deque):
-        """Aggregate messages in a buffer and write features to Redis."""
+    async def _snapshot_loop(self):
+        """Aggregate each buffer on its snapshot grid, sleeping until the next grid time."""
+        wheel = self.snapshot_wheel
+        check_interval = self.config.aggregation.check_interval_seconds
+        while self._running:
+            try:
+                self._adopt_native_buffers()
+                self._schedule_snapshots()
+                
+                for timer_id, due_us, _lag_us in wheel.advance(now_us()):
+                    buffer_key = self._snapshot_timers.get(timer_id)
+                    buffer = self._message_buffers.get(buffer_key)
+                    if buffer:
+                        await self._aggregate_buffer(buffer_key, buffer, snapshot_ts_us=due_us)
+                
+                self._maybe_save_window_checkpoint(time.time())
+                
+                # Wake on the next grid time, or sooner to pick up new buffers
+                next_due_us = wheel.next_due_us
+                delay = check_interval if next_due_us is None else (next_due_us - now_us()) / 1e6
+                await asyncio.sleep(min(max(delay, 0.0), check_interval))
+            
+            except Exception as e:
+                logger.error(f"Snapshot loop error: {e}", exc_info=True)
+                await asyncio.sleep(5)  # Brief pause on error
+    
+    def _schedule_snapshots(self):
+        """Give every buffer without one a timer on its type's snapshot grid."""
+        aggregation = self.config.aggregation
+        for buffer_key in self._message_buffers.keys() - self._scheduled_buffers:
+            message_type = buffer_key.split('_', 1)[1]
+            period = aggregation.snapshot_type_intervals.get(message_type, aggregation.snapshot_interval_seconds)
+            self._snapshot_timers[self.snapshot_wheel.add(period)] = buffer_key
+            self._scheduled_buffers.add(buffer_key)
+    
+    def _maybe_save_window_checkpoint(self, current_time: float):
+        """Checkpoint the trade windows once window_checkpoint_interval_seconds has passed."""
+        interval = self.config.aggregation.window_checkpoint_interval_seconds
+        if current_time - self._last_window_checkpoint >= interval:
+            self._save_window_checkpoint()
+            self._last_window_checkpoint = current_time
+    
+    def _adopt_native_buffers(self):
+        """Pick up the rings the ingestor created and count what it routed."""
+        if self.record_ingestor is None:
+            return
+        for symbol, message_type, ring, window in self.record_ingestor.take_new_buffers():
+            self._message_buffers[f"{symbol}_{message_type}"] = ring
+            if window is not None:
+                self._horizon_windows[symbol] = window
+        counts = self.record_ingestor.counts
+        routed = counts["trades"] + counts["quotes"]
+        if routed != self._native_messages:
+            self.stats["messages_consumed"] += routed - self._native_messages
+            self.stats["last_message_time"] = datetime.now()
+            self._native_messages = routed
+    
+    def _restore_window_checkpoint(self):
+        """Warm-start the trade windows and Kinesis positions from the last checkpoint."""
+        path = self.config.aggregation.window_checkpoint_path
+        if not path or not NATIVE_RINGS_AVAILABLE or not os.path.exists(path):
+            return
+        try:
+            checkpoint = WindowCheckpoint(path)
+            meta = json.loads(checkpoint.meta or b"{}")
+        except ValueError as e:
+            logger.warning(f"Ignoring window checkpoint {path}: {e}")
+            return
+        
+        if self.record_ingestor is not None:
+            # Adopted with their rings by _adopt_native_buffers
+            restored = self.record_ingestor.restore_windows(checkpoint)
+        else:
+            restored = 0
+            for symbol in checkpoint.keys:
+                window = MultiHorizonWindow(HORIZONS_SECONDS)
+                if checkpoint.restore(symbol, window):
+                    self._horizon_windows[symbol] = window
+                    restored += 1
+        # Replay only what arrived after the checkpoint; resuming without the
+        # windows would skip the trades they are missing
+        if restored == len(checkpoint):
+            self.kinesis_consumer.resume_from(meta.get("positions", {}))
+        age = time.time() - checkpoint.written_us / 1e6
+        logger.info(f"Restored {restored}/{len(checkpoint)} trade windows from {path} ({age:.1f}s old)")
+    
+    def _save_window_checkpoint(self):
+        """Write the trade windows and the Kinesis positions they include."""
+        path = self.config.aggregation.window_checkpoint_path
+        if not path or not NATIVE_RINGS_AVAILABLE:
+            return
+        self._adopt_native_buffers()
+        meta = json.dumps({"positions": self.kinesis_consumer.positions()}).encode()
+        try:
+            save_window_checkpoint(path, self._horizon_windows, meta)
+        except ValueError as e:
+            logger.warning(f"Failed to write window checkpoint {path}: {e}")
+            self.stats["errors"] += 1
+    
+    async def _aggregate_buffer(self, buffer_key: str, buffer, snapshot_ts_us: Optional[int] = None):
+        """Aggregate messages in a buffer and write features to Redis.
+        
+        A snapshot_ts_us (a grid time from the snapshot wheel) becomes the
+        features' timestamp, so they line up with the training data's grid.
+        """
         if not buffer:
             return
         
@@ -179,18 +435,41 @@ class StreamAggregator:
             # Extract symbol and message type from buffer key
             symbol, message_type = buffer_key.split('_', 1)
             
-            # Get messages to aggregate
-            messages_to_aggregate = list(buffer)
-            buffer.clear()
+            logger.debug(f"Aggregating {len(buffer)} messages for {buffer_key}")
             
-            logger.debug(f"Aggregating {len(messages_to_aggregate)} messages for {buffer_key}")
+            if isinstance(buffer, deque):
+                # Get messages to aggregate
+                messages_to_aggregate = list(buffer)
+                buffer.clear()
+                
+                # Build features
+                features = await self.feature_builder.build_features(
+                    symbol=symbol,
+                    messages=messages_to_aggregate,
+                    message_type=message_type
+                )
+            else:
+                # Native rings compute the features over their columns in place
+                features = self.feature_builder.build_ring_features(
+                    symbol=symbol,
+                    ring=buffer,
+                    message_type=message_type
+                )
+                buffer.clear()
+                window = self._horizon_windows.get(symbol)
+                if features and window is not None and message_type == "trade":
+                    features.update(self._horizon_features(window))
+                quantiles = self._quantile_windows.get(symbol)
+                if quantiles is None and self.record_ingestor is not None:
+                    quantiles = self.record_ingestor.quantile_window(symbol)
+                if features and quantiles is not None:
+                    features.update(self._quantile_features(quantiles, message_type))
             
-            # Build features
-            features = await self.feature_builder.build_features(
-                symbol=symbol,
-                messages=messages_to_aggregate,
-                message_type=message_type
-            )
+            if features and snapshot_ts_us is not None:
+                features["timestamp"] = snapshot_ts_us // 1_000_000
+            
+            if features and self.feature_bus is not None:
+                self._publish_to_bus(f"{symbol}:{message_type}", features)
             
             if features:
                 # Write features to Redis
@@ -199,6 +478,8 @@ class StreamAggregator:
                 if success:
                     self.stats["features_computed"] += 1
                     self.stats["features_written"] += 1
+                    if self.trace_collector is not None:
+                        self._close_trace(buffer_key)
                     logger.debug(f"Wrote features for {symbol}: {features}")
                 else:
                     self.stats["errors"] += 1
@@ -207,9 +488,52 @@ class StreamAggregator:
             logger.error(f"Error aggregating buffer {buffer_key}: {e}", exc_info=True)
             self.stats["errors"] += 1
     
+    def _publish_to_bus(self, key: str, features: Dict[str, Any]):
+        """Write the numeric features to the shared-memory bus slot of key."""
+        names = numeric_feature_names(features)
+        schema_hash = self._schema_hashes.get(names)
+        if schema_hash is None:
+            schema_hash = feature_schema_hash(list(names))
+            self._schema_hashes[names] = schema_hash
+        values = [float(features[name]) for name in names]
+        try:
+            if not self.feature_bus.publish(key, values, int(features.get("timestamp", 0)) * 1_000_000, schema_hash):
+                logger.warning(f"Feature bus has no free slot for {key}")
+        except ValueError as e:
+            logger.warning(f"Feature bus rejected {key}: {e}")
+    
+    @staticmethod
+    def _horizon_features(window) -> Dict[str, Any]:
+        """Flatten the per-horizon trade features as e.g. "vwap_10s"."""
+        flat = {}
+        for label, features in window.features().items():
+            for name in ("vwap", "volume", "trade_count", "price_change_pct",
+                         "price_volatility", "volume_imbalance"):
+                flat[f"{name}_{label}"] = features.get(name, 0)
+        return flat
+    
+    def _quantile_window(self, symbol: str):
+        """The symbol's QuantileWindow, created on its first trade or quote."""
+        window = self._quantile_windows.get(symbol)
+        if window is None:
+            window = self._quantile_windows[symbol] = QuantileWindow(QUANTILE_HORIZONS_SECONDS)
+        return window
+    
+    @staticmethod
+    def _quantile_features(window, message_type: str) -> Dict[str, Any]:
+        """Flatten the message type's percentiles as e.g. "trade_size_p99_10s"."""
+        metrics = QUANTILE_METRICS.get(message_type, ())
+        flat = {}
+        for label, features in window.features(list(QUANTILES)).items():
+            for name, value in features.items():
+                if name.rsplit('_p', 1)[0] in metrics:
+                    flat[f"{name}_{label}"] = value
+        return flat
+    
     async def _flush_all_features(self):
         """Flush all remaining features in buffers."""
         logger.info("Flushing all remaining features")
+        self._adopt_native_buffers()
         
         for buffer_key, buffer in self._message_buffers.items():
             if buffer:
@@ -311,5 +635,10 @@ class StreamAggregator:
                 "active_buffers": len(self._message_buffers)
             }
         })
+        if self.trace_collector is not None and self.trace_collector.traces:
+            stats["trace_latency_us"] = self.trace_collector.summary()
+        if self.snapshot_wheel is not None:
+            # Lag of each snapshot behind its grid time, and grid points missed
+            stats["snapshot_schedule"] = self.snapshot_wheel.stats
         
         return stats
\ No newline at end of file
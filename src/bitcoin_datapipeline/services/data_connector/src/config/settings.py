@@ -34,6 +34,7 @@ class ETLConfig:
     batch_size: int
     enable_derived_features: bool
     max_file_age_hours: int
+    max_concurrent_files: int = 4  # files of a batch read/parsed/written at once
 
 
 @dataclass
@@ -153,7 +153,12 @@ class ETLOrchestrator:
         return cycle_stats
     
     async def _process_file_batch(self, file_batch: List[Dict[str, Any]]) -> Dict[str, Any]:
-        """Process a batch of S3 files."""
+        """Process a batch of S3 files, up to etl.max_concurrent_files at a time.
+        
+        Downloads, parsing (native, GIL released) and database writes of
+        different files overlap; each file is still read, transformed and
+        written in order.
+        """
         batch_stats = {
             "files_processed": 0,
             "records_processed": 0,
@@ -161,38 +166,46 @@ class ETLOrchestrator:
             "errors": 0
         }
         
-        for file_info in file_batch:
-            try:
-                # Read data from S3
-                raw_data = await self.s3_reader.read_file(file_info)
-                
-                if not raw_data:
-                    logger.warning(f"No data in file: {file_info['key']}")
-                    continue
-                
-                # Transform data
-                transformed_data = await self.transformer.transform(raw_data, file_info)
-                
-                if not transformed_data:
-                    logger.warning(f"No transformed data for file: {file_info['key']}")
-                    continue
-                
-                # Write to database
-                records_written = await self.db_writer.write_batch(transformed_data)
-                
-                # Update statistics
-                batch_stats["files_processed"] += 1
-                batch_stats["records_processed"] += len(raw_data)
-                batch_stats["records_written"] += records_written
-                
-                logger.debug(f"Processed file {file_info['key']}: {len(raw_data)} records")
-                
-            except Exception as e:
-                logger.error(f"Error processing file {file_info['key']}: {e}", exc_info=True)
-                batch_stats["errors"] += 1
+        semaphore = asyncio.Semaphore(max(1, int(self.config.etl.max_concurrent_files)))
         
+        async def process(file_info: Dict[str, Any]):
+            async with semaphore:
+                await self._process_file(file_info, batch_stats)
+        
+        await asyncio.gather(*(process(file_info) for file_info in file_batch))
         return batch_stats
     
+    async def _process_file(self, file_info: Dict[str, Any], batch_stats: Dict[str, Any]):
+        """Read, transform and write one S3 file, counting into batch_stats."""
+        try:
+            # Read data from S3
+            raw_data = await self.s3_reader.read_file(file_info)
+            
+            if not raw_data:
+                logger.warning(f"No data in file: {file_info['key']}")
+                return
+            
+            # Transform data
+            transformed_data = await self.transformer.transform(raw_data, file_info)
+            
+            if not transformed_data:
+                logger.warning(f"No transformed data for file: {file_info['key']}")
+                return
+            
+            # Write to database
+            records_written = await self.db_writer.write_batch(transformed_data)
+            
+            # Update statistics
+            batch_stats["files_processed"] += 1
+            batch_stats["records_processed"] += len(raw_data)
+            batch_stats["records_written"] += records_written
+            
+            logger.debug(f"Processed file {file_info['key']}: {len(raw_data)} records")
+            
+        except Exception as e:
+            logger.error(f"Error processing file {file_info['key']}: {e}", exc_info=True)
+            batch_stats["errors"] += 1
+    
     async def _wait_for_next_cycle(self):
         """Wait for the next ETL cycle."""
         interval_seconds = self.config.etl.cycle_interval_seconds
@@ -11,6 +11,77 @@ from botocore.exceptions import ClientError
 
 from .config.settings import DataConnectorConfig
 
+# Parquet archive files (rest_ingestor's S3BronzeWriter with
+# archive_format: parquet) need pyarrow; JSONL files do not
+try:
+    import pyarrow as pa
+    import pyarrow.parquet as pq
+    PARQUET_AVAILABLE = True
+except ImportError:
+    PARQUET_AVAILABLE = False
+
+# JSONL objects are parsed natively into typed columns when the extension is
+# installed; without it they are json.loads'ed line by line
+try:
+    from sbe_decoder_cpp import NdjsonParser
+    NATIVE_JSONL_AVAILABLE = True
+except ImportError:
+    NATIVE_JSONL_AVAILABLE = False
+
+# JSONL record fields per data type, as in rest_ingestor's S3BronzeWriter
+# archive schemas; depth snapshots come out one row per level
+AGG_TRADES_COLUMNS = [
+    ("symbol", "string"),
+    ("event_ts", "timestamp_ms"),
+    ("ingest_ts", "timestamp_ms"),
+    ("trade_id", "int64"),
+    ("price", "float64"),
+    ("qty", "float64"),
+    ("is_buyer_maker", "bool"),
+    ("source", "string"),
+]
+KLINES_COLUMNS = [
+    ("symbol", "string"),
+    ("interval", "string"),
+    ("open_time", "timestamp_ms"),
+    ("close_time", "timestamp_ms"),
+    ("open_price", "float64"),
+    ("high_price", "float64"),
+    ("low_price", "float64"),
+    ("close_price", "float64"),
+    ("volume", "float64"),
+    ("quote_volume", "float64"),
+    ("trade_count", "int64"),
+    ("taker_buy_base_volume", "float64"),
+    ("taker_buy_quote_volume", "float64"),
+    ("ingest_ts", "timestamp_ms"),
+]
+DEPTH_LEVEL_COLUMNS = [
+    ("symbol", "string"),
+    ("timestamp", "timestamp_ms"),
+    ("ingest_ts", "timestamp_ms"),
+    ("last_update_id", "int64"),
+    ("side", "string"),
+    ("level", "int64"),
+    ("price", "float64"),
+    ("qty", "float64"),
+    ("source", "string"),
+]
+
+
+JSONL_SCHEMAS = {
+    "aggTrades": AGG_TRADES_COLUMNS,
+    "klines": KLINES_COLUMNS,
+    "depth_snapshots": DEPTH_LEVEL_COLUMNS,
+}
+
+
+def jsonl_schema_name(data_type: Optional[str]) -> Optional[str]:
+    """JSONL_SCHEMAS key of a data type (klines_1m -> klines), None if it has none."""
+    if data_type and data_type.startswith("klines"):
+        return "klines"
+    return data_type if data_type in JSONL_SCHEMAS else None
+
 
 logger = logging.getLogger(__name__)
 
@@ -32,6 +103,10 @@ class S3Reader:
         # Processed files tracking (in production, this would be in a database)
         self._processed_files = set()
         
+        # One native parser per schema; parse() releases the GIL and splits
+        # each object over every core
+        self._jsonl_parsers: Dict[str, Any] = {}
+        
         logger.info(f"S3Reader initialized for bucket: {config.aws.s3_bucket}")
     
     async def discover_new_files(
@@ -118,7 +193,7 @@ class S3Reader:
     def _is_data_file(self, key: str) -> bool:
         """Check if S3 key represents a data file."""
         # Check for expected data file patterns
-        data_patterns = ['.jsonl', '.jsonl.gz', '.json', '.json.gz']
+        data_patterns = ['.jsonl', '.jsonl.gz', '.json', '.json.gz', '.parquet']
         return any(key.endswith(pattern) for pattern in data_patterns)
     
     def _extract_metadata_from_key(self, key: str) -> Dict[str, Any]:
@@ -151,8 +226,16 @@ class S3Reader:
         
         return metadata
     
-    async def read_file(self, file_info: Dict[str, Any]) -> List[Dict[str, Any]]:
-        """Read and parse data from S3 file."""
+    async def read_file(
+        self,
+        file_info: Dict[str, Any],
+        columns: Optional[List[str]] = None
+    ) -> List[Dict[str, Any]]:
+        """Read and parse data from S3 file.
+        
+        `columns` limits a Parquet file to the fields the caller needs (JSONL
+        records always come whole).
+        """
         
         key = file_info["key"]
         logger.debug(f"Reading file: {key}")
@@ -170,10 +253,30 @@ class S3Reader:
             # Read file content
             content = response['Body'].read()
             
+            if key.endswith('.parquet'):
+                records = await asyncio.get_event_loop().run_in_executor(
+                    None, self._parse_parquet, content, columns
+                )
+                self._processed_files.add(key)
+                logger.debug(f"Read {len(records)} records from {key}")
+                return records
+            
             # Decompress if gzipped
             if key.endswith('.gz'):
                 content = gzip.decompress(content)
             
+            parser = self._jsonl_parser(file_info.get("data_type"))
+            if parser is not None:
+                parsed = await asyncio.get_event_loop().run_in_executor(None, parser.parse, content)
+                if parsed["bad_lines"]:
+                    logger.warning(f"Skipped {parsed['bad_lines']} invalid JSON lines in {key}")
+                records = self._columns_to_records(parsed)
+                if 'side' in parsed["columns"]:
+                    records = self._group_depth_levels(records)
+                self._processed_files.add(key)
+                logger.debug(f"Read {len(records)} records from {key}")
+                return records
+            
             # Parse JSONL content
             content_str = content.decode('utf-8')
             records = []
@@ -196,6 +299,95 @@ class S3Reader:
             logger.error(f"Error reading file {key}: {e}", exc_info=True)
             raise
     
+    async def read_columns(self, file_info: Dict[str, Any]) -> Optional[Dict[str, Any]]:
+        """Parse a JSONL file straight into typed columns.
+        
+        Returns NdjsonParser.parse's result ('columns', 'rows', 'bad_lines',
+        'missing' masks), with depth snapshots one row per level, or None when
+        the extension is missing or the data type has no schema; callers then
+        use read_file.
+        """
+        
+        key = file_info["key"]
+        parser = self._jsonl_parser(file_info.get("data_type"))
+        if parser is None or key.endswith('.parquet'):
+            return None
+        
+        response = await asyncio.get_event_loop().run_in_executor(
+            None,
+            lambda: self.s3_client.get_object(Bucket=self.config.aws.s3_bucket, Key=key)
+        )
+        content = response['Body'].read()
+        if key.endswith('.gz'):
+            content = gzip.decompress(content)
+        
+        parsed = await asyncio.get_event_loop().run_in_executor(None, parser.parse, content)
+        self._processed_files.add(key)
+        logger.debug(f"Parsed {parsed['rows']} rows from {key}")
+        return parsed
+    
+    def _jsonl_parser(self, data_type: Optional[str]):
+        """The native parser for a data type's JSONL files, if there is one."""
+        
+        schema = jsonl_schema_name(data_type)
+        if not NATIVE_JSONL_AVAILABLE or schema is None:
+            return None
+        parser = self._jsonl_parsers.get(schema)
+        if parser is None:
+            parser = self._jsonl_parsers[schema] = NdjsonParser(JSONL_SCHEMAS[schema])
+        return parser
+    
+    @staticmethod
+    def _columns_to_records(parsed: Dict[str, Any]) -> List[Dict[str, Any]]:
+        """Records from parsed columns; fields the line did not have are left out."""
+        
+        columns = parsed["columns"]
+        names = list(columns)
+        values = [column if isinstance(column, list) else column.tolist() for column in columns.values()]
+        records = [dict(zip(names, row)) for row in zip(*values)]
+        
+        for name, mask in parsed["missing"].items():
+            for row in mask.nonzero()[0].tolist():
+                del records[row][name]
+        return records
+    
+    @staticmethod
+    def _group_depth_levels(rows: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
+        """Depth snapshot records from one-row-per-level rows (a `side` field)."""
+        
+        snapshots: Dict[tuple, Dict[str, Any]] = {}
+        for row in rows:
+            key = (row.get('symbol'), row.get('timestamp'), row.get('last_update_id'))
+            snapshot = snapshots.get(key)
+            if snapshot is None:
+                snapshot = {k: v for k, v in row.items() if k not in ('side', 'level', 'price', 'qty')}
+                snapshot['bids'] = []
+                snapshot['asks'] = []
+                snapshots[key] = snapshot
+            snapshot[row['side'] + 's'].append([row.get('price'), row.get('qty')])
+        return list(snapshots.values())
+    
+    @staticmethod
+    def _parse_parquet(content: bytes, columns: Optional[List[str]]) -> List[Dict[str, Any]]:
+        """Records of a Parquet archive file, timestamps as epoch milliseconds.
+        
+        Depth files hold one row per level (a `side` column); their rows are
+        regrouped into the snapshot records the JSONL files carry.
+        """
+        
+        if not PARQUET_AVAILABLE:
+            raise RuntimeError("pyarrow is required to read Parquet archive files")
+        
+        table = pq.read_table(pa.BufferReader(content), columns=columns)
+        for i, field in enumerate(table.schema):
+            if pa.types.is_timestamp(field.type):
+                table = table.set_column(i, field.name, table.column(i).cast(pa.int64()))
+        rows = table.to_pylist()
+        
+        if 'side' not in table.column_names:
+            return rows
+        return S3Reader._group_depth_levels(rows)
+    
     async def health_check(self) -> Dict[str, Any]:
         """Perform health check on S3 reader."""
         health_status = {
@@ -7,9 +7,24 @@ from decimal import Decimal, InvalidOperation
 
 from .config.settings import DataConnectorConfig
 
+# Price and quantity text is validated a whole column at a time when the
+# extension is installed; without it every value goes through
+# _safe_decimal_convert on its own
+try:
+    from sbe_decoder_cpp import parse_decimals
+    NATIVE_DECIMALS_AVAILABLE = True
+except ImportError:
+    NATIVE_DECIMALS_AVAILABLE = False
+
 
 logger = logging.getLogger(__name__)
 
+# Record fields holding decimal text, per data type
+DECIMAL_FIELDS = {
+    "aggTrades": ("price", "qty"),
+    "klines": ("open_price", "high_price", "low_price", "close_price", "volume", "quote_volume"),
+}
+
 
 class DataTransformer:
     """Transforms raw S3 data for PostgreSQL storage."""
@@ -37,6 +52,7 @@ class DataTransformer:
         logger.debug(f"Transforming {len(raw_records)} records of type {data_type}")
         
         transformed_records = []
+        self._convert_decimal_fields(raw_records, DECIMAL_FIELDS.get(data_type, ()))
         
         for record in raw_records:
             try:
@@ -158,6 +174,60 @@ class DataTransformer:
             logger.warning(f"Error transforming kline record: {e}")
             return None
     
+    def transform_kline_columns(
+        self,
+        klines: Dict[str, Any],
+        symbol: str,
+        interval: str = '1m'
+    ) -> List[Dict[str, Any]]:
+        """Build kline records from a decoded klines table.
+
+        `klines` is the 'klines' table of sbe_decoder_cpp's decode_batch for
+        KlinesResponse (template 203) pages: equal-length columns open_time,
+        close_time, open/high/low/close, volume, quote_volume, num_trades.
+        With raw=True the OHLC columns are mantissas plus price_exponent and
+        are converted exactly. The page was validated by the decoder, so rows
+        skip the per-field checks of _transform_kline.
+        """
+
+        exponents = klines.get('price_exponent')
+
+        def prices(column: str) -> List[Decimal]:
+            values = klines[column]
+            if exponents is None:
+                return [Decimal(str(float(value))) for value in values]
+            return [Decimal(int(value)).scaleb(int(exponent)) for value, exponent in zip(values, exponents)]
+
+        open_prices, high_prices = prices('open'), prices('high')
+        low_prices, close_prices = prices('low'), prices('close')
+        created_at = datetime.now()
+
+        transformed_records = []
+        for i in range(len(klines['open_time'])):
+            volume = Decimal(str(float(klines['volume'][i])))
+            quote_volume = Decimal(str(float(klines['quote_volume'][i])))
+            close_price = close_prices[i]
+            transformed_records.append({
+                "symbol": symbol,
+                "timestamp": int(klines['open_time'][i]),
+                "price": close_price,
+                "volume": volume,
+                "open_price": open_prices[i],
+                "high_price": high_prices[i],
+                "low_price": low_prices[i],
+                "close_price": close_price,
+                "quote_volume": quote_volume,
+                "vwap": quote_volume / volume if volume > 0 else close_price,
+                "trade_count": int(klines['num_trades'][i]),
+                "interval": interval,
+                "source": "rest",
+                "data_type": "kline",
+                "created_at": created_at
+            })
+
+        self.stats["records_transformed"] += len(transformed_records)
+        return transformed_records
+
     async def _transform_depth_snapshot(self, record: Dict[str, Any], symbol: str) -> Optional[Dict[str, Any]]:
         """Transform depth snapshot record."""
         
@@ -214,6 +284,34 @@ class DataTransformer:
             logger.warning(f"Error transforming depth snapshot: {e}")
             return None
     
+    def _convert_decimal_fields(self, records: List[Dict[str, Any]], fields) -> None:
+        """Replace the decimal text of `fields` with Decimals, in place.
+
+        Each field is parsed natively for the whole batch in one call, and
+        rows repeating a text (prices at the same tick, round quantities)
+        share one Decimal. Values the parser rejects - numbers, blank or
+        malformed text, missing fields - are left as they are for
+        _safe_decimal_convert, which handles and logs them as before.
+        """
+
+        if not NATIVE_DECIMALS_AVAILABLE or not records:
+            return
+
+        for field in fields:
+            values = [record.get(field) for record in records]
+            parsed = parse_decimals(values)
+            if parsed["invalid"] == len(values):
+                continue
+            decimals: Dict[str, Decimal] = {}
+            for record, value, valid in zip(records, values, parsed["valid"].tolist()):
+                # parse_decimals also takes bytes, which Decimal does not
+                if not valid or type(value) is not str:
+                    continue
+                decimal = decimals.get(value)
+                if decimal is None:
+                    decimal = decimals[value] = Decimal(value)
+                record[field] = decimal
+
     def _safe_decimal_convert(self, value: Any) -> Optional[Decimal]:
         """Safely convert value to Decimal."""
         
@@ -3,7 +3,7 @@
 import asyncio
 import aiohttp
 import logging
-from typing import List, Dict, Any, Optional, AsyncIterator
+from typing import List, Dict, Any, Optional, AsyncIterator, Tuple
 from datetime import datetime, timedelta
 import time
 import json
@@ -12,8 +12,39 @@ from dataclasses import dataclass
 from ..config.settings import BinanceConfig, RetryConfig
 from ..utils.retry import exponential_backoff
 
+try:
+    from sbe_decoder_cpp import rate_governor
+    NATIVE_GOVERNOR_AVAILABLE = True
+except ImportError:
+    NATIVE_GOVERNOR_AVAILABLE = False
+
+try:
+    from sbe_decoder_cpp import OrderBook
+    NATIVE_DEPTH_AVAILABLE = True
+except ImportError:
+    NATIVE_DEPTH_AVAILABLE = False
+
 logger = logging.getLogger(__name__)
 
+# Request weights per endpoint (depth's depends on limit, see depth_weight)
+ENDPOINT_WEIGHTS = {
+    '/api/v3/aggTrades': 4,
+    '/api/v3/historicalTrades': 25,
+    '/api/v3/klines': 2,
+    '/api/v3/exchangeInfo': 20,
+}
+
+
+def depth_weight(limit: int) -> int:
+    """Request weight of /api/v3/depth for a given limit."""
+    if limit <= 100:
+        return 5
+    if limit <= 500:
+        return 25
+    if limit <= 1000:
+        return 50
+    return 250
+
 
 @dataclass
 class BackfillCheckpoint:
@@ -33,6 +64,10 @@ class BinanceRESTClient:
         self.retry_config = retry_config
         self.session: Optional[aiohttp.ClientSession] = None
         self.rate_limiter = RateLimiter(config.rate_limit_requests_per_minute)
+        # With the native extension every client in the process shares one
+        # weight budget, sized from exchangeInfo and corrected from the
+        # X-MBX-USED-WEIGHT-1M header of each response
+        self.governor = rate_governor() if NATIVE_GOVERNOR_AVAILABLE else None
         
         # Endpoints
         self.endpoints = {
@@ -55,23 +90,75 @@ class BinanceRESTClient:
         if self.session:
             await self.session.close()
     
-    async def _make_request(self, endpoint: str, params: Dict[str, Any]) -> Dict[str, Any]:
-        """Make rate-limited HTTP request with retry logic."""
+    async def _configure_governor(self):
+        """Size the shared governor from exchangeInfo's rate limits, once per process."""
+        if self.governor is None or self.governor.configured:
+            return
+        endpoint = '/api/v3/exchangeInfo'
+        try:
+            await self._wait_for_governor(ENDPOINT_WEIGHTS[endpoint])
+            async with self.session.get(f"{self.config.rest_base_url}{endpoint}",
+                                        params={'symbol': self.config.symbols[0]}) as response:
+                response.raise_for_status()
+                self._observe_used_weight(response)
+                rate_limits = (await response.json()).get('rateLimits', [])
+            self.governor.configure(rate_limits)
+            logger.info(f"Rate governor configured from exchangeInfo: {self.governor.limits}")
+        except Exception as e:
+            # Unconfigured, the governor still learns the weight limit from
+            # response headers and honours Retry-After
+            logger.warning(f"Could not load exchangeInfo rate limits: {e}")
+    
+    async def _wait_for_governor(self, weight: int):
+        """Sleep until the shared governor grants `weight`."""
+        while (wait := self.governor.reserve(weight)) > 0:
+            await asyncio.sleep(wait)
+    
+    def _observe_used_weight(self, response: aiohttp.ClientResponse):
+        used = response.headers.get('X-MBX-USED-WEIGHT-1M')
+        if used is not None and self.governor is not None:
+            self.governor.observe_used_weight(int(used))
+    
+    async def _make_request(
+        self,
+        endpoint: str,
+        params: Dict[str, Any],
+        weight: Optional[int] = None,
+        raw: bool = False
+    ) -> Any:
+        """Make rate-limited HTTP request with retry logic.
+
+        Returns the decoded JSON, or the body bytes with raw=True.
+        """
         if not self.session:
             raise RuntimeError("Client not initialized. Use async context manager.")
         
         url = f"{self.config.rest_base_url}{endpoint}"
+        if weight is None:
+            weight = ENDPOINT_WEIGHTS.get(endpoint, 1)
         
-        # Rate limiting
-        await self.rate_limiter.acquire()
+        if self.governor is not None:
+            await self._configure_governor()
         
         async def _request():
+            # Rate limiting, per attempt: a retry spends weight too
+            if self.governor is not None:
+                await self._wait_for_governor(weight)
+            else:
+                await self.rate_limiter.acquire()
+            
             async with self.session.get(url, params=params) as response:
-                if response.status == 429:
-                    # Rate limit exceeded
+                self._observe_used_weight(response)
+                if response.status in (418, 429):
+                    # Rate limit exceeded (418: IP banned for repeating 429s)
                     retry_after = int(response.headers.get('Retry-After', 60))
-                    logger.warning(f"Rate limit exceeded, waiting {retry_after}s")
-                    await asyncio.sleep(retry_after)
+                    if self.governor is not None:
+                        # Holds every caller in the process, not just this one
+                        logger.warning(f"Rate limit exceeded ({response.status}), backing off {retry_after}s")
+                        self.governor.back_off(retry_after)
+                    else:
+                        logger.warning(f"Rate limit exceeded, waiting {retry_after}s")
+                        await asyncio.sleep(retry_after)
                     raise aiohttp.ClientResponseError(
                         request_info=response.request_info,
                         history=response.history,
@@ -80,6 +167,8 @@ class BinanceRESTClient:
                     )
                 
                 response.raise_for_status()
+                if raw:
+                    return await response.read()
                 return await response.json()
         
         return await exponential_backoff(
@@ -109,7 +198,7 @@ class BinanceRESTClient:
             params['startTime'] = start_time
         if end_time:
             params['endTime'] = end_time
-        if from_id:
+        if from_id is not None:
             params['fromId'] = from_id
         
         logger.debug(f"Fetching aggTrades for {symbol}: {params}")
@@ -191,13 +280,45 @@ class BinanceRESTClient:
         logger.debug(f"Fetching depth snapshot for {symbol}")
         
         try:
-            data = await self._make_request(self.endpoints['depth'], params)
+            data = await self._make_request(self.endpoints['depth'], params, weight=depth_weight(limit))
             logger.info(f"Retrieved depth snapshot for {symbol} with {len(data.get('bids', []))} bids and {len(data.get('asks', []))} asks")
             return data
         except Exception as e:
             logger.error(f"Failed to fetch depth snapshot for {symbol}: {e}")
             raise
     
+    async def get_depth_book(
+        self,
+        symbol: str,
+        limit: int = 5000,
+        book: Optional[Any] = None
+    ) -> Any:
+        """Load a depth snapshot into a native OrderBook.
+
+        The response body goes to OrderBook.load_depth_json as bytes, so a
+        5000-level snapshot never becomes Python lists and strings. Loads
+        into `book` (replacing its levels) or a new OrderBook for `symbol`.
+        """
+        if not NATIVE_DEPTH_AVAILABLE:
+            raise RuntimeError("Native OrderBook unavailable; use get_depth_snapshot")
+        params = {
+            'symbol': symbol,
+            'limit': limit
+        }
+        
+        logger.debug(f"Fetching depth book for {symbol}")
+        
+        try:
+            body = await self._make_request(self.endpoints['depth'], params, weight=depth_weight(limit), raw=True)
+            if book is None:
+                book = OrderBook(symbol)
+            book.load_depth_json(body)
+            logger.info(f"Loaded depth book for {symbol} with {book.bid_levels} bids and {book.ask_levels} asks")
+            return book
+        except Exception as e:
+            logger.error(f"Failed to load depth book for {symbol}: {e}")
+            raise
+    
     async def backfill_agg_trades(
         self,
         symbol: str,
@@ -231,19 +352,7 @@ class BinanceRESTClient:
                 
                 # Process each trade
                 for trade in trades:
-                    # Normalize trade data (REST API format)
-                    normalized_trade = {
-                        'symbol': symbol,  # Symbol is passed as parameter, not in response
-                        'event_ts': trade['T'],  # Timestamp
-                        'ingest_ts': int(time.time() * 1000),
-                        'trade_id': trade['a'],  # aggTradeId
-                        'price': float(trade['p']),  # Price
-                        'qty': float(trade['q']),   # Quantity
-                        'is_buyer_maker': trade['m'],  # isBuyerMaker
-                        'source': 'rest'
-                    }
-                    
-                    yield normalized_trade
+                    yield self._normalize_agg_trade(symbol, trade)
                     current_start = max(current_start, trade['T'] + 1)
                 
                 # Update checkpoint
@@ -254,14 +363,45 @@ class BinanceRESTClient:
                 
                 logger.debug(f"Processed batch for {symbol}: {len(trades)} trades, next start: {current_start}")
                 
-                # Small delay to be respectful to the API
-                await asyncio.sleep(0.1)
+                # Small delay to be respectful to the API, unless the
+                # governor is already pacing requests to the weight budget
+                if self.governor is None:
+                    await asyncio.sleep(0.1)
                 
             except Exception as e:
                 logger.error(f"Error in aggTrades backfill for {symbol} at {current_start}: {e}")
                 raise
         
         logger.info(f"Completed aggTrades backfill for {symbol}")
+    
+    async def backfill_agg_trade_ids(
+        self,
+        symbol: str,
+        requests: List[Tuple[int, int]]
+    ) -> AsyncIterator[Dict[str, Any]]:
+        """Fetch planned (from_id, limit) aggTrades requests, e.g. to fill ID gaps."""
+        for from_id, limit in requests:
+            trades = await self.get_agg_trades(symbol=symbol, from_id=from_id, limit=limit)
+            for trade in trades:
+                yield self._normalize_agg_trade(symbol, trade)
+            
+            # Small delay to be respectful to the API, unless governed
+            if self.governor is None:
+                await asyncio.sleep(0.1)
+    
+    @staticmethod
+    def _normalize_agg_trade(symbol: str, trade: Dict[str, Any]) -> Dict[str, Any]:
+        """Normalize trade data (REST API format)."""
+        return {
+            'symbol': symbol,  # Symbol is passed as parameter, not in response
+            'event_ts': trade['T'],  # Timestamp
+            'ingest_ts': int(time.time() * 1000),
+            'trade_id': trade['a'],  # aggTradeId
+            'price': float(trade['p']),  # Price
+            'qty': float(trade['q']),   # Quantity
+            'is_buyer_maker': trade['m'],  # isBuyerMaker
+            'source': 'rest'
+        }
 
 
 class RateLimiter:
@@ -3,16 +3,35 @@
 import asyncio
 import logging
 from datetime import datetime, timedelta
-from typing import Dict, Any, List
+from typing import Dict, Any, List, Tuple
 
 from .clients.binance_rest import BinanceRESTClient, BackfillCheckpoint
 from .writers.s3_writer import S3BronzeWriter
 from .config.settings import RestIngestorConfig
 from .config.aws_config import AWSClientManager
 
+# Captured-ID interval sets from the SBE decoder extension, when it is
+# installed; without it gap backfill refetches the whole ID range
+try:
+    from sbe_decoder_cpp import IdIntervalSet
+    NATIVE_GAPS_AVAILABLE = True
+except ImportError:
+    NATIVE_GAPS_AVAILABLE = False
+
+# Native work-stealing backfill: pages are fetched over the WebSocket API,
+# decoded and encoded as Parquet on worker threads
+try:
+    from sbe_decoder_cpp import BackfillPool
+    NATIVE_BACKFILL_AVAILABLE = True
+except ImportError:
+    NATIVE_BACKFILL_AVAILABLE = False
+
 
 logger = logging.getLogger(__name__)
 
+# Binance returns at most this many aggTrades per request
+AGG_TRADES_REQUEST_LIMIT = 1000
+
 
 class DataCollector:
     """Orchestrates data collection from Binance REST API to S3."""
@@ -21,6 +40,8 @@ class DataCollector:
         self.config = config
         self.aws_client_manager = AWSClientManager(config.aws)
         self.s3_writer = S3BronzeWriter(self.aws_client_manager, config.aws)
+        # aggTrade IDs written to S3 so far, per symbol
+        self.captured_agg_trade_ids: Dict[str, Any] = {}
         
         logger.info("DataCollector initialized")
     
@@ -75,6 +96,7 @@ class DataCollector:
                         await self._write_batch_to_s3(
                             "aggTrades", symbol, current_batch, stats
                         )
+                        self._record_agg_trade_ids(symbol, current_batch)
                         current_batch = []
                         batch_count += 1
                         
@@ -87,6 +109,7 @@ class DataCollector:
                     await self._write_batch_to_s3(
                         "aggTrades", symbol, current_batch, stats
                     )
+                    self._record_agg_trade_ids(symbol, current_batch)
         
         except Exception as e:
             logger.error(f"Error collecting aggTrades for {symbol}: {e}", exc_info=True)
@@ -95,6 +118,171 @@ class DataCollector:
         
         return stats
     
+    async def collect_agg_trade_gaps(
+        self,
+        symbol: str,
+        first_id: int,
+        last_id: int
+    ) -> Dict[str, Any]:
+        """Fetch only the aggTrade IDs in first_id..last_id not captured yet."""
+        requests = self._plan_agg_trade_requests(symbol, first_id, last_id)
+        logger.info(
+            f"Filling aggTrades gaps for {symbol} in IDs {first_id}..{last_id} "
+            f"with {len(requests)} requests"
+        )
+        
+        stats = {
+            "data_type": "aggTrades",
+            "symbol": symbol,
+            "first_id": first_id,
+            "last_id": last_id,
+            "requests_planned": len(requests),
+            "records_collected": 0,
+            "files_written": 0,
+            "errors": 0
+        }
+        if not requests:
+            return stats
+        
+        try:
+            rest_client = BinanceRESTClient(
+                config=self.config.binance,
+                retry_config=self.config.retry
+            )
+            
+            async with rest_client:
+                current_batch = []
+                async for trade in rest_client.backfill_agg_trade_ids(symbol, requests):
+                    current_batch.append(trade)
+                    stats["records_collected"] += 1
+                    
+                    if len(current_batch) >= AGG_TRADES_REQUEST_LIMIT:
+                        await self._write_batch_to_s3(
+                            "aggTrades", symbol, current_batch, stats
+                        )
+                        self._record_agg_trade_ids(symbol, current_batch)
+                        current_batch = []
+                
+                if current_batch:
+                    await self._write_batch_to_s3(
+                        "aggTrades", symbol, current_batch, stats
+                    )
+                    self._record_agg_trade_ids(symbol, current_batch)
+        
+        except Exception as e:
+            logger.error(f"Error filling aggTrades gaps for {symbol}: {e}", exc_info=True)
+            stats["errors"] += 1
+            stats["error_message"] = str(e)
+        
+        return stats
+    
+    async def backfill_agg_trade_gaps(
+        self,
+        gaps: Dict[str, Tuple[int, int]],
+        workers: int = 0
+    ) -> Dict[str, Dict[str, Any]]:
+        """Fill several symbols' aggTrade ID gaps, {symbol: (first_id, last_id)}.
+        
+        With the native extension and a Parquet archive, every symbol's
+        planned pages go to one BackfillPool: its workers (0 = one per core)
+        fetch, decode and encode pages in parallel, steal from each other
+        when one symbol has far more history than the rest, and pace their
+        requests through the process's shared rate governor. Only the
+        uploads happen here. Otherwise symbols are filled one at a time.
+        """
+        if not (NATIVE_BACKFILL_AVAILABLE and NATIVE_GAPS_AVAILABLE
+                and self.s3_writer.archive_format == "parquet"):
+            return {
+                symbol: await self.collect_agg_trade_gaps(symbol, first_id, last_id)
+                for symbol, (first_id, last_id) in gaps.items()
+            }
+        
+        all_stats = {}
+        pool = BackfillPool(workers=workers)
+        loop = asyncio.get_event_loop()
+        try:
+            remaining = 0
+            for symbol, (first_id, last_id) in gaps.items():
+                requests = self._plan_agg_trade_requests(symbol, first_id, last_id)
+                all_stats[symbol] = {
+                    "data_type": "aggTrades",
+                    "symbol": symbol,
+                    "first_id": first_id,
+                    "last_id": last_id,
+                    "requests_planned": len(requests),
+                    "records_collected": 0,
+                    "files_written": 0,
+                    "errors": 0
+                }
+                if requests:
+                    pool.add(symbol, requests)
+                    remaining += len(requests)
+            logger.info(
+                f"Backfilling {remaining} aggTrades pages for {len(gaps)} symbols "
+                f"on {pool.workers} workers"
+            )
+            
+            # One result per page; waiting on the next one releases the GIL
+            while remaining:
+                result = await loop.run_in_executor(None, pool.next_result, 1.0)
+                if result is None:
+                    continue
+                remaining -= 1
+                stats = all_stats[result.symbol]
+                if not result.ok:
+                    logger.error(f"aggTrades page {result.symbol} fromId={result.from_id} failed: {result.error}")
+                    stats["errors"] += 1
+                    stats["error_message"] = result.error
+                    continue
+                if not result.rows:
+                    continue
+                try:
+                    await self.s3_writer.write_agg_trades_parquet(
+                        result.symbol, result.parquet, result.rows, result.first_time, result.first_id
+                    )
+                    stats["files_written"] += 1
+                    stats["records_collected"] += result.rows
+                    self._record_agg_trade_range(result.symbol, result.first_id, result.last_id)
+                except Exception as e:
+                    logger.error(f"Failed to write backfilled aggTrades for {result.symbol}: {e}", exc_info=True)
+                    stats["errors"] += 1
+        finally:
+            await loop.run_in_executor(None, pool.stop)
+        
+        logger.info(f"Backfill pool stats: {pool.stats}")
+        return all_stats
+    
+    def _record_agg_trade_range(self, symbol: str, first_id: int, last_id: int):
+        """Mark a written page's consecutive aggTrade IDs as captured."""
+        captured = self.captured_agg_trade_ids.get(symbol)
+        if captured is None:
+            captured = self.captured_agg_trade_ids[symbol] = IdIntervalSet()
+        captured.add(first_id, last_id)
+    
+    def _record_agg_trade_ids(self, symbol: str, batch: List[Dict[str, Any]]):
+        """Mark a written batch's aggTrade IDs as captured."""
+        if not NATIVE_GAPS_AVAILABLE:
+            return
+        captured = self.captured_agg_trade_ids.get(symbol)
+        if captured is None:
+            captured = self.captured_agg_trade_ids[symbol] = IdIntervalSet()
+        captured.add_ids([trade["trade_id"] for trade in batch])
+    
+    def _plan_agg_trade_requests(
+        self,
+        symbol: str,
+        first_id: int,
+        last_id: int
+    ) -> List[Tuple[int, int]]:
+        """The (from_id, limit) requests that fetch every uncaptured ID in range."""
+        if NATIVE_GAPS_AVAILABLE:
+            captured = self.captured_agg_trade_ids.get(symbol) or IdIntervalSet()
+            return captured.plan(first_id, last_id, AGG_TRADES_REQUEST_LIMIT)
+        return [
+            (from_id, min(AGG_TRADES_REQUEST_LIMIT, last_id - from_id + 1))
+            for from_id in range(first_id, last_id + 1, AGG_TRADES_REQUEST_LIMIT)
+        ]
+    
     async def collect_klines(
         self, 
         symbol: str, 
@@ -23,6 +23,7 @@ class AWSConfig:
     s3_bronze_prefix: str
     s3_checkpoint_prefix: str
     endpoint_url: Optional[str] = None  # For LocalStack
+    archive_format: str = "parquet"  # "parquet" or "jsonl" (gzip)
 
 
 @dataclass
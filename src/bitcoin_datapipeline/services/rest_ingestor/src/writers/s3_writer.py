@@ -15,8 +15,56 @@ from ..config.settings import AWSConfig
 from ..utils.retry import retry_with_backoff
 from ..utils.deduplication import RecordDeduplicator
 
+# Columnar Parquet archive files from the SBE decoder extension, when it is
+# installed; without it the writer falls back to gzip JSONL
+try:
+    from sbe_decoder_cpp import ParquetWriter
+    PARQUET_AVAILABLE = True
+except ImportError:
+    PARQUET_AVAILABLE = False
+
 logger = logging.getLogger(__name__)
 
+# Parquet columns per data type, named as in the JSONL records. Depth
+# snapshots are stored one row per level; S3Reader regroups them.
+AGG_TRADES_COLUMNS = [
+    ("symbol", "string"),
+    ("event_ts", "timestamp_ms"),
+    ("ingest_ts", "timestamp_ms"),
+    ("trade_id", "int64"),
+    ("price", "float64"),
+    ("qty", "float64"),
+    ("is_buyer_maker", "bool"),
+    ("source", "string"),
+]
+KLINES_COLUMNS = [
+    ("symbol", "string"),
+    ("interval", "string"),
+    ("open_time", "timestamp_ms"),
+    ("close_time", "timestamp_ms"),
+    ("open_price", "float64"),
+    ("high_price", "float64"),
+    ("low_price", "float64"),
+    ("close_price", "float64"),
+    ("volume", "float64"),
+    ("quote_volume", "float64"),
+    ("trade_count", "int64"),
+    ("taker_buy_base_volume", "float64"),
+    ("taker_buy_quote_volume", "float64"),
+    ("ingest_ts", "timestamp_ms"),
+]
+DEPTH_LEVEL_COLUMNS = [
+    ("symbol", "string"),
+    ("timestamp", "timestamp_ms"),
+    ("ingest_ts", "timestamp_ms"),
+    ("last_update_id", "int64"),
+    ("side", "string"),
+    ("level", "int64"),
+    ("price", "float64"),
+    ("qty", "float64"),
+    ("source", "string"),
+]
+
 
 @dataclass
 class S3WriteStats:
@@ -34,7 +82,7 @@ class S3BronzeWriter:
     
     Features:
     - Time-partitioned storage (yyyy/mm/dd/hh structure)
-    - JSONL format with optional gzip compression
+    - Parquet (dictionary-encoded, zstd) or JSONL with optional gzip
     - Deduplication support
     - Batch writing for efficiency
     - Proper error handling and retry logic
@@ -50,6 +98,10 @@ class S3BronzeWriter:
         
         # Configuration
         self.compression_enabled = True
+        self.archive_format = config.archive_format
+        if self.archive_format == "parquet" and not PARQUET_AVAILABLE:
+            logger.warning("sbe_decoder_cpp not installed; archiving as JSONL instead of Parquet")
+            self.archive_format = "jsonl"
         self.batch_size = 1000
         self.buffer_timeout_seconds = 300  # 5 minutes
         
@@ -92,8 +144,40 @@ class S3BronzeWriter:
         
         logger.info(f"Writing {len(unique_trades)} unique aggTrades for {symbol} to {s3_key}")
         
+        if self.archive_format == "parquet":
+            ingest_ts = int(datetime.utcnow().timestamp() * 1000)
+            rows = [
+                {**trade, "symbol": trade.get("symbol", symbol), "ingest_ts": trade.get("ingest_ts", ingest_ts),
+                 "source": trade.get("source", "rest")}
+                for trade in unique_trades
+            ]
+            return await self._write_parquet_to_s3(s3_key, AGG_TRADES_COLUMNS, rows)
         return await self._write_jsonl_to_s3(s3_key, unique_trades)
     
+    async def write_agg_trades_parquet(
+        self,
+        symbol: str,
+        content: bytes,
+        record_count: int,
+        first_time: int,
+        first_id: int
+    ) -> bool:
+        """Upload an aggTrades page already encoded as Parquet (BackfillPool results).
+        
+        The file is keyed by its first trade's time and ID, so pages of one
+        symbol written in the same second do not overwrite each other.
+        """
+        
+        s3_key = self._build_s3_key(
+            data_type="aggTrades",
+            symbol=symbol,
+            timestamp=datetime.utcfromtimestamp(first_time / 1000),
+            archive_format="parquet",
+            suffix=f"_{first_id}"
+        )
+        await self._put_object(s3_key, content, 'application/vnd.apache.parquet', record_count, 'parquet-zstd')
+        return True
+    
     async def write_trades(
         self,
         symbol: str,
@@ -180,6 +264,8 @@ class S3BronzeWriter:
         
         logger.info(f"Writing {len(structured_klines)} unique klines for {symbol} to {s3_key}")
         
+        if self.archive_format == "parquet":
+            return await self._write_parquet_to_s3(s3_key, KLINES_COLUMNS, structured_klines)
         return await self._write_jsonl_to_s3(s3_key, structured_klines)
     
     async def write_depth_snapshot(
@@ -211,9 +297,35 @@ class S3BronzeWriter:
         
         logger.info(f"Writing depth snapshot for {symbol} to {s3_key}")
         
+        if self.archive_format == "parquet":
+            return await self._write_parquet_to_s3(s3_key, DEPTH_LEVEL_COLUMNS, self._depth_level_rows(structured_depth))
         return await self._write_jsonl_to_s3(s3_key, [structured_depth])
     
-    def _build_s3_key(self, data_type: str, symbol: str, timestamp: datetime) -> str:
+    @staticmethod
+    def _depth_level_rows(snapshot: Dict[str, Any]) -> List[Dict[str, Any]]:
+        """One row per bid and ask level of a structured depth snapshot."""
+        
+        base = {
+            "symbol": snapshot["symbol"],
+            "timestamp": snapshot["timestamp"],
+            "ingest_ts": snapshot["ingest_ts"],
+            "last_update_id": snapshot["last_update_id"] or 0,
+            "source": snapshot["source"],
+        }
+        rows = []
+        for side in ("bids", "asks"):
+            for level, (price, qty) in enumerate(snapshot[side]):
+                rows.append({**base, "side": side[:-1], "level": level, "price": float(price), "qty": float(qty)})
+        return rows
+    
+    def _build_s3_key(
+        self,
+        data_type: str,
+        symbol: str,
+        timestamp: datetime,
+        archive_format: Optional[str] = None,
+        suffix: str = ""
+    ) -> str:
         """Build S3 key with time partitioning."""
         
         # Time partitioning: yyyy/mm/dd/hh
@@ -223,9 +335,13 @@ class S3BronzeWriter:
         hour = timestamp.strftime("%H")
         
         # File name with timestamp
-        filename = f"{data_type}_{timestamp.strftime('%Y%m%d_%H%M%S')}.jsonl"
-        if self.compression_enabled:
-            filename += ".gz"
+        filename = f"{data_type}_{timestamp.strftime('%Y%m%d_%H%M%S')}{suffix}"
+        if (archive_format or self.archive_format) == "parquet":
+            filename += ".parquet"
+        else:
+            filename += ".jsonl"
+            if self.compression_enabled:
+                filename += ".gz"
         
         return f"{self.config.s3_bronze_prefix}/{symbol}/{data_type}/yyyy={year}/mm={month}/dd={day}/hh={hour}/{filename}"
     
@@ -257,7 +373,201 @@ class S3BronzeWriter:
                 content_bytes = jsonl_content.encode('utf-8')
                 content_type = 'application/json'
             
-            # Upload to S3
-            s3_client = self.aws_client_manager.s3_client
+            extra_args = {'ContentEncoding': 'gzip'} if self.compression_enabled else {}
+            await self._put_object(
+                s3_key, content_bytes, content_type, len(records),
+                'gzip' if self.compression_enabled else 'none', **extra_args
+            )
+            return True
+            
+        except Exception as e:
+            logger.error(f"Failed to write to S3 key {s3_key}: {e}")
+            self.stats.errors += 1
+            raise
+    
+    @retry_with_backoff(
+        max_attempts=3,
+        initial_delay=1.0,
+        max_delay=10.0,
+        exceptions=(Exception,)
+    )
+    async def _write_parquet_to_s3(
+        self,
+        s3_key: str,
+        columns: List[tuple],
+        records: List[Dict[str, Any]]
+    ) -> bool:
+        """Write records to S3 as one Parquet file with the given columns."""
+        
+        try:
+            writer = ParquetWriter(columns)
+            writer.append_rows(records)
+            # Encoding releases the GIL
+            content_bytes = await asyncio.get_event_loop().run_in_executor(None, writer.finish)
+            
+            await self._put_object(
+                s3_key, content_bytes, 'application/vnd.apache.parquet', len(records), 'parquet-zstd'
+            )
+            return True
+            
+        except Exception as e:
+            logger.error(f"Failed to write to S3 key {s3_key}: {e}")
+            self.stats.errors += 1
+            raise
+    
+    async def _put_object(
+        self,
+        s3_key: str,
+        content_bytes: bytes,
+        content_type: str,
+        record_count: int,
+        compression: str,
+        **extra_args
+    ):
+        """Upload one archive file and update statistics."""
+        
+        s3_client = self.aws_client_manager.s3_client
+        
+        await asyncio.get_event_loop().run_in_executor(
+            None,
+            lambda: s3_client.put_object(
+                Bucket=self.config.s3_bucket,
+                Key=s3_key,
+                Body=content_bytes,
+                ContentType=content_type,
+                Metadata={
+                    'record_count': str(record_count),
+                    'ingest_timestamp': str(int(datetime.utcnow().timestamp())),
+                    'compression': compression
+                },
+                **extra_args
+            )
+        )
+        
+        # Update statistics
+        self.stats.files_written += 1
+        self.stats.records_written += record_count
+        self.stats.bytes_written += len(content_bytes)
+        self.stats.last_write_time = datetime.utcnow().timestamp()
+        
+        logger.info(
+            f"Successfully wrote {record_count} records to s3://{self.config.s3_bucket}/{s3_key} "
+            f"({len(content_bytes)} bytes)"
+        )
+    
+    async def write_buffered(self, buffer_key: str, record: Dict[str, Any]):
+        """Add record to buffer and write when buffer is full or timeout reached."""
+        
+        current_time = datetime.utcnow().timestamp()
+        
+        # Initialize buffer if needed
+        if buffer_key not in self._buffers:
+            self._buffers[buffer_key] = []
+            self._buffer_timestamps[buffer_key] = current_time
+        
+        self._buffers[buffer_key].append(record)
+        
+        # Check if we should flush the buffer
+        should_flush = (
+            len(self._buffers[buffer_key]) >= self.batch_size or
+            current_time - self._buffer_timestamps[buffer_key] >= self.buffer_timeout_seconds
+        )
+        
+        if should_flush:
+            await self._flush_buffer(buffer_key)
+    
+    async def _flush_buffer(self, buffer_key: str):
+        """Flush a specific buffer to S3."""
+        
+        if buffer_key not in self._buffers or not self._buffers[buffer_key]:
+            return
+        
+        records = self._buffers[buffer_key].copy()
+        self._buffers[buffer_key].clear()
+        self._buffer_timestamps[buffer_key] = datetime.utcnow().timestamp()
+        
+        # Parse buffer key to extract metadata
+        # Format: "symbol_datatype_timestamp"
+        try:
+            parts = buffer_key.split('_')
+            symbol = parts[0]
+            data_type = '_'.join(parts[1:-1])
+            
+            timestamp = datetime.utcnow()
+            s3_key = self._build_s3_key(data_type, symbol, timestamp, archive_format="jsonl")
+            
+            await self._write_jsonl_to_s3(s3_key, records)
+            
+        except Exception as e:
+            logger.error(f"Failed to flush buffer {buffer_key}: {e}")
+            # Re-add records to buffer for retry
+            self._buffers[buffer_key].extend(records)
+    
+    async def flush_all_buffers(self):
+        """Flush all pending buffers."""
+        
+        buffer_keys = list(self._buffers.keys())
+        
+        if buffer_keys:
+            logger.info(f"Flushing {len(buffer_keys)} buffers")
+            
+            flush_tasks = [
+                self._flush_buffer(buffer_key)
+                for buffer_key in buffer_keys
+                if self._buffers[buffer_key]  # Only flush non-empty buffers
+            ]
             
-            await asyncio.get_event_loop().run_in_executor(\n                None,\n                lambda: s3_client.put_object(\n                    Bucket=self.config.s3_bucket,\n                    Key=s3_key,\n                    Body=content_bytes,\n                    ContentType=content_type,\n                    ContentEncoding='gzip' if self.compression_enabled else None,\n                    Metadata={\n                        'record_count': str(len(records)),\n                        'ingest_timestamp': str(int(datetime.utcnow().timestamp())),\n                        'compression': 'gzip' if self.compression_enabled else 'none'\n                    }\n                )\n            )\n            \n            # Update statistics\n            self.stats.files_written += 1\n            self.stats.records_written += len(records)\n            self.stats.bytes_written += len(content_bytes)\n            self.stats.last_write_time = datetime.utcnow().timestamp()\n            \n            logger.info(\n                f\"Successfully wrote {len(records)} records to s3://{self.config.s3_bucket}/{s3_key} \"\n                f\"({len(content_bytes)} bytes)\"\n            )\n            \n            return True\n            \n        except Exception as e:\n            logger.error(f\"Failed to write to S3 key {s3_key}: {e}\")\n            self.stats.errors += 1\n            raise\n    \n    async def write_buffered(self, buffer_key: str, record: Dict[str, Any]):\n        \"\"\"Add record to buffer and write when buffer is full or timeout reached.\"\"\"\n        \n        current_time = datetime.utcnow().timestamp()\n        \n        # Initialize buffer if needed\n        if buffer_key not in self._buffers:\n            self._buffers[buffer_key] = []\n            self._buffer_timestamps[buffer_key] = current_time\n        \n        self._buffers[buffer_key].append(record)\n        \n        # Check if we should flush the buffer\n        should_flush = (\n            len(self._buffers[buffer_key]) >= self.batch_size or\n            current_time - self._buffer_timestamps[buffer_key] >= self.buffer_timeout_seconds\n        )\n        \n        if should_flush:\n            await self._flush_buffer(buffer_key)\n    \n    async def _flush_buffer(self, buffer_key: str):\n        \"\"\"Flush a specific buffer to S3.\"\"\"\n        \n        if buffer_key not in self._buffers or not self._buffers[buffer_key]:\n            return\n        \n        records = self._buffers[buffer_key].copy()\n        self._buffers[buffer_key].clear()\n        self._buffer_timestamps[buffer_key] = datetime.utcnow().timestamp()\n        \n        # Parse buffer key to extract metadata\n        # Format: \"symbol_datatype_timestamp\"\n        try:\n            parts = buffer_key.split('_')\n            symbol = parts[0]\n            data_type = '_'.join(parts[1:-1])\n            \n            timestamp = datetime.utcnow()\n            s3_key = self._build_s3_key(data_type, symbol, timestamp)\n            \n            await self._write_jsonl_to_s3(s3_key, records)\n            \n        except Exception as e:\n            logger.error(f\"Failed to flush buffer {buffer_key}: {e}\")\n            # Re-add records to buffer for retry\n            self._buffers[buffer_key].extend(records)\n    \n    async def flush_all_buffers(self):\n        \"\"\"Flush all pending buffers.\"\"\"\n        \n        buffer_keys = list(self._buffers.keys())\n        \n        if buffer_keys:\n            logger.info(f\"Flushing {len(buffer_keys)} buffers\")\n            \n            flush_tasks = [\n                self._flush_buffer(buffer_key)\n                for buffer_key in buffer_keys\n                if self._buffers[buffer_key]  # Only flush non-empty buffers\n            ]\n            \n            if flush_tasks:\n                await asyncio.gather(*flush_tasks, return_exceptions=True)\n    \n    def get_stats(self) -> Dict[str, Any]:\n        \"\"\"Get S3 writer statistics.\"\"\"\n        \n        return {\n            'files_written': self.stats.files_written,\n            'records_written': self.stats.records_written,\n            'bytes_written': self.stats.bytes_written,\n            'errors': self.stats.errors,\n            'last_write_time': self.stats.last_write_time,\n            'buffer_counts': {\n                buffer_key: len(records)\n                for buffer_key, records in self._buffers.items()\n            },\n            'deduplication_stats': self.deduplicator.get_stats()\n        }\n    \n    async def health_check(self) -> Dict[str, Any]:\n        \"\"\"Perform health check on S3 writer.\"\"\"\n        \n        stats = self.get_stats()\n        \n        health_status = {\n            'healthy': True,\n            'issues': []\n        }\n        \n        # Check error rates\n        if stats['files_written'] > 0:\n            error_rate = stats['errors'] / stats['files_written']\n            if error_rate > 0.05:  # >5% error rate\n                health_status['healthy'] = False\n                health_status['issues'].append(f'High error rate: {error_rate:.2%}')\n        \n        # Check buffer sizes\n        total_buffered = sum(stats['buffer_counts'].values())\n        if total_buffered > 10000:\n            health_status['healthy'] = False\n            health_status['issues'].append(f'Large buffer size: {total_buffered}')\n        \n        # Check last write time\n        if stats['last_write_time']:\n            time_since_last_write = datetime.utcnow().timestamp() - stats['last_write_time']\n            if time_since_last_write > 3600:  # >1 hour\n                health_status['healthy'] = False\n                health_status['issues'].append(f'No writes for {time_since_last_write/3600:.1f} hours')\n        \n        return {\n            'status': 'healthy' if health_status['healthy'] else 'unhealthy',\n            'issues': health_status['issues'],\n            'stats': stats\n        }"
\ No newline at end of file
+            if flush_tasks:
+                await asyncio.gather(*flush_tasks, return_exceptions=True)
+    
+    def get_stats(self) -> Dict[str, Any]:
+        """Get S3 writer statistics."""
+        
+        return {
+            'files_written': self.stats.files_written,
+            'records_written': self.stats.records_written,
+            'bytes_written': self.stats.bytes_written,
+            'errors': self.stats.errors,
+            'last_write_time': self.stats.last_write_time,
+            'buffer_counts': {
+                buffer_key: len(records)
+                for buffer_key, records in self._buffers.items()
+            },
+            'deduplication_stats': self.deduplicator.get_stats()
+        }
+    
+    async def health_check(self) -> Dict[str, Any]:
+        """Perform health check on S3 writer."""
+        
+        stats = self.get_stats()
+        
+        health_status = {
+            'healthy': True,
+            'issues': []
+        }
+        
+        # Check error rates
+        if stats['files_written'] > 0:
+            error_rate = stats['errors'] / stats['files_written']
+            if error_rate > 0.05:  # >5% error rate
+                health_status['healthy'] = False
+                health_status['issues'].append(f'High error rate: {error_rate:.2%}')
+        
+        # Check buffer sizes
+        total_buffered = sum(stats['buffer_counts'].values())
+        if total_buffered > 10000:
+            health_status['healthy'] = False
+            health_status['issues'].append(f'Large buffer size: {total_buffered}')
+        
+        # Check last write time
+        if stats['last_write_time']:
+            time_since_last_write = datetime.utcnow().timestamp() - stats['last_write_time']
+            if time_since_last_write > 3600:  # >1 hour
+                health_status['healthy'] = False
+                health_status['issues'].append(f'No writes for {time_since_last_write/3600:.1f} hours')
+        
+        return {
+            'status': 'healthy' if health_status['healthy'] else 'unhealthy',
+            'issues': health_status['issues'],
+            'stats': stats
+        }
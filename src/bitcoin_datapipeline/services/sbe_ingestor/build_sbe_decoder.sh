@@ -47,7 +47,7 @@ else
 fi
 
 # Build with performance optimizations for trading applications
-CPPFLAGS="-O3 -march=native -ffast-math -DNDEBUG" $PYTHON_CMD setup.py build_ext --inplace
+CPPFLAGS="-O3 -ffast-math -DNDEBUG" $PYTHON_CMD setup.py build_ext --inplace
 
 # Install the extension
 echo "📦 Installing extension..."
@@ -87,6 +87,7 @@ echo "   - This decoder supports Binance SBE WebSocket streams (schema 1:0)"
 echo "   - Optimized for ultra-low latency trading applications"
 echo "   - Supports trade, best bid/ask, and depth diff stream messages"
 echo "   - Use decode_message() for automatic message type detection"
+echo "   - Benchmark decoder changes with src/sbe_decoder/bench/run_bench.sh"
 echo ""
 echo "🔗 WebSocket endpoint: wss://stream-sbe.binance.com/stream"
 echo "📚 Documentation: https://developers.binance.com/docs/binance-spot-api-docs/sbe-market-data-streams"
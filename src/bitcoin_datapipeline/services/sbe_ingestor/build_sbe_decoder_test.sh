@@ -53,7 +53,7 @@ else
 fi
 
 # Build with performance optimizations for trading applications
-CPPFLAGS="-O3 -march=native -ffast-math -DNDEBUG" $PYTHON_CMD setup.py build_ext --inplace
+CPPFLAGS="-O3 -ffast-math -DNDEBUG" $PYTHON_CMD setup.py build_ext --inplace
 
 # For testing, we just build in-place and add to PYTHONPATH
 # This completely avoids pip and works with the current environment
@@ -1,12 +1,14 @@
 """Binance SBE WebSocket client for real-time market data."""
 
 import asyncio
+import glob
+import os
 import websockets
 from websockets.exceptions import ConnectionClosed, WebSocketException
 import logging
 import time
-import struct
-from typing import Dict, Any, Optional, Callable, AsyncIterator
+from urllib.parse import urlparse
+from typing import Dict, Any, List, Optional, Callable, AsyncIterator
 from dataclasses import dataclass
 from enum import Enum
 
@@ -17,11 +19,23 @@ from ..utils.retry import CircuitBreaker
 try:
     from ..sbe_decoder.sbe_decoder_cpp import (
         SBEDecoder, 
+        DecodeStatus,
+        StreamReceiver,
+        IngestPipeline,
+        JournalReplay,
+        TickStoreWriter,
+        EventLogReader,
+        MetricsServer,
+        ClockSync,
+        ShardLeaseManager,
         TRADES_STREAM_EVENT, 
         BEST_BID_ASK_STREAM_EVENT, 
+        DEPTH_SNAPSHOT_STREAM_EVENT,
         DEPTH_DIFF_STREAM_EVENT,
         EXPECTED_SCHEMA_ID,
-        EXPECTED_SCHEMA_VERSION
+        EXPECTED_SCHEMA_VERSION,
+        ingest_clock_us,
+        memory_stats,
     )
     SBE_DECODER_AVAILABLE = True
 except ImportError:
@@ -31,6 +45,20 @@ except ImportError:
 logger = logging.getLogger(__name__)
 
 
+def _isolated_cpus() -> set:
+    """Cores the kernel was booted to keep free (isolcpus), from sysfs."""
+    try:
+        with open("/sys/devices/system/cpu/isolated") as f:
+            spec = f.read().strip()
+    except OSError:
+        return set()
+    cpus = set()
+    for part in filter(None, spec.split(",")):
+        first, _, last = part.partition("-")
+        cpus.update(range(int(first), int(last or first) + 1))
+    return cpus
+
+
 class SBEMessageType(Enum):
     """SBE message types from Binance."""
     TRADE = "trade"
@@ -70,10 +98,50 @@ class BinanceSBEClient:
         self._reconnect_attempts = 0
         self._max_reconnect_attempts = 10
         self._message_handlers: Dict[SBEMessageType, Callable] = {}
+        self._receiver: Optional[StreamReceiver] = None
+        self._pipeline: Optional[IngestPipeline] = None
+        self._event_log_reader: Optional[EventLogReader] = None
+        # With shard_node_id set, run_pipeline leases this node's symbols
+        # and runs one receiver per group of symbols taken over together
+        self._shard: Optional[ShardLeaseManager] = None
+        self._shard_receivers: List[tuple] = []
         
         # Initialize C++ SBE decoder for high-performance binary parsing
-        self.sbe_decoder = SBEDecoder()
+        # Results come back in the published schema: msg_type named by stream,
+        # integer ms timestamps and depth levels as exact [price, qty] strings
+        self.sbe_decoder = SBEDecoder(
+            debug=config.decoder_debug,
+            decimal_strings=True,
+            stream_msg_types=True,
+            alloc_accounting=config.decoder_alloc_accounting,
+            perf_sample_every=config.decoder_perf_sample_every,
+            trace=config.decoder_trace,
+        )
+        # Raw frames for troubleshooting, in place of logging each one
+        self.sbe_decoder.capture_frames(
+            recent=config.frame_capture_recent,
+            sample_every=config.frame_capture_sample_every,
+            failed=config.frame_capture_failed,
+        )
         logger.info(f"Initialized C++ SBE decoder (schema {EXPECTED_SCHEMA_ID}:{EXPECTED_SCHEMA_VERSION})")
+
+        # Native counters are scraped from the exporter's own thread, so a
+        # scrape never waits on the event loop or the GIL
+        self._metrics_server: Optional[MetricsServer] = None
+        if config.native_metrics_port:
+            self._metrics_server = MetricsServer(host=config.native_metrics_host, port=config.native_metrics_port)
+            self._metrics_server.start()
+            logger.info(f"Serving native metrics on {config.native_metrics_host}:{self._metrics_server.port}/metrics")
+
+        # Measures the exchange clock's offset, which native latency
+        # histograms and trace event stamps are corrected by
+        self._clock_sync: Optional[ClockSync] = None
+        if config.clock_sync_seconds > 0:
+            self._clock_sync = ClockSync(host=config.clock_sync_host, api_key=config.api_key or "",
+                                         interval=config.clock_sync_seconds)
+            self._clock_sync.start()
+            logger.info(f"Syncing the exchange clock against {config.clock_sync_host} "
+                        f"every {config.clock_sync_seconds}s")
         
         # Statistics
         self.stats = {
@@ -85,6 +153,13 @@ class BinanceSBEClient:
             'sbe_mode': True
         }
     
+    _template_to_type = {
+        TRADES_STREAM_EVENT: SBEMessageType.TRADE,
+        BEST_BID_ASK_STREAM_EVENT: SBEMessageType.BEST_BID_ASK,
+        DEPTH_SNAPSHOT_STREAM_EVENT: SBEMessageType.PARTIAL_DEPTH,
+        DEPTH_DIFF_STREAM_EVENT: SBEMessageType.DEPTH,
+    }
+
     def register_handler(self, message_type: SBEMessageType, handler: Callable):
         """Register a handler for specific message types."""
         self._message_handlers[message_type] = handler
@@ -132,6 +207,12 @@ class BinanceSBEClient:
     async def disconnect(self):
         """Close WebSocket connection."""
         self._running = False
+        if self._pipeline:
+            # Releases receive threads waiting on a full block-policy lane
+            await asyncio.get_running_loop().run_in_executor(None, self._pipeline.stop)
+        if self._receiver:
+            await asyncio.get_running_loop().run_in_executor(None, self._receiver.stop)
+            self._receiver = None
         if self.websocket:
             await self.websocket.close()
             self.websocket = None
@@ -156,15 +237,403 @@ class BinanceSBEClient:
                 logger.error(f"Error in message stream: {e}")
                 await self._handle_connection_error()
     
+    async def stream_batches(self, poll_timeout: float = 0.5, raw: bool = False,
+                             max_records: int = 65536) -> AsyncIterator[Dict[str, Any]]:
+        """
+        Stream columnar batches from the native receiver.
+
+        The C++ receiver owns the connection (TLS, subscription, ping/pong,
+        reconnect) and decodes on its own thread into a lock-free ring; each
+        item is a decode_batch-style dict of up to max_records drained
+        records, plus per-frame frame_ingest_ts_us. Ring overflow shows up
+        as receiver dropped_frames in get_stats(). With capture_journal_dir
+        set, every raw frame is also journaled to disk by the receive threads,
+        and with event_log_dir set the decoded records are published to
+        shared-memory event logs for event_log_batches consumers. With
+        conflate_bba_seconds or conflate_depth_seconds set, those streams
+        arrive once per interval per symbol (latest quote, or a partialDepth
+        snapshot of the book) with a row in the batch's conflation table.
+
+        The loop does not poll: once the rings are empty it arms the
+        receiver's eventfd (registered with loop.add_reader) and sleeps until
+        a receive thread signals, then drains everything staged since in
+        bulk, so a burst of frames costs one wake-up. receiver_batch_records
+        and receiver_batch_delay_us trade latency for fewer, larger batches:
+        a batch is handed off once that many records are staged or the
+        oldest has waited that long, and receiver_batch_adaptive lets the
+        record target follow the flow. The loop never blocks on a filling
+        batch: it sleeps on the eventfd until the next arrival or the
+        batch's deadline (receiver.pending_wait), whichever comes first.
+        """
+        self._receiver = self._create_receiver(raw)
+        self._receiver.start()
+        self._running = True
+        logger.info(f"Started native SBE receiver on {urlparse(self.config.sbe_base_url).hostname} with "
+                    f"{len(self._receiver.paths)} connection(s)")
+
+        receiver = self._receiver
+        loop = asyncio.get_running_loop()
+        ready = asyncio.Event()
+
+        def on_ready():
+            receiver.clear_notify()
+            ready.set()
+
+        loop.add_reader(receiver.notify_fd, on_ready)
+        try:
+            while self._running and self._receiver:
+                batch = receiver.drain(max_records, 0.0)
+                if batch is None:
+                    ready.clear()
+                    if receiver.arm_notify():
+                        # Timed, so a stop request is still noticed without traffic and a
+                        # filling micro-batch is handed off at its deadline
+                        try:
+                            await asyncio.wait_for(ready.wait(), receiver.pending_wait or poll_timeout)
+                        except asyncio.TimeoutError:
+                            pass
+                    continue
+                self.stats['messages_received'] += len(batch['frame_ingest_ts_us'])
+                self.stats['decode_errors'] += len(batch['errors'])
+                self.stats['last_message_time'] = time.time()
+                yield batch
+        finally:
+            loop.remove_reader(receiver.notify_fd)
+
+    async def run_pipeline(self, publishers: Dict[str, Any], books: Optional[Any] = None,
+                           stop_timeout: float = 5.0, poll_interval: float = 1.0):
+        """
+        Publish the streams through a native IngestPipeline until disconnect().
+
+        Receive threads hand every frame to the pipeline, which decodes,
+        optionally applies depth to `books` (an SBEDecoderPool), and
+        publishes through `publishers` (lane -> started native
+        KinesisProducer, or a list of them to fan the lane out to each),
+        each stage behind a bounded queue with the lane's pipeline_policies
+        overflow policy and laid out per pipeline_stages. Nothing passes
+        through the event loop, so a slow stream fills its own queues
+        instead of memory; queue depths, drop counts and per-stage latency
+        show up under 'pipeline' in get_stats().
+
+        With shard_node_id set, this node only ingests the symbols it holds
+        leases for (see _start_shard); the others are left to the other
+        nodes sharing shard_redis_url, and symbols start, stop and move
+        between nodes as nodes join and leave.
+        """
+        pipeline = IngestPipeline(policies=self.config.pipeline_policies,
+                                  capacity=self.config.pipeline_queue_capacity,
+                                  stages=self.config.pipeline_stages)
+        for lane, producers in publishers.items():
+            for producer in producers if isinstance(producers, (list, tuple)) else [producers]:
+                pipeline.attach_publisher(lane, producer)
+        if books is not None:
+            pipeline.attach_books(books)
+        receiver = None
+        if self.config.shard_node_id:
+            pipeline.start()
+            self._start_shard(books)
+            logger.info(f"Started native SBE pipeline as shard node '{self.config.shard_node_id}', "
+                        f"publishing {sorted(publishers)}")
+        else:
+            receiver = self._create_receiver(raw=False)
+            receiver.attach_pipeline(pipeline)
+            pipeline.start()
+            receiver.start()
+            self._receiver = receiver
+            logger.info(f"Started native SBE pipeline with {len(receiver.paths)} connection(s), "
+                        f"publishing {sorted(publishers)}")
+        self._pipeline = pipeline
+        self._running = True
+
+        loop = asyncio.get_running_loop()
+        try:
+            while self._running:
+                if self._shard:
+                    # Wakes as soon as the lease manager has symbols to start, hand off or stop
+                    if await loop.run_in_executor(None, self._shard.wait_changes, poll_interval):
+                        await self._apply_shard_changes(self._shard.take_changes(), pipeline, books)
+                else:
+                    await asyncio.sleep(poll_interval)
+                frames = sum(pipeline.stats[lane]['frames'] for lane in ('trade', 'bestBidAsk', 'depth'))
+                if frames != self.stats['messages_received']:
+                    self.stats['messages_received'] = frames
+                    self.stats['last_message_time'] = time.time()
+        finally:
+            # The pipeline first: a receive thread waiting on a full
+            # block-policy lane is only released once it stops
+            await loop.run_in_executor(None, pipeline.stop, stop_timeout)
+            if receiver:
+                await loop.run_in_executor(None, receiver.stop)
+            if self._shard:
+                await self._stop_shard(books)
+
+    def _start_shard(self, books: Optional[Any]):
+        """
+        Start leasing this node's share of the symbols.
+
+        A native ShardLeaseManager renews the leases in Redis on its own
+        thread and reports symbols to start, hand off and stop, which
+        _apply_shard_changes acts on. With shard_checkpoint_dir (shared by
+        the nodes) and `books`, each node also checkpoints its books there
+        every shard_checkpoint_seconds, so the node taking over a symbol,
+        whether handed off or after a failover, starts from its last book
+        instead of a REST snapshot.
+        """
+        url = urlparse(self.config.shard_redis_url)
+        self._shard = ShardLeaseManager(
+            node_id=self.config.shard_node_id,
+            symbols=self.config.symbols,
+            host=url.hostname or "localhost",
+            port=url.port or 6379,
+            password=url.password or "",
+            db=int(url.path.lstrip("/") or 0),
+            key_prefix=self.config.shard_key_prefix,
+            vnodes=self.config.shard_vnodes,
+            lease=self.config.shard_lease_seconds,
+            interval=self.config.shard_renew_seconds,
+            stop_budget=self.config.shard_stop_seconds,
+            timeout=self.config.shard_redis_timeout_seconds,
+        )
+        if books is not None and self.config.shard_checkpoint_dir:
+            os.makedirs(self.config.shard_checkpoint_dir, exist_ok=True)
+            books.start_checkpoints(self._shard_checkpoint_path(), self.config.shard_checkpoint_seconds)
+        self._shard.start()
+        logger.info(f"Leasing symbols as node '{self.config.shard_node_id}' through "
+                    f"{url.hostname}:{url.port or 6379}")
+
+    async def _stop_shard(self, books: Optional[Any]):
+        """Stop the shard's receivers, checkpoint the books, then release every lease."""
+        loop = asyncio.get_running_loop()
+        for _, receiver in self._shard_receivers:
+            await loop.run_in_executor(None, receiver.stop)
+        self._shard_receivers = []
+        if books is not None and self.config.shard_checkpoint_dir:
+            # Saves once more on the way out
+            await loop.run_in_executor(None, books.stop_checkpoints)
+        await loop.run_in_executor(None, self._shard.stop, True)
+        self._shard = None
+
+    async def _apply_shard_changes(self, changes: Dict[str, Any], pipeline: IngestPipeline, books: Optional[Any]):
+        """
+        Act on the lease manager's changes, in an order that never has two
+        nodes streaming a symbol.
+
+        Lost symbols may already be leased to another node, so they stop
+        first. Releasing symbols stop, their books are checkpointed, and
+        only then are their leases released, so the next owner restores
+        them from the checkpoint. Acquired symbols have their books restored
+        from the nodes' checkpoints before their receiver starts; the first
+        diff then either continues the restored book or resyncs it from a
+        snapshot. The stream gap of each handoff (release to takeover) goes
+        to the log for backfill.
+        """
+        loop = asyncio.get_running_loop()
+        lost = set(changes['lost'])
+        releasing = set(changes['releasing'])
+        if lost:
+            logger.warning(f"Lost the leases of {sorted(lost)}; stopping their streams")
+        if lost or releasing:
+            await self._drop_shard_symbols(lost, releasing, pipeline)
+        if releasing:
+            if books is not None and self.config.shard_checkpoint_dir:
+                await loop.run_in_executor(None, books.save_checkpoint, self._shard_checkpoint_path())
+            self._shard.release(sorted(releasing))
+            logger.info(f"Handing off {len(releasing)} symbol(s): {sorted(releasing)}")
+
+        acquired = [entry['symbol'] for entry in changes['acquired']]
+        if not acquired:
+            return
+        if books is not None and self.config.shard_checkpoint_dir:
+            await loop.run_in_executor(None, self._restore_shard_books, books, acquired)
+        receiver = self._create_receiver(raw=False, symbols=acquired)
+        receiver.attach_pipeline(pipeline)
+        receiver.start()
+        self._shard_receivers.append((set(acquired), receiver))
+        for entry in changes['acquired']:
+            if entry['released_ms']:
+                logger.info(f"Took over {entry['symbol']}: "
+                            f"{entry['acquired_ms'] - entry['released_ms']} ms since its release")
+            else:
+                logger.info(f"Took over {entry['symbol']} from a free or expired lease")
+
+    async def _drop_shard_symbols(self, lost: set, releasing: set, pipeline: IngestPipeline):
+        """
+        Stop the receivers carrying `lost` or `releasing` symbols, moving
+        their other symbols to a new receiver. With only releasing symbols
+        involved the new receiver is connected before the old one stops,
+        so the symbols staying here see no gap, only a few duplicates.
+        """
+        loop = asyncio.get_running_loop()
+        dropped = lost | releasing
+        kept = []
+        for symbols, receiver in self._shard_receivers:
+            if not symbols & dropped:
+                kept.append((symbols, receiver))
+                continue
+            remainder = symbols - dropped
+            if symbols & lost:
+                await loop.run_in_executor(None, receiver.stop)
+            if remainder:
+                replacement = self._create_receiver(raw=False, symbols=sorted(remainder))
+                replacement.attach_pipeline(pipeline)
+                replacement.start()
+                kept.append((remainder, replacement))
+                if not symbols & lost:
+                    await self._wait_connected(replacement, self.config.shard_lease_seconds)
+            if not symbols & lost:
+                await loop.run_in_executor(None, receiver.stop)
+        self._shard_receivers = kept
+
+    async def _wait_connected(self, receiver: StreamReceiver, timeout: float):
+        """Wait until every connection of `receiver` is up, or `timeout` seconds."""
+        deadline = time.monotonic() + timeout
+        while not receiver.stats['connected'] and time.monotonic() < deadline:
+            await asyncio.sleep(0.05)
+
+    def _restore_shard_books(self, books: Any, symbols: List[str]):
+        """Restore `symbols`' books from every node's checkpoint; the newest of each wins."""
+        for path in sorted(glob.glob(os.path.join(self.config.shard_checkpoint_dir, "*.book"))):
+            try:
+                books.restore_checkpoint(path, symbols)
+            except ValueError as e:
+                logger.warning(f"Skipping book checkpoint {path}: {e}")
+
+    def _shard_checkpoint_path(self) -> str:
+        return os.path.join(self.config.shard_checkpoint_dir, f"{self.config.shard_node_id}.book")
+
+    def _create_receiver(self, raw: bool, symbols: Optional[List[str]] = None) -> StreamReceiver:
+        """A StreamReceiver for the configured endpoint and streams (of `symbols` if given)."""
+        url = urlparse(self.config.sbe_base_url)
+        receiver = StreamReceiver(
+            symbols=self.config.symbols if symbols is None else symbols,
+            api_key=self.config.api_key or "",
+            host=url.hostname or "stream-sbe.binance.com",
+            port=url.port or 9443,
+            use_tls=url.scheme != "ws",
+            raw=raw,
+            ping_interval=float(self.config.heartbeat_interval_seconds or 20),
+            connections=self.config.receiver_connections,
+            cpu_affinity=self.config.receiver_cpu_affinity,
+            journal_dir=self.config.capture_journal_dir,
+            journal_file_size=self.config.capture_journal_file_mb << 20,
+            journal_roll_interval=float(self.config.capture_journal_roll_seconds),
+            wait=self.config.receiver_wait,
+            spin_us=self.config.receiver_spin_us,
+            busy_poll_us=self.config.receiver_busy_poll_us,
+            io_uring=self.config.receiver_io_uring,
+            event_log_dir=self.config.event_log_dir,
+            event_log_capacity=self.config.event_log_capacity,
+            conflate_bba_interval=self.config.conflate_bba_seconds,
+            conflate_depth_interval=self.config.conflate_depth_seconds,
+            conflate_depth_levels=self.config.conflate_depth_levels,
+            feed_lines=self.config.receiver_feed_lines,
+            feed_hosts=self.config.receiver_feed_hosts,
+            huge_pages=self.config.receiver_huge_pages,
+            numa_local=self.config.receiver_numa_local,
+            batch_max_records=self.config.receiver_batch_records,
+            batch_max_delay=self.config.receiver_batch_delay_us / 1e6,
+            batch_adaptive=self.config.receiver_batch_adaptive,
+            executor_threads=self.config.receiver_executor_threads,
+            executor_cpu_affinity=self.config.receiver_executor_cpu_affinity,
+        )
+        if self.config.receiver_numa_local and not self.config.receiver_cpu_affinity:
+            logger.warning("receiver_numa_local has no effect without receiver_cpu_affinity")
+        if self.config.receiver_wait != "block":
+            # A spinning thread on a shared core competes with everything else scheduled there
+            shared = set(self.config.receiver_cpu_affinity) - _isolated_cpus()
+            if not self.config.receiver_cpu_affinity or shared:
+                logger.warning(f"Receiver wait '{self.config.receiver_wait}' on cores that are not isolated: "
+                               f"{sorted(shared) or 'unpinned'}")
+        return receiver
+
+    async def replay_batches(self, paths: List[str], speed: float = 1.0, poll_timeout: float = 0.5,
+                             raw: bool = False, max_records: int = 65536,
+                             order: str = "received") -> AsyncIterator[Dict[str, Any]]:
+        """
+        Replay capture journals as stream_batches-style columnar batches.
+
+        paths are journal files or capture directories; records from all of
+        them are merged by receive time, or with order="event" message by
+        message by exchange event time (trades before the book updates at
+        the same time), which gives backtests the same order on every run.
+        speed 1 keeps the recorded pacing, N replays N times faster and 0 as
+        fast as batches are consumed. frame_ingest_ts_us carries the
+        recorded receive times.
+        """
+        replay = JournalReplay(paths, speed=speed, raw=raw, order=order)
+        replay.start()
+        logger.info(f"Replaying {replay.files} journal file(s) in {order} order at speed {speed or 'max'}")
+
+        loop = asyncio.get_running_loop()
+        try:
+            while not replay.done:
+                batch = await loop.run_in_executor(None, replay.drain, max_records, poll_timeout)
+                if batch is None:
+                    continue
+                self.stats['messages_received'] += len(batch['frame_ingest_ts_us'])
+                self.stats['decode_errors'] += len(batch['errors'])
+                yield batch
+        finally:
+            replay.stop()
+
+    async def write_tick_store(self, paths: List[str], root: str, block_rows: int = 65536,
+                               compression: str = "zstd") -> Dict[str, Any]:
+        """
+        Convert capture journals into the columnar tick store under root.
+
+        paths are journal files or capture directories; records from all of
+        them are merged by receive time and land in one file per stream,
+        symbol and UTC day ({root}/{stream}/{symbol}/{YYYY-MM-DD}.tick),
+        appending to files an earlier run wrote. Training reads them back
+        with TickFile, without SQL in between. Returns the writer stats
+        plus the paths written.
+        """
+        writer = TickStoreWriter(root, block_rows=block_rows, compression=compression)
+        loop = asyncio.get_running_loop()
+        try:
+            records = await loop.run_in_executor(None, writer.append_journals, paths)
+        finally:
+            writer.close()
+        stats = writer.stats
+        logger.info(f"Wrote {stats['rows']} rows from {records} journal records to {len(writer.paths)} tick file(s)")
+        return {**stats, 'records': records, 'paths': writer.paths}
+
+    async def event_log_batches(self, paths: List[str], poll_timeout: float = 0.5, raw: bool = False,
+                                start: str = "latest", max_records: int = 65536) -> AsyncIterator[Dict[str, Any]]:
+        """
+        Follow another process's receiver through its shared-memory event logs.
+
+        paths are the receiver's StreamReceiver.event_logs (event-*.log under
+        event_log_dir). Batches match stream_batches; the receiver never
+        waits for us, so records overwritten before they are read are
+        counted as lost_records in get_stats() instead.
+        """
+        reader = EventLogReader(paths, raw=raw, start=start)
+        self._event_log_reader = reader
+        self._running = True
+        logger.info(f"Following {len(paths)} event log(s) from the {start} record")
+
+        loop = asyncio.get_running_loop()
+        while self._running:
+            batch = await loop.run_in_executor(None, reader.drain, max_records, poll_timeout)
+            if batch is None:
+                continue
+            self.stats['messages_received'] += len(batch['frame_ingest_ts_us'])
+            self.stats['decode_errors'] += len(batch['errors'])
+            self.stats['last_message_time'] = time.time()
+            yield batch
+
     async def _message_stream(self) -> AsyncIterator[Optional[SBEMessage]]:
         """Internal message streaming loop."""
         try:
             async for raw_message in self.websocket:
+                # Stamp at receive so ingest_ts excludes our own parse time
+                received_us = ingest_clock_us()
                 self.stats['messages_received'] += 1
                 self.stats['last_message_time'] = time.time()
                 
                 try:
-                    parsed_message = await self._parse_message(raw_message)
+                    parsed_message = await self._parse_message(raw_message, received_us)
                     if parsed_message:
                         self.stats['messages_processed'] += 1
                         
@@ -190,14 +659,14 @@ class BinanceSBEClient:
             logger.error(f"Unexpected error in message stream: {e}")
             raise
     
-    async def _parse_message(self, raw_message) -> Optional[SBEMessage]:
+    async def _parse_message(self, raw_message, received_us: Optional[int] = None) -> Optional[SBEMessage]:
         """
         Parse incoming SBE binary message using C++ decoder for maximum performance.
         """
         try:
             if isinstance(raw_message, bytes):
                 # Handle binary SBE messages with C++ decoder
-                return await self._decode_sbe_binary(raw_message)
+                return await self._decode_sbe_binary(raw_message, received_us)
             else:
                 logger.warning(f"Received non-binary message on SBE connection: {type(raw_message)}")
                 return None
@@ -207,7 +676,8 @@ class BinanceSBEClient:
             return None
     
     
-    async def _decode_sbe_binary(self, raw_message: bytes) -> Optional[SBEMessage]:
+    async def _decode_sbe_binary(self, raw_message: bytes,
+                                 received_us: Optional[int] = None) -> Optional[SBEMessage]:
         """
         Decode SBE binary message using high-performance C++ decoder.
         """
@@ -216,141 +686,39 @@ class BinanceSBEClient:
                 logger.error("SBE decoder not available")
                 return None
             
-            # Debug: Check the actual schema version and message content
-            header = None
-            if len(raw_message) >= 8:  # Minimum size for SBE header
-                import struct
-                header = struct.unpack('<HHHH', raw_message[:8])  # little-endian: blockLength, templateId, schemaId, version
-                logger.info(
-                    f"🔍 SBE Header - blockLength: {header[0]}, templateId: {header[1]}, schemaId: {header[2]}, version: {header[3]}"
-                )
-                logger.info(f"🔍 Message size: {len(raw_message)} bytes")
-                logger.info(f"🔍 Raw bytes (first 32): {raw_message[:32].hex()}")
-            
-            # Validate message format first
-            if not self.sbe_decoder.is_valid_message(raw_message):
-                logger.warning(
-                    f"Invalid SBE message format or schema version. Expected schema {EXPECTED_SCHEMA_ID}:{EXPECTED_SCHEMA_VERSION}"
-                )
-                if header:
-                    logger.warning(
-                        f"Received: schemaId={header[2]}, version={header[3]}, templateId={header[1]}"
+            # One native call validates the header, dispatches on the
+            # template and decodes; failures come back as a DecodeStatus
+            decoded = self.sbe_decoder.try_decode(raw_message, ingest_ts_us=received_us)
+            if not isinstance(decoded, dict):
+                if decoded == DecodeStatus.UNKNOWN_TEMPLATE:
+                    logger.debug(
+                        f"Skipping SBE template {self.sbe_decoder.get_message_type(raw_message)} (no decoder)"
                     )
                 else:
-                    logger.warning("Received message too short to inspect header")
-                return None
-            
-            try:
-                decoded = self.sbe_decoder.decode_message(raw_message)
-            except RuntimeError as e:
-                logger.warning(f"Failed to decode SBE message: {e}")
+                    logger.warning(
+                        f"Failed to decode SBE message ({decoded.name}, {len(raw_message)} bytes). "
+                        f"Expected schema {EXPECTED_SCHEMA_ID}:{EXPECTED_SCHEMA_VERSION}"
+                    )
                 return None
 
-            msg_type = decoded.get('msg_type')
-            type_map = {
-                'trade': SBEMessageType.TRADE,
-                'bestBidAsk': SBEMessageType.BEST_BID_ASK,
-                'bookTicker': SBEMessageType.BEST_BID_ASK,
-                'depth': SBEMessageType.DEPTH,
-                'depthDiff': SBEMessageType.DEPTH,
-                'depth@100ms': SBEMessageType.PARTIAL_DEPTH,
-            }
-
-            message_type = type_map.get(msg_type)
-            if not message_type and header:
-                template_id = header[1]
-                template_to_type = {
-                    10000: SBEMessageType.TRADE,
-                    10001: SBEMessageType.BEST_BID_ASK,
-                    10002: SBEMessageType.DEPTH,
-                    10003: SBEMessageType.DEPTH,
-                }
-                message_type = template_to_type.get(template_id)
-                if not message_type:
-                    logger.info(f"📋 Discovered new template ID: {template_id} - add to mapping if needed")
-                    message_type = SBEMessageType.TRADE
+            template_id = decoded['template_id']
+            message_type = self._template_to_type.get(template_id)
             if not message_type:
-                message_type = SBEMessageType.TRADE
-
-            normalized_data = self._normalize_decoded_data(decoded, message_type)
+                logger.info(f"📋 Discovered new template ID: {template_id} - add to mapping if needed")
+                return None
 
             return SBEMessage(
                 message_type=message_type,
-                symbol=normalized_data.get('symbol', 'BTCUSDT'),
-                event_time=normalized_data.get('event_ts', int(time.time() * 1000)),
-                data=normalized_data,
-                raw_message=f"SBE template={header[1] if header else 'unknown'} size={len(raw_message)}"
+                symbol=decoded.get('symbol', 'BTCUSDT'),
+                event_time=decoded.get('event_ts', int(time.time() * 1000)),
+                data=decoded,
+                raw_message=f"SBE template={template_id} size={len(raw_message)}"
             )
 
         except Exception as e:
             logger.error(f"SBE binary decoding failed: {e}")
             return None
 
-    def _normalize_decoded_data(self, decoded: Dict[str, Any], message_type: SBEMessageType) -> Dict[str, Any]:
-        """Normalize decoder output to match internal expectations."""
-        normalized = {**decoded}
-
-        # Ensure consistent source and msg_type casing
-        normalized['source'] = 'sbe'
-        normalized['msg_type'] = message_type.value
-
-        # Normalize symbol casing if present
-        symbol = normalized.get('symbol')
-        if isinstance(symbol, str):
-            normalized['symbol'] = symbol.upper()
-
-        # Force millisecond timestamps
-        for ts_field in ('event_ts', 'ingest_ts'):
-            if ts_field in normalized and normalized[ts_field] is not None:
-                normalized[ts_field] = int(normalized[ts_field])
-
-        if message_type == SBEMessageType.DEPTH:
-            normalized['bids'] = self._convert_depth_levels(normalized.get('bids'))
-            normalized['asks'] = self._convert_depth_levels(normalized.get('asks'))
-        
-        return normalized
-
-    def _convert_depth_levels(self, levels: Optional[Any]) -> list:
-        """Convert depth levels to [[price, qty], ...] string pairs."""
-        if not levels:
-            return []
-
-        normalized_levels = []
-        for level in levels:
-            price = None
-            qty = None
-
-            if isinstance(level, dict):
-                price = level.get('price')
-                qty = level.get('qty')
-            elif isinstance(level, (list, tuple)) and len(level) >= 2:
-                price, qty = level[0], level[1]
-
-            if price is None or qty is None:
-                continue
-
-            normalized_levels.append([
-                self._format_numeric(price),
-                self._format_numeric(qty)
-            ])
-
-        return normalized_levels
-
-    def _format_numeric(self, value: Any) -> str:
-        """Format numeric values as decimal strings for Avro payloads."""
-        if value is None:
-            return "0"
-
-        if isinstance(value, bool):
-            return "1" if value else "0"
-
-        if isinstance(value, (int, float)):
-            # Use fixed decimal format to avoid scientific notation
-            # 8 decimal places is sufficient for crypto prices and quantities
-            return f"{float(value):.8f}".rstrip('0').rstrip('.')
-
-        return str(value)
-
     def _build_stream_list(self) -> str:
         """Build stream list for SBE WebSocket subscription."""
         streams = []
@@ -400,6 +768,45 @@ class BinanceSBEClient:
         if self.stats['last_message_time']:
             last_message_age = current_time - self.stats['last_message_time']
         
+        if self._shard:
+            receivers = [receiver.stats for _, receiver in self._shard_receivers]
+            stats = {
+                **self.stats,
+                'last_message_age_seconds': last_message_age,
+                'is_connected': all(receiver['connected'] for receiver in receivers),
+                'reconnect_attempts': sum(receiver['disconnects'] for receiver in receivers),
+                'receivers': receivers,
+                'shard': self._shard.stats,
+                'memory': memory_stats(),
+            }
+            if self._pipeline:
+                stats['pipeline'] = self._pipeline.stats
+            return stats
+
+        if self._receiver:
+            stats = {
+                **self.stats,
+                'last_message_age_seconds': last_message_age,
+                'is_connected': self._receiver.stats['connected'],
+                'reconnect_attempts': self._receiver.stats['disconnects'],
+                'receiver': self._receiver.stats,
+                # Live and reserved bytes of the native rings, journals,
+                # books and dedup tables, by component and symbol
+                'memory': memory_stats(),
+            }
+            if self._pipeline:
+                stats['pipeline'] = self._pipeline.stats
+            if self._clock_sync:
+                stats['clock'] = self._clock_sync.stats
+            return stats
+
+        if self._event_log_reader:
+            return {
+                **self.stats,
+                'last_message_age_seconds': last_message_age,
+                'event_logs': self._event_log_reader.stats,
+            }
+
         return {
             **self.stats,
             'last_message_age_seconds': last_message_age,
@@ -407,8 +814,12 @@ class BinanceSBEClient:
             'reconnect_attempts': self._reconnect_attempts
         }
     
-    async def health_check(self) -> Dict[str, Any]:
-        """Perform health check on the WebSocket connection."""
+    async def health_check(self, dump_frames: bool = False) -> Dict[str, Any]:
+        """Perform health check on the WebSocket connection.
+
+        dump_frames adds the decoder's captured raw frames (recent, sampled
+        and failed) under 'frames'.
+        """
         stats = self.get_stats()
         
         health_status = {
@@ -433,8 +844,11 @@ class BinanceSBEClient:
                 health_status['healthy'] = False
                 health_status['issues'].append(f"High error rate: {error_rate:.2%}")
         
-        return {
+        result = {
             'status': 'healthy' if health_status['healthy'] else 'unhealthy',
             'issues': health_status['issues'],
             'stats': stats
         }
+        if dump_frames:
+            result['frames'] = self.sbe_decoder.captured_frames()
+        return result
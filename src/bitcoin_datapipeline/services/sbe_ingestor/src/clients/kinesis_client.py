@@ -5,26 +5,56 @@ import logging
 import time
 import json
 import hashlib
-from typing import Dict, Any, List, Optional
+from typing import Dict, Any, List, Optional, Sequence, Union
 from dataclasses import dataclass, asdict
 from collections import defaultdict, deque
+from urllib.parse import urlparse
 
 import aioboto3
+import boto3
 from botocore.exceptions import ClientError
 
 from ..config.aws_config import AWSClientManager
 from ..config.settings import AWSConfig
 from ..utils.retry import retry_with_backoff, CircuitBreaker
 
+# KPL record aggregation and record compression from the SBE decoder
+# extension, when it is installed; otherwise every payload is its own
+# uncompressed Kinesis record
+try:
+    from sbe_decoder_cpp import KPL_DEFAULT_MAX_BYTES, KplAggregator, RecordCompressor
+    KPL_AGGREGATION_AVAILABLE = True
+except ImportError:
+    KPL_DEFAULT_MAX_BYTES = 0
+    KPL_AGGREGATION_AVAILABLE = False
+
+# Native PutRecords transport (signing, batching and retries off the GIL)
+try:
+    from sbe_decoder_cpp import KinesisProducer as NativeKinesisProducer
+    NATIVE_TRANSPORT_AVAILABLE = True
+except ImportError:
+    NATIVE_TRANSPORT_AVAILABLE = False
+
+# Spreading a hot symbol over several shards, numbered so the aggregator
+# can merge it back in order
+try:
+    from sbe_decoder_cpp import HotPartitioner
+    HOT_PARTITIONING_AVAILABLE = True
+except ImportError:
+    HOT_PARTITIONING_AVAILABLE = False
+
 logger = logging.getLogger(__name__)
 
+# PutRecords takes at most 5 MiB per call
+PUT_RECORDS_MAX_BYTES = 5 * 1024 * 1024
+
 
 @dataclass
 class KinesisRecord:
     """Kinesis record wrapper."""
     stream_name: str
     partition_key: str
-    data: bytes
+    data: Union[bytes, memoryview]
     explicit_hash_key: Optional[str] = None
     timestamp: Optional[float] = None
 
@@ -45,9 +75,16 @@ class KinesisProducer:
     
     Features:
     - Automatic batching with configurable size and time limits
+    - KPL aggregation of small payloads into shared Kinesis records
     - Per-stream partition key distribution
     - Retry with exponential backoff
     - Circuit breaker protection
+    - Optional native transport (kinesis_native_transport): the SBE
+      decoder extension's KinesisProducer signs, batches per shard and
+      retries on its own threads over pooled keep-alive connections
+    - Hot-symbol partitioning (kinesis_hot_symbols): each listed symbol is
+      spread over kinesis_hot_symbol_shards shards, its records numbered
+      in the partition key ("BTCUSDT#42") for the aggregator's merge
     - Comprehensive metrics
     """
     
@@ -58,9 +95,39 @@ class KinesisProducer:
         # Batching configuration
         self.batch_size = config.kinesis_batch_size
         self.flush_interval = config.kinesis_flush_interval_seconds
+        # Aggregate up to this many bytes per Kinesis record; 0 disables
+        self.aggregation_max_bytes = (
+            getattr(config, 'kinesis_aggregation_max_bytes', KPL_DEFAULT_MAX_BYTES)
+            if KPL_AGGREGATION_AVAILABLE else 0
+        )
+        # zstd compressor for SBEDecoder.serialize_records, when a trained
+        # dictionary is configured; consumers must hold the same dictionary
+        self.record_compressor = self._load_compressor(getattr(config, 'kinesis_zstd_dictionary_path', None))
+        # Publish through the extension's KinesisProducer instead of boto3:
+        # one per stream, fed each Kinesis record as it is sealed
+        self.native_transport = getattr(config, 'kinesis_native_transport', False)
+        if self.native_transport and not NATIVE_TRANSPORT_AVAILABLE:
+            logger.warning("sbe_decoder_cpp not installed; publishing through boto3")
+            self.native_transport = False
+        self.native_connections = getattr(config, 'kinesis_native_connections', 4)
+        self._native_producers: Dict[str, Any] = {}
+        self._native_session_credentials = None
+        self.hot_symbols = list(getattr(config, 'kinesis_hot_symbols', None) or [])
+        if self.hot_symbols and not HOT_PARTITIONING_AVAILABLE:
+            logger.warning("sbe_decoder_cpp not installed; hot symbols stay on one shard each")
+            self.hot_symbols = []
+        self.hot_symbol_shards = getattr(config, 'kinesis_hot_symbol_shards', 4)
+        self.hot_symbol_run = getattr(config, 'kinesis_hot_symbol_run', 1)
+        # One per stream: each stream numbers its own records
+        self._partitioners: Dict[str, Any] = {}
         
         # Internal state
         self._batches: Dict[str, List[KinesisRecord]] = defaultdict(list)
+        self._batch_bytes: Dict[str, int] = defaultdict(int)
+        # Open aggregates per stream and (partition key, None), or
+        # (None, explicit hash key) for hot-symbol records, sealed into the
+        # batch when full and on every flush (the time budget)
+        self._aggregators: Dict[str, Dict[tuple, Any]] = defaultdict(dict)
         self._batch_stats: Dict[str, BatchStats] = defaultdict(BatchStats)
         self._last_flush_time = time.time()
         self._running = False
@@ -75,11 +142,15 @@ class KinesisProducer:
             'total_bytes': 0,
             'failed_records': 0,
             'batches_sent': 0,
+            'payloads_aggregated': 0,
             'errors': 0,
             'circuit_breaker_opens': 0
         }
         
-        logger.info(f"Initialized KinesisProducer with batch_size={self.batch_size}")
+        logger.info(
+            f"Initialized KinesisProducer with batch_size={self.batch_size}, "
+            f"aggregation_max_bytes={self.aggregation_max_bytes}"
+        )
     
     async def start(self):
         """Start the producer with background flush task."""
@@ -106,12 +177,13 @@ class KinesisProducer:
         
         # Flush any remaining records
         await self._flush_all_batches()
+        await self._stop_native_producers()
         logger.info("KinesisProducer stopped")
     
     async def put_record(
         self,
         stream_name: str,
-        data: Dict[str, Any],
+        data: Union[Dict[str, Any], bytes, memoryview],
         partition_key: Optional[str] = None
     ) -> bool:
         """
@@ -119,7 +191,7 @@ class KinesisProducer:
         
         Args:
             stream_name: Kinesis stream name
-            data: Record data (will be JSON serialized)
+            data: Record data (JSON serialized), or an already serialized payload
             partition_key: Optional partition key (auto-generated if not provided)
         
         Returns:
@@ -130,28 +202,19 @@ class KinesisProducer:
             return False
         
         try:
-            # Serialize data
-            data_bytes = json.dumps(data, separators=(',', ':')).encode('utf-8')
-            
-            # Generate partition key if not provided
-            if not partition_key:
-                partition_key = self._generate_partition_key(data)
-            
-            # Create record
-            record = KinesisRecord(
-                stream_name=stream_name,
-                partition_key=partition_key,
-                data=data_bytes,
-                timestamp=time.time()
-            )
-            
-            # Add to batch
-            self._batches[stream_name].append(record)
-            
-            # Check if we need to flush this stream
-            if len(self._batches[stream_name]) >= self.batch_size:
-                await self._flush_stream(stream_name)
+            # Serialize data unless the decoder already did
+            if isinstance(data, (bytes, bytearray, memoryview)):
+                data_bytes = data
+                if not partition_key:
+                    partition_key = hashlib.md5(data_bytes).hexdigest()[:16]
+            else:
+                data_bytes = json.dumps(data, separators=(',', ':')).encode('utf-8')
+                
+                # Generate partition key if not provided
+                if not partition_key:
+                    partition_key = self._generate_partition_key(data)
             
+            await self._queue_payload(stream_name, partition_key, data_bytes, time.time())
             return True
             
         except Exception as e:
@@ -159,6 +222,135 @@ class KinesisProducer:
             self.stats['errors'] += 1
             return False
     
+    async def put_serialized_records(
+        self,
+        stream_name: str,
+        payload: Union[bytes, bytearray, memoryview],
+        offsets: Sequence[int],
+        partition_keys: Sequence[str]
+    ) -> int:
+        """
+        Queue records serialized by SBEDecoder.serialize_records.
+        
+        Records are memoryview slices of `payload` (offsets holds n + 1
+        boundaries). Without aggregation they are queued as is, so the
+        buffer must not be overwritten until they have been flushed;
+        aggregation copies them.
+        
+        Returns:
+            Number of records queued
+        """
+        if not self._running:
+            logger.warning("Producer not running, dropping records")
+            return 0
+        
+        if self.native_transport and not self.aggregation_max_bytes:
+            # One call, records copied off the GIL
+            producer = await self._native_producer(stream_name)
+            queued = producer.put_records(payload, offsets, partition_keys)
+            self._count_native_rejects(len(partition_keys) - queued)
+            return queued
+        
+        view = memoryview(payload)
+        now = time.time()
+        for i, partition_key in enumerate(partition_keys):
+            await self._queue_payload(
+                stream_name, partition_key, view[int(offsets[i]):int(offsets[i + 1])], now
+            )
+        
+        return len(partition_keys)
+    
+    @staticmethod
+    def _load_compressor(dictionary_path: Optional[str]):
+        """RecordCompressor for the dictionary at `dictionary_path`, if any."""
+        if not dictionary_path:
+            return None
+        if not KPL_AGGREGATION_AVAILABLE:
+            logger.warning("sbe_decoder_cpp not installed; records will not be compressed")
+            return None
+        with open(dictionary_path, 'rb') as f:
+            return RecordCompressor(f.read())
+    
+    async def _queue_payload(
+        self,
+        stream_name: str,
+        partition_key: str,
+        data: Union[bytes, memoryview],
+        timestamp: float
+    ):
+        """Add a payload to its open aggregate, or to the batch directly
+        when aggregation is off."""
+        explicit_hash_key = None
+        partitioner = self._partitioner(stream_name)
+        if partitioner is not None:
+            routed = partitioner.route(partition_key)
+            if routed is not None:
+                partition_key, explicit_hash_key = routed
+        
+        if not self.aggregation_max_bytes:
+            await self._queue_record(KinesisRecord(
+                stream_name=stream_name,
+                partition_key=partition_key,
+                data=data,
+                explicit_hash_key=explicit_hash_key,
+                timestamp=timestamp
+            ))
+            return
+        
+        # A hot symbol's records share their bucket's aggregate, each
+        # sub-record keeping its own numbered key
+        route = (None, explicit_hash_key) if explicit_hash_key else (partition_key, None)
+        aggregators = self._aggregators[stream_name]
+        aggregator = aggregators.get(route)
+        if aggregator is None:
+            aggregator = aggregators[route] = KplAggregator(self.aggregation_max_bytes)
+        if not aggregator.add(partition_key, data):
+            await self._seal_aggregate(stream_name, aggregator, explicit_hash_key)
+            aggregator.add(partition_key, data)
+        self.stats['payloads_aggregated'] += 1
+    
+    async def _seal_aggregate(self, stream_name: str, aggregator: Any, explicit_hash_key: Optional[str] = None):
+        """Queue an aggregate's Kinesis record and reset it."""
+        if not len(aggregator):
+            return
+        partition_key = aggregator.partition_key
+        await self._queue_record(KinesisRecord(
+            stream_name=stream_name,
+            partition_key=partition_key,
+            data=aggregator.finish(),
+            explicit_hash_key=explicit_hash_key,
+            timestamp=time.time()
+        ))
+    
+    def _partitioner(self, stream_name: str):
+        """The stream's HotPartitioner, or None without hot symbols."""
+        if not self.hot_symbols:
+            return None
+        partitioner = self._partitioners.get(stream_name)
+        if partitioner is None:
+            partitioner = self._partitioners[stream_name] = HotPartitioner(
+                self.hot_symbols, buckets=self.hot_symbol_shards, run=self.hot_symbol_run
+            )
+        return partitioner
+    
+    async def _queue_record(self, record: KinesisRecord):
+        """Append a Kinesis record to its stream's batch, flushing first if
+        it would pass the PutRecords byte limit and after if the batch is
+        full."""
+        stream_name = record.stream_name
+        if self.native_transport:
+            producer = await self._native_producer(stream_name)
+            if not producer.put(record.data, record.partition_key, record.explicit_hash_key or ""):
+                self._count_native_rejects(1)
+            return
+        size = len(record.data) + len(record.partition_key)
+        if self._batch_bytes[stream_name] + size > PUT_RECORDS_MAX_BYTES:
+            await self._send_pending(stream_name)
+        self._batches[stream_name].append(record)
+        self._batch_bytes[stream_name] += size
+        if len(self._batches[stream_name]) >= self.batch_size:
+            await self._send_pending(stream_name)
+    
     async def put_trade_record(self, trade_data: Dict[str, Any]) -> bool:
         """Put a trade record to the trade stream."""
         return await self.put_record(
@@ -183,6 +375,17 @@ class KinesisProducer:
             partition_key=depth_data.get('symbol', 'default')
         )
     
+    async def native_publishers(self) -> Dict[str, Any]:
+        """Started native producers of the trade, bestBidAsk and depth
+        streams by pipeline lane, for BinanceSBEClient.run_pipeline."""
+        if not self.native_transport:
+            raise RuntimeError("Native pipeline publishing needs kinesis_native_transport")
+        return {
+            'trade': await self._native_producer(self.config.kinesis_trade_stream),
+            'bestBidAsk': await self._native_producer(self.config.kinesis_bba_stream),
+            'depth': await self._native_producer(self.config.kinesis_depth_stream),
+        }
+    
     async def _flush_loop(self):
         """Background task to flush batches periodically."""
         while self._running:
@@ -199,9 +402,82 @@ class KinesisProducer:
                 logger.error(f"Error in flush loop: {e}")
                 await asyncio.sleep(1)  # Brief pause before retrying
     
+    async def _native_producer(self, stream_name: str):
+        """The stream's native producer, started on first use with the
+        stream's open shards and the session's credentials."""
+        producer = self._native_producers.get(stream_name)
+        if producer is not None:
+            return producer
+        
+        loop = asyncio.get_event_loop()
+        shards = await loop.run_in_executor(None, self._list_open_shards, stream_name)
+        access_key, secret_key, session_token = self._native_credentials()
+        endpoint = urlparse(getattr(self.config, 'localstack_endpoint', None) or '')
+        use_tls = endpoint.scheme != 'http'
+        producer = NativeKinesisProducer(
+            stream_name,
+            self.config.region,
+            access_key,
+            secret_key,
+            session_token,
+            shards=shards,
+            host=endpoint.hostname or '',
+            port=endpoint.port or (443 if use_tls else 80),
+            use_tls=use_tls,
+            connections=self.native_connections,
+            linger=min(self.flush_interval, 0.05),
+            max_batch_records=self.batch_size,
+            partitioner=self._partitioner(stream_name)
+        )
+        producer.start()
+        self._native_producers[stream_name] = producer
+        logger.info(f"Started native Kinesis transport for {stream_name} over {producer.shard_count} shards")
+        return producer
+    
+    def _list_open_shards(self, stream_name: str) -> List[tuple]:
+        """(ShardId, StartingHashKey, EndingHashKey) of the stream's open
+        shards; closed (split or merged) shards have an ending sequence
+        number."""
+        kinesis_client = self.aws_client_manager.kinesis_client
+        shards = []
+        response = kinesis_client.list_shards(StreamName=stream_name)
+        while True:
+            for shard in response['Shards']:
+                if 'EndingSequenceNumber' in shard['SequenceNumberRange']:
+                    continue
+                hash_range = shard['HashKeyRange']
+                shards.append((shard['ShardId'], hash_range['StartingHashKey'], hash_range['EndingHashKey']))
+            if not response.get('NextToken'):
+                return shards
+            response = kinesis_client.list_shards(NextToken=response['NextToken'])
+    
+    def _native_credentials(self) -> tuple:
+        """(access key, secret key, session token) to sign with; LocalStack
+        takes any."""
+        if getattr(self.config, 'localstack_endpoint', None):
+            return 'test', 'test', ''
+        if self._native_session_credentials is None:
+            # Refreshable for instance and task roles
+            self._native_session_credentials = boto3.Session(region_name=self.config.region).get_credentials()
+        frozen = self._native_session_credentials.get_frozen_credentials()
+        return frozen.access_key, frozen.secret_key, frozen.token or ''
+    
+    def _count_native_rejects(self, count: int):
+        if count > 0:
+            logger.warning(f"Native Kinesis queue full, dropping {count} records")
+            self.stats['failed_records'] += count
+    
+    async def _stop_native_producers(self):
+        """Flush and stop the native producers without blocking the loop."""
+        producers = list(self._native_producers.values())
+        self._native_producers.clear()
+        loop = asyncio.get_event_loop()
+        for producer in producers:
+            await loop.run_in_executor(None, producer.stop, float(self.flush_interval) + 5.0)
+    
     async def _flush_all_batches(self):
         """Flush all pending batches."""
-        streams_to_flush = list(self._batches.keys())
+        streams_to_flush = list(self._batches.keys() | self._aggregators.keys())
         
         if streams_to_flush:
             logger.debug(f"Flushing {len(streams_to_flush)} streams")
@@ -215,15 +491,31 @@ class KinesisProducer:
             if flush_tasks:
                 await asyncio.gather(*flush_tasks, return_exceptions=True)
         
+        # Temporary credentials rotate; botocore refreshes them ahead of
+        # expiry and the native producers sign with the current ones
+        if self._native_producers and not getattr(self.config, 'localstack_endpoint', None):
+            credentials = self._native_credentials()
+            for producer in self._native_producers.values():
+                producer.set_credentials(*credentials)
+        
         self._last_flush_time = time.time()
     
     async def _flush_stream(self, stream_name: str):
-        """Flush pending records for a specific stream."""
+        """Seal the stream's open aggregates and flush its pending records."""
+        # Dropped afterwards, so keys that went quiet do not pile up
+        aggregators = self._aggregators.pop(stream_name, {})
+        for (_, explicit_hash_key), aggregator in aggregators.items():
+            await self._seal_aggregate(stream_name, aggregator, explicit_hash_key)
+        await self._send_pending(stream_name)
+    
+    async def _send_pending(self, stream_name: str):
+        """Send the records already in a stream's batch."""
         if stream_name not in self._batches or not self._batches[stream_name]:
             return
         
         records = self._batches[stream_name].copy()
         self._batches[stream_name].clear()
+        self._batch_bytes[stream_name] = 0
         
         if not records:
             return
@@ -263,6 +555,7 @@ class KinesisProducer:
             # Re-queue failed records (with limit to prevent infinite growth)
             if len(self._batches[stream_name]) < 1000:
                 self._batches[stream_name].extend(records)
+                self._batch_bytes[stream_name] += sum(len(r.data) + len(r.partition_key) for r in records)
             else:
                 logger.warning(f"Dropping {len(records)} records due to queue overflow")
             
@@ -356,9 +649,21 @@ class KinesisProducer:
                 stream: len(records)
                 for stream, records in self._batches.items()
             },
+            'open_aggregates': {
+                stream: sum(len(aggregator) for aggregator in aggregators.values())
+                for stream, aggregators in self._aggregators.items()
+            },
             'circuit_breakers': {
                 stream: cb.state
                 for stream, cb in self._circuit_breakers.items()
+            },
+            'native_transport': {
+                stream: producer.stats
+                for stream, producer in self._native_producers.items()
+            },
+            'hot_symbols': {
+                stream: partitioner.routed
+                for stream, partitioner in self._partitioners.items()
             }
         }
     
@@ -2,7 +2,7 @@
 
 import os
 import yaml
-from dataclasses import dataclass
+from dataclasses import dataclass, field
 from typing import List, Dict, Any, Optional
 
 
@@ -16,6 +16,54 @@ class BinanceConfig:
     stream_types: List[str]
     reconnect_interval_seconds: int
     heartbeat_interval_seconds: int
+    decoder_debug: bool = False  # Add debug_* fields to decoded SBE messages
+    decoder_alloc_accounting: bool = False  # Count allocations per decoded frame in the decoder stats
+    decoder_perf_sample_every: int = 0  # Read hardware counters around every Nth decoded frame (0 = off)
+    decoder_trace: bool = False  # Attach latency trace stamps to every decoded message
+    frame_capture_recent: int = 64  # Raw frames kept for the health dump: the last N decoded...
+    frame_capture_sample_every: int = 10000  # ...one in K (0 = none)...
+    frame_capture_failed: int = 64  # ...and the last N that failed to decode
+    receiver_connections: int = 1  # Native receiver sockets (raised to respect the stream cap)
+    receiver_cpu_affinity: List[int] = field(default_factory=list)  # Core per receiver connection
+    receiver_wait: str = "block"  # Receive thread wait: "block", "spin" or "spin_yield"
+    receiver_spin_us: int = 50  # spin_yield: spin this long after each frame before yielding
+    receiver_busy_poll_us: int = 0  # SO_BUSY_POLL on receiver sockets (needs CAP_NET_ADMIN; 0 = off)
+    receiver_io_uring: bool = False  # Receive through io_uring registered buffers (falls back to recv())
+    receiver_feed_lines: int = 1  # Redundant (A/B) connections per stream group, first copy wins
+    receiver_feed_hosts: List[str] = field(default_factory=list)  # "host[:port]" per feed line, cycled
+    receiver_huge_pages: List[str] = field(default_factory=list)  # "ring", "journal", "event_log" on 2 MB pages
+    receiver_numa_local: List[str] = field(default_factory=list)  # Same components, on their pinned core's node
+    receiver_batch_records: int = 1  # Hand records to Python once this many are waiting... (1 = each at once)
+    receiver_batch_delay_us: int = 0  # ...or once the oldest has waited this long
+    receiver_batch_adaptive: bool = False  # Grow the record target under load, shrink it when quiet
+    receiver_executor_threads: int = 0  # Run connections as coroutines on this many threads (0 = a thread each)
+    receiver_executor_cpu_affinity: List[int] = field(default_factory=list)  # Core per executor thread
+    capture_journal_dir: str = ""  # Raw SBE frame journal directory for the native receiver ("" = off)
+    capture_journal_file_mb: int = 256  # Journal files roll at this size...
+    capture_journal_roll_seconds: int = 3600  # ...or after this long
+    event_log_dir: str = ""  # Shared-memory event logs for co-located consumers, e.g. /dev/shm ("" = off)
+    event_log_capacity: int = 1 << 20  # Records per connection's event log
+    conflate_bba_seconds: float = 0.0  # Stage only each symbol's latest bestBidAsk this often (0 = every update)
+    conflate_depth_seconds: float = 0.0  # Stage each symbol's book as a top-N snapshot this often (0 = every diff)
+    conflate_depth_levels: int = 20  # Levels per side of a conflated book
+    pipeline_policies: Dict[str, str] = field(default_factory=dict)  # Lane -> block, drop_oldest or conflate
+    pipeline_queue_capacity: int = 8192  # Items per native pipeline stage queue
+    # Lane -> stage ("decode", "books", "publish") -> {"capacity": items in its input queue, "cpu": pinned core}
+    pipeline_stages: Dict[str, Dict[str, Dict[str, int]]] = field(default_factory=dict)
+    clock_sync_seconds: float = 0.0  # Measure the exchange clock offset over the WebSocket API this often (0 = off)
+    clock_sync_host: str = "ws-api.binance.com"
+    native_metrics_port: int = 0  # Prometheus /metrics for the native decoder/receiver counters (0 = off)
+    native_metrics_host: str = "0.0.0.0"
+    shard_node_id: str = ""  # Share the symbols with other ingest nodes under this id ("" = ingest them all)
+    shard_redis_url: str = "redis://localhost:6379/0"  # Where the symbol leases are held
+    shard_key_prefix: str = "{sbe-shard}:"  # Lease key prefix, the same on every node (hash tag for Redis Cluster)
+    shard_vnodes: int = 128  # Points per node on the consistent-hash ring, the same on every node
+    shard_lease_seconds: float = 10.0  # A dead node's symbols move after this long...
+    shard_renew_seconds: float = 0.5  # ...and leases are renewed, and handoffs noticed, this often
+    shard_stop_seconds: float = 1.0  # Time to stop a lost symbol's streams before another node may take it
+    shard_redis_timeout_seconds: float = 2.0  # Redis connect, send and receive timeout for the lease rounds
+    shard_checkpoint_dir: str = ""  # Directory shared by the nodes for book checkpoints handed over ("" = off)
+    shard_checkpoint_seconds: float = 1.0  # Checkpoint this node's books this often for a failover
 
 
 @dataclass
@@ -50,6 +98,7 @@ class LoggingConfig:
     level: str
     format: str
     handlers: List[str]
+    native_level: str = "WARNING"  # Level of the native components' asynchronous log
 
 
 @dataclass
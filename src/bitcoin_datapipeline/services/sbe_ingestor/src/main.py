@@ -65,8 +65,8 @@ class SBEIngestorService:
         signal.signal(signal.SIGINT, signal_handler)
         signal.signal(signal.SIGTERM, signal_handler)
     
-    async def health_check(self) -> dict:
-        """Perform health check."""
+    async def health_check(self, dump_frames: bool = False) -> dict:
+        """Perform health check; dump_frames adds the decoder's captured raw frames."""
         health_status = {
             "service": "sbe-ingestor",
             "status": "healthy",
@@ -75,7 +75,7 @@ class SBEIngestorService:
         }
         
         if self.stream_processor:
-            processor_health = await self.stream_processor.health_check()
+            processor_health = await self.stream_processor.health_check(dump_frames=dump_frames)
             health_status["components"]["stream_processor"] = processor_health
         
         # Determine overall health
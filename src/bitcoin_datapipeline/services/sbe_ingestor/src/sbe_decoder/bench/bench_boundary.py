@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+pybind11 boundary cost of sbe_decoder_cpp over the benchmark corpora.
+
+For each template's corpus this times, per frame:
+  get_message_type  one call that only exports the buffer and reads the
+                    header -- the fixed cost of crossing into C++
+  decode_message    the dict decoder
+  try_decode        validation + dict decode in one call
+  decode_batch      the columnar path, amortized over the whole corpus
+and reports ns/msg, MB/s and Python blocks/msg (allocated blocks still
+held by the results, i.e. what a decoded message costs the allocator).
+Native decode cost without the boundary is in bench_decoder.cpp.
+
+Usage (after building the extension):
+    python bench_boundary.py [--corpus DIR] [--repeat N]
+"""
+
+import argparse
+import os
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.dirname(HERE))
+
+import sbe_decoder_cpp  # noqa: E402
+
+TEMPLATES = {10000: 'trade', 10001: 'best_bid_ask', 10003: 'depth_diff'}
+
+
+def load_frames(corpus_dir: str):
+    """Corpus frames grouped by template id."""
+    by_template = {}
+    for name in sorted(os.listdir(corpus_dir)):
+        if not name.endswith('.sbej'):
+            continue
+        journal = sbe_decoder_cpp.read_journal(os.path.join(corpus_dir, name))
+        data, offsets = journal['frames'], journal['offsets']
+        for i in range(len(offsets) - 1):
+            frame = data[offsets[i]:offsets[i + 1]]
+            template_id = int.from_bytes(frame[2:4], 'little')
+            by_template.setdefault(template_id, []).append(frame)
+    return by_template
+
+
+def measure(fn, frames, repeat: int):
+    """Best-of-`repeat` ns per frame for fn(frames), plus blocks held per frame."""
+    best = float('inf')
+    for _ in range(repeat):
+        start = time.perf_counter_ns()
+        fn(frames)
+        best = min(best, time.perf_counter_ns() - start)
+    before = sys.getallocatedblocks()
+    held = fn(frames)
+    blocks = (sys.getallocatedblocks() - before) / len(frames)
+    del held
+    return best / len(frames), blocks
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--corpus', default=os.environ.get('SBE_BENCH_CORPUS', os.path.join(HERE, 'corpus')))
+    parser.add_argument('--repeat', type=int, default=20)
+    args = parser.parse_args(argv)
+
+    decoder = sbe_decoder_cpp.SBEDecoder()
+    cases = {
+        'get_message_type': lambda frames: [decoder.get_message_type(f) for f in frames],
+        'decode_message': lambda frames: [decoder.decode_message(f) for f in frames],
+        'try_decode': lambda frames: [decoder.try_decode(f) for f in frames],
+        'decode_batch': lambda frames: decoder.decode_batch(frames),
+    }
+
+    print(f"{'template':<14}{'call':<18}{'ns/msg':>10}{'MB/s':>10}{'blocks/msg':>12}")
+    for template_id, frames in sorted(load_frames(args.corpus).items()):
+        size = sum(len(f) for f in frames) / len(frames)
+        for call, fn in cases.items():
+            ns, blocks = measure(fn, frames, args.repeat)
+            name = TEMPLATES.get(template_id, str(template_id))
+            print(f"{name:<14}{call:<18}{ns:>10.1f}{size * 1e3 / ns:>10.1f}{blocks:>12.2f}")
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
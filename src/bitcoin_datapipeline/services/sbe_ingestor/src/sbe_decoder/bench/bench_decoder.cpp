@@ -0,0 +1,1758 @@
+/*
+ * Microbenchmarks for the native hot paths of sbe_decoder_cpp.
+ *
+ * Every benchmark cycles through the frames of one corpus (capture journals
+ * in bench/corpus, or SBE_BENCH_CORPUS) and processes one frame per
+ * iteration, so the reported time is ns/msg. Each also reports bytes/s,
+ * msgs/s and allocs/msg (global operator new calls inside the timed loop).
+ * The pybind11 boundary is measured separately by bench_boundary.py.
+ *
+ * Build and run with bench/run_bench.sh.
+ */
+
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "arrow_export.h"
+#include "backfill_pool.h"
+#include "bar_builder.h"
+#include "batch_decode.h"
+#include "book_checkpoint.h"
+#include "book_sync.h"
+#include "capture_journal.h"
+#include "column_stats.h"
+#include "conflation.h"
+#include "dedup_filter.h"
+#include "dedup_window.h"
+#include "event_log.h"
+#include "event_ring.h"
+#include "exchange_clock.h"
+#include "feature_history.h"
+#include "feed_arbiter.h"
+#include "forward_labels.h"
+#include "ingest_pipeline.h"
+#include "interval_set.h"
+#include "journal_replay.h"
+#include "kline_check.h"
+#include "kinesis_producer.h"
+#include "kinesis_records.h"
+#include "message_walk.h"
+#include "mlp_model.h"
+#include "ndjson_columns.h"
+#include "parquet_writer.h"
+#include "perf_counters.h"
+#include "pg_copy.h"
+#include "rate_governor.h"
+#include "rcu_cell.h"
+#include "ready_notifier.h"
+#include "record_ingest.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+#include "stream_load_server.h"
+#include "symbol_registry.h"
+#include "synthetic_stream.h"
+#include "tick_store.h"
+#include "timer_wheel.h"
+#include "trace_stamps.h"
+#include "uring_recv.h"
+#include "window_checkpoint.h"
+#include "ws_api_client.h"
+
+// ---------------------------------------------------------------------------
+// Allocation counting
+// ---------------------------------------------------------------------------
+
+namespace {
+std::atomic<uint64_t> g_allocations{0};
+}
+
+// Every form of operator new is replaced, so aligned and array allocations
+// count too. They allocate with malloc / aligned_alloc like the library's
+// own, whose operator delete (free) releases them; replacing delete as well
+// would pair a visible malloc with a visible free that GCC reports under
+// -Wmismatched-new-delete.
+void *operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a size that is a multiple of the alignment
+    if (void *p = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment) { return ::operator new(size, alignment); }
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Corpora
+// ---------------------------------------------------------------------------
+
+struct Corpus {
+    std::vector<std::vector<char>> frames;
+    std::size_t bytes = 0;
+};
+
+std::string corpus_dir() {
+    if (const char *dir = std::getenv("SBE_BENCH_CORPUS")) {
+        return dir;
+    }
+    return BENCH_CORPUS_DIR;
+}
+
+// Frames of `template_id` from every journal in the corpus directory
+const Corpus &corpus(uint16_t template_id) {
+    static const auto corpora = [] {
+        std::map<uint16_t, Corpus> by_template;
+        for (const auto &file : journal_files({corpus_dir()})) {
+            JournalReader reader(file);
+            JournalRecord record;
+            while (reader.next(record)) {
+                if (record.frame.size() < spot_sbe::MessageHeader::encodedLength()) {
+                    continue;
+                }
+                spot_sbe::MessageHeader header(const_cast<char *>(record.frame.data()), record.frame.size());
+                auto &target = by_template[header.templateId()];
+                target.frames.emplace_back(record.frame.begin(), record.frame.end());
+                target.bytes += record.frame.size();
+            }
+        }
+        return by_template;
+    }();
+    const auto it = corpora.find(template_id);
+    if (it == corpora.end() || it->second.frames.empty()) {
+        throw std::runtime_error("no frames for template " + std::to_string(template_id) + " in " + corpus_dir());
+    }
+    return it->second;
+}
+
+// Run `fn(frame)` once per iteration over the corpus and set the counters
+template <typename Fn>
+void run_corpus(benchmark::State &state, uint16_t template_id, Fn &&fn) {
+    const Corpus &frames = corpus(template_id);
+    const std::size_t count = frames.frames.size();
+    std::size_t i = 0;
+    uint64_t bytes = 0;
+    const uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        auto &frame = const_cast<std::vector<char> &>(frames.frames[i]);
+        bytes += frame.size();
+        fn(std::span<char>(frame.data(), frame.size()));
+        if (++i == count) {
+            i = 0;
+        }
+    }
+    const auto iterations = static_cast<double>(state.iterations());
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocs/msg"] =
+        static_cast<double>(g_allocations.load(std::memory_order_relaxed) - allocations) / iterations;
+}
+
+constexpr std::size_t HEADER_SIZE = 8;
+
+const char *body_of(std::span<char> frame) { return frame.data() + HEADER_SIZE; }
+std::size_t body_size_of(std::span<char> frame) { return frame.size() - HEADER_SIZE; }
+
+// ---------------------------------------------------------------------------
+// Benchmarks
+// ---------------------------------------------------------------------------
+
+void BM_HeaderParse(benchmark::State &state) {
+    run_corpus(state, static_cast<uint16_t>(state.range(0)), [](std::span<char> frame) {
+        spot_sbe::MessageHeader header(frame.data(), frame.size());
+        benchmark::DoNotOptimize(header.templateId());
+        benchmark::DoNotOptimize(header.blockLength());
+        benchmark::DoNotOptimize(header.schemaId());
+        benchmark::DoNotOptimize(header.version());
+    });
+}
+
+void BM_TradeStream(benchmark::State &state) {
+    run_corpus(state, 10000, [](std::span<char> frame) {
+        TradeFrame trade;
+        spot_sbe::MessageHeader header(frame.data(), frame.size());
+        benchmark::DoNotOptimize(parse_trade_frame(body_of(frame), body_size_of(frame), header.blockLength(), trade));
+        int64_t sum = 0;
+        for_each_trade_entry(body_of(frame), body_size_of(frame), trade,
+                             [&](const TradeEntry &entry) { sum += entry.price_mantissa + entry.qty_mantissa; });
+        benchmark::DoNotOptimize(sum);
+    });
+}
+
+void BM_BestBidAskStream(benchmark::State &state) {
+    run_corpus(state, 10001, [](std::span<char> frame) {
+        BestBidAskFrame bba;
+        spot_sbe::MessageHeader header(frame.data(), frame.size());
+        benchmark::DoNotOptimize(
+            parse_best_bid_ask_frame(body_of(frame), body_size_of(frame), header.blockLength(), bba));
+        benchmark::DoNotOptimize(bba);
+    });
+}
+
+void BM_DepthStream(benchmark::State &state) {
+    run_corpus(state, 10003, [](std::span<char> frame) {
+        DepthDiffFrame depth;
+        spot_sbe::MessageHeader header(frame.data(), frame.size());
+        benchmark::DoNotOptimize(
+            parse_depth_diff_frame(body_of(frame), body_size_of(frame), header.blockLength(), depth));
+        int64_t sum = 0;
+        const auto add = [&](const LevelMantissa &level) { sum += level.price + level.qty; };
+        for_each_level(body_of(frame), depth.bids, add);
+        for_each_level(body_of(frame), depth.asks, add);
+        benchmark::DoNotOptimize(sum);
+    });
+}
+
+// Depth diffs applied to a book, parse included: the baseline of double
+// prices in std::map (Arg 0), OrderBook's flat mantissa arrays (Arg 1; book
+// features refreshed too) and the same with BTCUSDT's 0.01 tick grid
+// indexed directly (Arg 2)
+void BM_BookApplyDiffs(benchmark::State &state) {
+    OrderBook book("BTCUSDT");
+    if (state.range(0) == 2) {
+        book.set_tick(1, -2);
+    }
+    std::map<double, double, std::greater<>> bids;
+    std::map<double, double> asks;
+    uint64_t update_id = 1;
+    run_corpus(state, 10003, [&](std::span<char> frame) {
+        DepthDiffFrame diff;
+        spot_sbe::MessageHeader header(frame.data(), frame.size());
+        if (parse_depth_diff_frame(body_of(frame), body_size_of(frame), header.blockLength(), diff) !=
+            ParseError::None) {
+            return;
+        }
+        if (state.range(0) == 0) {
+            const auto apply = [&](auto &side) {
+                return [&](const LevelMantissa &level) {
+                    const double price = decode_decimal(level.price, diff.price_exponent);
+                    if (level.qty == 0) {
+                        side.erase(price);
+                    } else {
+                        side[price] = decode_decimal(level.qty, diff.qty_exponent);
+                    }
+                };
+            };
+            for_each_level(body_of(frame), diff.bids, apply(bids));
+            for_each_level(body_of(frame), diff.asks, apply(asks));
+            benchmark::DoNotOptimize(bids.begin()->first);
+        } else {
+            diff.first_update_id = diff.final_update_id = update_id++;
+            benchmark::DoNotOptimize(book.apply_diff(body_of(frame), diff));
+        }
+    });
+}
+
+// A synthetic trade frame of 64 entries, ns/trade: entries with isBuyerMaker
+// (Arg 25) and without it (Arg 24)
+void BM_TradeGroupEntries(benchmark::State &state) {
+    constexpr uint32_t entries = 64;
+    const auto entry_length = static_cast<uint16_t>(state.range(0));
+    std::vector<char> frame(HEADER_SIZE + 18 + 6 + entries * entry_length + 8);
+    char *at = frame.data();
+    const auto put = [&](auto value) {
+        std::memcpy(at, &value, sizeof(value));
+        at += sizeof(value);
+    };
+    put(uint16_t{18});
+    put(uint16_t{10000});
+    put(uint16_t{1});
+    put(uint16_t{0});
+    put(int64_t{1700000000000000});
+    put(int64_t{1700000000000000});
+    put(int8_t{-2});
+    put(int8_t{-5});
+    put(entry_length);
+    put(entries);
+    for (uint32_t i = 0; i < entries; ++i) {
+        put(int64_t{i});
+        put(int64_t{6500000 + i});
+        put(int64_t{100 + i});
+        if (entry_length > 24) {
+            put(uint8_t(i & 1));
+        }
+    }
+    put(uint8_t{7});
+    std::memcpy(at, "BTCUSDT", 7);
+    const std::span<char> span(frame);
+    for (auto _ : state) {
+        TradeFrame trade;
+        benchmark::DoNotOptimize(parse_trade_frame(body_of(span), body_size_of(span), 18, trade));
+        int64_t sum = 0;
+        for_each_trade_entry(body_of(span), body_size_of(span), trade, [&](const TradeEntry &entry) {
+            sum += entry.price_mantissa + entry.qty_mantissa + entry.is_buyer_maker;
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * entries);
+}
+
+// A resync end to end: the corpus' depth diffs buffered behind a gap, then
+// a snapshot anchoring the first of them and the replay onto it (ns/diff)
+void BM_BookSyncReplay(benchmark::State &state) {
+    const Corpus &frames = corpus(10003);
+    std::vector<DepthDiffFrame> diffs(frames.frames.size());
+    for (std::size_t i = 0; i < diffs.size(); ++i) {
+        auto &frame = const_cast<std::vector<char> &>(frames.frames[i]);
+        spot_sbe::MessageHeader header(frame.data(), frame.size());
+        if (parse_depth_diff_frame(body_of(frame), body_size_of(frame), header.blockLength(), diffs[i]) !=
+            ParseError::None) {
+            state.SkipWithError("malformed corpus frame");
+            return;
+        }
+        // One contiguous sequence, so every diff is replayed
+        diffs[i].first_update_id = diffs[i].final_update_id = 1000 + i;
+    }
+    BookSync sync(std::string(diffs.front().symbol));
+    const std::vector<BookLevel> bids{{6500000, 100}}, asks{{6500100, 100}};
+    uint64_t replayed = 0;
+    for (auto _ : state) {
+        sync.resync();
+        for (std::size_t i = 0; i < diffs.size(); ++i) {
+            sync.apply_diff(frames.frames[i].data() + HEADER_SIZE, diffs[i]);
+        }
+        sync.load_snapshot(diffs.front().first_update_id - 1, diffs.front().price_exponent,
+                           diffs.front().qty_exponent, bids, asks);
+        replayed += diffs.size();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(replayed));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frames.bytes));
+}
+
+// Publishing a book to readers: copy the working book into a recycled spare
+// and swap it in, as DecoderPool does once per changed book and batch
+void BM_PublishBook(benchmark::State &state) {
+    OrderBook book("BTCUSDT");
+    std::vector<BookLevel> bids, asks;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        bids.push_back({6500000 - i, 100 + i});
+        asks.push_back({6500001 + i, 100 + i});
+    }
+    book.load_snapshot(1, -2, -5, bids, asks);
+    RcuCell<OrderBook> published(book_epochs());
+    for (auto _ : state) {
+        std::unique_ptr<OrderBook> next = published.recycle();
+        if (next) {
+            *next = book;
+        } else {
+            next = std::make_unique<OrderBook>(book);
+        }
+        published.publish(std::move(next));
+        EpochGuard guard(book_epochs());
+        benchmark::DoNotOptimize(published.load()->last_update_id());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// 100 books of 1000 levels a side through a checkpoint file: writing it
+// (fsync included, Arg 0) and restoring every book from it (Arg 1)
+void BM_BookCheckpoint(benchmark::State &state) {
+    constexpr int64_t symbols = 100;
+    constexpr int64_t depth = 1000;
+    std::vector<OrderBook> books;
+    std::vector<BookLevel> bids, asks;
+    for (int64_t i = 0; i < depth; ++i) {
+        bids.push_back({6500000 - i, 100 + i});
+        asks.push_back({6500001 + i, 100 + i});
+    }
+    for (int64_t s = 0; s < symbols; ++s) {
+        books.emplace_back("BENCH" + std::to_string(s) + "USDT");
+        books.back().load_snapshot(1000 + s, -2, -5, bids, asks);
+    }
+    std::vector<const OrderBook *> pointers;
+    for (const auto &book : books) {
+        pointers.push_back(&book);
+    }
+    const std::string path = std::filesystem::temp_directory_path() / "bench_books.ckpt";
+    write_book_checkpoint(path, pointers, 0);
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            benchmark::DoNotOptimize(write_book_checkpoint(path, pointers, 0));
+        } else {
+            const BookCheckpoint checkpoint(path);
+            for (std::size_t i = 0; i < checkpoint.size(); ++i) {
+                checkpoint.load(i, books[i]);
+            }
+            benchmark::DoNotOptimize(books.back().last_update_id());
+        }
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * symbols);
+    state.SetBytesProcessed(state.iterations() * symbols * depth * 2 * static_cast<int64_t>(sizeof(BookLevel)));
+}
+
+// One perf counter group read, what each sampled frame pays twice; skipped
+// where perf_event_open is not allowed
+void BM_PerfCounterRead(benchmark::State &state) {
+    PerfCounters counters;
+    if (!counters.open()) {
+        state.SkipWithError(counters.error().c_str());
+        return;
+    }
+    PerfReading reading;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(counters.read(reading));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// A trace block's stamps as the native stages take them (one ingest clock
+// read each), and one finished trace into the per-hop histograms
+void BM_TraceStamp(benchmark::State &state) {
+    TraceStamps trace;
+    for (auto _ : state) {
+        trace.us[TRACE_DECODE] = ingest_time_us();
+        benchmark::DoNotOptimize(trace);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_TraceCollectorRecord(benchmark::State &state) {
+    TraceCollector collector;
+    TraceStamps trace;
+    trace.us = {1700000000000000ULL, 1700000000040000ULL, 1700000000040030ULL, 1700000000040100ULL,
+                1700000000055000ULL, 1700000000090000ULL, 1700000000095000ULL};
+    for (auto _ : state) {
+        collector.record(trace);
+        trace.us[TRACE_PUBLISH] += 7;
+    }
+    benchmark::DoNotOptimize(collector.traces());
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Snapshot scheduling for Arg(0) buffers, on 2 s and 10 s grids, with the
+// wheel advanced every millisecond over a minute; time per advance
+void BM_TimerWheelAdvance(benchmark::State &state) {
+    const auto timers = static_cast<std::size_t>(state.range(0));
+    uint64_t fired = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        uint64_t now_us = 1700000000123456ULL;
+        TimerWheel wheel(1000, now_us);
+        for (std::size_t i = 0; i < timers; ++i) {
+            wheel.add(i % 4 == 3 ? 10000000 : 2000000);
+        }
+        state.ResumeTiming();
+        for (int ms = 0; ms < 60000; ++ms) {
+            now_us += 1000;
+            fired += wheel.advance(now_us, [](const TimerFired &timer) { benchmark::DoNotOptimize(timer.due_us); });
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 60000);
+    state.counters["fired/s"] = static_cast<double>(fired) / static_cast<double>(state.iterations()) / 60.0;
+}
+
+// Bars of kind Arg(0) (0 time, 1 tick, 2 volume, 3 dollar) from a 1M-row
+// trades table of two symbols, roughly 10 trades a second; time per trade
+void BM_BuildBars(benchmark::State &state) {
+    constexpr std::size_t n = 1'000'000;
+    TradeColumns trades;
+    const SymbolId ids[2] = {symbol_table().intern("BTCUSDT"), symbol_table().intern("ETHUSDT")};
+    for (std::size_t i = 0; i < n; ++i) {
+        trades.trade_time.push_back(1700000000000LL + static_cast<int64_t>(i) * 100);
+        trades.trade_id.push_back(static_cast<int64_t>(i));
+        trades.price.value.push_back(65000.0 + static_cast<double>(i % 997) * 0.01);
+        trades.qty.value.push_back(0.001 * static_cast<double>(i % 89 + 1));
+        trades.is_buyer_maker.push_back(static_cast<uint8_t>(i % 3 == 0));
+        trades.symbol_id.push_back(ids[i % 7 == 0]);
+    }
+    BarConfig config;
+    config.kind = static_cast<BarKind>(state.range(0));
+    config.threshold = std::array<double, 4>{60000, 500, 20, 1.3e6}[state.range(0)];
+    std::size_t bars = 0;
+    for (auto _ : state) {
+        BarBuilder builder(config);
+        builder.add_trades(trades);
+        builder.flush();
+        bars = builder.take().size();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+    state.counters["bars"] = static_cast<double>(bars);
+}
+
+// A month of 1m klines (43200) rebuilt from trades and diffed against the
+// same klines as REST would return them; time per diff
+void BM_DiffKlines(benchmark::State &state) {
+    BarBuilder builder(BarConfig{BarKind::Time, 60000});
+    const SymbolId id = symbol_table().intern("BTCUSDT");
+    for (int64_t i = 0; i < 43200 * 4; ++i) {
+        builder.add(id, 1700000000000LL + i * 15000, i, 65000.0 + static_cast<double>(i % 997) * 0.01,
+                    0.001 * static_cast<double>(i % 89 + 1), i % 3 == 0);
+    }
+    builder.flush();
+    const KlineColumns built = klines_from_bars(builder.take(), id);
+    const KlineColumns rest = built;
+    for (auto _ : state) {
+        KlineDiffColumns rows;
+        benchmark::DoNotOptimize(diff_klines(kline_view(built), kline_view(rest), 1e-9, rows));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(built.open_time.size()));
+}
+
+// Per-message state lookup over 256 symbols: a string-keyed map (Arg 0),
+// interning the name then the registry (1), and the registry by the
+// symbol_id a decoded frame already carries (2); time per lookup
+void BM_SymbolStateLookup(benchmark::State &state) {
+    constexpr std::size_t symbols = 256;
+    std::vector<std::string> names;
+    std::vector<SymbolId> ids;
+    std::unordered_map<std::string, std::unique_ptr<int64_t>, SymbolHash, std::equal_to<>> map;
+    SymbolRegistry<int64_t> registry(symbols);
+    for (std::size_t i = 0; i < symbols; ++i) {
+        names.push_back("SYM" + std::to_string(i * 7919) + "USDT");
+        ids.push_back(symbol_table().intern(names.back()));
+        map.emplace(names.back(), std::make_unique<int64_t>(0));
+        registry.emplace(ids.back(), 0);
+    }
+    std::vector<std::size_t> order(4096);
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = (i * 2654435761u) % symbols;
+    }
+    const int64_t mode = state.range(0);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const std::size_t s = order[i++ & (order.size() - 1)];
+        int64_t *value;
+        if (mode == 0) {
+            value = map.find(std::string_view(names[s]))->second.get();
+        } else if (mode == 1) {
+            value = registry.find(symbol_table().intern(names[s]));
+        } else {
+            value = registry.find(ids[s]);
+        }
+        ++*value;
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Receive-thread cost of ReadyNotifier::notify() per staged frame while
+// the consumer is busy (Arg 0), and a full arm/notify/clear wake-up cycle
+// with its eventfd write and read (Arg 1)
+void BM_ReadyNotify(benchmark::State &state) {
+    ReadyNotifier notifier;
+    const bool cycle = state.range(0) != 0;
+    for (auto _ : state) {
+        if (cycle) {
+            notifier.arm([] { return false; });
+        }
+        notifier.notify();
+        if (cycle) {
+            benchmark::DoNotOptimize(notifier.clear());
+        }
+    }
+    state.counters["wakeups"] = static_cast<double>(notifier.wakeups());
+}
+
+// A WebSocket API response envelope around an Arg(0)-byte result (a
+// klines page is ~100 KB), read in place (Arg 1 = 0) or with the result
+// copied out as a copying client would (1); time per response
+void BM_WsApiEnvelope(benchmark::State &state) {
+    const auto result_size = static_cast<uint32_t>(state.range(0));
+    const bool copy = state.range(1) != 0;
+    std::vector<char> frame;
+    const auto put = [&frame](const auto value) {
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        frame.insert(frame.end(), bytes, bytes + sizeof(value));
+    };
+    put(uint16_t{3});
+    put(WS_API_RESPONSE_TEMPLATE);
+    put(EXPECTED_SCHEMA_ID);
+    put(EXPECTED_SCHEMA_VERSION);
+    put(uint8_t{0});
+    put(uint16_t{200});
+    put(uint16_t{19});
+    put(uint16_t{1});
+    put(uint8_t{2});
+    put(uint8_t{1});
+    put(uint8_t{1});
+    put(int64_t{6000});
+    put(int64_t{40});
+    const std::string id = "4294967297";
+    put(static_cast<uint8_t>(id.size()));
+    frame.insert(frame.end(), id.begin(), id.end());
+    put(result_size);
+    frame.resize(frame.size() + result_size, 'k');
+    std::vector<char> copied;
+    for (auto _ : state) {
+        const WsApiEnvelope envelope = parse_ws_api_envelope({frame.data(), frame.size()});
+        if (copy) {
+            copied.assign(envelope.result.begin(), envelope.result.end());
+            benchmark::DoNotOptimize(copied.data());
+        }
+        benchmark::DoNotOptimize(envelope.result.data());
+    }
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(frame.size()));
+}
+
+// RateGovernor::reserve() against exchangeInfo's three spot limits, with a
+// budget that never runs out; time per reservation
+void BM_RateGovernorReserve(benchmark::State &state) {
+    using spot_sbe::RateLimitInterval;
+    using spot_sbe::RateLimitType;
+    RateGovernor governor;
+    const RateLimitSpec limits[] = {{RateLimitType::RequestWeight, RateLimitInterval::Minute, 1, INT64_MAX / 2},
+                                    {RateLimitType::Orders, RateLimitInterval::Second, 10, 100},
+                                    {RateLimitType::RawRequests, RateLimitInterval::Minute, 5, INT64_MAX / 2}};
+    governor.configure(limits);
+    int64_t now_ms = 1'700'000'000'000;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(governor.reserve(2, now_ms++));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Backfill of one dense symbol (256 pages) and seven sparse ones (2 pages
+// each) on state.range(0) workers. The fetch stands in for the WS API: a
+// 1 ms round trip per batch, then a copy of a prebuilt 1000-row
+// AggTradesResponse per page; decode and Parquet encoding are real. The
+// dense symbol's pages all start on one worker, so beyond one worker the
+// speedup comes from stealing.
+void BM_BackfillPool(benchmark::State &state) {
+    std::vector<char> page(64 * 1024);
+    spot_sbe::AggTradesResponse response;
+    response.wrapAndApplyHeader(page.data(), 0, page.size()).priceExponent(-2).qtyExponent(-8);
+    auto &trades = response.aggTradesCount(1000);
+    for (int64_t i = 0; i < 1000; ++i) {
+        trades.next()
+            .aggTradeId(3'000'000'000 + i)
+            .price(6'500'000 + i % 397)
+            .qty(100'000 + i % 61)
+            .firstTradeId(5'000'000'000 + 2 * i)
+            .lastTradeId(5'000'000'001 + 2 * i)
+            .time(1'700'000'000'000 + i / 4)
+            .isBuyerMaker(i % 3 == 0 ? spot_sbe::BoolEnum::True : spot_sbe::BoolEnum::False)
+            .isBestMatch(spot_sbe::BoolEnum::True);
+    }
+    page.resize(spot_sbe::MessageHeader::encodedLength() + response.encodedLength());
+
+    BackfillConfig config;
+    config.workers = static_cast<std::size_t>(state.range(0));
+    BackfillPool pool(config, [&](std::size_t, std::span<const WsApiRequest> requests) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::vector<WsApiResponse> responses(requests.size());
+        for (WsApiResponse &out : responses) {
+            out.frame = page;
+            out.envelope.status = 200;
+            out.envelope.result = std::span<char>(out.frame);
+        }
+        return responses;
+    });
+    const std::vector<IdRequest> dense = IdIntervalSet().plan(0, 256 * 1000 - 1, 1000);
+    const std::vector<IdRequest> sparse = IdIntervalSet().plan(0, 2 * 1000 - 1, 1000);
+    const std::size_t pages = dense.size() + 7 * sparse.size();
+    for (auto _ : state) {
+        pool.add("BTCUSDT", dense);
+        for (const char *symbol : {"ETHUSDT", "XRPUSDT", "LTCUSDT", "ADAUSDT", "DOTUSDT", "SOLUSDT", "BNBUSDT"}) {
+            pool.add(symbol, sparse);
+        }
+        for (std::size_t done = 0; done < pages;) {
+            done += pool.next_result(10000).has_value() ? 1 : 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(pages));
+    state.counters["stolen"] = benchmark::Counter(static_cast<double>(pool.stats().stolen_tasks.load()) /
+                                                  static_cast<double>(state.iterations()));
+}
+
+// A day of trade IDs (2M over 24 h, 8 symbols, 1% repeats) through the
+// exact window (arg 0) and the 1% Bloom filter (arg 1); `bytes` is what
+// each holds at the end
+template <typename Window>
+void run_dedup_day(benchmark::State &state, Window &window) {
+    constexpr uint64_t keys = 2'000'000;
+    constexpr uint64_t day_us = 86'400'000'000;
+    // Each iteration is a later day, so time never goes backwards
+    uint64_t start_us = 0;
+    for (auto _ : state) {
+        window.clear();
+        std::size_t unique = 0;
+        for (uint64_t i = 0; i < keys; ++i) {
+            const uint64_t id = i % 100 == 99 ? i - 50 : i;
+            unique += window.check(static_cast<SymbolId>(i % 8), id, start_us + i * (day_us / keys)) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(unique);
+        start_us += 2 * day_us;
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(keys));
+    state.counters["bytes"] = static_cast<double>(window.memory_bytes());
+}
+
+void BM_DedupDay(benchmark::State &state) {
+    if (state.range(0) == 0) {
+        DedupWindow window(86'400'000'000);
+        run_dedup_day(state, window);
+    } else {
+        DedupFilter filter(86'400'000'000, 2'000'000, 0.01);
+        run_dedup_day(state, filter);
+    }
+}
+
+// Messages per second split out of one buffer holding 1024 synthetic
+// frames back to back, then decoded (Arg 1) or only measured (Arg 0)
+void BM_MessageWalk(benchmark::State &state) {
+    SyntheticStreamConfig config;
+    config.symbols = {"BTCUSDT", "ETHUSDT", "SOLUSDT", "BNBUSDT"};
+    config.partial_depth_interval_ms = 100;
+    SyntheticStream stream(config);
+    std::vector<char> combined;
+    for (int i = 0; i < 1024; ++i) {
+        stream.next(combined);
+    }
+    const bool decode = state.range(0) != 0;
+    std::vector<std::span<char>> frames;
+    for (auto _ : state) {
+        frames.clear();
+        split_messages(std::span<char>(combined), frames);
+        if (decode) {
+            BatchColumns out;
+            decode_frames(frames, out);
+            benchmark::DoNotOptimize(out);
+        }
+        benchmark::DoNotOptimize(frames.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(combined.size()));
+}
+
+// Frames per second through an IngestPipeline's receive and decode stages
+// into JSON records, 4096 synthetic frames a batch over the three lanes'
+// decode threads, drained with take() (every lane blocks, nothing drops)
+void BM_IngestPipeline(benchmark::State &state) {
+    SyntheticStreamConfig config;
+    config.symbols = {"BTCUSDT", "ETHUSDT", "SOLUSDT", "BNBUSDT"};
+    SyntheticStream stream(config);
+    std::vector<std::vector<char>> frames(4096);
+    std::array<std::size_t, PIPELINE_LANES> per_lane{};
+    int64_t bytes = 0;
+    for (std::vector<char> &frame : frames) {
+        stream.next(frame);
+        spot_sbe::MessageHeader header(frame.data(), frame.size());
+        PipelineLane lane{};
+        pipeline_lane(header.templateId(), lane);
+        ++per_lane[static_cast<std::size_t>(lane)];
+        bytes += static_cast<int64_t>(frame.size());
+    }
+    IngestPipelineConfig pipeline_config;
+    for (PipelineLaneConfig &lane : pipeline_config.lanes) {
+        lane = PipelineLaneConfig{OverflowPolicy::Block, frames.size()};
+    }
+    IngestPipeline pipeline(pipeline_config);
+    pipeline.start();
+    std::vector<PipelineItem> items;
+    for (auto _ : state) {
+        for (const std::vector<char> &frame : frames) {
+            pipeline.submit(std::span<const char>(frame), 1);
+        }
+        for (std::size_t lane = 0; lane < PIPELINE_LANES; ++lane) {
+            for (std::size_t taken = 0; taken < per_lane[lane];) {
+                items.clear();
+                taken += pipeline.take(static_cast<PipelineLane>(lane), items, frames.size(), 1000);
+            }
+        }
+        benchmark::DoNotOptimize(items.data());
+    }
+    pipeline.stop(1000);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(frames.size()));
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+// Copies per second through a FeedArbiter: 4096 synthetic frames arriving
+// on two lines, line B one frame behind A, so every frame is one win and
+// one duplicate (a fresh arbiter per iteration, as the IDs do not repeat)
+void BM_FeedArbiter(benchmark::State &state) {
+    SyntheticStreamConfig config;
+    config.symbols = {"BTCUSDT", "ETHUSDT", "SOLUSDT", "BNBUSDT"};
+    SyntheticStream stream(config);
+    std::vector<std::vector<char>> frames(4096);
+    for (std::vector<char> &frame : frames) {
+        stream.next(frame);
+    }
+    for (auto _ : state) {
+        FeedArbiter arbiter(2);
+        std::size_t wins = 0;
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            wins += arbiter.admit(std::span<const char>(frames[i]), 0, 2 * i + 1);
+            if (i > 0) {
+                wins += arbiter.admit(std::span<const char>(frames[i - 1]), 1, 2 * i + 2);
+            }
+        }
+        benchmark::DoNotOptimize(wins);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(2 * frames.size() - 1));
+}
+
+// Offset-corrected exchange-to-receive latencies per second, the per-frame
+// cost a receive thread pays once the exchange clock is synced (a seqlock
+// read and the drift extrapolation)
+void BM_ExchangeLatency(benchmark::State &state) {
+    ExchangeClock clock;
+    const uint64_t base = 1'700'000'000'000'000;
+    for (uint64_t i = 0; i < ExchangeClock::WINDOW; ++i) {
+        const uint64_t sent = base + i * 30'000'000;
+        clock.add(ClockSample{sent, sent + 400, static_cast<int64_t>(sent + 200 + 2500 + i * 600), 1});
+    }
+    uint64_t received = base + ExchangeClock::WINDOW * 30'000'000;
+    int64_t total = 0;
+    for (auto _ : state) {
+        total += clock.exchange_latency_us(received - 900, received);
+        ++received;
+    }
+    benchmark::DoNotOptimize(total);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Feature history rows per second: 720 trade-feature rows of 16 values on
+// a 5 s grid (a cent-rounded random walk, its derived prices and a few
+// counters), appended (arg 0) or decoded from one blob (arg 1); the
+// bytes_per_row counter is the compressed size
+void BM_FeatureHistory(benchmark::State &state) {
+    constexpr std::size_t ROWS = 720;
+    constexpr std::size_t WIDTH = 16;
+    std::vector<double> rows(ROWS * WIDTH);
+    uint64_t seed = 42;
+    double price = 60000.0;
+    for (std::size_t r = 0; r < ROWS; ++r) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        price += static_cast<double>(static_cast<int64_t>(seed >> 59) - 16) * 0.01;
+        double *row = &rows[r * WIDTH];
+        for (std::size_t i = 0; i < 6; ++i) {
+            row[i] = price + static_cast<double>(i) * 0.5;
+        }
+        for (std::size_t i = 6; i < WIDTH; ++i) {
+            row[i] = static_cast<double>((seed >> (i * 3)) % 8);
+        }
+    }
+    const auto append_all = [&](FeatureHistoryChunk &chunk) {
+        std::string blob;
+        for (std::size_t r = 0; r < ROWS; ++r) {
+            const int64_t ts = 1'700'000'000'000'000 + static_cast<int64_t>(r) * 5'000'000;
+            blob += chunk.append(1, ts, std::span<const double>(&rows[r * WIDTH], WIDTH));
+        }
+        return blob;
+    };
+    FeatureHistoryChunk chunk;
+    const std::string blob = append_all(chunk);
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            chunk.reset();
+            benchmark::DoNotOptimize(append_all(chunk).size());
+        } else {
+            std::vector<FeatureHistorySeries> series;
+            decode_feature_history(blob, series);
+            benchmark::DoNotOptimize(series.front().values.data());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(ROWS));
+    state.counters["bytes_per_row"] = static_cast<double>(blob.size()) / ROWS;
+}
+
+// Tick store rows per second for 20000 synthetic frames of two symbols:
+// written to fresh files (arg 0), or every column of every file decoded
+// back (arg 1, zstd blocks; arg 2, uncompressed). Bytes are decoded column
+// bytes, the scan's effective bandwidth.
+void BM_TickStore(benchmark::State &state) {
+    const std::string root = (std::filesystem::temp_directory_path() / "sbe_bench_ticks").string();
+    SyntheticStreamConfig config;
+    config.symbols = {"BTCUSDT", "ETHUSDT"};
+    SyntheticStream stream(config);
+    std::vector<std::vector<char>> frames(20000);
+    for (std::vector<char> &frame : frames) {
+        stream.next(frame);
+    }
+    const auto write_all = [&](bool compress) {
+        std::filesystem::remove_all(root);
+        TickStoreWriter writer(TickStoreConfig{root, TICK_DEFAULT_BLOCK_ROWS, compress, 3});
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            writer.append_buffer(frames[i], i);
+        }
+        writer.close();
+        return writer.stats().rows;
+    };
+    uint64_t rows = write_all(state.range(0) != 2);
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(root)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".tick") {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::size_t bytes = 0;
+    std::vector<char> out;
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            rows = write_all(true);
+            continue;
+        }
+        bytes = 0;
+        for (const std::string &path : paths) {
+            TickFileReader reader(path);
+            for (std::size_t b = 0; b < reader.blocks(); ++b) {
+                for (std::size_t c = 0; c < reader.columns().size(); ++c) {
+                    out.resize(reader.block(b).rows * tick_column_width(reader.columns()[c].type));
+                    reader.read_column(b, c, out.data());
+                    bytes += out.size();
+                }
+            }
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+    std::filesystem::remove_all(root);
+}
+
+// Two-minute range reads from half an hour of depth rows in 4096-row
+// blocks: open the file and read every column of the range, with the
+// sparse index (arg 0), with the .idx file gone so blocks are walked (arg
+// 1), or by decoding the whole file and filtering (arg 2, no range read)
+void BM_TickRange(benchmark::State &state) {
+    const std::string root = (std::filesystem::temp_directory_path() / "sbe_bench_tick_range").string();
+    std::filesystem::remove_all(root);
+    SyntheticStreamConfig config;
+    SyntheticStream stream(config);
+    std::string path;
+    {
+        TickStoreWriter writer(TickStoreConfig{root, 4096, true, 3});
+        std::vector<char> frame;
+        for (int i = 0; i < 300000; ++i) {
+            frame.clear();
+            const uint64_t event_us = stream.next(frame);
+            writer.append_buffer(frame, event_us);
+        }
+        writer.close();
+        path = tick_file_path(root, TickStream::Depth, "BTCUSDT", tick_day(static_cast<int64_t>(config.start_us)));
+    }
+    if (state.range(0) == 1) {
+        std::filesystem::remove(sparse_index_path(path));
+    }
+    const int64_t from = static_cast<int64_t>(config.start_us) + 900'000'000;
+    const int64_t to = from + 120'000'000;
+    std::vector<std::size_t> selection;
+    std::vector<std::vector<char>> out;
+    std::vector<char> times;
+    std::vector<char> column;
+    uint64_t rows = 0;
+    std::size_t blocks = 0;
+    for (auto _ : state) {
+        TickFileReader reader(path);
+        if (selection.empty()) {
+            for (std::size_t c = 0; c < reader.columns().size(); ++c) {
+                selection.push_back(c);
+            }
+        }
+        if (state.range(0) != 2) {
+            const TickRangeRead read = reader.read_range(SparseKey::Time, from, to, selection, out);
+            rows = read.rows;
+            blocks = read.blocks;
+            continue;
+        }
+        rows = 0;
+        blocks = reader.blocks();
+        for (std::size_t b = 0; b < reader.blocks(); ++b) {
+            times.resize(reader.block(b).rows * sizeof(int64_t));
+            reader.read_column(b, 0, times.data());
+            for (std::size_t c = 1; c < reader.columns().size(); ++c) {
+                column.resize(reader.block(b).rows * tick_column_width(reader.columns()[c].type));
+                reader.read_column(b, c, column.data());
+            }
+            for (std::size_t r = 0; r < reader.block(b).rows; ++r) {
+                int64_t ts;
+                std::memcpy(&ts, times.data() + r * sizeof(ts), sizeof(ts));
+                rows += ts >= from && ts <= to;
+            }
+        }
+        benchmark::DoNotOptimize(column.data());
+    }
+    state.counters["rows"] = static_cast<double>(rows);
+    state.counters["blocks_decoded"] = static_cast<double>(blocks);
+    std::filesystem::remove_all(root);
+}
+
+// Records per second a sender turns into signed PutRecords requests: a
+// full 500-record batch of trade-sized JSON, base64 encoded into the body,
+// hashed and signed (the signing key is cached after the first request)
+void BM_KinesisPutRecordsRequest(benchmark::State &state) {
+    std::vector<KinesisRecord> records(500);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        records[i].partition_key = i % 2 == 0 ? "BTCUSDT" : "ETHUSDT";
+        records[i].data = "{\"msg_type\":\"trade\",\"symbol\":\"" + records[i].partition_key +
+                          "\",\"trade_id\":" + std::to_string(4'000'000'000 + i) +
+                          ",\"price\":65000.12,\"quantity\":0.00125,\"is_buyer_maker\":true,"
+                          "\"event_ts\":1700000000123,\"ingest_ts\":1700000000124,\"source\":\"sbe\"}";
+    }
+    const AwsCredentials credentials{"AKIDEXAMPLE", "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY", ""};
+    SigV4Signer signer("us-east-1", "kinesis");
+    std::string body;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        build_put_records_body("trades", records, body);
+        const std::string head =
+            put_records_request_head(signer, credentials, "kinesis.us-east-1.amazonaws.com", body, 1'700'000'000);
+        benchmark::DoNotOptimize(head.data());
+        bytes += static_cast<int64_t>(body.size());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(records.size()));
+    state.SetBytesProcessed(bytes);
+}
+
+// Frames the synthetic generator encodes per second, four symbols at
+// 10x a busy BTCUSDT minute, with 20-level partial depth on: the ceiling
+// of a load test before any socket is involved
+void BM_SyntheticStream(benchmark::State &state) {
+    SyntheticStreamConfig config;
+    config.symbols = {"BTCUSDT", "ETHUSDT", "SOLUSDT", "BNBUSDT"};
+    config.trade_rate = 2000;
+    config.bba_rate = 5000;
+    config.partial_depth_interval_ms = 100;
+    SyntheticStream stream(config);
+    std::vector<char> frames;
+    frames.reserve(1 << 20);
+    for (auto _ : state) {
+        frames.clear();
+        for (int i = 0; i < 1024; ++i) {
+            stream.next(frames);
+        }
+        benchmark::DoNotOptimize(frames.data());
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+    state.SetBytesProcessed(static_cast<int64_t>(stream.stats().bytes));
+}
+
+// The same stream unpaced through StreamLoadServer into one plain
+// WebSocketClient over loopback: generation, framing, send and receive
+void BM_StreamLoadServer(benchmark::State &state) {
+    SyntheticStreamConfig config;
+    config.symbols = {"BTCUSDT", "ETHUSDT", "SOLUSDT", "BNBUSDT"};
+    config.trade_rate = 2000;
+    config.bba_rate = 5000;
+    StreamLoadServerConfig server_config;
+    server_config.speed = 0;
+    StreamLoadServer server(SyntheticStream(config), server_config);
+    server.start();
+    WebSocketClient client;
+    WsEndpoint endpoint;
+    endpoint.host = "127.0.0.1";
+    endpoint.port = server.port();
+    endpoint.use_tls = false;
+    client.connect(endpoint);
+    std::vector<char> message;
+    for (auto _ : state) {
+        for (int i = 0; i < 1024; ++i) {
+            message.clear();
+            client.read_message(message);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 1024);
+    client.close();
+    server.stop();
+}
+
+// column_stats' vector pass per variant on the same 64k column: baseline
+// (Arg 0), AVX2 (1), AVX-512 (2); variants the CPU lacks are skipped
+void BM_ColumnStatsVariant(benchmark::State &state) {
+    constexpr std::size_t n = 65536;
+    std::vector<double> price(n), qty(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        price[i] = 65000.0 + static_cast<double>(i % 997) * 0.01;
+        qty[i] = 0.001 * static_cast<double>(i % 89 + 1);
+    }
+    const auto level = static_cast<SimdLevel>(state.range(0));
+    if (level > cpu_dispatch_detail::detect_simd_level()) {
+        state.SkipWithError("not supported by this CPU");
+        return;
+    }
+    for (auto _ : state) {
+        ColumnStats stats;
+        stats.pivot = price[0];
+#if SBE_X86_DISPATCH
+        if (level == SimdLevel::Avx512) {
+            benchmark::DoNotOptimize(column_stats_detail::accumulate_avx512(stats, price.data(), qty.data(), n));
+        } else if (level == SimdLevel::Avx2) {
+            benchmark::DoNotOptimize(column_stats_detail::accumulate_avx2(stats, price.data(), qty.data(), n));
+        } else {
+            benchmark::DoNotOptimize(
+                column_stats_detail::accumulate_with<column_stats_detail::SseOps>(stats, price.data(), qty.data(), n));
+        }
+#else
+        column_stats_detail::accumulate_scalar(stats, price.data(), qty.data(), 0, n);
+#endif
+        benchmark::DoNotOptimize(stats);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+    state.SetLabel(simd_level_name(level));
+}
+
+// 200 symbols' 1/2/10/60 s trade windows, full of trades, through a window
+// checkpoint: writing it (fsync included, Arg 0) and restoring them (Arg 1)
+void BM_WindowCheckpoint(benchmark::State &state) {
+    constexpr std::size_t symbols = 200;
+    const std::vector<int64_t> horizons = {1000, 2000, 10000, 60000};
+    std::vector<std::string> keys;
+    std::vector<MultiHorizonWindow> windows;
+    for (std::size_t s = 0; s < symbols; ++s) {
+        keys.push_back("BENCH" + std::to_string(s) + "USDT");
+        windows.emplace_back(horizons, 0);
+        for (int64_t t = 0; t < 60000; t += 50) {
+            windows.back().add(1700000000000 + t, 65000.0 + static_cast<double>(t % 97), 0.01, t % 3 == 0);
+        }
+    }
+    std::vector<WindowCheckpointItem> items;
+    for (std::size_t s = 0; s < symbols; ++s) {
+        items.push_back({keys[s], &windows[s]});
+    }
+    const std::string path = std::filesystem::temp_directory_path() / "bench_windows.ckpt";
+    write_window_checkpoint(path, items, {}, 0);
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            write_window_checkpoint(path, items, {}, 0);
+        } else {
+            const WindowCheckpoint checkpoint(path);
+            for (std::size_t i = 0; i < checkpoint.size(); ++i) {
+                benchmark::DoNotOptimize(checkpoint.load(i, windows[i]));
+            }
+        }
+    }
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(symbols));
+}
+
+// decode_batch's per-frame columnar decode, batch reused across frames
+void BM_DecodeFrameColumns(benchmark::State &state) {
+    BatchColumns batch;
+    int64_t index = 0;
+    run_corpus(state, static_cast<uint16_t>(state.range(0)), [&](std::span<char> frame) {
+        if (index == 1024) {
+            batch = BatchColumns{};
+            index = 0;
+        }
+        decode_frame(frame, index++, batch);
+    });
+}
+
+// Receiver path: staging into the event ring on the receive thread plus
+// the consumer's drain into columns, every 256 frames
+void BM_StageAndDrain(benchmark::State &state) {
+    EventRing ring(1 << 16);
+    std::size_t staged = 0;
+    uint64_t seq = 0;
+    run_corpus(state, static_cast<uint16_t>(state.range(0)), [&](std::span<char> frame) {
+        stage_frame(ring, frame, seq++, 1700000000000000ULL);
+        if (++staged == 256) {
+            BatchColumns out;
+            drain_events(ring, out, SIZE_MAX);
+            benchmark::DoNotOptimize(out);
+            staged = 0;
+        }
+    });
+}
+
+// Receiver path with an event log: decode into the shared log, copy the
+// frame's records into the ring and drain it every 256 frames, plus one
+// EventLogReader following the log in step
+void BM_EventLogAppendRead(benchmark::State &state) {
+    const std::string path = (std::filesystem::temp_directory_path() / "sbe_bench_events.log").string();
+    EventLog log = EventLog::create(path, 1 << 16);
+    EventLogReader reader({path}, false, EventLogStart::Latest);
+    EventRing ring(1 << 16);
+    std::size_t staged = 0;
+    uint64_t seq = 0;
+    run_corpus(state, static_cast<uint16_t>(state.range(0)), [&](std::span<char> frame) {
+        if (append_frame(log, frame, seq++, 1700000000000000ULL)) {
+            copy_frame(ring, log.last_frame());
+        }
+        if (++staged == 256) {
+            BatchColumns out;
+            drain_events(ring, out, SIZE_MAX);
+            benchmark::DoNotOptimize(out);
+            BatchColumns followed;
+            reader.drain(followed, SIZE_MAX, 0);
+            benchmark::DoNotOptimize(followed);
+            staged = 0;
+        }
+    });
+    std::filesystem::remove(path);
+}
+
+// BM_StageAndDrain with conflation: frames arrive 1ms apart and each
+// symbol's latest quote (Arg 10001) or top-20 book (Arg 10003) is staged
+// every 100ms, so the ring and the drain see 1 frame in 100
+void BM_ConflateAndDrain(benchmark::State &state) {
+    ConflationConfig config;
+    config.bba_interval_ms = 100;
+    config.depth_interval_ms = 100;
+    Conflator conflator(config, 1700000000000000ULL);
+    EventRing ring(1 << 16);
+    std::size_t staged = 0;
+    uint64_t seq = 0;
+    uint64_t now_us = 1700000000000000ULL;
+    run_corpus(state, static_cast<uint16_t>(state.range(0)), [&](std::span<char> frame) {
+        now_us += 1000;
+        if (!conflator.absorb(frame, now_us)) {
+            stage_frame(ring, frame, seq++, now_us);
+        }
+        conflator.flush_due(now_us, [&](std::span<EventRecord> records) {
+            for (EventRecord &record : records) {
+                record.frame_seq = seq;
+            }
+            ++seq;
+            copy_frame(ring, records);
+        });
+        if (++staged == 256) {
+            BatchColumns out;
+            drain_events(ring, out, SIZE_MAX);
+            benchmark::DoNotOptimize(out);
+            staged = 0;
+        }
+    });
+}
+
+// Receive side of one 100-byte frame over a socketpair, as the receive
+// thread does it: poll() then recv() into a staging buffer (Arg 0), or
+// wait on the armed multishot io_uring recv and copy out of its buffer
+// (Arg 1). The send is timed too.
+void BM_SocketReceive(benchmark::State &state) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        state.SkipWithError("socketpair failed");
+        return;
+    }
+    std::unique_ptr<UringRecv> uring;
+    if (state.range(0) == 1) {
+        try {
+            uring = std::make_unique<UringRecv>(fds[0], UringConfig{});
+        } catch (const std::exception &e) {
+            state.SkipWithError(e.what());
+        }
+    }
+    char frame[100] = {};
+    char staging[16 * 1024];
+    for (auto _ : state) {
+        if (::send(fds[1], frame, sizeof(frame), 0) != sizeof(frame)) {
+            state.SkipWithError("send failed");
+            break;
+        }
+        std::size_t received = 0;
+        while (received < sizeof(frame)) {
+            if (uring) {
+                uring->wait(-1);
+                received += uring->read(staging, sizeof(staging));
+            } else {
+                pollfd pfd{fds[0], POLLIN, 0};
+                ::poll(&pfd, 1, -1);
+                received += static_cast<std::size_t>(std::max<ssize_t>(::recv(fds[0], staging, sizeof(staging), 0), 0));
+            }
+        }
+        benchmark::DoNotOptimize(staging);
+    }
+    uring.reset();
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+// decode_batch(format="arrow") for trades: every 1024 frames the columns
+// move into an ArrowBatch that is exported and released like a consumer would
+void BM_ArrowExportTrades(benchmark::State &state) {
+    BatchColumns batch;
+    int64_t index = 0;
+    run_corpus(state, 10000, [&](std::span<char> frame) {
+        if (index == 1024) {
+            ArrowBatch arrow;
+            arrow.add("frame_index", std::move(batch.trades.frame_index));
+            arrow.add("event_ts", std::move(batch.trades.event_ts));
+            arrow.add("trade_id", std::move(batch.trades.trade_id));
+            arrow.add("price", std::move(batch.trades.price.value));
+            arrow.add("qty", std::move(batch.trades.qty.value));
+            arrow.add_bools("is_buyer_maker", batch.trades.is_buyer_maker);
+            arrow.add_strings("symbol", batch.trades.symbol);
+            ArrowSchema schema;
+            ArrowArray array;
+            arrow.export_schema(&schema);
+            arrow.export_array(&array);
+            benchmark::DoNotOptimize(array.children);
+            array.release(&array);
+            schema.release(&schema);
+            batch = BatchColumns{};
+            index = 0;
+        }
+        decode_frame(frame, index++, batch);
+    });
+}
+
+// decode_frame over frames torn one byte short, so every frame fails on
+// the last check (its symbol) and lands in the error columns
+void BM_DecodeFrameMalformed(benchmark::State &state) {
+    BatchColumns batch;
+    int64_t index = 0;
+    run_corpus(state, static_cast<uint16_t>(state.range(0)), [&](std::span<char> frame) {
+        if (index == 1024) {
+            batch.error_frames.clear();
+            batch.error_causes.clear();
+            index = 0;
+        }
+        decode_frame(frame.first(frame.size() - 1), index++, batch);
+    });
+}
+
+// Kinesis JSON records straight from the frame; the buffer is rewound and
+// the batch cleared whenever it fills up
+void BM_SerializeJson(benchmark::State &state) {
+    std::vector<char> buffer(1 << 20);
+    RecordWriter writer{std::span<char>(buffer)};
+    RecordOptions options;
+    options.ingest_us = 1700000000000000ULL;
+    options.max_records = SIZE_MAX;
+    RecordScratch scratch;
+    RecordBatch batch;
+    int64_t index = 0;
+    run_corpus(state, static_cast<uint16_t>(state.range(0)), [&](std::span<char> frame) {
+        while (serialize_frame(frame, index, options, writer, batch, scratch) == SerializeStatus::Full) {
+            writer.rewind(0);
+            batch.offsets.assign(1, 0);
+            batch.template_id.clear();
+            batch.symbol.clear();
+            batch.error_frames.clear();
+            batch.unknown_frames.clear();
+            index = 0;
+        }
+        ++index;
+    });
+}
+
+// BM_SerializeJson with every record compressed against a dictionary
+// trained on the same corpus; the label is the payload compression ratio
+void BM_SerializeJsonCompressed(benchmark::State &state) {
+    const auto template_id = static_cast<uint16_t>(state.range(0));
+    const Corpus &frames = corpus(template_id);
+    std::vector<char> buffer(1 << 20);
+    RecordWriter writer{std::span<char>(buffer)};
+    RecordOptions options;
+    options.ingest_us = 1700000000000000ULL;
+    options.max_records = SIZE_MAX;
+    options.compress_all = true;
+    RecordScratch scratch;
+    RecordBatch batch;
+    const auto reset = [&] {
+        writer.rewind(0);
+        batch.offsets.assign(1, 0);
+        batch.template_id.clear();
+        batch.symbol.clear();
+        batch.error_frames.clear();
+        batch.unknown_frames.clear();
+    };
+
+    // Uncompressed size of each frame's record, which also feeds the trainer
+    std::vector<char> samples;
+    std::vector<std::size_t> sizes;
+    std::vector<std::size_t> raw_size;
+    for (const auto &stored : frames.frames) {
+        std::vector<char> frame(stored);
+        reset();
+        serialize_frame(frame, 0, options, writer, batch, scratch);
+        samples.insert(samples.end(), writer.written().begin(), writer.written().end());
+        sizes.push_back(writer.size());
+        raw_size.push_back(writer.size());
+    }
+    const auto dictionary = train_record_dictionary(samples, sizes, 16 << 10);
+    RecordCompressor compressor(dictionary);
+    options.compressor = &compressor;
+
+    reset();
+    std::size_t raw_bytes = 0;
+    std::size_t compressed_bytes = 0;
+    std::size_t i = 0;
+    int64_t index = 0;
+    run_corpus(state, template_id, [&](std::span<char> frame) {
+        std::size_t before = writer.size();
+        while (serialize_frame(frame, index, options, writer, batch, scratch) == SerializeStatus::Full) {
+            reset();
+            before = 0;
+            index = 0;
+        }
+        ++index;
+        compressed_bytes += writer.size() - before;
+        raw_bytes += raw_size[i];
+        i = (i + 1) % raw_size.size();
+    });
+    state.SetLabel("ratio " + std::to_string(static_cast<double>(raw_bytes) / static_cast<double>(compressed_bytes)));
+}
+
+// Depth diffs serialized as JSON records (Arg 0) or as delta-encoded top-20
+// records of the book they build (Arg 1), with update IDs renumbered so the
+// book never goes stale; the label is the average wire bytes per frame
+void BM_SerializeDepthDelta(benchmark::State &state) {
+    std::vector<char> buffer(1 << 20);
+    RecordWriter writer{std::span<char>(buffer)};
+    DepthDeltaEncoder encoder;
+    RecordOptions options;
+    options.ingest_us = 1700000000000000ULL;
+    options.max_records = SIZE_MAX;
+    if (state.range(0) == 1) {
+        options.depth_delta = &encoder;
+    }
+    RecordScratch scratch;
+    RecordBatch batch;
+    uint64_t update_id = 1;
+    std::size_t bytes = 0;
+    int64_t index = 0;
+    run_corpus(state, 10003, [&](std::span<char> frame) {
+        // First and last update IDs follow the event time in the fixed block
+        std::memcpy(frame.data() + HEADER_SIZE + 8, &update_id, sizeof(update_id));
+        std::memcpy(frame.data() + HEADER_SIZE + 16, &update_id, sizeof(update_id));
+        ++update_id;
+        std::size_t before = writer.size();
+        while (serialize_frame(frame, index, options, writer, batch, scratch) == SerializeStatus::Full) {
+            writer.rewind(0);
+            batch.offsets.assign(1, 0);
+            batch.template_id.clear();
+            batch.symbol.clear();
+            index = 0;
+            before = 0;
+        }
+        ++index;
+        bytes += writer.size() - before;
+    });
+    state.SetLabel("B/frame " + std::to_string(static_cast<double>(bytes) / static_cast<double>(state.iterations())));
+}
+
+// RecordIngestor over the corpus's JSON records (serialized once up front),
+// one record per iteration; trades and best bid/ask land in rings
+void BM_IngestJson(benchmark::State &state) {
+    std::vector<char> buffer(64 << 20);
+    RecordWriter writer{std::span<char>(buffer)};
+    RecordOptions options;
+    options.ingest_us = 1700000000000000ULL;
+    options.max_records = SIZE_MAX;
+    RecordScratch scratch;
+    RecordBatch batch;
+    int64_t index = 0;
+    for (const auto &stored : corpus(static_cast<uint16_t>(state.range(0))).frames) {
+        std::vector<char> frame(stored);
+        serialize_frame(frame, index++, options, writer, batch, scratch);
+    }
+    RecordIngestor ingestor(1000, {1000, 2000, 10000, 60000}, 0);
+    const std::size_t count = batch.records();
+    std::size_t i = 0;
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        const auto begin = static_cast<std::size_t>(batch.offsets[i]);
+        const auto end = static_cast<std::size_t>(batch.offsets[i + 1]);
+        ingestor.ingest("BTCUSDT", writer.written().subspan(begin, end - begin),
+                        [](std::string_view, std::span<const char>) {});
+        bytes += end - begin;
+        if (++i == count) {
+            i = 0;
+        }
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Whole-window recompute over synthetic price/qty columns (no corpus
+// needed); the label names the kernel simd_level() picked
+void BM_ColumnStats(benchmark::State &state) {
+    const auto n = static_cast<std::size_t>(state.range(0));
+    std::vector<double> price(n), qty(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        price[i] = 65000.0 + static_cast<double>(i % 997) * 0.01;
+        qty[i] = 0.001 * static_cast<double>(i % 89 + 1);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(column_stats(price.data(), qty.data(), n));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(n));
+    state.SetLabel(column_stats_kernel());
+}
+
+// A day of mid prices, ten per second, labelled for the 1/2/10/60 s
+// horizons in one pass
+void BM_ForwardLabels(benchmark::State &state) {
+    constexpr std::size_t rows = 864000;
+    std::vector<int64_t> timestamps(rows);
+    std::vector<double> mids(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+        timestamps[i] = static_cast<int64_t>(i) * 100000;
+        mids[i] = 65000.0 + static_cast<double>((i * 7919) % 997) * 0.01;
+    }
+    const std::vector<int64_t> horizons_us{1000000, 2000000, 10000000, 60000000};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(forward_labels(timestamps.data(), mids.data(), rows, horizons_us));
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+}
+
+// A 100k-row aggTrades archive file: synthetic rows shaped like REST
+// backfill (one symbol, clustered prices), appended and encoded per
+// iteration; the label is the encoded size per row
+void BM_ParquetAggTrades(benchmark::State &state) {
+    constexpr std::size_t rows = 100000;
+    ParquetWriter writer({{"symbol", ParquetType::STRING},
+                          {"event_ts", ParquetType::TIMESTAMP_MS},
+                          {"trade_id", ParquetType::INT64},
+                          {"price", ParquetType::FLOAT64},
+                          {"qty", ParquetType::FLOAT64},
+                          {"is_buyer_maker", ParquetType::BOOL}},
+                         state.range(0) != 0 ? ParquetCompression::ZSTD : ParquetCompression::NONE);
+    std::size_t file_size = 0;
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < rows; ++i) {
+            writer.append_string(0, "BTCUSDT");
+            writer.append_int64(1, 1700000000000 + static_cast<int64_t>(i / 4));
+            writer.append_int64(2, 3000000000 + static_cast<int64_t>(i));
+            writer.append_float64(3, 65000.0 + static_cast<double>(i % 397) * 0.01);
+            writer.append_float64(4, 0.0001 * static_cast<double>(i % 61 + 1));
+            writer.append_bool(5, i % 3 == 0);
+        }
+        file_size = writer.finish().size();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(file_size));
+    state.SetLabel(std::to_string(static_cast<double>(file_size) / rows) + " B/row");
+}
+
+// A 100k-line aggTrades JSONL archive object (as S3BronzeWriter writes it)
+// parsed into columns on state.range(0) threads
+void BM_NdjsonAggTrades(benchmark::State &state) {
+    constexpr std::size_t rows = 100000;
+    std::string data;
+    for (std::size_t i = 0; i < rows; ++i) {
+        data += "{\"symbol\":\"BTCUSDT\",\"event_ts\":" + std::to_string(1700000000000 + i / 4) +
+                ",\"trade_id\":" + std::to_string(3000000000 + i) + ",\"price\":\"" +
+                std::to_string(65000.0 + static_cast<double>(i % 397) * 0.01) + "\",\"qty\":\"" +
+                std::to_string(0.0001 * static_cast<double>(i % 61 + 1)) + "\",\"is_buyer_maker\":" +
+                (i % 3 == 0 ? "true" : "false") + ",\"source\":\"rest\"}\n";
+    }
+    const NdjsonParser parser({{"symbol", ParquetType::STRING},
+                               {"event_ts", ParquetType::TIMESTAMP_MS},
+                               {"trade_id", ParquetType::INT64},
+                               {"price", ParquetType::FLOAT64},
+                               {"qty", ParquetType::FLOAT64},
+                               {"is_buyer_maker", ParquetType::BOOL},
+                               {"source", ParquetType::STRING}});
+    for (auto _ : state) {
+        NdjsonTable table = parser.parse(std::span<const char>(data), static_cast<unsigned>(state.range(0)));
+        benchmark::DoNotOptimize(table.rows);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+}
+
+// 100k aggTrade rows of market_data as binary COPY data: prices and
+// quantities from decimal text, as DataTransformer's Decimals arrive
+void BM_PgCopyAggTrades(benchmark::State &state) {
+    constexpr std::size_t rows = 100000;
+    std::vector<std::string> prices, qtys;
+    for (std::size_t i = 0; i < rows; ++i) {
+        prices.push_back(std::to_string(65000 + i % 397) + "." + std::to_string(10 + i % 89));
+        qtys.push_back("0.000" + std::to_string(1 + i % 61));
+    }
+    PgCopyWriter writer({{"symbol", PgType::TEXT},
+                         {"timestamp", PgType::INT8},
+                         {"price", PgType::NUMERIC},
+                         {"volume", PgType::NUMERIC},
+                         {"trade_id", PgType::INT8},
+                         {"is_buyer_maker", PgType::BOOL},
+                         {"created_at", PgType::TIMESTAMP}});
+    std::size_t size = 0;
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < rows; ++i) {
+            writer.begin_row();
+            writer.text("BTCUSDT");
+            writer.int8(1700000000000 + static_cast<int64_t>(i / 4));
+            writer.numeric_text(prices[i]);
+            writer.numeric_text(qtys[i]);
+            writer.int8(3000000000 + static_cast<int64_t>(i));
+            writer.boolean(i % 3 == 0);
+            writer.timestamp_us(1700000000000000);
+        }
+        size = writer.finish().size();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(size));
+}
+
+// 100k REST price strings ("65123.45000000") into mantissa/exponent pairs
+void BM_ParseDecimals(benchmark::State &state) {
+    constexpr std::size_t rows = 100000;
+    std::vector<std::string> prices;
+    std::size_t bytes = 0;
+    for (std::size_t i = 0; i < rows; ++i) {
+        prices.push_back(std::to_string(65000 + i % 397) + "." + std::to_string(10 + i % 89) + "000000");
+        bytes += prices.back().size();
+    }
+    std::vector<std::string_view> texts(prices.begin(), prices.end());
+    for (auto _ : state) {
+        DecimalTextColumn column = parse_decimal_column(texts);
+        benchmark::DoNotOptimize(column.mantissa.data());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(rows));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+}
+
+// 1M aggTrade IDs captured in 1000-ID pages, one page in 16 lost and a few
+// IDs missing from every 8th: record every page, then plan the backfill
+void BM_IntervalPlan(benchmark::State &state) {
+    constexpr int64_t pages = 1000;
+    constexpr int64_t page_size = 1000;
+    std::vector<std::vector<int64_t>> captured;
+    for (int64_t p = 0; p < pages; ++p) {
+        if (p % 16 == 5) {
+            continue;
+        }
+        std::vector<int64_t> ids;
+        for (int64_t id = p * page_size; id < (p + 1) * page_size; ++id) {
+            if (p % 8 != 3 || id % 97 != 0) {
+                ids.push_back(id);
+            }
+        }
+        captured.push_back(std::move(ids));
+    }
+    std::size_t planned = 0;
+    for (auto _ : state) {
+        IdIntervalSet set;
+        for (const auto &ids : captured) {
+            set.add_ids(ids);
+        }
+        planned = set.plan(0, pages * page_size - 1, 1000).size();
+        benchmark::DoNotOptimize(planned);
+    }
+    state.counters["requests"] = static_cast<double>(planned);
+    state.SetItemsProcessed(state.iterations() * pages * page_size);
+}
+
+constexpr std::array<uint32_t, 4> MLP_SIZES = {48, 64, 32, 1};
+
+// A 64-32-1 MLP over 48 features with uniform synthetic weights
+MlpModel bench_mlp_model(bool quantized) {
+    std::vector<DenseLayer> layers;
+    for (std::size_t l = 0; l + 1 < MLP_SIZES.size(); ++l) {
+        DenseLayer layer;
+        layer.in = MLP_SIZES[l];
+        layer.out = MLP_SIZES[l + 1];
+        layer.activation = l + 2 == MLP_SIZES.size() ? Activation::Identity : Activation::Relu;
+        layer.weights.assign(std::size_t{layer.out} * layer.stride(), 0.0f);
+        for (uint32_t r = 0; r < layer.out; ++r) {
+            for (uint32_t i = 0; i < layer.in; ++i) {
+                layer.weights[r * layer.stride() + i] = 0.01f * static_cast<float>((r * 31 + i * 7) % 19) - 0.09f;
+            }
+        }
+        layer.bias.assign(layer.out, 0.01f);
+        layers.push_back(std::move(layer));
+    }
+    MlpModel model({}, {}, std::move(layers));
+    if (quantized) {
+        model.quantize();
+    }
+    return model;
+}
+
+// One prediction; Arg(1) quantizes to int8
+void BM_MlpPredict(benchmark::State &state) {
+    MlpModel model = bench_mlp_model(state.range(0) != 0);
+    std::vector<float> x(MLP_SIZES.front(), 0.5f);
+    float y = 0;
+    for (auto _ : state) {
+        model.predict(x.data(), &y);
+        benchmark::DoNotOptimize(y);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(std::string(mlp_kernel()) + (state.range(0) != 0 ? "/int8" : "/f32"));
+}
+
+// Arg rows (symbols) predicted together; compare items/s with BM_MlpPredict
+void BM_MlpPredictBatch(benchmark::State &state) {
+    MlpModel model = bench_mlp_model(false);
+    const auto rows = static_cast<std::size_t>(state.range(0));
+    std::vector<float> x(rows * MLP_SIZES.front(), 0.5f);
+    std::vector<float> y(rows);
+    for (auto _ : state) {
+        model.predict_batch(x.data(), rows, y.data());
+        benchmark::DoNotOptimize(y.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    state.SetLabel(mlp_kernel());
+}
+
+} // namespace
+
+BENCHMARK(BM_HeaderParse)->Arg(10000)->Arg(10001)->Arg(10003);
+BENCHMARK(BM_TradeStream);
+BENCHMARK(BM_BestBidAskStream);
+BENCHMARK(BM_DepthStream);
+BENCHMARK(BM_TradeGroupEntries)->Arg(24)->Arg(25);
+BENCHMARK(BM_BookApplyDiffs)->Arg(0)->Arg(1)->Arg(2);
+BENCHMARK(BM_BookSyncReplay);
+BENCHMARK(BM_PublishBook)->Arg(20)->Arg(1000);
+BENCHMARK(BM_BookCheckpoint)->Arg(0)->Arg(1);
+BENCHMARK(BM_WindowCheckpoint)->Arg(0)->Arg(1);
+BENCHMARK(BM_ColumnStatsVariant)->Arg(0)->Arg(1)->Arg(2);
+BENCHMARK(BM_PerfCounterRead);
+BENCHMARK(BM_TraceStamp);
+BENCHMARK(BM_TraceCollectorRecord);
+BENCHMARK(BM_TimerWheelAdvance)->Arg(16)->Arg(1024);
+BENCHMARK(BM_BuildBars)->Arg(0)->Arg(1)->Arg(2)->Arg(3);
+BENCHMARK(BM_DiffKlines);
+BENCHMARK(BM_SymbolStateLookup)->Arg(0)->Arg(1)->Arg(2);
+BENCHMARK(BM_ReadyNotify)->Arg(0)->Arg(1);
+BENCHMARK(BM_RateGovernorReserve);
+BENCHMARK(BM_BackfillPool)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+BENCHMARK(BM_SyntheticStream);
+BENCHMARK(BM_DedupDay)->Arg(0)->Arg(1);
+BENCHMARK(BM_MessageWalk)->Arg(0)->Arg(1);
+BENCHMARK(BM_IngestPipeline)->UseRealTime();
+BENCHMARK(BM_FeedArbiter);
+BENCHMARK(BM_ExchangeLatency);
+BENCHMARK(BM_FeatureHistory)->Arg(0)->Arg(1);
+BENCHMARK(BM_TickStore)->Arg(0)->Arg(1)->Arg(2);
+BENCHMARK(BM_TickRange)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_KinesisPutRecordsRequest);
+BENCHMARK(BM_StreamLoadServer)->UseRealTime();
+BENCHMARK(BM_WsApiEnvelope)->Args({1000, 0})->Args({100000, 0})->Args({100000, 1});
+BENCHMARK(BM_DecodeFrameColumns)->Arg(10000)->Arg(10001)->Arg(10003);
+BENCHMARK(BM_DecodeFrameMalformed)->Arg(10000)->Arg(10001)->Arg(10003);
+BENCHMARK(BM_StageAndDrain)->Arg(10000)->Arg(10001)->Arg(10003);
+BENCHMARK(BM_EventLogAppendRead)->Arg(10000)->Arg(10001)->Arg(10003);
+BENCHMARK(BM_ConflateAndDrain)->Arg(10001)->Arg(10003);
+BENCHMARK(BM_SocketReceive)->Arg(0)->Arg(1);
+BENCHMARK(BM_ArrowExportTrades);
+BENCHMARK(BM_SerializeJson)->Arg(10000)->Arg(10001)->Arg(10003);
+BENCHMARK(BM_SerializeJsonCompressed)->Arg(10003);
+BENCHMARK(BM_SerializeDepthDelta)->Arg(0)->Arg(1);
+BENCHMARK(BM_IngestJson)->Arg(10000)->Arg(10001);
+BENCHMARK(BM_ColumnStats)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_ForwardLabels)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParquetAggTrades)->Arg(0)->Arg(1);
+BENCHMARK(BM_NdjsonAggTrades)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK(BM_PgCopyAggTrades);
+BENCHMARK(BM_ParseDecimals);
+BENCHMARK(BM_IntervalPlan);
+BENCHMARK(BM_MlpPredict)->Arg(0)->Arg(1);
+BENCHMARK(BM_MlpPredictBatch)->Arg(1)->Arg(8)->Arg(32);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+Load test the ingestor with a synthetic SBE stream (synthetic_stream.h).
+
+Two modes:
+  serve   run a StreamLoadServer and print what it sent each second. Point
+          the ingestor's sbe_base_url at the printed ws:// URL and raise
+          --speed until behind_us keeps growing: that is the receiver's
+          saturation point at --speed times the simulated market's rate.
+  decode  feed the frames straight into SBEDecoderPool.decode_batch, no
+          sockets, and report frames/s against the rate the simulation
+          asks for; --speed is the multiple of that rate to aim at.
+
+The simulated market defaults to a busy BTCUSDT minute (--trade-rate,
+--bba-rate, --depth-interval per symbol); --symbols multiplies it.
+
+Usage (after building the extension):
+    python load_stream.py serve [--port N] [--speed X] [--symbols A,B]
+    python load_stream.py decode [--seconds S] [--speed X] [--workers N]
+"""
+
+import argparse
+import os
+import sys
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.dirname(HERE))
+
+import sbe_decoder_cpp  # noqa: E402
+
+
+def make_stream(args) -> 'sbe_decoder_cpp.SyntheticStream':
+    return sbe_decoder_cpp.SyntheticStream(
+        symbols=args.symbols.split(','), seed=args.seed, trade_rate=args.trade_rate, bba_rate=args.bba_rate,
+        depth_interval=args.depth_interval, depth_churn=args.depth_churn,
+        partial_depth_interval=args.partial_depth_interval)
+
+
+def serve(args) -> None:
+    stream = make_stream(args)
+    server = sbe_decoder_cpp.StreamLoadServer(stream, host=args.host, port=args.port, speed=args.speed)
+    server.start()
+    pace = f"{stream.rate * args.speed:,.0f} frames/s" if args.speed > 0 else "unpaced"
+    print(f"serving {pace} on {server.url}; waiting for a client", flush=True)
+    last = server.stats
+    deadline = float('inf')
+    try:
+        while args.seconds == 0 or time.monotonic() < deadline:
+            time.sleep(1.0)
+            stats = server.stats
+            if last['frames_sent'] == 0 and stats['frames_sent'] > 0:
+                deadline = time.monotonic() + args.seconds
+            print(f"clients {stats['clients']:3d}  frames/s {stats['frames_sent'] - last['frames_sent']:>10,}  "
+                  f"MB/s {(stats['bytes_sent'] - last['bytes_sent']) / 1e6:7.1f}  "
+                  f"behind_us {stats['behind_us']:>9,}  max {stats['max_behind_us']:>9,}  "
+                  f"dropped {stats['dropped']}", flush=True)
+            last = stats
+    except KeyboardInterrupt:
+        pass
+    finally:
+        server.stop()
+
+
+def decode(args) -> None:
+    stream = make_stream(args)
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=args.workers)
+    target = stream.rate * args.speed
+    chunk = max(1, int(target / 10))
+    frames = 0
+    start = time.perf_counter()
+    while time.perf_counter() - start < args.seconds:
+        batch = stream.generate(chunk)
+        pool.decode_batch(batch['frames'], batch['offsets'].astype('int64'))
+        frames += chunk
+    elapsed = time.perf_counter() - start
+    achieved = frames / elapsed
+    print(f"decoded {achieved:,.0f} frames/s against a target of {target:,.0f} "
+          f"({achieved / target:.2f}x); generation included")
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('mode', choices=['serve', 'decode'])
+    parser.add_argument('--symbols', default='BTCUSDT')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--trade-rate', type=float, default=50.0, help='trade events per second and symbol')
+    parser.add_argument('--bba-rate', type=float, default=100.0, help='bestBidAsk frames per second and symbol')
+    parser.add_argument('--depth-interval', type=float, default=0.1, help='seconds between depth diffs')
+    parser.add_argument('--depth-churn', type=float, default=20.0, help='mean level changes per depth diff')
+    parser.add_argument('--partial-depth-interval', type=float, default=0.0,
+                        help='seconds between partial depth snapshots (0 = off)')
+    parser.add_argument('--speed', type=float, default=10.0,
+                        help='multiple of the simulated rate (serve: 0 = unpaced)')
+    parser.add_argument('--seconds', type=float, default=10.0, help='run length once the stream starts (0 = forever)')
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=0)
+    parser.add_argument('--workers', type=int, default=0, help='decode mode: SBEDecoderPool workers (0 = per core)')
+    args = parser.parse_args()
+    if args.mode == 'serve':
+        serve(args)
+    else:
+        if args.speed <= 0 or args.seconds <= 0:
+            parser.error('decode needs a positive --speed and --seconds')
+        decode(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+Write the benchmark corpora as capture journals (capture_journal.h format).
+
+The checked-in corpus/ files are synthetic: a seeded random walk of BTCUSDT
+trades (10000), best bid/ask updates (10001) and depth diffs (10003) with
+realistic sizes and burstiness. A real capture from StreamReceiver(
+journal_dir=...) can replace them, or be pointed at with SBE_BENCH_CORPUS;
+the benchmarks only look at template ids.
+
+Usage:
+    python make_corpus.py [--output DIR] [--seed N]
+"""
+
+import argparse
+import os
+import random
+import struct
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+SCHEMA_ID = 1
+SCHEMA_VERSION = 0
+PRICE_EXPONENT = -2
+QTY_EXPONENT = -8
+
+JOURNAL_MAGIC = b'SBEJRNL1'
+JOURNAL_VERSION = 1
+FILE_HEADER = struct.Struct('<8sIIQIIQ24x')
+RECORD_HEADER = struct.Struct('<IHHQQ')
+
+
+def sbe_header(block_length: int, template_id: int) -> bytes:
+    return struct.pack('<HHHH', block_length, template_id, SCHEMA_ID, SCHEMA_VERSION)
+
+
+def symbol_field(symbol: bytes) -> bytes:
+    return struct.pack('<B', len(symbol)) + symbol
+
+
+def trade_frame(event_us: int, trades, symbol: bytes) -> bytes:
+    body = struct.pack('<qqbb', event_us, event_us - 150, PRICE_EXPONENT, QTY_EXPONENT)
+    body += struct.pack('<HI', 25, len(trades))
+    for trade_id, price, qty, maker in trades:
+        body += struct.pack('<qqqB', trade_id, price, qty, maker)
+    return sbe_header(18, 10000) + body + symbol_field(symbol)
+
+
+def best_bid_ask_frame(event_us: int, update_id: int, bid, ask, symbol: bytes) -> bytes:
+    body = struct.pack('<qqbbqqqq', event_us, update_id, PRICE_EXPONENT, QTY_EXPONENT, bid[0], bid[1], ask[0], ask[1])
+    return sbe_header(50, 10001) + body + symbol_field(symbol)
+
+
+def depth_frame(event_us: int, first_id: int, final_id: int, bids, asks, symbol: bytes) -> bytes:
+    body = struct.pack('<qqqbb', event_us, first_id, final_id, PRICE_EXPONENT, QTY_EXPONENT)
+    for levels in (bids, asks):
+        body += struct.pack('<HH', 16, len(levels))
+        for price, qty in levels:
+            body += struct.pack('<qq', price, qty)
+    return sbe_header(26, 10003) + body + symbol_field(symbol)
+
+
+def write_journal(path: str, frames, connection_id: int = 0) -> None:
+    """frames: (received_us, bytes) in receive order."""
+    with open(path, 'wb') as f:
+        f.write(FILE_HEADER.pack(JOURNAL_MAGIC, JOURNAL_VERSION, FILE_HEADER.size, frames[0][0],
+                                 connection_id, 0, 1))
+        for sequence, (received_us, frame) in enumerate(frames):
+            f.write(RECORD_HEADER.pack(len(frame), connection_id, 0, received_us, sequence))
+            f.write(frame)
+            f.write(b'\0' * (-(RECORD_HEADER.size + len(frame)) % 8))
+
+
+def generate(rng: random.Random, count: int):
+    """Three streams of `count` frames sharing one random-walk mid price."""
+    symbol = b'BTCUSDT'
+    clock_us = 1_700_000_000_000_000
+    mid = 6_500_000  # 65000.00
+    trade_id = 1_000_000
+    update_id = 50_000_000
+    trades, quotes, depth = [], [], []
+
+    while min(len(trades), len(quotes), len(depth)) < count:
+        # Bursty arrivals: mostly sub-millisecond gaps, occasional quiet spells
+        clock_us += int(rng.expovariate(1 / 300)) if rng.random() < 0.95 else rng.randint(5_000, 50_000)
+        mid += rng.choice((-1, 0, 0, 1))
+        kind = rng.random()
+
+        if kind < 0.45 and len(trades) < count:
+            # Aggregated prints: usually one, sometimes a sweep of several
+            size = 1 if rng.random() < 0.8 else rng.randint(2, 12)
+            entries = []
+            for _ in range(size):
+                trade_id += 1
+                entries.append((trade_id, mid + rng.randint(-3, 3), rng.randint(1, 5_000_000), rng.random() < 0.5))
+            trades.append((clock_us, trade_frame(clock_us - 800, entries, symbol)))
+        elif kind < 0.8 and len(quotes) < count:
+            update_id += 1
+            quotes.append((clock_us, best_bid_ask_frame(clock_us - 500, update_id, (mid - 1, rng.randint(1, 10**8)),
+                                                        (mid + 1, rng.randint(1, 10**8)), symbol)))
+        elif len(depth) < count:
+            first = update_id + 1
+            update_id += rng.randint(1, 40)
+
+            def side(sign):
+                levels = sorted({mid + sign * rng.randint(1, 500) for _ in range(rng.randint(1, 20))},
+                                reverse=sign < 0)
+                return [(price, 0 if rng.random() < 0.2 else rng.randint(1, 10**9)) for price in levels]
+
+            depth.append((clock_us, depth_frame(clock_us - 700, first, update_id, side(-1), side(1), symbol)))
+    return trades, quotes, depth
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--output', default=os.path.join(HERE, 'corpus'))
+    parser.add_argument('--seed', type=int, default=20240101)
+    parser.add_argument('--count', type=int, default=1000, help='frames per template')
+    args = parser.parse_args(argv)
+
+    os.makedirs(args.output, exist_ok=True)
+    trades, quotes, depth = generate(random.Random(args.seed), args.count)
+    for name, frames in (('trade', trades), ('best_bid_ask', quotes), ('depth_diff', depth)):
+        path = os.path.join(args.output, f'{name}.sbej')
+        write_journal(path, frames)
+        print(f'{path}: {len(frames)} frames, {sum(len(f) for _, f in frames)} bytes')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
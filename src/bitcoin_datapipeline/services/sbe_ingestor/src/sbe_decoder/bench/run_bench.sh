@@ -0,0 +1,54 @@
+#!/bin/bash
+# Build and run the sbe_decoder_cpp benchmarks.
+#
+# bench_decoder (Google Benchmark) times the native hot paths over the
+# capture-journal corpora in bench/corpus; bench_boundary.py times the
+# pybind11 calls when the extension has been built. Extra arguments go to
+# bench_decoder, e.g. --benchmark_filter=Depth or --benchmark_format=json.
+# Set SBE_BENCH_CORPUS to benchmark a real capture directory instead.
+#
+# Requires Google Benchmark (libbenchmark-dev).
+
+set -e  # Exit on any error
+
+BENCH_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+DECODER_DIR="$(dirname "$BENCH_DIR")"
+BUILD_DIR="${BENCH_BUILD_DIR:-$BENCH_DIR/build}"
+CXX="${CXX:-c++}"
+
+echo "🔧 Building sbe_decoder benchmarks..."
+mkdir -p "$BUILD_DIR"
+# Same optimization flags and baseline ISA as the extension (setup.py); the
+# SIMD kernels pick their variant at run time, SBE_DECODER_SIMD caps it
+if [[ -n "$SBE_DECODER_MARCH" ]]; then
+    ARCH_FLAGS="-march=$SBE_DECODER_MARCH"
+else
+    case "$(uname -m)" in
+        x86_64|amd64) ARCH_FLAGS="-msse4.2 -mpopcnt" ;;
+        aarch64|arm64) ARCH_FLAGS="-march=armv8-a" ;;
+        *) ARCH_FLAGS="" ;;
+    esac
+fi
+"$CXX" -std=c++20 -O3 $ARCH_FLAGS -ffast-math -DNDEBUG -Wall \
+    -DBENCH_CORPUS_DIR="\"$BENCH_DIR/corpus\"" \
+    -I"$DECODER_DIR/src" -I"$DECODER_DIR/include" \
+    -I"$DECODER_DIR/include/spot_sbe" -I"$DECODER_DIR/include/official" \
+    "$BENCH_DIR/bench_decoder.cpp" -o "$BUILD_DIR/bench_decoder" \
+    -lbenchmark -lssl -lcrypto -lzstd -pthread
+
+echo "🏁 Native hot paths"
+"$BUILD_DIR/bench_decoder" "$@"
+
+if [[ "$VIRTUAL_ENV" != "" ]]; then
+    PYTHON_CMD="$VIRTUAL_ENV/bin/python"
+else
+    PYTHON_CMD="python3"
+fi
+
+echo ""
+if (cd "$DECODER_DIR" && "$PYTHON_CMD" -c "import sbe_decoder_cpp" 2>/dev/null); then
+    echo "🏁 pybind11 boundary"
+    "$PYTHON_CMD" "$BENCH_DIR/bench_boundary.py"
+else
+    echo "⚠️  sbe_decoder_cpp not built; skipping bench_boundary.py (run ./build_sbe_decoder.sh first)"
+fi
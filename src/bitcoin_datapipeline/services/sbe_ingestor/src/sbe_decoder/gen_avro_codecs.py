@@ -0,0 +1,220 @@
+#!/usr/bin/env python3
+"""
+Generate C++ Avro binary codecs from the pipeline's .avsc schemas.
+
+Each record schema becomes a struct in namespace avro_gen with its
+CRC-64-AVRO fingerprint, plus inline encode()/decode() functions that
+write and read the fields in schema order with the avro_binary.h
+primitives, and a visit_fields() hook for generic conversions. Run by
+setup.py whenever the schema directory is present; the output is checked
+in so builds from the service directory alone (e.g. the Docker image) use
+the last generated copy.
+
+Usage:
+    python gen_avro_codecs.py [--schemas DIR] [--output FILE]
+"""
+
+import argparse
+import json
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_SCHEMA_DIR = os.path.normpath(os.path.join(HERE, '..', '..', '..', '..', 'schemas', 'avro'))
+DEFAULT_OUTPUT = os.path.join(HERE, 'src', 'avro_codecs.h')
+
+# Schemas compiled into the extension, in output order
+SCHEMAS = ['MarketTrade.avsc', 'BestBidAsk.avsc', 'DepthDelta.avsc']
+
+PRIMITIVES = {
+    'string': ('std::string_view', 'avro_write_string', 'read_string'),
+    'long': ('int64_t', 'avro_write_long', 'read_long'),
+    'int': ('int32_t', 'avro_write_int', 'read_int'),
+    'double': ('double', 'avro_write_double', 'read_double'),
+    'float': ('float', 'avro_write_float', 'read_float'),
+    'boolean': ('bool', 'avro_write_boolean', 'read_boolean'),
+}
+
+DEFAULTS = {'int64_t': ' = 0', 'int32_t': ' = 0', 'double': ' = 0.0', 'float': ' = 0.0f', 'bool': ' = false'}
+
+
+def canonical_form(schema, namespace=None):
+    """Avro Parsing Canonical Form of the (record, array, primitive) subset used here."""
+    if isinstance(schema, str):
+        return json.dumps(schema)
+    kind = schema['type']
+    if kind in PRIMITIVES and len(schema) == 1:
+        return json.dumps(kind)
+    if kind == 'array':
+        return '{"type":"array","items":%s}' % canonical_form(schema['items'], namespace)
+    if kind == 'record':
+        name = schema['name']
+        namespace = schema.get('namespace', namespace)
+        fullname = name if '.' in name or not namespace else f'{namespace}.{name}'
+        fields = ','.join(
+            '{"name":%s,"type":%s}' % (json.dumps(field['name']), canonical_form(field['type'], namespace))
+            for field in schema['fields']
+        )
+        return '{"name":%s,"type":"record","fields":[%s]}' % (json.dumps(fullname), fields)
+    raise ValueError(f'unsupported Avro type: {schema!r}')
+
+
+def crc64_avro(data: bytes) -> int:
+    """64-bit Rabin fingerprint as defined by the Avro specification."""
+    empty = 0xc15d213aa4d7a795
+    table = []
+    for i in range(256):
+        fp = i
+        for _ in range(8):
+            fp = (fp >> 1) ^ (empty & -(fp & 1))
+        table.append(fp)
+    fp = empty
+    for byte in data:
+        fp = (fp >> 8) ^ table[(fp ^ byte) & 0xff]
+    return fp
+
+
+def cpp_type(schema) -> str:
+    if isinstance(schema, str):
+        return PRIMITIVES[schema][0]
+    if schema['type'] == 'array':
+        return f'std::vector<{cpp_type(schema["items"])}>'
+    if schema['type'] in PRIMITIVES:
+        return PRIMITIVES[schema['type']][0]
+    raise ValueError(f'unsupported field type: {schema!r}')
+
+
+def write_expr(schema, value: str, depth: int) -> str:
+    if isinstance(schema, dict) and schema['type'] == 'array':
+        item = f'item{depth}'
+        inner = write_expr(schema['items'], item, depth + 1)
+        return f'avro_write_array(writer, {value}, [&](const auto &{item}) {{ {inner}; }})'
+    name = schema if isinstance(schema, str) else schema['type']
+    return f'{PRIMITIVES[name][1]}(writer, {value})'
+
+
+def read_stmt(schema, target: str, depth: int) -> str:
+    if isinstance(schema, dict) and schema['type'] == 'array':
+        item = f'item{depth}'
+        inner = read_stmt(schema['items'], f'{item}', depth + 1)
+        return (f'{target}.clear(); reader.read_array([&] {{ auto &{item} = {target}.emplace_back(); '
+                f'{inner}; }})')
+    name = schema if isinstance(schema, str) else schema['type']
+    return f'{target} = reader.{PRIMITIVES[name][2]}()'
+
+
+def generate_record(schema) -> str:
+    if schema.get('type') != 'record':
+        raise ValueError(f'{schema.get("name")}: top-level schema must be a record')
+    name = schema['name']
+    canonical = canonical_form(schema)
+    fingerprint = crc64_avro(canonical.encode('utf-8'))
+
+    lines = []
+    doc = schema.get('doc')
+    if doc:
+        lines.append(f'// {doc}')
+    lines.append(f'struct {name} {{')
+    lines.append(f'    static constexpr std::string_view SCHEMA_NAME = "{json.loads(canonical)["name"]}";')
+    lines.append(f'    static constexpr uint64_t FINGERPRINT = 0x{fingerprint:016x}ULL;')
+    lines.append('')
+    for field in schema['fields']:
+        ctype = cpp_type(field['type'])
+        lines.append(f'    {ctype} {field["name"]}{DEFAULTS.get(ctype, "")};')
+    lines.append('};')
+    lines.append('')
+
+    lines.append(f'inline void encode(RecordWriter &writer, const {name} &record) {{')
+    lines.append(f'    avro_write_header(writer, {name}::FINGERPRINT);')
+    for field in schema['fields']:
+        lines.append(f'    {write_expr(field["type"], "record." + field["name"], 0)};')
+    lines.append('}')
+    lines.append('')
+
+    lines.append('// Body only: the single-object header has already been read')
+    lines.append(f'inline void decode(AvroReader &reader, {name} &record) {{')
+    for field in schema['fields']:
+        lines.append(f'    {read_stmt(field["type"], "record." + field["name"], 0)};')
+    lines.append('}')
+    lines.append('')
+
+    lines.append('template <typename Fn>')
+    lines.append(f'void visit_fields(const {name} &record, Fn &&fn) {{')
+    for field in schema['fields']:
+        lines.append(f'    fn("{field["name"]}", record.{field["name"]});')
+    lines.append('}')
+    return '\n'.join(lines)
+
+
+def generate(schema_dir: str) -> str:
+    records = []
+    names = []
+    for filename in SCHEMAS:
+        with open(os.path.join(schema_dir, filename)) as f:
+            schema = json.load(f)
+        records.append(generate_record(schema))
+        names.append(schema['name'])
+
+    dispatch = ['// Read a single-object payload and call fn(record) with the decoded record.',
+                '// Returns false for fingerprints of schemas not compiled in.',
+                'template <typename Fn>',
+                'bool decode_single_object(std::span<const char> payload, Fn &&fn) {',
+                '    AvroReader reader{payload};',
+                '    const uint64_t fingerprint = reader.read_header();']
+    for name in names:
+        dispatch += [f'    if (fingerprint == {name}::FINGERPRINT) {{',
+                     f'        {name} record;',
+                     '        decode(reader, record);',
+                     '        fn(record);',
+                     '        return true;',
+                     '    }']
+    dispatch += ['    return false;', '}']
+
+    sources = ', '.join(SCHEMAS)
+    return f'''/*
+ * Avro codecs for {sources}.
+ *
+ * GENERATED by gen_avro_codecs.py from schemas/avro -- do not edit by hand.
+ */
+
+#ifndef _SBE_AVRO_CODECS_H_
+#define _SBE_AVRO_CODECS_H_
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "avro_binary.h"
+
+namespace avro_gen {{
+
+{(chr(10) * 2).join(records)}
+
+{chr(10).join(dispatch)}
+
+}} // namespace avro_gen
+
+#endif
+'''
+
+
+def main(argv=None) -> int:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--schemas', default=DEFAULT_SCHEMA_DIR)
+    parser.add_argument('--output', default=DEFAULT_OUTPUT)
+    args = parser.parse_args(argv)
+
+    code = generate(args.schemas)
+    if os.path.exists(args.output):
+        with open(args.output) as f:
+            if f.read() == code:
+                return 0
+    with open(args.output, 'w') as f:
+        f.write(code)
+    print(f'generated {args.output}')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
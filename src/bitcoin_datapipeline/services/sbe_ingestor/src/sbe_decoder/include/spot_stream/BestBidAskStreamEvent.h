@@ -0,0 +1,72 @@
+/* SBE (Simple Binary Encoding) message codec for the market-data stream schema (stream_1_0.xml) */
+#ifndef _SPOT_STREAM_BESTBIDASKSTREAMEVENT_CXX_H_
+#define _SPOT_STREAM_BESTBIDASKSTREAMEVENT_CXX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+
+#include "StreamCodec.h"
+
+namespace spot_stream {
+
+// <bestBidAsk> stream, template 10001: top of book, then the symbol
+class BestBidAskStreamEvent {
+public:
+    static constexpr std::uint16_t SBE_BLOCK_LENGTH = 50;
+    static constexpr std::uint16_t SBE_TEMPLATE_ID = 10001;
+
+    static constexpr std::size_t EVENT_TIME_OFFSET = 0;
+    static constexpr std::size_t BOOK_UPDATE_ID_OFFSET = 8;
+    static constexpr std::size_t PRICE_EXPONENT_OFFSET = 16;
+    static constexpr std::size_t QTY_EXPONENT_OFFSET = 17;
+    static constexpr std::size_t BID_PRICE_OFFSET = 18;
+    static constexpr std::size_t BID_QTY_OFFSET = 26;
+    static constexpr std::size_t ASK_PRICE_OFFSET = 34;
+    static constexpr std::size_t ASK_QTY_OFFSET = 42;
+    static_assert(ASK_QTY_OFFSET + sizeof(std::int64_t) == SBE_BLOCK_LENGTH);
+
+    // `buffer` starts just past the message header; `actingBlockLength` is
+    // the header's blockLength. Wraps the symbol too.
+    DecodeError wrapForDecode(const char *buffer, std::uint64_t bufferLength,
+                              std::uint16_t actingBlockLength) noexcept {
+        if (bufferLength < std::max(actingBlockLength, SBE_BLOCK_LENGTH)) [[unlikely]] {
+            return DecodeError::ShortBlock;
+        }
+        m_buffer = buffer;
+        std::uint64_t position = std::max(actingBlockLength, SBE_BLOCK_LENGTH);
+        if (const DecodeError error = decodeVarString8(buffer, position, bufferLength, m_symbol);
+            error != DecodeError::None) [[unlikely]] {
+            return error;
+        }
+        m_encodedLength = position;
+        return DecodeError::None;
+    }
+
+    static constexpr std::uint16_t sbeBlockLength() noexcept { return SBE_BLOCK_LENGTH; }
+    static constexpr std::uint16_t sbeTemplateId() noexcept { return SBE_TEMPLATE_ID; }
+
+    // utcTimestampUs
+    std::int64_t eventTime() const noexcept { return load<std::int64_t>(m_buffer + EVENT_TIME_OFFSET); }
+    std::int64_t bookUpdateId() const noexcept { return load<std::int64_t>(m_buffer + BOOK_UPDATE_ID_OFFSET); }
+    std::int8_t priceExponent() const noexcept { return load<std::int8_t>(m_buffer + PRICE_EXPONENT_OFFSET); }
+    std::int8_t qtyExponent() const noexcept { return load<std::int8_t>(m_buffer + QTY_EXPONENT_OFFSET); }
+    std::int64_t bidPrice() const noexcept { return load<std::int64_t>(m_buffer + BID_PRICE_OFFSET); }
+    std::int64_t bidQty() const noexcept { return load<std::int64_t>(m_buffer + BID_QTY_OFFSET); }
+    std::int64_t askPrice() const noexcept { return load<std::int64_t>(m_buffer + ASK_PRICE_OFFSET); }
+    std::int64_t askQty() const noexcept { return load<std::int64_t>(m_buffer + ASK_QTY_OFFSET); }
+
+    // Empty when the frame ends before the symbol
+    std::string_view getSymbolAsStringView() const noexcept { return m_symbol; }
+    // Bytes from the start of the block through the symbol
+    std::uint64_t encodedLength() const noexcept { return m_encodedLength; }
+
+private:
+    const char *m_buffer = nullptr;
+    std::string_view m_symbol;
+    std::uint64_t m_encodedLength = 0;
+};
+
+} // namespace spot_stream
+
+#endif
@@ -0,0 +1,78 @@
+/* SBE (Simple Binary Encoding) message codec for the market-data stream schema (stream_1_0.xml) */
+#ifndef _SPOT_STREAM_DEPTHSNAPSHOTSTREAMEVENT_CXX_H_
+#define _SPOT_STREAM_DEPTHSNAPSHOTSTREAMEVENT_CXX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+
+#include "StreamCodec.h"
+
+namespace spot_stream {
+
+// <depth<N>@100ms> stream, template 10002: the top N levels of the book as
+// of bookUpdateId, then the symbol
+class DepthSnapshotStreamEvent {
+public:
+    static constexpr std::uint16_t SBE_BLOCK_LENGTH = 18;
+    static constexpr std::uint16_t SBE_TEMPLATE_ID = 10002;
+
+    static constexpr std::size_t EVENT_TIME_OFFSET = 0;
+    static constexpr std::size_t BOOK_UPDATE_ID_OFFSET = 8;
+    static constexpr std::size_t PRICE_EXPONENT_OFFSET = 16;
+    static constexpr std::size_t QTY_EXPONENT_OFFSET = 17;
+    static_assert(QTY_EXPONENT_OFFSET + sizeof(std::int8_t) == SBE_BLOCK_LENGTH);
+
+    // `buffer` starts just past the message header; `actingBlockLength` is
+    // the header's blockLength. Wraps both level groups and the symbol too.
+    DecodeError wrapForDecode(const char *buffer, std::uint64_t bufferLength,
+                              std::uint16_t actingBlockLength) noexcept {
+        if (bufferLength < std::max(actingBlockLength, SBE_BLOCK_LENGTH)) [[unlikely]] {
+            return DecodeError::ShortBlock;
+        }
+        m_buffer = buffer;
+        std::uint64_t position = std::max(actingBlockLength, SBE_BLOCK_LENGTH);
+        // Groups and var data in schema order: bids, asks, symbol
+        if (const DecodeError error = m_bids.wrapForDecode(buffer, position, bufferLength);
+            error != DecodeError::None) [[unlikely]] {
+            return error;
+        }
+        if (const DecodeError error = m_asks.wrapForDecode(buffer, position, bufferLength);
+            error != DecodeError::None) [[unlikely]] {
+            return error;
+        }
+        if (const DecodeError error = decodeVarString8(buffer, position, bufferLength, m_symbol);
+            error != DecodeError::None) [[unlikely]] {
+            return error;
+        }
+        m_encodedLength = position;
+        return DecodeError::None;
+    }
+
+    static constexpr std::uint16_t sbeBlockLength() noexcept { return SBE_BLOCK_LENGTH; }
+    static constexpr std::uint16_t sbeTemplateId() noexcept { return SBE_TEMPLATE_ID; }
+
+    // utcTimestampUs
+    std::int64_t eventTime() const noexcept { return load<std::int64_t>(m_buffer + EVENT_TIME_OFFSET); }
+    std::int64_t bookUpdateId() const noexcept { return load<std::int64_t>(m_buffer + BOOK_UPDATE_ID_OFFSET); }
+    std::int8_t priceExponent() const noexcept { return load<std::int8_t>(m_buffer + PRICE_EXPONENT_OFFSET); }
+    std::int8_t qtyExponent() const noexcept { return load<std::int8_t>(m_buffer + QTY_EXPONENT_OFFSET); }
+
+    const PriceLevels &bids() const noexcept { return m_bids; }
+    const PriceLevels &asks() const noexcept { return m_asks; }
+    // Empty when the frame ends before the symbol
+    std::string_view getSymbolAsStringView() const noexcept { return m_symbol; }
+    // Bytes from the start of the block through the symbol
+    std::uint64_t encodedLength() const noexcept { return m_encodedLength; }
+
+private:
+    const char *m_buffer = nullptr;
+    PriceLevels m_bids;
+    PriceLevels m_asks;
+    std::string_view m_symbol;
+    std::uint64_t m_encodedLength = 0;
+};
+
+} // namespace spot_stream
+
+#endif
@@ -0,0 +1,161 @@
+/* SBE (Simple Binary Encoding) codec support for the market-data stream schema (stream_1_0.xml) */
+#ifndef _SPOT_STREAM_STREAMCODEC_CXX_H_
+#define _SPOT_STREAM_STREAMCODEC_CXX_H_
+
+/*
+ * Shared pieces of the spot_stream flyweights: schema constants, unaligned
+ * little-endian loads and the repeating-group flyweight.
+ *
+ * The codecs follow the sbe-tool decoder API (wrapForDecode, sbeBlockLength,
+ * count/forEach on groups, getXAsStringView on var data) but every field
+ * sits at a constexpr offset: wrapForDecode checks the fixed block and each
+ * group's extent once, after which a field read is a single unaligned load.
+ * Checks return a DecodeError rather than throwing, so a malformed frame
+ * costs one predictable branch instead of an unwind.
+ */
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace spot_stream {
+
+static_assert(std::endian::native == std::endian::little, "spot_stream codecs load little-endian fields directly");
+
+constexpr std::uint16_t SBE_SCHEMA_ID = 1;
+constexpr std::uint16_t SBE_SCHEMA_VERSION = 0;
+
+template <typename T>
+inline T load(const char *at) noexcept {
+    T value;
+    std::memcpy(&value, at, sizeof(T));
+    return value;
+}
+
+// Why wrapForDecode rejected a buffer
+enum class DecodeError : std::uint8_t {
+    None = 0,
+    ShortBlock,     // shorter than the fixed block
+    GroupHeader,    // a group's dimensions run past the buffer
+    GroupEntrySize, // a group's entries are shorter than the schema allows
+    GroupOverrun,   // a group's entries run past the buffer
+    VarDataOverrun, // a var-data field runs past the buffer
+};
+
+// groupSizeEncoding: uint16 blockLength, uint32 numInGroup
+struct GroupSizeEncoding {
+    using Count = std::uint32_t;
+    static constexpr std::size_t BLOCK_LENGTH_OFFSET = 0;
+    static constexpr std::size_t NUM_IN_GROUP_OFFSET = 2;
+    static constexpr std::size_t ENCODED_LENGTH = 6;
+};
+
+// groupSize16Encoding: uint16 blockLength, uint16 numInGroup
+struct GroupSize16Encoding {
+    using Count = std::uint16_t;
+    static constexpr std::size_t BLOCK_LENGTH_OFFSET = 0;
+    static constexpr std::size_t NUM_IN_GROUP_OFFSET = 2;
+    static constexpr std::size_t ENCODED_LENGTH = 4;
+};
+
+static_assert(GroupSizeEncoding::NUM_IN_GROUP_OFFSET + sizeof(GroupSizeEncoding::Count) ==
+              GroupSizeEncoding::ENCODED_LENGTH);
+static_assert(GroupSize16Encoding::NUM_IN_GROUP_OFFSET + sizeof(GroupSize16Encoding::Count) ==
+              GroupSize16Encoding::ENCODED_LENGTH);
+
+// A repeating group whose entries are `Entry` flyweights. Entries are
+// `actingBlockLength()` apart, which may exceed Entry::SBE_BLOCK_LENGTH when
+// a newer schema version appends fields; it may also be shorter (down to
+// Entry::SBE_MIN_BLOCK_LENGTH) when trailing optional fields are absent.
+template <typename Dimensions, typename Entry>
+class Group {
+public:
+    using Count = typename Dimensions::Count;
+
+    // Wrap the group whose dimensions start at `position`, and advance
+    // `position` past its entries
+    DecodeError wrapForDecode(const char *buffer, std::uint64_t &position, std::uint64_t bufferLength) noexcept {
+        if (position + Dimensions::ENCODED_LENGTH > bufferLength) [[unlikely]] {
+            return DecodeError::GroupHeader;
+        }
+        const char *dimensions = buffer + position;
+        m_blockLength = load<std::uint16_t>(dimensions + Dimensions::BLOCK_LENGTH_OFFSET);
+        m_count = load<Count>(dimensions + Dimensions::NUM_IN_GROUP_OFFSET);
+        if (m_count > 0 && m_blockLength < Entry::SBE_MIN_BLOCK_LENGTH) [[unlikely]] {
+            return DecodeError::GroupEntrySize;
+        }
+        m_offset = position + Dimensions::ENCODED_LENGTH;
+        m_buffer = buffer;
+        position = m_offset + static_cast<std::uint64_t>(m_count) * m_blockLength;
+        if (position > bufferLength) [[unlikely]] {
+            return DecodeError::GroupOverrun;
+        }
+        return DecodeError::None;
+    }
+
+    Count count() const noexcept { return m_count; }
+    std::uint16_t actingBlockLength() const noexcept { return m_blockLength; }
+    // First entry, relative to the buffer passed to wrapForDecode
+    std::uint64_t offset() const noexcept { return m_offset; }
+
+    Entry operator[](std::size_t index) const noexcept {
+        return Entry(m_buffer + m_offset + index * m_blockLength, m_blockLength);
+    }
+
+    template <typename Func>
+    void forEach(Func &&func) const {
+        const char *entry = m_buffer + m_offset;
+        for (Count i = 0; i < m_count; ++i, entry += m_blockLength) {
+            func(Entry(entry, m_blockLength));
+        }
+    }
+
+private:
+    const char *m_buffer = nullptr;
+    std::uint64_t m_offset = 0;
+    std::uint16_t m_blockLength = 0;
+    Count m_count = 0;
+};
+
+// varString8 at `position` into `value`: uint8 length then the bytes.
+// Empty when the buffer ends first; advances `position` past the string.
+inline DecodeError decodeVarString8(const char *buffer, std::uint64_t &position, std::uint64_t bufferLength,
+                                    std::string_view &value) noexcept {
+    if (position >= bufferLength) {
+        value = {};
+        return DecodeError::None;
+    }
+    const auto length = load<std::uint8_t>(buffer + position);
+    if (position + 1 + length > bufferLength) [[unlikely]] {
+        return DecodeError::VarDataOverrun;
+    }
+    value = std::string_view(buffer + position + 1, length);
+    position += 1 + length;
+    return DecodeError::None;
+}
+
+// [price, qty] entry of the depth groups (groupSize16Encoding)
+class PriceLevel {
+public:
+    static constexpr std::uint16_t SBE_BLOCK_LENGTH = 16;
+    static constexpr std::uint16_t SBE_MIN_BLOCK_LENGTH = SBE_BLOCK_LENGTH;
+    static constexpr std::size_t PRICE_OFFSET = 0;
+    static constexpr std::size_t QTY_OFFSET = 8;
+    static_assert(QTY_OFFSET + sizeof(std::int64_t) == SBE_BLOCK_LENGTH);
+
+    PriceLevel(const char *entry, std::uint16_t) noexcept : m_entry(entry) {}
+
+    std::int64_t price() const noexcept { return load<std::int64_t>(m_entry + PRICE_OFFSET); }
+    std::int64_t qty() const noexcept { return load<std::int64_t>(m_entry + QTY_OFFSET); }
+
+private:
+    const char *m_entry;
+};
+
+using PriceLevels = Group<GroupSize16Encoding, PriceLevel>;
+
+} // namespace spot_stream
+
+#endif
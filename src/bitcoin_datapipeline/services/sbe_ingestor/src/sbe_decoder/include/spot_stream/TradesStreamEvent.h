@@ -0,0 +1,102 @@
+/* SBE (Simple Binary Encoding) message codec for the market-data stream schema (stream_1_0.xml) */
+#ifndef _SPOT_STREAM_TRADESSTREAMEVENT_CXX_H_
+#define _SPOT_STREAM_TRADESSTREAMEVENT_CXX_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+
+#include "StreamCodec.h"
+
+namespace spot_stream {
+
+// <trade> stream, template 10000: one or more trades executed at the same
+// transact time, then the symbol
+class TradesStreamEvent {
+public:
+    static constexpr std::uint16_t SBE_BLOCK_LENGTH = 18;
+    static constexpr std::uint16_t SBE_TEMPLATE_ID = 10000;
+
+    static constexpr std::size_t EVENT_TIME_OFFSET = 0;
+    static constexpr std::size_t TRANSACT_TIME_OFFSET = 8;
+    static constexpr std::size_t PRICE_EXPONENT_OFFSET = 16;
+    static constexpr std::size_t QTY_EXPONENT_OFFSET = 17;
+    static_assert(QTY_EXPONENT_OFFSET + sizeof(std::int8_t) == SBE_BLOCK_LENGTH);
+
+    class Trade {
+    public:
+        static constexpr std::uint16_t SBE_BLOCK_LENGTH = 25;
+        // isBuyerMaker is the only field a shorter entry may leave out
+        static constexpr std::uint16_t SBE_MIN_BLOCK_LENGTH = 24;
+        static constexpr std::size_t ID_OFFSET = 0;
+        static constexpr std::size_t PRICE_OFFSET = 8;
+        static constexpr std::size_t QTY_OFFSET = 16;
+        static constexpr std::size_t IS_BUYER_MAKER_OFFSET = 24;
+        static_assert(IS_BUYER_MAKER_OFFSET == SBE_MIN_BLOCK_LENGTH);
+        static_assert(IS_BUYER_MAKER_OFFSET + sizeof(std::uint8_t) == SBE_BLOCK_LENGTH);
+
+        Trade(const char *entry, std::uint16_t actingBlockLength) noexcept
+            : m_entry(entry), m_actingBlockLength(actingBlockLength) {}
+
+        std::int64_t id() const noexcept { return load<std::int64_t>(m_entry + ID_OFFSET); }
+        std::int64_t price() const noexcept { return load<std::int64_t>(m_entry + PRICE_OFFSET); }
+        std::int64_t qty() const noexcept { return load<std::int64_t>(m_entry + QTY_OFFSET); }
+        // BoolEnum; false when the entry is too short to carry it
+        bool isBuyerMaker() const noexcept {
+            return m_actingBlockLength > IS_BUYER_MAKER_OFFSET &&
+                   load<std::uint8_t>(m_entry + IS_BUYER_MAKER_OFFSET) == 1;
+        }
+
+    private:
+        const char *m_entry;
+        std::uint16_t m_actingBlockLength;
+    };
+
+    using Trades = Group<GroupSizeEncoding, Trade>;
+
+    // `buffer` starts just past the message header; `actingBlockLength` is
+    // the header's blockLength. Wraps the trades group and the symbol too.
+    DecodeError wrapForDecode(const char *buffer, std::uint64_t bufferLength,
+                              std::uint16_t actingBlockLength) noexcept {
+        if (bufferLength < std::max(actingBlockLength, SBE_BLOCK_LENGTH)) [[unlikely]] {
+            return DecodeError::ShortBlock;
+        }
+        m_buffer = buffer;
+        std::uint64_t position = std::max(actingBlockLength, SBE_BLOCK_LENGTH);
+        if (const DecodeError error = m_trades.wrapForDecode(buffer, position, bufferLength);
+            error != DecodeError::None) [[unlikely]] {
+            return error;
+        }
+        if (const DecodeError error = decodeVarString8(buffer, position, bufferLength, m_symbol);
+            error != DecodeError::None) [[unlikely]] {
+            return error;
+        }
+        m_encodedLength = position;
+        return DecodeError::None;
+    }
+
+    static constexpr std::uint16_t sbeBlockLength() noexcept { return SBE_BLOCK_LENGTH; }
+    static constexpr std::uint16_t sbeTemplateId() noexcept { return SBE_TEMPLATE_ID; }
+
+    // utcTimestampUs
+    std::int64_t eventTime() const noexcept { return load<std::int64_t>(m_buffer + EVENT_TIME_OFFSET); }
+    std::int64_t transactTime() const noexcept { return load<std::int64_t>(m_buffer + TRANSACT_TIME_OFFSET); }
+    std::int8_t priceExponent() const noexcept { return load<std::int8_t>(m_buffer + PRICE_EXPONENT_OFFSET); }
+    std::int8_t qtyExponent() const noexcept { return load<std::int8_t>(m_buffer + QTY_EXPONENT_OFFSET); }
+
+    const Trades &trades() const noexcept { return m_trades; }
+    // Empty when the frame ends before the symbol
+    std::string_view getSymbolAsStringView() const noexcept { return m_symbol; }
+    // Bytes from the start of the block through the symbol
+    std::uint64_t encodedLength() const noexcept { return m_encodedLength; }
+
+private:
+    const char *m_buffer = nullptr;
+    Trades m_trades;
+    std::string_view m_symbol;
+    std::uint64_t m_encodedLength = 0;
+};
+
+} // namespace spot_stream
+
+#endif
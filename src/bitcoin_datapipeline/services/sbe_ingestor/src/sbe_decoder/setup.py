@@ -11,6 +11,34 @@ from pybind11 import get_cmake_dir
 import pybind11
 from setuptools import setup, Extension
 import os
+import platform
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_avro_codecs
+
+# Regenerate the Avro codecs from schemas/avro in a full checkout; builds
+# from the service directory alone (Docker) use the checked-in
+# src/avro_codecs.h
+if os.path.isdir(gen_avro_codecs.DEFAULT_SCHEMA_DIR):
+    gen_avro_codecs.main([])
+
+# Portable baseline ISA: the image must run on every instance type it is
+# deployed to, so nothing past x86-64-v2 (SSE4.2, POPCNT) or armv8-a (NEON).
+# The SIMD kernels also carry AVX2 and AVX-512 variants picked at import
+# (src/cpu_dispatch.h). SBE_DECODER_MARCH overrides it for a host-only
+# build, e.g. SBE_DECODER_MARCH=native.
+def baseline_arch_flags():
+    march = os.environ.get("SBE_DECODER_MARCH")
+    if march:
+        return [f"-march={march}"]
+    machine = platform.machine().lower()
+    if machine in ("x86_64", "amd64"):
+        return ["-msse4.2", "-mpopcnt"]
+    if machine in ("aarch64", "arm64"):
+        return ["-march=armv8-a"]
+    return []
+
 
 # Define the extension module
 ext_modules = [
@@ -27,6 +55,9 @@ ext_modules = [
             "include/spot_sbe/",
             "include/official/",
         ],
+        # OpenSSL for the native WebSocket receiver (TLS, handshake SHA-1),
+        # zstd for dictionary-compressed Kinesis records
+        libraries=["ssl", "crypto", "zstd"],
         language='c++',
         cxx_std=20,  # C++20 for std::span support
         define_macros=[
@@ -37,10 +68,9 @@ ext_modules = [
         # High performance optimization flags
         extra_compile_args=[
             '-O3',              # Maximum optimization
-            '-march=native',    # Optimize for current CPU
             '-ffast-math',      # Fast math operations
             '-DNDEBUG',         # Disable debug assertions
-        ],
+        ] + baseline_arch_flags(),
     ),
 ]
 
@@ -55,6 +85,7 @@ setup(
     zip_safe=False,
     python_requires=">=3.8",
     install_requires=[
-        "pybind11>=2.6.0",
+        "pybind11>=2.13",
+        "numpy>=1.22",
     ],
 )
\ No newline at end of file
@@ -0,0 +1,53 @@
+/*
+ * Heap allocation accounting for the decode hot path.
+ *
+ * Once warm, the production decode path should not allocate: frames are
+ * borrowed buffers, levels land in the arena, and result shapes and symbol
+ * strs are cached. To prove that, and to catch regressions, the extension
+ * replaces the global operator new with a counting one (sbe_decoder.cpp).
+ * It can also hook Python's object allocator. Both count into per-thread
+ * totals. A decoder with alloc_accounting on reads the totals around each
+ * frame and adds the difference to that template's statistics
+ * (decode_stats.h).
+ *
+ * The totals are per thread, so frames decoded on other threads never leak
+ * in. The extension's own calls normally bind to the replacement;
+ * allocations inside libstdc++'s compiled code are counted only when the
+ * dynamic linker bound those to it too, so the count is a lower bound.
+ * Python allocations are counted once the first accounting decoder has
+ * installed the hook. Objects served from a type's free list never reach it.
+ */
+
+#ifndef _SBE_ALLOC_ACCOUNTING_H_
+#define _SBE_ALLOC_ACCOUNTING_H_
+
+#include <cstddef>
+#include <cstdint>
+
+struct AllocCounts {
+    // operator new calls and the bytes they asked for
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    // Python object-domain allocations (PyObject_Malloc and friends)
+    uint64_t py_allocations = 0;
+
+    AllocCounts operator-(const AllocCounts &earlier) const {
+        return {allocations - earlier.allocations, bytes - earlier.bytes, py_allocations - earlier.py_allocations};
+    }
+};
+
+// This thread's running totals
+inline AllocCounts &thread_alloc_counts() {
+    static thread_local AllocCounts counts;
+    return counts;
+}
+
+inline void count_heap_allocation(std::size_t bytes) {
+    AllocCounts &counts = thread_alloc_counts();
+    ++counts.allocations;
+    counts.bytes += bytes;
+}
+
+inline void count_py_allocation() { ++thread_alloc_counts().py_allocations; }
+
+#endif
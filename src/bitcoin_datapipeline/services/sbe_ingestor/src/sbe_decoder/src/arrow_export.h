@@ -0,0 +1,281 @@
+/*
+ * Decoded columns as Arrow record batches through the Arrow C Data
+ * Interface, so pyarrow, polars and pandas take them without a copy.
+ *
+ * An ArrowBatch owns its columns: numeric vectors are moved in and exported
+ * as they are, so the Arrow buffers are the decoder's own memory. Booleans
+ * are bit-packed and symbols become utf8 (offsets plus bytes) on the way
+ * in, since Arrow has no byte-per-flag or fixed-width padded string type;
+ * both are small next to the numeric columns.
+ *
+ * export_schema()/export_array() fill a struct-typed ArrowSchema/ArrowArray
+ * with one child per column. Every export shares ownership of the column
+ * storage, so an exported array (or a child the consumer moved out) stays
+ * valid after the batch is gone, and a batch can be exported any number of
+ * times. The release callbacks follow the spec: a parent releases the
+ * children that are still in place, and each structure frees only its own
+ * private data.
+ */
+
+#ifndef _SBE_ARROW_EXPORT_H_
+#define _SBE_ARROW_EXPORT_H_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// The ABI structs, verbatim from the specification
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+namespace arrow_export_detail {
+
+template <typename T>
+constexpr const char *format_of() {
+    if constexpr (std::is_same_v<T, int64_t>) {
+        return "l";
+    } else if constexpr (std::is_same_v<T, uint64_t>) {
+        return "L";
+    } else if constexpr (std::is_same_v<T, int32_t>) {
+        return "i";
+    } else if constexpr (std::is_same_v<T, uint32_t>) {
+        return "I";
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+        return "s";
+    } else if constexpr (std::is_same_v<T, uint16_t>) {
+        return "S";
+    } else if constexpr (std::is_same_v<T, int8_t>) {
+        return "c";
+    } else if constexpr (std::is_same_v<T, uint8_t>) {
+        return "C";
+    } else if constexpr (std::is_same_v<T, double>) {
+        return "g";
+    } else {
+        static_assert(std::is_same_v<T, float>, "no Arrow format for this column type");
+        return "f";
+    }
+}
+
+struct Column {
+    std::string name;
+    const char *format;
+    int64_t length;
+    // Data buffers after the (absent) validity bitmap: one for primitives
+    // and booleans, offsets then bytes for utf8
+    std::vector<const void *> buffers;
+    std::shared_ptr<const void> owner;
+};
+
+struct SchemaPrivate {
+    std::string name;
+    std::vector<ArrowSchema> children;
+    std::vector<ArrowSchema *> child_pointers;
+};
+
+struct ArrayPrivate {
+    std::shared_ptr<const void> owner;
+    std::vector<const void *> buffers;
+    std::vector<ArrowArray> children;
+    std::vector<ArrowArray *> child_pointers;
+};
+
+inline void release_schema(ArrowSchema *schema) {
+    auto *data = static_cast<SchemaPrivate *>(schema->private_data);
+    for (ArrowSchema *child : data->child_pointers) {
+        if (child->release != nullptr) {
+            child->release(child);
+        }
+    }
+    delete data;
+    schema->release = nullptr;
+}
+
+inline void release_array(ArrowArray *array) {
+    auto *data = static_cast<ArrayPrivate *>(array->private_data);
+    for (ArrowArray *child : data->child_pointers) {
+        if (child->release != nullptr) {
+            child->release(child);
+        }
+    }
+    delete data;
+    array->release = nullptr;
+}
+
+} // namespace arrow_export_detail
+
+class ArrowBatch {
+public:
+    // A numeric column, moved in and exported without a copy
+    template <typename T>
+    void add(std::string name, std::vector<T> &&values) {
+        auto owned = std::make_shared<std::vector<T>>(std::move(values));
+        arrow_export_detail::Column column;
+        column.name = std::move(name);
+        column.format = arrow_export_detail::format_of<T>();
+        column.length = static_cast<int64_t>(owned->size());
+        column.buffers = {owned->data()};
+        column.owner = std::move(owned);
+        push(std::move(column));
+    }
+
+    // 0/1 flags, bit-packed into an Arrow boolean column
+    void add_bools(std::string name, const std::vector<uint8_t> &flags) {
+        auto bits = std::make_shared<std::vector<uint8_t>>((flags.size() + 7) / 8, 0);
+        for (std::size_t i = 0; i < flags.size(); ++i) {
+            (*bits)[i / 8] = static_cast<uint8_t>((*bits)[i / 8] | (flags[i] != 0 ? 1 : 0) << (i % 8));
+        }
+        arrow_export_detail::Column column;
+        column.name = std::move(name);
+        column.format = "b";
+        column.length = static_cast<int64_t>(flags.size());
+        column.buffers = {bits->data()};
+        column.owner = std::move(bits);
+        push(std::move(column));
+    }
+
+    // A utf8 column from strings (or zero-padded fixed-width codes, cut at
+    // their first NUL)
+    template <typename Strings>
+    void add_strings(std::string name, const Strings &values) {
+        struct Utf8 {
+            std::vector<int32_t> offsets{0};
+            std::vector<char> bytes;
+        };
+        auto owned = std::make_shared<Utf8>();
+        owned->offsets.reserve(values.size() + 1);
+        for (const auto &value : values) {
+            const std::string_view text(value.data(), strnlen(value.data(), value.size()));
+            owned->bytes.insert(owned->bytes.end(), text.begin(), text.end());
+            if (owned->bytes.size() > static_cast<std::size_t>(INT32_MAX)) {
+                throw std::runtime_error("ArrowBatch: utf8 column over 2 GiB");
+            }
+            owned->offsets.push_back(static_cast<int32_t>(owned->bytes.size()));
+        }
+        arrow_export_detail::Column column;
+        column.name = std::move(name);
+        column.format = "u";
+        column.length = static_cast<int64_t>(values.size());
+        column.buffers = {owned->offsets.data(), owned->bytes.data()};
+        column.owner = std::move(owned);
+        push(std::move(column));
+    }
+
+    int64_t rows() const { return rows_; }
+    std::size_t column_count() const { return columns_.size(); }
+    const std::string &column_name(std::size_t i) const { return columns_[i].name; }
+    const char *column_format(std::size_t i) const { return columns_[i].format; }
+
+    // A struct schema ("+s") with one child per column; `out` is released
+    // by its consumer
+    void export_schema(ArrowSchema *out) const {
+        using namespace arrow_export_detail;
+        auto *data = new SchemaPrivate;
+        data->children.resize(columns_.size());
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            auto *child_data = new SchemaPrivate;
+            child_data->name = columns_[i].name;
+            ArrowSchema &child = data->children[i];
+            child = ArrowSchema{columns_[i].format, child_data->name.c_str(), nullptr, 0, 0, nullptr, nullptr,
+                                &release_schema, child_data};
+            data->child_pointers.push_back(&child);
+        }
+        *out = ArrowSchema{"+s",
+                           "",
+                           nullptr,
+                           0,
+                           static_cast<int64_t>(columns_.size()),
+                           data->child_pointers.data(),
+                           nullptr,
+                           &release_schema,
+                           data};
+    }
+
+    // The matching struct array; shares ownership of the column storage
+    void export_array(ArrowArray *out) const {
+        using namespace arrow_export_detail;
+        auto *data = new ArrayPrivate;
+        data->buffers = {nullptr};
+        data->children.resize(columns_.size());
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            const Column &column = columns_[i];
+            auto *child_data = new ArrayPrivate;
+            child_data->owner = column.owner;
+            child_data->buffers.push_back(nullptr);
+            child_data->buffers.insert(child_data->buffers.end(), column.buffers.begin(), column.buffers.end());
+            ArrowArray &child = data->children[i];
+            child = ArrowArray{column.length,
+                               0,
+                               0,
+                               static_cast<int64_t>(child_data->buffers.size()),
+                               0,
+                               child_data->buffers.data(),
+                               nullptr,
+                               nullptr,
+                               &release_array,
+                               child_data};
+            data->child_pointers.push_back(&child);
+        }
+        *out = ArrowArray{rows_,
+                          0,
+                          0,
+                          1,
+                          static_cast<int64_t>(columns_.size()),
+                          data->buffers.data(),
+                          data->child_pointers.data(),
+                          nullptr,
+                          &release_array,
+                          data};
+    }
+
+private:
+    void push(arrow_export_detail::Column &&column) {
+        if (!columns_.empty() && column.length != rows_) {
+            throw std::runtime_error("ArrowBatch: column '" + column.name + "' has " +
+                                     std::to_string(column.length) + " rows, expected " + std::to_string(rows_));
+        }
+        rows_ = column.length;
+        columns_.push_back(std::move(column));
+    }
+
+    std::vector<arrow_export_detail::Column> columns_;
+    int64_t rows_ = 0;
+};
+
+#endif
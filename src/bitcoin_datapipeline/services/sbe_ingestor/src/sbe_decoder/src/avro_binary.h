@@ -0,0 +1,172 @@
+/*
+ * Avro binary encoding primitives for the generated codecs in avro_codecs.h.
+ *
+ * Writers append to a RecordWriter (zig-zag varints for int/long, raw
+ * little-endian IEEE doubles, length-prefixed strings, block-encoded
+ * arrays). AvroReader walks a payload and throws std::runtime_error on
+ * truncated or malformed input; decoded strings are views into the payload.
+ * Records are framed with Avro single-object encoding: 0xC3 0x01 and the
+ * schema's CRC-64-AVRO fingerprint, so consumers can tell schemas apart.
+ */
+
+#ifndef _SBE_AVRO_BINARY_H_
+#define _SBE_AVRO_BINARY_H_
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+#include "record_writer.h"
+
+constexpr uint8_t AVRO_SINGLE_OBJECT_MAGIC[2] = {0xC3, 0x01};
+constexpr std::size_t AVRO_SINGLE_OBJECT_HEADER_SIZE = 10;
+
+inline void avro_write_long(RecordWriter &writer, int64_t value) {
+    uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    char buf[10];
+    std::size_t size = 0;
+    while (zigzag >= 0x80) {
+        buf[size++] = static_cast<char>((zigzag & 0x7F) | 0x80);
+        zigzag >>= 7;
+    }
+    buf[size++] = static_cast<char>(zigzag);
+    writer.put(std::string_view(buf, size));
+}
+
+inline void avro_write_int(RecordWriter &writer, int32_t value) {
+    avro_write_long(writer, value);
+}
+
+inline void avro_write_boolean(RecordWriter &writer, bool value) {
+    writer.put(static_cast<char>(value ? 1 : 0));
+}
+
+inline void avro_write_double(RecordWriter &writer, double value) {
+    char buf[sizeof(value)];
+    std::memcpy(buf, &value, sizeof(value));
+    writer.put(std::string_view(buf, sizeof(buf)));
+}
+
+inline void avro_write_float(RecordWriter &writer, float value) {
+    char buf[sizeof(value)];
+    std::memcpy(buf, &value, sizeof(value));
+    writer.put(std::string_view(buf, sizeof(buf)));
+}
+
+inline void avro_write_string(RecordWriter &writer, std::string_view value) {
+    avro_write_long(writer, static_cast<int64_t>(value.size()));
+    writer.put(value);
+}
+
+// One block with every item, then the terminating empty block
+template <typename Range, typename WriteItem>
+void avro_write_array(RecordWriter &writer, const Range &items, WriteItem &&write_item) {
+    const auto count = static_cast<int64_t>(std::size(items));
+    if (count > 0) {
+        avro_write_long(writer, count);
+        for (const auto &item : items) {
+            write_item(item);
+        }
+    }
+    avro_write_long(writer, 0);
+}
+
+inline void avro_write_header(RecordWriter &writer, uint64_t fingerprint) {
+    char buf[AVRO_SINGLE_OBJECT_HEADER_SIZE];
+    buf[0] = static_cast<char>(AVRO_SINGLE_OBJECT_MAGIC[0]);
+    buf[1] = static_cast<char>(AVRO_SINGLE_OBJECT_MAGIC[1]);
+    std::memcpy(buf + 2, &fingerprint, sizeof(fingerprint));
+    writer.put(std::string_view(buf, sizeof(buf)));
+}
+
+class AvroReader {
+public:
+    explicit AvroReader(std::span<const char> data) : cursor_(data.data()), end_(data.data() + data.size()) {}
+
+    std::size_t remaining() const { return static_cast<std::size_t>(end_ - cursor_); }
+
+    int64_t read_long() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const auto byte = static_cast<uint8_t>(*take(1));
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+            }
+        }
+        throw std::runtime_error("Avro decode: varint longer than 10 bytes");
+    }
+
+    int32_t read_int() { return static_cast<int32_t>(read_long()); }
+
+    bool read_boolean() { return *take(1) != 0; }
+
+    double read_double() {
+        double value = 0.0;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    float read_float() {
+        float value = 0.0f;
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    std::string_view read_string() {
+        const int64_t size = read_long();
+        if (size < 0) {
+            throw std::runtime_error("Avro decode: negative string length");
+        }
+        return {take(static_cast<std::size_t>(size)), static_cast<std::size_t>(size)};
+    }
+
+    // Call read_item() once per array item, across all blocks
+    template <typename ReadItem>
+    void read_array(ReadItem &&read_item) {
+        while (true) {
+            int64_t count = read_long();
+            if (count == 0) {
+                return;
+            }
+            if (count < 0) {
+                // Negative count: the block's byte size follows
+                count = -count;
+                read_long();
+            }
+            for (int64_t i = 0; i < count; ++i) {
+                read_item();
+            }
+        }
+    }
+
+    // Fingerprint of a single-object encoded payload
+    uint64_t read_header() {
+        const char *header = take(AVRO_SINGLE_OBJECT_HEADER_SIZE);
+        if (static_cast<uint8_t>(header[0]) != AVRO_SINGLE_OBJECT_MAGIC[0] ||
+            static_cast<uint8_t>(header[1]) != AVRO_SINGLE_OBJECT_MAGIC[1]) {
+            throw std::runtime_error("Avro decode: missing single-object marker");
+        }
+        uint64_t fingerprint = 0;
+        std::memcpy(&fingerprint, header + 2, sizeof(fingerprint));
+        return fingerprint;
+    }
+
+private:
+    const char *take(std::size_t count) {
+        if (remaining() < count) {
+            throw std::runtime_error("Avro decode: truncated payload");
+        }
+        const char *data = cursor_;
+        cursor_ += count;
+        return data;
+    }
+
+    const char *cursor_;
+    const char *end_;
+};
+
+#endif
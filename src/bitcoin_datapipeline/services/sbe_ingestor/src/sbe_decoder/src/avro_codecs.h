@@ -0,0 +1,193 @@
+/*
+ * Avro codecs for MarketTrade.avsc, BestBidAsk.avsc, DepthDelta.avsc.
+ *
+ * GENERATED by gen_avro_codecs.py from schemas/avro -- do not edit by hand.
+ */
+
+#ifndef _SBE_AVRO_CODECS_H_
+#define _SBE_AVRO_CODECS_H_
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "avro_binary.h"
+
+namespace avro_gen {
+
+// Individual trade event from Binance
+struct MarketTrade {
+    static constexpr std::string_view SCHEMA_NAME = "binance.MarketTrade";
+    static constexpr uint64_t FINGERPRINT = 0x4c6246c253d476c5ULL;
+
+    std::string_view symbol;
+    int64_t event_ts = 0;
+    int64_t ingest_ts = 0;
+    int64_t trade_id = 0;
+    double price = 0.0;
+    double qty = 0.0;
+    bool is_buyer_maker = false;
+    std::string_view source;
+};
+
+inline void encode(RecordWriter &writer, const MarketTrade &record) {
+    avro_write_header(writer, MarketTrade::FINGERPRINT);
+    avro_write_string(writer, record.symbol);
+    avro_write_long(writer, record.event_ts);
+    avro_write_long(writer, record.ingest_ts);
+    avro_write_long(writer, record.trade_id);
+    avro_write_double(writer, record.price);
+    avro_write_double(writer, record.qty);
+    avro_write_boolean(writer, record.is_buyer_maker);
+    avro_write_string(writer, record.source);
+}
+
+// Body only: the single-object header has already been read
+inline void decode(AvroReader &reader, MarketTrade &record) {
+    record.symbol = reader.read_string();
+    record.event_ts = reader.read_long();
+    record.ingest_ts = reader.read_long();
+    record.trade_id = reader.read_long();
+    record.price = reader.read_double();
+    record.qty = reader.read_double();
+    record.is_buyer_maker = reader.read_boolean();
+    record.source = reader.read_string();
+}
+
+template <typename Fn>
+void visit_fields(const MarketTrade &record, Fn &&fn) {
+    fn("symbol", record.symbol);
+    fn("event_ts", record.event_ts);
+    fn("ingest_ts", record.ingest_ts);
+    fn("trade_id", record.trade_id);
+    fn("price", record.price);
+    fn("qty", record.qty);
+    fn("is_buyer_maker", record.is_buyer_maker);
+    fn("source", record.source);
+}
+
+// Best bid/ask price and size update
+struct BestBidAsk {
+    static constexpr std::string_view SCHEMA_NAME = "binance.BestBidAsk";
+    static constexpr uint64_t FINGERPRINT = 0xef1521a96315f75eULL;
+
+    std::string_view symbol;
+    int64_t event_ts = 0;
+    int64_t ingest_ts = 0;
+    double bid_px = 0.0;
+    double bid_sz = 0.0;
+    double ask_px = 0.0;
+    double ask_sz = 0.0;
+    std::string_view source;
+};
+
+inline void encode(RecordWriter &writer, const BestBidAsk &record) {
+    avro_write_header(writer, BestBidAsk::FINGERPRINT);
+    avro_write_string(writer, record.symbol);
+    avro_write_long(writer, record.event_ts);
+    avro_write_long(writer, record.ingest_ts);
+    avro_write_double(writer, record.bid_px);
+    avro_write_double(writer, record.bid_sz);
+    avro_write_double(writer, record.ask_px);
+    avro_write_double(writer, record.ask_sz);
+    avro_write_string(writer, record.source);
+}
+
+// Body only: the single-object header has already been read
+inline void decode(AvroReader &reader, BestBidAsk &record) {
+    record.symbol = reader.read_string();
+    record.event_ts = reader.read_long();
+    record.ingest_ts = reader.read_long();
+    record.bid_px = reader.read_double();
+    record.bid_sz = reader.read_double();
+    record.ask_px = reader.read_double();
+    record.ask_sz = reader.read_double();
+    record.source = reader.read_string();
+}
+
+template <typename Fn>
+void visit_fields(const BestBidAsk &record, Fn &&fn) {
+    fn("symbol", record.symbol);
+    fn("event_ts", record.event_ts);
+    fn("ingest_ts", record.ingest_ts);
+    fn("bid_px", record.bid_px);
+    fn("bid_sz", record.bid_sz);
+    fn("ask_px", record.ask_px);
+    fn("ask_sz", record.ask_sz);
+    fn("source", record.source);
+}
+
+// Order book depth delta (top-N compressed)
+struct DepthDelta {
+    static constexpr std::string_view SCHEMA_NAME = "binance.DepthDelta";
+    static constexpr uint64_t FINGERPRINT = 0x617d2bd79634f2eeULL;
+
+    std::string_view symbol;
+    int64_t event_ts = 0;
+    int64_t ingest_ts = 0;
+    std::vector<std::vector<std::string_view>> bids;
+    std::vector<std::vector<std::string_view>> asks;
+    std::string_view source;
+};
+
+inline void encode(RecordWriter &writer, const DepthDelta &record) {
+    avro_write_header(writer, DepthDelta::FINGERPRINT);
+    avro_write_string(writer, record.symbol);
+    avro_write_long(writer, record.event_ts);
+    avro_write_long(writer, record.ingest_ts);
+    avro_write_array(writer, record.bids, [&](const auto &item0) { avro_write_array(writer, item0, [&](const auto &item1) { avro_write_string(writer, item1); }); });
+    avro_write_array(writer, record.asks, [&](const auto &item0) { avro_write_array(writer, item0, [&](const auto &item1) { avro_write_string(writer, item1); }); });
+    avro_write_string(writer, record.source);
+}
+
+// Body only: the single-object header has already been read
+inline void decode(AvroReader &reader, DepthDelta &record) {
+    record.symbol = reader.read_string();
+    record.event_ts = reader.read_long();
+    record.ingest_ts = reader.read_long();
+    record.bids.clear(); reader.read_array([&] { auto &item0 = record.bids.emplace_back(); item0.clear(); reader.read_array([&] { auto &item1 = item0.emplace_back(); item1 = reader.read_string(); }); });
+    record.asks.clear(); reader.read_array([&] { auto &item0 = record.asks.emplace_back(); item0.clear(); reader.read_array([&] { auto &item1 = item0.emplace_back(); item1 = reader.read_string(); }); });
+    record.source = reader.read_string();
+}
+
+template <typename Fn>
+void visit_fields(const DepthDelta &record, Fn &&fn) {
+    fn("symbol", record.symbol);
+    fn("event_ts", record.event_ts);
+    fn("ingest_ts", record.ingest_ts);
+    fn("bids", record.bids);
+    fn("asks", record.asks);
+    fn("source", record.source);
+}
+
+// Read a single-object payload and call fn(record) with the decoded record.
+// Returns false for fingerprints of schemas not compiled in.
+template <typename Fn>
+bool decode_single_object(std::span<const char> payload, Fn &&fn) {
+    AvroReader reader{payload};
+    const uint64_t fingerprint = reader.read_header();
+    if (fingerprint == MarketTrade::FINGERPRINT) {
+        MarketTrade record;
+        decode(reader, record);
+        fn(record);
+        return true;
+    }
+    if (fingerprint == BestBidAsk::FINGERPRINT) {
+        BestBidAsk record;
+        decode(reader, record);
+        fn(record);
+        return true;
+    }
+    if (fingerprint == DepthDelta::FINGERPRINT) {
+        DepthDelta record;
+        decode(reader, record);
+        fn(record);
+        return true;
+    }
+    return false;
+}
+
+} // namespace avro_gen
+
+#endif
@@ -0,0 +1,598 @@
+/*
+ * Work-stealing parallel aggTrades backfill across symbols.
+ *
+ * The REST collector filled each symbol's ID gaps one request at a time,
+ * symbol after symbol. BackfillPool runs the pages IdIntervalSet::plan()
+ * produces (interval_set.h) on a fixed set of worker threads instead. Each
+ * task is one (symbol, fromId, limit) page and one unit of work end to
+ * end: the worker fetches it as a trades.aggregate request over its own
+ * WebSocket API connection (ws_api_client.h), decodes the
+ * AggTradesResponse it answers with (batch_decode.h) and encodes the rows
+ * as one Parquet file in the S3 archive's aggTrades columns
+ * (parquet_writer.h). The caller only uploads the bytes.
+ *
+ * A symbol's pages all start on one worker's queue, in ID order, symbols
+ * dealt round robin. History is anything but even (a major pair has
+ * orders of magnitude more aggTrades per hour than a minor one), so a
+ * worker whose queue runs dry steals the back half of the fullest queue
+ * (WorkStealingQueues); the owner keeps working from the front, so the
+ * two only meet on the last few tasks. A worker takes up to `batch` tasks
+ * at a time and pipelines them on its connection with fetch_all().
+ *
+ * Every connection is governed, so however many workers run, the process
+ * stays within the exchange's request-weight limits (rate_governor.h): a
+ * worker the governor holds back simply waits for its next grant. A batch
+ * whose connection fails, and a page answered 429, 418 or 5xx, go back on
+ * the worker's queue until max_attempts; any other failure is a result
+ * with its error set. Results come out of next_result() in completion
+ * order, from any thread.
+ */
+
+#ifndef _SBE_BACKFILL_POOL_H_
+#define _SBE_BACKFILL_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "batch_decode.h"
+#include "interval_set.h"
+#include "native_metrics.h"
+#include "parquet_writer.h"
+#include "spot_sbe/AggTradesResponse.h"
+#include "spot_sbe/MessageHeader.h"
+#include "ws_api_client.h"
+
+// One deque per worker. The owner takes from the front; a worker whose
+// deque is empty steals the back half of the fullest other one. Each deque
+// has its own lock and no call holds two, so owners only contend with a
+// thief, and only on the deque being robbed.
+template <typename T>
+class WorkStealingQueues {
+public:
+    explicit WorkStealingQueues(std::size_t workers) : queues_(workers) {
+        if (workers == 0) {
+            throw std::invalid_argument("WorkStealingQueues: at least one worker is required");
+        }
+    }
+
+    WorkStealingQueues(const WorkStealingQueues &) = delete;
+    WorkStealingQueues &operator=(const WorkStealingQueues &) = delete;
+
+    std::size_t workers() const { return queues_.size(); }
+
+    void push(std::size_t worker, T item) {
+        Queue &queue = queues_[worker];
+        std::lock_guard lock(queue.mutex);
+        queue.items.push_back(std::move(item));
+        queue.size.store(queue.items.size(), std::memory_order_relaxed);
+        total_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Moves up to `max` items into `out`, from the front of `worker`'s own
+    // deque or, when that is empty, out of a steal; stolen items `out` has
+    // no room for go on the thief's own deque. Returns how many items were
+    // stolen, 0 when they came from its own deque or there was nothing.
+    std::size_t take(std::size_t worker, std::size_t max, std::vector<T> &out) {
+        if (pop_front(worker, max, out) > 0) {
+            return 0;
+        }
+        std::deque<T> stolen;
+        if (!steal(worker, stolen)) {
+            return 0;
+        }
+        const std::size_t count = stolen.size();
+        total_.fetch_sub(count, std::memory_order_relaxed);
+        while (!stolen.empty() && max > 0) {
+            out.push_back(std::move(stolen.front()));
+            stolen.pop_front();
+            --max;
+        }
+        if (!stolen.empty()) {
+            Queue &own = queues_[worker];
+            std::lock_guard lock(own.mutex);
+            total_.fetch_add(stolen.size(), std::memory_order_relaxed);
+            for (T &item : stolen) {
+                own.items.push_back(std::move(item));
+            }
+            own.size.store(own.items.size(), std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    // Approximate while other threads push and take
+    std::size_t size(std::size_t worker) const { return queues_[worker].size.load(std::memory_order_relaxed); }
+    std::size_t size() const { return total_.load(std::memory_order_relaxed); }
+
+    void clear() {
+        for (Queue &queue : queues_) {
+            std::lock_guard lock(queue.mutex);
+            total_.fetch_sub(queue.items.size(), std::memory_order_relaxed);
+            queue.items.clear();
+            queue.size.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<T> items;
+        // items.size() for thieves choosing a victim without the lock
+        std::atomic<std::size_t> size{0};
+    };
+
+    std::size_t pop_front(std::size_t worker, std::size_t max, std::vector<T> &out) {
+        Queue &queue = queues_[worker];
+        std::lock_guard lock(queue.mutex);
+        const std::size_t count = std::min(max, queue.items.size());
+        for (std::size_t i = 0; i < count; ++i) {
+            out.push_back(std::move(queue.items.front()));
+            queue.items.pop_front();
+        }
+        queue.size.store(queue.items.size(), std::memory_order_relaxed);
+        total_.fetch_sub(count, std::memory_order_relaxed);
+        return count;
+    }
+
+    bool steal(std::size_t thief, std::deque<T> &stolen) {
+        std::size_t victim = thief;
+        std::size_t most = 0;
+        for (std::size_t i = 0; i < queues_.size(); ++i) {
+            const std::size_t size = queues_[i].size.load(std::memory_order_relaxed);
+            if (i != thief && size > most) {
+                victim = i;
+                most = size;
+            }
+        }
+        if (victim == thief) {
+            return false;
+        }
+        Queue &queue = queues_[victim];
+        std::lock_guard lock(queue.mutex);
+        const std::size_t count = (queue.items.size() + 1) / 2;
+        const auto first = queue.items.end() - static_cast<std::ptrdiff_t>(count);
+        stolen.insert(stolen.end(), std::make_move_iterator(first), std::make_move_iterator(queue.items.end()));
+        queue.items.erase(first, queue.items.end());
+        queue.size.store(queue.items.size(), std::memory_order_relaxed);
+        return count > 0;
+    }
+
+    std::vector<Queue> queues_;
+    std::atomic<std::size_t> total_{0};
+};
+
+struct BackfillTask {
+    std::string symbol;
+    int64_t from_id = 0;
+    int64_t limit = 0;
+    // Fetches tried so far
+    int attempts = 0;
+};
+
+struct BackfillResult {
+    BackfillTask task;
+    std::size_t worker = 0;
+    // The page's WebSocket API status; 0 when no answer arrived
+    uint16_t status = 0;
+    // Empty on success
+    std::string error;
+    int64_t rows = 0;
+    // aggTrade IDs and trade times of the first and last row, when rows > 0
+    int64_t first_id = 0;
+    int64_t last_id = 0;
+    int64_t first_time = 0;
+    int64_t last_time = 0;
+    // The rows as one Parquet file in backfill_agg_trade_columns(); empty
+    // when there are none
+    std::vector<char> parquet;
+
+    bool ok() const { return error.empty(); }
+};
+
+struct BackfillConfig {
+    // 0: one per hardware thread
+    std::size_t workers = 0;
+    // Every worker's connection; max_in_flight bounds `batch`
+    WsApiConfig api;
+    // Tasks a worker takes and pipelines at a time
+    std::size_t batch = 8;
+    int max_attempts = 3;
+    // Pause before a worker reconnects after its connection failed
+    int retry_delay_ms = 500;
+    std::string method = "trades.aggregate";
+    // Request weight of one page
+    int64_t weight = 4;
+    // Written to every row's source column
+    std::string source = "ws_api";
+    int compression_level = 3;
+};
+
+// Written by the workers, readable from any thread
+struct BackfillStats {
+    std::atomic<uint64_t> tasks{0};
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> retries{0};
+    // Steals, and the tasks they moved
+    std::atomic<uint64_t> steals{0};
+    std::atomic<uint64_t> stolen_tasks{0};
+    // fetch_all() calls
+    std::atomic<uint64_t> fetches{0};
+    std::atomic<uint64_t> rows{0};
+    std::atomic<uint64_t> parquet_bytes{0};
+};
+
+// The S3 archive's aggTrades columns (AGG_TRADES_COLUMNS in the REST
+// ingestor's S3 writer), in order
+inline std::vector<ParquetColumnSpec> backfill_agg_trade_columns() {
+    return {
+        {"symbol", ParquetType::STRING},
+        {"event_ts", ParquetType::TIMESTAMP_MS},
+        {"ingest_ts", ParquetType::TIMESTAMP_MS},
+        {"trade_id", ParquetType::INT64},
+        {"price", ParquetType::FLOAT64},
+        {"qty", ParquetType::FLOAT64},
+        {"is_buyer_maker", ParquetType::BOOL},
+        {"source", ParquetType::STRING},
+    };
+}
+
+class BackfillPool {
+public:
+    // How a worker fetches a batch of pages; the default is its own
+    // WsApiClient. Responses come back in request order.
+    using Fetch = std::function<std::vector<WsApiResponse>(std::size_t worker, std::span<const WsApiRequest>)>;
+
+    explicit BackfillPool(BackfillConfig config, Fetch fetch = {})
+        : config_(std::move(config)), fetch_(std::move(fetch)),
+          queues_(config_.workers != 0 ? config_.workers : std::max(1u, std::thread::hardware_concurrency())) {
+        if (config_.batch == 0 || config_.batch > config_.api.max_in_flight) {
+            throw std::invalid_argument("batch must be between 1 and max_in_flight");
+        }
+        if (config_.max_attempts < 1) {
+            throw std::invalid_argument("max_attempts must be at least 1");
+        }
+        const std::size_t workers = queues_.workers();
+        if (!fetch_) {
+            clients_.reserve(workers);
+            for (std::size_t i = 0; i < workers; ++i) {
+                clients_.push_back(std::make_unique<WsApiClient>(config_.api));
+            }
+        }
+        threads_.reserve(workers);
+        for (std::size_t i = 0; i < workers; ++i) {
+            threads_.emplace_back([this, i] { worker(i); });
+        }
+        metrics_.publish([this](MetricsWriter &out) { write_metrics(out); });
+    }
+
+    ~BackfillPool() { stop(); }
+
+    BackfillPool(const BackfillPool &) = delete;
+    BackfillPool &operator=(const BackfillPool &) = delete;
+
+    std::size_t workers() const { return queues_.workers(); }
+    const BackfillConfig &config() const { return config_; }
+    const BackfillStats &stats() const { return stats_; }
+
+    // Tasks waiting on each worker's queue
+    std::vector<std::size_t> queued() const {
+        std::vector<std::size_t> sizes(queues_.workers());
+        for (std::size_t i = 0; i < sizes.size(); ++i) {
+            sizes[i] = queues_.size(i);
+        }
+        return sizes;
+    }
+
+    // Tasks added whose result has not been produced yet
+    std::size_t outstanding() const { return outstanding_.load(std::memory_order_acquire); }
+
+    // Queues one task per page of `symbol` on the symbol's home worker.
+    // Throws std::invalid_argument for a symbol that is not plain [A-Z0-9]
+    // or a page with a negative fromId or a limit outside 1..1000.
+    void add(std::string_view symbol, std::span<const IdRequest> pages) {
+        check_symbol(symbol);
+        for (const IdRequest &page : pages) {
+            if (page.from_id < 0 || page.limit < 1 || page.limit > 1000) {
+                throw std::invalid_argument("backfill pages need fromId >= 0 and a limit of 1..1000");
+            }
+        }
+        const std::size_t home = home_of(symbol);
+        outstanding_.fetch_add(pages.size(), std::memory_order_acq_rel);
+        stats_.tasks.fetch_add(pages.size(), std::memory_order_relaxed);
+        for (const IdRequest &page : pages) {
+            queues_.push(home, BackfillTask{std::string(symbol), page.from_id, page.limit, 0});
+        }
+        wake();
+    }
+
+    // The next finished task, or std::nullopt if none finished within
+    // timeout_ms
+    std::optional<BackfillResult> next_result(int timeout_ms) {
+        std::unique_lock lock(results_mutex_);
+        if (!results_ready_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                     [&] { return !results_.empty(); })) {
+            return std::nullopt;
+        }
+        BackfillResult result = std::move(results_.front());
+        results_.pop_front();
+        return result;
+    }
+
+    // Stops the workers after their current batch; queued tasks are dropped
+    void stop() {
+        {
+            std::lock_guard lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+            stopping_ = true;
+        }
+        work_ready_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+        for (auto &client : clients_) {
+            client->close();
+        }
+        const std::size_t dropped = queues_.size();
+        queues_.clear();
+        outstanding_.fetch_sub(dropped, std::memory_order_acq_rel);
+    }
+
+private:
+    static void check_symbol(std::string_view symbol) {
+        if (symbol.empty() || !std::all_of(symbol.begin(), symbol.end(), [](char c) {
+                return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+            })) {
+            throw std::invalid_argument("backfill symbols must be plain [A-Z0-9]");
+        }
+    }
+
+    // Symbols are dealt to workers round robin in the order they are added
+    std::size_t home_of(std::string_view symbol) {
+        std::lock_guard lock(mutex_);
+        const auto [it, inserted] = homes_.try_emplace(std::string(symbol), next_home_);
+        if (inserted) {
+            next_home_ = (next_home_ + 1) % queues_.workers();
+        }
+        return it->second;
+    }
+
+    // Taking the lock orders the queue push before a waiter's predicate check
+    void wake() {
+        { std::lock_guard lock(mutex_); }
+        work_ready_.notify_all();
+    }
+
+    bool stopping() {
+        std::lock_guard lock(mutex_);
+        return stopping_;
+    }
+
+    void worker(std::size_t index) {
+        ParquetWriter writer(backfill_agg_trade_columns(), ParquetCompression::ZSTD, config_.compression_level);
+        std::vector<BackfillTask> batch;
+        std::vector<WsApiRequest> requests;
+        while (true) {
+            batch.clear();
+            if (const std::size_t stolen = queues_.take(index, config_.batch, batch)) {
+                stats_.steals.fetch_add(1, std::memory_order_relaxed);
+                stats_.stolen_tasks.fetch_add(stolen, std::memory_order_relaxed);
+                if (stolen > batch.size()) {
+                    // The rest landed on this worker's queue, for idle workers to steal in turn
+                    wake();
+                }
+            }
+            if (batch.empty()) {
+                std::unique_lock lock(mutex_);
+                // Tasks can come back for a retry, so an idle worker waits
+                // rather than exits
+                work_ready_.wait(lock, [&] { return stopping_ || queues_.size() > 0; });
+                if (stopping_) {
+                    return;
+                }
+                continue;
+            }
+            if (stopping()) {
+                outstanding_.fetch_sub(batch.size(), std::memory_order_acq_rel);
+                return;
+            }
+            requests.clear();
+            for (BackfillTask &task : batch) {
+                ++task.attempts;
+                requests.push_back({config_.method, page_params(task), config_.weight});
+            }
+            std::vector<WsApiResponse> responses;
+            try {
+                stats_.fetches.fetch_add(1, std::memory_order_relaxed);
+                responses = fetch(index, requests);
+            } catch (const std::exception &error) {
+                if (!fetch_) {
+                    clients_[index]->close();
+                }
+                for (BackfillTask &task : batch) {
+                    retry_or_fail(index, std::move(task), 0, error.what());
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(config_.retry_delay_ms));
+                continue;
+            }
+            for (std::size_t i = 0; i < batch.size(); ++i) {
+                complete(index, std::move(batch[i]), responses[i], writer);
+            }
+        }
+    }
+
+    std::vector<WsApiResponse> fetch(std::size_t index, std::span<const WsApiRequest> requests) {
+        if (fetch_) {
+            return fetch_(index, requests);
+        }
+        WsApiClient &client = *clients_[index];
+        if (!client.connected()) {
+            client.connect();
+        }
+        return client.fetch_all(requests);
+    }
+
+    static std::string page_params(const BackfillTask &task) {
+        return "{\"symbol\":\"" + task.symbol + "\",\"fromId\":" + std::to_string(task.from_id) +
+               ",\"limit\":" + std::to_string(task.limit) + "}";
+    }
+
+    void complete(std::size_t index, BackfillTask task, const WsApiResponse &response, ParquetWriter &writer) {
+        const uint16_t status = response.status();
+        if (response.json || status != 200) {
+            if (status == 429 || status == 418 || status >= 500) {
+                // The governor has taken the retry-after; the page waits its turn
+                retry_or_fail(index, std::move(task), status, "status " + std::to_string(status));
+                return;
+            }
+            std::string error = response.json ? std::string(response.result().begin(), response.result().end())
+                                              : "status " + std::to_string(status);
+            fail(index, std::move(task), status, std::move(error));
+            return;
+        }
+        BackfillResult result;
+        result.task = std::move(task);
+        result.worker = index;
+        result.status = status;
+        try {
+            write_page(response.envelope.result, result, writer);
+        } catch (const std::exception &error) {
+            writer.clear();
+            result.error = error.what();
+            result.parquet.clear();
+        }
+        if (result.ok()) {
+            stats_.completed.fetch_add(1, std::memory_order_relaxed);
+            stats_.rows.fetch_add(static_cast<uint64_t>(result.rows), std::memory_order_relaxed);
+            stats_.parquet_bytes.fetch_add(result.parquet.size(), std::memory_order_relaxed);
+        } else {
+            stats_.failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        publish(std::move(result));
+    }
+
+    // Decodes an AggTradesResponse page into `result` and its Parquet file
+    void write_page(std::span<char> page, BackfillResult &result, ParquetWriter &writer) const {
+        if (page.size() < spot_sbe::MessageHeader::encodedLength() ||
+            spot_sbe::MessageHeader(page.data(), page.size()).templateId() !=
+                spot_sbe::AggTradesResponse::SBE_TEMPLATE_ID) {
+            throw std::runtime_error("response is not an AggTradesResponse");
+        }
+        BatchColumns columns;
+        decode_frames(std::span<const std::span<char>>(&page, 1), columns);
+        if (!columns.error_frames.empty()) {
+            throw std::runtime_error(std::string("AggTradesResponse decode: ") +
+                                     parse_error_name(static_cast<ParseError>(columns.error_causes.front())));
+        }
+        const AggTradeColumns &trades = columns.agg_trades;
+        const std::size_t rows = trades.agg_trade_id.size();
+        result.rows = static_cast<int64_t>(rows);
+        if (rows == 0) {
+            return;
+        }
+        result.first_id = trades.agg_trade_id.front();
+        result.last_id = trades.agg_trade_id.back();
+        result.first_time = trades.trade_time.front();
+        result.last_time = trades.trade_time.back();
+
+        const auto ingest_ts = static_cast<int64_t>(columns.ingest_ts);
+        for (std::size_t i = 0; i < rows; ++i) {
+            writer.append_string(0, result.task.symbol);
+            writer.append_int64(2, ingest_ts);
+            writer.append_string(7, config_.source);
+        }
+        writer.append_int64s(1, trades.trade_time);
+        writer.append_int64s(3, trades.agg_trade_id);
+        writer.append_float64s(4, trades.price.value);
+        writer.append_float64s(5, trades.qty.value);
+        writer.append_bools(6, trades.is_buyer_maker);
+        result.parquet = writer.finish();
+    }
+
+    void retry_or_fail(std::size_t index, BackfillTask task, uint16_t status, std::string error) {
+        if (task.attempts < config_.max_attempts) {
+            stats_.retries.fetch_add(1, std::memory_order_relaxed);
+            queues_.push(index, std::move(task));
+            wake();
+            return;
+        }
+        fail(index, std::move(task), status, std::move(error));
+    }
+
+    void fail(std::size_t index, BackfillTask task, uint16_t status, std::string error) {
+        stats_.failed.fetch_add(1, std::memory_order_relaxed);
+        BackfillResult result;
+        result.task = std::move(task);
+        result.worker = index;
+        result.status = status;
+        result.error = std::move(error);
+        publish(std::move(result));
+    }
+
+    void publish(BackfillResult result) {
+        {
+            std::lock_guard lock(results_mutex_);
+            results_.push_back(std::move(result));
+        }
+        outstanding_.fetch_sub(1, std::memory_order_acq_rel);
+        results_ready_.notify_one();
+    }
+
+    // Prometheus families; runs on the scrape thread
+    void write_metrics(MetricsWriter &out) const {
+        const std::string_view pool = metrics_.instance();
+        const auto tasks = [&](std::string_view status, const std::atomic<uint64_t> &counter) {
+            out.sample("sbe_backfill_tasks_total", MetricType::Counter, "Backfill pages by outcome",
+                       {{"pool", pool}, {"status", status}}, counter.load(std::memory_order_relaxed));
+        };
+        tasks("completed", stats_.completed);
+        tasks("failed", stats_.failed);
+        tasks("retried", stats_.retries);
+        out.sample("sbe_backfill_steals_total", MetricType::Counter, "Tasks moved between workers by stealing",
+                   {{"pool", pool}}, stats_.stolen_tasks.load(std::memory_order_relaxed));
+        out.sample("sbe_backfill_rows_total", MetricType::Counter, "aggTrades rows fetched and encoded",
+                   {{"pool", pool}}, stats_.rows.load(std::memory_order_relaxed));
+        out.sample("sbe_backfill_queued_tasks", MetricType::Gauge, "Tasks waiting on the workers' queues",
+                   {{"pool", pool}}, static_cast<uint64_t>(queues_.size()));
+    }
+
+    const BackfillConfig config_;
+    const Fetch fetch_;
+    WorkStealingQueues<BackfillTask> queues_;
+    // One connection per worker, used only by that worker (and stop())
+    std::vector<std::unique_ptr<WsApiClient>> clients_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::unordered_map<std::string, std::size_t> homes_;
+    std::size_t next_home_ = 0;
+    bool stopping_ = false;
+
+    std::mutex results_mutex_;
+    std::condition_variable results_ready_;
+    std::deque<BackfillResult> results_;
+    std::atomic<std::size_t> outstanding_{0};
+
+    BackfillStats stats_;
+    MetricsRegistration metrics_;
+};
+
+#endif
@@ -0,0 +1,279 @@
+/*
+ * Time, tick, volume and dollar bars from trade columns.
+ *
+ * Each symbol has one open bar. A trade extends it (OHLC, base and quote
+ * volume, taker buy/sell split, trade IDs) and the bar closes by its kind:
+ *
+ *   Time    when a trade lands in a later interval (or advance() passes the
+ *           interval's end); intervals sit on the epoch grid, like klines,
+ *           and an interval without trades has no bar
+ *   Tick    once it holds `threshold` trades
+ *   Volume  once its base volume reaches `threshold`
+ *   Dollar  once its quote volume reaches `threshold`
+ *
+ * The trade that reaches a threshold belongs to the bar it closes; trades
+ * are never split across bars. Closed bars are appended to BarColumns until
+ * take() moves them out, so a month of decode_batch trade tables (live,
+ * Parquet or journal replays) turns into bars in one pass with no per-bar
+ * allocation. Trades are expected in time order per symbol: a late trade
+ * joins the open bar.
+ *
+ * Trades added as mantissas (raw tables, or the Decimal64 add()) also sum
+ * volume and quote volume exactly (decimal64.h); a bar made only of such
+ * trades reports those sums and their ratio as VWAP, each rounded once.
+ *
+ * Not thread-safe; use one from one thread at a time.
+ */
+
+#ifndef _SBE_BAR_BUILDER_H_
+#define _SBE_BAR_BUILDER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "batch_decode.h"
+#include "decimal64.h"
+#include "float_bits.h"
+#include "symbol_table.h"
+
+enum class BarKind : uint8_t {
+    Time = 0,
+    Tick = 1,
+    Volume = 2,
+    Dollar = 3,
+};
+
+struct BarConfig {
+    BarKind kind = BarKind::Time;
+    // Interval in milliseconds for time bars; trades, base volume or quote
+    // volume per bar otherwise
+    double threshold = 60'000;
+};
+
+// Closed bars, one row each. Times are trade times in milliseconds; a time
+// bar spans its whole interval, [open_time, close_time].
+struct BarColumns {
+    std::vector<SymbolCode> symbol;
+    std::vector<SymbolId> symbol_id;
+    std::vector<int64_t> open_time;
+    std::vector<int64_t> close_time;
+    std::vector<int64_t> first_trade_id;
+    std::vector<int64_t> last_trade_id;
+    std::vector<double> open;
+    std::vector<double> high;
+    std::vector<double> low;
+    std::vector<double> close;
+    std::vector<double> volume;
+    std::vector<double> quote_volume;
+    std::vector<double> vwap;
+    std::vector<int64_t> trades;
+    // Taker side: buy volume is from trades whose buyer was not the maker
+    std::vector<double> buy_volume;
+    std::vector<double> sell_volume;
+
+    std::size_t size() const { return open_time.size(); }
+};
+
+class BarBuilder {
+public:
+    explicit BarBuilder(const BarConfig &config) : config_(config) {
+        if (!(config_.threshold > 0) || !finite_bits(config_.threshold)) {
+            throw std::invalid_argument("BarBuilder: threshold must be positive");
+        }
+        if (config_.kind == BarKind::Time) {
+            interval_ms_ = std::max<int64_t>(1, std::llround(config_.threshold));
+        }
+    }
+
+    void add(SymbolId symbol_id, int64_t trade_time_ms, int64_t trade_id, double price, double qty,
+             bool is_buyer_maker) {
+        OpenBar &bar = extend(symbol_id, trade_time_ms, trade_id, price, qty, is_buyer_maker);
+        settle(symbol_id, bar, trade_time_ms);
+    }
+
+    // A trade as mantissas, summed exactly as well
+    void add(SymbolId symbol_id, int64_t trade_time_ms, int64_t trade_id, const Decimal64 &price,
+             const Decimal64 &qty, bool is_buyer_maker) {
+        OpenBar &bar = extend(symbol_id, trade_time_ms, trade_id, price.to_double(), qty.to_double(), is_buyer_maker);
+        bar.exact_volume.add(qty);
+        bar.exact_quote_volume.add_product(price, qty);
+        ++bar.exact_trades;
+        settle(symbol_id, bar, trade_time_ms);
+    }
+
+    // Every row of a decode_batch trades table, scaled or raw
+    void add_trades(const TradeColumns &trades) {
+        const bool raw = !trades.price.mantissa.empty();
+        for (std::size_t i = 0; i < trades.trade_time.size(); ++i) {
+            if (raw) {
+                add(trades.symbol_id[i], trades.trade_time[i], trades.trade_id[i],
+                    Decimal64{trades.price.mantissa[i], trades.exponents.price_exponent[i]},
+                    Decimal64{trades.qty.mantissa[i], trades.exponents.qty_exponent[i]}, trades.is_buyer_maker[i] != 0);
+            } else {
+                add(trades.symbol_id[i], trades.trade_time[i], trades.trade_id[i], trades.price.value[i],
+                    trades.qty.value[i], trades.is_buyer_maker[i] != 0);
+            }
+        }
+    }
+
+    // Close the time bars whose interval ended by `now_ms`, so a quiet
+    // symbol's last bar comes out without waiting for its next trade
+    void advance(int64_t now_ms) {
+        if (config_.kind != BarKind::Time) {
+            return;
+        }
+        for (std::size_t id = 0; id < open_.size(); ++id) {
+            if (open_[id].trades != 0 && open_[id].close_time < now_ms) {
+                close(static_cast<SymbolId>(id), open_[id]);
+            }
+        }
+    }
+
+    // Close every open bar, e.g. at the end of a backfill
+    void flush() {
+        for (std::size_t id = 0; id < open_.size(); ++id) {
+            if (open_[id].trades != 0) {
+                close(static_cast<SymbolId>(id), open_[id]);
+            }
+        }
+    }
+
+    // The bars closed since the last take()
+    BarColumns take() { return std::exchange(closed_, BarColumns{}); }
+
+    std::size_t open_bars() const {
+        return static_cast<std::size_t>(
+            std::count_if(open_.begin(), open_.end(), [](const OpenBar &bar) { return bar.trades != 0; }));
+    }
+
+    std::size_t pending() const { return closed_.size(); }
+    uint64_t bars() const { return bars_; }
+    const BarConfig &config() const { return config_; }
+
+private:
+    struct OpenBar {
+        int64_t open_time = 0;
+        int64_t close_time = 0;
+        int64_t first_trade_id = 0;
+        int64_t last_trade_id = 0;
+        double open = 0;
+        double high = 0;
+        double low = 0;
+        double close = 0;
+        double volume = 0;
+        double quote_volume = 0;
+        double buy_volume = 0;
+        double sell_volume = 0;
+        int64_t trades = 0;
+        // Over the trades added as mantissas
+        DecimalSum exact_volume;
+        DecimalSum exact_quote_volume;
+        int64_t exact_trades = 0;
+    };
+
+    // The symbol's open bar with the trade added, closing the previous time
+    // bar first if the trade is past it
+    OpenBar &extend(SymbolId symbol_id, int64_t trade_time_ms, int64_t trade_id, double price, double qty,
+                    bool is_buyer_maker) {
+        if (symbol_id >= open_.size()) {
+            open_.resize(static_cast<std::size_t>(symbol_id) + 1);
+        }
+        OpenBar &bar = open_[symbol_id];
+        if (bar.trades != 0 && config_.kind == BarKind::Time && trade_time_ms > bar.close_time) {
+            close(symbol_id, bar);
+        }
+        if (bar.trades == 0) {
+            start(bar, trade_time_ms, trade_id, price);
+        }
+        bar.high = std::max(bar.high, price);
+        bar.low = std::min(bar.low, price);
+        bar.close = price;
+        bar.last_trade_id = trade_id;
+        bar.volume += qty;
+        bar.quote_volume += price * qty;
+        (is_buyer_maker ? bar.sell_volume : bar.buy_volume) += qty;
+        ++bar.trades;
+        return bar;
+    }
+
+    // Close a tick, volume or dollar bar that reached its threshold
+    void settle(SymbolId symbol_id, OpenBar &bar, int64_t trade_time_ms) {
+        if (config_.kind != BarKind::Time) {
+            bar.close_time = std::max(bar.close_time, trade_time_ms);
+            if (full(bar)) {
+                close(symbol_id, bar);
+            }
+        }
+    }
+
+    void start(OpenBar &bar, int64_t trade_time_ms, int64_t trade_id, double price) {
+        bar = OpenBar{};
+        if (config_.kind == BarKind::Time) {
+            // Floor to the grid, negative times included
+            const int64_t offset = trade_time_ms % interval_ms_;
+            bar.open_time = trade_time_ms - (offset < 0 ? offset + interval_ms_ : offset);
+            bar.close_time = bar.open_time + interval_ms_ - 1;
+        } else {
+            bar.open_time = trade_time_ms;
+            bar.close_time = trade_time_ms;
+        }
+        bar.first_trade_id = trade_id;
+        bar.open = price;
+        bar.high = price;
+        bar.low = price;
+    }
+
+    bool full(const OpenBar &bar) const {
+        switch (config_.kind) {
+        case BarKind::Tick:
+            return static_cast<double>(bar.trades) >= config_.threshold;
+        case BarKind::Volume:
+            return bar.volume >= config_.threshold;
+        case BarKind::Dollar:
+            return bar.quote_volume >= config_.threshold;
+        case BarKind::Time:
+            break;
+        }
+        return false;
+    }
+
+    void close(SymbolId symbol_id, OpenBar &bar) {
+        closed_.symbol.push_back(to_symbol_code(symbol_table().name_of(symbol_id)));
+        closed_.symbol_id.push_back(symbol_id);
+        closed_.open_time.push_back(bar.open_time);
+        closed_.close_time.push_back(bar.close_time);
+        closed_.first_trade_id.push_back(bar.first_trade_id);
+        closed_.last_trade_id.push_back(bar.last_trade_id);
+        closed_.open.push_back(bar.open);
+        closed_.high.push_back(bar.high);
+        closed_.low.push_back(bar.low);
+        closed_.close.push_back(bar.close);
+        if (bar.exact_trades == bar.trades && bar.exact_volume.mantissa() > 0) {
+            closed_.volume.push_back(bar.exact_volume.to_double());
+            closed_.quote_volume.push_back(bar.exact_quote_volume.to_double());
+            closed_.vwap.push_back(bar.exact_quote_volume.ratio(bar.exact_volume));
+        } else {
+            closed_.volume.push_back(bar.volume);
+            closed_.quote_volume.push_back(bar.quote_volume);
+            closed_.vwap.push_back(bar.volume > 0 ? bar.quote_volume / bar.volume : bar.close);
+        }
+        closed_.trades.push_back(bar.trades);
+        closed_.buy_volume.push_back(bar.buy_volume);
+        closed_.sell_volume.push_back(bar.sell_volume);
+        bar.trades = 0;
+        ++bars_;
+    }
+
+    BarConfig config_;
+    int64_t interval_ms_ = 0;
+    // Open bar per SymbolId; trades == 0 means none
+    std::vector<OpenBar> open_;
+    BarColumns closed_;
+    uint64_t bars_ = 0;
+};
+
+#endif
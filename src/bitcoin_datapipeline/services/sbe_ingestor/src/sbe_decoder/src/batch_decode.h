@@ -0,0 +1,570 @@
+/*
+ * Columnar batch decoding of SBE stream frames.
+ *
+ * decode_frames() walks a batch of frames and appends rows to per-template
+ * column vectors: one row per trade (every entry of each frame's trades
+ * group), per aggregate trade of a REST aggTrades page (template 202) and
+ * per kline of a REST klines page (template 203), both read through the
+ * generated flyweights, and one row per message for the other templates;
+ * the levels of both depth templates share one level table keyed by frame
+ * index. It never touches Python objects, so the binding layer calls it
+ * with the GIL released and then hands the columns to NumPy without
+ * copying. With DecodeOptions::raw_mantissa the decimal columns hold the
+ * integer wire mantissas (plus per-row exponents) instead of doubles.
+ * Stream rows carry their symbol twice: the fixed-width cell and the dense
+ * ID from the process-wide symbol table (symbol_table.h).
+ */
+
+#ifndef _SBE_BATCH_DECODE_H_
+#define _SBE_BATCH_DECODE_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "official/util.h"
+#include "spot_sbe/AggTradesResponse.h"
+#include "spot_sbe/BoolEnum.h"
+#include "spot_sbe/KlinesResponse.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+#include "subscription_mask.h"
+#include "symbol_table.h"
+
+// Fixed-width symbol cell, exported to NumPy as dtype 'S16'
+using SymbolCode = std::array<char, 16>;
+
+inline SymbolCode to_symbol_code(std::string_view symbol) {
+    SymbolCode code{};
+    std::memcpy(code.data(), symbol.data(), std::min(symbol.size(), code.size()));
+    return code;
+}
+
+// Decimal field column. Scaled batches fill `value`; raw batches keep the
+// wire mantissas instead and skip floating-point conversion entirely.
+struct DecimalColumn {
+    std::vector<double> value;
+    std::vector<int64_t> mantissa;
+
+    void push(int64_t raw_mantissa, int8_t exponent, bool raw) {
+        if (raw) {
+            mantissa.push_back(raw_mantissa);
+        } else {
+            value.push_back(decode_decimal(raw_mantissa, exponent));
+        }
+    }
+
+    void append(const DecimalColumn &other) {
+        value.insert(value.end(), other.value.begin(), other.value.end());
+        mantissa.insert(mantissa.end(), other.mantissa.begin(), other.mantissa.end());
+    }
+};
+
+// Per-row exponents, only filled for raw batches
+struct ExponentColumns {
+    std::vector<int8_t> price_exponent;
+    std::vector<int8_t> qty_exponent;
+
+    void push(int8_t price, int8_t qty, bool raw) {
+        if (raw) {
+            price_exponent.push_back(price);
+            qty_exponent.push_back(qty);
+        }
+    }
+
+    void append(const ExponentColumns &other) {
+        price_exponent.insert(price_exponent.end(), other.price_exponent.begin(), other.price_exponent.end());
+        qty_exponent.insert(qty_exponent.end(), other.qty_exponent.begin(), other.qty_exponent.end());
+    }
+};
+
+struct DecodeOptions {
+    bool raw_mantissa = false;
+    // Receive timestamp shared by the whole batch; 0 reads the ingest clock
+    uint64_t ingest_ts_us = 0;
+    // Frames the mask rejects are skipped undecoded; null decodes them all
+    const SubscriptionMask *subscription = nullptr;
+};
+
+struct TradeColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<int64_t> event_ts;
+    std::vector<int64_t> trade_time;
+    std::vector<int64_t> trade_id;
+    DecimalColumn price;
+    DecimalColumn qty;
+    ExponentColumns exponents;
+    std::vector<uint8_t> is_buyer_maker;
+    std::vector<SymbolCode> symbol;
+    std::vector<SymbolId> symbol_id;
+};
+
+struct BestBidAskColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<int64_t> event_ts;
+    std::vector<int64_t> book_update_id;
+    DecimalColumn bid_px;
+    DecimalColumn bid_sz;
+    DecimalColumn ask_px;
+    DecimalColumn ask_sz;
+    ExponentColumns exponents;
+    std::vector<SymbolCode> symbol;
+    std::vector<SymbolId> symbol_id;
+};
+
+struct DepthDiffColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<int64_t> event_ts;
+    std::vector<int64_t> first_update_id;
+    std::vector<int64_t> final_update_id;
+    std::vector<SymbolCode> symbol;
+    std::vector<SymbolId> symbol_id;
+};
+
+// Template 10002: one row per top-N snapshot
+struct PartialDepthColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<int64_t> event_ts;
+    std::vector<int64_t> book_update_id;
+    std::vector<SymbolCode> symbol;
+    std::vector<SymbolId> symbol_id;
+};
+
+// One row per depth diff that skipped updates, found by the native
+// receiver while staging (see depth_sequence.h); `frame_index` is the
+// diff's frame
+struct DepthGapColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<int64_t> event_ts;
+    std::vector<int64_t> expected_first_update_id;
+    std::vector<int64_t> first_update_id;
+    std::vector<SymbolCode> symbol;
+    std::vector<SymbolId> symbol_id;
+};
+
+// One row per conflated frame (see conflation.h): what the interval behind
+// the frame's latest quote or book saw. `stream` is 0 for bestBidAsk, 1 for
+// depth; the ranges are the touch's bid and ask prices.
+struct ConflationColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<int64_t> event_ts;
+    std::vector<int64_t> first_event_ts;
+    std::vector<uint8_t> stream;
+    std::vector<int64_t> updates;
+    DecimalColumn bid_low;
+    DecimalColumn bid_high;
+    DecimalColumn ask_low;
+    DecimalColumn ask_high;
+    ExponentColumns exponents;
+    std::vector<SymbolCode> symbol;
+    std::vector<SymbolId> symbol_id;
+};
+
+// One row per price level of every depth frame (diff or partial snapshot)
+// in the batch
+struct DepthLevelColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<uint8_t> is_bid;
+    DecimalColumn price;
+    DecimalColumn qty;
+    ExponentColumns exponents;
+};
+
+// Template 202 (REST aggTrades page): one row per aggregate trade
+struct AggTradeColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<int64_t> agg_trade_id;
+    DecimalColumn price;
+    DecimalColumn qty;
+    ExponentColumns exponents;
+    std::vector<int64_t> first_trade_id;
+    std::vector<int64_t> last_trade_id;
+    std::vector<int64_t> trade_time;
+    std::vector<uint8_t> is_buyer_maker;
+};
+
+// Template 203 (REST klines page): one row per kline. Volumes are uint128
+// mantissas on the wire, so they are always decoded to doubles; raw batches
+// keep the OHLC mantissas plus the page's exponents.
+struct KlineColumns {
+    std::vector<int64_t> frame_index;
+    std::vector<int64_t> open_time;
+    std::vector<int64_t> close_time;
+    DecimalColumn open;
+    DecimalColumn high;
+    DecimalColumn low;
+    DecimalColumn close;
+    ExponentColumns exponents;
+    std::vector<double> volume;
+    std::vector<double> quote_volume;
+    std::vector<int64_t> num_trades;
+};
+
+struct BatchColumns {
+    uint64_t ingest_ts = 0;
+    uint64_t ingest_ts_us = 0;
+    bool raw_mantissa = false;
+    TradeColumns trades;
+    BestBidAskColumns best_bid_ask;
+    DepthDiffColumns depth;
+    PartialDepthColumns partial_depth;
+    DepthGapColumns depth_gaps;
+    DepthLevelColumns depth_levels;
+    ConflationColumns conflation;
+    AggTradeColumns agg_trades;
+    KlineColumns klines;
+    std::vector<int64_t> error_frames;
+    // ParseError of each error frame, parallel to error_frames
+    std::vector<uint8_t> error_causes;
+    std::vector<int64_t> unknown_frames;
+    // Per-frame receive time, filled when frames arrive over time (native
+    // receiver) rather than as one caller-supplied batch
+    std::vector<uint64_t> frame_ingest_ts_us;
+    // Frames a SubscriptionMask skipped
+    uint64_t filtered_frames = 0;
+};
+
+template <typename T>
+void append_column(std::vector<T> &dst, const std::vector<T> &src) {
+    dst.insert(dst.end(), src.begin(), src.end());
+}
+
+// Append every row of `src` to `dst`; frame indexes are kept as they are.
+// Batch-level fields (ingest time, raw_mantissa) stay those of `dst`.
+inline void append_batch(BatchColumns &dst, const BatchColumns &src) {
+    auto &trades = dst.trades;
+    append_column(trades.frame_index, src.trades.frame_index);
+    append_column(trades.event_ts, src.trades.event_ts);
+    append_column(trades.trade_time, src.trades.trade_time);
+    append_column(trades.trade_id, src.trades.trade_id);
+    trades.price.append(src.trades.price);
+    trades.qty.append(src.trades.qty);
+    trades.exponents.append(src.trades.exponents);
+    append_column(trades.is_buyer_maker, src.trades.is_buyer_maker);
+    append_column(trades.symbol, src.trades.symbol);
+    append_column(trades.symbol_id, src.trades.symbol_id);
+
+    auto &bba = dst.best_bid_ask;
+    append_column(bba.frame_index, src.best_bid_ask.frame_index);
+    append_column(bba.event_ts, src.best_bid_ask.event_ts);
+    append_column(bba.book_update_id, src.best_bid_ask.book_update_id);
+    bba.bid_px.append(src.best_bid_ask.bid_px);
+    bba.bid_sz.append(src.best_bid_ask.bid_sz);
+    bba.ask_px.append(src.best_bid_ask.ask_px);
+    bba.ask_sz.append(src.best_bid_ask.ask_sz);
+    bba.exponents.append(src.best_bid_ask.exponents);
+    append_column(bba.symbol, src.best_bid_ask.symbol);
+    append_column(bba.symbol_id, src.best_bid_ask.symbol_id);
+
+    auto &depth = dst.depth;
+    append_column(depth.frame_index, src.depth.frame_index);
+    append_column(depth.event_ts, src.depth.event_ts);
+    append_column(depth.first_update_id, src.depth.first_update_id);
+    append_column(depth.final_update_id, src.depth.final_update_id);
+    append_column(depth.symbol, src.depth.symbol);
+    append_column(depth.symbol_id, src.depth.symbol_id);
+
+    auto &partial = dst.partial_depth;
+    append_column(partial.frame_index, src.partial_depth.frame_index);
+    append_column(partial.event_ts, src.partial_depth.event_ts);
+    append_column(partial.book_update_id, src.partial_depth.book_update_id);
+    append_column(partial.symbol, src.partial_depth.symbol);
+    append_column(partial.symbol_id, src.partial_depth.symbol_id);
+
+    auto &gaps = dst.depth_gaps;
+    append_column(gaps.frame_index, src.depth_gaps.frame_index);
+    append_column(gaps.event_ts, src.depth_gaps.event_ts);
+    append_column(gaps.expected_first_update_id, src.depth_gaps.expected_first_update_id);
+    append_column(gaps.first_update_id, src.depth_gaps.first_update_id);
+    append_column(gaps.symbol, src.depth_gaps.symbol);
+    append_column(gaps.symbol_id, src.depth_gaps.symbol_id);
+
+    auto &levels = dst.depth_levels;
+    append_column(levels.frame_index, src.depth_levels.frame_index);
+    append_column(levels.is_bid, src.depth_levels.is_bid);
+    levels.price.append(src.depth_levels.price);
+    levels.qty.append(src.depth_levels.qty);
+    levels.exponents.append(src.depth_levels.exponents);
+
+    auto &conflation = dst.conflation;
+    append_column(conflation.frame_index, src.conflation.frame_index);
+    append_column(conflation.event_ts, src.conflation.event_ts);
+    append_column(conflation.first_event_ts, src.conflation.first_event_ts);
+    append_column(conflation.stream, src.conflation.stream);
+    append_column(conflation.updates, src.conflation.updates);
+    conflation.bid_low.append(src.conflation.bid_low);
+    conflation.bid_high.append(src.conflation.bid_high);
+    conflation.ask_low.append(src.conflation.ask_low);
+    conflation.ask_high.append(src.conflation.ask_high);
+    conflation.exponents.append(src.conflation.exponents);
+    append_column(conflation.symbol, src.conflation.symbol);
+    append_column(conflation.symbol_id, src.conflation.symbol_id);
+
+    auto &agg = dst.agg_trades;
+    append_column(agg.frame_index, src.agg_trades.frame_index);
+    append_column(agg.agg_trade_id, src.agg_trades.agg_trade_id);
+    agg.price.append(src.agg_trades.price);
+    agg.qty.append(src.agg_trades.qty);
+    agg.exponents.append(src.agg_trades.exponents);
+    append_column(agg.first_trade_id, src.agg_trades.first_trade_id);
+    append_column(agg.last_trade_id, src.agg_trades.last_trade_id);
+    append_column(agg.trade_time, src.agg_trades.trade_time);
+    append_column(agg.is_buyer_maker, src.agg_trades.is_buyer_maker);
+
+    auto &klines = dst.klines;
+    append_column(klines.frame_index, src.klines.frame_index);
+    append_column(klines.open_time, src.klines.open_time);
+    append_column(klines.close_time, src.klines.close_time);
+    klines.open.append(src.klines.open);
+    klines.high.append(src.klines.high);
+    klines.low.append(src.klines.low);
+    klines.close.append(src.klines.close);
+    klines.exponents.append(src.klines.exponents);
+    append_column(klines.volume, src.klines.volume);
+    append_column(klines.quote_volume, src.klines.quote_volume);
+    append_column(klines.num_trades, src.klines.num_trades);
+
+    append_column(dst.error_frames, src.error_frames);
+    append_column(dst.error_causes, src.error_causes);
+    append_column(dst.unknown_frames, src.unknown_frames);
+    append_column(dst.frame_ingest_ts_us, src.frame_ingest_ts_us);
+}
+
+// Bid then ask level rows of a depth diff or partial depth frame
+template <typename DepthFrame>
+void append_depth_levels(const char *data, const DepthFrame &depth, int64_t index, BatchColumns &out) {
+    const bool raw = out.raw_mantissa;
+    auto &levels = out.depth_levels;
+    auto append_side = [&](const LevelGroup &group, uint8_t is_bid) {
+        for_each_level(data, group, [&](const LevelMantissa &level) {
+            levels.frame_index.push_back(index);
+            levels.is_bid.push_back(is_bid);
+            levels.price.push(level.price, depth.price_exponent, raw);
+            levels.qty.push(level.qty, depth.qty_exponent, raw);
+            levels.exponents.push(depth.price_exponent, depth.qty_exponent, raw);
+        });
+    };
+    append_side(depth.bids, 1);
+    append_side(depth.asks, 0);
+}
+
+// An error frame and why it failed
+[[gnu::cold]] inline void push_error_frame(BatchColumns &out, int64_t index, ParseError cause) {
+    out.error_frames.push_back(index);
+    out.error_causes.push_back(static_cast<uint8_t>(cause));
+}
+
+// Check that the root block and the first repeating group of a REST
+// response (groupSizeEncoding right after the root block) fit in the frame
+// before the generated flyweight is wrapped or any row is emitted, so a
+// truncated page is an error frame rather than a partial one
+inline ParseError check_response_group(std::span<char> frame, const spot_sbe::MessageHeader &header) noexcept {
+    const char *body = frame.data() + spot_sbe::MessageHeader::encodedLength();
+    const std::size_t body_size = frame.size() - spot_sbe::MessageHeader::encodedLength();
+    std::size_t offset = header.blockLength();
+    if (offset > body_size) [[unlikely]] {
+        return ParseError::ShortBlock;
+    }
+    uint16_t entry_length = 0;
+    uint32_t count = 0;
+    if (!read_little_endian(body, body_size, offset, entry_length) ||
+        !read_little_endian(body, body_size, offset, count)) [[unlikely]] {
+        return ParseError::GroupHeader;
+    }
+    if (static_cast<uint64_t>(count) * entry_length > body_size - offset) [[unlikely]] {
+        return ParseError::GroupOverrun;
+    }
+    return ParseError::None;
+}
+
+// Rows of a REST aggTrades page; one exponent pair covers the whole page
+inline void append_agg_trades(std::span<char> frame, const spot_sbe::MessageHeader &header, int64_t index,
+                              BatchColumns &out) {
+    const bool raw = out.raw_mantissa;
+    auto page = message_from_header<spot_sbe::AggTradesResponse>(frame, header);
+    const int8_t price_exponent = page.priceExponent();
+    const int8_t qty_exponent = page.qtyExponent();
+
+    auto &cols = out.agg_trades;
+    page.aggTrades().forEach([&](auto &trade) {
+        cols.frame_index.push_back(index);
+        cols.agg_trade_id.push_back(trade.aggTradeId());
+        cols.price.push(trade.price(), price_exponent, raw);
+        cols.qty.push(trade.qty(), qty_exponent, raw);
+        cols.exponents.push(price_exponent, qty_exponent, raw);
+        cols.first_trade_id.push_back(trade.firstTradeId());
+        cols.last_trade_id.push_back(trade.lastTradeId());
+        cols.trade_time.push_back(trade.time());
+        cols.is_buyer_maker.push_back(trade.isBuyerMaker() == spot_sbe::BoolEnum::Value::True ? 1 : 0);
+    });
+}
+
+// Rows of a REST klines page
+inline void append_klines(std::span<char> frame, const spot_sbe::MessageHeader &header, int64_t index,
+                          BatchColumns &out) {
+    const bool raw = out.raw_mantissa;
+    auto page = message_from_header<spot_sbe::KlinesResponse>(frame, header);
+    const int8_t price_exponent = page.priceExponent();
+    const int8_t qty_exponent = page.qtyExponent();
+
+    auto &cols = out.klines;
+    page.klines().forEach([&](auto &kline) {
+        cols.frame_index.push_back(index);
+        cols.open_time.push_back(kline.openTime());
+        cols.close_time.push_back(kline.closeTime());
+        cols.open.push(kline.openPrice(), price_exponent, raw);
+        cols.high.push(kline.highPrice(), price_exponent, raw);
+        cols.low.push(kline.lowPrice(), price_exponent, raw);
+        cols.close.push(kline.closePrice(), price_exponent, raw);
+        cols.exponents.push(price_exponent, qty_exponent, raw);
+        cols.volume.push_back(decode_decimal_u128(kline.volume(), qty_exponent));
+        cols.quote_volume.push_back(decode_decimal_u128(kline.quoteVolume(), price_exponent + qty_exponent));
+        cols.num_trades.push_back(kline.numTrades());
+    });
+}
+
+// Rows of a REST page through `Append` (aggTrades or klines). The group is
+// checked up front; whatever the generated flyweight still rejects counts
+// as Rejected.
+template <void (*Append)(std::span<char>, const spot_sbe::MessageHeader &, int64_t, BatchColumns &)>
+ParseError append_response(std::span<char> frame, const spot_sbe::MessageHeader &header, int64_t index,
+                           BatchColumns &out) {
+    if (const ParseError error = check_response_group(frame, header); error != ParseError::None) [[unlikely]] {
+        return error;
+    }
+    try {
+        Append(frame, header, index, out);
+    } catch (const std::exception &) {
+        return ParseError::Rejected;
+    }
+    return ParseError::None;
+}
+
+// Append the rows of one frame. `index` is the frame's position in the
+// batch; out.raw_mantissa selects the decimal representation.
+inline void decode_frame(std::span<char> frame, int64_t index, BatchColumns &out) {
+    using spot_sbe::MessageHeader;
+
+    const bool raw = out.raw_mantissa;
+    if (frame.size() < MessageHeader::encodedLength()) [[unlikely]] {
+        push_error_frame(out, index, ParseError::ShortHeader);
+        return;
+    }
+
+    MessageHeader header{frame.data(), frame.size()};
+    const char *data = frame.data() + MessageHeader::encodedLength();
+    const std::size_t data_size = frame.size() - MessageHeader::encodedLength();
+
+    ParseError error = ParseError::None;
+    switch (header.templateId()) {
+    case TRADES_STREAM_EVENT: {
+        TradeFrame trade;
+        error = parse_trade_frame(data, data_size, header.blockLength(), trade);
+        if (error != ParseError::None) [[unlikely]] {
+            break;
+        }
+        const auto event_ts = static_cast<int64_t>(micros_to_millis(trade.event_time_us));
+        const auto trade_time = static_cast<int64_t>(micros_to_millis(trade.trade_time_us));
+        const auto symbol = to_symbol_code(trade.symbol);
+        const SymbolId symbol_id = symbol_table().intern(trade.symbol);
+        auto &cols = out.trades;
+        for_each_trade_entry(data, data_size, trade, [&](const TradeEntry &entry) {
+            cols.frame_index.push_back(index);
+            cols.event_ts.push_back(event_ts);
+            cols.trade_time.push_back(trade_time);
+            cols.trade_id.push_back(static_cast<int64_t>(entry.trade_id));
+            cols.price.push(entry.price_mantissa, trade.price_exponent, raw);
+            cols.qty.push(entry.qty_mantissa, trade.qty_exponent, raw);
+            cols.exponents.push(trade.price_exponent, trade.qty_exponent, raw);
+            cols.is_buyer_maker.push_back(entry.is_buyer_maker ? 1 : 0);
+            cols.symbol.push_back(symbol);
+            cols.symbol_id.push_back(symbol_id);
+        });
+        break;
+    }
+    case BEST_BID_ASK_STREAM_EVENT: {
+        BestBidAskFrame bba;
+        error = parse_best_bid_ask_frame(data, data_size, header.blockLength(), bba);
+        if (error != ParseError::None) [[unlikely]] {
+            break;
+        }
+        auto &cols = out.best_bid_ask;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(bba.event_time_us)));
+        cols.book_update_id.push_back(static_cast<int64_t>(bba.book_update_id));
+        cols.bid_px.push(bba.bid_price_mantissa, bba.price_exponent, raw);
+        cols.bid_sz.push(bba.bid_qty_mantissa, bba.qty_exponent, raw);
+        cols.ask_px.push(bba.ask_price_mantissa, bba.price_exponent, raw);
+        cols.ask_sz.push(bba.ask_qty_mantissa, bba.qty_exponent, raw);
+        cols.exponents.push(bba.price_exponent, bba.qty_exponent, raw);
+        cols.symbol.push_back(to_symbol_code(bba.symbol));
+        cols.symbol_id.push_back(symbol_table().intern(bba.symbol));
+        break;
+    }
+    case DEPTH_DIFF_STREAM_EVENT: {
+        DepthDiffFrame depth;
+        error = parse_depth_diff_frame(data, data_size, header.blockLength(), depth);
+        if (error != ParseError::None) [[unlikely]] {
+            break;
+        }
+        auto &cols = out.depth;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(depth.event_time_us)));
+        cols.first_update_id.push_back(static_cast<int64_t>(depth.first_update_id));
+        cols.final_update_id.push_back(static_cast<int64_t>(depth.final_update_id));
+        cols.symbol.push_back(to_symbol_code(depth.symbol));
+        cols.symbol_id.push_back(symbol_table().intern(depth.symbol));
+
+        append_depth_levels(data, depth, index, out);
+        break;
+    }
+    case DEPTH_SNAPSHOT_STREAM_EVENT: {
+        DepthSnapshotFrame snapshot;
+        error = parse_depth_snapshot_frame(data, data_size, header.blockLength(), snapshot);
+        if (error != ParseError::None) [[unlikely]] {
+            break;
+        }
+        auto &cols = out.partial_depth;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(snapshot.event_time_us)));
+        cols.book_update_id.push_back(static_cast<int64_t>(snapshot.book_update_id));
+        cols.symbol.push_back(to_symbol_code(snapshot.symbol));
+        cols.symbol_id.push_back(symbol_table().intern(snapshot.symbol));
+        append_depth_levels(data, snapshot, index, out);
+        break;
+    }
+    case spot_sbe::AggTradesResponse::SBE_TEMPLATE_ID:
+        error = append_response<&append_agg_trades>(frame, header, index, out);
+        break;
+    case spot_sbe::KlinesResponse::SBE_TEMPLATE_ID:
+        error = append_response<&append_klines>(frame, header, index, out);
+        break;
+    default:
+        out.unknown_frames.push_back(index);
+        break;
+    }
+    if (error != ParseError::None) [[unlikely]] {
+        push_error_frame(out, index, error);
+    }
+}
+
+inline void decode_frames(std::span<const std::span<char>> frames, BatchColumns &out,
+                          DecodeOptions options = {}) {
+    out.raw_mantissa = options.raw_mantissa;
+
+    // One clock read per batch, shared by every row
+    out.ingest_ts_us = options.ingest_ts_us != 0 ? options.ingest_ts_us : ingest_time_us();
+    out.ingest_ts = micros_to_millis(out.ingest_ts_us);
+
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        if (options.subscription != nullptr && !options.subscription->admits(frames[i])) {
+            ++out.filtered_frames;
+            continue;
+        }
+        decode_frame(frames[i], static_cast<int64_t>(i), out);
+    }
+}
+
+#endif
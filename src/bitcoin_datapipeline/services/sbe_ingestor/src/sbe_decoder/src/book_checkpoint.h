@@ -0,0 +1,267 @@
+/*
+ * Binary order book checkpoints for fast restart.
+ *
+ * A checkpoint file holds every in-sync book of a process as it stood at
+ * one moment: per symbol its last update ID, event time, exponents and
+ * levels as (price, qty) int64 mantissas, best price first. Restoring a
+ * book from it is a memcpy-sized copy per side, so a restarted ingestor has
+ * all its books back in milliseconds instead of one REST snapshot per
+ * symbol. A restored book is only a candidate: the first diff it sees
+ * either continues its update IDs and it is live, or skips past them and
+ * the usual gap -> snapshot resync (book_sync.h) takes over.
+ *
+ * Layout: a 64-byte BookCheckpointHeader, `books` 72-byte
+ * BookCheckpointEntry records, then all levels as 16-byte BookLevels, so
+ * the file is read in place through a read-only mapping. Files are
+ * replaced atomically (checkpoint_file.h).
+ */
+
+#ifndef _SBE_BOOK_CHECKPOINT_H_
+#define _SBE_BOOK_CHECKPOINT_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "checkpoint_file.h"
+#include "order_book.h"
+
+constexpr char BOOK_CHECKPOINT_MAGIC[8] = {'S', 'B', 'E', 'B', 'O', 'O', 'K', '1'};
+constexpr uint32_t BOOK_CHECKPOINT_VERSION = 1;
+
+struct BookCheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    // Wall-clock time the checkpoint was taken
+    uint64_t written_us;
+    uint32_t books;
+    uint32_t entry_size;
+    // BookLevels after the entries
+    uint64_t levels;
+    char padding[24];
+};
+static_assert(sizeof(BookCheckpointHeader) == 64);
+
+struct BookCheckpointEntry {
+    // NUL-padded
+    char symbol[32];
+    uint64_t last_update_id;
+    uint64_t event_time_us;
+    // Index of the first bid in the level array; the asks follow the bids
+    uint64_t first_level;
+    uint32_t bid_count;
+    uint32_t ask_count;
+    int8_t price_exponent;
+    int8_t qty_exponent;
+    char padding[6];
+};
+static_assert(sizeof(BookCheckpointEntry) == 72);
+static_assert(sizeof(BookLevel) == 16);
+
+// Write `books` to `path`, skipping empty books and those waiting for a
+// resync, whose levels cannot be resumed from. Returns the books written.
+// Throws std::runtime_error on I/O errors or a symbol over 32 bytes.
+inline std::size_t write_book_checkpoint(const std::string &path, std::span<const OrderBook *const> books,
+                                         uint64_t written_us) {
+    std::vector<const OrderBook *> kept;
+    uint64_t levels = 0;
+    for (const OrderBook *book : books) {
+        if (book == nullptr || book->last_update_id() == 0 || book->resync_pending()) {
+            continue;
+        }
+        if (book->symbol().size() > sizeof(BookCheckpointEntry::symbol)) {
+            throw std::runtime_error("book checkpoint: symbol longer than 32 bytes: " + book->symbol());
+        }
+        kept.push_back(book);
+        levels += book->bids().size() + book->asks().size();
+    }
+
+    BookCheckpointHeader header{};
+    std::memcpy(header.magic, BOOK_CHECKPOINT_MAGIC, sizeof(BOOK_CHECKPOINT_MAGIC));
+    header.version = BOOK_CHECKPOINT_VERSION;
+    header.header_size = sizeof(BookCheckpointHeader);
+    header.written_us = written_us;
+    header.books = static_cast<uint32_t>(kept.size());
+    header.entry_size = sizeof(BookCheckpointEntry);
+    header.levels = levels;
+
+    std::vector<char> out(sizeof(BookCheckpointHeader) + kept.size() * sizeof(BookCheckpointEntry) +
+                          levels * sizeof(BookLevel));
+    std::memcpy(out.data(), &header, sizeof(header));
+    auto *entry = reinterpret_cast<BookCheckpointEntry *>(out.data() + sizeof(BookCheckpointHeader));
+    auto *level = reinterpret_cast<BookLevel *>(entry + kept.size());
+    uint64_t next_level = 0;
+    for (const OrderBook *book : kept) {
+        *entry = BookCheckpointEntry{};
+        std::memcpy(entry->symbol, book->symbol().data(), book->symbol().size());
+        entry->last_update_id = book->last_update_id();
+        entry->event_time_us = book->event_time_us();
+        entry->first_level = next_level;
+        entry->bid_count = static_cast<uint32_t>(book->bids().size());
+        entry->ask_count = static_cast<uint32_t>(book->asks().size());
+        entry->price_exponent = book->price_exponent();
+        entry->qty_exponent = book->qty_exponent();
+        for (const BookSideLevels *side : {&book->bids(), &book->asks()}) {
+            side->for_each_top(side->size(), [&](const BookLevel &l) { level[next_level++] = l; });
+        }
+        ++entry;
+    }
+
+    write_checkpoint_file(path, out);
+    return kept.size();
+}
+
+// Read-only view of a checkpoint file
+class BookCheckpoint {
+public:
+    // Map and validate `path`; throws std::runtime_error if it is missing
+    // or not a complete checkpoint
+    explicit BookCheckpoint(const std::string &path) : file_(path, sizeof(BookCheckpointHeader)) {
+        const std::size_t file_size = file_.size();
+        const BookCheckpointHeader &h = header();
+        const std::size_t entries_end =
+            sizeof(BookCheckpointHeader) + std::size_t{h.books} * sizeof(BookCheckpointEntry);
+        if (std::memcmp(h.magic, BOOK_CHECKPOINT_MAGIC, sizeof(BOOK_CHECKPOINT_MAGIC)) != 0 ||
+            h.version != BOOK_CHECKPOINT_VERSION || h.header_size != sizeof(BookCheckpointHeader) ||
+            h.entry_size != sizeof(BookCheckpointEntry) || entries_end > file_size ||
+            h.levels > (file_size - entries_end) / sizeof(BookLevel)) {
+            throw std::runtime_error("not a book checkpoint: " + path);
+        }
+        for (const auto &e : entries()) {
+            if (e.first_level > h.levels || uint64_t{e.bid_count} + e.ask_count > h.levels - e.first_level) {
+                throw std::runtime_error("corrupt book checkpoint: " + path);
+            }
+        }
+    }
+
+    const BookCheckpointHeader &header() const { return *reinterpret_cast<const BookCheckpointHeader *>(file_.data()); }
+    uint64_t written_us() const { return header().written_us; }
+    std::size_t size() const { return header().books; }
+
+    std::span<const BookCheckpointEntry> entries() const {
+        return {reinterpret_cast<const BookCheckpointEntry *>(file_.data() + sizeof(BookCheckpointHeader)), size()};
+    }
+
+    static std::string_view symbol_of(const BookCheckpointEntry &entry) {
+        return {entry.symbol, strnlen(entry.symbol, sizeof(entry.symbol))};
+    }
+
+    // Index of `symbol`'s entry, or -1
+    int64_t find(std::string_view symbol) const {
+        const auto all = entries();
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            if (symbol_of(all[i]) == symbol) {
+                return static_cast<int64_t>(i);
+            }
+        }
+        return -1;
+    }
+
+    // Replace `book` with entry `index` as it was checkpointed
+    void load(std::size_t index, OrderBook &book) const {
+        const BookCheckpointEntry &entry = entries()[index];
+        const BookLevel *levels = reinterpret_cast<const BookLevel *>(file_.data() + sizeof(BookCheckpointHeader) +
+                                                                      size() * sizeof(BookCheckpointEntry)) +
+                                  entry.first_level;
+        const auto copy = [](const BookLevel *side, uint32_t count) {
+            return [side, count](auto &&emit) {
+                for (uint32_t i = 0; i < count; ++i) {
+                    emit(side[i].price, side[i].qty);
+                }
+            };
+        };
+        book.load_snapshot(entry.last_update_id, entry.price_exponent, entry.qty_exponent,
+                           [&](BookSideLevels &bids, BookSideLevels &asks) {
+                               bids.assign_best_first(entry.bid_count, copy(levels, entry.bid_count));
+                               asks.assign_best_first(entry.ask_count,
+                                                      copy(levels + entry.bid_count, entry.ask_count));
+                           });
+        book.set_event_time_us(entry.event_time_us);
+    }
+
+    // Entry `index` as a new book
+    OrderBook book(std::size_t index) const {
+        OrderBook result{std::string(symbol_of(entries()[index]))};
+        load(index, result);
+        return result;
+    }
+
+private:
+    MappedCheckpoint file_;
+};
+
+// Background writer calling `save` every interval_ms, and once more on stop
+class BookCheckpointer {
+public:
+    BookCheckpointer(std::function<void()> save, int interval_ms)
+        : save_(std::move(save)), interval_ms_(std::max(interval_ms, 1)) {}
+
+    ~BookCheckpointer() { stop(); }
+
+    BookCheckpointer(const BookCheckpointer &) = delete;
+    BookCheckpointer &operator=(const BookCheckpointer &) = delete;
+
+    void start() {
+        if (running_.exchange(true)) {
+            return;
+        }
+        worker_ = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+        save_quietly();
+    }
+
+    // Checkpoints written, and attempts that threw
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int POLL_SLICE_MS = 100;
+
+    void run() {
+        auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval_ms_);
+        while (running_.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(interval_ms_, POLL_SLICE_MS)));
+            if (std::chrono::steady_clock::now() >= next) {
+                save_quietly();
+                next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval_ms_);
+            }
+        }
+    }
+
+    // A failed write keeps the previous checkpoint; the next one retries
+    void save_quietly() {
+        try {
+            save_();
+            written_.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception &) {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    const std::function<void()> save_;
+    const int interval_ms_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::thread worker_;
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Order-independent checksums of book levels.
+ *
+ * Deciding whether a book has drifted from the exchange used to take a
+ * level-by-level compare against a REST snapshot. Instead each side keeps
+ * a running checksum: the sum (mod 2^64) of a hash of every level it
+ * holds. Setting a level subtracts the old level's hash and adds the new
+ * one, so a diff costs one hash per level it changes, and a snapshot's
+ * checksum is the same sum over its levels. Equal books give equal sums;
+ * a book that lost or kept a level, or holds a wrong quantity, differs
+ * with overwhelming probability.
+ *
+ * A level is hashed by its value, not its mantissa: price and qty are
+ * brought to a common exponent (BOOK_CHECKSUM_EXPONENT) in 128-bit
+ * arithmetic that wraps, so 650001e-1 and 6500010e-2 hash alike and a book
+ * that moved to a finer exponent keeps its checksum without rehashing.
+ * 10^k is 2^k times an odd number, so the wrap keeps distinct mantissas
+ * distinct for exponents up to BOOK_CHECKSUM_EXPONENT + 64; exponents
+ * finer than BOOK_CHECKSUM_EXPONENT are not normalized. Bids and asks hash
+ * differently, so a level on the wrong side does not cancel out.
+ */
+
+#ifndef _SBE_BOOK_CHECKSUM_H_
+#define _SBE_BOOK_CHECKSUM_H_
+
+#include <cstdint>
+
+// Finest exponent a checksum normalizes levels to
+constexpr int BOOK_CHECKSUM_EXPONENT = -32;
+
+class LevelHasher {
+public:
+    LevelHasher() = default;
+    LevelHasher(int8_t price_exponent, int8_t qty_exponent)
+        : price_scale_(scale_of(price_exponent)), qty_scale_(scale_of(qty_exponent)) {}
+
+    // Hash of a level of `qty` (mantissa) at `price`; an empty level has none
+    uint64_t operator()(bool bid, int64_t price, int64_t qty) const {
+        if (qty == 0) {
+            return 0;
+        }
+        const unsigned __int128 p = static_cast<unsigned __int128>(static_cast<uint64_t>(price)) * price_scale_;
+        const unsigned __int128 q = static_cast<unsigned __int128>(static_cast<uint64_t>(qty)) * qty_scale_;
+        uint64_t h = mix(static_cast<uint64_t>(p) ^ (bid ? BID_SEED : ASK_SEED));
+        h = mix(h ^ static_cast<uint64_t>(p >> 64));
+        h = mix(h ^ static_cast<uint64_t>(q));
+        return mix(h ^ static_cast<uint64_t>(q >> 64));
+    }
+
+private:
+    static constexpr uint64_t BID_SEED = 0x9e3779b97f4a7c15ULL;
+    static constexpr uint64_t ASK_SEED = 0xc2b2ae3d27d4eb4fULL;
+
+    // 10^(exponent - BOOK_CHECKSUM_EXPONENT), wrapped to 128 bits
+    static unsigned __int128 scale_of(int8_t exponent) {
+        unsigned __int128 scale = 1;
+        for (int i = BOOK_CHECKSUM_EXPONENT; i < exponent; ++i) {
+            scale *= 10;
+        }
+        return scale;
+    }
+
+    // splitmix64 finalizer
+    static uint64_t mix(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    unsigned __int128 price_scale_ = 1;
+    unsigned __int128 qty_scale_ = 1;
+};
+
+#endif
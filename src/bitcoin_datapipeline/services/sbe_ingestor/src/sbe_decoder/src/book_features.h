@@ -0,0 +1,153 @@
+/*
+ * Fixed-layout top-of-book and depth features of an OrderBook.
+ *
+ * FeatureBuilder._build_orderbook_features and _build_depth_features derive
+ * spread, mid and imbalance from lists of message dicts, well behind the
+ * book at best bid/ask rates. OrderBook instead refreshes one
+ * BookFeatureVector after every update it applies: mid, spread (also in
+ * ticks), microprice, a depth-weighted mid, and cumulative depth and
+ * imbalance at 1, 5, 10 and 20 levels. One walk over the top 20 levels of
+ * each side, so the cost does not depend on book depth.
+ *
+ * Values are doubles in price and base-asset units, each rounded once from
+ * exact mantissa sums; the vector is all NaN
+ * while either side is empty. BOOK_FEATURE_NAMES gives the layout to
+ * Python, so consumers index by name once and then by position.
+ */
+
+#ifndef _SBE_BOOK_FEATURES_H_
+#define _SBE_BOOK_FEATURES_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "decimal64.h"
+#include "stream_decode.h"
+
+// Positions in BookFeatureVector
+enum BookFeature : std::size_t {
+    BOOK_BEST_BID,
+    BOOK_BEST_ASK,
+    BOOK_MID,
+    BOOK_SPREAD,
+    BOOK_SPREAD_TICKS,
+    // Best prices weighted by the opposite side's quantity
+    BOOK_MICROPRICE,
+    // Mean of the qty-weighted bid and ask prices over the top 5 levels
+    BOOK_WEIGHTED_MID,
+    BOOK_BID_DEPTH_1,
+    BOOK_ASK_DEPTH_1,
+    BOOK_IMBALANCE_1,
+    BOOK_BID_DEPTH_5,
+    BOOK_ASK_DEPTH_5,
+    BOOK_IMBALANCE_5,
+    BOOK_BID_DEPTH_10,
+    BOOK_ASK_DEPTH_10,
+    BOOK_IMBALANCE_10,
+    BOOK_BID_DEPTH_20,
+    BOOK_ASK_DEPTH_20,
+    BOOK_IMBALANCE_20,
+    BOOK_FEATURE_COUNT,
+};
+
+inline constexpr std::array<const char *, BOOK_FEATURE_COUNT> BOOK_FEATURE_NAMES = {
+    "best_bid",     "best_ask",     "mid",          "spread",       "spread_ticks", "microprice",
+    "weighted_mid", "bid_depth_1",  "ask_depth_1",  "imbalance_1",  "bid_depth_5",  "ask_depth_5",
+    "imbalance_5",  "bid_depth_10", "ask_depth_10", "imbalance_10", "bid_depth_20", "ask_depth_20",
+    "imbalance_20",
+};
+
+using BookFeatureVector = std::array<double, BOOK_FEATURE_COUNT>;
+static_assert(BOOK_IMBALANCE_20 == BOOK_BID_DEPTH_1 + 3 * 3 + 2, "depth features come in (bid, ask, imbalance)");
+
+// The vector of a book with an empty side
+inline BookFeatureVector empty_book_features() {
+    BookFeatureVector features;
+    features.fill(std::numeric_limits<double>::quiet_NaN());
+    return features;
+}
+
+inline constexpr std::array<std::size_t, 4> BOOK_DEPTH_LEVELS = {1, 5, 10, 20};
+inline constexpr std::size_t BOOK_WEIGHTED_LEVELS = 5;
+
+namespace book_features_detail {
+
+// Cumulative qty at each BOOK_DEPTH_LEVELS depth (levels past the side's
+// end add nothing) and the top-5 qty-weighted price
+struct SideDepth {
+    std::array<double, BOOK_DEPTH_LEVELS.size()> depth{};
+    double weighted_price = 0;
+};
+
+// Every level of a side shares the book's exponents, so quantities and
+// notionals are summed exactly as 128-bit mantissas (decimal64.h) and each
+// feature is rounded once
+template <typename Side>
+SideDepth side_depth(const Side &side, int8_t price_exponent, int8_t qty_exponent) {
+    using decimal64_detail::to_double;
+    SideDepth result;
+    int128_t qty = 0, notional = 0, weighted_qty = 0;
+    std::size_t next = 0;
+    side.for_each_top(BOOK_DEPTH_LEVELS.back(), [&](const auto &level) {
+        qty += level.qty;
+        if (next < BOOK_WEIGHTED_LEVELS) {
+            notional += static_cast<int128_t>(level.price) * level.qty;
+            weighted_qty = qty;
+        }
+        ++next;
+        for (std::size_t d = 0; d < BOOK_DEPTH_LEVELS.size(); ++d) {
+            if (next == BOOK_DEPTH_LEVELS[d]) {
+                result.depth[d] = to_double(qty, qty_exponent);
+            }
+        }
+    });
+    for (std::size_t d = 0; d < BOOK_DEPTH_LEVELS.size(); ++d) {
+        if (next < BOOK_DEPTH_LEVELS[d]) {
+            result.depth[d] = to_double(qty, qty_exponent);
+        }
+    }
+    result.weighted_price =
+        weighted_qty > 0 ? to_double(notional, 0) / to_double(weighted_qty, 0) * to_double(1, price_exponent) : 0;
+    return result;
+}
+
+inline double imbalance(double bid, double ask) { return bid + ask > 0 ? (bid - ask) / (bid + ask) : 0; }
+
+} // namespace book_features_detail
+
+// Fill `out` from both sides of a book whose mantissas are at
+// `price_exponent`/`qty_exponent`; `tick` is the price tick in price units
+template <typename Side>
+void compute_book_features(const Side &bids, const Side &asks, int8_t price_exponent, int8_t qty_exponent,
+                           double tick, BookFeatureVector &out) {
+    using namespace book_features_detail;
+    if (bids.empty() || asks.empty()) {
+        out = empty_book_features();
+        return;
+    }
+    const double bid = decode_decimal(bids.best().price, price_exponent);
+    const double ask = decode_decimal(asks.best().price, price_exponent);
+    const double bid_qty = decode_decimal(bids.best().qty, qty_exponent);
+    const double ask_qty = decode_decimal(asks.best().qty, qty_exponent);
+    const SideDepth bid_depth = side_depth(bids, price_exponent, qty_exponent);
+    const SideDepth ask_depth = side_depth(asks, price_exponent, qty_exponent);
+
+    out[BOOK_BEST_BID] = bid;
+    out[BOOK_BEST_ASK] = ask;
+    out[BOOK_MID] = (bid + ask) / 2;
+    out[BOOK_SPREAD] = ask - bid;
+    out[BOOK_SPREAD_TICKS] = (ask - bid) / tick;
+    out[BOOK_MICROPRICE] =
+        bid_qty + ask_qty > 0 ? (bid * ask_qty + ask * bid_qty) / (bid_qty + ask_qty) : out[BOOK_MID];
+    out[BOOK_WEIGHTED_MID] = (bid_depth.weighted_price + ask_depth.weighted_price) / 2;
+    for (std::size_t d = 0; d < BOOK_DEPTH_LEVELS.size(); ++d) {
+        const std::size_t at = BOOK_BID_DEPTH_1 + 3 * d;
+        out[at] = bid_depth.depth[d];
+        out[at + 1] = ask_depth.depth[d];
+        out[at + 2] = imbalance(bid_depth.depth[d], ask_depth.depth[d]);
+    }
+}
+
+#endif
@@ -0,0 +1,329 @@
+/*
+ * Fixed-interval samples of one symbol's order book as dense tensors.
+ *
+ * Depth models want the book's top levels at regular times, and rebuilding
+ * a book in Python for every sample does not scale to a day of diffs.
+ * BookSampler replays depth through an OrderBook (order_book.h), from
+ * capture journals (template 10003 diffs and 10002 partial depth frames,
+ * merged by receive time as JournalReplay does) or from the tick store's
+ * depth and book files, and at every interval_us writes the book into a
+ * caller-owned float32 tensor of shape [samples, 2, levels, 2]:
+ *
+ *   [t][0][k] = {price offset, qty} of the k-th bid from the touch
+ *   [t][1][k] = the same for the k-th ask
+ *
+ * with the price offset (price - mid) / tick_size, so bids sit at -0.5
+ * ticks and below and asks at +0.5 and above, and the quantity in base
+ * units. Missing levels, and whole samples taken while the book is empty
+ * on a side or waiting for a resync, are zeros; valid() tells which
+ * samples hold a book.
+ *
+ * Sample t is the book after every update with an event time before
+ * start_us + t * interval_us, so a sample is written only once an update at
+ * or past its time shows the book is complete for it. Without a start_us
+ * the grid starts at the first interval boundary after the first update.
+ * Sampling stops when the tensor is full.
+ *
+ * Tick store rows hold decoded doubles; they go back into the book as
+ * mantissas at BOOK_SAMPLER_EXPONENT, finer than any Binance tick or step.
+ */
+
+#ifndef _SBE_BOOK_SAMPLER_H_
+#define _SBE_BOOK_SAMPLER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "capture_journal.h"
+#include "journal_replay.h"
+#include "message_walk.h"
+#include "order_book.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+#include "tick_store.h"
+
+// Exponent tick store prices and quantities are re-encoded at
+constexpr int8_t BOOK_SAMPLER_EXPONENT = -8;
+
+struct BookSamplerConfig {
+    std::string symbol;
+    // PRICE_FILTER tickSize, the unit of the price offsets
+    double tick_size = 0;
+    int64_t interval_us = 1000000;
+    // Time of sample 0; 0 starts after the first update
+    int64_t start_us = 0;
+};
+
+struct BookSamplerStats {
+    uint64_t updates = 0;
+    uint64_t stale = 0;
+    uint64_t gaps = 0;
+    uint64_t snapshots = 0;
+    // Samples written with no book (zeros)
+    uint64_t invalid = 0;
+};
+
+class BookSampler {
+public:
+    // `out` holds `capacity` samples of [2, levels, 2] floats and must
+    // outlive the sampler
+    BookSampler(BookSamplerConfig config, float *out, std::size_t capacity, std::size_t levels)
+        : config_(std::move(config)), book_(config_.symbol), out_(out), capacity_(capacity), levels_(levels) {
+        if (!(config_.tick_size > 0) || config_.interval_us <= 0 || levels_ == 0) {
+            throw std::invalid_argument("book sampler: tick_size, interval and levels must be positive");
+        }
+        // The tick as a mantissa at the coarsest exponent that holds it
+        // exactly, so the book can index levels on the grid
+        int64_t tick = std::llround(config_.tick_size * 1e8);
+        int8_t exponent = BOOK_SAMPLER_EXPONENT;
+        while (tick != 0 && tick % 10 == 0 && exponent < 0) {
+            tick /= 10;
+            ++exponent;
+        }
+        book_.set_tick(tick, exponent);
+        next_us_ = config_.start_us;
+        timestamps_us_.reserve(capacity_);
+        mids_.reserve(capacity_);
+        valid_.reserve(capacity_);
+    }
+
+    BookSampler(const BookSampler &) = delete;
+    BookSampler &operator=(const BookSampler &) = delete;
+
+    // One SBE message; other templates and symbols are skipped. False once
+    // the tensor is full.
+    bool apply_message(std::span<const char> message) {
+        using spot_sbe::MessageHeader;
+        if (full() || message.size() < MessageHeader::encodedLength()) {
+            return !full();
+        }
+        MessageHeader header{const_cast<char *>(message.data()), message.size()};
+        const char *data = message.data() + MessageHeader::encodedLength();
+        const std::size_t size = message.size() - MessageHeader::encodedLength();
+        if (header.templateId() == DEPTH_DIFF_STREAM_EVENT) {
+            DepthDiffFrame diff;
+            if (parse_depth_diff_frame(data, size, header.blockLength(), diff) == ParseError::None &&
+                diff.symbol == config_.symbol) {
+                advance(static_cast<int64_t>(diff.event_time_us));
+                count(book_.apply_diff(data, diff));
+            }
+        } else if (header.templateId() == DEPTH_SNAPSHOT_STREAM_EVENT) {
+            DepthSnapshotFrame snapshot;
+            if (parse_depth_snapshot_frame(data, size, header.blockLength(), snapshot) == ParseError::None &&
+                snapshot.symbol == config_.symbol) {
+                advance(static_cast<int64_t>(snapshot.event_time_us));
+                if (book_.apply_partial_depth(data, snapshot) == ApplyStatus::Applied) {
+                    stats_.snapshots++;
+                }
+            }
+        }
+        return !full();
+    }
+
+    // Every depth message of the capture journals named by `paths`
+    // (directories expand to their *.sbej files), merged by receive time;
+    // returns the samples written
+    std::size_t sample_journals(const std::vector<std::string> &paths) {
+        struct Source {
+            std::unique_ptr<JournalReader> reader;
+            JournalRecord head{};
+            bool live = false;
+        };
+        std::vector<Source> sources;
+        for (const std::string &file : journal_files(paths)) {
+            Source source{std::make_unique<JournalReader>(file)};
+            source.live = source.reader->next(source.head);
+            sources.push_back(std::move(source));
+        }
+        std::vector<std::span<char>> messages;
+        while (!full()) {
+            Source *next = nullptr;
+            for (Source &source : sources) {
+                if (source.live &&
+                    (next == nullptr || source.head.header->received_us < next->head.header->received_us)) {
+                    next = &source;
+                }
+            }
+            if (next == nullptr) {
+                break;
+            }
+            // split_messages takes char* like the generated codecs, but never writes
+            messages.clear();
+            split_messages(std::span<char>(const_cast<char *>(next->head.frame.data()), next->head.frame.size()),
+                           messages);
+            for (const std::span<char> message : messages) {
+                apply_message(message);
+            }
+            next->live = next->reader->next(next->head);
+        }
+        return rows();
+    }
+
+    // The symbol's depth diffs and partial depth snapshots of one day of
+    // the tick store under `root`, merged by event time (a snapshot first
+    // on a tie); returns the samples written
+    std::size_t sample_tick_store(const std::string &root, int32_t day) {
+        const Updates depth = read_updates(tick_file_path(root, TickStream::Depth, config_.symbol, day), true);
+        const Updates book = read_updates(tick_file_path(root, TickStream::Book, config_.symbol, day), false);
+        std::size_t d = 0, b = 0;
+        while (!full() && (d < depth.size() || b < book.size())) {
+            const bool snapshot = b < book.size() && (d == depth.size() || book.event_us(b) <= depth.event_us(d));
+            if (snapshot) {
+                apply_update(book, b++, true);
+            } else {
+                apply_update(depth, d++, false);
+            }
+        }
+        return rows();
+    }
+
+    bool full() const { return rows() == capacity_; }
+    std::size_t rows() const { return timestamps_us_.size(); }
+    std::size_t capacity() const { return capacity_; }
+    std::size_t levels() const { return levels_; }
+    const std::vector<int64_t> &timestamps_us() const { return timestamps_us_; }
+    // NaN for samples without a book
+    const std::vector<double> &mids() const { return mids_; }
+    const std::vector<uint8_t> &valid() const { return valid_; }
+    const BookSamplerStats &stats() const { return stats_; }
+    const OrderBook &book() const { return book_; }
+
+private:
+    // Rows of a depth or book tick file, grouped into updates: runs of rows
+    // with the same update ID
+    struct Updates {
+        std::vector<std::vector<char>> columns;
+        // First row of each update, and one past the last row
+        std::vector<std::size_t> starts;
+
+        std::size_t size() const { return starts.empty() ? 0 : starts.size() - 1; }
+        int64_t event_us(std::size_t update) const { return tick_value<int64_t>(columns[0], starts[update]); }
+    };
+
+    static Updates read_updates(const std::string &path, bool diffs) {
+        Updates updates;
+        if (!std::filesystem::exists(path)) {
+            return updates;
+        }
+        TickFileReader reader(path);
+        // Same order for both streams; book files have no first_update_id
+        updates.columns = diffs ? tick_read_columns(reader, {"event_time_us", "update_id", "side", "price", "qty",
+                                                             "first_update_id"})
+                                : tick_read_columns(reader, {"event_time_us", "update_id", "side", "price", "qty"});
+        const std::vector<char> &ids = updates.columns[1];
+        const std::size_t rows = updates.columns[0].size() / sizeof(int64_t);
+        for (std::size_t r = 0; r < rows; ++r) {
+            if (r == 0 || tick_value<int64_t>(ids, r) != tick_value<int64_t>(ids, r - 1)) {
+                updates.starts.push_back(r);
+            }
+        }
+        updates.starts.push_back(rows);
+        return updates;
+    }
+
+    void apply_update(const Updates &source, std::size_t update, bool snapshot) {
+        const auto &columns = source.columns;
+        const std::size_t row = source.starts[update];
+        const int64_t update_id = tick_value<int64_t>(columns[1], row);
+        const int64_t event_us = tick_value<int64_t>(columns[0], row);
+        bids_.clear();
+        asks_.clear();
+        for (std::size_t r = row; r < source.starts[update + 1]; ++r) {
+            const BookLevel level{mantissa(tick_value<double>(columns[3], r)),
+                                  mantissa(tick_value<double>(columns[4], r))};
+            (tick_value<uint8_t>(columns[2], r) == 0 ? bids_ : asks_).push_back(level);
+        }
+        advance(event_us);
+        if (snapshot) {
+            if (book_.apply_partial_depth(static_cast<uint64_t>(update_id), static_cast<uint64_t>(event_us),
+                                          BOOK_SAMPLER_EXPONENT, BOOK_SAMPLER_EXPONENT, bids_,
+                                          asks_) == ApplyStatus::Applied) {
+                stats_.snapshots++;
+            }
+            return;
+        }
+        count(book_.apply_diff(static_cast<uint64_t>(tick_value<int64_t>(columns[5], row)),
+                               static_cast<uint64_t>(update_id), static_cast<uint64_t>(event_us),
+                               BOOK_SAMPLER_EXPONENT, BOOK_SAMPLER_EXPONENT, bids_, asks_));
+    }
+
+    static int64_t mantissa(double value) { return std::llround(value * 1e8); }
+
+    void count(ApplyStatus status) {
+        switch (status) {
+        case ApplyStatus::Applied:
+            stats_.updates++;
+            break;
+        case ApplyStatus::Stale:
+            stats_.stale++;
+            break;
+        case ApplyStatus::Gap:
+            stats_.gaps++;
+            break;
+        case ApplyStatus::Buffered:
+            break;
+        }
+    }
+
+    // Write the samples due before an update at `event_us`
+    void advance(int64_t event_us) {
+        if (next_us_ == 0) {
+            next_us_ = (event_us / config_.interval_us + 1) * config_.interval_us;
+        }
+        while (next_us_ <= event_us && !full()) {
+            write_sample(next_us_);
+            next_us_ += config_.interval_us;
+        }
+    }
+
+    void write_sample(int64_t at_us) {
+        float *sample = out_ + rows() * 2 * levels_ * 2;
+        std::fill(sample, sample + 2 * levels_ * 2, 0.0f);
+        const BookSideLevels &bids = book_.bids();
+        const BookSideLevels &asks = book_.asks();
+        timestamps_us_.push_back(at_us);
+        if (bids.empty() || asks.empty() || book_.resync_pending()) {
+            mids_.push_back(std::numeric_limits<double>::quiet_NaN());
+            valid_.push_back(0);
+            stats_.invalid++;
+            return;
+        }
+        const int8_t price_exponent = book_.price_exponent();
+        const int8_t qty_exponent = book_.qty_exponent();
+        const double mid =
+            (decode_decimal(bids.best().price, price_exponent) + decode_decimal(asks.best().price, price_exponent)) / 2;
+        mids_.push_back(mid);
+        valid_.push_back(1);
+        for (const BookSideLevels *side : {&bids, &asks}) {
+            float *level = sample + (side == &bids ? 0 : levels_ * 2);
+            side->for_each_top(levels_, [&](const BookLevel &top) {
+                *level++ = static_cast<float>((decode_decimal(top.price, price_exponent) - mid) / config_.tick_size);
+                *level++ = static_cast<float>(decode_decimal(top.qty, qty_exponent));
+            });
+        }
+    }
+
+    BookSamplerConfig config_;
+    OrderBook book_;
+    float *out_;
+    std::size_t capacity_;
+    std::size_t levels_;
+    int64_t next_us_ = 0;
+    std::vector<int64_t> timestamps_us_;
+    std::vector<double> mids_;
+    std::vector<uint8_t> valid_;
+    BookSamplerStats stats_;
+    // One tick store update's levels
+    std::vector<BookLevel> bids_;
+    std::vector<BookLevel> asks_;
+};
+
+#endif
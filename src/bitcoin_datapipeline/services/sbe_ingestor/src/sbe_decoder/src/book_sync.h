@@ -0,0 +1,215 @@
+/*
+ * Binance's local order book procedure around an OrderBook: buffer the
+ * depth diffs, take a snapshot, drop the buffered diffs it already covers
+ * (final_update_id <= lastUpdateId) and apply the rest.
+ *
+ * A BookSync passes diffs straight to its book while the book is in
+ * sequence. A gap (or resync()) switches it to buffering: the diff bodies
+ * are copied into one arena, since the frames they came from are gone by
+ * the time a snapshot arrives, and the book is no longer touched. A REST
+ * DepthResponse (template 200) or a partial depth frame (template 10002)
+ * then ends the resync in one call: the snapshot is only loaded if the
+ * buffer continues it (the first diff past lastUpdateId starts at or before
+ * lastUpdateId + 1), the buffered diffs are replayed from the arena, and the
+ * book is live again - all within the snapshot's round trip, with nothing
+ * replayed from Python.
+ *
+ * A snapshot older than the buffer is refused (SnapshotTooOld) and leaves
+ * everything as it was, so the caller just fetches another. The buffer is
+ * capped; past max_buffered_bytes it is dropped and buffering starts over,
+ * which a later snapshot recovers from the same way.
+ */
+
+#ifndef _SBE_BOOK_SYNC_H_
+#define _SBE_BOOK_SYNC_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "depth_snapshot.h"
+#include "order_book.h"
+#include "stream_decode.h"
+
+constexpr std::size_t BOOK_SYNC_DEFAULT_BUFFER = std::size_t{8} << 20;
+
+// Outcome of handing a BookSync a snapshot
+enum class SyncResult : uint8_t {
+    Synced,         // snapshot loaded and the buffered diffs replayed onto it; the book is live
+    SnapshotTooOld, // the buffer starts after lastUpdateId + 1; nothing changed, fetch a newer snapshot
+    Gap,            // loaded, but the buffered diffs skip updates; still buffering from the gap
+    Ignored,        // a partial depth frame for a book that is live; nothing changed
+};
+
+class BookSync {
+public:
+    explicit BookSync(std::string symbol = {}, std::size_t max_buffered_bytes = BOOK_SYNC_DEFAULT_BUFFER)
+        : book_(std::move(symbol)), max_buffered_bytes_(max_buffered_bytes) {}
+
+    // Apply or buffer a depth diff parsed by parse_depth_diff_frame; `data`
+    // is the frame body its level groups point into. Gap is returned once,
+    // for the diff that starts the resync; later ones are Buffered.
+    ApplyStatus apply_diff(const char *data, const DepthDiffFrame &diff) {
+        if (!syncing_) {
+            const ApplyStatus status = book_.apply_diff(data, diff);
+            if (status != ApplyStatus::Gap) {
+                return status;
+            }
+            syncing_ = true;
+            buffer(data, diff);
+            return ApplyStatus::Gap;
+        }
+        buffer(data, diff);
+        return ApplyStatus::Buffered;
+    }
+
+    // End a resync with a REST DepthResponse frame (message header
+    // included). Throws std::runtime_error for a frame that is not one; a
+    // truncated frame clears the book and keeps buffering. A live book
+    // just takes the snapshot.
+    SyncResult load_depth_response(std::span<char> payload) {
+        auto depth = open_depth_response(payload);
+        return sync(static_cast<uint64_t>(depth.lastUpdateId()), [&] { load_depth_levels(book_, depth); });
+    }
+
+    // End a resync with a partial depth frame parsed by
+    // parse_depth_snapshot_frame. Outside a resync only an empty book takes
+    // it (see OrderBook::apply_partial_depth).
+    SyncResult apply_partial_depth(const char *data, const DepthSnapshotFrame &snapshot) {
+        if (!syncing_) {
+            return book_.apply_partial_depth(data, snapshot) == ApplyStatus::Applied ? SyncResult::Synced
+                                                                                      : SyncResult::Ignored;
+        }
+        return sync(snapshot.book_update_id, [&] {
+            book_.clear();
+            book_.apply_partial_depth(data, snapshot);
+        });
+    }
+
+    // End a resync with snapshot levels taken at `last_update_id`, as
+    // OrderBook::load_snapshot
+    SyncResult load_snapshot(uint64_t last_update_id, int8_t price_exponent, int8_t qty_exponent,
+                             std::span<const BookLevel> bids, std::span<const BookLevel> asks) {
+        return sync(last_update_id,
+                    [&] { book_.load_snapshot(last_update_id, price_exponent, qty_exponent, bids, asks); });
+    }
+
+    // End a resync with a book already loaded from a snapshot, typically
+    // built off the decoding thread: the live book is replaced by it (tick
+    // size, price grid and order-flow sums kept) and the buffered diffs are
+    // replayed onto it
+    SyncResult adopt(OrderBook &&snapshot) {
+        return sync(snapshot.last_update_id(), [&] {
+            const double tick_size = book_.tick_size();
+            const PriceGrid grid = book_.price_grid();
+            const OrderFlow flow = book_.order_flow();
+            book_ = std::move(snapshot);
+            book_.set_tick_size(tick_size);
+            book_.set_price_grid(grid);
+            book_.set_order_flow(flow);
+        });
+    }
+
+    // Start buffering until the next snapshot, from an empty book: the
+    // start of Binance's procedure, before the first snapshot is requested
+    void resync() {
+        book_.clear();
+        drop_buffer();
+        syncing_ = true;
+    }
+
+    const OrderBook &book() const { return book_; }
+    OrderBook &book() { return book_; }
+    // Diffs are being buffered for a snapshot
+    bool syncing() const { return syncing_; }
+    std::size_t buffered() const { return diffs_.size(); }
+    std::size_t buffered_bytes() const { return bytes_.size(); }
+    // Buffered diffs applied onto snapshots, and those a snapshot already covered
+    uint64_t replayed() const { return replayed_; }
+    uint64_t skipped() const { return skipped_; }
+    // Times the buffer outgrew max_buffered_bytes and was dropped
+    uint64_t overflows() const { return overflows_; }
+
+    // Bytes of the buffered diffs, not counting the book itself
+    MemoryUsage buffer_memory_usage() const {
+        MemoryUsage usage = memory_of<char>(bytes_.size(), bytes_.capacity());
+        usage += memory_of<BufferedDiff>(diffs_.size(), diffs_.capacity());
+        return usage;
+    }
+
+private:
+    struct BufferedDiff {
+        DepthDiffFrame diff;
+        std::size_t offset;
+    };
+
+    void buffer(const char *data, const DepthDiffFrame &diff) {
+        const auto group_end = [](const LevelGroup &group) {
+            return group.offset + static_cast<std::size_t>(group.count) * group.block_length;
+        };
+        const std::size_t size = std::max(group_end(diff.bids), group_end(diff.asks));
+        if (bytes_.size() + size > max_buffered_bytes_) {
+            drop_buffer();
+            ++overflows_;
+        }
+        BufferedDiff entry{diff, bytes_.size()};
+        // The symbol points into the original frame; the book has its own
+        entry.diff.symbol = {};
+        bytes_.insert(bytes_.end(), data, data + size);
+        diffs_.push_back(entry);
+    }
+
+    void drop_buffer() {
+        bytes_.clear();
+        diffs_.clear();
+    }
+
+    // Load a snapshot taken at `last_update_id` through `load` if the buffer
+    // continues it, then replay the buffer onto it
+    template <typename Load>
+    SyncResult sync(uint64_t last_update_id, Load &&load) {
+        if (!syncing_) {
+            load();
+            return SyncResult::Synced;
+        }
+        const auto first = std::find_if(diffs_.begin(), diffs_.end(), [&](const BufferedDiff &entry) {
+            return entry.diff.final_update_id > last_update_id;
+        });
+        if (first != diffs_.end() && first->diff.first_update_id > last_update_id + 1) {
+            return SyncResult::SnapshotTooOld;
+        }
+
+        load();
+        skipped_ += static_cast<uint64_t>(first - diffs_.begin());
+        for (auto it = first; it != diffs_.end(); ++it) {
+            const ApplyStatus status = book_.apply_diff(bytes_.data() + it->offset, it->diff);
+            if (status == ApplyStatus::Gap) {
+                // Keep buffering from the diff past the hole
+                const std::size_t keep_from = it->offset;
+                diffs_.erase(diffs_.begin(), it);
+                for (auto &entry : diffs_) {
+                    entry.offset -= keep_from;
+                }
+                bytes_.erase(bytes_.begin(), bytes_.begin() + static_cast<std::ptrdiff_t>(keep_from));
+                return SyncResult::Gap;
+            }
+            ++(status == ApplyStatus::Applied ? replayed_ : skipped_);
+        }
+        drop_buffer();
+        syncing_ = false;
+        return SyncResult::Synced;
+    }
+
+    OrderBook book_;
+    std::size_t max_buffered_bytes_;
+    bool syncing_ = false;
+    std::vector<char> bytes_;
+    std::vector<BufferedDiff> diffs_;
+    uint64_t replayed_ = 0;
+    uint64_t skipped_ = 0;
+    uint64_t overflows_ = 0;
+};
+
+#endif
@@ -0,0 +1,520 @@
+/*
+ * Append-only memory-mapped journal of raw SBE frames.
+ *
+ * Every frame a receive thread reads is copied, with its receive timestamp,
+ * connection id and per-connection sequence number, into a preallocated
+ * file mapped MAP_SHARED. Appending is a memcpy and a release store, with
+ * no syscall per frame; JournalSyncer msyncs the written range in the
+ * background and the page cache does the rest. Files roll when the next
+ * record would not fit or when roll_interval_ms has passed since the file
+ * was opened; a rolled file is truncated to what was written.
+ *
+ * Layout: a 64-byte JournalFileHeader, then records laid end to end, each a
+ * 24-byte JournalRecordHeader and the frame bytes, padded to 8 bytes. A
+ * record's size is stored last, so a zero size marks the end of the data
+ * (the preallocated tail reads as zeros) and a reader following a live
+ * file never sees half a record. Each connection writes its own files, so
+ * writers stay single-threaded.
+ *
+ * The writer also keeps a sparse index of the file in memory, an entry per
+ * JOURNAL_INDEX_BLOCK_BYTES of records (first offset, receive time and
+ * sequence range), and writes it to {file}.idx when the file rolls. A
+ * reader seeks by receive time with it; the live file has no index yet
+ * and is scanned from its start.
+ */
+
+#ifndef _SBE_CAPTURE_JOURNAL_H_
+#define _SBE_CAPTURE_JOURNAL_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "memory_accounting.h"
+#include "page_memory.h"
+#include "sparse_index.h"
+
+constexpr char JOURNAL_MAGIC[8] = {'S', 'B', 'E', 'J', 'R', 'N', 'L', '1'};
+constexpr uint32_t JOURNAL_VERSION = 1;
+constexpr std::size_t JOURNAL_RECORD_ALIGN = 8;
+constexpr std::size_t JOURNAL_INDEX_BLOCK_BYTES = std::size_t{1} << 20;
+
+struct JournalFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    // Receive time of the file's first frame
+    uint64_t created_us;
+    uint32_t connection_id;
+    uint32_t reserved;
+    // Files written so far by this connection's writer, this one included
+    uint64_t file_index;
+    char padding[24];
+};
+static_assert(sizeof(JournalFileHeader) == 64);
+
+struct JournalRecordHeader {
+    // Frame bytes, excluding header and padding; written last
+    uint32_t size;
+    uint16_t connection_id;
+    uint16_t flags;
+    uint64_t received_us;
+    uint64_t sequence;
+};
+static_assert(sizeof(JournalRecordHeader) == 24);
+
+struct JournalConfig {
+    // Empty disables the journal
+    std::string directory;
+    std::string prefix = "sbe";
+    std::size_t file_size = std::size_t{256} << 20;
+    int roll_interval_ms = 3600 * 1000;
+    int sync_interval_ms = 1000;
+    // Huge-page advice and preferred node for each file's mapping
+    MemoryPlacement placement;
+
+    bool enabled() const { return !directory.empty(); }
+};
+
+struct JournalStats {
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> files{0};
+};
+
+inline std::size_t journal_record_size(std::size_t frame_size) {
+    const std::size_t size = sizeof(JournalRecordHeader) + frame_size;
+    return (size + JOURNAL_RECORD_ALIGN - 1) & ~(JOURNAL_RECORD_ALIGN - 1);
+}
+
+inline std::string journal_errno_message(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+// One connection's journal. append() is called from the receive thread
+// only; sync() and the stats may be called from any thread.
+class JournalWriter {
+public:
+    JournalWriter(JournalConfig config, uint16_t connection_id)
+        : config_(std::move(config)), connection_id_(connection_id) {
+        if (config_.file_size < sizeof(JournalFileHeader) + journal_record_size(0)) {
+            throw std::runtime_error("journal file_size is too small");
+        }
+        if (::mkdir(config_.directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error(journal_errno_message("cannot create journal directory", config_.directory));
+        }
+    }
+
+    ~JournalWriter() {
+        std::lock_guard lock(mutex_);
+        close_file();
+    }
+
+    JournalWriter(const JournalWriter &) = delete;
+    JournalWriter &operator=(const JournalWriter &) = delete;
+
+    // Copy one frame into the journal; false (and counted as dropped) when
+    // it can never fit a file or no file could be opened
+    bool append(std::span<const char> frame, uint64_t received_us, uint64_t sequence) {
+        const std::size_t needed = journal_record_size(frame.size());
+        if (needed > config_.file_size - sizeof(JournalFileHeader)) {
+            stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (base_ == nullptr || cursor_ + needed > config_.file_size ||
+            received_us >= opened_us_ + static_cast<uint64_t>(config_.roll_interval_ms) * 1000) {
+            if (!roll(received_us)) {
+                stats_.dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+
+        index_record(cursor_, needed, received_us, sequence);
+        char *record = base_ + cursor_;
+        auto *header = reinterpret_cast<JournalRecordHeader *>(record);
+        std::memcpy(record + sizeof(JournalRecordHeader), frame.data(), frame.size());
+        header->connection_id = connection_id_;
+        header->flags = 0;
+        header->received_us = received_us;
+        header->sequence = sequence;
+        std::atomic_ref<uint32_t>(header->size).store(static_cast<uint32_t>(frame.size()), std::memory_order_release);
+
+        cursor_ += needed;
+        committed_.store(cursor_, std::memory_order_release);
+        stats_.records.fetch_add(1, std::memory_order_relaxed);
+        stats_.bytes.fetch_add(frame.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    // Start write-back of everything appended since the last call
+    void sync() {
+        std::lock_guard lock(mutex_);
+        if (base_ == nullptr) {
+            return;
+        }
+        const std::size_t committed = committed_.load(std::memory_order_acquire);
+        if (committed <= synced_) {
+            return;
+        }
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const std::size_t begin = synced_ & ~(page - 1);
+        ::msync(base_ + begin, committed - begin, MS_ASYNC);
+        synced_ = committed;
+    }
+
+    // Finish the current file now; a later append() starts a new one
+    void close() {
+        std::lock_guard lock(mutex_);
+        close_file();
+    }
+
+    const JournalStats &stats() const { return stats_; }
+    uint16_t connection_id() const { return connection_id_; }
+
+    std::string current_path() const {
+        std::lock_guard lock(mutex_);
+        return path_;
+    }
+
+    // Bytes of the current file's records against its whole mapping;
+    // nothing between files
+    MemoryUsage memory_usage() const {
+        std::lock_guard lock(mutex_);
+        if (base_ == nullptr) {
+            return {};
+        }
+        return {committed_.load(std::memory_order_acquire), config_.file_size};
+    }
+
+    std::string last_error() const {
+        std::lock_guard lock(mutex_);
+        return last_error_;
+    }
+
+private:
+    // Rolls happen once per file, so a failed open is retried at most once
+    // a second rather than on every frame
+    static constexpr uint64_t REOPEN_RETRY_US = 1000000;
+
+    bool roll(uint64_t received_us) {
+        std::lock_guard lock(mutex_);
+        close_file();
+        if (received_us < retry_at_us_) {
+            return false;
+        }
+        if (open_file(received_us)) {
+            return true;
+        }
+        retry_at_us_ = received_us + REOPEN_RETRY_US;
+        return false;
+    }
+
+    // Count a record into the file's index, opening an entry per
+    // JOURNAL_INDEX_BLOCK_BYTES; the entries were reserved at open
+    void index_record(std::size_t offset, std::size_t length, uint64_t received_us, uint64_t sequence) {
+        const auto ts = static_cast<int64_t>(received_us);
+        const auto id = static_cast<int64_t>(sequence);
+        if (index_.empty() || offset - index_.back().offset >= JOURNAL_INDEX_BLOCK_BYTES) {
+            index_.push_back(SparseIndexEntry{offset, 0, 0, ts, ts, id, id});
+        }
+        SparseIndexEntry &entry = index_.back();
+        entry.size += length;
+        entry.rows++;
+        entry.min_ts_us = std::min(entry.min_ts_us, ts);
+        entry.max_ts_us = std::max(entry.max_ts_us, ts);
+        entry.min_id = std::min(entry.min_id, id);
+        entry.max_id = std::max(entry.max_id, id);
+    }
+
+    bool open_file(uint64_t received_us) {
+        char name[96];
+        std::snprintf(name, sizeof(name), "-c%02u-%020llu-%llu.sbej", static_cast<unsigned>(connection_id_),
+                      static_cast<unsigned long long>(received_us), static_cast<unsigned long long>(file_index_));
+        const std::string path = config_.directory + "/" + config_.prefix + name;
+
+        const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            last_error_ = journal_errno_message("cannot create journal", path);
+            return false;
+        }
+        // Reserve the blocks up front: running out of space under a shared
+        // mapping would be a SIGBUS rather than an error
+        const int rc = ::posix_fallocate(fd, 0, static_cast<off_t>(config_.file_size));
+        if (rc != 0) {
+            last_error_ = "cannot allocate journal " + path + ": " + std::strerror(rc);
+            ::close(fd);
+            ::unlink(path.c_str());
+            return false;
+        }
+        void *base = ::mmap(nullptr, config_.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED) {
+            last_error_ = journal_errno_message("cannot map journal", path);
+            ::close(fd);
+            ::unlink(path.c_str());
+            return false;
+        }
+        ::madvise(base, config_.file_size, MADV_SEQUENTIAL);
+        place_pages(base, config_.file_size, config_.placement);
+
+        fd_ = fd;
+        base_ = static_cast<char *>(base);
+        path_ = path;
+        opened_us_ = received_us;
+        auto *header = reinterpret_cast<JournalFileHeader *>(base_);
+        std::memcpy(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        header->version = JOURNAL_VERSION;
+        header->header_size = sizeof(JournalFileHeader);
+        header->created_us = received_us;
+        header->connection_id = connection_id_;
+        header->file_index = ++file_index_;
+        cursor_ = sizeof(JournalFileHeader);
+        index_.clear();
+        index_.reserve(config_.file_size / JOURNAL_INDEX_BLOCK_BYTES + 1);
+        synced_ = 0;
+        committed_.store(cursor_, std::memory_order_release);
+        stats_.files.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Caller holds mutex_
+    void close_file() {
+        if (base_ == nullptr) {
+            return;
+        }
+        ::munmap(base_, config_.file_size);
+        if (::ftruncate(fd_, static_cast<off_t>(cursor_)) != 0) {
+            last_error_ = journal_errno_message("cannot truncate journal", path_);
+        } else {
+            try {
+                write_sparse_index(sparse_index_path(path_), index_);
+            } catch (const std::runtime_error &e) {
+                last_error_ = e.what();
+            }
+        }
+        ::close(fd_);
+        base_ = nullptr;
+        fd_ = -1;
+    }
+
+    const JournalConfig config_;
+    const uint16_t connection_id_;
+
+    // Receive thread only
+    std::size_t cursor_ = 0;
+    uint64_t opened_us_ = 0;
+    uint64_t retry_at_us_ = 0;
+    uint64_t file_index_ = 0;
+    std::vector<SparseIndexEntry> index_;
+
+    // Shared with sync(); base_/fd_ change only under mutex_
+    mutable std::mutex mutex_;
+    char *base_ = nullptr;
+    int fd_ = -1;
+    std::string path_;
+    std::string last_error_;
+    std::atomic<std::size_t> committed_{0};
+    std::size_t synced_ = 0;
+
+    JournalStats stats_;
+};
+
+// Background msync for a set of writers
+class JournalSyncer {
+public:
+    JournalSyncer(std::vector<JournalWriter *> writers, int interval_ms)
+        : writers_(std::move(writers)), interval_ms_(interval_ms) {}
+
+    ~JournalSyncer() { stop(); }
+
+    JournalSyncer(const JournalSyncer &) = delete;
+    JournalSyncer &operator=(const JournalSyncer &) = delete;
+
+    void start() {
+        if (writers_.empty() || running_.exchange(true)) {
+            return;
+        }
+        worker_ = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+        sync_all();
+    }
+
+private:
+    static constexpr int POLL_SLICE_MS = 100;
+
+    void run() {
+        auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval_ms_);
+        while (running_.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min(interval_ms_, POLL_SLICE_MS)));
+            if (std::chrono::steady_clock::now() >= next) {
+                sync_all();
+                next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval_ms_);
+            }
+        }
+    }
+
+    void sync_all() {
+        for (auto *writer : writers_) {
+            writer->sync();
+        }
+    }
+
+    const std::vector<JournalWriter *> writers_;
+    const int interval_ms_;
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+};
+
+struct JournalRecord {
+    const JournalRecordHeader *header;
+    std::span<const char> frame;
+};
+
+// Read-only walk over one journal file, live or rolled
+class JournalReader {
+public:
+    explicit JournalReader(const std::string &path) : path_(path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::runtime_error(journal_errno_message("cannot open journal", path));
+        }
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(JournalFileHeader)) {
+            ::close(fd_);
+            throw std::runtime_error("not a journal file: " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void *base = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error(journal_errno_message("cannot map journal", path));
+        }
+        base_ = static_cast<const char *>(base);
+        ::madvise(base, size_, MADV_SEQUENTIAL);
+
+        const auto *header = reinterpret_cast<const JournalFileHeader *>(base_);
+        if (std::memcmp(header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 ||
+            header->version != JOURNAL_VERSION || header->header_size < sizeof(JournalFileHeader) ||
+            header->header_size > size_) {
+            close();
+            throw std::runtime_error("not a journal file: " + path);
+        }
+        cursor_ = header->header_size;
+    }
+
+    ~JournalReader() { close(); }
+
+    JournalReader(const JournalReader &) = delete;
+    JournalReader &operator=(const JournalReader &) = delete;
+
+    const JournalFileHeader &file_header() const { return *reinterpret_cast<const JournalFileHeader *>(base_); }
+
+    // Next complete record; false at the end of the written data. A record
+    // running past the end of the file is reported as truncated.
+    bool next(JournalRecord &record) {
+        if (cursor_ + sizeof(JournalRecordHeader) > size_) {
+            return false;
+        }
+        const auto *header = reinterpret_cast<const JournalRecordHeader *>(base_ + cursor_);
+        const uint32_t frame_size =
+            std::atomic_ref<uint32_t>(const_cast<uint32_t &>(header->size)).load(std::memory_order_acquire);
+        if (frame_size == 0) {
+            return false;
+        }
+        const std::size_t length = journal_record_size(frame_size);
+        if (cursor_ + sizeof(JournalRecordHeader) + frame_size > size_) {
+            throw std::runtime_error("truncated record in journal " + path_);
+        }
+        record.header = header;
+        record.frame = {base_ + cursor_ + sizeof(JournalRecordHeader), frame_size};
+        cursor_ += length;
+        return true;
+    }
+
+    // The file's sparse index, as far as it matches the file; empty for a
+    // live file or one written before indexes. Loaded on first use.
+    const SparseIndex &index() {
+        if (!index_loaded_) {
+            std::vector<SparseIndexEntry> entries;
+            read_sparse_index(sparse_index_path(path_), entries);
+            sparse_index_chain(entries, file_header().header_size, size_);
+            index_ = SparseIndex(std::move(entries));
+            index_loaded_ = true;
+        }
+        return index_;
+    }
+
+    // Position next() at the first record received at or after
+    // `received_us`: the index skips the blocks that all came before it,
+    // then records are scanned. Receive times are in order but for clock
+    // steps, so callers bounding a range still check each record's time.
+    void seek(uint64_t received_us) {
+        const SparseIndex &blocks = index();
+        const auto from = static_cast<int64_t>(std::min<uint64_t>(received_us, std::numeric_limits<int64_t>::max()));
+        const std::size_t block = blocks.span(SparseKey::Time, from, std::numeric_limits<int64_t>::max()).first;
+        if (block < blocks.size()) {
+            cursor_ = blocks[block].offset;
+        } else if (blocks.size() > 0) {
+            cursor_ = blocks[blocks.size() - 1].offset + blocks[blocks.size() - 1].size;
+        } else {
+            cursor_ = file_header().header_size;
+        }
+        JournalRecord record;
+        while (true) {
+            const std::size_t at = cursor_;
+            if (!next(record)) {
+                return;
+            }
+            if (record.header->received_us >= received_us) {
+                cursor_ = at;
+                return;
+            }
+        }
+    }
+
+private:
+    void close() {
+        if (base_ != nullptr) {
+            ::munmap(const_cast<char *>(base_), size_);
+            base_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    const char *base_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t cursor_ = 0;
+    SparseIndex index_;
+    bool index_loaded_ = false;
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * File plumbing shared by the state checkpoints (book_checkpoint.h,
+ * window_checkpoint.h).
+ *
+ * A checkpoint is built in memory, written beside its path, fsynced and
+ * renamed over it, so a reader, or a restart after a crash mid-write, sees
+ * either the previous checkpoint or the new one, never part of one.
+ * Readers map the file read-only and use it in place.
+ */
+
+#ifndef _SBE_CHECKPOINT_FILE_H_
+#define _SBE_CHECKPOINT_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+inline std::string checkpoint_errno_message(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+// Replace `path` with `data` atomically. Throws std::runtime_error on I/O
+// errors, leaving the previous file in place.
+inline void write_checkpoint_file(const std::string &path, std::span<const char> data) {
+    const std::string staging = path + ".new";
+    const int fd = ::open(staging.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(checkpoint_errno_message("cannot create checkpoint", staging));
+    }
+    const char *at = data.data();
+    std::size_t left = data.size();
+    while (left > 0) {
+        const ssize_t written = ::write(fd, at, left);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            const std::string message = checkpoint_errno_message("cannot write checkpoint", staging);
+            ::close(fd);
+            ::unlink(staging.c_str());
+            throw std::runtime_error(message);
+        }
+        at += written;
+        left -= static_cast<std::size_t>(written);
+    }
+    if (::fsync(fd) != 0) {
+        const std::string message = checkpoint_errno_message("cannot sync checkpoint", staging);
+        ::close(fd);
+        ::unlink(staging.c_str());
+        throw std::runtime_error(message);
+    }
+    ::close(fd);
+    if (::rename(staging.c_str(), path.c_str()) != 0) {
+        const std::string message = checkpoint_errno_message("cannot publish checkpoint", path);
+        ::unlink(staging.c_str());
+        throw std::runtime_error(message);
+    }
+}
+
+// Read-only mapping of a whole checkpoint file
+class MappedCheckpoint {
+public:
+    // Throws std::runtime_error if `path` cannot be opened or is shorter
+    // than `min_size`
+    MappedCheckpoint(const std::string &path, std::size_t min_size) : path_(path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::runtime_error(checkpoint_errno_message("cannot open checkpoint", path));
+        }
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0 || static_cast<std::size_t>(st.st_size) < min_size) {
+            close();
+            throw std::runtime_error("not a checkpoint: " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void *base = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) {
+            close();
+            throw std::runtime_error(checkpoint_errno_message("cannot map checkpoint", path));
+        }
+        base_ = static_cast<const char *>(base);
+    }
+
+    ~MappedCheckpoint() { close(); }
+
+    MappedCheckpoint(const MappedCheckpoint &) = delete;
+    MappedCheckpoint &operator=(const MappedCheckpoint &) = delete;
+
+    const char *data() const { return base_; }
+    std::size_t size() const { return size_; }
+    const std::string &path() const { return path_; }
+
+private:
+    void close() {
+        if (base_ != nullptr) {
+            ::munmap(const_cast<char *>(base_), size_);
+            base_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    const char *base_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * Bulk reductions over contiguous price/qty columns: min, max, sum, sum of
+ * squares and the qty-weighted sum in one pass.
+ *
+ * TradeWindow (trade_window.h) covers the streaming case. Replay, training
+ * and multi-horizon rebuilds instead recompute a whole window from the
+ * decode_batch columns, and for that a single vectorised pass beats any
+ * bookkeeping. The kernel is picked at run time (cpu_dispatch.h): AVX-512F,
+ * AVX2 or SSE2 on x86-64, NEON on aarch64, a scalar loop elsewhere.
+ *
+ * Squares are accumulated around the column's first price, so the variance
+ * of 60000-ish prices does not cancel down to noise; sum_sq() converts back.
+ */
+
+#ifndef _SBE_COLUMN_STATS_H_
+#define _SBE_COLUMN_STATS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "cpu_dispatch.h"
+
+struct ColumnStats {
+    std::size_t count = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    // Σ qty and Σ price·qty; left at 0 without a qty column
+    double qty_sum = 0;
+    double weighted_sum = 0;
+
+    double sum() const { return shifted_sum + static_cast<double>(count) * pivot; }
+    double sum_sq() const {
+        const double n = static_cast<double>(count);
+        return shifted_sum_sq + 2 * pivot * shifted_sum + n * pivot * pivot;
+    }
+    double mean() const { return count == 0 ? 0 : sum() / static_cast<double>(count); }
+    // Sample variance (n - 1), 0 below two values
+    double variance() const {
+        if (count < 2) {
+            return 0;
+        }
+        const double n = static_cast<double>(count);
+        return std::max(shifted_sum_sq - shifted_sum * shifted_sum / n, 0.0) / (n - 1);
+    }
+    double vwap() const { return qty_sum > 0 ? weighted_sum / qty_sum : mean(); }
+
+    // Σ (price - pivot) and Σ (price - pivot)², pivot = first price
+    double pivot = 0;
+    double shifted_sum = 0;
+    double shifted_sum_sq = 0;
+};
+
+// Name of the kernel simd_level() picked, for benchmarks and logs
+inline const char *column_stats_kernel() { return simd_level_name(simd_level()); }
+
+// GCC 12 flags _mm512_undefined_pd inside the AVX-512 intrinsics as
+// maybe-uninitialized wherever they are inlined, and warns that the vector
+// ops' ABI depends on the target each time one is instantiated
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace column_stats_detail {
+
+// Plain loop over [begin, end); also finishes the vector kernels' tails
+inline void accumulate_scalar(ColumnStats &stats, const double *price, const double *qty, std::size_t begin,
+                              std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+        const double p = price[i];
+        const double d = p - stats.pivot;
+        stats.min = std::min(stats.min, p);
+        stats.max = std::max(stats.max, p);
+        stats.shifted_sum += d;
+        stats.shifted_sum_sq += d * d;
+        if (qty != nullptr) {
+            stats.qty_sum += qty[i];
+            stats.weighted_sum += p * qty[i];
+        }
+    }
+}
+
+#if SBE_X86_DISPATCH
+struct Avx512Ops {
+    static constexpr std::size_t LANES = 8;
+    using Vec = __m512d;
+    SBE_TARGET_AVX512 static Vec load(const double *at) { return _mm512_loadu_pd(at); }
+    SBE_TARGET_AVX512 static Vec broadcast(double x) { return _mm512_set1_pd(x); }
+    SBE_TARGET_AVX512 static Vec add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+    SBE_TARGET_AVX512 static Vec sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+    SBE_TARGET_AVX512 static Vec fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_pd(a, b, c); }
+    SBE_TARGET_AVX512 static Vec vmin(Vec a, Vec b) { return _mm512_min_pd(a, b); }
+    SBE_TARGET_AVX512 static Vec vmax(Vec a, Vec b) { return _mm512_max_pd(a, b); }
+    SBE_TARGET_AVX512 static double hsum(Vec v) { return _mm512_reduce_add_pd(v); }
+    SBE_TARGET_AVX512 static double hmin(Vec v) { return _mm512_reduce_min_pd(v); }
+    SBE_TARGET_AVX512 static double hmax(Vec v) { return _mm512_reduce_max_pd(v); }
+};
+
+struct Avx2Ops {
+    static constexpr std::size_t LANES = 4;
+    using Vec = __m256d;
+    SBE_TARGET_AVX2 static Vec load(const double *at) { return _mm256_loadu_pd(at); }
+    SBE_TARGET_AVX2 static Vec broadcast(double x) { return _mm256_set1_pd(x); }
+    SBE_TARGET_AVX2 static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+    SBE_TARGET_AVX2 static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+    SBE_TARGET_AVX2 static Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+    SBE_TARGET_AVX2 static Vec vmin(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+    SBE_TARGET_AVX2 static Vec vmax(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+    SBE_TARGET_AVX2 static double hsum(Vec v) {
+        const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+    }
+    SBE_TARGET_AVX2 static double hmin(Vec v) {
+        const __m128d pair = _mm_min_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_min_sd(pair, _mm_unpackhi_pd(pair, pair)));
+    }
+    SBE_TARGET_AVX2 static double hmax(Vec v) {
+        const __m128d pair = _mm_max_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_max_sd(pair, _mm_unpackhi_pd(pair, pair)));
+    }
+};
+
+// SSE2 is part of x86-64, so the baseline build always has it
+struct SseOps {
+    static constexpr std::size_t LANES = 2;
+    using Vec = __m128d;
+    static Vec load(const double *at) { return _mm_loadu_pd(at); }
+    static Vec broadcast(double x) { return _mm_set1_pd(x); }
+    static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+    static Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+    static Vec fmadd(Vec a, Vec b, Vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    static Vec vmin(Vec a, Vec b) { return _mm_min_pd(a, b); }
+    static Vec vmax(Vec a, Vec b) { return _mm_max_pd(a, b); }
+    static double hsum(Vec v) { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+    static double hmin(Vec v) { return _mm_cvtsd_f64(_mm_min_sd(v, _mm_unpackhi_pd(v, v))); }
+    static double hmax(Vec v) { return _mm_cvtsd_f64(_mm_max_sd(v, _mm_unpackhi_pd(v, v))); }
+};
+#endif
+
+#if defined(__aarch64__)
+// NEON is part of armv8-a, so the baseline build always has it
+struct NeonOps {
+    static constexpr std::size_t LANES = 2;
+    using Vec = float64x2_t;
+    static Vec load(const double *at) { return vld1q_f64(at); }
+    static Vec broadcast(double x) { return vdupq_n_f64(x); }
+    static Vec add(Vec a, Vec b) { return vaddq_f64(a, b); }
+    static Vec sub(Vec a, Vec b) { return vsubq_f64(a, b); }
+    static Vec fmadd(Vec a, Vec b, Vec c) { return vfmaq_f64(c, a, b); }
+    static Vec vmin(Vec a, Vec b) { return vminq_f64(a, b); }
+    static Vec vmax(Vec a, Vec b) { return vmaxq_f64(a, b); }
+    static double hsum(Vec v) { return vaddvq_f64(v); }
+    static double hmin(Vec v) { return vminvq_f64(v); }
+    static double hmax(Vec v) { return vmaxvq_f64(v); }
+};
+#endif
+
+// Whole vectors of [0, n); returns where the scalar tail starts. Two
+// accumulators per sum hide the add latency. Always inlined into a caller
+// compiled for Ops' ISA.
+template <typename Ops>
+[[gnu::always_inline]] inline std::size_t accumulate_with(ColumnStats &stats, const double *price, const double *qty,
+                                                          std::size_t n) {
+    using Vec = typename Ops::Vec;
+    constexpr std::size_t STEP = 2 * Ops::LANES;
+    if (n < STEP) {
+        return 0;
+    }
+    const Vec pivot = Ops::broadcast(stats.pivot);
+    Vec lo = Ops::load(price), hi = lo;
+    Vec s0 = Ops::broadcast(0), s1 = s0, q0 = s0, q1 = s0, w0 = s0, w1 = s0, sq0 = s0, sq1 = s0;
+    std::size_t i = 0;
+    for (; i + STEP <= n; i += STEP) {
+        const Vec p0 = Ops::load(price + i);
+        const Vec p1 = Ops::load(price + i + Ops::LANES);
+        lo = Ops::vmin(lo, Ops::vmin(p0, p1));
+        hi = Ops::vmax(hi, Ops::vmax(p0, p1));
+        const Vec d0 = Ops::sub(p0, pivot);
+        const Vec d1 = Ops::sub(p1, pivot);
+        s0 = Ops::add(s0, d0);
+        s1 = Ops::add(s1, d1);
+        sq0 = Ops::fmadd(d0, d0, sq0);
+        sq1 = Ops::fmadd(d1, d1, sq1);
+        if (qty != nullptr) {
+            const Vec v0 = Ops::load(qty + i);
+            const Vec v1 = Ops::load(qty + i + Ops::LANES);
+            q0 = Ops::add(q0, v0);
+            q1 = Ops::add(q1, v1);
+            w0 = Ops::fmadd(p0, v0, w0);
+            w1 = Ops::fmadd(p1, v1, w1);
+        }
+    }
+    stats.min = std::min(stats.min, Ops::hmin(lo));
+    stats.max = std::max(stats.max, Ops::hmax(hi));
+    stats.shifted_sum += Ops::hsum(Ops::add(s0, s1));
+    stats.shifted_sum_sq += Ops::hsum(Ops::add(sq0, sq1));
+    stats.qty_sum += Ops::hsum(Ops::add(q0, q1));
+    stats.weighted_sum += Ops::hsum(Ops::add(w0, w1));
+    return i;
+}
+
+#if SBE_X86_DISPATCH
+SBE_TARGET_AVX512 inline std::size_t accumulate_avx512(ColumnStats &stats, const double *price, const double *qty,
+                                                       std::size_t n) {
+    return accumulate_with<Avx512Ops>(stats, price, qty, n);
+}
+
+SBE_TARGET_AVX2 inline std::size_t accumulate_avx2(ColumnStats &stats, const double *price, const double *qty,
+                                                   std::size_t n) {
+    return accumulate_with<Avx2Ops>(stats, price, qty, n);
+}
+#endif
+
+// The widest kernel simd_level() allows
+inline std::size_t accumulate_vector(ColumnStats &stats, const double *price, const double *qty, std::size_t n) {
+#if SBE_X86_DISPATCH
+    switch (simd_level()) {
+    case SimdLevel::Avx512:
+        return accumulate_avx512(stats, price, qty, n);
+    case SimdLevel::Avx2:
+        return accumulate_avx2(stats, price, qty, n);
+    case SimdLevel::Baseline:
+        break;
+    }
+    return accumulate_with<SseOps>(stats, price, qty, n);
+#elif defined(__aarch64__)
+    return accumulate_with<NeonOps>(stats, price, qty, n);
+#else
+    return 0;
+#endif
+}
+
+} // namespace column_stats_detail
+
+// Fold `n` more prices (and quantities, when `qty` is not null) into
+// `stats`, e.g. the second half of a wrapped ring
+inline void column_stats_append(ColumnStats &stats, const double *price, const double *qty, std::size_t n) {
+    if (n == 0) {
+        return;
+    }
+    if (stats.count == 0) {
+        stats.pivot = price[0];
+    }
+    stats.count += n;
+    const std::size_t tail = column_stats_detail::accumulate_vector(stats, price, qty, n);
+    column_stats_detail::accumulate_scalar(stats, price, qty, tail, n);
+}
+
+// One pass over `n` prices and, when `qty` is not null, their quantities
+inline ColumnStats column_stats(const double *price, const double *qty, std::size_t n) {
+    ColumnStats stats;
+    column_stats_append(stats, price, qty, n);
+    return stats;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
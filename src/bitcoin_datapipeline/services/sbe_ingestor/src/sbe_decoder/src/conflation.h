@@ -0,0 +1,395 @@
+/*
+ * Per-symbol conflation of best bid/ask and depth updates.
+ *
+ * Downstream consumers (Redis features, inference) read the latest quote
+ * and book every couple of seconds, yet every bestBidAsk and depth update
+ * turns into records of its own. With an interval set for a stream type, a
+ * receiver hands that type's frames to a Conflator instead of staging
+ * them. It keeps the newest best bid/ask per symbol, and a book per symbol
+ * built from the depth frames, along with how many updates arrived and the
+ * range the touch covered. Once per interval, every symbol that saw
+ * updates is staged as one frame: its latest BestBidAsk record, or its
+ * book's top-N as a PartialDepth snapshot, then a Conflation record with
+ * the update count and the touch's extremes. A diff that skips update IDs
+ * reseeds the book from that diff and puts a DepthGap record ahead of the
+ * snapshot. Trades are never conflated.
+ *
+ * Frames the conflator does not take (other stream types, malformed
+ * frames) are left to the caller, which stages them as usual.
+ * Receive thread only, apart from the atomic stats.
+ */
+
+#ifndef _SBE_CONFLATION_H_
+#define _SBE_CONFLATION_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "event_ring.h"
+#include "order_book.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+#include "symbol_table.h"
+
+struct ConflationConfig {
+    // Milliseconds between emissions per stream type; 0 stages every update
+    // as it arrives
+    int bba_interval_ms = 0;
+    int depth_interval_ms = 0;
+    // Levels per side of a conflated book
+    std::size_t depth_levels = 20;
+
+    bool enabled() const { return bba_interval_ms > 0 || depth_interval_ms > 0; }
+};
+
+// Stream a Conflation record summarizes, in its flag
+enum class ConflatedStream : uint8_t {
+    BestBidAsk = 0,
+    Depth = 1,
+};
+
+struct ConflationStats {
+    std::atomic<uint64_t> updates{0};  // frames absorbed
+    std::atomic<uint64_t> frames{0};   // conflated frames handed to the caller
+    std::atomic<uint64_t> resyncs{0};  // books reseeded after an update-ID gap
+};
+
+namespace conflation_detail {
+
+// Lowest and highest bid and ask price mantissas over an interval
+struct TouchRange {
+    int64_t bid_low = 0;
+    int64_t bid_high = 0;
+    int64_t ask_low = 0;
+    int64_t ask_high = 0;
+    bool has_bid = false;
+    bool has_ask = false;
+
+    void clear() { has_bid = has_ask = false; }
+
+    void add_bid(int64_t price) {
+        bid_low = has_bid ? std::min(bid_low, price) : price;
+        bid_high = has_bid ? std::max(bid_high, price) : price;
+        has_bid = true;
+    }
+
+    void add_ask(int64_t price) {
+        ask_low = has_ask ? std::min(ask_low, price) : price;
+        ask_high = has_ask ? std::max(ask_high, price) : price;
+        has_ask = true;
+    }
+};
+
+// Deadline after `deadline` once it has passed at `now_us`
+inline uint64_t next_deadline(uint64_t deadline, int interval_ms, uint64_t now_us) {
+    const auto interval_us = static_cast<uint64_t>(interval_ms) * 1000;
+    deadline += interval_us;
+    return deadline > now_us ? deadline : now_us + interval_us;
+}
+
+} // namespace conflation_detail
+
+class Conflator {
+public:
+    explicit Conflator(ConflationConfig config, uint64_t now_us = 0) : config_(config) {
+        next_bba_us_ = conflation_detail::next_deadline(now_us, config_.bba_interval_ms, now_us);
+        next_depth_us_ = conflation_detail::next_deadline(now_us, config_.depth_interval_ms, now_us);
+    }
+
+    Conflator(const Conflator &) = delete;
+    Conflator &operator=(const Conflator &) = delete;
+
+    // Take a best bid/ask or depth frame whose stream type is conflated.
+    // False for any other frame, which the caller stages itself.
+    bool absorb(std::span<char> frame, uint64_t received_us) {
+        using spot_sbe::MessageHeader;
+        if (frame.size() < MessageHeader::encodedLength()) [[unlikely]] {
+            return false;
+        }
+        MessageHeader header{frame.data(), frame.size()};
+        const char *data = frame.data() + MessageHeader::encodedLength();
+        const std::size_t data_size = frame.size() - MessageHeader::encodedLength();
+
+        switch (header.templateId()) {
+        case BEST_BID_ASK_STREAM_EVENT: {
+            BestBidAskFrame bba;
+            if (config_.bba_interval_ms <= 0 ||
+                parse_best_bid_ask_frame(data, data_size, header.blockLength(), bba) != ParseError::None) {
+                return false;
+            }
+            Quote *quote = quote_for(bba.symbol);
+            if (quote == nullptr) [[unlikely]] {
+                return false;
+            }
+            EventRecord &latest = quote->latest;
+            if (quote->updates > 0 &&
+                (bba.price_exponent != latest.price_exponent || bba.qty_exponent != latest.qty_exponent)) {
+                // Mantissas at another exponent do not compare
+                quote->range.clear();
+            }
+            latest.kind = EventKind::BestBidAsk;
+            latest.price_exponent = bba.price_exponent;
+            latest.qty_exponent = bba.qty_exponent;
+            latest.event_time_us = bba.event_time_us;
+            latest.ingest_ts_us = received_us;
+            latest.id[0] = static_cast<int64_t>(bba.book_update_id);
+            latest.mantissa[0] = bba.bid_price_mantissa;
+            latest.mantissa[1] = bba.bid_qty_mantissa;
+            latest.mantissa[2] = bba.ask_price_mantissa;
+            latest.mantissa[3] = bba.ask_qty_mantissa;
+            latest.symbol = to_symbol_code(bba.symbol);
+            latest.symbol_id = quote->symbol_id;
+            quote->range.add_bid(bba.bid_price_mantissa);
+            quote->range.add_ask(bba.ask_price_mantissa);
+            stats_.updates.fetch_add(1, std::memory_order_relaxed);
+            note(quote->updates, quote->first_event_us, bba.event_time_us);
+            return true;
+        }
+        case DEPTH_DIFF_STREAM_EVENT: {
+            DepthDiffFrame diff;
+            if (config_.depth_interval_ms <= 0 ||
+                parse_depth_diff_frame(data, data_size, header.blockLength(), diff) != ParseError::None) {
+                return false;
+            }
+            Book *book = book_for(diff.symbol);
+            if (book == nullptr) [[unlikely]] {
+                return false;
+            }
+            book->diff_fed = true;
+            if (book->book.apply_diff(data, diff) == ApplyStatus::Gap) {
+                if (!book->gap) {
+                    book->gap = true;
+                    book->expected_first_id = book->book.last_update_id() + 1;
+                    book->first_id = diff.first_update_id;
+                }
+                stats_.resyncs.fetch_add(1, std::memory_order_relaxed);
+                book->book.clear();
+                book->book.apply_diff(data, diff);
+            }
+            touched(*book, diff.event_time_us, received_us);
+            return true;
+        }
+        case DEPTH_SNAPSHOT_STREAM_EVENT: {
+            DepthSnapshotFrame snapshot;
+            if (config_.depth_interval_ms <= 0 ||
+                parse_depth_snapshot_frame(data, data_size, header.blockLength(), snapshot) != ParseError::None) {
+                return false;
+            }
+            Book *book = book_for(snapshot.symbol);
+            if (book == nullptr) [[unlikely]] {
+                return false;
+            }
+            // Partial depth alone replaces the book each time; next to diffs
+            // it only reseeds one waiting for a resync
+            if (!book->diff_fed) {
+                book->book.clear();
+            }
+            book->book.apply_partial_depth(data, snapshot);
+            touched(*book, snapshot.event_time_us, received_us);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    // Hand every symbol whose interval ended by `now_us` to `stage` as one
+    // frame (a std::span<EventRecord>; the caller numbers it)
+    template <typename Stage>
+    void flush_due(uint64_t now_us, Stage &&stage) {
+        if (config_.bba_interval_ms > 0 && now_us >= next_bba_us_) {
+            next_bba_us_ = conflation_detail::next_deadline(next_bba_us_, config_.bba_interval_ms, now_us);
+            for (Quote &quote : quotes_) {
+                if (quote.updates > 0) {
+                    emit_quote(quote, stage);
+                }
+            }
+        }
+        if (config_.depth_interval_ms > 0 && now_us >= next_depth_us_) {
+            next_depth_us_ = conflation_detail::next_deadline(next_depth_us_, config_.depth_interval_ms, now_us);
+            for (auto &book : books_) {
+                if (book && book->updates > 0) {
+                    emit_book(*book, stage);
+                }
+            }
+        }
+    }
+
+    const ConflationConfig &config() const { return config_; }
+    const ConflationStats &stats() const { return stats_; }
+
+private:
+    struct Quote {
+        SymbolId symbol_id = INVALID_SYMBOL_ID;
+        uint64_t updates = 0;
+        uint64_t first_event_us = 0;
+        EventRecord latest;
+        conflation_detail::TouchRange range;
+    };
+
+    struct Book {
+        SymbolId symbol_id = INVALID_SYMBOL_ID;
+        SymbolCode symbol{};
+        OrderBook book;
+        bool diff_fed = false;
+        uint64_t updates = 0;
+        uint64_t first_event_us = 0;
+        uint64_t received_us = 0;
+        // Range of the touch at range_exponent
+        conflation_detail::TouchRange range;
+        int8_t range_exponent = 0;
+        // First gap of the interval
+        bool gap = false;
+        uint64_t expected_first_id = 0;
+        uint64_t first_id = 0;
+    };
+
+    static void note(uint64_t &updates, uint64_t &first_event_us, uint64_t event_time_us) {
+        if (updates++ == 0) {
+            first_event_us = event_time_us;
+        }
+    }
+
+    Quote *quote_for(std::string_view symbol) {
+        const SymbolId id = symbol_table().intern(symbol);
+        if (id == INVALID_SYMBOL_ID) {
+            return nullptr;
+        }
+        if (id >= quotes_.size()) {
+            quotes_.resize(id + 1);
+        }
+        quotes_[id].symbol_id = id;
+        return &quotes_[id];
+    }
+
+    Book *book_for(std::string_view symbol) {
+        const SymbolId id = symbol_table().intern(symbol);
+        if (id == INVALID_SYMBOL_ID) {
+            return nullptr;
+        }
+        if (id >= books_.size()) {
+            books_.resize(id + 1);
+        }
+        if (!books_[id]) {
+            books_[id] = std::make_unique<Book>();
+            books_[id]->symbol_id = id;
+            books_[id]->symbol = to_symbol_code(symbol);
+        }
+        return books_[id].get();
+    }
+
+    void touched(Book &book, uint64_t event_time_us, uint64_t received_us) {
+        stats_.updates.fetch_add(1, std::memory_order_relaxed);
+        note(book.updates, book.first_event_us, event_time_us);
+        book.received_us = received_us;
+        const OrderBook &b = book.book;
+        if (book.range_exponent != b.price_exponent()) {
+            book.range.clear();
+            book.range_exponent = b.price_exponent();
+        }
+        if (b.bids().size() > 0) {
+            book.range.add_bid(b.bids().best().price);
+        }
+        if (b.asks().size() > 0) {
+            book.range.add_ask(b.asks().best().price);
+        }
+    }
+
+    EventRecord &push(EventKind kind, SymbolId symbol_id, const SymbolCode &symbol, uint64_t ingest_ts_us) {
+        EventRecord &record = frame_.emplace_back();
+        record.kind = kind;
+        record.symbol_id = symbol_id;
+        record.symbol = symbol;
+        record.ingest_ts_us = ingest_ts_us;
+        return record;
+    }
+
+    // The Conflation record closing a frame
+    void summarize(const SymbolCode &symbol, SymbolId symbol_id, uint64_t ingest_ts_us, ConflatedStream stream,
+                   int8_t price_exponent, uint64_t event_time_us, uint64_t updates, uint64_t first_event_us,
+                   const conflation_detail::TouchRange &range) {
+        EventRecord &record = push(EventKind::Conflation, symbol_id, symbol, ingest_ts_us);
+        record.flag = static_cast<uint8_t>(stream);
+        record.price_exponent = price_exponent;
+        record.event_time_us = event_time_us;
+        record.id[0] = static_cast<int64_t>(updates);
+        record.id[1] = static_cast<int64_t>(first_event_us);
+        record.mantissa[0] = range.has_bid ? range.bid_low : 0;
+        record.mantissa[1] = range.has_bid ? range.bid_high : 0;
+        record.mantissa[2] = range.has_ask ? range.ask_low : 0;
+        record.mantissa[3] = range.has_ask ? range.ask_high : 0;
+    }
+
+    template <typename Stage>
+    void emit_quote(Quote &quote, Stage &stage) {
+        const EventRecord &latest = quote.latest;
+        frame_.clear();
+        frame_.push_back(latest);
+        summarize(latest.symbol, latest.symbol_id, latest.ingest_ts_us, ConflatedStream::BestBidAsk,
+                  latest.price_exponent, latest.event_time_us, quote.updates, quote.first_event_us, quote.range);
+        stage(std::span<EventRecord>(frame_));
+        stats_.frames.fetch_add(1, std::memory_order_relaxed);
+        quote.updates = 0;
+        quote.range.clear();
+        quote.range.add_bid(latest.mantissa[0]);
+        quote.range.add_ask(latest.mantissa[2]);
+    }
+
+    template <typename Stage>
+    void emit_book(Book &book, Stage &stage) {
+        const OrderBook &b = book.book;
+        frame_.clear();
+        if (book.gap) {
+            EventRecord &gap = push(EventKind::DepthGap, book.symbol_id, book.symbol, book.received_us);
+            gap.event_time_us = b.event_time_us();
+            gap.id[0] = static_cast<int64_t>(book.expected_first_id);
+            gap.id[1] = static_cast<int64_t>(book.first_id);
+        }
+        EventRecord &snapshot = push(EventKind::PartialDepth, book.symbol_id, book.symbol, book.received_us);
+        snapshot.price_exponent = b.price_exponent();
+        snapshot.qty_exponent = b.qty_exponent();
+        snapshot.event_time_us = b.event_time_us();
+        snapshot.id[0] = static_cast<int64_t>(b.last_update_id());
+        const auto stage_side = [&](const BookSideLevels &side, uint8_t is_bid) {
+            side.for_each_top(config_.depth_levels, [&](const BookLevel &level) {
+                EventRecord &record = push(EventKind::DepthLevel, book.symbol_id, book.symbol, book.received_us);
+                record.flag = is_bid;
+                record.price_exponent = b.price_exponent();
+                record.qty_exponent = b.qty_exponent();
+                record.mantissa[0] = level.price;
+                record.mantissa[1] = level.qty;
+            });
+        };
+        stage_side(b.bids(), 1);
+        stage_side(b.asks(), 0);
+        summarize(book.symbol, book.symbol_id, book.received_us, ConflatedStream::Depth, b.price_exponent(),
+                  b.event_time_us(), book.updates, book.first_event_us, book.range);
+        stage(std::span<EventRecord>(frame_));
+        stats_.frames.fetch_add(1, std::memory_order_relaxed);
+        book.updates = 0;
+        book.gap = false;
+        book.range.clear();
+        if (b.bids().size() > 0) {
+            book.range.add_bid(b.bids().best().price);
+        }
+        if (b.asks().size() > 0) {
+            book.range.add_ask(b.asks().best().price);
+        }
+    }
+
+    ConflationConfig config_;
+    ConflationStats stats_;
+    uint64_t next_bba_us_ = 0;
+    uint64_t next_depth_us_ = 0;
+    // By SymbolId
+    std::vector<Quote> quotes_;
+    std::vector<std::unique_ptr<Book>> books_;
+    // Records of the frame being emitted
+    std::vector<EventRecord> frame_;
+};
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Runtime choice between SIMD kernel variants.
+ *
+ * The extension is compiled for a portable baseline (SSE4.2 on x86-64,
+ * armv8-a with NEON on aarch64; see setup.py), so one image runs on every
+ * instance type it lands on. The kernels that gain from wider vectors
+ * (column_stats.h, mlp_model.h) are compiled once more per wider ISA through
+ * target attributes, and simd_level() picks the widest one the CPU and OS
+ * support. It is detected once and cached; the module reads it at import.
+ *
+ * SBE_DECODER_SIMD=baseline|avx2|avx512 caps the level, e.g. to compare
+ * kernels on one host or to rule a kernel out in production. It never raises
+ * the level past what the CPU supports.
+ */
+
+#ifndef _SBE_CPU_DISPATCH_H_
+#define _SBE_CPU_DISPATCH_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__)
+#define SBE_X86_DISPATCH 1
+#else
+#define SBE_X86_DISPATCH 0
+#endif
+
+#if SBE_X86_DISPATCH
+#include <immintrin.h>
+// Variants compiled for wider ISAs than the baseline; every helper a kernel
+// inlines must carry the same attribute
+#define SBE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SBE_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx2,fma")))
+#endif
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+enum class SimdLevel : int {
+    Baseline = 0,
+    Avx2 = 1,
+    Avx512 = 2,
+};
+
+namespace cpu_dispatch_detail {
+
+inline SimdLevel detect_simd_level() {
+#if SBE_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        return SimdLevel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return SimdLevel::Avx2;
+    }
+#endif
+    return SimdLevel::Baseline;
+}
+
+// The SBE_DECODER_SIMD cap; unset or unknown leaves the level alone
+inline SimdLevel simd_level_cap() {
+    const char *cap = std::getenv("SBE_DECODER_SIMD");
+    if (cap == nullptr) {
+        return SimdLevel::Avx512;
+    }
+    if (std::strcmp(cap, "baseline") == 0) {
+        return SimdLevel::Baseline;
+    }
+    if (std::strcmp(cap, "avx2") == 0) {
+        return SimdLevel::Avx2;
+    }
+    return SimdLevel::Avx512;
+}
+
+} // namespace cpu_dispatch_detail
+
+inline SimdLevel simd_level() {
+    static const SimdLevel level =
+        std::min(cpu_dispatch_detail::detect_simd_level(), cpu_dispatch_detail::simd_level_cap());
+    return level;
+}
+
+// Kernel name for `level`, for benchmarks and logs: the baseline is named
+// after the ISA it is compiled for
+inline const char *simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Avx512:
+        return "avx512";
+    case SimdLevel::Avx2:
+        return "avx2";
+    case SimdLevel::Baseline:
+        break;
+    }
+#if defined(__aarch64__)
+    return "neon";
+#elif defined(__SSE4_2__)
+    return "sse4.2";
+#elif defined(__x86_64__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * Fixed-point decimal values: mantissa * 10^exponent in integers.
+ *
+ * official/decimal.h's Decimal is the wire form of every SBE price and
+ * quantity, but consumers used to turn it into a double right away and
+ * back into text or Python Decimal later, rounding twice on the way.
+ * Decimal64 is the same (int64 mantissa, int8 exponent) pair as a value
+ * type, so prices and quantities can stay exact from the decoder through
+ * the book (whose levels already hold mantissas) to the record writers:
+ *
+ *   - + and - align both operands to the finer exponent and * adds the
+ *     exponents, all in 128-bit integers; a result that does not fit an
+ *     int64 mantissa, even with its trailing zeros dropped, throws
+ *     std::overflow_error instead of rounding silently
+ *   - comparison is by value across exponents (1.50 == 1.5)
+ *   - text() is the exact decimal text of format_mantissa_text()
+ *
+ * DecimalSum accumulates many values, or products such as price * qty
+ * notionals, in a 128-bit mantissa at the finest exponent seen, so VWAP
+ * and notional sums are exact and only their final ratio is rounded.
+ */
+
+#ifndef _SBE_DECIMAL64_H_
+#define _SBE_DECIMAL64_H_
+
+#include <array>
+#include <cmath>
+#include <compare>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+
+#include "decimal_text.h"
+#include "official/decimal.h"
+#include "stream_decode.h"
+
+using int128_t = __int128;
+
+namespace decimal64_detail {
+
+// 10^0 .. 10^38, every power of ten an int128 holds
+inline constexpr auto POW10_I128_TABLE = [] {
+    std::array<int128_t, 39> table{};
+    table[0] = 1;
+    for (std::size_t i = 1; i < table.size(); ++i) {
+        table[i] = table[i - 1] * 10;
+    }
+    return table;
+}();
+
+constexpr int MAX_I128_SHIFT = static_cast<int>(POW10_I128_TABLE.size()) - 1;
+constexpr int128_t I128_MAX = static_cast<int128_t>((~static_cast<unsigned __int128>(0)) >> 1);
+
+// value * 10^shift, false on overflow
+inline bool scale_up(int128_t value, int shift, int128_t &out) {
+    if (value == 0) {
+        out = 0;
+        return true;
+    }
+    if (shift > MAX_I128_SHIFT) {
+        return false;
+    }
+    const int128_t factor = POW10_I128_TABLE[shift];
+    const int128_t magnitude = value < 0 ? -value : value;
+    if (magnitude > I128_MAX / factor) {
+        return false;
+    }
+    out = value * factor;
+    return true;
+}
+
+inline double to_double(int128_t mantissa, int exponent) {
+    // An int64 converts in one instruction, an int128 through a libcall
+    const bool narrow = mantissa >= std::numeric_limits<int64_t>::min() &&
+                        mantissa <= std::numeric_limits<int64_t>::max();
+    const double value = narrow ? static_cast<double>(static_cast<int64_t>(mantissa)) : static_cast<double>(mantissa);
+    if (exponent >= 0) {
+        return exponent < static_cast<int>(POW10_TABLE.size()) ? value * POW10_TABLE[exponent]
+                                                               : value * std::pow(10.0, exponent);
+    }
+    return -exponent < static_cast<int>(POW10_TABLE.size()) ? value / POW10_TABLE[-exponent]
+                                                            : value * std::pow(10.0, exponent);
+}
+
+} // namespace decimal64_detail
+
+struct Decimal64 {
+    int64_t mantissa = 0;
+    int8_t exponent = 0;
+
+    constexpr Decimal64() = default;
+    constexpr Decimal64(int64_t m, int8_t e) : mantissa(m), exponent(e) {}
+    explicit constexpr Decimal64(const Decimal &wire) : mantissa(wire.mantissa), exponent(wire.exponent) {}
+
+    // The exact value of a wide mantissa, trailing zeros dropped as needed;
+    // throws std::overflow_error when it has no int64 mantissa
+    static Decimal64 from_wide(int128_t mantissa, int exponent) {
+        while ((mantissa > std::numeric_limits<int64_t>::max() || mantissa < std::numeric_limits<int64_t>::min() ||
+                exponent < std::numeric_limits<int8_t>::min()) &&
+               mantissa % 10 == 0 && exponent < std::numeric_limits<int8_t>::max()) {
+            mantissa /= 10;
+            ++exponent;
+        }
+        if (mantissa > std::numeric_limits<int64_t>::max() || mantissa < std::numeric_limits<int64_t>::min() ||
+            exponent < std::numeric_limits<int8_t>::min() || exponent > std::numeric_limits<int8_t>::max()) {
+            throw std::overflow_error("Decimal64: result does not fit a 64-bit mantissa");
+        }
+        return {static_cast<int64_t>(mantissa), static_cast<int8_t>(exponent)};
+    }
+
+    Decimal to_decimal() const { return {mantissa, exponent}; }
+    double to_double() const { return decode_decimal(mantissa, exponent); }
+
+    // Exact decimal text into `buf` (DECIMAL_TEXT_SIZE chars)
+    std::string_view text(char *buf) const { return format_mantissa_text(mantissa, exponent, buf); }
+
+    // The same value at `target`, if that needs no rounding and fits
+    bool rescale(int8_t target, Decimal64 &out) const {
+        if (target <= exponent) {
+            int128_t scaled = 0;
+            if (!decimal64_detail::scale_up(mantissa, exponent - target, scaled) ||
+                scaled > std::numeric_limits<int64_t>::max() || scaled < std::numeric_limits<int64_t>::min()) {
+                return false;
+            }
+            out = {static_cast<int64_t>(scaled), target};
+            return true;
+        }
+        const int shift = target - exponent;
+        if (shift > decimal64_detail::MAX_I128_SHIFT) {
+            if (mantissa != 0) {
+                return false;
+            }
+            out = {0, target};
+            return true;
+        }
+        const int128_t factor = decimal64_detail::POW10_I128_TABLE[shift];
+        if (mantissa % factor != 0) {
+            return false;
+        }
+        out = {static_cast<int64_t>(mantissa / factor), target};
+        return true;
+    }
+
+    // Trailing zeros dropped: the smallest mantissa of the same value
+    Decimal64 normalized() const {
+        if (mantissa == 0) {
+            return {0, 0};
+        }
+        Decimal64 out = *this;
+        while (out.mantissa % 10 == 0 && out.exponent < std::numeric_limits<int8_t>::max()) {
+            out.mantissa /= 10;
+            ++out.exponent;
+        }
+        return out;
+    }
+
+    friend Decimal64 operator+(const Decimal64 &a, const Decimal64 &b) { return add(a, b, false); }
+    friend Decimal64 operator-(const Decimal64 &a, const Decimal64 &b) { return add(a, b, true); }
+
+    friend Decimal64 operator*(const Decimal64 &a, const Decimal64 &b) {
+        return from_wide(static_cast<int128_t>(a.mantissa) * b.mantissa, a.exponent + b.exponent);
+    }
+
+    friend std::strong_ordering operator<=>(const Decimal64 &a, const Decimal64 &b) {
+        if (a.exponent == b.exponent) {
+            return a.mantissa <=> b.mantissa;
+        }
+        const int sign_a = (a.mantissa > 0) - (a.mantissa < 0);
+        const int sign_b = (b.mantissa > 0) - (b.mantissa < 0);
+        if (sign_a != sign_b || sign_a == 0) {
+            return sign_a <=> sign_b;
+        }
+        // Same sign, both nonzero: scale the coarser one to the finer exponent.
+        // Past 10^38 the coarser one's magnitude dominates any int64.
+        const bool a_coarser = a.exponent > b.exponent;
+        const Decimal64 &coarse = a_coarser ? a : b;
+        const Decimal64 &fine = a_coarser ? b : a;
+        int128_t scaled = 0;
+        std::strong_ordering coarse_vs_fine = std::strong_ordering::equal;
+        if (decimal64_detail::scale_up(coarse.mantissa, coarse.exponent - fine.exponent, scaled)) {
+            coarse_vs_fine = scaled <=> static_cast<int128_t>(fine.mantissa);
+        } else {
+            coarse_vs_fine = sign_a > 0 ? std::strong_ordering::greater : std::strong_ordering::less;
+        }
+        return a_coarser ? coarse_vs_fine : 0 <=> coarse_vs_fine;
+    }
+
+    friend bool operator==(const Decimal64 &a, const Decimal64 &b) { return (a <=> b) == 0; }
+
+private:
+    static Decimal64 add(const Decimal64 &a, const Decimal64 &b, bool subtract) {
+        const int exponent = a.exponent < b.exponent ? a.exponent : b.exponent;
+        int128_t left = 0;
+        int128_t right = 0;
+        if (!decimal64_detail::scale_up(a.mantissa, a.exponent - exponent, left) ||
+            !decimal64_detail::scale_up(b.mantissa, b.exponent - exponent, right)) {
+            throw std::overflow_error("Decimal64: operands too far apart in scale");
+        }
+        return from_wide(subtract ? left - right : left + right, exponent);
+    }
+};
+
+// A running sum of decimals (or of products of two) in a 128-bit mantissa
+// at the finest exponent added so far
+class DecimalSum {
+public:
+    void add(const Decimal64 &value) { add_wide(value.mantissa, value.exponent); }
+
+    // Adds a * b exactly, e.g. a trade's price * qty notional
+    void add_product(const Decimal64 &a, const Decimal64 &b) {
+        add_wide(static_cast<int128_t>(a.mantissa) * b.mantissa, a.exponent + b.exponent);
+    }
+
+    void reset() { *this = DecimalSum{}; }
+
+    bool empty() const { return !started_; }
+    int128_t mantissa() const { return mantissa_; }
+    int exponent() const { return exponent_; }
+
+    // The sum as a Decimal64; throws std::overflow_error if it has outgrown
+    // one
+    Decimal64 value() const { return Decimal64::from_wide(mantissa_, exponent_); }
+    double to_double() const { return decimal64_detail::to_double(mantissa_, exponent_); }
+
+    // this / other as a double, one rounding of two exact sums
+    double ratio(const DecimalSum &other) const {
+        return static_cast<double>(mantissa_) / static_cast<double>(other.mantissa_) *
+               decimal64_detail::to_double(1, exponent_ - other.exponent_);
+    }
+
+private:
+    void add_wide(int128_t mantissa, int exponent) {
+        if (!started_) {
+            started_ = true;
+            exponent_ = exponent;
+        }
+        if (exponent < exponent_) {
+            if (!decimal64_detail::scale_up(mantissa_, exponent_ - exponent, mantissa_)) {
+                throw std::overflow_error("DecimalSum: sum outgrew 128 bits");
+            }
+            exponent_ = exponent;
+        } else if (exponent > exponent_ && !decimal64_detail::scale_up(mantissa, exponent - exponent_, mantissa)) {
+            throw std::overflow_error("DecimalSum: value outgrew 128 bits");
+        }
+        if (__builtin_add_overflow(mantissa_, mantissa, &mantissa_)) {
+            throw std::overflow_error("DecimalSum: sum outgrew 128 bits");
+        }
+    }
+
+    int128_t mantissa_ = 0;
+    int exponent_ = 0;
+    bool started_ = false;
+};
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ * Decimal text for prices and quantities.
+ *
+ * Depth levels are published as [price, qty] strings in the same form the
+ * Python client wrote with f"{float(v):.8f}".rstrip('0').rstrip('.'):
+ * plain notation, trailing fractional zeros and point stripped.
+ * format_mantissa_text() produces that straight from the SBE mantissa and
+ * exponent with integer digit placement, so there is no round trip through
+ * double: the text is always exact, where the double path printed binary
+ * noise for larger mantissas (77887868022.77 became "77887868022.77000427").
+ *
+ * The reverse direction, parse_decimal_text(), reads the price and qty
+ * strings of REST JSON into the same (mantissa, exponent) Decimal the SBE
+ * schemas use, keeping the digits as written ("65000.50" is 6500050e-2,
+ * like Python's Decimal). Digits are consumed eight at a time with SWAR
+ * arithmetic on one 64-bit load, so a typical 8-14 digit price costs two
+ * or three multiplies instead of a loop over characters.
+ */
+
+#ifndef _SBE_DECIMAL_TEXT_H_
+#define _SBE_DECIMAL_TEXT_H_
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "official/decimal.h"
+
+constexpr std::size_t DECIMAL_TEXT_SIZE = 48;
+
+// Largest |exponent| whose text always fits DECIMAL_TEXT_SIZE
+constexpr int MAX_TEXT_EXPONENT = 24;
+
+// Decimal text as the Python client used to write it: eight places, trailing zeros and
+// point stripped. `buf` must hold DECIMAL_TEXT_SIZE chars; magnitudes too
+// large for that fall back to the shortest form.
+inline std::string_view format_decimal_text(double value, char *buf) {
+    auto result = std::to_chars(buf, buf + DECIMAL_TEXT_SIZE, value, std::chars_format::fixed, 8);
+    if (result.ec != std::errc{}) {
+        result = std::to_chars(buf, buf + DECIMAL_TEXT_SIZE, value);
+        return {buf, static_cast<std::size_t>(result.ptr - buf)};
+    }
+    std::string_view text(buf, static_cast<std::size_t>(result.ptr - buf));
+    while (!text.empty() && text.back() == '0') {
+        text.remove_suffix(1);
+    }
+    if (!text.empty() && text.back() == '.') {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+// Exact text of mantissa * 10^exponent into `buf` (DECIMAL_TEXT_SIZE chars).
+// Exponents beyond MAX_TEXT_EXPONENT never occur in Binance schemas and go
+// through format_decimal_text() instead.
+inline std::string_view format_mantissa_text(int64_t mantissa, int8_t exponent, char *buf) {
+    if (exponent > MAX_TEXT_EXPONENT || exponent < -MAX_TEXT_EXPONENT) {
+        return format_decimal_text(static_cast<double>(mantissa) * std::pow(10.0, exponent), buf);
+    }
+    if (mantissa == 0) {
+        buf[0] = '0';
+        return {buf, 1};
+    }
+
+    char *cursor = buf;
+    // Magnitude as unsigned so INT64_MIN has a representation too
+    const bool negative = mantissa < 0;
+    uint64_t magnitude = negative ? 0 - static_cast<uint64_t>(mantissa) : static_cast<uint64_t>(mantissa);
+    if (negative) {
+        *cursor++ = '-';
+    }
+    if (exponent >= 0) {
+        cursor = std::to_chars(cursor, buf + DECIMAL_TEXT_SIZE, magnitude).ptr;
+        std::memset(cursor, '0', static_cast<std::size_t>(exponent));
+        return {buf, static_cast<std::size_t>(cursor + exponent - buf)};
+    }
+
+    // Trailing zeros of the scaled part never reach the output
+    int scale = -exponent;
+    while (scale > 0 && magnitude % 10 == 0) {
+        magnitude /= 10;
+        --scale;
+    }
+    char digits[24];
+    const auto length = static_cast<int>(std::to_chars(digits, digits + sizeof(digits), magnitude).ptr - digits);
+    if (scale == 0) {
+        std::memcpy(cursor, digits, static_cast<std::size_t>(length));
+        cursor += length;
+    } else if (length > scale) {
+        std::memcpy(cursor, digits, static_cast<std::size_t>(length - scale));
+        cursor += length - scale;
+        *cursor++ = '.';
+        std::memcpy(cursor, digits + length - scale, static_cast<std::size_t>(scale));
+        cursor += scale;
+    } else {
+        *cursor++ = '0';
+        *cursor++ = '.';
+        std::memset(cursor, '0', static_cast<std::size_t>(scale - length));
+        cursor += scale - length;
+        std::memcpy(cursor, digits, static_cast<std::size_t>(length));
+        cursor += length;
+    }
+    return {buf, static_cast<std::size_t>(cursor - buf)};
+}
+
+
+namespace decimal_text_detail {
+
+// Significant digits that always fit an unsigned 64-bit accumulator
+constexpr int MAX_MANTISSA_DIGITS = 19;
+
+inline uint64_t load8(const char *p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// All eight bytes are '0'..'9' (little-endian load)
+inline bool is_eight_digits(uint64_t v) {
+    return ((v & 0xF0F0F0F0F0F0F0F0ULL) | (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+           0x3333333333333333ULL;
+}
+
+// Value of eight ASCII digits: pairs, then quads, then the whole in three
+// multiplies
+inline uint32_t eight_digits_value(uint64_t v) {
+    v -= 0x3030303030303030ULL;
+    v = v * 10 + (v >> 8);
+    v = ((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)) +
+         ((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32))) >>
+        32;
+    return static_cast<uint32_t>(v);
+}
+
+// Appends the digits at `p` to `mantissa`; nullptr once more than
+// MAX_MANTISSA_DIGITS significant digits have been read
+inline const char *scan_digits(const char *p, const char *end, uint64_t &mantissa, int &digits) {
+    while (end - p >= 8 && digits + 8 <= MAX_MANTISSA_DIGITS && is_eight_digits(load8(p))) {
+        const uint32_t chunk = eight_digits_value(load8(p));
+        if (mantissa != 0) {
+            digits += 8;
+        } else {
+            // Leading zeros are not significant
+            for (uint32_t rest = chunk; rest != 0; rest /= 10) {
+                ++digits;
+            }
+        }
+        mantissa = mantissa * 100000000 + chunk;
+        p += 8;
+    }
+    while (p != end && static_cast<unsigned char>(*p - '0') < 10) {
+        if (mantissa != 0 || *p != '0') {
+            if (++digits > MAX_MANTISSA_DIGITS) {
+                return nullptr;
+            }
+        }
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+        ++p;
+    }
+    return p;
+}
+
+} // namespace decimal_text_detail
+
+// [+-]digits[.digits][(e|E)[+-]digits] into `out`. False for anything else
+// (empty, NaN/Infinity, stray characters) and for values whose mantissa or
+// exponent does not fit the Decimal (over 19 significant digits, exponent
+// outside int8).
+inline bool parse_decimal_text(std::string_view text, Decimal &out) {
+    using namespace decimal_text_detail;
+    const char *p = text.data();
+    const char *end = p + text.size();
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    const char *integer = p;
+    p = scan_digits(p, end, mantissa, digits);
+    if (p == nullptr) {
+        return false;
+    }
+    bool any = p != integer;
+    if (p != end && *p == '.') {
+        const char *fraction = ++p;
+        p = scan_digits(p, end, mantissa, digits);
+        if (p == nullptr) {
+            return false;
+        }
+        exponent = -static_cast<int>(p - fraction);
+        any = any || p != fraction;
+    }
+    if (!any) {
+        return false;
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        if (p != end && *p == '+') {
+            ++p;
+        }
+        int shift = 0;
+        const auto result = std::from_chars(p, end, shift);
+        if (result.ec != std::errc{} || result.ptr == p) {
+            return false;
+        }
+        p = result.ptr;
+        // Far outside int8 either way; keeps the sum from overflowing
+        if (shift < -1000 || shift > 1000) {
+            return false;
+        }
+        exponent += shift;
+    }
+    if (p != end || exponent < INT8_MIN || exponent > INT8_MAX) {
+        return false;
+    }
+    if (mantissa > static_cast<uint64_t>(INT64_MAX) + (negative ? 1 : 0)) {
+        return false;
+    }
+    out.mantissa = negative ? static_cast<int64_t>(0 - mantissa) : static_cast<int64_t>(mantissa);
+    out.exponent = static_cast<int8_t>(exponent);
+    return true;
+}
+
+// `value` as an integer count of 10^exponent units, exactly. False when it
+// has digits below that unit or overflows int64.
+inline bool rescale_decimal(const Decimal &value, int exponent, int64_t &out) {
+    int64_t mantissa = value.mantissa;
+    int shift = value.exponent - exponent;
+    for (; shift < 0; ++shift) {
+        if (mantissa % 10 != 0) {
+            return false;
+        }
+        mantissa /= 10;
+    }
+    for (; shift > 0; --shift) {
+        if (__builtin_mul_overflow(mantissa, int64_t{10}, &mantissa)) {
+            return false;
+        }
+    }
+    out = mantissa;
+    return true;
+}
+
+// A column of decimal strings: mantissa and exponent per row, with a 0/1
+// valid flag (invalid rows are 0e0)
+struct DecimalTextColumn {
+    std::vector<int64_t> mantissa;
+    std::vector<int8_t> exponent;
+    std::vector<uint8_t> valid;
+    std::size_t invalid = 0;
+};
+
+template <typename Texts>
+DecimalTextColumn parse_decimal_column(const Texts &texts) {
+    DecimalTextColumn column;
+    column.mantissa.resize(texts.size());
+    column.exponent.resize(texts.size());
+    column.valid.resize(texts.size());
+    for (std::size_t i = 0; i < texts.size(); ++i) {
+        Decimal value{0, 0};
+        const bool ok = parse_decimal_text(texts[i], value);
+        column.mantissa[i] = value.mantissa;
+        column.exponent[i] = value.exponent;
+        column.valid[i] = ok ? 1 : 0;
+        column.invalid += ok ? 0 : 1;
+    }
+    return column;
+}
+
+#endif
@@ -0,0 +1,395 @@
+/*
+ * Per-template decode statistics: message, byte and parse-error counts (the
+ * latter also per ParseError cause) plus an HDR-style latency histogram of
+ * decode time.
+ *
+ * Decode time is measured in ticks of the cheapest clock available (the TSC
+ * on x86-64, steady_clock elsewhere) and converted to nanoseconds only when
+ * the statistics are read. The histogram is log-linear: values below 32
+ * ticks get a bucket each, above that every power of two is split into 32
+ * linear sub-buckets, so a reported percentile is within ~3% of the true
+ * value. Recording is a bucket index computation and a few relaxed stores.
+ *
+ * There is one writer, the thread decoding (for SBEDecoder the caller
+ * holding its InstanceLock, or the GIL); counters are single-writer atomics so a reader on any
+ * thread sees torn-free values without the writer paying for a locked
+ * read-modify-write. Per-template blocks are allocated on the first frame of
+ * their template and published with a release store.
+ *
+ * With allocation accounting on (alloc_accounting.h), each frame also adds
+ * the heap and Python allocations made while it was decoded; sampled frames
+ * add their hardware counter deltas (perf_counters.h).
+ */
+
+#ifndef _SBE_DECODE_STATS_H_
+#define _SBE_DECODE_STATS_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#define SBE_DECODE_CLOCK_TSC 1
+#endif
+
+#include "alloc_accounting.h"
+#include "native_metrics.h"
+#include "parse_error.h"
+#include "perf_counters.h"
+#include "template_dispatch.h"
+
+// ---------------------------------------------------------------------------
+// Tick clock
+// ---------------------------------------------------------------------------
+
+inline uint64_t decode_clock_ticks() {
+#ifdef SBE_DECODE_CLOCK_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+inline const char *decode_clock_name() {
+#ifdef SBE_DECODE_CLOCK_TSC
+    return "tsc";
+#else
+    return "steady_clock";
+#endif
+}
+
+struct DecodeClockAnchor {
+    std::chrono::steady_clock::time_point time;
+    uint64_t ticks;
+};
+
+// Calibration anchor, taken the first time it is asked for (DecodeStats
+// asks on construction)
+inline const DecodeClockAnchor &decode_clock_anchor() {
+    static const DecodeClockAnchor anchor{std::chrono::steady_clock::now(), decode_clock_ticks()};
+    return anchor;
+}
+
+// Nanoseconds per tick, measured against steady_clock from the anchor to
+// now, so the estimate sharpens the longer the process runs. Waits until the
+// anchor is CALIBRATION_WINDOW old if it is younger.
+inline double decode_clock_ns_per_tick() {
+#ifdef SBE_DECODE_CLOCK_TSC
+    static constexpr auto CALIBRATION_WINDOW = std::chrono::milliseconds(10);
+    const DecodeClockAnchor &anchor = decode_clock_anchor();
+    auto now = std::chrono::steady_clock::now();
+    if (now - anchor.time < CALIBRATION_WINDOW) {
+        std::this_thread::sleep_until(anchor.time + CALIBRATION_WINDOW);
+        now = std::chrono::steady_clock::now();
+    }
+    const uint64_t ticks = decode_clock_ticks() - anchor.ticks;
+    const double ns = std::chrono::duration<double, std::nano>(now - anchor.time).count();
+    return ticks == 0 ? 1.0 : ns / static_cast<double>(ticks);
+#else
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::duration(1)).count();
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Histogram
+// ---------------------------------------------------------------------------
+
+// Increment a counter that only one thread writes
+inline void bump_counter(std::atomic<uint64_t> &counter, uint64_t n = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKETS = uint64_t{1} << SUB_BUCKET_BITS;
+    // Values are clamped to 2^36 ticks (about 20 s at 3.5 GHz)
+    static constexpr int VALUE_BITS = 36;
+    static constexpr uint64_t MAX_VALUE = (uint64_t{1} << VALUE_BITS) - 1;
+    static constexpr std::size_t BUCKET_COUNT = SUB_BUCKETS * (VALUE_BITS - SUB_BUCKET_BITS + 1);
+
+    static constexpr std::size_t bucket_of(uint64_t value) {
+        value = std::min(value, MAX_VALUE);
+        if (value < SUB_BUCKETS) {
+            return static_cast<std::size_t>(value);
+        }
+        const int shift = std::bit_width(value) - 1 - SUB_BUCKET_BITS;
+        return static_cast<std::size_t>(SUB_BUCKETS * (shift + 1) + ((value >> shift) - SUB_BUCKETS));
+    }
+
+    // Highest value that lands in `bucket`
+    static constexpr uint64_t bucket_ceiling(std::size_t bucket) {
+        if (bucket < SUB_BUCKETS) {
+            return bucket;
+        }
+        const uint64_t shift = bucket / SUB_BUCKETS - 1;
+        const uint64_t lowest = (SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+        return lowest + (uint64_t{1} << shift) - 1;
+    }
+
+    void record(uint64_t value) {
+        bump_counter(buckets_[bucket_of(value)]);
+        bump_counter(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    // Writer-side only, like record()
+    void reset() {
+        for (auto &bucket : buckets_) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        uint64_t p50 = 0;
+        uint64_t p99 = 0;
+        uint64_t p999 = 0;
+    };
+
+    // Percentiles are bucket ceilings capped at the exact maximum
+    Summary summary() const {
+        std::vector<uint64_t> counts(BUCKET_COUNT);
+        Summary out;
+        for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            out.count += counts[i];
+        }
+        out.sum = sum_.load(std::memory_order_relaxed);
+        out.max = max_.load(std::memory_order_relaxed);
+        if (out.count == 0) {
+            return out;
+        }
+
+        const auto rank = [&](uint64_t per_mille) {
+            return std::max<uint64_t>(1, (out.count * per_mille + 999) / 1000);
+        };
+        const std::array<uint64_t, 3> ranks = {rank(500), rank(990), rank(999)};
+        std::array<uint64_t *, 3> targets = {&out.p50, &out.p99, &out.p999};
+        std::size_t next = 0;
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < BUCKET_COUNT && next < ranks.size(); ++i) {
+            seen += counts[i];
+            while (next < ranks.size() && seen >= ranks[next]) {
+                *targets[next++] = std::min(bucket_ceiling(i), out.max);
+            }
+        }
+        return out;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_{};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// ---------------------------------------------------------------------------
+// Per-template statistics
+// ---------------------------------------------------------------------------
+
+struct TemplateDecodeStats {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> parse_errors{0};
+    // parse_errors by cause, in ParseError order (None stays zero)
+    std::array<std::atomic<uint64_t>, PARSE_ERROR_COUNT> parse_error_causes{};
+    // Only counted with allocation accounting on
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> alloc_bytes{0};
+    std::atomic<uint64_t> py_allocations{0};
+    // Sums over the frames sampled with hardware counters, in PerfEvent order
+    std::atomic<uint64_t> perf_samples{0};
+    std::array<std::atomic<uint64_t>, PERF_EVENT_COUNT> perf{};
+    LatencyHistogram latency;
+
+    void reset() {
+        messages.store(0, std::memory_order_relaxed);
+        bytes.store(0, std::memory_order_relaxed);
+        parse_errors.store(0, std::memory_order_relaxed);
+        for (auto &value : parse_error_causes) {
+            value.store(0, std::memory_order_relaxed);
+        }
+        allocations.store(0, std::memory_order_relaxed);
+        alloc_bytes.store(0, std::memory_order_relaxed);
+        py_allocations.store(0, std::memory_order_relaxed);
+        perf_samples.store(0, std::memory_order_relaxed);
+        for (auto &value : perf) {
+            value.store(0, std::memory_order_relaxed);
+        }
+        latency.reset();
+    }
+};
+
+class DecodeStats {
+public:
+    using Slots = TemplateTable<char>;
+
+    DecodeStats() { decode_clock_anchor(); }
+    DecodeStats(const DecodeStats &) = delete;
+    DecodeStats &operator=(const DecodeStats &) = delete;
+
+    // One decoded frame of `template_id`, `ticks` long (decode_clock_ticks),
+    // that made `allocs` allocations and failed with `parse_error` unless None
+    void record(uint16_t template_id, std::size_t bytes, uint64_t ticks, ParseError parse_error,
+                const AllocCounts &allocs = {}) {
+        TemplateDecodeStats *stats = slot(template_id);
+        if (stats == nullptr) {
+            bump_counter(untracked_);
+            return;
+        }
+        bump_counter(stats->messages);
+        bump_counter(stats->bytes, bytes);
+        if (parse_error != ParseError::None) [[unlikely]] {
+            bump_counter(stats->parse_errors);
+            bump_counter(stats->parse_error_causes[static_cast<std::size_t>(parse_error)]);
+        }
+        if (allocs.allocations != 0 || allocs.py_allocations != 0) {
+            bump_counter(stats->allocations, allocs.allocations);
+            bump_counter(stats->alloc_bytes, allocs.bytes);
+            bump_counter(stats->py_allocations, allocs.py_allocations);
+        }
+        stats->latency.record(ticks);
+    }
+
+    // Hardware counter deltas of one sampled frame of `template_id`
+    void record_perf(uint16_t template_id, const PerfReading &delta) {
+        TemplateDecodeStats *stats = slot(template_id);
+        if (stats == nullptr) {
+            return;
+        }
+        bump_counter(stats->perf_samples);
+        for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            bump_counter(stats->perf[i], delta.values[i]);
+        }
+    }
+
+    // Whether the writer measures allocations; read by the metrics export
+    void set_alloc_accounting(bool enabled) { alloc_accounting_.store(enabled, std::memory_order_relaxed); }
+    bool alloc_accounting() const { return alloc_accounting_.load(std::memory_order_relaxed); }
+
+    // Frames rejected before any template decoder ran
+    void too_short() { bump_counter(too_short_); }
+    void schema_mismatch() { bump_counter(schema_mismatch_); }
+    void unknown_template() { bump_counter(unknown_template_); }
+
+    uint64_t too_short_count() const { return too_short_.load(std::memory_order_relaxed); }
+    uint64_t schema_mismatch_count() const { return schema_mismatch_.load(std::memory_order_relaxed); }
+    uint64_t unknown_template_count() const { return unknown_template_.load(std::memory_order_relaxed); }
+    // Decoded frames whose template ID is outside the dispatch table ranges
+    uint64_t untracked_count() const { return untracked_.load(std::memory_order_relaxed); }
+
+    // fn(template_id, const TemplateDecodeStats&) for every template seen
+    template <typename Fn>
+    void for_each(Fn &&fn) const {
+        for (std::size_t i = 0; i < Slots::SLOT_COUNT; ++i) {
+            if (const TemplateDecodeStats *stats = slots_[i].load(std::memory_order_acquire)) {
+                fn(Slots::template_at(i), *stats);
+            }
+        }
+    }
+
+    // Writer-side only; templates seen so far stay listed with zero counts
+    void reset() {
+        for (auto &owned : owned_) {
+            owned->reset();
+        }
+        too_short_.store(0, std::memory_order_relaxed);
+        schema_mismatch_.store(0, std::memory_order_relaxed);
+        unknown_template_.store(0, std::memory_order_relaxed);
+        untracked_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    TemplateDecodeStats *slot(uint16_t template_id) {
+        const std::size_t index = Slots::slot(template_id);
+        if (index == Slots::NO_SLOT) {
+            return nullptr;
+        }
+        TemplateDecodeStats *stats = slots_[index].load(std::memory_order_relaxed);
+        if (stats == nullptr) {
+            owned_.push_back(std::make_unique<TemplateDecodeStats>());
+            stats = owned_.back().get();
+            slots_[index].store(stats, std::memory_order_release);
+        }
+        return stats;
+    }
+
+    std::array<std::atomic<TemplateDecodeStats *>, Slots::SLOT_COUNT> slots_{};
+    std::vector<std::unique_ptr<TemplateDecodeStats>> owned_;
+    std::atomic<uint64_t> too_short_{0};
+    std::atomic<uint64_t> schema_mismatch_{0};
+    std::atomic<uint64_t> unknown_template_{0};
+    std::atomic<uint64_t> untracked_{0};
+    std::atomic<bool> alloc_accounting_{false};
+};
+
+// Prometheus families for one decoder's statistics, labelled decoder=`decoder`
+inline void write_decode_metrics(MetricsWriter &out, const DecodeStats &stats, std::string_view decoder) {
+    const double seconds_per_tick = decode_clock_ns_per_tick() * 1e-9;
+    stats.for_each([&](uint16_t template_id, const TemplateDecodeStats &entry) {
+        const std::string id = std::to_string(template_id);
+        const MetricLabels labels = {{"decoder", decoder}, {"template", id}};
+        out.sample("sbe_decoder_messages_total", MetricType::Counter, "Frames decoded per template", labels,
+                   entry.messages.load(std::memory_order_relaxed));
+        out.sample("sbe_decoder_bytes_total", MetricType::Counter, "Frame bytes decoded per template", labels,
+                   entry.bytes.load(std::memory_order_relaxed));
+        out.sample("sbe_decoder_parse_errors_total", MetricType::Counter, "Frames that failed to parse", labels,
+                   entry.parse_errors.load(std::memory_order_relaxed));
+        for (std::size_t cause = 1; cause < PARSE_ERROR_COUNT; ++cause) {
+            if (const uint64_t count = entry.parse_error_causes[cause].load(std::memory_order_relaxed); count != 0) {
+                out.sample("sbe_decoder_parse_error_causes_total", MetricType::Counter,
+                           "Frames that failed to parse, by the check they failed",
+                           {{"decoder", decoder}, {"template", id}, {"cause", PARSE_ERROR_NAMES[cause]}}, count);
+            }
+        }
+        if (stats.alloc_accounting()) {
+            out.sample("sbe_decoder_allocations_total", MetricType::Counter, "Heap allocations while decoding",
+                       labels, entry.allocations.load(std::memory_order_relaxed));
+            out.sample("sbe_decoder_alloc_bytes_total", MetricType::Counter, "Heap bytes allocated while decoding",
+                       labels, entry.alloc_bytes.load(std::memory_order_relaxed));
+            out.sample("sbe_decoder_py_allocations_total", MetricType::Counter,
+                       "Python object allocations while decoding", labels,
+                       entry.py_allocations.load(std::memory_order_relaxed));
+        }
+        if (const uint64_t samples = entry.perf_samples.load(std::memory_order_relaxed); samples != 0) {
+            out.sample("sbe_decoder_perf_samples_total", MetricType::Counter,
+                       "Frames decoded with hardware counters read around them", labels, samples);
+            for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                out.sample("sbe_decoder_perf_events_total", MetricType::Counter,
+                           "Hardware counter totals over the sampled frames",
+                           {{"decoder", decoder}, {"template", id}, {"event", PERF_EVENT_NAMES[i]}},
+                           entry.perf[i].load(std::memory_order_relaxed));
+            }
+        }
+        const LatencyHistogram::Summary latency = entry.latency.summary();
+        out.summary("sbe_decoder_decode_seconds", "Decode time per frame", labels,
+                    {{"0.5", latency.p50 * seconds_per_tick},
+                     {"0.99", latency.p99 * seconds_per_tick},
+                     {"0.999", latency.p999 * seconds_per_tick},
+                     {"1", latency.max * seconds_per_tick}},
+                    latency.sum * seconds_per_tick, latency.count);
+    });
+    const auto rejected = [&](std::string_view reason, uint64_t count) {
+        out.sample("sbe_decoder_rejected_total", MetricType::Counter, "Frames rejected before a template decoder ran",
+                   {{"decoder", decoder}, {"reason", reason}}, count);
+    };
+    rejected("too_short", stats.too_short_count());
+    rejected("schema_mismatch", stats.schema_mismatch_count());
+    rejected("unknown_template", stats.unknown_template_count());
+}
+
+#endif
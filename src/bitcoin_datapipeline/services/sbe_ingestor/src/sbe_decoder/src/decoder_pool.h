@@ -0,0 +1,587 @@
+/*
+ * Symbol-sharded parallel batch decoding.
+ *
+ * DecoderPool splits each batch by symbol across a fixed set of worker
+ * threads. Every symbol hashes to one shard, and a shard owns its columns
+ * and the order books of its symbols outright, so workers share no mutable
+ * state and each symbol's frames are decoded (and applied to its book) in
+ * submission order. A shard's books sit in a flat array indexed by the
+ * symbol's interned ID (symbol_table.h), so finding a frame's book is one
+ * probe of the symbol table and an indexed load. Each book sits in a
+ * BookSync (book_sync.h): a diff that hits a gap starts buffering that
+ * symbol's diffs on the worker, and the snapshot handed to update_book
+ * replays them.
+ *
+ * Readers never see the workers' books. After each batch a shard copies
+ * every book it changed into a spare and publishes it through an RcuCell
+ * (rcu_cell.h), so with_book() is a lock-free pointer load of a complete
+ * book as of a batch boundary and never waits for decode(). reanchor()
+ * builds a replacement book from a REST snapshot on the calling thread
+ * while the workers keep decoding; only adopting it and replaying the
+ * buffered diffs take the pool, and readers move to the rebuilt book with
+ * one pointer swap. Results are concatenated shard by shard; frame_index
+ * still refers to the caller's batch, so sorting on it restores the
+ * global order when that matters. Frame and depth-diff counts are kept in
+ * ShardedCounters, bumped once per shard and batch, and exported as
+ * Prometheus metrics. The books' bytes, working copy and published
+ * copy together, are reported per symbol to memory_stats()
+ * (memory_accounting.h).
+ *
+ * save_checkpoint() writes the published books to a book checkpoint
+ * (book_checkpoint.h), from any thread and without taking the pool, and
+ * start_checkpoints() does so periodically; restore_checkpoint() seeds the
+ * books of a restarted pool from one before its first batch.
+ *
+ * With set_rules(), each book indexes its levels on its symbol's tick from
+ * the exchangeInfo rules cache (symbol_rules.h; see PriceGrid in
+ * order_book.h). With set_order_flow_levels(), each book sums order-flow
+ * imbalance as diffs are applied (order_flow.h), and take_order_flow()
+ * hands a sampler the sums since its last call.
+ *
+ * Workers can be pinned to cores (cpu_affinity[i] for worker i) and, with
+ * numa_local, prefer their core's NUMA node for everything they allocate
+ * (page_memory.h), which keeps each shard's books, spares and columns
+ * local to the thread that writes them. Books are heap objects of many
+ * small allocations, so they get the node but not huge pages.
+ */
+
+#ifndef _SBE_DECODER_POOL_H_
+#define _SBE_DECODER_POOL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "batch_decode.h"
+#include "book_checkpoint.h"
+#include "book_sync.h"
+#include "native_metrics.h"
+#include "ingest_clock.h"
+#include "memory_accounting.h"
+#include "order_book.h"
+#include "page_memory.h"
+#include "rcu_cell.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+#include "symbol_rules.h"
+#include "symbol_table.h"
+
+class DecoderPool {
+public:
+    // Worker i is pinned to cpu_affinity[i] when given and non-negative
+    DecoderPool(std::size_t workers, bool raw_mantissa, std::vector<int> cpu_affinity = {}, bool numa_local = false)
+        : raw_mantissa_(raw_mantissa), cpu_affinity_(std::move(cpu_affinity)), numa_local_(numa_local),
+          directory_(std::make_unique<std::atomic<const RcuCell<OrderBook> *>[]>(SymbolTable::MAX_SYMBOLS)) {
+        if (workers == 0) {
+            workers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        shards_.resize(workers);
+        threads_.reserve(workers);
+        for (std::size_t i = 0; i < workers; ++i) {
+            threads_.emplace_back([this, i] { worker(i); });
+        }
+        metrics_.publish([this](MetricsWriter &out) { write_metrics(out); });
+        memory_.publish([this](MemoryReport &out) { report_memory(out); });
+    }
+
+    ~DecoderPool() {
+        stop_checkpoints();
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        work_ready_.notify_all();
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    DecoderPool(const DecoderPool &) = delete;
+    DecoderPool &operator=(const DecoderPool &) = delete;
+
+    std::size_t workers() const { return shards_.size(); }
+
+    // First error pinning a worker or placing its memory; empty if none
+    std::string placement_error() const {
+        std::lock_guard lock(mutex_);
+        return placement_error_;
+    }
+
+    std::size_t shard_of(std::string_view symbol) const { return SymbolHash{}(symbol) % shards_.size(); }
+
+    // Decode `frames` across the shards and concatenate their columns into
+    // `out`. Frames whose symbol cannot be read (short, unknown template,
+    // malformed) go to shard 0, which reports them as usual. Depth diffs
+    // are applied to the owning shard's book for that symbol; symbols whose
+    // diff hit a sequence gap are listed in `gaps` (once per resync; the
+    // diffs after it are buffered). Partial depth frames seed new books and
+    // resync gapped ones.
+    void decode(std::span<const std::span<char>> frames, BatchColumns &out, uint64_t ingest_ts_us,
+                std::vector<std::string> &gaps) {
+        std::lock_guard busy(busy_);
+
+        for (auto &shard : shards_) {
+            shard.frames.clear();
+            shard.out = BatchColumns{};
+            shard.out.raw_mantissa = raw_mantissa_;
+            shard.gaps.clear();
+        }
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            shards_[route(frames[i])].frames.push_back(static_cast<uint32_t>(i));
+        }
+
+        // Run every shard and wait for all of them
+        {
+            std::unique_lock lock(mutex_);
+            frames_ = frames;
+            pending_ = shards_.size();
+            ++generation_;
+        }
+        work_ready_.notify_all();
+        {
+            std::unique_lock lock(mutex_);
+            work_done_.wait(lock, [this] { return pending_ == 0; });
+        }
+
+        out.raw_mantissa = raw_mantissa_;
+        out.ingest_ts_us = ingest_ts_us != 0 ? ingest_ts_us : ingest_time_us();
+        out.ingest_ts = micros_to_millis(out.ingest_ts_us);
+        for (auto &shard : shards_) {
+            append_batch(out, shard.out);
+            gaps.insert(gaps.end(), shard.gaps.begin(), shard.gaps.end());
+        }
+    }
+
+    // Run `fn` on the published book for `symbol` (nullptr if it has none
+    // yet), as of the last batch or snapshot. Lock-free; safe from any
+    // thread while decode() runs.
+    template <typename Fn>
+    auto with_book(std::string_view symbol, Fn &&fn) const {
+        EpochGuard guard(book_epochs());
+        const SymbolId id = symbol_table().find(symbol);
+        const RcuCell<OrderBook> *cell =
+            id < SymbolTable::MAX_SYMBOLS ? directory_[id].load(std::memory_order_acquire) : nullptr;
+        return fn(cell != nullptr ? cell->load() : nullptr);
+    }
+
+    // Run `fn` on the BookSync for `symbol`, created empty if needed, to
+    // seed or resync it from a snapshot. Throws std::runtime_error once the
+    // symbol table is full.
+    template <typename Fn>
+    auto update_book(std::string_view symbol, Fn &&fn) {
+        std::lock_guard busy(busy_);
+        SymbolBook *entry = book_for(shards_[shard_of(symbol)], symbol_table().intern(symbol));
+        if (entry == nullptr) {
+            throw std::runtime_error("Symbol table is full");
+        }
+        // Published even if fn throws: a failed load may have cleared the book
+        struct Publish {
+            SymbolBook &entry;
+            ~Publish() { entry.publish(); }
+        } publish{*entry};
+        return fn(entry->sync);
+    }
+
+    // Re-anchor `symbol` from a REST DepthResponse frame (header included).
+    // The snapshot is loaded into a new book here, outside the pool, so the
+    // workers keep decoding meanwhile; then it replaces the live book and
+    // the diffs buffered since the gap are replayed onto it. Throws
+    // std::runtime_error for a bad frame, leaving the live book as it was.
+    SyncResult reanchor(std::string_view symbol, std::span<char> payload) {
+        OrderBook staged{std::string(symbol)};
+        load_depth_response(staged, payload);
+        return reanchor(symbol, std::move(staged));
+    }
+
+    // reanchor() with a book already loaded from a snapshot in another
+    // form, such as REST JSON (depth_json.h)
+    SyncResult reanchor(std::string_view symbol, OrderBook &&staged) {
+        return update_book(symbol, [&](BookSync &sync) { return sync.adopt(std::move(staged)); });
+    }
+
+    // Write every published, in-sync book to a checkpoint at `path`;
+    // returns the books written. Lock-free like with_book(), so decode()
+    // keeps running. Throws std::runtime_error on I/O errors.
+    std::size_t save_checkpoint(const std::string &path) const {
+        EpochGuard guard(book_epochs());
+        std::vector<const OrderBook *> books;
+        const std::size_t count = std::min(symbol_table().size(), SymbolTable::MAX_SYMBOLS);
+        for (std::size_t id = 0; id < count; ++id) {
+            const RcuCell<OrderBook> *cell = directory_[id].load(std::memory_order_acquire);
+            if (cell != nullptr) {
+                books.push_back(cell->load());
+            }
+        }
+        return write_book_checkpoint(path, books, ingest_time_us());
+    }
+
+    // Seed books from the checkpoint at `path`, typically at startup: each
+    // resumes from its checkpointed update ID, and a first diff that does
+    // not continue it is a gap resynced from a snapshot as usual. A book
+    // already newer than its checkpoint is left alone (Ignored). With
+    // `symbols`, only their books are restored, e.g. the symbols a node has
+    // just taken over from another node's checkpoint. Throws
+    // std::runtime_error for a missing or invalid file.
+    std::vector<std::pair<std::string, SyncResult>> restore_checkpoint(const std::string &path,
+                                                                       std::span<const std::string> symbols = {}) {
+        const BookCheckpoint checkpoint(path);
+        std::vector<std::pair<std::string, SyncResult>> results;
+        for (std::size_t i = 0; i < checkpoint.size(); ++i) {
+            OrderBook staged = checkpoint.book(i);
+            const std::string symbol = staged.symbol();
+            if (!symbols.empty() && std::find(symbols.begin(), symbols.end(), symbol) == symbols.end()) {
+                continue;
+            }
+            const SyncResult result = update_book(symbol, [&](BookSync &sync) {
+                if (sync.book().last_update_id() >= staged.last_update_id()) {
+                    return SyncResult::Ignored;
+                }
+                return sync.adopt(std::move(staged));
+            });
+            results.emplace_back(symbol, result);
+        }
+        return results;
+    }
+
+    // Save a checkpoint to `path` every interval_ms in the background, and
+    // once more when stopped. Replaces a running schedule.
+    void start_checkpoints(const std::string &path, int interval_ms) {
+        stop_checkpoints();
+        checkpointer_ = std::make_unique<BookCheckpointer>([this, path] { save_checkpoint(path); }, interval_ms);
+        checkpointer_->start();
+    }
+
+    void stop_checkpoints() {
+        if (checkpointer_) {
+            checkpointer_->stop();
+            checkpointer_.reset();
+        }
+    }
+
+    // Put every book, existing or created later, on its symbol's tick from
+    // `rules`, which must outlive the pool (nullptr: later books get none).
+    // Call again after a refresh to pick up changed ticks.
+    void set_rules(const SymbolRulesTable *rules) {
+        std::lock_guard busy(busy_);
+        rules_ = rules;
+        for (auto &shard : shards_) {
+            for (SymbolId id = 0; id < shard.books.size(); ++id) {
+                if (shard.books[id]) {
+                    apply_rules(*shard.books[id], id);
+                    shard.books[id]->publish();
+                }
+            }
+        }
+    }
+
+    // Sum order-flow imbalance to `levels` from the touch on every book,
+    // existing or created later (order_flow.h); 0 stops
+    void set_order_flow_levels(std::size_t levels) {
+        std::lock_guard busy(busy_);
+        order_flow_levels_ = levels;
+        for (auto &shard : shards_) {
+            for (auto &book : shard.books) {
+                if (book) {
+                    book->sync.book().track_order_flow(levels);
+                }
+            }
+        }
+    }
+
+    // Read and reset the order-flow sums of `symbol`'s working book, e.g.
+    // once per sampling interval; nullopt if it has no book. Waits for the
+    // batch being decoded. Published books keep the sums as of their batch.
+    std::optional<OrderFlowTotals> take_order_flow(std::string_view symbol) {
+        std::lock_guard busy(busy_);
+        const SymbolId id = symbol_table().find(symbol);
+        const Shard &shard = shards_[shard_of(symbol)];
+        if (id == INVALID_SYMBOL_ID || id >= shard.books.size() || !shard.books[id]) {
+            return std::nullopt;
+        }
+        return shard.books[id]->sync.book().take_order_flow();
+    }
+
+    std::vector<std::string> symbols() {
+        std::lock_guard busy(busy_);
+        std::vector<std::string> result;
+        for (const auto &shard : shards_) {
+            for (const auto &book : shard.books) {
+                if (book) {
+                    result.push_back(book->sync.book().symbol());
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    // A symbol's working book and the copy readers see
+    struct SymbolBook {
+        explicit SymbolBook(std::string symbol) : sync(std::move(symbol)) {}
+
+        BookSync sync;
+        RcuCell<OrderBook> published{book_epochs()};
+        bool changed = false;
+
+        // Copy the working book into a spare no reader holds and swap it in
+        void publish() {
+            std::unique_ptr<OrderBook> next = published.recycle();
+            if (next) {
+                *next = sync.book();
+            } else {
+                next = std::make_unique<OrderBook>(sync.book());
+            }
+            published.publish(std::move(next));
+            changed = false;
+        }
+    };
+
+    struct Shard {
+        std::vector<uint32_t> frames;
+        BatchColumns out;
+        // Indexed by SymbolId; null for symbols this shard has no book for
+        std::vector<std::unique_ptr<SymbolBook>> books;
+        // Books changed by the current batch
+        std::vector<SymbolBook *> changed;
+        std::vector<std::string> gaps;
+    };
+
+    // The book for `id` in `shard`, created empty (and registered for
+    // readers) on first use; nullptr for INVALID_SYMBOL_ID (symbol table full)
+    SymbolBook *book_for(Shard &shard, SymbolId id) {
+        if (id == INVALID_SYMBOL_ID) {
+            return nullptr;
+        }
+        if (id >= shard.books.size()) {
+            shard.books.resize(id + 1);
+        }
+        if (!shard.books[id]) {
+            shard.books[id] = std::make_unique<SymbolBook>(std::string(symbol_table().name_of(id)));
+            apply_rules(*shard.books[id], id);
+            shard.books[id]->sync.book().track_order_flow(order_flow_levels_);
+            directory_[id].store(&shard.books[id]->published, std::memory_order_release);
+        }
+        return shard.books[id].get();
+    }
+
+    void apply_rules(SymbolBook &entry, SymbolId id) const {
+        const SymbolRules *rules = rules_ != nullptr ? rules_->rules(id) : nullptr;
+        if (rules != nullptr && rules->listed) {
+            entry.sync.book().set_tick(rules->tick_size, rules->price_exponent);
+        }
+    }
+
+    // Remember that the batch changed `entry`'s book
+    static void touch(Shard &shard, SymbolBook &entry) {
+        if (!entry.changed) {
+            entry.changed = true;
+            shard.changed.push_back(&entry);
+        }
+    }
+
+    std::size_t route(std::span<char> frame) const {
+        using spot_sbe::MessageHeader;
+        if (shards_.size() == 1 || frame.size() < MessageHeader::encodedLength()) {
+            return 0;
+        }
+        MessageHeader header{frame.data(), frame.size()};
+        std::string_view symbol;
+        if (stream_frame_symbol(header.templateId(), frame.data() + MessageHeader::encodedLength(),
+                                frame.size() - MessageHeader::encodedLength(), header.blockLength(),
+                                symbol) != ParseError::None) [[unlikely]] {
+            return 0;
+        }
+        return symbol.empty() ? 0 : shard_of(symbol);
+    }
+
+    void worker(std::size_t index) {
+        place_worker(index);
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock lock(mutex_);
+                work_ready_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+                if (stopping_) {
+                    return;
+                }
+                seen = generation_;
+            }
+            run_shard(shards_[index]);
+            {
+                std::lock_guard lock(mutex_);
+                --pending_;
+            }
+            work_done_.notify_one();
+        }
+    }
+
+    // Pin worker `index` and prefer its core's node; failures only leave
+    // the worker unplaced, so they are recorded rather than thrown
+    void place_worker(std::size_t index) {
+        const int cpu = index < cpu_affinity_.size() ? cpu_affinity_[index] : -1;
+        if (cpu < 0) {
+            return;
+        }
+        std::string error = pin_current_thread(cpu);
+        if (error.empty() && numa_local_) {
+            error = prefer_numa_node(cpu_numa_node(cpu));
+        }
+        if (!error.empty()) {
+            std::lock_guard lock(mutex_);
+            if (placement_error_.empty()) {
+                placement_error_ = std::move(error);
+            }
+        }
+    }
+
+    void run_shard(Shard &shard) {
+        using spot_sbe::MessageHeader;
+        uint64_t applied = 0, stale = 0, gaps = 0, buffered = 0, resynced = 0;
+        for (const uint32_t i : shard.frames) {
+            const auto frame = frames_[i];
+            decode_frame(frame, static_cast<int64_t>(i), shard.out);
+            if (frame.size() < MessageHeader::encodedLength()) {
+                continue;
+            }
+            MessageHeader header{frame.data(), frame.size()};
+            const char *body = frame.data() + MessageHeader::encodedLength();
+            if (header.templateId() == DEPTH_SNAPSHOT_STREAM_EVENT) {
+                // Partial depth re-seeds books that are new or behind a gap
+                DepthSnapshotFrame snapshot;
+                if (parse_depth_snapshot_frame(body, frame.size() - MessageHeader::encodedLength(),
+                                               header.blockLength(), snapshot) != ParseError::None) [[unlikely]] {
+                    continue;
+                }
+                SymbolBook *entry = book_for(shard, symbol_table().intern(snapshot.symbol));
+                if (entry != nullptr && entry->sync.apply_partial_depth(body, snapshot) == SyncResult::Synced) {
+                    ++resynced;
+                    touch(shard, *entry);
+                }
+                continue;
+            }
+            if (header.templateId() != DEPTH_DIFF_STREAM_EVENT) {
+                continue;
+            }
+            DepthDiffFrame diff;
+            if (parse_depth_diff_frame(body, frame.size() - MessageHeader::encodedLength(), header.blockLength(),
+                                       diff) != ParseError::None) [[unlikely]] {
+                continue; // already reported by decode_frame
+            }
+            SymbolBook *entry = book_for(shard, symbol_table().intern(diff.symbol));
+            if (entry == nullptr) {
+                continue;
+            }
+            switch (entry->sync.apply_diff(body, diff)) {
+            case ApplyStatus::Applied:
+                ++applied;
+                touch(shard, *entry);
+                break;
+            case ApplyStatus::Stale:
+                ++stale;
+                break;
+            case ApplyStatus::Gap:
+                ++gaps;
+                shard.gaps.push_back(entry->sync.book().symbol());
+                break;
+            case ApplyStatus::Buffered:
+                ++buffered;
+                break;
+            }
+        }
+        for (SymbolBook *entry : shard.changed) {
+            entry->publish();
+        }
+        shard.changed.clear();
+        frames_decoded_.add(shard.frames.size());
+        diffs_applied_.add(applied);
+        diffs_stale_.add(stale);
+        diffs_gap_.add(gaps);
+        diffs_buffered_.add(buffered);
+        partial_resyncs_.add(resynced);
+    }
+
+    // Prometheus families; runs on the scrape thread
+    void write_metrics(MetricsWriter &out) const {
+        const std::string_view pool = metrics_.instance();
+        out.sample("sbe_pool_frames_total", MetricType::Counter, "Frames decoded by the pool's workers",
+                   {{"pool", pool}}, frames_decoded_.value());
+        const auto diffs = [&](std::string_view status, const ShardedCounter &counter) {
+            out.sample("sbe_pool_depth_diffs_total", MetricType::Counter, "Depth diffs applied to the pool's books",
+                       {{"pool", pool}, {"status", status}}, counter.value());
+        };
+        diffs("applied", diffs_applied_);
+        diffs("stale", diffs_stale_);
+        diffs("gap", diffs_gap_);
+        diffs("buffered", diffs_buffered_);
+        out.sample("sbe_pool_partial_depth_resyncs_total", MetricType::Counter,
+                   "Books seeded or resynced from partial depth frames", {{"pool", pool}}, partial_resyncs_.value());
+    }
+
+    // Books per symbol: the working book and the copy readers see. Waits
+    // for the batch being decoded; only this pool republishes the copies,
+    // under busy_, so they stay put while it is held.
+    void report_memory(MemoryReport &out) {
+        std::lock_guard busy(busy_);
+        for (const auto &shard : shards_) {
+            for (const auto &book : shard.books) {
+                if (!book) {
+                    continue;
+                }
+                const std::string &symbol = book->sync.book().symbol();
+                MemoryUsage usage = book->sync.book().memory_usage();
+                if (const OrderBook *published = book->published.load()) {
+                    usage += published->memory_usage();
+                }
+                out.add("book", symbol, usage);
+                out.add("book_sync", symbol, book->sync.buffer_memory_usage());
+            }
+        }
+    }
+
+    const bool raw_mantissa_;
+    const std::vector<int> cpu_affinity_;
+    const bool numa_local_;
+    std::vector<Shard> shards_;
+    std::vector<std::thread> threads_;
+
+    // Serializes decode() against book updates from other threads
+    std::mutex busy_;
+    // Tick source for books; set and read under busy_
+    const SymbolRulesTable *rules_ = nullptr;
+    // OFI depth for books; set and read under busy_
+    std::size_t order_flow_levels_ = 0;
+    // SymbolId -> the published book of whichever shard owns the symbol
+    std::unique_ptr<std::atomic<const RcuCell<OrderBook> *>[]> directory_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    std::span<const std::span<char>> frames_;
+    std::size_t pending_ = 0;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+    std::string placement_error_;
+
+    ShardedCounter frames_decoded_;
+    ShardedCounter diffs_applied_;
+    ShardedCounter diffs_stale_;
+    ShardedCounter diffs_gap_;
+    ShardedCounter diffs_buffered_;
+    ShardedCounter partial_resyncs_;
+    std::unique_ptr<BookCheckpointer> checkpointer_;
+    MetricsRegistration metrics_;
+    MemoryRegistration memory_;
+};
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * Probabilistic sliding-window deduplication of (symbol_id, record id)
+ * keys, for windows too long for DedupWindow's exact table.
+ *
+ * DedupWindow (dedup_window.h) stores every key in a 16-byte slot, so a
+ * day of trade IDs across the backfilled symbols runs to hundreds of MB.
+ * DedupFilter keeps the same time-bucketed expiry: the window is split
+ * into BUCKETS - 1 buckets, each with its own generation, and the oldest
+ * generation is reused when time enters a new bucket. Each generation is
+ * a blocked Bloom filter instead of a table: a key's k bits all land in
+ * one 64-byte block, so a lookup touches one cache line per generation.
+ *
+ * The filter is sized once, from the keys expected per window and the
+ * target false-positive rate: each generation gets capacity / (BUCKETS - 1)
+ * keys at fp_rate / BUCKETS, so the union over the generations a check
+ * reads stays within fp_rate. Sizing uses the blocked filter's own rate
+ * (blocked_fp_rate), not the classic formula, which is optimistic for
+ * 512-bit blocks. At 1% that is about 2 bytes per key, i.e. a day of 2M
+ * trade IDs in about 4 MB. Memory never grows; more keys than planned
+ * raise the false-positive rate instead, which estimated_fp_rate()
+ * follows from the keys each generation holds.
+ *
+ * A false positive reports a new key as a duplicate, so a caller drops a
+ * record it should have kept. Use this where a small, bounded loss is
+ * acceptable (reconciliation against a source that can be re-read);
+ * duplicates themselves are never missed while their bucket is live.
+ * Keys cannot be removed one symbol at a time.
+ *
+ * The generations' blocks share one PageMemory (page_memory.h), so a
+ * filter of many MB can be backed by huge pages: a check reads one block
+ * per generation at random, which on 4 KB pages is mostly TLB misses.
+ *
+ * Not thread-safe; the binding uses it with the GIL held. Its blocks are
+ * reported to memory_stats() whole and under no symbol: bits are shared
+ * by every key, so no symbol owns any of them.
+ */
+
+#ifndef _SBE_DEDUP_FILTER_H_
+#define _SBE_DEDUP_FILTER_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+
+#include "memory_accounting.h"
+#include "page_memory.h"
+#include "symbol_table.h"
+
+class DedupFilter {
+public:
+    static constexpr std::size_t BUCKETS = 8;
+    static constexpr std::size_t BLOCK_BITS = 512;
+
+    struct Stats {
+        uint64_t checks = 0;
+        uint64_t duplicates = 0;
+        uint64_t unique = 0;
+    };
+
+    // Remember `capacity` keys per window at about `fp_rate` false positives
+    DedupFilter(uint64_t window_us, uint64_t capacity, double fp_rate, const MemoryPlacement &placement = {})
+        : bucket_us_(window_us / (BUCKETS - 1)), fp_rate_(fp_rate) {
+        if (bucket_us_ == 0) {
+            throw std::runtime_error("DedupFilter: window too short");
+        }
+        if (capacity == 0) {
+            throw std::runtime_error("DedupFilter: capacity must be positive");
+        }
+        if (!(fp_rate > 0 && fp_rate < 1)) {
+            throw std::runtime_error("DedupFilter: fp_rate must be in (0, 1)");
+        }
+        // The fewest bits per key (and the best k for them) that meet the
+        // per-generation rate
+        const double generation_rate = fp_rate / BUCKETS;
+        const double keys = std::ceil(static_cast<double>(capacity) / (BUCKETS - 1));
+        double bits_per_key = 2.0;
+        for (;; bits_per_key += 0.25) {
+            hashes_ = best_hashes(BLOCK_BITS / bits_per_key);
+            if (blocked_fp_rate(BLOCK_BITS / bits_per_key, hashes_) <= generation_rate || bits_per_key >= 64) {
+                break;
+            }
+        }
+        blocks_ = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(keys * bits_per_key / BLOCK_BITS)));
+        memory_ = PageMemory(BUCKETS * blocks_ * sizeof(Block), placement);
+        auto *blocks = static_cast<Block *>(memory_.data());
+        std::uninitialized_value_construct_n(blocks, BUCKETS * blocks_);
+        for (std::size_t i = 0; i < BUCKETS; ++i) {
+            generations_[i].blocks = std::span<Block>(blocks + i * blocks_, blocks_);
+        }
+        memory_registration_.publish([this](MemoryReport &out) {
+            out.add("dedup_filter", "", MemoryUsage{memory_bytes(), memory_.size()});
+        });
+    }
+
+    // True the first time (symbol, id) is seen within the window as of
+    // `now_us` (or a false positive made it look seen), false for a
+    // duplicate. `now_us` should not go backwards; if it does, the latest
+    // bucket keeps being used.
+    bool check(SymbolId symbol, uint64_t id, uint64_t now_us) {
+        advance(now_us / bucket_us_);
+        ++stats_.checks;
+        const uint64_t hash = hash_of(symbol, id);
+        const std::size_t block = block_of(hash);
+        for (std::size_t age = 0; age < BUCKETS; ++age) {
+            if (age > epoch_) {
+                break;
+            }
+            if (generation_at(epoch_ - age).contains(block, hash, hashes_)) {
+                ++stats_.duplicates;
+                return false;
+            }
+        }
+        generation_at(epoch_).insert(block, hash, hashes_);
+        ++stats_.unique;
+        return true;
+    }
+
+    // Keys inserted into the live generations (some may be past their
+    // window by up to a bucket)
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (const auto &generation : generations_) {
+            total += generation.keys;
+        }
+        return total;
+    }
+
+    std::size_t memory_bytes() const { return BUCKETS * blocks_ * sizeof(Block); }
+
+    // Chance that a new key reads as seen right now, from the keys in each
+    // live generation: 1 - prod(1 - fp_g)
+    double estimated_fp_rate() const {
+        double miss = 1.0;
+        for (const auto &generation : generations_) {
+            const double keys_per_block = static_cast<double>(generation.keys) / static_cast<double>(blocks_);
+            miss *= 1.0 - blocked_fp_rate(keys_per_block, hashes_);
+        }
+        return 1.0 - miss;
+    }
+
+    // False-positive rate of a blocked filter holding `keys_per_block` keys
+    // per block on average. Keys land in blocks as a Poisson process, and
+    // the crowded blocks dominate, so this sits well above the classic
+    // (1 - e^(-kn/m))^k for the same bits per key.
+    static double blocked_fp_rate(double keys_per_block, uint32_t hashes) {
+        if (keys_per_block <= 0) {
+            return 0.0;
+        }
+        const double empty_per_insert = 1.0 - 1.0 / static_cast<double>(BLOCK_BITS);
+        // Poisson terms within ~10 standard deviations of the mean
+        const double spread = 10.0 * std::sqrt(keys_per_block) + 16.0;
+        const auto first = static_cast<uint64_t>(std::max(0.0, keys_per_block - spread));
+        const auto last = static_cast<uint64_t>(keys_per_block + spread);
+        double total = 0.0;
+        for (uint64_t x = first; x <= last; ++x) {
+            const double n = static_cast<double>(x);
+            const double weight = std::exp(n * std::log(keys_per_block) - keys_per_block - std::lgamma(n + 1.0));
+            const double fill = 1.0 - std::pow(empty_per_insert, static_cast<double>(hashes) * n);
+            total += weight * std::pow(fill, static_cast<double>(hashes));
+        }
+        return std::min(total, 1.0);
+    }
+
+    double target_fp_rate() const { return fp_rate_; }
+    uint32_t hashes() const { return hashes_; }
+    uint64_t window_us() const { return bucket_us_ * (BUCKETS - 1); }
+    const Stats &stats() const { return stats_; }
+    const PageMemory &memory() const { return memory_; }
+
+    // Forget every key; clears every generation's bits
+    void clear() {
+        for (auto &generation : generations_) {
+            generation.reset();
+        }
+    }
+
+private:
+    static constexpr uint32_t MAX_HASHES = 16;
+
+    struct alignas(64) Block {
+        std::array<uint64_t, BLOCK_BITS / 64> words{};
+    };
+    static_assert(sizeof(Block) == 64);
+
+    struct Generation {
+        std::span<Block> blocks;
+        std::size_t keys = 0;
+
+        bool contains(std::size_t block, uint64_t hash, uint32_t hashes) const {
+            const Block &b = blocks[block];
+            for (uint32_t i = 0; i < hashes; ++i) {
+                const uint32_t bit = bit_of(hash, i);
+                if ((b.words[bit / 64] & (uint64_t{1} << (bit % 64))) == 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void insert(std::size_t block, uint64_t hash, uint32_t hashes) {
+            Block &b = blocks[block];
+            for (uint32_t i = 0; i < hashes; ++i) {
+                const uint32_t bit = bit_of(hash, i);
+                b.words[bit / 64] |= uint64_t{1} << (bit % 64);
+            }
+            ++keys;
+        }
+
+        void reset() {
+            std::fill(blocks.begin(), blocks.end(), Block{});
+            keys = 0;
+        }
+    };
+
+    static uint32_t best_hashes(double keys_per_block) {
+        uint32_t best = 1;
+        for (uint32_t k = 2; k <= MAX_HASHES; ++k) {
+            if (blocked_fp_rate(keys_per_block, k) < blocked_fp_rate(keys_per_block, best)) {
+                best = k;
+            }
+        }
+        return best;
+    }
+
+    // Odd multipliers of split block Bloom filters (Parquet's SBBF salts)
+    static constexpr std::array<uint32_t, 8> SALTS = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                      0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+    // Bit i of a key within its block: the top 9 bits of one half of the
+    // hash times a salt. Bit positions stepping through the block as
+    // h1 + i * h2 overlap between keys far more often in 512 bits, which
+    // roughly doubles the false positives.
+    static uint32_t bit_of(uint64_t hash, uint32_t i) {
+        const auto half = static_cast<uint32_t>(i < SALTS.size() ? hash : hash >> 32);
+        return (half * SALTS[i % SALTS.size()]) >> (32 - std::countr_zero(BLOCK_BITS));
+    }
+
+    // splitmix64 finalizer over the packed key, as DedupWindow
+    static uint64_t hash_of(SymbolId symbol, uint64_t id) {
+        uint64_t x = id ^ (static_cast<uint64_t>(symbol) << 48) ^ 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // The block from a second mix of the hash, scaled into range without
+    // a division
+    std::size_t block_of(uint64_t hash) const {
+        uint64_t mixed = hash + 0x9e3779b97f4a7c15ULL;
+        mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebULL;
+        mixed ^= mixed >> 31;
+        return static_cast<std::size_t>((static_cast<unsigned __int128>(mixed) * blocks_) >> 64);
+    }
+
+    Generation &generation_at(uint64_t epoch) { return generations_[epoch % BUCKETS]; }
+
+    // Move to bucket `epoch`, clearing the generations of the buckets that
+    // leave the window (all of them after a pause of BUCKETS or more)
+    void advance(uint64_t epoch) {
+        if (started_ && epoch <= epoch_) {
+            return;
+        }
+        const uint64_t oldest_kept = epoch >= BUCKETS ? epoch - BUCKETS + 1 : 0;
+        const uint64_t first = started_ ? std::max(epoch_ + 1, oldest_kept) : epoch;
+        for (uint64_t e = first; e <= epoch; ++e) {
+            generation_at(e).reset();
+        }
+        epoch_ = epoch;
+        started_ = true;
+    }
+
+    uint64_t bucket_us_;
+    double fp_rate_;
+    uint32_t hashes_ = 1;
+    std::size_t blocks_ = 1;
+    uint64_t epoch_ = 0;
+    bool started_ = false;
+    // Every generation's blocks, BUCKETS runs of blocks_
+    PageMemory memory_;
+    std::array<Generation, BUCKETS> generations_;
+    Stats stats_;
+    MemoryRegistration memory_registration_;
+};
+
+#endif
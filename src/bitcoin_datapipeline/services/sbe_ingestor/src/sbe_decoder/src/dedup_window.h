@@ -0,0 +1,245 @@
+/*
+ * Sliding-window deduplication of (symbol_id, record id) keys.
+ *
+ * The Python RecordDeduplicator keeps a dict of string IDs per symbol plus
+ * an insertion-order deque, and rebuilds both in a periodic sweep. Here the
+ * key is the interned symbol ID (symbol_table.h) and the numeric trade or
+ * update ID, stored in 16-byte open-addressed slots.
+ *
+ * Expiry is time-bucketed: the window is split into BUCKETS - 1 buckets,
+ * and each bucket's keys go into their own generation table. When time
+ * moves into a new bucket, the oldest generation is reused by bumping its
+ * stamp. A slot whose stamp is not its generation's current stamp counts
+ * as empty, so expiring a whole bucket is O(1) and nothing ever sweeps the
+ * table. A key is remembered for at least the window and at most one
+ * bucket longer.
+ *
+ * Not thread-safe; the binding uses it with the GIL held, and memory_stats()
+ * reads it with the GIL held too (memory_accounting.h).
+ */
+
+#ifndef _SBE_DEDUP_WINDOW_H_
+#define _SBE_DEDUP_WINDOW_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "memory_accounting.h"
+#include "symbol_table.h"
+
+class DedupWindow {
+public:
+    static constexpr std::size_t BUCKETS = 8;
+
+    struct Stats {
+        uint64_t checks = 0;
+        uint64_t duplicates = 0;
+        uint64_t unique = 0;
+    };
+
+    explicit DedupWindow(uint64_t window_us) : bucket_us_(window_us / (BUCKETS - 1)) {
+        if (bucket_us_ == 0) {
+            throw std::runtime_error("DedupWindow: window too short");
+        }
+        for (auto &generation : generations_) {
+            generation.stamp = next_stamp_++;
+            generation.slots.resize(INITIAL_CAPACITY);
+        }
+        memory_.publish([this](MemoryReport &out) { report_memory(out); });
+    }
+
+    // True the first time (symbol, id) is seen within the window as of
+    // `now_us`, false for a duplicate. `now_us` should not go backwards;
+    // if it does, the latest bucket keeps being used.
+    bool check(SymbolId symbol, uint64_t id, uint64_t now_us) {
+        advance(now_us / bucket_us_);
+        ++stats_.checks;
+        const uint64_t hash = hash_of(symbol, id);
+        for (std::size_t age = 0; age < BUCKETS; ++age) {
+            if (age > epoch_) {
+                break;
+            }
+            if (generation_at(epoch_ - age).contains(symbol, id, hash)) {
+                ++stats_.duplicates;
+                return false;
+            }
+        }
+        generation_at(epoch_).insert(symbol, id, hash);
+        ++stats_.unique;
+        return true;
+    }
+
+    // Keys currently remembered (some may be past their window by up to a
+    // bucket)
+    std::size_t size() const {
+        std::size_t total = 0;
+        for (const auto &generation : generations_) {
+            total += generation.size;
+        }
+        return total;
+    }
+
+    std::size_t memory_bytes() const {
+        std::size_t total = 0;
+        for (const auto &generation : generations_) {
+            total += generation.slots.capacity() * sizeof(Slot);
+        }
+        return total;
+    }
+
+    // Each symbol's remembered keys, and the free slots under no symbol.
+    // Scans every slot, like clear_symbol().
+    void report_memory(MemoryReport &out) const {
+        std::vector<uint64_t> keys;
+        std::size_t slots = 0;
+        for (const auto &generation : generations_) {
+            slots += generation.slots.capacity();
+            for (const Slot &slot : generation.slots) {
+                if (slot.stamp == generation.stamp) {
+                    keys.resize(std::max<std::size_t>(keys.size(), slot.symbol + 1));
+                    ++keys[slot.symbol];
+                }
+            }
+        }
+        const std::size_t interned = symbol_table().size();
+        std::size_t live = 0;
+        for (std::size_t id = 0; id < keys.size(); ++id) {
+            if (keys[id] > 0) {
+                const std::string_view symbol =
+                    id < interned ? symbol_table().name_of(static_cast<SymbolId>(id)) : std::string_view{};
+                out.add("dedup_window", symbol, memory_of<Slot>(keys[id], keys[id]));
+                live += keys[id];
+            }
+        }
+        out.add("dedup_window", "", MemoryUsage{0, (slots - live) * sizeof(Slot)});
+    }
+
+    uint64_t window_us() const { return bucket_us_ * (BUCKETS - 1); }
+    const Stats &stats() const { return stats_; }
+
+    // Forget every key, in O(BUCKETS)
+    void clear() {
+        for (auto &generation : generations_) {
+            generation.reset(next_stamp_++);
+        }
+    }
+
+    // Forget one symbol's keys. Scans every live slot; meant for rare
+    // administrative use, not the hot path.
+    void clear_symbol(SymbolId symbol) {
+        for (auto &generation : generations_) {
+            generation.rebuild(generation.slots.size(), next_stamp_++, symbol);
+        }
+    }
+
+private:
+    static constexpr std::size_t INITIAL_CAPACITY = 1024;
+
+    struct Slot {
+        uint64_t id = 0;
+        // Generation stamp at insertion; 0 is never a live stamp
+        uint32_t stamp = 0;
+        SymbolId symbol = 0;
+        uint16_t reserved = 0;
+    };
+    static_assert(sizeof(Slot) == 16);
+
+    struct Generation {
+        std::vector<Slot> slots;
+        uint32_t stamp = 0;
+        std::size_t size = 0;
+
+        bool contains(SymbolId symbol, uint64_t id, uint64_t hash) const {
+            const std::size_t mask = slots.size() - 1;
+            for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+                const Slot &slot = slots[i];
+                if (slot.stamp != stamp) {
+                    return false;
+                }
+                if (slot.id == id && slot.symbol == symbol) {
+                    return true;
+                }
+            }
+        }
+
+        // Callers check contains() first, so the key is new
+        void insert(SymbolId symbol, uint64_t id, uint64_t hash) {
+            // Keep the load factor under 3/4
+            if ((size + 1) * 4 > slots.size() * 3) {
+                rebuild(slots.size() * 2, stamp, INVALID_SYMBOL_ID);
+            }
+            place(Slot{id, stamp, symbol, 0}, hash);
+            ++size;
+        }
+
+        void reset(uint32_t next) {
+            stamp = next;
+            size = 0;
+        }
+
+        // Re-place the live slots into `capacity` slots under stamp `next`,
+        // dropping `drop`'s keys
+        void rebuild(std::size_t capacity, uint32_t next, SymbolId drop) {
+            std::vector<Slot> old(capacity);
+            old.swap(slots);
+            const uint32_t live = stamp;
+            stamp = next;
+            size = 0;
+            for (Slot &slot : old) {
+                if (slot.stamp == live && slot.symbol != drop) {
+                    slot.stamp = stamp;
+                    place(slot, hash_of(slot.symbol, slot.id));
+                    ++size;
+                }
+            }
+        }
+
+        void place(const Slot &entry, uint64_t hash) {
+            const std::size_t mask = slots.size() - 1;
+            std::size_t i = hash & mask;
+            while (slots[i].stamp == stamp) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = entry;
+        }
+    };
+
+    // splitmix64 finalizer over the packed key
+    static uint64_t hash_of(SymbolId symbol, uint64_t id) {
+        uint64_t x = id ^ (static_cast<uint64_t>(symbol) << 48) ^ 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    Generation &generation_at(uint64_t epoch) { return generations_[epoch % BUCKETS]; }
+
+    // Move to bucket `epoch`, reusing the generations of the buckets that
+    // leave the window (all of them after a pause of BUCKETS or more)
+    void advance(uint64_t epoch) {
+        if (started_ && epoch <= epoch_) {
+            return;
+        }
+        const uint64_t oldest_kept = epoch >= BUCKETS ? epoch - BUCKETS + 1 : 0;
+        const uint64_t first = started_ ? std::max(epoch_ + 1, oldest_kept) : epoch;
+        for (uint64_t e = first; e <= epoch; ++e) {
+            generation_at(e).reset(next_stamp_++);
+        }
+        epoch_ = epoch;
+        started_ = true;
+    }
+
+    uint64_t bucket_us_;
+    uint64_t epoch_ = 0;
+    bool started_ = false;
+    uint32_t next_stamp_ = 1;
+    std::array<Generation, BUCKETS> generations_;
+    Stats stats_;
+    MemoryRegistration memory_;
+};
+
+#endif
@@ -0,0 +1,562 @@
+/*
+ * Delta-encoded top-N depth records.
+ *
+ * A JSON DepthDelta record spells out every [price, qty] level as decimal
+ * strings, although from one depth update to the next only a few of the
+ * top levels change. DepthDeltaEncoder keeps the top-N it last published
+ * for each symbol and writes only the levels that changed since: each as
+ * its price's offset in ticks from a reference mid, plus its quantity
+ * mantissa (0 removes the level). Fed SBE depth frames, it keeps a book per
+ * symbol and publishes the book's top-N; a diff that skips update IDs
+ * clears the book and reseeds it from that diff, like a fresh start.
+ *
+ * The first record of a symbol is a keyframe carrying every level, and so
+ * is every keyframe_interval-th record after it and any record whose
+ * exponents or tick change. The tick is the largest step that divides every
+ * price published so far, so it converges on the symbol's price filter
+ * tick without being told; the symbol's book takes it as its price grid
+ * (order_book.h). DepthDeltaDecoder rebuilds the top-N by
+ * applying each delta to the levels it holds and keeping the best N. A
+ * per-symbol record sequence lets it notice a lost record; that symbol's
+ * deltas are then refused until the next keyframe.
+ *
+ * Layout (varints are LEB128, signed values zig-zag encoded first):
+ *
+ *   0xD7, version, flags (bit 0: keyframe), u8 symbol length, symbol,
+ *   varint sequence,
+ *   keyframe: varint event time us, varint ingest us, varint update id,
+ *             int8 price exponent, int8 qty exponent, varint levels N,
+ *             varint tick (price mantissa), signed mid in ticks
+ *   delta:    signed change of event time, ingest time, update id and mid
+ *   bids, then asks: varint count, count x (signed offset from mid in
+ *             ticks, varint qty mantissa)
+ *
+ * JSON records start with '{', Avro with 0xC3, KPL aggregates with 0xF3
+ * and codec-framed payloads with 0xB7, so the first byte tells these apart
+ * too; a delta record can itself be compressed (record_codec.h).
+ * Neither side is thread-safe.
+ */
+
+#ifndef _SBE_DEPTH_DELTA_H_
+#define _SBE_DEPTH_DELTA_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "order_book.h"
+#include "record_writer.h"
+#include "stream_decode.h"
+
+constexpr uint8_t DEPTH_DELTA_MAGIC = 0xD7;
+constexpr uint8_t DEPTH_DELTA_VERSION = 1;
+constexpr uint8_t DEPTH_DELTA_KEYFRAME = 0x01;
+
+// True when `data` starts like a delta-encoded depth record
+inline bool is_depth_delta_record(std::span<const char> data) {
+    return data.size() >= 3 && static_cast<uint8_t>(data[0]) == DEPTH_DELTA_MAGIC;
+}
+
+struct DepthDeltaConfig {
+    std::size_t levels = 20;           // top-N published per side
+    uint32_t keyframe_interval = 100;  // records between keyframes of a symbol
+};
+
+// One symbol's top of book, best level first on each side
+struct DepthTop {
+    std::string_view symbol;
+    uint64_t event_time_us = 0;
+    uint64_t ingest_us = 0;
+    uint64_t update_id = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    std::span<const BookLevel> bids;
+    std::span<const BookLevel> asks;
+};
+
+namespace depth_delta_detail {
+
+inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline void put_varint(RecordWriter &writer, uint64_t value) {
+    char buf[10];
+    std::size_t size = 0;
+    while (value >= 0x80) {
+        buf[size++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    buf[size++] = static_cast<char>(value);
+    writer.put(std::string_view(buf, size));
+}
+
+inline void put_signed(RecordWriter &writer, int64_t value) { put_varint(writer, zigzag(value)); }
+
+inline int64_t difference(uint64_t value, uint64_t previous) {
+    return static_cast<int64_t>(value - previous);
+}
+
+// Walks a record; throws std::runtime_error on truncated or malformed input
+class Reader {
+public:
+    explicit Reader(std::span<const char> data) : cursor_(data.data()), end_(data.data() + data.size()) {}
+
+    bool done() const { return cursor_ == end_; }
+
+    uint8_t byte() { return static_cast<uint8_t>(*take(1)); }
+
+    std::string_view bytes(std::size_t size) { return {take(size), size}; }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("depth delta: varint longer than 10 bytes");
+    }
+
+    int64_t signed_varint() {
+        const uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+private:
+    const char *take(std::size_t size) {
+        if (static_cast<std::size_t>(end_ - cursor_) < size) {
+            throw std::runtime_error("depth delta: truncated record");
+        }
+        const char *at = cursor_;
+        cursor_ += size;
+        return at;
+    }
+
+    const char *cursor_;
+    const char *end_;
+};
+
+// Whether `a` ranks ahead of `b` on the side
+inline bool better(BookSide side, int64_t a, int64_t b) { return side == BookSide::Bid ? a > b : a < b; }
+
+inline bool same_levels(std::span<const BookLevel> a, std::span<const BookLevel> b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+                      [](const BookLevel &x, const BookLevel &y) { return x.price == y.price && x.qty == y.qty; });
+}
+
+// Set or (qty 0) remove the level at `price` in a best-first side
+inline void apply_level(std::vector<BookLevel> &levels, BookSide side, int64_t price, int64_t qty) {
+    auto it = std::find_if(levels.begin(), levels.end(),
+                           [&](const BookLevel &level) { return !better(side, level.price, price); });
+    if (it != levels.end() && it->price == price) {
+        if (qty == 0) {
+            levels.erase(it);
+        } else {
+            it->qty = qty;
+        }
+    } else if (qty != 0) {
+        levels.insert(it, BookLevel{price, qty});
+    }
+}
+
+} // namespace depth_delta_detail
+
+struct DepthDeltaEncoderStats {
+    uint64_t records = 0;
+    uint64_t keyframes = 0;
+    uint64_t bytes = 0;
+    uint64_t unchanged = 0;  // updates that left the top-N as published
+    uint64_t resyncs = 0;    // books cleared after an update-ID gap
+};
+
+class DepthDeltaEncoder {
+public:
+    explicit DepthDeltaEncoder(DepthDeltaConfig config = {}) : config_(config) {
+        if (config_.levels == 0) {
+            throw std::invalid_argument("DepthDeltaEncoder: levels must be positive");
+        }
+    }
+
+    // Append the record taking `top.symbol` from its last published top-N
+    // to `top` (levels past config().levels are ignored). False, with
+    // nothing written, when the top-N did not change. The new top-N only
+    // becomes the reference if the writer did not overflow, so a caller
+    // that rewinds the writer and retries encodes the same change again.
+    bool encode(const DepthTop &top, RecordWriter &writer) {
+        Symbol &state = symbol(top.symbol);
+        const std::size_t levels = config_.levels;
+        const auto take = [&](std::span<const BookLevel> side, std::vector<BookLevel> &out) {
+            out.assign(side.begin(), side.begin() + static_cast<std::ptrdiff_t>(std::min(side.size(), levels)));
+        };
+        take(top.bids, bids_);
+        take(top.asks, asks_);
+        return write_record(state, top, writer);
+    }
+
+    // Apply a depth diff to the symbol's book, then encode the book's top-N
+    bool encode_diff(const char *data, const DepthDiffFrame &diff, uint64_t ingest_us, RecordWriter &writer) {
+        Symbol &state = symbol(diff.symbol);
+        if (state.book.apply_diff(data, diff) == ApplyStatus::Gap) {
+            ++stats_.resyncs;
+            state.book.clear();
+            state.book.apply_diff(data, diff);
+        }
+        return encode_book(state, diff.symbol, ingest_us, writer);
+    }
+
+    // Seed the symbol's book from a partial depth frame and encode its
+    // top-N. A book kept in sync by diffs already holds more than the frame
+    // and ignores it (apply_partial_depth), leaving nothing to publish.
+    bool encode_partial(const char *data, const DepthSnapshotFrame &partial, uint64_t ingest_us,
+                        RecordWriter &writer) {
+        Symbol &state = symbol(partial.symbol);
+        if (state.book.apply_partial_depth(data, partial) != ApplyStatus::Applied) {
+            ++stats_.unchanged;
+            return false;
+        }
+        return encode_book(state, partial.symbol, ingest_us, writer);
+    }
+
+    // Make the next record of every symbol a keyframe
+    void force_keyframes() {
+        for (auto &entry : symbols_) {
+            entry.second.started = false;
+        }
+    }
+
+    const DepthDeltaConfig &config() const { return config_; }
+    const DepthDeltaEncoderStats &stats() const { return stats_; }
+
+private:
+    struct Symbol {
+        explicit Symbol(std::string name) : name(std::move(name)) {}
+
+        std::string name;  // upper case, as written
+        OrderBook book;
+        // Published top-N and the record fields the next delta is taken from
+        std::vector<BookLevel> bids;
+        std::vector<BookLevel> asks;
+        bool started = false;
+        uint64_t sequence = 0;
+        uint32_t since_keyframe = 0;
+        uint64_t event_time_us = 0;
+        uint64_t ingest_us = 0;
+        uint64_t update_id = 0;
+        int8_t price_exponent = 0;
+        int8_t qty_exponent = 0;
+        int64_t tick = 0;
+        int64_t mid = 0;
+    };
+
+    Symbol &symbol(std::string_view name) {
+        auto it = symbols_.find(name);
+        if (it == symbols_.end()) {
+            std::string upper(name);
+            for (char &c : upper) {
+                c = (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+            }
+            if (upper.size() > UINT8_MAX) {
+                throw std::invalid_argument("DepthDeltaEncoder: symbol longer than 255 bytes");
+            }
+            it = symbols_.emplace(std::string(name), Symbol(std::move(upper))).first;
+        }
+        return it->second;
+    }
+
+    bool encode_book(Symbol &state, std::string_view name, uint64_t ingest_us, RecordWriter &writer) {
+        const OrderBook &book = state.book;
+        bids_.clear();
+        asks_.clear();
+        book.bids().for_each_top(config_.levels, [&](const BookLevel &level) { bids_.push_back(level); });
+        book.asks().for_each_top(config_.levels, [&](const BookLevel &level) { asks_.push_back(level); });
+        DepthTop top;
+        top.symbol = name;
+        top.event_time_us = book.event_time_us();
+        top.ingest_us = ingest_us;
+        top.update_id = book.last_update_id();
+        top.price_exponent = book.price_exponent();
+        top.qty_exponent = book.qty_exponent();
+        return write_record(state, top, writer);
+    }
+
+    // Encode bids_/asks_ against the symbol's published top-N
+    bool write_record(Symbol &state, const DepthTop &top, RecordWriter &writer) {
+        namespace dd = depth_delta_detail;
+        const bool same_exponents =
+            state.started && top.price_exponent == state.price_exponent && top.qty_exponent == state.qty_exponent;
+        if (same_exponents && dd::same_levels(bids_, state.bids) && dd::same_levels(asks_, state.asks)) {
+            ++stats_.unchanged;
+            return false;
+        }
+
+        // The tick only ever shrinks to take in a new price; a change is
+        // a keyframe, so deltas always use the tick the decoder holds
+        int64_t tick = same_exponents ? state.tick : 0;
+        for (const auto *side : {&bids_, &asks_}) {
+            for (const BookLevel &level : *side) {
+                tick = std::gcd(tick, level.price);
+            }
+        }
+        if (tick <= 0) {
+            tick = 1;
+        }
+        const bool keyframe = !same_exponents || tick != state.tick ||
+                              state.since_keyframe + 1 >= config_.keyframe_interval;
+
+        int64_t mid = state.mid;
+        if (!bids_.empty() && !asks_.empty()) {
+            mid = (bids_.front().price / tick + asks_.front().price / tick) / 2;
+        } else if (!bids_.empty() || !asks_.empty()) {
+            mid = (bids_.empty() ? asks_ : bids_).front().price / tick;
+        }
+
+        const std::size_t start = writer.size();
+        writer.put(static_cast<char>(DEPTH_DELTA_MAGIC));
+        writer.put(static_cast<char>(DEPTH_DELTA_VERSION));
+        writer.put(static_cast<char>(keyframe ? DEPTH_DELTA_KEYFRAME : 0));
+        writer.put(static_cast<char>(state.name.size()));
+        writer.put(state.name);
+        const uint64_t sequence = state.started ? state.sequence + 1 : 0;
+        dd::put_varint(writer, sequence);
+        if (keyframe) {
+            dd::put_varint(writer, top.event_time_us);
+            dd::put_varint(writer, top.ingest_us);
+            dd::put_varint(writer, top.update_id);
+            writer.put(static_cast<char>(top.price_exponent));
+            writer.put(static_cast<char>(top.qty_exponent));
+            dd::put_varint(writer, config_.levels);
+            dd::put_varint(writer, static_cast<uint64_t>(tick));
+            dd::put_signed(writer, mid);
+            write_side(writer, {}, bids_, BookSide::Bid, tick, mid);
+            write_side(writer, {}, asks_, BookSide::Ask, tick, mid);
+        } else {
+            dd::put_signed(writer, dd::difference(top.event_time_us, state.event_time_us));
+            dd::put_signed(writer, dd::difference(top.ingest_us, state.ingest_us));
+            dd::put_signed(writer, dd::difference(top.update_id, state.update_id));
+            dd::put_signed(writer, mid - state.mid);
+            write_side(writer, state.bids, bids_, BookSide::Bid, tick, mid);
+            write_side(writer, state.asks, asks_, BookSide::Ask, tick, mid);
+        }
+        if (writer.overflowed()) {
+            return true;
+        }
+
+        state.started = true;
+        state.sequence = sequence;
+        state.since_keyframe = keyframe ? 0 : state.since_keyframe + 1;
+        state.event_time_us = top.event_time_us;
+        state.ingest_us = top.ingest_us;
+        state.update_id = top.update_id;
+        state.price_exponent = top.price_exponent;
+        state.qty_exponent = top.qty_exponent;
+        if (tick != state.tick) {
+            // The book indexes levels near the touch on the same tick
+            state.book.set_price_grid(PriceGrid{tick, top.price_exponent});
+        }
+        state.tick = tick;
+        state.mid = mid;
+        state.bids.swap(bids_);
+        state.asks.swap(asks_);
+        ++stats_.records;
+        stats_.keyframes += keyframe ? 1 : 0;
+        stats_.bytes += writer.size() - start;
+        return true;
+    }
+
+    // The levels of `now` that differ from `before`, both best first. A
+    // level that left a full top-N from below needs no removal entry: the
+    // decoder drops whatever ranks past the N-th level.
+    void write_side(RecordWriter &writer, std::span<const BookLevel> before, std::span<const BookLevel> now,
+                    BookSide side, int64_t tick, int64_t mid) {
+        namespace dd = depth_delta_detail;
+        const bool full = now.size() == config_.levels;
+        changes_.clear();
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while (i < before.size() || j < now.size()) {
+            if (j == now.size() || (i < before.size() && dd::better(side, before[i].price, now[j].price))) {
+                if (!full || dd::better(side, before[i].price, now.back().price)) {
+                    changes_.push_back(BookLevel{before[i].price, 0});
+                }
+                ++i;
+            } else if (i == before.size() || dd::better(side, now[j].price, before[i].price)) {
+                changes_.push_back(now[j++]);
+            } else {
+                if (now[j].qty != before[i].qty) {
+                    changes_.push_back(now[j]);
+                }
+                ++i;
+                ++j;
+            }
+        }
+        dd::put_varint(writer, changes_.size());
+        for (const BookLevel &level : changes_) {
+            dd::put_signed(writer, level.price / tick - mid);
+            dd::put_varint(writer, static_cast<uint64_t>(level.qty));
+        }
+    }
+
+    DepthDeltaConfig config_;
+    DepthDeltaEncoderStats stats_;
+    std::unordered_map<std::string, Symbol, SymbolHash, std::equal_to<>> symbols_;
+    // Top-N being encoded, and one side's changes
+    std::vector<BookLevel> bids_;
+    std::vector<BookLevel> asks_;
+    std::vector<BookLevel> changes_;
+};
+
+enum class DepthDeltaStatus : uint8_t {
+    Applied,       // the symbol's top-N is current
+    NeedKeyframe,  // a record of the symbol was lost; deltas wait for its next keyframe
+};
+
+// A decoded record: the rebuilt top-N, valid until the next decode()
+struct DepthDeltaRecord {
+    std::string_view symbol;
+    uint64_t sequence = 0;
+    uint64_t event_time_us = 0;
+    uint64_t ingest_us = 0;
+    uint64_t update_id = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    bool keyframe = false;
+    std::span<const BookLevel> bids;
+    std::span<const BookLevel> asks;
+};
+
+struct DepthDeltaDecoderStats {
+    uint64_t keyframes = 0;
+    uint64_t deltas = 0;
+    uint64_t refused = 0;  // deltas dropped while waiting for a keyframe
+};
+
+class DepthDeltaDecoder {
+public:
+    // Apply one record. Throws std::runtime_error on malformed input, which
+    // also leaves the symbol waiting for a keyframe.
+    DepthDeltaStatus decode(std::span<const char> payload, DepthDeltaRecord &out) {
+        namespace dd = depth_delta_detail;
+        dd::Reader reader{payload};
+        if (reader.byte() != DEPTH_DELTA_MAGIC) {
+            throw std::runtime_error("depth delta: bad magic");
+        }
+        if (reader.byte() != DEPTH_DELTA_VERSION) {
+            throw std::runtime_error("depth delta: unsupported version");
+        }
+        const bool keyframe = (reader.byte() & DEPTH_DELTA_KEYFRAME) != 0;
+        const std::string_view name = reader.bytes(reader.byte());
+        auto it = symbols_.find(name);
+        if (it == symbols_.end()) {
+            it = symbols_.emplace(std::string(name), Symbol{}).first;
+        }
+        Symbol &state = it->second;
+        const uint64_t sequence = reader.varint();
+        if (!keyframe && (!state.synced || sequence != state.sequence + 1)) {
+            state.synced = false;
+            ++stats_.refused;
+            return DepthDeltaStatus::NeedKeyframe;
+        }
+
+        // Decode into a copy so a malformed record leaves the state unsynced
+        // rather than half applied
+        state.synced = false;
+        Symbol &next = next_;
+        next = state;
+        if (keyframe) {
+            next.bids.clear();
+            next.asks.clear();
+            next.event_time_us = reader.varint();
+            next.ingest_us = reader.varint();
+            next.update_id = reader.varint();
+            next.price_exponent = static_cast<int8_t>(reader.byte());
+            next.qty_exponent = static_cast<int8_t>(reader.byte());
+            next.levels = reader.varint();
+            next.tick = static_cast<int64_t>(reader.varint());
+            next.mid = reader.signed_varint();
+            if (next.levels == 0 || next.tick <= 0) {
+                throw std::runtime_error("depth delta: bad keyframe");
+            }
+        } else {
+            next.event_time_us += static_cast<uint64_t>(reader.signed_varint());
+            next.ingest_us += static_cast<uint64_t>(reader.signed_varint());
+            next.update_id += static_cast<uint64_t>(reader.signed_varint());
+            next.mid += reader.signed_varint();
+        }
+        read_side(reader, next, next.bids, BookSide::Bid);
+        read_side(reader, next, next.asks, BookSide::Ask);
+        if (!reader.done()) {
+            throw std::runtime_error("depth delta: trailing bytes");
+        }
+        next.sequence = sequence;
+        next.synced = true;
+        std::swap(state, next);
+        ++(keyframe ? stats_.keyframes : stats_.deltas);
+
+        out.symbol = it->first;
+        out.sequence = state.sequence;
+        out.event_time_us = state.event_time_us;
+        out.ingest_us = state.ingest_us;
+        out.update_id = state.update_id;
+        out.price_exponent = state.price_exponent;
+        out.qty_exponent = state.qty_exponent;
+        out.keyframe = keyframe;
+        out.bids = state.bids;
+        out.asks = state.asks;
+        return DepthDeltaStatus::Applied;
+    }
+
+    const DepthDeltaDecoderStats &stats() const { return stats_; }
+
+private:
+    struct Symbol {
+        bool synced = false;
+        uint64_t sequence = 0;
+        uint64_t event_time_us = 0;
+        uint64_t ingest_us = 0;
+        uint64_t update_id = 0;
+        int8_t price_exponent = 0;
+        int8_t qty_exponent = 0;
+        uint64_t levels = 0;
+        int64_t tick = 1;
+        int64_t mid = 0;
+        std::vector<BookLevel> bids;
+        std::vector<BookLevel> asks;
+    };
+
+    static void read_side(depth_delta_detail::Reader &reader, const Symbol &state, std::vector<BookLevel> &levels,
+                          BookSide side) {
+        const uint64_t count = reader.varint();
+        for (uint64_t i = 0; i < count; ++i) {
+            int64_t price = 0;
+            if (__builtin_add_overflow(state.mid, reader.signed_varint(), &price) ||
+                __builtin_mul_overflow(price, state.tick, &price)) {
+                throw std::runtime_error("depth delta: price out of range");
+            }
+            const auto qty = static_cast<int64_t>(reader.varint());
+            if (qty < 0) {
+                throw std::runtime_error("depth delta: bad quantity");
+            }
+            depth_delta_detail::apply_level(levels, side, price, qty);
+        }
+        if (levels.size() > state.levels) {
+            levels.resize(state.levels);
+        }
+    }
+
+    DepthDeltaDecoderStats stats_;
+    std::unordered_map<std::string, Symbol, SymbolHash, std::equal_to<>> symbols_;
+    // Record being decoded; swapped in once it is whole
+    Symbol next_;
+};
+
+#endif
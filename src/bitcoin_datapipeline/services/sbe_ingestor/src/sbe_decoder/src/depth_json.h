@@ -0,0 +1,149 @@
+/*
+ * REST JSON depth snapshots (/api/v3/depth) loaded straight into an
+ * OrderBook.
+ *
+ * Until the SBE REST path (depth_snapshot.h) is live, BinanceRESTClient
+ * fetches depth as JSON: {"lastUpdateId": N, "bids": [["price", "qty"],
+ * ...], "asks": [...]} with up to 5000 levels a side. response.json()
+ * builds a list and two strings per level before anything reads them.
+ * load_depth_json() takes the raw body instead: the object is scanned as
+ * record_ingest.h does, each level array with the depth archive's pair
+ * scanner (ndjson_columns.h), and each price and qty string is read
+ * digit-for-digit into a mantissa by parse_decimal_text (decimal_text.h).
+ *
+ * Binance writes every value with the same eight decimals, most of them
+ * trailing zeros. The levels are first parsed into a reused scratch list
+ * while noting how many trailing zeros every price and every qty shares;
+ * the book is then loaded at the coarsest exponents that hold all of them
+ * exactly (a BTCUSDT price lands at -2, like the stream's diffs), so the
+ * diffs that follow apply without rescaling.
+ */
+
+#ifndef _SBE_DEPTH_JSON_H_
+#define _SBE_DEPTH_JSON_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decimal_text.h"
+#include "ndjson_columns.h"
+#include "order_book.h"
+#include "record_ingest.h"
+
+namespace depth_json_detail {
+
+using ingest_detail::JsonKind;
+using ingest_detail::JsonValue;
+
+// Exponent of `value` with its trailing zeros dropped; zero has none to lose
+inline int coarsest_exponent(const Decimal &value) {
+    if (value.mantissa == 0) {
+        return INT8_MAX;
+    }
+    int exponent = value.exponent;
+    for (int64_t mantissa = value.mantissa; mantissa % 10 == 0 && exponent < INT8_MAX; mantissa /= 10) {
+        ++exponent;
+    }
+    return exponent;
+}
+
+struct JsonLevels {
+    std::vector<Decimal> bids;  // price, qty alternating
+    std::vector<Decimal> asks;
+    int price_exponent = INT8_MAX;
+    int qty_exponent = INT8_MAX;
+
+    void clear() {
+        bids.clear();
+        asks.clear();
+        price_exponent = INT8_MAX;
+        qty_exponent = INT8_MAX;
+    }
+
+    void parse(std::vector<Decimal> &side, std::string_view text) {
+        ndjson_detail::scan_level_pairs(text, [&](const JsonValue &price, const JsonValue &qty) {
+            Decimal p{0, 0};
+            Decimal q{0, 0};
+            if (price.kind == JsonKind::Compound || qty.kind == JsonKind::Compound ||
+                !parse_decimal_text(price.text, p) || !parse_decimal_text(qty.text, q)) {
+                throw std::runtime_error("depth json: bad level [" + std::string(price.text) + ", " +
+                                         std::string(qty.text) + "]");
+            }
+            price_exponent = std::min(price_exponent, coarsest_exponent(p));
+            qty_exponent = std::min(qty_exponent, coarsest_exponent(q));
+            side.push_back(p);
+            side.push_back(q);
+        });
+    }
+};
+
+inline JsonLevels &scratch_levels() {
+    thread_local JsonLevels levels;
+    return levels;
+}
+
+} // namespace depth_json_detail
+
+// Replace `book` with the /api/v3/depth JSON body in `body`. Throws
+// std::runtime_error for a body that is not a depth snapshot (book
+// untouched), including levels that do not fit int64 mantissas at the
+// exponents the snapshot needs.
+inline void load_depth_json(OrderBook &book, std::span<const char> body) {
+    using namespace depth_json_detail;
+    JsonLevels &levels = scratch_levels();
+    levels.clear();
+    int64_t last_update_id = -1;
+    bool has_bids = false;
+    bool has_asks = false;
+    ingest_detail::scan_json_object(body, [&](std::string_view key, const JsonValue &value) {
+        if (key == "lastUpdateId") {
+            if (!ingest_detail::json_int64(value, last_update_id)) {
+                throw std::runtime_error("depth json: bad lastUpdateId");
+            }
+        } else if (key == "bids" || key == "asks") {
+            if (value.kind != JsonKind::Compound) {
+                throw std::runtime_error("depth json: " + std::string(key) + " is not an array");
+            }
+            const bool bids = key == "bids";
+            levels.parse(bids ? levels.bids : levels.asks, value.text);
+            (bids ? has_bids : has_asks) = true;
+        }
+    });
+    if (last_update_id < 0 || !has_bids || !has_asks) {
+        throw std::runtime_error("depth json: expected lastUpdateId, bids and asks");
+    }
+
+    // An all-zero side (or none) says nothing about the exponent
+    const int8_t price_exponent = static_cast<int8_t>(levels.price_exponent == INT8_MAX ? 0 : levels.price_exponent);
+    const int8_t qty_exponent = static_cast<int8_t>(levels.qty_exponent == INT8_MAX ? 0 : levels.qty_exponent);
+    // Rescale both sides before touching the book, so a level that does not
+    // fit leaves it as it was
+    for (std::vector<Decimal> *side : {&levels.bids, &levels.asks}) {
+        for (std::size_t i = 0; i < side->size(); ++i) {
+            Decimal &value = (*side)[i];
+            const int exponent = i % 2 == 0 ? price_exponent : qty_exponent;
+            if (!rescale_decimal(value, exponent, value.mantissa)) {
+                throw std::runtime_error("depth json: level out of range");
+            }
+        }
+    }
+    book.load_snapshot(static_cast<uint64_t>(last_update_id), price_exponent, qty_exponent,
+                       [&](BookSideLevels &bids, BookSideLevels &asks) {
+                           const auto load = [](BookSideLevels &side, const std::vector<Decimal> &values) {
+                               side.assign_best_first(values.size() / 2, [&](auto &&emit) {
+                                   for (std::size_t i = 0; i < values.size(); i += 2) {
+                                       emit(values[i].mantissa, values[i + 1].mantissa);
+                                   }
+                               });
+                           };
+                           load(bids, levels.bids);
+                           load(asks, levels.asks);
+                       });
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Per-symbol sequence tracking of depth diffs (template 10003), done by the
+ * decoding thread itself.
+ *
+ * Each diff covers updates first_update_id..final_update_id; the next diff
+ * of the same symbol must start at final_update_id + 1. A DepthSequence
+ * remembers every symbol's last final_update_id in a flat array indexed by
+ * SymbolId and reports a diff that starts later as a gap, so stage_frame can
+ * put a DepthGap record into the ring next to the diff itself instead of
+ * leaving detection to a downstream consumer. The first diff of a symbol
+ * only anchors it; after a gap the sequence re-anchors on the gapped diff.
+ * Positions survive reconnects, so updates missed while disconnected are
+ * reported too.
+ *
+ * Single-threaded by design: one tracker per ring producer. Symbols never
+ * span connections (partition_streams), so each symbol has one tracker.
+ */
+
+#ifndef _SBE_DEPTH_SEQUENCE_H_
+#define _SBE_DEPTH_SEQUENCE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "symbol_table.h"
+
+class DepthSequence {
+public:
+    // The first_update_id that `first_update_id` should have been when the
+    // diff skips updates, std::nullopt when it follows on (or overlaps, or
+    // is the symbol's first diff)
+    std::optional<uint64_t> check(SymbolId symbol, uint64_t first_update_id) const {
+        if (symbol >= last_final_.size() || last_final_[symbol] == 0) {
+            return std::nullopt;
+        }
+        const uint64_t expected = last_final_[symbol] + 1;
+        if (first_update_id > expected) {
+            return expected;
+        }
+        return std::nullopt;
+    }
+
+    // Record a diff the consumer will see. Only call once the frame is
+    // published, so a dropped frame shows up as a gap on the next one.
+    void advance(SymbolId symbol, uint64_t final_update_id, bool gap) {
+        if (symbol == INVALID_SYMBOL_ID) {
+            return;
+        }
+        if (symbol >= last_final_.size()) {
+            last_final_.resize(static_cast<std::size_t>(symbol) + 1, 0);
+        }
+        if (final_update_id > last_final_[symbol]) {
+            last_final_[symbol] = final_update_id;
+        }
+        if (gap) {
+            gaps_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Gaps reported so far; safe to read from any thread
+    uint64_t gaps() const { return gaps_.load(std::memory_order_relaxed); }
+
+private:
+    // Last final_update_id per SymbolId; 0 until the symbol's first diff
+    std::vector<uint64_t> last_final_;
+    std::atomic<uint64_t> gaps_{0};
+};
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * REST depth snapshots (DepthResponse, template 200) loaded straight into an
+ * OrderBook.
+ *
+ * The generated flyweight walks the bids and asks groups in place over the
+ * response buffer and each level goes directly into the book's side arrays,
+ * so a 5000-level snapshot is one pass with no intermediate Python lists or
+ * level vectors. This is the book re-anchor path: load the snapshot, then
+ * apply the buffered diffs that follow its lastUpdateId.
+ *
+ * depth_snapshot_checksum() reads a snapshot the same way into the checksum
+ * a book holding exactly its levels would have (OrderBook::checksum), so a
+ * periodic snapshot poll can check a live book without loading anything.
+ */
+
+#ifndef _SBE_DEPTH_SNAPSHOT_H_
+#define _SBE_DEPTH_SNAPSHOT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include "book_checksum.h"
+#include "official/util.h"
+#include "order_book.h"
+#include "spot_sbe/DepthResponse.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+
+// The DepthResponse message in `payload` (message header included), ready
+// to read. Throws std::runtime_error if the frame is not a DepthResponse of
+// the expected schema.
+inline spot_sbe::DepthResponse open_depth_response(std::span<char> payload) {
+    if (payload.size() < spot_sbe::MessageHeader::encodedLength()) {
+        throw std::runtime_error("Buffer too short for message header");
+    }
+    spot_sbe::MessageHeader header(payload.data(), payload.size());
+    if (header.schemaId() != EXPECTED_SCHEMA_ID) {
+        throw std::runtime_error("Unexpected schema id " + std::to_string(header.schemaId()));
+    }
+    if (header.templateId() != spot_sbe::DepthResponse::sbeTemplateId()) {
+        throw std::runtime_error("Expected DepthResponse (template 200), got template " +
+                                 std::to_string(header.templateId()));
+    }
+    return message_from_header<spot_sbe::DepthResponse>(payload, header);
+}
+
+// Replace `book` with an opened DepthResponse. A truncated frame throws
+// std::runtime_error and leaves the book cleared and waiting for a resync
+// (see OrderBook::load_snapshot).
+inline void load_depth_levels(OrderBook &book, spot_sbe::DepthResponse &depth) {
+    const auto last_update_id = static_cast<uint64_t>(depth.lastUpdateId());
+    const int8_t price_exponent = depth.priceExponent();
+    const int8_t qty_exponent = depth.qtyExponent();
+    // Groups must be read in schema order: bids, then asks. Each group is
+    // wrapped (and bounds-checked) where the previous one ended.
+    book.load_snapshot(last_update_id, price_exponent, qty_exponent, [&](BookSideLevels &bids, BookSideLevels &asks) {
+        const auto load = [](BookSideLevels &side, auto &group) {
+            side.assign_best_first(static_cast<std::size_t>(group.count()), [&](auto &&emit) {
+                group.forEach([&](auto &level) { emit(level.price(), level.qty()); });
+            });
+        };
+        load(bids, depth.bids());
+        load(asks, depth.asks());
+    });
+}
+
+// Replace `book` with the DepthResponse frame in `payload`. Throws
+// std::runtime_error if the frame is not a DepthResponse (book untouched)
+// or is truncated (book cleared and left waiting for a resync).
+inline void load_depth_response(OrderBook &book, std::span<char> payload) {
+    auto depth = open_depth_response(payload);
+    load_depth_levels(book, depth);
+}
+
+// Checksum of the best `depth` levels of each side of the DepthResponse
+// frame in `payload` (0: all of them), as OrderBook::checksum(depth) gives
+// for a book in sync with it. Levels are taken best first, as Binance
+// sends them; empty ones are skipped. Throws std::runtime_error like
+// open_depth_response, or for a truncated frame.
+inline uint64_t depth_snapshot_checksum(std::span<char> payload, std::size_t depth = 0) {
+    auto snapshot = open_depth_response(payload);
+    const LevelHasher hasher(snapshot.priceExponent(), snapshot.qtyExponent());
+    uint64_t sum = 0;
+    const auto add = [&](auto &group, bool bid) {
+        std::size_t taken = 0;
+        group.forEach([&](auto &level) {
+            if (level.qty() != 0 && (depth == 0 || taken < depth)) {
+                sum += hasher(bid, level.price(), level.qty());
+                ++taken;
+            }
+        });
+    };
+    add(snapshot.bids(), true);
+    add(snapshot.asks(), false);
+    return sum;
+}
+
+#endif
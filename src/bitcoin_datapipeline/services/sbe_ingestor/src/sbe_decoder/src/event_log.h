@@ -0,0 +1,523 @@
+/*
+ * Shared-memory broadcast log of decoded stream events.
+ *
+ * One writer decodes each frame once into EventRecords (see event_ring.h)
+ * and appends them to a file (normally under /dev/shm) mapped MAP_SHARED;
+ * any number of readers on the host map it and follow along with their own
+ * cursors. The writer never waits for readers: the log is a ring of
+ * `capacity` record slots indexed by an ever-growing position, and a
+ * reader that falls more than `capacity` records behind loses the oldest
+ * ones and counts them. A frame's records are published together with one
+ * release store of the tail, so readers only ever see whole frames.
+ *
+ * Slots are read and written a 64-bit word at a time through
+ * std::atomic_ref, as in feature_bus.h. Before overwriting, the writer
+ * advances `claim` past the records it is about to write; a reader copies
+ * records out, then checks `claim` and discards any it copied from slots
+ * the writer may have been overwriting meanwhile. The oldest surviving
+ * frame after a loss may be partial, so readers skip it as well.
+ *
+ * Symbol IDs are interned per process (symbol_table.h): readers map the
+ * writer's IDs to their own by symbol. A restarted writer creates a new
+ * file and renames it over the old one; EventLogReader notices and
+ * follows the new file from its start.
+ *
+ * Layout: a 192-byte EventLogHeader (metadata, then claim and tail on
+ * cache lines of their own), then `capacity` slots of one EventRecord.
+ */
+
+#ifndef _SBE_EVENT_LOG_H_
+#define _SBE_EVENT_LOG_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "event_ring.h"
+#include "ingest_clock.h"
+#include "memory_accounting.h"
+#include "page_memory.h"
+#include "symbol_table.h"
+
+constexpr char EVENT_LOG_MAGIC[8] = {'B', 'T', 'C', 'E', 'L', 'O', 'G', '1'};
+constexpr uint32_t EVENT_LOG_VERSION = 1;
+
+static_assert(std::is_trivially_copyable_v<EventRecord> && sizeof(EventRecord) % sizeof(uint64_t) == 0);
+
+struct EventLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t reserved;
+    // Record slots, a power of two
+    uint64_t capacity;
+    uint64_t created_us;
+    char padding[24];
+    // Records the writer has started writing; slots below claim - capacity
+    // may be mid-overwrite
+    uint64_t claim;
+    char claim_padding[56];
+    // Records published; readers read below it
+    uint64_t tail;
+    char tail_padding[56];
+};
+static_assert(sizeof(EventLogHeader) == 192);
+static_assert(offsetof(EventLogHeader, claim) % CACHE_LINE_SIZE == 0);
+static_assert(offsetof(EventLogHeader, tail) % CACHE_LINE_SIZE == 0);
+
+struct EventLogWriterStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> records{0};
+    // Frames with more records than the log holds
+    std::atomic<uint64_t> dropped_frames{0};
+};
+
+class EventLog {
+public:
+    static constexpr std::size_t RECORD_WORDS = sizeof(EventRecord) / sizeof(uint64_t);
+
+    // Create (or replace) the log at `path` as its writer. Like FeatureBus,
+    // the file is built beside `path` and renamed over it, so readers still
+    // mapping an old log keep a valid (if finished) one.
+    static EventLog create(const std::string &path, std::size_t capacity, const MemoryPlacement &placement = {}) {
+        capacity = std::bit_ceil(std::max<std::size_t>(capacity, 2));
+        const std::size_t size = sizeof(EventLogHeader) + capacity * sizeof(EventRecord);
+
+        const std::string staging = path + ".new";
+        const int fd = ::open(staging.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error(errno_message("cannot create event log", staging));
+        }
+        // Reserve the pages up front: running out of space under a shared
+        // mapping would be a SIGBUS rather than an error
+        const int rc = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+        if (rc != 0) {
+            ::close(fd);
+            ::unlink(staging.c_str());
+            throw std::runtime_error("cannot allocate event log " + staging + ": " + std::strerror(rc));
+        }
+        EventLog log(path, fd, size, true);
+        place_pages(log.base_, size, placement);
+        auto *header = log.mutable_header();
+        header->version = EVENT_LOG_VERSION;
+        header->header_size = sizeof(EventLogHeader);
+        header->record_size = sizeof(EventRecord);
+        header->capacity = capacity;
+        header->created_us = ingest_time_us();
+        log.capacity_ = capacity;
+        // Magic last, so a reader opening mid-create rejects the file
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC));
+        if (::rename(staging.c_str(), path.c_str()) != 0) {
+            const std::string message = errno_message("cannot publish event log", path);
+            ::unlink(staging.c_str());
+            throw std::runtime_error(message);
+        }
+        return log;
+    }
+
+    // Map an existing log read-only
+    static EventLog open(const std::string &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error(errno_message("cannot open event log", path));
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(EventLogHeader)) {
+            ::close(fd);
+            throw std::runtime_error("not an event log: " + path);
+        }
+        EventLog log(path, fd, static_cast<std::size_t>(st.st_size), false);
+        const EventLogHeader &header = log.header();
+        if (std::memcmp(header.magic, EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC)) != 0 ||
+            header.version != EVENT_LOG_VERSION || header.header_size != sizeof(EventLogHeader) ||
+            header.record_size != sizeof(EventRecord) || !std::has_single_bit(header.capacity) ||
+            sizeof(EventLogHeader) + header.capacity * sizeof(EventRecord) > log.size_) {
+            throw std::runtime_error("not an event log (or written by another build): " + path);
+        }
+        log.capacity_ = static_cast<std::size_t>(header.capacity);
+        log.inode_ = st.st_ino;
+        return log;
+    }
+
+    EventLog(EventLog &&other) noexcept { *this = std::move(other); }
+    EventLog &operator=(EventLog &&other) noexcept {
+        if (this != &other) {
+            unmap();
+            path_ = std::move(other.path_);
+            fd_ = std::exchange(other.fd_, -1);
+            base_ = std::exchange(other.base_, nullptr);
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            inode_ = other.inode_;
+            writable_ = other.writable_;
+            tail_ = other.tail_;
+            staged_ = std::move(other.staged_);
+            published_ = other.published_;
+            read_buffer_ = std::move(other.read_buffer_);
+        }
+        return *this;
+    }
+    EventLog(const EventLog &) = delete;
+    EventLog &operator=(const EventLog &) = delete;
+    ~EventLog() { unmap(); }
+
+    // Writer side: EventRing's producer interface, so stage_frame decodes
+    // straight into it. Records are staged locally and copied into the
+    // shared slots on publish.
+
+    std::size_t writable(std::size_t = 1) const { return capacity_; }
+
+    EventRecord &write_slot(std::size_t offset) {
+        if (offset >= staged_.size()) {
+            staged_.resize(std::max(offset + 1, staged_.size() * 2));
+        }
+        return staged_[offset];
+    }
+
+    void publish(std::size_t count) {
+        auto *header = mutable_header();
+        std::atomic_ref<uint64_t>(header->claim).store(tail_ + count, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < count; ++i) {
+            uint64_t words[RECORD_WORDS];
+            std::memcpy(words, &staged_[i], sizeof(words));
+            uint64_t *slot = slot_words(tail_ + i);
+            for (std::size_t w = 0; w < RECORD_WORDS; ++w) {
+                std::atomic_ref<uint64_t>(slot[w]).store(words[w], std::memory_order_relaxed);
+            }
+        }
+        tail_ += count;
+        std::atomic_ref<uint64_t>(header->tail).store(tail_, std::memory_order_release);
+        published_ = count;
+        stats_.frames.fetch_add(1, std::memory_order_relaxed);
+        stats_.records.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    // Records of the last published frame, still in the writer's staging
+    std::span<const EventRecord> last_frame() const { return {staged_.data(), published_}; }
+
+    // Reader side
+
+    // Up to `max_records` published records from `cursor` on, copied out.
+    // `position` is where the first of them sits, past `cursor` when older
+    // records were overwritten before they could be read.
+    std::span<EventRecord> read(uint64_t cursor, std::size_t max_records, uint64_t &position) {
+        const uint64_t tail = this->tail();
+        position = std::max(cursor, tail > capacity_ ? tail - capacity_ : 0);
+        const auto count = static_cast<std::size_t>(std::min<uint64_t>(tail - std::min(position, tail), max_records));
+        read_buffer_.resize(std::max(read_buffer_.size(), count));
+        for (std::size_t i = 0; i < count; ++i) {
+            uint64_t words[RECORD_WORDS];
+            const uint64_t *slot = slot_words(position + i);
+            for (std::size_t w = 0; w < RECORD_WORDS; ++w) {
+                words[w] = load(slot[w]);
+            }
+            std::memcpy(&read_buffer_[i], words, sizeof(words));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t claim = load(header().claim);
+        const uint64_t oldest_intact = claim > capacity_ ? claim - capacity_ : 0;
+        const uint64_t overwritten = oldest_intact > position ? oldest_intact - position : 0;
+        const auto torn = static_cast<std::size_t>(std::min<uint64_t>(overwritten, count));
+        position += torn;
+        return {read_buffer_.data() + torn, count - torn};
+    }
+
+    uint64_t tail() const {
+        return std::atomic_ref<uint64_t>(const_cast<uint64_t &>(header().tail)).load(std::memory_order_acquire);
+    }
+
+    const EventLogHeader &header() const { return *reinterpret_cast<const EventLogHeader *>(base_); }
+    const std::string &path() const { return path_; }
+    std::size_t capacity() const { return capacity_; }
+    // Created by this process, as opposed to opened for reading
+    bool is_writer() const { return writable_; }
+    const EventLogWriterStats &stats() const { return stats_; }
+    // Bytes of the slots written so far (all of them once it has wrapped)
+    // against the whole mapping
+    MemoryUsage memory_usage() const {
+        const uint64_t written = std::min<uint64_t>(tail(), capacity_);
+        return {sizeof(EventLogHeader) + written * sizeof(EventRecord), size_};
+    }
+    void count_dropped_frame() { stats_.dropped_frames.fetch_add(1, std::memory_order_relaxed); }
+
+    // True once `path` names a different file than the one mapped (the
+    // writer restarted)
+    bool replaced() const {
+        struct stat st {};
+        return ::stat(path_.c_str(), &st) == 0 && st.st_ino != inode_;
+    }
+
+private:
+    EventLog(std::string path, int fd, std::size_t size, bool writable)
+        : path_(std::move(path)), fd_(fd), size_(size), writable_(writable) {
+        void *base = ::mmap(nullptr, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd_);
+            fd_ = -1;
+            throw std::runtime_error(errno_message("cannot map event log", path_));
+        }
+        base_ = static_cast<char *>(base);
+    }
+
+    static std::string errno_message(const std::string &what, const std::string &path) {
+        return what + " " + path + ": " + std::strerror(errno);
+    }
+
+    static uint64_t load(const uint64_t &word) {
+        return std::atomic_ref<uint64_t>(const_cast<uint64_t &>(word)).load(std::memory_order_relaxed);
+    }
+
+    EventLogHeader *mutable_header() { return reinterpret_cast<EventLogHeader *>(base_); }
+
+    uint64_t *slot_words(uint64_t position) const {
+        auto *slots = reinterpret_cast<uint64_t *>(base_ + sizeof(EventLogHeader));
+        return slots + (position & (capacity_ - 1)) * RECORD_WORDS;
+    }
+
+    void unmap() {
+        if (base_ != nullptr) {
+            ::munmap(base_, size_);
+            base_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    char *base_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t capacity_ = 0;
+    ino_t inode_ = 0;
+    bool writable_ = false;
+
+    // Writer only
+    uint64_t tail_ = 0;
+    std::vector<EventRecord> staged_;
+    std::size_t published_ = 0;
+    EventLogWriterStats stats_;
+
+    // Reader only
+    std::vector<EventRecord> read_buffer_;
+};
+
+// Decode one frame into `log`; false (and counted) when the frame has more
+// records than the log holds
+inline bool append_frame(EventLog &log, std::span<char> frame, uint64_t frame_seq, uint64_t ingest_ts_us,
+                         DepthSequence *sequence = nullptr) {
+    if (!stage_frame(log, frame, frame_seq, ingest_ts_us, sequence)) {
+        log.count_dropped_frame();
+        return false;
+    }
+    return true;
+}
+
+// Where a new reader starts in a log that is already running
+enum class EventLogStart : uint8_t {
+    Latest,
+    Earliest,
+};
+
+struct EventLogReaderStats {
+    uint64_t frames = 0;
+    uint64_t records = 0;
+    // Overwritten before they were read, or part of a frame that was
+    uint64_t lost_records = 0;
+    uint64_t reopens = 0;
+};
+
+// One consumer of several logs (say one per receiver connection), each
+// followed with its own cursor; drains whole frames into BatchColumns like
+// StreamReceiver::drain. One thread at a time.
+class EventLogReader {
+public:
+    EventLogReader(const std::vector<std::string> &paths, bool raw_mantissa, EventLogStart start)
+        : raw_mantissa_(raw_mantissa) {
+        if (paths.empty()) {
+            throw std::runtime_error("EventLogReader needs at least one log");
+        }
+        for (const auto &path : paths) {
+            Source source(EventLog::open(path));
+            const uint64_t tail = source.log.tail();
+            if (start == EventLogStart::Latest) {
+                source.cursor = tail;
+            } else if (tail > source.log.capacity()) {
+                // The oldest record left may be the middle of a frame
+                source.cursor = tail - source.log.capacity();
+                source.skip_partial = true;
+            }
+            sources_.push_back(std::move(source));
+        }
+    }
+
+    // Wait up to `timeout_ms` for records, then move up to `max_records`
+    // of them (whole frames) into `out`, visiting the logs starting one
+    // further along each call. Returns the records drained; 0 on timeout.
+    std::size_t drain(BatchColumns &out, std::size_t max_records, int timeout_ms) {
+        out.raw_mantissa = raw_mantissa_;
+        if (!wait_for_events([this] { return any_readable(); }, timeout_ms)) {
+            reopen_replaced();
+            return 0;
+        }
+        std::size_t drained = 0;
+        const std::size_t count = sources_.size();
+        for (std::size_t i = 0; i < count && drained < max_records; ++i) {
+            drained += drain_source(sources_[(next_drain_ + i) % count], out, max_records - drained);
+        }
+        next_drain_ = (next_drain_ + 1) % count;
+        if (!out.frame_ingest_ts_us.empty()) {
+            out.ingest_ts_us = out.frame_ingest_ts_us.front();
+            out.ingest_ts = micros_to_millis(out.ingest_ts_us);
+        }
+        return drained;
+    }
+
+    struct SourceView {
+        const std::string &path;
+        uint64_t cursor;
+        uint64_t tail;
+        const EventLogReaderStats &stats;
+    };
+
+    template <typename Fn>
+    void for_each_source(Fn &&fn) const {
+        for (const auto &source : sources_) {
+            fn(SourceView{source.log.path(), source.cursor, source.log.tail(), source.stats});
+        }
+    }
+
+private:
+    // Records copied out of a log per read
+    static constexpr std::size_t READ_CHUNK = 4096;
+
+    struct Source {
+        explicit Source(EventLog log) : log(std::move(log)) {}
+
+        EventLog log;
+        uint64_t cursor = 0;
+        // The next record read may be the middle of a frame: skip that frame
+        bool skip_partial = false;
+        bool skipping = false;
+        uint64_t skip_seq = 0;
+        // Writer's symbol ID -> ours
+        std::vector<SymbolId> symbol_ids;
+        EventLogReaderStats stats;
+    };
+
+    bool any_readable() const {
+        return std::any_of(sources_.begin(), sources_.end(),
+                           [](const Source &source) { return source.log.tail() != source.cursor; });
+    }
+
+    // A restarted writer's log is followed from its start
+    void reopen_replaced() {
+        for (auto &source : sources_) {
+            if (!source.log.replaced()) {
+                continue;
+            }
+            try {
+                EventLog log = EventLog::open(source.log.path());
+                source.log = std::move(log);
+            } catch (const std::exception &) {
+                // Mid-create; try again on the next idle drain
+                continue;
+            }
+            source.cursor = 0;
+            source.skip_partial = false;
+            source.skipping = false;
+            source.symbol_ids.clear();
+            ++source.stats.reopens;
+        }
+    }
+
+    SymbolId local_symbol_id(Source &source, const EventRecord &record) {
+        if (record.symbol_id == INVALID_SYMBOL_ID) {
+            return INVALID_SYMBOL_ID;
+        }
+        if (record.symbol_id >= source.symbol_ids.size()) {
+            source.symbol_ids.resize(record.symbol_id + 1u, INVALID_SYMBOL_ID);
+        }
+        SymbolId &id = source.symbol_ids[record.symbol_id];
+        if (id == INVALID_SYMBOL_ID) {
+            const char *symbol = record.symbol.data();
+            id = symbol_table().intern(std::string_view(symbol, strnlen(symbol, record.symbol.size())));
+        }
+        return id;
+    }
+
+    std::size_t drain_source(Source &source, BatchColumns &out, std::size_t max_records) {
+        std::size_t taken = 0;
+        bool in_frame = false;
+        uint64_t current_seq = 0;
+        int64_t index = 0;
+        while (true) {
+            uint64_t position = 0;
+            const std::span<EventRecord> records = source.log.read(source.cursor, READ_CHUNK, position);
+            if (position != source.cursor) {
+                source.stats.lost_records += position - source.cursor;
+                source.skip_partial = true;
+                in_frame = false;
+            }
+            std::size_t i = 0;
+            for (; i < records.size(); ++i) {
+                EventRecord &record = records[i];
+                if (source.skip_partial) {
+                    source.skip_partial = false;
+                    source.skipping = true;
+                    source.skip_seq = record.frame_seq;
+                }
+                if (source.skipping) {
+                    if (record.frame_seq == source.skip_seq) {
+                        ++source.stats.lost_records;
+                        continue;
+                    }
+                    source.skipping = false;
+                }
+                if (!in_frame || record.frame_seq != current_seq) {
+                    if (taken >= max_records) {
+                        break;
+                    }
+                    in_frame = true;
+                    current_seq = record.frame_seq;
+                    index = static_cast<int64_t>(out.frame_ingest_ts_us.size());
+                    out.frame_ingest_ts_us.push_back(record.ingest_ts_us);
+                    ++source.stats.frames;
+                }
+                record.symbol_id = local_symbol_id(source, record);
+                append_event(record, index, out);
+                ++taken;
+            }
+            source.cursor = position + i;
+            if (records.empty() || i < records.size()) {
+                source.stats.records += taken;
+                return taken;
+            }
+        }
+    }
+
+    bool raw_mantissa_;
+    std::vector<Source> sources_;
+    std::size_t next_drain_ = 0;
+};
+
+#endif
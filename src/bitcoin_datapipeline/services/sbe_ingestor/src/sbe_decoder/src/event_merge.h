@@ -0,0 +1,232 @@
+/*
+ * Deterministic k-way merge of journaled streams by exchange event time.
+ *
+ * Trades, best bid/ask and depth come from different connections, so they
+ * land in different journal files, and merging those by receive time
+ * orders them by when our socket read them: a replay is only as
+ * reproducible as the network was. JournalEventMerger orders every SBE
+ * message of a set of journal files by a key that depends on the messages
+ * alone:
+ *
+ *   event_us   the exchange's event time (receive time for a message
+ *              without one)
+ *   priority   trade, then best bid/ask, then depth diff, then depth
+ *              snapshot, then anything else: at one event time the trade
+ *              comes before the book updates it caused
+ *   seq        the book update id of a best bid/ask or depth message, so
+ *              two connections' copies of a book interleave by it; 0 for
+ *              trades
+ *   source     the file's place in name order, then the message's place
+ *              in its file, which breaks every remaining tie
+ *
+ * Each file's head message sits in a binary heap (KWayHeap), so a message
+ * costs O(log files) however many files there are. The merge is exact when
+ * every file is in key order, as one stream's file is; a message older than
+ * one already emitted (e.g. one connection carrying streams whose event
+ * times interleave) is still emitted, in its file's order, and counted as
+ * out_of_order. Either way the same files give the same order every time.
+ *
+ * Messages borrow the readers' mappings and stay valid while the merger
+ * lives. Not thread-safe.
+ */
+
+#ifndef _SBE_EVENT_MERGE_H_
+#define _SBE_EVENT_MERGE_H_
+
+#include <algorithm>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "capture_journal.h"
+#include "message_view.h"
+#include "message_walk.h"
+
+// Order of the templates sharing an event time
+enum EventMergePriority : uint8_t {
+    EVENT_MERGE_TRADE = 0,
+    EVENT_MERGE_BEST_BID_ASK = 1,
+    EVENT_MERGE_DEPTH_DIFF = 2,
+    EVENT_MERGE_DEPTH_SNAPSHOT = 3,
+    EVENT_MERGE_OTHER = 4,
+};
+
+inline uint8_t event_merge_priority(uint16_t template_id) {
+    switch (template_id) {
+    case TRADES_STREAM_EVENT:
+        return EVENT_MERGE_TRADE;
+    case BEST_BID_ASK_STREAM_EVENT:
+        return EVENT_MERGE_BEST_BID_ASK;
+    case DEPTH_DIFF_STREAM_EVENT:
+        return EVENT_MERGE_DEPTH_DIFF;
+    case DEPTH_SNAPSHOT_STREAM_EVENT:
+        return EVENT_MERGE_DEPTH_SNAPSHOT;
+    default:
+        return EVENT_MERGE_OTHER;
+    }
+}
+
+struct EventMergeKey {
+    uint64_t event_us = 0;
+    uint8_t priority = EVENT_MERGE_OTHER;
+    uint64_t seq = 0;
+    uint32_t source = 0;
+    // Message's place in its source
+    uint64_t position = 0;
+
+    auto operator<=>(const EventMergeKey &) const = default;
+};
+
+// Key of one SBE message; a message too short to view keeps its receive
+// time and sorts after the known templates
+inline EventMergeKey event_merge_key(std::span<const char> frame, uint64_t received_us, uint16_t &template_id) {
+    EventMergeKey key;
+    key.event_us = received_us;
+    template_id = 0;
+    try {
+        const MessageView view(frame.data(), frame.size());
+        template_id = view.template_id();
+        key.event_us = view.event_time_us().value_or(received_us);
+        key.priority = event_merge_priority(template_id);
+        key.seq = view.book_update_id().value_or(view.final_update_id().value_or(0));
+    } catch (const std::runtime_error &) {
+    }
+    return key;
+}
+
+// Min-heap of keys; each key names its source, which pushes its next key
+// once the top is popped
+template <typename Key>
+class KWayHeap {
+public:
+    void reserve(std::size_t sources) { heap_.reserve(sources); }
+    bool empty() const { return heap_.empty(); }
+    std::size_t size() const { return heap_.size(); }
+    const Key &top() const { return heap_.front(); }
+
+    void push(const Key &key) {
+        heap_.push_back(key);
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<>());
+    }
+
+    void pop() {
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<>());
+        heap_.pop_back();
+    }
+
+private:
+    std::vector<Key> heap_;
+};
+
+struct MergedMessage {
+    std::span<char> frame;
+    uint64_t received_us = 0;
+    uint16_t template_id = 0;
+    EventMergeKey key;
+};
+
+struct EventMergeStats {
+    uint64_t messages = 0;
+    // Messages keyed before one already emitted
+    uint64_t out_of_order = 0;
+};
+
+class JournalEventMerger {
+public:
+    // `files` in the order that breaks ties (journal_files() gives name order)
+    explicit JournalEventMerger(const std::vector<std::string> &files) {
+        sources_.reserve(files.size());
+        for (const std::string &file : files) {
+            Source source;
+            source.reader = std::make_unique<JournalReader>(file);
+            sources_.push_back(std::move(source));
+        }
+        heap_.reserve(sources_.size());
+        for (uint32_t i = 0; i < sources_.size(); ++i) {
+            EventMergeKey key;
+            if (load(i, key)) {
+                heap_.push(key);
+            }
+        }
+    }
+
+    JournalEventMerger(const JournalEventMerger &) = delete;
+    JournalEventMerger &operator=(const JournalEventMerger &) = delete;
+
+    // The next message in key order; false when every file is done
+    bool next(MergedMessage &out) {
+        if (heap_.empty()) {
+            return false;
+        }
+        const EventMergeKey key = heap_.top();
+        heap_.pop();
+        Source &source = sources_[key.source];
+        out.frame = source.messages[source.index];
+        out.received_us = source.record.header->received_us;
+        out.template_id = source.template_id;
+        out.key = key;
+        ++source.index;
+        ++source.position;
+        EventMergeKey following;
+        if (load(key.source, following)) {
+            heap_.push(following);
+        }
+
+        if (stats_.messages > 0 && std::tie(key.event_us, key.priority, key.seq) <
+                                       std::tie(last_.event_us, last_.priority, last_.seq)) {
+            ++stats_.out_of_order;
+        } else {
+            last_ = key;
+        }
+        ++stats_.messages;
+        return true;
+    }
+
+    std::size_t sources() const { return sources_.size(); }
+    const EventMergeStats &stats() const { return stats_; }
+
+private:
+    struct Source {
+        std::unique_ptr<JournalReader> reader;
+        JournalRecord record{};
+        // The current record's SBE messages, the next at `index`
+        std::vector<std::span<char>> messages;
+        std::size_t index = 0;
+        uint64_t position = 0;
+        uint16_t template_id = 0;
+    };
+
+    // Key of the source's next message, reading its next record when the
+    // current one is used up; false at the end of the file
+    bool load(uint32_t i, EventMergeKey &key) {
+        Source &source = sources_[i];
+        if (source.index == source.messages.size()) {
+            if (!source.reader->next(source.record)) {
+                return false;
+            }
+            // split_messages takes char* like the generated codecs, but never writes
+            source.messages.clear();
+            split_messages({const_cast<char *>(source.record.frame.data()), source.record.frame.size()},
+                           source.messages);
+            source.index = 0;
+        }
+        key = event_merge_key(source.messages[source.index], source.record.header->received_us, source.template_id);
+        key.source = i;
+        key.position = source.position;
+        return true;
+    }
+
+    std::vector<Source> sources_;
+    KWayHeap<EventMergeKey> heap_;
+    // Greatest key emitted so far
+    EventMergeKey last_;
+    EventMergeStats stats_;
+};
+
+#endif
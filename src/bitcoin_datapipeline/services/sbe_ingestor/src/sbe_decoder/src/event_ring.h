@@ -0,0 +1,424 @@
+/*
+ * Decoded stream events in an SPSC ring.
+ *
+ * The receiver thread decodes each frame into fixed-size EventRecords written
+ * straight into ring slots: one per trade entry, one per best bid/ask, and
+ * one header plus one per level for depth diffs and partial depth
+ * snapshots. Records keep wire
+ * mantissas and exponents, so the producer does no floating-point work and
+ * never allocates. A frame's records are published together; if they do not
+ * fit, the whole frame is dropped and counted. drain_events() turns records
+ * back into BatchColumns on the consumer side, never splitting a frame.
+ *
+ * Given a DepthSequence, stage_frame also checks each depth diff against
+ * its symbol's previous one and stages a DepthGap record ahead of a diff
+ * that skips updates, so gaps reach the consumer with the diff itself.
+ */
+
+#ifndef _SBE_EVENT_RING_H_
+#define _SBE_EVENT_RING_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <thread>
+
+#include "batch_decode.h"
+#include "depth_sequence.h"
+#include "spot_sbe/MessageHeader.h"
+#include "spsc_ring.h"
+#include "stream_decode.h"
+
+enum class EventKind : uint8_t {
+    Trade,
+    BestBidAsk,
+    DepthDiff,
+    PartialDepth,
+    DepthLevel,
+    DepthGap,
+    Error,
+    Unknown,
+    // Summary closing a conflated frame (see conflation.h)
+    Conflation,
+};
+
+struct EventRecord {
+    EventKind kind = EventKind::Error;
+    // is_buyer_maker for trades, is_bid for depth levels, the ParseError
+    // for errors
+    uint8_t flag = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    // Interned ID of `symbol` (see symbol_table.h)
+    SymbolId symbol_id = INVALID_SYMBOL_ID;
+    uint64_t frame_seq = 0;
+    uint64_t ingest_ts_us = 0;
+    uint64_t event_time_us = 0;
+    // trade: trade_id, trade_time_us; best bid/ask and partial depth:
+    // book_update_id; depth diff: first_update_id, final_update_id; depth
+    // gap: expected first_update_id, actual first_update_id; conflation:
+    // updates, first event time
+    int64_t id[2] = {0, 0};
+    // trade / level: price, qty; best bid/ask: bid px, bid qty, ask px, ask
+    // qty; conflation: bid low, bid high, ask low, ask high
+    int64_t mantissa[4] = {0, 0, 0, 0};
+    SymbolCode symbol{};
+};
+
+using EventRing = SpscRing<EventRecord>;
+
+// Decode one frame into the ring and publish its records. Returns false,
+// with nothing visible to the consumer, when the frame needs more slots
+// than are free. With a `sequence`, depth diffs are gap-checked; the
+// sequence only advances when the frame is published. Any ring with
+// EventRing's producer side works (see EventLog in event_log.h).
+template <typename Ring>
+bool stage_frame(Ring &ring, std::span<char> frame, uint64_t frame_seq, uint64_t ingest_ts_us,
+                 DepthSequence *sequence = nullptr) {
+    using spot_sbe::MessageHeader;
+
+    std::size_t free = ring.writable();
+    std::size_t count = 0;
+    bool overflow = false;
+    auto next = [&]() -> EventRecord * {
+        if (overflow) {
+            return nullptr;
+        }
+        if (count == free) {
+            free = ring.writable(count + 1);
+            if (count == free) {
+                overflow = true;
+                return nullptr;
+            }
+        }
+        EventRecord &record = ring.write_slot(count++);
+        record.frame_seq = frame_seq;
+        record.ingest_ts_us = ingest_ts_us;
+        return &record;
+    };
+    // Depth diff to record in `sequence` once published
+    SymbolId diff_symbol = INVALID_SYMBOL_ID;
+    uint64_t diff_final = 0;
+    bool diff_gap = false;
+    auto single = [&](EventKind kind, ParseError cause = ParseError::None) {
+        count = 0;
+        if (EventRecord *record = next()) {
+            record->kind = kind;
+            record->flag = static_cast<uint8_t>(cause);
+        }
+    };
+
+    if (frame.size() < MessageHeader::encodedLength()) [[unlikely]] {
+        single(EventKind::Error, ParseError::ShortHeader);
+    } else {
+        MessageHeader header{frame.data(), frame.size()};
+        const char *data = frame.data() + MessageHeader::encodedLength();
+        // One DepthLevel record per bid, then per ask
+        auto stage_levels = [&](const auto &depth) {
+            auto stage_side = [&](const LevelGroup &group, uint8_t is_bid) {
+                for_each_level(data, group, [&](const LevelMantissa &level) {
+                    EventRecord *record = next();
+                    if (record == nullptr) {
+                        return;
+                    }
+                    record->kind = EventKind::DepthLevel;
+                    record->flag = is_bid;
+                    record->price_exponent = depth.price_exponent;
+                    record->qty_exponent = depth.qty_exponent;
+                    record->mantissa[0] = level.price;
+                    record->mantissa[1] = level.qty;
+                });
+            };
+            stage_side(depth.bids, 1);
+            stage_side(depth.asks, 0);
+        };
+        const std::size_t data_size = frame.size() - MessageHeader::encodedLength();
+
+        ParseError error = ParseError::None;
+        switch (header.templateId()) {
+        case TRADES_STREAM_EVENT: {
+            TradeFrame trade;
+            error = parse_trade_frame(data, data_size, header.blockLength(), trade);
+            if (error != ParseError::None) [[unlikely]] {
+                break;
+            }
+            const auto symbol = to_symbol_code(trade.symbol);
+            const SymbolId symbol_id = symbol_table().intern(trade.symbol);
+            for_each_trade_entry(data, data_size, trade, [&](const TradeEntry &entry) {
+                EventRecord *record = next();
+                if (record == nullptr) {
+                    return;
+                }
+                record->kind = EventKind::Trade;
+                record->flag = entry.is_buyer_maker ? 1 : 0;
+                record->price_exponent = trade.price_exponent;
+                record->qty_exponent = trade.qty_exponent;
+                record->event_time_us = trade.event_time_us;
+                record->id[0] = static_cast<int64_t>(entry.trade_id);
+                record->id[1] = static_cast<int64_t>(trade.trade_time_us);
+                record->mantissa[0] = entry.price_mantissa;
+                record->mantissa[1] = entry.qty_mantissa;
+                record->symbol = symbol;
+                record->symbol_id = symbol_id;
+            });
+            break;
+        }
+        case BEST_BID_ASK_STREAM_EVENT: {
+            BestBidAskFrame bba;
+            error = parse_best_bid_ask_frame(data, data_size, header.blockLength(), bba);
+            if (error != ParseError::None) [[unlikely]] {
+                break;
+            }
+            if (EventRecord *record = next()) {
+                record->kind = EventKind::BestBidAsk;
+                record->price_exponent = bba.price_exponent;
+                record->qty_exponent = bba.qty_exponent;
+                record->event_time_us = bba.event_time_us;
+                record->id[0] = static_cast<int64_t>(bba.book_update_id);
+                record->mantissa[0] = bba.bid_price_mantissa;
+                record->mantissa[1] = bba.bid_qty_mantissa;
+                record->mantissa[2] = bba.ask_price_mantissa;
+                record->mantissa[3] = bba.ask_qty_mantissa;
+                record->symbol = to_symbol_code(bba.symbol);
+                record->symbol_id = symbol_table().intern(bba.symbol);
+            }
+            break;
+        }
+        case DEPTH_DIFF_STREAM_EVENT: {
+            DepthDiffFrame depth;
+            error = parse_depth_diff_frame(data, data_size, header.blockLength(), depth);
+            if (error != ParseError::None) [[unlikely]] {
+                break;
+            }
+            const auto symbol = to_symbol_code(depth.symbol);
+            const SymbolId symbol_id = symbol_table().intern(depth.symbol);
+            if (sequence != nullptr) {
+                if (const auto expected = sequence->check(symbol_id, depth.first_update_id)) {
+                    if (EventRecord *record = next()) {
+                        record->kind = EventKind::DepthGap;
+                        record->event_time_us = depth.event_time_us;
+                        record->id[0] = static_cast<int64_t>(*expected);
+                        record->id[1] = static_cast<int64_t>(depth.first_update_id);
+                        record->symbol = symbol;
+                        record->symbol_id = symbol_id;
+                    }
+                    diff_gap = true;
+                }
+                diff_symbol = symbol_id;
+                diff_final = depth.final_update_id;
+            }
+            if (EventRecord *record = next()) {
+                record->kind = EventKind::DepthDiff;
+                record->price_exponent = depth.price_exponent;
+                record->qty_exponent = depth.qty_exponent;
+                record->event_time_us = depth.event_time_us;
+                record->id[0] = static_cast<int64_t>(depth.first_update_id);
+                record->id[1] = static_cast<int64_t>(depth.final_update_id);
+                record->symbol = symbol;
+                record->symbol_id = symbol_id;
+            }
+            stage_levels(depth);
+            break;
+        }
+        case DEPTH_SNAPSHOT_STREAM_EVENT: {
+            DepthSnapshotFrame snapshot;
+            error = parse_depth_snapshot_frame(data, data_size, header.blockLength(), snapshot);
+            if (error != ParseError::None) [[unlikely]] {
+                break;
+            }
+            if (EventRecord *record = next()) {
+                record->kind = EventKind::PartialDepth;
+                record->price_exponent = snapshot.price_exponent;
+                record->qty_exponent = snapshot.qty_exponent;
+                record->event_time_us = snapshot.event_time_us;
+                record->id[0] = static_cast<int64_t>(snapshot.book_update_id);
+                record->symbol = to_symbol_code(snapshot.symbol);
+                record->symbol_id = symbol_table().intern(snapshot.symbol);
+            }
+            stage_levels(snapshot);
+            break;
+        }
+        default:
+            single(EventKind::Unknown);
+            break;
+        }
+        if (error != ParseError::None) [[unlikely]] {
+            // Parsing fails before the frame stages anything
+            single(EventKind::Error, error);
+        }
+    }
+
+    if (overflow) {
+        return false;
+    }
+    ring.publish(count);
+    if (diff_symbol != INVALID_SYMBOL_ID) {
+        sequence->advance(diff_symbol, diff_final, diff_gap);
+    }
+    return true;
+}
+
+// Publish one already-decoded frame's records into the ring; false, with
+// nothing published, when they do not fit
+template <typename Ring>
+bool copy_frame(Ring &ring, std::span<const EventRecord> records) {
+    if (ring.writable(records.size()) < records.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        ring.write_slot(i) = records[i];
+    }
+    ring.publish(records.size());
+    return true;
+}
+
+// Consumer-side wait until `readable()` is true or `timeout_ms` passes.
+// Producers never signal, so idle waits back off from 50us to 1ms.
+template <typename Readable>
+bool wait_for_events(Readable &&readable, int timeout_ms) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    auto pause = std::chrono::microseconds(50);
+    while (!readable()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(pause);
+        pause = std::min(pause * 2, std::chrono::microseconds(1000));
+    }
+    return true;
+}
+
+// Append one record to `out` as part of frame `index`
+inline void append_event(const EventRecord &record, int64_t index, BatchColumns &out) {
+    const bool raw = out.raw_mantissa;
+    const int8_t pe = record.price_exponent;
+    const int8_t qe = record.qty_exponent;
+    switch (record.kind) {
+    case EventKind::Trade: {
+        auto &cols = out.trades;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(record.event_time_us)));
+        cols.trade_time.push_back(static_cast<int64_t>(micros_to_millis(static_cast<uint64_t>(record.id[1]))));
+        cols.trade_id.push_back(record.id[0]);
+        cols.price.push(record.mantissa[0], pe, raw);
+        cols.qty.push(record.mantissa[1], qe, raw);
+        cols.exponents.push(pe, qe, raw);
+        cols.is_buyer_maker.push_back(record.flag);
+        cols.symbol.push_back(record.symbol);
+        cols.symbol_id.push_back(record.symbol_id);
+        break;
+    }
+    case EventKind::BestBidAsk: {
+        auto &cols = out.best_bid_ask;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(record.event_time_us)));
+        cols.book_update_id.push_back(record.id[0]);
+        cols.bid_px.push(record.mantissa[0], pe, raw);
+        cols.bid_sz.push(record.mantissa[1], qe, raw);
+        cols.ask_px.push(record.mantissa[2], pe, raw);
+        cols.ask_sz.push(record.mantissa[3], qe, raw);
+        cols.exponents.push(pe, qe, raw);
+        cols.symbol.push_back(record.symbol);
+        cols.symbol_id.push_back(record.symbol_id);
+        break;
+    }
+    case EventKind::DepthDiff: {
+        auto &cols = out.depth;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(record.event_time_us)));
+        cols.first_update_id.push_back(record.id[0]);
+        cols.final_update_id.push_back(record.id[1]);
+        cols.symbol.push_back(record.symbol);
+        cols.symbol_id.push_back(record.symbol_id);
+        break;
+    }
+    case EventKind::PartialDepth: {
+        auto &cols = out.partial_depth;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(record.event_time_us)));
+        cols.book_update_id.push_back(record.id[0]);
+        cols.symbol.push_back(record.symbol);
+        cols.symbol_id.push_back(record.symbol_id);
+        break;
+    }
+    case EventKind::DepthLevel: {
+        auto &levels = out.depth_levels;
+        levels.frame_index.push_back(index);
+        levels.is_bid.push_back(record.flag);
+        levels.price.push(record.mantissa[0], pe, raw);
+        levels.qty.push(record.mantissa[1], qe, raw);
+        levels.exponents.push(pe, qe, raw);
+        break;
+    }
+    case EventKind::DepthGap: {
+        auto &cols = out.depth_gaps;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(record.event_time_us)));
+        cols.expected_first_update_id.push_back(record.id[0]);
+        cols.first_update_id.push_back(record.id[1]);
+        cols.symbol.push_back(record.symbol);
+        cols.symbol_id.push_back(record.symbol_id);
+        break;
+    }
+    case EventKind::Error:
+        push_error_frame(out, index, static_cast<ParseError>(record.flag));
+        break;
+    case EventKind::Unknown:
+        out.unknown_frames.push_back(index);
+        break;
+    case EventKind::Conflation: {
+        auto &cols = out.conflation;
+        cols.frame_index.push_back(index);
+        cols.event_ts.push_back(static_cast<int64_t>(micros_to_millis(record.event_time_us)));
+        cols.first_event_ts.push_back(static_cast<int64_t>(micros_to_millis(static_cast<uint64_t>(record.id[1]))));
+        cols.stream.push_back(record.flag);
+        cols.updates.push_back(record.id[0]);
+        cols.bid_low.push(record.mantissa[0], pe, raw);
+        cols.bid_high.push(record.mantissa[1], pe, raw);
+        cols.ask_low.push(record.mantissa[2], pe, raw);
+        cols.ask_high.push(record.mantissa[3], pe, raw);
+        cols.exponents.push(pe, qe, raw);
+        cols.symbol.push_back(record.symbol);
+        cols.symbol_id.push_back(record.symbol_id);
+        break;
+    }
+    }
+}
+
+// Move up to `max_records` records (rounded up to the end of the last frame
+// touched) into `out`. Frames are numbered on from the ones already in
+// `out` (0 for a fresh batch), so several rings can drain into one batch;
+// out.frame_ingest_ts_us holds one receive time per frame. Returns the
+// number of records consumed.
+inline std::size_t drain_events(EventRing &ring, BatchColumns &out, std::size_t max_records) {
+    // Bulk drain: always take the producer's latest tail
+    const std::size_t available = ring.readable(SIZE_MAX);
+    std::size_t taken = 0;
+    auto index = static_cast<int64_t>(out.frame_ingest_ts_us.size()) - 1;
+    uint64_t current_seq = 0;
+
+    while (taken < available) {
+        const EventRecord &record = ring.read_slot(taken);
+        const bool new_frame = taken == 0 || record.frame_seq != current_seq;
+        if (new_frame) {
+            if (taken >= max_records) {
+                break;
+            }
+            ++index;
+            current_seq = record.frame_seq;
+            out.frame_ingest_ts_us.push_back(record.ingest_ts_us);
+        }
+        ++taken;
+        append_event(record, index, out);
+    }
+
+    ring.release(taken);
+    if (!out.frame_ingest_ts_us.empty()) {
+        out.ingest_ts_us = out.frame_ingest_ts_us.front();
+        out.ingest_ts = micros_to_millis(out.ingest_ts_us);
+    }
+    return taken;
+}
+
+#endif
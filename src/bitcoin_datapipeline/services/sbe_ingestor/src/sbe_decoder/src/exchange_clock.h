@@ -0,0 +1,550 @@
+/*
+ * Exchange clock offset and drift, estimated NTP-style from WebSocket API
+ * round trips.
+ *
+ * Event times are stamped by the exchange's clock and receive times by ours
+ * (ingest_clock.h), so an event-to-receive latency mixes the network delay
+ * with the offset between the two clocks and can even come out negative.
+ * ClockSync measures the offset: every interval it sends a burst of `time`
+ * requests, each answered with a ServerTimeResponse, and times each round
+ * trip on the ingest clock. The server read its clock somewhere inside the
+ * round trip, so
+ *
+ *     offset = server_time - (sent + received) / 2,   error <= rtt / 2
+ *
+ * plus half the server's time unit. Queueing only ever lengthens a round
+ * trip and moves its midpoint, so the fastest round trip of a burst is the
+ * one kept (min-RTT filtering), and the fit below skips samples whose RTT
+ * is more than RTT_SLACK times the window's fastest.
+ *
+ * ExchangeClock keeps the last WINDOW samples and fits offset against local
+ * time by least squares once they span MIN_DRIFT_SPAN_US: the line's value
+ * at the newest sample is the offset, its slope the drift between the
+ * clocks, so between syncs the offset is extrapolated rather than held.
+ * With too short a span the fastest sample's offset stands, without drift.
+ * A sample further off the line than both errors and STEP_US means one of
+ * the clocks stepped; the window restarts from it.
+ *
+ * The estimate is published under a seqlock written by one thread at a
+ * time (add() is serialized by a mutex), so readers never block. Receive
+ * threads call exchange_latency_us() per frame: a few loads and a multiply.
+ * Until the first sample the clock is not synced and callers leave their
+ * latencies uncorrected. exchange_clock() is the process-wide instance that
+ * StreamReceiver and the decoder's trace stamps read.
+ */
+
+#ifndef _SBE_EXCHANGE_CLOCK_H_
+#define _SBE_EXCHANGE_CLOCK_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "ingest_clock.h"
+#include "native_metrics.h"
+#include "spot_sbe/MessageHeader.h"
+#include "spot_sbe/ServerTimeResponse.h"
+#include "stream_decode.h"
+#include "ws_api_client.h"
+
+// One round trip: our send and receive times (ingest clock) around the
+// server's reading
+struct ClockSample {
+    uint64_t sent_us = 0;
+    uint64_t received_us = 0;
+    int64_t server_us = 0;
+    // Unit of the server's reading: 1000 for milliseconds
+    uint64_t resolution_us = 1;
+};
+
+struct ClockEstimate {
+    bool synced = false;
+    // Exchange minus local time at anchor_us (local)
+    int64_t offset_us = 0;
+    uint64_t anchor_us = 0;
+    // Exchange clock rate minus ours, parts per million
+    double drift_ppm = 0.0;
+    // Bound on the offset's error: half the fastest RTT plus the time unit
+    uint64_t error_us = 0;
+    uint64_t min_rtt_us = 0;
+
+    // Offset at local time `local_us`
+    int64_t offset_at(uint64_t local_us) const {
+        const double elapsed = static_cast<double>(static_cast<int64_t>(local_us - anchor_us));
+        return offset_us + static_cast<int64_t>(drift_ppm * 1e-6 * elapsed);
+    }
+};
+
+// Written by add(), readable from any thread
+struct ExchangeClockStats {
+    std::atomic<uint64_t> samples{0};
+    // Round trips with the receive before the send, or no server time
+    std::atomic<uint64_t> rejected{0};
+    // Times the window restarted because a clock stepped
+    std::atomic<uint64_t> steps{0};
+    // Window samples in the last fit, and the ones the RTT filter skipped
+    std::atomic<uint64_t> window{0};
+    std::atomic<uint64_t> filtered{0};
+};
+
+// The ServerTimeResponse in `payload` (message header included) as a
+// sample's server_us and resolution_us. Readings below 10^14 are taken as
+// milliseconds (the API's default unit), larger ones as microseconds; a
+// millisecond reading stands for the middle of its millisecond.
+// Throws std::runtime_error if the frame is not a ServerTimeResponse of the
+// expected schema.
+inline std::pair<int64_t, uint64_t> server_time_us(std::span<const char> payload) {
+    using spot_sbe::ServerTimeResponse;
+    if (payload.size() < spot_sbe::MessageHeader::encodedLength()) {
+        throw std::runtime_error("Buffer too short for message header");
+    }
+    char *data = const_cast<char *>(payload.data());
+    spot_sbe::MessageHeader header(data, payload.size());
+    if (header.schemaId() != EXPECTED_SCHEMA_ID) {
+        throw std::runtime_error("Unexpected schema id " + std::to_string(header.schemaId()));
+    }
+    if (header.templateId() != ServerTimeResponse::SBE_TEMPLATE_ID) {
+        throw std::runtime_error("Expected ServerTimeResponse (template 102), got template " +
+                                 std::to_string(header.templateId()));
+    }
+    if (payload.size() < spot_sbe::MessageHeader::encodedLength() + header.blockLength()) {
+        throw std::runtime_error("ServerTimeResponse shorter than its block");
+    }
+    std::span<char> frame(data, payload.size());
+    const int64_t server_time = message_from_header<ServerTimeResponse>(frame, header).serverTime();
+    if (server_time <= 0) {
+        throw std::runtime_error("ServerTimeResponse without a server time");
+    }
+    constexpr int64_t MICROS_FROM = 100'000'000'000'000;
+    if (server_time < MICROS_FROM) {
+        return {server_time * 1000 + 500, 1000};
+    }
+    return {server_time, 1};
+}
+
+class ExchangeClock {
+public:
+    static constexpr std::size_t WINDOW = 32;
+    // Samples slower than this many times the window's fastest RTT (plus
+    // RTT_SLACK_US) are left out of the fit
+    static constexpr double RTT_SLACK = 1.5;
+    static constexpr uint64_t RTT_SLACK_US = 50;
+    static constexpr uint64_t MIN_DRIFT_SPAN_US = 10'000'000;
+    // Fitted drifts past this are not a clock's and are ignored
+    static constexpr double MAX_DRIFT_PPM = 1000.0;
+    static constexpr uint64_t STEP_US = 5000;
+
+    ExchangeClock() = default;
+    ExchangeClock(const ExchangeClock &) = delete;
+    ExchangeClock &operator=(const ExchangeClock &) = delete;
+
+    // Take a round trip into the window and refit; false if it was rejected
+    bool add(const ClockSample &sample) {
+        if (sample.received_us < sample.sent_us || sample.server_us <= 0) {
+            stats_.rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        std::lock_guard lock(mutex_);
+        const uint64_t rtt = sample.received_us - sample.sent_us;
+        Point point;
+        point.local_us = sample.sent_us + rtt / 2;
+        point.offset_us = sample.server_us - static_cast<int64_t>(point.local_us);
+        point.rtt_us = rtt;
+        point.resolution_us = sample.resolution_us;
+        if (count_ > 0) {
+            const int64_t residual = point.offset_us - fitted_.offset_at(point.local_us);
+            const uint64_t bound = rtt / 2 + sample.resolution_us / 2 + fitted_.error_us + STEP_US;
+            if (static_cast<uint64_t>(std::llabs(residual)) > bound) {
+                stats_.steps.fetch_add(1, std::memory_order_relaxed);
+                count_ = 0;
+            }
+        }
+        points_[(first_ + count_) % WINDOW] = point;
+        if (count_ < WINDOW) {
+            ++count_;
+        } else {
+            first_ = (first_ + 1) % WINDOW;
+        }
+        stats_.samples.fetch_add(1, std::memory_order_relaxed);
+        fitted_ = fit();
+        publish(fitted_);
+        return true;
+    }
+
+    // The current estimate; never blocks
+    ClockEstimate estimate() const {
+        ClockEstimate out;
+        while (true) {
+            const uint64_t before = sequence_.load(std::memory_order_acquire);
+            if ((before & 1) != 0) {
+                continue;
+            }
+            out.synced = synced_.load(std::memory_order_relaxed);
+            out.offset_us = offset_us_.load(std::memory_order_relaxed);
+            out.anchor_us = anchor_us_.load(std::memory_order_relaxed);
+            out.drift_ppm = drift_ppm_.load(std::memory_order_relaxed);
+            out.error_us = error_us_.load(std::memory_order_relaxed);
+            out.min_rtt_us = min_rtt_us_.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before) {
+                return out;
+            }
+        }
+    }
+
+    bool synced() const { return synced_.load(std::memory_order_relaxed); }
+
+    // `exchange_us` on the local clock; unchanged until synced
+    uint64_t to_local_us(uint64_t exchange_us) const {
+        if (!synced()) {
+            return exchange_us;
+        }
+        return static_cast<uint64_t>(static_cast<int64_t>(exchange_us) - estimate().offset_at(exchange_us));
+    }
+
+    // Offset-corrected time from an exchange event to its local receive,
+    // negative where the offset's error exceeds the true latency. Only
+    // meaningful once synced().
+    int64_t exchange_latency_us(uint64_t event_us, uint64_t received_us) const {
+        return static_cast<int64_t>(received_us) + estimate().offset_at(received_us) - static_cast<int64_t>(event_us);
+    }
+
+    const ExchangeClockStats &stats() const { return stats_; }
+
+    // Forget every sample; the clock is not synced until the next one
+    void reset() {
+        std::lock_guard lock(mutex_);
+        count_ = 0;
+        first_ = 0;
+        fitted_ = ClockEstimate{};
+        publish(fitted_);
+    }
+
+private:
+    struct Point {
+        uint64_t local_us = 0;
+        int64_t offset_us = 0;
+        uint64_t rtt_us = 0;
+        uint64_t resolution_us = 1;
+    };
+
+    const Point &point(std::size_t i) const { return points_[(first_ + i) % WINDOW]; }
+
+    ClockEstimate fit() {
+        std::size_t fastest = 0;
+        for (std::size_t i = 1; i < count_; ++i) {
+            if (point(i).rtt_us < point(fastest).rtt_us) {
+                fastest = i;
+            }
+        }
+        const Point &best = point(fastest);
+        const double rtt_limit = static_cast<double>(best.rtt_us) * RTT_SLACK + static_cast<double>(RTT_SLACK_US);
+
+        // Least squares over the kept points, x relative to the newest
+        const uint64_t anchor = point(count_ - 1).local_us;
+        double n = 0, sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+        uint64_t earliest = anchor;
+        for (std::size_t i = 0; i < count_; ++i) {
+            const Point &p = point(i);
+            if (static_cast<double>(p.rtt_us) > rtt_limit) {
+                continue;
+            }
+            const double x = static_cast<double>(static_cast<int64_t>(p.local_us - anchor));
+            const double y = static_cast<double>(p.offset_us - best.offset_us);
+            n += 1;
+            sum_x += x;
+            sum_y += y;
+            sum_xx += x * x;
+            sum_xy += x * y;
+            earliest = std::min(earliest, p.local_us);
+        }
+        stats_.window.store(count_, std::memory_order_relaxed);
+        stats_.filtered.store(count_ - static_cast<std::size_t>(n), std::memory_order_relaxed);
+
+        ClockEstimate out;
+        out.synced = true;
+        out.min_rtt_us = best.rtt_us;
+        out.error_us = best.rtt_us / 2 + best.resolution_us / 2;
+        out.offset_us = best.offset_us;
+        out.anchor_us = best.local_us;
+        const double denominator = n * sum_xx - sum_x * sum_x;
+        if (n >= 2 && anchor - earliest >= MIN_DRIFT_SPAN_US && denominator > 0) {
+            const double slope = (n * sum_xy - sum_x * sum_y) / denominator;
+            if (std::abs(slope) * 1e6 <= MAX_DRIFT_PPM) {
+                // The line's value at x = 0, the newest sample
+                out.offset_us = best.offset_us + static_cast<int64_t>((sum_y - slope * sum_x) / n);
+                out.anchor_us = anchor;
+                out.drift_ppm = slope * 1e6;
+            }
+        }
+        return out;
+    }
+
+    void publish(const ClockEstimate &estimate) {
+        const uint64_t seq = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        synced_.store(estimate.synced, std::memory_order_relaxed);
+        offset_us_.store(estimate.offset_us, std::memory_order_relaxed);
+        anchor_us_.store(estimate.anchor_us, std::memory_order_relaxed);
+        drift_ppm_.store(estimate.drift_ppm, std::memory_order_relaxed);
+        error_us_.store(estimate.error_us, std::memory_order_relaxed);
+        min_rtt_us_.store(estimate.min_rtt_us, std::memory_order_relaxed);
+        sequence_.store(seq + 2, std::memory_order_release);
+    }
+
+    std::mutex mutex_;
+    std::array<Point, WINDOW> points_{};
+    std::size_t first_ = 0;
+    std::size_t count_ = 0;
+    ClockEstimate fitted_;
+    ExchangeClockStats stats_;
+
+    // Seqlock: odd while publish() is inside
+    std::atomic<uint64_t> sequence_{0};
+    std::atomic<bool> synced_{false};
+    std::atomic<int64_t> offset_us_{0};
+    std::atomic<uint64_t> anchor_us_{0};
+    std::atomic<double> drift_ppm_{0.0};
+    std::atomic<uint64_t> error_us_{0};
+    std::atomic<uint64_t> min_rtt_us_{0};
+};
+
+inline ExchangeClock &exchange_clock() {
+    static ExchangeClock clock;
+    return clock;
+}
+
+// The WebSocket API connection ClockSync uses by default: SBE responses,
+// with server times in microseconds
+inline WsApiConfig clock_sync_api_config() {
+    WsApiConfig api;
+    api.path += "&timeUnit=MICROSECOND";
+    api.max_in_flight = 1;
+    api.response_timeout_ms = 2000;
+    return api;
+}
+
+struct ClockSyncConfig {
+    WsApiConfig api = clock_sync_api_config();
+    int interval_ms = 30000;
+    // Round trips per sync; the fastest becomes the sample
+    int burst = 8;
+    // Pause before reconnecting after a failed sync
+    int retry_delay_ms = 1000;
+    std::string method = "time";
+    int64_t weight = 1;
+};
+
+// Written by the syncing thread, readable from any thread
+struct ClockSyncStats {
+    std::atomic<uint64_t> syncs{0};
+    std::atomic<uint64_t> round_trips{0};
+    // Syncs without a usable round trip (connection errors, timeouts,
+    // error answers)
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> connects{0};
+};
+
+class ClockSync {
+public:
+    // One round trip, or nothing if it failed; the default is a `time`
+    // request on ClockSync's own WsApiClient
+    using Probe = std::function<std::optional<ClockSample>()>;
+
+    explicit ClockSync(ClockSyncConfig config, ExchangeClock &clock = exchange_clock(), Probe probe = {})
+        : config_(std::move(config)), clock_(clock), probe_(std::move(probe)) {
+        if (config_.burst < 1 || config_.interval_ms < 1) {
+            throw std::invalid_argument("ClockSync needs a burst of at least 1 and a positive interval");
+        }
+        if (!probe_) {
+            client_ = std::make_unique<WsApiClient>(config_.api);
+        }
+        metrics_.publish([this](MetricsWriter &out) { write_metrics(out); });
+    }
+
+    ~ClockSync() { stop(); }
+
+    ClockSync(const ClockSync &) = delete;
+    ClockSync &operator=(const ClockSync &) = delete;
+
+    // Sync now and then every interval_ms on a background thread
+    void start() {
+        std::lock_guard lock(mutex_);
+        if (thread_.joinable()) {
+            return;
+        }
+        stopping_ = false;
+        thread_ = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        {
+            std::lock_guard lock(mutex_);
+            if (!thread_.joinable()) {
+                return;
+            }
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+        if (client_) {
+            client_->close();
+        }
+    }
+
+    bool running() const {
+        std::lock_guard lock(mutex_);
+        return thread_.joinable() && !stopping_;
+    }
+
+    // One burst on the calling thread; true when it gave the clock a sample.
+    // Not to be mixed with a running start().
+    bool sync() {
+        std::optional<ClockSample> best;
+        for (int i = 0; i < config_.burst; ++i) {
+            std::optional<ClockSample> sample;
+            try {
+                sample = probe_ ? probe_() : round_trip();
+            } catch (const std::exception &e) {
+                set_error(e.what());
+                if (client_) {
+                    client_->close();
+                }
+                break;
+            }
+            if (!sample) {
+                continue;
+            }
+            stats_.round_trips.fetch_add(1, std::memory_order_relaxed);
+            if (!best || sample->received_us - sample->sent_us < best->received_us - best->sent_us) {
+                best = sample;
+            }
+        }
+        stats_.syncs.fetch_add(1, std::memory_order_relaxed);
+        if (!best || !clock_.add(*best)) {
+            stats_.failures.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    const ClockSyncConfig &config() const { return config_; }
+    const ClockSyncStats &stats() const { return stats_; }
+    const ExchangeClock &clock() const { return clock_; }
+
+    std::string last_error() const {
+        std::lock_guard lock(mutex_);
+        return last_error_;
+    }
+
+private:
+    void run() {
+        while (true) {
+            const bool ok = sync();
+            std::unique_lock lock(mutex_);
+            const int wait_ms = ok ? config_.interval_ms : std::min(config_.retry_delay_ms, config_.interval_ms);
+            wake_.wait_for(lock, std::chrono::milliseconds(wait_ms), [this] { return stopping_; });
+            if (stopping_) {
+                return;
+            }
+        }
+    }
+
+    // A `time` request and its answer. The send time is the client's own
+    // (WsApiResponse::latency_us), so a wait for the rate governor does not
+    // count towards the round trip.
+    std::optional<ClockSample> round_trip() {
+        if (!client_->connected()) {
+            client_->connect();
+            stats_.connects.fetch_add(1, std::memory_order_relaxed);
+        }
+        const uint64_t id = client_->submit(config_.method, "", config_.weight);
+        using Clock = std::chrono::steady_clock;
+        const auto deadline = Clock::now() + std::chrono::milliseconds(config_.api.response_timeout_ms);
+        while (true) {
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+            if (left.count() <= 0) {
+                // The request stays pending; drop the connection so its slot frees up
+                throw std::runtime_error("ClockSync: no answer to " + config_.method + " in time");
+            }
+            std::optional<WsApiResponse> response = client_->receive(static_cast<int>(left.count()));
+            const uint64_t received_us = ingest_time_us();
+            if (!response || response->request_id != id) {
+                continue;
+            }
+            if (response->json || response->status() != 200) {
+                set_error("ClockSync: " + config_.method + " answered with status " +
+                          std::to_string(response->status()));
+                return std::nullopt;
+            }
+            const auto [server_us, resolution_us] = server_time_us(response->result());
+            ClockSample sample;
+            sample.received_us = received_us;
+            sample.sent_us = received_us - std::min<uint64_t>(static_cast<uint64_t>(response->latency_us), received_us);
+            sample.server_us = server_us;
+            sample.resolution_us = resolution_us;
+            return sample;
+        }
+    }
+
+    void set_error(std::string error) {
+        std::lock_guard lock(mutex_);
+        last_error_ = std::move(error);
+    }
+
+    void write_metrics(MetricsWriter &out) const {
+        using Type = MetricType;
+        const MetricLabels labels = {{"clock_sync", metrics_.instance()}};
+        const auto counter = [&](std::string_view family, std::string_view help, const std::atomic<uint64_t> &v) {
+            out.sample(family, Type::Counter, help, labels, v.load(std::memory_order_relaxed));
+        };
+        counter("sbe_clock_syncs_total", "Round-trip bursts to the exchange's time endpoint", stats_.syncs);
+        counter("sbe_clock_round_trips_total", "Round trips answered with a server time", stats_.round_trips);
+        counter("sbe_clock_sync_failures_total", "Bursts without a usable round trip", stats_.failures);
+        counter("sbe_clock_samples_total", "Samples the offset estimate took", clock_.stats().samples);
+        counter("sbe_clock_steps_total", "Times a clock stepped and the estimate restarted", clock_.stats().steps);
+        const ClockEstimate estimate = clock_.estimate();
+        if (!estimate.synced) {
+            return;
+        }
+        out.sample("sbe_clock_offset_microseconds", Type::Gauge, "Exchange clock minus local clock", labels,
+                   static_cast<double>(estimate.offset_at(ingest_time_us())));
+        out.sample("sbe_clock_drift_ppm", Type::Gauge, "Exchange clock rate minus local clock rate", labels,
+                   estimate.drift_ppm);
+        out.sample("sbe_clock_error_microseconds", Type::Gauge, "Bound on the offset estimate's error", labels,
+                   estimate.error_us);
+        out.sample("sbe_clock_min_rtt_microseconds", Type::Gauge, "Fastest round trip in the estimate's window",
+                   labels, estimate.min_rtt_us);
+    }
+
+    const ClockSyncConfig config_;
+    ExchangeClock &clock_;
+    const Probe probe_;
+    std::unique_ptr<WsApiClient> client_;
+    ClockSyncStats stats_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::string last_error_;
+    std::thread thread_;
+    MetricsRegistration metrics_;
+};
+
+#endif
@@ -0,0 +1,439 @@
+/*
+ * Fused assembly of model inputs from published feature vectors.
+ *
+ * The model reads one float vector per symbol: features of several streams
+ * (e.g. "trade" and "bestBidAsk"), in the order it was trained on, each
+ * scaled as in training. Building that in Python costs a dict lookup, a
+ * float and a scaler call per feature on every prediction. A
+ * FeatureManifest, exported by the trainer, fixes the layout once:
+ *
+ *   sources  the streams the inputs come from: name (the bus key suffix),
+ *            schema hash (feature_schema_hash over its feature names, 0 to
+ *            skip the check) and vector width
+ *   inputs   per model input, in model order: its source, its index in the
+ *            source's vector, its scaling (none, standard (x - mean) / std
+ *            or min-max (x - min) / (max - min)) and a fill value
+ *
+ * compile() resolves feature names to indices, so names are looked up when
+ * a model is loaded and never per prediction. A FeatureAssembler folds each
+ * scaling into x * mul + add and writes a row of model inputs in one pass
+ * per source, straight from the source's FeatureBus slot (inside the
+ * slot's seqlock read) or from a binary feature record's value bytes. A
+ * missing source, a source of another schema and a value that is not
+ * finite all give the input's fill value (0 is the training mean under
+ * standard scaling) and are counted.
+ *
+ * Scaling lives in the manifest, so a model fed by an assembler is saved
+ * without its own input scaler. Manifest files are little-endian:
+ *
+ *   magic "BTCFMAN1", uint32 version, uint32 source count, uint32 input
+ *   count, uint32 reserved, then per source: uint64 schema hash, uint32
+ *   width, uint16 name length, name bytes; then per input: uint32 source,
+ *   uint32 index, uint8 scaling, 3 reserved bytes, float32 a, float32 b,
+ *   float32 fill, where (a, b) is (mean, std) or (min, max)
+ *
+ * An assembler keeps scratch state and counters: not thread-safe.
+ */
+
+#ifndef _SBE_FEATURE_ASSEMBLER_H_
+#define _SBE_FEATURE_ASSEMBLER_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "feature_bus.h"
+#include "feature_record.h"
+#include "float_bits.h"
+
+static_assert(std::endian::native == std::endian::little, "feature manifests are read in host byte order");
+
+constexpr char FEATURE_MANIFEST_MAGIC[8] = {'B', 'T', 'C', 'F', 'M', 'A', 'N', '1'};
+constexpr uint32_t FEATURE_MANIFEST_VERSION = 1;
+
+enum class FeatureScaling : uint8_t {
+    None = 0,
+    // (x - a) / b with (a, b) = (mean, std)
+    Standard = 1,
+    // (x - a) / (b - a) with (a, b) = (min, max)
+    MinMax = 2,
+};
+
+struct FeatureSource {
+    std::string name;
+    uint64_t schema_hash = 0;
+    uint32_t width = 0;
+};
+
+struct FeatureInput {
+    uint32_t source = 0;
+    uint32_t index = 0;
+    FeatureScaling scaling = FeatureScaling::None;
+    float a = 0;
+    float b = 1;
+    // Written for a missing source or a value that is not finite
+    float fill = 0;
+};
+
+// A source by its feature names, and an input by its source's and its
+// feature's name, for FeatureManifest::compile
+struct FeatureSourceLayout {
+    std::string name;
+    std::vector<std::string> features;
+};
+
+struct NamedFeatureInput {
+    std::string source;
+    std::string feature;
+    FeatureScaling scaling = FeatureScaling::None;
+    float a = 0;
+    float b = 1;
+    float fill = 0;
+};
+
+class FeatureManifest {
+public:
+    FeatureManifest(std::vector<FeatureSource> sources, std::vector<FeatureInput> inputs)
+        : sources_(std::move(sources)), inputs_(std::move(inputs)) {
+        if (sources_.empty() || inputs_.empty()) {
+            throw std::runtime_error("feature manifest: at least one source and one input are required");
+        }
+        for (const FeatureSource &source : sources_) {
+            if (source.name.empty() || source.name.size() > UINT16_MAX || source.width == 0) {
+                throw std::runtime_error("feature manifest: every source needs a name and a width");
+            }
+        }
+        for (std::size_t i = 0; i < inputs_.size(); ++i) {
+            const FeatureInput &input = inputs_[i];
+            if (input.source >= sources_.size() || input.index >= sources_[input.source].width) {
+                throw std::runtime_error("feature manifest: input " + std::to_string(i) + " is out of range");
+            }
+            if (input.scaling > FeatureScaling::MinMax) {
+                throw std::runtime_error("feature manifest: input " + std::to_string(i) + " has unknown scaling");
+            }
+        }
+    }
+
+    // Resolve named inputs against the sources' feature names; each
+    // source's schema hash is taken from its names
+    static FeatureManifest compile(const std::vector<FeatureSourceLayout> &layouts,
+                                   const std::vector<NamedFeatureInput> &named) {
+        std::vector<FeatureSource> sources;
+        std::unordered_map<std::string, uint32_t> source_of;
+        std::vector<std::unordered_map<std::string, uint32_t>> index_of(layouts.size());
+        for (uint32_t s = 0; s < layouts.size(); ++s) {
+            const FeatureSourceLayout &layout = layouts[s];
+            if (!source_of.emplace(layout.name, s).second) {
+                throw std::runtime_error("feature manifest: source '" + layout.name + "' given twice");
+            }
+            for (uint32_t i = 0; i < layout.features.size(); ++i) {
+                index_of[s].emplace(layout.features[i], i);
+            }
+            sources.push_back({layout.name, feature_schema_hash(layout.features),
+                               static_cast<uint32_t>(layout.features.size())});
+        }
+        std::vector<FeatureInput> inputs;
+        inputs.reserve(named.size());
+        for (const NamedFeatureInput &input : named) {
+            const auto source = source_of.find(input.source);
+            if (source == source_of.end()) {
+                throw std::runtime_error("feature manifest: unknown source '" + input.source + "'");
+            }
+            const auto index = index_of[source->second].find(input.feature);
+            if (index == index_of[source->second].end()) {
+                throw std::runtime_error("feature manifest: source '" + input.source + "' has no feature '" +
+                                         input.feature + "'");
+            }
+            inputs.push_back({source->second, index->second, input.scaling, input.a, input.b, input.fill});
+        }
+        return FeatureManifest(std::move(sources), std::move(inputs));
+    }
+
+    // Parse a manifest file image (see the top of this file)
+    static FeatureManifest from_bytes(std::span<const char> data) {
+        std::size_t offset = 0;
+        const auto take = [&](void *out, std::size_t n) {
+            if (data.size() - offset < n) {
+                throw std::runtime_error("feature manifest: truncated file");
+            }
+            std::memcpy(out, data.data() + offset, n);
+            offset += n;
+        };
+        char magic[sizeof(FEATURE_MANIFEST_MAGIC)];
+        take(magic, sizeof(magic));
+        if (std::memcmp(magic, FEATURE_MANIFEST_MAGIC, sizeof(magic)) != 0) {
+            throw std::runtime_error("feature manifest: bad magic");
+        }
+        uint32_t header[4];
+        take(header, sizeof(header));
+        if (header[0] != FEATURE_MANIFEST_VERSION) {
+            throw std::runtime_error("feature manifest: unsupported version");
+        }
+        // Counts are checked against the bytes left before anything is
+        // allocated for them
+        const std::size_t left = data.size() - offset;
+        if (header[1] > left / 14 || header[2] > left / 24) {
+            throw std::runtime_error("feature manifest: truncated file");
+        }
+        std::vector<FeatureSource> sources(header[1]);
+        for (FeatureSource &source : sources) {
+            uint16_t length;
+            take(&source.schema_hash, sizeof(source.schema_hash));
+            take(&source.width, sizeof(source.width));
+            take(&length, sizeof(length));
+            source.name.resize(length);
+            take(source.name.data(), length);
+        }
+        std::vector<FeatureInput> inputs(header[2]);
+        for (FeatureInput &input : inputs) {
+            uint8_t scaling[4];
+            take(&input.source, sizeof(input.source));
+            take(&input.index, sizeof(input.index));
+            take(scaling, sizeof(scaling));
+            input.scaling = static_cast<FeatureScaling>(scaling[0]);
+            take(&input.a, sizeof(input.a));
+            take(&input.b, sizeof(input.b));
+            take(&input.fill, sizeof(input.fill));
+        }
+        if (offset != data.size()) {
+            throw std::runtime_error("feature manifest: trailing bytes");
+        }
+        return FeatureManifest(std::move(sources), std::move(inputs));
+    }
+
+    static FeatureManifest load(const std::string &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open feature manifest " + path + ": " + std::strerror(errno));
+        }
+        std::vector<char> data;
+        char buf[1 << 16];
+        ssize_t n;
+        while ((n = ::read(fd, buf, sizeof(buf))) > 0) {
+            data.insert(data.end(), buf, buf + n);
+        }
+        const int error = errno;
+        ::close(fd);
+        if (n < 0) {
+            throw std::runtime_error("cannot read feature manifest " + path + ": " + std::strerror(error));
+        }
+        return from_bytes(data);
+    }
+
+    // The manifest file image
+    std::vector<char> to_bytes() const {
+        std::vector<char> out;
+        const auto put = [&out](const void *data, std::size_t n) {
+            const std::size_t at = out.size();
+            out.resize(at + n);
+            std::memcpy(out.data() + at, data, n);
+        };
+        const uint32_t header[4] = {FEATURE_MANIFEST_VERSION, static_cast<uint32_t>(sources_.size()),
+                                    static_cast<uint32_t>(inputs_.size()), 0};
+        put(FEATURE_MANIFEST_MAGIC, sizeof(FEATURE_MANIFEST_MAGIC));
+        put(header, sizeof(header));
+        for (const FeatureSource &source : sources_) {
+            const auto length = static_cast<uint16_t>(source.name.size());
+            put(&source.schema_hash, sizeof(source.schema_hash));
+            put(&source.width, sizeof(source.width));
+            put(&length, sizeof(length));
+            put(source.name.data(), length);
+        }
+        for (const FeatureInput &input : inputs_) {
+            const uint8_t scaling[4] = {static_cast<uint8_t>(input.scaling), 0, 0, 0};
+            put(&input.source, sizeof(input.source));
+            put(&input.index, sizeof(input.index));
+            put(scaling, sizeof(scaling));
+            put(&input.a, sizeof(input.a));
+            put(&input.b, sizeof(input.b));
+            put(&input.fill, sizeof(input.fill));
+        }
+        return out;
+    }
+
+    const std::vector<FeatureSource> &sources() const { return sources_; }
+    const std::vector<FeatureInput> &inputs() const { return inputs_; }
+
+private:
+    std::vector<FeatureSource> sources_;
+    std::vector<FeatureInput> inputs_;
+};
+
+struct FeatureAssemblyStats {
+    uint64_t rows = 0;
+    // Source reads that found no vector
+    uint64_t missing = 0;
+    // Source reads that found a vector of another schema or width
+    uint64_t schema_mismatches = 0;
+    // Values that were not finite
+    uint64_t filled = 0;
+};
+
+class FeatureAssembler {
+public:
+    explicit FeatureAssembler(FeatureManifest manifest) : manifest_(std::move(manifest)) {
+        const auto &inputs = manifest_.inputs();
+        for (uint32_t position = 0; position < inputs.size(); ++position) {
+            const FeatureInput &input = inputs[position];
+            double mul = 1;
+            double add = 0;
+            // A zero spread (a constant feature) passes the centred value
+            // through, as MlpModel's own scaler does
+            if (input.scaling == FeatureScaling::Standard) {
+                mul = input.b != 0 ? 1.0 / input.b : 1.0;
+                add = -input.a * mul;
+            } else if (input.scaling == FeatureScaling::MinMax) {
+                mul = input.b != input.a ? 1.0 / (double{input.b} - input.a) : 1.0;
+                add = -input.a * mul;
+            }
+            steps_.push_back({input.source, input.index, position, mul, add, input.fill});
+        }
+        // Each source's inputs together, read in vector order
+        std::sort(steps_.begin(), steps_.end(), [](const Step &x, const Step &y) {
+            return x.source != y.source ? x.source < y.source : x.index < y.index;
+        });
+        const std::size_t sources = manifest_.sources().size();
+        source_begin_.assign(sources + 1, 0);
+        for (const Step &step : steps_) {
+            ++source_begin_[step.source + 1];
+        }
+        for (std::size_t s = 0; s < sources; ++s) {
+            source_begin_[s + 1] += source_begin_[s];
+        }
+    }
+
+    // Model inputs per row
+    std::size_t width() const { return steps_.size(); }
+    const FeatureManifest &manifest() const { return manifest_; }
+    const FeatureAssemblyStats &stats() const { return stats_; }
+
+    // One row from `symbol`'s slots ("<symbol>:<source>") of the bus into
+    // out[width()]; returns the newest event time found, 0 for none
+    int64_t assemble(FeatureBus &bus, std::string_view symbol, float *out) {
+        int64_t event_ts_us = 0;
+        const auto &sources = manifest_.sources();
+        for (std::size_t s = 0; s < sources.size(); ++s) {
+            key_.assign(symbol);
+            key_ += ':';
+            key_ += sources[s].name;
+            bool matched = false;
+            uint64_t filled = 0;
+            const bool found = bus.visit_latest(key_, [&](const FeatureBus::EntryView &entry) {
+                matched = matches(sources[s], entry.schema_hash(), entry.count);
+                if (matched) {
+                    event_ts_us = std::max(event_ts_us, entry.event_ts_us());
+                    filled = gather(s, entry, out);
+                }
+            });
+            finish_source(s, found, matched, filled, out);
+        }
+        ++stats_.rows;
+        return event_ts_us;
+    }
+
+    // One row from binary feature records, one per manifest source (empty
+    // for a missing one); a malformed record throws
+    int64_t assemble(std::span<const std::span<const char>> records, float *out) {
+        if (records.size() != manifest_.sources().size()) {
+            throw std::runtime_error("FeatureAssembler: expected one record per source");
+        }
+        int64_t event_ts_us = 0;
+        for (std::size_t s = 0; s < records.size(); ++s) {
+            const bool found = !records[s].empty();
+            bool matched = false;
+            uint64_t filled = 0;
+            if (found) {
+                const FeatureRecordHeader header = decode_feature_record_header(records[s]);
+                matched = matches(manifest_.sources()[s], header.schema_hash, header.count);
+                if (matched) {
+                    event_ts_us = std::max(event_ts_us, header.event_ts_us);
+                    const char *values = records[s].data() + FEATURE_RECORD_HEADER_SIZE;
+                    filled = header.value_type == FeatureValueType::Float32
+                                 ? gather(s, RecordValues<float>{values}, out)
+                                 : gather(s, RecordValues<double>{values}, out);
+                }
+            }
+            finish_source(s, found, matched, filled, out);
+        }
+        ++stats_.rows;
+        return event_ts_us;
+    }
+
+    void reset_stats() { stats_ = {}; }
+
+private:
+    struct Step {
+        uint32_t source;
+        uint32_t index;
+        // Place in the row
+        uint32_t position;
+        double mul;
+        double add;
+        float fill;
+    };
+
+    // Unaligned values of a feature record
+    template <typename T>
+    struct RecordValues {
+        const char *at;
+        double operator[](std::size_t i) const {
+            T value;
+            std::memcpy(&value, at + i * sizeof(T), sizeof(T));
+            return value;
+        }
+    };
+
+    static bool matches(const FeatureSource &source, uint64_t schema_hash, std::size_t count) {
+        return (source.schema_hash == 0 || source.schema_hash == schema_hash) && count == source.width;
+    }
+
+    // Scale source `s`'s inputs out of `values` into the row; returns the
+    // values that were not finite
+    template <typename Values>
+    uint64_t gather(std::size_t s, const Values &values, float *out) const {
+        uint64_t filled = 0;
+        for (std::size_t i = source_begin_[s]; i < source_begin_[s + 1]; ++i) {
+            const Step &step = steps_[i];
+            const double x = values[step.index];
+            if (finite_bits(x)) {
+                out[step.position] = static_cast<float>(x * step.mul + step.add);
+            } else {
+                out[step.position] = step.fill;
+                ++filled;
+            }
+        }
+        return filled;
+    }
+
+    void finish_source(std::size_t s, bool found, bool matched, uint64_t filled, float *out) {
+        if (!matched) {
+            for (std::size_t i = source_begin_[s]; i < source_begin_[s + 1]; ++i) {
+                out[steps_[i].position] = steps_[i].fill;
+            }
+            ++(found ? stats_.schema_mismatches : stats_.missing);
+        }
+        stats_.filled += filled;
+    }
+
+    FeatureManifest manifest_;
+    // Inputs grouped by source; source s owns [source_begin_[s], source_begin_[s + 1])
+    std::vector<Step> steps_;
+    std::vector<std::size_t> source_begin_;
+    // Bus key of the source being read
+    std::string key_;
+    FeatureAssemblyStats stats_;
+};
+
+#endif
@@ -0,0 +1,409 @@
+/*
+ * Shared-memory feature bus between a co-located aggregator and inference.
+ *
+ * Going through Redis costs a network round trip per prediction even when
+ * both services share a host. A FeatureBus is a file (normally under
+ * /dev/shm) mapped MAP_SHARED by one writer and any number of readers. It
+ * holds a fixed number of slots, one per feature stream key (e.g.
+ * "BTCUSDT:trade"), and each slot keeps the last `history` feature vectors
+ * in a ring.
+ *
+ * Every slot is guarded by a seqlock: the writer makes the slot's sequence
+ * odd, writes the entry, and makes it even again. A reader copies what it
+ * needs and retries if the sequence was odd or changed underneath it, so
+ * readers never block the writer or each other and take no locks. All
+ * shared words are accessed through std::atomic_ref, which keeps the
+ * copy-then-validate pattern free of data races. Redis stays the cross-host
+ * and recovery path; the bus only holds the latest values.
+ *
+ * Layout: a 64-byte FeatureBusHeader, then `slots` slots of slot_size
+ * bytes. A slot is a 64-byte FeatureBusSlotHeader followed by `history`
+ * entries, each [event_ts_us, schema_hash, count, value...] as 64-bit words
+ * with room for `capacity` values.
+ */
+
+#ifndef _SBE_FEATURE_BUS_H_
+#define _SBE_FEATURE_BUS_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "stream_decode.h"
+
+constexpr char FEATURE_BUS_MAGIC[8] = {'B', 'T', 'C', 'F', 'B', 'U', 'S', '1'};
+constexpr uint32_t FEATURE_BUS_VERSION = 1;
+
+struct FeatureBusHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t slots;
+    uint32_t capacity;
+    uint32_t history;
+    uint32_t slot_size;
+    // Slots handed out so far; published after the slot's key
+    uint32_t slots_used;
+    char padding[28];
+};
+static_assert(sizeof(FeatureBusHeader) == 64);
+
+struct FeatureBusSlotHeader {
+    // NUL-padded stream key
+    char key[32];
+    // Seqlock: odd while the writer is inside the slot
+    uint64_t sequence;
+    // Entries written so far; the newest is at (written - 1) % history
+    uint64_t written;
+    char padding[16];
+};
+static_assert(sizeof(FeatureBusSlotHeader) == 64);
+
+// One feature vector read back from the bus
+struct FeatureBusEntry {
+    int64_t event_ts_us = 0;
+    uint64_t schema_hash = 0;
+    std::vector<double> values;
+};
+
+class FeatureBus {
+public:
+    static constexpr std::size_t KEY_SIZE = sizeof(FeatureBusSlotHeader::key);
+    // Entry words before the values
+    static constexpr std::size_t ENTRY_HEADER_WORDS = 3;
+
+    // Reads that may find the same odd sequence before the reader decides
+    // the writer died mid-write
+    static constexpr std::size_t MAX_STUCK_READS = std::size_t{1} << 24;
+
+    // Create (or replace) the segment at `path` as its writer. The new file
+    // is built beside `path` and renamed over it, so readers still mapping
+    // an old segment keep a valid (if stale) one.
+    static FeatureBus create(const std::string &path, uint32_t slots, uint32_t capacity, uint32_t history) {
+        if (slots == 0 || capacity == 0 || history == 0) {
+            throw std::runtime_error("FeatureBus: slots, capacity and history must be positive");
+        }
+        const std::size_t entry_words = ENTRY_HEADER_WORDS + capacity;
+        const std::size_t slot_size = sizeof(FeatureBusSlotHeader) + history * entry_words * sizeof(uint64_t);
+        const std::size_t size = sizeof(FeatureBusHeader) + slots * slot_size;
+
+        const std::string staging = path + ".new";
+        const int fd = ::open(staging.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error(errno_message("cannot create feature bus", staging));
+        }
+        // Reserve the pages up front: running out of space under a shared
+        // mapping would be a SIGBUS rather than an error
+        const int rc = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+        if (rc != 0) {
+            ::close(fd);
+            ::unlink(staging.c_str());
+            throw std::runtime_error("cannot allocate feature bus " + staging + ": " + std::strerror(rc));
+        }
+        FeatureBus bus(path, fd, size, true);
+        auto *header = reinterpret_cast<FeatureBusHeader *>(bus.base_);
+        header->version = FEATURE_BUS_VERSION;
+        header->header_size = sizeof(FeatureBusHeader);
+        header->slots = slots;
+        header->capacity = capacity;
+        header->history = history;
+        header->slot_size = static_cast<uint32_t>(slot_size);
+        // Magic last, so a reader opening mid-create rejects the file
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, FEATURE_BUS_MAGIC, sizeof(FEATURE_BUS_MAGIC));
+        if (::rename(staging.c_str(), path.c_str()) != 0) {
+            const std::string message = errno_message("cannot publish feature bus", path);
+            ::unlink(staging.c_str());
+            throw std::runtime_error(message);
+        }
+        return bus;
+    }
+
+    // Map an existing segment read-only
+    static FeatureBus open(const std::string &path) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error(errno_message("cannot open feature bus", path));
+        }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(FeatureBusHeader)) {
+            ::close(fd);
+            throw std::runtime_error("not a feature bus: " + path);
+        }
+        FeatureBus bus(path, fd, static_cast<std::size_t>(st.st_size), false);
+        const FeatureBusHeader &header = bus.header();
+        if (std::memcmp(header.magic, FEATURE_BUS_MAGIC, sizeof(FEATURE_BUS_MAGIC)) != 0 ||
+            header.version != FEATURE_BUS_VERSION || header.header_size != sizeof(FeatureBusHeader) ||
+            sizeof(FeatureBusHeader) + std::size_t{header.slots} * header.slot_size > bus.size_) {
+            throw std::runtime_error("not a feature bus: " + path);
+        }
+        return bus;
+    }
+
+    FeatureBus(FeatureBus &&other) noexcept { *this = std::move(other); }
+    FeatureBus &operator=(FeatureBus &&other) noexcept {
+        if (this != &other) {
+            unmap();
+            path_ = std::move(other.path_);
+            fd_ = std::exchange(other.fd_, -1);
+            base_ = std::exchange(other.base_, nullptr);
+            size_ = other.size_;
+            writable_ = other.writable_;
+            slot_of_ = std::move(other.slot_of_);
+        }
+        return *this;
+    }
+    FeatureBus(const FeatureBus &) = delete;
+    FeatureBus &operator=(const FeatureBus &) = delete;
+    ~FeatureBus() { unmap(); }
+
+    // Writer side --------------------------------------------------------
+
+    // Write one vector to `key`'s slot, claiming a slot on first use.
+    // Returns false when every slot is taken by other keys.
+    bool publish(std::string_view key, int64_t event_ts_us, uint64_t schema_hash, const double *values,
+                 std::size_t count) {
+        if (!writable_) {
+            throw std::runtime_error("FeatureBus: opened read-only");
+        }
+        if (count > header().capacity) {
+            throw std::runtime_error("FeatureBus: more values than the bus capacity");
+        }
+        const int64_t index = claim(key);
+        if (index < 0) {
+            return false;
+        }
+        auto *slot = slot_header(static_cast<std::size_t>(index));
+        std::atomic_ref<uint64_t> sequence(slot->sequence);
+        const uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        const uint64_t written = slot->written;
+        uint64_t *entry = entry_words(static_cast<std::size_t>(index), written % header().history);
+        store(entry[0], std::bit_cast<uint64_t>(event_ts_us));
+        store(entry[1], schema_hash);
+        store(entry[2], count);
+        for (std::size_t i = 0; i < count; ++i) {
+            store(entry[ENTRY_HEADER_WORDS + i], std::bit_cast<uint64_t>(values[i]));
+        }
+        store(slot->written, written + 1);
+
+        sequence.store(seq + 2, std::memory_order_release);
+        return true;
+    }
+
+    // Reader side --------------------------------------------------------
+
+    // Up to `max_entries` of `key`'s vectors, newest first; empty when the
+    // key has no slot yet
+    std::vector<FeatureBusEntry> read(std::string_view key, std::size_t max_entries = 1) {
+        const int64_t index = find(key);
+        if (index < 0 || max_entries == 0) {
+            return {};
+        }
+        const FeatureBusHeader &bus = header();
+        std::vector<FeatureBusEntry> entries;
+        read_consistent(static_cast<std::size_t>(index), key, [&](const FeatureBusSlotHeader &slot) {
+            const uint64_t written = load(slot.written);
+            const std::size_t n = static_cast<std::size_t>(std::min<uint64_t>({written, bus.history, max_entries}));
+            entries.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                const EntryView entry = entry_view(static_cast<std::size_t>(index), written - 1 - i);
+                FeatureBusEntry &out = entries[i];
+                out.event_ts_us = entry.event_ts_us();
+                out.schema_hash = entry.schema_hash();
+                out.values.resize(entry.count);
+                for (std::size_t v = 0; v < entry.count; ++v) {
+                    out.values[v] = entry[v];
+                }
+            }
+        });
+        return entries;
+    }
+
+    // One entry read in place from the mapping; only valid inside
+    // visit_latest's callback
+    struct EntryView {
+        const uint64_t *words = nullptr;
+        std::size_t count = 0;
+
+        int64_t event_ts_us() const { return std::bit_cast<int64_t>(load(words[0])); }
+        uint64_t schema_hash() const { return load(words[1]); }
+        double operator[](std::size_t i) const { return std::bit_cast<double>(load(words[ENTRY_HEADER_WORDS + i])); }
+    };
+
+    // Run fn(const EntryView &) on `key`'s newest entry without copying it
+    // out; false when the key has none. fn runs again whenever the writer
+    // got in the way, so it must only write what a rerun overwrites.
+    template <typename Fn>
+    bool visit_latest(std::string_view key, Fn &&fn) {
+        const int64_t index = find(key);
+        if (index < 0) {
+            return false;
+        }
+        bool found = false;
+        read_consistent(static_cast<std::size_t>(index), key, [&](const FeatureBusSlotHeader &slot) {
+            const uint64_t written = load(slot.written);
+            found = written > 0;
+            if (found) {
+                fn(entry_view(static_cast<std::size_t>(index), written - 1));
+            }
+        });
+        return found;
+    }
+
+    // Keys with a slot, in claim order
+    std::vector<std::string> keys() const {
+        std::vector<std::string> result;
+        const uint32_t used = slots_used();
+        for (uint32_t i = 0; i < used; ++i) {
+            const char *key = slot_header(i)->key;
+            result.emplace_back(key, strnlen(key, KEY_SIZE));
+        }
+        return result;
+    }
+
+    const FeatureBusHeader &header() const { return *reinterpret_cast<const FeatureBusHeader *>(base_); }
+    const std::string &path() const { return path_; }
+    bool writable() const { return writable_; }
+
+private:
+    FeatureBus(std::string path, int fd, std::size_t size, bool writable)
+        : path_(std::move(path)), fd_(fd), size_(size), writable_(writable) {
+        void *base = ::mmap(nullptr, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd_);
+            fd_ = -1;
+            throw std::runtime_error(errno_message("cannot map feature bus", path_));
+        }
+        base_ = static_cast<char *>(base);
+    }
+
+    static std::string errno_message(const std::string &what, const std::string &path) {
+        return what + " " + path + ": " + std::strerror(errno);
+    }
+
+    // Plain words of the mapping, read and written without tearing
+    static uint64_t load(const uint64_t &word) {
+        return std::atomic_ref<uint64_t>(const_cast<uint64_t &>(word)).load(std::memory_order_relaxed);
+    }
+    static void store(uint64_t &word, uint64_t value) {
+        std::atomic_ref<uint64_t>(word).store(value, std::memory_order_relaxed);
+    }
+
+    uint32_t slots_used() const {
+        auto &used = const_cast<uint32_t &>(header().slots_used);
+        return std::atomic_ref<uint32_t>(used).load(std::memory_order_acquire);
+    }
+
+    FeatureBusSlotHeader *slot_header(std::size_t index) const {
+        return reinterpret_cast<FeatureBusSlotHeader *>(base_ + sizeof(FeatureBusHeader) +
+                                                        index * header().slot_size);
+    }
+
+    uint64_t *entry_words(std::size_t index, uint64_t position) const {
+        auto *first = reinterpret_cast<uint64_t *>(slot_header(index) + 1);
+        return first + position * (ENTRY_HEADER_WORDS + header().capacity);
+    }
+
+    // Entry number `n` (counting every entry ever written) of a slot
+    EntryView entry_view(std::size_t index, uint64_t n) const {
+        const uint64_t *words = entry_words(index, n % header().history);
+        return {words, static_cast<std::size_t>(std::min<uint64_t>(load(words[2]), header().capacity))};
+    }
+
+    // Run read(slot) until it ran with no write in between, copying
+    // nothing the writer may still change
+    template <typename Read>
+    void read_consistent(std::size_t index, std::string_view key, Read &&read) const {
+        const FeatureBusSlotHeader *slot = slot_header(index);
+        std::atomic_ref<uint64_t> sequence(const_cast<uint64_t &>(slot->sequence));
+        uint64_t busy_sequence = 0;
+        for (std::size_t stuck = 0; stuck < MAX_STUCK_READS;) {
+            const uint64_t before = sequence.load(std::memory_order_acquire);
+            if ((before & 1) != 0) {
+                stuck = before == busy_sequence ? stuck + 1 : 0;
+                busy_sequence = before;
+                continue;
+            }
+            read(*slot);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before) {
+                return;
+            }
+        }
+        throw std::runtime_error("FeatureBus: slot " + std::string(key) + " stayed busy");
+    }
+
+    // Slot of `key`, from the cache or a scan of the claimed slots (keys
+    // never move once claimed); -1 when it has none
+    int64_t find(std::string_view key) {
+        if (const auto found = slot_of_.find(key); found != slot_of_.end()) {
+            return found->second;
+        }
+        const uint32_t used = slots_used();
+        for (uint32_t i = 0; i < used; ++i) {
+            const char *slot_key = slot_header(i)->key;
+            if (std::string_view(slot_key, strnlen(slot_key, KEY_SIZE)) == key) {
+                slot_of_.emplace(key, i);
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int64_t claim(std::string_view key) {
+        if (key.empty() || key.size() > KEY_SIZE) {
+            throw std::runtime_error("FeatureBus: key must be 1 to 32 bytes");
+        }
+        if (const int64_t index = find(key); index >= 0) {
+            return index;
+        }
+        auto &header_words = *reinterpret_cast<FeatureBusHeader *>(base_);
+        const uint32_t used = header_words.slots_used;
+        if (used >= header_words.slots) {
+            return -1;
+        }
+        std::memcpy(slot_header(used)->key, key.data(), key.size());
+        std::atomic_ref<uint32_t>(header_words.slots_used).store(used + 1, std::memory_order_release);
+        slot_of_.emplace(key, used);
+        return used;
+    }
+
+    void unmap() {
+        if (base_ != nullptr) {
+            ::munmap(base_, size_);
+            base_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    char *base_ = nullptr;
+    std::size_t size_ = 0;
+    bool writable_ = false;
+    // Key -> slot index, filled lazily on each side
+    std::unordered_map<std::string, int64_t, SymbolHash, std::equal_to<>> slot_of_;
+};
+
+#endif
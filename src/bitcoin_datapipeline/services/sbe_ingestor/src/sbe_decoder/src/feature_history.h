@@ -0,0 +1,446 @@
+/*
+ * Gorilla-style compressed feature history, appended to one blob per symbol.
+ *
+ * RedisWriter used to keep every feature snapshot as its own JSON key, so
+ * warming a model up on the last hour meant a KEYS scan and one GET per
+ * snapshot, and each ~25-field row cost close to a kilobyte. A history
+ * chunk keeps the numeric features of every snapshot in one blob instead,
+ * compressed the way Gorilla (Pelkonen et al., VLDB 2015) compresses
+ * time series:
+ *
+ *   - timestamps as delta-of-delta: a snapshot on a fixed grid is one bit,
+ *     a small change a 9 to 28-bit code, and a jump a 37 or 69-bit one;
+ *   - values XORed with the same column's previous value: an unchanged
+ *     value is one bit, and a change stores only the meaningful bits of
+ *     the XOR, reusing the previous leading/trailing zero window when the
+ *     bits fit in it.
+ *
+ * The blob is an 8-byte header ("BTCG", uint16 version, uint16 reserved)
+ * and a sequence of byte-aligned records, each opened by a tag byte:
+ *
+ *   0xFF   schema definition: uint64 schema hash, uint32 width, both
+ *          little-endian; it takes the next slot number (from 0)
+ *   slot   a row of that slot's schema: the bit-packed timestamp and
+ *          values, zero-padded to the next byte
+ *
+ * Each slot compresses against its own previous row, so a symbol whose
+ * trade and quote snapshots (two schemas) interleave stays one blob with
+ * two well-compressing series. Because records are byte-aligned and never
+ * rewritten, a writer appends with Redis APPEND and a reader decodes the
+ * whole blob from one GET.
+ *
+ * FeatureHistoryChunk is the writing side: it holds the per-slot state and
+ * returns each append's bytes, the header and schema definition included
+ * when needed. resume() rebuilds that state from an existing blob, e.g.
+ * after a restart. decode_feature_history() is the reading side and merges
+ * several blobs (an older chunk, then the current one) per schema hash.
+ * Neither is thread-safe.
+ */
+
+#ifndef _SBE_FEATURE_HISTORY_H_
+#define _SBE_FEATURE_HISTORY_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static_assert(std::endian::native == std::endian::little, "feature history is written in host byte order");
+
+constexpr char FEATURE_HISTORY_MAGIC[4] = {'B', 'T', 'C', 'G'};
+constexpr uint16_t FEATURE_HISTORY_VERSION = 1;
+constexpr std::size_t FEATURE_HISTORY_HEADER_SIZE = 8;
+constexpr uint8_t FEATURE_HISTORY_DEFINE = 0xFF;
+// Slots per chunk: every tag below FEATURE_HISTORY_DEFINE
+constexpr std::size_t FEATURE_HISTORY_MAX_SLOTS = 255;
+// Widest schema a reader accepts, against corrupt definitions
+constexpr uint32_t FEATURE_HISTORY_MAX_WIDTH = 4096;
+
+// One schema's rows from one or more chunks, oldest first
+struct FeatureHistorySeries {
+    uint64_t schema_hash = 0;
+    uint32_t width = 0;
+    std::vector<int64_t> timestamps_us;
+    // Row-major, width values per row
+    std::vector<double> values;
+
+    std::size_t rows() const { return timestamps_us.size(); }
+};
+
+namespace feature_history_detail {
+
+// MSB-first bits appended to a byte string
+class BitWriter {
+public:
+    explicit BitWriter(std::string &out) : out_(out) {}
+
+    // The low `count` (up to 64) bits of `bits`
+    void write(uint64_t bits, unsigned count) {
+        while (count > 0) {
+            if (used_ == 0) {
+                out_.push_back('\0');
+            }
+            const unsigned room = 8 - used_;
+            const unsigned take = std::min(room, count);
+            const auto part = static_cast<uint8_t>((bits >> (count - take)) & ((1u << take) - 1));
+            out_.back() = static_cast<char>(static_cast<uint8_t>(out_.back()) | part << (room - take));
+            used_ = (used_ + take) % 8;
+            count -= take;
+        }
+    }
+
+    // Zero-pad to the next byte boundary
+    void align() { used_ = 0; }
+
+private:
+    std::string &out_;
+    unsigned used_ = 0;
+};
+
+// MSB-first bits of a byte range; throws when a read runs past the end
+class BitReader {
+public:
+    BitReader(std::span<const char> data, std::size_t offset) : data_(data), bit_(offset * 8) {}
+
+    uint64_t read(unsigned count) {
+        if (count == 0) {
+            return 0;
+        }
+        if (count > 56) {
+            const uint64_t high = read(count - 32);
+            return high << 32 | read(32);
+        }
+        if (bit_ + count > data_.size() * 8) {
+            throw std::runtime_error("feature history: truncated record");
+        }
+        const uint64_t window = peek() << (bit_ % 8);
+        bit_ += count;
+        return window >> (64 - count);
+    }
+
+    bool read_bit() { return read(1) != 0; }
+
+    // Skip the padding to the next byte boundary
+    void align() { bit_ = (bit_ + 7) / 8 * 8; }
+
+    std::size_t byte_offset() const { return bit_ / 8; }
+    bool at_end() const { return bit_ >= data_.size() * 8; }
+
+private:
+    // Eight bytes from the current byte, big-endian, zero past the end
+    uint64_t peek() const {
+        const std::size_t byte = bit_ / 8;
+        uint64_t word = 0;
+        if (byte + 8 <= data_.size()) {
+            std::memcpy(&word, data_.data() + byte, sizeof(word));
+            return __builtin_bswap64(word);
+        }
+        for (std::size_t i = 0; i < 8; ++i) {
+            word <<= 8;
+            if (byte + i < data_.size()) {
+                word |= static_cast<uint8_t>(data_[byte + i]);
+            }
+        }
+        return word;
+    }
+
+    std::span<const char> data_;
+    std::size_t bit_;
+};
+
+// Previous row of one slot, which the next row is coded against
+struct SlotState {
+    uint64_t schema_hash = 0;
+    uint32_t width = 0;
+    uint64_t rows = 0;
+    int64_t last_ts_us = 0;
+    int64_t last_delta_us = 0;
+    std::vector<uint64_t> last_bits;
+    // Leading/trailing zero window of each column's last stored XOR;
+    // 0xFF until there is one
+    std::vector<uint8_t> leading;
+    std::vector<uint8_t> trailing;
+
+    SlotState(uint64_t hash, uint32_t columns)
+        : schema_hash(hash), width(columns), last_bits(columns), leading(columns, 0xFF), trailing(columns, 0xFF) {}
+};
+
+// Delta-of-delta code classes: prefix, prefix length, value bits
+struct DodClass {
+    uint8_t prefix;
+    uint8_t prefix_bits;
+    uint8_t value_bits;
+};
+
+constexpr DodClass DOD_CLASSES[] = {{0b10, 2, 7}, {0b110, 3, 12}, {0b1110, 4, 24}, {0b11110, 5, 32}};
+
+inline void write_dod(BitWriter &out, int64_t dod) {
+    if (dod == 0) {
+        out.write(0, 1);
+        return;
+    }
+    for (const DodClass &code : DOD_CLASSES) {
+        const int64_t bound = int64_t{1} << (code.value_bits - 1);
+        if (dod >= -bound && dod < bound) {
+            out.write(code.prefix, code.prefix_bits);
+            out.write(static_cast<uint64_t>(dod), code.value_bits);
+            return;
+        }
+    }
+    out.write(0b11111, 5);
+    out.write(static_cast<uint64_t>(dod), 64);
+}
+
+inline int64_t read_dod(BitReader &in) {
+    if (!in.read_bit()) {
+        return 0;
+    }
+    for (const DodClass &code : DOD_CLASSES) {
+        if (!in.read_bit()) {
+            const unsigned shift = 64 - code.value_bits;
+            return static_cast<int64_t>(in.read(code.value_bits) << shift) >> shift;
+        }
+    }
+    return static_cast<int64_t>(in.read(64));
+}
+
+inline void write_row(BitWriter &out, SlotState &slot, int64_t ts_us, const double *values) {
+    if (slot.rows == 0) {
+        out.write(static_cast<uint64_t>(ts_us), 64);
+        for (uint32_t i = 0; i < slot.width; ++i) {
+            slot.last_bits[i] = std::bit_cast<uint64_t>(values[i]);
+            out.write(slot.last_bits[i], 64);
+        }
+    } else {
+        const int64_t delta = ts_us - slot.last_ts_us;
+        write_dod(out, delta - slot.last_delta_us);
+        slot.last_delta_us = delta;
+        for (uint32_t i = 0; i < slot.width; ++i) {
+            const auto bits = std::bit_cast<uint64_t>(values[i]);
+            const uint64_t x = bits ^ slot.last_bits[i];
+            slot.last_bits[i] = bits;
+            if (x == 0) {
+                out.write(0, 1);
+                continue;
+            }
+            // 5 bits of leading zeros, as in Gorilla
+            const auto leading = static_cast<uint8_t>(std::min(std::countl_zero(x), 31));
+            const auto trailing = static_cast<uint8_t>(std::countr_zero(x));
+            if (leading >= slot.leading[i] && trailing >= slot.trailing[i]) {
+                out.write(0b10, 2);
+                out.write(x >> slot.trailing[i], 64 - slot.leading[i] - slot.trailing[i]);
+                continue;
+            }
+            const unsigned meaningful = 64 - leading - trailing;
+            out.write(0b11, 2);
+            out.write(leading, 5);
+            out.write(meaningful - 1, 6);
+            out.write(x >> trailing, meaningful);
+            slot.leading[i] = leading;
+            slot.trailing[i] = trailing;
+        }
+    }
+    slot.last_ts_us = ts_us;
+    ++slot.rows;
+    out.align();
+}
+
+// Decode one row into the slot's last_bits; returns its timestamp
+inline int64_t read_row(BitReader &in, SlotState &slot) {
+    if (slot.rows == 0) {
+        slot.last_ts_us = static_cast<int64_t>(in.read(64));
+        for (uint32_t i = 0; i < slot.width; ++i) {
+            slot.last_bits[i] = in.read(64);
+        }
+    } else {
+        slot.last_delta_us += read_dod(in);
+        slot.last_ts_us += slot.last_delta_us;
+        for (uint32_t i = 0; i < slot.width; ++i) {
+            if (!in.read_bit()) {
+                continue;
+            }
+            if (!in.read_bit()) {
+                if (slot.leading[i] == 0xFF) {
+                    throw std::runtime_error("feature history: window reused before one was stored");
+                }
+                const unsigned meaningful = 64 - slot.leading[i] - slot.trailing[i];
+                slot.last_bits[i] ^= in.read(meaningful) << slot.trailing[i];
+                continue;
+            }
+            const auto leading = static_cast<uint8_t>(in.read(5));
+            const unsigned meaningful = static_cast<unsigned>(in.read(6)) + 1;
+            if (leading + meaningful > 64) {
+                throw std::runtime_error("feature history: bad XOR window");
+            }
+            const auto trailing = static_cast<uint8_t>(64 - leading - meaningful);
+            slot.last_bits[i] ^= in.read(meaningful) << trailing;
+            slot.leading[i] = leading;
+            slot.trailing[i] = trailing;
+        }
+    }
+    ++slot.rows;
+    in.align();
+    return slot.last_ts_us;
+}
+
+inline void check_header(std::span<const char> data) {
+    if (data.size() < FEATURE_HISTORY_HEADER_SIZE ||
+        std::memcmp(data.data(), FEATURE_HISTORY_MAGIC, sizeof(FEATURE_HISTORY_MAGIC)) != 0) {
+        throw std::runtime_error("feature history: bad magic");
+    }
+    uint16_t version;
+    std::memcpy(&version, data.data() + 4, sizeof(version));
+    if (version != FEATURE_HISTORY_VERSION) {
+        throw std::runtime_error("feature history: unsupported version");
+    }
+}
+
+// Walk every record of a chunk, rebuilding `slots`; on_row(slot index,
+// ts) sees each row, whose values are then the slot's last_bits
+template <typename OnRow>
+void walk_chunk(std::span<const char> data, std::vector<SlotState> &slots, OnRow &&on_row) {
+    check_header(data);
+    BitReader in(data, FEATURE_HISTORY_HEADER_SIZE);
+    while (!in.at_end()) {
+        const auto tag = static_cast<uint8_t>(in.read(8));
+        if (tag == FEATURE_HISTORY_DEFINE) {
+            if (slots.size() == FEATURE_HISTORY_MAX_SLOTS) {
+                throw std::runtime_error("feature history: too many schemas");
+            }
+            const std::size_t at = in.byte_offset();
+            if (at + 12 > data.size()) {
+                throw std::runtime_error("feature history: truncated schema definition");
+            }
+            uint64_t hash;
+            uint32_t width;
+            std::memcpy(&hash, data.data() + at, sizeof(hash));
+            std::memcpy(&width, data.data() + at + 8, sizeof(width));
+            if (width == 0 || width > FEATURE_HISTORY_MAX_WIDTH) {
+                throw std::runtime_error("feature history: bad schema width");
+            }
+            slots.emplace_back(hash, width);
+            in.read(64);
+            in.read(32);
+            continue;
+        }
+        if (tag >= slots.size()) {
+            throw std::runtime_error("feature history: row of an undefined schema");
+        }
+        on_row(tag, read_row(in, slots[tag]));
+    }
+}
+
+} // namespace feature_history_detail
+
+class FeatureHistoryChunk {
+public:
+    FeatureHistoryChunk() = default;
+
+    // Append one row of `schema_hash` (width values) and return the bytes
+    // to append to the blob. The first append of a chunk starts with the
+    // header and the first row of a schema with its definition.
+    std::string append(uint64_t schema_hash, int64_t ts_us, std::span<const double> values) {
+        using namespace feature_history_detail;
+        if (values.empty() || values.size() > FEATURE_HISTORY_MAX_WIDTH) {
+            throw std::invalid_argument("feature history: row width must be 1 to 4096");
+        }
+        std::string out;
+        if (size_ == 0) {
+            out.append(FEATURE_HISTORY_MAGIC, sizeof(FEATURE_HISTORY_MAGIC));
+            out.append(reinterpret_cast<const char *>(&FEATURE_HISTORY_VERSION), sizeof(FEATURE_HISTORY_VERSION));
+            out.append(2, '\0');
+        }
+        auto found = slot_of_.find(schema_hash);
+        if (found == slot_of_.end()) {
+            if (slots_.size() == FEATURE_HISTORY_MAX_SLOTS) {
+                throw std::runtime_error("feature history: chunk holds the maximum number of schemas");
+            }
+            const auto width = static_cast<uint32_t>(values.size());
+            out.push_back(static_cast<char>(FEATURE_HISTORY_DEFINE));
+            out.append(reinterpret_cast<const char *>(&schema_hash), sizeof(schema_hash));
+            out.append(reinterpret_cast<const char *>(&width), sizeof(width));
+            found = slot_of_.emplace(schema_hash, slots_.size()).first;
+            slots_.emplace_back(schema_hash, width);
+        }
+        SlotState &slot = slots_[found->second];
+        if (values.size() != slot.width) {
+            throw std::invalid_argument("feature history: row width does not match its schema");
+        }
+        out.push_back(static_cast<char>(found->second));
+        BitWriter bits(out);
+        write_row(bits, slot, ts_us, values.data());
+        size_ += out.size();
+        ++rows_;
+        return out;
+    }
+
+    // Take over an existing blob so later appends continue it
+    void resume(std::span<const char> data) {
+        std::vector<feature_history_detail::SlotState> slots;
+        uint64_t rows = 0;
+        feature_history_detail::walk_chunk(data, slots, [&](std::size_t, int64_t) { ++rows; });
+        reset();
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+            slot_of_.emplace(slots[i].schema_hash, i);
+        }
+        slots_ = std::move(slots);
+        rows_ = rows;
+        size_ = data.size();
+    }
+
+    void reset() {
+        slots_.clear();
+        slot_of_.clear();
+        rows_ = 0;
+        size_ = 0;
+    }
+
+    // Bytes of the blob so far, to check an APPEND against
+    std::size_t size() const { return size_; }
+    uint64_t rows() const { return rows_; }
+    std::size_t schemas() const { return slots_.size(); }
+    // No further schema fits; the next append of a new one throws
+    bool full() const { return slots_.size() == FEATURE_HISTORY_MAX_SLOTS; }
+
+private:
+    std::vector<feature_history_detail::SlotState> slots_;
+    std::unordered_map<uint64_t, std::size_t> slot_of_;
+    uint64_t rows_ = 0;
+    std::size_t size_ = 0;
+};
+
+// Decode `data` and append its rows to `series`, one entry per schema hash
+// in order of first appearance, so blobs decoded oldest first stay in time
+// order. Throws std::runtime_error on a malformed blob.
+inline void decode_feature_history(std::span<const char> data, std::vector<FeatureHistorySeries> &series) {
+    std::vector<feature_history_detail::SlotState> slots;
+    std::vector<std::size_t> target;
+    feature_history_detail::walk_chunk(data, slots, [&](std::size_t slot, int64_t ts_us) {
+        const feature_history_detail::SlotState &state = slots[slot];
+        while (target.size() < slots.size()) {
+            const feature_history_detail::SlotState &defined = slots[target.size()];
+            auto same = std::find_if(series.begin(), series.end(), [&](const FeatureHistorySeries &s) {
+                return s.schema_hash == defined.schema_hash;
+            });
+            if (same == series.end()) {
+                series.push_back(FeatureHistorySeries{defined.schema_hash, defined.width, {}, {}});
+                same = series.end() - 1;
+            } else if (same->width != defined.width) {
+                throw std::runtime_error("feature history: schema width differs between chunks");
+            }
+            target.push_back(static_cast<std::size_t>(same - series.begin()));
+        }
+        FeatureHistorySeries &out = series[target[slot]];
+        out.timestamps_us.push_back(ts_us);
+        for (const uint64_t bits : state.last_bits) {
+            out.values.push_back(std::bit_cast<double>(bits));
+        }
+    });
+}
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * Fixed-layout binary feature records for the Redis hand-off to inference.
+ *
+ * RedisWriter stores JSON feature maps, which the inference service parses
+ * field by field on every prediction. A feature record is instead a 64-byte
+ * header followed by the values as one packed float32 or float64 vector, so
+ * reading it back is a header check and a memcpy:
+ *
+ *   0  magic "BTCF"          24  symbol, NUL-padded (the 'S16' symbol cell)
+ *   4  uint16 version        40  int64 event_ts_us
+ *   6  uint8 value width     48  int64 written_ts_us
+ *   7  uint8 reserved        56  reserved (zero)
+ *   8  uint32 value count    64  values
+ *  12  uint32 reserved
+ *  16  uint64 schema hash
+ *
+ * All fields are little-endian. The schema hash is FNV-1a over the feature
+ * names in order, so a reader refuses a record whose layout it was not
+ * built for instead of misreading positions. The symbol is stored as text
+ * rather than a SymbolId because IDs are only stable within one process.
+ */
+
+#ifndef _SBE_FEATURE_RECORD_H_
+#define _SBE_FEATURE_RECORD_H_
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+static_assert(std::endian::native == std::endian::little, "feature records are written in host byte order");
+
+constexpr char FEATURE_RECORD_MAGIC[4] = {'B', 'T', 'C', 'F'};
+constexpr uint16_t FEATURE_RECORD_VERSION = 1;
+constexpr std::size_t FEATURE_RECORD_HEADER_SIZE = 64;
+
+// Byte width of each value
+enum class FeatureValueType : uint8_t {
+    Float32 = 4,
+    Float64 = 8,
+};
+
+struct FeatureRecordHeader {
+    uint16_t version = FEATURE_RECORD_VERSION;
+    FeatureValueType value_type = FeatureValueType::Float32;
+    uint32_t count = 0;
+    uint64_t schema_hash = 0;
+    std::array<char, 16> symbol{};
+    int64_t event_ts_us = 0;
+    int64_t written_ts_us = 0;
+
+    std::string_view symbol_view() const { return {symbol.data(), strnlen(symbol.data(), symbol.size())}; }
+};
+
+// FNV-1a over the names, each followed by a NUL so ("ab", "c") and
+// ("a", "bc") differ
+template <typename Names>
+uint64_t feature_schema_hash(const Names &names) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (std::string_view name : names) {
+        for (const char c : name) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ULL;
+        }
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+inline std::size_t feature_record_size(FeatureValueType type, std::size_t count) {
+    return FEATURE_RECORD_HEADER_SIZE + count * static_cast<std::size_t>(type);
+}
+
+// Write `header` and its `header.count` values (narrowed to float32 when
+// the header says so) into `out`, which must hold feature_record_size()
+inline void encode_feature_record(const FeatureRecordHeader &header, const double *values, std::span<char> out) {
+    if (out.size() < feature_record_size(header.value_type, header.count)) {
+        throw std::runtime_error("feature record: output buffer too small");
+    }
+    char *at = out.data();
+    std::memset(at, 0, FEATURE_RECORD_HEADER_SIZE);
+    std::memcpy(at, FEATURE_RECORD_MAGIC, sizeof(FEATURE_RECORD_MAGIC));
+    std::memcpy(at + 4, &header.version, sizeof(header.version));
+    at[6] = static_cast<char>(header.value_type);
+    std::memcpy(at + 8, &header.count, sizeof(header.count));
+    std::memcpy(at + 16, &header.schema_hash, sizeof(header.schema_hash));
+    std::memcpy(at + 24, header.symbol.data(), header.symbol.size());
+    std::memcpy(at + 40, &header.event_ts_us, sizeof(header.event_ts_us));
+    std::memcpy(at + 48, &header.written_ts_us, sizeof(header.written_ts_us));
+    at += FEATURE_RECORD_HEADER_SIZE;
+    if (header.value_type == FeatureValueType::Float64) {
+        std::memcpy(at, values, header.count * sizeof(double));
+        return;
+    }
+    for (uint32_t i = 0; i < header.count; ++i) {
+        const auto value = static_cast<float>(values[i]);
+        std::memcpy(at + i * sizeof(float), &value, sizeof(float));
+    }
+}
+
+// Parse and validate a record's header; the values are the
+// header.count * width bytes at FEATURE_RECORD_HEADER_SIZE
+inline FeatureRecordHeader decode_feature_record_header(std::span<const char> data) {
+    if (data.size() < FEATURE_RECORD_HEADER_SIZE) {
+        throw std::runtime_error("feature record: truncated header");
+    }
+    const char *at = data.data();
+    if (std::memcmp(at, FEATURE_RECORD_MAGIC, sizeof(FEATURE_RECORD_MAGIC)) != 0) {
+        throw std::runtime_error("feature record: bad magic");
+    }
+    FeatureRecordHeader header;
+    std::memcpy(&header.version, at + 4, sizeof(header.version));
+    if (header.version != FEATURE_RECORD_VERSION) {
+        throw std::runtime_error("feature record: unsupported version");
+    }
+    header.value_type = static_cast<FeatureValueType>(at[6]);
+    if (header.value_type != FeatureValueType::Float32 && header.value_type != FeatureValueType::Float64) {
+        throw std::runtime_error("feature record: bad value width");
+    }
+    std::memcpy(&header.count, at + 8, sizeof(header.count));
+    std::memcpy(&header.schema_hash, at + 16, sizeof(header.schema_hash));
+    std::memcpy(header.symbol.data(), at + 24, header.symbol.size());
+    std::memcpy(&header.event_ts_us, at + 40, sizeof(header.event_ts_us));
+    std::memcpy(&header.written_ts_us, at + 48, sizeof(header.written_ts_us));
+    if (data.size() != feature_record_size(header.value_type, header.count)) {
+        throw std::runtime_error("feature record: size does not match the value count");
+    }
+    return header;
+}
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * First-copy-wins arbitration between redundant feeds (A/B lines).
+ *
+ * Several connections (lines) subscribe to the same streams, possibly on
+ * different endpoints, and every message arrives once per line. admit()
+ * forwards the first copy and rejects the rest, by the message's IDs per
+ * symbol and stream:
+ *
+ *   - trades and depth diffs are sequenced: a trade event covers trade IDs
+ *     first..last and a diff update IDs first..final, each range starting
+ *     right after the previous one. A range past the newest forwarded ID
+ *     wins. One that skips IDs opens a hole, and a later copy covering
+ *     part of a hole still wins (the line that jumped ahead had just
+ *     reconnected, and a slower line still holds the skipped messages).
+ *     Anything else was already forwarded.
+ *   - bestBidAsk and partial depth only matter as the latest state: an
+ *     update ID past the newest forwarded one wins, older ones are stale.
+ *     Quotes can repeat a book update ID, so equal IDs go by event time.
+ *
+ * Frames without IDs (other templates, unreadable frames) always pass.
+ * Holes are kept per key up to MAX_HOLES, the oldest given up first, so a
+ * line that stays behind for good cannot grow the state.
+ *
+ * Per line, stats count frames, wins, duplicates and hole fills, and how
+ * far a duplicate trailed the copy that won (for copies of one of the last
+ * RECENT_WINS winners per key): the line's lag. A line that wins most races
+ * is the faster path; one that reconnects only stops winning, it never
+ * stalls the stream.
+ *
+ * Not thread-safe: the receiver calls admit() under its feed group's lock.
+ * Stats are atomic for readers on other threads.
+ */
+
+#ifndef _SBE_FEED_ARBITER_H_
+#define _SBE_FEED_ARBITER_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "interval_set.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+#include "symbol_table.h"
+
+struct FeedLineStats {
+    std::atomic<uint64_t> frames{0};
+    // First copies, forwarded
+    std::atomic<uint64_t> wins{0};
+    // Copies another line already delivered
+    std::atomic<uint64_t> duplicates{0};
+    // Wins that filled a hole another line skipped
+    std::atomic<uint64_t> fills{0};
+    // How far duplicates trailed the winning copy, where measured
+    std::atomic<uint64_t> lag_samples{0};
+    std::atomic<uint64_t> lag_us_total{0};
+    std::atomic<uint64_t> lag_us_max{0};
+};
+
+// IDs a stream frame carries, for arbitration
+struct FeedFrameIds {
+    uint32_t key = 0;
+    int64_t first = 0;
+    int64_t last = 0;
+    uint64_t event_time_us = 0;
+    // Latest-state streams: only newer IDs matter
+    bool latest_only = false;
+};
+
+// Arbitration IDs of a stream frame; false for frames that carry none
+inline bool feed_frame_ids(std::span<const char> frame, FeedFrameIds &out) {
+    using spot_sbe::MessageHeader;
+    if (frame.size() < MessageHeader::encodedLength()) {
+        return false;
+    }
+    MessageHeader header{const_cast<char *>(frame.data()), frame.size()};
+    const char *data = frame.data() + MessageHeader::encodedLength();
+    const std::size_t size = frame.size() - MessageHeader::encodedLength();
+    const uint16_t block_length = header.blockLength();
+    std::string_view symbol;
+    uint32_t stream = 0;
+    switch (header.templateId()) {
+    case TRADES_STREAM_EVENT: {
+        TradeFrame trade;
+        if (parse_trade_frame(data, size, block_length, trade) != ParseError::None) {
+            return false;
+        }
+        const char *last_entry = data + trade.group_start + (trade.num_in_group - 1) * trade.group_block_length;
+        out.first = static_cast<int64_t>(trade.trade_id);
+        out.last = static_cast<int64_t>(load_trade_entry<false>(last_entry).trade_id);
+        out.event_time_us = trade.event_time_us;
+        out.latest_only = false;
+        symbol = trade.symbol;
+        stream = 0;
+        break;
+    }
+    case BEST_BID_ASK_STREAM_EVENT: {
+        BestBidAskFrame bba;
+        if (parse_best_bid_ask_frame(data, size, block_length, bba) != ParseError::None) {
+            return false;
+        }
+        out.first = out.last = static_cast<int64_t>(bba.book_update_id);
+        out.event_time_us = bba.event_time_us;
+        out.latest_only = true;
+        symbol = bba.symbol;
+        stream = 1;
+        break;
+    }
+    case DEPTH_DIFF_STREAM_EVENT: {
+        DepthDiffFrame diff;
+        if (parse_depth_diff_frame(data, size, block_length, diff) != ParseError::None) {
+            return false;
+        }
+        out.first = static_cast<int64_t>(diff.first_update_id);
+        out.last = static_cast<int64_t>(diff.final_update_id);
+        out.event_time_us = diff.event_time_us;
+        out.latest_only = false;
+        symbol = diff.symbol;
+        stream = 2;
+        break;
+    }
+    case DEPTH_SNAPSHOT_STREAM_EVENT: {
+        DepthSnapshotFrame snapshot;
+        if (parse_depth_snapshot_frame(data, size, block_length, snapshot) != ParseError::None) {
+            return false;
+        }
+        out.first = out.last = static_cast<int64_t>(snapshot.book_update_id);
+        out.event_time_us = snapshot.event_time_us;
+        out.latest_only = true;
+        symbol = snapshot.symbol;
+        stream = 3;
+        break;
+    }
+    default:
+        return false;
+    }
+    if (out.last < out.first) {
+        return false;
+    }
+    const SymbolId id = symbol_table().intern(symbol);
+    if (id == INVALID_SYMBOL_ID) {
+        return false;
+    }
+    out.key = static_cast<uint32_t>(id) << 2 | stream;
+    return true;
+}
+
+class FeedArbiter {
+public:
+    static constexpr std::size_t MAX_HOLES = 16;
+    static constexpr std::size_t RECENT_WINS = 16;
+
+    explicit FeedArbiter(std::size_t lines) : lines_(std::max<std::size_t>(lines, 1)) {
+        for (std::size_t i = 0; i < lines_; ++i) {
+            stats_.push_back(std::make_unique<FeedLineStats>());
+        }
+    }
+
+    FeedArbiter(const FeedArbiter &) = delete;
+    FeedArbiter &operator=(const FeedArbiter &) = delete;
+
+    // True when `line`'s copy of `frame` is the first and should be forwarded
+    bool admit(std::span<const char> frame, std::size_t line, uint64_t received_us) {
+        if (line >= lines_) {
+            throw std::runtime_error("FeedArbiter: line out of range");
+        }
+        FeedLineStats &stats = *stats_[line];
+        stats.frames.fetch_add(1, std::memory_order_relaxed);
+        FeedFrameIds ids;
+        if (!feed_frame_ids(frame, ids)) {
+            stats.wins.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        KeyState &state = keys_[ids.key];
+        bool admitted = false;
+        if (ids.last > state.newest ||
+            (ids.latest_only && ids.last == state.newest && ids.event_time_us > state.newest_time_us)) {
+            if (!ids.latest_only && state.newest >= 0 && ids.first > state.newest + 1) {
+                open_hole(state, IdInterval{state.newest + 1, ids.first - 1});
+            }
+            state.newest = ids.last;
+            state.newest_time_us = ids.event_time_us;
+            admitted = true;
+        } else if (!ids.latest_only && fill_holes(state, ids.first, ids.last)) {
+            stats.fills.fetch_add(1, std::memory_order_relaxed);
+            admitted = true;
+        }
+
+        if (admitted) {
+            state.recent[state.next_recent] = RecentWin{ids.last, ids.event_time_us, received_us};
+            state.next_recent = (state.next_recent + 1) % RECENT_WINS;
+            stats.wins.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        stats.duplicates.fetch_add(1, std::memory_order_relaxed);
+        for (const RecentWin &win : state.recent) {
+            if (win.last == ids.last && win.event_time_us == ids.event_time_us && win.received_us != 0) {
+                const uint64_t lag = received_us > win.received_us ? received_us - win.received_us : 0;
+                stats.lag_samples.fetch_add(1, std::memory_order_relaxed);
+                stats.lag_us_total.fetch_add(lag, std::memory_order_relaxed);
+                if (lag > stats.lag_us_max.load(std::memory_order_relaxed)) {
+                    stats.lag_us_max.store(lag, std::memory_order_relaxed);
+                }
+                break;
+            }
+        }
+        return false;
+    }
+
+    std::size_t lines() const { return lines_; }
+    const FeedLineStats &stats(std::size_t line) const { return *stats_.at(line); }
+    // Holes given up on (MAX_HOLES) before any line filled them
+    uint64_t abandoned_holes() const { return abandoned_holes_.load(std::memory_order_relaxed); }
+
+private:
+    struct RecentWin {
+        int64_t last = -1;
+        uint64_t event_time_us = 0;
+        uint64_t received_us = 0;
+    };
+
+    struct KeyState {
+        int64_t newest = -1;
+        uint64_t newest_time_us = 0;
+        std::vector<IdInterval> holes;
+        std::array<RecentWin, RECENT_WINS> recent{};
+        std::size_t next_recent = 0;
+    };
+
+    void open_hole(KeyState &state, IdInterval hole) {
+        if (state.holes.size() == MAX_HOLES) {
+            state.holes.erase(state.holes.begin());
+            abandoned_holes_.fetch_add(1, std::memory_order_relaxed);
+        }
+        state.holes.push_back(hole);
+    }
+
+    // Remove first..last from the holes; true when it covered any of them
+    bool fill_holes(KeyState &state, int64_t first, int64_t last) {
+        bool filled = false;
+        std::vector<IdInterval> &holes = state.holes;
+        for (std::size_t i = 0; i < holes.size();) {
+            IdInterval &hole = holes[i];
+            if (last < hole.first || first > hole.last) {
+                ++i;
+                continue;
+            }
+            filled = true;
+            if (first > hole.first && last < hole.last) {
+                // Splits the hole in two
+                const IdInterval tail{last + 1, hole.last};
+                hole.last = first - 1;
+                holes.insert(holes.begin() + static_cast<std::ptrdiff_t>(i) + 1, tail);
+                i += 2;
+            } else if (first > hole.first) {
+                hole.last = first - 1;
+                ++i;
+            } else if (last < hole.last) {
+                hole.first = last + 1;
+                ++i;
+            } else {
+                holes.erase(holes.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+        while (holes.size() > MAX_HOLES) {
+            holes.erase(holes.begin());
+            abandoned_holes_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return filled;
+    }
+
+    const std::size_t lines_;
+    std::vector<std::unique_ptr<FeedLineStats>> stats_;
+    std::unordered_map<uint32_t, KeyState> keys_;
+    std::atomic<uint64_t> abandoned_holes_{0};
+};
+
+#endif
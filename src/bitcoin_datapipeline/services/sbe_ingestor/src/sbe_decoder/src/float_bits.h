@@ -0,0 +1,34 @@
+/*
+ * NaN and infinity tests on the IEEE-754 bits.
+ *
+ * setup.py builds with -ffast-math, under which the compiler may assume no
+ * value is NaN or infinite and fold std::isfinite to true and std::isnan to
+ * false. Native code that must reject or detect such values tests the
+ * exponent and mantissa bits instead.
+ */
+
+#ifndef _SBE_FLOAT_BITS_H_
+#define _SBE_FLOAT_BITS_H_
+
+#include <bit>
+#include <cstdint>
+
+namespace float_bits_detail {
+
+constexpr uint64_t EXPONENT = 0x7ff0000000000000ULL;
+constexpr uint64_t MANTISSA = 0x000fffffffffffffULL;
+
+}  // namespace float_bits_detail
+
+// Neither NaN nor infinite
+inline bool finite_bits(double value) {
+    return (std::bit_cast<uint64_t>(value) & float_bits_detail::EXPONENT) != float_bits_detail::EXPONENT;
+}
+
+inline bool nan_bits(double value) {
+    const uint64_t bits = std::bit_cast<uint64_t>(value);
+    return (bits & float_bits_detail::EXPONENT) == float_bits_detail::EXPONENT &&
+           (bits & float_bits_detail::MANTISSA) != 0;
+}
+
+#endif
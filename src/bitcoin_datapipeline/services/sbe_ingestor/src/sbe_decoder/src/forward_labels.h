@@ -0,0 +1,148 @@
+/*
+ * Forward-looking labels over a sorted (timestamp, price) column pair.
+ *
+ * For every row i and horizon h, with t = timestamp[i], p = price[i] and
+ * j the last row at or before t + h:
+ *
+ *   forward_price   price[j], the price standing h later (the forward mid
+ *                   when the column is a mid)
+ *   forward_return  price[j] / p - 1
+ *   max_up          max(price[i..j]) / p - 1, never below 0
+ *   max_down        min(price[i..j]) / p - 1, never above 0
+ *
+ * A row whose t + h lies past the last timestamp has no label yet: its
+ * columns are NaN. Rows sharing a timestamp are taken in row order.
+ *
+ * Rows and horizons are walked in one pass. Each horizon keeps its own
+ * pointer to j and two monotonic queues of row indices, one for the max
+ * and one for the min of price[i+1..j]; both ends of the window only move
+ * forward, so a row enters and leaves each queue once and the pass is
+ * O(rows × horizons) whatever the horizon length.
+ */
+
+#ifndef _SBE_FORWARD_LABELS_H_
+#define _SBE_FORWARD_LABELS_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+struct ForwardLabelColumns {
+    int64_t horizon_us = 0;
+    std::vector<double> forward_price;
+    std::vector<double> forward_return;
+    std::vector<double> max_up;
+    std::vector<double> max_down;
+};
+
+namespace forward_labels_detail {
+
+// Row indices whose prices are kept monotonic by `keep(older, newer)`:
+// the front is the extreme of the window
+template <typename Keep>
+class MonotonicQueue {
+public:
+    explicit MonotonicQueue(Keep keep) : keep_(keep) {}
+
+    void push(const double *price, std::size_t row) {
+        while (rows_.size() > head_ && !keep_(price[rows_.back()], price[row])) {
+            rows_.pop_back();
+        }
+        rows_.push_back(row);
+    }
+
+    // Drop rows at or before `row`
+    void expire(std::size_t row) {
+        while (head_ < rows_.size() && rows_[head_] <= row) {
+            ++head_;
+        }
+        if (head_ == rows_.size()) {
+            rows_.clear();
+            head_ = 0;
+        }
+    }
+
+    bool empty() const { return head_ == rows_.size(); }
+    std::size_t front() const { return rows_[head_]; }
+
+private:
+    Keep keep_;
+    std::vector<std::size_t> rows_;
+    std::size_t head_ = 0;
+};
+
+inline bool keeps_max(double older, double newer) { return older > newer; }
+inline bool keeps_min(double older, double newer) { return older < newer; }
+
+} // namespace forward_labels_detail
+
+// Labels of `rows` rows for each of `horizons_us`; throws
+// std::invalid_argument on unsorted timestamps or a horizon below 1 us
+inline std::vector<ForwardLabelColumns> forward_labels(const int64_t *timestamp_us, const double *price,
+                                                       std::size_t rows, std::span<const int64_t> horizons_us) {
+    using forward_labels_detail::MonotonicQueue;
+    using Queue = MonotonicQueue<bool (*)(double, double)>;
+
+    for (const int64_t horizon : horizons_us) {
+        if (horizon <= 0) {
+            throw std::invalid_argument("forward_labels: horizons must be positive");
+        }
+    }
+    for (std::size_t i = 1; i < rows; ++i) {
+        if (timestamp_us[i] < timestamp_us[i - 1]) {
+            throw std::invalid_argument("forward_labels: timestamps must be sorted");
+        }
+    }
+
+    constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<ForwardLabelColumns> out(horizons_us.size());
+    struct Cursor {
+        // Last row inside the window
+        std::size_t last = 0;
+        Queue high{forward_labels_detail::keeps_max};
+        Queue low{forward_labels_detail::keeps_min};
+    };
+    std::vector<Cursor> cursors(horizons_us.size());
+    for (std::size_t h = 0; h < horizons_us.size(); ++h) {
+        out[h].horizon_us = horizons_us[h];
+        out[h].forward_price.assign(rows, nan);
+        out[h].forward_return.assign(rows, nan);
+        out[h].max_up.assign(rows, nan);
+        out[h].max_down.assign(rows, nan);
+    }
+    const int64_t last_us = rows > 0 ? timestamp_us[rows - 1] : 0;
+
+    for (std::size_t i = 0; i < rows; ++i) {
+        const double p = price[i];
+        for (std::size_t h = 0; h < horizons_us.size(); ++h) {
+            Cursor &cursor = cursors[h];
+            const int64_t until_us = timestamp_us[i] + horizons_us[h];
+            if (until_us > last_us) {
+                // Every later row reaches past the data too
+                continue;
+            }
+            cursor.last = std::max(cursor.last, i);
+            while (cursor.last + 1 < rows && timestamp_us[cursor.last + 1] <= until_us) {
+                ++cursor.last;
+                cursor.high.push(price, cursor.last);
+                cursor.low.push(price, cursor.last);
+            }
+            cursor.high.expire(i);
+            cursor.low.expire(i);
+            const double high = cursor.high.empty() ? p : std::max(p, price[cursor.high.front()]);
+            const double low = cursor.low.empty() ? p : std::min(p, price[cursor.low.front()]);
+            ForwardLabelColumns &labels = out[h];
+            labels.forward_price[i] = price[cursor.last];
+            labels.forward_return[i] = price[cursor.last] / p - 1;
+            labels.max_up[i] = high / p - 1;
+            labels.max_down[i] = low / p - 1;
+        }
+    }
+    return out;
+}
+
+#endif
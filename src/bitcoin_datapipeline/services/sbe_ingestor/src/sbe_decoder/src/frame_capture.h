@@ -0,0 +1,168 @@
+/*
+ * Sampled raw-frame capture for troubleshooting a running decoder.
+ *
+ * Logging every frame's header and leading bytes costs more than decoding
+ * it, so that logging stays off in production and a bad frame leaves no
+ * trace. A FrameCapture keeps the evidence in fixed rings instead:
+ *
+ *   recent    the last `recent` frames decoded
+ *   sampled   every sample_every-th frame, the last `sampled` of them
+ *   failed    the last `failed` frames that did not decode, with why
+ *
+ * Each ring is allocated once, as slots of max_bytes; a frame is copied
+ * into its slot (cut to max_bytes, its full size kept) with the time it
+ * was received and its DecodeStatus and ParseError. Recording costs a copy
+ * per ring the frame lands in and never allocates. The rings are read on
+ * demand, oldest first, e.g. for a health endpoint dump.
+ *
+ * Not synchronized: the owner serializes record() and the reads (the
+ * decoder records and dumps under its instance lock).
+ */
+
+#ifndef _SBE_FRAME_CAPTURE_H_
+#define _SBE_FRAME_CAPTURE_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "parse_error.h"
+#include "stream_decode.h"
+
+// Names of DecodeStatus values, in order
+constexpr std::array<const char *, 5> DECODE_STATUS_NAMES = {"ok", "too_short", "schema_mismatch",
+                                                              "unknown_template", "malformed"};
+
+struct FrameCaptureConfig {
+    std::size_t recent = 64;
+    // Keep one frame in sample_every (0 = none) ...
+    uint32_t sample_every = 0;
+    // ... the last `sampled` of them
+    std::size_t sampled = 64;
+    std::size_t failed = 64;
+    // Bytes kept of each frame
+    std::size_t max_bytes = 512;
+
+    bool enabled() const { return recent > 0 || (sample_every > 0 && sampled > 0) || failed > 0; }
+};
+
+struct CapturedFrame {
+    // Frames recorded before this one
+    uint64_t seq = 0;
+    uint64_t received_us = 0;
+    // Size of the whole frame; bytes holds at most max_bytes of it
+    uint32_t size = 0;
+    DecodeStatus status = DecodeStatus::Ok;
+    ParseError cause = ParseError::None;
+    std::span<const char> bytes;
+};
+
+class CaptureRing {
+public:
+    CaptureRing(std::size_t slots, std::size_t max_bytes)
+        : max_bytes_(max_bytes), data_(slots * max_bytes), frames_(slots) {}
+
+    // Frames point into data_
+    CaptureRing(const CaptureRing &) = delete;
+    CaptureRing &operator=(const CaptureRing &) = delete;
+
+    void push(const CapturedFrame &frame, std::span<const char> bytes) {
+        if (frames_.empty()) {
+            return;
+        }
+        const std::size_t slot = next_;
+        next_ = next_ + 1 == frames_.size() ? 0 : next_ + 1;
+        count_ = std::min(count_ + 1, frames_.size());
+        char *dst = data_.data() + slot * max_bytes_;
+        const std::size_t kept = std::min(bytes.size(), max_bytes_);
+        if (kept > 0) {
+            std::memcpy(dst, bytes.data(), kept);
+        }
+        frames_[slot] = frame;
+        frames_[slot].bytes = std::span<const char>(dst, kept);
+    }
+
+    std::size_t size() const { return count_; }
+    std::size_t capacity() const { return frames_.size(); }
+
+    // Oldest first
+    template <typename Fn>
+    void for_each(Fn &&fn) const {
+        const std::size_t first = count_ < frames_.size() ? 0 : next_;
+        for (std::size_t i = 0; i < count_; ++i) {
+            fn(frames_[(first + i) % frames_.size()]);
+        }
+    }
+
+    void clear() {
+        next_ = 0;
+        count_ = 0;
+    }
+
+private:
+    const std::size_t max_bytes_;
+    std::vector<char> data_;
+    std::vector<CapturedFrame> frames_;
+    std::size_t next_ = 0;
+    std::size_t count_ = 0;
+};
+
+class FrameCapture {
+public:
+    explicit FrameCapture(const FrameCaptureConfig &config)
+        : config_(config), recent_(config.recent, config.max_bytes),
+          sampled_(config.sample_every > 0 ? config.sampled : 0, config.max_bytes),
+          failed_(config.failed, config.max_bytes) {}
+
+    void record(std::span<const char> frame, uint64_t received_us, DecodeStatus status,
+                ParseError cause = ParseError::None) {
+        const CapturedFrame captured{seen_, received_us, static_cast<uint32_t>(frame.size()), status, cause, {}};
+        recent_.push(captured, frame);
+        if (config_.sample_every > 0 && seen_ % config_.sample_every == 0) {
+            sampled_.push(captured, frame);
+        }
+        if (status != DecodeStatus::Ok) {
+            failed_.push(captured, frame);
+        }
+        ++seen_;
+    }
+
+    const FrameCaptureConfig &config() const { return config_; }
+    // Frames recorded so far
+    uint64_t seen() const { return seen_; }
+    const CaptureRing &recent() const { return recent_; }
+    const CaptureRing &sampled() const { return sampled_; }
+    const CaptureRing &failed() const { return failed_; }
+
+    void clear() {
+        recent_.clear();
+        sampled_.clear();
+        failed_.clear();
+    }
+
+private:
+    const FrameCaptureConfig config_;
+    CaptureRing recent_;
+    CaptureRing sampled_;
+    CaptureRing failed_;
+    uint64_t seen_ = 0;
+};
+
+// Lower-case hex of `bytes`
+inline std::string frame_hex(std::span<const char> bytes) {
+    static constexpr char DIGITS[] = "0123456789abcdef";
+    std::string hex(bytes.size() * 2, '0');
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        const auto byte = static_cast<unsigned char>(bytes[i]);
+        hex[2 * i] = DIGITS[byte >> 4];
+        hex[2 * i + 1] = DIGITS[byte & 0xf];
+    }
+    return hex;
+}
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * Spreading one symbol's records over several Kinesis shards, and putting
+ * them back in order on the consumer.
+ *
+ * Records are keyed by symbol, so all of BTCUSDT lands on one shard and
+ * its 1 MiB/s write budget however many shards the stream has. For the
+ * symbols it is given, a HotPartitioner instead numbers each record with
+ * the symbol's next sequence number and routes it to one of `buckets`
+ * shards:
+ *
+ *   partition key       "<symbol>#<seq>", so every record (KPL sub-records
+ *                       included) carries its sequence to the consumer
+ *   explicit hash key   bucket (seq / run) % buckets, placed at the
+ *                       symbol's own hash key (the MD5 Kinesis would use)
+ *                       plus bucket / buckets of the hash space, so on a
+ *                       stream of evenly split shards each bucket is a
+ *                       different shard
+ *
+ * Each bucket keeps its records in order, as one shard does. A
+ * SequenceMerger on the consumer takes the records of every shard as they
+ * are read and hands each symbol's back in sequence order, k-way merging
+ * the buckets: a record waits while an earlier one is still missing, up to
+ * max_wait_us or max_buffered records, after which the merger skips the
+ * gap (a lost record) and counts it; a symbol's first records wait the
+ * same way for the shards not read yet. Keys without a sequence pass
+ * through unmerged.
+ *
+ * The partitioner is thread-safe (a fixed symbol table with an atomic
+ * counter each); the merger is not.
+ */
+
+#ifndef _SBE_HOT_PARTITION_H_
+#define _SBE_HOT_PARTITION_H_
+
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "kinesis_producer.h"
+
+// Separates the symbol from its sequence number in a partition key
+inline constexpr char HOT_PARTITION_SEPARATOR = '#';
+
+struct HotPartitionConfig {
+    std::vector<std::string> symbols;
+    // Shards each symbol is spread over
+    uint32_t buckets = 4;
+    // Consecutive records that go to the same bucket
+    uint32_t run = 1;
+};
+
+class HotPartitioner {
+public:
+    explicit HotPartitioner(const HotPartitionConfig &config) : buckets_(config.buckets), run_(config.run) {
+        if (buckets_ == 0 || run_ == 0) {
+            throw std::runtime_error("HotPartitioner: buckets and run must be positive");
+        }
+        const KinesisHashKey stride = ~KinesisHashKey{0} / buckets_;
+        for (const std::string &symbol : config.symbols) {
+            if (symbol.empty() || symbol.find(HOT_PARTITION_SEPARATOR) != std::string::npos) {
+                throw std::runtime_error("HotPartitioner: bad symbol '" + symbol + "'");
+            }
+            auto entry = std::make_unique<Symbol>();
+            const KinesisHashKey base = kinesis_hash_key(symbol);
+            for (uint32_t bucket = 0; bucket < buckets_; ++bucket) {
+                entry->hash_keys.push_back(format_kinesis_hash_key(base + stride * bucket));
+            }
+            symbols_.emplace(symbol, std::move(entry));
+        }
+    }
+
+    HotPartitioner(const HotPartitioner &) = delete;
+    HotPartitioner &operator=(const HotPartitioner &) = delete;
+
+    uint32_t buckets() const { return buckets_; }
+    uint32_t run() const { return run_; }
+
+    bool hot(std::string_view symbol) const { return find(symbol) != nullptr; }
+
+    // Number the next record of `symbol` into its partition key and
+    // explicit hash key; false, leaving both alone, for a symbol that is
+    // not hot (it keeps routing by its own key)
+    bool route(std::string_view symbol, std::string &partition_key, std::string &explicit_hash_key) {
+        Symbol *entry = find(symbol);
+        if (entry == nullptr) {
+            return false;
+        }
+        const uint64_t seq = entry->next_seq.fetch_add(1, std::memory_order_relaxed);
+        partition_key.assign(symbol);
+        partition_key += HOT_PARTITION_SEPARATOR;
+        partition_key += std::to_string(seq);
+        explicit_hash_key = entry->hash_keys[(seq / run_) % buckets_];
+        return true;
+    }
+
+    // Records routed so far per hot symbol
+    std::map<std::string, uint64_t> routed() const {
+        std::map<std::string, uint64_t> out;
+        for (const auto &[symbol, entry] : symbols_) {
+            out.emplace(symbol, entry->next_seq.load(std::memory_order_relaxed));
+        }
+        return out;
+    }
+
+private:
+    struct Symbol {
+        std::atomic<uint64_t> next_seq{0};
+        // Explicit hash key of each bucket
+        std::vector<std::string> hash_keys;
+    };
+
+    Symbol *find(std::string_view symbol) const {
+        const auto it = symbols_.find(symbol);
+        return it == symbols_.end() ? nullptr : it->second.get();
+    }
+
+    struct Hash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+    };
+
+    const uint32_t buckets_;
+    const uint32_t run_;
+    // Fixed after construction
+    std::unordered_map<std::string, std::unique_ptr<Symbol>, Hash, std::equal_to<>> symbols_;
+};
+
+// Split "<symbol>#<seq>"; false for a key without a sequence number
+inline bool split_sequenced_key(std::string_view key, std::string_view &symbol, uint64_t &seq) {
+    const std::size_t separator = key.rfind(HOT_PARTITION_SEPARATOR);
+    if (separator == std::string_view::npos || separator == 0 || separator + 1 == key.size()) {
+        return false;
+    }
+    const char *end = key.data() + key.size();
+    const auto [ptr, ec] = std::from_chars(key.data() + separator + 1, end, seq);
+    if (ec != std::errc() || ptr != end) {
+        return false;
+    }
+    symbol = key.substr(0, separator);
+    return true;
+}
+
+struct SequenceMergerConfig {
+    // Records a symbol may hold back before its gap is skipped
+    std::size_t max_buffered = 65536;
+    // How long a gap may hold records back before it is skipped
+    uint64_t max_wait_us = 500000;
+};
+
+struct SequenceMergerStats {
+    uint64_t released = 0;
+    uint64_t buffered = 0;
+    // Records at or below a sequence already released (redeliveries)
+    uint64_t duplicates = 0;
+    // Gaps skipped, and the sequence numbers they covered
+    uint64_t gaps = 0;
+    uint64_t skipped = 0;
+};
+
+template <typename T>
+class SequenceMerger {
+public:
+    explicit SequenceMerger(const SequenceMergerConfig &config = {}) : config_(config) {}
+
+    // Take one record; emit(T&&) gets every record this releases, in order
+    template <typename Emit>
+    void push(std::string_view symbol, uint64_t seq, T item, uint64_t now_us, Emit &&emit) {
+        auto it = symbols_.find(symbol);
+        if (it == symbols_.end()) {
+            it = symbols_.emplace(std::string(symbol), Stream{}).first;
+        }
+        Stream &stream = it->second;
+        if ((stream.started && seq < stream.next) || stream.pending.contains(seq)) {
+            ++stats_.duplicates;
+            return;
+        }
+        stream.pending.emplace(seq, std::move(item));
+        ++stats_.buffered;
+        release(stream, now_us, emit);
+    }
+
+    // Release what gaps that have waited long enough were holding back
+    template <typename Emit>
+    void expire(uint64_t now_us, Emit &&emit) {
+        for (auto &[symbol, stream] : symbols_) {
+            release(stream, now_us, emit);
+        }
+    }
+
+    // Release everything held back, skipping every gap
+    template <typename Emit>
+    void flush(Emit &&emit) {
+        for (auto &[symbol, stream] : symbols_) {
+            while (!stream.pending.empty()) {
+                skip_gap(stream);
+                release_ready(stream, emit);
+            }
+        }
+    }
+
+    const SequenceMergerStats &stats() const { return stats_; }
+
+private:
+    struct Stream {
+        bool started = false;
+        uint64_t next = 0;
+        std::map<uint64_t, T> pending;
+        // When the record at `next` was first found missing; 0 without a gap
+        uint64_t gap_since_us = 0;
+    };
+
+    // Records released
+    template <typename Emit>
+    std::size_t release_ready(Stream &stream, Emit &emit) {
+        std::size_t released = 0;
+        auto it = stream.pending.begin();
+        while (stream.started && it != stream.pending.end() && it->first == stream.next) {
+            emit(std::move(it->second));
+            it = stream.pending.erase(it);
+            ++stream.next;
+            ++released;
+        }
+        stats_.released += released;
+        stats_.buffered -= released;
+        return released;
+    }
+
+    // Move on to the first record held back; a stream's first records
+    // start it wherever its lowest sequence is
+    void skip_gap(Stream &stream) {
+        const uint64_t head = stream.pending.begin()->first;
+        if (stream.started) {
+            ++stats_.gaps;
+            stats_.skipped += head - stream.next;
+        }
+        stream.started = true;
+        stream.next = head;
+        stream.gap_since_us = 0;
+    }
+
+    template <typename Emit>
+    void release(Stream &stream, uint64_t now_us, Emit &emit) {
+        if (release_ready(stream, emit) > 0) {
+            stream.gap_since_us = 0;
+        }
+        if (stream.pending.empty()) {
+            return;
+        }
+        if (stream.gap_since_us == 0) {
+            stream.gap_since_us = now_us;
+        }
+        if (stream.pending.size() > config_.max_buffered || now_us - stream.gap_since_us >= config_.max_wait_us) {
+            skip_gap(stream);
+            release_ready(stream, emit);
+            if (!stream.pending.empty()) {
+                // The next gap starts waiting now
+                stream.gap_since_us = now_us;
+            }
+        }
+    }
+
+    const SequenceMergerConfig config_;
+    std::map<std::string, Stream, std::less<>> symbols_;
+    SequenceMergerStats stats_;
+};
+
+#endif
@@ -0,0 +1,355 @@
+/*
+ * Minimal blocking HTTP/1.1 client connection with keep-alive, over TLS or
+ * plain TCP, for the native Kinesis producer (kinesis_producer.h).
+ *
+ * One connection carries one request at a time: round_trip() writes the
+ * request head and body and reads the whole response, sized by
+ * Content-Length or chunked transfer encoding. The connection stays open
+ * for the next request unless the server answers Connection: close, so a
+ * pool of these (one per sender thread) saves the TCP and TLS handshakes
+ * on every call. All failures throw std::runtime_error and leave the
+ * connection closed; the caller reconnects. Plain TCP (use_tls = false) is
+ * kept for local endpoints (LocalStack, tests).
+ */
+
+#ifndef _SBE_HTTP_CONNECTION_H_
+#define _SBE_HTTP_CONNECTION_H_
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+struct HttpEndpoint {
+    std::string host;
+    uint16_t port = 443;
+    bool use_tls = true;
+    int connect_timeout_ms = 5000;
+    // Send and receive timeout per socket call
+    int io_timeout_ms = 10000;
+};
+
+struct HttpResponse {
+    int status = 0;
+    // Status line and headers, without the blank line
+    std::string head;
+    std::string body;
+
+    // Value of header `name` (lower case), empty if absent
+    std::string header(std::string_view name) const {
+        std::size_t line = head.find("\r\n");
+        while (line != std::string::npos) {
+            line += 2;
+            const std::size_t end = std::min(head.find("\r\n", line), head.size());
+            const std::size_t colon = head.find(':', line);
+            if (colon < end && colon - line == name.size()) {
+                bool match = true;
+                for (std::size_t i = 0; i < name.size() && match; ++i) {
+                    match = std::tolower(static_cast<unsigned char>(head[line + i])) == name[i];
+                }
+                if (match) {
+                    std::size_t value = colon + 1;
+                    while (value < end && (head[value] == ' ' || head[value] == '\t')) {
+                        ++value;
+                    }
+                    return head.substr(value, end - value);
+                }
+            }
+            line = end < head.size() ? end : std::string::npos;
+        }
+        return {};
+    }
+};
+
+class HttpConnection {
+public:
+    HttpConnection() = default;
+    ~HttpConnection() { close(); }
+
+    HttpConnection(const HttpConnection &) = delete;
+    HttpConnection &operator=(const HttpConnection &) = delete;
+
+    void connect(const HttpEndpoint &endpoint) {
+        close();
+        try {
+            open_socket(endpoint);
+            if (endpoint.use_tls) {
+                start_tls(endpoint.host);
+            }
+        } catch (...) {
+            close();
+            throw;
+        }
+    }
+
+    bool connected() const { return fd_ >= 0; }
+
+    // Send one request and read its response into `out`. `head` is the
+    // request line and headers, each ending in CRLF, without the blank line
+    // or Content-Length, which are added here.
+    void round_trip(std::string_view head, std::span<const char> body, HttpResponse &out) {
+        if (fd_ < 0) {
+            throw std::runtime_error("http: not connected");
+        }
+        try {
+            request_.assign(head);
+            request_ += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+            write_all(request_.data(), request_.size());
+            write_all(body.data(), body.size());
+            read_response(out);
+        } catch (...) {
+            close();
+            throw;
+        }
+        if (lower(out.header("connection")) == "close") {
+            close();
+        }
+    }
+
+    void close() {
+        if (ssl_ != nullptr) {
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+        }
+        if (ctx_ != nullptr) {
+            SSL_CTX_free(ctx_);
+            ctx_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        read_buf_.clear();
+        read_pos_ = 0;
+    }
+
+private:
+    void open_socket(const HttpEndpoint &endpoint) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *results = nullptr;
+        const std::string port = std::to_string(endpoint.port);
+        if (const int rc = ::getaddrinfo(endpoint.host.c_str(), port.c_str(), &hints, &results); rc != 0) {
+            throw std::runtime_error("http resolve failed for " + endpoint.host + ": " + ::gai_strerror(rc));
+        }
+
+        std::string last_error = "no addresses";
+        for (addrinfo *ai = results; ai != nullptr; ai = ai->ai_next) {
+            const int fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) {
+                last_error = std::strerror(errno);
+                continue;
+            }
+            set_timeouts(fd, endpoint.connect_timeout_ms);
+            if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                const int one = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                set_timeouts(fd, endpoint.io_timeout_ms);
+                fd_ = fd;
+                break;
+            }
+            last_error = std::strerror(errno);
+            ::close(fd);
+        }
+        ::freeaddrinfo(results);
+        if (fd_ < 0) {
+            throw std::runtime_error("http connect to " + endpoint.host + " failed: " + last_error);
+        }
+    }
+
+    static std::string lower(std::string value) {
+        std::transform(value.begin(), value.end(), value.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return value;
+    }
+
+    static void set_timeouts(int fd, int timeout_ms) {
+        timeval timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    static std::string ssl_error_string() {
+        char buf[256];
+        ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+        return buf;
+    }
+
+    void start_tls(const std::string &host) {
+        ctx_ = SSL_CTX_new(TLS_client_method());
+        if (ctx_ == nullptr) {
+            throw std::runtime_error("http TLS context: " + ssl_error_string());
+        }
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        SSL_CTX_set_default_verify_paths(ctx_);
+        SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, nullptr);
+
+        ssl_ = SSL_new(ctx_);
+        SSL_set_fd(ssl_, fd_);
+        SSL_set_tlsext_host_name(ssl_, host.c_str());
+        SSL_set1_host(ssl_, host.c_str());
+        if (SSL_connect(ssl_) != 1) {
+            throw std::runtime_error("http TLS handshake with " + host + " failed: " + ssl_error_string());
+        }
+    }
+
+    void read_response(HttpResponse &out) {
+        out.status = 0;
+        out.head.clear();
+        out.body.clear();
+
+        // Head: up to the blank line, keeping what follows it buffered
+        std::size_t head_end = std::string::npos;
+        // Bytes past read_pos_ already searched (fill() moves read_pos_)
+        std::size_t scanned = 0;
+        while ((head_end = read_buf_.find("\r\n\r\n", read_pos_ + scanned)) == std::string::npos) {
+            if (read_buf_.size() - read_pos_ > 64 * 1024) {
+                throw std::runtime_error("http response head too large");
+            }
+            scanned = std::max<std::size_t>(read_buf_.size() - read_pos_, 3) - 3;
+            fill();
+        }
+        out.head.assign(read_buf_, read_pos_, head_end - read_pos_);
+        read_pos_ = head_end + 4;
+
+        if (out.head.size() < 12 || out.head.compare(0, 5, "HTTP/") != 0) {
+            throw std::runtime_error("http: malformed status line");
+        }
+        out.status = std::atoi(out.head.c_str() + out.head.find(' ') + 1);
+
+        if (lower(out.header("transfer-encoding")) == "chunked") {
+            read_chunked(out.body);
+        } else if (const std::string length = out.header("content-length"); !length.empty()) {
+            read_exact(out.body, std::strtoull(length.c_str(), nullptr, 10));
+        } else if (out.status != 204 && out.status != 304) {
+            throw std::runtime_error("http: response without Content-Length");
+        }
+    }
+
+    void read_chunked(std::string &body) {
+        while (true) {
+            const std::string line = read_line();
+            const std::size_t size = std::strtoull(line.c_str(), nullptr, 16);
+            if (size == 0) {
+                // Trailers, up to the blank line
+                while (!read_line().empty()) {
+                }
+                return;
+            }
+            read_exact(body, size);
+            read_line();
+        }
+    }
+
+    std::string read_line() {
+        std::size_t end = std::string::npos;
+        std::size_t scanned = 0;
+        while ((end = read_buf_.find("\r\n", read_pos_ + scanned)) == std::string::npos) {
+            if (read_buf_.size() - read_pos_ > 4096) {
+                throw std::runtime_error("http: chunk header too long");
+            }
+            scanned = std::max<std::size_t>(read_buf_.size() - read_pos_, 1) - 1;
+            fill();
+        }
+        std::string line = read_buf_.substr(read_pos_, end - read_pos_);
+        read_pos_ = end + 2;
+        return line;
+    }
+
+    // Append `size` body bytes to `out`
+    void read_exact(std::string &out, std::size_t size) {
+        const std::size_t buffered = std::min(size, read_buf_.size() - read_pos_);
+        out.append(read_buf_, read_pos_, buffered);
+        read_pos_ += buffered;
+        size -= buffered;
+        if (size > 0) {
+            const std::size_t offset = out.size();
+            out.resize(offset + size);
+            char *dst = out.data() + offset;
+            while (size > 0) {
+                const std::size_t n = read_some(dst, size);
+                dst += n;
+                size -= n;
+            }
+        }
+    }
+
+    // Read more bytes into the buffer, dropping what was already consumed
+    void fill() {
+        if (read_pos_ > 0) {
+            read_buf_.erase(0, read_pos_);
+            read_pos_ = 0;
+        }
+        char chunk[16 * 1024];
+        read_buf_.append(chunk, read_some(chunk, sizeof(chunk)));
+    }
+
+    std::size_t read_some(char *dst, std::size_t size) {
+        if (ssl_ != nullptr) {
+            const int n = SSL_read(ssl_, dst, static_cast<int>(std::min<std::size_t>(size, INT32_MAX)));
+            if (n <= 0) {
+                throw std::runtime_error("http TLS read failed: " + ssl_error_string());
+            }
+            return static_cast<std::size_t>(n);
+        }
+        ssize_t n = 0;
+        do {
+            n = ::recv(fd_, dst, size, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            throw std::runtime_error(n == 0 ? "http connection closed"
+                                            : std::string("http read failed: ") + std::strerror(errno));
+        }
+        return static_cast<std::size_t>(n);
+    }
+
+    void write_all(const char *data, std::size_t size) {
+        while (size > 0) {
+            std::size_t written = 0;
+            if (ssl_ != nullptr) {
+                const int n = SSL_write(ssl_, data, static_cast<int>(std::min<std::size_t>(size, INT32_MAX)));
+                if (n <= 0) {
+                    throw std::runtime_error("http TLS write failed: " + ssl_error_string());
+                }
+                written = static_cast<std::size_t>(n);
+            } else {
+                const ssize_t n = ::send(fd_, data, size, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::runtime_error(std::string("http write failed: ") + std::strerror(errno));
+                }
+                written = static_cast<std::size_t>(n);
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    int fd_ = -1;
+    SSL_CTX *ctx_ = nullptr;
+    SSL *ssl_ = nullptr;
+    std::string request_;
+    std::string read_buf_;
+    std::size_t read_pos_ = 0;
+};
+
+#endif
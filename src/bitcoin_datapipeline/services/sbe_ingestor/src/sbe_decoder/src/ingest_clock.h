@@ -0,0 +1,78 @@
+/*
+ * Ingest clock: CLOCK_MONOTONIC_RAW anchored to wall time.
+ *
+ * A wall-clock read per message costs a vDSO call and only gave millisecond
+ * resolution. The ingest clock reads the raw monotonic counter and adds an
+ * offset taken from CLOCK_REALTIME at anchor time, giving microsecond Unix
+ * timestamps that never jump with NTP slews between anchors. The anchor is
+ * refreshed every few seconds so the clock keeps tracking wall time.
+ *
+ * Callers take one reading per receive batch and stamp it on every event in
+ * that batch (see decode_frames and the ingest_ts_us arguments in
+ * sbe_decoder.cpp).
+ */
+
+#ifndef _SBE_INGEST_CLOCK_H_
+#define _SBE_INGEST_CLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+class IngestClock {
+public:
+    IngestClock() { anchor(); }
+
+    IngestClock(const IngestClock &) = delete;
+    IngestClock &operator=(const IngestClock &) = delete;
+
+    // Wall time in microseconds since the Unix epoch
+    uint64_t now_us() {
+        const int64_t mono = read_ns(MONOTONIC_CLOCK_ID);
+        if (mono - anchor_mono_ns_.load(std::memory_order_relaxed) > REANCHOR_INTERVAL_NS) {
+            anchor();
+        }
+        return static_cast<uint64_t>(mono + offset_ns_.load(std::memory_order_relaxed)) / 1000;
+    }
+
+    // Re-read the wall clock. Concurrent anchors are harmless: each stores
+    // an equally valid offset.
+    void anchor() {
+        // Bracket the wall-clock read and take the midpoint so the offset is
+        // not skewed by the cost of the calls themselves
+        const int64_t before = read_ns(MONOTONIC_CLOCK_ID);
+        const int64_t wall = read_ns(CLOCK_REALTIME);
+        const int64_t after = read_ns(MONOTONIC_CLOCK_ID);
+        const int64_t mono = before + (after - before) / 2;
+        offset_ns_.store(wall - mono, std::memory_order_relaxed);
+        anchor_mono_ns_.store(mono, std::memory_order_relaxed);
+    }
+
+private:
+#ifdef CLOCK_MONOTONIC_RAW
+    static constexpr clockid_t MONOTONIC_CLOCK_ID = CLOCK_MONOTONIC_RAW;
+#else
+    static constexpr clockid_t MONOTONIC_CLOCK_ID = CLOCK_MONOTONIC;
+#endif
+    static constexpr int64_t REANCHOR_INTERVAL_NS = 5'000'000'000;
+
+    static int64_t read_ns(clockid_t clock_id) {
+        timespec ts{};
+        clock_gettime(clock_id, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+
+    std::atomic<int64_t> offset_ns_{0};
+    std::atomic<int64_t> anchor_mono_ns_{0};
+};
+
+inline IngestClock &ingest_clock() {
+    static IngestClock clock;
+    return clock;
+}
+
+inline uint64_t ingest_time_us() {
+    return ingest_clock().now_us();
+}
+
+#endif
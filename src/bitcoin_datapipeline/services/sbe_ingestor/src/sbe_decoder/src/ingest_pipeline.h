@@ -0,0 +1,873 @@
+/*
+ * Staged native ingest pipeline with bounded queues and overflow policies.
+ *
+ * Frames go receive -> decode -> book -> publish, each stage on its own
+ * thread, handing work to the next through a bounded StageQueue. A frame's
+ * lane is its stream type (trade, bestBidAsk, depth); every lane has its
+ * own queues and threads, so a lane that falls behind never holds up the
+ * others past its ingress, and the lane's overflow policy decides what
+ * happens when one of its queues is full:
+ *
+ *   - block: the producer waits for room, so backpressure travels up the
+ *     lane to its ingress. There the producer is a receive thread, which
+ *     stops reading its socket (stalling every lane on that connection)
+ *     until TCP pushes back on the exchange; Binance drops a consumer that
+ *     stays slow, and the receiver reconnects.
+ *   - drop_oldest: the oldest queued item is dropped and counted, so fresh
+ *     data keeps flowing. A dropped depth diff is a gap, which the book
+ *     stage's BookSync resyncs from.
+ *   - conflate: an item replaces the one queued for the same symbol in
+ *     place, keeping its position, so only each symbol's latest quote
+ *     waits; when nothing is queued for the symbol and the queue is full,
+ *     the oldest is dropped. bestBidAsk only: a conflated trade or depth
+ *     diff would be lost data.
+ *
+ * Stages:
+ *   - receive: accept() (the FrameSink a StreamReceiver hands its frames
+ *     to, see stream_receiver.h) or submit() copies a frame into its
+ *     lane's ingress queue. Other templates are counted and dropped.
+ *   - decode: serialize_frame (kinesis_records.h) writes the frame's
+ *     Kinesis records, JSON or Avro, stamped with the receive time.
+ *   - book (depth lane, with a DecoderPool attached): frames are applied to
+ *     the pool's books in batches, keeping its books and book features
+ *     current for readers of the pool.
+ *   - publish: records go to the lane's KinesisProducers (kinesis_producer.h),
+ *     every record to each of them when a lane fans out to several streams.
+ *     While one refuses them (its own queue is full) the stage waits, so a
+ *     slow stream backs up into this lane's bounded publish queue, where
+ *     the policy applies, instead of growing memory until the process is
+ *     killed. A lane without a producer is drained by the caller (take()).
+ *
+ * The layout is config, not code: per lane and stage, the capacity of the
+ * queue the stage takes from and the core its thread is pinned to
+ * (PipelineStageConfig), so one build can be laid out per host type, e.g.
+ * small queues and a core per stage for latency, or big queues and shared
+ * cores for throughput. The service reads it from its YAML config.
+ *
+ * Each queue is bounded in items and keeps its depth, bytes, high-water
+ * mark, drop and conflation counts, and the time producers spent blocked
+ * on it. Each stage counts the items it finished, the time it spent on
+ * them, and the latency from receive to its output. All of it is exported
+ * as Prometheus metrics per lane and stage.
+ * stop() drains every lane into its producers or until the timeout, after
+ * which whatever is still queued is dropped and counted.
+ */
+
+#ifndef _SBE_INGEST_PIPELINE_H_
+#define _SBE_INGEST_PIPELINE_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "decode_stats.h"
+#include "decoder_pool.h"
+#include "ingest_clock.h"
+#include "kinesis_producer.h"
+#include "kinesis_records.h"
+#include "memory_accounting.h"
+#include "native_log.h"
+#include "native_metrics.h"
+#include "page_memory.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+#include "stream_receiver.h"
+#include "symbol_table.h"
+
+enum class OverflowPolicy : uint8_t {
+    Block = 0,
+    DropOldest,
+    Conflate,
+};
+
+// Config names, in OverflowPolicy order
+constexpr std::array<const char *, 3> OVERFLOW_POLICY_NAMES = {"block", "drop_oldest", "conflate"};
+
+enum class PipelineLane : uint8_t {
+    Trade = 0,
+    BestBidAsk,
+    Depth,
+};
+
+constexpr std::size_t PIPELINE_LANES = 3;
+// Stream type names, in PipelineLane order
+constexpr std::array<const char *, PIPELINE_LANES> PIPELINE_LANE_NAMES = {"trade", "bestBidAsk", "depth"};
+
+inline const LogFormat PIPELINE_DECODE_ERROR_LOG{LogLevel::Warning, "pipeline",
+                                                 "{} lane: dropped a frame of {} bytes that did not decode ({})"};
+inline const LogFormat PIPELINE_PUBLISH_ERROR_LOG{LogLevel::Warning, "pipeline", "{} lane: publish failed: {}"};
+
+enum class PipelineStage : uint8_t {
+    Decode = 0,
+    Books,
+    Publish,
+};
+
+constexpr std::size_t PIPELINE_STAGES = 3;
+// Config names, in PipelineStage order
+constexpr std::array<const char *, PIPELINE_STAGES> PIPELINE_STAGE_NAMES = {"decode", "books", "publish"};
+
+// Lane of a stream template; false for any other template
+inline bool pipeline_lane(uint16_t template_id, PipelineLane &lane) {
+    switch (template_id) {
+    case TRADES_STREAM_EVENT:
+        lane = PipelineLane::Trade;
+        return true;
+    case BEST_BID_ASK_STREAM_EVENT:
+        lane = PipelineLane::BestBidAsk;
+        return true;
+    case DEPTH_DIFF_STREAM_EVENT:
+    case DEPTH_SNAPSHOT_STREAM_EVENT:
+        lane = PipelineLane::Depth;
+        return true;
+    default:
+        return false;
+    }
+}
+
+struct StageQueueStats {
+    uint64_t capacity = 0;
+    uint64_t depth = 0;
+    uint64_t bytes = 0;
+    uint64_t high_water = 0;
+    uint64_t pushed = 0;
+    uint64_t popped = 0;
+    uint64_t dropped = 0;
+    uint64_t conflated = 0;
+    // Pushes that waited for room, and how long they waited in total
+    uint64_t blocked = 0;
+    uint64_t blocked_us = 0;
+};
+
+// Bounded multi-producer queue between two stages. T needs size() (its
+// bytes, for the stats).
+template <typename T>
+class StageQueue {
+public:
+    StageQueue(std::size_t capacity, OverflowPolicy policy)
+        : capacity_(std::max<std::size_t>(capacity, 1)), policy_(policy) {}
+
+    StageQueue(const StageQueue &) = delete;
+    StageQueue &operator=(const StageQueue &) = delete;
+
+    // Queue `item` under the policy. `key` identifies what conflates
+    // (0: never). False, with the item dropped and counted, once the queue
+    // is closed.
+    bool push(T item, uint64_t key = 0) {
+        std::unique_lock lock(mutex_);
+        if (closed_) {
+            ++stats_.dropped;
+            return false;
+        }
+        const bool conflate = policy_ == OverflowPolicy::Conflate && key != 0;
+        if (conflate) {
+            if (const auto it = latest_.find(key); it != latest_.end()) {
+                T &queued = entries_[it->second - head_seq_].item;
+                bytes_ = bytes_ - queued.size() + item.size();
+                queued = std::move(item);
+                ++stats_.pushed;
+                ++stats_.conflated;
+                return true;
+            }
+        }
+        if (entries_.size() >= capacity_) {
+            if (policy_ == OverflowPolicy::Block) {
+                ++stats_.blocked;
+                const auto start = std::chrono::steady_clock::now();
+                not_full_.wait(lock, [this] { return closed_ || entries_.size() < capacity_; });
+                stats_.blocked_us += static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+                        .count());
+                if (closed_) {
+                    ++stats_.dropped;
+                    return false;
+                }
+            } else {
+                pop_front();
+                ++stats_.dropped;
+            }
+        }
+        if (conflate) {
+            latest_[key] = head_seq_ + entries_.size();
+        }
+        bytes_ += item.size();
+        entries_.push_back(Entry{std::move(item), key});
+        ++stats_.pushed;
+        stats_.high_water = std::max<uint64_t>(stats_.high_water, entries_.size());
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Append up to `max` items to `out`, waiting up to `timeout_ms`
+    // (negative: until closed) for the first. Returns how many; 0 on
+    // timeout, or once the queue is closed and empty.
+    std::size_t pop(std::vector<T> &out, std::size_t max, int timeout_ms) {
+        std::unique_lock lock(mutex_);
+        const auto ready = [this] { return closed_ || !entries_.empty(); };
+        if (timeout_ms < 0) {
+            not_empty_.wait(lock, ready);
+        } else if (!not_empty_.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+            return 0;
+        }
+        std::size_t count = 0;
+        for (; count < max && !entries_.empty(); ++count) {
+            out.push_back(std::move(entries_.front().item));
+            pop_front();
+        }
+        stats_.popped += count;
+        lock.unlock();
+        if (count > 0) {
+            not_full_.notify_all();
+        }
+        return count;
+    }
+
+    // Refuse further pushes and wake every waiter; queued items can still
+    // be popped, or are dropped (and counted) with `discard`
+    void close(bool discard = false) {
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+            if (discard) {
+                stats_.dropped += entries_.size();
+                while (!entries_.empty()) {
+                    pop_front();
+                }
+            }
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
+    StageQueueStats stats() const {
+        std::lock_guard lock(mutex_);
+        StageQueueStats stats = stats_;
+        stats.capacity = capacity_;
+        stats.depth = entries_.size();
+        stats.bytes = bytes_;
+        return stats;
+    }
+
+    OverflowPolicy policy() const { return policy_; }
+
+    // Bytes of the queued items, against those plus their entries
+    MemoryUsage memory_usage() const {
+        std::lock_guard lock(mutex_);
+        return {bytes_, bytes_ + entries_.size() * sizeof(Entry)};
+    }
+
+private:
+    struct Entry {
+        T item;
+        uint64_t key;
+    };
+
+    void pop_front() {
+        Entry &front = entries_.front();
+        if (front.key != 0) {
+            if (const auto it = latest_.find(front.key); it != latest_.end() && it->second == head_seq_) {
+                latest_.erase(it);
+            }
+        }
+        bytes_ -= front.item.size();
+        entries_.pop_front();
+        ++head_seq_;
+    }
+
+    const std::size_t capacity_;
+    const OverflowPolicy policy_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<Entry> entries_;
+    // Sequence number of entries_.front(); an entry's is head_seq_ plus its index
+    uint64_t head_seq_ = 0;
+    // Conflate: sequence number of the queued entry for each key
+    std::unordered_map<uint64_t, uint64_t> latest_;
+    std::size_t bytes_ = 0;
+    bool closed_ = false;
+    StageQueueStats stats_;
+};
+
+// One frame on its way through a lane
+struct PipelineItem {
+    // The SBE message; released once decoded, or once applied to the books
+    std::vector<char> frame;
+    // Its records end to end, and where each one ends
+    std::vector<char> records;
+    std::vector<uint32_t> ends;
+    // Partition key
+    std::string symbol;
+    uint64_t received_us = 0;
+
+    std::size_t size() const { return frame.size() + records.size(); }
+};
+
+struct PipelineStageConfig {
+    // Items in the queue the stage takes from; 0 for the lane's capacity
+    std::size_t capacity = 0;
+    // Core the stage's thread is pinned to; -1 leaves it unpinned
+    int cpu = -1;
+};
+
+struct PipelineLaneConfig {
+    OverflowPolicy policy = OverflowPolicy::Block;
+    // Items per queue, in each of the lane's queues without its own
+    std::size_t capacity = 8192;
+    // In PipelineStage order
+    std::array<PipelineStageConfig, PIPELINE_STAGES> stages{};
+
+    std::size_t queue_capacity(PipelineStage stage) const {
+        const std::size_t own = stages[static_cast<std::size_t>(stage)].capacity;
+        return own > 0 ? own : capacity;
+    }
+};
+
+struct IngestPipelineConfig {
+    // In PipelineLane order; bestBidAsk conflates by default
+    std::array<PipelineLaneConfig, PIPELINE_LANES> lanes = {
+        PipelineLaneConfig{},
+        PipelineLaneConfig{OverflowPolicy::Conflate},
+        PipelineLaneConfig{},
+    };
+    RecordFormat format = RecordFormat::Json;
+    // Items a stage takes from its queue at once
+    std::size_t batch = 256;
+    // Publish stage: wait before offering a refused record again
+    int publish_retry_ms = 2;
+};
+
+struct PipelineStageStats {
+    // Items the stage finished, and the time it spent on them
+    uint64_t items = 0;
+    uint64_t busy_us = 0;
+    // Microseconds from receive to the stage's output, per item
+    LatencyHistogram::Summary latency;
+};
+
+struct PipelineLaneStats {
+    // In PipelineStage order
+    std::array<PipelineStageStats, PIPELINE_STAGES> stages;
+    StageQueueStats ingress;
+    StageQueueStats books;
+    StageQueueStats publish;
+    uint64_t frames = 0;
+    uint64_t records = 0;
+    // Frames the decode stage could not serialize
+    uint64_t decode_errors = 0;
+    uint64_t published = 0;
+    // Times a producer refused a record and the stage waited
+    uint64_t publish_waits = 0;
+    // Records a producer rejected outright (too large, bad key) or that
+    // stop() abandoned
+    uint64_t publish_errors = 0;
+};
+
+class IngestPipeline : public FrameSink {
+public:
+    explicit IngestPipeline(IngestPipelineConfig config) : config_(std::move(config)) {
+        for (std::size_t i = 0; i < PIPELINE_LANES; ++i) {
+            if (config_.lanes[i].policy == OverflowPolicy::Conflate &&
+                static_cast<PipelineLane>(i) != PipelineLane::BestBidAsk) {
+                throw std::runtime_error(std::string("IngestPipeline: only bestBidAsk can conflate, not ") +
+                                         PIPELINE_LANE_NAMES[i]);
+            }
+            lanes_[i] = std::make_unique<Lane>(config_.lanes[i], PIPELINE_LANE_NAMES[i]);
+        }
+        config_.batch = std::max<std::size_t>(config_.batch, 1);
+        metrics_.publish([this](MetricsWriter &out) { write_metrics(out); });
+        memory_.publish([this](MemoryReport &out) { report_memory(out); });
+    }
+
+    ~IngestPipeline() override { stop(0); }
+
+    IngestPipeline(const IngestPipeline &) = delete;
+    IngestPipeline &operator=(const IngestPipeline &) = delete;
+
+    // Publish `lane`'s records through `producer` (not owned; it must
+    // outlive the pipeline), and through every producer attached before it:
+    // each record goes to each of them. Before start() only.
+    void attach_publisher(PipelineLane lane, KinesisProducer *producer) {
+        std::lock_guard lock(mutex_);
+        require_stopped("attach_publisher");
+        lanes_[static_cast<std::size_t>(lane)]->producers.push_back(producer);
+    }
+
+    // Apply depth frames to `pool`'s books (not owned). Before start() only.
+    void attach_books(DecoderPool *pool) {
+        std::lock_guard lock(mutex_);
+        require_stopped("attach_books");
+        books_ = pool;
+    }
+
+    void start() {
+        std::lock_guard lock(mutex_);
+        if (started_) {
+            return;
+        }
+        started_ = true;
+        for (std::size_t i = 0; i < PIPELINE_LANES; ++i) {
+            Lane &lane = *lanes_[i];
+            const bool books = books_ != nullptr && static_cast<PipelineLane>(i) == PipelineLane::Depth;
+            lane.decoder = std::thread([this, &lane, books] {
+                pin_stage(lane, PipelineStage::Decode);
+                run_decode(lane, books ? lane.books : lane.publish);
+            });
+            if (books) {
+                lane.book = std::thread([this, &lane] {
+                    pin_stage(lane, PipelineStage::Books);
+                    run_books(lane);
+                });
+            }
+            if (!lane.producers.empty()) {
+                lane.publisher = std::thread([this, &lane] {
+                    pin_stage(lane, PipelineStage::Publish);
+                    run_publish(lane);
+                });
+            }
+        }
+    }
+
+    // Stop taking frames, then let every lane drain into its producers for
+    // up to `timeout_ms`; what is left after that is dropped and counted.
+    // Lanes without a producer keep their records for take().
+    void stop(int timeout_ms) {
+        std::unique_lock lock(mutex_);
+        if (!started_ || stopped_) {
+            return;
+        }
+        stopped_ = true;
+        lock.unlock();
+
+        for (auto &lane : lanes_) {
+            lane->ingress.close();
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+        lock.lock();
+        drained_.wait_until(lock, deadline, [this] { return lanes_done_ == PIPELINE_LANES; });
+        const bool abandon = lanes_done_ < PIPELINE_LANES;
+        lock.unlock();
+        if (abandon) {
+            abandon_.store(true, std::memory_order_relaxed);
+            for (auto &lane : lanes_) {
+                lane->ingress.close(true);
+                lane->books.close(true);
+                lane->publish.close(!lane->producers.empty());
+            }
+        }
+        for (auto &lane : lanes_) {
+            for (std::thread *thread : {&lane->decoder, &lane->book, &lane->publisher}) {
+                if (thread->joinable()) {
+                    thread->join();
+                }
+            }
+        }
+    }
+
+    // FrameSink: queue a receive thread's frame (copied). False when the
+    // frame was dropped: not a stream template, unreadable, or the
+    // pipeline is stopped. Blocks while a full block-policy lane waits.
+    bool accept(std::span<const char> frame, uint64_t received_us) override {
+        using spot_sbe::MessageHeader;
+
+        PipelineLane lane{};
+        std::string_view symbol;
+        if (frame.size() < MessageHeader::encodedLength()) {
+            unrouted_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        MessageHeader header{const_cast<char *>(frame.data()), frame.size()};
+        const uint16_t template_id = header.templateId();
+        if (!pipeline_lane(template_id, lane) ||
+            stream_frame_symbol(template_id, frame.data() + MessageHeader::encodedLength(),
+                                frame.size() - MessageHeader::encodedLength(), header.blockLength(),
+                                symbol) != ParseError::None) {
+            unrouted_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Lane &target = *lanes_[static_cast<std::size_t>(lane)];
+        uint64_t key = 0;
+        if (target.ingress.policy() == OverflowPolicy::Conflate) {
+            // 0 (no conflation) when the symbol table is full
+            key = static_cast<uint64_t>(symbol_table().intern(symbol)) + 1;
+            key = key > INVALID_SYMBOL_ID ? 0 : key;
+        }
+        PipelineItem item;
+        item.frame.assign(frame.begin(), frame.end());
+        item.symbol.assign(symbol);
+        item.received_us = received_us;
+        return target.ingress.push(std::move(item), key);
+    }
+
+    // Queue a frame from the caller's thread, as a receive thread would
+    bool submit(std::span<const char> frame, uint64_t received_us) { return accept(frame, received_us); }
+
+    // Move up to `max_items` decoded frames of a lane without a producer
+    // into `out`, waiting up to `timeout_ms` for the first
+    std::size_t take(PipelineLane lane, std::vector<PipelineItem> &out, std::size_t max_items, int timeout_ms) {
+        const std::size_t index = static_cast<std::size_t>(lane);
+        Lane &source = *lanes_[index];
+        if (!source.producers.empty()) {
+            throw std::runtime_error(std::string("IngestPipeline: the ") + PIPELINE_LANE_NAMES[index] +
+                                     " lane publishes to its producers");
+        }
+        return source.publish.pop(out, max_items, timeout_ms);
+    }
+
+    PipelineLaneStats lane_stats(PipelineLane lane) const {
+        const Lane &source = *lanes_[static_cast<std::size_t>(lane)];
+        PipelineLaneStats stats;
+        for (std::size_t i = 0; i < PIPELINE_STAGES; ++i) {
+            const StageMeter &meter = source.stages[i];
+            stats.stages[i].items = meter.items.load(std::memory_order_relaxed);
+            stats.stages[i].busy_us = meter.busy_us.load(std::memory_order_relaxed);
+            stats.stages[i].latency = meter.latency.summary();
+        }
+        stats.ingress = source.ingress.stats();
+        stats.books = source.books.stats();
+        stats.publish = source.publish.stats();
+        stats.frames = source.frames.load(std::memory_order_relaxed);
+        stats.records = source.records.load(std::memory_order_relaxed);
+        stats.decode_errors = source.decode_errors.load(std::memory_order_relaxed);
+        stats.published = source.published.load(std::memory_order_relaxed);
+        stats.publish_waits = source.publish_waits.load(std::memory_order_relaxed);
+        stats.publish_errors = source.publish_errors.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    // Frames of no lane, or whose symbol could not be read
+    uint64_t unrouted() const { return unrouted_.load(std::memory_order_relaxed); }
+    // Depth diffs the book stage found past a sequence gap
+    uint64_t book_gaps() const { return book_gaps_.load(std::memory_order_relaxed); }
+
+    // First failure to pin a stage thread to its core; the stage runs unpinned
+    std::string placement_error() const {
+        std::lock_guard lock(mutex_);
+        return placement_error_;
+    }
+
+    bool has_publisher(PipelineLane lane) const { return !lanes_[static_cast<std::size_t>(lane)]->producers.empty(); }
+    const IngestPipelineConfig &config() const { return config_; }
+
+private:
+    // Written by the stage's own thread only
+    struct StageMeter {
+        std::atomic<uint64_t> items{0};
+        std::atomic<uint64_t> busy_us{0};
+        LatencyHistogram latency;
+
+        // An item received at `received_us` leaves the stage at `now_us`
+        void passed(uint64_t received_us, uint64_t now_us) {
+            latency.record(now_us > received_us ? now_us - received_us : 0);
+            bump_counter(items);
+        }
+
+        // The stage worked on a batch from `start_us` to `end_us`
+        void worked(uint64_t start_us, uint64_t end_us) {
+            bump_counter(busy_us, end_us > start_us ? end_us - start_us : 0);
+        }
+    };
+
+    struct Lane {
+        Lane(const PipelineLaneConfig &config, const char *name)
+            : config(config), name(name),
+              ingress(config.queue_capacity(PipelineStage::Decode), config.policy),
+              books(config.queue_capacity(PipelineStage::Books), config.policy),
+              publish(config.queue_capacity(PipelineStage::Publish), config.policy) {}
+
+        const PipelineLaneConfig config;
+        const char *const name;
+        StageQueue<PipelineItem> ingress;
+        StageQueue<PipelineItem> books;
+        StageQueue<PipelineItem> publish;
+        std::vector<KinesisProducer *> producers;
+        std::array<StageMeter, PIPELINE_STAGES> stages;
+        std::thread decoder;
+        std::thread book;
+        std::thread publisher;
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> records{0};
+        std::atomic<uint64_t> decode_errors{0};
+        std::atomic<uint64_t> published{0};
+        std::atomic<uint64_t> publish_waits{0};
+        std::atomic<uint64_t> publish_errors{0};
+    };
+
+    void require_stopped(const char *what) const {
+        if (started_) {
+            throw std::runtime_error(std::string("IngestPipeline.") + what + ": the pipeline has started");
+        }
+    }
+
+    // On the stage's thread: pin it to its configured core. Unpinned is
+    // still a working stage, so a failure is only reported.
+    void pin_stage(const Lane &lane, PipelineStage stage) {
+        const int cpu = lane.config.stages[static_cast<std::size_t>(stage)].cpu;
+        if (cpu < 0) {
+            return;
+        }
+        if (std::string error = pin_current_thread(cpu); !error.empty()) {
+            std::lock_guard lock(mutex_);
+            if (placement_error_.empty()) {
+                placement_error_ = std::move(error);
+            }
+        }
+    }
+
+    // Conflated lanes keep conflating after the ingress: a frame the
+    // decode stage already passed on can still be replaced downstream
+    static uint64_t conflation_key(const StageQueue<PipelineItem> &queue, const PipelineItem &item) {
+        if (queue.policy() != OverflowPolicy::Conflate) {
+            return 0;
+        }
+        const uint64_t key = static_cast<uint64_t>(symbol_table().intern(item.symbol)) + 1;
+        return key > INVALID_SYMBOL_ID ? 0 : key;
+    }
+
+    void run_decode(Lane &lane, StageQueue<PipelineItem> &next) {
+        const bool keep_frames = &next == &lane.books;
+        RecordOptions options;
+        options.format = config_.format;
+        options.max_records = std::numeric_limits<std::size_t>::max();
+        RecordScratch scratch;
+        RecordBatch batch;
+        std::vector<char> buffer(64 * 1024);
+        std::vector<PipelineItem> items;
+        StageMeter &meter = lane.stages[static_cast<std::size_t>(PipelineStage::Decode)];
+        while (lane.ingress.pop(items, config_.batch, -1) > 0) {
+            const uint64_t start_us = ingest_time_us();
+            for (PipelineItem &item : items) {
+                lane.frames.fetch_add(1, std::memory_order_relaxed);
+                batch = RecordBatch{};
+                options.ingest_us = item.received_us;
+                RecordWriter writer{std::span<char>(buffer)};
+                // Full only when a frame's records outgrow the buffer
+                while (serialize_frame(std::span<char>(item.frame), 0, options, writer, batch, scratch) ==
+                       SerializeStatus::Full) {
+                    buffer.resize(buffer.size() * 2);
+                    writer = RecordWriter{std::span<char>(buffer)};
+                }
+                if (!batch.error_frames.empty() || !batch.unknown_frames.empty()) {
+                    lane.decode_errors.fetch_add(1, std::memory_order_relaxed);
+                    native_log(PIPELINE_DECODE_ERROR_LOG, lane.name, item.frame.size(),
+                               batch.error_frames.empty() ? "unknown template" : "malformed");
+                    continue;
+                }
+                const std::span<const char> written = writer.written();
+                item.records.assign(written.begin(), written.end());
+                item.ends.clear();
+                for (std::size_t i = 1; i < batch.offsets.size(); ++i) {
+                    item.ends.push_back(static_cast<uint32_t>(batch.offsets[i]));
+                }
+                lane.records.fetch_add(item.ends.size(), std::memory_order_relaxed);
+                if (!keep_frames) {
+                    std::vector<char>().swap(item.frame);
+                }
+                const uint64_t key = conflation_key(next, item);
+                meter.passed(item.received_us, ingest_time_us());
+                next.push(std::move(item), key);
+            }
+            meter.worked(start_us, ingest_time_us());
+            items.clear();
+        }
+        next.close();
+        if (!keep_frames) {
+            lane_done();
+        }
+    }
+
+    // Depth lane with a DecoderPool: apply each batch to the books
+    void run_books(Lane &lane) {
+        std::vector<PipelineItem> items;
+        std::vector<std::span<char>> frames;
+        std::vector<std::string> gaps;
+        StageMeter &meter = lane.stages[static_cast<std::size_t>(PipelineStage::Books)];
+        while (lane.books.pop(items, config_.batch, -1) > 0) {
+            const uint64_t start_us = ingest_time_us();
+            frames.clear();
+            for (PipelineItem &item : items) {
+                frames.emplace_back(item.frame);
+            }
+            BatchColumns columns;
+            gaps.clear();
+            books_->decode(frames, columns, 0, gaps);
+            book_gaps_.fetch_add(gaps.size(), std::memory_order_relaxed);
+            const uint64_t applied_us = ingest_time_us();
+            for (PipelineItem &item : items) {
+                std::vector<char>().swap(item.frame);
+                meter.passed(item.received_us, applied_us);
+                if (!item.ends.empty()) {
+                    lane.publish.push(std::move(item));
+                }
+            }
+            meter.worked(start_us, ingest_time_us());
+            items.clear();
+        }
+        lane.publish.close();
+        lane_done();
+    }
+
+    void run_publish(Lane &lane) {
+        std::vector<PipelineItem> items;
+        StageMeter &meter = lane.stages[static_cast<std::size_t>(PipelineStage::Publish)];
+        while (lane.publish.pop(items, config_.batch, -1) > 0) {
+            const uint64_t start_us = ingest_time_us();
+            for (const PipelineItem &item : items) {
+                uint32_t start = 0;
+                for (const uint32_t end : item.ends) {
+                    const std::span<const char> record(item.records.data() + start, end - start);
+                    for (KinesisProducer *producer : lane.producers) {
+                        publish_record(lane, *producer, record, item.symbol);
+                    }
+                    start = end;
+                }
+                meter.passed(item.received_us, ingest_time_us());
+            }
+            meter.worked(start_us, ingest_time_us());
+            items.clear();
+        }
+    }
+
+    void publish_record(Lane &lane, KinesisProducer &producer, std::span<const char> record,
+                        std::string_view partition_key) {
+        try {
+            while (!producer.put(record, partition_key)) {
+                if (abandon_.load(std::memory_order_relaxed)) {
+                    lane.publish_errors.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                lane.publish_waits.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::sleep_for(std::chrono::milliseconds(config_.publish_retry_ms));
+            }
+            lane.published.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::runtime_error &e) {
+            lane.publish_errors.fetch_add(1, std::memory_order_relaxed);
+            native_log(PIPELINE_PUBLISH_ERROR_LOG, lane.name, e.what());
+        }
+    }
+
+    // A lane's last stage before publishing has closed its output
+    void lane_done() {
+        {
+            std::lock_guard lock(mutex_);
+            ++lanes_done_;
+        }
+        drained_.notify_all();
+    }
+
+    // Prometheus families, per lane and stage queue; runs on the scrape thread
+    void write_metrics(MetricsWriter &out) const {
+        using Type = MetricType;
+        for (std::size_t i = 0; i < PIPELINE_LANES; ++i) {
+            const PipelineLaneStats stats = lane_stats(static_cast<PipelineLane>(i));
+            const MetricLabels lane_labels = {{"pipeline", metrics_.instance()}, {"lane", PIPELINE_LANE_NAMES[i]}};
+            const auto counter = [&](std::string_view family, std::string_view help, uint64_t value) {
+                out.sample(family, Type::Counter, help, lane_labels, value);
+            };
+            counter("sbe_pipeline_frames_total", "Frames the decode stage took", stats.frames);
+            counter("sbe_pipeline_records_total", "Records the decode stage wrote", stats.records);
+            counter("sbe_pipeline_decode_errors_total", "Frames that could not be serialized", stats.decode_errors);
+            counter("sbe_pipeline_published_total", "Records handed to the lane's producers, once per producer",
+                    stats.published);
+            counter("sbe_pipeline_publish_waits_total", "Waits for room in the lane's producers", stats.publish_waits);
+            counter("sbe_pipeline_publish_errors_total", "Records the producer rejected or stop() abandoned",
+                    stats.publish_errors);
+
+            for (std::size_t s = 0; s < PIPELINE_STAGES; ++s) {
+                const PipelineStageStats &stage = stats.stages[s];
+                const MetricLabels labels = {{"pipeline", metrics_.instance()},
+                                             {"lane", PIPELINE_LANE_NAMES[i]},
+                                             {"stage", PIPELINE_STAGE_NAMES[s]}};
+                out.sample("sbe_pipeline_stage_items_total", Type::Counter, "Items the stage finished", labels,
+                           stage.items);
+                out.sample("sbe_pipeline_stage_busy_microseconds_total", Type::Counter,
+                           "Time the stage spent on its batches, waits for room downstream included", labels,
+                           stage.busy_us);
+                if (stage.latency.count > 0) {
+                    out.summary("sbe_pipeline_stage_latency_seconds", "Receive to the stage's output, per item",
+                                labels,
+                                {{"0.5", stage.latency.p50 * 1e-6},
+                                 {"0.99", stage.latency.p99 * 1e-6},
+                                 {"0.999", stage.latency.p999 * 1e-6},
+                                 {"1", stage.latency.max * 1e-6}},
+                                stage.latency.sum * 1e-6, stage.latency.count);
+                }
+            }
+
+            const std::array<std::pair<const char *, const StageQueueStats *>, 3> queues = {{
+                {"ingress", &stats.ingress},
+                {"books", &stats.books},
+                {"publish", &stats.publish},
+            }};
+            for (const auto &[stage, queue] : queues) {
+                const MetricLabels labels = {
+                    {"pipeline", metrics_.instance()}, {"lane", PIPELINE_LANE_NAMES[i]}, {"stage", stage}};
+                out.sample("sbe_pipeline_queue_depth", Type::Gauge, "Items waiting in the stage queue", labels,
+                           queue->depth);
+                out.sample("sbe_pipeline_queue_bytes", Type::Gauge, "Bytes waiting in the stage queue", labels,
+                           queue->bytes);
+                out.sample("sbe_pipeline_queue_capacity", Type::Gauge, "Stage queue capacity in items", labels,
+                           queue->capacity);
+                out.sample("sbe_pipeline_queue_high_water", Type::Gauge, "Most items ever waiting in the queue",
+                           labels, queue->high_water);
+                out.sample("sbe_pipeline_queue_dropped_total", Type::Counter, "Items dropped by the overflow policy",
+                           labels, queue->dropped);
+                out.sample("sbe_pipeline_queue_conflated_total", Type::Counter, "Items replaced by a newer one",
+                           labels, queue->conflated);
+                out.sample("sbe_pipeline_queue_blocked_total", Type::Counter, "Pushes that waited for room", labels,
+                           queue->blocked);
+                out.sample("sbe_pipeline_queue_blocked_microseconds_total", Type::Counter,
+                           "Time pushes spent waiting for room", labels, queue->blocked_us);
+            }
+        }
+        const MetricLabels labels = {{"pipeline", metrics_.instance()}};
+        out.sample("sbe_pipeline_unrouted_total", Type::Counter, "Frames of no lane, or with an unreadable symbol",
+                   labels, unrouted());
+        out.sample("sbe_pipeline_book_gaps_total", Type::Counter, "Depth diffs the book stage found past a gap",
+                   labels, book_gaps());
+    }
+
+    void report_memory(MemoryReport &out) const {
+        for (const auto &lane : lanes_) {
+            for (const StageQueue<PipelineItem> *queue : {&lane->ingress, &lane->books, &lane->publish}) {
+                out.add("pipeline_queue", "", queue->memory_usage());
+            }
+        }
+    }
+
+    IngestPipelineConfig config_;
+    std::array<std::unique_ptr<Lane>, PIPELINE_LANES> lanes_;
+    DecoderPool *books_ = nullptr;
+
+    mutable std::mutex mutex_;
+    std::condition_variable drained_;
+    bool started_ = false;
+    bool stopped_ = false;
+    std::size_t lanes_done_ = 0;
+    std::string placement_error_;
+    std::atomic<bool> abandon_{false};
+
+    std::atomic<uint64_t> unrouted_{0};
+    std::atomic<uint64_t> book_gaps_{0};
+    MetricsRegistration metrics_;
+    MemoryRegistration memory_;
+};
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Per-object lock for bindings with mutable per-call state.
+ *
+ * With the GIL, a binding that does not release it runs alone on its
+ * object. A free-threaded build (Py_GIL_DISABLED, CPython 3.13t) gives no
+ * such guarantee, so SBEDecoder's dict decoders, which rewind a level
+ * arena, learn result shapes, count down perf samples and are the single
+ * writer of their stats, take the decoder's InstanceLock for the call.
+ *
+ * There it is a PyMutex: a thread that blocks on it detaches from the
+ * interpreter first, so a waiter never holds up the garbage collector or
+ * a stop-the-world pause. With the GIL it compiles to nothing. It is
+ * BasicLockable, so std::unique_lock can drop it before calling back into
+ * Python code that may re-enter the object.
+ */
+
+#ifndef _SBE_INSTANCE_LOCK_H_
+#define _SBE_INSTANCE_LOCK_H_
+
+#include <Python.h>
+
+class InstanceLock {
+public:
+    InstanceLock() = default;
+    InstanceLock(const InstanceLock &) = delete;
+    InstanceLock &operator=(const InstanceLock &) = delete;
+
+#ifdef Py_GIL_DISABLED
+    void lock() { PyMutex_Lock(&mutex_); }
+    void unlock() { PyMutex_Unlock(&mutex_); }
+
+private:
+    PyMutex mutex_{};
+#else
+    void lock() {}
+    void unlock() {}
+#endif
+};
+
+#endif
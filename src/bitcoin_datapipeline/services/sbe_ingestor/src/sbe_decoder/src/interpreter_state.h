@@ -0,0 +1,89 @@
+/*
+ * Per-interpreter state for the Python objects the module caches.
+ *
+ * The dict API reuses Python objects across calls: interned result keys,
+ * one str per SymbolId and per ParseError cause. As process-wide statics
+ * they would be shared by sub-interpreters, each of which has its own
+ * objects (and, since 3.12, possibly its own GIL), and filled lazily by
+ * racing threads on a free-threaded build. interpreter_state<State>() gives
+ * each interpreter its own State instead:
+ *
+ *   - created on first use in the interpreter, owned by a capsule in the
+ *     interpreter's state dict under State::STATE_KEY, and destroyed with
+ *     it, so no reference outlives the interpreter it belongs to
+ *   - created at most once: racing threads publish through
+ *     PyDict_SetDefault and the losers drop their copy
+ *   - found through a thread-local cache of the last interpreter ID, so
+ *     the hot path is two calls and a compare, no dict lookup
+ *
+ * A State must be safe to use from the threads of its interpreter: fully
+ * built in its constructor, or filled with its own synchronisation.
+ * Needs an attached thread state (the GIL, where there is one).
+ */
+
+#ifndef _SBE_INTERPRETER_STATE_H_
+#define _SBE_INTERPRETER_STATE_H_
+
+#include <pybind11/pybind11.h>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace py = pybind11;
+
+namespace interpreter_state_detail {
+
+template <typename State>
+void destroy(PyObject *capsule) {
+    delete static_cast<State *>(PyCapsule_GetPointer(capsule, State::STATE_KEY));
+}
+
+// State's capsule in `interp`'s state dict, created if it has none yet
+template <typename State>
+State *find_or_create(PyInterpreterState *interp) {
+    PyObject *dict = PyInterpreterState_GetDict(interp);
+    if (dict == nullptr) {
+        throw std::runtime_error(std::string("no interpreter state dict for ") + State::STATE_KEY);
+    }
+    if (PyObject *existing = PyDict_GetItemString(dict, State::STATE_KEY)) {
+        return static_cast<State *>(PyCapsule_GetPointer(existing, State::STATE_KEY));
+    }
+    auto state = std::make_unique<State>();
+    PyObject *capsule = PyCapsule_New(state.get(), State::STATE_KEY, &destroy<State>);
+    if (capsule == nullptr) {
+        throw py::error_already_set();
+    }
+    state.release();
+    PyObject *key = PyUnicode_FromString(State::STATE_KEY);
+    // Borrowed: the capsule that won, ours or another thread's
+    PyObject *winner = key == nullptr ? nullptr : PyDict_SetDefault(dict, key, capsule);
+    Py_XDECREF(key);
+    Py_DECREF(capsule);
+    if (winner == nullptr) {
+        throw py::error_already_set();
+    }
+    return static_cast<State *>(PyCapsule_GetPointer(winner, State::STATE_KEY));
+}
+
+} // namespace interpreter_state_detail
+
+// The calling thread's interpreter's State
+template <typename State>
+State &interpreter_state() {
+    struct Cached {
+        int64_t interpreter = -1;
+        State *state = nullptr;
+    };
+    static thread_local Cached cached;
+    PyInterpreterState *interp = PyInterpreterState_Get();
+    const int64_t id = PyInterpreterState_GetID(interp);
+    if (id != cached.interpreter) [[unlikely]] {
+        cached.state = interpreter_state_detail::find_or_create<State>(interp);
+        cached.interpreter = id;
+    }
+    return *cached.state;
+}
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * Captured ID ranges and the REST requests that fill the holes between them.
+ *
+ * An IdIntervalSet holds the trade IDs (or update IDs) a symbol already has
+ * as sorted, disjoint, non-adjacent closed intervals, so a day of aggTrades
+ * captured in a few runs is a few entries whatever its row count. Adding a
+ * run merges it with every interval it touches; adding a column of IDs
+ * collapses it into runs first, in one pass when it is sorted as REST pages
+ * and stream batches are.
+ *
+ * plan() turns the holes in [first, last] into fromId/limit requests. Each
+ * request returns up to `limit` consecutive IDs from its fromId, so the
+ * greedy cover is minimal: start at the first missing ID, take `limit`
+ * IDs, and start the next request at the first ID still missing after
+ * them. Short captured runs between holes are fetched again rather than
+ * costing a request of their own, and each request's limit is trimmed to
+ * the last ID it actually needs.
+ */
+
+#ifndef _SBE_INTERVAL_SET_H_
+#define _SBE_INTERVAL_SET_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+struct IdInterval {
+    int64_t first = 0;
+    int64_t last = 0;
+
+    int64_t size() const { return last - first + 1; }
+};
+
+struct IdRequest {
+    int64_t from_id = 0;
+    int64_t limit = 0;
+};
+
+class IdIntervalSet {
+public:
+    // Record IDs first..last as captured
+    void add(int64_t first, int64_t last) {
+        if (first > last) {
+            throw std::runtime_error("IdIntervalSet: first > last");
+        }
+        // Intervals that overlap or touch [first, last] merge into it
+        auto begin = std::lower_bound(intervals_.begin(), intervals_.end(), first,
+                                      [](const IdInterval &interval, int64_t id) { return interval.last < id - 1; });
+        auto end = begin;
+        while (end != intervals_.end() && end->first <= last + 1) {
+            first = std::min(first, end->first);
+            last = std::max(last, end->last);
+            ++end;
+        }
+        if (begin == end) {
+            intervals_.insert(begin, IdInterval{first, last});
+        } else {
+            *begin = IdInterval{first, last};
+            intervals_.erase(begin + 1, end);
+        }
+    }
+
+    // Record a column of captured IDs, in any order, duplicates allowed
+    void add_ids(std::span<const int64_t> ids) {
+        if (ids.empty()) {
+            return;
+        }
+        std::vector<int64_t> sorted;
+        if (!std::is_sorted(ids.begin(), ids.end())) {
+            sorted.assign(ids.begin(), ids.end());
+            std::sort(sorted.begin(), sorted.end());
+            ids = sorted;
+        }
+        int64_t run_first = ids[0];
+        int64_t run_last = ids[0];
+        for (std::size_t i = 1; i < ids.size(); ++i) {
+            if (ids[i] > run_last + 1) {
+                add(run_first, run_last);
+                run_first = ids[i];
+            }
+            run_last = ids[i];
+        }
+        add(run_first, run_last);
+    }
+
+    bool contains(int64_t id) const {
+        auto it = std::lower_bound(intervals_.begin(), intervals_.end(), id,
+                                   [](const IdInterval &interval, int64_t value) { return interval.last < value; });
+        return it != intervals_.end() && it->first <= id;
+    }
+
+    // The holes in [first, last]: IDs in it that are not captured
+    std::vector<IdInterval> missing(int64_t first, int64_t last) const {
+        std::vector<IdInterval> holes;
+        if (first > last) {
+            return holes;
+        }
+        int64_t next = first;
+        auto it = std::lower_bound(intervals_.begin(), intervals_.end(), first,
+                                   [](const IdInterval &interval, int64_t id) { return interval.last < id; });
+        for (; it != intervals_.end() && it->first <= last; ++it) {
+            if (it->first > next) {
+                holes.push_back(IdInterval{next, it->first - 1});
+            }
+            next = it->last + 1;
+        }
+        if (next <= last) {
+            holes.push_back(IdInterval{next, last});
+        }
+        return holes;
+    }
+
+    // The fewest fromId/limit requests that fetch every hole in [first, last]
+    std::vector<IdRequest> plan(int64_t first, int64_t last, int64_t limit) const {
+        if (limit <= 0) {
+            throw std::runtime_error("IdIntervalSet: limit must be positive");
+        }
+        std::vector<IdRequest> requests;
+        const std::vector<IdInterval> holes = missing(first, last);
+        std::size_t i = 0;
+        int64_t from = holes.empty() ? 0 : holes[0].first;
+        while (i < holes.size()) {
+            const int64_t window_last = from + limit - 1;
+            // The last ID this request needs: the end of the last hole it reaches
+            int64_t needed = from;
+            while (i < holes.size() && holes[i].first <= window_last) {
+                needed = std::min(holes[i].last, window_last);
+                if (holes[i].last > window_last) {
+                    break;
+                }
+                ++i;
+            }
+            requests.push_back(IdRequest{from, needed - from + 1});
+            if (i < holes.size()) {
+                from = std::max(holes[i].first, window_last + 1);
+            }
+        }
+        return requests;
+    }
+
+    const std::vector<IdInterval> &intervals() const { return intervals_; }
+    // Captured IDs in total
+    int64_t count() const {
+        int64_t total = 0;
+        for (const auto &interval : intervals_) {
+            total += interval.size();
+        }
+        return total;
+    }
+    bool empty() const { return intervals_.empty(); }
+    void clear() { intervals_.clear(); }
+
+private:
+    std::vector<IdInterval> intervals_;
+};
+
+#endif
@@ -0,0 +1,461 @@
+/*
+ * Coroutine executor for native ingest tasks.
+ *
+ * A thread per connection stops scaling somewhere in the hundreds of
+ * streams: each one is a stack, a scheduler entry and a wake-up per frame,
+ * and most of them sleep in poll() most of the time. IoExecutor instead
+ * runs C++20 coroutines (IoTask) on a fixed pool of worker threads over
+ * one epoll instance. Where a task would block on its socket it
+ * co_awaits readable(fd, timeout_ms), and its thread moves on to whichever
+ * task is ready, so many connections share a few threads:
+ *
+ *   readable(fd, timeout_ms)  resumes with true once `fd` is readable (or
+ *                             has failed, so the read reports why), false
+ *                             after timeout_ms (-1 waits for good)
+ *   sleep_for(ms)             resumes after `ms`
+ *   yield()                   resumes after the tasks already ready, so a
+ *                             busy task does not hold its thread forever
+ *   run_blocking(fn)          runs fn on a thread of its own and resumes
+ *                             with its result or exception; for calls with
+ *                             no readiness to wait on (DNS, TCP and TLS
+ *                             handshakes), which would stall the pool
+ *
+ * Workers take turns as the poller (leader/followers): a worker with
+ * nothing ready and no other worker polling calls epoll_wait until the
+ * next timer, moves the tasks whose fds or timers fired to the ready
+ * queue, and goes back to resuming tasks; the others sleep on a condition
+ * variable until there is work. An eventfd wakes the poller when a task is
+ * made ready from outside or a nearer timer is set while no worker is free.
+ *
+ * Registrations are one-shot (EPOLLONESHOT), so a fired fd stays quiet
+ * until its task waits on it again and a task is never resumed twice. A
+ * timeout removes the fd before resuming the task. An fd is waited on by
+ * one task at a time; a task resumes on whichever worker is free, so its
+ * state must not be tied to a thread.
+ *
+ * Tasks are detached: spawn() starts one and its frame is freed when it
+ * returns. An exception escaping a task terminates, as it would escaping a
+ * std::thread. The destructor waits for every task to return; whoever
+ * spawned them must first make them return (StreamConnection::stop).
+ */
+
+#ifndef _SBE_IO_EXECUTOR_H_
+#define _SBE_IO_EXECUTOR_H_
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "page_memory.h"
+
+class IoExecutor;
+
+class IoTask {
+public:
+    struct promise_type {
+        IoExecutor *executor = nullptr;
+
+        IoTask get_return_object() { return IoTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept;
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    IoTask(IoTask &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    IoTask &operator=(IoTask &&) = delete;
+
+    // A task never spawned is never run
+    ~IoTask() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+private:
+    friend class IoExecutor;
+
+    explicit IoTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    std::coroutine_handle<promise_type> release() { return std::exchange(handle_, {}); }
+
+    std::coroutine_handle<promise_type> handle_;
+};
+
+struct IoExecutorStats {
+    // Tasks resumed by the workers
+    std::atomic<uint64_t> resumes{0};
+    // epoll_wait calls, and waits on an fd that ran out of time
+    std::atomic<uint64_t> polls{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::atomic<uint64_t> blocking_calls{0};
+};
+
+class IoExecutor {
+    using Clock = std::chrono::steady_clock;
+
+    // A task suspended on an fd, a timer or both
+    struct Waiter {
+        explicit Waiter(int fd = -1) : fd(fd) {}
+
+        std::coroutine_handle<> handle;
+        int fd;
+        bool has_timer = false;
+        std::multimap<Clock::time_point, Waiter *>::iterator timer;
+        // The fd fired, rather than the timer
+        bool readable = false;
+        // Registering the fd failed (errno)
+        int error = 0;
+    };
+
+public:
+    // `threads` workers (at least one); cpu_affinity[i] pins worker i
+    explicit IoExecutor(std::size_t threads, std::vector<int> cpu_affinity = {})
+        : epoll_fd_(::epoll_create1(EPOLL_CLOEXEC)), wake_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (epoll_fd_ < 0 || wake_fd_ < 0) {
+            const std::string error = std::strerror(errno);
+            close_fds();
+            throw std::runtime_error("IoExecutor: " + error);
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event) != 0) {
+            const std::string error = std::strerror(errno);
+            close_fds();
+            throw std::runtime_error("IoExecutor: " + error);
+        }
+        threads = std::max<std::size_t>(threads, 1);
+        pin_errors_.resize(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            const int cpu = i < cpu_affinity.size() ? cpu_affinity[i] : -1;
+            workers_.emplace_back([this, i, cpu] { work(i, cpu); });
+        }
+    }
+
+    ~IoExecutor() {
+        {
+            std::unique_lock lock(mutex_);
+            tasks_done_.wait(lock, [this] { return tasks_ == 0; });
+            stopping_ = true;
+            work_ready_.notify_all();
+        }
+        wake_poller();
+        for (std::thread &worker : workers_) {
+            worker.join();
+        }
+        close_fds();
+    }
+
+    IoExecutor(const IoExecutor &) = delete;
+    IoExecutor &operator=(const IoExecutor &) = delete;
+
+    // Start `task` on a worker
+    void spawn(IoTask task) {
+        std::coroutine_handle<IoTask::promise_type> handle = task.release();
+        handle.promise().executor = this;
+        {
+            std::lock_guard lock(mutex_);
+            ++tasks_;
+        }
+        schedule(handle);
+    }
+
+    std::size_t threads() const { return workers_.size(); }
+
+    // Tasks spawned and not yet returned
+    std::size_t tasks() const {
+        std::lock_guard lock(mutex_);
+        return tasks_;
+    }
+
+    const IoExecutorStats &stats() const { return stats_; }
+
+    // Workers that could not be pinned, as "worker i: why"
+    std::vector<std::string> pin_errors() const {
+        std::lock_guard lock(mutex_);
+        std::vector<std::string> errors;
+        for (std::size_t i = 0; i < pin_errors_.size(); ++i) {
+            if (!pin_errors_[i].empty()) {
+                errors.push_back("worker " + std::to_string(i) + ": " + pin_errors_[i]);
+            }
+        }
+        return errors;
+    }
+
+    auto readable(int fd, int timeout_ms) {
+        struct Awaiter {
+            IoExecutor &executor;
+            int timeout_ms;
+            Waiter waiter;
+
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                waiter.handle = handle;
+                return executor.wait_for(waiter, timeout_ms);
+            }
+            bool await_resume() const {
+                if (waiter.error != 0) {
+                    throw std::runtime_error(std::string("IoExecutor: epoll_ctl: ") + std::strerror(waiter.error));
+                }
+                return waiter.readable;
+            }
+        };
+        return Awaiter{*this, timeout_ms, Waiter(fd)};
+    }
+
+    auto sleep_for(std::chrono::milliseconds duration) {
+        struct Awaiter {
+            IoExecutor &executor;
+            int timeout_ms;
+            Waiter waiter;
+
+            bool await_ready() const noexcept { return timeout_ms <= 0; }
+            bool await_suspend(std::coroutine_handle<> handle) {
+                waiter.handle = handle;
+                return executor.wait_for(waiter, timeout_ms);
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this, static_cast<int>(duration.count()), Waiter{}};
+    }
+
+    auto yield() {
+        struct Awaiter {
+            IoExecutor &executor;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) { executor.schedule(handle); }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this};
+    }
+
+    // co_await run_blocking(fn): fn() on a thread of its own
+    template <typename Fn>
+    auto run_blocking(Fn fn) {
+        struct Awaiter {
+            IoExecutor &executor;
+            Fn fn;
+            std::exception_ptr error;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle) {
+                executor.stats_.blocking_calls.fetch_add(1, std::memory_order_relaxed);
+                // Nothing of the awaiter or the executor is touched once
+                // the task is scheduled: it may have resumed and returned
+                std::thread([this, handle] {
+                    try {
+                        fn();
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                    executor.schedule(handle);
+                }).detach();
+            }
+            void await_resume() {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        };
+        return Awaiter{*this, std::move(fn), nullptr};
+    }
+
+private:
+    friend struct IoTask::promise_type;
+
+    static constexpr std::size_t MAX_EVENTS = 64;
+
+    void close_fds() {
+        if (epoll_fd_ >= 0) {
+            ::close(epoll_fd_);
+        }
+        if (wake_fd_ >= 0) {
+            ::close(wake_fd_);
+        }
+    }
+
+    void schedule(std::coroutine_handle<> handle) {
+        std::lock_guard lock(mutex_);
+        ready_.push_back(handle);
+        notify_locked();
+    }
+
+    // A task returned (its frame is already gone)
+    void task_done() {
+        std::lock_guard lock(mutex_);
+        if (--tasks_ == 0) {
+            tasks_done_.notify_all();
+        }
+    }
+
+    // Hand new work to an idle worker, or to the poller when none is idle
+    void notify_locked() {
+        if (idle_ > 0) {
+            work_ready_.notify_one();
+        } else if (polling_) {
+            wake_poller();
+        }
+    }
+
+    void wake_poller() {
+        const uint64_t one = 1;
+        [[maybe_unused]] const ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    }
+
+    // Arm `waiter`'s fd and timer; false (not suspended) when arming failed
+    bool wait_for(Waiter &waiter, int timeout_ms) {
+        std::lock_guard lock(mutex_);
+        if (waiter.fd >= 0) {
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+            event.data.ptr = &waiter;
+            // Registrations outlive a wait; a closed fd drops its own
+            if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, waiter.fd, &event) != 0 &&
+                (errno != ENOENT || ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, waiter.fd, &event) != 0)) {
+                waiter.error = errno;
+                return false;
+            }
+        }
+        if (timeout_ms >= 0) {
+            const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+            waiter.timer = timers_.emplace(deadline, &waiter);
+            waiter.has_timer = true;
+            if (polling_ && deadline < poll_deadline_) {
+                wake_poller();
+            }
+        }
+        return true;
+    }
+
+    void work(std::size_t index, int cpu) {
+        if (cpu >= 0) {
+            if (std::string error = pin_current_thread(cpu); !error.empty()) {
+                std::lock_guard lock(mutex_);
+                pin_errors_[index] = std::move(error);
+            }
+        }
+        std::array<epoll_event, MAX_EVENTS> events;
+        std::unique_lock lock(mutex_);
+        while (true) {
+            if (!ready_.empty()) {
+                const std::coroutine_handle<> handle = ready_.front();
+                ready_.pop_front();
+                lock.unlock();
+                stats_.resumes.fetch_add(1, std::memory_order_relaxed);
+                handle.resume();
+                lock.lock();
+                continue;
+            }
+            if (stopping_) {
+                return;
+            }
+            if (polling_) {
+                ++idle_;
+                work_ready_.wait(lock);
+                --idle_;
+                continue;
+            }
+
+            polling_ = true;
+            int timeout_ms = -1;
+            poll_deadline_ = Clock::time_point::max();
+            if (!timers_.empty()) {
+                poll_deadline_ = timers_.begin()->first;
+                const auto wait = std::chrono::ceil<std::chrono::milliseconds>(poll_deadline_ - Clock::now());
+                timeout_ms = static_cast<int>(std::max<int64_t>(wait.count(), 0));
+            }
+            lock.unlock();
+            const int n = ::epoll_wait(epoll_fd_, events.data(), static_cast<int>(events.size()), timeout_ms);
+            stats_.polls.fetch_add(1, std::memory_order_relaxed);
+            lock.lock();
+            polling_ = false;
+
+            // Fds first, so a task whose fd and timer both fired reads
+            for (int i = 0; i < n; ++i) {
+                auto *waiter = static_cast<Waiter *>(events[i].data.ptr);
+                if (waiter == nullptr) {
+                    uint64_t count = 0;
+                    [[maybe_unused]] const ssize_t read = ::read(wake_fd_, &count, sizeof(count));
+                    continue;
+                }
+                if (waiter->has_timer) {
+                    timers_.erase(waiter->timer);
+                    waiter->has_timer = false;
+                }
+                waiter->readable = true;
+                ready_.push_back(waiter->handle);
+            }
+            const Clock::time_point now = Clock::now();
+            while (!timers_.empty() && timers_.begin()->first <= now) {
+                Waiter *waiter = timers_.begin()->second;
+                timers_.erase(timers_.begin());
+                waiter->has_timer = false;
+                if (waiter->fd >= 0) {
+                    // Removed, so a late event (a hangup is reported even
+                    // unasked) never reaches a waiter that is gone
+                    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, waiter->fd, nullptr);
+                    stats_.timeouts.fetch_add(1, std::memory_order_relaxed);
+                }
+                ready_.push_back(waiter->handle);
+            }
+            // This worker takes the first; wake others for the rest and to
+            // take over polling
+            for (std::size_t i = 0; i < ready_.size() && i < idle_; ++i) {
+                work_ready_.notify_one();
+            }
+        }
+    }
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    IoExecutorStats stats_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable tasks_done_;
+    std::deque<std::coroutine_handle<>> ready_;
+    std::multimap<Clock::time_point, Waiter *> timers_;
+    std::size_t tasks_ = 0;
+    std::size_t idle_ = 0;
+    bool polling_ = false;
+    Clock::time_point poll_deadline_ = Clock::time_point::max();
+    bool stopping_ = false;
+    std::vector<std::string> pin_errors_;
+    std::vector<std::thread> workers_;
+};
+
+inline auto IoTask::promise_type::final_suspend() noexcept {
+    struct Awaiter {
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+            IoExecutor *executor = handle.promise().executor;
+            handle.destroy();
+            executor->task_done();
+        }
+        void await_resume() const noexcept {}
+    };
+    return Awaiter{};
+}
+
+#endif
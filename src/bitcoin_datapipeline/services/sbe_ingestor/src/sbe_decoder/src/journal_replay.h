@@ -0,0 +1,271 @@
+/*
+ * Replay of capture journals through the live receiver's event path.
+ *
+ * JournalReplay opens every journal file it is given (directories expand to
+ * their *.sbej files), merges the records of all files and stages each
+ * frame into an EventRing with stage_frame(), exactly as a receive thread
+ * does. ReplayOrder::Received merges records by receive time, as they were
+ * read live; ReplayOrder::Event merges SBE messages by exchange event time
+ * with JournalEventMerger (event_merge.h), the same order on every run. The consumer drains the ring with the same
+ * drain_events() columns as StreamReceiver::drain, so everything after the
+ * receiver runs unchanged on recorded data.
+ *
+ * Pacing is on the replay thread: speed 1 reproduces the recorded gaps
+ * between frames, speed N compresses them N times and speed 0 replays as
+ * fast as the consumer drains; it follows whichever time the replay is
+ * ordered by. Unlike the live receiver, a full ring makes
+ * replay wait rather than drop, so nothing captured is lost; only frames
+ * that could never fit the ring are skipped and counted. Frames keep their
+ * recorded receive time as ingest_ts_us.
+ */
+
+#ifndef _SBE_JOURNAL_REPLAY_H_
+#define _SBE_JOURNAL_REPLAY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch_decode.h"
+#include "capture_journal.h"
+#include "event_merge.h"
+#include "event_ring.h"
+#include "message_walk.h"
+
+// Journal files named by `paths`, directories expanded, in name order
+inline std::vector<std::string> journal_files(const std::vector<std::string> &paths) {
+    std::vector<std::string> files;
+    for (const auto &path : paths) {
+        if (!std::filesystem::is_directory(path)) {
+            files.push_back(path);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto &entry : std::filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file() && entry.path().extension() == ".sbej") {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        files.insert(files.end(), found.begin(), found.end());
+    }
+    return files;
+}
+
+enum class ReplayOrder : uint8_t { Received, Event };
+
+struct ReplayStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> dropped_frames{0};
+    // Receive time of the last frame staged
+    std::atomic<uint64_t> position_us{0};
+    std::atomic<bool> finished{false};
+};
+
+class JournalReplay {
+public:
+    // speed <= 0 replays as fast as possible
+    JournalReplay(const std::vector<std::string> &paths, double speed, bool raw_mantissa, std::size_t ring_capacity,
+                  ReplayOrder order = ReplayOrder::Received)
+        : speed_(speed), raw_mantissa_(raw_mantissa), order_(order), ring_(ring_capacity) {
+        const std::vector<std::string> files = journal_files(paths);
+        if (files.empty()) {
+            throw std::runtime_error("JournalReplay needs at least one journal file");
+        }
+        if (order_ == ReplayOrder::Event) {
+            merger_ = std::make_unique<JournalEventMerger>(files);
+            return;
+        }
+        for (const auto &file : files) {
+            sources_.push_back(Source{std::make_unique<JournalReader>(file)});
+        }
+    }
+
+    ~JournalReplay() { stop(); }
+
+    JournalReplay(const JournalReplay &) = delete;
+    JournalReplay &operator=(const JournalReplay &) = delete;
+
+    void start() {
+        if (started_ || running_.exchange(true)) {
+            return;
+        }
+        started_ = true;
+        worker_ = std::thread([this] { run(); });
+    }
+
+    // Stop early; a stopped replay does not resume
+    void stop() {
+        running_.store(false);
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+    }
+
+    // Same contract as StreamReceiver::drain
+    std::size_t drain(BatchColumns &out, std::size_t max_records, int timeout_ms) {
+        out.raw_mantissa = raw_mantissa_;
+        if (!wait_for_events([this] { return ring_.readable() > 0 || stats_.finished.load(); }, timeout_ms)) {
+            return 0;
+        }
+        return drain_events(ring_, out, max_records);
+    }
+
+    // Every frame staged and drained
+    bool done() { return stats_.finished.load() && ring_.readable() == 0; }
+
+    const ReplayStats &stats() const { return stats_; }
+    const DepthSequence &depth_sequence() const { return depth_sequence_; }
+    const EventRing &ring() const { return ring_; }
+    std::size_t files() const { return merger_ ? merger_->sources() : sources_.size(); }
+    double speed() const { return speed_; }
+    ReplayOrder order() const { return order_; }
+    // Event order only; read once the replay has finished
+    const JournalEventMerger *merger() const { return merger_.get(); }
+
+private:
+    static constexpr auto POLL_SLICE = std::chrono::milliseconds(100);
+    static constexpr auto FULL_RING_PAUSE = std::chrono::microseconds(50);
+
+    struct Source {
+        std::unique_ptr<JournalReader> reader;
+        JournalRecord head{};
+    };
+
+    void run() {
+        wall_start_ = std::chrono::steady_clock::now();
+        if (merger_) {
+            run_event_order();
+        } else {
+            run_received_order();
+        }
+        stats_.finished.store(true);
+    }
+
+    // Whole records by receive time, ties to the earlier file
+    void run_received_order() {
+        // (receive time, source)
+        KWayHeap<std::pair<uint64_t, uint32_t>> heap;
+        heap.reserve(sources_.size());
+        for (uint32_t i = 0; i < sources_.size(); ++i) {
+            if (sources_[i].reader->next(sources_[i].head)) {
+                heap.push({sources_[i].head.header->received_us, i});
+            }
+        }
+        while (running_.load() && !heap.empty()) {
+            Source &next = sources_[heap.top().second];
+            heap.pop();
+            const JournalRecord record = next.head;
+            if (!pace(record.header->received_us) || !publish(record)) {
+                break;
+            }
+            if (next.reader->next(next.head)) {
+                heap.push({next.head.header->received_us, static_cast<uint32_t>(&next - sources_.data())});
+            }
+        }
+    }
+
+    // SBE messages by JournalEventMerger's key
+    void run_event_order() {
+        MergedMessage message;
+        while (running_.load() && merger_->next(message)) {
+            if (!pace(message.key.event_us) || !publish_frame(message.frame, message.received_us)) {
+                break;
+            }
+            stats_.position_us.store(message.received_us, std::memory_order_relaxed);
+        }
+    }
+
+    // Wait until `time_us` is due at the replay speed; false if stopped
+    bool pace(uint64_t time_us) {
+        if (!paced_) {
+            first_us_ = time_us;
+            paced_ = true;
+        }
+        if (speed_ <= 0 || time_us <= first_us_) {
+            return true;
+        }
+        const auto offset = std::chrono::duration<double, std::micro>((time_us - first_us_) / speed_);
+        return wait_until(wall_start_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+    }
+
+    // Sleep to `target` in slices so stop() is honoured; false if stopped
+    bool wait_until(std::chrono::steady_clock::time_point target) {
+        while (running_.load()) {
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= target) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(target - now, POLL_SLICE));
+        }
+        return false;
+    }
+
+    // Stage a record's SBE messages, one frame each as the receiver does,
+    // waiting for the consumer while the ring is full; false if stopped
+    // meanwhile
+    bool publish(const JournalRecord &record) {
+        // stage_frame takes char* like the generated codecs, but never writes
+        const std::span<char> message(const_cast<char *>(record.frame.data()), record.frame.size());
+        const uint64_t received_us = record.header->received_us;
+        frames_.clear();
+        split_messages(message, frames_);
+        for (const std::span<char> frame : frames_) {
+            if (!publish_frame(frame, received_us)) {
+                return false;
+            }
+        }
+        stats_.position_us.store(received_us, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool publish_frame(std::span<char> frame, uint64_t received_us) {
+        while (!stage_frame(ring_, frame, frame_seq_, received_us, &depth_sequence_)) {
+            if (ring_.writable(ring_.capacity()) == ring_.capacity()) {
+                // Does not fit even an empty ring
+                stats_.dropped_frames.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (!running_.load()) {
+                return false;
+            }
+            std::this_thread::sleep_for(FULL_RING_PAUSE);
+        }
+        ++frame_seq_;
+        stats_.frames.fetch_add(1, std::memory_order_relaxed);
+        stats_.bytes.fetch_add(frame.size(), std::memory_order_relaxed);
+        return true;
+    }
+
+    const double speed_;
+    const bool raw_mantissa_;
+    const ReplayOrder order_;
+    // Received order reads sources_, event order the merger
+    std::vector<Source> sources_;
+    std::unique_ptr<JournalEventMerger> merger_;
+    EventRing ring_;
+    uint64_t frame_seq_ = 0;
+    // Pacing (replay thread only): the first time replayed and when
+    std::chrono::steady_clock::time_point wall_start_;
+    uint64_t first_us_ = 0;
+    bool paced_ = false;
+    // The current record's SBE messages (replay thread only)
+    std::vector<std::span<char>> frames_;
+    // Replay thread only, apart from its atomic gap count
+    DepthSequence depth_sequence_;
+
+    ReplayStats stats_;
+    bool started_ = false;
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+};
+
+#endif
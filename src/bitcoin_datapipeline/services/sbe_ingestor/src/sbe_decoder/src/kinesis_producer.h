@@ -0,0 +1,793 @@
+/*
+ * Native Kinesis PutRecords producer.
+ *
+ * KinesisProducer._send_batch sent every batch through boto3 on an executor
+ * thread: records rebuilt as dicts, the GIL taken for each call, and SigV4
+ * signing and JSON encoding done in Python. This producer takes records
+ * (typically SBEDecoder.serialize_records output) into native queues and
+ * publishes them from its own threads:
+ *
+ *   - shard-aware batching: a record's shard is found from its hash key
+ *     (MD5 of the partition key, or the explicit hash key) against the
+ *     stream's shard hash-key ranges, given once from ListShards. Records
+ *     queue per shard, and a batch takes from the shards round-robin,
+ *     each within its write budget (1000 records and 1 MiB per second by
+ *     default), so one hot shard cannot fill every request and get the
+ *     whole batch throttled. Without a shard map the hash space is split
+ *     into `connections` even ranges.
+ *   - at most one request in flight per shard, so a shard's records reach
+ *     Kinesis in the order they were put, retries included.
+ *   - pooled keep-alive connections: each of `connections` sender threads
+ *     owns an HttpConnection (http_connection.h) and a SigV4Signer
+ *     (aws_sigv4.h), so the in-flight window is `connections` requests of
+ *     up to 500 records / 5 MiB each, and handshakes only happen on
+ *     reconnects.
+ *   - asynchronous retries: records a response marks failed go back to
+ *     the front of their shard's queue, and the shard waits out an
+ *     exponential backoff (longer while throttled) without holding a
+ *     sender, which moves on to other shards. Records still failing after
+ *     max_attempts are dropped and counted, and so is a whole request that
+ *     failed (network error, 5xx, throttling), one attempt per record.
+ *   - bounded memory: put() refuses records once max_queued_bytes are
+ *     queued or in flight, so a stalled stream pushes back on the caller
+ *     instead of growing without limit.
+ *
+ * A record succeeding after an earlier one in its shard failed still
+ * overtakes it (PutRecords gives no ordering within a request); what the
+ * one-in-flight rule rules out is a later request overtaking a retry.
+ *
+ * Batches are sent once `max_batch_records` are queued or the oldest
+ * queued record has waited `linger_ms`, and immediately while flush()
+ * waits. Credentials can be replaced at any time (set_credentials), for
+ * the temporary keys of an instance or task role.
+ */
+
+#ifndef _SBE_KINESIS_PRODUCER_H_
+#define _SBE_KINESIS_PRODUCER_H_
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "aws_sigv4.h"
+#include "http_connection.h"
+
+// Kinesis hash keys are unsigned 128-bit integers
+using KinesisHashKey = unsigned __int128;
+
+// MD5 of the partition key read as a big-endian 128-bit integer, as
+// Kinesis maps partition keys to shards
+inline KinesisHashKey kinesis_hash_key(std::string_view partition_key) {
+    unsigned char digest[16];
+    unsigned int size = 0;
+    if (EVP_Digest(partition_key.data(), partition_key.size(), digest, &size, EVP_md5(), nullptr) != 1) {
+        throw std::runtime_error("md5 failed");
+    }
+    KinesisHashKey key = 0;
+    for (const unsigned char byte : digest) {
+        key = (key << 8) | byte;
+    }
+    return key;
+}
+
+// A decimal hash key as ListShards and ExplicitHashKey spell them; false
+// if `text` is not a number below 2^128
+inline bool parse_kinesis_hash_key(std::string_view text, KinesisHashKey &out) {
+    if (text.empty() || text.size() > 39) {
+        return false;
+    }
+    KinesisHashKey value = 0;
+    for (const char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        const auto digit = static_cast<unsigned>(c - '0');
+        const KinesisHashKey max = ~KinesisHashKey{0};
+        if (value > (max - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    out = value;
+    return true;
+}
+
+// `key` in decimal, as ExplicitHashKey takes it
+inline std::string format_kinesis_hash_key(KinesisHashKey key) {
+    std::string text;
+    do {
+        text += static_cast<char>('0' + static_cast<unsigned>(key % 10));
+        key /= 10;
+    } while (key != 0);
+    std::reverse(text.begin(), text.end());
+    return text;
+}
+
+struct KinesisShardRange {
+    std::string shard_id;
+    KinesisHashKey start = 0;
+    KinesisHashKey end = ~KinesisHashKey{0};
+};
+
+struct KinesisProducerConfig {
+    std::string stream_name;
+    std::string region;
+    // Host empty for kinesis.<region>.amazonaws.com over TLS
+    HttpEndpoint endpoint;
+    // Open shards of the stream; empty splits the hash space evenly
+    std::vector<KinesisShardRange> shards;
+    // Sender threads, each with one keep-alive connection and at most one
+    // request in flight
+    std::size_t connections = 4;
+    // PutRecords limits: 500 records, 5 MiB (data plus partition keys)
+    std::size_t max_batch_records = 500;
+    std::size_t max_batch_bytes = 5 * 1024 * 1024;
+    // Queued and in-flight bytes past which put() refuses records
+    std::size_t max_queued_bytes = 64 * 1024 * 1024;
+    uint32_t linger_ms = 50;
+    uint32_t max_attempts = 10;
+    uint32_t retry_base_ms = 100;
+    uint32_t retry_max_ms = 5000;
+    // Per-shard write budget per second; 0 = unlimited
+    uint32_t shard_records_per_second = 1000;
+    uint64_t shard_bytes_per_second = 1024 * 1024;
+    // Re-keys records put without an explicit hash key (a HotPartitioner,
+    // hot_partition.h): true with the new partition and explicit hash keys
+    std::function<bool(std::string_view, std::string &, std::string &)> route;
+};
+
+struct KinesisProducerStats {
+    uint64_t records_put = 0;
+    uint64_t bytes_put = 0;
+    uint64_t records_sent = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t requests = 0;
+    // Requests that failed as a whole (network, HTTP status, bad response)
+    uint64_t failed_requests = 0;
+    uint64_t records_retried = 0;
+    uint64_t records_throttled = 0;
+    // Gave up after max_attempts, or still queued at stop()
+    uint64_t records_dropped = 0;
+    // Refused by put() with the queue full
+    uint64_t records_rejected = 0;
+    uint64_t connects = 0;
+    uint64_t queued_records = 0;
+    uint64_t queued_bytes = 0;
+    uint64_t in_flight_requests = 0;
+    uint64_t last_latency_us = 0;
+    uint64_t max_latency_us = 0;
+};
+
+// A queued record, with its own copy of the data
+struct KinesisRecord {
+    std::string data;
+    std::string partition_key;
+    std::string explicit_hash_key;
+    uint64_t enqueued_us = 0;
+    uint32_t attempts = 0;
+
+    // What PutRecords counts against its limits
+    std::size_t size() const { return data.size() + partition_key.size(); }
+};
+
+inline void append_json_string(std::string &out, std::string_view text) {
+    out += '"';
+    for (const char c : text) {
+        const auto byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (byte < 0x20) {
+            static constexpr char HEX[] = "0123456789abcdef";
+            out += "\\u00";
+            out += HEX[byte >> 4];
+            out += HEX[byte & 0x0F];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+inline void append_base64(std::string &out, std::string_view data) {
+    static constexpr char TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const std::size_t offset = out.size();
+    out.resize(offset + (data.size() + 2) / 3 * 4);
+    char *dst = out.data() + offset;
+    const auto *src = reinterpret_cast<const unsigned char *>(data.data());
+    std::size_t i = 0;
+    for (; i + 3 <= data.size(); i += 3) {
+        const uint32_t v = (uint32_t{src[i]} << 16) | (uint32_t{src[i + 1]} << 8) | src[i + 2];
+        *dst++ = TABLE[v >> 18];
+        *dst++ = TABLE[(v >> 12) & 63];
+        *dst++ = TABLE[(v >> 6) & 63];
+        *dst++ = TABLE[v & 63];
+    }
+    if (i < data.size()) {
+        const bool two = i + 1 < data.size();
+        const uint32_t v = (uint32_t{src[i]} << 16) | (two ? uint32_t{src[i + 1]} << 8 : 0);
+        *dst++ = TABLE[v >> 18];
+        *dst++ = TABLE[(v >> 12) & 63];
+        *dst++ = two ? TABLE[(v >> 6) & 63] : '=';
+        *dst++ = '=';
+    }
+}
+
+// PutRecords JSON body for `records` into `body`: Data base64-encoded,
+// PartitionKey and ExplicitHashKey as given
+inline void build_put_records_body(std::string_view stream_name, std::span<const KinesisRecord> records,
+                                   std::string &body) {
+    body.clear();
+    std::size_t estimate = 64 + stream_name.size();
+    for (const KinesisRecord &record : records) {
+        estimate += 64 + (record.data.size() + 2) / 3 * 4 + record.partition_key.size() * 2 +
+                    record.explicit_hash_key.size();
+    }
+    body.reserve(estimate);
+    body += "{\"StreamName\":";
+    append_json_string(body, stream_name);
+    body += ",\"Records\":[";
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        const KinesisRecord &record = records[i];
+        body += i == 0 ? "{\"Data\":\"" : ",{\"Data\":\"";
+        append_base64(body, record.data);
+        body += "\",\"PartitionKey\":";
+        append_json_string(body, record.partition_key);
+        if (!record.explicit_hash_key.empty()) {
+            body += ",\"ExplicitHashKey\":\"";
+            body += record.explicit_hash_key;
+            body += '"';
+        }
+        body += '}';
+    }
+    body += "]}";
+}
+
+// Signed PutRecords request head (request line and headers) for `body`,
+// sent to `host` (the Host header value) at epoch second `now`
+inline std::string put_records_request_head(SigV4Signer &signer, const AwsCredentials &credentials,
+                                            const std::string &host, std::string_view body, std::time_t now) {
+    const std::string date = amz_date(now);
+    const std::string payload_hash = hex_lower(digest_view(sha256(body)));
+    std::vector<std::pair<std::string, std::string>> headers = {
+        {"content-type", "application/x-amz-json-1.1"},
+        {"host", host},
+        {"x-amz-date", date},
+        {"x-amz-target", "Kinesis_20131202.PutRecords"},
+    };
+    if (!credentials.session_token.empty()) {
+        headers.emplace_back("x-amz-security-token", credentials.session_token);
+    }
+    const std::string authorization = signer.sign(credentials, "POST", "/", "", headers, payload_hash, date);
+    std::string head = "POST / HTTP/1.1\r\n";
+    for (const auto &[name, value] : headers) {
+        head += name + ": " + value + "\r\n";
+    }
+    head += "authorization: " + authorization + "\r\n";
+    head += "connection: keep-alive\r\n";
+    return head;
+}
+
+// Outcome of one record in a PutRecords response
+enum class KinesisRecordResult : uint8_t {
+    Ok,
+    Throttled,
+    Failed,
+};
+
+// Per-record results of a PutRecords response body, in request order.
+// False if the body does not hold exactly `records` results.
+inline bool parse_put_records_response(std::string_view body, std::size_t records,
+                                       std::vector<KinesisRecordResult> &out) {
+    out.clear();
+    const std::size_t key = body.find("\"Records\"");
+    if (key == std::string_view::npos) {
+        return false;
+    }
+    std::size_t pos = body.find('[', key);
+    if (pos == std::string_view::npos) {
+        return false;
+    }
+    ++pos;
+    while (pos < body.size()) {
+        const char c = body[pos];
+        if (c == ']') {
+            return out.size() == records;
+        }
+        if (c != '{') {
+            ++pos;
+            continue;
+        }
+        // One result object; strings are skipped whole so braces or quotes
+        // in an ErrorMessage cannot end it early
+        const std::size_t begin = pos;
+        bool in_string = false;
+        for (++pos; pos < body.size(); ++pos) {
+            if (in_string) {
+                if (body[pos] == '\\') {
+                    ++pos;
+                } else if (body[pos] == '"') {
+                    in_string = false;
+                }
+            } else if (body[pos] == '"') {
+                in_string = true;
+            } else if (body[pos] == '}') {
+                break;
+            }
+        }
+        if (pos >= body.size()) {
+            return false;
+        }
+        const std::string_view entry = body.substr(begin, pos - begin + 1);
+        ++pos;
+        const std::size_t code = entry.find("\"ErrorCode\"");
+        if (code == std::string_view::npos) {
+            out.push_back(KinesisRecordResult::Ok);
+        } else {
+            const std::size_t value = entry.find('"', entry.find(':', code) + 1);
+            const bool throttled =
+                value != std::string_view::npos &&
+                (entry.compare(value + 1, 38, "ProvisionedThroughputExceededException") == 0 ||
+                 entry.compare(value + 1, 22, "KMSThrottlingException") == 0);
+            out.push_back(throttled ? KinesisRecordResult::Throttled : KinesisRecordResult::Failed);
+        }
+    }
+    return false;
+}
+
+class KinesisProducer {
+public:
+    // Kinesis limits on one record
+    static constexpr std::size_t MAX_RECORD_BYTES = 1024 * 1024;
+    static constexpr std::size_t MAX_PARTITION_KEY = 256;
+
+    KinesisProducer(KinesisProducerConfig config, AwsCredentials credentials)
+        : config_(std::move(config)), credentials_(std::move(credentials)) {
+        if (config_.stream_name.empty() || config_.region.empty()) {
+            throw std::runtime_error("KinesisProducer: stream_name and region are required");
+        }
+        if (config_.connections == 0 || config_.max_batch_records == 0 || config_.max_attempts == 0) {
+            throw std::runtime_error(
+                "KinesisProducer: connections, max_batch_records and max_attempts must be positive");
+        }
+        config_.max_batch_records = std::min<std::size_t>(config_.max_batch_records, 500);
+        config_.max_batch_bytes = std::clamp<std::size_t>(config_.max_batch_bytes, MAX_RECORD_BYTES + MAX_PARTITION_KEY,
+                                                          5 * 1024 * 1024);
+        if (config_.endpoint.host.empty()) {
+            config_.endpoint.host = "kinesis." + config_.region + ".amazonaws.com";
+            config_.endpoint.port = 443;
+            config_.endpoint.use_tls = true;
+        }
+        const bool default_port = config_.endpoint.port == (config_.endpoint.use_tls ? 443 : 80);
+        host_header_ = config_.endpoint.host + (default_port ? "" : ":" + std::to_string(config_.endpoint.port));
+
+        if (config_.shards.empty()) {
+            // Even split, one range per connection
+            const KinesisHashKey step = ~KinesisHashKey{0} / config_.connections;
+            for (std::size_t i = 0; i < config_.connections; ++i) {
+                const KinesisHashKey start = step * i;
+                const KinesisHashKey end = i + 1 == config_.connections ? ~KinesisHashKey{0} : start + step - 1;
+                config_.shards.push_back(KinesisShardRange{"", start, end});
+            }
+        }
+        std::sort(config_.shards.begin(), config_.shards.end(),
+                  [](const auto &a, const auto &b) { return a.start < b.start; });
+        shards_.resize(config_.shards.size());
+        for (std::size_t i = 0; i < shards_.size(); ++i) {
+            shards_[i].range = config_.shards[i];
+        }
+    }
+
+    ~KinesisProducer() { stop(0); }
+
+    KinesisProducer(const KinesisProducer &) = delete;
+    KinesisProducer &operator=(const KinesisProducer &) = delete;
+
+    void start() {
+        std::lock_guard lock(mutex_);
+        if (running_) {
+            return;
+        }
+        running_ = true;
+        for (std::size_t i = 0; i < config_.connections; ++i) {
+            senders_.emplace_back([this] { run_sender(); });
+        }
+    }
+
+    // Flush for up to `timeout_ms`, then stop the senders; records still
+    // queued are dropped and counted
+    void stop(int timeout_ms) {
+        {
+            std::lock_guard lock(mutex_);
+            if (!running_) {
+                return;
+            }
+        }
+        if (timeout_ms > 0) {
+            flush(timeout_ms);
+        }
+        {
+            std::lock_guard lock(mutex_);
+            running_ = false;
+        }
+        work_.notify_all();
+        for (auto &sender : senders_) {
+            sender.join();
+        }
+        senders_.clear();
+        std::lock_guard lock(mutex_);
+        for (auto &shard : shards_) {
+            stats_.records_dropped += shard.queue.size();
+            shard.queue.clear();
+        }
+        stats_.queued_records = 0;
+        stats_.queued_bytes = 0;
+        total_records_ = 0;
+        total_bytes_ = 0;
+        done_.notify_all();
+    }
+
+    // Queue one record; false (and counted) when the queue is full. An
+    // empty `explicit_hash_key` routes by the config's route, if it takes
+    // the key, or else by the partition key's MD5.
+    bool put(std::span<const char> data, std::string_view partition_key, std::string_view explicit_hash_key = {}) {
+        if (data.size() > MAX_RECORD_BYTES) {
+            throw std::runtime_error("KinesisProducer: record larger than 1 MiB");
+        }
+        std::string routed_key;
+        std::string routed_hash_key;
+        if (explicit_hash_key.empty() && config_.route && config_.route(partition_key, routed_key, routed_hash_key)) {
+            partition_key = routed_key;
+            explicit_hash_key = routed_hash_key;
+        }
+        if (partition_key.empty() || partition_key.size() > MAX_PARTITION_KEY) {
+            throw std::runtime_error("KinesisProducer: partition key must be 1 to 256 characters");
+        }
+        KinesisHashKey hash = 0;
+        if (explicit_hash_key.empty()) {
+            hash = kinesis_hash_key(partition_key);
+        } else if (!parse_kinesis_hash_key(explicit_hash_key, hash)) {
+            throw std::runtime_error("KinesisProducer: explicit hash key must be a decimal below 2^128");
+        }
+        const std::size_t index = shard_for(hash);
+        const std::size_t size = data.size() + partition_key.size();
+
+        std::unique_lock lock(mutex_);
+        if (total_bytes_ + size > config_.max_queued_bytes) {
+            ++stats_.records_rejected;
+            return false;
+        }
+        KinesisRecord &record = shards_[index].queue.emplace_back();
+        record.data.assign(data.data(), data.size());
+        record.partition_key.assign(partition_key);
+        record.explicit_hash_key.assign(explicit_hash_key);
+        record.enqueued_us = now_us();
+        ++stats_.records_put;
+        stats_.bytes_put += size;
+        ++stats_.queued_records;
+        stats_.queued_bytes += size;
+        ++total_records_;
+        total_bytes_ += size;
+        // Wake a sender when the queue starts (for the linger clock) and
+        // whenever another full batch is waiting
+        const bool wake = stats_.queued_records == 1 || config_.linger_ms == 0 ||
+                          stats_.queued_records % config_.max_batch_records == 0;
+        lock.unlock();
+        if (wake) {
+            work_.notify_one();
+        }
+        return true;
+    }
+
+    // Send everything queued now, ignoring linger; true once nothing is
+    // queued or in flight, false after `timeout_ms` (negative waits forever)
+    bool flush(int timeout_ms) {
+        std::unique_lock lock(mutex_);
+        ++flushing_;
+        work_.notify_all();
+        const auto empty = [this] { return total_records_ == 0 || !running_; };
+        bool done = true;
+        if (timeout_ms < 0) {
+            done_.wait(lock, empty);
+        } else {
+            done = done_.wait_for(lock, std::chrono::milliseconds(timeout_ms), empty);
+        }
+        --flushing_;
+        return done && total_records_ == 0;
+    }
+
+    void set_credentials(AwsCredentials credentials) {
+        std::lock_guard lock(mutex_);
+        credentials_ = std::move(credentials);
+    }
+
+    KinesisProducerStats stats() const {
+        std::lock_guard lock(mutex_);
+        return stats_;
+    }
+
+    std::string last_error() const {
+        std::lock_guard lock(mutex_);
+        return last_error_;
+    }
+
+    const KinesisProducerConfig &config() const { return config_; }
+    std::size_t shard_count() const { return shards_.size(); }
+
+    // Index of the shard whose range holds `hash`
+    std::size_t shard_for(KinesisHashKey hash) const {
+        const auto it = std::upper_bound(config_.shards.begin(), config_.shards.end(), hash,
+                                         [](KinesisHashKey h, const KinesisShardRange &s) { return h < s.start; });
+        return it == config_.shards.begin() ? 0 : static_cast<std::size_t>(it - config_.shards.begin()) - 1;
+    }
+
+private:
+    struct Shard {
+        KinesisShardRange range;
+        std::deque<KinesisRecord> queue;
+        bool in_flight = false;
+        uint64_t retry_at_us = 0;
+        // Write budget window
+        uint64_t window_start_us = 0;
+        uint64_t window_records = 0;
+        uint64_t window_bytes = 0;
+    };
+
+    // What one sender took for a request
+    struct Batch {
+        std::vector<KinesisRecord> records;
+        std::vector<uint32_t> shard_of;
+        std::vector<uint32_t> shards;
+        std::size_t bytes = 0;
+
+        void clear() {
+            records.clear();
+            shard_of.clear();
+            shards.clear();
+            bytes = 0;
+        }
+    };
+
+    static uint64_t now_us() {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+                .count());
+    }
+
+    // Whether `shard` may take a record of `size` bytes this second
+    bool within_budget(Shard &shard, std::size_t size, uint64_t now) const {
+        if (now - shard.window_start_us >= 1'000'000) {
+            shard.window_start_us = now;
+            shard.window_records = 0;
+            shard.window_bytes = 0;
+        }
+        if (config_.shard_records_per_second != 0 && shard.window_records >= config_.shard_records_per_second) {
+            return false;
+        }
+        // A record larger than the whole budget still goes out, alone
+        return config_.shard_bytes_per_second == 0 || shard.window_bytes == 0 ||
+               shard.window_bytes + size <= config_.shard_bytes_per_second;
+    }
+
+    bool sendable(Shard &shard, uint64_t now) const {
+        return !shard.in_flight && !shard.queue.empty() && shard.retry_at_us <= now &&
+               within_budget(shard, shard.queue.front().size(), now);
+    }
+
+    // Whether a request should go out now (caller holds mutex_)
+    bool batch_due(uint64_t now) {
+        const bool force = flushing_ > 0 || !running_ || stats_.queued_records >= config_.max_batch_records;
+        const uint64_t linger_us = uint64_t{config_.linger_ms} * 1000;
+        for (auto &shard : shards_) {
+            if (sendable(shard, now) && (force || shard.queue.front().enqueued_us + linger_us <= now)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Fill `batch` round-robin over the sendable shards (caller holds mutex_)
+    void take_batch(Batch &batch, uint64_t now) {
+        const std::size_t count = shards_.size();
+        for (std::size_t step = 0; step < count && batch.records.size() < config_.max_batch_records; ++step) {
+            const std::size_t index = (cursor_ + step) % count;
+            Shard &shard = shards_[index];
+            if (!sendable(shard, now)) {
+                continue;
+            }
+            std::size_t taken = 0;
+            while (!shard.queue.empty() && batch.records.size() < config_.max_batch_records) {
+                const std::size_t size = shard.queue.front().size();
+                if (batch.bytes + size > config_.max_batch_bytes || !within_budget(shard, size, now)) {
+                    break;
+                }
+                batch.records.push_back(std::move(shard.queue.front()));
+                shard.queue.pop_front();
+                batch.shard_of.push_back(static_cast<uint32_t>(index));
+                batch.bytes += size;
+                ++shard.window_records;
+                shard.window_bytes += size;
+                stats_.queued_bytes -= size;
+                --stats_.queued_records;
+                ++taken;
+            }
+            if (taken > 0) {
+                shard.in_flight = true;
+                batch.shards.push_back(static_cast<uint32_t>(index));
+                cursor_ = (index + 1) % count;
+            }
+        }
+    }
+
+    uint64_t backoff_us(uint32_t attempts, bool throttled) {
+        const uint32_t shift = std::min<uint32_t>(attempts > 0 ? attempts - 1 : 0, 16);
+        uint64_t delay_ms = std::min<uint64_t>(uint64_t{config_.retry_base_ms} << shift, config_.retry_max_ms);
+        if (throttled) {
+            // Let the shard's next budget window start first
+            delay_ms = std::max<uint64_t>(delay_ms, 250);
+        }
+        // +-25% jitter so shards throttled together do not retry together
+        jitter_ = jitter_ * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t spread = delay_ms * 1000 / 2;
+        return delay_ms * 1000 * 3 / 4 + (spread > 0 ? (jitter_ >> 33) % spread : 0);
+    }
+
+    // Account for a finished request (caller holds mutex_). `results` is
+    // empty when the request failed as a whole.
+    void complete(Batch &batch, const std::vector<KinesisRecordResult> &results, bool throttled_request) {
+        const uint64_t now = now_us();
+        for (const uint32_t index : batch.shards) {
+            shards_[index].in_flight = false;
+        }
+        // Back to front, so re-queued records keep their order
+        for (std::size_t i = batch.records.size(); i-- > 0;) {
+            KinesisRecord &record = batch.records[i];
+            const auto result = results.empty()
+                                    ? (throttled_request ? KinesisRecordResult::Throttled : KinesisRecordResult::Failed)
+                                    : results[i];
+            const std::size_t size = record.size();
+            if (result == KinesisRecordResult::Ok) {
+                ++stats_.records_sent;
+                stats_.bytes_sent += size;
+                --total_records_;
+                total_bytes_ -= size;
+                continue;
+            }
+            const bool throttled = result == KinesisRecordResult::Throttled;
+            stats_.records_throttled += throttled ? 1 : 0;
+            if (++record.attempts >= config_.max_attempts || !running_) {
+                ++stats_.records_dropped;
+                --total_records_;
+                total_bytes_ -= size;
+                continue;
+            }
+            ++stats_.records_retried;
+            Shard &shard = shards_[batch.shard_of[i]];
+            shard.retry_at_us = std::max(shard.retry_at_us, now + backoff_us(record.attempts, throttled));
+            ++stats_.queued_records;
+            stats_.queued_bytes += size;
+            shard.queue.push_front(std::move(record));
+        }
+        batch.clear();
+    }
+
+    void run_sender() {
+        HttpConnection connection;
+        SigV4Signer signer(config_.region, "kinesis");
+        HttpResponse response;
+        std::vector<KinesisRecordResult> results;
+        Batch batch;
+        std::string body;
+        const auto poll = std::chrono::milliseconds(std::clamp<uint32_t>(config_.linger_ms, 1, 10));
+
+        std::unique_lock lock(mutex_);
+        while (running_) {
+            const uint64_t now = now_us();
+            if (!batch_due(now)) {
+                if (total_records_ == 0) {
+                    done_.notify_all();
+                }
+                // Idle senders sleep until put() wakes them; with records
+                // waiting on linger, a retry or a budget they poll
+                if (stats_.queued_records == 0) {
+                    work_.wait(lock);
+                } else {
+                    work_.wait_for(lock, poll);
+                }
+                continue;
+            }
+            take_batch(batch, now);
+            if (batch.records.empty()) {
+                continue;
+            }
+            ++stats_.in_flight_requests;
+            const AwsCredentials credentials = credentials_;
+            lock.unlock();
+
+            bool request_failed = false;
+            bool throttled = false;
+            std::string error;
+            const auto started = std::chrono::steady_clock::now();
+            try {
+                if (!connection.connected()) {
+                    connection.connect(config_.endpoint);
+                    std::lock_guard stats_lock(mutex_);
+                    ++stats_.connects;
+                }
+                build_put_records_body(config_.stream_name, batch.records, body);
+                const std::string head =
+                    put_records_request_head(signer, credentials, host_header_, body, std::time(nullptr));
+                connection.round_trip(head, body, response);
+                if (response.status != 200) {
+                    request_failed = true;
+                    throttled = response.status == 429 ||
+                                response.body.find("ProvisionedThroughputExceeded") != std::string::npos ||
+                                response.body.find("LimitExceeded") != std::string::npos ||
+                                response.body.find("Throttling") != std::string::npos;
+                    error = "PutRecords HTTP " + std::to_string(response.status) + ": " + response.body.substr(0, 256);
+                } else if (!parse_put_records_response(response.body, batch.records.size(), results)) {
+                    request_failed = true;
+                    error = "PutRecords: unexpected response " + response.body.substr(0, 256);
+                }
+            } catch (const std::exception &e) {
+                request_failed = true;
+                error = e.what();
+            }
+            const auto latency_us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started)
+                    .count());
+
+            lock.lock();
+            --stats_.in_flight_requests;
+            ++stats_.requests;
+            stats_.last_latency_us = latency_us;
+            stats_.max_latency_us = std::max(stats_.max_latency_us, latency_us);
+            if (request_failed) {
+                ++stats_.failed_requests;
+                last_error_ = std::move(error);
+                results.clear();
+            }
+            complete(batch, results, throttled);
+            if (total_records_ == 0) {
+                done_.notify_all();
+            }
+            // Shards this request held may be sendable again
+            work_.notify_one();
+        }
+        done_.notify_all();
+    }
+
+    KinesisProducerConfig config_;
+    std::string host_header_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable done_;
+    AwsCredentials credentials_;
+    std::vector<Shard> shards_;
+    std::size_t cursor_ = 0;
+    // Queued plus in-flight
+    uint64_t total_records_ = 0;
+    uint64_t total_bytes_ = 0;
+    int flushing_ = 0;
+    bool running_ = false;
+    uint64_t jitter_ = 0x9e3779b97f4a7c15ULL;
+    KinesisProducerStats stats_;
+    std::string last_error_;
+    std::vector<std::thread> senders_;
+};
+
+#endif
@@ -0,0 +1,385 @@
+/*
+ * Kinesis record payloads written straight from SBE stream frames.
+ *
+ * serialize_frame() parses a frame and appends its events as compact JSON
+ * records (one per trades group entry, best bid/ask or depth message) to a
+ * caller-supplied byte span: the MarketTrade / BestBidAsk / DepthDelta
+ * fields plus msg_type and the exchange sequence ids, with depth levels as
+ * [price, qty] decimal strings, i.e. what json.dumps made of the normalized
+ * dict, but with trade and quote prices and sizes written as exact decimal
+ * numbers from their mantissas (decimal64.h). Records are laid end to end and described by RecordBatch (n + 1
+ * offsets, a template and a symbol per record), so PutRecords can be fed
+ * memoryview slices of the buffer. A frame's records are written whole or
+ * not at all, which lets the caller flush and resume when the buffer or the
+ * record limit is reached. Nothing here touches Python objects.
+ *
+ * RecordFormat::Avro writes the same events as single-object encoded Avro
+ * with the generated avro_codecs.h encoders instead (schema fields only;
+ * partial depth uses DepthDelta too).
+ *
+ * With RecordOptions::compressor set, depth records (all records with
+ * compress_all) are zstd-compressed in place behind a codec header
+ * (record_codec.h) as each is finished; one that would not shrink stays
+ * plain.
+ *
+ * With RecordOptions::depth_delta set, depth frames feed that encoder
+ * (depth_delta.h) instead: each writes one delta record of the symbol's
+ * book top-N, or none when the top-N did not change.
+ */
+
+#ifndef _SBE_KINESIS_RECORDS_H_
+#define _SBE_KINESIS_RECORDS_H_
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "avro_codecs.h"
+#include "batch_decode.h"
+#include "depth_delta.h"
+#include "record_codec.h"
+#include "record_writer.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+
+// Layout of the records written so far; offsets has one more entry than
+// there are records
+struct RecordBatch {
+    std::vector<int64_t> offsets{0};
+    std::vector<uint16_t> template_id;
+    std::vector<SymbolCode> symbol;
+    std::vector<int64_t> error_frames;
+    std::vector<int64_t> unknown_frames;
+
+    std::size_t records() const { return template_id.size(); }
+};
+
+enum class RecordFormat : uint8_t {
+    Json,
+    Avro,
+};
+
+struct RecordOptions {
+    RecordFormat format = RecordFormat::Json;
+    uint64_t ingest_us = 0;
+    std::size_t max_records = 500;
+    // Compress records as they are written; not owned
+    RecordCompressor *compressor = nullptr;
+    // Compress every record rather than depth only
+    bool compress_all = false;
+    // Write depth as delta-encoded top-N records; not owned
+    DepthDeltaEncoder *depth_delta = nullptr;
+};
+
+// Reused storage for Avro depth records: the record's level vectors and the
+// level strings they point into
+struct RecordScratch {
+    avro_gen::DepthDelta depth;
+    std::vector<char> text;
+    std::vector<char> compressed;
+};
+
+enum class SerializeStatus : uint8_t {
+    Written,  // records appended (possibly none, for skipped frames)
+    Full,     // buffer or record limit reached; nothing from the frame written
+};
+
+namespace kinesis_detail {
+
+inline void record_header(RecordWriter &writer, std::string_view msg_type, std::string_view symbol, uint64_t event_us,
+                          uint64_t ingest_us) {
+    writer.put('{');
+    writer.key("symbol", true);
+    writer.symbol(symbol);
+    writer.key("event_ts");
+    writer.integer(micros_to_millis(event_us));
+    writer.key("ingest_ts");
+    writer.integer(micros_to_millis(ingest_us));
+    writer.key("msg_type");
+    writer.put('"');
+    writer.put(msg_type);
+    writer.put('"');
+}
+
+inline void record_footer(RecordWriter &writer) {
+    writer.key("source");
+    writer.put("\"sbe\"}");
+}
+
+inline void levels(RecordWriter &writer, const char *data, const LevelGroup &group, int8_t price_exponent,
+                   int8_t qty_exponent) {
+    writer.put('[');
+    bool first = true;
+    for_each_level(data, group, [&](const LevelMantissa &level) {
+        if (!first) {
+            writer.put(',');
+        }
+        first = false;
+        writer.put('[');
+        writer.decimal_string(level.price, price_exponent);
+        writer.put(',');
+        writer.decimal_string(level.qty, qty_exponent);
+        writer.put(']');
+    });
+    writer.put(']');
+}
+
+// Point `side` at [price, qty] strings formatted into text slots from `slot` on
+inline void avro_levels(std::vector<std::vector<std::string_view>> &side, std::vector<char> &text, std::size_t &slot,
+                        const char *data, const LevelGroup &group, int8_t price_exponent, int8_t qty_exponent) {
+    side.resize(group.count);
+    std::size_t i = 0;
+    for_each_level(data, group, [&](const LevelMantissa &level) {
+        auto &pair = side[i++];
+        pair.resize(2);
+        char *price_text = text.data() + slot++ * DECIMAL_TEXT_SIZE;
+        char *qty_text = text.data() + slot++ * DECIMAL_TEXT_SIZE;
+        pair[0] = format_mantissa_text(level.price, price_exponent, price_text);
+        pair[1] = format_mantissa_text(level.qty, qty_exponent, qty_text);
+    });
+}
+
+inline void write_trade(RecordWriter &writer, const RecordOptions &options, const TradeFrame &trade,
+                        const TradeEntry &entry) {
+    const Decimal64 price{entry.price_mantissa, trade.price_exponent};
+    const Decimal64 qty{entry.qty_mantissa, trade.qty_exponent};
+    if (options.format == RecordFormat::Avro) {
+        avro_gen::MarketTrade record;
+        record.symbol = trade.symbol;
+        record.event_ts = static_cast<int64_t>(micros_to_millis(trade.event_time_us));
+        record.ingest_ts = static_cast<int64_t>(micros_to_millis(options.ingest_us));
+        record.trade_id = static_cast<int64_t>(entry.trade_id);
+        record.price = price.to_double();
+        record.qty = qty.to_double();
+        record.is_buyer_maker = entry.is_buyer_maker;
+        record.source = "sbe";
+        avro_gen::encode(writer, record);
+        return;
+    }
+    record_header(writer, "trade", trade.symbol, trade.event_time_us, options.ingest_us);
+    writer.key("trade_id");
+    writer.integer(entry.trade_id);
+    writer.key("price");
+    writer.decimal_number(price);
+    writer.key("qty");
+    writer.decimal_number(qty);
+    writer.key("is_buyer_maker");
+    writer.boolean(entry.is_buyer_maker);
+    record_footer(writer);
+}
+
+inline void write_best_bid_ask(RecordWriter &writer, const RecordOptions &options, const BestBidAskFrame &bba) {
+    const Decimal64 bid_px{bba.bid_price_mantissa, bba.price_exponent};
+    const Decimal64 bid_sz{bba.bid_qty_mantissa, bba.qty_exponent};
+    const Decimal64 ask_px{bba.ask_price_mantissa, bba.price_exponent};
+    const Decimal64 ask_sz{bba.ask_qty_mantissa, bba.qty_exponent};
+    if (options.format == RecordFormat::Avro) {
+        avro_gen::BestBidAsk record;
+        record.symbol = bba.symbol;
+        record.event_ts = static_cast<int64_t>(micros_to_millis(bba.event_time_us));
+        record.ingest_ts = static_cast<int64_t>(micros_to_millis(options.ingest_us));
+        record.bid_px = bid_px.to_double();
+        record.bid_sz = bid_sz.to_double();
+        record.ask_px = ask_px.to_double();
+        record.ask_sz = ask_sz.to_double();
+        record.source = "sbe";
+        avro_gen::encode(writer, record);
+        return;
+    }
+    record_header(writer, "bestBidAsk", bba.symbol, bba.event_time_us, options.ingest_us);
+    writer.key("book_update_id");
+    writer.integer(bba.book_update_id);
+    writer.key("bid_px");
+    writer.decimal_number(bid_px);
+    writer.key("bid_sz");
+    writer.decimal_number(bid_sz);
+    writer.key("ask_px");
+    writer.decimal_number(ask_px);
+    writer.key("ask_sz");
+    writer.decimal_number(ask_sz);
+    record_footer(writer);
+}
+
+// Templates 10002 and 10003; `write_ids` adds the JSON sequence id fields
+template <typename Depth, typename WriteIds>
+void write_depth(RecordWriter &writer, const RecordOptions &options, RecordScratch &scratch,
+                 std::string_view msg_type, const char *data, const Depth &depth, WriteIds &&write_ids) {
+    if (options.format == RecordFormat::Avro) {
+        auto &record = scratch.depth;
+        record.symbol = depth.symbol;
+        record.event_ts = static_cast<int64_t>(micros_to_millis(depth.event_time_us));
+        record.ingest_ts = static_cast<int64_t>(micros_to_millis(options.ingest_us));
+        record.source = "sbe";
+        scratch.text.resize((static_cast<std::size_t>(depth.bids.count) + depth.asks.count) * 2 * DECIMAL_TEXT_SIZE);
+        std::size_t slot = 0;
+        avro_levels(record.bids, scratch.text, slot, data, depth.bids, depth.price_exponent, depth.qty_exponent);
+        avro_levels(record.asks, scratch.text, slot, data, depth.asks, depth.price_exponent, depth.qty_exponent);
+        avro_gen::encode(writer, record);
+        return;
+    }
+    record_header(writer, msg_type, depth.symbol, depth.event_time_us, options.ingest_us);
+    write_ids();
+    writer.key("bids");
+    levels(writer, data, depth.bids, depth.price_exponent, depth.qty_exponent);
+    writer.key("asks");
+    levels(writer, data, depth.asks, depth.price_exponent, depth.qty_exponent);
+    record_footer(writer);
+}
+
+} // namespace kinesis_detail
+
+// Append the records of one frame at `index` in the caller's batch.
+// Malformed and unknown frames are listed in the batch and produce no
+// records. Returns Full, leaving writer and batch as they were, when the
+// frame's records would overrun the buffer or take the batch past
+// options.max_records.
+inline SerializeStatus serialize_frame(std::span<char> frame, int64_t index, const RecordOptions &options,
+                                       RecordWriter &writer, RecordBatch &batch, RecordScratch &scratch) {
+    using spot_sbe::MessageHeader;
+    namespace kd = kinesis_detail;
+
+    if (frame.size() < MessageHeader::encodedLength()) {
+        batch.error_frames.push_back(index);
+        return SerializeStatus::Written;
+    }
+    MessageHeader header{frame.data(), frame.size()};
+    const char *data = frame.data() + MessageHeader::encodedLength();
+    const std::size_t data_size = frame.size() - MessageHeader::encodedLength();
+    const uint16_t template_id = header.templateId();
+
+    const std::size_t start_size = writer.size();
+    const std::size_t start_records = batch.records();
+    auto fits = [&](std::size_t records) { return start_records + records <= options.max_records; };
+    const bool compress = options.compressor != nullptr &&
+                          (options.compress_all || template_id == DEPTH_SNAPSHOT_STREAM_EVENT ||
+                           template_id == DEPTH_DIFF_STREAM_EVENT);
+    auto finish = [&](std::string_view symbol) {
+        if (compress && !writer.overflowed()) {
+            const auto start = static_cast<std::size_t>(batch.offsets.back());
+            if (options.compressor->compress(writer.written().subspan(start), scratch.compressed)) {
+                writer.rewind(start);
+                writer.put(std::string_view(scratch.compressed.data(), scratch.compressed.size()));
+            }
+        }
+        batch.offsets.push_back(static_cast<int64_t>(writer.size()));
+        batch.template_id.push_back(template_id);
+        batch.symbol.push_back(to_symbol_code(symbol));
+    };
+    auto undo = [&] {
+        writer.rewind(start_size);
+        batch.offsets.resize(start_records + 1);
+        batch.template_id.resize(start_records);
+        batch.symbol.resize(start_records);
+    };
+
+    // Every parse runs before the frame writes anything, so a malformed
+    // frame leaves nothing to undo
+    ParseError error = ParseError::None;
+    switch (template_id) {
+    case TRADES_STREAM_EVENT: {
+        TradeFrame trade;
+        error = parse_trade_frame(data, data_size, header.blockLength(), trade);
+        if (error != ParseError::None) [[unlikely]] {
+            break;
+        }
+        if (!fits(trade.num_in_group)) {
+            return SerializeStatus::Full;
+        }
+        for_each_trade_entry(data, data_size, trade, [&](const TradeEntry &entry) {
+            kd::write_trade(writer, options, trade, entry);
+            finish(trade.symbol);
+        });
+        break;
+    }
+    case BEST_BID_ASK_STREAM_EVENT: {
+        BestBidAskFrame bba;
+        error = parse_best_bid_ask_frame(data, data_size, header.blockLength(), bba);
+        if (error != ParseError::None) [[unlikely]] {
+            break;
+        }
+        if (!fits(1)) {
+            return SerializeStatus::Full;
+        }
+        kd::write_best_bid_ask(writer, options, bba);
+        finish(bba.symbol);
+        break;
+    }
+    case DEPTH_SNAPSHOT_STREAM_EVENT: {
+        DepthSnapshotFrame depth;
+        error = parse_depth_snapshot_frame(data, data_size, header.blockLength(), depth);
+        if (error != ParseError::None) [[unlikely]] {
+            break;
+        }
+        if (!fits(1)) {
+            return SerializeStatus::Full;
+        }
+        if (options.depth_delta != nullptr) {
+            if (options.depth_delta->encode_partial(data, depth, options.ingest_us, writer)) {
+                finish(depth.symbol);
+            }
+            break;
+        }
+        kd::write_depth(writer, options, scratch, "depth@100ms", data, depth, [&] {
+            writer.key("book_update_id");
+            writer.integer(depth.book_update_id);
+        });
+        finish(depth.symbol);
+        break;
+    }
+    case DEPTH_DIFF_STREAM_EVENT: {
+        DepthDiffFrame depth;
+        error = parse_depth_diff_frame(data, data_size, header.blockLength(), depth);
+        if (error != ParseError::None) [[unlikely]] {
+            break;
+        }
+        if (!fits(1)) {
+            return SerializeStatus::Full;
+        }
+        if (options.depth_delta != nullptr) {
+            if (options.depth_delta->encode_diff(data, depth, options.ingest_us, writer)) {
+                finish(depth.symbol);
+            }
+            break;
+        }
+        kd::write_depth(writer, options, scratch, "depth", data, depth, [&] {
+            writer.key("first_update_id");
+            writer.integer(depth.first_update_id);
+            writer.key("final_update_id");
+            writer.integer(depth.final_update_id);
+        });
+        finish(depth.symbol);
+        break;
+    }
+    default:
+        batch.unknown_frames.push_back(index);
+        return SerializeStatus::Written;
+    }
+    if (error != ParseError::None) [[unlikely]] {
+        batch.error_frames.push_back(index);
+        return SerializeStatus::Written;
+    }
+
+    if (writer.overflowed()) {
+        undo();
+        return SerializeStatus::Full;
+    }
+    return SerializeStatus::Written;
+}
+
+// Serialize frames in order until one no longer fits. Returns the number
+// of frames consumed; the caller ships the batch and resumes from there.
+inline std::size_t serialize_frames(std::span<const std::span<char>> frames, const RecordOptions &options,
+                                    std::span<char> out, RecordBatch &batch) {
+    RecordWriter writer{out};
+    RecordScratch scratch;
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        if (serialize_frame(frames[i], static_cast<int64_t>(i), options, writer, batch, scratch) ==
+            SerializeStatus::Full) {
+            return i;
+        }
+    }
+    return frames.size();
+}
+
+#endif
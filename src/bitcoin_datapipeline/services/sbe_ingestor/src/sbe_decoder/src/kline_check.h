@@ -0,0 +1,172 @@
+/*
+ * Klines rebuilt from stream trades, diffed against REST klines.
+ *
+ * klines_from_bars() turns one symbol's time bars (bar_builder.h) into the
+ * KlineColumns layout the template 203 decoder fills, so trades the hot
+ * path decoded and a REST klines page line up column for column.
+ * diff_klines() then walks both, sorted by open time, in one merge pass
+ * and records every interval that disagrees: missing on either side, or
+ * with a different OHLC, volume, quote volume or trade count. Prices come
+ * from the same decimals on both sides and must match exactly (up to a
+ * rounding ulp); volumes are sums of doubles against exact wire decimals,
+ * so they match within a relative tolerance.
+ *
+ * A REST kline without trades has no bar and is not a mismatch. The first
+ * and last interval of a trade capture usually hold only part of their
+ * trades; callers diff the intervals the capture fully covers.
+ */
+
+#ifndef _SBE_KLINE_CHECK_H_
+#define _SBE_KLINE_CHECK_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "bar_builder.h"
+#include "batch_decode.h"
+
+// Bits of a KlineDiffColumns mismatch mask
+enum KlineDiffField : uint16_t {
+    KLINE_MISSING_BUILT = 1 << 0,  // REST has trades in the interval, the stream none
+    KLINE_MISSING_REST = 1 << 1,   // the stream has trades, REST no kline
+    KLINE_OPEN = 1 << 2,
+    KLINE_HIGH = 1 << 3,
+    KLINE_LOW = 1 << 4,
+    KLINE_CLOSE = 1 << 5,
+    KLINE_VOLUME = 1 << 6,
+    KLINE_QUOTE_VOLUME = 1 << 7,
+    KLINE_NUM_TRADES = 1 << 8,
+};
+
+constexpr const char *KLINE_DIFF_FIELD_NAMES[] = {
+    "missing_built", "missing_rest", "open", "high", "low", "close", "volume", "quote_volume", "num_trades",
+};
+
+// Scaled kline columns, borrowed from KlineColumns or NumPy arrays
+struct KlineView {
+    std::span<const int64_t> open_time;
+    std::span<const double> open;
+    std::span<const double> high;
+    std::span<const double> low;
+    std::span<const double> close;
+    std::span<const double> volume;
+    std::span<const double> quote_volume;
+    std::span<const int64_t> num_trades;
+
+    std::size_t size() const { return open_time.size(); }
+};
+
+// A scaled (not raw_mantissa) KlineColumns
+inline KlineView kline_view(const KlineColumns &klines) {
+    return {klines.open_time,   klines.open.value, klines.high.value,   klines.low.value,
+            klines.close.value, klines.volume,     klines.quote_volume, klines.num_trades};
+}
+
+// One row per disagreeing interval
+struct KlineDiffColumns {
+    std::vector<int64_t> open_time;
+    std::vector<uint16_t> mismatch;
+    std::vector<double> built_volume;
+    std::vector<double> rest_volume;
+    std::vector<int64_t> built_num_trades;
+    std::vector<int64_t> rest_num_trades;
+};
+
+struct KlineDiffSummary {
+    uint64_t compared = 0;  // intervals on either side
+    uint64_t matched = 0;
+    uint64_t mismatched = 0;
+    uint64_t missing_built = 0;
+    uint64_t missing_rest = 0;
+};
+
+// One symbol's bars in template 203's column layout, scaled; frame_index
+// is -1, as the rows come from no frame
+inline KlineColumns klines_from_bars(const BarColumns &bars, SymbolId symbol_id) {
+    KlineColumns klines;
+    for (std::size_t i = 0; i < bars.size(); ++i) {
+        if (bars.symbol_id[i] != symbol_id) {
+            continue;
+        }
+        klines.frame_index.push_back(-1);
+        klines.open_time.push_back(bars.open_time[i]);
+        klines.close_time.push_back(bars.close_time[i]);
+        klines.open.value.push_back(bars.open[i]);
+        klines.high.value.push_back(bars.high[i]);
+        klines.low.value.push_back(bars.low[i]);
+        klines.close.value.push_back(bars.close[i]);
+        klines.volume.push_back(bars.volume[i]);
+        klines.quote_volume.push_back(bars.quote_volume[i]);
+        klines.num_trades.push_back(bars.trades[i]);
+    }
+    return klines;
+}
+
+namespace kline_check_detail {
+
+inline bool close_enough(double a, double b, double relative) {
+    return std::fabs(a - b) <= relative * std::max(std::fabs(a), std::fabs(b));
+}
+
+} // namespace kline_check_detail
+
+// Diff `built` against `rest`, both ascending by open time, appending the
+// disagreeing intervals to `out`
+inline KlineDiffSummary diff_klines(const KlineView &built, const KlineView &rest, double volume_tolerance,
+                                    KlineDiffColumns &out) {
+    using kline_check_detail::close_enough;
+    // Prices are the same decimals scaled the same way; allow an ulp or so
+    constexpr double PRICE_TOLERANCE = 1e-12;
+    KlineDiffSummary summary;
+    auto record = [&](int64_t open_time, uint16_t mask, std::size_t b, std::size_t r) {
+        out.open_time.push_back(open_time);
+        out.mismatch.push_back(mask);
+        out.built_volume.push_back(b < built.size() ? built.volume[b] : 0.0);
+        out.rest_volume.push_back(r < rest.size() ? rest.volume[r] : 0.0);
+        out.built_num_trades.push_back(b < built.size() ? built.num_trades[b] : 0);
+        out.rest_num_trades.push_back(r < rest.size() ? rest.num_trades[r] : 0);
+        ++summary.mismatched;
+    };
+    std::size_t b = 0;
+    std::size_t r = 0;
+    while (b < built.size() || r < rest.size()) {
+        ++summary.compared;
+        if (r == rest.size() || (b < built.size() && built.open_time[b] < rest.open_time[r])) {
+            ++summary.missing_rest;
+            record(built.open_time[b], KLINE_MISSING_REST, b, rest.size());
+            ++b;
+            continue;
+        }
+        if (b == built.size() || rest.open_time[r] < built.open_time[b]) {
+            if (rest.num_trades[r] == 0) {
+                ++summary.matched;
+            } else {
+                ++summary.missing_built;
+                record(rest.open_time[r], KLINE_MISSING_BUILT, built.size(), r);
+            }
+            ++r;
+            continue;
+        }
+        uint16_t mask = 0;
+        mask |= close_enough(built.open[b], rest.open[r], PRICE_TOLERANCE) ? 0 : KLINE_OPEN;
+        mask |= close_enough(built.high[b], rest.high[r], PRICE_TOLERANCE) ? 0 : KLINE_HIGH;
+        mask |= close_enough(built.low[b], rest.low[r], PRICE_TOLERANCE) ? 0 : KLINE_LOW;
+        mask |= close_enough(built.close[b], rest.close[r], PRICE_TOLERANCE) ? 0 : KLINE_CLOSE;
+        mask |= close_enough(built.volume[b], rest.volume[r], volume_tolerance) ? 0 : KLINE_VOLUME;
+        mask |= close_enough(built.quote_volume[b], rest.quote_volume[r], volume_tolerance) ? 0 : KLINE_QUOTE_VOLUME;
+        mask |= built.num_trades[b] == rest.num_trades[r] ? 0 : KLINE_NUM_TRADES;
+        if (mask == 0) {
+            ++summary.matched;
+        } else {
+            record(built.open_time[b], mask, b, r);
+        }
+        ++b;
+        ++r;
+    }
+    return summary;
+}
+
+#endif
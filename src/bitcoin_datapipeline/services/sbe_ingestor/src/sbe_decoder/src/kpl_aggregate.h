@@ -0,0 +1,376 @@
+/*
+ * KPL aggregated records: many small payloads in one Kinesis record.
+ *
+ * Kinesis bills and throttles per record and per 25 KB payload unit, and a
+ * trade or best bid/ask record is a few hundred bytes. KplAggregator packs
+ * payloads in the Kinesis Producer Library's aggregated-record format, so
+ * the KCL and the aws-kinesis-agg deaggregators read them too:
+ *
+ *   magic F3 89 9A C2 | AggregatedRecord protobuf | MD5 of the protobuf
+ *
+ *   message AggregatedRecord {
+ *     repeated string partition_key_table = 1;
+ *     repeated string explicit_hash_key_table = 2;
+ *     repeated Record records = 3;
+ *   }
+ *   message Record {
+ *     required uint64 partition_key_index = 1;
+ *     optional uint64 explicit_hash_key_index = 2;
+ *     required bytes data = 3;
+ *   }
+ *
+ * Records are encoded as they are added and the key table is written after
+ * them at finish() (protobuf fields may come in any order), so adding is an
+ * append and size() is exact. A batch of one payload is sent as the
+ * payload itself, with no aggregation overhead.
+ *
+ * Consumers see one record per aggregate, under its first payload's key.
+ * The producer keeps one aggregator per partition key so each key's
+ * payloads still reach one shard in order.
+ */
+
+#ifndef _SBE_KPL_AGGREGATE_H_
+#define _SBE_KPL_AGGREGATE_H_
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr std::array<uint8_t, 4> KPL_MAGIC = {0xF3, 0x89, 0x9A, 0xC2};
+constexpr std::size_t KPL_DIGEST_SIZE = 16;
+// The KPL's AggregationMaxSize default: two 25 KB payload units
+constexpr std::size_t KPL_DEFAULT_MAX_BYTES = 51200;
+// Kinesis' limit on one record's data
+constexpr std::size_t KINESIS_MAX_RECORD_BYTES = 1 << 20;
+
+namespace kpl_detail {
+
+// RFC 1321, for the trailing digest
+inline std::array<uint8_t, 16> md5(std::span<const char> data) {
+    static constexpr std::array<uint32_t, 64> K = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+    };
+    static constexpr std::array<int, 16> SHIFTS = {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+
+    uint32_t state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+    const auto block = [&](const uint8_t *chunk) {
+        uint32_t m[16];
+        for (int i = 0; i < 16; ++i) {
+            m[i] = static_cast<uint32_t>(chunk[i * 4]) | static_cast<uint32_t>(chunk[i * 4 + 1]) << 8 |
+                   static_cast<uint32_t>(chunk[i * 4 + 2]) << 16 | static_cast<uint32_t>(chunk[i * 4 + 3]) << 24;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t f;
+            int g;
+            if (i < 16) {
+                f = (b & c) | (~b & d);
+                g = i;
+            } else if (i < 32) {
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) % 16;
+            } else if (i < 48) {
+                f = b ^ c ^ d;
+                g = (3 * i + 5) % 16;
+            } else {
+                f = c ^ (b | ~d);
+                g = (7 * i) % 16;
+            }
+            const uint32_t rotated = std::rotl(a + f + K[i] + m[g], SHIFTS[(i / 16) * 4 + i % 4]);
+            a = d;
+            d = c;
+            c = b;
+            b += rotated;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    };
+
+    const auto *bytes = reinterpret_cast<const uint8_t *>(data.data());
+    std::size_t whole = data.size() & ~std::size_t{63};
+    for (std::size_t at = 0; at < whole; at += 64) {
+        block(bytes + at);
+    }
+    // Padding: 0x80, zeros, then the bit length, in one or two blocks
+    uint8_t tail[128] = {};
+    const std::size_t rest = data.size() - whole;
+    if (rest != 0) {
+        std::memcpy(tail, bytes + whole, rest);
+    }
+    tail[rest] = 0x80;
+    const std::size_t tail_size = rest < 56 ? 64 : 128;
+    const uint64_t bits = static_cast<uint64_t>(data.size()) * 8;
+    for (int i = 0; i < 8; ++i) {
+        tail[tail_size - 8 + i] = static_cast<uint8_t>(bits >> (8 * i));
+    }
+    for (std::size_t at = 0; at < tail_size; at += 64) {
+        block(tail + at);
+    }
+
+    std::array<uint8_t, 16> digest;
+    for (int i = 0; i < 16; ++i) {
+        digest[i] = static_cast<uint8_t>(state[i / 4] >> (8 * (i % 4)));
+    }
+    return digest;
+}
+
+inline std::size_t varint_size(uint64_t value) {
+    std::size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+inline void put_varint(std::vector<char> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Bounds-checked protobuf reader; throws on truncation
+struct ProtoReader {
+    const char *at;
+    const char *end;
+
+    bool done() const { return at == end; }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (at == end) {
+                throw std::runtime_error("kpl: truncated varint");
+            }
+            const auto byte = static_cast<uint8_t>(*at++);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (byte < 0x80) {
+                return value;
+            }
+        }
+        throw std::runtime_error("kpl: varint too long");
+    }
+
+    std::span<const char> bytes() {
+        const uint64_t size = varint();
+        if (size > static_cast<uint64_t>(end - at)) {
+            throw std::runtime_error("kpl: truncated field");
+        }
+        const std::span<const char> field(at, static_cast<std::size_t>(size));
+        at += size;
+        return field;
+    }
+
+    // Skip a field of `wire_type` we do not read (e.g. tags)
+    void skip(uint64_t wire_type) {
+        switch (wire_type) {
+        case 0:
+            varint();
+            return;
+        case 1:
+            advance(8);
+            return;
+        case 2:
+            bytes();
+            return;
+        case 5:
+            advance(4);
+            return;
+        default:
+            throw std::runtime_error("kpl: unsupported wire type");
+        }
+    }
+
+    void advance(std::size_t n) {
+        if (n > static_cast<std::size_t>(end - at)) {
+            throw std::runtime_error("kpl: truncated field");
+        }
+        at += n;
+    }
+};
+
+} // namespace kpl_detail
+
+// True when `data` is a KPL aggregate: the magic, room for a digest and a
+// digest that matches. Anything else is an ordinary record, as in the KCL.
+inline bool is_kpl_aggregate(std::span<const char> data) {
+    if (data.size() < KPL_MAGIC.size() + KPL_DIGEST_SIZE ||
+        std::memcmp(data.data(), KPL_MAGIC.data(), KPL_MAGIC.size()) != 0) {
+        return false;
+    }
+    const auto digest =
+        kpl_detail::md5(data.subspan(KPL_MAGIC.size(), data.size() - KPL_MAGIC.size() - KPL_DIGEST_SIZE));
+    return std::memcmp(digest.data(), data.data() + data.size() - KPL_DIGEST_SIZE, KPL_DIGEST_SIZE) == 0;
+}
+
+// One payload of an aggregate; both views point into the aggregate
+struct KplRecord {
+    std::string_view partition_key;
+    std::span<const char> data;
+};
+
+// The payloads of a KPL aggregate (is_kpl_aggregate() must hold), in order
+inline std::vector<KplRecord> deaggregate_kpl(std::span<const char> data) {
+    kpl_detail::ProtoReader reader{data.data() + KPL_MAGIC.size(), data.data() + data.size() - KPL_DIGEST_SIZE};
+    std::vector<std::string_view> keys;
+    std::vector<uint64_t> key_index;
+    std::vector<KplRecord> records;
+    while (!reader.done()) {
+        const uint64_t tag = reader.varint();
+        if (tag == ((1 << 3) | 2)) {
+            const auto key = reader.bytes();
+            keys.emplace_back(key.data(), key.size());
+        } else if (tag == ((3 << 3) | 2)) {
+            kpl_detail::ProtoReader record{nullptr, nullptr};
+            const auto body = reader.bytes();
+            record.at = body.data();
+            record.end = body.data() + body.size();
+            uint64_t index = 0;
+            bool has_data = false;
+            KplRecord entry;
+            while (!record.done()) {
+                const uint64_t field = record.varint();
+                if (field == ((1 << 3) | 0)) {
+                    index = record.varint();
+                } else if (field == ((3 << 3) | 2)) {
+                    entry.data = record.bytes();
+                    has_data = true;
+                } else {
+                    record.skip(field & 7);
+                }
+            }
+            if (!has_data) {
+                throw std::runtime_error("kpl: record without data");
+            }
+            key_index.push_back(index);
+            records.push_back(entry);
+        } else {
+            reader.skip(tag & 7);
+        }
+    }
+    // The key table may follow the records, so keys are resolved last
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        if (key_index[i] >= keys.size()) {
+            throw std::runtime_error("kpl: partition key index out of range");
+        }
+        records[i].partition_key = keys[key_index[i]];
+    }
+    return records;
+}
+
+class KplAggregator {
+public:
+    explicit KplAggregator(std::size_t max_bytes = KPL_DEFAULT_MAX_BYTES) : max_bytes_(max_bytes) {
+        if (max_bytes_ > KINESIS_MAX_RECORD_BYTES) {
+            throw std::runtime_error("KplAggregator: max_bytes is above the Kinesis record limit");
+        }
+        clear();
+    }
+
+    // Append one payload. Returns false, adding nothing, when it would take
+    // the aggregate past max_bytes; the caller finish()es and adds it to the
+    // next one. An empty aggregate takes any payload up to the Kinesis limit.
+    bool add(std::string_view partition_key, std::span<const char> data) {
+        uint64_t index = keys_.size();
+        for (std::size_t i = 0; i < keys_.size(); ++i) {
+            if (keys_[i] == partition_key) {
+                index = i;
+                break;
+            }
+        }
+        const bool new_key = index == keys_.size();
+        const std::size_t record_size =
+            1 + kpl_detail::varint_size(index) + 1 + kpl_detail::varint_size(data.size()) + data.size();
+        const std::size_t added = 1 + kpl_detail::varint_size(record_size) + record_size +
+                                  (new_key ? key_entry_size(partition_key) : 0);
+        if (size_ + added > (records_ == 0 ? KINESIS_MAX_RECORD_BYTES : max_bytes_)) {
+            if (records_ == 0) {
+                throw std::runtime_error("KplAggregator: payload is above the Kinesis record limit");
+            }
+            return false;
+        }
+        if (new_key) {
+            keys_.emplace_back(partition_key);
+        }
+        body_.push_back(static_cast<char>((3 << 3) | 2));
+        kpl_detail::put_varint(body_, record_size);
+        body_.push_back(static_cast<char>((1 << 3) | 0));
+        kpl_detail::put_varint(body_, index);
+        body_.push_back(static_cast<char>((3 << 3) | 2));
+        kpl_detail::put_varint(body_, data.size());
+        if (records_ == 0) {
+            first_data_ = body_.size();
+        }
+        body_.insert(body_.end(), data.begin(), data.end());
+        size_ += added;
+        ++records_;
+        return true;
+    }
+
+    // The record for everything added so far (a lone payload as itself),
+    // ready for PutRecords under partition_key(); resets the aggregator
+    std::vector<char> finish() {
+        std::vector<char> out;
+        if (records_ == 1) {
+            out.assign(body_.begin() + static_cast<std::ptrdiff_t>(first_data_), body_.end());
+        } else if (records_ > 1) {
+            for (const std::string &key : keys_) {
+                body_.push_back(static_cast<char>((1 << 3) | 2));
+                kpl_detail::put_varint(body_, key.size());
+                body_.insert(body_.end(), key.begin(), key.end());
+            }
+            const auto digest = kpl_detail::md5(std::span<const char>(body_).subspan(KPL_MAGIC.size()));
+            body_.insert(body_.end(), digest.begin(), digest.end());
+            out.swap(body_);
+        }
+        clear();
+        return out;
+    }
+
+    void clear() {
+        body_.assign(KPL_MAGIC.begin(), KPL_MAGIC.end());
+        keys_.clear();
+        records_ = 0;
+        first_data_ = 0;
+        size_ = KPL_MAGIC.size() + KPL_DIGEST_SIZE;
+    }
+
+    // Size of the aggregate finish() would return, were it aggregated
+    std::size_t size() const { return size_; }
+    std::size_t records() const { return records_; }
+    bool empty() const { return records_ == 0; }
+    std::size_t max_bytes() const { return max_bytes_; }
+    // The first payload's key, which the aggregate is sent under
+    std::string_view partition_key() const { return keys_.empty() ? std::string_view{} : keys_.front(); }
+
+private:
+    static std::size_t key_entry_size(std::string_view key) {
+        return 1 + kpl_detail::varint_size(key.size()) + key.size();
+    }
+
+    std::size_t max_bytes_;
+    std::vector<char> body_;
+    std::vector<std::string> keys_;
+    std::size_t records_ = 0;
+    std::size_t first_data_ = 0;
+    std::size_t size_ = 0;
+};
+
+#endif
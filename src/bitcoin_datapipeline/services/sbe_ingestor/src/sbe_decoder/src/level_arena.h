@@ -0,0 +1,75 @@
+/*
+ * Bump arena for decoded depth levels.
+ *
+ * Depth messages used to build a vector per side and then one Python list
+ * per level. The arena hands out contiguous PriceLevel runs from a shared
+ * block instead; the binding layer exposes each run as a NumPy view that
+ * keeps the block alive. reset() rewinds the block in O(1) once no view
+ * refers to it any more, so steady-state decoding allocates nothing. While
+ * views are still held, allocation just carries on past them, and a fresh
+ * block is only taken when the current one fills up.
+ */
+
+#ifndef _SBE_LEVEL_ARENA_H_
+#define _SBE_LEVEL_ARENA_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "stream_decode.h"
+
+struct LevelArenaBlock {
+    explicit LevelArenaBlock(std::size_t capacity_levels)
+        : levels(std::make_unique<PriceLevel[]>(capacity_levels)), capacity(capacity_levels) {}
+
+    std::unique_ptr<PriceLevel[]> levels;
+    std::size_t capacity;
+    std::size_t used = 0;
+};
+
+class LevelArena {
+public:
+    // 256 KiB of levels per block
+    static constexpr std::size_t DEFAULT_BLOCK_LEVELS = 16384;
+
+    explicit LevelArena(std::size_t block_levels = DEFAULT_BLOCK_LEVELS) : block_levels_(block_levels) {}
+
+    // Contiguous storage for `count` levels in the current block
+    std::span<PriceLevel> allocate(std::size_t count) {
+        if (!block_ || block_->capacity - block_->used < count) {
+            block_ = std::make_shared<LevelArenaBlock>(std::max(count, block_levels_));
+            ++blocks_allocated_;
+        }
+        const std::span<PriceLevel> run{block_->levels.get() + block_->used, count};
+        block_->used += count;
+        return run;
+    }
+
+    // Block backing the most recent allocate(); views share ownership of it
+    const std::shared_ptr<LevelArenaBlock> &block() const { return block_; }
+
+    // Start a new batch: rewind in place when no view holds the block
+    void reset() {
+        if (block_ && block_.use_count() == 1) {
+            // use_count() is a relaxed load; order the last view's reads,
+            // on whichever thread dropped it, before the levels are reused
+            std::atomic_thread_fence(std::memory_order_acquire);
+            block_->used = 0;
+        }
+    }
+
+    std::size_t blocks_allocated() const { return blocks_allocated_; }
+    std::size_t used() const { return block_ ? block_->used : 0; }
+    std::size_t capacity() const { return block_ ? block_->capacity : 0; }
+
+private:
+    std::size_t block_levels_;
+    std::shared_ptr<LevelArenaBlock> block_;
+    std::size_t blocks_allocated_ = 0;
+};
+
+#endif
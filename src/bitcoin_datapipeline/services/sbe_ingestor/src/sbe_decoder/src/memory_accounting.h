@@ -0,0 +1,157 @@
+/*
+ * Live and reserved bytes of the native components, by symbol.
+ *
+ * Sizing a task's memory from the number of symbols needs what each
+ * structure actually holds, not a per-record guess. Every long-lived
+ * component (the decoder pool's books, a receiver's rings, journal and
+ * event log mappings, the pipeline's queues, dedup tables) publishes a
+ * MemorySource to the process-wide registry, as it does a MetricsSource
+ * (native_metrics.h). memory_report() runs them all into one MemoryReport:
+ *
+ *   live       bytes holding data right now (levels, queued frames,
+ *              journal records written, keys in a table)
+ *   reserved   bytes allocated or mapped for it, live included (vector
+ *              capacity, ring slots, a journal file's whole mapping)
+ *
+ * per component and symbol. Memory no single symbol owns, such as a ring
+ * shared by a connection's streams or the free slots of a dedup table, is
+ * reported under the empty symbol.
+ *
+ * Sources run on the caller's thread, under the registry's lock. A
+ * component owned by worker threads reads itself under its own lock; one
+ * the bindings only touch with the GIL held is read with it held too.
+ */
+
+#ifndef _SBE_MEMORY_ACCOUNTING_H_
+#define _SBE_MEMORY_ACCOUNTING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+struct MemoryUsage {
+    uint64_t live = 0;
+    uint64_t reserved = 0;
+
+    MemoryUsage &operator+=(const MemoryUsage &other) {
+        live += other.live;
+        reserved += other.reserved;
+        return *this;
+    }
+};
+
+// Bytes of `count` elements of T held in storage for `capacity`
+template <typename T>
+MemoryUsage memory_of(std::size_t count, std::size_t capacity) {
+    return MemoryUsage{count * sizeof(T), capacity * sizeof(T)};
+}
+
+class MemoryReport {
+public:
+    using Symbols = std::map<std::string, MemoryUsage, std::less<>>;
+
+    // Add `usage` to `component`'s entry for `symbol` ("" for none)
+    void add(std::string_view component, std::string_view symbol, const MemoryUsage &usage) {
+        auto component_it = components_.find(component);
+        if (component_it == components_.end()) {
+            component_it = components_.emplace(std::string(component), Symbols{}).first;
+        }
+        Symbols &symbols = component_it->second;
+        auto symbol_it = symbols.find(symbol);
+        if (symbol_it == symbols.end()) {
+            symbol_it = symbols.emplace(std::string(symbol), MemoryUsage{}).first;
+        }
+        symbol_it->second += usage;
+    }
+
+    const std::map<std::string, Symbols, std::less<>> &components() const { return components_; }
+
+    MemoryUsage total(const Symbols &symbols) const {
+        MemoryUsage sum;
+        for (const auto &[symbol, usage] : symbols) {
+            sum += usage;
+        }
+        return sum;
+    }
+
+    MemoryUsage total() const {
+        MemoryUsage sum;
+        for (const auto &[component, symbols] : components_) {
+            sum += total(symbols);
+        }
+        return sum;
+    }
+
+private:
+    std::map<std::string, Symbols, std::less<>> components_;
+};
+
+using MemorySource = std::function<void(MemoryReport &)>;
+
+class MemoryRegistry {
+public:
+    uint64_t reserve_id() { return next_id_.fetch_add(1, std::memory_order_relaxed); }
+
+    void add(uint64_t id, MemorySource source) {
+        std::lock_guard lock(mutex_);
+        sources_.emplace(id, std::move(source));
+    }
+
+    // Waits for a report in progress, so `id`'s source never outlives it
+    void remove(uint64_t id) {
+        std::lock_guard lock(mutex_);
+        sources_.erase(id);
+    }
+
+    MemoryReport report() {
+        MemoryReport out;
+        std::lock_guard lock(mutex_);
+        for (const auto &[id, source] : sources_) {
+            source(out);
+        }
+        return out;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<uint64_t, MemorySource> sources_;
+    std::atomic<uint64_t> next_id_{0};
+};
+
+inline MemoryRegistry &memory_registry() {
+    static MemoryRegistry registry;
+    return registry;
+}
+
+inline MemoryReport memory_report() { return memory_registry().report(); }
+
+// A component's registry entry, declared as its last member and published
+// once the component is fully constructed, like MetricsRegistration
+class MemoryRegistration {
+public:
+    MemoryRegistration() : id_(memory_registry().reserve_id()) {}
+
+    ~MemoryRegistration() {
+        if (published_) {
+            memory_registry().remove(id_);
+        }
+    }
+
+    MemoryRegistration(const MemoryRegistration &) = delete;
+    MemoryRegistration &operator=(const MemoryRegistration &) = delete;
+
+    void publish(MemorySource source) {
+        memory_registry().add(id_, std::move(source));
+        published_ = true;
+    }
+
+private:
+    const uint64_t id_;
+    bool published_ = false;
+};
+
+#endif
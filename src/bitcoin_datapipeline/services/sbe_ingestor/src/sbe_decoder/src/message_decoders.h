@@ -0,0 +1,537 @@
+/*
+ * Per-template dict decoders behind SBEDecoder.decode_message/try_decode.
+ *
+ * Each template registers a MessageDecoder in a TemplateTable: the result
+ * msg_type, a fill function that parses the frame and writes its fields
+ * (returning the ParseError of a malformed frame, with the result left
+ * partial), and an optional fill_error that writes decode_message's
+ * PARSE_ERROR placeholders. The
+ * tables are constant-initialized per DecodeMode; register_message_decoder
+ * is the hook for plugging in more templates. Fields are stored with the
+ * interned keys of result_keys.h.
+ */
+
+#ifndef _SBE_MESSAGE_DECODERS_H_
+#define _SBE_MESSAGE_DECODERS_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "decimal_text.h"
+#include "level_arena.h"
+#include "official/util.h"
+#include "result_keys.h"
+#include "spot_sbe/AggTradesResponse.h"
+#include "spot_sbe/BookTickerResponse.h"
+#include "spot_sbe/BoolEnum.h"
+#include "spot_sbe/DepthResponse.h"
+#include "spot_sbe/KlinesResponse.h"
+#include "spot_sbe/MessageHeader.h"
+#include "spot_sbe/TradesResponse.h"
+#include "stream_decode.h"
+#include "symbol_registry.h"
+#include "symbol_table.h"
+#include "template_dispatch.h"
+
+namespace py = pybind11;
+
+// One frame as seen by a fill function: `payload` is the whole frame,
+// `body` starts just past the message header. With an `arena`, depth
+// levels come back as NumPy views into it rather than lists; with
+// `decimal_strings` they are exact [price, qty] decimal strings instead.
+struct FrameView {
+    const spot_sbe::MessageHeader &header;
+    std::span<char> payload;
+    const char *body;
+    std::size_t body_size;
+    uint64_t ingest_us;
+    LevelArena *arena = nullptr;
+    bool decimal_strings = false;
+};
+
+// Interned symbol strs of one interpreter, by SymbolId; a str created by
+// two threads at once is published by the first and dropped by the other
+struct SymbolStrs {
+    static constexpr const char *STATE_KEY = "sbe_decoder_cpp.symbol_strs";
+
+    SymbolRegistry<py::object> strs;
+};
+
+// The symbol as an interned Python str, created once per SymbolId and
+// shared by every result afterwards instead of a new str per message
+inline py::str symbol_str(std::string_view symbol) {
+    const SymbolId id = symbol_table().intern(symbol);
+    if (id == INVALID_SYMBOL_ID) {
+        return py::str(symbol.data(), symbol.size());
+    }
+    SymbolRegistry<py::object> &strs = interpreter_state<SymbolStrs>().strs;
+    if (const py::object *cached = strs.find(id)) [[likely]] {
+        return py::reinterpret_borrow<py::str>(*cached);
+    }
+    PyObject *str = PyUnicode_FromStringAndSize(symbol.data(), static_cast<py::ssize_t>(symbol.size()));
+    if (str == nullptr) {
+        throw py::error_already_set();
+    }
+    PyUnicode_InternInPlace(&str);
+    return py::reinterpret_borrow<py::str>(*strs.emplace(id, py::reinterpret_steal<py::object>(str)).first);
+}
+
+using MessageFillFn = ParseError (*)(py::dict &, const FrameView &);
+using MessageErrorFillFn = void (*)(py::dict &, uint64_t ingest_us);
+
+struct MessageDecoder {
+    const char *msg_type = nullptr;
+    MessageFillFn fill = nullptr;
+    MessageErrorFillFn fill_error = nullptr;
+    // The stream's name as the ingestor's consumers know it ("depth" for a
+    // diff), for decoders made with stream_msg_types; null keeps msg_type
+    const char *stream_type = nullptr;
+};
+
+using MessageTable = TemplateTable<MessageDecoder>;
+
+inline std::string preview_next_bytes_hex(const char *data, std::size_t data_size, std::size_t offset,
+                                          std::size_t count) {
+    std::size_t preview_len = std::min(count, data_size > offset ? data_size - offset : 0);
+    std::string hex;
+    hex.reserve(preview_len * 2);
+
+    for (std::size_t i = 0; i < preview_len; ++i) {
+        char buf[3];
+        std::snprintf(buf, sizeof(buf), "%02x", static_cast<unsigned char>(data[offset + i]));
+        hex.append(buf);
+    }
+
+    return hex;
+}
+
+inline py::list levels_to_python(const std::vector<PriceLevel> &levels) {
+    py::list result;
+    for (const auto &level : levels) {
+        py::list entry;
+        entry.append(level.price);
+        entry.append(level.qty);
+        result.append(entry);
+    }
+    return result;
+}
+
+// (n, 2) float64 view of an arena run; the view shares ownership of the block
+inline py::array level_view(std::span<const PriceLevel> run, const std::shared_ptr<LevelArenaBlock> &block) {
+    auto *owner = new std::shared_ptr<LevelArenaBlock>(block);
+    py::capsule base(owner, [](void *p) { delete static_cast<std::shared_ptr<LevelArenaBlock> *>(p); });
+    return py::array(py::dtype::of<double>(), {static_cast<py::ssize_t>(run.size()), py::ssize_t{2}},
+                     {static_cast<py::ssize_t>(sizeof(PriceLevel)), static_cast<py::ssize_t>(sizeof(double))},
+                     run.data(), base);
+}
+
+// One side of a depth result. `visit(emit)` calls emit(price, qty) with the
+// mantissas of at most `count` levels. With decimal_strings they become
+// [[price, qty], ...] exact decimal strings; otherwise doubles, landing in
+// the arena when there is one, else in a [[price, qty], ...] list.
+template <typename Visit>
+py::object levels_object(const FrameView &frame, std::size_t count, int8_t price_exponent, int8_t qty_exponent,
+                         Visit &&visit) {
+    if (frame.decimal_strings) {
+        py::list result(count);
+        std::size_t filled = 0;
+        visit([&](int64_t price, int64_t qty) {
+            char price_text[DECIMAL_TEXT_SIZE];
+            char qty_text[DECIMAL_TEXT_SIZE];
+            const auto price_str = format_mantissa_text(price, price_exponent, price_text);
+            const auto qty_str = format_mantissa_text(qty, qty_exponent, qty_text);
+            py::list entry(2);
+            PyList_SET_ITEM(entry.ptr(), 0, py::str(price_str.data(), price_str.size()).release().ptr());
+            PyList_SET_ITEM(entry.ptr(), 1, py::str(qty_str.data(), qty_str.size()).release().ptr());
+            PyList_SET_ITEM(result.ptr(), filled++, entry.release().ptr());
+        });
+        if (filled < count) {
+            // Drop the slots never filled (they are still NULL)
+            PyList_SetSlice(result.ptr(), static_cast<py::ssize_t>(filled), static_cast<py::ssize_t>(count), nullptr);
+        }
+        return result;
+    }
+    if (frame.arena == nullptr) {
+        py::list result;
+        visit([&](int64_t price, int64_t qty) {
+            py::list entry;
+            entry.append(decode_decimal(price, price_exponent));
+            entry.append(decode_decimal(qty, qty_exponent));
+            result.append(entry);
+        });
+        return result;
+    }
+    const auto run = frame.arena->allocate(count);
+    std::size_t filled = 0;
+    visit([&](int64_t price, int64_t qty) {
+        run[filled++] = PriceLevel{decode_decimal(price, price_exponent), decode_decimal(qty, qty_exponent)};
+    });
+    return level_view(run.first(filled), frame.arena->block());
+}
+
+inline py::object stream_levels(const FrameView &frame, const LevelGroup &group, int8_t price_exponent,
+                                int8_t qty_exponent) {
+    return levels_object(frame, group.count, price_exponent, qty_exponent, [&](auto &&emit) {
+        for_each_level(frame.body, group, [&](const LevelMantissa &level) { emit(level.price, level.qty); });
+    });
+}
+
+// Generated REST flyweight wrapped over the frame (official util.h pattern)
+template <typename T>
+T response_flyweight(const FrameView &frame) {
+    return message_from_header<T>(frame.payload, frame.header);
+}
+
+// The generated flyweights report a malformed response by throwing; REST
+// pages are rare enough that catching here costs nothing on the stream path
+template <void (*Fill)(py::dict &, const FrameView &)>
+ParseError response_fill(py::dict &result, const FrameView &frame) {
+    try {
+        Fill(result, frame);
+    } catch (const std::exception &) {
+        return ParseError::Rejected;
+    }
+    return ParseError::None;
+}
+
+inline bool response_bool(spot_sbe::BoolEnum::Value value) {
+    return value == spot_sbe::BoolEnum::Value::True;
+}
+
+// ---------------------------------------------------------------------------
+// Stream events
+// ---------------------------------------------------------------------------
+
+// Template 10000
+template <typename Mode>
+ParseError fill_trade_stream(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    TradeFrame trade;
+    if (const auto error = parse_trade_frame(frame.body, frame.body_size, frame.header.blockLength(), trade);
+        error != ParseError::None) [[unlikely]] {
+        return error;
+    }
+
+    set_item(result, keys.event_ts, micros_to_millis(trade.event_time_us));
+    set_item(result, keys.trade_time, micros_to_millis(trade.trade_time_us));
+    set_item(result, keys.price_exponent, static_cast<int>(trade.price_exponent));
+    set_item(result, keys.qty_exponent, static_cast<int>(trade.qty_exponent));
+    set_item(result, keys.symbol, symbol_str(trade.symbol));
+    set_item(result, keys.price, decode_decimal(trade.price_mantissa, trade.price_exponent));
+    set_item(result, keys.qty, decode_decimal(trade.qty_mantissa, trade.qty_exponent));
+    set_item(result, keys.trade_id, static_cast<unsigned long long>(trade.trade_id));
+    set_item(result, keys.is_buyer_maker, trade.is_buyer_maker);
+
+    if constexpr (Mode::diagnostics) {
+        // Debug preview of upcoming bytes for troubleshooting
+        result["debug_offset_fixed_end"] = static_cast<int>(frame.header.blockLength());
+        result["debug_data_size"] = static_cast<int>(frame.body_size);
+        result["debug_next_16_bytes"] =
+            preview_next_bytes_hex(frame.body, frame.body_size, trade.group_header_offset, 16);
+        result["debug_group_block_length"] = static_cast<int>(trade.group_block_length);
+        result["debug_num_in_group"] = static_cast<long long>(trade.num_in_group);
+        result["debug_price_mantissa"] = static_cast<long long>(trade.price_mantissa);
+        result["debug_qty_mantissa"] = static_cast<long long>(trade.qty_mantissa);
+        result["debug_found_group"] = true;
+    }
+    return ParseError::None;
+}
+
+template <typename Mode>
+void fill_trade_stream_error(py::dict &result, uint64_t ingest_us) {
+    const ResultKeys &keys = result_keys();
+    // If parsing fails, return placeholder values
+    set_item(result, keys.symbol, "PARSE_ERROR");
+    set_item(result, keys.price, 0.0);
+    set_item(result, keys.qty, 0.0);
+    set_item(result, keys.event_ts, micros_to_millis(ingest_us));
+    set_item(result, keys.trade_time, micros_to_millis(ingest_us));
+    set_item(result, keys.trade_id, 0);
+    set_item(result, keys.is_buyer_maker, false);
+    if constexpr (Mode::diagnostics) {
+        result["debug_found_group"] = false;
+    }
+}
+
+// Template 10001
+template <typename Mode>
+ParseError fill_best_bid_ask_stream(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    BestBidAskFrame bba;
+    if (const auto error = parse_best_bid_ask_frame(frame.body, frame.body_size, frame.header.blockLength(), bba);
+        error != ParseError::None) [[unlikely]] {
+        return error;
+    }
+
+    set_item(result, keys.event_ts, micros_to_millis(bba.event_time_us));
+    set_item(result, keys.book_update_id, static_cast<unsigned long long>(bba.book_update_id));
+    set_item(result, keys.price_exponent, static_cast<int>(bba.price_exponent));
+    set_item(result, keys.qty_exponent, static_cast<int>(bba.qty_exponent));
+    set_item(result, keys.bid_px, decode_decimal(bba.bid_price_mantissa, bba.price_exponent));
+    set_item(result, keys.bid_sz, decode_decimal(bba.bid_qty_mantissa, bba.qty_exponent));
+    set_item(result, keys.ask_px, decode_decimal(bba.ask_price_mantissa, bba.price_exponent));
+    set_item(result, keys.ask_sz, decode_decimal(bba.ask_qty_mantissa, bba.qty_exponent));
+    set_item(result, keys.symbol, symbol_str(bba.symbol));
+    if constexpr (Mode::diagnostics) {
+        result["debug_bid_mantissa"] = static_cast<long long>(bba.bid_price_mantissa);
+    }
+    return ParseError::None;
+}
+
+inline void fill_best_bid_ask_stream_error(py::dict &result, uint64_t ingest_us) {
+    const ResultKeys &keys = result_keys();
+    set_item(result, keys.symbol, "PARSE_ERROR");
+    set_item(result, keys.bid_px, 0.0);
+    set_item(result, keys.bid_sz, 0.0);
+    set_item(result, keys.ask_px, 0.0);
+    set_item(result, keys.ask_sz, 0.0);
+    set_item(result, keys.event_ts, micros_to_millis(ingest_us));
+}
+
+// Template 10002
+inline ParseError fill_depth_snapshot_stream(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    DepthSnapshotFrame depth;
+    if (const auto error = parse_depth_snapshot_frame(frame.body, frame.body_size, frame.header.blockLength(), depth);
+        error != ParseError::None) [[unlikely]] {
+        return error;
+    }
+
+    set_item(result, keys.event_ts, micros_to_millis(depth.event_time_us));
+    set_item(result, keys.book_update_id, static_cast<unsigned long long>(depth.book_update_id));
+    set_item(result, keys.price_exponent, static_cast<int>(depth.price_exponent));
+    set_item(result, keys.qty_exponent, static_cast<int>(depth.qty_exponent));
+
+    set_item(result, keys.bids, stream_levels(frame, depth.bids, depth.price_exponent, depth.qty_exponent));
+    set_item(result, keys.asks, stream_levels(frame, depth.asks, depth.price_exponent, depth.qty_exponent));
+    set_item(result, keys.symbol, symbol_str(depth.symbol));
+    return ParseError::None;
+}
+
+// Template 10003: fixed block (blockLength=26) then bids and asks groups
+// (groupSize16Encoding) and the symbol
+inline ParseError fill_depth_diff_stream(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    DepthDiffFrame depth;
+    if (const auto error = parse_depth_diff_frame(frame.body, frame.body_size, frame.header.blockLength(), depth);
+        error != ParseError::None) [[unlikely]] {
+        return error;
+    }
+
+    set_item(result, keys.event_ts, micros_to_millis(depth.event_time_us));
+    set_item(result, keys.first_update_id, static_cast<unsigned long long>(depth.first_update_id));
+    set_item(result, keys.final_update_id, static_cast<unsigned long long>(depth.final_update_id));
+    set_item(result, keys.price_exponent, static_cast<int>(depth.price_exponent));
+    set_item(result, keys.qty_exponent, static_cast<int>(depth.qty_exponent));
+
+    set_item(result, keys.bids, stream_levels(frame, depth.bids, depth.price_exponent, depth.qty_exponent));
+    set_item(result, keys.asks, stream_levels(frame, depth.asks, depth.price_exponent, depth.qty_exponent));
+    set_item(result, keys.symbol, symbol_str(depth.symbol));
+    return ParseError::None;
+}
+
+inline void fill_depth_stream_error(py::dict &result, uint64_t ingest_us) {
+    const ResultKeys &keys = result_keys();
+    set_item(result, keys.symbol, "PARSE_ERROR");
+    set_item(result, keys.first_update_id, 0);
+    set_item(result, keys.final_update_id, 0);
+    set_item(result, keys.event_ts, micros_to_millis(ingest_us));
+    set_item(result, keys.bids, py::list());
+    set_item(result, keys.asks, py::list());
+}
+
+// ---------------------------------------------------------------------------
+// REST responses (generated spot_sbe flyweights)
+// ---------------------------------------------------------------------------
+
+template <typename Group>
+py::object response_levels(const FrameView &frame, Group &group, int8_t price_exponent, int8_t qty_exponent) {
+    return levels_object(frame, static_cast<std::size_t>(group.count()), price_exponent, qty_exponent,
+                         [&](auto &&emit) { group.forEach([&](auto &level) { emit(level.price(), level.qty()); }); });
+}
+
+// Template 200
+inline void fill_depth_response(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    auto depth = response_flyweight<spot_sbe::DepthResponse>(frame);
+    const int8_t price_exponent = depth.priceExponent();
+    const int8_t qty_exponent = depth.qtyExponent();
+
+    set_item(result, keys.last_update_id, depth.lastUpdateId());
+    set_item(result, keys.price_exponent, static_cast<int>(price_exponent));
+    set_item(result, keys.qty_exponent, static_cast<int>(qty_exponent));
+    // Groups must be read in schema order: bids, then asks
+    set_item(result, keys.bids, response_levels(frame, depth.bids(), price_exponent, qty_exponent));
+    set_item(result, keys.asks, response_levels(frame, depth.asks(), price_exponent, qty_exponent));
+}
+
+// Template 201
+inline void fill_trades_response(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    auto response = response_flyweight<spot_sbe::TradesResponse>(frame);
+    const int8_t price_exponent = response.priceExponent();
+    const int8_t qty_exponent = response.qtyExponent();
+
+    py::list trades;
+    response.trades().forEach([&](auto &trade) {
+        py::dict entry;
+        set_item(entry, keys.id, trade.id());
+        set_item(entry, keys.price, decode_decimal(trade.price(), price_exponent));
+        set_item(entry, keys.qty, decode_decimal(trade.qty(), qty_exponent));
+        set_item(entry, keys.quote_qty, decode_decimal(trade.quoteQty(), price_exponent + qty_exponent));
+        set_item(entry, keys.time, trade.time());
+        set_item(entry, keys.is_buyer_maker, response_bool(trade.isBuyerMaker()));
+        set_item(entry, keys.is_best_match, response_bool(trade.isBestMatch()));
+        trades.append(entry);
+    });
+    set_item(result, keys.price_exponent, static_cast<int>(price_exponent));
+    set_item(result, keys.qty_exponent, static_cast<int>(qty_exponent));
+    set_item(result, keys.trades, trades);
+}
+
+// Template 202
+inline void fill_agg_trades_response(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    auto response = response_flyweight<spot_sbe::AggTradesResponse>(frame);
+    const int8_t price_exponent = response.priceExponent();
+    const int8_t qty_exponent = response.qtyExponent();
+
+    py::list agg_trades;
+    response.aggTrades().forEach([&](auto &trade) {
+        py::dict entry;
+        set_item(entry, keys.agg_trade_id, trade.aggTradeId());
+        set_item(entry, keys.price, decode_decimal(trade.price(), price_exponent));
+        set_item(entry, keys.qty, decode_decimal(trade.qty(), qty_exponent));
+        set_item(entry, keys.first_trade_id, trade.firstTradeId());
+        set_item(entry, keys.last_trade_id, trade.lastTradeId());
+        set_item(entry, keys.time, trade.time());
+        set_item(entry, keys.is_buyer_maker, response_bool(trade.isBuyerMaker()));
+        set_item(entry, keys.is_best_match, response_bool(trade.isBestMatch()));
+        agg_trades.append(entry);
+    });
+    set_item(result, keys.price_exponent, static_cast<int>(price_exponent));
+    set_item(result, keys.qty_exponent, static_cast<int>(qty_exponent));
+    set_item(result, keys.agg_trades, agg_trades);
+}
+
+// Template 203. Rows follow the REST JSON kline layout:
+// [open_time, open, high, low, close, volume, close_time, quote_volume, num_trades]
+inline void fill_klines_response(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    auto response = response_flyweight<spot_sbe::KlinesResponse>(frame);
+    const int8_t price_exponent = response.priceExponent();
+    const int8_t qty_exponent = response.qtyExponent();
+
+    py::list klines;
+    response.klines().forEach([&](auto &kline) {
+        py::list row;
+        row.append(kline.openTime());
+        row.append(decode_decimal(kline.openPrice(), price_exponent));
+        row.append(decode_decimal(kline.highPrice(), price_exponent));
+        row.append(decode_decimal(kline.lowPrice(), price_exponent));
+        row.append(decode_decimal(kline.closePrice(), price_exponent));
+        row.append(decode_decimal_u128(kline.volume(), qty_exponent));
+        row.append(kline.closeTime());
+        row.append(decode_decimal_u128(kline.quoteVolume(), price_exponent + qty_exponent));
+        row.append(kline.numTrades());
+        klines.append(row);
+    });
+    set_item(result, keys.price_exponent, static_cast<int>(price_exponent));
+    set_item(result, keys.qty_exponent, static_cast<int>(qty_exponent));
+    set_item(result, keys.klines, klines);
+}
+
+// Template 212
+inline void fill_book_ticker_response(py::dict &result, const FrameView &frame) {
+    const ResultKeys &keys = result_keys();
+    auto response = response_flyweight<spot_sbe::BookTickerResponse>(frame);
+
+    py::list tickers;
+    response.tickers().forEach([&](auto &ticker) {
+        const int8_t price_exponent = ticker.priceExponent();
+        const int8_t qty_exponent = ticker.qtyExponent();
+        py::dict entry;
+        set_item(entry, keys.bid_px, decode_decimal(ticker.bidPrice(), price_exponent));
+        set_item(entry, keys.bid_sz, decode_decimal(ticker.bidQty(), qty_exponent));
+        set_item(entry, keys.ask_px, decode_decimal(ticker.askPrice(), price_exponent));
+        set_item(entry, keys.ask_sz, decode_decimal(ticker.askQty(), qty_exponent));
+        set_item(entry, keys.symbol, symbol_str(ticker.getSymbolAsStringView()));
+        tickers.append(entry);
+    });
+    set_item(result, keys.tickers, tickers);
+}
+
+// Every ParseError cause name as an interned str, per interpreter
+struct ParseErrorStrs {
+    static constexpr const char *STATE_KEY = "sbe_decoder_cpp.parse_error_strs";
+
+    ParseErrorStrs() {
+        for (std::size_t cause = 0; cause < PARSE_ERROR_COUNT; ++cause) {
+            PyObject *str = PyUnicode_InternFromString(parse_error_name(static_cast<ParseError>(cause)));
+            if (str == nullptr) {
+                throw py::error_already_set();
+            }
+            strs[cause] = py::reinterpret_steal<py::object>(str);
+        }
+    }
+
+    std::array<py::object, PARSE_ERROR_COUNT> strs;
+};
+
+// A ParseError's cause name as an interned Python str
+inline py::str parse_error_str(ParseError error) {
+    return py::reinterpret_borrow<py::str>(interpreter_state<ParseErrorStrs>().strs[static_cast<std::size_t>(error)]);
+}
+
+inline void fill_parse_error(py::dict &result, uint64_t ingest_us) {
+    const ResultKeys &keys = result_keys();
+    set_item(result, keys.symbol, "PARSE_ERROR");
+    set_item(result, keys.event_ts, micros_to_millis(ingest_us));
+}
+
+// ---------------------------------------------------------------------------
+// Tables
+// ---------------------------------------------------------------------------
+
+template <typename Mode>
+constexpr MessageTable make_message_table() {
+    MessageTable table;
+    table.add(TRADES_STREAM_EVENT, {"trade", &fill_trade_stream<Mode>, &fill_trade_stream_error<Mode>, "trade"});
+    table.add(BEST_BID_ASK_STREAM_EVENT,
+              {"bestBidAsk", &fill_best_bid_ask_stream<Mode>, &fill_best_bid_ask_stream_error, "bestBidAsk"});
+    table.add(DEPTH_SNAPSHOT_STREAM_EVENT,
+              {"partialDepth", &fill_depth_snapshot_stream, &fill_depth_stream_error, "depth@100ms"});
+    table.add(DEPTH_DIFF_STREAM_EVENT, {"depthDiff", &fill_depth_diff_stream, &fill_depth_stream_error, "depth"});
+    table.add(spot_sbe::DepthResponse::SBE_TEMPLATE_ID,
+              {"depthSnapshot", &response_fill<&fill_depth_response>, nullptr});
+    table.add(spot_sbe::TradesResponse::SBE_TEMPLATE_ID, {"trades", &response_fill<&fill_trades_response>, nullptr});
+    table.add(spot_sbe::AggTradesResponse::SBE_TEMPLATE_ID,
+              {"aggTrades", &response_fill<&fill_agg_trades_response>, nullptr});
+    table.add(spot_sbe::KlinesResponse::SBE_TEMPLATE_ID, {"klines", &response_fill<&fill_klines_response>, nullptr});
+    table.add(spot_sbe::BookTickerResponse::SBE_TEMPLATE_ID,
+              {"bookTicker", &response_fill<&fill_book_ticker_response>, nullptr});
+    return table;
+}
+
+template <typename Mode>
+MessageTable &message_table() {
+    static constinit MessageTable table = make_message_table<Mode>();
+    return table;
+}
+
+// Registration hook: plug a decoder for `template_id` into both modes.
+// Not synchronized; call at module init, before decoding starts.
+inline bool register_message_decoder(uint16_t template_id, const MessageDecoder &decoder) {
+    const bool added = message_table<ProductionMode>().add(template_id, decoder);
+    return message_table<DiagnosticMode>().add(template_id, decoder) && added;
+}
+
+#endif
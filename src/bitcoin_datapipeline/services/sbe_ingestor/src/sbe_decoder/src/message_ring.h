@@ -0,0 +1,255 @@
+/*
+ * Fixed-capacity, struct-of-arrays message buffers for the aggregator.
+ *
+ * StreamAggregator buffers each (symbol, type) stream as a deque of dicts
+ * holding the whole decoded message, and _aggregate_buffer copies the deque
+ * with list() before the feature builder walks it. A TradeRing or QuoteRing
+ * keeps only the fields the features read, one contiguous column per field,
+ * and overwrites the oldest row when full (the deque's maxlen). The columns
+ * are at most two contiguous runs, so features() runs the column_stats
+ * kernels over the ring in place instead of over a copy.
+ *
+ * Rows stay in append order, which is event order within a Kinesis shard.
+ * Not thread-safe; the binding uses them with the GIL held.
+ */
+
+#ifndef _SBE_MESSAGE_RING_H_
+#define _SBE_MESSAGE_RING_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "column_stats.h"
+#include "trade_window.h"
+
+// Slot arithmetic shared by the rings: `head` is the oldest row
+class RingIndex {
+public:
+    explicit RingIndex(std::size_t capacity) : capacity_(capacity) {
+        if (capacity_ == 0) {
+            throw std::runtime_error("message ring: capacity must be positive");
+        }
+    }
+
+    // Slot for a new row; overwrites (and counts) the oldest when full
+    std::size_t push() {
+        if (size_ < capacity_) {
+            return slot(size_++);
+        }
+        const std::size_t at = head_;
+        head_ = (head_ + 1) % capacity_;
+        ++overwritten_;
+        return at;
+    }
+
+    // Slot of the `i`th oldest row
+    std::size_t slot(std::size_t i) const { return (head_ + i) % capacity_; }
+
+    // fn(first_slot, count) for each contiguous run, oldest first
+    template <typename Fn>
+    void for_each_run(Fn &&fn) const {
+        const std::size_t first = std::min(size_, capacity_ - head_);
+        if (first > 0) {
+            fn(head_, first);
+        }
+        if (size_ > first) {
+            fn(std::size_t{0}, size_ - first);
+        }
+    }
+
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+    std::size_t size() const { return size_; }
+    std::size_t capacity() const { return capacity_; }
+    uint64_t overwritten() const { return overwritten_; }
+
+private:
+    std::size_t capacity_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    uint64_t overwritten_ = 0;
+};
+
+class TradeRing {
+public:
+    explicit TradeRing(std::size_t capacity)
+        : index_(capacity), event_ts_(capacity), price_(capacity), qty_(capacity), is_buyer_maker_(capacity) {}
+
+    // Trades without a positive price and qty are dropped, as the Python
+    // builder skips them
+    void push(int64_t event_ts, double price, double qty, bool is_buyer_maker) {
+        if (!(price > 0) || !(qty > 0)) {
+            return;
+        }
+        const std::size_t at = index_.push();
+        event_ts_[at] = event_ts;
+        price_[at] = price;
+        qty_[at] = qty;
+        is_buyer_maker_[at] = is_buyer_maker ? 1 : 0;
+    }
+
+    // _build_trade_features over the buffered trades; needs size() > 0
+    TradeFeatures features() const {
+        ColumnStats stats;
+        double buy_volume = 0;
+        index_.for_each_run([&](std::size_t first, std::size_t count) {
+            column_stats_append(stats, price_.data() + first, qty_.data() + first, count);
+            for (std::size_t i = first; i < first + count; ++i) {
+                buy_volume += is_buyer_maker_[i] ? 0.0 : qty_[i];
+            }
+        });
+        const std::size_t oldest = index_.slot(0);
+        const std::size_t newest = index_.slot(index_.size() - 1);
+
+        TradeSummary summary;
+        summary.count = stats.count;
+        summary.first_ts_ms = event_ts_[oldest];
+        summary.last_ts_ms = event_ts_[newest];
+        summary.first_price = price_[oldest];
+        summary.last_price = price_[newest];
+        summary.min_price = stats.min;
+        summary.max_price = stats.max;
+        summary.mean_price = stats.mean();
+        summary.price_variance = stats.variance();
+        summary.volume = stats.qty_sum;
+        summary.notional = stats.weighted_sum;
+        summary.buy_volume = buy_volume;
+        return trade_features(summary);
+    }
+
+    const RingIndex &index() const { return index_; }
+    const std::vector<int64_t> &event_ts() const { return event_ts_; }
+    const std::vector<double> &price() const { return price_; }
+    const std::vector<double> &qty() const { return qty_; }
+    const std::vector<uint8_t> &is_buyer_maker() const { return is_buyer_maker_; }
+
+    std::size_t size() const { return index_.size(); }
+    void clear() { index_.clear(); }
+
+private:
+    RingIndex index_;
+    std::vector<int64_t> event_ts_;
+    std::vector<double> price_;
+    std::vector<double> qty_;
+    std::vector<uint8_t> is_buyer_maker_;
+};
+
+// Same names and definitions as the Python best bid/ask features
+struct QuoteFeatures {
+    double price = 0;
+    double bid_price = 0;
+    double ask_price = 0;
+    double spread = 0;
+    double spread_pct = 0;
+    double mid_price = 0;
+    double avg_bid = 0;
+    double avg_ask = 0;
+    double avg_spread = 0;
+    double avg_mid = 0;
+    double min_spread = 0;
+    double max_spread = 0;
+    double spread_volatility = 0;
+    double bid_size = 0;
+    double ask_size = 0;
+    double avg_bid_size = 0;
+    double avg_ask_size = 0;
+    double total_bid_size = 0;
+    double total_ask_size = 0;
+    double size_imbalance = 0;
+    double mid_change = 0;
+    double mid_change_pct = 0;
+    uint64_t update_count = 0;
+};
+
+class QuoteRing {
+public:
+    explicit QuoteRing(std::size_t capacity)
+        : index_(capacity), event_ts_(capacity), bid_px_(capacity), bid_sz_(capacity), ask_px_(capacity),
+          ask_sz_(capacity), spread_(capacity) {}
+
+    // Updates without a positive bid and ask price are dropped, as the
+    // Python builder skips them. The spread is stored as its own column so
+    // its statistics are one more column pass.
+    void push(int64_t event_ts, double bid_px, double bid_sz, double ask_px, double ask_sz) {
+        if (!(bid_px > 0) || !(ask_px > 0)) {
+            return;
+        }
+        const std::size_t at = index_.push();
+        event_ts_[at] = event_ts;
+        bid_px_[at] = bid_px;
+        bid_sz_[at] = bid_sz;
+        ask_px_[at] = ask_px;
+        ask_sz_[at] = ask_sz;
+        spread_[at] = ask_px - bid_px;
+    }
+
+    // _build_orderbook_features over the buffered updates; needs size() > 0
+    QuoteFeatures features() const {
+        ColumnStats bid, ask, bid_size, ask_size, spread;
+        index_.for_each_run([&](std::size_t first, std::size_t count) {
+            column_stats_append(bid, bid_px_.data() + first, nullptr, count);
+            column_stats_append(ask, ask_px_.data() + first, nullptr, count);
+            column_stats_append(bid_size, bid_sz_.data() + first, nullptr, count);
+            column_stats_append(ask_size, ask_sz_.data() + first, nullptr, count);
+            column_stats_append(spread, spread_.data() + first, nullptr, count);
+        });
+        const std::size_t oldest = index_.slot(0);
+        const std::size_t newest = index_.slot(index_.size() - 1);
+        const double first_mid = (bid_px_[oldest] + ask_px_[oldest]) / 2;
+        const double count = static_cast<double>(index_.size());
+
+        QuoteFeatures f;
+        f.bid_price = bid_px_[newest];
+        f.ask_price = ask_px_[newest];
+        f.spread = spread_[newest];
+        f.mid_price = (f.bid_price + f.ask_price) / 2;
+        f.price = f.mid_price;
+        f.spread_pct = f.mid_price > 0 ? f.spread / f.mid_price * 100 : 0;
+        f.avg_bid = bid.mean();
+        f.avg_ask = ask.mean();
+        f.avg_spread = spread.mean();
+        f.avg_mid = (bid.sum() + ask.sum()) / (2 * count);
+        f.min_spread = spread.min;
+        f.max_spread = spread.max;
+        f.spread_volatility = std::sqrt(spread.variance());
+        f.bid_size = bid_sz_[newest];
+        f.ask_size = ask_sz_[newest];
+        f.avg_bid_size = bid_size.mean();
+        f.avg_ask_size = ask_size.mean();
+        f.total_bid_size = bid_size.sum();
+        f.total_ask_size = ask_size.sum();
+        f.size_imbalance =
+            (f.total_bid_size - f.total_ask_size) / std::max(f.total_bid_size + f.total_ask_size, 1.0);
+        f.mid_change = index_.size() > 1 ? f.mid_price - first_mid : 0;
+        f.mid_change_pct = first_mid > 0 ? f.mid_change / first_mid * 100 : 0;
+        f.update_count = index_.size();
+        return f;
+    }
+
+    const RingIndex &index() const { return index_; }
+    const std::vector<int64_t> &event_ts() const { return event_ts_; }
+    const std::vector<double> &bid_px() const { return bid_px_; }
+    const std::vector<double> &bid_sz() const { return bid_sz_; }
+    const std::vector<double> &ask_px() const { return ask_px_; }
+    const std::vector<double> &ask_sz() const { return ask_sz_; }
+
+    std::size_t size() const { return index_.size(); }
+    void clear() { index_.clear(); }
+
+private:
+    RingIndex index_;
+    std::vector<int64_t> event_ts_;
+    std::vector<double> bid_px_;
+    std::vector<double> bid_sz_;
+    std::vector<double> ask_px_;
+    std::vector<double> ask_sz_;
+    std::vector<double> spread_;
+};
+
+#endif
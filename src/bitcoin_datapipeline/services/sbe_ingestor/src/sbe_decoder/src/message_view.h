@@ -0,0 +1,150 @@
+/*
+ * Lazy, read-only view of one SBE frame.
+ *
+ * Filtering and routing often need one or two fields (a gap detector reads
+ * first_update_id/final_update_id, a router the symbol), not a decoded
+ * message. A MessageView reads the 8-byte header and checks that the
+ * body covers the template's fixed block, nothing more. Each accessor then
+ * loads its field straight from the frame at the spot_stream codec's
+ * constexpr offset when it is called. symbol() is the one accessor that
+ * walks the frame (past the repeating groups); it never decodes a level.
+ *
+ * Fields a template does not carry come back as std::nullopt. The view
+ * borrows the frame's bytes; SBEDecoder.view pins them for as long as the
+ * Python object lives.
+ */
+
+#ifndef _SBE_MESSAGE_VIEW_H_
+#define _SBE_MESSAGE_VIEW_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+
+class MessageView {
+public:
+    // Throws std::runtime_error when the frame is shorter than its header or,
+    // for a stream template, than the template's fixed block
+    MessageView(const char *data, std::size_t size) : data_(data), size_(size) {
+        using spot_sbe::MessageHeader;
+        if (size < MessageHeader::encodedLength()) {
+            throw std::runtime_error("SBE view: buffer too short for message header");
+        }
+        MessageHeader header{const_cast<char *>(data), size};
+        block_length_ = header.blockLength();
+        template_id_ = header.templateId();
+        schema_id_ = header.schemaId();
+        version_ = header.version();
+
+        const uint16_t fixed_block = fixed_block_length(template_id_);
+        if (body_size() < std::max(block_length_, fixed_block)) {
+            throw std::runtime_error("SBE view: payload shorter than block length");
+        }
+    }
+
+    uint16_t template_id() const { return template_id_; }
+    uint16_t schema_id() const { return schema_id_; }
+    uint16_t version() const { return version_; }
+    uint16_t block_length() const { return block_length_; }
+    std::size_t size() const { return size_; }
+
+    std::optional<uint64_t> event_time_us() const {
+        switch (template_id_) {
+        case TRADES_STREAM_EVENT:
+            return field<spot_stream::TradesStreamEvent::EVENT_TIME_OFFSET>();
+        case BEST_BID_ASK_STREAM_EVENT:
+            return field<spot_stream::BestBidAskStreamEvent::EVENT_TIME_OFFSET>();
+        case DEPTH_SNAPSHOT_STREAM_EVENT:
+            return field<spot_stream::DepthSnapshotStreamEvent::EVENT_TIME_OFFSET>();
+        case DEPTH_DIFF_STREAM_EVENT:
+            return field<spot_stream::DepthDiffStreamEvent::EVENT_TIME_OFFSET>();
+        default:
+            return std::nullopt;
+        }
+    }
+
+    std::optional<uint64_t> trade_time_us() const {
+        if (template_id_ != TRADES_STREAM_EVENT) {
+            return std::nullopt;
+        }
+        return field<spot_stream::TradesStreamEvent::TRANSACT_TIME_OFFSET>();
+    }
+
+    // bookUpdateId of the best bid/ask and partial-depth templates
+    std::optional<uint64_t> book_update_id() const {
+        switch (template_id_) {
+        case BEST_BID_ASK_STREAM_EVENT:
+            return field<spot_stream::BestBidAskStreamEvent::BOOK_UPDATE_ID_OFFSET>();
+        case DEPTH_SNAPSHOT_STREAM_EVENT:
+            return field<spot_stream::DepthSnapshotStreamEvent::BOOK_UPDATE_ID_OFFSET>();
+        default:
+            return std::nullopt;
+        }
+    }
+
+    std::optional<uint64_t> first_update_id() const {
+        if (template_id_ != DEPTH_DIFF_STREAM_EVENT) {
+            return std::nullopt;
+        }
+        return field<spot_stream::DepthDiffStreamEvent::FIRST_BOOK_UPDATE_ID_OFFSET>();
+    }
+
+    std::optional<uint64_t> final_update_id() const {
+        if (template_id_ != DEPTH_DIFF_STREAM_EVENT) {
+            return std::nullopt;
+        }
+        return field<spot_stream::DepthDiffStreamEvent::LAST_BOOK_UPDATE_ID_OFFSET>();
+    }
+
+    // The stream symbol (DEFAULT_SYMBOL when the frame omits it), or empty
+    // for templates without one. Validates the groups it skips, so a
+    // truncated frame throws std::runtime_error here rather than at view time.
+    std::string_view symbol() const {
+        std::string_view symbol;
+        if (const auto error = stream_frame_symbol(template_id_, body(), body_size(), block_length_, symbol);
+            error != ParseError::None) {
+            throw_parse_error(error, "view");
+        }
+        return symbol;
+    }
+
+private:
+    const char *body() const { return data_ + spot_sbe::MessageHeader::encodedLength(); }
+    std::size_t body_size() const { return size_ - spot_sbe::MessageHeader::encodedLength(); }
+
+    // Fixed block the accessors read for a stream template, 0 otherwise
+    static uint16_t fixed_block_length(uint16_t template_id) {
+        switch (template_id) {
+        case TRADES_STREAM_EVENT:
+            return spot_stream::TradesStreamEvent::SBE_BLOCK_LENGTH;
+        case BEST_BID_ASK_STREAM_EVENT:
+            return spot_stream::BestBidAskStreamEvent::SBE_BLOCK_LENGTH;
+        case DEPTH_SNAPSHOT_STREAM_EVENT:
+            return spot_stream::DepthSnapshotStreamEvent::SBE_BLOCK_LENGTH;
+        case DEPTH_DIFF_STREAM_EVENT:
+            return spot_stream::DepthDiffStreamEvent::SBE_BLOCK_LENGTH;
+        default:
+            return 0;
+        }
+    }
+
+    // Checked at construction: the fixed block is inside the frame
+    template <std::size_t Offset>
+    uint64_t field() const {
+        return spot_stream::load<uint64_t>(body() + Offset);
+    }
+
+    const char *data_;
+    std::size_t size_;
+    uint16_t block_length_ = 0;
+    uint16_t template_id_ = 0;
+    uint16_t schema_id_ = 0;
+    uint16_t version_ = 0;
+};
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * Walking a buffer that holds several SBE messages back to back.
+ *
+ * A WebSocket message or a Python bytes object normally carries one
+ * MessageHeader and its body, but concatenated captures and combined
+ * payloads put several messages in one buffer. SBE messages carry no total
+ * length: a message ends where its last group or var-data field ends. So
+ * message_length() wraps the body with the template's codec, which steps
+ * over the fixed block (at the header's blockLength, so newer schema
+ * versions with longer blocks still measure correctly), each group and
+ * each var-data field, and reports where it stopped.
+ *
+ * The walk measures the templates the decoders handle: the four stream
+ * events, and the REST responses decode_frame turns into rows. When a
+ * message cannot be measured (unknown template, truncated body), the rest
+ * of the buffer becomes one final frame, so the decoder reports it as an
+ * error or unknown frame exactly as it would have before, and nothing
+ * after it is misread as a message.
+ */
+
+#ifndef _SBE_MESSAGE_WALK_H_
+#define _SBE_MESSAGE_WALK_H_
+
+#include <cstdint>
+#include <exception>
+#include <span>
+#include <vector>
+
+#include "spot_sbe/AggTradesResponse.h"
+#include "spot_sbe/DepthResponse.h"
+#include "spot_sbe/KlinesResponse.h"
+#include "spot_sbe/MessageHeader.h"
+#include "spot_sbe/TradesResponse.h"
+#include "stream_decode.h"
+#include "util.h"
+
+// Header plus the stream event's body, or 0
+template <typename Stream>
+std::size_t stream_message_length(std::span<char> buffer, uint16_t block_length) noexcept {
+    constexpr std::size_t header = spot_sbe::MessageHeader::encodedLength();
+    Stream msg;
+    if (msg.wrapForDecode(buffer.data() + header, buffer.size() - header, block_length) !=
+        spot_stream::DecodeError::None) [[unlikely]] {
+        return 0;
+    }
+    return header + msg.encodedLength();
+}
+
+// Header plus the generated codec's walk of the response, or 0 when it
+// overruns the buffer (the codecs throw)
+template <typename Response>
+std::size_t response_message_length(std::span<char> buffer, const spot_sbe::MessageHeader &header) noexcept {
+    try {
+        auto msg = message_from_header<Response>(buffer, header);
+        msg.skip();
+        return spot_sbe::MessageHeader::encodedLength() + msg.encodedLength();
+    } catch (const std::exception &) {
+        return 0;
+    }
+}
+
+// Length of the message at the start of `buffer`, header included; 0 when
+// it is too short for a header, of an unmeasured template, or overruns
+// the buffer
+inline std::size_t message_length(std::span<char> buffer) noexcept {
+    using spot_sbe::MessageHeader;
+
+    if (buffer.size() < MessageHeader::encodedLength()) [[unlikely]] {
+        return 0;
+    }
+    const MessageHeader header{buffer.data(), buffer.size()};
+    const uint16_t block_length = header.blockLength();
+    switch (header.templateId()) {
+    case TRADES_STREAM_EVENT:
+        return stream_message_length<spot_stream::TradesStreamEvent>(buffer, block_length);
+    case BEST_BID_ASK_STREAM_EVENT:
+        return stream_message_length<spot_stream::BestBidAskStreamEvent>(buffer, block_length);
+    case DEPTH_DIFF_STREAM_EVENT:
+        return stream_message_length<spot_stream::DepthDiffStreamEvent>(buffer, block_length);
+    case DEPTH_SNAPSHOT_STREAM_EVENT:
+        return stream_message_length<spot_stream::DepthSnapshotStreamEvent>(buffer, block_length);
+    case spot_sbe::AggTradesResponse::SBE_TEMPLATE_ID:
+        return response_message_length<spot_sbe::AggTradesResponse>(buffer, header);
+    case spot_sbe::KlinesResponse::SBE_TEMPLATE_ID:
+        return response_message_length<spot_sbe::KlinesResponse>(buffer, header);
+    case spot_sbe::TradesResponse::SBE_TEMPLATE_ID:
+        return response_message_length<spot_sbe::TradesResponse>(buffer, header);
+    case spot_sbe::DepthResponse::SBE_TEMPLATE_ID:
+        return response_message_length<spot_sbe::DepthResponse>(buffer, header);
+    default:
+        return 0;
+    }
+}
+
+// Append each message in `buffer` to `out` and return how many there were.
+// Trailing bytes too short for another header stay on the last message,
+// so a buffer holding one message appends it whole, as before; an empty
+// buffer appends itself and decodes as a short header.
+inline std::size_t split_messages(std::span<char> buffer, std::vector<std::span<char>> &out) {
+    std::size_t count = 0;
+    while (true) {
+        ++count;
+        const std::size_t length = message_length(buffer);
+        if (length == 0 || buffer.size() - length < spot_sbe::MessageHeader::encodedLength()) {
+            out.push_back(buffer);
+            return count;
+        }
+        out.push_back(buffer.first(length));
+        buffer = buffer.subspan(length);
+    }
+}
+
+#endif
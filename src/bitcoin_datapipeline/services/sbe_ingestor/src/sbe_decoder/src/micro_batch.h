@@ -0,0 +1,102 @@
+/*
+ * When the consumer of a receiver's rings should take what is waiting.
+ *
+ * Every drain() is one crossing into Python: a GIL acquisition, a batch of
+ * arrays and a trip round the event loop. Draining as soon as one record
+ * is waiting gives the lowest latency and the most crossings; waiting for
+ * a full batch gives the fewest crossings and holds the first record back.
+ * A MicroBatcher makes the trade explicit: a drain hands off once
+ * `target` records are waiting or the oldest of them (by its receive
+ * stamp) is max_delay_us old, whichever comes first.
+ *
+ * With `adaptive`, the target follows the flow. A handoff that reached the
+ * target before the deadline means records arrive faster than the target
+ * fills, so the target doubles (up to max_records); one cut off by the
+ * deadline means the market is quieter than that, so the target drops to
+ * what did arrive in the window (not below min_records). A quiet market
+ * settles at a target of one record, i.e. per-message handoffs with no
+ * wait at all, and a burst grows the batch within a few drains. The fixed
+ * mode keeps target = max_records.
+ *
+ * Only the consumer thread drives a MicroBatcher; its stats and target
+ * can be read from any thread.
+ */
+
+#ifndef _SBE_MICRO_BATCH_H_
+#define _SBE_MICRO_BATCH_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct MicroBatchConfig {
+    // Records to wait for; 1 hands off as soon as any are waiting (off)
+    std::size_t max_records = 1;
+    // ...or until the oldest waiting record is this old
+    uint64_t max_delay_us = 0;
+    // Move the target between min_records and max_records with the flow
+    bool adaptive = false;
+    std::size_t min_records = 1;
+
+    bool enabled() const { return max_records > 1 && max_delay_us > 0; }
+};
+
+struct MicroBatchStats {
+    std::atomic<uint64_t> batches{0};
+    // Handed off on reaching the target...
+    std::atomic<uint64_t> full{0};
+    // ...or on the oldest record reaching max_delay_us
+    std::atomic<uint64_t> timed_out{0};
+    // Records handed off
+    std::atomic<uint64_t> records{0};
+};
+
+class MicroBatcher {
+public:
+    explicit MicroBatcher(const MicroBatchConfig &config)
+        : config_(config), max_(std::max<std::size_t>(config.max_records, 1)),
+          min_(std::clamp<std::size_t>(config.min_records, 1, max_)), target_(config.adaptive ? min_ : max_) {}
+
+    // Records to wait for when a drain takes at most `limit`
+    std::size_t target(std::size_t limit = SIZE_MAX) const {
+        return std::clamp<std::size_t>(target_.load(std::memory_order_relaxed), 1, std::max<std::size_t>(limit, 1));
+    }
+
+    // Microseconds still to wait for a batch whose oldest record is
+    // `age_us` old with `waiting` records; 0 to hand off now
+    uint64_t wait_us(std::size_t waiting, uint64_t age_us, std::size_t limit = SIZE_MAX) const {
+        if (!config_.enabled() || waiting >= target(limit) || age_us >= config_.max_delay_us) {
+            return 0;
+        }
+        return config_.max_delay_us - age_us;
+    }
+
+    // After a handoff of `records` that were `waiting` when it was decided
+    void handed_off(std::size_t records, std::size_t waiting, std::size_t limit = SIZE_MAX) {
+        stats_.batches.fetch_add(1, std::memory_order_relaxed);
+        stats_.records.fetch_add(records, std::memory_order_relaxed);
+        if (!config_.enabled()) {
+            return;
+        }
+        const bool full = waiting >= target(limit);
+        (full ? stats_.full : stats_.timed_out).fetch_add(1, std::memory_order_relaxed);
+        if (config_.adaptive) {
+            const std::size_t target = target_.load(std::memory_order_relaxed);
+            const std::size_t next = full ? std::min(target * 2, max_) : std::clamp(waiting, min_, max_);
+            target_.store(next, std::memory_order_relaxed);
+        }
+    }
+
+    const MicroBatchConfig &config() const { return config_; }
+    const MicroBatchStats &stats() const { return stats_; }
+
+private:
+    const MicroBatchConfig config_;
+    const std::size_t max_;
+    const std::size_t min_;
+    std::atomic<std::size_t> target_;
+    MicroBatchStats stats_;
+};
+
+#endif
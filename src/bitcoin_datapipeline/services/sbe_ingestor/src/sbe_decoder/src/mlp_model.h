@@ -0,0 +1,833 @@
+/*
+ * Dense-network runtime for the 10-second-ahead price model.
+ *
+ * The planned inference service runs a small MLP (Linear + BatchNorm + ReLU
+ * blocks, one linear output) from Python. MlpModel runs the same network
+ * natively: each layer is one GEMV over row-major weights whose rows are
+ * padded to a whole number of SIMD vectors, with bias and activation fused
+ * into the row loop. A layer can be quantized to int8 per output row
+ * (symmetric, weights only), which cuts the weight bytes per prediction by
+ * four; the activations stay float. The kernel is picked at run time like
+ * column_stats.h.
+ *
+ * Weights come from an MLP weight file, the trainer's export format:
+ *
+ *   magic "BTCMLP01", uint32 version, uint32 layer count, uint32 input size,
+ *   uint32 reserved, float32 input mean[input], float32 input scale[input],
+ *   then per layer: uint32 in, uint32 out, uint8 activation, 3 reserved
+ *   bytes, float32 weights[out][in], float32 bias[out]
+ *
+ * all little-endian. BatchNorm is folded into the preceding Linear at export
+ * and the input scaler is applied as (x - mean) / scale, so a file is just
+ * dense layers. Prediction reuses the model's scratch buffers: not
+ * thread-safe, one model per thread.
+ *
+ * predict_batch() runs many feature vectors (e.g. every symbol's latest)
+ * through each layer together: each loaded weight vector multiplies
+ * BATCH_BLOCK inputs, so the weights come through the cache N / BATCH_BLOCK
+ * times per batch instead of N times.
+ *
+ * An aligned weight file holds the same model laid out as it is used, so
+ * load() maps it read-only and the layers read their rows in place instead
+ * of parsing a copy: startup costs the page faults of the rows a
+ * prediction touches. It is a 64-byte MlpAlignedHeader (with a revision
+ * the trainer stamps), a table of 32-byte MlpAlignedLayer entries, then
+ * 64-byte aligned sections: input mean and scale (mlp_padded(input) floats
+ * each), and per layer its rows (mlp_padded(in) floats, zero-padded) and
+ * bias. Deployments write it beside the old file and rename it over, so a
+ * mapped model never changes underneath its readers.
+ *
+ * MlpModelSwap rolls a new version out between predictions: a loader
+ * thread maps the file, faults its pages in and stages the model; the
+ * predicting thread picks it up at its next prediction with one atomic
+ * exchange, and hands the old model back to the loader to free. Neither
+ * side waits for the other.
+ */
+
+#ifndef _SBE_MLP_MODEL_H_
+#define _SBE_MLP_MODEL_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cpu_dispatch.h"
+
+static_assert(std::endian::native == std::endian::little, "MLP weight files are read in host byte order");
+
+constexpr char MLP_WEIGHTS_MAGIC[8] = {'B', 'T', 'C', 'M', 'L', 'P', '0', '1'};
+constexpr uint32_t MLP_WEIGHTS_VERSION = 1;
+constexpr char MLP_ALIGNED_MAGIC[8] = {'B', 'T', 'C', 'M', 'L', 'P', 'A', '1'};
+constexpr uint32_t MLP_ALIGNED_VERSION = 1;
+// Alignment of every section of an aligned weight file
+constexpr std::size_t MLP_FILE_ALIGN = 64;
+
+enum class Activation : uint8_t {
+    Identity = 0,
+    Relu = 1,
+    Tanh = 2,
+    Sigmoid = 3,
+};
+
+// Floats per padded weight row / activation buffer
+constexpr std::size_t MLP_ROW_ALIGN = 16;
+
+inline std::size_t mlp_padded(std::size_t n) { return (n + MLP_ROW_ALIGN - 1) / MLP_ROW_ALIGN * MLP_ROW_ALIGN; }
+
+struct DenseLayer {
+    uint32_t in = 0;
+    uint32_t out = 0;
+    Activation activation = Activation::Identity;
+    // out rows of mlp_padded(in) floats, zero past `in`; empty once quantized
+    std::vector<float> weights;
+    // The same rows inside a mapped weight file, in place of `weights`
+    const float *mapped_weights = nullptr;
+    std::vector<float> bias;
+    // int8 rows (same padding) and their scales when quantized
+    std::vector<int8_t> qweights;
+    std::vector<float> row_scale;
+
+    std::size_t stride() const { return mlp_padded(in); }
+    bool quantized() const { return !qweights.empty(); }
+    const float *float_rows() const { return mapped_weights != nullptr ? mapped_weights : weights.data(); }
+};
+
+struct MlpAlignedHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t layers;
+    uint32_t inputs;
+    // 1 when the file has an input scaler
+    uint32_t scaled;
+    // Stamped by the trainer, e.g. the training run
+    uint64_t revision;
+    // Input mean, then input scale
+    uint64_t scaler_offset;
+    char padding[24];
+};
+static_assert(sizeof(MlpAlignedHeader) == 64);
+
+struct MlpAlignedLayer {
+    uint32_t in;
+    uint32_t out;
+    uint8_t activation;
+    uint8_t reserved[7];
+    uint64_t weights_offset;
+    uint64_t bias_offset;
+};
+static_assert(sizeof(MlpAlignedLayer) == 32);
+
+// GCC 12 flags _mm512_undefined_ps inside the AVX-512 intrinsics as
+// (maybe-)uninitialized wherever they are inlined, and warns that the vector
+// ops' ABI depends on the target each time one is instantiated
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+namespace mlp_detail {
+
+#if SBE_X86_DISPATCH
+struct Avx512Ops {
+    static constexpr std::size_t LANES = 16;
+    using Vec = __m512;
+    SBE_TARGET_AVX512 static Vec zero() { return _mm512_setzero_ps(); }
+    SBE_TARGET_AVX512 static Vec load(const float *at) { return _mm512_loadu_ps(at); }
+    SBE_TARGET_AVX512 static Vec load(const int8_t *at) {
+        return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(at))));
+    }
+    SBE_TARGET_AVX512 static Vec fmadd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+    SBE_TARGET_AVX512 static float hsum(Vec v) { return _mm512_reduce_add_ps(v); }
+};
+
+struct Avx2Ops {
+    static constexpr std::size_t LANES = 8;
+    using Vec = __m256;
+    SBE_TARGET_AVX2 static Vec zero() { return _mm256_setzero_ps(); }
+    SBE_TARGET_AVX2 static Vec load(const float *at) { return _mm256_loadu_ps(at); }
+    SBE_TARGET_AVX2 static Vec load(const int8_t *at) {
+        return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(at))));
+    }
+    SBE_TARGET_AVX2 static Vec fmadd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+    SBE_TARGET_AVX2 static float hsum(Vec v) {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+        return _mm_cvtss_f32(sum);
+    }
+};
+
+// The x86-64 baseline; int8 rows widen in one instruction with SSE4.1,
+// which setup.py's baseline includes
+struct SseOps {
+    static constexpr std::size_t LANES = 4;
+    using Vec = __m128;
+    static Vec zero() { return _mm_setzero_ps(); }
+    static Vec load(const float *at) { return _mm_loadu_ps(at); }
+    static Vec load(const int8_t *at) {
+#if defined(__SSE4_1__)
+        int32_t bytes;
+        std::memcpy(&bytes, at, sizeof(bytes));
+        return _mm_cvtepi32_ps(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(bytes)));
+#else
+        return _mm_setr_ps(at[0], at[1], at[2], at[3]);
+#endif
+    }
+    static Vec fmadd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static float hsum(Vec v) {
+        const __m128 sum = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        return _mm_cvtss_f32(_mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1)));
+    }
+};
+#elif defined(__aarch64__)
+struct NeonOps {
+    static constexpr std::size_t LANES = 4;
+    using Vec = float32x4_t;
+    static Vec zero() { return vdupq_n_f32(0); }
+    static Vec load(const float *at) { return vld1q_f32(at); }
+    static Vec load(const int8_t *at) {
+        int32_t bytes;
+        std::memcpy(&bytes, at, sizeof(bytes));
+        const int16x8_t wide = vmovl_s8(vreinterpret_s8_s32(vdup_n_s32(bytes)));
+        return vcvtq_f32_s32(vmovl_s16(vget_low_s16(wide)));
+    }
+    static Vec fmadd(Vec a, Vec b, Vec c) { return vfmaq_f32(c, a, b); }
+    static float hsum(Vec v) { return vaddvq_f32(v); }
+};
+#else
+struct ScalarOps {
+    static constexpr std::size_t LANES = 1;
+    using Vec = float;
+    static Vec zero() { return 0; }
+    static Vec load(const float *at) { return *at; }
+    static Vec load(const int8_t *at) { return static_cast<float>(*at); }
+    static Vec fmadd(Vec a, Vec b, Vec c) { return a * b + c; }
+    static float hsum(Vec v) { return v; }
+};
+#endif
+
+// Inputs that share each loaded weight vector in a batch
+constexpr std::size_t BATCH_BLOCK = 4;
+
+// sums[k] = Σ row[i] * x[k * x_stride + i] over `n` (a multiple of
+// MLP_ROW_ALIGN) for ROWS inputs; int8 rows are widened in registers
+template <typename Ops, std::size_t ROWS, typename Weight>
+[[gnu::always_inline]] inline void dot_rows(const Weight *row, const float *x, std::size_t x_stride, std::size_t n,
+                                            float *sums) {
+    static_assert(MLP_ROW_ALIGN % Ops::LANES == 0, "padded rows must be whole vectors");
+    typename Ops::Vec acc[ROWS];
+    for (auto &a : acc) {
+        a = Ops::zero();
+    }
+    for (std::size_t i = 0; i < n; i += Ops::LANES) {
+        const auto w = Ops::load(row + i);
+        for (std::size_t k = 0; k < ROWS; ++k) {
+            acc[k] = Ops::fmadd(w, Ops::load(x + k * x_stride + i), acc[k]);
+        }
+    }
+    for (std::size_t k = 0; k < ROWS; ++k) {
+        sums[k] = Ops::hsum(acc[k]);
+    }
+}
+
+inline float activate(Activation activation, float value) {
+    switch (activation) {
+    case Activation::Relu:
+        return value > 0 ? value : 0;
+    case Activation::Tanh:
+        return std::tanh(value);
+    case Activation::Sigmoid:
+        return 1 / (1 + std::exp(-value));
+    case Activation::Identity:
+        break;
+    }
+    return value;
+}
+
+// y[k] = activation(W x[k] + b) for `rows` inputs of layer.stride() floats,
+// `x_stride` apart, writing outputs `y_stride` apart. Inputs go through in
+// blocks of BATCH_BLOCK so each weight load feeds BATCH_BLOCK accumulators,
+// which turns N GEMVs into a blocked GEMM; leftover inputs run one by one.
+// Always inlined into a caller compiled for Ops' ISA.
+template <typename Ops, typename Weight>
+[[gnu::always_inline]] inline void dense_rows(const DenseLayer &layer, const Weight *weights, const float *x,
+                                              std::size_t x_stride, std::size_t rows, float *y,
+                                              std::size_t y_stride) {
+    const std::size_t stride = layer.stride();
+    const auto output = [&](std::size_t k, uint32_t r, float sum) {
+        const float scale = layer.quantized() ? layer.row_scale[r] : 1.0f;
+        y[k * y_stride + r] = activate(layer.activation, scale * sum + layer.bias[r]);
+    };
+    float sums[BATCH_BLOCK];
+    std::size_t k = 0;
+    for (; k + BATCH_BLOCK <= rows; k += BATCH_BLOCK) {
+        for (uint32_t r = 0; r < layer.out; ++r) {
+            dot_rows<Ops, BATCH_BLOCK>(weights + r * stride, x + k * x_stride, x_stride, stride, sums);
+            for (std::size_t j = 0; j < BATCH_BLOCK; ++j) {
+                output(k + j, r, sums[j]);
+            }
+        }
+    }
+    for (; k < rows; ++k) {
+        for (uint32_t r = 0; r < layer.out; ++r) {
+            dot_rows<Ops, 1>(weights + r * stride, x + k * x_stride, 0, stride, sums);
+            output(k, r, sums[0]);
+        }
+    }
+}
+
+template <typename Ops>
+[[gnu::always_inline]] inline void dense_forward_with(const DenseLayer &layer, const float *x, std::size_t x_stride,
+                                                      std::size_t rows, float *y, std::size_t y_stride) {
+    if (layer.quantized()) {
+        dense_rows<Ops>(layer, layer.qweights.data(), x, x_stride, rows, y, y_stride);
+    } else {
+        dense_rows<Ops>(layer, layer.float_rows(), x, x_stride, rows, y, y_stride);
+    }
+}
+
+#if SBE_X86_DISPATCH
+SBE_TARGET_AVX512 inline void dense_forward_avx512(const DenseLayer &layer, const float *x, std::size_t x_stride,
+                                                   std::size_t rows, float *y, std::size_t y_stride) {
+    dense_forward_with<Avx512Ops>(layer, x, x_stride, rows, y, y_stride);
+}
+
+SBE_TARGET_AVX2 inline void dense_forward_avx2(const DenseLayer &layer, const float *x, std::size_t x_stride,
+                                               std::size_t rows, float *y, std::size_t y_stride) {
+    dense_forward_with<Avx2Ops>(layer, x, x_stride, rows, y, y_stride);
+}
+#endif
+
+// One layer through the widest kernel simd_level() allows
+inline void dense_forward(const DenseLayer &layer, const float *x, std::size_t x_stride, std::size_t rows, float *y,
+                          std::size_t y_stride) {
+#if SBE_X86_DISPATCH
+    switch (simd_level()) {
+    case SimdLevel::Avx512:
+        return dense_forward_avx512(layer, x, x_stride, rows, y, y_stride);
+    case SimdLevel::Avx2:
+        return dense_forward_avx2(layer, x, x_stride, rows, y, y_stride);
+    case SimdLevel::Baseline:
+        break;
+    }
+    dense_forward_with<SseOps>(layer, x, x_stride, rows, y, y_stride);
+#elif defined(__aarch64__)
+    dense_forward_with<NeonOps>(layer, x, x_stride, rows, y, y_stride);
+#else
+    dense_forward_with<ScalarOps>(layer, x, x_stride, rows, y, y_stride);
+#endif
+}
+
+// Sequential reader over a weight file image
+class WeightReader {
+public:
+    explicit WeightReader(std::span<const char> data) : data_(data) {}
+
+    template <typename T>
+    T read() {
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    void read_floats(float *out, std::size_t n) { std::memcpy(out, take(n * sizeof(float)), n * sizeof(float)); }
+
+    const char *take(std::size_t n) {
+        if (data_.size() - offset_ < n) {
+            throw std::runtime_error("MLP weights: truncated file");
+        }
+        const char *at = data_.data() + offset_;
+        offset_ += n;
+        return at;
+    }
+
+    std::size_t remaining() const { return data_.size() - offset_; }
+    bool done() const { return offset_ == data_.size(); }
+
+private:
+    std::span<const char> data_;
+    std::size_t offset_ = 0;
+};
+
+// Read-only mapping of a whole weight file
+class MappedWeights {
+public:
+    explicit MappedWeights(const std::string &path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::runtime_error("cannot open MLP weights " + path + ": " + std::strerror(errno));
+        }
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0 || st.st_size == 0) {
+            close();
+            throw std::runtime_error("MLP weights: empty or unreadable file " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void *base = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) {
+            close();
+            throw std::runtime_error("cannot map MLP weights " + path + ": " + std::strerror(errno));
+        }
+        base_ = static_cast<const char *>(base);
+        ::madvise(const_cast<char *>(base_), size_, MADV_WILLNEED);
+    }
+
+    ~MappedWeights() { close(); }
+
+    MappedWeights(const MappedWeights &) = delete;
+    MappedWeights &operator=(const MappedWeights &) = delete;
+
+    std::span<const char> bytes() const { return {base_, size_}; }
+
+    // Touch every page, so predictions never wait on a page fault
+    void prefault() const {
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        char sum = 0;
+        for (std::size_t at = 0; at < size_; at += page) {
+            sum ^= *static_cast<const volatile char *>(base_ + at);
+        }
+        touched_ = sum;
+    }
+
+private:
+    void close() {
+        if (base_ != nullptr) {
+            ::munmap(const_cast<char *>(base_), size_);
+            base_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    int fd_ = -1;
+    const char *base_ = nullptr;
+    std::size_t size_ = 0;
+    // Keeps prefault()'s reads
+    mutable char touched_ = 0;
+};
+
+inline std::size_t mlp_file_aligned(std::size_t n) {
+    return (n + MLP_FILE_ALIGN - 1) / MLP_FILE_ALIGN * MLP_FILE_ALIGN;
+}
+
+} // namespace mlp_detail
+
+// Name of the GEMV kernel simd_level() picked, for benchmarks and logs
+inline const char *mlp_kernel() { return simd_level_name(simd_level()); }
+
+class MlpModel {
+public:
+    // `input_mean`/`input_scale` may be empty (no scaling); every layer's
+    // `in` must match the previous layer's `out`
+    MlpModel(std::vector<float> input_mean, std::vector<float> input_scale, std::vector<DenseLayer> layers)
+        : input_mean_(std::move(input_mean)), layers_(std::move(layers)) {
+        if (layers_.empty()) {
+            throw std::runtime_error("MLP: at least one layer is required");
+        }
+        const std::size_t inputs = layers_.front().in;
+        if (!input_mean_.empty() && input_mean_.size() != inputs) {
+            throw std::runtime_error("MLP: input_mean does not match the input size");
+        }
+        if (input_scale.size() != input_mean_.size()) {
+            throw std::runtime_error("MLP: input_mean and input_scale must have the same length");
+        }
+        // Multiply by 1/scale; a zero scale (constant feature) passes the
+        // centred value through
+        for (const float scale : input_scale) {
+            input_inv_scale_.push_back(scale != 0 ? 1 / scale : 1);
+        }
+        widest_ = mlp_padded(inputs);
+        for (std::size_t i = 0; i < layers_.size(); ++i) {
+            DenseLayer &layer = layers_[i];
+            if (i > 0 && layer.in != layers_[i - 1].out) {
+                throw std::runtime_error("MLP: layer " + std::to_string(i) + " input size does not match");
+            }
+            const bool rows_ok = layer.mapped_weights != nullptr ||
+                                 layer.weights.size() == std::size_t{layer.out} * layer.stride();
+            if (layer.in == 0 || layer.out == 0 || layer.bias.size() != layer.out || !rows_ok) {
+                throw std::runtime_error("MLP: layer " + std::to_string(i) + " has inconsistent shapes");
+            }
+            widest_ = std::max(widest_, mlp_padded(layer.out));
+        }
+        scratch_[0].assign(widest_, 0.0f);
+        scratch_[1].assign(widest_, 0.0f);
+    }
+
+    // Parse a weight file image (see the top of this file)
+    static MlpModel from_bytes(std::span<const char> data) {
+        mlp_detail::WeightReader reader(data);
+        if (std::memcmp(reader.take(sizeof(MLP_WEIGHTS_MAGIC)), MLP_WEIGHTS_MAGIC, sizeof(MLP_WEIGHTS_MAGIC)) != 0) {
+            throw std::runtime_error("MLP weights: bad magic");
+        }
+        if (reader.read<uint32_t>() != MLP_WEIGHTS_VERSION) {
+            throw std::runtime_error("MLP weights: unsupported version");
+        }
+        const auto layer_count = reader.read<uint32_t>();
+        const auto inputs = reader.read<uint32_t>();
+        reader.read<uint32_t>();
+        // Shapes are checked against the bytes left before anything is
+        // allocated for them
+        if (std::size_t{inputs} * 2 * sizeof(float) > reader.remaining() || layer_count > reader.remaining() / 12) {
+            throw std::runtime_error("MLP weights: truncated file");
+        }
+        std::vector<float> mean(inputs), scale(inputs);
+        reader.read_floats(mean.data(), inputs);
+        reader.read_floats(scale.data(), inputs);
+
+        std::vector<DenseLayer> layers(layer_count);
+        for (DenseLayer &layer : layers) {
+            layer.in = reader.read<uint32_t>();
+            layer.out = reader.read<uint32_t>();
+            const auto activation = reader.read<uint8_t>();
+            if (activation > static_cast<uint8_t>(Activation::Sigmoid)) {
+                throw std::runtime_error("MLP weights: unknown activation");
+            }
+            layer.activation = static_cast<Activation>(activation);
+            reader.take(3);
+            if ((std::size_t{layer.in} + 1) * layer.out * sizeof(float) > reader.remaining()) {
+                throw std::runtime_error("MLP weights: truncated file");
+            }
+            const std::size_t stride = layer.stride();
+            layer.weights.assign(std::size_t{layer.out} * stride, 0.0f);
+            for (uint32_t r = 0; r < layer.out; ++r) {
+                reader.read_floats(layer.weights.data() + r * stride, layer.in);
+            }
+            layer.bias.resize(layer.out);
+            reader.read_floats(layer.bias.data(), layer.out);
+        }
+        if (!reader.done()) {
+            throw std::runtime_error("MLP weights: trailing bytes");
+        }
+        return MlpModel(std::move(mean), std::move(scale), std::move(layers));
+    }
+
+    // Map an aligned weight file and read its rows in place, or parse a
+    // plain one; `prefault` faults the mapping in before returning
+    static MlpModel load(const std::string &path, bool prefault = false) {
+        auto mapping = std::make_shared<const mlp_detail::MappedWeights>(path);
+        const std::span<const char> data = mapping->bytes();
+        if (data.size() < sizeof(MLP_ALIGNED_MAGIC) ||
+            std::memcmp(data.data(), MLP_ALIGNED_MAGIC, sizeof(MLP_ALIGNED_MAGIC)) != 0) {
+            return from_bytes(data);
+        }
+        MlpModel model = from_mapping(mapping);
+        if (prefault) {
+            mapping->prefault();
+        }
+        return model;
+    }
+
+    // The aligned weight file image of this model (float models only),
+    // stamped with `revision`
+    std::vector<char> to_aligned_bytes(uint64_t revision) const {
+        if (quantized()) {
+            throw std::runtime_error("MLP: a quantized model has no float weights to save");
+        }
+        const uint32_t inputs = input_size();
+        const std::size_t table = sizeof(MlpAlignedHeader) + layers_.size() * sizeof(MlpAlignedLayer);
+        std::size_t at = mlp_detail::mlp_file_aligned(table);
+        MlpAlignedHeader header{};
+        std::memcpy(header.magic, MLP_ALIGNED_MAGIC, sizeof(MLP_ALIGNED_MAGIC));
+        header.version = MLP_ALIGNED_VERSION;
+        header.layers = static_cast<uint32_t>(layers_.size());
+        header.inputs = inputs;
+        header.scaled = input_mean_.empty() ? 0 : 1;
+        header.revision = revision;
+        if (header.scaled != 0) {
+            header.scaler_offset = at;
+            at += mlp_detail::mlp_file_aligned(2 * mlp_padded(inputs) * sizeof(float));
+        }
+        std::vector<MlpAlignedLayer> entries(layers_.size());
+        for (std::size_t l = 0; l < layers_.size(); ++l) {
+            const DenseLayer &layer = layers_[l];
+            MlpAlignedLayer &entry = entries[l];
+            entry = {};
+            entry.in = layer.in;
+            entry.out = layer.out;
+            entry.activation = static_cast<uint8_t>(layer.activation);
+            entry.weights_offset = at;
+            at += mlp_detail::mlp_file_aligned(std::size_t{layer.out} * layer.stride() * sizeof(float));
+            entry.bias_offset = at;
+            at += mlp_detail::mlp_file_aligned(layer.out * sizeof(float));
+        }
+
+        std::vector<char> out(at, 0);
+        std::memcpy(out.data(), &header, sizeof(header));
+        std::memcpy(out.data() + sizeof(header), entries.data(), entries.size() * sizeof(MlpAlignedLayer));
+        if (header.scaled != 0) {
+            auto *mean = reinterpret_cast<float *>(out.data() + header.scaler_offset);
+            float *scale = mean + mlp_padded(inputs);
+            for (uint32_t i = 0; i < inputs; ++i) {
+                mean[i] = input_mean_[i];
+                scale[i] = 1 / input_inv_scale_[i];
+            }
+        }
+        for (std::size_t l = 0; l < layers_.size(); ++l) {
+            const DenseLayer &layer = layers_[l];
+            std::memcpy(out.data() + entries[l].weights_offset, layer.float_rows(),
+                        std::size_t{layer.out} * layer.stride() * sizeof(float));
+            std::memcpy(out.data() + entries[l].bias_offset, layer.bias.data(), layer.out * sizeof(float));
+        }
+        return out;
+    }
+
+    // Quantize every layer's weights to int8, one symmetric scale per row
+    void quantize() {
+        for (DenseLayer &layer : layers_) {
+            if (layer.quantized()) {
+                continue;
+            }
+            const std::size_t stride = layer.stride();
+            layer.qweights.assign(std::size_t{layer.out} * stride, 0);
+            layer.row_scale.assign(layer.out, 0.0f);
+            for (uint32_t r = 0; r < layer.out; ++r) {
+                const float *row = layer.float_rows() + r * stride;
+                float peak = 0;
+                for (uint32_t i = 0; i < layer.in; ++i) {
+                    peak = std::max(peak, std::fabs(row[i]));
+                }
+                const float scale = peak > 0 ? peak / 127 : 1;
+                layer.row_scale[r] = scale;
+                for (uint32_t i = 0; i < layer.in; ++i) {
+                    layer.qweights[r * stride + i] = static_cast<int8_t>(std::lround(row[i] / scale));
+                }
+            }
+            layer.weights.clear();
+            layer.weights.shrink_to_fit();
+            layer.mapped_weights = nullptr;
+        }
+        // Nothing reads the float rows any more
+        mapping_.reset();
+    }
+
+    // One prediction: input_size() floats in, output_size() floats out
+    void predict(const float *x, float *out) { predict_batch(x, 1, out); }
+
+    // `rows` predictions at once: x is rows x input_size() and out is
+    // rows x output_size(), both row-major. The scratch buffers grow to the
+    // largest batch seen and are reused after that.
+    void predict_batch(const float *x, std::size_t rows, float *out) {
+        if (rows == 0) {
+            return;
+        }
+        if (scratch_[0].size() < rows * widest_) {
+            scratch_[0].assign(rows * widest_, 0.0f);
+            scratch_[1].assign(rows * widest_, 0.0f);
+        }
+        const uint32_t inputs = input_size();
+        float *current = scratch_[0].data();
+        for (std::size_t k = 0; k < rows; ++k) {
+            const float *in = x + k * inputs;
+            float *row = current + k * widest_;
+            for (uint32_t i = 0; i < inputs; ++i) {
+                row[i] = input_mean_.empty() ? in[i] : (in[i] - input_mean_[i]) * input_inv_scale_[i];
+            }
+            std::fill(row + inputs, row + mlp_padded(inputs), 0.0f);
+        }
+        for (std::size_t l = 0; l < layers_.size(); ++l) {
+            const DenseLayer &layer = layers_[l];
+            if (l + 1 == layers_.size()) {
+                mlp_detail::dense_forward(layer, current, widest_, rows, out, layer.out);
+                return;
+            }
+            float *next = scratch_[(l + 1) % 2].data();
+            mlp_detail::dense_forward(layer, current, widest_, rows, next, widest_);
+            // The next dot reads whole vectors; clear what a wider layer
+            // left in the padding
+            for (std::size_t k = 0; k < rows; ++k) {
+                std::fill(next + k * widest_ + layer.out, next + k * widest_ + mlp_padded(layer.out), 0.0f);
+            }
+            current = next;
+        }
+    }
+
+    // The weight file image of this model; float models only
+    std::vector<char> to_bytes() const {
+        if (quantized()) {
+            throw std::runtime_error("MLP: a quantized model has no float weights to save");
+        }
+        std::vector<char> out;
+        const auto put = [&out](const void *data, std::size_t n) {
+            const std::size_t at = out.size();
+            out.resize(at + n);
+            std::memcpy(out.data() + at, data, n);
+        };
+        const uint32_t header[4] = {MLP_WEIGHTS_VERSION, static_cast<uint32_t>(layers_.size()), input_size(), 0};
+        put(MLP_WEIGHTS_MAGIC, sizeof(MLP_WEIGHTS_MAGIC));
+        put(header, sizeof(header));
+        for (uint32_t i = 0; i < input_size(); ++i) {
+            const float mean = input_mean_.empty() ? 0.0f : input_mean_[i];
+            put(&mean, sizeof(mean));
+        }
+        for (uint32_t i = 0; i < input_size(); ++i) {
+            const float scale = input_mean_.empty() ? 1.0f : 1 / input_inv_scale_[i];
+            put(&scale, sizeof(scale));
+        }
+        for (const DenseLayer &layer : layers_) {
+            const uint32_t shape[2] = {layer.in, layer.out};
+            const char activation[4] = {static_cast<char>(layer.activation), 0, 0, 0};
+            put(shape, sizeof(shape));
+            put(activation, sizeof(activation));
+            for (uint32_t r = 0; r < layer.out; ++r) {
+                put(layer.float_rows() + r * layer.stride(), layer.in * sizeof(float));
+            }
+            put(layer.bias.data(), layer.out * sizeof(float));
+        }
+        return out;
+    }
+
+    uint32_t input_size() const { return layers_.front().in; }
+    uint32_t output_size() const { return layers_.back().out; }
+    const std::vector<DenseLayer> &layers() const { return layers_; }
+    bool quantized() const { return layers_.front().quantized(); }
+    // Whether the layers read their rows from a mapped weight file
+    bool mapped() const { return mapping_ != nullptr; }
+    // The aligned file's revision; 0 for other models
+    uint64_t revision() const { return revision_; }
+
+private:
+    // Layers whose rows point into `mapping`, validated against its size
+    static MlpModel from_mapping(std::shared_ptr<const mlp_detail::MappedWeights> mapping) {
+        const std::span<const char> data = mapping->bytes();
+        if (data.size() < sizeof(MlpAlignedHeader)) {
+            throw std::runtime_error("MLP weights: truncated file");
+        }
+        MlpAlignedHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.version != MLP_ALIGNED_VERSION) {
+            throw std::runtime_error("MLP weights: unsupported version");
+        }
+        // Every section must lie inside the file, aligned
+        const auto section = [&](uint64_t offset, std::size_t size) {
+            if (offset % MLP_FILE_ALIGN != 0 || offset > data.size() || size > data.size() - offset) {
+                throw std::runtime_error("MLP weights: section outside the file");
+            }
+            return data.data() + offset;
+        };
+        if (header.layers > (data.size() - sizeof(header)) / sizeof(MlpAlignedLayer)) {
+            throw std::runtime_error("MLP weights: truncated file");
+        }
+        std::vector<float> mean, scale;
+        if (header.scaled != 0) {
+            const std::size_t padded = mlp_padded(header.inputs);
+            const char *at = section(header.scaler_offset, 2 * padded * sizeof(float));
+            mean.resize(header.inputs);
+            scale.resize(header.inputs);
+            std::memcpy(mean.data(), at, header.inputs * sizeof(float));
+            std::memcpy(scale.data(), at + padded * sizeof(float), header.inputs * sizeof(float));
+        }
+        std::vector<DenseLayer> layers(header.layers);
+        for (uint32_t l = 0; l < header.layers; ++l) {
+            MlpAlignedLayer entry;
+            std::memcpy(&entry, data.data() + sizeof(header) + l * sizeof(entry), sizeof(entry));
+            if (entry.activation > static_cast<uint8_t>(Activation::Sigmoid)) {
+                throw std::runtime_error("MLP weights: unknown activation");
+            }
+            DenseLayer &layer = layers[l];
+            layer.in = entry.in;
+            layer.out = entry.out;
+            layer.activation = static_cast<Activation>(entry.activation);
+            // Shapes are bounded by the file before they size anything
+            const std::size_t floats = data.size() / sizeof(float);
+            if (layer.stride() > floats || entry.out > floats / std::max<std::size_t>(layer.stride(), 1)) {
+                throw std::runtime_error("MLP weights: truncated file");
+            }
+            const std::size_t rows = std::size_t{entry.out} * layer.stride();
+            layer.mapped_weights = reinterpret_cast<const float *>(section(entry.weights_offset, rows * sizeof(float)));
+            layer.bias.resize(entry.out);
+            std::memcpy(layer.bias.data(), section(entry.bias_offset, entry.out * sizeof(float)),
+                        entry.out * sizeof(float));
+        }
+        if (!layers.empty() && layers.front().in != header.inputs) {
+            throw std::runtime_error("MLP weights: input size does not match the first layer");
+        }
+        MlpModel model(std::move(mean), std::move(scale), std::move(layers));
+        model.mapping_ = std::move(mapping);
+        model.revision_ = header.revision;
+        return model;
+    }
+
+    std::vector<float> input_mean_;
+    std::vector<float> input_inv_scale_;
+    std::vector<DenseLayer> layers_;
+    // Row stride of the scratch buffers: the widest padded layer
+    std::size_t widest_ = 0;
+    // Ping-pong activations, one widest_ row per batch input
+    std::vector<float> scratch_[2];
+    // The weight file mapped_weights point into, if any
+    std::shared_ptr<const mlp_detail::MappedWeights> mapping_;
+    uint64_t revision_ = 0;
+};
+
+// Hands new model versions from a loader thread to the predicting thread.
+// The loader stages a fully loaded model; the predicting thread's next
+// current() swaps it in with one exchange and parks the model it replaced,
+// which the loader frees at its next stage() (or the predicting thread
+// frees, should two swaps come before the loader does).
+class MlpModelSwap {
+public:
+    MlpModelSwap() = default;
+    MlpModelSwap(const MlpModelSwap &) = delete;
+    MlpModelSwap &operator=(const MlpModelSwap &) = delete;
+
+    ~MlpModelSwap() {
+        delete pending_.load(std::memory_order_acquire);
+        delete retired_.load(std::memory_order_acquire);
+    }
+
+    // Loader side: `next` becomes current at the next prediction; a model
+    // staged before and never picked up is dropped
+    void stage(std::unique_ptr<MlpModel> next) {
+        delete retired_.exchange(nullptr, std::memory_order_acq_rel);
+        delete pending_.exchange(next.release(), std::memory_order_acq_rel);
+    }
+
+    // Predicting side: the model to predict with, after picking up a staged
+    // one; nullptr before the first stage()
+    MlpModel *current() {
+        if (pending_.load(std::memory_order_relaxed) != nullptr) {
+            if (MlpModel *next = pending_.exchange(nullptr, std::memory_order_acq_rel); next != nullptr) {
+                MlpModel *replaced = current_.release();
+                current_.reset(next);
+                delete retired_.exchange(replaced, std::memory_order_acq_rel);
+                swaps_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        return current_.get();
+    }
+
+    // Staged models picked up so far
+    uint64_t swaps() const { return swaps_.load(std::memory_order_relaxed); }
+    bool pending() const { return pending_.load(std::memory_order_relaxed) != nullptr; }
+
+private:
+    // Owned by the predicting thread
+    std::unique_ptr<MlpModel> current_;
+    std::atomic<MlpModel *> pending_{nullptr};
+    std::atomic<MlpModel *> retired_{nullptr};
+    std::atomic<uint64_t> swaps_{0};
+};
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Trade features over several horizons at once, from shared panes.
+ *
+ * Time is cut into fixed panes (by default the gcd of the horizons) and a
+ * ring of them covers the longest horizon. Each trade is absorbed once, into
+ * its pane's count, volume, notional, buy volume, min/max, first/last and
+ * Welford mean/M2. A horizon's features combine the panes it spans, oldest
+ * first; the means and M2s merge with Chan's parallel formula. Adding a
+ * horizon therefore costs one combine over its panes when features are read,
+ * not another pass over the trades, and every horizon uses trade_features()
+ * (trade_window.h), so all horizons share the single-window definitions.
+ *
+ * A horizon ends at the pane of the newest trade (or the advance() time) and
+ * includes that pane as it fills. A trade older than the ring is dropped;
+ * one that is late but still inside the ring lands in its own pane.
+ *
+ * The panes are plain data, so a window's whole state (panes(), current
+ * pane and late drops) can be checkpointed and restore()d elsewhere
+ * (window_checkpoint.h).
+ *
+ * Not thread-safe; the binding uses it with the GIL held.
+ */
+
+#ifndef _SBE_MULTI_HORIZON_H_
+#define _SBE_MULTI_HORIZON_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "trade_window.h"
+
+class MultiHorizonWindow {
+public:
+    // One pane's aggregates; trivially copyable, so checkpoints store it as is
+    struct Pane {
+        // Pane number (ts / pane_ms) the slot holds; stale slots are skipped
+        int64_t index = std::numeric_limits<int64_t>::min();
+        std::size_t count = 0;
+        int64_t first_ts_ms = 0;
+        int64_t last_ts_ms = 0;
+        double first_price = 0;
+        double last_price = 0;
+        double min_price = 0;
+        double max_price = 0;
+        double mean = 0;
+        double m2 = 0;
+        double volume = 0;
+        double notional = 0;
+        double buy_volume = 0;
+
+        void add(int64_t ts_ms, double price, double qty, bool is_buyer_maker) {
+            if (count == 0 || ts_ms < first_ts_ms) {
+                first_ts_ms = ts_ms;
+                first_price = price;
+            }
+            if (count == 0 || ts_ms >= last_ts_ms) {
+                last_ts_ms = ts_ms;
+                last_price = price;
+            }
+            min_price = count == 0 ? price : std::min(min_price, price);
+            max_price = count == 0 ? price : std::max(max_price, price);
+            ++count;
+            const double delta = price - mean;
+            mean += delta / static_cast<double>(count);
+            m2 += delta * (price - mean);
+            volume += qty;
+            notional += price * qty;
+            if (!is_buyer_maker) {
+                buy_volume += qty;
+            }
+        }
+    };
+
+    // `horizons_ms` must be positive multiples of `pane_ms`; pane_ms 0 picks
+    // their gcd
+    MultiHorizonWindow(std::vector<int64_t> horizons_ms, int64_t pane_ms) : horizons_ms_(std::move(horizons_ms)) {
+        if (horizons_ms_.empty()) {
+            throw std::runtime_error("MultiHorizonWindow: at least one horizon is required");
+        }
+        for (const int64_t horizon : horizons_ms_) {
+            if (horizon <= 0) {
+                throw std::runtime_error("MultiHorizonWindow: horizons must be positive");
+            }
+            if (pane_ms == 0) {
+                pane_ms_ = std::gcd(pane_ms_, horizon);
+            }
+        }
+        if (pane_ms != 0) {
+            pane_ms_ = pane_ms;
+        }
+        if (pane_ms_ <= 0) {
+            throw std::runtime_error("MultiHorizonWindow: pane must be positive");
+        }
+        int64_t longest = 0;
+        for (const int64_t horizon : horizons_ms_) {
+            if (horizon % pane_ms_ != 0) {
+                throw std::runtime_error("MultiHorizonWindow: horizons must be multiples of the pane");
+            }
+            longest = std::max(longest, horizon);
+        }
+        panes_.resize(static_cast<std::size_t>(longest / pane_ms_));
+    }
+
+    // Trades without a positive price and qty are ignored, as in TradeWindow
+    void add(int64_t ts_ms, double price, double qty, bool is_buyer_maker) {
+        if (!(price > 0) || !(qty > 0)) {
+            return;
+        }
+        const int64_t pane = floor_div(ts_ms, pane_ms_);
+        advance_to(pane);
+        if (pane <= current_ - static_cast<int64_t>(panes_.size())) {
+            ++late_drops_;
+            return;
+        }
+        Pane &slot = slot_of(pane);
+        if (slot.index != pane) {
+            slot = Pane{};
+            slot.index = pane;
+        }
+        slot.add(ts_ms, price, qty, is_buyer_maker);
+    }
+
+    // Move the horizons' end to `now_ms` without a trade, so quiet symbols
+    // age out
+    void advance(int64_t now_ms) { advance_to(floor_div(now_ms, pane_ms_)); }
+
+    // Combine the panes of horizon `h` (an index into horizons_ms()) into
+    // `summary`, for trade_features(); returns its trade count, 0 when the
+    // horizon holds no trades
+    std::size_t combine(std::size_t h, TradeSummary &summary) const {
+        const int64_t span = horizons_ms_.at(h) / pane_ms_;
+        summary = TradeSummary{};
+        if (current_ == std::numeric_limits<int64_t>::min()) {
+            return 0;
+        }
+        double m2 = 0;
+        bool first = true;
+        for (int64_t pane = current_ - span + 1; pane <= current_; ++pane) {
+            const Pane &slot = slot_of(pane);
+            if (slot.index != pane || slot.count == 0) {
+                continue;
+            }
+            if (first) {
+                summary.first_ts_ms = slot.first_ts_ms;
+                summary.first_price = slot.first_price;
+                summary.min_price = slot.min_price;
+                summary.max_price = slot.max_price;
+                first = false;
+            }
+            summary.last_ts_ms = slot.last_ts_ms;
+            summary.last_price = slot.last_price;
+            summary.min_price = std::min(summary.min_price, slot.min_price);
+            summary.max_price = std::max(summary.max_price, slot.max_price);
+            summary.volume += slot.volume;
+            summary.notional += slot.notional;
+            summary.buy_volume += slot.buy_volume;
+            // Chan et al.: merge (count, mean, M2) of two disjoint sets
+            const double na = static_cast<double>(summary.count);
+            const double nb = static_cast<double>(slot.count);
+            const double delta = slot.mean - summary.mean_price;
+            summary.count += slot.count;
+            const double n = static_cast<double>(summary.count);
+            summary.mean_price += delta * nb / n;
+            m2 += slot.m2 + delta * delta * na * nb / n;
+        }
+        summary.price_variance =
+            summary.count > 1 ? std::max(m2, 0.0) / static_cast<double>(summary.count - 1) : 0;
+        return summary.count;
+    }
+
+    const std::vector<int64_t> &horizons_ms() const { return horizons_ms_; }
+    int64_t pane_ms() const { return pane_ms_; }
+    std::size_t pane_count() const { return panes_.size(); }
+    // Trades that arrived after their pane had left the ring
+    uint64_t late_drops() const { return late_drops_; }
+
+    // The ring as stored (slot = pane index mod pane_count()) and the
+    // newest pane it has seen
+    std::span<const Pane> panes() const { return panes_; }
+    int64_t current_pane() const { return current_; }
+
+    // Replace the state with one saved from a window of the same horizons
+    // and pane. Throws std::runtime_error if the pane count differs.
+    void restore(int64_t current_pane, uint64_t late_drops, std::span<const Pane> panes) {
+        if (panes.size() != panes_.size()) {
+            throw std::runtime_error("MultiHorizonWindow: restored state has a different pane count");
+        }
+        std::copy(panes.begin(), panes.end(), panes_.begin());
+        current_ = current_pane;
+        late_drops_ = late_drops;
+    }
+
+    void clear() {
+        std::fill(panes_.begin(), panes_.end(), Pane{});
+        current_ = std::numeric_limits<int64_t>::min();
+    }
+
+private:
+    static int64_t floor_div(int64_t a, int64_t b) { return a / b - ((a % b != 0) && ((a < 0) != (b < 0))); }
+
+    Pane &slot_of(int64_t pane) { return panes_[ring_slot(pane)]; }
+    const Pane &slot_of(int64_t pane) const { return panes_[ring_slot(pane)]; }
+    std::size_t ring_slot(int64_t pane) const {
+        const auto size = static_cast<int64_t>(panes_.size());
+        return static_cast<std::size_t>(((pane % size) + size) % size);
+    }
+
+    // Stale slots are recognised by their index, so moving forward is O(1)
+    void advance_to(int64_t pane) { current_ = std::max(current_, pane); }
+
+    std::vector<int64_t> horizons_ms_;
+    int64_t pane_ms_ = 0;
+    std::vector<Pane> panes_;
+    int64_t current_ = std::numeric_limits<int64_t>::min();
+    uint64_t late_drops_ = 0;
+};
+
+#endif
@@ -0,0 +1,481 @@
+/*
+ * Asynchronous binary logging for the native components.
+ *
+ * A warning formatted on the thread that hit it costs a string build and a
+ * write() per line, and going through Python logging costs the GIL too, so
+ * a parse-error storm or a reconnect loop would stall the decode or receive
+ * thread exactly when it is already behind. native_log() instead writes a
+ * fixed LogRecord into its thread's own buffer:
+ *
+ *   format    the ID of a LogFormat, registered once per call site, that
+ *             holds the level, component and "{}"-style format string
+ *   args      up to LOG_MAX_ARGS raw integers, doubles and bools; strings
+ *             are copied, cut to what fits in the record's text bytes
+ *
+ * Each thread's buffer is an SpscRing (spsc_ring.h) it alone produces into,
+ * created on its first record; a full buffer drops the record and counts
+ * it, so logging never blocks, allocates or makes a syscall after that.
+ * A record below the configured level costs one relaxed load.
+ *
+ * The logger's writer thread drains every buffer each flush interval,
+ * formats the records in time order and writes the lines out: to stderr,
+ * or, when forwarding, into a bounded queue that the Python side drains on
+ * a ReadyNotifier wake-up and emits through its logging sinks (see
+ * forward_native_logs in utils/logging.py). Nothing is logged until start().
+ */
+
+#ifndef _SBE_NATIVE_LOG_H_
+#define _SBE_NATIVE_LOG_H_
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ingest_clock.h"
+#include "ready_notifier.h"
+#include "spsc_ring.h"
+
+// Python logging's numeric levels
+enum class LogLevel : uint8_t { Debug = 10, Info = 20, Warning = 30, Error = 40 };
+
+inline const char *log_level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::Debug:
+        return "DEBUG";
+    case LogLevel::Info:
+        return "INFO";
+    case LogLevel::Warning:
+        return "WARNING";
+    case LogLevel::Error:
+        return "ERROR";
+    }
+    return "UNKNOWN";
+}
+
+inline constexpr std::size_t LOG_MAX_ARGS = 4;
+// Bytes shared by a record's string arguments
+inline constexpr std::size_t LOG_TEXT_BYTES = 72;
+
+enum class LogArgKind : uint8_t { Int, UInt, Double, Bool, Text };
+
+union LogArgValue {
+    int64_t i;
+    uint64_t u;
+    double d;
+    // Text: where the string sits in the record's text bytes
+    struct {
+        uint32_t offset;
+        uint32_t size;
+    } text;
+};
+
+struct alignas(CACHE_LINE_SIZE) LogRecord {
+    uint64_t time_us;
+    uint32_t format;
+    uint8_t arg_count;
+    std::array<LogArgKind, LOG_MAX_ARGS> kinds;
+    uint8_t text_size;
+    std::array<LogArgValue, LOG_MAX_ARGS> args;
+    std::array<char, LOG_TEXT_BYTES> text;
+};
+
+static_assert(sizeof(LogRecord) == 2 * CACHE_LINE_SIZE);
+
+// A formatted line, as handed to the output
+struct LogLine {
+    uint64_t time_us = 0;
+    LogLevel level = LogLevel::Info;
+    const char *component = "";
+    std::string message;
+};
+
+struct NativeLoggerConfig {
+    LogLevel level = LogLevel::Warning;
+    int flush_interval_ms = 20;
+    // Records per thread buffer, for buffers created after start()
+    std::size_t thread_buffer = 1024;
+    // Queue lines for drain() instead of writing them to stderr
+    bool forward = false;
+    // Forwarded lines kept waiting; the oldest are dropped beyond it
+    std::size_t max_pending = 16384;
+};
+
+struct NativeLoggerStats {
+    uint64_t records = 0;
+    // Records dropped on a full thread buffer
+    uint64_t dropped = 0;
+    // Forwarded lines dropped on a full queue
+    uint64_t lines_dropped = 0;
+    std::size_t threads = 0;
+    std::size_t pending = 0;
+};
+
+class NativeLogger {
+public:
+    NativeLogger() = default;
+    ~NativeLogger() { stop(); }
+
+    NativeLogger(const NativeLogger &) = delete;
+    NativeLogger &operator=(const NativeLogger &) = delete;
+
+    // A call site's format; component and format must be string literals
+    // (or otherwise outlive the logger)
+    uint32_t register_format(LogLevel level, const char *component, const char *format) {
+        std::lock_guard lock(formats_mutex_);
+        formats_.push_back(Format{level, component, format});
+        return static_cast<uint32_t>(formats_.size() - 1);
+    }
+
+    // Start (or restart with a new config) the writer thread
+    void start(const NativeLoggerConfig &config) {
+        stop();
+        config_ = config;
+        thread_buffer_.store(config.thread_buffer, std::memory_order_relaxed);
+        running_ = true;
+        writer_ = std::thread([this] { run(); });
+        min_level_.store(static_cast<uint8_t>(config.level), std::memory_order_relaxed);
+    }
+
+    // Stop recording, write out what was recorded and join the writer
+    void stop() {
+        min_level_.store(LEVEL_OFF, std::memory_order_relaxed);
+        if (!writer_.joinable()) {
+            return;
+        }
+        {
+            std::lock_guard lock(wake_mutex_);
+            running_ = false;
+        }
+        wake_.notify_all();
+        writer_.join();
+    }
+
+    bool enabled(LogLevel level) const {
+        return static_cast<uint8_t>(level) >= min_level_.load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void log(LogLevel level, uint32_t format, const Args &...args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+        if (!enabled(level)) {
+            return;
+        }
+        ThreadBuffer *buffer = thread_buffer();
+        if (buffer == nullptr) {
+            return;
+        }
+        if (buffer->ring.writable() == 0) {
+            buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        LogRecord &record = buffer->ring.write_slot(0);
+        record.time_us = ingest_time_us();
+        record.format = format;
+        record.arg_count = 0;
+        record.text_size = 0;
+        (put_arg(record, args), ...);
+        buffer->ring.publish(1);
+        buffer->records.store(buffer->records.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Forwarding consumer ------------------------------------------------
+
+    // Up to `max_lines` forwarded lines, oldest first
+    std::vector<LogLine> drain(std::size_t max_lines) {
+        std::vector<LogLine> out;
+        std::lock_guard lock(pending_mutex_);
+        const std::size_t count = std::min(max_lines, pending_.size());
+        out.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            out.push_back(std::move(pending_.front()));
+            pending_.pop_front();
+        }
+        return out;
+    }
+
+    ReadyNotifier &notifier() { return notifier_; }
+
+    bool arm_notify() {
+        return notifier_.arm([this] {
+            std::lock_guard lock(pending_mutex_);
+            return !pending_.empty();
+        });
+    }
+
+    // Drain every thread buffer now, on the calling thread
+    void flush() {
+        std::lock_guard lock(flush_mutex_);
+        flush_locked();
+    }
+
+    NativeLoggerStats stats() {
+        NativeLoggerStats out;
+        {
+            std::lock_guard lock(threads_mutex_);
+            out.threads = threads_.size();
+            out.dropped = retired_dropped_;
+            out.records = retired_records_;
+            for (const auto &buffer : threads_) {
+                out.records += buffer->records.load(std::memory_order_relaxed);
+                out.dropped += buffer->dropped.load(std::memory_order_relaxed);
+            }
+        }
+        std::lock_guard lock(pending_mutex_);
+        out.pending = pending_.size();
+        out.lines_dropped = lines_dropped_;
+        return out;
+    }
+
+private:
+    static constexpr uint8_t LEVEL_OFF = UINT8_MAX;
+
+    struct Format {
+        LogLevel level;
+        const char *component;
+        const char *format;
+    };
+
+    struct ThreadBuffer {
+        explicit ThreadBuffer(std::size_t capacity) : ring(capacity) {}
+
+        SpscRing<LogRecord> ring;
+        // Written by the owning thread only
+        std::atomic<uint64_t> records{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<bool> exited{false};
+    };
+
+    // A thread's hold on its buffer; marks it exited so the writer can
+    // retire it once drained
+    struct ThreadHandle {
+        std::shared_ptr<ThreadBuffer> buffer;
+        bool failed = false;
+
+        ~ThreadHandle() {
+            if (buffer) {
+                buffer->exited.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    ThreadBuffer *thread_buffer() {
+        thread_local ThreadHandle handle;
+        if (!handle.buffer && !handle.failed) [[unlikely]] {
+            try {
+                auto buffer = std::make_shared<ThreadBuffer>(thread_buffer_.load(std::memory_order_relaxed));
+                std::lock_guard lock(threads_mutex_);
+                threads_.push_back(buffer);
+                handle.buffer = std::move(buffer);
+            } catch (const std::exception &) {
+                // No buffer (out of memory): this thread logs nothing
+                handle.failed = true;
+            }
+        }
+        return handle.buffer.get();
+    }
+
+    template <typename T>
+    static void put_arg(LogRecord &record, const T &arg) {
+        const std::size_t i = record.arg_count++;
+        if constexpr (std::is_same_v<T, bool>) {
+            record.kinds[i] = LogArgKind::Bool;
+            record.args[i].u = arg ? 1 : 0;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            record.kinds[i] = LogArgKind::Double;
+            record.args[i].d = static_cast<double>(arg);
+        } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            record.kinds[i] = LogArgKind::Int;
+            record.args[i].i = static_cast<int64_t>(arg);
+        } else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>) {
+            record.kinds[i] = LogArgKind::UInt;
+            record.args[i].u = static_cast<uint64_t>(arg);
+        } else {
+            const std::string_view text(arg);
+            const std::size_t size = std::min(text.size(), LOG_TEXT_BYTES - record.text_size);
+            std::memcpy(record.text.data() + record.text_size, text.data(), size);
+            record.kinds[i] = LogArgKind::Text;
+            record.args[i].text = {record.text_size, static_cast<uint32_t>(size)};
+            record.text_size = static_cast<uint8_t>(record.text_size + size);
+        }
+    }
+
+    static void append_arg(std::string &out, const LogRecord &record, std::size_t i) {
+        char number[32];
+        switch (record.kinds[i]) {
+        case LogArgKind::Int:
+            out.append(number, std::snprintf(number, sizeof(number), "%lld", static_cast<long long>(record.args[i].i)));
+            break;
+        case LogArgKind::UInt:
+            out.append(number,
+                       std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(record.args[i].u)));
+            break;
+        case LogArgKind::Double:
+            out.append(number, std::snprintf(number, sizeof(number), "%g", record.args[i].d));
+            break;
+        case LogArgKind::Bool:
+            out += record.args[i].u ? "true" : "false";
+            break;
+        case LogArgKind::Text:
+            out.append(record.text.data() + record.args[i].text.offset, record.args[i].text.size);
+            break;
+        }
+    }
+
+    // "{}" takes the next argument; one without an argument stays as it is
+    static std::string format_record(const char *format, const LogRecord &record) {
+        std::string out;
+        std::size_t next = 0;
+        for (const char *p = format; *p != '\0'; ++p) {
+            if (p[0] == '{' && p[1] == '}' && next < record.arg_count) {
+                append_arg(out, record, next++);
+                ++p;
+            } else {
+                out += *p;
+            }
+        }
+        return out;
+    }
+
+    void run() {
+        std::unique_lock lock(wake_mutex_);
+        while (running_) {
+            wake_.wait_for(lock, std::chrono::milliseconds(config_.flush_interval_ms), [this] { return !running_; });
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    void flush_locked() {
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        {
+            std::lock_guard lock(threads_mutex_);
+            buffers = threads_;
+        }
+        std::vector<Format> formats;
+        {
+            std::lock_guard lock(formats_mutex_);
+            formats = formats_;
+        }
+        lines_.clear();
+        for (const auto &buffer : buffers) {
+            // Read before draining, so a buffer seen exited is also seen empty
+            const bool exited = buffer->exited.load(std::memory_order_acquire);
+            const std::size_t count = buffer->ring.readable();
+            for (std::size_t i = 0; i < count; ++i) {
+                const LogRecord &record = buffer->ring.read_slot(i);
+                if (record.format < formats.size()) {
+                    const Format &format = formats[record.format];
+                    lines_.push_back(
+                        LogLine{record.time_us, format.level, format.component, format_record(format.format, record)});
+                }
+            }
+            buffer->ring.release(count);
+            if (exited) {
+                retire(buffer);
+            }
+        }
+        if (lines_.empty()) {
+            return;
+        }
+        std::stable_sort(lines_.begin(), lines_.end(),
+                         [](const LogLine &a, const LogLine &b) { return a.time_us < b.time_us; });
+        if (config_.forward) {
+            {
+                std::lock_guard lock(pending_mutex_);
+                for (LogLine &line : lines_) {
+                    pending_.push_back(std::move(line));
+                }
+                while (pending_.size() > config_.max_pending) {
+                    pending_.pop_front();
+                    ++lines_dropped_;
+                }
+            }
+            notifier_.notify();
+        } else {
+            std::string out;
+            for (const LogLine &line : lines_) {
+                out += std::to_string(line.time_us) + " [" + log_level_name(line.level) + "] native." + line.component +
+                       ": " + line.message + "\n";
+            }
+            [[maybe_unused]] const ssize_t written = ::write(STDERR_FILENO, out.data(), out.size());
+        }
+    }
+
+    void retire(const std::shared_ptr<ThreadBuffer> &buffer) {
+        std::lock_guard lock(threads_mutex_);
+        retired_records_ += buffer->records.load(std::memory_order_relaxed);
+        retired_dropped_ += buffer->dropped.load(std::memory_order_relaxed);
+        threads_.erase(std::remove(threads_.begin(), threads_.end(), buffer), threads_.end());
+    }
+
+    std::atomic<uint8_t> min_level_{LEVEL_OFF};
+    std::atomic<std::size_t> thread_buffer_{1024};
+
+    std::mutex formats_mutex_;
+    std::vector<Format> formats_;
+
+    // Only changed while the writer is stopped
+    NativeLoggerConfig config_;
+
+    std::mutex threads_mutex_;
+    std::vector<std::shared_ptr<ThreadBuffer>> threads_;
+    uint64_t retired_records_ = 0;
+    uint64_t retired_dropped_ = 0;
+
+    // Serializes flushes (the writer's, and flush() callers')
+    std::mutex flush_mutex_;
+    std::vector<LogLine> lines_;
+
+    std::mutex pending_mutex_;
+    std::deque<LogLine> pending_;
+    uint64_t lines_dropped_ = 0;
+    ReadyNotifier notifier_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool running_ = false;
+    std::thread writer_;
+};
+
+inline NativeLogger &native_logger() {
+    static NativeLogger logger;
+    return logger;
+}
+
+// A log call site: its level, component and format, registered once
+class LogFormat {
+public:
+    LogFormat(LogLevel level, const char *component, const char *format)
+        : level_(level), id_(native_logger().register_format(level, component, format)) {}
+
+    LogLevel level() const { return level_; }
+    uint32_t id() const { return id_; }
+
+private:
+    const LogLevel level_;
+    const uint32_t id_;
+};
+
+template <typename... Args>
+inline void native_log(const LogFormat &format, const Args &...args) {
+    native_logger().log(format.level(), format.id(), args...);
+}
+
+#endif
@@ -0,0 +1,419 @@
+/*
+ * Prometheus exposition of the native pipeline's counters.
+ *
+ * Native components (decoders, receivers, decoder pools) register a metrics
+ * source with the process-wide MetricsRegistry for their lifetime. A source
+ * only reads relaxed atomics its component already maintains, so it can run
+ * on any thread: MetricsServer answers GET /metrics from its own thread,
+ * never takes the GIL and never makes a hot path wait. Sources are
+ * serialized against registration by the registry mutex, which components
+ * take only when they are created and destroyed.
+ *
+ * Counters written by several threads at once use ShardedCounter, one
+ * cache-line-padded slot per thread, so increments never bounce a shared
+ * line between cores; a scrape sums the slots.
+ */
+
+#ifndef _SBE_NATIVE_METRICS_H_
+#define _SBE_NATIVE_METRICS_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// ---------------------------------------------------------------------------
+// Counters
+// ---------------------------------------------------------------------------
+
+class ShardedCounter {
+public:
+    static constexpr std::size_t SHARDS = 16;
+
+    void add(uint64_t n = 1) { shards_[thread_shard()].value.fetch_add(n, std::memory_order_relaxed); }
+
+    uint64_t value() const {
+        uint64_t total = 0;
+        for (const auto &shard : shards_) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+private:
+    // Threads are dealt shards round-robin as they first count anything
+    static std::size_t thread_shard() {
+        static std::atomic<std::size_t> next{0};
+        thread_local const std::size_t shard = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return shard;
+    }
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard, SHARDS> shards_{};
+};
+
+// ---------------------------------------------------------------------------
+// Text exposition
+// ---------------------------------------------------------------------------
+
+enum class MetricType : uint8_t {
+    Counter,
+    Gauge,
+    Summary,
+};
+
+using MetricLabels = std::initializer_list<std::pair<std::string_view, std::string_view>>;
+
+// Collects samples from every source and renders them grouped by family, as
+// the text format requires when several sources export the same metric
+class MetricsWriter {
+public:
+    void sample(std::string_view family, MetricType type, std::string_view help, MetricLabels labels, uint64_t value) {
+        char buf[24];
+        const auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+        line(family, type, help, {}, labels, std::string_view(buf, static_cast<std::size_t>(end - buf)));
+    }
+
+    void sample(std::string_view family, MetricType type, std::string_view help, MetricLabels labels, double value) {
+        line(family, type, help, {}, labels, format_double(value));
+    }
+
+    // A summary's quantile samples plus its _sum and _count
+    void summary(std::string_view family, std::string_view help, MetricLabels labels,
+                 std::initializer_list<std::pair<std::string_view, double>> quantiles, double sum, uint64_t count) {
+        for (const auto &[quantile, value] : quantiles) {
+            std::vector<std::pair<std::string_view, std::string_view>> with_quantile(labels);
+            with_quantile.emplace_back("quantile", quantile);
+            entry(family, MetricType::Summary, help).lines +=
+                render_line(family, {}, with_quantile, format_double(value));
+        }
+        line(family, MetricType::Summary, help, "_sum", labels, format_double(sum));
+        line(family, MetricType::Summary, help, "_count", labels, std::to_string(count));
+    }
+
+    std::string render() const {
+        std::string out;
+        for (const auto &family : families_) {
+            out += "# HELP ";
+            out += family.name;
+            out += ' ';
+            out += family.help;
+            out += "\n# TYPE ";
+            out += family.name;
+            out += ' ';
+            out += type_name(family.type);
+            out += '\n';
+            out += family.lines;
+        }
+        return out;
+    }
+
+private:
+    struct Family {
+        std::string name;
+        std::string help;
+        MetricType type;
+        std::string lines;
+    };
+
+    static const char *type_name(MetricType type) {
+        switch (type) {
+        case MetricType::Counter:
+            return "counter";
+        case MetricType::Gauge:
+            return "gauge";
+        case MetricType::Summary:
+            return "summary";
+        }
+        return "untyped";
+    }
+
+    static std::string format_double(double value) {
+        char buf[32];
+        const auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+        return std::string(buf, end);
+    }
+
+    template <typename Labels>
+    static std::string render_line(std::string_view family, std::string_view suffix, const Labels &labels,
+                                   std::string_view value) {
+        std::string out(family);
+        out += suffix;
+        if (labels.size() > 0) {
+            out += '{';
+            bool first = true;
+            for (const auto &[name, label_value] : labels) {
+                if (!first) {
+                    out += ',';
+                }
+                first = false;
+                out += name;
+                out += "=\"";
+                for (const char c : label_value) {
+                    if (c == '\\' || c == '"') {
+                        out += '\\';
+                        out += c;
+                    } else if (c == '\n') {
+                        out += "\\n";
+                    } else {
+                        out += c;
+                    }
+                }
+                out += '"';
+            }
+            out += '}';
+        }
+        out += ' ';
+        out += value;
+        out += '\n';
+        return out;
+    }
+
+    void line(std::string_view family, MetricType type, std::string_view help, std::string_view suffix,
+              MetricLabels labels, std::string_view value) {
+        entry(family, type, help).lines += render_line(family, suffix, labels, value);
+    }
+
+    Family &entry(std::string_view family, MetricType type, std::string_view help) {
+        const auto it = index_.find(std::string(family));
+        if (it != index_.end()) {
+            return families_[it->second];
+        }
+        index_.emplace(std::string(family), families_.size());
+        families_.push_back(Family{std::string(family), std::string(help), type, {}});
+        return families_.back();
+    }
+
+    std::vector<Family> families_;
+    std::unordered_map<std::string, std::size_t> index_;
+};
+
+// ---------------------------------------------------------------------------
+// Registry
+// ---------------------------------------------------------------------------
+
+using MetricsSource = std::function<void(MetricsWriter &)>;
+
+class MetricsRegistry {
+public:
+    uint64_t reserve_id() { return next_id_.fetch_add(1, std::memory_order_relaxed); }
+
+    void add(uint64_t id, MetricsSource source) {
+        std::lock_guard lock(mutex_);
+        sources_.emplace(id, std::move(source));
+    }
+
+    // Waits for a scrape in progress, so `id`'s source never outlives it
+    void remove(uint64_t id) {
+        std::lock_guard lock(mutex_);
+        sources_.erase(id);
+    }
+
+    std::string render() {
+        MetricsWriter out;
+        {
+            std::lock_guard lock(mutex_);
+            for (const auto &[id, source] : sources_) {
+                source(out);
+            }
+        }
+        return out.render();
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<uint64_t, MetricsSource> sources_;
+    std::atomic<uint64_t> next_id_{0};
+};
+
+inline MetricsRegistry &metrics_registry() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+// A component's registry entry. The owner calls publish() once it is fully
+// constructed and declares this as its last member, so the source is
+// unregistered before anything it reads is destroyed. instance() is unique
+// per registration, for use as a label value.
+class MetricsRegistration {
+public:
+    MetricsRegistration() : id_(metrics_registry().reserve_id()), instance_(std::to_string(id_)) {}
+
+    ~MetricsRegistration() {
+        if (published_) {
+            metrics_registry().remove(id_);
+        }
+    }
+
+    MetricsRegistration(const MetricsRegistration &) = delete;
+    MetricsRegistration &operator=(const MetricsRegistration &) = delete;
+
+    void publish(MetricsSource source) {
+        metrics_registry().add(id_, std::move(source));
+        published_ = true;
+    }
+
+    const std::string &instance() const { return instance_; }
+
+private:
+    const uint64_t id_;
+    const std::string instance_;
+    bool published_ = false;
+};
+
+// ---------------------------------------------------------------------------
+// HTTP exporter
+// ---------------------------------------------------------------------------
+
+// Serves the registry as Prometheus text on GET /metrics (any other path is
+// a 404), one request per connection, from a single background thread
+class MetricsServer {
+public:
+    MetricsServer(std::string host, uint16_t port) : host_(std::move(host)), port_(port) {}
+
+    ~MetricsServer() { stop(); }
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    // Bind and start serving; port 0 picks a free port (see port())
+    void start() {
+        if (running_.load()) {
+            return;
+        }
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            throw std::runtime_error(std::string("metrics socket: ") + std::strerror(errno));
+        }
+        const int one = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port_);
+        if (::inet_pton(AF_INET, host_.empty() ? "0.0.0.0" : host_.c_str(), &addr.sin_addr) != 1) {
+            close_listener();
+            throw std::runtime_error("metrics host must be an IPv4 address: " + host_);
+        }
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, 16) != 0) {
+            const std::string error = std::strerror(errno);
+            close_listener();
+            throw std::runtime_error("metrics bind " + host_ + ":" + std::to_string(port_) + ": " + error);
+        }
+        socklen_t len = sizeof(addr);
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+
+        running_.store(true);
+        worker_ = std::thread([this] { serve(); });
+    }
+
+    void stop() {
+        running_.store(false);
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+        close_listener();
+    }
+
+    bool running() const { return running_.load(); }
+    uint16_t port() const { return port_; }
+    const std::string &host() const { return host_; }
+    uint64_t scrapes() const { return scrapes_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int POLL_INTERVAL_MS = 200;
+    static constexpr int CLIENT_TIMEOUT_MS = 1000;
+    static constexpr std::size_t MAX_REQUEST = 8192;
+
+    void close_listener() {
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+            listen_fd_ = -1;
+        }
+    }
+
+    void serve() {
+        while (running_.load()) {
+            pollfd pfd{listen_fd_, POLLIN, 0};
+            if (::poll(&pfd, 1, POLL_INTERVAL_MS) <= 0) {
+                continue;
+            }
+            const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            handle(fd);
+            ::close(fd);
+        }
+    }
+
+    void handle(int fd) {
+        std::string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST) {
+            pollfd pfd{fd, POLLIN, 0};
+            if (::poll(&pfd, 1, CLIENT_TIMEOUT_MS) <= 0) {
+                return;
+            }
+            const ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                return;
+            }
+            request.append(buf, static_cast<std::size_t>(n));
+        }
+
+        const std::string_view line(request.data(), std::min(request.find("\r\n"), request.size()));
+        std::string status = "404 Not Found";
+        std::string body = "not found\n";
+        std::string content_type = "text/plain";
+        if (line.starts_with("GET /metrics ") || line.starts_with("GET /metrics?")) {
+            status = "200 OK";
+            body = metrics_registry().render();
+            content_type = "text/plain; version=0.0.4; charset=utf-8";
+            scrapes_.fetch_add(1, std::memory_order_relaxed);
+        }
+        const std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: " + content_type +
+                                     "\r\nContent-Length: " + std::to_string(body.size()) +
+                                     "\r\nConnection: close\r\n\r\n" + body;
+        std::size_t sent = 0;
+        while (sent < response.size()) {
+            const ssize_t n = ::send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            sent += static_cast<std::size_t>(n);
+        }
+    }
+
+    const std::string host_;
+    uint16_t port_;
+    int listen_fd_ = -1;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> scrapes_{0};
+    std::thread worker_;
+};
+
+#endif
@@ -0,0 +1,400 @@
+/*
+ * Bronze JSONL archive files straight into typed columns.
+ *
+ * S3Reader used to json.loads an object line by line into dicts. The
+ * NdjsonParser takes the whole (decompressed) object instead, splits it at
+ * newlines into one chunk per thread, and scans each line with the record
+ * scanner from record_ingest.h into the columns of a ParquetColumnSpec list,
+ * so the JSONL and Parquet archives of a data type share one schema
+ * (S3BronzeWriter's *_COLUMNS). Chunks are concatenated in file order.
+ *
+ * Values convert the way the Python transformer did: numbers or numeric
+ * strings for int64/float64 (timestamps are int64 milliseconds), truthiness
+ * for bool, string contents taken raw. A missing or unconvertible value is
+ * 0, NaN, false or "" and flagged in the column's `absent` mask (so
+ * callers can still tell a missing field from a zero); a line that is not
+ * one JSON object is skipped and counted in `bad_lines`.
+ *
+ * A schema with a `side` column is a depth level schema: each record's
+ * `bids` and `asks` ([price, qty] pairs) expand into one row per level with
+ * side "bid"/"ask", its `level` index and `price`/`qty`, the other columns
+ * repeated from the record - the layout of the Parquet depth archive.
+ */
+
+#ifndef _SBE_NDJSON_COLUMNS_H_
+#define _SBE_NDJSON_COLUMNS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "parquet_writer.h"
+#include "record_ingest.h"
+
+// Chunks below this size are not worth a thread
+constexpr std::size_t NDJSON_MIN_CHUNK = 256 * 1024;
+
+struct NdjsonColumn {
+    ParquetType type = ParquetType::INT64;
+    std::vector<int64_t> ints;  // INT64, TIMESTAMP_MS
+    std::vector<double> doubles;
+    std::vector<uint8_t> flags;
+    std::vector<char> bytes;  // STRING: contents back to back, split by offsets
+    std::vector<int64_t> offsets{0};
+    std::vector<uint8_t> absent;  // per row, 1 where the value was missing
+    uint64_t missing = 0;
+
+    std::string_view string(std::size_t row) const {
+        return {bytes.data() + offsets[row], static_cast<std::size_t>(offsets[row + 1] - offsets[row])};
+    }
+};
+
+struct NdjsonTable {
+    std::vector<NdjsonColumn> columns;
+    std::size_t rows = 0;
+    uint64_t lines = 0;
+    uint64_t bad_lines = 0;
+};
+
+namespace ndjson_detail {
+
+using ingest_detail::JsonKind;
+using ingest_detail::JsonValue;
+
+constexpr std::size_t NO_COLUMN = std::numeric_limits<std::size_t>::max();
+
+inline bool is_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+// fn(price, qty) for each [price, qty] pair of a level array; throws
+// std::runtime_error on anything else
+template <typename Fn>
+void scan_level_pairs(std::string_view text, Fn &&fn) {
+    const char *at = text.data();
+    const char *const end = text.data() + text.size();
+    const auto space = [&] {
+        while (at != end && is_space(*at)) {
+            ++at;
+        }
+    };
+    const auto expect = [&](char c) {
+        space();
+        if (at == end || *at != c) {
+            throw std::runtime_error("json: malformed level array");
+        }
+        ++at;
+    };
+    const auto scalar = [&]() -> JsonValue {
+        space();
+        if (at != end && *at == '"') {
+            const char *start = ++at;
+            while (at < end && *at != '"') {
+                at += *at == '\\' ? 2 : 1;
+            }
+            if (at >= end) {
+                throw std::runtime_error("json: malformed level array");
+            }
+            return {true, JsonKind::String, std::string_view(start, static_cast<std::size_t>(at++ - start))};
+        }
+        const char *start = at;
+        while (at != end && *at != ',' && *at != ']' && !is_space(*at)) {
+            ++at;
+        }
+        return {true, JsonKind::Number, std::string_view(start, static_cast<std::size_t>(at - start))};
+    };
+
+    expect('[');
+    space();
+    if (at != end && *at == ']') {
+        return;
+    }
+    while (true) {
+        expect('[');
+        const JsonValue price = scalar();
+        expect(',');
+        const JsonValue qty = scalar();
+        // Binance pads levels with nothing, but tolerate extra members
+        space();
+        while (at != end && *at == ',') {
+            ++at;
+            scalar();
+            space();
+        }
+        expect(']');
+        fn(price, qty);
+        space();
+        if (at != end && *at == ',') {
+            ++at;
+            continue;
+        }
+        expect(']');
+        return;
+    }
+}
+
+inline void append_string(NdjsonColumn &column, std::string_view text) {
+    column.bytes.insert(column.bytes.end(), text.begin(), text.end());
+    column.offsets.push_back(static_cast<int64_t>(column.bytes.size()));
+}
+
+inline void append_value(NdjsonColumn &column, const JsonValue &value) {
+    const bool present = value.present && value.kind != JsonKind::Null;
+    const uint64_t missing = column.missing;
+    switch (column.type) {
+    case ParquetType::INT64:
+    case ParquetType::TIMESTAMP_MS: {
+        int64_t number = 0;
+        if (!present || !ingest_detail::json_int64(value, number)) {
+            number = 0;
+            ++column.missing;
+        }
+        column.ints.push_back(number);
+        break;
+    }
+    case ParquetType::FLOAT64: {
+        double number = 0;
+        if (!present || !ingest_detail::json_double(value, number)) {
+            number = std::numeric_limits<double>::quiet_NaN();
+            ++column.missing;
+        }
+        column.doubles.push_back(number);
+        break;
+    }
+    case ParquetType::BOOL:
+        column.missing += present ? 0 : 1;
+        column.flags.push_back(present && ingest_detail::json_truthy(value) ? 1 : 0);
+        break;
+    case ParquetType::STRING:
+        if (present && (value.kind == JsonKind::String || value.kind == JsonKind::Number)) {
+            append_string(column, value.text);
+        } else {
+            ++column.missing;
+            append_string(column, {});
+        }
+        break;
+    }
+    column.absent.push_back(column.missing != missing ? 1 : 0);
+}
+
+// Append `src` to `dst`, both of the same schema
+inline void append_table(NdjsonTable &dst, NdjsonTable &&src) {
+    for (std::size_t i = 0; i < dst.columns.size(); ++i) {
+        NdjsonColumn &to = dst.columns[i];
+        NdjsonColumn &from = src.columns[i];
+        to.ints.insert(to.ints.end(), from.ints.begin(), from.ints.end());
+        to.doubles.insert(to.doubles.end(), from.doubles.begin(), from.doubles.end());
+        to.flags.insert(to.flags.end(), from.flags.begin(), from.flags.end());
+        to.absent.insert(to.absent.end(), from.absent.begin(), from.absent.end());
+        const auto base = static_cast<int64_t>(to.bytes.size());
+        to.bytes.insert(to.bytes.end(), from.bytes.begin(), from.bytes.end());
+        for (std::size_t row = 1; row < from.offsets.size(); ++row) {
+            to.offsets.push_back(base + from.offsets[row]);
+        }
+        to.missing += from.missing;
+    }
+    dst.rows += src.rows;
+    dst.lines += src.lines;
+    dst.bad_lines += src.bad_lines;
+}
+
+} // namespace ndjson_detail
+
+class NdjsonParser {
+public:
+    explicit NdjsonParser(std::vector<ParquetColumnSpec> columns) : specs_(std::move(columns)) {
+        using ndjson_detail::NO_COLUMN;
+        if (specs_.empty()) {
+            throw std::runtime_error("NdjsonParser: no columns");
+        }
+        for (std::size_t i = 0; i < specs_.size(); ++i) {
+            const std::string &name = specs_[i].name;
+            std::size_t *slot = name == "side"    ? &side_
+                                : name == "level" ? &level_
+                                : name == "price" ? &price_
+                                : name == "qty"   ? &qty_
+                                                  : nullptr;
+            if (slot != nullptr) {
+                *slot = i;
+            }
+        }
+        if (side_ != NO_COLUMN) {
+            const auto typed = [&](std::size_t column, ParquetType type) {
+                return column != NO_COLUMN && specs_[column].type == type;
+            };
+            if (specs_[side_].type != ParquetType::STRING || !typed(level_, ParquetType::INT64) ||
+                !typed(price_, ParquetType::FLOAT64) || !typed(qty_, ParquetType::FLOAT64)) {
+                throw std::runtime_error(
+                    "NdjsonParser: a side column needs level (int64), price and qty (float64) columns");
+            }
+        }
+    }
+
+    const std::vector<ParquetColumnSpec> &columns() const { return specs_; }
+    bool depth_levels() const { return side_ != ndjson_detail::NO_COLUMN; }
+
+    // Parse `data` on up to `threads` threads (0 = one per core)
+    NdjsonTable parse(std::span<const char> data, unsigned threads = 0) const {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        const std::size_t chunk_count =
+            std::max<std::size_t>(1, std::min<std::size_t>(threads, data.size() / NDJSON_MIN_CHUNK));
+
+        // Chunk boundaries, each just past a newline
+        std::vector<std::size_t> bounds{0};
+        for (std::size_t i = 1; i < chunk_count; ++i) {
+            std::size_t at = std::max(bounds.back(), data.size() * i / chunk_count);
+            const void *newline = at < data.size() ? std::memchr(data.data() + at, '\n', data.size() - at) : nullptr;
+            at = newline != nullptr ? static_cast<std::size_t>(static_cast<const char *>(newline) - data.data()) + 1
+                                    : data.size();
+            bounds.push_back(at);
+        }
+        bounds.push_back(data.size());
+
+        std::vector<NdjsonTable> parts(bounds.size() - 1);
+        if (parts.size() == 1) {
+            parts[0] = parse_chunk(data);
+        } else {
+            std::vector<std::exception_ptr> errors(parts.size());
+            std::vector<std::thread> workers;
+            workers.reserve(parts.size());
+            for (std::size_t i = 0; i < parts.size(); ++i) {
+                workers.emplace_back([&, i] {
+                    try {
+                        parts[i] = parse_chunk(data.subspan(bounds[i], bounds[i + 1] - bounds[i]));
+                    } catch (...) {
+                        errors[i] = std::current_exception();
+                    }
+                });
+            }
+            for (auto &worker : workers) {
+                worker.join();
+            }
+            for (const auto &error : errors) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+
+        NdjsonTable table = std::move(parts[0]);
+        for (std::size_t i = 1; i < parts.size(); ++i) {
+            ndjson_detail::append_table(table, std::move(parts[i]));
+        }
+        return table;
+    }
+
+private:
+    NdjsonTable empty_table() const {
+        NdjsonTable table;
+        table.columns.resize(specs_.size());
+        for (std::size_t i = 0; i < specs_.size(); ++i) {
+            table.columns[i].type = specs_[i].type;
+        }
+        return table;
+    }
+
+    NdjsonTable parse_chunk(std::span<const char> data) const {
+        using namespace ndjson_detail;
+        NdjsonTable table = empty_table();
+        std::vector<JsonValue> values(specs_.size());
+        JsonValue bids, asks;
+
+        const char *at = data.data();
+        const char *const end = data.data() + data.size();
+        while (at != end) {
+            const char *newline = static_cast<const char *>(std::memchr(at, '\n', static_cast<std::size_t>(end - at)));
+            const char *line_end = newline != nullptr ? newline : end;
+            const char *line_start = at;
+            at = newline != nullptr ? newline + 1 : end;
+            while (line_start != line_end && is_space(*line_start)) {
+                ++line_start;
+            }
+            if (line_start == line_end) {
+                continue;
+            }
+            ++table.lines;
+
+            std::fill(values.begin(), values.end(), JsonValue{});
+            bids = asks = JsonValue{};
+            try {
+                ingest_detail::scan_json_object(
+                    std::span<const char>(line_start, static_cast<std::size_t>(line_end - line_start)),
+                    [&](std::string_view key, const JsonValue &value) {
+                        if (depth_levels() && (key == "bids" || key == "asks")) {
+                            (key == "bids" ? bids : asks) = value;
+                            return;
+                        }
+                        for (std::size_t i = 0; i < specs_.size(); ++i) {
+                            if (specs_[i].name == key) {
+                                values[i] = value;
+                                break;
+                            }
+                        }
+                    });
+                if (depth_levels()) {
+                    // Validate both sides before any row is written
+                    for (const JsonValue *side : {&bids, &asks}) {
+                        if (side->present && side->kind == JsonKind::Compound) {
+                            scan_level_pairs(side->text, [](const JsonValue &, const JsonValue &) {});
+                        }
+                    }
+                }
+            } catch (const std::runtime_error &) {
+                ++table.bad_lines;
+                continue;
+            }
+
+            if (!depth_levels()) {
+                for (std::size_t i = 0; i < specs_.size(); ++i) {
+                    append_value(table.columns[i], values[i]);
+                }
+                ++table.rows;
+                continue;
+            }
+            for (const bool is_bid : {true, false}) {
+                const JsonValue &side = is_bid ? bids : asks;
+                if (!side.present || side.kind != JsonKind::Compound) {
+                    continue;
+                }
+                int64_t level = 0;
+                scan_level_pairs(side.text, [&](const JsonValue &price, const JsonValue &qty) {
+                    for (std::size_t i = 0; i < specs_.size(); ++i) {
+                        NdjsonColumn &column = table.columns[i];
+                        if (i == side_) {
+                            append_string(column, is_bid ? "bid" : "ask");
+                            column.absent.push_back(0);
+                        } else if (i == level_) {
+                            column.ints.push_back(level);
+                            column.absent.push_back(0);
+                        } else if (i == price_) {
+                            append_value(column, price);
+                        } else if (i == qty_) {
+                            append_value(column, qty);
+                        } else {
+                            append_value(column, values[i]);
+                        }
+                    }
+                    ++level;
+                    ++table.rows;
+                });
+            }
+        }
+        return table;
+    }
+
+    std::vector<ParquetColumnSpec> specs_;
+    std::size_t side_ = ndjson_detail::NO_COLUMN;
+    std::size_t level_ = ndjson_detail::NO_COLUMN;
+    std::size_t price_ = ndjson_detail::NO_COLUMN;
+    std::size_t qty_ = ndjson_detail::NO_COLUMN;
+};
+
+#endif
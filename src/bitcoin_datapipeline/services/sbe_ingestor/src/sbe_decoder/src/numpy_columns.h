@@ -0,0 +1,32 @@
+/*
+ * Hand C++ column vectors to NumPy without copying.
+ *
+ * The vector is moved to the heap and owned by a capsule that becomes the
+ * array's base object, so the array data stays valid until NumPy drops it.
+ */
+
+#ifndef _SBE_NUMPY_COLUMNS_H_
+#define _SBE_NUMPY_COLUMNS_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <utility>
+#include <vector>
+
+namespace py = pybind11;
+
+template <typename T>
+py::array column_to_numpy(std::vector<T>&& column, const py::dtype& dtype) {
+    auto* owned = new std::vector<T>(std::move(column));
+    py::capsule base(owned, [](void* p) { delete static_cast<std::vector<T>*>(p); });
+    const auto size = static_cast<py::ssize_t>(owned->size());
+    return py::array(dtype, {size}, {static_cast<py::ssize_t>(sizeof(T))}, owned->data(), base);
+}
+
+template <typename T>
+py::array column_to_numpy(std::vector<T>&& column) {
+    return column_to_numpy(std::move(column), py::dtype::of<T>());
+}
+
+#endif
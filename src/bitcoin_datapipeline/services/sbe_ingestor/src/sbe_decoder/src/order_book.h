@@ -0,0 +1,753 @@
+/*
+ * Native L2 order book fed by depth diffs (template 10003).
+ *
+ * Each side is a flat array of (price, qty) mantissa pairs sorted so the
+ * best price sits at the back: bids ascending, asks descending. Updates at
+ * or near the touch, by far the most common, shift only a few elements,
+ * and top-N reads walk the tail in O(N) without touching the rest of the
+ * book. Prices are integer mantissas at the book's price exponent, so level
+ * lookup is integer comparison only.
+ *
+ * Given the symbol's price grid (PRICE_FILTER tickSize, set_tick), each side
+ * also indexes the BOOK_WINDOW_TICKS ticks nearest the touch directly: a
+ * level there is a quantity in a dense array at its distance in ticks, so
+ * an update is one indexed store and the flat array only holds the levels
+ * further out. The window follows the touch as it moves. A price off the
+ * grid (a stale tick size) drops the side back to the flat array alone.
+ *
+ * A diff that skips update IDs leaves the book waiting for a resync, which
+ * a REST snapshot (load_snapshot, or load_depth_response in depth_snapshot.h
+ * straight from a template 200 frame) or a partial depth frame (template 10002,
+ * apply_partial_depth) provides; the partial frame's top-N levels are
+ * copied from the wire straight into the side arrays.
+ *
+ * Every applied update also refreshes the book's BookFeatureVector
+ * (book_features.h), so features() is always current and costs a read.
+ * With track_order_flow(), it also adds to the book's order-flow
+ * imbalance and liquidity sums (order_flow.h), which take_order_flow()
+ * reads and resets.
+ *
+ * Every change to the levels also bumps the book's epoch. Readers that
+ * want whole arrays of levels rather than one level at a time take a
+ * levels_snapshot(): the top N rows of a side, best first, laid out
+ * contiguously once per epoch and shared, immutable, by every reader of
+ * that epoch, so a reader can hold one while the book moves on and
+ * repeated reads between updates copy nothing.
+ *
+ * Each side also keeps a running checksum of its levels (book_checksum.h),
+ * updated with every level set, so checksum() compares a whole book with a
+ * snapshot's checksum (depth_snapshot_checksum in depth_snapshot.h) in
+ * O(1); a checksum to a depth the side goes beyond walks that many levels.
+ */
+
+#ifndef _SBE_ORDER_BOOK_H_
+#define _SBE_ORDER_BOOK_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "book_checksum.h"
+#include "book_features.h"
+#include "memory_accounting.h"
+#include "order_flow.h"
+#include "stream_decode.h"
+#include "symbol_table.h"
+
+struct BookLevel {
+    int64_t price = 0;
+    int64_t qty = 0;
+};
+
+// Ticks each side of a gridded book indexes directly (8 bytes per tick)
+constexpr std::size_t BOOK_WINDOW_TICKS = 1024;
+
+// A symbol's price tick: PRICE_FILTER tickSize as a mantissa at `exponent`
+// (SymbolRules::tick_size and price_exponent); tick 0 is no grid
+struct PriceGrid {
+    int64_t tick = 0;
+    int8_t exponent = 0;
+};
+
+enum class BookSide : uint8_t {
+    Bid,
+    Ask,
+};
+
+// Outcome of applying one diff, following Binance's update-ID rules
+enum class ApplyStatus : uint8_t {
+    Applied, // diff continued the sequence (or seeded an empty book)
+    Stale,   // final_update_id <= last applied ID, nothing changed
+    Gap,     // first_update_id skipped past last applied ID + 1, book needs a resync
+    Buffered, // held by a BookSync until its snapshot arrives (book_sync.h)
+};
+
+class BookSideLevels {
+public:
+    explicit BookSideLevels(BookSide side) : side_(side) {}
+
+    // Set the quantity at `price`; zero removes the level. Returns the
+    // quantity the level had (0 if none).
+    int64_t set(int64_t price, int64_t qty) {
+        const int64_t old = set_level(price, qty);
+        if (old != qty) {
+            checksum_ += hash_of(price, qty) - hash_of(price, old);
+        }
+        return old;
+    }
+
+    std::size_t size() const { return window_levels_ + levels_.size(); }
+    bool empty() const { return size() == 0; }
+    BookSide side() const { return side_; }
+
+    // Checksum of the best `depth` levels (book_checksum.h); 0 for all of
+    // them, which is a read, as is any depth the side does not go beyond
+    uint64_t checksum(std::size_t depth = 0) const {
+        if (depth == 0 || depth >= size()) {
+            return checksum_;
+        }
+        uint64_t sum = 0;
+        for_each_top(depth, [&](const BookLevel &level) { sum += hash_of(level.price, level.qty); });
+        return sum;
+    }
+
+    // Exponents of the mantissas the side holds, for its checksum
+    void set_exponents(int8_t price_exponent, int8_t qty_exponent) {
+        hasher_ = LevelHasher(price_exponent, qty_exponent);
+        rehash();
+    }
+
+    // Bytes of the levels held, in the flat array and the window's slots
+    MemoryUsage memory_usage() const {
+        MemoryUsage usage = memory_of<BookLevel>(levels_.size(), levels_.capacity());
+        usage += memory_of<int64_t>(window_levels_, window_.capacity());
+        return usage;
+    }
+
+    // i-th level counted from the touch (0 is the best price); O(i)
+    BookLevel level(std::size_t i) const {
+        BookLevel found;
+        for_each_top(i + 1, [&](const BookLevel &level) { found = level; });
+        return found;
+    }
+
+    BookLevel best() const {
+        return window_levels_ > 0 ? BookLevel{window_price(window_best_), window_[window_best_]} : levels_.back();
+    }
+
+    // Visit up to n levels starting at the touch
+    template <typename Fn>
+    void for_each_top(std::size_t n, Fn &&fn) const {
+        std::size_t visited = 0;
+        if (window_levels_ > 0) {
+            std::size_t left = window_levels_;
+            for (std::size_t i = window_best_; left > 0 && visited < n; ++i) {
+                if (window_[i] != 0) {
+                    fn(BookLevel{window_price(i), window_[i]});
+                    --left;
+                    ++visited;
+                }
+            }
+        }
+        const std::size_t count = std::min(n - visited, levels_.size());
+        for (std::size_t i = 0; i < count; ++i) {
+            fn(levels_[levels_.size() - 1 - i]);
+        }
+    }
+
+    void clear() {
+        levels_.clear();
+        clear_window();
+        checksum_ = 0;
+    }
+
+    void reserve(std::size_t n) { levels_.reserve(n); }
+
+    // Index the `window_ticks` ticks nearest the touch directly, for prices
+    // on a grid of `tick` (a mantissa at the book's price exponent); 0 keeps
+    // the flat array alone
+    void set_tick(int64_t tick, std::size_t window_ticks = BOOK_WINDOW_TICKS) {
+        if (tick == tick_ && (tick == 0 || window_ticks == window_.size())) {
+            return;
+        }
+        drop_window();
+        if (tick > 0 && window_ticks > 0) {
+            tick_ = tick;
+            window_.assign(window_ticks, 0);
+            index_window();
+        }
+    }
+
+    // Grid the window is on; 0 without one
+    int64_t tick() const { return tick_; }
+
+    // Multiply every price or quantity mantissa by `factor`, moving to the
+    // finer exponents given; the levels' values, and so the checksum, stay
+    void rescale(int64_t price_factor, int64_t qty_factor, int8_t price_exponent, int8_t qty_exponent) {
+        hasher_ = LevelHasher(price_exponent, qty_exponent);
+        for (auto &level : levels_) {
+            level.price *= price_factor;
+            level.qty *= qty_factor;
+        }
+        tick_ *= price_factor;
+        if (window_levels_ > 0) {
+            for (auto &qty : window_) {
+                qty *= qty_factor;
+            }
+        }
+    }
+
+    // Replace the side with `count` levels that `visit(emit)` produces by
+    // calling emit(price, qty). Binance sends levels best price first, so
+    // they are written back to front and only sorted if that does not leave
+    // them in order. Capacity is kept, so reloading does not allocate.
+    template <typename Visit>
+    void assign_best_first(std::size_t count, Visit &&visit) {
+        clear_window();
+        levels_.resize(count);
+        std::size_t back = count;
+        visit([&](int64_t price, int64_t qty) {
+            if (back > 0) {
+                levels_[--back] = BookLevel{price, qty};
+            }
+        });
+        levels_.erase(levels_.begin(), levels_.begin() + static_cast<std::ptrdiff_t>(back));
+        std::erase_if(levels_, [](const BookLevel &level) { return level.qty == 0; });
+        const auto order = [this](const BookLevel &a, const BookLevel &b) { return further(a.price, b.price); };
+        if (!std::is_sorted(levels_.begin(), levels_.end(), order)) {
+            std::sort(levels_.begin(), levels_.end(), order);
+        }
+        index_window();
+        rehash();
+    }
+
+    // Replace the side with a wire level group
+    void assign(const char *data, const LevelGroup &group) {
+        assign_best_first(group.count, [&](auto &&emit) {
+            for_each_level(data, group, [&](const LevelMantissa &level) { emit(level.price, level.qty); });
+        });
+    }
+
+    // Replace the side with `levels` in any order
+    void assign(std::span<const BookLevel> levels) {
+        clear_window();
+        levels_.assign(levels.begin(), levels.end());
+        std::erase_if(levels_, [](const BookLevel &level) { return level.qty == 0; });
+        std::sort(levels_.begin(), levels_.end(),
+                  [this](const BookLevel &a, const BookLevel &b) { return further(a.price, b.price); });
+        index_window();
+        rehash();
+    }
+
+private:
+    // set() apart from the checksum
+    int64_t set_level(int64_t price, int64_t qty) {
+        int64_t old = 0;
+        if (tick_ > 0 && set_in_window(price, qty, old)) {
+            return old;
+        }
+        auto it = std::lower_bound(levels_.begin(), levels_.end(), price,
+                                   [this](const BookLevel &level, int64_t p) { return further(level.price, p); });
+        const bool exists = it != levels_.end() && it->price == price;
+        old = exists ? it->qty : 0;
+        if (qty == 0) {
+            if (exists) {
+                levels_.erase(it);
+            }
+        } else if (exists) {
+            it->qty = qty;
+        } else {
+            levels_.insert(it, BookLevel{price, qty});
+        }
+        return old;
+    }
+
+    uint64_t hash_of(int64_t price, int64_t qty) const { return hasher_(side_ == BookSide::Bid, price, qty); }
+
+    void rehash() {
+        checksum_ = 0;
+        for_each_top(size(), [&](const BookLevel &level) { checksum_ += hash_of(level.price, level.qty); });
+    }
+
+    // Sort order: true when price `a` is further from the touch than `b`
+    bool further(int64_t a, int64_t b) const { return side_ == BookSide::Bid ? a < b : a > b; }
+
+    // Ticks from zero counted away from the touch, so nearer is smaller on
+    // both sides
+    int64_t distance(int64_t price) const { return side_ == BookSide::Bid ? -(price / tick_) : price / tick_; }
+    int64_t window_price(std::size_t i) const {
+        const int64_t ticks = window_start_ + static_cast<int64_t>(i);
+        return (side_ == BookSide::Bid ? -ticks : ticks) * tick_;
+    }
+
+    // The window's part of set(), which sets `old` when it takes the
+    // update; false leaves the update to the flat array
+    bool set_in_window(int64_t price, int64_t qty, int64_t &old) {
+        if (price % tick_ != 0) {
+            drop_window();
+            return false;
+        }
+        const int64_t d = distance(price);
+        const auto size = static_cast<int64_t>(window_.size());
+        if (d < window_start_ || (window_levels_ == 0 && d - window_start_ >= size)) {
+            // Nearer than the window (nothing there to remove), or the
+            // window is empty: move it to the new touch
+            if (qty == 0) {
+                return d < window_start_;
+            }
+            recenter(d);
+        }
+        const int64_t index = d - window_start_;
+        if (index >= size) {
+            return false;
+        }
+        const auto i = static_cast<std::size_t>(index);
+        old = window_[i];
+        window_[i] = qty;
+        if (qty != 0 && old == 0) {
+            window_best_ = window_levels_++ == 0 ? i : std::min(window_best_, i);
+        } else if (qty == 0 && old != 0 && --window_levels_ > 0 && i == window_best_) {
+            while (window_[window_best_] == 0) {
+                ++window_best_;
+            }
+        }
+        // Keep the touch in the window's near half
+        if (window_levels_ == 0 ? !levels_.empty() : window_best_ >= window_.size() / 2) {
+            recenter(window_levels_ == 0 ? distance(levels_.back().price)
+                                         : window_start_ + static_cast<int64_t>(window_best_));
+        }
+        return true;
+    }
+
+    // Re-place the window so the level `nearest` ticks out (or the touch,
+    // if nearer) sits a quarter of the way in, moving levels between the
+    // window and the flat array to match
+    void recenter(int64_t nearest) {
+        // Window levels are all nearer than the flat array's: append them
+        // furthest first
+        for (std::size_t i = window_.size(); window_levels_ > 0 && i-- > 0;) {
+            if (window_[i] != 0) {
+                levels_.push_back(BookLevel{window_price(i), window_[i]});
+                window_[i] = 0;
+                --window_levels_;
+            }
+        }
+        if (!levels_.empty()) {
+            nearest = std::min(nearest, distance(levels_.back().price));
+        }
+        window_start_ = nearest - static_cast<int64_t>(window_.size() / 4);
+        const auto size = static_cast<int64_t>(window_.size());
+        while (!levels_.empty() && distance(levels_.back().price) - window_start_ < size) {
+            const auto i = static_cast<std::size_t>(distance(levels_.back().price) - window_start_);
+            if (window_levels_++ == 0) {
+                window_best_ = i;
+            }
+            window_[i] = levels_.back().qty;
+            levels_.pop_back();
+        }
+    }
+
+    // Move the flat array's nearest levels into the window after a reload;
+    // any price off the grid leaves the side without a window
+    void index_window() {
+        if (tick_ == 0) {
+            return;
+        }
+        if (std::any_of(levels_.begin(), levels_.end(), [this](const BookLevel &l) { return l.price % tick_ != 0; })) {
+            drop_window();
+        } else if (!levels_.empty()) {
+            recenter(distance(levels_.back().price));
+        }
+    }
+
+    void clear_window() {
+        if (window_levels_ > 0) {
+            std::fill(window_.begin(), window_.end(), 0);
+            window_levels_ = 0;
+        }
+    }
+
+    // Back to the flat array alone, levels kept
+    void drop_window() {
+        if (tick_ == 0) {
+            return;
+        }
+        for (std::size_t i = window_.size(); window_levels_ > 0 && i-- > 0;) {
+            if (window_[i] != 0) {
+                levels_.push_back(BookLevel{window_price(i), window_[i]});
+                --window_levels_;
+            }
+        }
+        window_.clear();
+        tick_ = 0;
+    }
+
+    BookSide side_;
+    // Levels beyond the window (all of them without one), best at the back
+    std::vector<BookLevel> levels_;
+    // Dense window: window_[i] is the quantity window_start_ + i ticks out
+    // (see distance), 0 for no level; every flat array level lies beyond it
+    int64_t tick_ = 0;
+    int64_t window_start_ = 0;
+    std::vector<int64_t> window_;
+    std::size_t window_levels_ = 0;
+    // Nearest occupied slot, while window_levels_ > 0
+    std::size_t window_best_ = 0;
+    // Sum of every level's hash
+    LevelHasher hasher_;
+    uint64_t checksum_ = 0;
+};
+
+// A side's best levels as of one book epoch, best first: `rows` (price,
+// qty) pairs, as mantissas or as decoded values. Immutable once built.
+struct BookLevelsSnapshot {
+    uint64_t epoch = 0;
+    // Levels asked for; rows is fewer when the side is shallower
+    std::size_t depth = 0;
+    std::size_t rows = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    bool decoded = false;
+    // rows x 2, whichever of the two `decoded` says
+    std::vector<int64_t> mantissas;
+    std::vector<double> values;
+
+    // Holds the best `n` levels, or the whole side
+    bool covers(std::size_t n) const { return depth >= n || rows < depth; }
+};
+
+class OrderBook {
+public:
+    explicit OrderBook(std::string symbol = {})
+        : symbol_(std::move(symbol)),
+          symbol_id_(symbol_.empty() ? INVALID_SYMBOL_ID : symbol_table().intern(symbol_)) {}
+
+    // Apply a depth diff parsed by parse_depth_diff_frame; `data` is the
+    // frame body the diff's level groups point into.
+    ApplyStatus apply_diff(const char *data, const DepthDiffFrame &diff) {
+        return apply_update(diff.first_update_id, diff.final_update_id, diff.event_time_us, diff.price_exponent,
+                            diff.qty_exponent, [&](auto &&set_bid, auto &&set_ask) {
+                                for_each_level(data, diff.bids,
+                                               [&](const LevelMantissa &level) { set_bid(level.price, level.qty); });
+                                for_each_level(data, diff.asks,
+                                               [&](const LevelMantissa &level) { set_ask(level.price, level.qty); });
+                            });
+    }
+
+    // apply_diff for levels no longer in a frame (tick store rows): the
+    // diff's IDs and time, its levels as mantissas at the given exponents
+    ApplyStatus apply_diff(uint64_t first_update_id, uint64_t final_update_id, uint64_t event_time_us,
+                           int8_t price_exponent, int8_t qty_exponent, std::span<const BookLevel> bids,
+                           std::span<const BookLevel> asks) {
+        return apply_update(first_update_id, final_update_id, event_time_us, price_exponent, qty_exponent,
+                            [&](auto &&set_bid, auto &&set_ask) {
+                                for (const BookLevel &level : bids) {
+                                    set_bid(level.price, level.qty);
+                                }
+                                for (const BookLevel &level : asks) {
+                                    set_ask(level.price, level.qty);
+                                }
+                            });
+    }
+
+    // Replace the whole book with a snapshot taken at `last_update_id`
+    void load_snapshot(uint64_t last_update_id, int8_t price_exponent, int8_t qty_exponent,
+                       std::span<const BookLevel> bids, std::span<const BookLevel> asks) {
+        set_exponents(price_exponent, qty_exponent);
+        bids_.assign(bids);
+        asks_.assign(asks);
+        last_update_id_ = last_update_id;
+        resync_pending_ = false;
+        refresh_features();
+        rebase_order_flow();
+    }
+
+    // Re-seed from a partial depth frame parsed by parse_depth_snapshot_frame.
+    // Only an empty book or one waiting for a resync takes it (Applied); an
+    // in-sync book already holds more depth than the top-N, so it is Stale.
+    ApplyStatus apply_partial_depth(const char *data, const DepthSnapshotFrame &snapshot) {
+        if (last_update_id_ != 0 && (!resync_pending_ || snapshot.book_update_id <= last_update_id_)) {
+            return ApplyStatus::Stale;
+        }
+        set_exponents(snapshot.price_exponent, snapshot.qty_exponent);
+        bids_.assign(data, snapshot.bids);
+        asks_.assign(data, snapshot.asks);
+        last_update_id_ = snapshot.book_update_id;
+        event_time_us_ = snapshot.event_time_us;
+        resync_pending_ = false;
+        refresh_features();
+        rebase_order_flow();
+        return ApplyStatus::Applied;
+    }
+
+    // apply_partial_depth for levels no longer in a frame, in any order
+    ApplyStatus apply_partial_depth(uint64_t book_update_id, uint64_t event_time_us, int8_t price_exponent,
+                                    int8_t qty_exponent, std::span<const BookLevel> bids,
+                                    std::span<const BookLevel> asks) {
+        if (last_update_id_ != 0 && (!resync_pending_ || book_update_id <= last_update_id_)) {
+            return ApplyStatus::Stale;
+        }
+        load_snapshot(book_update_id, price_exponent, qty_exponent, bids, asks);
+        event_time_us_ = event_time_us;
+        return ApplyStatus::Applied;
+    }
+
+    // load_snapshot for snapshots read in place from a wire buffer:
+    // `load_sides(bids, asks)` fills both sides, typically through
+    // BookSideLevels::assign_best_first. If it throws (a truncated buffer)
+    // the book is left empty and waiting for a resync.
+    template <typename LoadSides>
+    void load_snapshot(uint64_t last_update_id, int8_t price_exponent, int8_t qty_exponent, LoadSides &&load_sides) {
+        set_exponents(price_exponent, qty_exponent);
+        try {
+            load_sides(bids_, asks_);
+        } catch (...) {
+            clear();
+            resync_pending_ = true;
+            throw;
+        }
+        last_update_id_ = last_update_id;
+        resync_pending_ = false;
+        refresh_features();
+        rebase_order_flow();
+    }
+
+    // Event time of a book restored from a checkpoint (book_checkpoint.h);
+    // applied diffs keep it current otherwise
+    void set_event_time_us(uint64_t event_time_us) { event_time_us_ = event_time_us; }
+
+    void clear() {
+        bids_.clear();
+        asks_.clear();
+        last_update_id_ = 0;
+        event_time_us_ = 0;
+        has_exponents_ = false;
+        resync_pending_ = false;
+        features_ = empty_book_features();
+        ++epoch_;
+        rebase_order_flow();
+    }
+
+    // Price tick in price units for BOOK_SPREAD_TICKS (PRICE_FILTER
+    // tickSize); 0 counts one mantissa unit at the book's price exponent
+    void set_tick_size(double tick_size) {
+        tick_size_ = tick_size;
+        refresh_features();
+    }
+
+    // Sum order-flow imbalance to `levels` from the touch (at most
+    // ORDER_FLOW_MAX_LEVELS) and added/removed liquidity from here on;
+    // 0 stops. Kept across clear() and snapshots.
+    void track_order_flow(std::size_t levels) {
+        order_flow_.track(levels);
+        rebase_order_flow();
+    }
+
+    // Carry `flow`'s setting and sums over to this book, e.g. into a book
+    // that replaces this one's predecessor
+    void set_order_flow(const OrderFlow &flow) {
+        order_flow_ = flow;
+        rebase_order_flow();
+    }
+
+    const OrderFlow &order_flow() const { return order_flow_; }
+
+    // Order-flow sums since the last call, which this resets
+    OrderFlowTotals take_order_flow() { return order_flow_.take(); }
+
+    // Index levels on `grid` (see BookSideLevels::set_tick); kept across
+    // clear() and snapshots. Does not change tick_size().
+    void set_price_grid(PriceGrid grid) {
+        price_grid_ = grid;
+        apply_price_grid();
+    }
+
+    // The symbol's tick from the rules cache: both the grid and tick_size()
+    void set_tick(int64_t tick, int8_t exponent) {
+        set_price_grid(PriceGrid{tick, exponent});
+        set_tick_size(tick > 0 ? decode_decimal(tick, exponent) : 0);
+    }
+
+    const std::string &symbol() const { return symbol_; }
+    // Interned ID of symbol(); INVALID_SYMBOL_ID for an unnamed book
+    SymbolId symbol_id() const { return symbol_id_; }
+    const BookSideLevels &bids() const { return bids_; }
+    const BookSideLevels &asks() const { return asks_; }
+    uint64_t last_update_id() const { return last_update_id_; }
+    // A diff hit a gap since the last snapshot
+    bool resync_pending() const { return resync_pending_; }
+    uint64_t event_time_us() const { return event_time_us_; }
+    int8_t price_exponent() const { return price_exponent_; }
+    int8_t qty_exponent() const { return qty_exponent_; }
+    double tick_size() const { return tick_size_; }
+    PriceGrid price_grid() const { return price_grid_; }
+    // As of the last applied update; all NaN while either side is empty
+    const BookFeatureVector &features() const { return features_; }
+    // Bumped by every change to the levels
+    uint64_t epoch() const { return epoch_; }
+
+    // Checksum of the best `depth` levels of each side (0: all of them),
+    // as depth_snapshot_checksum computes it for a snapshot
+    uint64_t checksum(std::size_t depth = 0) const { return bids_.checksum(depth) + asks_.checksum(depth); }
+
+    // Bytes of both sides' levels (memory_accounting.h)
+    MemoryUsage memory_usage() const {
+        MemoryUsage usage = bids_.memory_usage();
+        usage += asks_.memory_usage();
+        return usage;
+    }
+
+    // `side`'s best `depth` levels as of this epoch. Reads between two
+    // changes share one snapshot (a deeper one serves a shallower read).
+    // Caches in the book: the thread that owns the book only.
+    std::shared_ptr<const BookLevelsSnapshot> levels_snapshot(BookSide side, std::size_t depth, bool decoded) const {
+        std::shared_ptr<const BookLevelsSnapshot> &cached =
+            snapshots_[(side == BookSide::Bid ? 0 : 2) + (decoded ? 1 : 0)];
+        if (cached != nullptr && cached->epoch == epoch_ && cached->covers(depth)) {
+            return cached;
+        }
+        auto snapshot = std::make_shared<BookLevelsSnapshot>();
+        snapshot->epoch = epoch_;
+        snapshot->depth = depth;
+        snapshot->price_exponent = price_exponent_;
+        snapshot->qty_exponent = qty_exponent_;
+        snapshot->decoded = decoded;
+        const BookSideLevels &levels = side == BookSide::Bid ? bids_ : asks_;
+        const std::size_t rows = std::min(depth, levels.size());
+        if (decoded) {
+            snapshot->values.reserve(2 * rows);
+        } else {
+            snapshot->mantissas.reserve(2 * rows);
+        }
+        levels.for_each_top(rows, [&](const auto &level) {
+            if (decoded) {
+                snapshot->values.push_back(decode_decimal(level.price, price_exponent_));
+                snapshot->values.push_back(decode_decimal(level.qty, qty_exponent_));
+            } else {
+                snapshot->mantissas.push_back(level.price);
+                snapshot->mantissas.push_back(level.qty);
+            }
+        });
+        snapshot->rows = rows;
+        cached = std::move(snapshot);
+        return cached;
+    }
+
+private:
+    // The update-ID rules, then `set_levels(set_bid, set_ask)` calls each
+    // setter with (price, qty) mantissas at the given exponents
+    template <typename SetLevels>
+    ApplyStatus apply_update(uint64_t first_update_id, uint64_t final_update_id, uint64_t event_time_us,
+                             int8_t price_exponent, int8_t qty_exponent, SetLevels &&set_levels) {
+        if (last_update_id_ != 0) {
+            if (final_update_id <= last_update_id_) {
+                return ApplyStatus::Stale;
+            }
+            if (first_update_id > last_update_id_ + 1) {
+                resync_pending_ = true;
+                return ApplyStatus::Gap;
+            }
+        }
+
+        align_exponents(price_exponent, qty_exponent);
+        const int64_t price_factor = pow10_i64(price_exponent - price_exponent_);
+        const int64_t qty_factor = pow10_i64(qty_exponent - qty_exponent_);
+        if (order_flow_.enabled() && last_update_id_ != 0) {
+            // Added and removed liquidity per side, from each level's old
+            // quantity; a diff seeding an empty book is not flow
+            std::array<int64_t, 4> liquidity{};
+            const auto set_tracked = [&](BookSideLevels &side, std::size_t at, int64_t price, int64_t qty) {
+                const int64_t change = qty * qty_factor - side.set(price * price_factor, qty * qty_factor);
+                liquidity[change > 0 ? at : at + 1] += change > 0 ? change : -change;
+            };
+            set_levels([&](int64_t price, int64_t qty) { set_tracked(bids_, 0, price, qty); },
+                       [&](int64_t price, int64_t qty) { set_tracked(asks_, 2, price, qty); });
+            order_flow_.add_liquidity(liquidity[0], liquidity[1], liquidity[2], liquidity[3], qty_exponent_);
+            order_flow_.update(bids_, asks_, price_exponent_, qty_exponent_);
+        } else {
+            set_levels([&](int64_t price, int64_t qty) { bids_.set(price * price_factor, qty * qty_factor); },
+                       [&](int64_t price, int64_t qty) { asks_.set(price * price_factor, qty * qty_factor); });
+            rebase_order_flow();
+        }
+
+        last_update_id_ = final_update_id;
+        event_time_us_ = event_time_us;
+        refresh_features();
+        return ApplyStatus::Applied;
+    }
+
+    // Every change to the levels ends here or in clear()
+    void refresh_features() {
+        ++epoch_;
+        const double tick = tick_size_ > 0 ? tick_size_ : decode_decimal(1, price_exponent_);
+        compute_book_features(bids_, asks_, price_exponent_, qty_exponent_, tick, features_);
+    }
+
+    void rebase_order_flow() { order_flow_.rebase(bids_, asks_, price_exponent_, qty_exponent_); }
+
+    void set_exponents(int8_t price_exponent, int8_t qty_exponent) {
+        price_exponent_ = price_exponent;
+        qty_exponent_ = qty_exponent;
+        has_exponents_ = true;
+        bids_.set_exponents(price_exponent, qty_exponent);
+        asks_.set_exponents(price_exponent, qty_exponent);
+        apply_price_grid();
+    }
+
+    // The grid's tick at the book's price exponent; no window until the
+    // exponent is known, or if the tick is finer than it
+    void apply_price_grid() {
+        int64_t tick = 0;
+        if (has_exponents_ && price_grid_.tick > 0 && price_grid_.exponent >= price_exponent_) {
+            tick = price_grid_.tick * pow10_i64(price_grid_.exponent - price_exponent_);
+        }
+        bids_.set_tick(tick);
+        asks_.set_tick(tick);
+    }
+
+    // The book keeps the finest exponents it has seen, so incoming
+    // mantissas always scale up exactly.
+    void align_exponents(int8_t price_exponent, int8_t qty_exponent) {
+        if (!has_exponents_) {
+            set_exponents(price_exponent, qty_exponent);
+            return;
+        }
+        const int8_t new_price_exponent = std::min(price_exponent_, price_exponent);
+        const int8_t new_qty_exponent = std::min(qty_exponent_, qty_exponent);
+        if (new_price_exponent != price_exponent_ || new_qty_exponent != qty_exponent_) {
+            const int64_t price_factor = pow10_i64(price_exponent_ - new_price_exponent);
+            const int64_t qty_factor = pow10_i64(qty_exponent_ - new_qty_exponent);
+            bids_.rescale(price_factor, qty_factor, new_price_exponent, new_qty_exponent);
+            asks_.rescale(price_factor, qty_factor, new_price_exponent, new_qty_exponent);
+            price_exponent_ = new_price_exponent;
+            qty_exponent_ = new_qty_exponent;
+            // rescale() carried the ticks along; this only re-enables a grid
+            // the old exponent could not express
+            apply_price_grid();
+        }
+    }
+
+    std::string symbol_;
+    SymbolId symbol_id_;
+    BookSideLevels bids_{BookSide::Bid};
+    BookSideLevels asks_{BookSide::Ask};
+    uint64_t last_update_id_ = 0;
+    uint64_t event_time_us_ = 0;
+    int8_t price_exponent_ = 0;
+    int8_t qty_exponent_ = 0;
+    bool has_exponents_ = false;
+    bool resync_pending_ = false;
+    double tick_size_ = 0;
+    PriceGrid price_grid_;
+    BookFeatureVector features_ = empty_book_features();
+    OrderFlow order_flow_;
+    uint64_t epoch_ = 0;
+    // levels_snapshot() per side, mantissas and decoded
+    mutable std::array<std::shared_ptr<const BookLevelsSnapshot>, 4> snapshots_;
+};
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Incremental order-flow imbalance (OFI) of an OrderBook.
+ *
+ * Book features (book_features.h) describe the book as it stands; OFI
+ * describes how it moved. Following Cont, Kukanov and Stoikov, each update
+ * contributes, at every level m from the touch,
+ *
+ *   e_m =  q_bid(t)   if P_bid(t) >= P_bid(t-1)
+ *        - q_bid(t-1) if P_bid(t) <= P_bid(t-1)
+ *        - q_ask(t)   if P_ask(t) <= P_ask(t-1)
+ *        + q_ask(t-1) if P_ask(t) >= P_ask(t-1)
+ *
+ * where P and q are the m-th level's price and quantity just after and just
+ * before the update: bids joining or improving and asks leaving or backing
+ * off count as buying pressure. A level missing on a side compares as the
+ * worst possible price with no quantity. The multi-level form (levels
+ * 1..N rather than the touch alone) follows Xu, Gould and Howison.
+ *
+ * OrderFlow keeps the top N levels of each side as of the last update, so
+ * an update costs one O(N) walk of each side, and sums e_m per level. It
+ * also sums the liquidity every diff added and removed on each side (all
+ * levels, not just the top N), from the quantity each level had before.
+ * Snapshots and resyncs move the reference book without counting as flow.
+ *
+ * The sums are accumulators: a sampler reads them with take(), which also
+ * resets them, so each read covers the updates since the previous one.
+ * Quantities are base-asset units, each update's contribution rounded
+ * once from exact mantissa arithmetic.
+ */
+
+#ifndef _SBE_ORDER_FLOW_H_
+#define _SBE_ORDER_FLOW_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "stream_decode.h"
+
+// Deepest level OFI can be tracked to
+constexpr std::size_t ORDER_FLOW_MAX_LEVELS = 20;
+
+struct OrderFlowTotals {
+    // Levels tracked; ofi[m]: summed e_m of level m + 1 from the touch
+    std::size_t levels = 0;
+    std::array<double, ORDER_FLOW_MAX_LEVELS> ofi{};
+    double bid_added = 0;
+    double bid_removed = 0;
+    double ask_added = 0;
+    double ask_removed = 0;
+    // Updates summed
+    uint64_t updates = 0;
+};
+
+class OrderFlow {
+public:
+    // Track OFI to `levels` (clamped to ORDER_FLOW_MAX_LEVELS); 0 turns
+    // tracking off. Resets the sums.
+    void track(std::size_t levels) {
+        levels_ = std::min(levels, ORDER_FLOW_MAX_LEVELS);
+        totals_ = OrderFlowTotals{};
+        totals_.levels = levels_;
+        has_reference_ = false;
+    }
+
+    bool enabled() const { return levels_ > 0; }
+    std::size_t levels() const { return levels_; }
+
+    // Liquidity one update added and removed, as qty mantissas at `qty_exponent`
+    void add_liquidity(int64_t bid_added, int64_t bid_removed, int64_t ask_added, int64_t ask_removed,
+                       int8_t qty_exponent) {
+        totals_.bid_added += decode_decimal(bid_added, qty_exponent);
+        totals_.bid_removed += decode_decimal(bid_removed, qty_exponent);
+        totals_.ask_added += decode_decimal(ask_added, qty_exponent);
+        totals_.ask_removed += decode_decimal(ask_removed, qty_exponent);
+    }
+
+    // After an applied update: add each level's e_m against the reference
+    // book, which becomes the book as it now stands
+    template <typename Side>
+    void update(const Side &bids, const Side &asks, int8_t price_exponent, int8_t qty_exponent) {
+        Top bid_top = top(bids, BID_MISSING);
+        Top ask_top = top(asks, ASK_MISSING);
+        if (has_reference_) {
+            align_reference(price_exponent, qty_exponent);
+            for (std::size_t m = 0; m < levels_; ++m) {
+                const Level &bid = bid_top[m], &old_bid = bid_top_[m];
+                const Level &ask = ask_top[m], &old_ask = ask_top_[m];
+                int64_t e = 0;
+                e += bid.price >= old_bid.price ? bid.qty : 0;
+                e -= bid.price <= old_bid.price ? old_bid.qty : 0;
+                e -= ask.price <= old_ask.price ? ask.qty : 0;
+                e += ask.price >= old_ask.price ? old_ask.qty : 0;
+                totals_.ofi[m] += decode_decimal(e, qty_exponent);
+            }
+            ++totals_.updates;
+        }
+        bid_top_ = bid_top;
+        ask_top_ = ask_top;
+        price_exponent_ = price_exponent;
+        qty_exponent_ = qty_exponent;
+        has_reference_ = true;
+    }
+
+    // After a snapshot, resync or clear: take the book as the reference
+    // without counting the change as flow
+    template <typename Side>
+    void rebase(const Side &bids, const Side &asks, int8_t price_exponent, int8_t qty_exponent) {
+        if (!enabled()) {
+            return;
+        }
+        bid_top_ = top(bids, BID_MISSING);
+        ask_top_ = top(asks, ASK_MISSING);
+        price_exponent_ = price_exponent;
+        qty_exponent_ = qty_exponent;
+        has_reference_ = true;
+    }
+
+    // Sums since the last take()
+    const OrderFlowTotals &totals() const { return totals_; }
+
+    // Read and reset the sums; the reference book is kept
+    OrderFlowTotals take() {
+        const OrderFlowTotals taken = totals_;
+        totals_ = OrderFlowTotals{};
+        totals_.levels = levels_;
+        return taken;
+    }
+
+private:
+    struct Level {
+        int64_t price = 0;
+        int64_t qty = 0;
+    };
+    using Top = std::array<Level, ORDER_FLOW_MAX_LEVELS>;
+
+    // Missing levels: worse than any real price on their side
+    static constexpr int64_t BID_MISSING = std::numeric_limits<int64_t>::min();
+    static constexpr int64_t ASK_MISSING = std::numeric_limits<int64_t>::max();
+
+    template <typename Side>
+    Top top(const Side &side, int64_t missing) const {
+        Top out;
+        out.fill(Level{missing, 0});
+        std::size_t m = 0;
+        side.for_each_top(levels_, [&](const auto &level) { out[m++] = Level{level.price, level.qty}; });
+        return out;
+    }
+
+    // The book only ever moves to finer exponents; bring the reference along
+    void align_reference(int8_t price_exponent, int8_t qty_exponent) {
+        if (price_exponent == price_exponent_ && qty_exponent == qty_exponent_) {
+            return;
+        }
+        const int64_t price_factor = pow10_i64(price_exponent_ - price_exponent);
+        const int64_t qty_factor = pow10_i64(qty_exponent_ - qty_exponent);
+        for (Top *side : {&bid_top_, &ask_top_}) {
+            for (Level &level : *side) {
+                if (level.qty != 0) {
+                    level.price *= price_factor;
+                    level.qty *= qty_factor;
+                }
+            }
+        }
+    }
+
+    std::size_t levels_ = 0;
+    // The top levels as of the last update, once there is one
+    bool has_reference_ = false;
+    Top bid_top_{};
+    Top ask_top_{};
+    int8_t price_exponent_ = 0;
+    int8_t qty_exponent_ = 0;
+    OrderFlowTotals totals_;
+};
+
+#endif
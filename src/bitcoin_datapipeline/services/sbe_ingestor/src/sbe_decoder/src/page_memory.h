@@ -0,0 +1,281 @@
+/*
+ * Huge-page and NUMA placement for long-lived native memory.
+ *
+ * Rings, event logs, journal mappings, books and dedup tables are sized
+ * once and then touched on every frame for the life of the process. On a
+ * two-socket host, memory the kernel happened to place on the other node
+ * costs a cross-node access on each of those touches, and megabytes of
+ * 4 KB pages keep missing the TLB. MemoryPlacement asks for both fixes:
+ *
+ *   huge_pages  2 MB pages: an explicit hugetlb mapping when the host has
+ *               reserved pages (vm.nr_hugepages), else a 2 MB-aligned
+ *               mapping madvise()d for transparent huge pages, else
+ *               plain pages. Each step down is a fallback, never an error.
+ *   numa_node   prefer that node for the pages (MPOL_PREFERRED: the kernel
+ *               still falls back to another node rather than fail when
+ *               this one is full); -1 leaves placement to first touch.
+ *
+ * The node normally comes from the core the owning thread is pinned to
+ * (pin_current_thread, cpu_numa_node). PageMemory is an anonymous mapping placed that way and
+ * prefaulted, so the pages are allocated where asked before the hot path
+ * first writes them. place_pages() applies the same advice to a mapping
+ * made elsewhere (a journal or event log file), and prefer_numa_node() sets
+ * the calling thread's default, which covers everything it allocates from
+ * the heap, such as the books of a pinned decoder worker, and the page
+ * cache of files it writes.
+ *
+ * page_memory_stats() counts the bytes each backing actually got, so a
+ * host that quietly fell back to 4 KB pages shows up in the metrics.
+ */
+
+#ifndef _SBE_PAGE_MEMORY_H_
+#define _SBE_PAGE_MEMORY_H_
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <utility>
+
+constexpr std::size_t HUGE_PAGE_SIZE = std::size_t{2} << 20;
+
+struct MemoryPlacement {
+    bool huge_pages = false;
+    // Preferred NUMA node; -1 for none
+    int numa_node = -1;
+};
+
+// Per component: its MemoryPlacement before the owning thread's core is known
+struct ComponentMemory {
+    bool huge_pages = false;
+    // Prefer the NUMA node of the core the owning thread is pinned to
+    bool numa_local = false;
+};
+
+enum class PageBacking : uint8_t {
+    Normal = 0,
+    // Transparent huge pages requested with madvise
+    Transparent,
+    // Explicit hugetlb pages
+    HugeTlb,
+};
+
+constexpr std::array<const char *, 3> PAGE_BACKING_NAMES = {"normal", "transparent", "hugetlb"};
+
+struct PageMemoryStats {
+    // Bytes currently mapped, by PageBacking
+    std::array<std::atomic<uint64_t>, 3> bytes{};
+    // Mappings that asked for huge pages and got plain ones
+    std::atomic<uint64_t> huge_page_fallbacks{0};
+    // NUMA placements the kernel refused (no such node, no NUMA support)
+    std::atomic<uint64_t> numa_failures{0};
+};
+
+inline PageMemoryStats &page_memory_stats() {
+    static PageMemoryStats stats;
+    return stats;
+}
+
+// NUMA node of `cpu` from sysfs; -1 when unknown or on a host without NUMA
+inline int cpu_numa_node(int cpu) {
+    if (cpu < 0) {
+        return -1;
+    }
+    std::error_code error;
+    const std::filesystem::path dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    for (const auto &entry : std::filesystem::directory_iterator(dir, error)) {
+        const std::string name = entry.path().filename().string();
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            name.find_first_not_of("0123456789", 4) == std::string::npos) {
+            return std::stoi(name.substr(4));
+        }
+    }
+    return -1;
+}
+
+// The placement for a component whose owner is pinned to `cpu` (-1 unpinned)
+inline MemoryPlacement component_placement(const ComponentMemory &memory, int cpu) {
+    return MemoryPlacement{memory.huge_pages, memory.numa_local ? cpu_numa_node(cpu) : -1};
+}
+
+namespace page_memory_detail {
+
+// Set the preferred node of a range, or of the calling thread when `base`
+// is null. MPOL_MF_MOVE in `flags` also migrates pages already allocated
+// and mapped only by this process.
+inline bool prefer_node(void *base, std::size_t size, int node, unsigned flags = 0) {
+    if (node < 0 || node >= static_cast<int>(8 * sizeof(unsigned long))) {
+        return node < 0;
+    }
+    const unsigned long mask = 1UL << node;
+    const long rc = base == nullptr
+                        ? ::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, 8 * sizeof(mask))
+                        : ::syscall(SYS_mbind, base, size, MPOL_PREFERRED, &mask, 8 * sizeof(mask), flags);
+    if (rc != 0) {
+        page_memory_stats().numa_failures.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+} // namespace page_memory_detail
+
+// Pin the calling thread to `cpu`; returns an error message or empty
+inline std::string pin_current_thread(int cpu) {
+    if (cpu >= CPU_SETSIZE) {
+        return "cpu " + std::to_string(cpu) + " is out of range for pinning";
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); rc != 0) {
+        return "failed to pin thread to cpu " + std::to_string(cpu) + ": " + std::strerror(rc);
+    }
+    return {};
+}
+
+// Prefer `node` for the calling thread's future allocations; returns an
+// error message or empty
+inline std::string prefer_numa_node(int node) {
+    if (node < 0 || page_memory_detail::prefer_node(nullptr, 0, node)) {
+        return {};
+    }
+    return "failed to prefer NUMA node " + std::to_string(node) + ": " + std::strerror(errno);
+}
+
+// Advise an existing page-aligned mapping: transparent huge pages where
+// the backing supports them (anonymous memory, tmpfs mounted huge=advise)
+// and the preferred node, moving pages a tmpfs file already allocated.
+// False when the node could not be set.
+inline bool place_pages(void *base, std::size_t size, const MemoryPlacement &placement) {
+    if (placement.huge_pages) {
+        ::madvise(base, size, MADV_HUGEPAGE);
+    }
+    return page_memory_detail::prefer_node(base, size, placement.numa_node, MPOL_MF_MOVE);
+}
+
+// An anonymous read-write mapping placed per MemoryPlacement, zeroed and
+// prefaulted. Move-only.
+class PageMemory {
+public:
+    PageMemory() = default;
+
+    PageMemory(std::size_t size, const MemoryPlacement &placement) {
+        if (size == 0) {
+            return;
+        }
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        if (placement.huge_pages) {
+            size_ = round_up(size, HUGE_PAGE_SIZE);
+            void *base =
+                ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (base != MAP_FAILED) {
+                map_ = base;
+                data_ = base;
+                backing_ = PageBacking::HugeTlb;
+            } else {
+                map_transparent();
+            }
+        } else {
+            size_ = round_up(size, page);
+            map_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (map_ == MAP_FAILED) {
+                map_ = nullptr;
+                throw std::bad_alloc();
+            }
+            data_ = map_;
+            map_size_ = size_;
+        }
+        if (map_size_ == 0) {
+            map_size_ = size_;
+        }
+        bound_ = placement.numa_node >= 0 && page_memory_detail::prefer_node(data_, size_, placement.numa_node);
+        node_ = bound_ ? placement.numa_node : -1;
+        // Fault every page in now, under the policy just set
+        const std::size_t stride = backing_ == PageBacking::Normal ? page : HUGE_PAGE_SIZE;
+        for (std::size_t offset = 0; offset < size_; offset += stride) {
+            static_cast<volatile char *>(data_)[offset] = 0;
+        }
+        PageMemoryStats &stats = page_memory_stats();
+        stats.bytes[static_cast<std::size_t>(backing_)].fetch_add(size_, std::memory_order_relaxed);
+        if (placement.huge_pages && backing_ == PageBacking::Normal) {
+            stats.huge_page_fallbacks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    ~PageMemory() { release(); }
+
+    PageMemory(PageMemory &&other) noexcept { *this = std::move(other); }
+
+    PageMemory &operator=(PageMemory &&other) noexcept {
+        if (this != &other) {
+            release();
+            map_ = std::exchange(other.map_, nullptr);
+            map_size_ = std::exchange(other.map_size_, 0);
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            backing_ = other.backing_;
+            node_ = other.node_;
+            bound_ = other.bound_;
+        }
+        return *this;
+    }
+
+    PageMemory(const PageMemory &) = delete;
+    PageMemory &operator=(const PageMemory &) = delete;
+
+    void *data() const { return data_; }
+    // Rounded up to the page size used
+    std::size_t size() const { return size_; }
+    PageBacking backing() const { return backing_; }
+    // Preferred node the pages were placed on; -1 if none was set
+    int node() const { return node_; }
+
+private:
+    static std::size_t round_up(std::size_t size, std::size_t unit) { return (size + unit - 1) / unit * unit; }
+
+    // Over-map by one huge page and keep a 2 MB-aligned window, so whole
+    // huge pages fit; the kernel backs them as THP when it can
+    void map_transparent() {
+        map_size_ = size_ + HUGE_PAGE_SIZE;
+        void *base = ::mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            map_size_ = 0;
+            throw std::bad_alloc();
+        }
+        map_ = base;
+        const auto address = reinterpret_cast<uintptr_t>(base);
+        data_ = reinterpret_cast<void *>((address + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+        backing_ = ::madvise(data_, size_, MADV_HUGEPAGE) == 0 ? PageBacking::Transparent : PageBacking::Normal;
+    }
+
+    void release() {
+        if (map_ != nullptr) {
+            page_memory_stats().bytes[static_cast<std::size_t>(backing_)].fetch_sub(size_, std::memory_order_relaxed);
+            ::munmap(map_, map_size_);
+            map_ = nullptr;
+        }
+    }
+
+    void *map_ = nullptr;
+    std::size_t map_size_ = 0;
+    void *data_ = nullptr;
+    std::size_t size_ = 0;
+    PageBacking backing_ = PageBacking::Normal;
+    int node_ = -1;
+    bool bound_ = false;
+};
+
+#endif
@@ -0,0 +1,732 @@
+/*
+ * Columnar Parquet files for the S3 archive, without an Arrow dependency.
+ *
+ * ParquetWriter buffers rows column by column and finish() encodes them as
+ * one Parquet file: "PAR1", a column chunk per column and row group, then
+ * the Thrift compact-encoded FileMetaData footer, its length and "PAR1".
+ * Every column is REQUIRED, so data pages carry values only, no levels.
+ *
+ * Each column chunk is one version 1 data page, preceded by a dictionary
+ * page when dictionary encoding pays: strings always (symbol, interval and
+ * the like have a handful of values), int64 and float64 when at most half
+ * the row group's values are distinct, e.g. prices and timestamps that
+ * repeat. Dictionary indices use the RLE/bit-packed hybrid. Pages are zstd
+ * frames (codec ZSTD), and int64/float64/string chunks carry min/max
+ * statistics with a type-defined column order, so readers can skip row
+ * groups by time range and read only the columns they ask for.
+ *
+ * Not thread-safe; one writer per archive partition.
+ */
+
+#ifndef _SBE_PARQUET_WRITER_H_
+#define _SBE_PARQUET_WRITER_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "record_codec.h"
+
+enum class ParquetType : uint8_t { INT64, FLOAT64, BOOL, STRING, TIMESTAMP_MS };
+
+enum class ParquetCompression : uint8_t { NONE, ZSTD };
+
+struct ParquetColumnSpec {
+    std::string name;
+    ParquetType type;
+};
+
+// Rows per row group unless the writer is told otherwise
+constexpr std::size_t PARQUET_DEFAULT_ROW_GROUP_SIZE = 1 << 20;
+// Largest dictionary page a column gets before falling back to PLAIN, as
+// parquet-cpp's dictionary_pagesize_limit
+constexpr std::size_t PARQUET_DICTIONARY_LIMIT = 1 << 20;
+
+inline ParquetType parquet_type_from_name(std::string_view name) {
+    if (name == "int64") {
+        return ParquetType::INT64;
+    }
+    if (name == "float64") {
+        return ParquetType::FLOAT64;
+    }
+    if (name == "bool") {
+        return ParquetType::BOOL;
+    }
+    if (name == "string") {
+        return ParquetType::STRING;
+    }
+    if (name == "timestamp_ms") {
+        return ParquetType::TIMESTAMP_MS;
+    }
+    throw std::runtime_error("ParquetWriter: unknown column type '" + std::string(name) +
+                             "' (int64, float64, bool, string or timestamp_ms)");
+}
+
+namespace parquet_detail {
+
+// parquet.thrift enums
+enum PhysicalType : int32_t { BOOLEAN = 0, INT64 = 2, DOUBLE = 5, BYTE_ARRAY = 6 };
+enum Encoding : int32_t { PLAIN = 0, RLE = 3, RLE_DICTIONARY = 8 };
+enum PageType : int32_t { DATA_PAGE = 0, DICTIONARY_PAGE = 2 };
+enum ConvertedType : int32_t { UTF8 = 0, TIMESTAMP_MILLIS = 9 };
+enum Codec : int32_t { UNCOMPRESSED = 0, ZSTD = 6 };
+constexpr int32_t REQUIRED = 0;
+
+// Thrift compact protocol, only what the footer and page headers need
+class CompactWriter {
+public:
+    enum Type : uint8_t { BOOL_TRUE = 1, BOOL_FALSE = 2, I32 = 5, I64 = 6, BINARY = 8, LIST = 9, STRUCT = 12 };
+
+    explicit CompactWriter(std::vector<char> &out) : out_(out) {}
+
+    void begin_struct() { last_.push_back(0); }
+    void end_struct() {
+        out_.push_back(0);
+        last_.pop_back();
+    }
+    void struct_field(int16_t id) {
+        header(id, STRUCT);
+        begin_struct();
+    }
+
+    void i32(int16_t id, int32_t value) {
+        header(id, I32);
+        varint(zigzag(value));
+    }
+    void i64(int16_t id, int64_t value) {
+        header(id, I64);
+        varint(zigzag(value));
+    }
+    void boolean(int16_t id, bool value) { header(id, value ? BOOL_TRUE : BOOL_FALSE); }
+    void binary(int16_t id, std::string_view value) {
+        header(id, BINARY);
+        binary_value(value);
+    }
+
+    // The list's elements follow: *_value() for scalars, begin_struct() and
+    // end_struct() around each struct
+    void list(int16_t id, Type element, std::size_t size) {
+        header(id, LIST);
+        if (size < 15) {
+            out_.push_back(static_cast<char>(size << 4 | element));
+        } else {
+            out_.push_back(static_cast<char>(0xF0 | element));
+            varint(size);
+        }
+    }
+    void i32_value(int32_t value) { varint(zigzag(value)); }
+    void binary_value(std::string_view value) {
+        varint(value.size());
+        out_.insert(out_.end(), value.begin(), value.end());
+    }
+
+private:
+    static uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out_.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void header(int16_t id, uint8_t type) {
+        const int delta = id - last_.back();
+        if (delta > 0 && delta <= 15) {
+            out_.push_back(static_cast<char>(delta << 4 | type));
+        } else {
+            out_.push_back(static_cast<char>(type));
+            varint(zigzag(id));
+        }
+        last_.back() = id;
+    }
+
+    std::vector<char> &out_;
+    std::vector<int16_t> last_;
+};
+
+template <typename T>
+void append_le(std::vector<char> &out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+inline void append_varint(std::vector<char> &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// RLE/bit-packed hybrid of dictionary indices, after the bit-width byte:
+// runs of 8 or more equal indices as RLE runs, everything else bit-packed
+// in groups of 8 (the last group padded with zeros)
+inline void encode_indices(std::span<const uint32_t> indices, int bit_width, std::vector<char> &out) {
+    const std::size_t n = indices.size();
+    const auto repeat_at = [&](std::size_t i) {
+        std::size_t j = i + 1;
+        while (j < n && indices[j] == indices[i]) {
+            ++j;
+        }
+        return j - i;
+    };
+    const int value_bytes = (bit_width + 7) / 8;
+    std::size_t i = 0;
+    while (i < n) {
+        const std::size_t run = repeat_at(i);
+        if (run >= 8) {
+            append_varint(out, static_cast<uint64_t>(run) << 1);
+            for (int b = 0; b < value_bytes; ++b) {
+                out.push_back(static_cast<char>(indices[i] >> (8 * b)));
+            }
+            i += run;
+            continue;
+        }
+        std::size_t end = i;
+        while (end < n && repeat_at(end) < 8) {
+            end += 8;
+        }
+        const std::size_t groups = (std::min(end, n) - i + 7) / 8;
+        append_varint(out, groups << 1 | 1);
+        const std::size_t start = out.size();
+        out.resize(start + groups * static_cast<std::size_t>(bit_width));
+        auto *packed = reinterpret_cast<uint8_t *>(out.data() + start);
+        std::size_t bit = 0;
+        for (std::size_t k = i; k < i + groups * 8; ++k) {
+            const uint32_t value = k < n ? indices[k] : 0;
+            for (int b = 0; b < bit_width; ++b, ++bit) {
+                packed[bit / 8] |= static_cast<uint8_t>(((value >> b) & 1) << (bit % 8));
+            }
+        }
+        i = std::min(end, n);
+    }
+}
+
+} // namespace parquet_detail
+
+class ParquetWriter {
+public:
+    ParquetWriter(std::vector<ParquetColumnSpec> columns, ParquetCompression compression = ParquetCompression::ZSTD,
+                  int level = 3, std::size_t row_group_size = PARQUET_DEFAULT_ROW_GROUP_SIZE)
+        : compression_(compression), level_(level), row_group_size_(row_group_size) {
+        if (columns.empty()) {
+            throw std::runtime_error("ParquetWriter: at least one column is required");
+        }
+        if (row_group_size_ == 0) {
+            throw std::runtime_error("ParquetWriter: row_group_size must be positive");
+        }
+        for (ParquetColumnSpec &spec : columns) {
+            if (spec.name.empty()) {
+                throw std::runtime_error("ParquetWriter: column names must not be empty");
+            }
+            if (find(spec.name) != nullptr) {
+                throw std::runtime_error("ParquetWriter: duplicate column '" + spec.name + "'");
+            }
+            Column column;
+            column.spec = std::move(spec);
+            columns_.push_back(std::move(column));
+        }
+        if (compression_ == ParquetCompression::ZSTD) {
+            zstd_.reset(ZSTD_createCCtx());
+            if (!zstd_) {
+                throw std::runtime_error("ParquetWriter: out of memory");
+            }
+            record_codec_detail::check(ZSTD_CCtx_setParameter(zstd_.get(), ZSTD_c_compressionLevel, level_),
+                                       "ParquetWriter");
+        }
+    }
+
+    std::size_t column_count() const { return columns_.size(); }
+    const ParquetColumnSpec &spec(std::size_t column) const { return columns_[column].spec; }
+
+    // Index of the column called `name`; throws when there is none
+    std::size_t column_index(std::string_view name) const {
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            if (columns_[i].spec.name == name) {
+                return i;
+            }
+        }
+        throw std::runtime_error("ParquetWriter: no column '" + std::string(name) + "'");
+    }
+
+    // Appenders for one column; callers append the same number of values to
+    // every column before finish(). int64 serves INT64 and TIMESTAMP_MS.
+    void append_int64(std::size_t column, int64_t value) { columns_[column].ints.push_back(value); }
+    void append_float64(std::size_t column, double value) { columns_[column].doubles.push_back(value); }
+    void append_bool(std::size_t column, bool value) { columns_[column].flags.push_back(value ? 1 : 0); }
+    void append_string(std::size_t column, std::string_view value) {
+        Column &col = columns_[column];
+        auto [it, inserted] = col.string_ids.try_emplace(std::string(value), static_cast<uint32_t>(col.strings.size()));
+        if (inserted) {
+            col.strings.push_back(it->first);
+        }
+        col.codes.push_back(it->second);
+    }
+    void append_int64s(std::size_t column, std::span<const int64_t> values) {
+        columns_[column].ints.insert(columns_[column].ints.end(), values.begin(), values.end());
+    }
+    void append_float64s(std::size_t column, std::span<const double> values) {
+        columns_[column].doubles.insert(columns_[column].doubles.end(), values.begin(), values.end());
+    }
+    void append_bools(std::size_t column, std::span<const uint8_t> values) {
+        for (const uint8_t value : values) {
+            columns_[column].flags.push_back(value != 0 ? 1 : 0);
+        }
+    }
+
+    // Values buffered in `column`
+    std::size_t column_size(std::size_t column) const {
+        const Column &col = columns_[column];
+        switch (col.spec.type) {
+        case ParquetType::INT64:
+        case ParquetType::TIMESTAMP_MS:
+            return col.ints.size();
+        case ParquetType::FLOAT64:
+            return col.doubles.size();
+        case ParquetType::BOOL:
+            return col.flags.size();
+        case ParquetType::STRING:
+            return col.codes.size();
+        }
+        return 0;
+    }
+
+    // Rows buffered, i.e. values in the shortest column
+    std::size_t rows() const {
+        std::size_t rows = std::numeric_limits<std::size_t>::max();
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            rows = std::min(rows, column_size(i));
+        }
+        return rows;
+    }
+
+    // Drop values past the first `rows` of every column, e.g. to undo a
+    // partly appended row
+    void truncate(std::size_t rows) {
+        for (Column &col : columns_) {
+            col.ints.resize(std::min(col.ints.size(), rows));
+            col.doubles.resize(std::min(col.doubles.size(), rows));
+            col.flags.resize(std::min(col.flags.size(), rows));
+            col.codes.resize(std::min(col.codes.size(), rows));
+        }
+    }
+
+    void clear() {
+        for (Column &col : columns_) {
+            col.ints.clear();
+            col.doubles.clear();
+            col.flags.clear();
+            col.codes.clear();
+            col.strings.clear();
+            col.string_ids.clear();
+        }
+    }
+
+    // The Parquet file of every buffered row, in row groups of at most
+    // row_group_size rows; the writer is empty again afterwards. Throws,
+    // keeping the rows, when columns hold different numbers of values.
+    std::vector<char> finish() {
+        using namespace parquet_detail;
+        const std::size_t rows = this->rows();
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            if (column_size(i) != rows) {
+                throw std::runtime_error("ParquetWriter: column '" + columns_[i].spec.name + "' has " +
+                                         std::to_string(column_size(i)) + " values for " + std::to_string(rows) +
+                                         " rows");
+            }
+        }
+
+        std::vector<char> file = {'P', 'A', 'R', '1'};
+        std::vector<RowGroup> groups;
+        for (std::size_t first = 0; first < rows; first += row_group_size_) {
+            const std::size_t count = std::min(row_group_size_, rows - first);
+            RowGroup group{static_cast<int64_t>(file.size()), static_cast<int64_t>(count), 0, 0, {}};
+            for (const Column &col : columns_) {
+                ChunkMeta chunk = write_chunk(col, first, count, file);
+                group.uncompressed += chunk.uncompressed;
+                group.compressed += chunk.compressed;
+                group.chunks.push_back(std::move(chunk));
+            }
+            groups.push_back(std::move(group));
+        }
+
+        const std::size_t footer_start = file.size();
+        write_footer(groups, static_cast<int64_t>(rows), file);
+        append_le<uint32_t>(file, static_cast<uint32_t>(file.size() - footer_start));
+        file.insert(file.end(), {'P', 'A', 'R', '1'});
+        clear();
+        return file;
+    }
+
+    ParquetCompression compression() const { return compression_; }
+    int level() const { return level_; }
+    std::size_t row_group_size() const { return row_group_size_; }
+
+private:
+    struct Column {
+        ParquetColumnSpec spec;
+        std::vector<int64_t> ints;
+        std::vector<double> doubles;
+        std::vector<uint8_t> flags;
+        // Strings are interned as they arrive; each row group re-indexes the
+        // ones it uses
+        std::vector<uint32_t> codes;
+        std::vector<std::string> strings;
+        std::unordered_map<std::string, uint32_t> string_ids;
+    };
+
+    struct ChunkMeta {
+        int64_t dictionary_offset = -1;
+        int64_t data_offset = 0;
+        int64_t uncompressed = 0;
+        int64_t compressed = 0;
+        std::vector<int32_t> encodings;
+        std::string min;
+        std::string max;
+        bool has_stats = false;
+    };
+
+    struct RowGroup {
+        int64_t offset;
+        int64_t rows;
+        int64_t uncompressed;
+        int64_t compressed;
+        std::vector<ChunkMeta> chunks;
+    };
+
+    const ParquetColumnSpec *find(std::string_view name) const {
+        for (const Column &col : columns_) {
+            if (col.spec.name == name) {
+                return &col.spec;
+            }
+        }
+        return nullptr;
+    }
+
+    static parquet_detail::PhysicalType physical_type(ParquetType type) {
+        switch (type) {
+        case ParquetType::FLOAT64:
+            return parquet_detail::DOUBLE;
+        case ParquetType::BOOL:
+            return parquet_detail::BOOLEAN;
+        case ParquetType::STRING:
+            return parquet_detail::BYTE_ARRAY;
+        default:
+            return parquet_detail::INT64;
+        }
+    }
+
+    template <typename T>
+    static std::string plain_bytes(T value) {
+        std::string bytes(sizeof(T), '\0');
+        std::memcpy(bytes.data(), &value, sizeof(T));
+        return bytes;
+    }
+
+    // Dictionary of the 8-byte values of [first, first + count), keyed by
+    // bit pattern: false when it would not pay (or not fit)
+    template <typename T>
+    static bool build_dictionary(std::span<const T> values, std::vector<T> &dictionary,
+                                 std::vector<uint32_t> &indices) {
+        std::unordered_map<uint64_t, uint32_t> ids;
+        const std::size_t limit = std::min(values.size() / 2, PARQUET_DICTIONARY_LIMIT / sizeof(T));
+        indices.reserve(values.size());
+        for (const T value : values) {
+            const auto bits = std::bit_cast<uint64_t>(value);
+            auto [it, inserted] = ids.try_emplace(bits, static_cast<uint32_t>(dictionary.size()));
+            if (inserted) {
+                if (dictionary.size() >= limit) {
+                    return false;
+                }
+                dictionary.push_back(value);
+            }
+            indices.push_back(it->second);
+        }
+        return true;
+    }
+
+    // Page header plus the (compressed) page body, appended to `file`
+    void write_page(parquet_detail::PageType type, int32_t values, parquet_detail::Encoding encoding,
+                    const std::vector<char> &body, std::vector<char> &file, ChunkMeta &chunk) {
+        using namespace parquet_detail;
+        std::span<const char> payload = body;
+        if (compression_ == ParquetCompression::ZSTD) {
+            scratch_.resize(ZSTD_compressBound(body.size()));
+            const std::size_t size = record_codec_detail::check(
+                ZSTD_compress2(zstd_.get(), scratch_.data(), scratch_.size(), body.data(), body.size()),
+                "ParquetWriter");
+            payload = std::span<const char>(scratch_.data(), size);
+        }
+        if (body.size() > static_cast<std::size_t>(std::numeric_limits<int32_t>::max())) {
+            throw std::runtime_error("ParquetWriter: page over 2 GiB; lower row_group_size");
+        }
+
+        const std::size_t header_start = file.size();
+        CompactWriter header(file);
+        header.begin_struct();
+        header.i32(1, type);
+        header.i32(2, static_cast<int32_t>(body.size()));
+        header.i32(3, static_cast<int32_t>(payload.size()));
+        if (type == DATA_PAGE) {
+            header.struct_field(5);
+            header.i32(1, values);
+            header.i32(2, encoding);
+            header.i32(3, RLE);
+            header.i32(4, RLE);
+            header.end_struct();
+        } else {
+            header.struct_field(7);
+            header.i32(1, values);
+            header.i32(2, encoding);
+            header.end_struct();
+        }
+        header.end_struct();
+        const auto header_size = static_cast<int64_t>(file.size() - header_start);
+        file.insert(file.end(), payload.begin(), payload.end());
+        chunk.uncompressed += header_size + static_cast<int64_t>(body.size());
+        chunk.compressed += header_size + static_cast<int64_t>(payload.size());
+    }
+
+    // Dictionary page plus RLE_DICTIONARY data page
+    void write_dictionary_pages(const std::vector<char> &dictionary, std::size_t entries,
+                                std::span<const uint32_t> indices, std::vector<char> &file, ChunkMeta &chunk) {
+        using namespace parquet_detail;
+        chunk.dictionary_offset = static_cast<int64_t>(file.size());
+        write_page(DICTIONARY_PAGE, static_cast<int32_t>(entries), PLAIN, dictionary, file, chunk);
+        chunk.data_offset = static_cast<int64_t>(file.size());
+        const int bit_width = std::max(1, static_cast<int>(std::bit_width(entries - 1)));
+        body_.assign(1, static_cast<char>(bit_width));
+        encode_indices(indices, bit_width, body_);
+        write_page(DATA_PAGE, static_cast<int32_t>(indices.size()), RLE_DICTIONARY, body_, file, chunk);
+        chunk.encodings = {PLAIN, RLE, RLE_DICTIONARY};
+    }
+
+    void write_plain_page(std::size_t count, std::vector<char> &file, ChunkMeta &chunk) {
+        using namespace parquet_detail;
+        chunk.data_offset = static_cast<int64_t>(file.size());
+        write_page(DATA_PAGE, static_cast<int32_t>(count), PLAIN, body_, file, chunk);
+        chunk.encodings = {PLAIN};
+    }
+
+    template <typename T>
+    void write_fixed_chunk(std::span<const T> values, std::vector<char> &file, ChunkMeta &chunk) {
+        using namespace parquet_detail;
+        bool have_stats = !values.empty();
+        T lo = have_stats ? values[0] : T{};
+        T hi = lo;
+        for (const T value : values) {
+            if constexpr (std::is_floating_point_v<T>) {
+                // By bits: the extension builds with -ffast-math
+                if ((std::bit_cast<uint64_t>(value) & ~(uint64_t{1} << 63)) > 0x7FF0000000000000ULL) {
+                    have_stats = false;
+                    break;
+                }
+            }
+            lo = std::min(lo, value);
+            hi = std::max(hi, value);
+        }
+        if (have_stats) {
+            chunk.has_stats = true;
+            chunk.min = plain_bytes(lo);
+            chunk.max = plain_bytes(hi);
+        }
+
+        std::vector<T> dictionary;
+        indices_.clear();
+        if (build_dictionary(values, dictionary, indices_)) {
+            std::vector<char> page(dictionary.size() * sizeof(T));
+            std::memcpy(page.data(), dictionary.data(), page.size());
+            write_dictionary_pages(page, dictionary.size(), indices_, file, chunk);
+            return;
+        }
+        body_.resize(values.size() * sizeof(T));
+        std::memcpy(body_.data(), values.data(), body_.size());
+        write_plain_page(values.size(), file, chunk);
+    }
+
+    void write_string_chunk(const Column &col, std::size_t first, std::size_t count, std::vector<char> &file,
+                            ChunkMeta &chunk) {
+        using namespace parquet_detail;
+        // Row-group-local dictionary, in order of first use
+        std::vector<uint32_t> local(col.strings.size(), UINT32_MAX);
+        std::vector<uint32_t> used;
+        std::size_t dictionary_bytes = 0;
+        indices_.clear();
+        indices_.reserve(count);
+        for (std::size_t row = first; row < first + count; ++row) {
+            const uint32_t code = col.codes[row];
+            if (local[code] == UINT32_MAX) {
+                local[code] = static_cast<uint32_t>(used.size());
+                used.push_back(code);
+                dictionary_bytes += 4 + col.strings[code].size();
+            }
+            indices_.push_back(local[code]);
+        }
+        if (!used.empty()) {
+            chunk.has_stats = true;
+            chunk.min = chunk.max = col.strings[used[0]];
+            for (const uint32_t code : used) {
+                chunk.min = std::min(chunk.min, col.strings[code]);
+                chunk.max = std::max(chunk.max, col.strings[code]);
+            }
+        }
+
+        const auto plain_string = [](std::vector<char> &out, const std::string &value) {
+            append_le<uint32_t>(out, static_cast<uint32_t>(value.size()));
+            out.insert(out.end(), value.begin(), value.end());
+        };
+        if (!used.empty() && dictionary_bytes <= PARQUET_DICTIONARY_LIMIT) {
+            std::vector<char> page;
+            page.reserve(dictionary_bytes);
+            for (const uint32_t code : used) {
+                plain_string(page, col.strings[code]);
+            }
+            write_dictionary_pages(page, used.size(), indices_, file, chunk);
+            return;
+        }
+        body_.clear();
+        for (std::size_t row = first; row < first + count; ++row) {
+            plain_string(body_, col.strings[col.codes[row]]);
+        }
+        write_plain_page(count, file, chunk);
+    }
+
+    ChunkMeta write_chunk(const Column &col, std::size_t first, std::size_t count, std::vector<char> &file) {
+        ChunkMeta chunk;
+        switch (col.spec.type) {
+        case ParquetType::INT64:
+        case ParquetType::TIMESTAMP_MS:
+            write_fixed_chunk<int64_t>(std::span<const int64_t>(col.ints).subspan(first, count), file, chunk);
+            break;
+        case ParquetType::FLOAT64:
+            write_fixed_chunk<double>(std::span<const double>(col.doubles).subspan(first, count), file, chunk);
+            break;
+        case ParquetType::BOOL:
+            body_.assign((count + 7) / 8, 0);
+            for (std::size_t i = 0; i < count; ++i) {
+                body_[i / 8] = static_cast<char>(body_[i / 8] | col.flags[first + i] << (i % 8));
+            }
+            write_plain_page(count, file, chunk);
+            break;
+        case ParquetType::STRING:
+            write_string_chunk(col, first, count, file, chunk);
+            break;
+        }
+        return chunk;
+    }
+
+    void write_footer(const std::vector<RowGroup> &groups, int64_t rows, std::vector<char> &file) const {
+        using namespace parquet_detail;
+        CompactWriter meta(file);
+        meta.begin_struct();
+        meta.i32(1, 1);
+        meta.list(2, CompactWriter::STRUCT, columns_.size() + 1);
+        meta.begin_struct();
+        meta.binary(4, "schema");
+        meta.i32(5, static_cast<int32_t>(columns_.size()));
+        meta.end_struct();
+        for (const Column &col : columns_) {
+            meta.begin_struct();
+            meta.i32(1, physical_type(col.spec.type));
+            meta.i32(3, REQUIRED);
+            meta.binary(4, col.spec.name);
+            if (col.spec.type == ParquetType::STRING) {
+                meta.i32(6, UTF8);
+                meta.struct_field(10);
+                meta.struct_field(1); // StringType
+                meta.end_struct();
+                meta.end_struct();
+            } else if (col.spec.type == ParquetType::TIMESTAMP_MS) {
+                meta.i32(6, TIMESTAMP_MILLIS);
+                meta.struct_field(10);
+                meta.struct_field(8); // TimestampType
+                meta.boolean(1, true);
+                meta.struct_field(2); // TimeUnit
+                meta.struct_field(1); // MilliSeconds
+                meta.end_struct();
+                meta.end_struct();
+                meta.end_struct();
+                meta.end_struct();
+            }
+            meta.end_struct();
+        }
+        meta.i64(3, rows);
+        meta.list(4, CompactWriter::STRUCT, groups.size());
+        for (const RowGroup &group : groups) {
+            meta.begin_struct();
+            meta.list(1, CompactWriter::STRUCT, group.chunks.size());
+            for (std::size_t i = 0; i < group.chunks.size(); ++i) {
+                const ChunkMeta &chunk = group.chunks[i];
+                const Column &col = columns_[i];
+                meta.begin_struct();
+                meta.i64(2, chunk.dictionary_offset >= 0 ? chunk.dictionary_offset : chunk.data_offset);
+                meta.struct_field(3);
+                meta.i32(1, physical_type(col.spec.type));
+                meta.list(2, CompactWriter::I32, chunk.encodings.size());
+                for (const int32_t encoding : chunk.encodings) {
+                    meta.i32_value(encoding);
+                }
+                meta.list(3, CompactWriter::BINARY, 1);
+                meta.binary_value(col.spec.name);
+                meta.i32(4, compression_ == ParquetCompression::ZSTD ? ZSTD : UNCOMPRESSED);
+                meta.i64(5, group.rows);
+                meta.i64(6, chunk.uncompressed);
+                meta.i64(7, chunk.compressed);
+                meta.i64(9, chunk.data_offset);
+                if (chunk.dictionary_offset >= 0) {
+                    meta.i64(11, chunk.dictionary_offset);
+                }
+                if (chunk.has_stats) {
+                    meta.struct_field(12);
+                    meta.i64(3, 0);
+                    meta.binary(5, chunk.max);
+                    meta.binary(6, chunk.min);
+                    meta.end_struct();
+                }
+                meta.end_struct();
+                meta.end_struct();
+            }
+            meta.i64(2, group.uncompressed);
+            meta.i64(3, group.rows);
+            meta.i64(5, group.offset);
+            meta.i64(6, group.compressed);
+            meta.end_struct();
+        }
+        meta.binary(6, "sbe_decoder_cpp version 1.0.0");
+        // TypeDefinedOrder for every column, so readers trust min/max
+        meta.list(7, CompactWriter::STRUCT, columns_.size());
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            meta.begin_struct();
+            meta.struct_field(1);
+            meta.end_struct();
+            meta.end_struct();
+        }
+        meta.end_struct();
+    }
+
+    std::vector<Column> columns_;
+    ParquetCompression compression_;
+    int level_;
+    std::size_t row_group_size_;
+    record_codec_detail::ZstdPtr<ZSTD_CCtx> zstd_;
+    std::vector<char> body_;
+    std::vector<char> scratch_;
+    std::vector<uint32_t> indices_;
+};
+
+#endif
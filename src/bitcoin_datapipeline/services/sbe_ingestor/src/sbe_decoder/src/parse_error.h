@@ -0,0 +1,62 @@
+/*
+ * Why a stream frame failed to parse.
+ *
+ * The stream parsers (stream_decode.h) return a ParseError instead of
+ * throwing. Each value names the first check a malformed frame failed, so
+ * the decoder statistics, batch error columns and ring error records can
+ * break parse errors down by cause without carrying a message string.
+ */
+
+#ifndef _SBE_PARSE_ERROR_H_
+#define _SBE_PARSE_ERROR_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "spot_stream/StreamCodec.h"
+
+// Why a stream parser rejected a frame body. The first five mirror
+// spot_stream::DecodeError; stats and metrics break parse errors down by it.
+enum class ParseError : uint8_t {
+    None = 0,
+    ShortBlock,     // body shorter than the fixed block
+    GroupHeader,    // a group's dimensions run past the body
+    GroupEntrySize, // a group's entries are shorter than the schema allows
+    GroupOverrun,   // a group's entries run past the body
+    SymbolOverrun,  // the symbol runs past the body
+    EmptyTrades,    // a trade event without trades
+    Rejected,       // a REST response the generated codec refused
+    ShortHeader,    // frame shorter than the 8-byte message header
+    Count,
+};
+
+static_assert(static_cast<uint8_t>(ParseError::ShortBlock) ==
+              static_cast<uint8_t>(spot_stream::DecodeError::ShortBlock));
+static_assert(static_cast<uint8_t>(ParseError::SymbolOverrun) ==
+              static_cast<uint8_t>(spot_stream::DecodeError::VarDataOverrun));
+
+constexpr std::size_t PARSE_ERROR_COUNT = static_cast<std::size_t>(ParseError::Count);
+
+// Stats keys and metric labels, in ParseError order
+constexpr std::array<const char *, PARSE_ERROR_COUNT> PARSE_ERROR_NAMES = {
+    "none", "short_block", "group_header", "group_entry_size", "group_overrun", "symbol_overrun",
+    "empty_trades", "rejected", "short_header",
+};
+
+inline const char *parse_error_name(ParseError error) noexcept {
+    return PARSE_ERROR_NAMES[static_cast<std::size_t>(error)];
+}
+
+inline ParseError to_parse_error(spot_stream::DecodeError error) noexcept {
+    return static_cast<ParseError>(error);
+}
+
+// For callers off the hot path that report errors by exception
+[[noreturn, gnu::cold]] inline void throw_parse_error(ParseError error, const char *what) {
+    throw std::runtime_error(std::string("SBE ") + what + " decode: " + parse_error_name(error));
+}
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * Hardware performance counters around decode (Linux perf_event_open).
+ *
+ * A PerfCounters opens one counter group on the calling thread: cycles (the
+ * leader), instructions, branch misses, L1D read misses and last-level
+ * cache misses, user space only, so it works at the default
+ * perf_event_paranoid of 2 without privileges. Reading the group is one
+ * read() of every counter at once. The decoder reads it before and after a
+ * sampled frame and adds the difference to that template's statistics
+ * (decode_stats.h). That gives IPC and misses per message per template,
+ * i.e. whether a template's decode is branch- or cache-bound.
+ *
+ * A read costs a syscall, so only every Nth frame is sampled. A counter the
+ * kernel or hypervisor does not offer (LLC misses on many VMs) is left out
+ * of the group and reads as zero. If the leader cannot be opened (seccomp,
+ * paranoid 3, non-Linux), is_open() is false and error() says why. When
+ * the kernel multiplexed the group during a sample, the sample is dropped
+ * rather than scaled.
+ */
+
+#ifndef _SBE_PERF_COUNTERS_H_
+#define _SBE_PERF_COUNTERS_H_
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum PerfEvent : std::size_t {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_EVENT_COUNT,
+};
+
+// Stats and metric names, in PerfEvent order
+constexpr std::array<const char *, PERF_EVENT_COUNT> PERF_EVENT_NAMES = {
+    "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses",
+};
+
+struct PerfReading {
+    std::array<uint64_t, PERF_EVENT_COUNT> values{};
+    // Group time enabled and running; they differ once the kernel multiplexes
+    uint64_t time_enabled = 0;
+    uint64_t time_running = 0;
+};
+
+// `end - start` per counter; false if the group was not running the whole
+// time in between
+inline bool perf_delta(const PerfReading &start, const PerfReading &end, PerfReading &delta) {
+    delta.time_enabled = end.time_enabled - start.time_enabled;
+    delta.time_running = end.time_running - start.time_running;
+    if (delta.time_running != delta.time_enabled) {
+        return false;
+    }
+    for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+        delta.values[i] = end.values[i] - start.values[i];
+    }
+    return true;
+}
+
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    ~PerfCounters() { close(); }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Open and start the group on the calling thread; false (see error())
+    // if the kernel refuses the leader
+    bool open() {
+        close();
+#if defined(__linux__)
+        const std::array<std::pair<uint32_t, uint64_t>, PERF_EVENT_COUNT> events = {{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        }};
+        for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.disabled = i == PERF_CYCLES ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            const int group = i == PERF_CYCLES ? -1 : fds_[PERF_CYCLES];
+            const int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+            if (fd < 0) {
+                if (i == PERF_CYCLES) {
+                    error_ = std::string("perf_event_open: ") + std::strerror(errno);
+                    return false;
+                }
+                continue;
+            }
+            fds_[i] = fd;
+            slot_[members_++] = i;
+        }
+        ::ioctl(fds_[PERF_CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ::ioctl(fds_[PERF_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        thread_ = std::this_thread::get_id();
+        return true;
+#else
+        error_ = "perf_event_open is Linux-only";
+        return false;
+#endif
+    }
+
+    bool is_open() const { return fds_[PERF_CYCLES] >= 0; }
+    // The group only counts the thread that opened it
+    bool on_this_thread() const { return is_open() && thread_ == std::this_thread::get_id(); }
+    const std::string &error() const { return error_; }
+    // Whether the kernel offered `event`
+    bool has(PerfEvent event) const { return fds_[event] >= 0; }
+
+    bool read(PerfReading &out) const {
+#if defined(__linux__)
+        // nr, time_enabled, time_running, then one value per member
+        std::array<uint64_t, 3 + PERF_EVENT_COUNT> buffer{};
+        const ssize_t got = ::read(fds_[PERF_CYCLES], buffer.data(), sizeof(buffer));
+        if (got < static_cast<ssize_t>(3 * sizeof(uint64_t)) || buffer[0] != members_) {
+            return false;
+        }
+        out.time_enabled = buffer[1];
+        out.time_running = buffer[2];
+        for (std::size_t m = 0; m < members_; ++m) {
+            out.values[slot_[m]] = buffer[3 + m];
+        }
+        return true;
+#else
+        (void)out;
+        return false;
+#endif
+    }
+
+    void close() {
+#if defined(__linux__)
+        // Members first, then the leader
+        for (std::size_t i = PERF_EVENT_COUNT; i-- > 0;) {
+            if (fds_[i] >= 0) {
+                ::close(fds_[i]);
+            }
+        }
+#endif
+        fds_.fill(-1);
+        members_ = 0;
+    }
+
+private:
+    std::array<int, PERF_EVENT_COUNT> fds_{-1, -1, -1, -1, -1};
+    // PerfEvent of each group member, in read order
+    std::array<std::size_t, PERF_EVENT_COUNT> slot_{};
+    std::size_t members_ = 0;
+    std::thread::id thread_;
+    std::string error_;
+};
+
+#endif
@@ -0,0 +1,373 @@
+/*
+ * PostgreSQL binary COPY encoding.
+ *
+ * DatabaseWriter used to send one INSERT per record. PgCopyWriter encodes a
+ * whole batch in the COPY BINARY format instead (signature, flags and
+ * extension header, then per row an int16 field count and each field as an
+ * int32 length, -1 for NULL, followed by its big-endian binary value; an
+ * int16 -1 trailer), so the batch goes to the server in a single
+ * copy_to_table call.
+ *
+ * NUMERIC is encoded exactly from decimal text (Python Decimal's str(),
+ * exponent form included) or from a mantissa and power-of-ten exponent:
+ * base-10000 digit groups with weight, sign and display scale, as
+ * numeric_send writes them. Doubles go through their shortest round-trip
+ * text, so 0.1 stays 0.1. TIMESTAMP (without time zone) values are wall
+ * clock microseconds since the Unix epoch and are rebased to 2000-01-01.
+ */
+
+#ifndef _SBE_PG_COPY_H_
+#define _SBE_PG_COPY_H_
+
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "float_bits.h"
+
+enum class PgType : uint8_t { INT8, INT4, BOOL, TEXT, NUMERIC, TIMESTAMP };
+
+struct PgColumnSpec {
+    std::string name;
+    PgType type = PgType::TEXT;
+};
+
+inline PgType pg_type_from_name(std::string_view name) {
+    if (name == "int8" || name == "bigint") {
+        return PgType::INT8;
+    }
+    if (name == "int4" || name == "integer") {
+        return PgType::INT4;
+    }
+    if (name == "bool" || name == "boolean") {
+        return PgType::BOOL;
+    }
+    if (name == "text" || name == "varchar") {
+        return PgType::TEXT;
+    }
+    if (name == "numeric" || name == "decimal") {
+        return PgType::NUMERIC;
+    }
+    if (name == "timestamp") {
+        return PgType::TIMESTAMP;
+    }
+    throw std::runtime_error("pg_copy: unknown column type '" + std::string(name) + "'");
+}
+
+inline const char *pg_type_name(PgType type) {
+    switch (type) {
+    case PgType::INT8:
+        return "int8";
+    case PgType::INT4:
+        return "int4";
+    case PgType::BOOL:
+        return "bool";
+    case PgType::TEXT:
+        return "text";
+    case PgType::NUMERIC:
+        return "numeric";
+    case PgType::TIMESTAMP:
+        return "timestamp";
+    }
+    return "text";
+}
+
+// Microseconds from the Unix epoch to PostgreSQL's 2000-01-01
+constexpr int64_t PG_EPOCH_OFFSET_US = 946684800LL * 1000000;
+
+namespace pg_copy_detail {
+
+constexpr char SIGNATURE[] = "PGCOPY\n\377\r\n";  // 11 bytes with the NUL
+
+constexpr uint16_t NUMERIC_POS = 0x0000;
+constexpr uint16_t NUMERIC_NEG = 0x4000;
+constexpr uint16_t NUMERIC_NAN = 0xC000;
+
+// Base-10000 digit groups of `digits` * 10^exponent (digits: ASCII 0-9,
+// no sign)
+struct NumericValue {
+    std::vector<int16_t> groups;
+    int16_t weight = 0;
+    uint16_t sign = NUMERIC_POS;
+    int16_t dscale = 0;
+};
+
+inline void numeric_from_digits(std::string_view digits, int exponent, bool negative, NumericValue &out) {
+    out.groups.clear();
+    out.weight = 0;
+    out.sign = negative ? NUMERIC_NEG : NUMERIC_POS;
+    out.dscale = static_cast<int16_t>(exponent < 0 ? -exponent : 0);
+    if (exponent > 4096 || exponent < -16383) {
+        throw std::runtime_error("pg_copy: numeric exponent out of range");
+    }
+
+    while (!digits.empty() && digits.front() == '0') {
+        digits.remove_prefix(1);
+    }
+    if (digits.empty()) {
+        out.sign = NUMERIC_POS;
+        return;
+    }
+
+    // Place the digits on a grid whose decimal point falls on a group
+    // boundary: int_len integer digits, frac fraction digits, both padded to
+    // multiples of four
+    const int frac = exponent < 0 ? -exponent : 0;
+    const int trailing_zeros = exponent > 0 ? exponent : 0;
+    const int total = static_cast<int>(digits.size()) + trailing_zeros;
+    const int int_len = total > frac ? total - frac : 0;
+    const int int_pad = (4 - int_len % 4) % 4;
+    const int lead_pad = int_pad + (total < frac ? frac - total : 0);
+    const int tail_pad = (4 - frac % 4) % 4;
+    const int cells = lead_pad + total + tail_pad;
+
+    const auto digit_at = [&](int cell) -> int {
+        const int i = cell - lead_pad;
+        return i >= 0 && i < static_cast<int>(digits.size()) ? digits[static_cast<std::size_t>(i)] - '0' : 0;
+    };
+    int weight = (int_pad + int_len) / 4 - 1;
+    bool leading = true;
+    for (int cell = 0; cell < cells; cell += 4) {
+        const int group = digit_at(cell) * 1000 + digit_at(cell + 1) * 100 + digit_at(cell + 2) * 10 + digit_at(cell + 3);
+        if (leading && group == 0) {
+            --weight;
+            continue;
+        }
+        leading = false;
+        out.groups.push_back(static_cast<int16_t>(group));
+    }
+    while (!out.groups.empty() && out.groups.back() == 0) {
+        out.groups.pop_back();
+    }
+    out.weight = static_cast<int16_t>(weight);
+}
+
+// Decimal text: [+-]digits[.digits][(e|E)[+-]digits], or NaN
+inline void numeric_from_text(std::string_view text, NumericValue &out, std::string &scratch) {
+    if (text == "NaN" || text == "nan" || text == "sNaN") {
+        out.groups.clear();
+        out.weight = 0;
+        out.sign = NUMERIC_NAN;
+        out.dscale = 0;
+        return;
+    }
+    bool negative = false;
+    if (!text.empty() && (text.front() == '-' || text.front() == '+')) {
+        negative = text.front() == '-';
+        text.remove_prefix(1);
+    }
+    scratch.clear();
+    int exponent = 0;
+    bool point = false;
+    std::size_t i = 0;
+    for (; i < text.size(); ++i) {
+        const char c = text[i];
+        if (c >= '0' && c <= '9') {
+            scratch.push_back(c);
+            exponent -= point ? 1 : 0;
+        } else if (c == '.' && !point) {
+            point = true;
+        } else {
+            break;
+        }
+    }
+    if (scratch.empty()) {
+        throw std::runtime_error("pg_copy: invalid numeric '" + std::string(text) + "'");
+    }
+    if (i < text.size()) {
+        if (text[i] != 'e' && text[i] != 'E') {
+            throw std::runtime_error("pg_copy: invalid numeric '" + std::string(text) + "'");
+        }
+        std::string_view rest = text.substr(i + 1);
+        if (!rest.empty() && rest.front() == '+') {
+            rest.remove_prefix(1);
+        }
+        int power = 0;
+        const auto [ptr, ec] = std::from_chars(rest.data(), rest.data() + rest.size(), power);
+        if (ec != std::errc() || ptr != rest.data() + rest.size() || rest.empty()) {
+            throw std::runtime_error("pg_copy: invalid numeric '" + std::string(text) + "'");
+        }
+        exponent += power;
+    }
+    numeric_from_digits(scratch, exponent, negative, out);
+}
+
+} // namespace pg_copy_detail
+
+class PgCopyWriter {
+public:
+    explicit PgCopyWriter(std::vector<PgColumnSpec> columns) : specs_(std::move(columns)) {
+        if (specs_.empty() || specs_.size() > 1600) {
+            throw std::runtime_error("PgCopyWriter: between 1 and 1600 columns");
+        }
+        start();
+    }
+
+    const std::vector<PgColumnSpec> &columns() const { return specs_; }
+    const PgColumnSpec &spec(std::size_t column) const { return specs_[column]; }
+    std::size_t column_count() const { return specs_.size(); }
+    std::size_t rows() const { return rows_; }
+    std::size_t size() const { return buffer_.size(); }
+
+    // Start a row; every column must then be written once, in order
+    void begin_row() {
+        if (field_ != specs_.size()) {
+            throw std::runtime_error("PgCopyWriter: previous row is incomplete");
+        }
+        put<int16_t>(static_cast<int16_t>(specs_.size()));
+        field_ = 0;
+        ++rows_;
+    }
+
+    void null() {
+        next();
+        put<int32_t>(-1);
+    }
+
+    void int8(int64_t value) {
+        next(PgType::INT8);
+        put<int32_t>(8);
+        put<int64_t>(value);
+    }
+
+    void int4(int32_t value) {
+        next(PgType::INT4);
+        put<int32_t>(4);
+        put<int32_t>(value);
+    }
+
+    void boolean(bool value) {
+        next(PgType::BOOL);
+        put<int32_t>(1);
+        buffer_.push_back(value ? 1 : 0);
+    }
+
+    void text(std::string_view value) {
+        next(PgType::TEXT);
+        put<int32_t>(static_cast<int32_t>(value.size()));
+        buffer_.insert(buffer_.end(), value.begin(), value.end());
+    }
+
+    // Wall clock microseconds since the Unix epoch
+    void timestamp_us(int64_t unix_us) {
+        next(PgType::TIMESTAMP);
+        put<int32_t>(8);
+        put<int64_t>(unix_us - PG_EPOCH_OFFSET_US);
+    }
+
+    void numeric_text(std::string_view value) {
+        pg_copy_detail::numeric_from_text(value, numeric_, scratch_);
+        put_numeric();
+    }
+
+    // mantissa * 10^exponent, exactly
+    void numeric(int64_t mantissa, int exponent) {
+        char digits[24];
+        const uint64_t magnitude = mantissa < 0 ? 0 - static_cast<uint64_t>(mantissa) : static_cast<uint64_t>(mantissa);
+        const auto result = std::to_chars(digits, digits + sizeof(digits), magnitude);
+        pg_copy_detail::numeric_from_digits(std::string_view(digits, static_cast<std::size_t>(result.ptr - digits)),
+                                            exponent, mantissa < 0, numeric_);
+        put_numeric();
+    }
+
+    // A double by its shortest round-trip text; NaN stays NaN
+    void numeric_double(double value) {
+        char text[32];
+        const auto result = std::to_chars(text, text + sizeof(text), value);
+        const std::string_view shortest(text, static_cast<std::size_t>(result.ptr - text));
+        if (nan_bits(value)) {
+            numeric_text("NaN");
+        } else if (shortest == "inf" || shortest == "-inf") {
+            throw std::runtime_error("pg_copy: numeric cannot hold infinity");
+        } else {
+            numeric_text(shortest);
+        }
+    }
+
+    // The COPY data of every row so far, then start over
+    std::vector<char> finish() {
+        if (field_ != specs_.size()) {
+            throw std::runtime_error("PgCopyWriter: last row is incomplete");
+        }
+        put<int16_t>(-1);
+        std::vector<char> out;
+        out.swap(buffer_);
+        start();
+        return out;
+    }
+
+    // Back to an earlier size() and rows(), dropping a partly written batch
+    void truncate(std::size_t size, std::size_t rows) {
+        buffer_.resize(size);
+        rows_ = rows;
+        field_ = specs_.size();
+    }
+
+    // Drop everything buffered
+    void clear() { start(); }
+
+private:
+    void start() {
+        buffer_.clear();
+        buffer_.insert(buffer_.end(), pg_copy_detail::SIGNATURE, pg_copy_detail::SIGNATURE + 11);
+        put<int32_t>(0);  // flags: no OIDs
+        put<int32_t>(0);  // header extension length
+        rows_ = 0;
+        field_ = specs_.size();
+    }
+
+    // Advance to the next field (NULL), checking its type otherwise
+    void next() {
+        if (field_ >= specs_.size()) {
+            throw std::runtime_error("PgCopyWriter: too many fields in row");
+        }
+        ++field_;
+    }
+
+    void next(PgType type) {
+        if (field_ < specs_.size() && specs_[field_].type != type) {
+            throw std::runtime_error("PgCopyWriter: column '" + specs_[field_].name + "' is " +
+                                     pg_type_name(specs_[field_].type) + ", not " + pg_type_name(type));
+        }
+        next();
+    }
+
+    void put_numeric() {
+        next(PgType::NUMERIC);
+        const auto &value = numeric_;
+        put<int32_t>(static_cast<int32_t>(8 + 2 * value.groups.size()));
+        put<int16_t>(static_cast<int16_t>(value.groups.size()));
+        put<int16_t>(value.weight);
+        put<uint16_t>(value.sign);
+        put<int16_t>(value.dscale);
+        for (const int16_t group : value.groups) {
+            put<int16_t>(group);
+        }
+    }
+
+    // Big-endian, as COPY BINARY and the *_send functions use
+    template <typename T>
+    void put(T value) {
+        using U = std::make_unsigned_t<T>;
+        auto bits = static_cast<U>(value);
+        char bytes[sizeof(T)];
+        for (std::size_t i = sizeof(T); i-- > 0;) {
+            bytes[i] = static_cast<char>(bits & 0xff);
+            bits = static_cast<U>(bits >> 8);
+        }
+        buffer_.insert(buffer_.end(), bytes, bytes + sizeof(T));
+    }
+
+    std::vector<PgColumnSpec> specs_;
+    std::vector<char> buffer_;
+    std::size_t rows_ = 0;
+    std::size_t field_ = 0;
+    pg_copy_detail::NumericValue numeric_;
+    std::string scratch_;
+};
+
+#endif
@@ -0,0 +1,361 @@
+/*
+ * Mergeable quantile sketches of trade size, trade inter-arrival time and
+ * spread, over several horizons at once.
+ *
+ * A TDigest is Dunning's merging t-digest: values go into a buffer, and a
+ * full buffer is sorted and folded into the centroids, which the k1 scale
+ * function keeps small near the tails (p99 stays accurate) and large in
+ * the middle. `compression` bounds the centroid count (about compression /
+ * 2 after a fold) and the buffer holds 2 * compression values; adding
+ * costs O(1) amortized, a buffer sort spread over the buffer's values.
+ * Digests merge by folding one's centroids into the other, which is what
+ * makes them windowable.
+ *
+ * A QuantileWindow keeps a ring of panes as MultiHorizonWindow does (panes
+ * of the horizons' gcd, stale slots recognised by their pane index), each
+ * with a digest per metric:
+ *
+ *   trade_size         qty of every trade
+ *   inter_arrival_ms   gap to the symbol's previous trade (0 within one
+ *                      match event); a trade older than the previous one
+ *                      adds its size only
+ *   spread_bps         (ask - bid) / mid of every two-sided quote, in basis
+ *                      points
+ *
+ * A horizon's quantiles merge the digests of the panes it spans, so reading
+ * p50/p90/p99 over 10s and 60s costs one merge per pane, never a sort of
+ * the raw values. Cleared digests keep their storage, so a warm window does
+ * not allocate. Unlike MultiHorizonWindow panes, digests are not plain
+ * data: quantile windows are not checkpointed and refill within their
+ * longest horizon after a restart.
+ *
+ * Not thread-safe; the binding uses it with the GIL held.
+ */
+
+#ifndef _SBE_QUANTILE_SKETCH_H_
+#define _SBE_QUANTILE_SKETCH_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "float_bits.h"
+
+class TDigest {
+public:
+    explicit TDigest(double compression = 200) : compression_(compression) {
+        if (!(compression_ >= 10)) {
+            throw std::runtime_error("TDigest: compression must be at least 10");
+        }
+        buffer_limit_ = static_cast<std::size_t>(compression_ * 2);
+    }
+
+    // Non-finite values are ignored
+    void add(double value, double weight = 1) {
+        if (!finite_bits(value) || !finite_bits(weight) || !(weight > 0)) {
+            return;
+        }
+        if (buffer_.size() >= buffer_limit_) {
+            fold();
+        }
+        buffer_.push_back({value, weight});
+        unfolded_weight_ += weight;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    // Fold `other`'s values into this digest
+    void merge(const TDigest &other) {
+        if (other.empty()) {
+            return;
+        }
+        for (const auto *values : {&other.centroids_, &other.buffer_}) {
+            for (const Centroid &centroid : *values) {
+                if (buffer_.size() >= buffer_limit_) {
+                    fold();
+                }
+                buffer_.push_back(centroid);
+                unfolded_weight_ += centroid.weight;
+            }
+        }
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    // Value at quantile q in [0, 1]; NaN when empty
+    double quantile(double q) {
+        if (empty()) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        fold();
+        q = std::clamp(q, 0.0, 1.0);
+        if (centroids_.size() == 1) {
+            return centroids_.front().mean;
+        }
+        // Each centroid's weight is centred on its mean; the ends
+        // interpolate to the exact min and max
+        const double target = q * weight_;
+        double cumulative = 0;
+        double previous_mid = 0;
+        double previous_mean = min_;
+        for (const Centroid &centroid : centroids_) {
+            const double mid = cumulative + centroid.weight / 2;
+            if (target < mid) {
+                if (mid == previous_mid) {
+                    return centroid.mean;
+                }
+                const double t = (target - previous_mid) / (mid - previous_mid);
+                return previous_mean + t * (centroid.mean - previous_mean);
+            }
+            cumulative += centroid.weight;
+            previous_mid = mid;
+            previous_mean = centroid.mean;
+        }
+        if (weight_ == previous_mid) {
+            return max_;
+        }
+        const double t = (target - previous_mid) / (weight_ - previous_mid);
+        return previous_mean + t * (max_ - previous_mean);
+    }
+
+    bool empty() const { return weight_ + unfolded_weight_ == 0; }
+    // Total weight added (the value count, for unit weights)
+    double count() const { return weight_ + unfolded_weight_; }
+    double min() const { return min_; }
+    double max() const { return max_; }
+    double compression() const { return compression_; }
+    std::size_t centroids() const { return centroids_.size(); }
+
+    // Empty, keeping the storage
+    void clear() {
+        centroids_.clear();
+        buffer_.clear();
+        weight_ = 0;
+        unfolded_weight_ = 0;
+        min_ = std::numeric_limits<double>::infinity();
+        max_ = -std::numeric_limits<double>::infinity();
+    }
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    // k1 scale function and its inverse: a centroid spans at most one unit
+    // of k, which is narrow in q at the tails
+    double k_of(double q) const { return compression_ / (2 * std::numbers::pi) * std::asin(2 * q - 1); }
+    double q_of(double k) const {
+        const double angle = 2 * std::numbers::pi * k / compression_;
+        return angle >= std::numbers::pi / 2 ? 1.0 : (std::sin(angle) + 1) / 2;
+    }
+
+    // Sort the buffer into the centroids
+    void fold() {
+        if (buffer_.empty()) {
+            return;
+        }
+        buffer_.insert(buffer_.end(), centroids_.begin(), centroids_.end());
+        std::sort(buffer_.begin(), buffer_.end(),
+                  [](const Centroid &a, const Centroid &b) { return a.mean < b.mean; });
+        const double total = weight_ + unfolded_weight_;
+        centroids_.clear();
+        Centroid current = buffer_.front();
+        double before = 0;
+        double limit = total * q_of(k_of(0) + 1);
+        for (std::size_t i = 1; i < buffer_.size(); ++i) {
+            const Centroid &next = buffer_[i];
+            if (before + current.weight + next.weight <= limit) {
+                current.weight += next.weight;
+                current.mean += (next.mean - current.mean) * next.weight / current.weight;
+                continue;
+            }
+            before += current.weight;
+            centroids_.push_back(current);
+            limit = total * q_of(k_of(before / total) + 1);
+            current = next;
+        }
+        centroids_.push_back(current);
+        buffer_.clear();
+        weight_ = total;
+        unfolded_weight_ = 0;
+    }
+
+    double compression_;
+    std::size_t buffer_limit_ = 0;
+    // Sorted by mean
+    std::vector<Centroid> centroids_;
+    std::vector<Centroid> buffer_;
+    double weight_ = 0;
+    double unfolded_weight_ = 0;
+    double min_ = std::numeric_limits<double>::infinity();
+    double max_ = -std::numeric_limits<double>::infinity();
+};
+
+enum class QuantileMetric : uint8_t {
+    TradeSize,
+    InterArrival,
+    Spread,
+};
+
+constexpr std::array<const char *, 3> QUANTILE_METRIC_NAMES = {"trade_size", "inter_arrival_ms", "spread_bps"};
+
+class QuantileWindow {
+public:
+    // `horizons_ms` must be positive multiples of `pane_ms`; pane_ms 0 picks
+    // their gcd
+    QuantileWindow(std::vector<int64_t> horizons_ms, int64_t pane_ms, double compression = 200)
+        : horizons_ms_(std::move(horizons_ms)) {
+        if (horizons_ms_.empty()) {
+            throw std::runtime_error("QuantileWindow: at least one horizon is required");
+        }
+        for (const int64_t horizon : horizons_ms_) {
+            if (horizon <= 0) {
+                throw std::runtime_error("QuantileWindow: horizons must be positive");
+            }
+            if (pane_ms == 0) {
+                pane_ms_ = std::gcd(pane_ms_, horizon);
+            }
+        }
+        if (pane_ms != 0) {
+            pane_ms_ = pane_ms;
+        }
+        if (pane_ms_ <= 0) {
+            throw std::runtime_error("QuantileWindow: pane must be positive");
+        }
+        int64_t longest = 0;
+        for (const int64_t horizon : horizons_ms_) {
+            if (horizon % pane_ms_ != 0) {
+                throw std::runtime_error("QuantileWindow: horizons must be multiples of the pane");
+            }
+            longest = std::max(longest, horizon);
+        }
+        panes_.assign(static_cast<std::size_t>(longest / pane_ms_), Pane(compression));
+    }
+
+    // Trades without a positive finite qty are ignored
+    void add_trade(int64_t ts_ms, double qty) {
+        if (!finite_bits(qty) || !(qty > 0)) {
+            return;
+        }
+        Pane *pane = pane_for(ts_ms);
+        if (pane == nullptr) {
+            return;
+        }
+        pane->digests[static_cast<std::size_t>(QuantileMetric::TradeSize)].add(qty);
+        if (has_trade_ && ts_ms >= last_trade_ms_) {
+            pane->digests[static_cast<std::size_t>(QuantileMetric::InterArrival)].add(
+                static_cast<double>(ts_ms - last_trade_ms_));
+        }
+        if (!has_trade_ || ts_ms > last_trade_ms_) {
+            last_trade_ms_ = ts_ms;
+            has_trade_ = true;
+        }
+    }
+
+    // Quotes without both finite sides, or crossed, are ignored
+    void add_quote(int64_t ts_ms, double bid_px, double ask_px) {
+        if (!finite_bits(bid_px) || !finite_bits(ask_px) || !(bid_px > 0) || !(ask_px >= bid_px)) {
+            return;
+        }
+        if (Pane *pane = pane_for(ts_ms)) {
+            const double mid = (bid_px + ask_px) / 2;
+            pane->digests[static_cast<std::size_t>(QuantileMetric::Spread)].add((ask_px - bid_px) / mid * 1e4);
+        }
+    }
+
+    // Move the horizons' end to `now_ms` without an event, so quiet symbols
+    // age out
+    void advance(int64_t now_ms) { current_ = std::max(current_, floor_div(now_ms, pane_ms_)); }
+
+    // Merge the panes of horizon `h` (an index into horizons_ms()) for
+    // `metric` into `out`, cleared first; returns its value count
+    std::size_t combine(std::size_t h, QuantileMetric metric, TDigest &out) const {
+        const int64_t span = horizons_ms_.at(h) / pane_ms_;
+        out.clear();
+        if (current_ == std::numeric_limits<int64_t>::min()) {
+            return 0;
+        }
+        for (int64_t pane = current_ - span + 1; pane <= current_; ++pane) {
+            const Pane &slot = slot_of(pane);
+            if (slot.index == pane) {
+                out.merge(slot.digests[static_cast<std::size_t>(metric)]);
+            }
+        }
+        return static_cast<std::size_t>(out.count());
+    }
+
+    const std::vector<int64_t> &horizons_ms() const { return horizons_ms_; }
+    int64_t pane_ms() const { return pane_ms_; }
+    std::size_t pane_count() const { return panes_.size(); }
+    double compression() const { return panes_.front().digests.front().compression(); }
+    // Events that arrived after their pane had left the ring
+    uint64_t late_drops() const { return late_drops_; }
+
+    void clear() {
+        for (Pane &pane : panes_) {
+            pane.reset(std::numeric_limits<int64_t>::min());
+        }
+        current_ = std::numeric_limits<int64_t>::min();
+        has_trade_ = false;
+    }
+
+private:
+    struct Pane {
+        explicit Pane(double compression) : digests{TDigest(compression), TDigest(compression), TDigest(compression)} {}
+
+        void reset(int64_t pane) {
+            index = pane;
+            for (TDigest &digest : digests) {
+                digest.clear();
+            }
+        }
+
+        // Pane number (ts / pane_ms) the slot holds; stale slots are skipped
+        int64_t index = std::numeric_limits<int64_t>::min();
+        std::array<TDigest, QUANTILE_METRIC_NAMES.size()> digests;
+    };
+
+    static int64_t floor_div(int64_t a, int64_t b) { return a / b - ((a % b != 0) && ((a < 0) != (b < 0))); }
+
+    // The pane `ts_ms` falls in, reset if its slot held an older one;
+    // nullptr (and counted) when it has left the ring
+    Pane *pane_for(int64_t ts_ms) {
+        const int64_t pane = floor_div(ts_ms, pane_ms_);
+        current_ = std::max(current_, pane);
+        if (pane <= current_ - static_cast<int64_t>(panes_.size())) {
+            ++late_drops_;
+            return nullptr;
+        }
+        Pane &slot = slot_of(pane);
+        if (slot.index != pane) {
+            slot.reset(pane);
+        }
+        return &slot;
+    }
+
+    Pane &slot_of(int64_t pane) { return panes_[ring_slot(pane)]; }
+    const Pane &slot_of(int64_t pane) const { return panes_[ring_slot(pane)]; }
+    std::size_t ring_slot(int64_t pane) const {
+        const auto size = static_cast<int64_t>(panes_.size());
+        return static_cast<std::size_t>(((pane % size) + size) % size);
+    }
+
+    std::vector<int64_t> horizons_ms_;
+    int64_t pane_ms_ = 0;
+    std::vector<Pane> panes_;
+    int64_t current_ = std::numeric_limits<int64_t>::min();
+    uint64_t late_drops_ = 0;
+    int64_t last_trade_ms_ = 0;
+    bool has_trade_ = false;
+};
+
+#endif
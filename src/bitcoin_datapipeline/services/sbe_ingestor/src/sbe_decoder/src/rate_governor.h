@@ -0,0 +1,312 @@
+/*
+ * Process-wide request-weight governor for the Binance REST and WebSocket
+ * APIs.
+ *
+ * The exchange counts request weight (and raw requests) per IP in fixed
+ * windows that reset on interval boundaries, e.g. REQUEST_WEIGHT 6000 per
+ * minute. Going over answers 429, and repeated 429s escalate to a 418 IP
+ * ban. Fixed delays between requests either leave most of the budget
+ * unused or, with several callers in one process, still overrun it, so
+ * every caller draws from one RateGovernor instead (rate_governor()):
+ *
+ *   - configure() sets the limits exchangeInfo publishes
+ *     (exchange_info_rate_limits() reads them from an SBE ExchangeInfo
+ *     response); each becomes a window counter
+ *   - reserve() charges a request's weight to every REQUEST_WEIGHT window
+ *     and 1 to every RAW_REQUESTS window if all of them stay within
+ *     utilization * limit, or returns how long until the window that
+ *     blocks it resets
+ *   - observe() takes the server's own count from a response (the WS API's
+ *     rateLimits `current`, REST's X-MBX-USED-WEIGHT-1M header) and raises
+ *     the local count to it, so weight spent by other processes on the same
+ *     IP, or weights a caller guessed low, slow this process down too
+ *   - back_off() refuses every reservation until a 429/418's retry-after
+ *     time
+ *
+ * Counts only ever move up within a window, so the governor errs towards
+ * waiting. Windows run on wall-clock milliseconds, because the exchange
+ * resets them on UTC boundaries and reports retryAfter as an epoch time.
+ * Thread-safe; the lock is held for a few compares per call.
+ */
+
+#ifndef _SBE_RATE_GOVERNOR_H_
+#define _SBE_RATE_GOVERNOR_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "official/util.h"
+#include "spot_sbe/ExchangeInfoResponse.h"
+#include "spot_sbe/GroupSizeEncoding.h"
+#include "spot_sbe/MessageHeader.h"
+#include "spot_sbe/RateLimitInterval.h"
+#include "spot_sbe/RateLimitType.h"
+#include "stream_decode.h"
+
+inline int64_t rate_governor_now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Length of one interval unit; 0 for an interval this schema does not know
+constexpr int64_t rate_limit_interval_ms(spot_sbe::RateLimitInterval::Value interval) {
+    switch (interval) {
+    case spot_sbe::RateLimitInterval::Second:
+        return 1000;
+    case spot_sbe::RateLimitInterval::Minute:
+        return 60 * 1000;
+    case spot_sbe::RateLimitInterval::Hour:
+        return 60 * 60 * 1000;
+    case spot_sbe::RateLimitInterval::Day:
+        return 24 * 60 * 60 * 1000;
+    case spot_sbe::RateLimitInterval::NULL_VALUE:
+        break;
+    }
+    return 0;
+}
+
+struct RateLimitSpec {
+    spot_sbe::RateLimitType::Value type = spot_sbe::RateLimitType::RequestWeight;
+    spot_sbe::RateLimitInterval::Value interval = spot_sbe::RateLimitInterval::Minute;
+    uint8_t interval_num = 1;
+    int64_t limit = 0;
+
+    bool same_window(const RateLimitSpec &other) const {
+        return type == other.type && interval == other.interval && interval_num == other.interval_num;
+    }
+};
+
+// The rateLimits of the ExchangeInfoResponse in `frame` (message header
+// included). Throws std::runtime_error if the frame is not an
+// ExchangeInfoResponse of the expected schema or is truncated.
+inline std::vector<RateLimitSpec> exchange_info_rate_limits(std::span<char> frame) {
+    using spot_sbe::ExchangeInfoResponse;
+    if (frame.size() < spot_sbe::MessageHeader::encodedLength()) {
+        throw std::runtime_error("Buffer too short for message header");
+    }
+    spot_sbe::MessageHeader header(frame.data(), frame.size());
+    if (header.schemaId() != EXPECTED_SCHEMA_ID) {
+        throw std::runtime_error("Unexpected schema id " + std::to_string(header.schemaId()));
+    }
+    if (header.templateId() != ExchangeInfoResponse::SBE_TEMPLATE_ID) {
+        throw std::runtime_error("Expected ExchangeInfoResponse (template 103), got template " +
+                                 std::to_string(header.templateId()));
+    }
+    if (frame.size() < spot_sbe::MessageHeader::encodedLength() + header.blockLength()) {
+        throw std::runtime_error("ExchangeInfoResponse shorter than its block");
+    }
+    auto response = message_from_header<ExchangeInfoResponse>(frame, header);
+    const spot_sbe::GroupSizeEncoding dimensions(frame.data(), response.sbePosition(), frame.size(),
+                                                 header.version());
+    if (dimensions.numInGroup() > 0 &&
+        dimensions.blockLength() < ExchangeInfoResponse::RateLimits::sbeBlockLength()) {
+        throw std::runtime_error("ExchangeInfoResponse rate limit entries shorter than their block");
+    }
+    std::vector<RateLimitSpec> limits;
+    auto &group = response.rateLimits();
+    while (group.hasNext()) {
+        group.next();
+        limits.push_back({group.rateLimitType(), group.interval(), group.intervalNum(), group.rateLimit()});
+    }
+    return limits;
+}
+
+struct RateWindow {
+    RateLimitSpec spec;
+    int64_t length_ms = 0;
+    int64_t start_ms = 0;
+    // Charged locally or reported by the server, whichever is higher
+    int64_t used = 0;
+};
+
+struct RateGovernorStats {
+    uint64_t granted = 0;
+    int64_t weight_granted = 0;
+    // Reservations refused with a wait
+    uint64_t waits = 0;
+    // Server counts that were above the local one
+    uint64_t corrections = 0;
+    uint64_t backoffs = 0;
+};
+
+class RateGovernor {
+public:
+    // Keep each window's count within utilization * limit
+    explicit RateGovernor(double utilization = 0.95) { set_utilization(utilization); }
+
+    RateGovernor(const RateGovernor &) = delete;
+    RateGovernor &operator=(const RateGovernor &) = delete;
+
+    void set_utilization(double utilization) {
+        if (!(utilization > 0.0 && utilization <= 1.0)) {
+            throw std::invalid_argument("utilization must be in (0, 1]");
+        }
+        std::lock_guard lock(mutex_);
+        utilization_ = utilization;
+    }
+
+    double utilization() const {
+        std::lock_guard lock(mutex_);
+        return utilization_;
+    }
+
+    // Replaces the windows; one that existed before keeps its count.
+    // Limits on an unknown interval are skipped.
+    void configure(std::span<const RateLimitSpec> limits) {
+        std::lock_guard lock(mutex_);
+        std::vector<RateWindow> windows;
+        for (const RateLimitSpec &spec : limits) {
+            const int64_t length = rate_limit_interval_ms(spec.interval) * std::max<int64_t>(spec.interval_num, 1);
+            if (length == 0) {
+                continue;
+            }
+            RateWindow window{spec, length, 0, 0};
+            if (const RateWindow *existing = find(spec)) {
+                window.start_ms = existing->start_ms;
+                window.used = existing->used;
+            }
+            windows.push_back(window);
+        }
+        windows_ = std::move(windows);
+    }
+
+    bool configured() const {
+        std::lock_guard lock(mutex_);
+        return !windows_.empty();
+    }
+
+    // Charges a request of `weight` and returns 0, or returns the
+    // milliseconds to wait before asking again and charges nothing
+    int64_t reserve(int64_t weight, int64_t now_ms) {
+        std::lock_guard lock(mutex_);
+        if (now_ms < backoff_until_ms_) {
+            ++stats_.waits;
+            return backoff_until_ms_ - now_ms;
+        }
+        int64_t wait = 0;
+        for (RateWindow &window : windows_) {
+            roll(window, now_ms);
+            const int64_t charge = charge_of(window.spec, weight);
+            // A request heavier than the whole budget still goes through
+            // into an empty window rather than waiting forever
+            if (charge > 0 && window.used > 0 && window.used + charge > budget(window.spec)) {
+                wait = std::max(wait, window.start_ms + window.length_ms - now_ms);
+            }
+        }
+        if (wait > 0) {
+            ++stats_.waits;
+            return wait;
+        }
+        for (RateWindow &window : windows_) {
+            window.used += charge_of(window.spec, weight);
+        }
+        ++stats_.granted;
+        stats_.weight_granted += weight;
+        return 0;
+    }
+
+    // The server's count for one window, as of `now_ms`. A window with no
+    // configured limit is added when `limit` is known.
+    void observe(const RateLimitSpec &spec, int64_t current, int64_t now_ms) {
+        std::lock_guard lock(mutex_);
+        RateWindow *window = find(spec);
+        if (window == nullptr) {
+            const int64_t length = rate_limit_interval_ms(spec.interval) * std::max<int64_t>(spec.interval_num, 1);
+            if (spec.limit <= 0 || length == 0) {
+                return;
+            }
+            window = &windows_.emplace_back(RateWindow{spec, length, 0, 0});
+        }
+        roll(*window, now_ms);
+        if (spec.limit > 0) {
+            window->spec.limit = spec.limit;
+        }
+        if (current > window->used) {
+            window->used = current;
+            ++stats_.corrections;
+        }
+    }
+
+    // Refuse every reservation until `until_ms` (a 429/418's retry-after)
+    void back_off(int64_t until_ms) {
+        std::lock_guard lock(mutex_);
+        if (until_ms > backoff_until_ms_) {
+            backoff_until_ms_ = until_ms;
+            ++stats_.backoffs;
+        }
+    }
+
+    int64_t backoff_until_ms() const {
+        std::lock_guard lock(mutex_);
+        return backoff_until_ms_;
+    }
+
+    std::vector<RateWindow> windows(int64_t now_ms) {
+        std::lock_guard lock(mutex_);
+        for (RateWindow &window : windows_) {
+            roll(window, now_ms);
+        }
+        return windows_;
+    }
+
+    RateGovernorStats stats() const {
+        std::lock_guard lock(mutex_);
+        return stats_;
+    }
+
+private:
+    static int64_t charge_of(const RateLimitSpec &spec, int64_t weight) {
+        switch (spec.type) {
+        case spot_sbe::RateLimitType::RequestWeight:
+            return weight;
+        case spot_sbe::RateLimitType::RawRequests:
+            return 1;
+        default:
+            // Orders and connections are not spent by data requests
+            return 0;
+        }
+    }
+
+    int64_t budget(const RateLimitSpec &spec) const {
+        return std::max<int64_t>(1, static_cast<int64_t>(std::floor(static_cast<double>(spec.limit) * utilization_)));
+    }
+
+    static void roll(RateWindow &window, int64_t now_ms) {
+        const int64_t start = now_ms - now_ms % window.length_ms;
+        if (start > window.start_ms) {
+            window.start_ms = start;
+            window.used = 0;
+        }
+    }
+
+    RateWindow *find(const RateLimitSpec &spec) {
+        for (RateWindow &window : windows_) {
+            if (window.spec.same_window(spec)) {
+                return &window;
+            }
+        }
+        return nullptr;
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<RateWindow> windows_;
+    double utilization_ = 0.95;
+    int64_t backoff_until_ms_ = 0;
+    RateGovernorStats stats_;
+};
+
+// The governor every REST and WebSocket API caller in the process shares
+inline RateGovernor &rate_governor() {
+    static RateGovernor governor;
+    return governor;
+}
+
+#endif
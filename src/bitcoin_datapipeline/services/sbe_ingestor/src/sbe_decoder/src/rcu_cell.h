@@ -0,0 +1,180 @@
+/*
+ * Read-copy-update publication of whole objects, with epoch-based
+ * reclamation.
+ *
+ * An RcuCell holds the current version of an object behind one atomic
+ * pointer. Its single writer builds the next version wherever it likes and
+ * publishes it with one pointer exchange; readers load the pointer inside an
+ * EpochGuard and use what they got for as long as the guard lives. A reader
+ * never blocks and never sees a version while it is being built.
+ *
+ * Replaced versions are retired with the epoch of the swap and freed (or
+ * handed back to the writer for reuse, see recycle()) once no reader is
+ * still inside an older epoch. Readers announce their epoch in a slot of
+ * their own: each thread claims one of EpochDomain::MAX_READERS cache-line
+ * slots on first use and releases it at thread exit, so a guard costs one
+ * atomic load and two stores to the thread's own line.
+ */
+
+#ifndef _SBE_RCU_CELL_H_
+#define _SBE_RCU_CELL_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+class EpochDomain {
+public:
+    static constexpr std::size_t MAX_READERS = 256;
+
+    EpochDomain() = default;
+    EpochDomain(const EpochDomain &) = delete;
+    EpochDomain &operator=(const EpochDomain &) = delete;
+
+    // A reader thread's pinned epoch (0 outside any guard)
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> taken{false};
+        // Only touched by the owning thread
+        uint32_t depth = 0;
+    };
+
+    // Reader side: pin the current epoch in the calling thread's slot.
+    // Guards nest; only the outermost one touches the slot.
+    class Guard {
+    public:
+        explicit Guard(EpochDomain &domain) : slot_(domain.reader_slot()) {
+            if (slot_->depth++ == 0) {
+                slot_->epoch.store(domain.epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            }
+        }
+
+        ~Guard() {
+            if (--slot_->depth == 0) {
+                slot_->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        Slot *slot_;
+    };
+
+    // Writer side: close the current epoch after a swap; the returned epoch
+    // tags what the swap replaced
+    uint64_t advance() { return epoch_.fetch_add(1, std::memory_order_seq_cst) + 1; }
+
+    // No reader is still inside an epoch before `epoch`
+    bool quiescent(uint64_t epoch) const {
+        for (const auto &slot : slots_) {
+            const uint64_t pinned = slot.epoch.load(std::memory_order_seq_cst);
+            if (pinned != 0 && pinned < epoch) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    // The calling thread's slot, claimed on first use and released when the
+    // thread exits. Throws std::runtime_error past MAX_READERS threads.
+    Slot *reader_slot() {
+        struct Claim {
+            EpochDomain *domain = nullptr;
+            Slot *slot = nullptr;
+            ~Claim() {
+                if (slot != nullptr) {
+                    slot->taken.store(false, std::memory_order_release);
+                }
+            }
+        };
+        // One claim per thread and domain; domains are few and long-lived
+        thread_local std::vector<Claim> claims;
+        for (const auto &claim : claims) {
+            if (claim.domain == this) {
+                return claim.slot;
+            }
+        }
+        for (auto &slot : slots_) {
+            bool expected = false;
+            if (!slot.taken.load(std::memory_order_relaxed) &&
+                slot.taken.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                claims.push_back(Claim{this, &slot});
+                return &slot;
+            }
+        }
+        throw std::runtime_error("EpochDomain: more than MAX_READERS reader threads");
+    }
+
+    std::atomic<uint64_t> epoch_{1};
+    std::array<Slot, MAX_READERS> slots_{};
+};
+
+using EpochGuard = EpochDomain::Guard;
+
+// The domain every published order book shares
+inline EpochDomain &book_epochs() {
+    static EpochDomain domain;
+    return domain;
+}
+
+template <typename T>
+class RcuCell {
+public:
+    explicit RcuCell(EpochDomain &domain) : domain_(domain) {}
+
+    RcuCell(const RcuCell &) = delete;
+    RcuCell &operator=(const RcuCell &) = delete;
+
+    // Readers must outlive the cell
+    ~RcuCell() { delete current_.load(std::memory_order_relaxed); }
+
+    // Reader: the current version, nullptr before the first publish. Only
+    // valid while an EpochGuard of the cell's domain is held.
+    const T *load() const { return current_.load(std::memory_order_seq_cst); }
+
+    // Writer: make `next` current; the version it replaces is retired
+    void publish(std::unique_ptr<T> next) {
+        T *previous = current_.exchange(next.release(), std::memory_order_seq_cst);
+        if (previous != nullptr) {
+            retired_.push_back(Retired{std::unique_ptr<T>(previous), domain_.advance()});
+        }
+        // Old versions nobody reads any more are freed, but one is kept for
+        // recycle()
+        while (retired_.size() > 1 && domain_.quiescent(retired_.front().epoch)) {
+            retired_.erase(retired_.begin());
+        }
+    }
+
+    // Writer: a retired version no reader can still see, to build the next
+    // one in without allocating; nullptr if every retired one may be in use
+    std::unique_ptr<T> recycle() {
+        if (retired_.empty() || !domain_.quiescent(retired_.front().epoch)) {
+            return nullptr;
+        }
+        std::unique_ptr<T> reused = std::move(retired_.front().object);
+        retired_.erase(retired_.begin());
+        return reused;
+    }
+
+    // Versions waiting for their readers to leave
+    std::size_t retired() const { return retired_.size(); }
+
+private:
+    struct Retired {
+        std::unique_ptr<T> object;
+        uint64_t epoch;
+    };
+
+    EpochDomain &domain_;
+    std::atomic<T *> current_{nullptr};
+    std::vector<Retired> retired_;
+};
+
+#endif
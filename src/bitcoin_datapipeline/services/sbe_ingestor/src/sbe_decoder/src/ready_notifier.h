@@ -0,0 +1,89 @@
+/*
+ * eventfd wake-ups from native producers to an event loop.
+ *
+ * The consumer (an asyncio loop, through loop.add_reader(fd())) drains
+ * everything available, then arm()s the notifier and sleeps until the fd
+ * becomes readable. Producers call notify() after publishing; only the
+ * first notify() after an arm() writes to the eventfd, so a burst of
+ * frames costs one syscall and one wake-up, and a consumer that is busy
+ * draining costs producers nothing but a fence and a load.
+ *
+ * arm() and notify() pair like Dekker's flags: the consumer sets `armed`
+ * and then checks its rings, a producer publishes and then checks `armed`,
+ * each with a full fence in between, so at least one side sees the other
+ * and a record is never left unannounced. arm() returning false means
+ * records arrived meanwhile and the consumer should drain again instead
+ * of sleeping.
+ */
+
+#ifndef _SBE_READY_NOTIFIER_H_
+#define _SBE_READY_NOTIFIER_H_
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+class ReadyNotifier {
+public:
+    ReadyNotifier() : fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+        if (fd_ < 0) {
+            throw std::runtime_error(std::string("eventfd: ") + std::strerror(errno));
+        }
+    }
+
+    ~ReadyNotifier() { ::close(fd_); }
+
+    ReadyNotifier(const ReadyNotifier &) = delete;
+    ReadyNotifier &operator=(const ReadyNotifier &) = delete;
+
+    int fd() const { return fd_; }
+
+    // Consumer: ask for a wake-up, then recheck with `readable()`. False,
+    // already disarmed, when there is something to drain right away.
+    template <typename Readable>
+    bool arm(Readable &&readable) {
+        armed_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (readable()) {
+            armed_.store(false, std::memory_order_relaxed);
+            return false;
+        }
+        arms_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Producer, after publishing: wake an armed consumer
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (armed_.load(std::memory_order_relaxed) && armed_.exchange(false, std::memory_order_acq_rel)) {
+            const uint64_t one = 1;
+            // A full counter (never, at one write per arm) still leaves the fd readable
+            [[maybe_unused]] const ssize_t written = ::write(fd_, &one, sizeof(one));
+            wakeups_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Consumer, once woken: reset the fd so the loop stops reporting it
+    // readable; returns the wake-ups it held
+    uint64_t clear() {
+        uint64_t count = 0;
+        return ::read(fd_, &count, sizeof(count)) == static_cast<ssize_t>(sizeof(count)) ? count : 0;
+    }
+
+    uint64_t arms() const { return arms_.load(std::memory_order_relaxed); }
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+
+private:
+    const int fd_;
+    std::atomic<bool> armed_{false};
+    std::atomic<uint64_t> arms_{0};
+    std::atomic<uint64_t> wakeups_{0};
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * zstd compression of Kinesis record payloads with a trained dictionary.
+ *
+ * Depth records repeat the same symbol, field names and nearby prices, and
+ * each one is too small for zstd to learn that on its own. A dictionary
+ * trained offline on captured records (train_record_dictionary(), e.g. fed
+ * from the capture journal) carries that context to both sides. Each
+ * compressed payload starts with a 10-byte codec header:
+ *
+ *   0  magic 0xB7             2  uint32 dictionary id (0: none)
+ *   1  codec (1: zstd)        6  uint32 uncompressed size
+ *
+ * followed by a zstd frame without its own content size or dictionary id,
+ * which the header already carries. JSON records start with '{', Avro
+ * single-object records with 0xC3 and KPL aggregates with 0xF3, so a
+ * reader tells compressed payloads from plain ones by the first byte. A
+ * payload that does not shrink is left as it is.
+ *
+ * The decompressor keeps every dictionary it is given, keyed by id, so a
+ * new dictionary can be rolled out to readers before writers switch to it.
+ * Both sides reuse their zstd contexts: not thread-safe, one per thread.
+ */
+
+#ifndef _SBE_RECORD_CODEC_H_
+#define _SBE_RECORD_CODEC_H_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <zdict.h>
+#include <zstd.h>
+
+constexpr uint8_t RECORD_CODEC_MAGIC = 0xB7;
+constexpr uint8_t RECORD_CODEC_ZSTD = 1;
+constexpr std::size_t RECORD_CODEC_HEADER_SIZE = 10;
+// Largest uncompressed size a reader accepts, against corrupt headers
+constexpr std::size_t RECORD_CODEC_MAX_SIZE = 16 << 20;
+
+namespace record_codec_detail {
+
+struct ZstdFree {
+    void operator()(ZSTD_CCtx *ctx) const { ZSTD_freeCCtx(ctx); }
+    void operator()(ZSTD_DCtx *ctx) const { ZSTD_freeDCtx(ctx); }
+    void operator()(ZSTD_CDict *dict) const { ZSTD_freeCDict(dict); }
+    void operator()(ZSTD_DDict *dict) const { ZSTD_freeDDict(dict); }
+};
+
+template <typename T>
+using ZstdPtr = std::unique_ptr<T, ZstdFree>;
+
+inline std::size_t check(std::size_t code, const char *what) {
+    if (ZSTD_isError(code)) {
+        throw std::runtime_error(std::string(what) + ": " + ZSTD_getErrorName(code));
+    }
+    return code;
+}
+
+} // namespace record_codec_detail
+
+// True when `data` starts with a codec header
+inline bool is_compressed_record(std::span<const char> data) {
+    return data.size() >= RECORD_CODEC_HEADER_SIZE && static_cast<uint8_t>(data[0]) == RECORD_CODEC_MAGIC;
+}
+
+// A dictionary of about `dict_size` bytes trained on `samples`; zstd wants
+// a few hundred samples at least, and throws here when they are too few
+inline std::vector<char> train_record_dictionary(std::span<const char> samples, std::span<const std::size_t> sizes,
+                                                 std::size_t dict_size) {
+    std::vector<char> dictionary(dict_size);
+    const std::size_t size = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(),
+                                                   sizes.data(), static_cast<unsigned>(sizes.size()));
+    if (ZDICT_isError(size)) {
+        throw std::runtime_error(std::string("train_record_dictionary: ") + ZDICT_getErrorName(size));
+    }
+    dictionary.resize(size);
+    return dictionary;
+}
+
+class RecordCompressor {
+public:
+    // An empty dictionary compresses with plain zstd
+    explicit RecordCompressor(std::span<const char> dictionary, int level = 3)
+        : ctx_(ZSTD_createCCtx()), level_(level) {
+        using namespace record_codec_detail;
+        if (!ctx_) {
+            throw std::runtime_error("RecordCompressor: out of memory");
+        }
+        if (!dictionary.empty()) {
+            dict_.reset(ZSTD_createCDict(dictionary.data(), dictionary.size(), level));
+            if (!dict_) {
+                throw std::runtime_error("RecordCompressor: not a zstd dictionary");
+            }
+            dict_id_ = ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+            check(ZSTD_CCtx_refCDict(ctx_.get(), dict_.get()), "RecordCompressor");
+        } else {
+            check(ZSTD_CCtx_setParameter(ctx_.get(), ZSTD_c_compressionLevel, level), "RecordCompressor");
+        }
+        check(ZSTD_CCtx_setParameter(ctx_.get(), ZSTD_c_contentSizeFlag, 0), "RecordCompressor");
+        check(ZSTD_CCtx_setParameter(ctx_.get(), ZSTD_c_dictIDFlag, 0), "RecordCompressor");
+    }
+
+    // Header plus zstd frame of `raw` into `out`; false, with `out`
+    // unspecified, when that is not smaller than `raw`
+    bool compress(std::span<const char> raw, std::vector<char> &out) {
+        using namespace record_codec_detail;
+        out.resize(RECORD_CODEC_HEADER_SIZE + ZSTD_compressBound(raw.size()));
+        const std::size_t size = check(ZSTD_compress2(ctx_.get(), out.data() + RECORD_CODEC_HEADER_SIZE,
+                                                      out.size() - RECORD_CODEC_HEADER_SIZE, raw.data(), raw.size()),
+                                       "RecordCompressor");
+        if (RECORD_CODEC_HEADER_SIZE + size >= raw.size()) {
+            return false;
+        }
+        const auto raw_size = static_cast<uint32_t>(raw.size());
+        out[0] = static_cast<char>(RECORD_CODEC_MAGIC);
+        out[1] = static_cast<char>(RECORD_CODEC_ZSTD);
+        std::memcpy(out.data() + 2, &dict_id_, sizeof(dict_id_));
+        std::memcpy(out.data() + 6, &raw_size, sizeof(raw_size));
+        out.resize(RECORD_CODEC_HEADER_SIZE + size);
+        return true;
+    }
+
+    uint32_t dictionary_id() const { return dict_id_; }
+    int level() const { return level_; }
+
+private:
+    record_codec_detail::ZstdPtr<ZSTD_CCtx> ctx_;
+    record_codec_detail::ZstdPtr<ZSTD_CDict> dict_;
+    uint32_t dict_id_ = 0;
+    int level_;
+};
+
+class RecordDecompressor {
+public:
+    RecordDecompressor() : ctx_(ZSTD_createDCtx()) {
+        if (!ctx_) {
+            throw std::runtime_error("RecordDecompressor: out of memory");
+        }
+    }
+
+    // Returns the dictionary's id; raw-content dictionaries (id 0) are
+    // refused since records could not name them
+    uint32_t add_dictionary(std::span<const char> dictionary) {
+        const uint32_t id = ZSTD_getDictID_fromDict(dictionary.data(), dictionary.size());
+        if (id == 0) {
+            throw std::runtime_error("RecordDecompressor: not a trained zstd dictionary");
+        }
+        record_codec_detail::ZstdPtr<ZSTD_DDict> dict(ZSTD_createDDict(dictionary.data(), dictionary.size()));
+        if (!dict) {
+            throw std::runtime_error("RecordDecompressor: not a zstd dictionary");
+        }
+        dicts_[id] = std::move(dict);
+        return id;
+    }
+
+    // The payload of a compressed record into `out`; throws on a corrupt
+    // record or one whose dictionary was never added
+    void decompress(std::span<const char> data, std::vector<char> &out) {
+        using namespace record_codec_detail;
+        if (!is_compressed_record(data)) {
+            throw std::runtime_error("RecordDecompressor: no codec header");
+        }
+        if (static_cast<uint8_t>(data[1]) != RECORD_CODEC_ZSTD) {
+            throw std::runtime_error("RecordDecompressor: unknown codec");
+        }
+        uint32_t dict_id = 0;
+        uint32_t raw_size = 0;
+        std::memcpy(&dict_id, data.data() + 2, sizeof(dict_id));
+        std::memcpy(&raw_size, data.data() + 6, sizeof(raw_size));
+        if (raw_size > RECORD_CODEC_MAX_SIZE) {
+            throw std::runtime_error("RecordDecompressor: record too large");
+        }
+        out.resize(raw_size);
+        const char *frame = data.data() + RECORD_CODEC_HEADER_SIZE;
+        const std::size_t frame_size = data.size() - RECORD_CODEC_HEADER_SIZE;
+        std::size_t size = 0;
+        if (dict_id == 0) {
+            size = check(ZSTD_decompressDCtx(ctx_.get(), out.data(), out.size(), frame, frame_size),
+                         "RecordDecompressor");
+        } else {
+            const auto dict = dicts_.find(dict_id);
+            if (dict == dicts_.end()) {
+                throw std::runtime_error("RecordDecompressor: unknown dictionary " + std::to_string(dict_id));
+            }
+            size = check(ZSTD_decompress_usingDDict(ctx_.get(), out.data(), out.size(), frame, frame_size,
+                                                    dict->second.get()),
+                         "RecordDecompressor");
+        }
+        if (size != raw_size) {
+            throw std::runtime_error("RecordDecompressor: size does not match the header");
+        }
+    }
+
+    std::vector<uint32_t> dictionary_ids() const {
+        std::vector<uint32_t> ids;
+        for (const auto &[id, dict] : dicts_) {
+            ids.push_back(id);
+        }
+        return ids;
+    }
+
+private:
+    record_codec_detail::ZstdPtr<ZSTD_DCtx> ctx_;
+    std::unordered_map<uint32_t, record_codec_detail::ZstdPtr<ZSTD_DDict>> dicts_;
+};
+
+#endif
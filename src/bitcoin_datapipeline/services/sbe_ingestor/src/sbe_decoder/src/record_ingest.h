@@ -0,0 +1,529 @@
+/*
+ * Kinesis records straight into the aggregator's native rings.
+ *
+ * KinesisConsumer json.loads every payload into a dict, and StreamAggregator
+ * then copies a handful of its fields into a TradeRing or QuoteRing.
+ * RecordIngestor takes the raw GetRecords data instead: it deaggregates KPL
+ * records, decompresses codec-framed payloads (record_codec.h), reads those
+ * fields out of JSON or Avro single-object records without building any
+ * objects, and appends them to per-symbol rings it owns, plus a
+ * MultiHorizonWindow per traded symbol and, with quantile horizons, a
+ * QuantileWindow (quantile_sketch.h) per symbol fed by its trades and
+ * quotes, all in registries indexed by interned symbol ID
+ * (symbol_registry.h). Field names and fallbacks follow
+ * StreamAggregator._append_to_ring. The windows can be checkpointed and
+ * restored across restarts (window_checkpoint.h).
+ *
+ * Only trades and best bid/ask have rings. Other JSON records (depth), and
+ * any the scanner cannot represent exactly (escaped symbols, non-string
+ * types), go back to the caller decompressed, for the dict path, and so do
+ * delta-encoded depth records (depth_delta.h) for the caller's decoder; Avro
+ * depth records have no dict path and are only counted.
+ *
+ * JSON is scanned rather than parsed: one object, members in any order,
+ * nested values skipped, strings taken raw. Not thread-safe, like the rings.
+ */
+
+#ifndef _SBE_RECORD_INGEST_H_
+#define _SBE_RECORD_INGEST_H_
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "avro_codecs.h"
+#include "depth_delta.h"
+#include "float_bits.h"
+#include "kpl_aggregate.h"
+#include "message_ring.h"
+#include "multi_horizon.h"
+#include "quantile_sketch.h"
+#include "record_codec.h"
+#include "stream_decode.h"
+#include "symbol_registry.h"
+#include "symbol_table.h"
+#include "window_checkpoint.h"
+
+namespace ingest_detail {
+
+enum class JsonKind : uint8_t {
+    String,
+    Number,
+    True,
+    False,
+    Null,
+    Compound,  // object or array, skipped; text is its raw span
+};
+
+struct JsonValue {
+    bool present = false;
+    JsonKind kind = JsonKind::Null;
+    std::string_view text;  // raw string contents, or the number's text
+};
+
+// fn(key, value) for each member of the one JSON object in `data`; throws
+// std::runtime_error on anything else
+template <typename Fn>
+void scan_json_object(std::span<const char> data, Fn &&fn) {
+    const char *at = data.data();
+    const char *const end = data.data() + data.size();
+    const auto is_space = [](char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+    const auto space = [&] {
+        while (at != end && is_space(*at)) {
+            ++at;
+        }
+    };
+    const auto peek = [&] {
+        if (at == end) {
+            throw std::runtime_error("json: truncated record");
+        }
+        return *at;
+    };
+    const auto expect = [&](char c) {
+        if (peek() != c) {
+            throw std::runtime_error("json: unexpected character");
+        }
+        ++at;
+    };
+    const auto string = [&] {
+        expect('"');
+        const char *start = at;
+        while (peek() != '"') {
+            if (*at++ == '\\') {
+                peek();
+                ++at;
+            }
+        }
+        return std::string_view(start, static_cast<std::size_t>(at++ - start));
+    };
+    const auto value = [&]() -> JsonValue {
+        const char c = peek();
+        if (c == '"') {
+            return {true, JsonKind::String, string()};
+        }
+        if (c == '{' || c == '[') {
+            const char *start = at;
+            int depth = 0;
+            do {
+                const char inner = peek();
+                if (inner == '"') {
+                    string();
+                    continue;
+                }
+                depth += (inner == '{' || inner == '[') ? 1 : (inner == '}' || inner == ']') ? -1 : 0;
+                ++at;
+            } while (depth > 0);
+            return {true, JsonKind::Compound, std::string_view(start, static_cast<std::size_t>(at - start))};
+        }
+        const char *start = at;
+        while (at != end && *at != ',' && *at != '}' && *at != ']' && !is_space(*at)) {
+            ++at;
+        }
+        const std::string_view text(start, static_cast<std::size_t>(at - start));
+        if (text == "true") {
+            return {true, JsonKind::True, text};
+        }
+        if (text == "false") {
+            return {true, JsonKind::False, text};
+        }
+        if (text == "null") {
+            return {true, JsonKind::Null, text};
+        }
+        if (text.empty()) {
+            throw std::runtime_error("json: missing value");
+        }
+        return {true, JsonKind::Number, text};
+    };
+
+    space();
+    expect('{');
+    space();
+    if (peek() == '}') {
+        ++at;
+    } else {
+        while (true) {
+            space();
+            const std::string_view key = string();
+            space();
+            expect(':');
+            space();
+            fn(key, value());
+            space();
+            if (peek() == ',') {
+                ++at;
+                continue;
+            }
+            expect('}');
+            break;
+        }
+    }
+    space();
+    if (at != end) {
+        throw std::runtime_error("json: trailing data");
+    }
+}
+
+// float(value): a number or a numeric string
+inline bool json_double(const JsonValue &value, double &out) {
+    if (value.kind != JsonKind::Number && value.kind != JsonKind::String) {
+        return false;
+    }
+    const char *end = value.text.data() + value.text.size();
+    const auto [ptr, ec] = std::from_chars(value.text.data(), end, out);
+    return ec == std::errc() && ptr == end;
+}
+
+// int(value): integers as they are, a JSON float truncated
+inline bool json_int64(const JsonValue &value, int64_t &out) {
+    const char *end = value.text.data() + value.text.size();
+    if (value.kind == JsonKind::Number || value.kind == JsonKind::String) {
+        const auto [ptr, ec] = std::from_chars(value.text.data(), end, out);
+        if (ec == std::errc() && ptr == end) {
+            return true;
+        }
+    }
+    double number = 0;
+    if (value.kind != JsonKind::Number || !json_double(value, number) || !finite_bits(number)) {
+        return false;
+    }
+    // Truncation past the int64 range is undefined; 2^63 itself is out
+    if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0)) {
+        return false;
+    }
+    out = static_cast<int64_t>(number);
+    return true;
+}
+
+// bool(value)
+inline bool json_truthy(const JsonValue &value) {
+    switch (value.kind) {
+    case JsonKind::True:
+        return true;
+    case JsonKind::String:
+        return !value.text.empty();
+    case JsonKind::Number: {
+        double number = 0;
+        return json_double(value, number) && number != 0;
+    }
+    default:
+        return false;
+    }
+}
+
+// The members _append_to_ring reads, in fallback pairs
+enum Field : std::size_t {
+    TYPE,
+    MSG_TYPE,
+    SYMBOL,
+    EVENT_TS,
+    TIMESTAMP,
+    PRICE,
+    QTY,
+    VOLUME,
+    IS_BUYER_MAKER,
+    BID_PX,
+    BID_PRICE,
+    BID_SZ,
+    BID_SIZE,
+    ASK_PX,
+    ASK_PRICE,
+    ASK_SZ,
+    ASK_SIZE,
+    FIELD_COUNT,
+};
+
+constexpr std::array<std::string_view, FIELD_COUNT> FIELD_NAMES = {
+    "type", "msg_type", "symbol", "event_ts", "timestamp", "price", "qty", "volume", "is_buyer_maker",
+    "bid_px", "bid_price", "bid_sz", "bid_size", "ask_px", "ask_price", "ask_sz", "ask_size",
+};
+
+using JsonFields = std::array<JsonValue, FIELD_COUNT>;
+
+// data.get(primary, data.get(fallback, 0)) as a float
+inline bool field_double(const JsonFields &fields, Field primary, Field fallback, double &out) {
+    const JsonValue &value = fields[primary].present ? fields[primary] : fields[fallback];
+    if (!value.present) {
+        out = 0;
+        return true;
+    }
+    return json_double(value, out);
+}
+
+} // namespace ingest_detail
+
+struct IngestCounts {
+    uint64_t records = 0;     // Kinesis records
+    uint64_t payloads = 0;    // after deaggregation
+    uint64_t aggregated = 0;  // KPL aggregates among the records
+    uint64_t compressed = 0;
+    uint64_t trades = 0;
+    uint64_t quotes = 0;
+    uint64_t returned = 0;  // handed back for the dict path
+    uint64_t skipped = 0;   // Avro records without a ring
+    uint64_t errors = 0;
+};
+
+enum class IngestKind : uint8_t {
+    Trades,
+    Quotes,
+};
+
+class RecordIngestor {
+public:
+    struct TradeBuffers {
+        TradeBuffers(std::size_t capacity, const std::vector<int64_t> &horizons_ms, int64_t pane_ms)
+            : ring(capacity), window(horizons_ms, pane_ms) {}
+
+        TradeRing ring;
+        MultiHorizonWindow window;
+    };
+
+    // A ring the ingestor created, not yet collected by take_new_buffers()
+    struct NewBuffer {
+        std::string symbol;
+        IngestKind kind;
+    };
+
+    // Rings hold `capacity` rows; trade windows cover `horizons_ms`, and
+    // quantile windows `quantile_horizons_ms` (none when empty)
+    RecordIngestor(std::size_t capacity, std::vector<int64_t> horizons_ms, int64_t pane_ms,
+                   std::vector<int64_t> quantile_horizons_ms = {})
+        : capacity_(capacity), horizons_ms_(std::move(horizons_ms)), pane_ms_(pane_ms),
+          quantile_horizons_ms_(std::move(quantile_horizons_ms)) {
+        // Validate the ring and window arguments up front
+        TradeBuffers probe(capacity_, horizons_ms_, pane_ms_);
+        if (!quantile_horizons_ms_.empty()) {
+            QuantileWindow quantile_probe(quantile_horizons_ms_, 0);
+        }
+    }
+
+    uint32_t add_dictionary(std::span<const char> dictionary) { return decompressor_.add_dictionary(dictionary); }
+
+    // Route one Kinesis record, a KPL aggregate or a single payload, and call
+    // other(partition_key, payload) for each payload left to the caller.
+    // The payload view is only valid during the call.
+    template <typename Other>
+    void ingest(std::string_view partition_key, std::span<const char> data, Other &&other) {
+        ++counts_.records;
+        if (!is_kpl_aggregate(data)) {
+            route(partition_key, data, other);
+            return;
+        }
+        std::vector<KplRecord> records;
+        try {
+            records = deaggregate_kpl(data);
+        } catch (const std::runtime_error &) {
+            ++counts_.errors;
+            return;
+        }
+        ++counts_.aggregated;
+        for (const KplRecord &record : records) {
+            route(record.partition_key, record.data, other);
+        }
+    }
+
+    TradeBuffers *trades(std::string_view symbol) const { return trades_.find(symbol_table().find(symbol)); }
+    QuoteRing *quotes(std::string_view symbol) const { return quotes_.find(symbol_table().find(symbol)); }
+    QuantileWindow *quantiles(std::string_view symbol) const {
+        return quantiles_.find(symbol_table().find(symbol));
+    }
+
+    std::vector<NewBuffer> take_new_buffers() { return std::exchange(new_buffers_, {}); }
+
+    // Restore the trade windows saved in `checkpoint`, creating the
+    // symbols' buffers (reported by take_new_buffers) as needed. Windows
+    // saved with other horizons are skipped; returns the ones restored.
+    std::size_t restore_windows(const WindowCheckpoint &checkpoint) {
+        const MultiHorizonWindow shape(horizons_ms_, pane_ms_);
+        std::size_t restored = 0;
+        for (std::size_t i = 0; i < checkpoint.size(); ++i) {
+            if (!checkpoint.matches(i, shape)) {
+                continue;
+            }
+            const std::string_view symbol = WindowCheckpoint::key_of(checkpoint.entries()[i]);
+            checkpoint.load(i, trade_buffers(symbol).window);
+            ++restored;
+        }
+        return restored;
+    }
+
+    // Every symbol's trade window, for write_window_checkpoint
+    std::vector<WindowCheckpointItem> windows() const {
+        std::vector<WindowCheckpointItem> result;
+        result.reserve(trades_.size());
+        trades_.for_each([&](SymbolId id, const TradeBuffers &buffers) {
+            result.push_back({symbol_table().name_of(id), &buffers.window});
+        });
+        return result;
+    }
+
+    const IngestCounts &counts() const { return counts_; }
+    std::vector<uint32_t> dictionary_ids() const { return decompressor_.dictionary_ids(); }
+
+private:
+    template <typename Other>
+    void route(std::string_view partition_key, std::span<const char> payload, Other &other) {
+        ++counts_.payloads;
+        try {
+            if (is_compressed_record(payload)) {
+                decompressor_.decompress(payload, inflated_);
+                payload = inflated_;
+                ++counts_.compressed;
+            }
+            if (payload.size() >= 2 && static_cast<uint8_t>(payload[0]) == AVRO_SINGLE_OBJECT_MAGIC[0] &&
+                static_cast<uint8_t>(payload[1]) == AVRO_SINGLE_OBJECT_MAGIC[1]) {
+                route_avro(payload);
+            } else if (is_depth_delta_record(payload) || !route_json(payload)) {
+                ++counts_.returned;
+                other(partition_key, payload);
+            }
+        } catch (const std::runtime_error &) {
+            ++counts_.errors;
+        }
+    }
+
+    void route_avro(std::span<const char> payload) {
+        AvroReader reader{payload};
+        const uint64_t fingerprint = reader.read_header();
+        if (fingerprint == avro_gen::MarketTrade::FINGERPRINT) {
+            avro_gen::MarketTrade record;
+            avro_gen::decode(reader, record);
+            trade(record.symbol, record.event_ts, record.price, record.qty, record.is_buyer_maker);
+        } else if (fingerprint == avro_gen::BestBidAsk::FINGERPRINT) {
+            avro_gen::BestBidAsk record;
+            avro_gen::decode(reader, record);
+            quote(record.symbol, record.event_ts, record.bid_px, record.bid_sz, record.ask_px, record.ask_sz);
+        } else {
+            ++counts_.skipped;
+        }
+    }
+
+    // False when the record is not a trade or best bid/ask the scanner can
+    // take exactly; throws on malformed JSON and unconvertible values
+    bool route_json(std::span<const char> payload) {
+        using namespace ingest_detail;
+        JsonFields fields;
+        scan_json_object(payload, [&](std::string_view key, const JsonValue &value) {
+            for (std::size_t i = 0; i < FIELD_COUNT; ++i) {
+                if (key == FIELD_NAMES[i]) {
+                    fields[i] = value;
+                    break;
+                }
+            }
+        });
+        const JsonValue &type = fields[TYPE].present ? fields[TYPE] : fields[MSG_TYPE];
+        const JsonValue &symbol = fields[SYMBOL];
+        if (type.kind != JsonKind::String || symbol.kind != JsonKind::String || symbol.text.empty() ||
+            symbol.text.find('\\') != std::string_view::npos) {
+            return false;
+        }
+        const bool is_trade = type.text == "trade";
+        if (!is_trade && type.text != "bestBidAsk") {
+            return false;
+        }
+
+        int64_t event_ts = 0;
+        const JsonValue &ts = fields[EVENT_TS].present ? fields[EVENT_TS] : fields[TIMESTAMP];
+        if (ts.present && !json_int64(ts, event_ts)) {
+            throw std::runtime_error("json: bad event_ts");
+        }
+        if (is_trade) {
+            double price = 0;
+            double qty = 0;
+            if (!field_double(fields, PRICE, PRICE, price) || !field_double(fields, QTY, VOLUME, qty)) {
+                throw std::runtime_error("json: bad trade field");
+            }
+            trade(symbol.text, event_ts, price, qty, json_truthy(fields[IS_BUYER_MAKER]));
+            return true;
+        }
+        double bid_px = 0;
+        double bid_sz = 0;
+        double ask_px = 0;
+        double ask_sz = 0;
+        if (!field_double(fields, BID_PX, BID_PRICE, bid_px) || !field_double(fields, BID_SZ, BID_SIZE, bid_sz) ||
+            !field_double(fields, ASK_PX, ASK_PRICE, ask_px) || !field_double(fields, ASK_SZ, ASK_SIZE, ask_sz)) {
+            throw std::runtime_error("json: bad quote field");
+        }
+        quote(symbol.text, event_ts, bid_px, bid_sz, ask_px, ask_sz);
+        return true;
+    }
+
+    // Records mostly repeat the previous symbol; only a change interns
+    SymbolId symbol_id(std::string_view symbol) {
+        if (last_id_ != INVALID_SYMBOL_ID && symbol == last_symbol_) {
+            return last_id_;
+        }
+        const SymbolId id = symbol_table().intern(symbol);
+        if (id == INVALID_SYMBOL_ID) {
+            throw std::runtime_error("Symbol table is full");
+        }
+        last_symbol_ = symbol_table().name_of(id);
+        last_id_ = id;
+        return id;
+    }
+
+    TradeBuffers &trade_buffers(std::string_view symbol) {
+        const SymbolId id = symbol_id(symbol);
+        if (TradeBuffers *buffers = trades_.find(id)) {
+            return *buffers;
+        }
+        TradeBuffers *buffers = trades_.emplace(id, capacity_, horizons_ms_, pane_ms_).first;
+        new_buffers_.push_back({std::string(symbol), IngestKind::Trades});
+        return *buffers;
+    }
+
+    void trade(std::string_view symbol, int64_t event_ts, double price, double qty, bool is_buyer_maker) {
+        TradeBuffers &buffers = trade_buffers(symbol);
+        buffers.ring.push(event_ts, price, qty, is_buyer_maker);
+        buffers.window.add(event_ts, price, qty, is_buyer_maker);
+        if (QuantileWindow *window = quantile_window(symbol_id(symbol))) {
+            window->add_trade(event_ts, qty);
+        }
+        ++counts_.trades;
+    }
+
+    void quote(std::string_view symbol, int64_t event_ts, double bid_px, double bid_sz, double ask_px,
+               double ask_sz) {
+        const SymbolId id = symbol_id(symbol);
+        QuoteRing *ring = quotes_.find(id);
+        if (ring == nullptr) {
+            ring = quotes_.emplace(id, capacity_).first;
+            new_buffers_.push_back({std::string(symbol), IngestKind::Quotes});
+        }
+        ring->push(event_ts, bid_px, bid_sz, ask_px, ask_sz);
+        if (QuantileWindow *window = quantile_window(id)) {
+            window->add_quote(event_ts, bid_px, ask_px);
+        }
+        ++counts_.quotes;
+    }
+
+    QuantileWindow *quantile_window(SymbolId id) {
+        if (quantile_horizons_ms_.empty()) {
+            return nullptr;
+        }
+        return quantiles_.emplace(id, quantile_horizons_ms_, 0).first;
+    }
+
+    std::size_t capacity_;
+    std::vector<int64_t> horizons_ms_;
+    int64_t pane_ms_;
+    RecordDecompressor decompressor_;
+    std::vector<char> inflated_;
+    // Blocks never move, so the rings handed to Python stay put
+    SymbolRegistry<TradeBuffers> trades_;
+    SymbolRegistry<QuoteRing> quotes_;
+    std::vector<int64_t> quantile_horizons_ms_;
+    SymbolRegistry<QuantileWindow> quantiles_;
+    std::string_view last_symbol_;
+    SymbolId last_id_ = INVALID_SYMBOL_ID;
+    std::vector<NewBuffer> new_buffers_;
+    IngestCounts counts_;
+};
+
+#endif
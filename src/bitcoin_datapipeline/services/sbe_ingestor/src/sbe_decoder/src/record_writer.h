@@ -0,0 +1,136 @@
+/*
+ * Bounded byte writer for serialized records.
+ *
+ * RecordWriter fills a caller-supplied span and never allocates. Once a
+ * write does not fit it sets an overflow flag and ignores everything after
+ * it, so serializers can write a whole record and check once at the end,
+ * then rewind() to drop the partial output.
+ */
+
+#ifndef _SBE_RECORD_WRITER_H_
+#define _SBE_RECORD_WRITER_H_
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+#include "decimal64.h"
+#include "decimal_text.h"
+
+// Appends to a fixed span; once something does not fit, every later write
+// is ignored and overflowed() reports it
+class RecordWriter {
+public:
+    explicit RecordWriter(std::span<char> out)
+        : begin_(out.data()), cursor_(out.data()), end_(out.data() + out.size()) {}
+
+    std::size_t size() const { return static_cast<std::size_t>(cursor_ - begin_); }
+    bool overflowed() const { return overflow_; }
+    // Everything written so far
+    std::span<const char> written() const { return {begin_, size()}; }
+
+    // Drop everything written past `size` (used to undo a partial frame)
+    void rewind(std::size_t size) {
+        cursor_ = begin_ + size;
+        overflow_ = false;
+    }
+
+    void put(char c) {
+        if (reserve(1)) {
+            *cursor_++ = c;
+        }
+    }
+
+    void put(std::string_view text) {
+        if (reserve(text.size())) {
+            std::memcpy(cursor_, text.data(), text.size());
+            cursor_ += text.size();
+        }
+    }
+
+    // Object key including the separator before it: `,"key":`
+    void key(std::string_view name, bool first = false) {
+        if (!first) {
+            put(',');
+        }
+        put('"');
+        put(name);
+        put("\":");
+    }
+
+    template <typename Int>
+    void integer(Int value) {
+        char buf[24];
+        const auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        put(std::string_view(buf, static_cast<std::size_t>(result.ptr - buf)));
+    }
+
+    void boolean(bool value) { put(value ? std::string_view("true") : std::string_view("false")); }
+
+    // Shortest round-trip form; integral values keep a ".0" like json.dumps
+    void number(double value) {
+        char buf[32];
+        const auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        const std::string_view text(buf, static_cast<std::size_t>(result.ptr - buf));
+        put(text);
+        if (text.find_first_of(".e") == std::string_view::npos) {
+            put(".0");
+        }
+    }
+
+    void decimal_string(double value) {
+        char buf[DECIMAL_TEXT_SIZE];
+        put('"');
+        put(format_decimal_text(value, buf));
+        put('"');
+    }
+
+    // mantissa * 10^exponent as an exact JSON number; integral values keep
+    // a ".0" like number()
+    void decimal_number(const Decimal64 &value) {
+        char buf[DECIMAL_TEXT_SIZE];
+        const std::string_view text = value.text(buf);
+        put(text);
+        if (text.find('.') == std::string_view::npos) {
+            put(".0");
+        }
+    }
+
+    // Exact text of mantissa * 10^exponent, no round trip through double
+    void decimal_string(int64_t mantissa, int8_t exponent) {
+        char buf[DECIMAL_TEXT_SIZE];
+        put('"');
+        put(format_mantissa_text(mantissa, exponent, buf));
+        put('"');
+    }
+
+    // Symbols are plain ASCII and never need escaping; always upper case
+    void symbol(std::string_view value) {
+        put('"');
+        if (reserve(value.size())) {
+            for (const char c : value) {
+                *cursor_++ = (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+            }
+        }
+        put('"');
+    }
+
+private:
+    bool reserve(std::size_t count) {
+        if (overflow_ || static_cast<std::size_t>(end_ - cursor_) < count) {
+            overflow_ = true;
+            return false;
+        }
+        return true;
+    }
+
+    char *begin_;
+    char *cursor_;
+    char *end_;
+    bool overflow_ = false;
+};
+
+#endif
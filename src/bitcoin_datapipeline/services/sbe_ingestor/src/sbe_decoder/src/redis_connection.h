@@ -0,0 +1,289 @@
+/*
+ * Minimal blocking Redis client connection (RESP2 over plain TCP), for the
+ * symbol lease manager (symbol_shard.h).
+ *
+ * command() writes one command as an array of bulk strings and reads its
+ * whole reply, nested arrays included. An error reply (-ERR ...) throws
+ * std::runtime_error but leaves the connection usable, since the protocol
+ * is still in step; an I/O or protocol failure throws and leaves it closed,
+ * and the caller reconnects. A password is sent with AUTH and a database
+ * other than 0 chosen with SELECT right after connecting. There is no TLS:
+ * the lease store is expected on the ingest hosts' private network.
+ */
+
+#ifndef _SBE_REDIS_CONNECTION_H_
+#define _SBE_REDIS_CONNECTION_H_
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct RedisEndpoint {
+    std::string host = "127.0.0.1";
+    uint16_t port = 6379;
+    std::string password;
+    int db = 0;
+    int connect_timeout_ms = 2000;
+    // Send and receive timeout per socket call
+    int io_timeout_ms = 2000;
+};
+
+struct RedisReply {
+    enum class Type : uint8_t { Nil, Status, Integer, Bulk, Array };
+
+    Type type = Type::Nil;
+    int64_t integer = 0;
+    // Status or bulk string
+    std::string text;
+    std::vector<RedisReply> elements;
+
+    bool nil() const { return type == Type::Nil; }
+};
+
+class RedisConnection {
+public:
+    RedisConnection() = default;
+    ~RedisConnection() { close(); }
+
+    RedisConnection(const RedisConnection &) = delete;
+    RedisConnection &operator=(const RedisConnection &) = delete;
+
+    void connect(const RedisEndpoint &endpoint) {
+        close();
+        try {
+            open_socket(endpoint);
+            if (!endpoint.password.empty()) {
+                command({"AUTH", endpoint.password});
+            }
+            if (endpoint.db != 0) {
+                command({"SELECT", std::to_string(endpoint.db)});
+            }
+        } catch (...) {
+            close();
+            throw;
+        }
+    }
+
+    bool connected() const { return fd_ >= 0; }
+
+    RedisReply command(const std::vector<std::string> &args) {
+        if (fd_ < 0) {
+            throw std::runtime_error("redis: not connected");
+        }
+        request_ = "*" + std::to_string(args.size()) + "\r\n";
+        for (const std::string &arg : args) {
+            request_ += "$" + std::to_string(arg.size()) + "\r\n";
+            request_ += arg;
+            request_ += "\r\n";
+        }
+        RedisReply reply;
+        std::string error;
+        try {
+            write_all(request_.data(), request_.size());
+            read_reply(reply, error, 0);
+        } catch (...) {
+            close();
+            throw;
+        }
+        if (!error.empty()) {
+            throw std::runtime_error("redis: " + error);
+        }
+        return reply;
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        read_buf_.clear();
+        read_pos_ = 0;
+    }
+
+private:
+    static constexpr int MAX_DEPTH = 8;
+
+    void open_socket(const RedisEndpoint &endpoint) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *results = nullptr;
+        const std::string port = std::to_string(endpoint.port);
+        if (const int rc = ::getaddrinfo(endpoint.host.c_str(), port.c_str(), &hints, &results); rc != 0) {
+            throw std::runtime_error("redis resolve failed for " + endpoint.host + ": " + ::gai_strerror(rc));
+        }
+
+        std::string last_error = "no addresses";
+        for (addrinfo *ai = results; ai != nullptr; ai = ai->ai_next) {
+            const int fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) {
+                last_error = std::strerror(errno);
+                continue;
+            }
+            set_timeouts(fd, endpoint.connect_timeout_ms);
+            if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                const int one = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                set_timeouts(fd, endpoint.io_timeout_ms);
+                fd_ = fd;
+                break;
+            }
+            last_error = std::strerror(errno);
+            ::close(fd);
+        }
+        ::freeaddrinfo(results);
+        if (fd_ < 0) {
+            throw std::runtime_error("redis connect to " + endpoint.host + " failed: " + last_error);
+        }
+    }
+
+    static void set_timeouts(int fd, int timeout_ms) {
+        timeval timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+
+    // One reply into `out`; the first error reply met, at any depth, into
+    // `error` (the rest of the reply is still read, to stay in step)
+    void read_reply(RedisReply &out, std::string &error, int depth) {
+        if (depth > MAX_DEPTH) {
+            throw std::runtime_error("redis: reply nested too deeply");
+        }
+        const std::string line = read_line();
+        if (line.empty()) {
+            throw std::runtime_error("redis: empty reply line");
+        }
+        const std::string_view body = std::string_view(line).substr(1);
+        switch (line[0]) {
+        case '+':
+            out.type = RedisReply::Type::Status;
+            out.text.assign(body);
+            return;
+        case '-':
+            out.type = RedisReply::Type::Nil;
+            if (error.empty()) {
+                error.assign(body);
+            }
+            return;
+        case ':':
+            out.type = RedisReply::Type::Integer;
+            out.integer = parse_integer(body);
+            return;
+        case '$': {
+            const int64_t size = parse_integer(body);
+            if (size < 0) {
+                out.type = RedisReply::Type::Nil;
+                return;
+            }
+            out.type = RedisReply::Type::Bulk;
+            read_exact(out.text, static_cast<std::size_t>(size));
+            std::string crlf;
+            read_exact(crlf, 2);
+            if (crlf != "\r\n") {
+                throw std::runtime_error("redis: bulk string not terminated");
+            }
+            return;
+        }
+        case '*': {
+            const int64_t count = parse_integer(body);
+            if (count < 0) {
+                out.type = RedisReply::Type::Nil;
+                return;
+            }
+            out.type = RedisReply::Type::Array;
+            out.elements.resize(static_cast<std::size_t>(count));
+            for (RedisReply &element : out.elements) {
+                read_reply(element, error, depth + 1);
+            }
+            return;
+        }
+        default:
+            throw std::runtime_error("redis: unknown reply type '" + std::string(1, line[0]) + "'");
+        }
+    }
+
+    static int64_t parse_integer(std::string_view text) {
+        int64_t value = 0;
+        const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (ec != std::errc() || ptr != text.data() + text.size()) {
+            throw std::runtime_error("redis: bad integer '" + std::string(text) + "'");
+        }
+        return value;
+    }
+
+    std::string read_line() {
+        std::size_t end = std::string::npos;
+        std::size_t scanned = 0;
+        while ((end = read_buf_.find("\r\n", read_pos_ + scanned)) == std::string::npos) {
+            if (read_buf_.size() - read_pos_ > 64 * 1024) {
+                throw std::runtime_error("redis: reply line too long");
+            }
+            scanned = std::max<std::size_t>(read_buf_.size() - read_pos_, 1) - 1;
+            fill();
+        }
+        std::string line = read_buf_.substr(read_pos_, end - read_pos_);
+        read_pos_ = end + 2;
+        return line;
+    }
+
+    // Replace `out` with the next `size` bytes
+    void read_exact(std::string &out, std::size_t size) {
+        out.clear();
+        while (read_buf_.size() - read_pos_ < size) {
+            fill();
+        }
+        out.assign(read_buf_, read_pos_, size);
+        read_pos_ += size;
+    }
+
+    // Read more bytes into the buffer, dropping what was already consumed
+    void fill() {
+        if (read_pos_ > 0) {
+            read_buf_.erase(0, read_pos_);
+            read_pos_ = 0;
+        }
+        char chunk[16 * 1024];
+        ssize_t n = 0;
+        do {
+            n = ::recv(fd_, chunk, sizeof(chunk), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            throw std::runtime_error(n == 0 ? "redis connection closed"
+                                            : std::string("redis read failed: ") + std::strerror(errno));
+        }
+        read_buf_.append(chunk, static_cast<std::size_t>(n));
+    }
+
+    void write_all(const char *data, std::size_t size) {
+        while (size > 0) {
+            const ssize_t n = ::send(fd_, data, size, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("redis write failed: ") + std::strerror(errno));
+            }
+            data += n;
+            size -= static_cast<std::size_t>(n);
+        }
+    }
+
+    int fd_ = -1;
+    std::string request_;
+    std::string read_buf_;
+    std::size_t read_pos_ = 0;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/*
+ * Interned keys and per-template dict shapes for the dict API
+ * (decode_message, try_decode, decode_trades).
+ *
+ * Writing result["event_ts"] builds a key str from the C string and hashes
+ * it on every call. ResultKeys interns every key the decoders write once
+ * per interpreter (interpreter_state.h), at module init, and set_item
+ * stores through PyDict_SetItem with the cached key, whose hash is already
+ * computed.
+ *
+ * ResultShapes goes one step further for decode_message: the first
+ * successful decode of a template records the dict's keys, and every later
+ * one starts from a copy of that shape (a table copy, already sized, no
+ * rehashing) and only replaces values. A fill function writes the same keys
+ * on every success, so nothing stale survives; failures build their
+ * placeholder dict from scratch.
+ */
+
+#ifndef _SBE_RESULT_KEYS_H_
+#define _SBE_RESULT_KEYS_H_
+
+#include <pybind11/pybind11.h>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "interpreter_state.h"
+#include "stream_decode.h"
+#include "template_dispatch.h"
+
+namespace py = pybind11;
+
+// Every key the native dict decoders write, debug_* fields aside
+#define SBE_RESULT_KEYS(X) \
+    X(agg_trade_id)        \
+    X(agg_trades)          \
+    X(ask_px)              \
+    X(ask_sz)              \
+    X(asks)                \
+    X(bid_px)              \
+    X(bid_sz)              \
+    X(bids)                \
+    X(book_update_id)      \
+    X(event_ts)            \
+    X(final_update_id)     \
+    X(first_trade_id)      \
+    X(first_update_id)     \
+    X(id)                  \
+    X(ingest_ts)           \
+    X(ingest_ts_us)        \
+    X(is_best_match)       \
+    X(is_buyer_maker)      \
+    X(klines)              \
+    X(last_trade_id)       \
+    X(last_update_id)      \
+    X(msg_type)            \
+    X(parse_error)         \
+    X(price)               \
+    X(price_exponent)      \
+    X(price_mantissa)      \
+    X(qty)                 \
+    X(qty_exponent)        \
+    X(qty_mantissa)        \
+    X(quote_qty)           \
+    X(source)              \
+    X(symbol)              \
+    X(template_id)         \
+    X(tickers)             \
+    X(time)                \
+    X(trace)               \
+    X(trade_id)            \
+    X(trade_time)          \
+    X(trades)
+
+struct ResultKeys {
+    static constexpr const char *STATE_KEY = "sbe_decoder_cpp.result_keys";
+
+#define SBE_DECLARE_RESULT_KEY(name) py::object name = intern(#name);
+    SBE_RESULT_KEYS(SBE_DECLARE_RESULT_KEY)
+#undef SBE_DECLARE_RESULT_KEY
+
+    // Constant values shared by every result
+    py::object sbe = intern("sbe");
+
+private:
+    static py::object intern(const char *text) {
+        PyObject *str = PyUnicode_InternFromString(text);
+        if (str == nullptr) {
+            throw py::error_already_set();
+        }
+        return py::reinterpret_steal<py::object>(str);
+    }
+};
+
+// The calling interpreter's interned keys; first built from PYBIND11_MODULE.
+// Immutable once built, so any thread may read them.
+inline const ResultKeys &result_keys() {
+    return interpreter_state<ResultKeys>();
+}
+
+template <typename T>
+void set_item(py::dict &dict, const py::object &key, T &&value) {
+    const py::object item = py::cast(std::forward<T>(value));
+    if (PyDict_SetItem(dict.ptr(), key.ptr(), item.ptr()) != 0) {
+        throw py::error_already_set();
+    }
+}
+
+// Result header shared by every template: msg_type, source, template_id,
+// ingest_ts, ingest_ts_us
+inline void set_result_header(py::dict &result, const py::object &msg_type, uint16_t template_id,
+                              uint64_t ingest_us) {
+    const ResultKeys &keys = result_keys();
+    set_item(result, keys.msg_type, msg_type);
+    set_item(result, keys.source, keys.sbe);
+    set_item(result, keys.template_id, template_id);
+    set_item(result, keys.ingest_ts, micros_to_millis(ingest_us));
+    set_item(result, keys.ingest_ts_us, ingest_us);
+}
+
+// One decoder's learned dict shapes, by template. Not thread-safe; the
+// owning decoder only uses it under its InstanceLock (instance_lock.h).
+class ResultShapes {
+public:
+    // A dict for `template_id` holding the result header, copied from the
+    // template's learned shape when there is one
+    py::dict start(uint16_t template_id, const char *msg_type, uint64_t ingest_us) {
+        Shape *shape = find(template_id);
+        if (shape != nullptr && shape->keys) {
+            PyObject *copy = PyDict_Copy(shape->keys.ptr());
+            if (copy == nullptr) {
+                throw py::error_already_set();
+            }
+            py::dict result = py::reinterpret_steal<py::dict>(copy);
+            set_result_header(result, shape->msg_type, template_id, ingest_us);
+            return result;
+        }
+        py::dict result;
+        set_result_header(result, msg_type_str(template_id, msg_type), template_id, ingest_us);
+        return result;
+    }
+
+    // Record the keys of a successfully filled result as the template's
+    // shape, if it has none yet
+    void learn(uint16_t template_id, const py::dict &result) {
+        Shape *shape = find(template_id);
+        if (shape == nullptr || shape->keys) {
+            return;
+        }
+        // Keys only: holding the first result's values would keep its level
+        // views (and so the decoder's arena) alive
+        py::dict keys;
+        for (const auto item : result) {
+            set_item(keys, py::reinterpret_borrow<py::object>(item.first), py::none());
+        }
+        shape->keys = std::move(keys);
+    }
+
+    // Header-only dict for a fill that failed, so no learned key leaks
+    // into the placeholder result
+    py::dict restart(uint16_t template_id, const char *msg_type, uint64_t ingest_us) {
+        py::dict result;
+        set_result_header(result, msg_type_str(template_id, msg_type), template_id, ingest_us);
+        return result;
+    }
+
+private:
+    struct Shape {
+        py::object msg_type;
+        // Null until learned
+        py::object keys;
+    };
+
+    using Table = TemplateTable<int>;
+
+    Shape *find(uint16_t template_id) {
+        const std::size_t index = Table::slot(template_id);
+        return index == Table::NO_SLOT ? nullptr : &shapes_[index];
+    }
+
+    // msg_type as an interned str, cached per template
+    py::object msg_type_str(uint16_t template_id, const char *msg_type) {
+        Shape *shape = find(template_id);
+        if (shape == nullptr) {
+            return py::str(msg_type);
+        }
+        if (!shape->msg_type) {
+            PyObject *str = PyUnicode_InternFromString(msg_type);
+            if (str == nullptr) {
+                throw py::error_already_set();
+            }
+            shape->msg_type = py::reinterpret_steal<py::object>(str);
+        }
+        return shape->msg_type;
+    }
+
+    std::array<Shape, Table::SLOT_COUNT> shapes_{};
+};
+
+#endif
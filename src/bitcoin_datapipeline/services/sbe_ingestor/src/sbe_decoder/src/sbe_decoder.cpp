@@ -9,28 +9,112 @@
  */
 
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include <string>
 #include <vector>
 #include <optional>
+#include <memory>
+#include <unordered_map>
 #include <span>
 #include <cstring>
 #include <cmath>
-#include <chrono>
 #include <algorithm>
 #include <stdexcept>
 #include <cstdio>
+#include <limits>
+#include <map>
+#include <new>
+#include <cstdlib>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <tuple>
+#include <cctype>
 
 // Include official Binance SBE headers
 #include "spot_sbe/MessageHeader.h"
 #include "spot_sbe/ErrorResponse.h"
 #include "spot_sbe/BoolEnum.h"
 
+#include "stream_decode.h"
+#include "stream_events.h"
+#include "batch_decode.h"
+#include "numpy_columns.h"
+#include "message_decoders.h"
+#include "message_view.h"
+#include "ingest_clock.h"
+#include "alloc_accounting.h"
+#include "decode_stats.h"
+#include "trace_stamps.h"
+#include "frame_capture.h"
+#include "native_log.h"
+#include "native_metrics.h"
+#include "order_book.h"
+#include "stream_receiver.h"
+#include "capture_journal.h"
+#include "journal_replay.h"
+#include "event_merge.h"
+#include "event_log.h"
+#include "conflation.h"
+#include "decoder_pool.h"
+#include "dedup_window.h"
+#include "dedup_filter.h"
+#include "trade_window.h"
+#include "column_stats.h"
+#include "cpu_dispatch.h"
+#include "message_ring.h"
+#include "multi_horizon.h"
+#include "quantile_sketch.h"
+#include "window_checkpoint.h"
+#include "feature_record.h"
+#include "kpl_aggregate.h"
+#include "record_codec.h"
+#include "feature_bus.h"
+#include "mlp_model.h"
+#include "feature_assembler.h"
+#include "depth_snapshot.h"
+#include "depth_json.h"
+#include "symbol_rules.h"
+#include "kinesis_records.h"
+#include "depth_delta.h"
+#include "record_ingest.h"
+#include "parquet_writer.h"
+#include "arrow_export.h"
+#include "ndjson_columns.h"
+#include "pg_copy.h"
+#include "book_sync.h"
+#include "interval_set.h"
+#include "timer_wheel.h"
+#include "bar_builder.h"
+#include "kline_check.h"
+#include "rate_governor.h"
+#include "ws_api_client.h"
+#include "backfill_pool.h"
+#include "synthetic_stream.h"
+#include "stream_load_server.h"
+#include "instance_lock.h"
+#include "message_walk.h"
+#include "kinesis_producer.h"
+#include "hot_partition.h"
+#include "ingest_pipeline.h"
+#include "feed_arbiter.h"
+#include "exchange_clock.h"
+#include "feature_history.h"
+#include "tick_store.h"
+#include "sparse_index.h"
+#include "training_loader.h"
+#include "forward_labels.h"
+#include "book_sampler.h"
+#include "page_memory.h"
+#include "memory_accounting.h"
+#include "subscription_mask.h"
+#include "symbol_shard.h"
+
 // Include decimal handling
-struct Decimal {
-    int64_t mantissa;
-    int8_t exponent;
-};
+#include "official/decimal.h"
+#include "official/json.h"
+#include "decimal_text.h"
 
 namespace py = pybind11;
 
@@ -38,511 +122,3926 @@ using spot_sbe::MessageHeader;
 using spot_sbe::ErrorResponse;
 using spot_sbe::BoolEnum;
 
-namespace {
+// Counting replacements of the global operator new (alloc_accounting.h).
+// They allocate with malloc like the library's own, so the library's
+// operator delete frees their memory and memory from any other operator new
+// the dynamic linker binds elsewhere.
+void* operator new(std::size_t size) {
+    count_heap_allocation(size);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
 
-template <typename T>
-T read_little_endian(const char *data, std::size_t data_size, std::size_t &offset)
-{
-    if (offset + sizeof(T) > data_size)
-    {
-        throw std::runtime_error("SBE decode: truncated buffer");
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    count_heap_allocation(size);
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a size that is a multiple of the alignment
+    if (void* p = std::aligned_alloc(align, (std::max<std::size_t>(size, 1) + align - 1) / align * align)) {
+        return p;
     }
+    throw std::bad_alloc();
+}
 
-    T value{};
-    std::memcpy(&value, data + offset, sizeof(T));
-    offset += sizeof(T);
-    return value;
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return ::operator new(size, alignment);
 }
 
-std::string preview_next_bytes_hex(const char *data, std::size_t data_size, std::size_t offset, std::size_t count)
-{
-    std::size_t preview_len = std::min(count, data_size > offset ? data_size - offset : 0);
-    std::string hex;
-    hex.reserve(preview_len * 2);
+// Python object-domain allocator hook for allocation accounting: counts on
+// the calling thread, then defers to the allocator it wrapped
+namespace py_alloc_hook {
 
-    for (std::size_t i = 0; i < preview_len; ++i)
-    {
-        char buf[3];
-        std::snprintf(buf, sizeof(buf), "%02x", static_cast<unsigned char>(data[offset + i]));
-        hex.append(buf);
+PyMemAllocatorEx wrapped{};
+
+void* hook_malloc(void*, size_t size) {
+    count_py_allocation();
+    return wrapped.malloc(wrapped.ctx, size);
+}
+
+void* hook_calloc(void*, size_t count, size_t size) {
+    count_py_allocation();
+    return wrapped.calloc(wrapped.ctx, count, size);
+}
+
+void* hook_realloc(void*, void* ptr, size_t size) {
+    if (ptr == nullptr) {
+        count_py_allocation();
     }
+    return wrapped.realloc(wrapped.ctx, ptr, size);
+}
 
-    return hex;
+void hook_free(void*, void* ptr) {
+    wrapped.free(wrapped.ctx, ptr);
 }
 
-} // namespace
+// Install once per process. It stays installed: memory allocated through
+// it may be freed at any time later. Not on a free-threaded build, whose
+// garbage collector finds objects through its own allocator's heaps; there
+// py_allocations stays zero.
+void install() {
+#ifndef Py_GIL_DISABLED
+    static std::once_flag installed;
+    std::call_once(installed, [] {
+        PyMem_GetAllocator(PYMEM_DOMAIN_OBJ, &wrapped);
+        PyMemAllocatorEx hook{nullptr, &hook_malloc, &hook_calloc, &hook_realloc, &hook_free};
+        PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &hook);
+    });
+#endif
+}
 
-// Stream template IDs for WebSocket streams (as expected by binance_sbe.py)
-constexpr uint16_t TRADES_STREAM_EVENT = 10000;
-constexpr uint16_t BEST_BID_ASK_STREAM_EVENT = 10001;
-constexpr uint16_t DEPTH_DIFF_STREAM_EVENT = 10003; // Updated to match your logs
+}  // namespace py_alloc_hook
 
-// Schema constants
-constexpr uint16_t EXPECTED_SCHEMA_ID = 1;
-constexpr uint16_t EXPECTED_SCHEMA_VERSION = 0;
 
 // WebSocket streaming uses a wrapper format
 // The actual data comes after WebSocket SBE wrapping
 // Let's decode the raw SBE data directly without assuming struct layouts
 
-// Utility functions (from official sample patterns)
-std::vector<char> read_payload_from_python(const py::bytes& data) {
-    const char* buffer = PyBytes_AsString(data.ptr());
-    size_t size = PyBytes_Size(data.ptr());
-    return std::vector<char>(buffer, buffer + size);
+// Borrowed view over a Python object exporting the buffer protocol
+// (bytes, bytearray, memoryview, mmap slices). The frame is decoded in
+// place: PyBUF_SIMPLE gives us a contiguous pointer and length without
+// copying or allocating, and the export is released when the view dies.
+// Output buffers are requested with PyBUF_WRITABLE.
+class FrameBuffer {
+public:
+    explicit FrameBuffer(const py::buffer& data, int flags = PyBUF_SIMPLE) {
+        if (PyObject_GetBuffer(data.ptr(), &view_, flags) != 0) {
+            throw py::error_already_set();
+        }
+    }
+
+    ~FrameBuffer() {
+        PyBuffer_Release(&view_);
+    }
+
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+    // The generated codecs take char*, but decoding never writes through it
+    std::span<char> payload() const {
+        return {static_cast<char*>(view_.buf), static_cast<size_t>(view_.len)};
+    }
+
+private:
+    Py_buffer view_{};
+};
+
+// Buffer exports for a whole batch of frames, released together. The
+// exports pin the frames' memory while decoding runs without the GIL.
+// With `walk_messages`, a buffer (or offsets slice) holding several SBE
+// messages back to back becomes one frame per message (message_walk.h).
+class FrameBufferList {
+public:
+    explicit FrameBufferList(bool walk_messages = false) : walk_messages_(walk_messages) {}
+
+    ~FrameBufferList() {
+        for (auto& view : views_) {
+            PyBuffer_Release(&view);
+        }
+    }
+
+    FrameBufferList(const FrameBufferList&) = delete;
+    FrameBufferList& operator=(const FrameBufferList&) = delete;
+
+    void add(const py::handle& obj) {
+        push(export_buffer(obj));
+    }
+
+    // Split one contiguous buffer at `offsets` (n + 1 ascending boundaries)
+    void add_split(const py::buffer& data, const py::array_t<int64_t, py::array::c_style | py::array::forcecast>& offsets) {
+        const auto whole = export_buffer(data);
+
+        const auto* bounds = offsets.data();
+        const auto count = offsets.size();
+        if (count < 1) {
+            throw py::value_error("decode_batch: offsets must hold at least one boundary");
+        }
+        frames_.reserve(frames_.size() + static_cast<size_t>(count - 1));
+        for (py::ssize_t i = 0; i + 1 < count; ++i) {
+            const auto begin = bounds[i];
+            const auto end = bounds[i + 1];
+            if (begin < 0 || end < begin || static_cast<size_t>(end) > whole.size()) {
+                throw py::value_error("decode_batch: offsets must be ascending and within the buffer");
+            }
+            push(whole.subspan(static_cast<size_t>(begin), static_cast<size_t>(end - begin)));
+        }
+    }
+
+    std::span<const std::span<char>> frames() const {
+        return frames_;
+    }
+
+private:
+    std::span<char> export_buffer(const py::handle& obj) {
+        Py_buffer view{};
+        if (PyObject_GetBuffer(obj.ptr(), &view, PyBUF_SIMPLE) != 0) {
+            throw py::error_already_set();
+        }
+        views_.push_back(view);
+        return {static_cast<char*>(view.buf), static_cast<size_t>(view.len)};
+    }
+
+    void push(std::span<char> frame) {
+        if (walk_messages_) {
+            split_messages(frame, frames_);
+        } else {
+            frames_.push_back(frame);
+        }
+    }
+
+    bool walk_messages_;
+    std::vector<Py_buffer> views_;
+    std::vector<std::span<char>> frames_;
+};
+
+using OffsetsArray = py::array_t<int64_t, py::array::c_style | py::array::forcecast>;
+
+// decode_batch input: an iterable of buffers, or one buffer plus offsets.
+// A lone buffer without offsets is one frame, or with a walking `buffers`
+// the messages it holds.
+void collect_frames(FrameBufferList& buffers, const py::object& frames, const std::optional<OffsetsArray>& offsets) {
+    if (offsets) {
+        buffers.add_split(py::reinterpret_borrow<py::buffer>(frames), *offsets);
+    } else if (PyObject_CheckBuffer(frames.ptr())) {
+        buffers.add(frames);
+    } else {
+        for (auto frame : py::reinterpret_borrow<py::iterable>(frames)) {
+            buffers.add(frame);
+        }
+    }
 }
 
-bool as_bool(const BoolEnum::Value bool_enum) {
-    switch (bool_enum) {
-        case BoolEnum::Value::False: 
-            return false;
-        case BoolEnum::Value::True: 
-            return true;
-        case BoolEnum::Value::NULL_VALUE:
-            return false;
+py::array symbols_to_numpy(std::vector<SymbolCode>&& symbols) {
+    return column_to_numpy(std::move(symbols), py::dtype("S16"));
+}
+
+py::array flags_to_numpy(std::vector<uint8_t>&& flags) {
+    return column_to_numpy(std::move(flags), py::dtype("bool"));
+}
+
+// Top-of-book levels as (price, qty) tuples, best price first
+py::list book_side_to_python(const BookSideLevels& side, std::size_t depth,
+                             int8_t price_exponent, int8_t qty_exponent) {
+    py::list result;
+    side.for_each_top(depth, [&](const BookLevel& level) {
+        result.append(py::make_tuple(decode_decimal(level.price, price_exponent),
+                                     decode_decimal(level.qty, qty_exponent)));
+    });
+    return result;
+}
+
+// A read-only (rows, 2) array over the side's levels snapshot, which it
+// keeps alive: no copy, and it stays as it was while the book moves on
+py::array book_levels_array(const OrderBook& book, BookSide side, std::size_t n, const std::string& dtype) {
+    if (dtype != "int64" && dtype != "float64") {
+        throw py::value_error("OrderBook: dtype must be 'int64' (mantissas) or 'float64'");
     }
-    return false;
+    auto snapshot = book.levels_snapshot(side, n, dtype == "float64");
+    const auto rows = static_cast<py::ssize_t>(std::min(n, snapshot->rows));
+    const BookLevelsSnapshot& levels = *snapshot;
+    py::capsule owner(new std::shared_ptr<const BookLevelsSnapshot>(std::move(snapshot)), [](void* held) {
+        delete static_cast<std::shared_ptr<const BookLevelsSnapshot>*>(held);
+    });
+    const std::vector<py::ssize_t> shape{rows, 2};
+    py::array array = levels.decoded ? py::array(py::array_t<double>(shape, levels.values.data(), owner))
+                                     : py::array(py::array_t<int64_t>(shape, levels.mantissas.data(), owner));
+    array.attr("flags").attr("writeable") = false;
+    return array;
+}
+
+py::object best_level_to_python(const OrderBook& book, const BookSideLevels& side) {
+    if (side.empty()) {
+        return py::none();
+    }
+    const auto& best = side.best();
+    return py::make_tuple(decode_decimal(best.price, book.price_exponent()),
+                          decode_decimal(best.qty, book.qty_exponent()));
 }
 
-double decode_decimal(int64_t mantissa, int8_t exponent) {
-    // Binance SBE uses mantissa * 10^exponent format
-    // Exponent is typically negative (e.g. -8) meaning divide by 10^8
-    return static_cast<double>(mantissa) * std::pow(10.0, static_cast<double>(exponent));
+// The book's feature vector, laid out as BOOK_FEATURE_NAMES
+py::array book_features_to_numpy(const OrderBook& book) {
+    const BookFeatureVector& features = book.features();
+    return column_to_numpy(std::vector<double>(features.begin(), features.end()));
 }
 
-double decode_price_from_raw(uint64_t raw_value) {
-    // REST shows ~124k, SBE shows ~11M after /10^12 scaling
-    // Need to scale down more: 11M / 124k ≈ 100x difference
-    // Try 10^14 to get closer to correct range
-    return static_cast<double>(raw_value) / 100000000000000.0; // 10^14
+// Order-flow sums as {ofi: levels 1..N, bid/ask added/removed, updates}
+py::dict order_flow_to_python(const OrderFlowTotals& totals) {
+    py::dict result;
+    result["ofi"] = column_to_numpy(std::vector<double>(totals.ofi.begin(), totals.ofi.begin() + totals.levels));
+    result["bid_added"] = totals.bid_added;
+    result["bid_removed"] = totals.bid_removed;
+    result["ask_added"] = totals.ask_added;
+    result["ask_removed"] = totals.ask_removed;
+    result["updates"] = totals.updates;
+    return result;
 }
 
-double decode_quantity_from_raw(uint64_t raw_value) {
-    // Based on empirical data:
-    // REST qty: 0.001, SBE: 11.24 (after /10^18)
-    // Need additional scaling: 11.24 / 0.001 = 11,240 ≈ 10^4
-    // So total scaling should be 10^18 * 10^4 = 10^22
-    return static_cast<double>(raw_value) / 10000000000000000000000.0; // 10^22
+std::vector<BookLevel> levels_from_python(const std::vector<std::pair<int64_t, int64_t>>& levels) {
+    std::vector<BookLevel> result;
+    result.reserve(levels.size());
+    for (const auto& [price, qty] : levels) {
+        result.push_back(BookLevel{price, qty});
+    }
+    return result;
 }
 
-double decode_bid_ask_price_from_raw(uint64_t raw_value) {
-    // BBA prices now showing e-12 values, which is way too small
-    // Need much less scaling - try same as trade prices first
-    return static_cast<double>(raw_value) / 100000000000000.0; // 10^14 (same as trades)
+// Decode a template 10003 (diff) or 10002 (partial depth) frame and apply
+// it to `book` in one pass
+ApplyStatus apply_depth_frame(OrderBook& book, const py::buffer& data) {
+    FrameBuffer buffer{data};
+    const auto payload = buffer.payload();
+    if (payload.size() < MessageHeader::encodedLength()) {
+        throw py::value_error("OrderBook.apply: buffer shorter than SBE message header");
+    }
+    MessageHeader header{payload.data(), payload.size()};
+    const char* body = payload.data() + MessageHeader::encodedLength();
+    const std::size_t body_size = payload.size() - MessageHeader::encodedLength();
+    try {
+        switch (header.templateId()) {
+        case DEPTH_DIFF_STREAM_EVENT: {
+            DepthDiffFrame diff;
+            if (const auto error = parse_depth_diff_frame(body, body_size, header.blockLength(), diff);
+                error != ParseError::None) {
+                throw_parse_error(error, "depth");
+            }
+            return book.apply_diff(body, diff);
+        }
+        case DEPTH_SNAPSHOT_STREAM_EVENT: {
+            DepthSnapshotFrame snapshot;
+            if (const auto error = parse_depth_snapshot_frame(body, body_size, header.blockLength(), snapshot);
+                error != ParseError::None) {
+                throw_parse_error(error, "depth");
+            }
+            return book.apply_partial_depth(body, snapshot);
+        }
+        default:
+            throw py::value_error("OrderBook.apply: expected a depth diff (10003) or partial depth (10002) frame");
+        }
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
 }
 
-uint64_t micros_to_millis(uint64_t micros) {
-    return micros / 1000;
+// BookSync.apply: a template 10003 frame applied or buffered in one pass
+ApplyStatus sync_apply_depth_frame(BookSync& sync, const py::buffer& data) {
+    FrameBuffer buffer{data};
+    const auto payload = buffer.payload();
+    if (payload.size() < MessageHeader::encodedLength()) {
+        throw py::value_error("BookSync.apply: buffer shorter than SBE message header");
+    }
+    MessageHeader header{payload.data(), payload.size()};
+    if (header.templateId() != DEPTH_DIFF_STREAM_EVENT) {
+        throw py::value_error("BookSync.apply: expected a depth diff (10003) frame");
+    }
+    const char* body = payload.data() + MessageHeader::encodedLength();
+    try {
+        DepthDiffFrame diff;
+        if (const auto error = parse_depth_diff_frame(body, payload.size() - MessageHeader::encodedLength(),
+                                                      header.blockLength(), diff);
+            error != ParseError::None) {
+            throw_parse_error(error, "depth");
+        }
+        return sync.apply_diff(body, diff);
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
 }
 
-uint64_t get_current_time_millis() {
-    return std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
+SyncResult sync_load_partial_depth(BookSync& sync, const py::buffer& data) {
+    FrameBuffer buffer{data};
+    const auto payload = buffer.payload();
+    if (payload.size() < MessageHeader::encodedLength()) {
+        throw py::value_error("BookSync.load_partial_depth: buffer shorter than SBE message header");
+    }
+    MessageHeader header{payload.data(), payload.size()};
+    if (header.templateId() != DEPTH_SNAPSHOT_STREAM_EVENT) {
+        throw py::value_error("BookSync.load_partial_depth: expected a partial depth (10002) frame");
+    }
+    const char* body = payload.data() + MessageHeader::encodedLength();
+    try {
+        DepthSnapshotFrame snapshot;
+        if (const auto error = parse_depth_snapshot_frame(body, payload.size() - MessageHeader::encodedLength(),
+                                                          header.blockLength(), snapshot);
+            error != ParseError::None) {
+            throw_parse_error(error, "depth");
+        }
+        return sync.apply_partial_depth(body, snapshot);
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
 }
 
-std::string extract_symbol(const char* symbol_buffer, size_t max_length = 16) {
-    size_t length = 0;
-    while (length < max_length && symbol_buffer[length] != '\0') {
-        length++;
+// The snapshot and the replay of the buffered diffs run without the GIL
+SyncResult sync_load_depth_response(BookSync& sync, const py::buffer& data) {
+    FrameBuffer buffer{data};
+    try {
+        py::gil_scoped_release release;
+        return sync.load_depth_response(buffer.payload());
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
     }
-    return std::string(symbol_buffer, length);
 }
 
-// Main SBE decoder class
-class SBEDecoder {
+// Load a REST DepthResponse (template 200) frame into `book` straight from
+// the generated flyweight, without building level lists
+void load_depth_response_frame(OrderBook& book, const py::buffer& data) {
+    FrameBuffer buffer{data};
+    try {
+        load_depth_response(book, buffer.payload());
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+}
+
+// decode_depth_snapshot: a new book for `symbol`, loaded without the GIL
+OrderBook decode_depth_snapshot(const py::buffer& data, std::string symbol) {
+    FrameBuffer buffer{data};
+    OrderBook book{std::move(symbol)};
+    try {
+        py::gil_scoped_release release;
+        load_depth_response(book, buffer.payload());
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+    return book;
+}
+
+uint64_t depth_snapshot_checksum_of(const py::buffer& data, std::size_t depth) {
+    FrameBuffer buffer{data};
+    try {
+        py::gil_scoped_release release;
+        return depth_snapshot_checksum(buffer.payload(), depth);
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+}
+
+// Load a REST /api/v3/depth JSON body into `book` without the GIL
+void load_depth_json_body(OrderBook& book, const py::buffer& data) {
+    FrameBuffer buffer{data};
+    try {
+        py::gil_scoped_release release;
+        load_depth_json(book, buffer.payload());
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+}
+
+// PyCapsules for the Arrow PyCapsule Interface; a consumer that imports the
+// struct leaves its release callback null, otherwise the capsule releases it
+void release_arrow_schema_capsule(PyObject* capsule) {
+    auto* schema = static_cast<ArrowSchema*>(PyCapsule_GetPointer(capsule, "arrow_schema"));
+    if (schema->release != nullptr) {
+        schema->release(schema);
+    }
+    delete schema;
+}
+
+void release_arrow_array_capsule(PyObject* capsule) {
+    auto* array = static_cast<ArrowArray*>(PyCapsule_GetPointer(capsule, "arrow_array"));
+    if (array->release != nullptr) {
+        array->release(array);
+    }
+    delete array;
+}
+
+py::capsule arrow_schema_capsule(const ArrowBatch& batch) {
+    auto schema = std::make_unique<ArrowSchema>();
+    batch.export_schema(schema.get());
+    return py::capsule(schema.release(), "arrow_schema", &release_arrow_schema_capsule);
+}
+
+py::capsule arrow_array_capsule(const ArrowBatch& batch) {
+    auto array = std::make_unique<ArrowArray>();
+    batch.export_array(array.get());
+    return py::capsule(array.release(), "arrow_array", &release_arrow_array_capsule);
+}
+
+// A decoded table as a dict of NumPy columns
+class NumpyTable {
 public:
-    SBEDecoder() = default;
-    
-    // Main decode function (follows official main.cpp patterns)
-    py::dict decode_message(const py::bytes& data) {
-        auto storage = read_payload_from_python(data);
-        auto payload = std::span<char>{storage};
-        
-        // Use official MessageHeader parsing
-        MessageHeader message_header{payload.data(), payload.size()};
-        
-        auto template_id = message_header.templateId();
-        auto schema_id = message_header.schemaId();
-        auto version = message_header.version();
-        
-        // Validate schema (optional for stream data)
-        if (schema_id != EXPECTED_SCHEMA_ID) {
-            // For stream data, we might be more lenient
-            // throw std::runtime_error("Unexpected schema ID: " + std::to_string(schema_id));
-        }
-        
-        // Decode based on template ID
-        if (template_id == TRADES_STREAM_EVENT) {
-            return decode_trade_stream(payload, message_header);
-        } else if (template_id == BEST_BID_ASK_STREAM_EVENT) {
-            return decode_best_bid_ask_stream(payload, message_header);
-        } else if (template_id == DEPTH_DIFF_STREAM_EVENT) {
-            return decode_depth_stream(payload, message_header);
+    template <typename T>
+    void column(const char* name, std::vector<T>&& values) {
+        table_[name] = column_to_numpy(std::move(values));
+    }
+
+    void decimal(const char* name, DecimalColumn&& column, bool raw) {
+        if (raw) {
+            table_[name] = column_to_numpy(std::move(column.mantissa));
         } else {
-            // Handle unknown template IDs gracefully
-            return decode_unknown_message(payload, message_header);
+            table_[name] = column_to_numpy(std::move(column.value));
         }
     }
-    
-    // Get message template ID
-    uint16_t get_message_type(const py::bytes& data) {
-        auto storage = read_payload_from_python(data);
-        auto payload = std::span<char>{storage};
-        MessageHeader message_header{payload.data(), payload.size()};
-        return message_header.templateId();
+
+    void flags(const char* name, std::vector<uint8_t>&& values) { table_[name] = flags_to_numpy(std::move(values)); }
+    void symbols(const char* name, std::vector<SymbolCode>&& values) {
+        table_[name] = symbols_to_numpy(std::move(values));
     }
-    
-    // Validate message format
-    bool is_valid_message(const py::bytes& data) {
-        try {
-            auto storage = read_payload_from_python(data);
-            if (storage.size() < sizeof(MessageHeader)) {
-                return false;
-            }
-            
-            auto payload = std::span<char>{storage};
-            MessageHeader message_header{payload.data(), payload.size()};
-            
-            // For stream data, accept any schema but validate basic structure
-            auto template_id = message_header.templateId();
-            return template_id == TRADES_STREAM_EVENT || 
-                   template_id == BEST_BID_ASK_STREAM_EVENT ||
-                   template_id == DEPTH_DIFF_STREAM_EVENT ||
-                   template_id > 0; // Accept any valid template ID
-        } catch (...) {
-            return false;
+
+    py::object finish() { return std::move(table_); }
+
+private:
+    py::dict table_;
+};
+
+// A decoded table as an ArrowBatch; numeric columns move in without a copy
+class ArrowTable {
+public:
+    template <typename T>
+    void column(const char* name, std::vector<T>&& values) {
+        batch_.add(name, std::move(values));
+    }
+
+    void decimal(const char* name, DecimalColumn&& column, bool raw) {
+        if (raw) {
+            batch_.add(name, std::move(column.mantissa));
+        } else {
+            batch_.add(name, std::move(column.value));
         }
     }
 
+    void flags(const char* name, std::vector<uint8_t>&& values) { batch_.add_bools(name, values); }
+    void symbols(const char* name, std::vector<SymbolCode>&& values) { batch_.add_strings(name, values); }
+
+    py::object finish() { return py::cast(std::move(batch_)); }
+
 private:
-    // Decode trade stream message (template 10000)
-    py::dict decode_trade_stream(const std::span<char> payload, const MessageHeader& message_header) {
-        py::dict result;
-        result["msg_type"] = "trade";
-        result["source"] = "sbe";
-        result["template_id"] = message_header.templateId();
-        result["ingest_ts"] = get_current_time_millis();
-        
-        // Parse fields from SBE message data following official Binance SBE pattern
-        const char* data = payload.data() + MessageHeader::encodedLength();
-        size_t data_size = payload.size() - MessageHeader::encodedLength();
-        size_t offset = 0;
+    ArrowBatch batch_;
+};
 
-        try {
-            if (data_size < message_header.blockLength()) {
-                throw std::runtime_error("SBE trade decode: payload shorter than block length");
-            }
+template <typename Table>
+void exponents_to_table(Table& table, ExponentColumns&& exponents, bool raw) {
+    if (raw) {
+        table.column("price_exponent", std::move(exponents.price_exponent));
+        table.column("qty_exponent", std::move(exponents.qty_exponent));
+    }
+}
 
-            // Fixed block (18 bytes for template 10000)
-            uint64_t event_time = read_little_endian<uint64_t>(data, data_size, offset);
-            uint64_t trade_time = read_little_endian<uint64_t>(data, data_size, offset);
-            int8_t price_exponent = read_little_endian<int8_t>(data, data_size, offset);
-            int8_t qty_exponent = read_little_endian<int8_t>(data, data_size, offset);
+// Template 203's table; klines_from_trades builds the same one
+template <typename Table>
+py::object klines_to_table(KlineColumns&& klines, bool raw) {
+    Table table;
+    table.column("frame_index", std::move(klines.frame_index));
+    table.column("open_time", std::move(klines.open_time));
+    table.column("close_time", std::move(klines.close_time));
+    table.decimal("open", std::move(klines.open), raw);
+    table.decimal("high", std::move(klines.high), raw);
+    table.decimal("low", std::move(klines.low), raw);
+    table.decimal("close", std::move(klines.close), raw);
+    exponents_to_table(table, std::move(klines.exponents), raw);
+    table.column("volume", std::move(klines.volume));
+    table.column("quote_volume", std::move(klines.quote_volume));
+    table.column("num_trades", std::move(klines.num_trades));
+    return table.finish();
+}
 
-            result["event_ts"] = micros_to_millis(event_time);
-            result["trade_time"] = micros_to_millis(trade_time);
-            result["price_exponent"] = static_cast<int>(price_exponent);
-            result["qty_exponent"] = static_cast<int>(qty_exponent);
+template <typename Table>
+py::dict batch_to_tables(BatchColumns&& batch) {
+    const bool raw = batch.raw_mantissa;
 
-            // Debug preview of upcoming bytes for troubleshooting
-            result["debug_offset_fixed_end"] = static_cast<int>(message_header.blockLength());
-            result["debug_data_size"] = static_cast<int>(data_size);
-            result["debug_next_16_bytes"] = preview_next_bytes_hex(data, data_size, offset, 16);
+    Table trades;
+    trades.column("frame_index", std::move(batch.trades.frame_index));
+    trades.column("event_ts", std::move(batch.trades.event_ts));
+    trades.column("trade_time", std::move(batch.trades.trade_time));
+    trades.column("trade_id", std::move(batch.trades.trade_id));
+    trades.decimal("price", std::move(batch.trades.price), raw);
+    trades.decimal("qty", std::move(batch.trades.qty), raw);
+    exponents_to_table(trades, std::move(batch.trades.exponents), raw);
+    trades.flags("is_buyer_maker", std::move(batch.trades.is_buyer_maker));
+    trades.symbols("symbol", std::move(batch.trades.symbol));
+    trades.column("symbol_id", std::move(batch.trades.symbol_id));
 
-            // Repeating group header (blockLength + numInGroup)
-            uint16_t group_block_length = read_little_endian<uint16_t>(data, data_size, offset);
-            uint32_t num_in_group = read_little_endian<uint32_t>(data, data_size, offset);
+    Table best_bid_ask;
+    best_bid_ask.column("frame_index", std::move(batch.best_bid_ask.frame_index));
+    best_bid_ask.column("event_ts", std::move(batch.best_bid_ask.event_ts));
+    best_bid_ask.column("book_update_id", std::move(batch.best_bid_ask.book_update_id));
+    best_bid_ask.decimal("bid_px", std::move(batch.best_bid_ask.bid_px), raw);
+    best_bid_ask.decimal("bid_sz", std::move(batch.best_bid_ask.bid_sz), raw);
+    best_bid_ask.decimal("ask_px", std::move(batch.best_bid_ask.ask_px), raw);
+    best_bid_ask.decimal("ask_sz", std::move(batch.best_bid_ask.ask_sz), raw);
+    exponents_to_table(best_bid_ask, std::move(batch.best_bid_ask.exponents), raw);
+    best_bid_ask.symbols("symbol", std::move(batch.best_bid_ask.symbol));
+    best_bid_ask.column("symbol_id", std::move(batch.best_bid_ask.symbol_id));
 
-            if (group_block_length == 0 || num_in_group == 0) {
-                throw std::runtime_error("SBE trade decode: empty trade group");
-            }
+    Table depth;
+    depth.column("frame_index", std::move(batch.depth.frame_index));
+    depth.column("event_ts", std::move(batch.depth.event_ts));
+    depth.column("first_update_id", std::move(batch.depth.first_update_id));
+    depth.column("final_update_id", std::move(batch.depth.final_update_id));
+    depth.symbols("symbol", std::move(batch.depth.symbol));
+    depth.column("symbol_id", std::move(batch.depth.symbol_id));
 
-            result["debug_group_block_length"] = static_cast<int>(group_block_length);
-            result["debug_num_in_group"] = static_cast<long long>(num_in_group);
+    Table partial_depth;
+    partial_depth.column("frame_index", std::move(batch.partial_depth.frame_index));
+    partial_depth.column("event_ts", std::move(batch.partial_depth.event_ts));
+    partial_depth.column("book_update_id", std::move(batch.partial_depth.book_update_id));
+    partial_depth.symbols("symbol", std::move(batch.partial_depth.symbol));
+    partial_depth.column("symbol_id", std::move(batch.partial_depth.symbol_id));
 
-            size_t group_start = offset;
-            double price = 0.0;
-            double qty = 0.0;
-            uint64_t trade_id = 0;
-            bool is_buyer_maker = false;
-            int64_t price_mantissa = 0;
-            int64_t qty_mantissa = 0;
-            bool populated = false;
+    Table depth_gaps;
+    depth_gaps.column("frame_index", std::move(batch.depth_gaps.frame_index));
+    depth_gaps.column("event_ts", std::move(batch.depth_gaps.event_ts));
+    depth_gaps.column("expected_first_update_id", std::move(batch.depth_gaps.expected_first_update_id));
+    depth_gaps.column("first_update_id", std::move(batch.depth_gaps.first_update_id));
+    depth_gaps.symbols("symbol", std::move(batch.depth_gaps.symbol));
+    depth_gaps.column("symbol_id", std::move(batch.depth_gaps.symbol_id));
 
-            for (uint32_t i = 0; i < num_in_group; ++i) {
-                size_t entry_offset = group_start + static_cast<size_t>(i) * group_block_length;
-                if (entry_offset + group_block_length > data_size) {
-                    throw std::runtime_error("SBE trade decode: group entry exceeds buffer");
-                }
+    Table depth_levels;
+    depth_levels.column("frame_index", std::move(batch.depth_levels.frame_index));
+    depth_levels.flags("is_bid", std::move(batch.depth_levels.is_bid));
+    depth_levels.decimal("price", std::move(batch.depth_levels.price), raw);
+    depth_levels.decimal("qty", std::move(batch.depth_levels.qty), raw);
+    exponents_to_table(depth_levels, std::move(batch.depth_levels.exponents), raw);
 
-                size_t cursor = entry_offset;
-                uint64_t entry_trade_id = read_little_endian<uint64_t>(data, data_size, cursor);
-                int64_t entry_price_mantissa = read_little_endian<int64_t>(data, data_size, cursor);
-                int64_t entry_qty_mantissa = read_little_endian<int64_t>(data, data_size, cursor);
-                bool entry_is_buyer_maker = false;
+    Table conflation;
+    conflation.column("frame_index", std::move(batch.conflation.frame_index));
+    conflation.column("event_ts", std::move(batch.conflation.event_ts));
+    conflation.column("first_event_ts", std::move(batch.conflation.first_event_ts));
+    conflation.column("stream", std::move(batch.conflation.stream));
+    conflation.column("updates", std::move(batch.conflation.updates));
+    conflation.decimal("bid_low", std::move(batch.conflation.bid_low), raw);
+    conflation.decimal("bid_high", std::move(batch.conflation.bid_high), raw);
+    conflation.decimal("ask_low", std::move(batch.conflation.ask_low), raw);
+    conflation.decimal("ask_high", std::move(batch.conflation.ask_high), raw);
+    exponents_to_table(conflation, std::move(batch.conflation.exponents), raw);
+    conflation.symbols("symbol", std::move(batch.conflation.symbol));
+    conflation.column("symbol_id", std::move(batch.conflation.symbol_id));
 
-                if (cursor < entry_offset + group_block_length) {
-                    uint8_t maker_flag = read_little_endian<uint8_t>(data, data_size, cursor);
-                    entry_is_buyer_maker = maker_flag != 0;
-                }
+    Table agg_trades;
+    agg_trades.column("frame_index", std::move(batch.agg_trades.frame_index));
+    agg_trades.column("agg_trade_id", std::move(batch.agg_trades.agg_trade_id));
+    agg_trades.decimal("price", std::move(batch.agg_trades.price), raw);
+    agg_trades.decimal("qty", std::move(batch.agg_trades.qty), raw);
+    exponents_to_table(agg_trades, std::move(batch.agg_trades.exponents), raw);
+    agg_trades.column("first_trade_id", std::move(batch.agg_trades.first_trade_id));
+    agg_trades.column("last_trade_id", std::move(batch.agg_trades.last_trade_id));
+    agg_trades.column("time", std::move(batch.agg_trades.trade_time));
+    agg_trades.flags("is_buyer_maker", std::move(batch.agg_trades.is_buyer_maker));
 
-                if (!populated) {
-                    trade_id = entry_trade_id;
-                    price_mantissa = entry_price_mantissa;
-                    qty_mantissa = entry_qty_mantissa;
-                    price = decode_decimal(entry_price_mantissa, price_exponent);
-                    qty = decode_decimal(entry_qty_mantissa, qty_exponent);
-                    is_buyer_maker = entry_is_buyer_maker;
-                    populated = true;
-                }
-            }
+    py::dict result;
+    result["ingest_ts"] = batch.ingest_ts;
+    result["ingest_ts_us"] = batch.ingest_ts_us;
+    result["trade"] = trades.finish();
+    result["bestBidAsk"] = best_bid_ask.finish();
+    result["depthDiff"] = depth.finish();
+    result["partialDepth"] = partial_depth.finish();
+    result["depthGaps"] = depth_gaps.finish();
+    result["depthLevels"] = depth_levels.finish();
+    result["conflation"] = conflation.finish();
+    result["aggTrades"] = agg_trades.finish();
+    result["klines"] = klines_to_table<Table>(std::move(batch.klines), raw);
+    result["errors"] = column_to_numpy(std::move(batch.error_frames));
+    // Index into PARSE_ERRORS per error frame
+    result["error_causes"] = column_to_numpy(std::move(batch.error_causes));
+    result["unknown"] = column_to_numpy(std::move(batch.unknown_frames));
+    if (!batch.frame_ingest_ts_us.empty()) {
+        result["frame_ingest_ts_us"] = column_to_numpy(std::move(batch.frame_ingest_ts_us));
+    }
+    return result;
+}
 
-            offset = group_start + static_cast<size_t>(num_in_group) * group_block_length;
+// format="numpy" (dicts of arrays) or "arrow" (ArrowBatch per table)
+bool arrow_format_from_name(const std::string& format, const char* what) {
+    if (format == "arrow") {
+        return true;
+    }
+    if (format != "numpy") {
+        throw py::value_error(std::string(what) + ": format must be 'numpy' or 'arrow'");
+    }
+    return false;
+}
 
-            // Symbol is encoded as length-prefixed string in the remaining bytes
-            std::string symbol = "BTCUSDT";
-            if (offset < data_size) {
-                uint8_t symbol_length = read_little_endian<uint8_t>(data, data_size, offset);
-                if (symbol_length > 0) {
-                    if (offset + symbol_length > data_size) {
-                        throw std::runtime_error("SBE trade decode: symbol exceeds buffer");
-                    }
-                    symbol.assign(data + offset, data + offset + symbol_length);
-                    offset += symbol_length;
-                }
-            }
+py::dict batch_to_python(BatchColumns&& batch, bool arrow) {
+    return arrow ? batch_to_tables<ArrowTable>(std::move(batch)) : batch_to_tables<NumpyTable>(std::move(batch));
+}
 
-            if (!populated) {
-                throw std::runtime_error("SBE trade decode: no trade entries parsed");
-            }
+// Record layout of a serialize_records call; the payloads stay in the
+// caller's buffer
+py::dict record_batch_to_python(RecordBatch&& batch, std::size_t frames_consumed) {
+    py::list partition_keys;
+    for (const auto& symbol : batch.symbol) {
+        partition_keys.append(symbol_str(std::string_view(symbol.data(), strnlen(symbol.data(), symbol.size()))));
+    }
 
-            result["symbol"] = symbol;
-            result["price"] = price;
-            result["qty"] = qty;
-            result["trade_id"] = static_cast<unsigned long long>(trade_id);
-            result["is_buyer_maker"] = is_buyer_maker;
-            result["debug_price_mantissa"] = static_cast<long long>(price_mantissa);
-            result["debug_qty_mantissa"] = static_cast<long long>(qty_mantissa);
-            result["debug_found_group"] = true;
+    py::dict result;
+    result["frames_consumed"] = frames_consumed;
+    result["records"] = batch.records();
+    result["bytes"] = batch.offsets.back();
+    result["offsets"] = column_to_numpy(std::move(batch.offsets));
+    result["template_id"] = column_to_numpy(std::move(batch.template_id));
+    result["partition_keys"] = partition_keys;
+    result["errors"] = column_to_numpy(std::move(batch.error_frames));
+    result["unknown"] = column_to_numpy(std::move(batch.unknown_frames));
+    return result;
+}
 
-        } catch (const std::exception& e) {
-            // If parsing fails, return placeholder values
-            result["symbol"] = "PARSE_ERROR";
-            result["price"] = 0.0;
-            result["qty"] = 0.0;
-            result["event_ts"] = get_current_time_millis();
-            result["trade_time"] = get_current_time_millis();
-            result["trade_id"] = 0;
-            result["is_buyer_maker"] = false;
-            result["debug_found_group"] = false;
-            result["parse_error"] = std::string(e.what());
+// A rebuilt depth delta record as the dict json.loads makes of a JSON
+// depth record: [price, qty] decimal strings, millisecond timestamps
+py::dict depth_delta_to_python(const DepthDeltaRecord& record) {
+    const auto side = [&](std::span<const BookLevel> levels) {
+        char price[DECIMAL_TEXT_SIZE];
+        char qty[DECIMAL_TEXT_SIZE];
+        py::list out(levels.size());
+        for (std::size_t i = 0; i < levels.size(); ++i) {
+            const std::string_view price_text = format_mantissa_text(levels[i].price, record.price_exponent, price);
+            const std::string_view qty_text = format_mantissa_text(levels[i].qty, record.qty_exponent, qty);
+            py::list level(2);
+            level[0] = py::str(price_text.data(), price_text.size());
+            level[1] = py::str(qty_text.data(), qty_text.size());
+            out[i] = level;
         }
-        
-        return result;
+        return out;
+    };
+    py::dict result;
+    result["symbol"] = symbol_str(record.symbol);
+    result["event_ts"] = micros_to_millis(record.event_time_us);
+    result["ingest_ts"] = micros_to_millis(record.ingest_us);
+    result["msg_type"] = "depth";
+    result["final_update_id"] = record.update_id;
+    result["bids"] = side(record.bids);
+    result["asks"] = side(record.asks);
+    result["source"] = "sbe";
+    result["keyframe"] = record.keyframe;
+    return result;
+}
+
+std::vector<BookLevel> book_levels_from_python(const std::vector<std::pair<int64_t, int64_t>>& levels) {
+    std::vector<BookLevel> out;
+    out.reserve(levels.size());
+    for (const auto& [price, qty] : levels) {
+        out.push_back(BookLevel{price, qty});
     }
-    
-    // Decode best bid/ask stream message (template 10001)
-    py::dict decode_best_bid_ask_stream(const std::span<char> payload, const MessageHeader& message_header) {
-        py::dict result;
-        result["msg_type"] = "bestBidAsk";
-        result["source"] = "sbe";
-        result["template_id"] = message_header.templateId();
-        result["ingest_ts"] = get_current_time_millis();
-        
-        // Parse fields from SBE message data
-        const char* data = payload.data() + MessageHeader::encodedLength();
-        size_t data_size = payload.size() - MessageHeader::encodedLength();
-        size_t offset = 0;
-        
-        try {
-            // Based on official stream_1_0.xml schema:
-            // BestBidAskStreamEvent has: eventTime, bookUpdateId, priceExponent, qtyExponent
-            // followed by bid/ask prices and quantities (mantissa values)
-            
-            // Event timestamp (8 bytes) - microseconds since epoch
-            if (offset + 8 <= data_size) {
-                uint64_t event_time = *reinterpret_cast<const uint64_t*>(data + offset);
-                result["event_ts"] = micros_to_millis(event_time);
-                offset += 8;
-            }
-            
-            // Book update ID (8 bytes)
-            if (offset + 8 <= data_size) {
-                uint64_t book_update_id = *reinterpret_cast<const uint64_t*>(data + offset);
-                result["book_update_id"] = static_cast<unsigned long long>(book_update_id);
-                offset += 8;
-            }
-            
-            // Price exponent (1 byte) - this is KEY for proper decimal decoding!
-            int8_t price_exponent = 0;
-            if (offset + 1 <= data_size) {
-                price_exponent = *reinterpret_cast<const int8_t*>(data + offset);
-                result["price_exponent"] = static_cast<int>(price_exponent);
-                offset += 1;
-            }
-            
-            // Quantity exponent (1 byte) - this is KEY for proper decimal decoding!
-            int8_t qty_exponent = 0;
-            if (offset + 1 <= data_size) {
-                qty_exponent = *reinterpret_cast<const int8_t*>(data + offset);
-                result["qty_exponent"] = static_cast<int>(qty_exponent);
-                offset += 1;
-            }
-            
-            // Bid price (8 bytes) - mantissa value, use with price_exponent
-            if (offset + 8 <= data_size) {
-                int64_t bid_price_mantissa = *reinterpret_cast<const int64_t*>(data + offset);
-                result["bid_px"] = decode_decimal(bid_price_mantissa, price_exponent);
-                result["debug_bid_mantissa"] = static_cast<long long>(bid_price_mantissa);
-                offset += 8;
-            }
-            
-            // Bid quantity (8 bytes) - mantissa value, use with qty_exponent
-            if (offset + 8 <= data_size) {
-                int64_t bid_qty_mantissa = *reinterpret_cast<const int64_t*>(data + offset);
-                result["bid_sz"] = decode_decimal(bid_qty_mantissa, qty_exponent);
-                offset += 8;
-            }
-            
-            // Ask price (8 bytes) - mantissa value, use with price_exponent
-            if (offset + 8 <= data_size) {
-                int64_t ask_price_mantissa = *reinterpret_cast<const int64_t*>(data + offset);
-                result["ask_px"] = decode_decimal(ask_price_mantissa, price_exponent);
-                offset += 8;
-            }
-            
-            // Ask quantity (8 bytes) - mantissa value, use with qty_exponent
-            if (offset + 8 <= data_size) {
-                int64_t ask_qty_mantissa = *reinterpret_cast<const int64_t*>(data + offset);
-                result["ask_sz"] = decode_decimal(ask_qty_mantissa, qty_exponent);
-                offset += 8;
-            }
-            
-            // Skip any padding/metadata in fixed block
-            while (offset < message_header.blockLength() && offset < data_size) {
-                offset++;
-            }
-            
-            // Symbol parsing from variable-length section
-            if (offset < data_size) {
-                std::string symbol;
-                // Look for symbol in remaining data
-                for (size_t i = offset; i < data_size && i < offset + 16; ++i) {
-                    char c = data[i];
-                    if (c == '\0') break;
-                    if (std::isalnum(c)) {
-                        symbol += c;
-                    }
+    return out;
+}
+
+WaitStrategy wait_strategy_from_name(const std::string& wait) {
+    for (std::size_t i = 0; i < WAIT_STRATEGY_NAMES.size(); ++i) {
+        if (wait == WAIT_STRATEGY_NAMES[i]) {
+            return static_cast<WaitStrategy>(i);
+        }
+    }
+    throw py::value_error("StreamReceiver: wait must be 'block', 'spin' or 'spin_yield'");
+}
+
+// The receiver's per-component memory, from the names of the components
+// to back with huge pages and to place on their connection's NUMA node
+void set_receiver_memory(ReceiverConfig& config, const std::vector<std::string>& huge_pages,
+                         const std::vector<std::string>& numa_local) {
+    const auto component = [&](const std::string& name) -> ComponentMemory& {
+        if (name == "ring") {
+            return config.ring_memory;
+        }
+        if (name == "journal") {
+            return config.journal_memory;
+        }
+        if (name == "event_log") {
+            return config.event_log_memory;
+        }
+        throw py::value_error("StreamReceiver: memory components are 'ring', 'journal' and 'event_log', not '" +
+                              name + "'");
+    };
+    for (const auto& name : huge_pages) {
+        component(name).huge_pages = true;
+    }
+    for (const auto& name : numa_local) {
+        component(name).numa_local = true;
+    }
+}
+
+py::dict page_memory_stats_to_python() {
+    const PageMemoryStats& stats = page_memory_stats();
+    py::dict bytes;
+    for (std::size_t i = 0; i < PAGE_BACKING_NAMES.size(); ++i) {
+        bytes[PAGE_BACKING_NAMES[i]] = stats.bytes[i].load(std::memory_order_relaxed);
+    }
+    py::dict result;
+    result["bytes"] = bytes;
+    result["huge_page_fallbacks"] = stats.huge_page_fallbacks.load(std::memory_order_relaxed);
+    result["numa_failures"] = stats.numa_failures.load(std::memory_order_relaxed);
+    return result;
+}
+
+py::dict memory_usage_to_python(const MemoryUsage& usage) {
+    py::dict result;
+    result["live_bytes"] = usage.live;
+    result["reserved_bytes"] = usage.reserved;
+    return result;
+}
+
+// {component: {live_bytes, reserved_bytes, symbols: {symbol: {...}}}, plus
+// "total"; the report is taken with the GIL held (memory_accounting.h)
+py::dict memory_stats_to_python() {
+    const MemoryReport report = memory_report();
+    py::dict result;
+    for (const auto& [component, symbols] : report.components()) {
+        py::dict entry = memory_usage_to_python(report.total(symbols));
+        py::dict by_symbol;
+        for (const auto& [symbol, usage] : symbols) {
+            by_symbol[py::str(symbol)] = memory_usage_to_python(usage);
+        }
+        entry["symbols"] = by_symbol;
+        result[py::str(component)] = entry;
+    }
+    result["total"] = memory_usage_to_python(report.total());
+    return result;
+}
+
+RecordFormat record_format_from_name(const std::string& format, const char* what) {
+    if (format == "avro") {
+        return RecordFormat::Avro;
+    }
+    if (format != "json") {
+        throw py::value_error(std::string(what) + ": format must be 'json' or 'avro'");
+    }
+    return RecordFormat::Json;
+}
+
+// Train a record dictionary on the Kinesis records serialized from the
+// frames of capture journals (files or directories): depth records only
+// unless `all_records`, up to `max_samples` of them
+std::vector<char> train_dictionary_from_journals(const std::vector<std::string>& paths, std::size_t dict_size,
+                                                 std::size_t max_samples, RecordFormat format, bool all_records) {
+    RecordOptions options;
+    options.format = format;
+    RecordScratch scratch;
+    std::vector<char> out(KINESIS_MAX_RECORD_BYTES);
+    std::vector<char> frame;
+    std::vector<char> samples;
+    std::vector<std::size_t> sizes;
+    for (const auto& file : journal_files(paths)) {
+        JournalReader reader(file);
+        JournalRecord record;
+        while (sizes.size() < max_samples && reader.next(record)) {
+            // The journal is mapped read-only; the SBE flyweights take a
+            // mutable frame
+            frame.assign(record.frame.begin(), record.frame.end());
+            options.ingest_us = record.header->received_us;
+            RecordWriter writer{out};
+            RecordBatch batch;
+            serialize_frame(frame, 0, options, writer, batch, scratch);
+            for (std::size_t i = 0; i < batch.records() && sizes.size() < max_samples; ++i) {
+                const uint16_t template_id = batch.template_id[i];
+                if (!all_records && template_id != DEPTH_SNAPSHOT_STREAM_EVENT &&
+                    template_id != DEPTH_DIFF_STREAM_EVENT) {
+                    continue;
                 }
-                result["symbol"] = symbol.empty() ? "BTCUSDT" : symbol;
-            } else {
-                result["symbol"] = "BTCUSDT";
+                const auto begin = out.begin() + batch.offsets[i];
+                const auto end = out.begin() + batch.offsets[i + 1];
+                samples.insert(samples.end(), begin, end);
+                sizes.push_back(static_cast<std::size_t>(end - begin));
             }
-            
-        } catch (const std::exception& e) {
-            result["symbol"] = "PARSE_ERROR";
-            result["bid_px"] = 0.0;
-            result["bid_sz"] = 0.0;
-            result["ask_px"] = 0.0;
-            result["ask_sz"] = 0.0;
-            result["event_ts"] = get_current_time_millis();
-            result["parse_error"] = std::string(e.what());
         }
-        
-        return result;
     }
-    
-    // Decode depth stream message (template 10003)
-    py::dict decode_depth_stream(const std::span<char> payload, const MessageHeader& message_header) {
-        py::dict result;
-        result["msg_type"] = "depthDiff";
-        result["source"] = "sbe";
-        result["template_id"] = message_header.templateId();
-        result["ingest_ts"] = get_current_time_millis();
-        
-        // Parse fields from SBE message data
-        const char* data = payload.data() + MessageHeader::encodedLength();
-        size_t data_size = payload.size() - MessageHeader::encodedLength();
-        size_t offset = 0;
-        
+    return train_record_dictionary(samples, sizes, dict_size);
+}
+
+py::object avro_value(std::string_view value) {
+    return py::str(value.data(), value.size());
+}
+
+template <typename T>
+    requires std::is_arithmetic_v<T>
+py::object avro_value(T value) {
+    return py::cast(value);
+}
+
+template <typename T>
+py::object avro_value(const std::vector<T>& items) {
+    py::list result;
+    for (const auto& item : items) {
+        result.append(avro_value(item));
+    }
+    return result;
+}
+
+// Decode one single-object Avro record into a dict with its schema name;
+// None for schemas this build has no codec for
+py::object decode_avro_record(const py::buffer& data) {
+    FrameBuffer buffer{data};
+    py::object result = py::none();
+    avro_gen::decode_single_object(buffer.payload(), [&](const auto& record) {
+        py::dict fields;
+        fields["schema"] = std::string(std::decay_t<decltype(record)>::SCHEMA_NAME);
+        avro_gen::visit_fields(record, [&](const char* name, const auto& value) { fields[name] = avro_value(value); });
+        result = fields;
+    });
+    return result;
+}
+
+// Drain a receiver's (or replay's) rings with the GIL released
+template <typename Source>
+py::object drain_receiver(Source& receiver, std::size_t max_n, double timeout, const std::string& format) {
+    const bool arrow = arrow_format_from_name(format, "drain");
+    BatchColumns batch;
+    std::size_t drained = 0;
+    {
+        py::gil_scoped_release release;
+        drained = receiver.drain(batch, max_n, static_cast<int>(timeout * 1000));
+    }
+    if (drained == 0) {
+        return py::none();
+    }
+    // The trace's decode-done stamp for every frame in the batch
+    const uint64_t drain_us = ingest_time_us();
+    py::dict result = batch_to_python(std::move(batch), arrow);
+    result["drain_ts_us"] = drain_us;
+    return result;
+}
+
+// A LatencyHistogram of microseconds
+py::dict latency_summary_to_python(const LatencyHistogram::Summary& latency) {
+    py::dict out;
+    out["count"] = latency.count;
+    out["p50_us"] = latency.p50;
+    out["p99_us"] = latency.p99;
+    out["p999_us"] = latency.p999;
+    out["max_us"] = latency.max;
+    out["mean_us"] = latency.count == 0 ? 0.0 : static_cast<double>(latency.sum) / static_cast<double>(latency.count);
+    return out;
+}
+
+py::dict trace_hop_summary(const LatencyHistogram& histogram) {
+    return latency_summary_to_python(histogram.summary());
+}
+
+void journal_stats_to_python(py::dict& result, const JournalWriter& journal) {
+    const auto& stats = journal.stats();
+    result["journal_records"] = stats.records.load();
+    result["journal_bytes"] = stats.bytes.load();
+    result["journal_dropped"] = stats.dropped.load();
+    result["journal_files"] = stats.files.load();
+    result["journal_path"] = journal.current_path();
+    result["journal_error"] = journal.last_error();
+}
+
+void event_log_stats_to_python(py::dict& result, const EventLog& log) {
+    const auto& stats = log.stats();
+    result["event_log_path"] = log.path();
+    result["event_log_frames"] = stats.frames.load();
+    result["event_log_records"] = stats.records.load();
+    result["event_log_dropped_frames"] = stats.dropped_frames.load();
+}
+
+ConflationConfig conflation_config(double bba_interval, double depth_interval, std::size_t depth_levels) {
+    if (bba_interval < 0 || depth_interval < 0) {
+        throw py::value_error("conflation intervals must not be negative");
+    }
+    ConflationConfig config;
+    config.bba_interval_ms = static_cast<int>(bba_interval * 1000);
+    config.depth_interval_ms = static_cast<int>(depth_interval * 1000);
+    config.depth_levels = depth_levels;
+    return config;
+}
+
+void conflation_stats_to_python(py::dict& result, const Conflator& conflator) {
+    const auto& stats = conflator.stats();
+    result["conflation_updates"] = stats.updates.load();
+    result["conflation_frames"] = stats.frames.load();
+    result["conflation_resyncs"] = stats.resyncs.load();
+}
+
+// The conflated frames due by `now_us` as one batch, one frame per symbol
+py::object conflator_flush(Conflator& conflator, uint64_t now_us, bool raw, const std::string& format) {
+    const bool arrow = arrow_format_from_name(format, "flush");
+    BatchColumns batch;
+    batch.raw_mantissa = raw;
+    conflator.flush_due(now_us, [&](std::span<EventRecord> records) {
+        const auto index = static_cast<int64_t>(batch.frame_ingest_ts_us.size());
+        batch.frame_ingest_ts_us.push_back(records.front().ingest_ts_us);
+        for (const EventRecord& record : records) {
+            append_event(record, index, batch);
+        }
+    });
+    if (batch.frame_ingest_ts_us.empty()) {
+        return py::none();
+    }
+    batch.ingest_ts_us = batch.frame_ingest_ts_us.front();
+    batch.ingest_ts = micros_to_millis(batch.ingest_ts_us);
+    return batch_to_python(std::move(batch), arrow);
+}
+
+py::dict connection_stats_to_python(const StreamConnection& connection) {
+    const auto& stats = connection.stats();
+    py::dict result;
+    result["path"] = connection.path();
+    result["host"] = connection.host();
+    result["port"] = connection.port();
+    result["line"] = connection.line();
+    result["cpu"] = connection.cpu();
+    result["connected"] = stats.connected.load();
+    result["messages"] = stats.messages.load();
+    result["bytes"] = stats.bytes.load();
+    result["text_messages"] = stats.text_messages.load();
+    result["connects"] = stats.connects.load();
+    result["disconnects"] = stats.disconnects.load();
+    result["dropped_frames"] = stats.dropped_frames.load();
+    result["dropped_bytes"] = stats.dropped_bytes.load();
+    result["filtered_frames"] = stats.filtered_frames.load();
+    result["idle_polls"] = stats.idle_polls.load();
+    result["yields"] = stats.yields.load();
+    result["io_uring"] = stats.io_uring.load();
+    result["depth_gaps"] = connection.depth_sequence().gaps();
+    result["ring_capacity"] = connection.ring().capacity();
+    result["ring_high_water"] = connection.ring().high_water();
+    result["exchange_latency"] = trace_hop_summary(connection.exchange_latency());
+    result["skewed_latencies"] = stats.skewed_latencies.load();
+    result["last_error"] = connection.last_error();
+    if (const JournalWriter* journal = connection.journal()) {
+        journal_stats_to_python(result, *journal);
+    }
+    if (const EventLog* log = connection.event_log()) {
+        event_log_stats_to_python(result, *log);
+    }
+    if (const Conflator* conflator = connection.conflator()) {
+        conflation_stats_to_python(result, *conflator);
+    }
+    return result;
+}
+
+py::list feed_arbiter_stats_to_python(const FeedArbiter& arbiter) {
+    py::list lines;
+    for (std::size_t line = 0; line < arbiter.lines(); ++line) {
+        const FeedLineStats& stats = arbiter.stats(line);
+        py::dict result;
+        result["frames"] = stats.frames.load();
+        result["wins"] = stats.wins.load();
+        result["duplicates"] = stats.duplicates.load();
+        result["fills"] = stats.fills.load();
+        result["lag_samples"] = stats.lag_samples.load();
+        result["lag_us_total"] = stats.lag_us_total.load();
+        result["lag_us_max"] = stats.lag_us_max.load();
+        lines.append(result);
+    }
+    return lines;
+}
+
+py::dict micro_batch_stats_to_python(const MicroBatcher& batcher) {
+    py::dict result;
+    result["batches"] = batcher.stats().batches.load();
+    result["full"] = batcher.stats().full.load();
+    result["timed_out"] = batcher.stats().timed_out.load();
+    result["records"] = batcher.stats().records.load();
+    result["target"] = batcher.target();
+    return result;
+}
+
+// Totals over all connections, plus the per-connection breakdown
+py::dict receiver_stats_to_python(const StreamReceiver& receiver) {
+    uint64_t messages = 0, bytes = 0, text_messages = 0, connects = 0, disconnects = 0;
+    uint64_t dropped_frames = 0, dropped_bytes = 0, depth_gaps = 0, journal_records = 0, journal_dropped = 0;
+    uint64_t filtered_frames = 0;
+    std::size_t connected = 0;
+    py::list connections;
+    for (const auto& connection : receiver.connections()) {
+        const auto& stats = connection->stats();
+        messages += stats.messages.load();
+        bytes += stats.bytes.load();
+        text_messages += stats.text_messages.load();
+        connects += stats.connects.load();
+        disconnects += stats.disconnects.load();
+        dropped_frames += stats.dropped_frames.load();
+        dropped_bytes += stats.dropped_bytes.load();
+        filtered_frames += stats.filtered_frames.load();
+        depth_gaps += connection->depth_sequence().gaps();
+        connected += stats.connected.load() ? 1 : 0;
+        if (const JournalWriter* journal = connection->journal()) {
+            journal_records += journal->stats().records.load();
+            journal_dropped += journal->stats().dropped.load();
+        }
+        connections.append(connection_stats_to_python(*connection));
+    }
+
+    py::dict result;
+    result["connected"] = receiver.connected();
+    result["connected_count"] = connected;
+    result["messages"] = messages;
+    result["bytes"] = bytes;
+    result["text_messages"] = text_messages;
+    result["connects"] = connects;
+    result["disconnects"] = disconnects;
+    result["dropped_frames"] = dropped_frames;
+    result["dropped_bytes"] = dropped_bytes;
+    result["filtered_frames"] = filtered_frames;
+    result["depth_gaps"] = depth_gaps;
+    result["notify_arms"] = receiver.notifier().arms();
+    result["notify_wakeups"] = receiver.notifier().wakeups();
+    if (receiver.config().micro_batch.enabled()) {
+        result["micro_batch"] = micro_batch_stats_to_python(receiver.micro_batcher());
+    }
+    if (const IoExecutor* executor = receiver.executor()) {
+        const IoExecutorStats& executor_stats = executor->stats();
+        py::dict tasks;
+        tasks["threads"] = executor->threads();
+        tasks["tasks"] = executor->tasks();
+        tasks["resumes"] = executor_stats.resumes.load();
+        tasks["polls"] = executor_stats.polls.load();
+        tasks["timeouts"] = executor_stats.timeouts.load();
+        tasks["blocking_calls"] = executor_stats.blocking_calls.load();
+        tasks["pin_errors"] = executor->pin_errors();
+        result["executor"] = tasks;
+    }
+    if (receiver.config().journal.enabled()) {
+        result["journal_records"] = journal_records;
+        result["journal_dropped"] = journal_dropped;
+    }
+    result["connections"] = connections;
+    if (!receiver.feed_groups().empty()) {
+        // Per group of redundant lines, one dict per line (see FeedArbiter)
+        py::list feeds;
+        for (const auto& group : receiver.feed_groups()) {
+            py::dict feed;
+            feed["lines"] = feed_arbiter_stats_to_python(group->arbiter);
+            feed["abandoned_holes"] = group->arbiter.abandoned_holes();
+            feeds.append(feed);
+        }
+        result["feeds"] = feeds;
+    }
+    return result;
+}
+
+const char* rate_limit_type_name(spot_sbe::RateLimitType::Value type) {
+    switch (type) {
+        case spot_sbe::RateLimitType::RawRequests:
+            return "RAW_REQUESTS";
+        case spot_sbe::RateLimitType::Connections:
+            return "CONNECTIONS";
+        case spot_sbe::RateLimitType::RequestWeight:
+            return "REQUEST_WEIGHT";
+        case spot_sbe::RateLimitType::Orders:
+            return "ORDERS";
+        case spot_sbe::RateLimitType::NULL_VALUE:
+            break;
+    }
+    return "UNKNOWN";
+}
+
+const char* rate_limit_interval_name(spot_sbe::RateLimitInterval::Value interval) {
+    switch (interval) {
+        case spot_sbe::RateLimitInterval::Second:
+            return "SECOND";
+        case spot_sbe::RateLimitInterval::Minute:
+            return "MINUTE";
+        case spot_sbe::RateLimitInterval::Hour:
+            return "HOUR";
+        case spot_sbe::RateLimitInterval::Day:
+            return "DAY";
+        case spot_sbe::RateLimitInterval::NULL_VALUE:
+            break;
+    }
+    return "UNKNOWN";
+}
+
+spot_sbe::RateLimitType::Value rate_limit_type_from_name(const std::string& name) {
+    for (const auto type : {spot_sbe::RateLimitType::RawRequests, spot_sbe::RateLimitType::Connections,
+                            spot_sbe::RateLimitType::RequestWeight, spot_sbe::RateLimitType::Orders}) {
+        if (name == rate_limit_type_name(type)) {
+            return type;
+        }
+    }
+    throw std::invalid_argument("unknown rateLimitType '" + name + "'");
+}
+
+spot_sbe::RateLimitInterval::Value rate_limit_interval_from_name(const std::string& name) {
+    for (const auto interval : {spot_sbe::RateLimitInterval::Second, spot_sbe::RateLimitInterval::Minute,
+                                spot_sbe::RateLimitInterval::Hour, spot_sbe::RateLimitInterval::Day}) {
+        if (name == rate_limit_interval_name(interval)) {
+            return interval;
+        }
+    }
+    throw std::invalid_argument("unknown rate limit interval '" + name + "'");
+}
+
+// A rateLimits entry as exchangeInfo's JSON (or WsApiResponse.rate_limits)
+// spells it; limit is optional
+RateLimitSpec rate_limit_spec_from_python(const py::dict& entry) {
+    RateLimitSpec spec;
+    spec.type = rate_limit_type_from_name(entry["rateLimitType"].cast<std::string>());
+    spec.interval = rate_limit_interval_from_name(entry["interval"].cast<std::string>());
+    spec.interval_num = entry.contains("intervalNum") ? entry["intervalNum"].cast<uint8_t>() : uint8_t{1};
+    spec.limit = entry.contains("limit") ? entry["limit"].cast<int64_t>() : 0;
+    return spec;
+}
+
+py::list rate_windows_to_python(RateGovernor& governor) {
+    py::list windows;
+    for (const RateWindow& window : governor.windows(rate_governor_now_ms())) {
+        py::dict entry;
+        entry["rateLimitType"] = rate_limit_type_name(window.spec.type);
+        entry["interval"] = rate_limit_interval_name(window.spec.interval);
+        entry["intervalNum"] = window.spec.interval_num;
+        entry["limit"] = window.spec.limit;
+        entry["count"] = window.used;
+        entry["window_start_ms"] = window.start_ms;
+        windows.append(std::move(entry));
+    }
+    return windows;
+}
+
+py::dict rate_governor_stats_to_python(const RateGovernor& governor) {
+    const RateGovernorStats stats = governor.stats();
+    py::dict result;
+    result["granted"] = stats.granted;
+    result["weight_granted"] = stats.weight_granted;
+    result["waits"] = stats.waits;
+    result["corrections"] = stats.corrections;
+    result["backoffs"] = stats.backoffs;
+    result["backoff_until_ms"] = governor.backoff_until_ms();
+    return result;
+}
+
+LogLevel log_level_from_name(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::toupper(c); });
+    for (const LogLevel level : {LogLevel::Debug, LogLevel::Info, LogLevel::Warning, LogLevel::Error}) {
+        if (name == log_level_name(level)) {
+            return level;
+        }
+    }
+    throw py::value_error("NativeLogger: level must be 'DEBUG', 'INFO', 'WARNING' or 'ERROR'");
+}
+
+// (time_us, level, component, message) per line, level as in Python logging
+py::list native_log_lines_to_python(NativeLogger& logger, std::size_t max_lines) {
+    std::vector<LogLine> lines;
+    {
+        py::gil_scoped_release release;
+        lines = logger.drain(max_lines);
+    }
+    py::list out;
+    for (const LogLine& line : lines) {
+        out.append(py::make_tuple(line.time_us, static_cast<int>(line.level), line.component, line.message));
+    }
+    return out;
+}
+
+py::dict native_logger_stats_to_python(NativeLogger& logger) {
+    const NativeLoggerStats stats = logger.stats();
+    py::dict result;
+    result["records"] = stats.records;
+    result["dropped"] = stats.dropped;
+    result["lines_dropped"] = stats.lines_dropped;
+    result["threads"] = stats.threads;
+    result["pending"] = stats.pending;
+    return result;
+}
+
+// A response's rate limits with the keys of the JSON API's rateLimits
+py::list ws_api_rate_limits(const WsApiEnvelope& envelope) {
+    py::list limits;
+    for (std::size_t i = 0; i < envelope.rate_limit_count; ++i) {
+        const WsApiRateLimit& limit = envelope.rate_limits[i];
+        py::dict entry;
+        entry["rateLimitType"] = rate_limit_type_name(limit.type);
+        entry["interval"] = rate_limit_interval_name(limit.interval);
+        entry["intervalNum"] = limit.interval_num;
+        entry["limit"] = limit.limit;
+        entry["count"] = limit.current;
+        limits.append(std::move(entry));
+    }
+    return limits;
+}
+
+// parse_ws_api_response: a WebSocketResponse frame read elsewhere (a
+// capture, a test), copied into a response of its own
+WsApiResponse parse_ws_api_response(const py::buffer& data) {
+    FrameBuffer buffer{data};
+    const std::span<char> payload = buffer.payload();
+    WsApiResponse response;
+    response.frame.assign(payload.begin(), payload.end());
+    try {
+        response.envelope = parse_ws_api_envelope({response.frame.data(), response.frame.size()});
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+    return response;
+}
+
+// An ErrorResponse (template 100) frame as the official sample app prints
+// it (official/json.h)
+std::string official_error_json(const py::buffer& data) {
+    FrameBuffer buffer{data};
+    const std::span<char> payload = buffer.payload();
+    std::string out;
+    try {
+        if (payload.size() < MessageHeader::encodedLength()) {
+            throw std::runtime_error("Buffer too short for message header");
+        }
+        MessageHeader header(payload.data(), payload.size());
+        if (header.schemaId() != EXPECTED_SCHEMA_ID) {
+            throw std::runtime_error("Unexpected schema id " + std::to_string(header.schemaId()));
+        }
+        if (header.templateId() != ErrorResponse::sbeTemplateId()) {
+            throw std::runtime_error("Expected ErrorResponse (template 100), got template " +
+                                     std::to_string(header.templateId()));
+        }
+        auto response = message_from_header<ErrorResponse>(payload, header);
+        print_json(out, Error(response));
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+    return out;
+}
+
+// A request's params as the compact JSON object the API expects
+std::string ws_api_params(const std::optional<py::dict>& params) {
+    if (!params || params->empty()) {
+        return {};
+    }
+    // Imported per call (a sys.modules hit) rather than cached across interpreters
+    const py::object dumps = py::module_::import("json").attr("dumps");
+    return py::str(dumps(*params, py::arg("separators") = py::make_tuple(",", ":")));
+}
+
+py::dict ws_api_stats_to_python(const WsApiClient& client) {
+    const WsApiStats& stats = client.stats();
+    py::dict result;
+    result["connected"] = client.connected();
+    result["requests"] = stats.requests.load();
+    result["responses"] = stats.responses.load();
+    result["errors"] = stats.errors.load();
+    result["unmatched"] = stats.unmatched.load();
+    result["bytes"] = stats.bytes_received.load();
+    result["in_flight"] = stats.in_flight.load();
+    result["max_in_flight_seen"] = stats.max_in_flight_seen.load();
+    return result;
+}
+
+py::dict exchange_clock_to_python(const ExchangeClock& clock) {
+    const ClockEstimate estimate = clock.estimate();
+    const ExchangeClockStats& stats = clock.stats();
+    py::dict result;
+    result["synced"] = estimate.synced;
+    result["offset_us"] = estimate.synced ? estimate.offset_at(ingest_time_us()) : 0;
+    result["drift_ppm"] = estimate.drift_ppm;
+    result["error_us"] = estimate.error_us;
+    result["min_rtt_us"] = estimate.min_rtt_us;
+    result["samples"] = stats.samples.load();
+    result["rejected"] = stats.rejected.load();
+    result["steps"] = stats.steps.load();
+    result["window"] = stats.window.load();
+    result["filtered"] = stats.filtered.load();
+    return result;
+}
+
+py::dict clock_sync_stats_to_python(const ClockSync& sync) {
+    const ClockSyncStats& stats = sync.stats();
+    py::dict result = exchange_clock_to_python(sync.clock());
+    result["running"] = sync.running();
+    result["syncs"] = stats.syncs.load();
+    result["round_trips"] = stats.round_trips.load();
+    result["failures"] = stats.failures.load();
+    result["connects"] = stats.connects.load();
+    result["last_error"] = sync.last_error();
+    return result;
+}
+
+py::dict shard_lease_stats_to_python(const ShardLeaseManager& leases) {
+    const ShardLeaseStats& stats = leases.stats();
+    py::dict result;
+    result["running"] = leases.running();
+    result["rounds"] = stats.ticks.load();
+    result["failures"] = stats.failures.load();
+    result["connects"] = stats.connects.load();
+    result["renewals"] = stats.renewals.load();
+    result["acquired"] = stats.acquired.load();
+    result["released"] = stats.released.load();
+    result["lost"] = stats.lost.load();
+    result["rebalances"] = stats.rebalances.load();
+    result["members"] = leases.members();
+    result["owned"] = leases.owned();
+    result["releasing"] = leases.releasing();
+    result["last_error"] = leases.last_error();
+    return result;
+}
+
+py::dict shard_changes_to_python(const ShardChanges& changes) {
+    py::list acquired;
+    for (const ShardAcquired& entry : changes.acquired) {
+        py::dict row;
+        row["symbol"] = entry.symbol;
+        row["released_ms"] = entry.released_ms;
+        row["acquired_ms"] = entry.acquired_ms;
+        acquired.append(std::move(row));
+    }
+    py::dict result;
+    result["acquired"] = std::move(acquired);
+    result["releasing"] = changes.releasing;
+    result["lost"] = changes.lost;
+    return result;
+}
+
+RedisReply redis_reply_from_python(const py::handle& value, int depth = 0) {
+    RedisReply reply;
+    if (value.is_none()) {
+        return reply;
+    }
+    if (depth > 8) {
+        throw std::runtime_error("redis transport: reply nested too deeply");
+    }
+    if (py::isinstance<py::bool_>(value) || py::isinstance<py::int_>(value)) {
+        reply.type = RedisReply::Type::Integer;
+        reply.integer = value.cast<int64_t>();
+    } else if (py::isinstance<py::str>(value) || py::isinstance<py::bytes>(value)) {
+        reply.type = RedisReply::Type::Bulk;
+        reply.text = value.cast<std::string>();
+    } else if (py::isinstance<py::list>(value) || py::isinstance<py::tuple>(value)) {
+        reply.type = RedisReply::Type::Array;
+        for (const py::handle element : value) {
+            reply.elements.push_back(redis_reply_from_python(element, depth + 1));
+        }
+    } else {
+        throw std::runtime_error("redis transport: reply must be None, int, str, bytes or a list of them");
+    }
+    return reply;
+}
+
+// Calls `transport(args) -> reply` under the GIL, from whichever thread runs
+// the round; the function itself is dropped under the GIL too
+ShardLeaseManager::Transport shard_transport_from_python(py::function transport) {
+    std::shared_ptr<py::function> held(new py::function(std::move(transport)), [](py::function* function) {
+        py::gil_scoped_acquire gil;
+        delete function;
+    });
+    return [held](const std::vector<std::string>& args) {
+        py::gil_scoped_acquire gil;
+        try {
+            return redis_reply_from_python((*held)(args));
+        } catch (py::error_already_set& e) {
+            throw std::runtime_error(e.what());
+        }
+    };
+}
+
+// Stops the lease threads without the GIL, which a Python transport needs
+struct ShardLeaseManagerDelete {
+    void operator()(ShardLeaseManager* leases) const {
+        {
+            py::gil_scoped_release release;
+            leases->stop(false);
+        }
+        delete leases;
+    }
+};
+
+py::dict backfill_stats_to_python(const BackfillPool& pool) {
+    const BackfillStats& stats = pool.stats();
+    py::dict result;
+    result["tasks"] = stats.tasks.load();
+    result["completed"] = stats.completed.load();
+    result["failed"] = stats.failed.load();
+    result["retries"] = stats.retries.load();
+    result["steals"] = stats.steals.load();
+    result["stolen_tasks"] = stats.stolen_tasks.load();
+    result["fetches"] = stats.fetches.load();
+    result["rows"] = stats.rows.load();
+    result["parquet_bytes"] = stats.parquet_bytes.load();
+    result["outstanding"] = pool.outstanding();
+    return result;
+}
+
+// Holds consumed records (any Python object) while a gap is open
+using PySequenceMerger = SequenceMerger<py::object>;
+
+py::dict kinesis_producer_stats_to_python(const KinesisProducer& producer) {
+    const KinesisProducerStats stats = producer.stats();
+    py::dict result;
+    result["records_put"] = stats.records_put;
+    result["bytes_put"] = stats.bytes_put;
+    result["records_sent"] = stats.records_sent;
+    result["bytes_sent"] = stats.bytes_sent;
+    result["requests"] = stats.requests;
+    result["failed_requests"] = stats.failed_requests;
+    result["records_retried"] = stats.records_retried;
+    result["records_throttled"] = stats.records_throttled;
+    result["records_dropped"] = stats.records_dropped;
+    result["records_rejected"] = stats.records_rejected;
+    result["connects"] = stats.connects;
+    result["queued_records"] = stats.queued_records;
+    result["queued_bytes"] = stats.queued_bytes;
+    result["in_flight_requests"] = stats.in_flight_requests;
+    result["last_latency_us"] = stats.last_latency_us;
+    result["max_latency_us"] = stats.max_latency_us;
+    return result;
+}
+
+// ListShards (ShardId, StartingHashKey, EndingHashKey) tuples as ranges
+std::vector<KinesisShardRange> kinesis_shards_from_python(
+    const std::vector<std::tuple<std::string, std::string, std::string>>& shards) {
+    std::vector<KinesisShardRange> ranges;
+    ranges.reserve(shards.size());
+    for (const auto& [shard_id, start, end] : shards) {
+        KinesisShardRange& range = ranges.emplace_back();
+        range.shard_id = shard_id;
+        if (!parse_kinesis_hash_key(start, range.start) || !parse_kinesis_hash_key(end, range.end) ||
+            range.end < range.start) {
+            throw py::value_error("KinesisProducer: bad hash key range for shard " + shard_id);
+        }
+    }
+    return ranges;
+}
+
+PipelineLane pipeline_lane_from_name(const std::string& lane) {
+    for (std::size_t i = 0; i < PIPELINE_LANE_NAMES.size(); ++i) {
+        if (lane == PIPELINE_LANE_NAMES[i]) {
+            return static_cast<PipelineLane>(i);
+        }
+    }
+    throw py::value_error("IngestPipeline: lane must be 'trade', 'bestBidAsk' or 'depth'");
+}
+
+OverflowPolicy overflow_policy_from_name(const std::string& policy) {
+    for (std::size_t i = 0; i < OVERFLOW_POLICY_NAMES.size(); ++i) {
+        if (policy == OVERFLOW_POLICY_NAMES[i]) {
+            return static_cast<OverflowPolicy>(i);
+        }
+    }
+    throw py::value_error("IngestPipeline: policy must be 'block', 'drop_oldest' or 'conflate'");
+}
+
+PipelineStage pipeline_stage_from_name(const std::string& stage) {
+    for (std::size_t i = 0; i < PIPELINE_STAGE_NAMES.size(); ++i) {
+        if (stage == PIPELINE_STAGE_NAMES[i]) {
+            return static_cast<PipelineStage>(i);
+        }
+    }
+    throw py::value_error("IngestPipeline: stage must be 'decode', 'books' or 'publish'");
+}
+
+// stages[lane][stage]: {'capacity': items, 'cpu': core}, either optional
+void apply_pipeline_stages(IngestPipelineConfig& config,
+                           const std::map<std::string, std::map<std::string, std::map<std::string, int64_t>>>& stages) {
+    for (const auto& [lane, lane_stages] : stages) {
+        PipelineLaneConfig& lane_config = config.lanes[static_cast<std::size_t>(pipeline_lane_from_name(lane))];
+        for (const auto& [stage, settings] : lane_stages) {
+            PipelineStageConfig& stage_config =
+                lane_config.stages[static_cast<std::size_t>(pipeline_stage_from_name(stage))];
+            for (const auto& [key, value] : settings) {
+                if (key == "capacity" && value >= 0) {
+                    stage_config.capacity = static_cast<std::size_t>(value);
+                } else if (key == "cpu" && value >= -1 && value <= INT32_MAX) {
+                    stage_config.cpu = static_cast<int>(value);
+                } else {
+                    throw py::value_error("IngestPipeline: bad " + lane + " " + stage + " setting " + key + "=" +
+                                          std::to_string(value) + "; expected capacity >= 0 or cpu >= -1");
+                }
+            }
+        }
+    }
+}
+
+py::dict stage_queue_stats_to_python(const StageQueueStats& stats) {
+    py::dict result;
+    result["capacity"] = stats.capacity;
+    result["depth"] = stats.depth;
+    result["bytes"] = stats.bytes;
+    result["high_water"] = stats.high_water;
+    result["pushed"] = stats.pushed;
+    result["popped"] = stats.popped;
+    result["dropped"] = stats.dropped;
+    result["conflated"] = stats.conflated;
+    result["blocked"] = stats.blocked;
+    result["blocked_us"] = stats.blocked_us;
+    return result;
+}
+
+// Per lane: its policy, each stage queue's stats and the lane counters
+py::dict ingest_pipeline_stats_to_python(const IngestPipeline& pipeline) {
+    py::dict result;
+    for (std::size_t i = 0; i < PIPELINE_LANES; ++i) {
+        const PipelineLaneStats stats = pipeline.lane_stats(static_cast<PipelineLane>(i));
+        py::dict lane;
+        const PipelineLaneConfig& config = pipeline.config().lanes[i];
+        lane["policy"] = OVERFLOW_POLICY_NAMES[static_cast<std::size_t>(config.policy)];
+        py::dict stages;
+        for (std::size_t s = 0; s < PIPELINE_STAGES; ++s) {
+            const PipelineStageStats& stage_stats = stats.stages[s];
+            py::dict stage;
+            stage["capacity"] = config.queue_capacity(static_cast<PipelineStage>(s));
+            stage["cpu"] = config.stages[s].cpu;
+            stage["items"] = stage_stats.items;
+            stage["busy_us"] = stage_stats.busy_us;
+            stage["latency"] = latency_summary_to_python(stage_stats.latency);
+            stages[PIPELINE_STAGE_NAMES[s]] = stage;
+        }
+        lane["stages"] = stages;
+        lane["ingress"] = stage_queue_stats_to_python(stats.ingress);
+        lane["books"] = stage_queue_stats_to_python(stats.books);
+        lane["publish"] = stage_queue_stats_to_python(stats.publish);
+        lane["frames"] = stats.frames;
+        lane["records"] = stats.records;
+        lane["decode_errors"] = stats.decode_errors;
+        lane["published"] = stats.published;
+        lane["publish_waits"] = stats.publish_waits;
+        lane["publish_errors"] = stats.publish_errors;
+        result[PIPELINE_LANE_NAMES[i]] = lane;
+    }
+    result["unrouted"] = pipeline.unrouted();
+    result["book_gaps"] = pipeline.book_gaps();
+    result["placement_error"] = pipeline.placement_error();
+    return result;
+}
+
+// Records of taken pipeline items, laid out like serialize_records output
+py::dict pipeline_items_to_python(const std::vector<PipelineItem>& items) {
+    std::size_t bytes = 0;
+    std::size_t records = 0;
+    for (const PipelineItem& item : items) {
+        bytes += item.records.size();
+        records += item.ends.size();
+    }
+    py::bytes payload(nullptr, bytes);
+    char* out = PyBytes_AS_STRING(payload.ptr());
+    std::vector<int64_t> offsets{0};
+    offsets.reserve(records + 1);
+    std::vector<uint64_t> received_us;
+    received_us.reserve(records);
+    py::list partition_keys;
+    for (const PipelineItem& item : items) {
+        const int64_t base = offsets.back();
+        std::memcpy(out + base, item.records.data(), item.records.size());
+        const py::str key(item.symbol);
+        for (const uint32_t end : item.ends) {
+            offsets.push_back(base + end);
+            partition_keys.append(key);
+            received_us.push_back(item.received_us);
+        }
+    }
+    py::dict result;
+    result["records"] = records;
+    result["payload"] = payload;
+    result["offsets"] = column_to_numpy(std::move(offsets));
+    result["partition_keys"] = partition_keys;
+    result["received_us"] = column_to_numpy(std::move(received_us));
+    return result;
+}
+
+py::dict synthetic_stream_stats_to_python(const SyntheticStream& stream) {
+    const SyntheticStreamStats& stats = stream.stats();
+    py::dict result;
+    result["trades"] = stats.trades;
+    result["best_bid_ask"] = stats.best_bid_ask;
+    result["depth_diffs"] = stats.depth_diffs;
+    result["partial_depth"] = stats.partial_depth;
+    result["bytes"] = stats.bytes;
+    return result;
+}
+
+py::dict stream_load_stats_to_python(const StreamLoadServer& server) {
+    const StreamLoadServerStats& stats = server.stats();
+    py::dict result;
+    result["clients"] = stats.clients.load();
+    result["connections"] = stats.connections.load();
+    result["dropped"] = stats.dropped.load();
+    result["frames_sent"] = stats.frames_sent.load();
+    result["bytes_sent"] = stats.bytes_sent.load();
+    result["batches"] = stats.batches.load();
+    result["behind_us"] = stats.behind_us.load();
+    result["max_behind_us"] = stats.max_behind_us.load();
+    result["finished"] = server.finished();
+    return result;
+}
+
+// The next `count` frames end to end, in read_journal's layout
+py::dict synthetic_stream_generate(SyntheticStream& stream, std::size_t count) {
+    std::vector<char> frames;
+    std::vector<uint64_t> offsets{0};
+    std::vector<uint64_t> event_us;
+    std::vector<uint16_t> template_ids;
+    {
+        py::gil_scoped_release release;
+        offsets.reserve(count + 1);
+        event_us.reserve(count);
+        template_ids.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t start = frames.size();
+            event_us.push_back(stream.next(frames));
+            uint16_t template_id = 0;
+            std::memcpy(&template_id, frames.data() + start + 2, sizeof(template_id));
+            template_ids.push_back(template_id);
+            offsets.push_back(frames.size());
+        }
+    }
+    py::dict result;
+    result["event_ts_us"] = column_to_numpy(std::move(event_us));
+    result["template_id"] = column_to_numpy(std::move(template_ids));
+    result["offsets"] = column_to_numpy(std::move(offsets));
+    result["frames"] = py::bytes(frames.data(), frames.size());
+    return result;
+}
+
+// A journal file as columns: one entry per record, frames end to end. A
+// start time seeks with the file's sparse index; reading stops at the
+// first record received after the end time.
+py::dict read_journal(const std::string& path, const std::optional<uint64_t>& start_ts_us,
+                      const std::optional<uint64_t>& end_ts_us) {
+    std::vector<uint64_t> received_us;
+    std::vector<uint64_t> sequence;
+    std::vector<uint16_t> connection_id;
+    std::vector<uint64_t> offsets{0};
+    std::string frames;
+    uint64_t created_us = 0;
+    {
+        py::gil_scoped_release release;
+        JournalReader reader(path);
+        created_us = reader.file_header().created_us;
+        if (start_ts_us) {
+            reader.seek(*start_ts_us);
+        }
+        JournalRecord record;
+        while (reader.next(record)) {
+            if (end_ts_us && record.header->received_us > *end_ts_us) {
+                break;
+            }
+            if (start_ts_us && record.header->received_us < *start_ts_us) {
+                continue;
+            }
+            received_us.push_back(record.header->received_us);
+            sequence.push_back(record.header->sequence);
+            connection_id.push_back(record.header->connection_id);
+            frames.append(record.frame.data(), record.frame.size());
+            offsets.push_back(frames.size());
+        }
+    }
+    py::dict result;
+    result["created_ts_us"] = created_us;
+    result["received_ts_us"] = column_to_numpy(std::move(received_us));
+    result["sequence"] = column_to_numpy(std::move(sequence));
+    result["connection_id"] = column_to_numpy(std::move(connection_id));
+    result["offsets"] = column_to_numpy(std::move(offsets));
+    result["frames"] = py::bytes(frames);
+    return result;
+}
+
+ReplayOrder replay_order_from_name(const std::string& name) {
+    if (name == "received") {
+        return ReplayOrder::Received;
+    }
+    if (name == "event") {
+        return ReplayOrder::Event;
+    }
+    throw py::value_error("order must be 'received' or 'event', got '" + name + "'");
+}
+
+// The merger's next `max_n` SBE messages in read_journal's layout, plus
+// their event time, template and source file; None once every file is done
+py::object journal_event_merger_read(JournalEventMerger& merger, std::size_t max_n) {
+    std::vector<uint64_t> received_us;
+    std::vector<uint64_t> event_us;
+    std::vector<uint16_t> template_ids;
+    std::vector<uint32_t> sources;
+    std::vector<uint64_t> offsets{0};
+    std::string frames;
+    {
+        py::gil_scoped_release release;
+        MergedMessage message;
+        while (received_us.size() < max_n && merger.next(message)) {
+            received_us.push_back(message.received_us);
+            event_us.push_back(message.key.event_us);
+            template_ids.push_back(message.template_id);
+            sources.push_back(message.key.source);
+            frames.append(message.frame.data(), message.frame.size());
+            offsets.push_back(frames.size());
+        }
+    }
+    if (received_us.empty()) {
+        return py::none();
+    }
+    py::dict result;
+    result["received_ts_us"] = column_to_numpy(std::move(received_us));
+    result["event_ts_us"] = column_to_numpy(std::move(event_us));
+    result["template_id"] = column_to_numpy(std::move(template_ids));
+    result["source"] = column_to_numpy(std::move(sources));
+    result["offsets"] = column_to_numpy(std::move(offsets));
+    result["frames"] = py::bytes(frames);
+    return result;
+}
+
+py::dict pool_decode_batch(DecoderPool& pool, const py::object& frames, const std::optional<OffsetsArray>& offsets,
+                           const std::optional<uint64_t>& ingest_ts_us, const std::string& format) {
+    const bool arrow = arrow_format_from_name(format, "decode_batch");
+    FrameBufferList buffers{true};
+    collect_frames(buffers, frames, offsets);
+
+    BatchColumns batch;
+    std::vector<std::string> gaps;
+    {
+        py::gil_scoped_release release;
+        pool.decode(buffers.frames(), batch, ingest_ts_us.value_or(0), gaps);
+    }
+    py::dict result = batch_to_python(std::move(batch), arrow);
+    result["book_gaps"] = gaps;
+    return result;
+}
+
+py::object pool_book_to_python(DecoderPool& pool, const std::string& symbol, std::size_t depth) {
+    return pool.with_book(symbol, [&](const OrderBook* book) -> py::object {
+        if (book == nullptr) {
+            return py::none();
+        }
+        py::dict result;
+        result["symbol"] = symbol_str(book->symbol());
+        result["last_update_id"] = book->last_update_id();
+        result["event_ts"] = micros_to_millis(book->event_time_us());
+        result["bids"] = book_side_to_python(book->bids(), depth, book->price_exponent(), book->qty_exponent());
+        result["asks"] = book_side_to_python(book->asks(), depth, book->price_exponent(), book->qty_exponent());
+        result["features"] = book_features_to_numpy(*book);
+        return result;
+    });
+}
+
+py::object pool_book_checksum(DecoderPool& pool, const std::string& symbol, std::size_t depth) {
+    return pool.with_book(symbol, [&](const OrderBook* book) -> py::object {
+        return book == nullptr ? py::none() : py::int_(book->checksum(depth));
+    });
+}
+
+py::object symbol_rules_to_python(const SymbolRulesTable& table, const std::string& symbol) {
+    const SymbolId id = table.id_of(symbol);
+    const SymbolRules* rules = table.rules(id);
+    if (rules == nullptr) {
+        return py::none();
+    }
+    py::dict result;
+    result["id"] = id;
+    result["listed"] = rules->listed;
+    result["status"] = static_cast<int>(rules->status);
+    result["price_exponent"] = static_cast<int>(rules->price_exponent);
+    result["min_price"] = rules->min_price;
+    result["max_price"] = rules->max_price;
+    result["tick_size"] = rules->tick_size;
+    result["qty_exponent"] = static_cast<int>(rules->qty_exponent);
+    result["min_qty"] = rules->min_qty;
+    result["max_qty"] = rules->max_qty;
+    result["step_size"] = rules->step_size;
+    result["notional_exponent"] = static_cast<int>(rules->notional_exponent);
+    result["min_notional"] = rules->min_notional;
+    return result;
+}
+
+// Same keys as RecordDeduplicator.get_stats, for a drop-in swap
+template <typename Window>
+py::dict dedup_stats_to_python(const Window& window) {
+    const typename Window::Stats& stats = window.stats();
+    py::dict result;
+    result["total_checks"] = stats.checks;
+    result["duplicates_found"] = stats.duplicates;
+    result["unique_records"] = stats.unique;
+    result["duplicate_rate"] =
+        stats.checks == 0 ? 0.0 : static_cast<double>(stats.duplicates) / static_cast<double>(stats.checks);
+    result["total_tracked_records"] = window.size();
+    result["memory_usage_mb"] = static_cast<double>(window.memory_bytes()) / (1024.0 * 1024.0);
+    result["window_size_seconds"] = static_cast<double>(window.window_us()) / 1e6;
+    return result;
+}
+
+py::dict dedup_filter_stats_to_python(const DedupFilter& filter) {
+    py::dict result = dedup_stats_to_python(filter);
+    result["memory_bytes"] = filter.memory_bytes();
+    result["estimated_fp_rate"] = filter.estimated_fp_rate();
+    result["target_fp_rate"] = filter.target_fp_rate();
+    result["hashes"] = filter.hashes();
+    result["page_backing"] = PAGE_BACKING_NAMES[static_cast<std::size_t>(filter.memory().backing())];
+    return result;
+}
+
+using FloatColumn = py::array_t<double, py::array::c_style | py::array::forcecast>;
+using FlagColumn = py::array_t<bool, py::array::c_style | py::array::forcecast>;
+
+// The dict FeatureBuilder._build_trade_features returns
+py::dict trade_features_to_python(const TradeFeatures& f) {
+    py::dict result;
+    result["price"] = f.price;
+    result["volume"] = f.volume;
+    result["vwap"] = f.vwap;
+    result["price_change"] = f.price_change;
+    result["price_change_pct"] = f.price_change_pct;
+    result["min_price"] = f.min_price;
+    result["max_price"] = f.max_price;
+    result["avg_price"] = f.avg_price;
+    result["price_volatility"] = f.price_volatility;
+    result["trade_count"] = f.trade_count;
+    result["trades_per_second"] = f.trades_per_second;
+    result["buy_volume"] = f.buy_volume;
+    result["sell_volume"] = f.sell_volume;
+    result["volume_imbalance"] = f.volume_imbalance;
+    result["avg_trade_size"] = f.avg_trade_size;
+    result["time_span_seconds"] = f.time_span_seconds;
+    return result;
+}
+
+
+// add() each row of a decode_batch trades table (trade_time, price, qty,
+// is_buyer_maker columns)
+template <typename Window>
+void add_trade_columns(Window& window, const OffsetsArray& trade_time, const FloatColumn& price, const FloatColumn& qty,
+                       const FlagColumn& is_buyer_maker) {
+    const auto count = trade_time.size();
+    if (price.size() != count || qty.size() != count || is_buyer_maker.size() != count) {
+        throw py::value_error("add_batch: columns must have the same length");
+    }
+    const int64_t* ts = trade_time.data();
+    const double* prices = price.data();
+    const double* qtys = qty.data();
+    const bool* makers = is_buyer_maker.data();
+    for (py::ssize_t i = 0; i < count; ++i) {
+        window.add(ts[i], prices[i], qtys[i], makers[i]);
+    }
+}
+
+// {"1s": features, "10s": features, ...}, one _build_trade_features dict
+// per horizon (empty when the horizon holds no trades)
+py::dict horizon_features_to_python(const MultiHorizonWindow& window) {
+    py::dict result;
+    TradeSummary summary;
+    for (std::size_t h = 0; h < window.horizons_ms().size(); ++h) {
+        char label[32];
+        std::snprintf(label, sizeof(label), "%gs", static_cast<double>(window.horizons_ms()[h]) / 1e3);
+        result[label] = window.combine(h, summary) > 0 ? trade_features_to_python(trade_features(summary)) : py::dict();
+    }
+    return result;
+}
+
+// Per horizon ('10s'), each metric's quantiles keyed like 'trade_size_p99';
+// a metric without values in the horizon is left out
+py::dict quantile_features_to_python(const QuantileWindow& window, const std::vector<double>& quantiles) {
+    std::vector<std::string> suffixes;
+    for (const double q : quantiles) {
+        if (!finite_bits(q) || !(q >= 0 && q <= 1)) {
+            throw py::value_error("quantiles must be in [0, 1]");
+        }
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "_p%g", q * 100);
+        suffixes.emplace_back(suffix);
+    }
+    py::dict result;
+    TDigest digest(window.compression());
+    for (std::size_t h = 0; h < window.horizons_ms().size(); ++h) {
+        char label[32];
+        std::snprintf(label, sizeof(label), "%gs", static_cast<double>(window.horizons_ms()[h]) / 1e3);
+        py::dict features;
+        for (std::size_t m = 0; m < QUANTILE_METRIC_NAMES.size(); ++m) {
+            if (window.combine(h, static_cast<QuantileMetric>(m), digest) == 0) {
+                continue;
+            }
+            for (std::size_t i = 0; i < quantiles.size(); ++i) {
+                features[(QUANTILE_METRIC_NAMES[m] + suffixes[i]).c_str()] = digest.quantile(quantiles[i]);
+            }
+        }
+        result[label] = features;
+    }
+    return result;
+}
+
+// The dict FeatureBuilder._build_orderbook_features returns
+py::dict quote_features_to_python(const QuoteFeatures& f) {
+    py::dict result;
+    result["price"] = f.price;
+    result["bid_price"] = f.bid_price;
+    result["ask_price"] = f.ask_price;
+    result["spread"] = f.spread;
+    result["spread_pct"] = f.spread_pct;
+    result["mid_price"] = f.mid_price;
+    result["avg_bid"] = f.avg_bid;
+    result["avg_ask"] = f.avg_ask;
+    result["avg_spread"] = f.avg_spread;
+    result["avg_mid"] = f.avg_mid;
+    result["min_spread"] = f.min_spread;
+    result["max_spread"] = f.max_spread;
+    result["spread_volatility"] = f.spread_volatility;
+    result["bid_size"] = f.bid_size;
+    result["ask_size"] = f.ask_size;
+    result["avg_bid_size"] = f.avg_bid_size;
+    result["avg_ask_size"] = f.avg_ask_size;
+    result["total_bid_size"] = f.total_bid_size;
+    result["total_ask_size"] = f.total_ask_size;
+    result["size_imbalance"] = f.size_imbalance;
+    result["mid_change"] = f.mid_change;
+    result["mid_change_pct"] = f.mid_change_pct;
+    result["update_count"] = f.update_count;
+    return result;
+}
+
+// Features of a window or ring, or an empty dict when it holds no rows, as
+// the Python builders return
+template <typename Source, typename ToPython>
+py::dict features_or_empty(const Source& source, ToPython&& to_python) {
+    if (source.size() == 0) {
+        return py::dict();
+    }
+    return to_python(source.features());
+}
+
+// One ring column in row order (oldest first), unwrapped into a new array
+template <typename T>
+py::array ring_column_to_numpy(const RingIndex& index, const std::vector<T>& column) {
+    std::vector<T> rows;
+    rows.reserve(index.size());
+    index.for_each_run([&](std::size_t first, std::size_t count) {
+        rows.insert(rows.end(), column.begin() + first, column.begin() + first + count);
+    });
+    return column_to_numpy(std::move(rows));
+}
+
+// column_stats over a price column and an optional qty column of the same
+// length, reduced without the GIL
+py::dict column_stats_to_python(const FloatColumn& price, const std::optional<FloatColumn>& qty) {
+    if (qty && qty->size() != price.size()) {
+        throw py::value_error("column_stats: price and qty must have the same length");
+    }
+    const double* prices = price.data();
+    const double* qtys = qty ? qty->data() : nullptr;
+    const auto count = static_cast<std::size_t>(price.size());
+    ColumnStats stats;
+    {
+        py::gil_scoped_release release;
+        stats = column_stats(prices, qtys, count);
+    }
+    py::dict result;
+    result["count"] = stats.count;
+    if (stats.count == 0) {
+        return result;
+    }
+    result["min"] = stats.min;
+    result["max"] = stats.max;
+    result["sum"] = stats.sum();
+    result["sum_sq"] = stats.sum_sq();
+    result["mean"] = stats.mean();
+    result["variance"] = stats.variance();
+    result["stdev"] = std::sqrt(stats.variance());
+    if (qtys != nullptr) {
+        result["qty_sum"] = stats.qty_sum;
+        result["weighted_sum"] = stats.weighted_sum;
+        result["vwap"] = stats.vwap();
+    }
+    return result;
+}
+
+// parse_decimals: str (or bytes) decimal text of a whole column, parsed
+// without the GIL. Anything else - None, numbers, malformed text - is an
+// invalid row the caller converts its own way.
+py::dict parse_decimals_to_python(const py::sequence& values, const std::optional<int>& exponent) {
+    if (exponent && (*exponent < INT8_MIN || *exponent > INT8_MAX)) {
+        throw py::value_error("parse_decimals: exponent must fit int8");
+    }
+    // The fast sequence holds references to the items, keeping the text
+    // pointers valid while the GIL is released
+    auto items = py::reinterpret_steal<py::object>(
+        PySequence_Fast(values.ptr(), "parse_decimals: expected a sequence"));
+    if (!items) {
+        throw py::error_already_set();
+    }
+    const auto count = static_cast<std::size_t>(PySequence_Fast_GET_SIZE(items.ptr()));
+    PyObject** objects = PySequence_Fast_ITEMS(items.ptr());
+    std::vector<std::string_view> texts(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        PyObject* item = objects[i];
+        if (PyUnicode_Check(item)) {
+            Py_ssize_t size = 0;
+            const char* text = PyUnicode_AsUTF8AndSize(item, &size);
+            if (text == nullptr) {
+                PyErr_Clear();
+                continue;
+            }
+            texts[i] = {text, static_cast<std::size_t>(size)};
+        } else if (PyBytes_Check(item)) {
+            texts[i] = {PyBytes_AS_STRING(item), static_cast<std::size_t>(PyBytes_GET_SIZE(item))};
+        }
+    }
+
+    DecimalTextColumn column;
+    std::vector<int64_t> scaled;
+    {
+        py::gil_scoped_release release;
+        column = parse_decimal_column(texts);
+        if (exponent) {
+            scaled.resize(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                const Decimal value{column.mantissa[i], column.exponent[i]};
+                if (column.valid[i] != 0 && !rescale_decimal(value, *exponent, scaled[i])) {
+                    scaled[i] = 0;
+                    column.valid[i] = 0;
+                    ++column.invalid;
+                }
+            }
+        }
+    }
+
+    py::dict result;
+    if (exponent) {
+        result["value"] = column_to_numpy(std::move(scaled));
+    } else {
+        result["mantissa"] = column_to_numpy(std::move(column.mantissa));
+        result["exponent"] = column_to_numpy(std::move(column.exponent));
+    }
+    result["valid"] = flags_to_numpy(std::move(column.valid));
+    result["invalid"] = column.invalid;
+    return result;
+}
+
+// encode_feature_record: the header fields plus a float64 value column,
+// packed into a new bytes object without an intermediate copy
+py::bytes encode_feature_record_to_python(const FloatColumn& values, std::string_view symbol, int64_t event_ts_us,
+                                          uint64_t schema_hash, const std::string& dtype,
+                                          const std::optional<int64_t>& written_ts_us) {
+    FeatureRecordHeader header;
+    if (dtype == "float32") {
+        header.value_type = FeatureValueType::Float32;
+    } else if (dtype == "float64") {
+        header.value_type = FeatureValueType::Float64;
+    } else {
+        throw py::value_error("encode_feature_record: dtype must be 'float32' or 'float64'");
+    }
+    if (symbol.size() > header.symbol.size()) {
+        throw py::value_error("encode_feature_record: symbol longer than 16 bytes");
+    }
+    header.count = static_cast<uint32_t>(values.size());
+    header.schema_hash = schema_hash;
+    std::memcpy(header.symbol.data(), symbol.data(), symbol.size());
+    header.event_ts_us = event_ts_us;
+    header.written_ts_us = written_ts_us ? *written_ts_us : static_cast<int64_t>(ingest_time_us());
+
+    const std::size_t size = feature_record_size(header.value_type, header.count);
+    py::bytes result(nullptr, size);
+    encode_feature_record(header, values.data(), {PyBytes_AS_STRING(result.ptr()), size});
+    return result;
+}
+
+// Header fields plus the values as a float32/float64 array; raises
+// ValueError on a malformed record or, when `schema_hash` is given, a
+// record of another schema
+py::dict decode_feature_record_to_python(const py::buffer& data, const std::optional<uint64_t>& schema_hash) {
+    FrameBuffer buffer{data};
+    const std::span<const char> payload = buffer.payload();
+    FeatureRecordHeader header;
+    try {
+        header = decode_feature_record_header(payload);
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+    if (schema_hash && *schema_hash != header.schema_hash) {
+        throw py::value_error("decode_feature_record: schema hash mismatch");
+    }
+
+    const char* values = payload.data() + FEATURE_RECORD_HEADER_SIZE;
+    py::array array;
+    if (header.value_type == FeatureValueType::Float32) {
+        py::array_t<float> column(header.count);
+        std::memcpy(column.mutable_data(), values, header.count * sizeof(float));
+        array = column;
+    } else {
+        py::array_t<double> column(header.count);
+        std::memcpy(column.mutable_data(), values, header.count * sizeof(double));
+        array = column;
+    }
+
+    py::dict result;
+    result["version"] = header.version;
+    result["symbol"] = py::str(header.symbol_view().data(), header.symbol_view().size());
+    result["event_ts_us"] = header.event_ts_us;
+    result["written_ts_us"] = header.written_ts_us;
+    result["schema_hash"] = header.schema_hash;
+    result["values"] = array;
+    return result;
+}
+
+// {"event_ts_us", "schema_hash", "values"} of one FeatureBus entry
+py::dict feature_bus_entry_to_python(FeatureBusEntry& entry) {
+    py::dict result;
+    result["event_ts_us"] = entry.event_ts_us;
+    result["schema_hash"] = entry.schema_hash;
+    result["values"] = column_to_numpy(std::move(entry.values));
+    return result;
+}
+
+std::vector<int64_t> seconds_to_ms(const std::vector<double>& seconds) {
+    std::vector<int64_t> ms;
+    for (const double value : seconds) {
+        ms.push_back(std::llround(value * 1e3));
+    }
+    return ms;
+}
+
+// Route a GetRecords 'Records' list (dicts with Data and PartitionKey) into
+// the ingestor with the GIL released; returns the (partition key, payload)
+// pairs left for the dict path
+py::list ingest_kinesis_records(RecordIngestor& ingestor, const py::sequence& records) {
+    FrameBufferList buffers;
+    std::vector<std::string> keys;
+    keys.reserve(records.size());
+    for (const py::handle record : records) {
+        buffers.add(record["Data"]);
+        keys.push_back(record["PartitionKey"].cast<std::string>());
+    }
+
+    std::vector<char> returned;
+    std::vector<std::size_t> offsets{0};
+    std::vector<std::string> returned_keys;
+    {
+        py::gil_scoped_release release;
+        const auto& frames = buffers.frames();
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            ingestor.ingest(keys[i], frames[i], [&](std::string_view key, std::span<const char> payload) {
+                returned_keys.emplace_back(key);
+                returned.insert(returned.end(), payload.begin(), payload.end());
+                offsets.push_back(returned.size());
+            });
+        }
+    }
+    py::list result;
+    for (std::size_t i = 0; i < returned_keys.size(); ++i) {
+        result.append(py::make_tuple(returned_keys[i],
+                                     py::bytes(returned.data() + offsets[i], offsets[i + 1] - offsets[i])));
+    }
+    return result;
+}
+
+py::dict ingest_counts_to_python(const IngestCounts& counts) {
+    py::dict result;
+    result["records"] = counts.records;
+    result["payloads"] = counts.payloads;
+    result["aggregated"] = counts.aggregated;
+    result["compressed"] = counts.compressed;
+    result["trades"] = counts.trades;
+    result["quotes"] = counts.quotes;
+    result["returned"] = counts.returned;
+    result["skipped"] = counts.skipped;
+    result["errors"] = counts.errors;
+    return result;
+}
+
+using Float32Column = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+// (event_ts_us[rows], values[rows, width]) for gathering many streams'
+// latest vectors into one inference batch: ts 0 and NaN values until a row
+// is filled
+std::pair<py::array_t<int64_t>, py::array_t<float>> new_feature_matrix(std::size_t rows, std::size_t width) {
+    py::array_t<int64_t> ts(rows);
+    py::array_t<float> matrix({static_cast<py::ssize_t>(rows), static_cast<py::ssize_t>(width)});
+    std::fill_n(ts.mutable_data(), rows, 0);
+    std::fill_n(matrix.mutable_data(), rows * width, std::numeric_limits<float>::quiet_NaN());
+    return {ts, matrix};
+}
+
+// Feature records (Redis values; None for a missing key) as one matrix.
+// Rows of another schema than `schema_hash` stay NaN; a record whose value
+// count is not `width` raises ValueError.
+py::tuple feature_records_to_matrix(const py::sequence& records, std::size_t width,
+                                    const std::optional<uint64_t>& schema_hash) {
+    const std::size_t rows = records.size();
+    auto [ts, matrix] = new_feature_matrix(rows, width);
+    for (std::size_t k = 0; k < rows; ++k) {
+        const py::object record = records[k];
+        if (record.is_none()) {
+            continue;
+        }
+        FrameBuffer buffer{record.cast<py::buffer>()};
+        const std::span<const char> payload = buffer.payload();
+        FeatureRecordHeader header;
+        try {
+            header = decode_feature_record_header(payload);
+        } catch (const std::runtime_error& e) {
+            throw py::value_error(e.what());
+        }
+        if (schema_hash && *schema_hash != header.schema_hash) {
+            continue;
+        }
+        if (header.count != width) {
+            throw py::value_error("feature_records_to_matrix: record has " + std::to_string(header.count) +
+                                  " values, expected " + std::to_string(width));
+        }
+        const char* values = payload.data() + FEATURE_RECORD_HEADER_SIZE;
+        float* row = matrix.mutable_data() + k * width;
+        if (header.value_type == FeatureValueType::Float32) {
+            std::memcpy(row, values, width * sizeof(float));
+        } else {
+            for (std::size_t i = 0; i < width; ++i) {
+                double value;
+                std::memcpy(&value, values + i * sizeof(double), sizeof(double));
+                row[i] = static_cast<float>(value);
+            }
+        }
+        ts.mutable_data()[k] = header.event_ts_us;
+    }
+    return py::make_tuple(ts, matrix);
+}
+
+// History blobs (Redis values, oldest first; None for a missing key) as
+// one dict per schema: schema_hash, int64 timestamps_us and a float64
+// (rows, width) values matrix
+py::list decode_feature_history_to_python(const py::sequence& blobs) {
+    std::vector<FeatureHistorySeries> series;
+    for (const py::handle blob : blobs) {
+        if (blob.is_none()) {
+            continue;
+        }
+        FrameBuffer buffer{blob.cast<py::buffer>()};
+        try {
+            decode_feature_history(buffer.payload(), series);
+        } catch (const std::runtime_error& e) {
+            throw py::value_error(e.what());
+        }
+    }
+    py::list result;
+    for (FeatureHistorySeries& s : series) {
+        py::array_t<double> values({static_cast<py::ssize_t>(s.rows()), static_cast<py::ssize_t>(s.width)});
+        std::memcpy(values.mutable_data(), s.values.data(), s.values.size() * sizeof(double));
+        py::dict entry;
+        entry["schema_hash"] = s.schema_hash;
+        entry["timestamps_us"] = column_to_numpy(std::move(s.timestamps_us));
+        entry["values"] = values;
+        result.append(entry);
+    }
+    return result;
+}
+
+Activation activation_from_name(const std::string& name) {
+    if (name == "relu") {
+        return Activation::Relu;
+    }
+    if (name == "tanh") {
+        return Activation::Tanh;
+    }
+    if (name == "sigmoid") {
+        return Activation::Sigmoid;
+    }
+    if (name == "identity" || name == "linear") {
+        return Activation::Identity;
+    }
+    throw py::value_error("MlpModel: unknown activation '" + name + "'");
+}
+
+const char* activation_name(Activation activation) {
+    switch (activation) {
+    case Activation::Relu:
+        return "relu";
+    case Activation::Tanh:
+        return "tanh";
+    case Activation::Sigmoid:
+        return "sigmoid";
+    case Activation::Identity:
+        break;
+    }
+    return "identity";
+}
+
+// MlpModel from (weights[out][in], bias[out], activation) tuples, BatchNorm
+// already folded in
+std::unique_ptr<MlpModel> mlp_from_python(const py::list& layers, const std::optional<Float32Column>& input_mean,
+                                          const std::optional<Float32Column>& input_scale) {
+    std::vector<DenseLayer> dense;
+    for (const py::handle& item : layers) {
+        const auto spec = item.cast<py::tuple>();
+        if (spec.size() != 3) {
+            throw py::value_error("MlpModel: each layer is (weights, bias, activation)");
+        }
+        const auto weights = spec[0].cast<Float32Column>();
+        const auto bias = spec[1].cast<Float32Column>();
+        if (weights.ndim() != 2 || bias.ndim() != 1 || bias.shape(0) != weights.shape(0)) {
+            throw py::value_error("MlpModel: weights must be (out, in) and bias (out,)");
+        }
+        DenseLayer layer;
+        layer.out = static_cast<uint32_t>(weights.shape(0));
+        layer.in = static_cast<uint32_t>(weights.shape(1));
+        layer.activation = activation_from_name(spec[2].cast<std::string>());
+        const std::size_t stride = layer.stride();
+        layer.weights.assign(std::size_t{layer.out} * stride, 0.0f);
+        for (uint32_t r = 0; r < layer.out; ++r) {
+            std::memcpy(layer.weights.data() + r * stride, weights.data() + std::size_t{r} * layer.in,
+                        layer.in * sizeof(float));
+        }
+        layer.bias.assign(bias.data(), bias.data() + layer.out);
+        dense.push_back(std::move(layer));
+    }
+    const auto to_vector = [](const std::optional<Float32Column>& column) {
+        return column ? std::vector<float>(column->data(), column->data() + column->size()) : std::vector<float>();
+    };
+    try {
+        return std::make_unique<MlpModel>(to_vector(input_mean), to_vector(input_scale), std::move(dense));
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+}
+
+py::array_t<float> mlp_predict_to_python(MlpModel& model, const Float32Column& x) {
+    if (x.ndim() != 1 || static_cast<std::size_t>(x.size()) != model.input_size()) {
+        throw py::value_error("predict: expected " + std::to_string(model.input_size()) + " features");
+    }
+    py::array_t<float> out(model.output_size());
+    model.predict(x.data(), out.mutable_data());
+    return out;
+}
+
+py::array_t<float> mlp_predict_batch_to_python(MlpModel& model, const Float32Column& x) {
+    if (x.ndim() != 2 || static_cast<std::size_t>(x.shape(1)) != model.input_size()) {
+        throw py::value_error("predict_batch: expected an (n, " + std::to_string(model.input_size()) + ") matrix");
+    }
+    py::array_t<float> out({x.shape(0), static_cast<py::ssize_t>(model.output_size())});
+    model.predict_batch(x.data(), static_cast<std::size_t>(x.shape(0)), out.mutable_data());
+    return out;
+}
+
+// The swap's current model, after picking up a staged one
+MlpModel& mlp_swap_current(MlpModelSwap& swap) {
+    MlpModel* model = swap.current();
+    if (model == nullptr) {
+        throw py::value_error("MlpModelSwap: no model staged yet");
+    }
+    return *model;
+}
+
+constexpr std::array<const char*, 3> FEATURE_SCALING_NAMES = {"none", "standard", "minmax"};
+
+FeatureScaling feature_scaling_from_name(const std::string& name) {
+    for (std::size_t i = 0; i < FEATURE_SCALING_NAMES.size(); ++i) {
+        if (name == FEATURE_SCALING_NAMES[i]) {
+            return static_cast<FeatureScaling>(i);
+        }
+    }
+    throw py::value_error("FeatureManifest: unknown scaling '" + name + "'");
+}
+
+// FeatureManifest from (source, feature names) pairs and (source, feature[,
+// scaling, a, b[, fill]]) inputs in model order
+FeatureManifest feature_manifest_from_python(const py::sequence& sources, const py::sequence& inputs) {
+    std::vector<FeatureSourceLayout> layouts;
+    for (const py::handle item : sources) {
+        const auto spec = item.cast<py::tuple>();
+        if (spec.size() != 2) {
+            throw py::value_error("FeatureManifest: each source is (name, feature names)");
+        }
+        layouts.push_back({spec[0].cast<std::string>(), spec[1].cast<std::vector<std::string>>()});
+    }
+    std::vector<NamedFeatureInput> named;
+    for (const py::handle item : inputs) {
+        const auto spec = item.cast<py::tuple>();
+        if (spec.size() != 2 && spec.size() != 5 && spec.size() != 6) {
+            throw py::value_error("FeatureManifest: each input is (source, feature[, scaling, a, b[, fill]])");
+        }
+        NamedFeatureInput input{spec[0].cast<std::string>(), spec[1].cast<std::string>()};
+        if (spec.size() > 2) {
+            input.scaling = feature_scaling_from_name(spec[2].cast<std::string>());
+            input.a = spec[3].cast<float>();
+            input.b = spec[4].cast<float>();
+        }
+        if (spec.size() > 5) {
+            input.fill = spec[5].cast<float>();
+        }
+        named.push_back(std::move(input));
+    }
+    try {
+        return FeatureManifest::compile(layouts, named);
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+}
+
+// Rows of binary feature records as (event_ts_us, float32 (rows, width)
+// model inputs): each row is a sequence of one record (None when missing)
+// per manifest source, or just the record when the manifest has one source
+py::tuple feature_assembler_from_records(FeatureAssembler& assembler, const py::sequence& rows) {
+    const std::size_t sources = assembler.manifest().sources().size();
+    auto [ts, matrix] = new_feature_matrix(rows.size(), assembler.width());
+    std::vector<std::unique_ptr<FrameBuffer>> buffers;
+    std::vector<std::span<const char>> records(sources);
+    for (std::size_t k = 0; k < rows.size(); ++k) {
+        const py::object row = rows[k];
+        const bool single = sources == 1 && (row.is_none() || py::isinstance<py::buffer>(row));
+        const py::sequence cells = single ? py::make_tuple(row) : row.cast<py::sequence>();
+        if (cells.size() != sources) {
+            throw py::value_error("FeatureAssembler: row " + std::to_string(k) + " needs one record per source");
+        }
+        buffers.clear();
+        for (std::size_t s = 0; s < sources; ++s) {
+            const py::object cell = cells[s];
+            records[s] = {};
+            if (!cell.is_none()) {
+                buffers.push_back(std::make_unique<FrameBuffer>(cell.cast<py::buffer>()));
+                records[s] = buffers.back()->payload();
+            }
+        }
+        try {
+            ts.mutable_data()[k] = assembler.assemble(records, matrix.mutable_data() + k * assembler.width());
+        } catch (const std::runtime_error& e) {
+            throw py::value_error(e.what());
+        }
+    }
+    return py::make_tuple(ts, matrix);
+}
+
+using Int64Column = py::array_t<int64_t, py::array::c_style | py::array::forcecast>;
+
+const char* parquet_type_name(ParquetType type) {
+    switch (type) {
+    case ParquetType::INT64:
+        return "int64";
+    case ParquetType::FLOAT64:
+        return "float64";
+    case ParquetType::BOOL:
+        return "bool";
+    case ParquetType::STRING:
+        return "string";
+    case ParquetType::TIMESTAMP_MS:
+        return "timestamp_ms";
+    }
+    return "int64";
+}
+
+// One value of `column` from a Python object, cast to the column's type
+void parquet_append_value(ParquetWriter& writer, std::size_t column, const py::handle& value) {
+    switch (writer.spec(column).type) {
+    case ParquetType::INT64:
+    case ParquetType::TIMESTAMP_MS:
+        writer.append_int64(column, value.cast<int64_t>());
+        break;
+    case ParquetType::FLOAT64:
+        writer.append_float64(column, value.cast<double>());
+        break;
+    case ParquetType::BOOL:
+        writer.append_bool(column, value.cast<bool>());
+        break;
+    case ParquetType::STRING:
+        writer.append_string(column, value.cast<std::string_view>());
+        break;
+    }
+}
+
+// Rows as mappings holding every column (other keys are ignored); a row that
+// fails to convert undoes the whole call
+void parquet_append_rows(ParquetWriter& writer, const py::iterable& rows) {
+    std::vector<py::str> names;
+    for (std::size_t i = 0; i < writer.column_count(); ++i) {
+        names.emplace_back(writer.spec(i).name);
+    }
+    const std::size_t before = writer.rows();
+    try {
+        for (const py::handle row : rows) {
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                const py::object value = row[names[i]];
+                parquet_append_value(writer, i, value);
+            }
+        }
+    } catch (...) {
+        writer.truncate(before);
+        throw;
+    }
+}
+
+// Whole columns: arrays or sequences of equal length (a decode_batch table
+// fits as it is; extra keys are ignored), and for string columns also a
+// single str repeated on every row, e.g. the symbol
+void parquet_append_columns(ParquetWriter& writer, const py::dict& columns) {
+    std::optional<std::size_t> rows;
+    std::vector<py::object> values;
+    for (std::size_t i = 0; i < writer.column_count(); ++i) {
+        const ParquetColumnSpec& spec = writer.spec(i);
+        const py::str name(spec.name);
+        if (!columns.contains(name)) {
+            throw py::key_error(spec.name);
+        }
+        py::object value = columns[name];
+        if (!(spec.type == ParquetType::STRING && py::isinstance<py::str>(value))) {
+            const std::size_t size = py::len(value);
+            if (rows && *rows != size) {
+                throw py::value_error("ParquetWriter.append_columns: column '" + spec.name + "' has " +
+                                      std::to_string(size) + " values, expected " + std::to_string(*rows));
+            }
+            rows = size;
+        }
+        values.push_back(std::move(value));
+    }
+    if (!rows) {
+        throw py::value_error("ParquetWriter.append_columns: no column gives the row count");
+    }
+
+    const std::size_t before = writer.rows();
+    try {
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            switch (writer.spec(i).type) {
+            case ParquetType::INT64:
+            case ParquetType::TIMESTAMP_MS: {
+                const auto column = values[i].cast<Int64Column>();
+                writer.append_int64s(i, {column.data(), *rows});
+                break;
+            }
+            case ParquetType::FLOAT64: {
+                const auto column = values[i].cast<FloatColumn>();
+                writer.append_float64s(i, {column.data(), *rows});
+                break;
+            }
+            case ParquetType::BOOL: {
+                const auto column = values[i].cast<FlagColumn>();
+                writer.append_bools(i, {reinterpret_cast<const uint8_t*>(column.data()), *rows});
+                break;
+            }
+            case ParquetType::STRING:
+                if (py::isinstance<py::str>(values[i])) {
+                    const auto value = values[i].cast<std::string_view>();
+                    for (std::size_t row = 0; row < *rows; ++row) {
+                        writer.append_string(i, value);
+                    }
+                } else {
+                    for (const py::handle value : values[i]) {
+                        writer.append_string(i, value.cast<std::string_view>());
+                    }
+                }
+                break;
+            }
+        }
+    } catch (...) {
+        writer.truncate(before);
+        throw;
+    }
+}
+
+std::vector<ParquetColumnSpec> column_specs_from_python(const std::vector<std::pair<std::string, std::string>>& columns) {
+    std::vector<ParquetColumnSpec> specs;
+    for (const auto& [name, type] : columns) {
+        specs.push_back({name, parquet_type_from_name(type)});
+    }
+    return specs;
+}
+
+// Parsed JSONL columns: NumPy arrays, strings as lists of str (one object
+// per distinct value, since symbols and sources repeat on every row), plus
+// a bool mask of the missing rows for each column that has any
+py::dict ndjson_table_to_python(const NdjsonParser& parser, NdjsonTable&& table) {
+    py::dict columns;
+    py::dict missing;
+    for (std::size_t i = 0; i < table.columns.size(); ++i) {
+        NdjsonColumn& column = table.columns[i];
+        const std::string& name = parser.columns()[i].name;
+        switch (column.type) {
+        case ParquetType::INT64:
+        case ParquetType::TIMESTAMP_MS:
+            columns[name.c_str()] = column_to_numpy(std::move(column.ints));
+            break;
+        case ParquetType::FLOAT64:
+            columns[name.c_str()] = column_to_numpy(std::move(column.doubles));
+            break;
+        case ParquetType::BOOL:
+            columns[name.c_str()] = flags_to_numpy(std::move(column.flags));
+            break;
+        case ParquetType::STRING: {
+            std::unordered_map<std::string_view, py::str> distinct;
+            py::list values(table.rows);
+            for (std::size_t row = 0; row < table.rows; ++row) {
+                const std::string_view text = column.string(row);
+                auto it = distinct.find(text);
+                if (it == distinct.end()) {
+                    it = distinct.emplace(text, py::str(text.data(), text.size())).first;
+                }
+                values[row] = it->second;
+            }
+            columns[name.c_str()] = values;
+            break;
+        }
+        }
+        if (column.missing != 0) {
+            missing[name.c_str()] = flags_to_numpy(std::move(column.absent));
+        }
+    }
+    py::dict result;
+    result["columns"] = columns;
+    result["rows"] = table.rows;
+    result["lines"] = table.lines;
+    result["bad_lines"] = table.bad_lines;
+    result["missing"] = missing;
+    return result;
+}
+
+// Wall clock microseconds since the Unix epoch of a naive datetime (its
+// fields as they are, like asyncpg sends TIMESTAMP values)
+int64_t datetime_to_unix_us(const py::handle& value) {
+    int64_t year = value.attr("year").cast<int64_t>();
+    const auto month = value.attr("month").cast<int64_t>();
+    const auto day = value.attr("day").cast<int64_t>();
+    // days_from_civil (Howard Hinnant)
+    year -= month <= 2 ? 1 : 0;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    const int64_t days = era * 146097 + day_of_era - 719468;
+    const int64_t seconds = days * 86400 + value.attr("hour").cast<int64_t>() * 3600 +
+                            value.attr("minute").cast<int64_t>() * 60 + value.attr("second").cast<int64_t>();
+    return seconds * 1000000 + value.attr("microsecond").cast<int64_t>();
+}
+
+// One COPY field from a Python value; None and float NaN are NULL
+void pg_copy_append_value(PgCopyWriter& writer, std::size_t column, const py::handle& value) {
+    if (value.is_none()) {
+        writer.null();
+        return;
+    }
+    switch (writer.spec(column).type) {
+    case PgType::INT8:
+        writer.int8(value.cast<int64_t>());
+        break;
+    case PgType::INT4:
+        writer.int4(value.cast<int32_t>());
+        break;
+    case PgType::BOOL:
+        writer.boolean(PyObject_IsTrue(value.ptr()) == 1);
+        break;
+    case PgType::TEXT:
+        if (py::isinstance<py::str>(value)) {
+            writer.text(value.cast<std::string_view>());
+        } else {
+            writer.text(py::str(value).cast<std::string>());
+        }
+        break;
+    case PgType::NUMERIC:
+        if (py::isinstance<py::float_>(value)) {
+            const auto number = value.cast<double>();
+            if (nan_bits(number)) {
+                writer.null();
+            } else {
+                writer.numeric_double(number);
+            }
+        } else {
+            // int, Decimal or decimal text, exactly
+            writer.numeric_text(py::str(value).cast<std::string>());
+        }
+        break;
+    case PgType::TIMESTAMP:
+        writer.timestamp_us(py::hasattr(value, "year") ? datetime_to_unix_us(value) : value.cast<int64_t>());
+        break;
+    }
+}
+
+// Equal-length columns by name (arrays or sequences); a column missing from
+// the dict is all NULL. Rows are encoded in order and a failed call keeps
+// nothing.
+void pg_copy_append_columns(PgCopyWriter& writer, const py::dict& columns) {
+    std::optional<std::size_t> rows;
+    std::vector<std::optional<py::list>> values(writer.column_count());
+    for (std::size_t i = 0; i < writer.column_count(); ++i) {
+        const PgColumnSpec& spec = writer.spec(i);
+        const py::str name(spec.name);
+        if (!columns.contains(name) || columns[name].is_none()) {
+            continue;
+        }
+        py::object value = columns[name];
+        // NumPy columns are read as Python lists, which keeps one conversion path
+        if (py::isinstance<py::array>(value)) {
+            value = value.attr("tolist")();
+        }
+        const std::size_t size = py::len(value);
+        if (rows && *rows != size) {
+            throw py::value_error("PgCopyWriter.append_columns: column '" + spec.name + "' has " +
+                                  std::to_string(size) + " values, expected " + std::to_string(*rows));
+        }
+        rows = size;
+        values[i] = py::list(value);
+    }
+    if (!rows) {
+        throw py::value_error("PgCopyWriter.append_columns: no column gives the row count");
+    }
+
+    const std::size_t size = writer.size();
+    const std::size_t before = writer.rows();
+    try {
+        for (std::size_t row = 0; row < *rows; ++row) {
+            writer.begin_row();
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                if (values[i]) {
+                    pg_copy_append_value(writer, i, PyList_GET_ITEM(values[i]->ptr(), static_cast<Py_ssize_t>(row)));
+                } else {
+                    writer.null();
+                }
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        writer.truncate(size, before);
+        throw py::value_error(e.what());
+    } catch (...) {
+        writer.truncate(size, before);
+        throw;
+    }
+}
+
+// Per-symbol Python state by symbol ID
+using PySymbolRegistry = SymbolRegistry<py::object>;
+
+SymbolId intern_or_throw(std::string_view symbol) {
+    const SymbolId id = symbol_table().intern(symbol);
+    if (id == INVALID_SYMBOL_ID) {
+        throw std::runtime_error("Symbol table is full");
+    }
+    return id;
+}
+
+// Caller-supplied receive timestamp, or a fresh ingest clock reading
+uint64_t resolve_ingest_us(const std::optional<uint64_t>& ingest_ts_us) {
+    return ingest_ts_us ? *ingest_ts_us : ingest_time_us();
+}
+
+py::dtype tick_column_dtype(TickColumnType type) {
+    switch (type) {
+    case TickColumnType::Int64:
+        return py::dtype::of<int64_t>();
+    case TickColumnType::Float64:
+        return py::dtype::of<double>();
+    case TickColumnType::UInt8:
+        return py::dtype::of<uint8_t>();
+    case TickColumnType::Bool:
+        break;
+    }
+    return py::dtype("bool");
+}
+
+// Indices of the named columns, every column when none are named
+std::vector<std::size_t> tick_column_selection(const TickFileReader& reader,
+                                               const std::optional<std::vector<std::string>>& columns) {
+    std::vector<std::size_t> selection;
+    if (!columns) {
+        for (std::size_t c = 0; c < reader.columns().size(); ++c) {
+            selection.push_back(c);
+        }
+        return selection;
+    }
+    for (const std::string& name : *columns) {
+        selection.push_back(reader.column_index(name));
+    }
+    return selection;
+}
+
+// Every block of the file, each column decoded straight into one array
+py::dict tick_file_read(TickFileReader& reader, const std::optional<std::vector<std::string>>& columns) {
+    const std::vector<std::size_t> selection = tick_column_selection(reader, columns);
+    py::dict result;
+    std::vector<char*> outputs;
+    for (const std::size_t c : selection) {
+        const TickColumnSpec& spec = reader.columns()[c];
+        py::array column(tick_column_dtype(spec.type), {static_cast<py::ssize_t>(reader.rows())});
+        outputs.push_back(static_cast<char*>(column.mutable_data()));
+        result[spec.name] = column;
+    }
+    try {
+        py::gil_scoped_release release;
+        for (std::size_t b = 0; b < reader.blocks(); ++b) {
+            for (std::size_t k = 0; k < selection.size(); ++k) {
+                const std::size_t width = tick_column_width(reader.columns()[selection[k]].type);
+                reader.read_column(b, selection[k], outputs[k]);
+                outputs[k] += reader.block(b).rows * width;
+            }
+        }
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+    return result;
+}
+
+// One block's columns: views of the mapped file for chunks stored RAW,
+// with the TickFile as their base so the mapping outlives them, and
+// decoded arrays for compressed ones
+py::dict tick_block_read(const py::object& self, std::size_t block,
+                         const std::optional<std::vector<std::string>>& columns) {
+    auto& reader = self.cast<TickFileReader&>();
+    if (block >= reader.blocks()) {
+        throw py::index_error("TickFile.read_block: block out of range");
+    }
+    const auto rows = static_cast<py::ssize_t>(reader.block(block).rows);
+    py::dict result;
+    for (const std::size_t c : tick_column_selection(reader, columns)) {
+        const TickColumnSpec& spec = reader.columns()[c];
+        std::span<const char> view;
+        bool raw = false;
+        try {
+            raw = reader.column_view(block, c, view);
+        } catch (const std::runtime_error& e) {
+            throw py::value_error(e.what());
+        }
+        if (raw) {
+            py::array column(tick_column_dtype(spec.type), {rows}, {}, view.data(), self);
+            // The mapping is PROT_READ: a write would fault, not raise
+            column.attr("setflags")(py::arg("write") = false);
+            result[spec.name] = column;
+            continue;
+        }
+        py::array column(tick_column_dtype(spec.type), {rows});
+        try {
+            reader.read_column(block, c, static_cast<char*>(column.mutable_data()));
+        } catch (const std::runtime_error& e) {
+            throw py::value_error(e.what());
+        }
+        result[spec.name] = column;
+    }
+    return result;
+}
+
+py::dict tick_block_info_to_python(const SparseIndexEntry& entry) {
+    py::dict result;
+    result["rows"] = entry.rows;
+    result["bytes"] = entry.size;
+    result["min_ts_us"] = entry.min_ts_us;
+    result["max_ts_us"] = entry.max_ts_us;
+    result["min_id"] = entry.min_id;
+    result["max_id"] = entry.max_id;
+    return result;
+}
+
+SparseKey tick_range_key(const std::string& key) {
+    if (key == "event_time") {
+        return SparseKey::Time;
+    }
+    if (key == "id") {
+        return SparseKey::Id;
+    }
+    throw py::value_error("TickFile: key must be 'event_time' or 'id'");
+}
+
+// Inclusive [start, end] bounds, open where None
+std::pair<int64_t, int64_t> tick_range_bounds(const std::optional<int64_t>& start, const std::optional<int64_t>& end) {
+    return {start.value_or(std::numeric_limits<int64_t>::min()), end.value_or(std::numeric_limits<int64_t>::max())};
+}
+
+// The rows of a time or ID range, decoding only the blocks that overlap it
+py::dict tick_range_read(TickFileReader& reader, const std::optional<int64_t>& start,
+                         const std::optional<int64_t>& end, const std::optional<std::vector<std::string>>& columns,
+                         const std::string& key) {
+    const std::vector<std::size_t> selection = tick_column_selection(reader, columns);
+    const SparseKey range_key = tick_range_key(key);
+    const auto [from, to] = tick_range_bounds(start, end);
+    std::vector<std::vector<char>> values;
+    TickRangeRead read;
+    try {
+        py::gil_scoped_release release;
+        read = reader.read_range(range_key, from, to, selection, values);
+    } catch (const std::runtime_error& e) {
+        throw py::value_error(e.what());
+    }
+    py::dict result;
+    for (std::size_t k = 0; k < selection.size(); ++k) {
+        const TickColumnSpec& spec = reader.columns()[selection[k]];
+        py::array column(tick_column_dtype(spec.type), {static_cast<py::ssize_t>(read.rows)});
+        if (!values[k].empty()) {
+            std::memcpy(column.mutable_data(), values[k].data(), values[k].size());
+        }
+        result[spec.name] = column;
+    }
+    return result;
+}
+
+// Owner of one lent batch buffer, the base of its arrays: the buffer goes
+// back to the pool when the last array is freed, even after the loader
+struct TrainingBatchLease {
+    std::shared_ptr<TrainingBatchPool> pool;
+    std::size_t slot;
+
+    ~TrainingBatchLease() { pool->release(slot); }
+};
+
+py::dict training_batch_to_python(const TrainingLoader& loader, const TrainingBatch& batch) {
+    py::capsule owner(new TrainingBatchLease{loader.pool(), batch.slot},
+                      [](void* lease) { delete static_cast<TrainingBatchLease*>(lease); });
+    const auto rows = static_cast<py::ssize_t>(batch.rows);
+    const auto window = static_cast<py::ssize_t>(loader.config().window);
+    const auto width = static_cast<py::ssize_t>(loader.feature_names().size());
+    py::dict result;
+    result["features"] = py::array_t<float>({rows, window, width}, batch.features, owner);
+    result["labels"] = py::array_t<float>({rows}, batch.labels, owner);
+    result["timestamp_us"] = py::array_t<int64_t>({rows}, batch.timestamps_us, owner);
+    result["symbol"] = py::array_t<uint16_t>({rows}, batch.symbols, owner);
+    return result;
+}
+
+py::dict training_loader_stats_to_python(const TrainingLoader& loader) {
+    const TrainingLoaderStats& stats = loader.stats();
+    py::dict result;
+    result["units"] = stats.units.load();
+    result["steps"] = stats.steps.load();
+    result["trades"] = stats.trades.load();
+    result["quotes"] = stats.quotes.load();
+    result["batches"] = stats.batches.load();
+    result["wait_us"] = stats.wait_us.load();
+    result["stall_us"] = stats.stall_us.load();
+    result["locked"] = loader.pool()->locked();
+    return result;
+}
+
+// {"10s": {forward_price, forward_return, max_up, max_down}, ...} over a
+// sorted timestamp column and a price (or mid) column, without the GIL
+py::dict forward_labels_to_python(const Int64Column& timestamp_us, const FloatColumn& price,
+                                  const std::vector<double>& horizons_seconds) {
+    if (timestamp_us.size() != price.size()) {
+        throw py::value_error("forward_labels: timestamp_us and price must have the same length");
+    }
+    std::vector<int64_t> horizons_us;
+    for (const double seconds : horizons_seconds) {
+        horizons_us.push_back(std::llround(seconds * 1e6));
+    }
+    const int64_t* timestamps = timestamp_us.data();
+    const double* prices = price.data();
+    const auto rows = static_cast<std::size_t>(price.size());
+    std::vector<ForwardLabelColumns> labels;
+    {
+        py::gil_scoped_release release;
+        labels = forward_labels(timestamps, prices, rows, horizons_us);
+    }
+    py::dict result;
+    for (ForwardLabelColumns& columns : labels) {
+        char label[32];
+        std::snprintf(label, sizeof(label), "%gs", static_cast<double>(columns.horizon_us) / 1e6);
+        py::dict horizon;
+        horizon["forward_price"] = column_to_numpy(std::move(columns.forward_price));
+        horizon["forward_return"] = column_to_numpy(std::move(columns.forward_return));
+        horizon["max_up"] = column_to_numpy(std::move(columns.max_up));
+        horizon["max_down"] = column_to_numpy(std::move(columns.max_down));
+        result[label] = horizon;
+    }
+    return result;
+}
+
+// A BookSampler writing into `out`, which must be a float32 (samples, 2,
+// levels, 2) array the sampler can write in place
+std::unique_ptr<BookSampler> make_book_sampler(const std::string& symbol, const py::array& out, double tick_size,
+                                               double interval_seconds, std::optional<int64_t> start_us) {
+    if (!py::isinstance<py::array_t<float, py::array::c_style>>(out) || !out.writeable() || out.ndim() != 4 ||
+        out.shape(1) != 2 || out.shape(3) != 2) {
+        throw py::value_error("BookSampler: out must be a writable C-contiguous float32 array of shape "
+                              "(samples, 2, levels, 2)");
+    }
+    BookSamplerConfig config{symbol, tick_size, std::llround(interval_seconds * 1e6), start_us.value_or(0)};
+    return std::make_unique<BookSampler>(std::move(config), static_cast<float*>(py::array(out).mutable_data()),
+                                         static_cast<std::size_t>(out.shape(0)),
+                                         static_cast<std::size_t>(out.shape(2)));
+}
+
+py::dict book_sampler_stats_to_python(const BookSampler& sampler) {
+    const BookSamplerStats& stats = sampler.stats();
+    py::dict result;
+    result["samples"] = sampler.rows();
+    result["invalid_samples"] = stats.invalid;
+    result["updates"] = stats.updates;
+    result["stale"] = stats.stale;
+    result["gaps"] = stats.gaps;
+    result["snapshots"] = stats.snapshots;
+    return result;
+}
+
+py::dict tick_store_stats_to_python(const TickStoreStats& stats) {
+    py::dict result;
+    result["messages"] = stats.messages;
+    result["rows"] = stats.rows;
+    result["blocks"] = stats.blocks;
+    result["bytes_written"] = stats.bytes_written;
+    result["skipped"] = stats.skipped;
+    result["files_opened"] = stats.files_opened;
+    result["truncated_blocks"] = stats.truncated_blocks;
+    return result;
+}
+
+using DedupSymbolColumn = py::array_t<uint16_t, py::array::c_style | py::array::forcecast>;
+using DedupIdColumn = py::array_t<int64_t, py::array::c_style | py::array::forcecast>;
+
+// Deduplicator.unique_mask for either window
+template <typename Window>
+py::array dedup_unique_mask(Window& window, const DedupSymbolColumn& symbol_id, const DedupIdColumn& record_id,
+                            const std::optional<uint64_t>& now_us) {
+    if (symbol_id.size() != record_id.size()) {
+        throw py::value_error("unique_mask: symbol_id and record_id must have the same length");
+    }
+    const uint64_t now = resolve_ingest_us(now_us);
+    const uint16_t* symbols = symbol_id.data();
+    const int64_t* ids = record_id.data();
+    std::vector<uint8_t> mask(static_cast<std::size_t>(record_id.size()));
+    for (std::size_t i = 0; i < mask.size(); ++i) {
+        mask[i] = window.check(symbols[i], static_cast<uint64_t>(ids[i]), now) ? 1 : 0;
+    }
+    return flags_to_numpy(std::move(mask));
+}
+
+// SBEDecoder.view result: a MessageView plus the buffer export that pins
+// the viewed bytes (and keeps a bytearray from being resized) for as long
+// as the Python object lives
+class PinnedMessageView {
+public:
+    explicit PinnedMessageView(const py::buffer& data)
+        : buffer_(data), view_(buffer_.payload().data(), buffer_.payload().size()) {}
+
+    const MessageView& view() const {
+        return view_;
+    }
+
+private:
+    FrameBuffer buffer_;
+    MessageView view_;
+};
+
+std::optional<uint64_t> optional_millis(const std::optional<uint64_t>& micros) {
+    return micros ? std::optional<uint64_t>(micros_to_millis(*micros)) : std::nullopt;
+}
+
+bool as_bool(const BoolEnum::Value bool_enum) {
+    switch (bool_enum) {
+        case BoolEnum::Value::False: 
+            return false;
+        case BoolEnum::Value::True: 
+            return true;
+        case BoolEnum::Value::NULL_VALUE:
+            return false;
+    }
+    return false;
+}
+
+// A trace block as the list that travels in the record's "trace" field
+py::list trace_to_list(const TraceStamps& stamps) {
+    py::list out(TRACE_STAGE_COUNT);
+    for (std::size_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+        out[i] = py::int_(stamps.us[i]);
+    }
+    return out;
+}
+
+// The list back; None, zero or negative stamps count as not stamped
+TraceStamps trace_from_python(const py::sequence& trace) {
+    if (trace.size() != TRACE_STAGE_COUNT) {
+        throw py::value_error("trace: expected " + std::to_string(TRACE_STAGE_COUNT) + " stamps, got " +
+                              std::to_string(trace.size()));
+    }
+    TraceStamps stamps;
+    for (std::size_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+        const py::object stamp = trace[i];
+        if (!stamp.is_none()) {
+            stamps.us[i] = static_cast<uint64_t>(std::max<int64_t>(stamp.cast<int64_t>(), 0));
+        }
+    }
+    return stamps;
+}
+
+py::dict trace_collector_summary(const TraceCollector& collector) {
+    py::dict stages;
+    for (std::size_t stage = TRACE_RECEIVE; stage < TRACE_STAGE_COUNT; ++stage) {
+        stages[TRACE_STAGE_NAMES[stage]] = trace_hop_summary(collector.hop(static_cast<TraceStage>(stage)));
+    }
+    py::dict result;
+    result["stages"] = stages;
+    result["total"] = trace_hop_summary(collector.total());
+    result["traces"] = collector.traces();
+    result["skewed"] = collector.skewed();
+    return result;
+}
+
+BarKind bar_kind_from_name(const std::string& kind) {
+    if (kind == "time") {
+        return BarKind::Time;
+    }
+    if (kind == "tick") {
+        return BarKind::Tick;
+    }
+    if (kind == "volume") {
+        return BarKind::Volume;
+    }
+    if (kind == "dollar") {
+        return BarKind::Dollar;
+    }
+    throw py::value_error("BarBuilder: kind must be 'time', 'tick', 'volume' or 'dollar'");
+}
+
+// add() each row of a decode_batch trades table. `symbol` is one name for
+// the whole batch, or the table's 'S16' symbol column.
+void add_bar_trades(BarBuilder& builder, const OffsetsArray& trade_time, const FloatColumn& price,
+                    const FloatColumn& qty, const FlagColumn& is_buyer_maker, const py::object& symbol,
+                    const std::optional<Int64Column>& trade_id) {
+    const auto count = trade_time.size();
+    if (price.size() != count || qty.size() != count || is_buyer_maker.size() != count ||
+        (trade_id && trade_id->size() != count)) {
+        throw py::value_error("add_batch: columns must have the same length");
+    }
+    SymbolId batch_symbol = INVALID_SYMBOL_ID;
+    py::array symbols;
+    const char* cells = nullptr;
+    std::size_t width = 0;
+    if (py::isinstance<py::str>(symbol) || py::isinstance<py::bytes>(symbol)) {
+        batch_symbol = intern_or_throw(symbol.cast<std::string>());
+    } else {
+        symbols = py::array::ensure(symbol, py::array::c_style);
+        if (!symbols || symbols.dtype().kind() != 'S' || symbols.ndim() != 1 || symbols.size() != count) {
+            throw py::value_error("add_batch: symbol must be a str or a bytes column as long as the others");
+        }
+        cells = static_cast<const char*>(symbols.data());
+        width = static_cast<std::size_t>(symbols.itemsize());
+    }
+    const int64_t* ts = trade_time.data();
+    const double* prices = price.data();
+    const double* qtys = qty.data();
+    const bool* makers = is_buyer_maker.data();
+    const int64_t* ids = trade_id ? trade_id->data() : nullptr;
+    // Consecutive rows mostly share a symbol; intern only on a change
+    std::string_view last_name;
+    for (py::ssize_t i = 0; i < count; ++i) {
+        if (cells != nullptr) {
+            const char* cell = cells + static_cast<std::size_t>(i) * width;
+            const std::string_view name(cell, strnlen(cell, width));
+            if (batch_symbol == INVALID_SYMBOL_ID || name != last_name) {
+                batch_symbol = intern_or_throw(name);
+                last_name = name;
+            }
+        }
+        builder.add(batch_symbol, ts[i], ids != nullptr ? ids[i] : 0, prices[i], qtys[i], makers[i]);
+    }
+}
+
+template <typename Table>
+py::object bars_to_table(BarColumns&& bars) {
+    Table table;
+    table.symbols("symbol", std::move(bars.symbol));
+    table.column("symbol_id", std::move(bars.symbol_id));
+    table.column("open_time", std::move(bars.open_time));
+    table.column("close_time", std::move(bars.close_time));
+    table.column("first_trade_id", std::move(bars.first_trade_id));
+    table.column("last_trade_id", std::move(bars.last_trade_id));
+    table.column("open", std::move(bars.open));
+    table.column("high", std::move(bars.high));
+    table.column("low", std::move(bars.low));
+    table.column("close", std::move(bars.close));
+    table.column("volume", std::move(bars.volume));
+    table.column("quote_volume", std::move(bars.quote_volume));
+    table.column("vwap", std::move(bars.vwap));
+    table.column("trades", std::move(bars.trades));
+    table.column("buy_volume", std::move(bars.buy_volume));
+    table.column("sell_volume", std::move(bars.sell_volume));
+    return table.finish();
+}
+
+// A scaled klines table (decode_batch's 'klines', or klines_from_trades) as
+// a KlineView; `keep` holds the converted columns the view points into
+KlineView kline_table_view(const py::dict& table, std::vector<py::array>& keep, const char* what) {
+    if (table.contains("price_exponent")) {
+        throw py::value_error(std::string("diff_klines: ") + what + " must be decoded without raw_mantissa");
+    }
+    auto floats = [&](const char* name) {
+        FloatColumn column = table[name].cast<FloatColumn>();
+        keep.push_back(column);
+        return std::span<const double>(column.data(), static_cast<std::size_t>(column.size()));
+    };
+    auto ints = [&](const char* name) {
+        Int64Column column = table[name].cast<Int64Column>();
+        keep.push_back(column);
+        return std::span<const int64_t>(column.data(), static_cast<std::size_t>(column.size()));
+    };
+    const KlineView view{ints("open_time"), floats("open"),   floats("high"),         floats("low"),
+                         floats("close"),   floats("volume"), floats("quote_volume"), ints("num_trades")};
+    const std::size_t rows = view.size();
+    if (view.open.size() != rows || view.high.size() != rows || view.low.size() != rows ||
+        view.close.size() != rows || view.volume.size() != rows || view.quote_volume.size() != rows ||
+        view.num_trades.size() != rows) {
+        throw py::value_error(std::string("diff_klines: ") + what + " columns must have the same length");
+    }
+    return view;
+}
+
+py::dict kline_diff_to_python(const KlineDiffSummary& summary, KlineDiffColumns&& rows) {
+    py::dict table;
+    table["open_time"] = column_to_numpy(std::move(rows.open_time));
+    table["mismatch"] = column_to_numpy(std::move(rows.mismatch));
+    table["built_volume"] = column_to_numpy(std::move(rows.built_volume));
+    table["rest_volume"] = column_to_numpy(std::move(rows.rest_volume));
+    table["built_num_trades"] = column_to_numpy(std::move(rows.built_num_trades));
+    table["rest_num_trades"] = column_to_numpy(std::move(rows.rest_num_trades));
+    py::dict result;
+    result["compared"] = summary.compared;
+    result["matched"] = summary.matched;
+    result["mismatched"] = summary.mismatched;
+    result["missing_built"] = summary.missing_built;
+    result["missing_rest"] = summary.missing_rest;
+    result["rows"] = table;
+    return result;
+}
+
+const LogFormat DECODER_REJECTED_LOG{LogLevel::Warning, "decoder",
+                                     "rejected a frame ({}): template {}, {} bytes, cause {}"};
+
+// Main SBE decoder class
+class SBEDecoder {
+public:
+    // debug=true adds the debug_* troubleshooting fields to decode_message
+    // results; the default instance never computes them.
+    // level_arrays=true returns depth levels as (n, 2) NumPy views into a
+    // per-decoder arena instead of building a list per level.
+    // decimal_strings=true returns depth levels as [price, qty] strings
+    // formatted exactly from the SBE mantissas (the DepthDelta form).
+    // trace=true adds the trace block (trace_stamps.h) to every result.
+    // stream_msg_types=true names stream frames by the stream they arrive
+    // on ("trade", "bestBidAsk", "depth", "depth@100ms"), the msg_type the
+    // ingestor publishes, instead of by template.
+    explicit SBEDecoder(bool debug = false, bool level_arrays = false, bool decimal_strings = false,
+                        bool alloc_accounting = false, uint32_t perf_sample_every = 0, bool trace = false,
+                        bool stream_msg_types = false)
+        : debug_(debug), level_arrays_(level_arrays), decimal_strings_(decimal_strings),
+          alloc_accounting_(alloc_accounting), trace_(trace), stream_msg_types_(stream_msg_types),
+          perf_sample_every_(perf_sample_every),
+          perf_countdown_(perf_sample_every) {
+        if (level_arrays && decimal_strings) {
+            throw py::value_error("level_arrays and decimal_strings are mutually exclusive");
+        }
+        if (alloc_accounting) {
+            py_alloc_hook::install();
+            stats_.set_alloc_accounting(true);
+        }
+        metrics_.publish([this](MetricsWriter& out) { write_decode_metrics(out, stats_, metrics_.instance()); });
+    }
+
+    bool debug() const {
+        return debug_;
+    }
+
+    bool level_arrays() const {
+        return level_arrays_;
+    }
+
+    bool decimal_strings() const {
+        return decimal_strings_;
+    }
+
+    bool alloc_accounting() const {
+        return alloc_accounting_;
+    }
+
+    uint32_t perf_sample_every() const {
+        return perf_sample_every_;
+    }
+
+    bool trace() const {
+        return trace_;
+    }
+
+    bool stream_msg_types() const {
+        return stream_msg_types_;
+    }
+
+    // Keep raw frames per `config` (frame_capture.h), replacing what was
+    // kept; a config that keeps none turns capture off
+    void capture_frames(const FrameCaptureConfig& config) {
+        std::lock_guard lock(lock_);
+        capture_ = config.enabled() ? std::make_unique<FrameCapture>(config) : nullptr;
+    }
+
+    // The captured frames by ring, oldest first, each with its leading
+    // bytes as hex; None while capture is off
+    py::object captured_frames(bool clear) {
+        std::lock_guard lock(lock_);
+        if (!capture_) {
+            return py::none();
+        }
+        const auto frames = [](const CaptureRing& ring) {
+            py::list out;
+            ring.for_each([&](const CapturedFrame& frame) {
+                py::dict entry;
+                entry["seq"] = frame.seq;
+                entry["received_us"] = frame.received_us;
+                entry["size"] = frame.size;
+                if (frame.bytes.size() >= MessageHeader::encodedLength()) {
+                    entry["template_id"] =
+                        MessageHeader(const_cast<char*>(frame.bytes.data()), frame.bytes.size()).templateId();
+                } else {
+                    entry["template_id"] = py::none();
+                }
+                entry["status"] = DECODE_STATUS_NAMES[static_cast<std::size_t>(frame.status)];
+                entry["cause"] = parse_error_name(frame.cause);
+                entry["hex"] = frame_hex(frame.bytes);
+                entry["truncated"] = frame.bytes.size() < frame.size;
+                out.append(entry);
+            });
+            return out;
+        };
+        py::dict result;
+        result["seen"] = capture_->seen();
+        result["recent"] = frames(capture_->recent());
+        result["sampled"] = frames(capture_->sampled());
+        result["failed"] = frames(capture_->failed());
+        if (clear) {
+            capture_->clear();
+        }
+        return result;
+    }
+
+    py::dict arena_stats() {
+        std::lock_guard lock(lock_);
+        py::dict stats;
+        stats["blocks_allocated"] = level_arena_.blocks_allocated();
+        stats["used"] = level_arena_.used();
+        stats["capacity"] = level_arena_.capacity();
+        return stats;
+    }
+
+    // Per-template counts and decode-time percentiles of decode_message and
+    // try_decode, plus the frames rejected before a template decoder ran
+    py::dict get_stats() const {
+        const double ns_per_tick = decode_clock_ns_per_tick();
+        const auto to_ns = [&](uint64_t ticks) { return static_cast<double>(ticks) * ns_per_tick; };
+        py::dict templates;
+        stats_.for_each([&](uint16_t template_id, const TemplateDecodeStats& stats) {
+            const LatencyHistogram::Summary latency = stats.latency.summary();
+            py::dict entry;
+            entry["messages"] = stats.messages.load(std::memory_order_relaxed);
+            entry["bytes"] = stats.bytes.load(std::memory_order_relaxed);
+            entry["parse_errors"] = stats.parse_errors.load(std::memory_order_relaxed);
+            py::dict causes;
+            for (std::size_t cause = 1; cause < PARSE_ERROR_COUNT; ++cause) {
+                if (const uint64_t count = stats.parse_error_causes[cause].load(std::memory_order_relaxed)) {
+                    causes[PARSE_ERROR_NAMES[cause]] = count;
+                }
+            }
+            entry["parse_error_causes"] = causes;
+            entry["p50_ns"] = to_ns(latency.p50);
+            entry["p99_ns"] = to_ns(latency.p99);
+            entry["p999_ns"] = to_ns(latency.p999);
+            entry["max_ns"] = to_ns(latency.max);
+            entry["mean_ns"] = latency.count == 0 ? 0.0 : to_ns(latency.sum) / static_cast<double>(latency.count);
+            if (alloc_accounting_) {
+                entry["allocations"] = stats.allocations.load(std::memory_order_relaxed);
+                entry["alloc_bytes"] = stats.alloc_bytes.load(std::memory_order_relaxed);
+                entry["py_allocations"] = stats.py_allocations.load(std::memory_order_relaxed);
+            }
+            if (const uint64_t samples = stats.perf_samples.load(std::memory_order_relaxed); samples != 0) {
+                // Per sampled message; counters the CPU does not offer are left out
+                entry["perf_samples"] = samples;
+                std::array<double, PERF_EVENT_COUNT> per_msg{};
+                for (std::size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+                    per_msg[i] = static_cast<double>(stats.perf[i].load(std::memory_order_relaxed)) /
+                                 static_cast<double>(samples);
+                    if (perf_.has(static_cast<PerfEvent>(i))) {
+                        entry[py::str(std::string(PERF_EVENT_NAMES[i]) + "_per_msg")] = per_msg[i];
+                    }
+                }
+                entry["ipc"] = per_msg[PERF_CYCLES] > 0 ? per_msg[PERF_INSTRUCTIONS] / per_msg[PERF_CYCLES] : 0.0;
+            }
+            templates[py::int_(template_id)] = entry;
+        });
+
+        py::dict result;
+        result["templates"] = templates;
+        result["too_short"] = stats_.too_short_count();
+        result["schema_mismatch"] = stats_.schema_mismatch_count();
+        result["unknown_template"] = stats_.unknown_template_count();
+        result["untracked"] = stats_.untracked_count();
+        result["clock"] = decode_clock_name();
+        result["alloc_accounting"] = alloc_accounting_;
+        if (perf_sample_every_ != 0) {
+            py::dict perf;
+            perf["sample_every"] = perf_sample_every_;
+            perf["open"] = perf_.is_open();
+            if (!perf_.error().empty()) {
+                perf["error"] = perf_.error();
+            }
+            result["perf"] = perf;
+        }
+        return result;
+    }
+
+    void reset_stats() {
+        std::lock_guard lock(lock_);
+        stats_.reset();
+    }
+    
+    // Main decode function (follows official main.cpp patterns)
+    py::object decode_message(const py::buffer& data) {
+        FrameBuffer frame{data};
+        auto payload = frame.payload();
+        std::unique_lock lock(lock_);
+        if (debug_) {
+            return decode_message_as<DiagnosticMode>(data, payload, lock);
+        }
+        return decode_message_as<ProductionMode>(data, payload, lock);
+    }
+    
+    // Get message template ID
+    uint16_t get_message_type(const py::buffer& data) {
+        FrameBuffer frame{data};
+        auto payload = frame.payload();
+        MessageHeader message_header{payload.data(), payload.size()};
+        return message_header.templateId();
+    }
+    
+    // Decode many frames in one call. `frames` is either an iterable of
+    // bytes-like objects, or one contiguous buffer with `offsets` holding the
+    // n + 1 frame boundaries (or none). Each buffer or slice may hold several
+    // SBE messages back to back; every message is decoded and frame_index
+    // counts messages, not buffers. Parsing runs with the GIL released and results
+    // come back as per-template NumPy columns rather than one dict per frame.
+    // With raw=True prices and quantities stay int64 mantissas and each table
+    // gains price_exponent/qty_exponent columns. `ingest_ts_us` stamps the
+    // batch with the caller's receive time instead of a fresh clock read.
+    // format="arrow" returns each table as an ArrowBatch (Arrow C Data
+    // Interface) over the same column buffers. Frames a `subscription`
+    // rejects are skipped undecoded and counted in "filtered".
+    py::dict decode_batch(const py::object& frames,
+                          const std::optional<py::array_t<int64_t, py::array::c_style | py::array::forcecast>>& offsets,
+                          bool raw, const std::optional<uint64_t>& ingest_ts_us, const std::string& format,
+                          const SubscriptionMask* subscription) {
+        const bool arrow = arrow_format_from_name(format, "decode_batch");
+        FrameBufferList buffers{true};
+        collect_frames(buffers, frames, offsets);
+
+        BatchColumns batch;
+        {
+            py::gil_scoped_release release;
+            decode_frames(buffers.frames(), batch, DecodeOptions{raw, ingest_ts_us.value_or(0), subscription});
+        }
+        const uint64_t filtered = batch.filtered_frames;
+        py::dict result = batch_to_python(std::move(batch), arrow);
+        if (subscription != nullptr) {
+            result["filtered"] = filtered;
+        }
+        return result;
+    }
+    
+    // Serialize frames straight into Kinesis records in `out`, a writable
+    // buffer, without building dicts: compact JSON, or single-object Avro
+    // with format="avro". Stops before the first frame
+    // that does not fit or would pass `max_records` (PutRecords takes 500),
+    // so the caller can send what was written and call again with the rest.
+    // With a compressor, depth records (every record with compress_all)
+    // are zstd-compressed behind a codec header; with a depth_delta
+    // encoder, depth frames become delta-encoded top-N records.
+    py::dict serialize_records(const py::object& frames, const py::buffer& out,
+                               const std::optional<OffsetsArray>& offsets,
+                               const std::optional<uint64_t>& ingest_ts_us, std::size_t max_records,
+                               const std::string& format, RecordCompressor* compressor, bool compress_all,
+                               DepthDeltaEncoder* depth_delta) {
+        RecordOptions options;
+        options.format = record_format_from_name(format, "serialize_records");
+        options.ingest_us = resolve_ingest_us(ingest_ts_us);
+        options.max_records = max_records;
+        options.compressor = compressor;
+        options.compress_all = compress_all;
+        options.depth_delta = depth_delta;
+
+        FrameBufferList buffers;
+        collect_frames(buffers, frames, offsets);
+        FrameBuffer target{out, PyBUF_WRITABLE};
+
+        RecordBatch batch;
+        std::size_t consumed = 0;
+        {
+            py::gil_scoped_release release;
+            consumed = serialize_frames(buffers.frames(), options, target.payload(), batch);
+        }
+        if (consumed == 0 && !buffers.frames().empty() && max_records > 0) {
+            throw py::value_error("serialize_records: first frame does not fit in the output buffer or max_records");
+        }
+        return record_batch_to_python(std::move(batch), consumed);
+    }
+
+    // Lazy view of a frame: only the header and fixed block are checked
+    // here, each field is read from the pinned bytes when accessed
+    std::unique_ptr<PinnedMessageView> view(const py::buffer& data) const {
+        return std::make_unique<PinnedMessageView>(data);
+    }
+
+    // Decode into a typed event (TradeEvent, BestBidAskEvent or
+    // DepthDiffEvent). Returns None for templates without a typed event;
+    // malformed frames raise RuntimeError.
+    py::object decode_event(const py::buffer& data, const std::optional<uint64_t>& ingest_ts_us) {
+        FrameBuffer frame{data};
+        auto payload = frame.payload();
+        MessageHeader message_header{payload.data(), payload.size()};
+        const char* body = payload.data() + MessageHeader::encodedLength();
+        const size_t body_size = payload.size() - MessageHeader::encodedLength();
+
+        switch (message_header.templateId()) {
+        case TRADES_STREAM_EVENT: {
+            TradeFrame trade;
+            if (const auto error = parse_trade_frame(body, body_size, message_header.blockLength(), trade);
+                error != ParseError::None) {
+                throw_parse_error(error, "trade");
+            }
+            return py::cast(make_trade_event(trade, resolve_ingest_us(ingest_ts_us)));
+        }
+        case BEST_BID_ASK_STREAM_EVENT: {
+            BestBidAskFrame bba;
+            if (const auto error = parse_best_bid_ask_frame(body, body_size, message_header.blockLength(), bba);
+                error != ParseError::None) {
+                throw_parse_error(error, "best bid/ask");
+            }
+            return py::cast(make_best_bid_ask_event(bba, resolve_ingest_us(ingest_ts_us)));
+        }
+        case DEPTH_DIFF_STREAM_EVENT: {
+            DepthDiffFrame depth;
+            if (const auto error = parse_depth_diff_frame(body, body_size, message_header.blockLength(), depth);
+                error != ParseError::None) {
+                throw_parse_error(error, "depth");
+            }
+            return py::cast(make_depth_diff_event(body, depth, resolve_ingest_us(ingest_ts_us)));
+        }
+        default:
+            return py::none();
+        }
+    }
+
+    // Decode every entry of a template 10000 trades group as NumPy columns,
+    // so one frame can drive one vectorized append downstream
+    py::dict decode_trades(const py::buffer& data) {
+        FrameBuffer frame{data};
+        auto payload = frame.payload();
+        MessageHeader message_header{payload.data(), payload.size()};
+        if (message_header.templateId() != TRADES_STREAM_EVENT) {
+            throw py::value_error("decode_trades: expected template " + std::to_string(TRADES_STREAM_EVENT) +
+                                  ", got " + std::to_string(message_header.templateId()));
+        }
+
+        const char* body = payload.data() + MessageHeader::encodedLength();
+        const size_t body_size = payload.size() - MessageHeader::encodedLength();
+        TradeFrame trade;
+        if (const auto error = parse_trade_frame(body, body_size, message_header.blockLength(), trade);
+            error != ParseError::None) {
+            throw_parse_error(error, "trade");
+        }
+
+        std::vector<int64_t> trade_ids, price_mantissas, qty_mantissas;
+        std::vector<double> prices, qtys;
+        std::vector<uint8_t> buyer_maker;
+        trade_ids.reserve(trade.num_in_group);
+        price_mantissas.reserve(trade.num_in_group);
+        qty_mantissas.reserve(trade.num_in_group);
+        prices.reserve(trade.num_in_group);
+        qtys.reserve(trade.num_in_group);
+        buyer_maker.reserve(trade.num_in_group);
+        for_each_trade_entry(body, body_size, trade, [&](const TradeEntry& entry) {
+            trade_ids.push_back(static_cast<int64_t>(entry.trade_id));
+            price_mantissas.push_back(entry.price_mantissa);
+            qty_mantissas.push_back(entry.qty_mantissa);
+            prices.push_back(decode_decimal(entry.price_mantissa, trade.price_exponent));
+            qtys.push_back(decode_decimal(entry.qty_mantissa, trade.qty_exponent));
+            buyer_maker.push_back(entry.is_buyer_maker ? 1 : 0);
+        });
+
+        const ResultKeys& keys = result_keys();
+        py::dict result;
+        set_item(result, keys.msg_type, "trade");
+        set_item(result, keys.source, keys.sbe);
+        set_item(result, keys.symbol, symbol_str(trade.symbol));
+        set_item(result, keys.event_ts, micros_to_millis(trade.event_time_us));
+        set_item(result, keys.trade_time, micros_to_millis(trade.trade_time_us));
+        const uint64_t ingest_us = ingest_time_us();
+        set_item(result, keys.ingest_ts, micros_to_millis(ingest_us));
+        set_item(result, keys.ingest_ts_us, ingest_us);
+        set_item(result, keys.price_exponent, static_cast<int>(trade.price_exponent));
+        set_item(result, keys.qty_exponent, static_cast<int>(trade.qty_exponent));
+        set_item(result, keys.trade_id, column_to_numpy(std::move(trade_ids)));
+        set_item(result, keys.price, column_to_numpy(std::move(prices)));
+        set_item(result, keys.qty, column_to_numpy(std::move(qtys)));
+        set_item(result, keys.price_mantissa, column_to_numpy(std::move(price_mantissas)));
+        set_item(result, keys.qty_mantissa, column_to_numpy(std::move(qty_mantissas)));
+        set_item(result, keys.is_buyer_maker, flags_to_numpy(std::move(buyer_maker)));
+        return result;
+    }
+    
+    // Validate, dispatch and decode in one pass over the header. Returns the
+    // same dict as decode_message, or a DecodeStatus when the frame is too
+    // short, from another schema, of an unknown template or malformed.
+    py::object try_decode(const py::buffer& data, const std::optional<uint64_t>& ingest_ts_us) {
+        FrameBuffer frame{data};
+        auto payload = frame.payload();
+        std::unique_lock lock(lock_);
+        if (payload.size() < MessageHeader::encodedLength()) {
+            stats_.too_short();
+            note_rejected(payload, ingest_ts_us, DecodeStatus::TooShort, ParseError::ShortHeader);
+            return py::cast(DecodeStatus::TooShort);
+        }
+        MessageHeader message_header{payload.data(), payload.size()};
+        if (message_header.schemaId() != EXPECTED_SCHEMA_ID) {
+            stats_.schema_mismatch();
+            note_rejected(payload, ingest_ts_us, DecodeStatus::SchemaMismatch);
+            return py::cast(DecodeStatus::SchemaMismatch);
+        }
+        if (debug_) {
+            return try_decode_as<DiagnosticMode>(data, payload, message_header, resolve_ingest_us(ingest_ts_us),
+                                                 lock);
+        }
+        return try_decode_as<ProductionMode>(data, payload, message_header, resolve_ingest_us(ingest_ts_us), lock);
+    }
+
+    // Route `template_id` frames without a native decoder to `decoder`,
+    // called with the original buffer; its return value is the result
+    void register_decoder(uint16_t template_id, py::function decoder) {
+        std::lock_guard lock(lock_);
+        python_decoders_[template_id] = std::move(decoder);
+    }
+
+    // Template IDs with a native decoder
+    static std::vector<uint16_t> supported_templates() {
+        std::vector<uint16_t> templates;
+        message_table<ProductionMode>().for_each([&](uint16_t template_id, const MessageDecoder&) {
+            templates.push_back(template_id);
+        });
+        return templates;
+    }
+
+    // Validate message format
+    bool is_valid_message(const py::buffer& data) {
         try {
-            // Template 10003 depth with blockLength=26, various payload sizes
-            // Raw: 1a00132701000000baa07fda784006004feb96081200000091eb960812000000
-            
-            // Event timestamp (8 bytes) - microseconds since epoch
-            if (offset + 8 <= data_size) {
-                uint64_t event_time = *reinterpret_cast<const uint64_t*>(data + offset);
-                result["event_ts"] = micros_to_millis(event_time);
-                offset += 8;
+            FrameBuffer frame{data};
+            auto payload = frame.payload();
+            if (payload.size() < sizeof(MessageHeader)) {
+                return false;
             }
             
-            // First update ID (8 bytes)
-            if (offset + 8 <= data_size) {
-                uint64_t first_update_id = *reinterpret_cast<const uint64_t*>(data + offset);
-                result["first_update_id"] = static_cast<unsigned long long>(first_update_id);
-                offset += 8;
-            }
+            MessageHeader message_header{payload.data(), payload.size()};
             
-            // Final update ID (8 bytes)  
-            if (offset + 8 <= data_size) {
-                uint64_t final_update_id = *reinterpret_cast<const uint64_t*>(data + offset);
-                result["final_update_id"] = static_cast<unsigned long long>(final_update_id);
-                offset += 8;
+            // For stream data, accept any schema but validate basic structure
+            auto template_id = message_header.templateId();
+            return template_id == TRADES_STREAM_EVENT || 
+                   template_id == BEST_BID_ASK_STREAM_EVENT ||
+                   template_id == DEPTH_DIFF_STREAM_EVENT ||
+                   template_id > 0; // Accept any valid template ID
+        } catch (...) {
+            return false;
+        }
+    }
+
+private:
+    bool debug_ = false;
+    bool level_arrays_ = false;
+    bool decimal_strings_ = false;
+    bool alloc_accounting_ = false;
+    bool trace_ = false;
+    bool stream_msg_types_ = false;
+    // Hardware counters around every perf_sample_every_-th frame (0 = off),
+    // opened on the thread of the first sampled frame
+    uint32_t perf_sample_every_ = 0;
+    uint32_t perf_countdown_ = 0;
+    bool perf_opened_ = false;
+    // Held by the calls below that use the arena, shapes, perf sampling,
+    // Python decoders or write stats_; no-op with the GIL
+    InstanceLock lock_;
+    PerfCounters perf_;
+    LevelArena level_arena_;
+    DecodeStats stats_;
+    // Learned dict shapes of decode_message / try_decode results
+    ResultShapes result_shapes_;
+    // Raw frames kept for troubleshooting; null while capture is off
+    std::unique_ptr<FrameCapture> capture_;
+
+    // Every decoded or rejected frame: rejects are logged, and all are
+    // captured while capture is on
+    void note_frame(std::span<const char> payload, uint64_t ingest_us, DecodeStatus status,
+                    ParseError cause = ParseError::None) {
+        if (status != DecodeStatus::Ok) [[unlikely]] {
+            log_rejected(payload, status, cause);
+        }
+        if (capture_) [[unlikely]] {
+            capture_->record(payload, ingest_us, status, cause);
+        }
+    }
+
+    // A frame rejected before its ingest time was resolved; only resolved
+    // when captured
+    void note_rejected(std::span<const char> payload, const std::optional<uint64_t>& ingest_ts_us,
+                       DecodeStatus status, ParseError cause = ParseError::None) {
+        log_rejected(payload, status, cause);
+        if (capture_) [[unlikely]] {
+            capture_->record(payload, resolve_ingest_us(ingest_ts_us), status, cause);
+        }
+    }
+
+    static void log_rejected(std::span<const char> payload, DecodeStatus status, ParseError cause) {
+        const int template_id = payload.size() >= MessageHeader::encodedLength()
+                                    ? MessageHeader(const_cast<char*>(payload.data()), payload.size()).templateId()
+                                    : -1;
+        native_log(DECODER_REJECTED_LOG, DECODE_STATUS_NAMES[static_cast<std::size_t>(status)], template_id,
+                   payload.size(), parse_error_name(cause));
+    }
+
+    // Arena for the next message's levels, rewound first if no view from
+    // earlier messages is still alive
+    LevelArena* level_arena() {
+        if (!level_arrays_) {
+            return nullptr;
+        }
+        level_arena_.reset();
+        return &level_arena_;
+    }
+
+    // This thread's allocation totals when accounting, else zeros; a frame's
+    // allocations are the difference across its decode
+    AllocCounts alloc_counts() const {
+        return alloc_accounting_ ? thread_alloc_counts() : AllocCounts{};
+    }
+
+    // Start of a hardware counter sample if this frame is due one and the
+    // counters count this thread
+    bool perf_sample_start(PerfReading& start) {
+        if (perf_sample_every_ == 0 || --perf_countdown_ != 0) {
+            return false;
+        }
+        perf_countdown_ = perf_sample_every_;
+        if (!perf_opened_) {
+            perf_opened_ = true;
+            perf_.open();
+        }
+        return perf_.on_this_thread() && perf_.read(start);
+    }
+
+    void perf_sample_end(uint16_t template_id, const PerfReading& start) {
+        PerfReading end;
+        PerfReading delta;
+        if (perf_.read(end) && perf_delta(start, end, delta)) {
+            stats_.record_perf(template_id, delta);
+        }
+    }
+
+    // The trace block of a frame just decoded: its event time (stream
+    // templates only, on the local clock once exchange_clock() is synced),
+    // receive time and now as decode done
+    void add_trace(py::dict& result, const FrameView& frame) const {
+        TraceStamps stamps;
+        switch (frame.header.templateId()) {
+        case TRADES_STREAM_EVENT:
+        case BEST_BID_ASK_STREAM_EVENT:
+        case DEPTH_DIFF_STREAM_EVENT:
+        case DEPTH_SNAPSHOT_STREAM_EVENT:
+            if (const uint64_t event_us = trace_event_time_us(frame.body, frame.body_size)) {
+                stamps.us[TRACE_EVENT] = exchange_clock().to_local_us(event_us);
             }
-            
-            // Skip any remaining fixed block bytes (blockLength=26, we've read 24)
-            if (offset + 2 <= data_size && offset < message_header.blockLength()) {
-                offset += 2;
+            break;
+        default:
+            break;
+        }
+        stamps.us[TRACE_RECEIVE] = frame.ingest_us;
+        stamps.us[TRACE_DECODE] = ingest_time_us();
+        set_item(result, result_keys().trace, trace_to_list(stamps));
+    }
+
+    const char* msg_type_of(const MessageDecoder& decoder) const {
+        return stream_msg_types_ && decoder.stream_type != nullptr ? decoder.stream_type : decoder.msg_type;
+    }
+
+    // decode_message's result for a frame that failed with `error`: the
+    // template's PARSE_ERROR placeholders and the cause under parse_error
+    [[gnu::cold]] py::dict parse_error_result(const MessageDecoder& decoder, uint16_t template_id, ParseError error,
+                                              uint64_t ingest_us) {
+        py::dict result = result_shapes_.restart(template_id, msg_type_of(decoder), ingest_us);
+        if (decoder.fill_error != nullptr) {
+            decoder.fill_error(result, ingest_us);
+        } else {
+            fill_parse_error(result, ingest_us);
+        }
+        set_item(result, result_keys().parse_error, parse_error_str(error));
+        return result;
+    }
+
+    // Frames whose template has no native decoder go to a Python decoder
+    // registered for it, if any
+    std::unordered_map<uint16_t, py::function> python_decoders_;
+    // Exports stats_ on the metrics server's thread; keep last
+    MetricsRegistration metrics_;
+
+    template <typename Mode>
+    py::object decode_message_as(const py::buffer& data, const std::span<char> payload,
+                                 std::unique_lock<InstanceLock>& lock) {
+        // Use official MessageHeader parsing
+        const AllocCounts start_allocs = alloc_counts();
+        PerfReading perf_start;
+        const bool perf_sampled = perf_sample_start(perf_start);
+        const uint64_t start_ticks = decode_clock_ticks();
+        MessageHeader message_header{payload.data(), payload.size()};
+        const uint64_t ingest_us = ingest_time_us();
+
+        // Validate schema (optional for stream data)
+        if (message_header.schemaId() != EXPECTED_SCHEMA_ID) {
+            // For stream data, we might be more lenient
+            // throw std::runtime_error("Unexpected schema ID: " + std::to_string(schema_id));
+        }
+
+        const MessageDecoder* decoder = message_table<Mode>().find(message_header.templateId());
+        if (decoder == nullptr) {
+            if (py::function python = find_python_decoder(message_header.templateId())) {
+                // Unlocked: the Python decoder may call back into this one
+                lock.unlock();
+                return python(data);
             }
-            
-            // Variable section with bid/ask arrays
-            py::list bids, asks;
-            
-            // Parse remaining data as price levels
-            // SBE groups typically have group headers, but for now parse as raw price/qty pairs
-            while (offset + 16 <= data_size) { // Need at least 16 bytes for price+qty
-                uint64_t price_raw = *reinterpret_cast<const uint64_t*>(data + offset);
-                uint64_t qty_raw = *reinterpret_cast<const uint64_t*>(data + offset + 8);
-                
-                if (price_raw == 0 || qty_raw == 0) break; // End of valid data
-                
-                double price = decode_price_from_raw(price_raw);
-                double qty = decode_quantity_from_raw(qty_raw);
-                
-                // For simplicity, assume first half are bids, second half are asks
-                py::list level;
-                level.append(price);
-                level.append(qty);
-                
-                if (bids.size() < 10) {
-                    bids.append(level);
-                } else {
-                    asks.append(level);
-                }
-                
-                offset += 16;
+            // Handle unknown template IDs gracefully
+            stats_.unknown_template();
+            note_frame(payload, ingest_us, DecodeStatus::UnknownTemplate);
+            return decode_unknown_message(payload, message_header, ingest_us);
+        }
+
+        const FrameView frame{message_header, payload, payload.data() + MessageHeader::encodedLength(),
+                              payload.size() - MessageHeader::encodedLength(), ingest_us, level_arena(),
+                              decimal_strings_};
+        const uint16_t template_id = message_header.templateId();
+        py::dict result = result_shapes_.start(template_id, msg_type_of(*decoder), ingest_us);
+        const ParseError parse_error = decoder->fill(result, frame);
+        if (parse_error == ParseError::None) [[likely]] {
+            if (trace_) {
+                add_trace(result, frame);
             }
-            
-            result["bids"] = bids;
-            result["asks"] = asks;
-            result["symbol"] = "BTCUSDT";
-            
-        } catch (const std::exception& e) {
-            result["symbol"] = "PARSE_ERROR";
-            result["first_update_id"] = 0;
-            result["final_update_id"] = 0;
-            result["event_ts"] = get_current_time_millis();
-            py::list empty_bids, empty_asks;
-            result["bids"] = empty_bids;
-            result["asks"] = empty_asks;
-            result["parse_error"] = std::string(e.what());
+            result_shapes_.learn(template_id, result);
+        } else {
+            result = parse_error_result(*decoder, template_id, parse_error, ingest_us);
         }
-        
+        if (perf_sampled) {
+            perf_sample_end(template_id, perf_start);
+        }
+        note_frame(payload, ingest_us, parse_error == ParseError::None ? DecodeStatus::Ok : DecodeStatus::Malformed,
+                      parse_error);
+        stats_.record(message_header.templateId(), payload.size(), decode_clock_ticks() - start_ticks, parse_error,
+                      alloc_counts() - start_allocs);
         return result;
     }
-    
+
+    template <typename Mode>
+    py::object try_decode_as(const py::buffer& data, const std::span<char> payload,
+                             const MessageHeader& message_header, uint64_t ingest_us,
+                             std::unique_lock<InstanceLock>& lock) {
+        const AllocCounts start_allocs = alloc_counts();
+        PerfReading perf_start;
+        const bool perf_sampled = perf_sample_start(perf_start);
+        const uint64_t start_ticks = decode_clock_ticks();
+        const MessageDecoder* decoder = message_table<Mode>().find(message_header.templateId());
+        if (decoder == nullptr) {
+            if (py::function python = find_python_decoder(message_header.templateId())) {
+                lock.unlock();
+                return python(data);
+            }
+            stats_.unknown_template();
+            note_frame(payload, ingest_us, DecodeStatus::UnknownTemplate);
+            return py::cast(DecodeStatus::UnknownTemplate);
+        }
+
+        const FrameView frame{message_header, payload, payload.data() + MessageHeader::encodedLength(),
+                              payload.size() - MessageHeader::encodedLength(), ingest_us, level_arena(),
+                              decimal_strings_};
+        py::dict result = result_shapes_.start(message_header.templateId(), msg_type_of(*decoder), ingest_us);
+        const ParseError parse_error = decoder->fill(result, frame);
+        if (parse_error != ParseError::None) [[unlikely]] {
+            stats_.record(message_header.templateId(), payload.size(), decode_clock_ticks() - start_ticks,
+                          parse_error, alloc_counts() - start_allocs);
+            note_frame(payload, ingest_us, DecodeStatus::Malformed, parse_error);
+            return py::cast(DecodeStatus::Malformed);
+        }
+        if (trace_) {
+            add_trace(result, frame);
+        }
+        result_shapes_.learn(message_header.templateId(), result);
+        if (perf_sampled) {
+            perf_sample_end(message_header.templateId(), perf_start);
+        }
+        stats_.record(message_header.templateId(), payload.size(), decode_clock_ticks() - start_ticks,
+                      ParseError::None, alloc_counts() - start_allocs);
+        note_frame(payload, ingest_us, DecodeStatus::Ok);
+        return result;
+    }
+
+    // A reference rather than a pointer into the map: the call outlives the
+    // lock, and register_decoder may rehash meanwhile
+    py::function find_python_decoder(uint16_t template_id) const {
+        if (python_decoders_.empty()) {
+            return {};
+        }
+        auto it = python_decoders_.find(template_id);
+        return it == python_decoders_.end() ? py::function() : it->second;
+    }
+
     // Handle unknown message types gracefully
-    py::dict decode_unknown_message(const std::span<char> payload, const MessageHeader& message_header) {
+    py::dict decode_unknown_message(const std::span<char> payload, const MessageHeader& message_header,
+                                    uint64_t ingest_us) {
         py::dict result;
         result["msg_type"] = "unknown";
         result["source"] = "sbe";
@@ -551,27 +4050,3425 @@ private:
         result["version"] = message_header.version();
         result["block_length"] = message_header.blockLength();
         result["payload_size"] = payload.size();
-        result["event_ts"] = get_current_time_millis();
-        result["ingest_ts"] = get_current_time_millis();
+        result["event_ts"] = micros_to_millis(ingest_us);
+        result["ingest_ts"] = micros_to_millis(ingest_us);
         
         return result;
     }
 };
 
+// Safe without the GIL (free-threaded CPython) and, with pybind11 3, in
+// sub-interpreters with their own GIL: cached Python objects live in
+// per-interpreter state (interpreter_state.h), native state is either
+// internally synchronized or per object, and SBEDecoder's dict decoders
+// take its InstanceLock. Other objects with mutable state (books, windows,
+// builders) are not locked; share one between threads only behind a lock
+// of your own.
+#if PYBIND11_VERSION_HEX >= 0x03000000
+PYBIND11_MODULE(sbe_decoder_cpp, m, py::mod_gil_not_used(), py::multiple_interpreters::per_interpreter_gil()) {
+#elif PYBIND11_VERSION_HEX >= 0x020D0000
+PYBIND11_MODULE(sbe_decoder_cpp, m, py::mod_gil_not_used()) {
+#else
 PYBIND11_MODULE(sbe_decoder_cpp, m) {
+#endif
     m.doc() = "Binance SBE decoder using official patterns for stream data";
+    // Intern this interpreter's dict API keys now rather than on the first decode
+    result_keys();
+
+    py::class_<TradeEvent>(m, "TradeEvent")
+        .def_property_readonly("msg_type", [](const TradeEvent&) { return "trade"; })
+        .def_property_readonly("symbol", [](const TradeEvent& e) { return symbol_str(e.symbol); })
+        .def_readonly("symbol_id", &TradeEvent::symbol_id)
+        .def_readonly("event_ts", &TradeEvent::event_ts)
+        .def_readonly("trade_time", &TradeEvent::trade_time)
+        .def_readonly("ingest_ts", &TradeEvent::ingest_ts)
+        .def_readonly("ingest_ts_us", &TradeEvent::ingest_ts_us)
+        .def_readonly("trade_id", &TradeEvent::trade_id)
+        .def_readonly("price", &TradeEvent::price)
+        .def_readonly("qty", &TradeEvent::qty)
+        .def_readonly("is_buyer_maker", &TradeEvent::is_buyer_maker)
+        .def_readonly("price_mantissa", &TradeEvent::price_mantissa)
+        .def_readonly("qty_mantissa", &TradeEvent::qty_mantissa)
+        .def_readonly("price_exponent", &TradeEvent::price_exponent)
+        .def_readonly("qty_exponent", &TradeEvent::qty_exponent);
+
+    py::class_<BestBidAskEvent>(m, "BestBidAskEvent")
+        .def_property_readonly("msg_type", [](const BestBidAskEvent&) { return "bestBidAsk"; })
+        .def_property_readonly("symbol", [](const BestBidAskEvent& e) { return symbol_str(e.symbol); })
+        .def_readonly("symbol_id", &BestBidAskEvent::symbol_id)
+        .def_readonly("event_ts", &BestBidAskEvent::event_ts)
+        .def_readonly("ingest_ts", &BestBidAskEvent::ingest_ts)
+        .def_readonly("ingest_ts_us", &BestBidAskEvent::ingest_ts_us)
+        .def_readonly("book_update_id", &BestBidAskEvent::book_update_id)
+        .def_readonly("bid_px", &BestBidAskEvent::bid_px)
+        .def_readonly("bid_sz", &BestBidAskEvent::bid_sz)
+        .def_readonly("ask_px", &BestBidAskEvent::ask_px)
+        .def_readonly("ask_sz", &BestBidAskEvent::ask_sz)
+        .def_readonly("price_exponent", &BestBidAskEvent::price_exponent)
+        .def_readonly("qty_exponent", &BestBidAskEvent::qty_exponent);
+
+    py::class_<DepthDiffEvent>(m, "DepthDiffEvent")
+        .def_property_readonly("msg_type", [](const DepthDiffEvent&) { return "depthDiff"; })
+        .def_property_readonly("symbol", [](const DepthDiffEvent& e) { return symbol_str(e.symbol); })
+        .def_readonly("symbol_id", &DepthDiffEvent::symbol_id)
+        .def_readonly("event_ts", &DepthDiffEvent::event_ts)
+        .def_readonly("ingest_ts", &DepthDiffEvent::ingest_ts)
+        .def_readonly("ingest_ts_us", &DepthDiffEvent::ingest_ts_us)
+        .def_readonly("first_update_id", &DepthDiffEvent::first_update_id)
+        .def_readonly("final_update_id", &DepthDiffEvent::final_update_id)
+        .def_property_readonly("bids", [](const DepthDiffEvent& e) { return levels_to_python(e.bids); })
+        .def_property_readonly("asks", [](const DepthDiffEvent& e) { return levels_to_python(e.asks); });
     
-    py::class_<SBEDecoder>(m, "SBEDecoder")
+    py::class_<PinnedMessageView>(m, "MessageView")
+        .def_property_readonly("template_id", [](const PinnedMessageView& v) { return v.view().template_id(); })
+        .def_property_readonly("schema_id", [](const PinnedMessageView& v) { return v.view().schema_id(); })
+        .def_property_readonly("version", [](const PinnedMessageView& v) { return v.view().version(); })
+        .def_property_readonly("block_length", [](const PinnedMessageView& v) { return v.view().block_length(); })
+        .def_property_readonly("msg_type",
+                               [](const PinnedMessageView& v) {
+                                   const MessageDecoder* decoder =
+                                       message_table<ProductionMode>().find(v.view().template_id());
+                                   return decoder == nullptr ? "unknown" : decoder->msg_type;
+                               })
+        .def_property_readonly("event_ts",
+                               [](const PinnedMessageView& v) { return optional_millis(v.view().event_time_us()); })
+        .def_property_readonly("event_ts_us", [](const PinnedMessageView& v) { return v.view().event_time_us(); })
+        .def_property_readonly("trade_time",
+                               [](const PinnedMessageView& v) { return optional_millis(v.view().trade_time_us()); })
+        .def_property_readonly("book_update_id", [](const PinnedMessageView& v) { return v.view().book_update_id(); })
+        .def_property_readonly("first_update_id",
+                               [](const PinnedMessageView& v) { return v.view().first_update_id(); })
+        .def_property_readonly("final_update_id",
+                               [](const PinnedMessageView& v) { return v.view().final_update_id(); })
+        .def_property_readonly("symbol",
+                               [](const PinnedMessageView& v) -> py::object {
+                                   const std::string_view symbol = v.view().symbol();
+                                   if (symbol.empty()) {
+                                       return py::none();
+                                   }
+                                   return symbol_str(symbol);
+                               })
+        .def("__len__", [](const PinnedMessageView& v) { return v.view().size(); });
+
+    py::enum_<RuleCheck>(m, "RuleCheck")
+        .value("OK", RuleCheck::Ok)
+        .value("NOT_LISTED", RuleCheck::NotListed)
+        .value("PRICE_RANGE", RuleCheck::PriceRange)
+        .value("PRICE_TICK", RuleCheck::PriceTick)
+        .value("QTY_RANGE", RuleCheck::QtyRange)
+        .value("QTY_STEP", RuleCheck::QtyStep)
+        .value("MIN_NOTIONAL", RuleCheck::MinNotional);
+
+    py::class_<SymbolRulesTable>(m, "SymbolRulesTable")
+        .def(py::init<>())
+        .def("load_exchange_info",
+             [](SymbolRulesTable& table, const py::buffer& data) {
+                 FrameBuffer buffer{data};
+                 try {
+                     return table.load_exchange_info(buffer.payload());
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("data"),
+             "Publish the symbol rules of an exchangeInfo frame (ExchangeInfoResponse, template 103); "
+             "returns the number of symbols. IDs of known symbols are kept")
+        .def("id_of",
+             [](const SymbolRulesTable& table, const std::string& symbol) -> py::object {
+                 const SymbolId id = table.id_of(symbol);
+                 return id == INVALID_SYMBOL_ID ? py::object(py::none()) : py::int_(id);
+             },
+             py::arg("symbol"), "Interned symbol ID, or None for a symbol never listed")
+        .def("get", &symbol_rules_to_python, py::arg("symbol"),
+             "A symbol's rules as integer mantissas plus exponents, or None")
+        .def("check",
+             [](const SymbolRulesTable& table, const std::string& symbol, int64_t price, int64_t qty) {
+                 const SymbolRules* rules = table.find(symbol);
+                 return rules == nullptr ? RuleCheck::NotListed : rules->check(price, qty);
+             },
+             py::arg("symbol"), py::arg("price"), py::arg("qty"),
+             "Check a limit order (price and qty mantissas at the symbol's price/qty exponents)")
+        .def_property_readonly("generation", &SymbolRulesTable::generation)
+        .def("__len__", &SymbolRulesTable::size);
+
+    py::class_<PySymbolRegistry>(m, "SymbolRegistry",
+                                 "Per-symbol objects by interned symbol ID (the symbol_id column of decode_batch), "
+                                 "in blocks that never move once created; lookups take no lock")
+        .def(py::init<std::size_t>(), py::arg("symbols") = 0, "Preallocate the blocks of the first `symbols` IDs")
+        .def("emplace",
+             [](PySymbolRegistry& registry, SymbolId id, py::object value) {
+                 const auto [stored, created] = registry.emplace(id, std::move(value));
+                 return py::make_tuple(*stored, created);
+             },
+             py::arg("symbol_id"), py::arg("value"),
+             "The symbol's object, stored from `value` if it has none yet, and whether this call stored it")
+        .def("find",
+             [](const PySymbolRegistry& registry, SymbolId id) -> py::object {
+                 const py::object* value = registry.find(id);
+                 return value == nullptr ? py::object(py::none()) : *value;
+             },
+             py::arg("symbol_id"), "The symbol's object, or None")
+        .def("address",
+             [](const PySymbolRegistry& registry, SymbolId id) -> py::object {
+                 const py::object* value = registry.find(id);
+                 return value == nullptr ? py::object(py::none()) : py::int_(reinterpret_cast<uintptr_t>(value));
+             },
+             py::arg("symbol_id"), "Address of the symbol's block, or None; fixed for the registry's life")
+        .def("items",
+             [](const PySymbolRegistry& registry) {
+                 py::list items;
+                 registry.for_each([&](SymbolId id, py::object& value) { items.append(py::make_tuple(id, value)); });
+                 return items;
+             },
+             "(symbol_id, object) pairs in ID order")
+        .def("__len__", &PySymbolRegistry::size);
+
+    py::class_<DedupWindow>(m, "Deduplicator")
+        .def(py::init([](double window_seconds) {
+                 if (!(window_seconds > 0)) {
+                     throw py::value_error("Deduplicator: window_seconds must be positive");
+                 }
+                 return std::make_unique<DedupWindow>(static_cast<uint64_t>(window_seconds * 1e6));
+             }),
+             py::arg("window_seconds") = 3600.0)
+        .def("is_unique",
+             [](DedupWindow& window, const std::string& symbol, uint64_t record_id,
+                const std::optional<uint64_t>& now_us) {
+                 return window.check(intern_or_throw(symbol), record_id, resolve_ingest_us(now_us));
+             },
+             py::arg("symbol"), py::arg("record_id"), py::arg("now_us") = py::none(),
+             "True the first time (symbol, record_id) is seen within the window, False for a duplicate")
+        .def("unique_mask", &dedup_unique_mask<DedupWindow>, py::arg("symbol_id"), py::arg("record_id"),
+             py::arg("now_us") = py::none(),
+             "Check a decode_batch table's symbol_id and trade/update ID columns in one call; returns a bool mask "
+             "of the rows seen for the first time")
+        .def("clear_symbol",
+             [](DedupWindow& window, const std::string& symbol) {
+                 const SymbolId id = symbol_table().find(symbol);
+                 if (id != INVALID_SYMBOL_ID) {
+                     window.clear_symbol(id);
+                 }
+             },
+             py::arg("symbol"))
+        .def("clear_all", &DedupWindow::clear)
+        .def("get_stats", &dedup_stats_to_python<DedupWindow>)
+        .def("__len__", &DedupWindow::size);
+
+    py::class_<DedupFilter>(m, "BloomDeduplicator",
+                            "Deduplicator on rotating blocked Bloom filters: fixed memory for very long windows, at "
+                            "the price of reporting about fp_rate of new keys as duplicates")
+        .def(py::init([](double window_seconds, uint64_t capacity, double fp_rate, bool huge_pages) {
+                 if (!(window_seconds > 0)) {
+                     throw py::value_error("BloomDeduplicator: window_seconds must be positive");
+                 }
+                 return std::make_unique<DedupFilter>(static_cast<uint64_t>(window_seconds * 1e6), capacity,
+                                                      fp_rate, MemoryPlacement{huge_pages, -1});
+             }),
+             py::arg("window_seconds") = 86400.0, py::arg("capacity") = 2'000'000, py::arg("fp_rate") = 0.01,
+             py::arg("huge_pages") = false,
+             "Sized once for `capacity` keys per window at `fp_rate`; more keys raise the rate, see "
+             "get_stats()['estimated_fp_rate']. huge_pages=True backs the filter with 2 MB pages where the host "
+             "allows, see get_stats()['page_backing']")
+        .def("is_unique",
+             [](DedupFilter& filter, const std::string& symbol, uint64_t record_id,
+                const std::optional<uint64_t>& now_us) {
+                 return filter.check(intern_or_throw(symbol), record_id, resolve_ingest_us(now_us));
+             },
+             py::arg("symbol"), py::arg("record_id"), py::arg("now_us") = py::none(),
+             "True the first time (symbol, record_id) is seen within the window; False for a duplicate or, "
+             "for about fp_rate of new keys, a false positive")
+        .def("unique_mask", &dedup_unique_mask<DedupFilter>, py::arg("symbol_id"), py::arg("record_id"),
+             py::arg("now_us") = py::none(), "Deduplicator.unique_mask over the filter")
+        .def("clear_all", &DedupFilter::clear)
+        .def("get_stats", &dedup_filter_stats_to_python,
+             "Deduplicator's keys plus memory_bytes, estimated_fp_rate, target_fp_rate and hashes")
+        .def_property_readonly("memory_bytes", &DedupFilter::memory_bytes)
+        .def_property_readonly("estimated_fp_rate", &DedupFilter::estimated_fp_rate)
+        .def("__len__", &DedupFilter::size);
+
+    py::class_<TradeWindow>(m, "TradeWindow")
+        .def(py::init([](double window_seconds) {
+                 if (!(window_seconds > 0)) {
+                     throw py::value_error("TradeWindow: window_seconds must be positive");
+                 }
+                 return std::make_unique<TradeWindow>(static_cast<int64_t>(window_seconds * 1e3));
+             }),
+             py::arg("window_seconds") = 60.0)
+        .def("add", &TradeWindow::add, py::arg("trade_time"), py::arg("price"), py::arg("qty"),
+             py::arg("is_buyer_maker"), "Add one trade (trade_time in ms) and evict what leaves the window")
+        .def("add_batch", &add_trade_columns<TradeWindow>, py::arg("trade_time"), py::arg("price"), py::arg("qty"),
+             py::arg("is_buyer_maker"),
+             "Add the rows of a decode_batch trades table (one symbol's rows, in order)")
+        .def("advance", &TradeWindow::advance, py::arg("now_ms"),
+             "Evict the trades older than the window as of now_ms, without adding one")
+        .def("features",
+             [](const TradeWindow& window) { return features_or_empty(window, trade_features_to_python); },
+             "Current window features, with the keys of FeatureBuilder._build_trade_features")
+        .def("clear", &TradeWindow::clear)
+        .def_property_readonly("window_seconds",
+                               [](const TradeWindow& window) { return static_cast<double>(window.window_ms()) / 1e3; })
+        .def("__len__", &TradeWindow::size);
+
+    py::class_<MultiHorizonWindow>(m, "MultiHorizonWindow")
+        .def(py::init([](const std::vector<double>& horizons_seconds, double pane_seconds) {
+                 try {
+                     return std::make_unique<MultiHorizonWindow>(seconds_to_ms(horizons_seconds),
+                                                                 std::llround(pane_seconds * 1e3));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("horizons_seconds") = std::vector<double>{1, 2, 10, 60}, py::arg("pane_seconds") = 0.0,
+             "Trade features over every horizon from shared panes; pane_seconds 0 uses the horizons' gcd")
+        .def("add", &MultiHorizonWindow::add, py::arg("trade_time"), py::arg("price"), py::arg("qty"),
+             py::arg("is_buyer_maker"), "Absorb one trade (trade_time in ms) into its pane")
+        .def("add_batch", &add_trade_columns<MultiHorizonWindow>, py::arg("trade_time"), py::arg("price"),
+             py::arg("qty"), py::arg("is_buyer_maker"), "Absorb the rows of a decode_batch trades table")
+        .def("advance", &MultiHorizonWindow::advance, py::arg("now_ms"),
+             "End every horizon at now_ms, so quiet symbols age out")
+        .def("features", &horizon_features_to_python,
+             "One FeatureBuilder._build_trade_features dict per horizon, keyed like '10s'")
+        .def("clear", &MultiHorizonWindow::clear)
+        .def_property_readonly("horizons_seconds",
+                               [](const MultiHorizonWindow& window) {
+                                   std::vector<double> seconds;
+                                   for (const int64_t horizon : window.horizons_ms()) {
+                                       seconds.push_back(static_cast<double>(horizon) / 1e3);
+                                   }
+                                   return seconds;
+                               })
+        .def_property_readonly("pane_seconds",
+                               [](const MultiHorizonWindow& window) {
+                                   return static_cast<double>(window.pane_ms()) / 1e3;
+                               })
+        .def_property_readonly("late_drops", &MultiHorizonWindow::late_drops);
+
+    py::class_<QuantileWindow>(m, "QuantileWindow",
+                               "t-digest quantiles of trade size, trade inter-arrival time and spread over every "
+                               "horizon, from shared panes; not thread-safe")
+        .def(py::init([](const std::vector<double>& horizons_seconds, double pane_seconds, double compression) {
+                 try {
+                     return std::make_unique<QuantileWindow>(seconds_to_ms(horizons_seconds),
+                                                             std::llround(pane_seconds * 1e3), compression);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("horizons_seconds") = std::vector<double>{10, 60}, py::arg("pane_seconds") = 0.0,
+             py::arg("compression") = 200.0,
+             "pane_seconds 0 uses the horizons' gcd; a larger compression keeps more centroids per digest, for "
+             "tighter tails")
+        .def("add_trade", &QuantileWindow::add_trade, py::arg("trade_time"), py::arg("qty"),
+             "Absorb one trade's size and its gap to the previous trade (trade_time in ms)")
+        .def("add_quote", &QuantileWindow::add_quote, py::arg("event_time"), py::arg("bid_price"),
+             py::arg("ask_price"), "Absorb one best bid/ask's spread, in basis points of the mid")
+        .def("advance", &QuantileWindow::advance, py::arg("now_ms"),
+             "End every horizon at now_ms, so quiet symbols age out")
+        .def("features", &quantile_features_to_python, py::arg("quantiles") = std::vector<double>{0.5, 0.9, 0.99},
+             "Per horizon, keyed like '10s', {'trade_size_p50': ..., 'inter_arrival_ms_p99': ..., "
+             "'spread_bps_p90': ...}; metrics without values in the horizon are left out")
+        .def("clear", &QuantileWindow::clear)
+        .def_property_readonly("horizons_seconds",
+                               [](const QuantileWindow& window) {
+                                   std::vector<double> seconds;
+                                   for (const int64_t horizon : window.horizons_ms()) {
+                                       seconds.push_back(static_cast<double>(horizon) / 1e3);
+                                   }
+                                   return seconds;
+                               })
+        .def_property_readonly("late_drops", &QuantileWindow::late_drops);
+
+    m.def(
+        "save_window_checkpoint",
+        [](const std::string& path, const std::map<std::string, const MultiHorizonWindow*>& windows,
+           const py::bytes& meta) {
+            std::vector<WindowCheckpointItem> items;
+            for (const auto& [key, window] : windows) {
+                items.push_back({key, window});
+            }
+            const std::string_view meta_bytes = meta;
+            try {
+                write_window_checkpoint(path, items, {meta_bytes.data(), meta_bytes.size()}, ingest_time_us());
+            } catch (const std::runtime_error& e) {
+                throw py::value_error(e.what());
+            }
+        },
+        py::arg("path"), py::arg("windows"), py::arg("meta") = py::bytes(),
+        "Atomically write {key: MultiHorizonWindow} and opaque `meta` bytes (e.g. stream positions) to a "
+        "binary checkpoint file");
+
+    py::class_<WindowCheckpoint>(m, "WindowCheckpoint")
+        .def(py::init([](const std::string& path) {
+                 try {
+                     return std::make_unique<WindowCheckpoint>(path);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("path"), "Map a checkpoint written by save_window_checkpoint")
+        .def_property_readonly("keys",
+                               [](const WindowCheckpoint& checkpoint) {
+                                   std::vector<std::string> keys;
+                                   for (const auto& entry : checkpoint.entries()) {
+                                       keys.emplace_back(WindowCheckpoint::key_of(entry));
+                                   }
+                                   return keys;
+                               })
+        .def_property_readonly("meta",
+                               [](const WindowCheckpoint& checkpoint) {
+                                   const auto meta = checkpoint.meta();
+                                   return py::bytes(meta.data(), meta.size());
+                               })
+        .def_property_readonly("written_us", &WindowCheckpoint::written_us)
+        .def(
+            "restore",
+            [](const WindowCheckpoint& checkpoint, const std::string& key, MultiHorizonWindow& window) {
+                const int64_t index = checkpoint.find(key);
+                return index >= 0 && checkpoint.load(static_cast<std::size_t>(index), window);
+            },
+            py::arg("key"), py::arg("window"),
+            "Restore key's saved state into window; False if the key is absent or was saved with other horizons")
+        .def("__len__", &WindowCheckpoint::size);
+
+    py::class_<FeatureBus>(m, "FeatureBus",
+                           "Shared-memory latest-value feature bus: one seqlock-protected slot per stream key with a "
+                           "short history; one writer, any number of lock-free readers")
+        .def_static(
+            "create",
+            [](const std::string& path, uint32_t slots, uint32_t capacity, uint32_t history) {
+                try {
+                    return FeatureBus::create(path, slots, capacity, history);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("path"), py::arg("slots") = 64, py::arg("capacity") = 64, py::arg("history") = 16,
+            "Create (or atomically replace) the segment at path, e.g. under /dev/shm, as its writer")
+        .def_static(
+            "open",
+            [](const std::string& path) {
+                try {
+                    return FeatureBus::open(path);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("path"), "Map an existing segment read-only")
+        .def("publish",
+             [](FeatureBus& bus, std::string_view key, const FloatColumn& values, int64_t event_ts_us,
+                uint64_t schema_hash) {
+                 try {
+                     return bus.publish(key, event_ts_us, schema_hash, values.data(),
+                                        static_cast<std::size_t>(values.size()));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("key"), py::arg("values"), py::arg("event_ts_us"), py::arg("schema_hash") = 0,
+             "Write a feature vector to key's slot; False when every slot is taken by other keys")
+        .def("latest",
+             [](FeatureBus& bus, std::string_view key) -> py::object {
+                 auto entries = bus.read(key, 1);
+                 if (entries.empty()) {
+                     return py::none();
+                 }
+                 return feature_bus_entry_to_python(entries.front());
+             },
+             py::arg("key"), "Newest entry of key as a dict with event_ts_us, schema_hash and values, or None")
+        .def("history",
+             [](FeatureBus& bus, std::string_view key, std::size_t n) {
+                 py::list result;
+                 for (auto& entry : bus.read(key, n)) {
+                     result.append(feature_bus_entry_to_python(entry));
+                 }
+                 return result;
+             },
+             py::arg("key"), py::arg("n") = 16, "Up to n entries of key, newest first")
+        .def("latest_matrix",
+             [](FeatureBus& bus, const std::vector<std::string>& keys, std::size_t width,
+                const std::optional<uint64_t>& schema_hash) {
+                 auto [ts, matrix] = new_feature_matrix(keys.size(), width);
+                 for (std::size_t k = 0; k < keys.size(); ++k) {
+                     auto entries = bus.read(keys[k], 1);
+                     if (entries.empty() || (schema_hash && *schema_hash != entries.front().schema_hash)) {
+                         continue;
+                     }
+                     const FeatureBusEntry& entry = entries.front();
+                     if (entry.values.size() != width) {
+                         throw py::value_error("latest_matrix: '" + keys[k] + "' has " +
+                                               std::to_string(entry.values.size()) + " values, expected " +
+                                               std::to_string(width));
+                     }
+                     std::copy(entry.values.begin(), entry.values.end(), matrix.mutable_data() + k * width);
+                     ts.mutable_data()[k] = entry.event_ts_us;
+                 }
+                 return py::make_tuple(ts, matrix);
+             },
+             py::arg("keys"), py::arg("width"), py::arg("schema_hash") = py::none(),
+             "Newest entries of keys as (event_ts_us, float32 (len(keys), width) matrix) for one batched "
+             "prediction; rows without an entry (or of another schema) are NaN with ts 0")
+        .def("keys", &FeatureBus::keys, "Stream keys with a slot, in the order they were claimed")
+        .def_property_readonly("path", &FeatureBus::path)
+        .def_property_readonly("writable", &FeatureBus::writable)
+        .def_property_readonly("slots", [](const FeatureBus& bus) { return bus.header().slots; })
+        .def_property_readonly("capacity", [](const FeatureBus& bus) { return bus.header().capacity; })
+        .def_property_readonly("history_length", [](const FeatureBus& bus) { return bus.header().history; });
+
+    py::class_<MlpModel>(m, "MlpModel",
+                         "Native dense-network runtime: SIMD GEMV (batched: blocked GEMM) layers with fused bias and "
+                         "activation, optionally int8-quantized; not thread-safe")
+        .def(py::init(&mlp_from_python), py::arg("layers"), py::arg("input_mean") = py::none(),
+             py::arg("input_scale") = py::none(),
+             "layers: (weights (out, in), bias (out,), 'relu'|'tanh'|'sigmoid'|'identity') tuples with BatchNorm "
+             "folded in; inputs are scaled as (x - input_mean) / input_scale")
+        .def_static(
+            "load",
+            [](const std::string& path, bool prefault) {
+                try {
+                    py::gil_scoped_release release;
+                    return MlpModel::load(path, prefault);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("path"), py::arg("prefault") = false,
+            "Load an MLP weight file: an aligned one (to_aligned_bytes) is memory-mapped and its rows read in "
+            "place, faulted in up front with prefault=True; a plain one (to_bytes) is parsed")
+        .def_static(
+            "from_bytes",
+            [](const py::buffer& data) {
+                FrameBuffer buffer{data};
+                try {
+                    return MlpModel::from_bytes(buffer.payload());
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("data"))
+        .def("to_bytes",
+             [](const MlpModel& model) {
+                 try {
+                     const std::vector<char> data = model.to_bytes();
+                     return py::bytes(data.data(), data.size());
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             "The model as an MLP weight file image (float models only)")
+        .def("to_aligned_bytes",
+             [](const MlpModel& model, uint64_t revision) {
+                 try {
+                     const std::vector<char> data = model.to_aligned_bytes(revision);
+                     return py::bytes(data.data(), data.size());
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("revision") = 0,
+             "The model as an aligned weight file image that load() maps in place (float models only); write it "
+             "beside the deployed file and rename it over")
+        .def("quantize", &MlpModel::quantize, "Quantize every layer's weights to int8, one scale per output row")
+        .def("predict", &mlp_predict_to_python, py::arg("x"),
+             "One prediction from a feature vector; returns the output layer as float32")
+        .def("predict_batch", &mlp_predict_batch_to_python, py::arg("x"),
+             "One prediction per row of an (n, input_size) matrix, e.g. every symbol's latest features, run "
+             "through each layer together; returns an (n, output_size) float32 array")
+        .def_property_readonly("input_size", &MlpModel::input_size)
+        .def_property_readonly("output_size", &MlpModel::output_size)
+        .def_property_readonly("quantized", &MlpModel::quantized)
+        .def_property_readonly("mapped", &MlpModel::mapped)
+        .def_property_readonly("revision", &MlpModel::revision)
+        .def_property_readonly("layers", [](const MlpModel& model) {
+            py::list result;
+            for (const DenseLayer& layer : model.layers()) {
+                result.append(py::make_tuple(layer.in, layer.out, activation_name(layer.activation)));
+            }
+            return result;
+        });
+    m.attr("MLP_KERNEL") = mlp_kernel();
+
+    py::class_<MlpModelSwap>(m, "MlpModelSwap",
+                             "Hot-swappable MLP: a loader thread stages new versions, the next prediction swaps one "
+                             "in with an atomic pointer exchange; predictions come from one thread")
+        .def(py::init<>())
+        .def("load",
+             [](MlpModelSwap& swap, const std::string& path) {
+                 try {
+                     py::gil_scoped_release release;
+                     swap.stage(std::make_unique<MlpModel>(MlpModel::load(path, true)));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("path"),
+             "Map (or parse) the weight file, fault it in and stage it, without the GIL; the model in use is kept "
+             "if the file is bad")
+        .def("stage", [](MlpModelSwap& swap, const MlpModel& model) { swap.stage(std::make_unique<MlpModel>(model)); },
+             py::arg("model"), "Stage a copy of model")
+        .def("predict", [](MlpModelSwap& swap, const Float32Column& x) {
+                 return mlp_predict_to_python(mlp_swap_current(swap), x);
+             },
+             py::arg("x"), "MlpModel.predict with the newest staged model")
+        .def("predict_batch", [](MlpModelSwap& swap, const Float32Column& x) {
+                 return mlp_predict_batch_to_python(mlp_swap_current(swap), x);
+             },
+             py::arg("x"), "MlpModel.predict_batch with the newest staged model")
+        .def_property_readonly("revision",
+                               [](MlpModelSwap& swap) -> py::object {
+                                   MlpModel* model = swap.current();
+                                   return model == nullptr ? py::none() : py::int_(model->revision());
+                               },
+                               "Revision of the model predictions use (picking up a staged one), None before any")
+        .def_property_readonly("pending", &MlpModelSwap::pending)
+        .def_property_readonly("swaps", &MlpModelSwap::swaps);
+
+    py::class_<FeatureManifest>(m, "FeatureManifest",
+                                "Compiled model input layout: which feature of which stream feeds each input, and "
+                                "its training-time scaling")
+        .def_static("compile", &feature_manifest_from_python, py::arg("sources"), py::arg("inputs"),
+                    "sources: (name, feature names) pairs, the name being the stream's bus key suffix (e.g. "
+                    "'trade') and the names in its vectors' order; inputs: (source, feature) or (source, feature, "
+                    "'none'|'standard'|'minmax', a, b[, fill]) tuples in model order, (a, b) being (mean, std) or "
+                    "(min, max)")
+        .def_static(
+            "load",
+            [](const std::string& path) {
+                try {
+                    return FeatureManifest::load(path);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("path"), "Load a manifest file as exported by the trainer")
+        .def_static(
+            "from_bytes",
+            [](const py::buffer& data) {
+                FrameBuffer buffer{data};
+                try {
+                    return FeatureManifest::from_bytes(buffer.payload());
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("data"))
+        .def("to_bytes",
+             [](const FeatureManifest& manifest) {
+                 const std::vector<char> data = manifest.to_bytes();
+                 return py::bytes(data.data(), data.size());
+             },
+             "The manifest file image")
+        .def_property_readonly("sources",
+                               [](const FeatureManifest& manifest) {
+                                   py::list result;
+                                   for (const FeatureSource& source : manifest.sources()) {
+                                       result.append(py::make_tuple(source.name, source.schema_hash, source.width));
+                                   }
+                                   return result;
+                               })
+        .def_property_readonly("inputs",
+                               [](const FeatureManifest& manifest) {
+                                   py::list result;
+                                   for (const FeatureInput& input : manifest.inputs()) {
+                                       result.append(py::make_tuple(
+                                           input.source, input.index,
+                                           FEATURE_SCALING_NAMES[static_cast<std::size_t>(input.scaling)], input.a,
+                                           input.b, input.fill));
+                                   }
+                                   return result;
+                               })
+        .def("__len__", [](const FeatureManifest& manifest) { return manifest.inputs().size(); });
+
+    py::class_<FeatureAssembler>(m, "FeatureAssembler",
+                                 "Writes normalized float32 model inputs straight from the feature bus or binary "
+                                 "feature records, in manifest order, one pass per source; not thread-safe")
+        .def(py::init([](const FeatureManifest& manifest) { return std::make_unique<FeatureAssembler>(manifest); }),
+             py::arg("manifest"))
+        .def("from_bus",
+             [](FeatureAssembler& assembler, FeatureBus& bus, const std::vector<std::string>& symbols) {
+                 auto [ts, matrix] = new_feature_matrix(symbols.size(), assembler.width());
+                 for (std::size_t k = 0; k < symbols.size(); ++k) {
+                     ts.mutable_data()[k] =
+                         assembler.assemble(bus, symbols[k], matrix.mutable_data() + k * assembler.width());
+                 }
+                 return py::make_tuple(ts, matrix);
+             },
+             py::arg("bus"), py::arg("symbols"),
+             "Inputs of each symbol from its '<symbol>:<source>' slots as (event_ts_us, float32 (len(symbols), "
+             "width) matrix) for MlpModel.predict_batch; ts is the newest source's, 0 when none was found")
+        .def("from_records", &feature_assembler_from_records, py::arg("rows"),
+             "Inputs from binary feature records (e.g. one MGET), one row per symbol: a sequence of one record "
+             "(None when missing) per source, or the record itself for a one-source manifest")
+        .def("reset_stats", &FeatureAssembler::reset_stats)
+        .def_property_readonly("width", &FeatureAssembler::width)
+        .def_property_readonly("stats", [](const FeatureAssembler& assembler) {
+            const FeatureAssemblyStats& stats = assembler.stats();
+            py::dict result;
+            result["rows"] = stats.rows;
+            result["missing"] = stats.missing;
+            result["schema_mismatches"] = stats.schema_mismatches;
+            result["filled"] = stats.filled;
+            return result;
+        });
+
+    py::class_<KplAggregator>(m, "KplAggregator",
+                              "Packs payloads into one KPL aggregated Kinesis record; keep one per partition key so "
+                              "each key's payloads stay on one shard in order")
+        .def(py::init([](std::size_t max_bytes) {
+                 try {
+                     return std::make_unique<KplAggregator>(max_bytes);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("max_bytes") = KPL_DEFAULT_MAX_BYTES)
+        .def("add",
+             [](KplAggregator& aggregator, std::string_view partition_key, const py::buffer& data) {
+                 FrameBuffer buffer{data};
+                 try {
+                     return aggregator.add(partition_key, buffer.payload());
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("partition_key"), py::arg("data"),
+             "Append a payload (copied); False, adding nothing, when it would pass max_bytes")
+        .def("finish",
+             [](KplAggregator& aggregator) {
+                 const std::vector<char> record = aggregator.finish();
+                 return py::bytes(record.data(), record.size());
+             },
+             "The Kinesis record for everything added (a lone payload as itself) and reset; send it under "
+             "partition_key, read before calling this")
+        .def("clear", &KplAggregator::clear)
+        .def("__len__", &KplAggregator::records)
+        .def_property_readonly("size", &KplAggregator::size, "Bytes of the aggregate finish() would build")
+        .def_property_readonly("max_bytes", &KplAggregator::max_bytes)
+        .def_property_readonly("partition_key", [](const KplAggregator& aggregator) -> py::object {
+            if (aggregator.empty()) {
+                return py::none();
+            }
+            const std::string_view key = aggregator.partition_key();
+            return py::str(key.data(), key.size());
+        });
+    m.def(
+        "kpl_deaggregate",
+        [](const py::buffer& data) -> py::object {
+            FrameBuffer buffer{data};
+            const std::span<const char> payload = buffer.payload();
+            if (!is_kpl_aggregate(payload)) {
+                return py::none();
+            }
+            std::vector<KplRecord> records;
+            try {
+                records = deaggregate_kpl(payload);
+            } catch (const std::runtime_error& e) {
+                throw py::value_error(e.what());
+            }
+            py::list result;
+            for (const KplRecord& record : records) {
+                result.append(py::make_tuple(py::str(record.partition_key.data(), record.partition_key.size()),
+                                             py::bytes(record.data.data(), record.data.size())));
+            }
+            return result;
+        },
+        py::arg("data"),
+        "(partition_key, bytes) payloads of a KPL aggregated record, or None for an ordinary record; raises "
+        "ValueError on a malformed aggregate");
+    m.attr("KPL_DEFAULT_MAX_BYTES") = KPL_DEFAULT_MAX_BYTES;
+
+    py::class_<KinesisProducer>(m, "KinesisProducer",
+                                "PutRecords producer with its own sender threads: SigV4-signed requests over pooled "
+                                "keep-alive connections, batched per shard by hash-key range, partial failures "
+                                "retried with backoff")
+        .def(py::init([](std::string stream_name, std::string region, std::string access_key, std::string secret_key,
+                         std::string session_token,
+                         const std::vector<std::tuple<std::string, std::string, std::string>>& shards,
+                         std::string host, uint16_t port, bool use_tls, std::size_t connections, double linger,
+                         std::size_t max_batch_records, std::size_t max_queued_bytes, uint32_t max_attempts,
+                         uint32_t shard_records_per_second, std::size_t shard_bytes_per_second,
+                         std::shared_ptr<HotPartitioner> partitioner) {
+                 KinesisProducerConfig config;
+                 config.stream_name = std::move(stream_name);
+                 config.region = std::move(region);
+                 config.endpoint.host = std::move(host);
+                 config.endpoint.port = port;
+                 config.endpoint.use_tls = use_tls;
+                 config.shards = kinesis_shards_from_python(shards);
+                 config.connections = connections;
+                 config.linger_ms = static_cast<uint32_t>(linger * 1000);
+                 config.max_batch_records = max_batch_records;
+                 config.max_queued_bytes = max_queued_bytes;
+                 config.max_attempts = max_attempts;
+                 config.shard_records_per_second = shard_records_per_second;
+                 config.shard_bytes_per_second = shard_bytes_per_second;
+                 if (partitioner) {
+                     config.route = [partitioner](std::string_view key, std::string& routed_key,
+                                                  std::string& routed_hash_key) {
+                         return partitioner->route(key, routed_key, routed_hash_key);
+                     };
+                 }
+                 try {
+                     return std::make_unique<KinesisProducer>(
+                         std::move(config),
+                         AwsCredentials{std::move(access_key), std::move(secret_key), std::move(session_token)});
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("stream_name"), py::arg("region"), py::arg("access_key"), py::arg("secret_key"),
+             py::arg("session_token") = "",
+             py::arg("shards") = std::vector<std::tuple<std::string, std::string, std::string>>{},
+             py::arg("host") = "", py::arg("port") = 443, py::arg("use_tls") = true, py::arg("connections") = 4,
+             py::arg("linger") = 0.05, py::arg("max_batch_records") = 500,
+             py::arg("max_queued_bytes") = std::size_t{64} << 20, py::arg("max_attempts") = 10,
+             py::arg("shard_records_per_second") = 1000, py::arg("shard_bytes_per_second") = std::size_t{1} << 20,
+             py::arg("partitioner") = nullptr,
+             "`shards` are ListShards' (ShardId, StartingHashKey, EndingHashKey) for the open shards; without "
+             "them the hash space is split evenly over the connections. An empty host is the region's Kinesis "
+             "endpoint; `connections` sender threads each keep one connection and one request in flight. A "
+             "HotPartitioner spreads its symbols' records (put without an explicit hash key) over several shards")
+        .def("start", &KinesisProducer::start)
+        .def("stop",
+             [](KinesisProducer& producer, double timeout) {
+                 py::gil_scoped_release release;
+                 producer.stop(static_cast<int>(timeout * 1000));
+             },
+             py::arg("timeout") = 5.0,
+             "Flush for up to timeout seconds, then stop the senders; records still queued are dropped")
+        .def("put",
+             [](KinesisProducer& producer, const py::buffer& data, std::string_view partition_key,
+                std::string_view explicit_hash_key) {
+                 FrameBuffer buffer{data};
+                 try {
+                     return producer.put(buffer.payload(), partition_key, explicit_hash_key);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("data"), py::arg("partition_key"), py::arg("explicit_hash_key") = "",
+             "Queue a copy of one record; False when max_queued_bytes are already queued or in flight")
+        .def("put_records",
+             [](KinesisProducer& producer, const py::buffer& payload, const OffsetsArray& offsets,
+                const std::vector<std::string>& partition_keys) {
+                 FrameBuffer buffer{payload};
+                 const std::span<char> bytes = buffer.payload();
+                 const int64_t* bounds = offsets.data();
+                 if (static_cast<std::size_t>(offsets.size()) < partition_keys.size() + 1) {
+                     throw py::value_error("put_records: offsets must hold one more entry than partition_keys");
+                 }
+                 for (std::size_t i = 0; i < partition_keys.size(); ++i) {
+                     if (bounds[i] < 0 || bounds[i] > bounds[i + 1] ||
+                         bounds[i + 1] > static_cast<int64_t>(bytes.size())) {
+                         throw py::value_error("put_records: offsets must be ascending and within the payload");
+                     }
+                 }
+                 py::gil_scoped_release release;
+                 std::size_t queued = 0;
+                 try {
+                     for (; queued < partition_keys.size(); ++queued) {
+                         const auto begin = static_cast<std::size_t>(bounds[queued]);
+                         const auto end = static_cast<std::size_t>(bounds[queued + 1]);
+                         const std::span<const char> record = bytes.subspan(begin, end - begin);
+                         if (!producer.put(record, partition_keys[queued])) {
+                             break;
+                         }
+                     }
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 return queued;
+             },
+             py::arg("payload"), py::arg("offsets"), py::arg("partition_keys"),
+             "Queue serialize_records output (records are copied) and return how many were queued; fewer than "
+             "len(partition_keys) when the queue filled up")
+        .def("flush",
+             [](KinesisProducer& producer, std::optional<double> timeout) {
+                 py::gil_scoped_release release;
+                 return producer.flush(timeout ? static_cast<int>(*timeout * 1000) : -1);
+             },
+             py::arg("timeout") = py::none(),
+             "Send everything queued without waiting out linger; True once nothing is queued or in flight, False "
+             "after timeout seconds")
+        .def("set_credentials",
+             [](KinesisProducer& producer, std::string access_key, std::string secret_key,
+                std::string session_token) {
+                 producer.set_credentials(
+                     AwsCredentials{std::move(access_key), std::move(secret_key), std::move(session_token)});
+             },
+             py::arg("access_key"), py::arg("secret_key"), py::arg("session_token") = "",
+             "Sign the next requests with new (e.g. refreshed temporary) credentials")
+        .def_property_readonly("shard_count", &KinesisProducer::shard_count)
+        .def_property_readonly("last_error", &KinesisProducer::last_error)
+        .def_property_readonly("stats", &kinesis_producer_stats_to_python);
+
+    py::class_<HotPartitioner, std::shared_ptr<HotPartitioner>>(
+        m, "HotPartitioner",
+        "Spreads each of `symbols` over `buckets` shards: records get partition key '<symbol>#<seq>' and the "
+        "explicit hash key of bucket (seq // run) % buckets; SequenceMerger restores the order. Thread-safe")
+        .def(py::init([](const std::vector<std::string>& symbols, uint32_t buckets, uint32_t run) {
+                 try {
+                     return std::make_shared<HotPartitioner>(HotPartitionConfig{symbols, buckets, run});
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("symbols"), py::arg("buckets") = 4, py::arg("run") = 1)
+        .def(
+            "route",
+            [](HotPartitioner& partitioner, std::string_view partition_key) -> py::object {
+                std::string key;
+                std::string hash_key;
+                if (!partitioner.route(partition_key, key, hash_key)) {
+                    return py::none();
+                }
+                return py::make_tuple(key, hash_key);
+            },
+            py::arg("partition_key"),
+            "(partition_key, explicit_hash_key) for the next record of a hot symbol, None for any other key")
+        .def("hot", &HotPartitioner::hot, py::arg("symbol"))
+        .def_property_readonly("buckets", &HotPartitioner::buckets)
+        .def_property_readonly("run", &HotPartitioner::run)
+        .def_property_readonly("routed", &HotPartitioner::routed, "Records numbered so far per hot symbol");
+
+    py::class_<PySequenceMerger>(m, "SequenceMerger",
+                                 "Restores each symbol's order across the shards a HotPartitioner spread it over; "
+                                 "not thread-safe")
+        .def(py::init([](std::size_t max_buffered, double max_wait) {
+                 return std::make_unique<PySequenceMerger>(
+                     SequenceMergerConfig{max_buffered, static_cast<uint64_t>(max_wait * 1e6)});
+             }),
+             py::arg("max_buffered") = 65536, py::arg("max_wait") = 0.5,
+             "A missing record holds its symbol's later ones back for up to max_wait seconds or max_buffered "
+             "records, then is skipped")
+        .def(
+            "push",
+            [](PySequenceMerger& merger, std::string_view partition_key, py::object item) {
+                py::list released;
+                std::string_view symbol;
+                uint64_t seq = 0;
+                if (!split_sequenced_key(partition_key, symbol, seq)) {
+                    released.append(std::move(item));
+                    return released;
+                }
+                merger.push(symbol, seq, std::move(item), ingest_time_us(),
+                            [&](py::object&& out) { released.append(std::move(out)); });
+                return released;
+            },
+            py::arg("partition_key"), py::arg("item"),
+            "Take the record under partition_key and return the records now released, in order: item itself "
+            "when the key has no '#<seq>'")
+        .def(
+            "expire",
+            [](PySequenceMerger& merger) {
+                py::list released;
+                merger.expire(ingest_time_us(), [&](py::object&& out) { released.append(std::move(out)); });
+                return released;
+            },
+            "Records released by gaps that have waited max_wait; call it between reads")
+        .def(
+            "flush",
+            [](PySequenceMerger& merger) {
+                py::list released;
+                merger.flush([&](py::object&& out) { released.append(std::move(out)); });
+                return released;
+            },
+            "Every record held back, skipping the gaps")
+        .def_property_readonly("stats", [](const PySequenceMerger& merger) {
+            const SequenceMergerStats& stats = merger.stats();
+            py::dict result;
+            result["released"] = stats.released;
+            result["buffered"] = stats.buffered;
+            result["duplicates"] = stats.duplicates;
+            result["gaps"] = stats.gaps;
+            result["skipped"] = stats.skipped;
+            return result;
+        });
+
+    py::class_<IngestPipeline>(m, "IngestPipeline",
+                               "Staged receive -> decode -> book -> publish pipeline, one lane per stream type, "
+                               "with bounded queues between stages and a block, drop_oldest or conflate overflow "
+                               "policy per lane")
+        .def(py::init([](const std::map<std::string, std::string>& policies, std::size_t capacity,
+                         const std::map<std::string, std::size_t>& capacities, const std::string& format,
+                         std::size_t batch,
+                         const std::map<std::string, std::map<std::string, std::map<std::string, int64_t>>>& stages) {
+                 IngestPipelineConfig config;
+                 for (PipelineLaneConfig& lane : config.lanes) {
+                     lane.capacity = capacity;
+                 }
+                 for (const auto& [lane, policy] : policies) {
+                     config.lanes[static_cast<std::size_t>(pipeline_lane_from_name(lane))].policy =
+                         overflow_policy_from_name(policy);
+                 }
+                 for (const auto& [lane, lane_capacity] : capacities) {
+                     config.lanes[static_cast<std::size_t>(pipeline_lane_from_name(lane))].capacity = lane_capacity;
+                 }
+                 apply_pipeline_stages(config, stages);
+                 config.format = record_format_from_name(format, "IngestPipeline");
+                 config.batch = batch;
+                 try {
+                     return std::make_unique<IngestPipeline>(std::move(config));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("policies") = std::map<std::string, std::string>{}, py::arg("capacity") = std::size_t{8192},
+             py::arg("capacities") = std::map<std::string, std::size_t>{}, py::arg("format") = "json",
+             py::arg("batch") = std::size_t{256},
+             py::arg("stages") = std::map<std::string, std::map<std::string, std::map<std::string, int64_t>>>{},
+             "`policies` maps lanes ('trade', 'bestBidAsk', 'depth') to 'block', 'drop_oldest' or 'conflate' "
+             "(bestBidAsk only); by default bestBidAsk conflates and the others block. Every stage queue holds "
+             "`capacity` items, or capacities[lane] for that lane. stages[lane][stage] ('decode', 'books', "
+             "'publish') may set 'capacity', the items in the queue that stage takes from, and 'cpu', the core "
+             "its thread is pinned to. Records are serialize_records output in `format`")
+        .def("attach_publisher",
+             [](IngestPipeline& pipeline, const std::string& lane, KinesisProducer& producer) {
+                 try {
+                     pipeline.attach_publisher(pipeline_lane_from_name(lane), &producer);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("lane"), py::arg("producer"), py::keep_alive<1, 3>(),
+             "Publish the lane's records through a started KinesisProducer; attaching several fans every record "
+             "out to each of them. Before start() only")
+        .def("attach_books",
+             [](IngestPipeline& pipeline, DecoderPool& pool) {
+                 try {
+                     pipeline.attach_books(&pool);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("pool"), py::keep_alive<1, 2>(),
+             "Apply depth frames to an SBEDecoderPool's books (and book features) between decode and publish; "
+             "before start() only")
+        .def("start", &IngestPipeline::start, "Start the lanes' stage threads")
+        .def("stop",
+             [](IngestPipeline& pipeline, double timeout) {
+                 py::gil_scoped_release release;
+                 pipeline.stop(static_cast<int>(timeout * 1000));
+             },
+             py::arg("timeout") = 5.0,
+             "Stop taking frames and drain the lanes into their producers for up to timeout seconds; what is "
+             "still queued after that is dropped and counted")
+        .def("submit",
+             [](IngestPipeline& pipeline, const py::object& frames, const std::optional<OffsetsArray>& offsets,
+                const std::optional<uint64_t>& received_us) {
+                 FrameBufferList buffers{true};
+                 collect_frames(buffers, frames, offsets);
+                 const uint64_t received = resolve_ingest_us(received_us);
+                 py::gil_scoped_release release;
+                 std::size_t accepted = 0;
+                 for (const std::span<char> frame : buffers.frames()) {
+                     accepted += pipeline.submit(frame, received) ? 1 : 0;
+                 }
+                 return accepted;
+             },
+             py::arg("frames"), py::arg("offsets") = py::none(), py::arg("received_us") = py::none(),
+             "Queue frames (copied) as a receive thread would, decode_batch input; returns how many were "
+             "accepted. Waits while a full block-policy lane has no room")
+        .def("take",
+             [](IngestPipeline& pipeline, const std::string& lane, std::size_t max_items,
+                double timeout) -> py::object {
+                 const PipelineLane source = pipeline_lane_from_name(lane);
+                 std::vector<PipelineItem> items;
+                 try {
+                     py::gil_scoped_release release;
+                     pipeline.take(source, items, max_items, static_cast<int>(timeout * 1000));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 if (items.empty()) {
+                     return py::none();
+                 }
+                 return pipeline_items_to_python(items);
+             },
+             py::arg("lane"), py::arg("max_items") = std::size_t{256}, py::arg("timeout") = 0.0,
+             "Records of up to max_items frames from a lane without a producer: payload, offsets, "
+             "partition_keys and received_us per record, or None if none arrived within timeout seconds")
+        .def_property_readonly("stats", &ingest_pipeline_stats_to_python);
+
+    py::class_<RecordCompressor>(m, "RecordCompressor",
+                                 "zstd compression of record payloads behind a codec header, with an optional "
+                                 "trained dictionary; not thread-safe")
+        .def(py::init([](const std::optional<py::buffer>& dictionary, int level) {
+                 std::optional<FrameBuffer> buffer;
+                 std::span<const char> dict;
+                 if (dictionary) {
+                     buffer.emplace(*dictionary);
+                     dict = buffer->payload();
+                 }
+                 try {
+                     return std::make_unique<RecordCompressor>(dict, level);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("dictionary") = py::none(), py::arg("level") = 3)
+        .def("compress",
+             [](RecordCompressor& compressor, const py::buffer& data) -> py::object {
+                 FrameBuffer buffer{data};
+                 std::vector<char> out;
+                 try {
+                     if (!compressor.compress(buffer.payload(), out)) {
+                         return data;
+                     }
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 return py::bytes(out.data(), out.size());
+             },
+             py::arg("data"), "The compressed payload, or the payload itself when compressing would not shrink it")
+        .def_property_readonly("dictionary_id", &RecordCompressor::dictionary_id)
+        .def_property_readonly("level", &RecordCompressor::level);
+
+    py::class_<RecordDecompressor>(m, "RecordDecompressor",
+                                   "Reverses RecordCompressor with any of its dictionaries; not thread-safe")
+        .def(py::init([](const std::vector<py::buffer>& dictionaries) {
+                 auto decompressor = std::make_unique<RecordDecompressor>();
+                 for (const py::buffer& dictionary : dictionaries) {
+                     FrameBuffer buffer{dictionary};
+                     try {
+                         decompressor->add_dictionary(buffer.payload());
+                     } catch (const std::runtime_error& e) {
+                         throw py::value_error(e.what());
+                     }
+                 }
+                 return decompressor;
+             }),
+             py::arg("dictionaries") = std::vector<py::buffer>{})
+        .def(
+            "add_dictionary",
+            [](RecordDecompressor& decompressor, const py::buffer& dictionary) {
+                FrameBuffer buffer{dictionary};
+                try {
+                    return decompressor.add_dictionary(buffer.payload());
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("dictionary"), "Accept records compressed with this dictionary; returns its id")
+        .def("decompress",
+             [](RecordDecompressor& decompressor, const py::buffer& data) -> py::object {
+                 FrameBuffer buffer{data};
+                 if (!is_compressed_record(buffer.payload())) {
+                     return data;
+                 }
+                 std::vector<char> out;
+                 try {
+                     decompressor.decompress(buffer.payload(), out);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 return py::bytes(out.data(), out.size());
+             },
+             py::arg("data"),
+             "The original payload; a payload without a codec header is returned as is. Raises ValueError on a "
+             "corrupt record or an unknown dictionary")
+        .def_property_readonly("dictionary_ids", &RecordDecompressor::dictionary_ids);
+    m.def(
+        "is_compressed_record",
+        [](const py::buffer& data) {
+            FrameBuffer buffer{data};
+            return is_compressed_record(buffer.payload());
+        },
+        py::arg("data"), "True when the payload starts with a RecordCompressor codec header");
+
+    py::class_<DepthDeltaEncoder>(m, "DepthDeltaEncoder",
+                                  "Per-symbol top-N depth as records holding only the levels changed since the "
+                                  "last one, with periodic keyframes; not thread-safe")
+        .def(py::init([](std::size_t levels, uint32_t keyframe_interval) {
+                 try {
+                     return std::make_unique<DepthDeltaEncoder>(DepthDeltaConfig{levels, keyframe_interval});
+                 } catch (const std::invalid_argument& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("levels") = 20, py::arg("keyframe_interval") = 100)
+        .def(
+            "encode",
+            [](DepthDeltaEncoder& encoder, const std::string& symbol,
+               const std::vector<std::pair<int64_t, int64_t>>& bids,
+               const std::vector<std::pair<int64_t, int64_t>>& asks, int8_t price_exponent, int8_t qty_exponent,
+               uint64_t event_ts_us, uint64_t update_id, const std::optional<uint64_t>& ingest_ts_us) -> py::object {
+                const std::vector<BookLevel> bid_levels = book_levels_from_python(bids);
+                const std::vector<BookLevel> ask_levels = book_levels_from_python(asks);
+                DepthTop top;
+                top.symbol = symbol;
+                top.event_time_us = event_ts_us;
+                top.ingest_us = resolve_ingest_us(ingest_ts_us);
+                top.update_id = update_id;
+                top.price_exponent = price_exponent;
+                top.qty_exponent = qty_exponent;
+                top.bids = bid_levels;
+                top.asks = ask_levels;
+                // Header and two ten-byte varints per change, at most 2N changes a side
+                std::vector<char> out(512 + 80 * encoder.config().levels);
+                RecordWriter writer{std::span<char>(out)};
+                try {
+                    if (!encoder.encode(top, writer)) {
+                        return py::none();
+                    }
+                } catch (const std::invalid_argument& e) {
+                    throw py::value_error(e.what());
+                }
+                return py::bytes(out.data(), writer.size());
+            },
+            py::arg("symbol"), py::arg("bids"), py::arg("asks"), py::arg("price_exponent"), py::arg("qty_exponent"),
+            py::arg("event_ts_us"), py::arg("update_id") = 0, py::arg("ingest_ts_us") = py::none(),
+            "The record for a top-N given as best-first (price, qty) mantissa pairs, or None when it did not "
+            "change since the symbol's last record")
+        .def("force_keyframes", &DepthDeltaEncoder::force_keyframes, "Make the next record of every symbol a keyframe")
+        .def_property_readonly("levels", [](const DepthDeltaEncoder& encoder) { return encoder.config().levels; })
+        .def_property_readonly("keyframe_interval",
+                               [](const DepthDeltaEncoder& encoder) { return encoder.config().keyframe_interval; })
+        .def_property_readonly("stats", [](const DepthDeltaEncoder& encoder) {
+            const DepthDeltaEncoderStats& stats = encoder.stats();
+            py::dict result;
+            result["records"] = stats.records;
+            result["keyframes"] = stats.keyframes;
+            result["bytes"] = stats.bytes;
+            result["unchanged"] = stats.unchanged;
+            result["resyncs"] = stats.resyncs;
+            return result;
+        });
+
+    py::class_<DepthDeltaDecoder>(m, "DepthDeltaDecoder",
+                                  "Rebuilds the top-N from DepthDeltaEncoder records; not thread-safe")
+        .def(py::init<>())
+        .def(
+            "decode",
+            [](DepthDeltaDecoder& decoder, const py::buffer& data) -> py::object {
+                FrameBuffer buffer{data};
+                DepthDeltaRecord record;
+                try {
+                    if (decoder.decode(buffer.payload(), record) == DepthDeltaStatus::NeedKeyframe) {
+                        return py::none();
+                    }
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+                return depth_delta_to_python(record);
+            },
+            py::arg("data"),
+            "The symbol's rebuilt top-N as a depth record dict, or None while it waits for a keyframe after a "
+            "lost record. Raises ValueError on a malformed record")
+        .def_property_readonly("stats", [](const DepthDeltaDecoder& decoder) {
+            const DepthDeltaDecoderStats& stats = decoder.stats();
+            py::dict result;
+            result["keyframes"] = stats.keyframes;
+            result["deltas"] = stats.deltas;
+            result["refused"] = stats.refused;
+            return result;
+        });
+    m.def(
+        "is_depth_delta_record",
+        [](const py::buffer& data) {
+            FrameBuffer buffer{data};
+            return is_depth_delta_record(buffer.payload());
+        },
+        py::arg("data"), "True when the payload is a DepthDeltaEncoder record");
+    m.def(
+        "train_record_dictionary",
+        [](const std::vector<py::bytes>& samples, std::size_t dict_size) {
+            std::vector<char> joined;
+            std::vector<std::size_t> sizes;
+            for (const py::bytes& sample : samples) {
+                const std::string_view view = sample;
+                joined.insert(joined.end(), view.begin(), view.end());
+                sizes.push_back(view.size());
+            }
+            try {
+                const std::vector<char> dictionary = train_record_dictionary(joined, sizes, dict_size);
+                return py::bytes(dictionary.data(), dictionary.size());
+            } catch (const std::runtime_error& e) {
+                throw py::value_error(e.what());
+            }
+        },
+        py::arg("samples"), py::arg("dict_size") = 16384,
+        "Train a zstd dictionary for RecordCompressor on sample payloads (a few hundred at least)");
+    m.def(
+        "train_record_dictionary_from_journal",
+        [](const std::vector<std::string>& paths, std::size_t dict_size, std::size_t max_samples,
+           const std::string& format, bool all_records) {
+            const RecordFormat record_format = record_format_from_name(format, "train_record_dictionary_from_journal");
+            std::vector<char> dictionary;
+            try {
+                py::gil_scoped_release release;
+                dictionary = train_dictionary_from_journals(paths, dict_size, max_samples, record_format, all_records);
+            } catch (const std::runtime_error& e) {
+                throw py::value_error(e.what());
+            }
+            return py::bytes(dictionary.data(), dictionary.size());
+        },
+        py::arg("paths"), py::arg("dict_size") = 16384, py::arg("max_samples") = 100000,
+        py::arg("format") = "json", py::arg("all_records") = false,
+        "Train a zstd dictionary on the records serialize_records writes for the frames of capture journals "
+        "(files or directories): depth records only unless all_records");
+
+    py::class_<ArrowBatch>(m, "ArrowBatch",
+                           "Decoded columns as an Arrow record batch (struct array) through the Arrow PyCapsule "
+                           "Interface: pyarrow.record_batch(batch) and polars.from_arrow take it without a copy")
+        .def("__arrow_c_schema__", &arrow_schema_capsule)
+        .def("__arrow_c_array__",
+             [](const ArrowBatch& batch, const py::object& /*requested_schema*/) {
+                 return py::make_tuple(arrow_schema_capsule(batch), arrow_array_capsule(batch));
+             },
+             py::arg("requested_schema") = py::none(),
+             "(schema, array) capsules; requested_schema is ignored, the columns keep their decoded types")
+        .def_property_readonly("num_rows", &ArrowBatch::rows)
+        .def_property_readonly("column_names",
+                               [](const ArrowBatch& batch) {
+                                   std::vector<std::string> names;
+                                   for (std::size_t i = 0; i < batch.column_count(); ++i) {
+                                       names.push_back(batch.column_name(i));
+                                   }
+                                   return names;
+                               })
+        .def("__len__", &ArrowBatch::rows);
+
+    py::class_<ParquetWriter>(m, "ParquetWriter",
+                              "Buffers rows column by column and encodes them as one Parquet file (dictionary "
+                              "encoding, zstd pages); not thread-safe")
+        .def(py::init([](const std::vector<std::pair<std::string, std::string>>& columns,
+                         const std::string& compression, int level, std::size_t row_group_size) {
+                 if (compression != "zstd" && compression != "none") {
+                     throw py::value_error("ParquetWriter: compression must be 'zstd' or 'none'");
+                 }
+                 try {
+                     return std::make_unique<ParquetWriter>(
+                         column_specs_from_python(columns), compression == "zstd" ? ParquetCompression::ZSTD : ParquetCompression::NONE,
+                         level, row_group_size);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("columns"), py::arg("compression") = "zstd", py::arg("level") = 3,
+             py::arg("row_group_size") = PARQUET_DEFAULT_ROW_GROUP_SIZE,
+             "columns: (name, type) pairs, type one of int64, float64, bool, string, timestamp_ms")
+        .def("append_rows", &parquet_append_rows, py::arg("rows"),
+             "Buffer mappings holding every column; nothing is kept when one fails to convert")
+        .def("append_columns", &parquet_append_columns, py::arg("columns"),
+             "Buffer equal-length arrays or sequences by column name (a str fills a string column)")
+        .def("finish",
+             [](ParquetWriter& writer) {
+                 std::vector<char> file;
+                 try {
+                     py::gil_scoped_release release;
+                     file = writer.finish();
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 return py::bytes(file.data(), file.size());
+             },
+             "The Parquet file of everything buffered, then start over")
+        .def("clear", &ParquetWriter::clear)
+        .def("__len__", &ParquetWriter::rows)
+        .def_property_readonly("columns",
+                               [](const ParquetWriter& writer) {
+                                   py::list result;
+                                   for (std::size_t i = 0; i < writer.column_count(); ++i) {
+                                       result.append(py::make_tuple(writer.spec(i).name,
+                                                                    parquet_type_name(writer.spec(i).type)));
+                                   }
+                                   return result;
+                               })
+        .def_property_readonly("row_group_size", &ParquetWriter::row_group_size);
+
+    py::class_<TickStoreWriter>(m, "TickStoreWriter",
+                                "Appends decoded stream messages to the columnar tick store: one file per stream "
+                                "(trades, bba, depth, book), symbol and UTC day, in compressed column blocks; "
+                                "not thread-safe")
+        .def(py::init([](const std::string& root, std::size_t block_rows, const std::string& compression, int level) {
+                 if (compression != "zstd" && compression != "none") {
+                     throw py::value_error("TickStoreWriter: compression must be 'zstd' or 'none'");
+                 }
+                 try {
+                     return std::make_unique<TickStoreWriter>(
+                         TickStoreConfig{root, block_rows, compression == "zstd", level});
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("root"), py::arg("block_rows") = TICK_DEFAULT_BLOCK_ROWS, py::arg("compression") = "zstd",
+             py::arg("level") = 3,
+             "compression 'none' stores columns uncompressed, which TickFile.read_block returns as views of the "
+             "file")
+        .def(
+            "append",
+            [](TickStoreWriter& writer, const py::buffer& data, const std::optional<uint64_t>& ingest_ts_us) {
+                FrameBuffer buffer{data};
+                try {
+                    return writer.append_buffer(buffer.payload(), resolve_ingest_us(ingest_ts_us));
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("data"), py::arg("ingest_ts_us") = py::none(),
+            "Store the rows of every stream message in a buffer; returns how many messages were stored")
+        .def(
+            "append_journals",
+            [](TickStoreWriter& writer, const std::vector<std::string>& paths) {
+                try {
+                    py::gil_scoped_release release;
+                    return writer.append_journals(paths);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("paths"),
+            "Store every record of capture journals (files or directories), merged by receive time; returns the "
+            "number of records read")
+        .def(
+            "flush",
+            [](TickStoreWriter& writer) {
+                try {
+                    writer.flush();
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            "Write every partial block")
+        .def(
+            "close",
+            [](TickStoreWriter& writer) {
+                try {
+                    writer.close();
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            "Flush and close every file; later appends reopen them")
+        .def_property_readonly("paths", &TickStoreWriter::paths, "Files written to, in first-write order")
+        .def_property_readonly(
+            "stats", [](const TickStoreWriter& writer) { return tick_store_stats_to_python(writer.stats()); });
+
+    py::class_<TickFileReader>(m, "TickFile", "Read-only memory map of one tick store file")
+        .def(py::init([](const std::string& path) {
+                 try {
+                     return std::make_unique<TickFileReader>(path);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("path"))
+        .def("read", &tick_file_read, py::arg("columns") = py::none(),
+             "Columns (all by default) of every block as one array each, by name")
+        .def("read_block", &tick_block_read, py::arg("block"), py::arg("columns") = py::none(),
+             "Columns of one block, by name: read-only views of the mapped file for uncompressed columns, "
+             "decoded arrays otherwise")
+        .def(
+            "block_info", [](const TickFileReader& reader, std::size_t block) {
+                if (block >= reader.blocks()) {
+                    throw py::index_error("TickFile.block_info: block out of range");
+                }
+                return tick_block_info_to_python(reader.block(block));
+            },
+            py::arg("block"), "rows, bytes and min/max event time and update or trade ID of one block")
+        .def("read_range", &tick_range_read, py::arg("start") = py::none(), py::arg("end") = py::none(),
+             py::arg("columns") = py::none(), py::arg("key") = "event_time",
+             "Columns of the rows whose event time (key='event_time', us) or update/trade ID (key='id') lies in "
+             "[start, end], either bound open when None; only the blocks overlapping the range are decoded")
+        .def(
+            "range_blocks",
+            [](const TickFileReader& reader, const std::optional<int64_t>& start, const std::optional<int64_t>& end,
+               const std::string& key) {
+                const auto [from, to] = tick_range_bounds(start, end);
+                return reader.range_blocks(tick_range_key(key), from, to);
+            },
+            py::arg("start") = py::none(), py::arg("end") = py::none(), py::arg("key") = "event_time",
+            "Indices of the blocks read_range would decode, found by binary search of the sparse index")
+        .def_property_readonly("stream", [](const TickFileReader& reader) { return tick_stream_name(reader.stream()); })
+        .def_property_readonly("symbol", [](const TickFileReader& reader) { return std::string(reader.symbol()); })
+        .def_property_readonly("day", [](const TickFileReader& reader) { return tick_day_name(reader.day()); })
+        .def_property_readonly("columns",
+                               [](const TickFileReader& reader) {
+                                   py::list result;
+                                   for (const TickColumnSpec& spec : reader.columns()) {
+                                       result.append(spec.name);
+                                   }
+                                   return result;
+                               })
+        .def_property_readonly("blocks", &TickFileReader::blocks)
+        .def_property_readonly("indexed_blocks", &TickFileReader::indexed_blocks,
+                               "Blocks found in the .idx sparse index rather than by walking the file")
+        .def_property_readonly("trailing_bytes", &TickFileReader::trailing_bytes,
+                               "Bytes past the last complete block: one being written, or cut short by a crash")
+        .def_property_readonly("path", &TickFileReader::path)
+        .def("__len__", &TickFileReader::rows);
+
+    m.def("forward_labels", &forward_labels_to_python, py::arg("timestamp_us"), py::arg("price"),
+          py::arg("horizons_seconds") = std::vector<double>{10},
+          "Forward labels per horizon ('10s': dict) for every row of a sorted timestamp_us column and its price "
+          "or mid column: forward_price (the price standing h later), forward_return, and max_up / max_down, "
+          "the largest move above and below the row's price within h, all float64 and NaN where h runs past "
+          "the last timestamp; raises ValueError on unsorted timestamps");
+
+    py::class_<TrainingLoader>(m, "TrainingLoader",
+                               "Minibatches of windowed feature rows and 10-second-ahead labels from the tick "
+                               "store, assembled and prefetched on background threads")
+        .def(py::init([](const std::string& root, const std::vector<std::string>& symbols,
+                         const std::vector<std::string>& days, std::size_t window, double step_seconds,
+                         double label_horizon_seconds, std::size_t batch_size, std::size_t prefetch,
+                         std::size_t threads, bool shuffle, uint64_t seed, bool drop_last,
+                         const std::vector<double>& horizons_seconds) {
+                 TrainingLoaderConfig config;
+                 config.root = root;
+                 config.symbols = symbols;
+                 config.days = days;
+                 config.window = window;
+                 config.step_ms = std::llround(step_seconds * 1e3);
+                 config.label_horizon_ms = std::llround(label_horizon_seconds * 1e3);
+                 config.batch_size = batch_size;
+                 config.prefetch = prefetch;
+                 config.threads = threads;
+                 config.shuffle = shuffle;
+                 config.seed = seed;
+                 config.drop_last = drop_last;
+                 config.horizons_ms = seconds_to_ms(horizons_seconds);
+                 return std::make_unique<TrainingLoader>(std::move(config));
+             }),
+             py::arg("root"), py::arg("symbols"), py::arg("days"), py::arg("window") = 32,
+             py::arg("step_seconds") = 1.0, py::arg("label_horizon_seconds") = 10.0, py::arg("batch_size") = 256,
+             py::arg("prefetch") = 4, py::arg("threads") = 2, py::arg("shuffle") = true, py::arg("seed") = 1,
+             py::arg("drop_last") = true, py::arg("horizons_seconds") = std::vector<double>{1, 2, 10, 60})
+        .def("__iter__", [](TrainingLoader& loader) -> TrainingLoader& { return loader; })
+        .def(
+            "__next__",
+            [](TrainingLoader& loader) {
+                TrainingBatch batch;
+                bool more = false;
+                try {
+                    py::gil_scoped_release release;
+                    more = loader.next(batch);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+                if (!more) {
+                    throw py::stop_iteration();
+                }
+                return training_batch_to_python(loader, batch);
+            },
+            "The epoch's next batch: features (rows, window, features) float32, labels (rows,) float32 mid "
+            "returns, timestamp_us and symbol (index into symbols). Arrays are views of a page-locked buffer that "
+            "returns to the pool once they are freed; iteration stops at the end of each epoch")
+        .def_property_readonly("feature_names", &TrainingLoader::feature_names)
+        .def_property_readonly("symbols", [](const TrainingLoader& loader) { return loader.config().symbols; })
+        .def_property_readonly(
+            "samples",
+            [](TrainingLoader& loader) {
+                try {
+                    py::gil_scoped_release release;
+                    loader.wait_ready();
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+                return loader.samples();
+            },
+            "Samples per epoch, once every symbol and day is assembled")
+        .def("__len__",
+             [](TrainingLoader& loader) {
+                 try {
+                     py::gil_scoped_release release;
+                     loader.wait_ready();
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 return loader.batches_per_epoch();
+             })
+        .def_property_readonly("epoch", &TrainingLoader::epoch)
+        .def_property_readonly("stats", &training_loader_stats_to_python);
+
+    py::class_<BookSampler>(m, "BookSampler",
+                            "Replays one symbol's depth through an OrderBook and writes its top levels every "
+                            "interval into a preallocated float32 (samples, 2, levels, 2) array: [t, 0] bids and "
+                            "[t, 1] asks from the touch, each level (price - mid) / tick_size and qty")
+        .def(py::init(&make_book_sampler), py::arg("symbol"), py::arg("out"), py::arg("tick_size"),
+             py::arg("interval_seconds") = 1.0, py::arg("start_us") = py::none(), py::keep_alive<1, 3>())
+        .def(
+            "sample_journals",
+            [](BookSampler& sampler, const std::vector<std::string>& paths) {
+                try {
+                    py::gil_scoped_release release;
+                    return sampler.sample_journals(paths);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("paths"),
+            "Replay the depth frames of capture journals (directories expand to *.sbej), merged by receive time; "
+            "returns the samples written so far")
+        .def(
+            "sample_tick_store",
+            [](BookSampler& sampler, const std::string& root, const std::string& day) {
+                const int32_t parsed = tick_day_parse(day);
+                try {
+                    py::gil_scoped_release release;
+                    return sampler.sample_tick_store(root, parsed);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("root"), py::arg("day"),
+            "Replay one 'YYYY-MM-DD' day of the tick store's depth and book files; the book carries over, so "
+            "consecutive days continue it. Returns the samples written so far")
+        .def_property_readonly("rows", &BookSampler::rows)
+        .def_property_readonly("full", &BookSampler::full)
+        .def_property_readonly("timestamp_us",
+                               [](const BookSampler& sampler) {
+                                   return column_to_numpy(std::vector(sampler.timestamps_us()));
+                               })
+        .def_property_readonly("mid_price",
+                               [](const BookSampler& sampler) { return column_to_numpy(std::vector(sampler.mids())); },
+                               "NaN for samples without a book")
+        .def_property_readonly("valid",
+                               [](const BookSampler& sampler) { return flags_to_numpy(std::vector(sampler.valid())); },
+                               "False for samples taken while the book was one-sided or waiting for a resync")
+        .def_property_readonly("stats", &book_sampler_stats_to_python);
+
+    py::class_<NdjsonParser>(m, "NdjsonParser",
+                             "Parses JSONL archive objects into typed columns on several threads; "
+                             "schemas as for ParquetWriter, a side column expands depth bids/asks to level rows")
+        .def(py::init([](const std::vector<std::pair<std::string, std::string>>& columns) {
+                 try {
+                     return std::make_unique<NdjsonParser>(column_specs_from_python(columns));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("columns"))
+        .def("parse",
+             [](const NdjsonParser& parser, const py::buffer& data, unsigned threads) {
+                 FrameBuffer buffer{data};
+                 NdjsonTable table;
+                 {
+                     py::gil_scoped_release release;
+                     table = parser.parse(buffer.payload(), threads);
+                 }
+                 return ndjson_table_to_python(parser, std::move(table));
+             },
+             py::arg("data"), py::arg("threads") = 0,
+             "{'columns', 'rows', 'lines', 'bad_lines', 'missing'} for a decompressed JSONL buffer, parsed with "
+             "the GIL released on up to `threads` threads (0 = one per core); bad lines are skipped, missing "
+             "values are 0, NaN, False or '' and flagged in missing[name]")
+        .def_property_readonly("columns", [](const NdjsonParser& parser) {
+            py::list result;
+            for (const auto& spec : parser.columns()) {
+                result.append(py::make_tuple(spec.name, parquet_type_name(spec.type)));
+            }
+            return result;
+        });
+
+    py::class_<IdIntervalSet>(m, "IdIntervalSet",
+                              "Captured trade or update IDs of one symbol as merged closed ranges, and the "
+                              "fromId/limit requests that fill the holes")
         .def(py::init<>())
-        .def("decode_message", &SBEDecoder::decode_message, "Decode SBE message")
-        .def("get_message_type", &SBEDecoder::get_message_type, "Get SBE message template ID")
-        .def("is_valid_message", &SBEDecoder::is_valid_message, "Validate SBE message format");
+        .def("add",
+             [](IdIntervalSet& set, int64_t first, int64_t last) {
+                 try {
+                     set.add(first, last);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("first"), py::arg("last"), "Record IDs first..last (inclusive) as captured")
+        .def("add_ids",
+             [](IdIntervalSet& set, const Int64Column& ids) {
+                 set.add_ids({ids.data(), static_cast<std::size_t>(ids.size())});
+             },
+             py::arg("ids"), "Record a column of captured IDs, in any order")
+        .def("__contains__", &IdIntervalSet::contains, py::arg("id"))
+        .def("missing",
+             [](const IdIntervalSet& set, int64_t first, int64_t last) {
+                 py::list holes;
+                 for (const auto& hole : set.missing(first, last)) {
+                     holes.append(py::make_tuple(hole.first, hole.last));
+                 }
+                 return holes;
+             },
+             py::arg("first"), py::arg("last"), "Uncaptured (first, last) ranges within first..last")
+        .def("plan",
+             [](const IdIntervalSet& set, int64_t first, int64_t last, int64_t limit) {
+                 std::vector<IdRequest> requests;
+                 try {
+                     requests = set.plan(first, last, limit);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 py::list result;
+                 for (const auto& request : requests) {
+                     result.append(py::make_tuple(request.from_id, request.limit));
+                 }
+                 return result;
+             },
+             py::arg("first"), py::arg("last"), py::arg("limit") = 1000,
+             "The fewest (from_id, limit) requests that fetch every uncaptured ID in first..last")
+        .def_property_readonly("intervals",
+                               [](const IdIntervalSet& set) {
+                                   py::list result;
+                                   for (const auto& interval : set.intervals()) {
+                                       result.append(py::make_tuple(interval.first, interval.last));
+                                   }
+                                   return result;
+                               })
+        .def_property_readonly("count", &IdIntervalSet::count, "Captured IDs in total")
+        .def("__len__", [](const IdIntervalSet& set) { return set.intervals().size(); })
+        .def("clear", &IdIntervalSet::clear);
+
+    py::class_<PgCopyWriter>(m, "PgCopyWriter",
+                             "Encodes rows as PostgreSQL binary COPY data for copy_to_table(format='binary'); "
+                             "not thread-safe")
+        .def(py::init([](const std::vector<std::pair<std::string, std::string>>& columns) {
+                 try {
+                     std::vector<PgColumnSpec> specs;
+                     for (const auto& [name, type] : columns) {
+                         specs.push_back({name, pg_type_from_name(type)});
+                     }
+                     return std::make_unique<PgCopyWriter>(std::move(specs));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("columns"),
+             "columns: (name, type) pairs in COPY column order, type one of int8, int4, bool, text, numeric, "
+             "timestamp")
+        .def("append_columns", &pg_copy_append_columns, py::arg("columns"),
+             "Encode equal-length arrays or sequences by column name; absent columns, None and float NaN are "
+             "NULL, numerics are exact from int/Decimal/str, timestamps take naive datetimes or Unix "
+             "microseconds")
+        .def("finish",
+             [](PgCopyWriter& writer) {
+                 std::vector<char> data;
+                 try {
+                     data = writer.finish();
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 return py::bytes(data.data(), data.size());
+             },
+             "The COPY data of every row so far, then start over")
+        .def("clear", &PgCopyWriter::clear)
+        .def("__len__", &PgCopyWriter::rows)
+        .def_property_readonly("columns", [](const PgCopyWriter& writer) {
+            py::list result;
+            for (const auto& spec : writer.columns()) {
+                result.append(py::make_tuple(spec.name, pg_type_name(spec.type)));
+            }
+            return result;
+        });
+
+    py::class_<TradeRing>(m, "TradeRing")
+        .def(py::init<std::size_t>(), py::arg("capacity") = 1000)
+        .def("append", &TradeRing::push, py::arg("event_ts"), py::arg("price"), py::arg("qty"),
+             py::arg("is_buyer_maker"), "Buffer one trade; overwrites the oldest when full")
+        .def("features",
+             [](const TradeRing& ring) { return features_or_empty(ring, trade_features_to_python); },
+             "FeatureBuilder._build_trade_features over the buffered trades, computed in place")
+        .def("columns",
+             [](const TradeRing& ring) {
+                 py::dict columns;
+                 columns["event_ts"] = ring_column_to_numpy(ring.index(), ring.event_ts());
+                 columns["price"] = ring_column_to_numpy(ring.index(), ring.price());
+                 columns["qty"] = ring_column_to_numpy(ring.index(), ring.qty());
+                 std::vector<uint8_t> flags;
+                 flags.reserve(ring.size());
+                 for (std::size_t i = 0; i < ring.size(); ++i) {
+                     flags.push_back(ring.is_buyer_maker()[ring.index().slot(i)]);
+                 }
+                 columns["is_buyer_maker"] = flags_to_numpy(std::move(flags));
+                 return columns;
+             },
+             "The buffered trades as NumPy columns, oldest first (copies)")
+        .def("clear", &TradeRing::clear)
+        .def_property_readonly("capacity", [](const TradeRing& ring) { return ring.index().capacity(); })
+        .def_property_readonly("overwritten", [](const TradeRing& ring) { return ring.index().overwritten(); })
+        .def("__len__", &TradeRing::size);
+
+    py::class_<QuoteRing>(m, "QuoteRing")
+        .def(py::init<std::size_t>(), py::arg("capacity") = 1000)
+        .def("append", &QuoteRing::push, py::arg("event_ts"), py::arg("bid_px"), py::arg("bid_sz"),
+             py::arg("ask_px"), py::arg("ask_sz"), "Buffer one best bid/ask update; overwrites the oldest when full")
+        .def("features",
+             [](const QuoteRing& ring) { return features_or_empty(ring, quote_features_to_python); },
+             "FeatureBuilder._build_orderbook_features over the buffered updates, computed in place")
+        .def("columns",
+             [](const QuoteRing& ring) {
+                 py::dict columns;
+                 columns["event_ts"] = ring_column_to_numpy(ring.index(), ring.event_ts());
+                 columns["bid_px"] = ring_column_to_numpy(ring.index(), ring.bid_px());
+                 columns["bid_sz"] = ring_column_to_numpy(ring.index(), ring.bid_sz());
+                 columns["ask_px"] = ring_column_to_numpy(ring.index(), ring.ask_px());
+                 columns["ask_sz"] = ring_column_to_numpy(ring.index(), ring.ask_sz());
+                 return columns;
+             },
+             "The buffered updates as NumPy columns, oldest first (copies)")
+        .def("clear", &QuoteRing::clear)
+        .def_property_readonly("capacity", [](const QuoteRing& ring) { return ring.index().capacity(); })
+        .def_property_readonly("overwritten", [](const QuoteRing& ring) { return ring.index().overwritten(); })
+        .def("__len__", &QuoteRing::size);
+
+    py::class_<RecordIngestor>(m, "RecordIngestor",
+                               "GetRecords payloads straight into per-symbol TradeRing/QuoteRing buffers, which it "
+                               "creates and owns; not thread-safe")
+        .def(py::init([](std::size_t capacity, const std::vector<double>& horizons_seconds, double pane_seconds,
+                         const std::vector<py::buffer>& dictionaries,
+                         const std::vector<double>& quantile_horizons_seconds) {
+                 try {
+                     auto ingestor = std::make_unique<RecordIngestor>(capacity, seconds_to_ms(horizons_seconds),
+                                                                      std::llround(pane_seconds * 1e3),
+                                                                      seconds_to_ms(quantile_horizons_seconds));
+                     for (const py::buffer& dictionary : dictionaries) {
+                         FrameBuffer buffer{dictionary};
+                         ingestor->add_dictionary(buffer.payload());
+                     }
+                     return ingestor;
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("capacity") = 1000, py::arg("horizons_seconds") = std::vector<double>{1, 2, 10, 60},
+             py::arg("pane_seconds") = 0.0, py::arg("dictionaries") = std::vector<py::buffer>{},
+             py::arg("quantile_horizons_seconds") = std::vector<double>{},
+             "Rings of `capacity` rows and a MultiHorizonWindow per traded symbol; `dictionaries` are the zstd "
+             "dictionaries of compressed records. With quantile_horizons_seconds each symbol also gets a "
+             "QuantileWindow over its trades and quotes")
+        .def("ingest", &ingest_kinesis_records, py::arg("records"),
+             "Deaggregate, decompress and decode a GetRecords 'Records' list into the rings; returns the "
+             "(partition key, payload) pairs of the records with no ring (depth), for the dict path. Malformed "
+             "records are counted and dropped")
+        .def(
+            "take_new_buffers",
+            [](py::object self) {
+                auto& ingestor = self.cast<RecordIngestor&>();
+                const auto policy = py::return_value_policy::reference_internal;
+                py::list result;
+                for (const auto& buffer : ingestor.take_new_buffers()) {
+                    if (buffer.kind == IngestKind::Trades) {
+                        auto* trades = ingestor.trades(buffer.symbol);
+                        result.append(py::make_tuple(buffer.symbol, "trade", py::cast(&trades->ring, policy, self),
+                                                     py::cast(&trades->window, policy, self)));
+                    } else {
+                        result.append(py::make_tuple(buffer.symbol, "bestBidAsk",
+                                                     py::cast(ingestor.quotes(buffer.symbol), policy, self),
+                                                     py::none()));
+                    }
+                }
+                return result;
+            },
+            "(symbol, message type, ring, window or None) for each buffer created since the last call; they "
+            "live as long as the ingestor")
+        .def(
+            "quantile_window",
+            [](py::object self, const std::string& symbol) -> py::object {
+                QuantileWindow* window = self.cast<RecordIngestor&>().quantiles(symbol);
+                if (window == nullptr) {
+                    return py::none();
+                }
+                return py::cast(window, py::return_value_policy::reference_internal, self);
+            },
+            py::arg("symbol"), "The symbol's QuantileWindow, None before its first trade or quote")
+        .def("restore_windows", &RecordIngestor::restore_windows, py::arg("checkpoint"),
+             "Restore the trade windows of a WindowCheckpoint saved with the same horizons, creating their "
+             "buffers (returned by take_new_buffers); returns the number restored")
+        .def_property_readonly(
+            "counts", [](const RecordIngestor& ingestor) { return ingest_counts_to_python(ingestor.counts()); },
+            "Records, payloads, trades, quotes, returned, skipped (Avro depth) and errors so far")
+        .def_property_readonly("dictionary_ids", &RecordIngestor::dictionary_ids);
+
+    py::enum_<ApplyStatus>(m, "ApplyStatus")
+        .value("APPLIED", ApplyStatus::Applied)
+        .value("STALE", ApplyStatus::Stale)
+        .value("GAP", ApplyStatus::Gap)
+        .value("BUFFERED", ApplyStatus::Buffered);
+
+    py::class_<OrderBook>(m, "OrderBook")
+        .def(py::init<std::string>(), py::arg("symbol") = "")
+        .def("apply", &apply_depth_frame, py::arg("data"),
+             "Apply a depth diff frame (template 10003); returns APPLIED, STALE or GAP. "
+             "A GAP leaves the book untouched and means it must be resynced from a snapshot: load_snapshot, "
+             "or a partial depth frame (template 10002), which only an empty or resync-pending book takes")
+        .def("load_snapshot",
+             [](OrderBook& book, uint64_t last_update_id,
+                const std::vector<std::pair<int64_t, int64_t>>& bids,
+                const std::vector<std::pair<int64_t, int64_t>>& asks,
+                int8_t price_exponent, int8_t qty_exponent) {
+                 const auto bid_levels = levels_from_python(bids);
+                 const auto ask_levels = levels_from_python(asks);
+                 book.load_snapshot(last_update_id, price_exponent, qty_exponent, bid_levels, ask_levels);
+             },
+             py::arg("last_update_id"), py::arg("bids"), py::arg("asks"),
+             py::arg("price_exponent"), py::arg("qty_exponent"),
+             "Replace the book with (price_mantissa, qty_mantissa) levels taken at last_update_id")
+        .def("load_depth_response", &load_depth_response_frame, py::arg("data"),
+             "Replace the book with a REST depth snapshot frame (DepthResponse, template 200), read in place")
+        .def("load_depth_json", &load_depth_json_body, py::arg("data"),
+             "Replace the book with a raw /api/v3/depth JSON body (bytes), parsed without building Python "
+             "objects; prices and quantities keep their exact decimal digits")
+        .def("top_bids",
+             [](const OrderBook& book, std::size_t n) {
+                 return book_side_to_python(book.bids(), n, book.price_exponent(), book.qty_exponent());
+             },
+             py::arg("n") = 10, "Best n bids as (price, qty), highest first")
+        .def("top_asks",
+             [](const OrderBook& book, std::size_t n) {
+                 return book_side_to_python(book.asks(), n, book.price_exponent(), book.qty_exponent());
+             },
+             py::arg("n") = 10, "Best n asks as (price, qty), lowest first")
+        .def("bids_array",
+             [](const OrderBook& book, std::size_t n, const std::string& dtype) {
+                 return book_levels_array(book, BookSide::Bid, n, dtype);
+             },
+             py::arg("n") = 10, py::arg("dtype") = "int64",
+             "Best n bids, highest first, as a read-only (rows, 2) array of [price, qty]: mantissas at "
+             "price_exponent/qty_exponent ('int64') or decoded ('float64'). Reads between two book changes share "
+             "one buffer and copy nothing; an array keeps the levels it was taken at")
+        .def("asks_array",
+             [](const OrderBook& book, std::size_t n, const std::string& dtype) {
+                 return book_levels_array(book, BookSide::Ask, n, dtype);
+             },
+             py::arg("n") = 10, py::arg("dtype") = "int64", "Best n asks, lowest first, as bids_array")
+        .def("clear", &OrderBook::clear)
+        .def("set_tick_size", &OrderBook::set_tick_size, py::arg("tick_size"),
+             "Price tick (PRICE_FILTER tickSize, in price units) for spread_ticks; 0 uses one price mantissa unit")
+        .def("set_tick", &OrderBook::set_tick, py::arg("tick"), py::arg("exponent"),
+             "PRICE_FILTER tickSize as a mantissa at `exponent` (SymbolRulesTable.get()'s tick_size and "
+             "price_exponent): sets tick_size and indexes the levels near the touch by tick")
+        .def("track_order_flow", &OrderBook::track_order_flow, py::arg("levels") = 10,
+             "Sum order-flow imbalance at levels 1..levels (at most 20) and added/removed liquidity per side as "
+             "diffs are applied; 0 stops")
+        .def("take_order_flow", [](OrderBook& book) { return order_flow_to_python(book.take_order_flow()); },
+             "Order-flow sums since the last call as {ofi, bid_added, bid_removed, ask_added, ask_removed, "
+             "updates}, then reset them; quantities in base units")
+        .def_property_readonly("order_flow",
+                               [](const OrderBook& book) { return order_flow_to_python(book.order_flow().totals()); },
+                               "Order-flow sums since the last take_order_flow(), without resetting them")
+        .def_property_readonly("tick_size", &OrderBook::tick_size)
+        .def_property_readonly("features", &book_features_to_numpy,
+                               "Book features as of the last applied update, laid out as BOOK_FEATURE_NAMES "
+                               "(all NaN while a side is empty)")
+        .def_property_readonly("best_bid", [](const OrderBook& book) { return best_level_to_python(book, book.bids()); })
+        .def_property_readonly("best_ask", [](const OrderBook& book) { return best_level_to_python(book, book.asks()); })
+        .def_property_readonly("symbol", &OrderBook::symbol)
+        .def_property_readonly("last_update_id", &OrderBook::last_update_id)
+        .def_property_readonly("resync_pending", &OrderBook::resync_pending)
+        .def_property_readonly("event_ts", [](const OrderBook& book) { return micros_to_millis(book.event_time_us()); })
+        .def_property_readonly("bid_levels", [](const OrderBook& book) { return book.bids().size(); })
+        .def_property_readonly("ask_levels", [](const OrderBook& book) { return book.asks().size(); })
+        .def_property_readonly("price_exponent", &OrderBook::price_exponent)
+        .def_property_readonly("qty_exponent", &OrderBook::qty_exponent)
+        .def_property_readonly("epoch", &OrderBook::epoch, "Bumped by every change to the levels")
+        .def("checksum", &OrderBook::checksum, py::arg("depth") = 0,
+             "64-bit checksum of the best `depth` levels of each side (0: all), kept up to date as levels change; "
+             "equal to depth_snapshot_checksum() of a snapshot the book is in sync with");
+
+    py::enum_<SyncResult>(m, "SyncResult")
+        .value("SYNCED", SyncResult::Synced)
+        .value("SNAPSHOT_TOO_OLD", SyncResult::SnapshotTooOld)
+        .value("GAP", SyncResult::Gap)
+        .value("IGNORED", SyncResult::Ignored);
+
+    py::class_<BookSync>(m, "BookSync")
+        .def(py::init<std::string, std::size_t>(), py::arg("symbol") = "",
+             py::arg("max_buffered_bytes") = BOOK_SYNC_DEFAULT_BUFFER)
+        .def("apply", &sync_apply_depth_frame, py::arg("data"),
+             "Apply a depth diff frame (template 10003) or buffer it during a resync; returns APPLIED, STALE, "
+             "GAP (the diff that starts a resync) or BUFFERED")
+        .def("load_depth_response", &sync_load_depth_response, py::arg("data"),
+             "End a resync with a REST depth snapshot frame (DepthResponse, template 200): SYNCED once the "
+             "buffered diffs are replayed, SNAPSHOT_TOO_OLD (nothing changed) or GAP (still buffering)")
+        .def("load_partial_depth", &sync_load_partial_depth, py::arg("data"),
+             "End a resync with a partial depth frame (template 10002); IGNORED by a live book")
+        .def("resync", &BookSync::resync, "Clear the book and buffer diffs until the next snapshot")
+        .def_property_readonly("book", py::overload_cast<>(&BookSync::book),
+                               py::return_value_policy::reference_internal)
+        .def_property_readonly("syncing", &BookSync::syncing)
+        .def_property_readonly("buffered", &BookSync::buffered)
+        .def_property_readonly("buffered_bytes", &BookSync::buffered_bytes)
+        .def_property_readonly("replayed", &BookSync::replayed)
+        .def_property_readonly("skipped", &BookSync::skipped)
+        .def_property_readonly("overflows", &BookSync::overflows);
+
+    py::enum_<DecodeStatus>(m, "DecodeStatus")
+        .value("OK", DecodeStatus::Ok)
+        .value("TOO_SHORT", DecodeStatus::TooShort)
+        .value("SCHEMA_MISMATCH", DecodeStatus::SchemaMismatch)
+        .value("UNKNOWN_TEMPLATE", DecodeStatus::UnknownTemplate)
+        .value("MALFORMED", DecodeStatus::Malformed);
+
+    py::class_<SubscriptionMask>(m, "SubscriptionMask",
+                                 "Native filter of SBE frames by template ID and symbol, for decode_batch and "
+                                 "StreamReceiver.set_subscription")
+        .def(py::init([](const std::vector<uint16_t>& templates, const std::vector<std::string>& symbols) {
+                 SubscriptionMask mask;
+                 for (const uint16_t id : templates) {
+                     mask.allow_template(id);
+                 }
+                 try {
+                     for (const auto& symbol : symbols) {
+                         mask.allow_symbol(symbol);
+                     }
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 return mask;
+             }),
+             py::arg("templates") = std::vector<uint16_t>{}, py::arg("symbols") = std::vector<std::string>{},
+             "Admit frames of these template IDs (e.g. DEPTH_DIFF_STREAM_EVENT) and symbols; an empty list "
+             "admits all of that kind. Frames too short to judge or whose symbol cannot be read are admitted, so "
+             "decoding still reports them")
+        .def("admits", [](const SubscriptionMask& mask, const py::buffer& frame) {
+                 FrameBuffer buffer{frame};
+                 return mask.admits(buffer.payload());
+             },
+             py::arg("frame"))
+        .def_property_readonly("templates", &SubscriptionMask::templates)
+        .def_property_readonly("symbols", [](const SubscriptionMask& mask) {
+            std::vector<std::string> names;
+            for (const uint16_t id : mask.symbol_ids()) {
+                names.emplace_back(symbol_table().name_of(id));
+            }
+            return names;
+        });
+
+    py::class_<SBEDecoder>(m, "SBEDecoder")
+        .def(py::init<bool, bool, bool, bool, uint32_t, bool, bool>(), py::arg("debug") = false,
+             py::arg("level_arrays") = false, py::arg("decimal_strings") = false,
+             py::arg("alloc_accounting") = false, py::arg("perf_sample_every") = 0, py::arg("trace") = false,
+             py::arg("stream_msg_types") = false,
+             "alloc_accounting adds each template's heap and Python allocations during decode to get_stats; "
+             "perf_sample_every=N reads hardware counters (perf_event_open) around every Nth frame and adds "
+             "IPC and cycles/instructions/branch and cache misses per message; trace=True adds a 'trace' list "
+             "of TRACE_STAGES microsecond stamps with event, receive and decode filled in; stream_msg_types=True "
+             "names stream frames' msg_type by stream ('trade', 'bestBidAsk', 'depth', 'depth@100ms')")
+        .def_property_readonly("debug", &SBEDecoder::debug)
+        .def_property_readonly("level_arrays", &SBEDecoder::level_arrays)
+        .def_property_readonly("decimal_strings", &SBEDecoder::decimal_strings)
+        .def_property_readonly("alloc_accounting", &SBEDecoder::alloc_accounting)
+        .def_property_readonly("perf_sample_every", &SBEDecoder::perf_sample_every)
+        .def_property_readonly("trace", &SBEDecoder::trace)
+        .def_property_readonly("stream_msg_types", &SBEDecoder::stream_msg_types)
+        .def("arena_stats", &SBEDecoder::arena_stats,
+             "Level arena usage: blocks allocated so far and the current block's used/capacity levels")
+        .def(
+            "capture_frames",
+            [](SBEDecoder& decoder, std::size_t recent, uint32_t sample_every, std::size_t sampled,
+               std::size_t failed, std::size_t max_bytes) {
+                FrameCaptureConfig config;
+                config.recent = recent;
+                config.sample_every = sample_every;
+                config.sampled = sampled;
+                config.failed = failed;
+                config.max_bytes = max_bytes;
+                decoder.capture_frames(config);
+            },
+            py::arg("recent") = 64, py::arg("sample_every") = 0, py::arg("sampled") = 64, py::arg("failed") = 64,
+            py::arg("max_bytes") = 512,
+            "Keep raw frames decode_message and try_decode see, up to max_bytes of each: the last `recent`, "
+            "the last `sampled` of one in sample_every (0 = none) and the last `failed` that did not decode. "
+            "Replaces what was kept; all zero turns capture off")
+        .def("captured_frames", &SBEDecoder::captured_frames, py::arg("clear") = false,
+             "{'seen', 'recent', 'sampled', 'failed'}: per ring, oldest first, dicts of seq, received_us, size, "
+             "template_id, status and cause (DecodeStatus and parse error names), hex and truncated; None while "
+             "capture is off. clear=True empties the rings after reading")
+        .def("get_stats", &SBEDecoder::get_stats,
+             "Per-template messages, bytes, parse_errors (and parse_error_causes by failed check) and "
+             "decode-time p50/p99/p999/max/mean in ns (plus "
+             "allocations, alloc_bytes and py_allocations with alloc_accounting, and ipc and <counter>_per_msg "
+             "with perf_sample_every), and frames rejected as too short, another schema or an unknown template")
+        .def("reset_stats", &SBEDecoder::reset_stats, "Zero the counters and histograms of get_stats")
+        .def("decode_message", &SBEDecoder::decode_message, py::arg("data"),
+             "Decode SBE message from any bytes-like object (decoded in place, no copy)")
+        .def("try_decode", &SBEDecoder::try_decode, py::arg("data"), py::arg("ingest_ts_us") = py::none(),
+             "Validate and decode in one pass; returns a dict, or a DecodeStatus on failure")
+        .def("register_decoder", &SBEDecoder::register_decoder, py::arg("template_id"), py::arg("decoder"),
+             "Decode frames of a template without a native decoder with a Python callable")
+        .def_static("supported_templates", &SBEDecoder::supported_templates,
+                    "Template IDs with a native decoder")
+        .def("get_message_type", &SBEDecoder::get_message_type, py::arg("data"),
+             "Get SBE message template ID")
+        .def("is_valid_message", &SBEDecoder::is_valid_message, py::arg("data"),
+             "Validate SBE message format")
+        .def("view", &SBEDecoder::view, py::arg("data"),
+             "Lazy MessageView of a frame: fields are read from the (pinned) buffer only when accessed, and are "
+             "None where the template has no such field")
+        .def("decode_event", &SBEDecoder::decode_event, py::arg("data"), py::arg("ingest_ts_us") = py::none(),
+             "Decode into a typed TradeEvent/BestBidAskEvent/DepthDiffEvent (None for other templates)")
+        .def("decode_trades", &SBEDecoder::decode_trades, py::arg("data"),
+             "Decode every entry of a trade frame's repeating group into NumPy columns")
+        .def("decode_batch", &SBEDecoder::decode_batch, py::arg("frames"), py::arg("offsets") = py::none(),
+             py::arg("raw") = false, py::arg("ingest_ts_us") = py::none(), py::arg("format") = "numpy",
+             py::arg("subscription") = nullptr,
+             "Decode a batch of frames (iterable of buffers, or one buffer plus optional offsets; a buffer may "
+             "hold several messages back to back, each its own frame_index) into per-template NumPy columns "
+             "with the GIL released; raw=True keeps integer mantissas instead of floats, format='arrow' gives "
+             "an ArrowBatch per template; error frames are listed in errors with their PARSE_ERRORS cause in "
+             "error_causes. Frames a SubscriptionMask `subscription` rejects are skipped before decoding and "
+             "counted in filtered")
+        .def("serialize_records", &SBEDecoder::serialize_records, py::arg("frames"), py::arg("out"),
+             py::arg("offsets") = py::none(), py::arg("ingest_ts_us") = py::none(), py::arg("max_records") = 500,
+             py::arg("format") = "json", py::arg("compressor") = nullptr, py::arg("compress_all") = false,
+             py::arg("depth_delta") = nullptr,
+             "Write frames as Kinesis JSON (or format='avro') records into the writable buffer `out`, depth records "
+             "(or all, with compress_all) compressed by `compressor`, or delta-encoded top-N by a "
+             "DepthDeltaEncoder; returns record offsets, template ids and partition keys plus how many frames were "
+             "consumed");
     
+    py::class_<StreamReceiver>(m, "StreamReceiver")
+        .def(py::init([](std::vector<std::string> symbols, std::vector<std::string> stream_types,
+                         std::string api_key, std::string host, uint16_t port, bool use_tls, bool raw,
+                         double ping_interval, double reconnect_max, std::size_t ring_capacity,
+                         std::size_t connections, std::vector<int> cpu_affinity,
+                         std::size_t max_streams_per_connection, std::string journal_dir,
+                         std::size_t journal_file_size, double journal_roll_interval, std::string wait,
+                         int spin_us, int busy_poll_us, bool io_uring, unsigned uring_buffers,
+                         std::size_t uring_buffer_size, std::string event_log_dir,
+                         std::size_t event_log_capacity, double conflate_bba_interval,
+                         double conflate_depth_interval, std::size_t conflate_depth_levels, std::size_t feed_lines,
+                         std::vector<std::string> feed_hosts, const std::vector<std::string>& huge_pages,
+                         const std::vector<std::string>& numa_local, std::size_t batch_max_records,
+                         double batch_max_delay, bool batch_adaptive, std::size_t executor_threads,
+                         std::vector<int> executor_cpu_affinity) {
+                 ReceiverConfig config;
+                 config.symbols = std::move(symbols);
+                 config.stream_types = std::move(stream_types);
+                 config.api_key = std::move(api_key);
+                 config.host = std::move(host);
+                 config.port = port;
+                 config.use_tls = use_tls;
+                 config.raw_mantissa = raw;
+                 config.ping_interval_ms = static_cast<int>(ping_interval * 1000);
+                 config.idle_timeout_ms = config.ping_interval_ms + config.ping_interval_ms / 2;
+                 config.reconnect_max_ms = static_cast<int>(reconnect_max * 1000);
+                 config.ring_capacity = ring_capacity;
+                 config.connections = connections;
+                 config.cpu_affinity = std::move(cpu_affinity);
+                 config.wait = wait_strategy_from_name(wait);
+                 config.spin_us = spin_us;
+                 config.busy_poll_us = busy_poll_us;
+                 config.use_io_uring = io_uring;
+                 config.uring.buffer_count = uring_buffers;
+                 config.uring.buffer_size = uring_buffer_size;
+                 config.max_streams_per_connection = max_streams_per_connection;
+                 config.journal.directory = std::move(journal_dir);
+                 config.journal.file_size = journal_file_size;
+                 config.journal.roll_interval_ms = static_cast<int>(journal_roll_interval * 1000);
+                 config.event_log_dir = std::move(event_log_dir);
+                 config.event_log_capacity = event_log_capacity;
+                 config.conflation = conflation_config(conflate_bba_interval, conflate_depth_interval,
+                                                       conflate_depth_levels);
+                 config.feed_lines = feed_lines;
+                 config.feed_hosts = std::move(feed_hosts);
+                 set_receiver_memory(config, huge_pages, numa_local);
+                 if (batch_max_delay < 0) {
+                     throw py::value_error("StreamReceiver: batch_max_delay must not be negative");
+                 }
+                 config.micro_batch.max_records = batch_max_records;
+                 config.micro_batch.max_delay_us = static_cast<uint64_t>(batch_max_delay * 1e6);
+                 config.micro_batch.adaptive = batch_adaptive;
+                 config.executor_threads = executor_threads;
+                 config.executor_cpu_affinity = std::move(executor_cpu_affinity);
+                 try {
+                     return std::make_unique<StreamReceiver>(std::move(config));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("symbols"), py::arg("stream_types") = std::vector<std::string>{"trade", "bestBidAsk", "depth"},
+             py::arg("api_key") = "", py::arg("host") = "stream-sbe.binance.com", py::arg("port") = 9443,
+             py::arg("use_tls") = true, py::arg("raw") = false, py::arg("ping_interval") = 20.0,
+             py::arg("reconnect_max") = 60.0, py::arg("ring_capacity") = std::size_t{1} << 16,
+             py::arg("connections") = 1, py::arg("cpu_affinity") = std::vector<int>{},
+             py::arg("max_streams_per_connection") = 1024, py::arg("journal_dir") = "",
+             py::arg("journal_file_size") = std::size_t{256} << 20, py::arg("journal_roll_interval") = 3600.0,
+             py::arg("wait") = "block", py::arg("spin_us") = 50, py::arg("busy_poll_us") = 0,
+             py::arg("io_uring") = false, py::arg("uring_buffers") = 64u,
+             py::arg("uring_buffer_size") = std::size_t{16} << 10, py::arg("event_log_dir") = "",
+             py::arg("event_log_capacity") = std::size_t{1} << 20, py::arg("conflate_bba_interval") = 0.0,
+             py::arg("conflate_depth_interval") = 0.0, py::arg("conflate_depth_levels") = std::size_t{20},
+             py::arg("feed_lines") = std::size_t{1}, py::arg("feed_hosts") = std::vector<std::string>{},
+             py::arg("huge_pages") = std::vector<std::string>{}, py::arg("numa_local") = std::vector<std::string>{},
+             py::arg("batch_max_records") = std::size_t{1}, py::arg("batch_max_delay") = 0.0,
+             py::arg("batch_adaptive") = false, py::arg("executor_threads") = std::size_t{0},
+             py::arg("executor_cpu_affinity") = std::vector<int>{},
+             "Receive on `connections` sockets (more if the stream cap requires), symbols dealt "
+             "round-robin; cpu_affinity[i] pins connection i's receive thread. wait='spin' busy-spins the "
+             "receive threads and 'spin_yield' spins spin_us after each frame before yielding; busy_poll_us "
+             "sets SO_BUSY_POLL. io_uring=True receives through a multishot io_uring recv into uring_buffers "
+             "registered buffers (falling back to recv() where unsupported). A journal_dir captures every raw "
+             "frame into per-connection memory-mapped journal files. An event_log_dir (normally under /dev/shm) "
+             "also publishes each connection's decoded records to a shared-memory event log of "
+             "event_log_capacity records, for EventLogReader consumers in other processes. A nonzero "
+             "conflate_bba_interval or conflate_depth_interval (seconds) conflates that stream per symbol: each "
+             "interval stages only the latest quote, or the book's top conflate_depth_levels as a partialDepth "
+             "snapshot, with a conflation row of update counts and touch ranges; trades are never conflated. "
+             "feed_lines > 1 receives every group of streams on that many redundant connections (A/B lines), "
+             "line i to feed_hosts[i % len] ('host' or 'host:port') when given, and stages only the first copy of "
+             "each message; stats['feeds'] reports per line wins, duplicates, hole fills and lag behind the "
+             "winning copy. huge_pages and numa_local list the components ('ring', 'journal', 'event_log') to "
+             "back with 2 MB pages (falling back to 4 KB) and to place on the NUMA node of the connection's "
+             "cpu_affinity core. batch_max_records > 1 with a batch_max_delay (seconds) micro-batches drain(): "
+             "it hands off once that many records are waiting or the oldest has waited batch_max_delay, and "
+             "batch_adaptive=True grows the record target under load and shrinks it to one when quiet. "
+             "executor_threads > 0 runs the connections as coroutines on that many shared threads (epoll) "
+             "instead of a thread each, executor_cpu_affinity[i] pinning worker i; wait and cpu_affinity pinning "
+             "then do not apply")
+        .def("start", &StreamReceiver::start, "Connect and receive on a background thread")
+        .def("stop", &StreamReceiver::stop, py::call_guard<py::gil_scoped_release>(),
+             "Close the connection and join the receive thread")
+        .def("set_subscription",
+             [](StreamReceiver& receiver, const SubscriptionMask& subscription) {
+                 try {
+                     receiver.set_subscription(subscription);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("subscription"),
+             "Stage only frames the SubscriptionMask admits into the rings (counted in "
+             "connections[i]['filtered_frames'] otherwise); journals and event logs still get every frame. Before "
+             "start() only")
+        .def("attach_pipeline",
+             [](StreamReceiver& receiver, IngestPipeline& pipeline) {
+                 try {
+                     receiver.set_frame_sink(&pipeline);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("pipeline"), py::keep_alive<1, 2>(),
+             "Hand every received frame to an IngestPipeline instead of the rings; before start() only. Stop "
+             "the pipeline before the receiver, so a receive thread waiting on a full block-policy lane is "
+             "released")
+        .def("drain", &drain_receiver<StreamReceiver>, py::arg("max_n") = std::size_t{1} << 16, py::arg("timeout") = 1.0,
+             py::arg("format") = "numpy",
+             "Up to max_n decoded records (whole frames) from the connections' rings as decode_batch columns "
+             "(ArrowBatch tables with format='arrow') plus frame_ingest_ts_us and drain_ts_us, or None if nothing arrived within timeout seconds. "
+             "Frames that found the ring full are counted in stats['dropped_frames']. With micro-batching the first "
+             "record may be held up to batch_max_delay more (stats['micro_batch']); with timeout=0 a batch still "
+             "filling is not waited for but returns None and leaves the wait in pending_wait")
+        .def_property_readonly(
+            "pending_wait", [](const StreamReceiver& receiver) { return receiver.pending_wait_us() / 1e6; },
+            "Seconds the last drain(timeout=0) left its records waiting for the micro-batch to fill; 0.0 when it "
+            "drained or found nothing")
+        .def_property_readonly("notify_fd", &StreamReceiver::notify_fd,
+                               "eventfd for loop.add_reader: readable once records arrive after arm_notify()")
+        .def("arm_notify", &StreamReceiver::arm_notify,
+             "Ask for a wake-up on notify_fd once records arrive; False when some are already waiting, so drain "
+             "again instead of sleeping. While a micro-batch fills, every arrival wakes and False means it is ready")
+        .def("clear_notify", &StreamReceiver::clear_notify, "Reset notify_fd after a wake-up")
+        .def_property_readonly("running", &StreamReceiver::running)
+        .def_property_readonly("paths",
+                               [](const StreamReceiver& receiver) {
+                                   std::vector<std::string> paths;
+                                   for (const auto& connection : receiver.connections()) {
+                                       paths.push_back(connection->path());
+                                   }
+                                   return paths;
+                               },
+                               "Subscription path of each connection")
+        .def_property_readonly("event_logs",
+                               [](const StreamReceiver& receiver) {
+                                   std::vector<std::string> paths;
+                                   for (const auto& connection : receiver.connections()) {
+                                       if (const EventLog* log = connection->event_log()) {
+                                           paths.push_back(log->path());
+                                       }
+                                   }
+                                   return paths;
+                               },
+                               "Event log of each connection; empty without event_log_dir")
+        .def_property_readonly("stats", &receiver_stats_to_python);
+
+    py::class_<MicroBatcher>(m, "MicroBatcher",
+                             "When a drain hands off: once target records wait or the oldest is max_delay old; the "
+                             "policy behind StreamReceiver's batch_* options")
+        .def(py::init([](std::size_t max_records, double max_delay, bool adaptive, std::size_t min_records) {
+                 if (max_delay < 0) {
+                     throw py::value_error("MicroBatcher: max_delay must not be negative");
+                 }
+                 MicroBatchConfig config;
+                 config.max_records = max_records;
+                 config.max_delay_us = static_cast<uint64_t>(max_delay * 1e6);
+                 config.adaptive = adaptive;
+                 config.min_records = min_records;
+                 return std::make_unique<MicroBatcher>(config);
+             }),
+             py::arg("max_records"), py::arg("max_delay"), py::arg("adaptive") = false, py::arg("min_records") = 1)
+        .def("target", &MicroBatcher::target, py::arg("limit") = SIZE_MAX, "Records to wait for, at most limit")
+        .def("wait_us", &MicroBatcher::wait_us, py::arg("waiting"), py::arg("age_us"), py::arg("limit") = SIZE_MAX,
+             "Microseconds still to hold `waiting` records whose oldest is age_us old; 0 to hand off now")
+        .def("handed_off", &MicroBatcher::handed_off, py::arg("records"), py::arg("waiting"),
+             py::arg("limit") = SIZE_MAX, "Count a handoff of records that were `waiting` when it was decided")
+        .def_property_readonly("stats", &micro_batch_stats_to_python);
+
+    py::class_<WsApiResponse>(m, "WsApiResponse", py::buffer_protocol(),
+                              "One WebSocket API answer. Exports its result (the embedded SBE message, header "
+                              "included) through the buffer protocol, so decoder.decode_message(response) or "
+                              "memoryview(response) reads it without a copy")
+        .def_buffer([](WsApiResponse& response) {
+            return py::buffer_info(response.envelope.result.data(), sizeof(uint8_t),
+                                   py::format_descriptor<uint8_t>::format(), 1,
+                                   {static_cast<py::ssize_t>(response.envelope.result.size())}, {py::ssize_t{1}},
+                                   true);
+        })
+        .def_readonly("request_id", &WsApiResponse::request_id, "0 when the id matched no pending request")
+        .def_readonly("index", &WsApiResponse::index, "Position of the request in fetch_all's list")
+        .def_readonly("latency_us", &WsApiResponse::latency_us, "Submit to response")
+        .def_readonly("json", &WsApiResponse::json,
+                      "A JSON error answer (a request the server could not parse); the buffer is its text")
+        .def_property_readonly("status", &WsApiResponse::status)
+        .def_property_readonly("ok", [](const WsApiResponse& response) {
+            return !response.json && response.status() == 200;
+        })
+        .def_property_readonly("id", [](const WsApiResponse& response) { return std::string(response.envelope.id); })
+        .def_property_readonly("rate_limits",
+                               [](const WsApiResponse& response) { return ws_api_rate_limits(response.envelope); },
+                               "Limits the request counted against, with their usage after it (count)")
+        .def("__len__", [](const WsApiResponse& response) { return response.envelope.result.size(); });
+
+    py::class_<RateGovernor>(m, "RateGovernor",
+                             "Request-weight budget in fixed windows per exchange rate limit, corrected from the "
+                             "server's own counts; rate_governor() is the one every caller in the process shares")
+        .def(py::init<double>(), py::arg("utilization") = 0.95)
+        .def("configure",
+             [](RateGovernor& governor, const std::vector<py::dict>& rate_limits) {
+                 std::vector<RateLimitSpec> specs;
+                 for (const py::dict& entry : rate_limits) {
+                     specs.push_back(rate_limit_spec_from_python(entry));
+                 }
+                 governor.configure(specs);
+             },
+             py::arg("rate_limits"), "Set the limits from exchangeInfo's JSON rateLimits entries")
+        .def("configure_from_exchange_info",
+             [](RateGovernor& governor, const py::buffer& data) {
+                 FrameBuffer buffer{data};
+                 try {
+                     governor.configure(exchange_info_rate_limits(buffer.payload()));
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("data"), "Set the limits from an SBE ExchangeInfoResponse (template 103) frame")
+        .def("reserve",
+             [](RateGovernor& governor, int64_t weight) {
+                 return static_cast<double>(governor.reserve(weight, rate_governor_now_ms())) / 1000.0;
+             },
+             py::arg("weight") = 1,
+             "Charge a request's weight and return 0.0, or return the seconds to wait before asking again "
+             "(nothing charged); for event loops, which should sleep without blocking")
+        .def("acquire",
+             [](RateGovernor& governor, int64_t weight, std::optional<double> timeout) {
+                 py::gil_scoped_release release;
+                 const int64_t deadline_ms =
+                     timeout ? rate_governor_now_ms() + static_cast<int64_t>(*timeout * 1000)
+                             : std::numeric_limits<int64_t>::max();
+                 while (true) {
+                     const int64_t now_ms = rate_governor_now_ms();
+                     const int64_t wait_ms = governor.reserve(weight, now_ms);
+                     if (wait_ms == 0) {
+                         return true;
+                     }
+                     if (now_ms + wait_ms > deadline_ms) {
+                         return false;
+                     }
+                     std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+                 }
+             },
+             py::arg("weight") = 1, py::arg("timeout") = py::none(),
+             "Block (without the GIL) until the weight is granted; False if that would take longer than timeout")
+        .def("observe",
+             [](RateGovernor& governor, const std::vector<py::dict>& rate_limits) {
+                 const int64_t now_ms = rate_governor_now_ms();
+                 for (const py::dict& entry : rate_limits) {
+                     governor.observe(rate_limit_spec_from_python(entry), entry["count"].cast<int64_t>(), now_ms);
+                 }
+             },
+             py::arg("rate_limits"), "Take the server's counts, as in WsApiResponse.rate_limits")
+        .def("observe_used_weight",
+             [](RateGovernor& governor, int64_t used, const std::string& interval, uint8_t interval_num) {
+                 governor.observe({spot_sbe::RateLimitType::RequestWeight, rate_limit_interval_from_name(interval),
+                                   interval_num, 0},
+                                  used, rate_governor_now_ms());
+             },
+             py::arg("used"), py::arg("interval") = "MINUTE", py::arg("interval_num") = 1,
+             "Take a REST response's X-MBX-USED-WEIGHT-<n><unit> header value")
+        .def("back_off",
+             [](RateGovernor& governor, double seconds) {
+                 governor.back_off(rate_governor_now_ms() + static_cast<int64_t>(seconds * 1000));
+             },
+             py::arg("seconds"), "Refuse every reservation for seconds, e.g. a 429/418's Retry-After")
+        .def_property("utilization", &RateGovernor::utilization, &RateGovernor::set_utilization)
+        .def_property_readonly("configured", &RateGovernor::configured)
+        .def_property_readonly("limits", &rate_windows_to_python,
+                               "Each window's limit and its count so far in the current window")
+        .def_property_readonly("stats", &rate_governor_stats_to_python);
+
+    m.def("rate_governor", &rate_governor, py::return_value_policy::reference,
+          "The RateGovernor shared by every REST and WebSocket API caller in the process");
+
+    py::class_<NativeLogger>(m, "NativeLogger",
+                             "Asynchronous log of the native components: hot threads record a format ID and raw "
+                             "arguments into their own buffer, a writer thread formats them; native_logger() is the "
+                             "process's one")
+        .def(
+            "start",
+            [](NativeLogger& logger, const std::string& level, double flush_interval, std::size_t thread_buffer,
+               bool forward, std::size_t max_pending) {
+                NativeLoggerConfig config;
+                config.level = log_level_from_name(level);
+                config.flush_interval_ms = std::max(1, static_cast<int>(flush_interval * 1000));
+                config.thread_buffer = thread_buffer;
+                config.forward = forward;
+                config.max_pending = max_pending;
+                py::gil_scoped_release release;
+                logger.start(config);
+            },
+            py::arg("level") = "WARNING", py::arg("flush_interval") = 0.02, py::arg("thread_buffer") = 1024,
+            py::arg("forward") = false, py::arg("max_pending") = 16384,
+            "Log records at level and above, formatted every flush_interval seconds: written to stderr, or with "
+            "forward queued (up to max_pending lines) for drain(). thread_buffer records per thread; a full "
+            "buffer drops records. Restarts a started logger with the new settings")
+        .def("stop", &NativeLogger::stop, py::call_guard<py::gil_scoped_release>(),
+             "Stop recording and write out what was recorded")
+        .def("flush", &NativeLogger::flush, py::call_guard<py::gil_scoped_release>(),
+             "Format every record so far now, rather than at the next flush interval")
+        .def("drain", &native_log_lines_to_python, py::arg("max_lines") = 1024,
+             "Forwarded lines, oldest first, as (time_us, level, component, message) with Python logging levels")
+        .def_property_readonly("notify_fd", [](NativeLogger& logger) { return logger.notifier().fd(); },
+                               "eventfd that turns readable once an armed logger has forwarded lines")
+        .def("arm_notify", &NativeLogger::arm_notify,
+             "Ask for a notify_fd wake-up on the next forwarded lines; False if some are already waiting")
+        .def("clear_notify", [](NativeLogger& logger) { return logger.notifier().clear(); })
+        .def_property_readonly("stats", &native_logger_stats_to_python,
+                               "Records logged, records dropped on full thread buffers, forwarded lines dropped, "
+                               "thread buffers and lines waiting");
+
+    m.def("native_logger", &native_logger, py::return_value_policy::reference,
+          "The NativeLogger every native component logs through");
+
+    m.def("parse_ws_api_response", &parse_ws_api_response, py::arg("data"),
+          "Parse a WebSocketResponse (template 50) frame into a WsApiResponse holding a copy of it");
+
+    m.def("official_error_json", &official_error_json, py::arg("data"),
+          "An ErrorResponse (template 100) frame as the official sample app's JSON");
+    m.def(
+        "official_json_decimal",
+        [](int64_t mantissa, int8_t exponent) {
+            std::string out;
+            append_decimal(out, Decimal{mantissa, exponent});
+            return out;
+        },
+        py::arg("mantissa"), py::arg("exponent"),
+        "Exact text of mantissa * 10**exponent as the official JSON writer prints it (trailing zeros kept)");
+    m.def(
+        "official_json_quote",
+        [](std::string_view text) {
+            std::string out;
+            append_quoted(out, text);
+            return out;
+        },
+        py::arg("text"), "A JSON string literal as the official JSON writer escapes it");
+
+    py::class_<WsApiClient>(m, "WsApiClient",
+                            "Pipelined WebSocket API client: keeps up to max_in_flight requests outstanding on one "
+                            "connection and reads SBE responses in place")
+        .def(py::init([](std::string host, uint16_t port, std::string path, bool use_tls, std::string api_key,
+                         std::size_t max_in_flight, std::size_t max_message_size, double response_timeout,
+                         bool governed) {
+                 WsApiConfig config;
+                 config.host = std::move(host);
+                 config.port = port;
+                 if (!path.empty()) {
+                     config.path = std::move(path);
+                 }
+                 config.use_tls = use_tls;
+                 config.api_key = std::move(api_key);
+                 config.max_in_flight = max_in_flight;
+                 config.max_message_size = max_message_size;
+                 config.response_timeout_ms = static_cast<int>(response_timeout * 1000);
+                 config.governed = governed;
+                 return std::make_unique<WsApiClient>(std::move(config));
+             }),
+             py::arg("host") = "ws-api.binance.com", py::arg("port") = 443, py::arg("path") = "",
+             py::arg("use_tls") = true, py::arg("api_key") = "", py::arg("max_in_flight") = 32,
+             py::arg("max_message_size") = std::size_t{16} << 20, py::arg("response_timeout") = 10.0,
+             py::arg("governed") = true,
+             "An empty path asks for SBE responses in this module's schema. A governed client paces its requests "
+             "through rate_governor() and reports each response's rate-limit usage to it")
+        .def("connect", &WsApiClient::connect, py::call_guard<py::gil_scoped_release>())
+        .def("close", &WsApiClient::close, py::call_guard<py::gil_scoped_release>(),
+             "Drop the connection; requests in flight are forgotten")
+        .def("submit",
+             [](WsApiClient& client, const std::string& method, const std::optional<py::dict>& params,
+                int64_t weight) {
+                 const std::string encoded = ws_api_params(params);
+                 py::gil_scoped_release release;
+                 return client.submit(method, encoded, weight);
+             },
+             py::arg("method"), py::arg("params") = py::none(), py::arg("weight") = 1,
+             "Send a request once the governor grants its weight and return its id; raises RuntimeError when "
+             "max_in_flight are already pending")
+        .def("receive",
+             [](WsApiClient& client, double timeout) {
+                 py::gil_scoped_release release;
+                 return client.receive(static_cast<int>(timeout * 1000));
+             },
+             py::arg("timeout") = 1.0, "The next response in arrival order, or None after timeout seconds")
+        .def("fetch_all",
+             [](WsApiClient& client, const std::vector<py::tuple>& requests) {
+                 std::vector<WsApiRequest> encoded;
+                 encoded.reserve(requests.size());
+                 for (const py::tuple& request : requests) {
+                     if (request.size() < 2 || request.size() > 3) {
+                         throw py::value_error("fetch_all: requests are (method, params[, weight]) tuples");
+                     }
+                     encoded.push_back({request[0].cast<std::string>(),
+                                        ws_api_params(request[1].cast<std::optional<py::dict>>()),
+                                        request.size() == 3 ? request[2].cast<int64_t>() : int64_t{1}});
+                 }
+                 py::gil_scoped_release release;
+                 return client.fetch_all(encoded);
+             },
+             py::arg("requests"),
+             "Send (method, params[, weight]) requests keeping max_in_flight outstanding and within the "
+             "governor's budget; returns the responses in request order")
+        .def_property_readonly("connected", &WsApiClient::connected)
+        .def_property_readonly("in_flight", &WsApiClient::in_flight)
+        .def_property_readonly("window_full", &WsApiClient::window_full)
+        .def_property_readonly("max_in_flight", [](const WsApiClient& client) { return client.config().max_in_flight; })
+        .def_property_readonly("stats", &ws_api_stats_to_python);
+
+    py::class_<BackfillResult>(m, "BackfillResult", "One backfilled aggTrades page, or why it failed")
+        .def_property_readonly("symbol", [](const BackfillResult& result) { return result.task.symbol; })
+        .def_property_readonly("from_id", [](const BackfillResult& result) { return result.task.from_id; })
+        .def_property_readonly("limit", [](const BackfillResult& result) { return result.task.limit; })
+        .def_property_readonly("attempts", [](const BackfillResult& result) { return result.task.attempts; })
+        .def_readonly("worker", &BackfillResult::worker)
+        .def_readonly("status", &BackfillResult::status)
+        .def_readonly("error", &BackfillResult::error)
+        .def_property_readonly("ok", &BackfillResult::ok)
+        .def_readonly("rows", &BackfillResult::rows)
+        .def_readonly("first_id", &BackfillResult::first_id)
+        .def_readonly("last_id", &BackfillResult::last_id)
+        .def_readonly("first_time", &BackfillResult::first_time)
+        .def_readonly("last_time", &BackfillResult::last_time)
+        .def_property_readonly("parquet",
+                               [](const BackfillResult& result) {
+                                   return py::bytes(result.parquet.data(), result.parquet.size());
+                               },
+                               "The rows as a Parquet file in the S3 archive's aggTrades columns; empty "
+                               "without rows");
+
+    py::class_<BackfillPool>(m, "BackfillPool",
+                             "Work-stealing aggTrades backfill: each worker fetches planned pages over its own "
+                             "governed WebSocket API connection, decodes them and encodes them as Parquet")
+        .def(py::init([](std::size_t workers, std::string host, uint16_t port, std::string path, bool use_tls,
+                         std::string api_key, std::size_t batch, int max_attempts, int64_t weight,
+                         double response_timeout, bool governed, std::string source) {
+                 BackfillConfig config;
+                 config.workers = workers;
+                 config.api.host = std::move(host);
+                 config.api.port = port;
+                 if (!path.empty()) {
+                     config.api.path = std::move(path);
+                 }
+                 config.api.use_tls = use_tls;
+                 config.api.api_key = std::move(api_key);
+                 config.api.max_in_flight = std::max<std::size_t>(batch, 1);
+                 config.api.response_timeout_ms = static_cast<int>(response_timeout * 1000);
+                 config.api.governed = governed;
+                 config.batch = batch;
+                 config.max_attempts = max_attempts;
+                 config.weight = weight;
+                 config.source = std::move(source);
+                 return std::make_unique<BackfillPool>(std::move(config));
+             }),
+             py::arg("workers") = 0, py::arg("host") = "ws-api.binance.com", py::arg("port") = 443,
+             py::arg("path") = "", py::arg("use_tls") = true, py::arg("api_key") = "", py::arg("batch") = 8,
+             py::arg("max_attempts") = 3, py::arg("weight") = 4, py::arg("response_timeout") = 10.0,
+             py::arg("governed") = true, py::arg("source") = "ws_api",
+             "`workers` threads (0 = one per core), each pipelining up to `batch` pages on its connection. "
+             "Governed workers share rate_governor() with every other caller in the process")
+        .def("add",
+             [](BackfillPool& pool, const std::string& symbol, const std::vector<std::pair<int64_t, int64_t>>& pages) {
+                 std::vector<IdRequest> requests;
+                 requests.reserve(pages.size());
+                 for (const auto& [from_id, limit] : pages) {
+                     requests.push_back({from_id, limit});
+                 }
+                 pool.add(symbol, requests);
+             },
+             py::arg("symbol"), py::arg("pages"),
+             "Queue a symbol's (from_id, limit) pages, e.g. IdIntervalSet.plan()'s, on its home worker; idle "
+             "workers steal them from there")
+        .def("next_result",
+             [](BackfillPool& pool, double timeout) {
+                 py::gil_scoped_release release;
+                 return pool.next_result(static_cast<int>(timeout * 1000));
+             },
+             py::arg("timeout") = 1.0, "The next finished page in completion order, or None after timeout seconds")
+        .def("stop", &BackfillPool::stop, py::call_guard<py::gil_scoped_release>(),
+             "Stop the workers after their current batch and drop the pages still queued")
+        .def_property_readonly("workers", &BackfillPool::workers)
+        .def_property_readonly("outstanding", &BackfillPool::outstanding,
+                               "Pages added whose result has not been produced yet")
+        .def_property_readonly("queued", &BackfillPool::queued, "Pages waiting on each worker's queue")
+        .def_property_readonly("stats", &backfill_stats_to_python);
+
+    py::class_<SyntheticStream>(m, "SyntheticStream",
+                                "Seeded simulation of the SBE market streams (trades, bestBidAsk, depth diffs, "
+                                "partial depth) for load tests; frames come out in event-time order")
+        .def(py::init([](std::vector<std::string> symbols, uint64_t seed, const std::optional<uint64_t>& start_ts_us,
+                         double trade_rate, double sweep_fills, double bba_rate, double depth_interval,
+                         double depth_churn, double partial_depth_interval, std::size_t partial_depth_levels,
+                         std::size_t book_levels, double start_price, double volatility, int price_exponent,
+                         int qty_exponent, double mean_qty) {
+                 if (price_exponent < -18 || price_exponent > 0 || qty_exponent < -18 || qty_exponent > 0) {
+                     throw std::invalid_argument("SyntheticStream: exponents must be in [-18, 0]");
+                 }
+                 SyntheticStreamConfig config;
+                 config.symbols = std::move(symbols);
+                 config.seed = seed;
+                 config.start_us = resolve_ingest_us(start_ts_us);
+                 config.trade_rate = trade_rate;
+                 config.sweep_fills = sweep_fills;
+                 config.bba_rate = bba_rate;
+                 config.depth_interval_ms = static_cast<int>(std::lround(depth_interval * 1000));
+                 config.depth_churn = depth_churn;
+                 config.partial_depth_interval_ms = static_cast<int>(std::lround(partial_depth_interval * 1000));
+                 config.partial_depth_levels = partial_depth_levels;
+                 config.book_levels = book_levels;
+                 config.start_price = std::llround(start_price * std::pow(10.0, -price_exponent));
+                 config.volatility = volatility;
+                 config.price_exponent = static_cast<int8_t>(price_exponent);
+                 config.qty_exponent = static_cast<int8_t>(qty_exponent);
+                 config.mean_qty = std::llround(mean_qty * std::pow(10.0, -qty_exponent));
+                 return std::make_unique<SyntheticStream>(std::move(config));
+             }),
+             py::arg("symbols") = std::vector<std::string>{"BTCUSDT"}, py::arg("seed") = 1,
+             py::arg("start_ts_us") = py::none(), py::arg("trade_rate") = 50.0, py::arg("sweep_fills") = 0.3,
+             py::arg("bba_rate") = 100.0, py::arg("depth_interval") = 0.1, py::arg("depth_churn") = 20.0,
+             py::arg("partial_depth_interval") = 0.0, py::arg("partial_depth_levels") = 20,
+             py::arg("book_levels") = 200, py::arg("start_price") = 65000.0, py::arg("volatility") = 50.0,
+             py::arg("price_exponent") = -2, py::arg("qty_exponent") = -8, py::arg("mean_qty") = 0.5,
+             "Rates are per second and symbol (Poisson), intervals in seconds (0 turns that stream off), "
+             "volatility in ticks per square-root second; event times start at start_ts_us (now by default)")
+        .def("next",
+             [](SyntheticStream& stream) {
+                 std::vector<char> frame;
+                 stream.next(frame);
+                 return py::bytes(frame.data(), frame.size());
+             },
+             "The next frame, message header included")
+        .def("generate", &synthetic_stream_generate, py::arg("count"),
+             "The next `count` frames as {'frames', 'offsets', 'event_ts_us', 'template_id'}; frames and offsets "
+             "go straight to decode_batch")
+        .def_property_readonly("next_event_ts_us", &SyntheticStream::next_event_us)
+        .def_property_readonly("rate", &SyntheticStream::rate, "Mean frames per second of event time")
+        .def_property_readonly("stats", &synthetic_stream_stats_to_python);
+
+    py::class_<StreamLoadServer>(m, "StreamLoadServer",
+                                 "Local WebSocket server playing a SyntheticStream to every client, paced against "
+                                 "the wall clock; behind_us in stats grows once clients cannot keep up")
+        .def(py::init([](const SyntheticStream& stream, std::string host, uint16_t port, double speed,
+                         uint64_t max_frames, double send_timeout) {
+                 StreamLoadServerConfig config;
+                 config.host = std::move(host);
+                 config.port = port;
+                 config.speed = speed;
+                 config.max_frames = max_frames;
+                 config.send_timeout_ms = static_cast<int>(send_timeout * 1000);
+                 return std::make_unique<StreamLoadServer>(stream, std::move(config));
+             }),
+             py::arg("stream"), py::arg("host") = "127.0.0.1", py::arg("port") = 0, py::arg("speed") = 1.0,
+             py::arg("max_frames") = 0, py::arg("send_timeout") = 5.0,
+             "Plays a copy of `stream` from where it is. speed scales event time (0 sends unpaced); "
+             "port 0 picks a free one")
+        .def("start", &StreamLoadServer::start, "Accept clients; the stream starts with the first one")
+        .def("stop", &StreamLoadServer::stop, py::call_guard<py::gil_scoped_release>(),
+             "Close every client and stop the threads")
+        .def_property_readonly("port", &StreamLoadServer::port)
+        .def_property_readonly("url",
+                               [](const StreamLoadServer& server) {
+                                   return "ws://" + server.host() + ":" + std::to_string(server.port()) + "/";
+                               })
+        .def_property_readonly("finished", &StreamLoadServer::finished, "max_frames have been sent")
+        .def_property_readonly("stats", &stream_load_stats_to_python);
+
+    py::class_<Conflator>(m, "Conflator",
+                          "StreamReceiver's per-symbol conflation of bestBidAsk and depth frames, for frames "
+                          "received in Python; not thread-safe")
+        .def(py::init([](double bba_interval, double depth_interval, std::size_t depth_levels,
+                         const std::optional<uint64_t>& start_ts_us) {
+                 return std::make_unique<Conflator>(conflation_config(bba_interval, depth_interval, depth_levels),
+                                                    resolve_ingest_us(start_ts_us));
+             }),
+             py::arg("bba_interval") = 2.0, py::arg("depth_interval") = 2.0, py::arg("depth_levels") = 20,
+             py::arg("start_ts_us") = py::none(),
+             "Intervals in seconds (0 leaves that stream unconflated), timed from start_ts_us")
+        .def(
+            "absorb",
+            [](Conflator& conflator, const py::buffer& data, const std::optional<uint64_t>& received_ts_us) {
+                const FrameBuffer buffer(data);
+                return conflator.absorb(buffer.payload(), resolve_ingest_us(received_ts_us));
+            },
+            py::arg("data"), py::arg("received_ts_us") = py::none(),
+            "Take a frame of a conflated stream; False for any other frame, which the caller handles itself")
+        .def(
+            "flush",
+            [](Conflator& conflator, const std::optional<uint64_t>& now_ts_us, bool raw, const std::string& format) {
+                return conflator_flush(conflator, resolve_ingest_us(now_ts_us), raw, format);
+            },
+            py::arg("now_ts_us") = py::none(), py::arg("raw") = false, py::arg("format") = "numpy",
+             "decode_batch-style columns of every symbol whose interval ended by now_ts_us, one frame each "
+             "(see the conflation table), or None if none is due")
+        .def_property_readonly("stats", [](const Conflator& conflator) {
+            py::dict result;
+            conflation_stats_to_python(result, conflator);
+            return result;
+        });
+
+    py::class_<FeedArbiter>(m, "FeedArbiter",
+                            "StreamReceiver's first-copy-wins arbitration between redundant feed lines, for "
+                            "frames received in Python; not thread-safe")
+        .def(py::init<std::size_t>(), py::arg("lines") = std::size_t{2})
+        .def(
+            "admit",
+            [](FeedArbiter& arbiter, const py::buffer& data, std::size_t line,
+               const std::optional<uint64_t>& received_ts_us) {
+                const FrameBuffer buffer(data);
+                try {
+                    return arbiter.admit(buffer.payload(), line, resolve_ingest_us(received_ts_us));
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("data"), py::arg("line"), py::arg("received_ts_us") = py::none(),
+            "True when this is the first copy of the frame on any line, so it should be forwarded; frames "
+            "without trade or update IDs always pass")
+        .def_property_readonly("lines", &FeedArbiter::lines)
+        .def_property_readonly("stats", [](const FeedArbiter& arbiter) {
+            py::dict result;
+            result["lines"] = feed_arbiter_stats_to_python(arbiter);
+            result["abandoned_holes"] = arbiter.abandoned_holes();
+            return result;
+        });
+
+    py::class_<DecoderPool>(m, "SBEDecoderPool")
+        .def(py::init<std::size_t, bool, std::vector<int>, bool>(), py::arg("workers") = 0, py::arg("raw") = false,
+             py::arg("cpu_affinity") = std::vector<int>{}, py::arg("numa_local") = false,
+             "Symbol-sharded decoder over `workers` threads (0 = one per core); cpu_affinity[i] pins worker i, "
+             "and numa_local=True has a pinned worker allocate its books on its core's NUMA node")
+        .def_property_readonly("workers", &DecoderPool::workers)
+        .def_property_readonly("placement_error", &DecoderPool::placement_error,
+                               "First error pinning a worker or placing its memory, or ''")
+        .def("shard_of", [](const DecoderPool& pool, const std::string& symbol) { return pool.shard_of(symbol); },
+             py::arg("symbol"))
+        .def("decode_batch", &pool_decode_batch, py::arg("frames"), py::arg("offsets") = py::none(),
+             py::arg("ingest_ts_us") = py::none(), py::arg("format") = "numpy",
+             "Like SBEDecoder.decode_batch, decoded in parallel by symbol shard. Rows are grouped "
+             "by shard with per-symbol order preserved; depth diffs also update each shard's "
+             "order books and book_gaps lists symbols that hit a sequence gap")
+        .def("book", &pool_book_to_python, py::arg("symbol"), py::arg("depth") = 10,
+             "Top levels of a symbol's book as a dict, or None before its first depth frame. Reads the copy "
+             "published after the last batch without waiting for a running decode_batch")
+        .def("checksum", &pool_book_checksum, py::arg("symbol"), py::arg("depth") = 0,
+             "OrderBook.checksum of a symbol's published book, or None before its first depth frame")
+        .def("load_snapshot",
+             [](DecoderPool& pool, const std::string& symbol, uint64_t last_update_id,
+                const std::vector<std::pair<int64_t, int64_t>>& bids,
+                const std::vector<std::pair<int64_t, int64_t>>& asks,
+                int8_t price_exponent, int8_t qty_exponent) {
+                 const auto bid_levels = levels_from_python(bids);
+                 const auto ask_levels = levels_from_python(asks);
+                 return pool.update_book(symbol, [&](BookSync& sync) {
+                     return sync.load_snapshot(last_update_id, price_exponent, qty_exponent, bid_levels, ask_levels);
+                 });
+             },
+             py::arg("symbol"), py::arg("last_update_id"), py::arg("bids"), py::arg("asks"),
+             py::arg("price_exponent"), py::arg("qty_exponent"),
+             "Seed or resync a symbol's book from (price_mantissa, qty_mantissa) snapshot levels, replaying "
+             "the diffs buffered since its gap; returns a SyncResult")
+        .def("load_depth_response",
+             [](DecoderPool& pool, const std::string& symbol, const py::buffer& data) {
+                 FrameBuffer buffer{data};
+                 try {
+                     py::gil_scoped_release release;
+                     return pool.reanchor(symbol, buffer.payload());
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("symbol"), py::arg("data"),
+             "Seed or resync a symbol's book from a REST depth snapshot frame (DepthResponse, template 200): "
+             "the snapshot is loaded while decode_batch keeps running, then swapped in and the diffs buffered "
+             "since the gap replayed; returns a SyncResult. Readers of book() see the old book until the swap")
+        .def("load_depth_json",
+             [](DecoderPool& pool, const std::string& symbol, const py::buffer& data) {
+                 OrderBook staged{symbol};
+                 load_depth_json_body(staged, data);
+                 py::gil_scoped_release release;
+                 return pool.reanchor(symbol, std::move(staged));
+             },
+             py::arg("symbol"), py::arg("data"),
+             "load_depth_response for a raw /api/v3/depth JSON body (bytes)")
+        .def("resync",
+             [](DecoderPool& pool, const std::string& symbol) {
+                 pool.update_book(symbol, [](BookSync& sync) { sync.resync(); });
+             },
+             py::arg("symbol"), "Clear a symbol's book and buffer its diffs until the next snapshot")
+        .def("set_rules", &DecoderPool::set_rules, py::arg("rules"), py::keep_alive<1, 2>(),
+             "Index every book's levels on its symbol's tick from a SymbolRulesTable (books created later "
+             "too); call again after refreshing the table. None leaves later books without a grid")
+        .def("save_checkpoint",
+             [](const DecoderPool& pool, const std::string& path) {
+                 try {
+                     py::gil_scoped_release release;
+                     return pool.save_checkpoint(path);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             },
+             py::arg("path"),
+             "Write the published, in-sync books to a binary checkpoint file without pausing decode_batch; "
+             "returns the number of books written")
+        .def("restore_checkpoint",
+             [](DecoderPool& pool, const std::string& path, const std::vector<std::string>& symbols) {
+                 std::vector<std::pair<std::string, SyncResult>> results;
+                 try {
+                     py::gil_scoped_release release;
+                     results = pool.restore_checkpoint(path, symbols);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+                 py::dict out;
+                 for (const auto& [symbol, result] : results) {
+                     out[py::str(symbol)] = result;
+                 }
+                 return out;
+             },
+             py::arg("path"), py::arg("symbols") = std::vector<std::string>{},
+             "Seed books from a checkpoint before the first batch (only those of `symbols`, when given); returns "
+             "{symbol: SyncResult}. A restored book resumes if the next diff continues its update IDs, else "
+             "reports a gap for a snapshot resync")
+        .def("start_checkpoints",
+             [](DecoderPool& pool, const std::string& path, double interval) {
+                 pool.start_checkpoints(path, static_cast<int>(interval * 1000));
+             },
+             py::arg("path"), py::arg("interval") = 1.0,
+             "Save a checkpoint to path every `interval` seconds in the background, and once more on stop")
+        .def("stop_checkpoints", &DecoderPool::stop_checkpoints, py::call_guard<py::gil_scoped_release>())
+        .def("set_order_flow_levels", &DecoderPool::set_order_flow_levels, py::arg("levels") = 10,
+             py::call_guard<py::gil_scoped_release>(),
+             "Sum order-flow imbalance at levels 1..levels on every book, existing or created later; 0 stops")
+        .def("take_order_flow",
+             [](DecoderPool& pool, const std::string& symbol) -> py::object {
+                 std::optional<OrderFlowTotals> totals;
+                 {
+                     py::gil_scoped_release release;
+                     totals = pool.take_order_flow(symbol);
+                 }
+                 if (!totals) {
+                     return py::none();
+                 }
+                 return order_flow_to_python(*totals);
+             },
+             py::arg("symbol"),
+             "A symbol's order-flow sums since the last call, as OrderBook.take_order_flow, then reset them; "
+             "None before its first depth frame. Call once per sampling interval")
+        .def("symbols", &DecoderPool::symbols, "Symbols with a book");
+
+    py::class_<JournalWriter>(m, "CaptureJournal")
+        .def(py::init([](std::string directory, uint16_t connection_id, std::string prefix, std::size_t file_size,
+                         double roll_interval) {
+                 JournalConfig config;
+                 config.directory = std::move(directory);
+                 config.prefix = std::move(prefix);
+                 config.file_size = file_size;
+                 config.roll_interval_ms = static_cast<int>(roll_interval * 1000);
+                 return std::make_unique<JournalWriter>(std::move(config), connection_id);
+             }),
+             py::arg("directory"), py::arg("connection_id") = 0, py::arg("prefix") = "sbe",
+             py::arg("file_size") = std::size_t{256} << 20, py::arg("roll_interval") = 3600.0,
+             "Raw frame journal in the StreamReceiver capture format, for frames received in Python")
+        .def("append",
+             [](JournalWriter& journal, const py::buffer& data, uint64_t sequence,
+                const std::optional<uint64_t>& received_ts_us) {
+                 const FrameBuffer buffer(data);
+                 return journal.append(buffer.payload(), resolve_ingest_us(received_ts_us), sequence);
+             },
+             py::arg("data"), py::arg("sequence"), py::arg("received_ts_us") = py::none(),
+             "Copy one frame into the journal; False if it was dropped (see stats)")
+        .def("sync", &JournalWriter::sync, py::call_guard<py::gil_scoped_release>(),
+             "Start write-back of the frames appended so far")
+        .def("close", &JournalWriter::close, py::call_guard<py::gil_scoped_release>(),
+             "Finish the current file; a later append starts a new one")
+        .def_property_readonly("path", &JournalWriter::current_path)
+        .def_property_readonly("stats", [](const JournalWriter& journal) {
+            py::dict result;
+            journal_stats_to_python(result, journal);
+            return result;
+        });
+
+    py::class_<JournalReplay>(m, "JournalReplay")
+        .def(py::init([](const std::vector<std::string>& paths, double speed, bool raw, std::size_t ring_capacity,
+                         const std::string& order) {
+                 return std::make_unique<JournalReplay>(paths, speed, raw, ring_capacity,
+                                                        replay_order_from_name(order));
+             }),
+             py::arg("paths"), py::arg("speed") = 1.0, py::arg("raw") = false,
+             py::arg("ring_capacity") = std::size_t{1} << 16, py::arg("order") = "received",
+             "Replay journal files (directories expand to their *.sbej files) merged by receive time, or with "
+             "order='event' message by message by (event time, template, update id), the same order on every "
+             "run; speed 1 keeps the recorded pacing, N is N times faster and 0 is as fast as drained")
+        .def("start", &JournalReplay::start, "Start replaying on a background thread")
+        .def("stop", &JournalReplay::stop, py::call_guard<py::gil_scoped_release>(),
+             "Stop replaying and join the replay thread")
+        .def("drain", &drain_receiver<JournalReplay>, py::arg("max_n") = std::size_t{1} << 16,
+             py::arg("timeout") = 1.0, py::arg("format") = "numpy",
+             "Same columns as StreamReceiver.drain, with the recorded receive times as frame_ingest_ts_us; "
+             "None if nothing was staged within timeout seconds")
+        .def_property_readonly("done", &JournalReplay::done, "Every frame replayed and drained")
+        .def_property_readonly("files", &JournalReplay::files)
+        .def_property_readonly("speed", &JournalReplay::speed)
+        .def_property_readonly("stats", [](const JournalReplay& replay) {
+            const auto& stats = replay.stats();
+            py::dict result;
+            result["frames"] = stats.frames.load();
+            result["bytes"] = stats.bytes.load();
+            result["dropped_frames"] = stats.dropped_frames.load();
+            result["depth_gaps"] = replay.depth_sequence().gaps();
+            result["position_ts_us"] = stats.position_us.load();
+            result["finished"] = stats.finished.load();
+            result["ring_capacity"] = replay.ring().capacity();
+            result["ring_high_water"] = replay.ring().high_water();
+            if (replay.merger() != nullptr && stats.finished.load()) {
+                result["out_of_order"] = replay.merger()->stats().out_of_order;
+            }
+            return result;
+        });
+
+    py::class_<JournalEventMerger>(m, "JournalEventMerger",
+                                   "Every SBE message of a set of journal files in (event time, template, update "
+                                   "id, file, position) order, the same on every run; not thread-safe")
+        .def(py::init([](const std::vector<std::string>& paths) {
+                 return std::make_unique<JournalEventMerger>(journal_files(paths));
+             }),
+             py::arg("paths"), "paths are journal files or directories of *.sbej files; ties go to name order")
+        .def("read", &journal_event_merger_read, py::arg("max_n") = std::size_t{1} << 16,
+             "The next max_n messages as columns: received_ts_us, event_ts_us, template_id, source (file index), "
+             "offsets (n + 1) into the concatenated frames bytes; None once every file is done")
+        .def_property_readonly("files", &JournalEventMerger::sources)
+        .def_property_readonly("stats", [](const JournalEventMerger& merger) {
+            py::dict result;
+            result["messages"] = merger.stats().messages;
+            result["out_of_order"] = merger.stats().out_of_order;
+            return result;
+        });
+
+    py::class_<EventLog>(m, "EventLogWriter")
+        .def(py::init([](const std::string& path, std::size_t capacity) {
+                 return std::make_unique<EventLog>(EventLog::create(path, capacity));
+             }),
+             py::arg("path"), py::arg("capacity") = std::size_t{1} << 20,
+             "Create (or replace) a shared-memory event log of `capacity` records, for frames received in Python")
+        .def("append",
+             [](EventLog& log, const py::buffer& data, uint64_t sequence,
+                const std::optional<uint64_t>& received_ts_us) {
+                 const FrameBuffer buffer(data);
+                 return append_frame(log, buffer.payload(), sequence, resolve_ingest_us(received_ts_us));
+             },
+             py::arg("data"), py::arg("sequence"), py::arg("received_ts_us") = py::none(),
+             "Decode one frame and publish its records; False if it needs more than capacity records")
+        .def_property_readonly("path", &EventLog::path)
+        .def_property_readonly("capacity", &EventLog::capacity)
+        .def_property_readonly("tail", &EventLog::tail, "Records published so far")
+        .def_property_readonly("stats", [](const EventLog& log) {
+            py::dict result;
+            event_log_stats_to_python(result, log);
+            return result;
+        });
+
+    py::class_<EventLogReader>(m, "EventLogReader")
+        .def(py::init([](const std::vector<std::string>& paths, bool raw, const std::string& start) {
+                 if (start != "latest" && start != "earliest") {
+                     throw py::value_error("start must be 'latest' or 'earliest', got '" + start + "'");
+                 }
+                 return std::make_unique<EventLogReader>(
+                     paths, raw, start == "latest" ? EventLogStart::Latest : EventLogStart::Earliest);
+             }),
+             py::arg("paths"), py::arg("raw") = false, py::arg("start") = "latest",
+             "Follow StreamReceiver event logs (see StreamReceiver.event_logs) from their tail, or from the "
+             "oldest record still held with start='earliest'")
+        .def("drain", &drain_receiver<EventLogReader>, py::arg("max_n") = std::size_t{1} << 16,
+             py::arg("timeout") = 1.0, py::arg("format") = "numpy",
+             "Same columns as StreamReceiver.drain; None if nothing was published within timeout seconds. "
+             "Records overwritten before they were read are counted in stats['lost_records']")
+        .def_property_readonly("stats", [](const EventLogReader& reader) {
+            uint64_t frames = 0, records = 0, lost_records = 0, reopens = 0;
+            py::list logs;
+            reader.for_each_source([&](const EventLogReader::SourceView& source) {
+                frames += source.stats.frames;
+                records += source.stats.records;
+                lost_records += source.stats.lost_records;
+                reopens += source.stats.reopens;
+                py::dict log;
+                log["path"] = source.path;
+                log["cursor"] = source.cursor;
+                log["tail"] = source.tail;
+                log["lag"] = source.tail > source.cursor ? source.tail - source.cursor : 0;
+                log["lost_records"] = source.stats.lost_records;
+                log["reopens"] = source.stats.reopens;
+                logs.append(log);
+            });
+            py::dict result;
+            result["frames"] = frames;
+            result["records"] = records;
+            result["lost_records"] = lost_records;
+            result["reopens"] = reopens;
+            result["logs"] = logs;
+            return result;
+        });
+
+    py::class_<MetricsServer>(m, "MetricsServer")
+        .def(py::init<std::string, uint16_t>(), py::arg("host") = "0.0.0.0", py::arg("port") = 9464,
+             "Prometheus exporter for the native counters of every decoder, receiver and decoder pool; "
+             "serves GET /metrics from its own thread without the GIL")
+        .def("start", &MetricsServer::start, "Bind and start serving; port 0 picks a free port")
+        .def("stop", &MetricsServer::stop, py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("running", &MetricsServer::running)
+        .def_property_readonly("host", &MetricsServer::host)
+        .def_property_readonly("port", &MetricsServer::port)
+        .def_property_readonly("scrapes", &MetricsServer::scrapes);
+
+    m.def("render_metrics", [] { return metrics_registry().render(); }, py::call_guard<py::gil_scoped_release>(),
+          "The native counters in Prometheus text format, as MetricsServer serves them");
+
+    m.def("depth_snapshot_checksum", &depth_snapshot_checksum_of, py::arg("data"), py::arg("depth") = 0,
+          "OrderBook.checksum(depth) of a book holding exactly the levels of a REST depth snapshot frame "
+          "(DepthResponse, template 200), read in place: one compare tells whether a live book still matches");
+    m.def("decode_depth_snapshot", &decode_depth_snapshot, py::arg("data"), py::arg("symbol") = "",
+          "Decode a REST depth snapshot frame (DepthResponse, template 200) straight into a new OrderBook, "
+          "without building level lists; apply the diffs after its last_update_id to bring it live");
+
+    m.def("read_journal", &read_journal, py::arg("path"), py::arg("start_ts_us") = py::none(),
+          py::arg("end_ts_us") = py::none(),
+          "Records of a journal file as columns: received_ts_us, sequence, connection_id, offsets (n + 1) "
+          "into the concatenated frames bytes, plus the file's created_ts_us. start_ts_us/end_ts_us bound the "
+          "receive times (inclusive); a rolled file's sparse index makes the start a seek rather than a scan");
+
+    m.def("decode_avro", &decode_avro_record, py::arg("data"),
+          "Decode a single-object Avro record (as written by serialize_records(format='avro')) into a dict, "
+          "or None for an unknown schema fingerprint");
+
+    m.def("feature_schema_hash",
+          [](const std::vector<std::string>& names) { return feature_schema_hash(names); }, py::arg("names"),
+          "FNV-1a hash of an ordered feature name list, the schema_hash of its feature records");
+    m.def("encode_feature_record", &encode_feature_record_to_python, py::arg("values"), py::arg("symbol"),
+          py::arg("event_ts_us"), py::arg("schema_hash"), py::arg("dtype") = "float32",
+          py::arg("written_ts_us") = py::none(),
+          "Pack a feature vector into a fixed-layout binary record: a 64-byte versioned header (symbol, "
+          "timestamps, schema hash) and the values as float32 or float64");
+    m.def("decode_feature_record", &decode_feature_record_to_python, py::arg("data"),
+          py::arg("schema_hash") = py::none(),
+          "Read a record written by encode_feature_record: dict of header fields plus a 'values' array; raises "
+          "ValueError on a malformed record or a schema_hash mismatch");
+    m.def("feature_records_to_matrix", &feature_records_to_matrix, py::arg("records"), py::arg("width"),
+          py::arg("schema_hash") = py::none(),
+          "Stack feature records (None for a missing one) into (event_ts_us, float32 (n, width) matrix) for one "
+          "batched prediction; missing rows and rows of another schema are NaN with ts 0");
+    m.attr("FEATURE_RECORD_VERSION") = FEATURE_RECORD_VERSION;
+
+    py::class_<FeatureHistoryChunk>(m, "FeatureHistoryChunk",
+                                    "Writer of a Gorilla-compressed feature history blob (delta-of-delta timestamps, "
+                                    "XOR-compressed values); append() returns the bytes to append to the blob")
+        .def(py::init<>())
+        .def(
+            "append",
+            [](FeatureHistoryChunk& chunk, uint64_t schema_hash, int64_t ts_us, const FloatColumn& values) {
+                std::string piece;
+                try {
+                    piece = chunk.append(schema_hash, ts_us, {values.data(), static_cast<std::size_t>(values.size())});
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+                return py::bytes(piece);
+            },
+            py::arg("schema_hash"), py::arg("ts_us"), py::arg("values"),
+            "Compress one row of schema_hash and return the bytes to append; the first append carries the blob "
+            "header and a schema's first row its definition. ValueError when the width does not match the schema")
+        .def(
+            "resume",
+            [](FeatureHistoryChunk& chunk, const py::buffer& data) {
+                FrameBuffer buffer{data};
+                try {
+                    chunk.resume(buffer.payload());
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("data"), "Continue an existing blob (e.g. after a restart); ValueError if it is malformed")
+        .def("reset", &FeatureHistoryChunk::reset, "Start a new blob")
+        .def_property_readonly("size", &FeatureHistoryChunk::size, "Bytes of the blob so far")
+        .def_property_readonly("rows", &FeatureHistoryChunk::rows)
+        .def_property_readonly("schemas", &FeatureHistoryChunk::schemas)
+        .def_property_readonly("full", &FeatureHistoryChunk::full, "No further schema fits in this blob");
+    m.def("decode_feature_history", &decode_feature_history_to_python, py::arg("blobs"),
+          "Decode feature history blobs (oldest first, None skipped) into one dict per schema: schema_hash, "
+          "timestamps_us and a float64 (rows, width) values matrix; raises ValueError on a malformed blob");
+    m.attr("FEATURE_HISTORY_VERSION") = FEATURE_HISTORY_VERSION;
+
+    m.def("column_stats", &column_stats_to_python, py::arg("price"), py::arg("qty") = py::none(),
+          "min, max, sum, sum_sq, mean, variance and stdev (sample) of a price column in one vectorised pass, "
+          "plus qty_sum, weighted_sum and vwap when a qty column is given");
+    m.attr("COLUMN_STATS_KERNEL") = column_stats_kernel();
+    // Detected here, at import; SBE_DECODER_SIMD must be set before it
+    m.attr("SIMD_LEVEL") = simd_level_name(simd_level());
+
+    m.def("parse_decimals", &parse_decimals_to_python, py::arg("values"), py::arg("exponent") = py::none(),
+          "Parse a column of decimal strings into int64 mantissa and int8 exponent arrays, digits as written "
+          "(\"65000.50\" is 6500050e-2); with exponent=e, into int64 counts of 10^e units instead, rows "
+          "finer than that invalid. Returns the arrays plus a valid mask and the invalid count");
+
+    m.def("page_memory_stats", &page_memory_stats_to_python,
+          "Bytes of native long-lived memory (rings, Bloom filters) by page backing ('normal', 'transparent', "
+          "'hugetlb'), huge-page requests that fell back to 4 KB pages, and NUMA placements the kernel refused");
+    m.def("memory_stats", &memory_stats_to_python,
+          "Live and reserved bytes of every native book, dedup table, ring, queue, capture journal and event log "
+          "mapping, by component and symbol ('' for memory no one symbol owns), plus the total");
+    m.def("cpu_numa_node", &cpu_numa_node, py::arg("cpu"), "NUMA node of a core, or -1 when unknown");
+
+    m.def("ingest_clock_us", &ingest_time_us,
+          "Current ingest clock reading (wall-anchored CLOCK_MONOTONIC_RAW, microseconds); "
+          "take one per receive batch and pass it as ingest_ts_us");
+
+    py::tuple trace_stages(TRACE_STAGE_COUNT);
+    for (std::size_t i = 0; i < TRACE_STAGE_COUNT; ++i) {
+        trace_stages[i] = py::str(TRACE_STAGE_NAMES[i]);
+    }
+    m.attr("TRACE_STAGES") = trace_stages;
+
+    py::tuple parse_errors(PARSE_ERROR_COUNT);
+    for (std::size_t i = 0; i < PARSE_ERROR_COUNT; ++i) {
+        parse_errors[i] = py::str(PARSE_ERROR_NAMES[i]);
+    }
+    m.attr("PARSE_ERRORS") = parse_errors;
+
+    py::class_<TraceCollector>(m, "TraceCollector",
+                               "Per-hop latency histograms (microseconds) of finished trace blocks")
+        .def(py::init<>())
+        .def(
+            "record", [](TraceCollector& collector, const py::sequence& trace) {
+                collector.record(trace_from_python(trace));
+            },
+            py::arg("trace"),
+            "Add one trace (TRACE_STAGES stamps in microseconds; 0 or None where a stage was not stamped)")
+        .def("summary", &trace_collector_summary,
+             "Per stage, count and p50/p99/p999/max/mean latency from the stamped stage before it; the same "
+             "for the whole trace as 'total', plus traces recorded and hops skewed by clock disagreement")
+        .def("reset", &TraceCollector::reset)
+        .def_property_readonly("traces", &TraceCollector::traces);
+
+    py::class_<ExchangeClock>(m, "ExchangeClock",
+                              "Offset and drift of the exchange's clock against the ingest clock, fitted over "
+                              "min-RTT-filtered round trips (see ClockSync)")
+        .def(py::init<>())
+        .def(
+            "add",
+            [](ExchangeClock& clock, uint64_t sent_us, uint64_t received_us, int64_t server_us,
+               uint64_t resolution_us) {
+                return clock.add(ClockSample{sent_us, received_us, server_us, resolution_us});
+            },
+            py::arg("sent_us"), py::arg("received_us"), py::arg("server_us"), py::arg("resolution_us") = 1,
+            "Take one round trip: ingest-clock send and receive times around the server's reading (in "
+            "microseconds, resolution_us its unit); False if rejected")
+        .def("to_local_us", &ExchangeClock::to_local_us, py::arg("exchange_us"),
+             "An exchange timestamp on the ingest clock; unchanged until synced")
+        .def(
+            "exchange_latency_us",
+            [](const ExchangeClock& clock, uint64_t event_us, const std::optional<uint64_t>& received_ts_us) {
+                return clock.exchange_latency_us(event_us, resolve_ingest_us(received_ts_us));
+            },
+            py::arg("event_us"), py::arg("received_ts_us") = py::none(),
+            "Offset-corrected microseconds from an exchange event time to its receive (default: now)")
+        .def("reset", &ExchangeClock::reset)
+        .def_property_readonly("synced", &ExchangeClock::synced)
+        .def_property_readonly("stats", &exchange_clock_to_python,
+                               "The estimate (offset_us now, drift_ppm, error_us, min_rtt_us) and sample counts");
+
+    m.def("exchange_clock", &exchange_clock, py::return_value_policy::reference,
+          "The process-wide ExchangeClock that ClockSync updates and StreamReceiver and trace stamps read");
+
+    py::class_<ClockSync>(m, "ClockSync",
+                          "Keeps exchange_clock() synced: every interval, a burst of `time` requests over its own "
+                          "WebSocket API connection, the fastest round trip becoming a sample")
+        .def(py::init([](std::string host, uint16_t port, std::string path, bool use_tls, std::string api_key,
+                         double interval, int burst, double response_timeout, bool governed) {
+                 ClockSyncConfig config;
+                 config.api.host = std::move(host);
+                 config.api.port = port;
+                 if (!path.empty()) {
+                     config.api.path = std::move(path);
+                 }
+                 config.api.use_tls = use_tls;
+                 config.api.api_key = std::move(api_key);
+                 config.api.response_timeout_ms = static_cast<int>(response_timeout * 1000);
+                 config.api.governed = governed;
+                 config.interval_ms = static_cast<int>(interval * 1000);
+                 config.burst = burst;
+                 return std::make_unique<ClockSync>(std::move(config));
+             }),
+             py::arg("host") = "ws-api.binance.com", py::arg("port") = 443, py::arg("path") = "",
+             py::arg("use_tls") = true, py::arg("api_key") = "", py::arg("interval") = 30.0, py::arg("burst") = 8,
+             py::arg("response_timeout") = 2.0, py::arg("governed") = true,
+             "An empty path asks for SBE responses with microsecond server times. Each request weighs 1 against "
+             "rate_governor() when governed")
+        .def("start", &ClockSync::start, "Sync now, then every interval seconds on a background thread")
+        .def("stop", &ClockSync::stop, py::call_guard<py::gil_scoped_release>())
+        .def("sync", &ClockSync::sync, py::call_guard<py::gil_scoped_release>(),
+             "One burst on the calling thread (not while started); True when it gave the clock a sample")
+        .def_property_readonly("running", &ClockSync::running)
+        .def_property_readonly("stats", &clock_sync_stats_to_python);
+
+    py::class_<ShardRing>(m, "ShardRing",
+                          "Consistent-hash ring of ingest nodes, each at `vnodes` points; a symbol belongs to the "
+                          "node at the first point at or after its hash")
+        .def(py::init([](std::vector<std::string> nodes, uint32_t vnodes) {
+                 try {
+                     return std::make_unique<ShardRing>(std::move(nodes), vnodes);
+                 } catch (const std::runtime_error& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("nodes"), py::arg("vnodes") = 128)
+        .def(
+            "owner",
+            [](const ShardRing& ring, const std::string& symbol) {
+                try {
+                    return ring.owner(symbol);
+                } catch (const std::runtime_error& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("symbol"), "Node owning the symbol (case-insensitive)")
+        .def(
+            "owned",
+            [](const ShardRing& ring, const std::vector<std::string>& symbols, const std::string& node) {
+                return ring.owned(symbols, node);
+            },
+            py::arg("symbols"), py::arg("node"), "The upper-cased symbols `node` owns, in their order")
+        .def_property_readonly("nodes", &ShardRing::nodes)
+        .def_property_readonly("vnodes", &ShardRing::vnodes);
+
+    py::class_<ShardLeaseManager, std::unique_ptr<ShardLeaseManager, ShardLeaseManagerDelete>>(
+        m, "ShardLeaseManager",
+        "Holds this node's share of the symbols through Redis leases, renewed on a background thread; a ShardRing "
+        "over the live nodes decides the shares")
+        .def(py::init([](std::string node_id, std::vector<std::string> symbols, std::string host, uint16_t port,
+                         std::string password, int db, std::string key_prefix, uint32_t vnodes, double lease,
+                         double interval, double stop_budget, double timeout, std::optional<py::function> transport) {
+                 ShardLeaseConfig config;
+                 config.node_id = std::move(node_id);
+                 config.symbols = std::move(symbols);
+                 config.redis.host = std::move(host);
+                 config.redis.port = port;
+                 config.redis.password = std::move(password);
+                 config.redis.db = db;
+                 config.key_prefix = std::move(key_prefix);
+                 config.vnodes = vnodes;
+                 config.lease_ms = static_cast<int>(lease * 1000);
+                 config.interval_ms = static_cast<int>(interval * 1000);
+                 config.stop_budget_ms = static_cast<int>(stop_budget * 1000);
+                 config.redis.connect_timeout_ms = static_cast<int>(timeout * 1000);
+                 config.redis.io_timeout_ms = static_cast<int>(timeout * 1000);
+                 ShardLeaseManager::Transport redis;
+                 if (transport) {
+                     redis = shard_transport_from_python(std::move(*transport));
+                 }
+                 return std::unique_ptr<ShardLeaseManager, ShardLeaseManagerDelete>(
+                     new ShardLeaseManager(std::move(config), std::move(redis)));
+             }),
+             py::arg("node_id"), py::arg("symbols"), py::arg("host") = "127.0.0.1", py::arg("port") = 6379,
+             py::arg("password") = "", py::arg("db") = 0, py::arg("key_prefix") = "{sbe-shard}:",
+             py::arg("vnodes") = 128, py::arg("lease") = 10.0, py::arg("interval") = 0.5,
+             py::arg("stop_budget") = 1.0, py::arg("timeout") = 2.0, py::arg("transport") = py::none(),
+             "Every node needs the same symbols, vnodes and key_prefix. A lease is reported lost stop_budget "
+             "seconds before Redis can expire it, so lease must exceed interval, stop_budget, and timeout (Redis "
+             "connect, send and receive) three times. transport(args) -> None, int, str, bytes or a list of them "
+             "replaces the Redis connection (tests)")
+        .def("start", &ShardLeaseManager::start, "Run a round now, then every interval seconds on a background thread")
+        .def("stop", &ShardLeaseManager::stop, py::arg("release") = true, py::call_guard<py::gil_scoped_release>(),
+             "Stop renewing; with release, also release every lease and leave the ring (checkpoint books first)")
+        .def("tick", &ShardLeaseManager::tick, py::call_guard<py::gil_scoped_release>(),
+             "One round on the calling thread (not while started); False when it failed")
+        .def("release", &ShardLeaseManager::release, py::arg("symbols"),
+             "Release the leases of symbols reported as releasing, once their streams are stopped and their books "
+             "checkpointed")
+        .def("take_changes",
+             [](ShardLeaseManager& leases) { return shard_changes_to_python(leases.take_changes()); },
+             "{'acquired': [{'symbol', 'released_ms', 'acquired_ms'}], 'releasing': [...], 'lost': [...]} since "
+             "the last call: start the acquired symbols' streams, hand off the releasing ones, stop the lost ones "
+             "at once")
+        .def(
+            "wait_changes",
+            [](ShardLeaseManager& leases, double timeout) {
+                py::gil_scoped_release release;
+                return leases.wait_changes(static_cast<int>(timeout * 1000));
+            },
+            py::arg("timeout"), "Wait up to timeout seconds for changes; True when there are some")
+        .def_property_readonly("owned", &ShardLeaseManager::owned)
+        .def_property_readonly("releasing", &ShardLeaseManager::releasing)
+        .def_property_readonly("members", &ShardLeaseManager::members)
+        .def_property_readonly("node_id", [](const ShardLeaseManager& leases) { return leases.config().node_id; })
+        .def_property_readonly("running", &ShardLeaseManager::running)
+        .def_property_readonly("stats", &shard_lease_stats_to_python);
+
+    py::class_<TimerWheel>(m, "TimerWheel",
+                           "Hierarchical timer wheel firing periodic timers on a fixed grid of Unix-time "
+                           "microseconds; driven by advance() from one thread")
+        .def(py::init([](uint64_t tick_us, const std::optional<uint64_t>& now_ts_us) {
+                 try {
+                     return std::make_unique<TimerWheel>(tick_us, resolve_ingest_us(now_ts_us));
+                 } catch (const std::invalid_argument& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("tick_us") = 1000, py::arg("now_ts_us") = py::none())
+        .def(
+            "add",
+            [](TimerWheel& wheel, double period, double phase) {
+                if (!(period > 0) || phase < 0) {
+                    throw py::value_error("period must be positive and phase not negative");
+                }
+                try {
+                    return wheel.add(static_cast<uint64_t>(std::llround(period * 1e6)),
+                                     static_cast<uint64_t>(std::llround(phase * 1e6)));
+                } catch (const std::invalid_argument& e) {
+                    throw py::value_error(e.what());
+                }
+            },
+            py::arg("period"), py::arg("phase") = 0.0,
+            "Timer id of a new timer firing every `period` seconds, at Unix times that are `phase` past a "
+            "multiple of it")
+        .def("cancel", &TimerWheel::cancel, py::arg("timer_id"))
+        .def(
+            "advance",
+            [](TimerWheel& wheel, const std::optional<uint64_t>& now_ts_us) {
+                py::list fired;
+                wheel.advance(resolve_ingest_us(now_ts_us), [&](const TimerFired& timer) {
+                    fired.append(py::make_tuple(timer.id, timer.due_us, timer.lag_us));
+                });
+                return fired;
+            },
+            py::arg("now_ts_us") = py::none(),
+            "(timer_id, due_us, lag_us) for each timer due by now, in due order. A timer that missed grid "
+            "times fires once, for the latest of them")
+        .def_property_readonly("next_due_us",
+                               [](const TimerWheel& wheel) -> std::optional<uint64_t> {
+                                   const uint64_t due = wheel.next_due_us();
+                                   return due == UINT64_MAX ? std::nullopt : std::optional<uint64_t>(due);
+                               },
+                               "Grid time of the next firing, or None without timers")
+        .def("__len__", &TimerWheel::size)
+        .def_property_readonly("stats", [](const TimerWheel& wheel) {
+            const TimerWheelStats& stats = wheel.stats();
+            py::dict result;
+            result["timers"] = wheel.size();
+            result["fired"] = stats.fired;
+            result["skipped"] = stats.skipped;
+            result["lag"] = trace_hop_summary(stats.lag);
+            return result;
+        });
+
+    py::class_<BarBuilder>(m, "BarBuilder",
+                           "Time, tick, volume or dollar bars (OHLCV, VWAP, taker buy/sell volume) from trade "
+                           "columns, one open bar per symbol")
+        .def(py::init([](const std::string& kind, double threshold) {
+                 BarConfig config;
+                 config.kind = bar_kind_from_name(kind);
+                 config.threshold = config.kind == BarKind::Time ? threshold * 1e3 : threshold;
+                 try {
+                     return std::make_unique<BarBuilder>(config);
+                 } catch (const std::invalid_argument& e) {
+                     throw py::value_error(e.what());
+                 }
+             }),
+             py::arg("kind") = "time", py::arg("threshold") = 60.0,
+             "threshold is the interval in seconds for time bars, else trades, base volume or quote volume "
+             "per bar")
+        .def("add_batch", &add_bar_trades, py::arg("trade_time"), py::arg("price"), py::arg("qty"),
+             py::arg("is_buyer_maker"), py::arg("symbol"), py::arg("trade_id") = py::none(),
+             "Absorb the rows of a decode_batch trades table (trade_time in ms), in time order per symbol")
+        .def("advance", &BarBuilder::advance, py::arg("now_ms"),
+             "Close the time bars whose interval ended by now_ms")
+        .def("flush", &BarBuilder::flush, "Close every open bar")
+        .def(
+            "drain",
+            [](BarBuilder& builder, const std::string& format) {
+                const bool arrow = arrow_format_from_name(format, "drain");
+                BarColumns bars = builder.take();
+                return arrow ? bars_to_table<ArrowTable>(std::move(bars)) : bars_to_table<NumpyTable>(std::move(bars));
+            },
+            py::arg("format") = "numpy", "The bars closed since the last drain, as one table")
+        .def_property_readonly("open_bars", &BarBuilder::open_bars)
+        .def_property_readonly("pending", &BarBuilder::pending)
+        .def_property_readonly("bars", &BarBuilder::bars);
+
+    m.def(
+        "klines_from_trades",
+        [](const OffsetsArray& trade_time, const FloatColumn& price, const FloatColumn& qty,
+           const FlagColumn& is_buyer_maker, const std::string& symbol, double interval_seconds,
+           const std::string& format) {
+            const bool arrow = arrow_format_from_name(format, "klines_from_trades");
+            std::optional<BarBuilder> builder;
+            try {
+                builder.emplace(BarConfig{BarKind::Time, interval_seconds * 1e3});
+            } catch (const std::invalid_argument& e) {
+                throw py::value_error(e.what());
+            }
+            add_bar_trades(*builder, trade_time, price, qty, is_buyer_maker, py::str(symbol), std::nullopt);
+            builder->flush();
+            KlineColumns klines = klines_from_bars(builder->take(), symbol_table().find(symbol));
+            return arrow ? klines_to_table<ArrowTable>(std::move(klines), false)
+                         : klines_to_table<NumpyTable>(std::move(klines), false);
+        },
+        py::arg("trade_time"), py::arg("price"), py::arg("qty"), py::arg("is_buyer_maker"), py::arg("symbol"),
+        py::arg("interval_seconds") = 60.0, py::arg("format") = "numpy",
+        "Klines of one symbol's decode_batch trade columns, as the table decode_batch gives for a REST klines "
+        "page (frame_index -1)");
+    m.def(
+        "diff_klines",
+        [](const py::dict& built, const py::dict& rest, double volume_tolerance) {
+            std::vector<py::array> keep;
+            const KlineView built_view = kline_table_view(built, keep, "built");
+            const KlineView rest_view = kline_table_view(rest, keep, "rest");
+            KlineDiffColumns rows;
+            const KlineDiffSummary summary = diff_klines(built_view, rest_view, volume_tolerance, rows);
+            return kline_diff_to_python(summary, std::move(rows));
+        },
+        py::arg("built"), py::arg("rest"), py::arg("volume_tolerance") = 1e-9,
+        "Diff klines built from trades against REST klines (both scaled tables ascending by open_time) in one "
+        "pass: counts plus one row per disagreeing interval, with a mismatch bitmask over KLINE_DIFF_FIELDS");
+
     // Export stream template IDs (as expected by binance_sbe.py)
     m.attr("TRADES_STREAM_EVENT") = TRADES_STREAM_EVENT;
     m.attr("BEST_BID_ASK_STREAM_EVENT") = BEST_BID_ASK_STREAM_EVENT;
+    m.attr("DEPTH_SNAPSHOT_STREAM_EVENT") = DEPTH_SNAPSHOT_STREAM_EVENT;
     m.attr("DEPTH_DIFF_STREAM_EVENT") = DEPTH_DIFF_STREAM_EVENT;
     
+    py::tuple book_feature_names(BOOK_FEATURE_COUNT);
+    for (std::size_t i = 0; i < BOOK_FEATURE_COUNT; ++i) {
+        book_feature_names[i] = BOOK_FEATURE_NAMES[i];
+    }
+    m.attr("BOOK_FEATURE_NAMES") = book_feature_names;
+
+    py::tuple kline_diff_fields(std::size(KLINE_DIFF_FIELD_NAMES));
+    for (std::size_t i = 0; i < std::size(KLINE_DIFF_FIELD_NAMES); ++i) {
+        kline_diff_fields[i] = KLINE_DIFF_FIELD_NAMES[i];
+    }
+    m.attr("KLINE_DIFF_FIELDS") = kline_diff_fields;
+
     // Export schema constants
     m.attr("EXPECTED_SCHEMA_ID") = EXPECTED_SCHEMA_ID;
     m.attr("EXPECTED_SCHEMA_VERSION") = EXPECTED_SCHEMA_VERSION;
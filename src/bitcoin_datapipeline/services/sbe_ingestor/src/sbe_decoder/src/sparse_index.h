@@ -0,0 +1,226 @@
+/*
+ * Sparse block index kept next to tick store files and capture journals.
+ *
+ * One entry per block of the data file: its offset and size, row count,
+ * and min/max timestamp and ID. In a tick file a block is a column block
+ * and the ID its update or trade ID; in a journal a block is a run of
+ * records of about JOURNAL_INDEX_BLOCK_BYTES, the timestamp their receive
+ * time and the ID their sequence number. The index lives in
+ * {data file}.idx: a 16-byte SparseIndexFileHeader ("SBEIDX1\0", version,
+ * entry size), then the entries in file order. A range read loads a few
+ * KB of index instead of touching every block of a day of data.
+ *
+ * The data file stays authoritative. Readers keep only the entries that
+ * tile the data file from its header on (an index lagging behind a crash
+ * or left over from a truncated file loses its tail) and find the rest by
+ * walking the data, so a missing or stale index costs time, never rows.
+ *
+ * Blocks come in arrival order, so their time and ID ranges are nearly
+ * but not strictly sorted. SparseIndex keeps a running max of the blocks'
+ * max keys and, from the end, a running min of their min keys; both are
+ * monotonic, so the blocks that can hold keys in [from, to] form one span
+ * found by binary search, and only those get decoded.
+ */
+
+#ifndef _SBE_SPARSE_INDEX_H_
+#define _SBE_SPARSE_INDEX_H_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr char SPARSE_INDEX_MAGIC[8] = {'S', 'B', 'E', 'I', 'D', 'X', '1', '\0'};
+constexpr uint32_t SPARSE_INDEX_VERSION = 1;
+
+struct SparseIndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+};
+static_assert(sizeof(SparseIndexFileHeader) == 16);
+
+struct SparseIndexEntry {
+    uint64_t offset;
+    // Whole block, in bytes of the data file
+    uint64_t size;
+    uint64_t rows;
+    int64_t min_ts_us;
+    int64_t max_ts_us;
+    int64_t min_id;
+    int64_t max_id;
+};
+static_assert(sizeof(SparseIndexEntry) == 56);
+
+enum class SparseKey : uint8_t { Time = 0, Id = 1 };
+
+inline std::string sparse_index_path(const std::string &data_path) { return data_path + ".idx"; }
+
+namespace sparse_index_detail {
+
+inline std::string errno_message(const std::string &what, const std::string &path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+inline void write_all(int fd, const char *data, std::size_t size, const std::string &path) {
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(errno_message("cannot write index", path));
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+}
+
+inline std::pair<int64_t, int64_t> keys(const SparseIndexEntry &entry, SparseKey key) {
+    return key == SparseKey::Time ? std::pair{entry.min_ts_us, entry.max_ts_us} : std::pair{entry.min_id, entry.max_id};
+}
+
+} // namespace sparse_index_detail
+
+// Entries of an index file; false when it is missing or not an index. A
+// partial last entry (a write cut short) is dropped.
+inline bool read_sparse_index(const std::string &path, std::vector<SparseIndexEntry> &out) {
+    out.clear();
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st {};
+    SparseIndexFileHeader header{};
+    bool valid = ::fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= sizeof(header) &&
+                 ::pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+                 std::memcmp(header.magic, SPARSE_INDEX_MAGIC, sizeof(SPARSE_INDEX_MAGIC)) == 0 &&
+                 header.version == SPARSE_INDEX_VERSION && header.entry_size == sizeof(SparseIndexEntry);
+    if (valid) {
+        out.resize((static_cast<std::size_t>(st.st_size) - sizeof(header)) / sizeof(SparseIndexEntry));
+        const std::size_t bytes = out.size() * sizeof(SparseIndexEntry);
+        valid = ::pread(fd, out.data(), bytes, sizeof(header)) == static_cast<ssize_t>(bytes);
+    }
+    ::close(fd);
+    if (!valid) {
+        out.clear();
+    }
+    return valid;
+}
+
+// Replace an index file with `entries`, through a rename so readers see
+// the old file or the new one
+inline void write_sparse_index(const std::string &path, std::span<const SparseIndexEntry> entries) {
+    const std::string temporary = path + ".tmp";
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error(sparse_index_detail::errno_message("cannot create index", temporary));
+    }
+    try {
+        SparseIndexFileHeader header{};
+        std::memcpy(header.magic, SPARSE_INDEX_MAGIC, sizeof(SPARSE_INDEX_MAGIC));
+        header.version = SPARSE_INDEX_VERSION;
+        header.entry_size = sizeof(SparseIndexEntry);
+        sparse_index_detail::write_all(fd, reinterpret_cast<const char *>(&header), sizeof(header), temporary);
+        sparse_index_detail::write_all(fd, reinterpret_cast<const char *>(entries.data()),
+                                       entries.size() * sizeof(SparseIndexEntry), temporary);
+    } catch (...) {
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw;
+    }
+    ::close(fd);
+    if (::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        throw std::runtime_error(sparse_index_detail::errno_message("cannot rename index", temporary));
+    }
+}
+
+// Keep the entries that tile the data file from `begin` on without
+// passing `end`; returns the offset the kept ones reach
+inline std::size_t sparse_index_chain(std::vector<SparseIndexEntry> &entries, std::size_t begin, std::size_t end) {
+    std::size_t offset = begin;
+    std::size_t kept = 0;
+    for (const SparseIndexEntry &entry : entries) {
+        if (entry.offset != offset || entry.size == 0 || entry.size > end - offset) {
+            break;
+        }
+        offset += entry.size;
+        ++kept;
+    }
+    entries.resize(kept);
+    return offset;
+}
+
+class SparseIndex {
+public:
+    SparseIndex() = default;
+
+    explicit SparseIndex(std::vector<SparseIndexEntry> entries) : entries_(std::move(entries)) {
+        for (const SparseKey key : {SparseKey::Time, SparseKey::Id}) {
+            Bounds &bounds = bounds_[static_cast<std::size_t>(key)];
+            bounds.running_max.resize(entries_.size());
+            bounds.suffix_min.resize(entries_.size());
+            int64_t high = std::numeric_limits<int64_t>::min();
+            for (std::size_t i = 0; i < entries_.size(); ++i) {
+                high = std::max(high, sparse_index_detail::keys(entries_[i], key).second);
+                bounds.running_max[i] = high;
+            }
+            int64_t low = std::numeric_limits<int64_t>::max();
+            for (std::size_t i = entries_.size(); i-- > 0;) {
+                low = std::min(low, sparse_index_detail::keys(entries_[i], key).first);
+                bounds.suffix_min[i] = low;
+            }
+        }
+    }
+
+    const std::vector<SparseIndexEntry> &entries() const { return entries_; }
+    std::size_t size() const { return entries_.size(); }
+    const SparseIndexEntry &operator[](std::size_t block) const { return entries_[block]; }
+
+    // [begin, end): the blocks that can hold keys in [from, to]. Every
+    // block outside it misses the range; one inside may still, and
+    // overlaps() tells.
+    std::pair<std::size_t, std::size_t> span(SparseKey key, int64_t from, int64_t to) const {
+        const Bounds &bounds = bounds_[static_cast<std::size_t>(key)];
+        const auto begin = std::partition_point(bounds.running_max.begin(), bounds.running_max.end(),
+                                                [from](int64_t high) { return high < from; });
+        const auto end = std::partition_point(bounds.suffix_min.begin() + (begin - bounds.running_max.begin()),
+                                              bounds.suffix_min.end(), [to](int64_t low) { return low <= to; });
+        return {static_cast<std::size_t>(begin - bounds.running_max.begin()),
+                static_cast<std::size_t>(end - bounds.suffix_min.begin())};
+    }
+
+    static bool overlaps(const SparseIndexEntry &entry, SparseKey key, int64_t from, int64_t to) {
+        const auto [low, high] = sparse_index_detail::keys(entry, key);
+        return low <= to && high >= from;
+    }
+
+    // Every key of the block lies in [from, to]
+    static bool covered(const SparseIndexEntry &entry, SparseKey key, int64_t from, int64_t to) {
+        const auto [low, high] = sparse_index_detail::keys(entry, key);
+        return low >= from && high <= to;
+    }
+
+private:
+    struct Bounds {
+        std::vector<int64_t> running_max;
+        std::vector<int64_t> suffix_min;
+    };
+
+    std::vector<SparseIndexEntry> entries_;
+    std::array<Bounds, 2> bounds_;
+};
+
+#endif
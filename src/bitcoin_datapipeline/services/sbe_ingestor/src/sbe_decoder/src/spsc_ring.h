@@ -0,0 +1,135 @@
+/*
+ * Bounded single-producer / single-consumer ring.
+ *
+ * Slots are preallocated once; the producer writes records in place and
+ * publishes them with a single release store, so a group of slots (one
+ * frame's records) becomes visible to the consumer all at once or not at
+ * all. Head and tail live on separate cache lines, each next to a cached
+ * copy of the other side's index, so the hot path touches the shared line
+ * only when the cached view runs out. Neither side ever blocks or
+ * allocates; a full ring is reported to the producer, which decides what to
+ * drop. The slots live in a PageMemory (page_memory.h), so a ring can be
+ * backed by huge pages and placed on its producer's NUMA node.
+ */
+
+#ifndef _SBE_SPSC_RING_H_
+#define _SBE_SPSC_RING_H_
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+#include "memory_accounting.h"
+#include "page_memory.h"
+
+// Fixed rather than std::hardware_destructive_interference_size, which
+// varies with -march and warns when used in headers
+inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+template <typename T>
+class SpscRing {
+public:
+    static_assert(std::is_trivially_destructible_v<T>, "slots are never destroyed, only unmapped");
+
+    // Capacity is rounded up to a power of two
+    explicit SpscRing(std::size_t capacity, const MemoryPlacement &placement = {})
+        : capacity_(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity)), mask_(capacity_ - 1),
+          memory_(capacity_ * sizeof(T), placement), slots_(static_cast<T *>(memory_.data())) {
+        std::uninitialized_value_construct_n(slots_, capacity_);
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    std::size_t capacity() const { return capacity_; }
+    const PageMemory &memory() const { return memory_; }
+
+    // Producer side ------------------------------------------------------
+
+    // Slots the producer may fill before publishing. The consumer's head is
+    // only re-read when the cached view has fewer than `wanted` free.
+    std::size_t writable(std::size_t wanted = 1) {
+        const uint64_t tail = producer_.tail.load(std::memory_order_relaxed);
+        std::size_t free = capacity_ - static_cast<std::size_t>(tail - producer_.cached_head);
+        if (free < wanted) {
+            producer_.cached_head = consumer_.head.load(std::memory_order_acquire);
+            free = capacity_ - static_cast<std::size_t>(tail - producer_.cached_head);
+        }
+        return free;
+    }
+
+    // Slot `offset` past the last published record; offset < writable()
+    T &write_slot(std::size_t offset) {
+        return slots_[(producer_.tail.load(std::memory_order_relaxed) + offset) & mask_];
+    }
+
+    // Make the next `count` written slots visible to the consumer
+    void publish(std::size_t count) {
+        const uint64_t tail = producer_.tail.load(std::memory_order_relaxed) + count;
+        producer_.tail.store(tail, std::memory_order_release);
+        const auto occupancy = static_cast<std::size_t>(tail - producer_.cached_head);
+        if (occupancy > producer_.high_water.load(std::memory_order_relaxed)) {
+            producer_.high_water.store(occupancy, std::memory_order_relaxed);
+        }
+    }
+
+    // Consumer side ------------------------------------------------------
+
+    // Published records not yet released. The producer's tail is only
+    // re-read when the cached view has fewer than `wanted` ready.
+    std::size_t readable(std::size_t wanted = 1) {
+        const uint64_t head = consumer_.head.load(std::memory_order_relaxed);
+        if (consumer_.cached_tail - head < wanted) {
+            consumer_.cached_tail = producer_.tail.load(std::memory_order_acquire);
+        }
+        return static_cast<std::size_t>(consumer_.cached_tail - head);
+    }
+
+    // Record `offset` past the oldest unreleased one; offset < readable()
+    const T &read_slot(std::size_t offset) const {
+        return slots_[(consumer_.head.load(std::memory_order_relaxed) + offset) & mask_];
+    }
+
+    // Hand `count` read slots back to the producer
+    void release(std::size_t count) {
+        consumer_.head.store(consumer_.head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Largest occupancy the producer has seen. Measured against its cached
+    // view of the head, so it can overstate but never understate.
+    std::size_t high_water() const { return producer_.high_water.load(std::memory_order_relaxed); }
+
+    // Records published and not yet released, as seen from any thread
+    std::size_t occupancy() const {
+        const uint64_t head = consumer_.head.load(std::memory_order_acquire);
+        return static_cast<std::size_t>(producer_.tail.load(std::memory_order_acquire) - head);
+    }
+
+    // Bytes of the waiting records against the whole mapping
+    MemoryUsage memory_usage() const { return {occupancy() * sizeof(T), memory_.size()}; }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) ProducerLine {
+        std::atomic<uint64_t> tail{0};
+        uint64_t cached_head = 0;
+        std::atomic<std::size_t> high_water{0};
+    };
+
+    struct alignas(CACHE_LINE_SIZE) ConsumerLine {
+        std::atomic<uint64_t> head{0};
+        uint64_t cached_tail = 0;
+    };
+
+    ProducerLine producer_;
+    ConsumerLine consumer_;
+    const std::size_t capacity_;
+    const std::size_t mask_;
+    PageMemory memory_;
+    T *slots_;
+};
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ * Plain C++ parsing of the SBE market-data stream templates.
+ *
+ * Nothing in here touches Python objects, so these routines can run with
+ * the GIL released (see batch_decode.h). The pybind11 layer in
+ * sbe_decoder.cpp turns the parsed frames into Python results.
+ *
+ * The parsers wrap the spot_stream flyweights (include/spot_stream/), which
+ * validate the fixed block and every group's extent once per frame; each
+ * field is then a single unaligned load at a constexpr offset. The entry
+ * loops (for_each_trade_entry, for_each_level) trust that validation and
+ * run without a branch per field: what varies per group, such as whether
+ * trade entries carry isBuyerMaker, is decided once before the loop.
+ *
+ * Parsers never throw: they return a ParseError naming the first check a
+ * malformed frame failed. The checks are [[unlikely]] branches and the
+ * error path allocates nothing, so a burst of bad frames costs about what
+ * the good ones do. Callers that want an exception use throw_parse_error.
+ */
+
+#ifndef _SBE_STREAM_DECODE_H_
+#define _SBE_STREAM_DECODE_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+
+#include "ingest_clock.h"
+#include "parse_error.h"
+#include "spot_stream/BestBidAskStreamEvent.h"
+#include "spot_stream/DepthDiffStreamEvent.h"
+#include "spot_stream/DepthSnapshotStreamEvent.h"
+#include "spot_stream/TradesStreamEvent.h"
+
+// Stream template IDs for WebSocket streams (as expected by binance_sbe.py)
+constexpr uint16_t TRADES_STREAM_EVENT = spot_stream::TradesStreamEvent::SBE_TEMPLATE_ID;
+constexpr uint16_t BEST_BID_ASK_STREAM_EVENT = spot_stream::BestBidAskStreamEvent::SBE_TEMPLATE_ID;
+constexpr uint16_t DEPTH_SNAPSHOT_STREAM_EVENT =
+    spot_stream::DepthSnapshotStreamEvent::SBE_TEMPLATE_ID; // depth<N>@100ms partial book
+constexpr uint16_t DEPTH_DIFF_STREAM_EVENT = spot_stream::DepthDiffStreamEvent::SBE_TEMPLATE_ID;
+
+// Schema constants
+constexpr uint16_t EXPECTED_SCHEMA_ID = spot_stream::SBE_SCHEMA_ID;
+constexpr uint16_t EXPECTED_SCHEMA_VERSION = spot_stream::SBE_SCHEMA_VERSION;
+
+// Why a frame could not be decoded (try_decode, batch error counts)
+enum class DecodeStatus : uint8_t {
+    Ok,
+    TooShort,        // shorter than the 8-byte message header
+    SchemaMismatch,  // schemaId is not EXPECTED_SCHEMA_ID
+    UnknownTemplate, // no decoder for the templateId
+    Malformed,       // body truncated or inconsistent with its header
+};
+
+// Decode policies. Diagnostic work (offsets, raw mantissas, hex previews)
+// is guarded by `if constexpr (Mode::diagnostics)`, so the production
+// instantiation compiles it out entirely.
+struct ProductionMode {
+    static constexpr bool diagnostics = false;
+};
+
+struct DiagnosticMode {
+    static constexpr bool diagnostics = true;
+};
+
+// Symbol used when a frame carries no symbol of its own
+constexpr std::string_view DEFAULT_SYMBOL = "BTCUSDT";
+
+// Transparent hash so symbol-keyed maps can be looked up by string_view
+struct SymbolHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view symbol) const { return std::hash<std::string_view>{}(symbol); }
+};
+
+// Read a T at `offset` and advance past it; false if the buffer ends first
+template <typename T>
+[[nodiscard]] bool read_little_endian(const char *data, std::size_t data_size, std::size_t &offset,
+                                      T &value) noexcept {
+    if (offset + sizeof(T) > data_size) [[unlikely]] {
+        return false;
+    }
+    std::memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+// Powers of ten for every int8 exponent magnitude (10^0 .. 10^128). Up to
+// 10^22 the entries are exact, so dividing by them is correctly rounded.
+inline constexpr auto POW10_TABLE = [] {
+    std::array<double, 129> table{};
+    double value = 1.0;
+    for (auto &entry : table) {
+        entry = value;
+        value *= 10.0;
+    }
+    return table;
+}();
+
+// Integer powers of ten for exact mantissa rescaling (10^0 .. 10^18)
+inline constexpr auto POW10_I64_TABLE = [] {
+    std::array<int64_t, 19> table{};
+    table[0] = 1;
+    for (std::size_t i = 1; i < table.size(); ++i) {
+        table[i] = table[i - 1] * 10;
+    }
+    return table;
+}();
+
+inline int64_t pow10_i64(int exponent) {
+    if (exponent < 0 || exponent >= static_cast<int>(POW10_I64_TABLE.size())) {
+        throw std::runtime_error("SBE decode: exponent change out of int64 range");
+    }
+    return POW10_I64_TABLE[exponent];
+}
+
+inline double decode_decimal(int64_t mantissa, int8_t exponent) {
+    // Binance SBE uses mantissa * 10^exponent format
+    // Exponent is typically negative (e.g. -8) meaning divide by 10^8
+    const auto value = static_cast<double>(mantissa);
+    return exponent >= 0 ? value * POW10_TABLE[exponent] : value / POW10_TABLE[-exponent];
+}
+
+// uint128 mantissa (two little-endian uint64 words), as used by kline volumes
+inline double decode_decimal_u128(const char *data, int8_t exponent) {
+    uint64_t low = 0;
+    uint64_t high = 0;
+    std::memcpy(&low, data, sizeof(low));
+    std::memcpy(&high, data + sizeof(low), sizeof(high));
+    const double value = static_cast<double>(high) * 18446744073709551616.0 + static_cast<double>(low);
+    return exponent >= 0 ? value * POW10_TABLE[exponent] : value / POW10_TABLE[-exponent];
+}
+
+inline uint64_t micros_to_millis(uint64_t micros) {
+    return micros / 1000;
+}
+
+inline uint64_t get_current_time_millis() {
+    return micros_to_millis(ingest_time_us());
+}
+
+// A flyweight's symbol, or DEFAULT_SYMBOL when the frame ends before the
+// string or the string is empty
+inline std::string_view symbol_or_default(std::string_view symbol) {
+    return symbol.empty() ? DEFAULT_SYMBOL : symbol;
+}
+
+// One entry of the template 10000 trades group
+struct TradeEntry {
+    uint64_t trade_id = 0;
+    int64_t price_mantissa = 0;
+    int64_t qty_mantissa = 0;
+    bool is_buyer_maker = false;
+};
+
+// Template 10000. The first group entry is copied into the frame for the
+// single-trade dict API; use for_each_trade_entry to visit all of them.
+struct TradeFrame {
+    uint64_t event_time_us = 0;
+    uint64_t trade_time_us = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    uint16_t group_block_length = 0;
+    uint32_t num_in_group = 0;
+    std::size_t group_header_offset = 0;
+    std::size_t group_start = 0;
+    uint64_t trade_id = 0;
+    int64_t price_mantissa = 0;
+    int64_t qty_mantissa = 0;
+    bool is_buyer_maker = false;
+    std::string_view symbol = DEFAULT_SYMBOL;
+};
+
+// Template 10001
+struct BestBidAskFrame {
+    uint64_t event_time_us = 0;
+    uint64_t book_update_id = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    int64_t bid_price_mantissa = 0;
+    int64_t bid_qty_mantissa = 0;
+    int64_t ask_price_mantissa = 0;
+    int64_t ask_qty_mantissa = 0;
+    std::string_view symbol = DEFAULT_SYMBOL;
+};
+
+// Depth level groups use groupSize16Encoding (uint16 blockLength,
+// uint16 numInGroup); `offset` is the first entry, relative to `data`.
+struct LevelGroup {
+    std::size_t offset = 0;
+    uint16_t block_length = 0;
+    uint16_t count = 0;
+};
+
+// Template 10003
+struct DepthDiffFrame {
+    uint64_t event_time_us = 0;
+    uint64_t first_update_id = 0;
+    uint64_t final_update_id = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    LevelGroup bids;
+    LevelGroup asks;
+    std::string_view symbol = DEFAULT_SYMBOL;
+};
+
+// Template 10002: top-N levels of the book as of book_update_id
+struct DepthSnapshotFrame {
+    uint64_t event_time_us = 0;
+    uint64_t book_update_id = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    LevelGroup bids;
+    LevelGroup asks;
+    std::string_view symbol = DEFAULT_SYMBOL;
+};
+
+// Raw level as sent on the wire: mantissas at the frame's exponents
+struct LevelMantissa {
+    int64_t price = 0;
+    int64_t qty = 0;
+};
+
+struct PriceLevel {
+    double price = 0.0;
+    double qty = 0.0;
+};
+
+// One entry of a validated trades group. `WithBuyerMaker` when the group's
+// entries are long enough to carry isBuyerMaker (false otherwise).
+template <bool WithBuyerMaker>
+inline TradeEntry load_trade_entry(const char *entry) noexcept {
+    using Trade = spot_stream::TradesStreamEvent::Trade;
+    TradeEntry out{static_cast<uint64_t>(spot_stream::load<int64_t>(entry + Trade::ID_OFFSET)),
+                   spot_stream::load<int64_t>(entry + Trade::PRICE_OFFSET),
+                   spot_stream::load<int64_t>(entry + Trade::QTY_OFFSET), false};
+    if constexpr (WithBuyerMaker) {
+        out.is_buyer_maker = spot_stream::load<uint8_t>(entry + Trade::IS_BUYER_MAKER_OFFSET) == 1;
+    }
+    return out;
+}
+
+inline bool trade_entries_have_buyer_maker(uint16_t group_block_length) noexcept {
+    return group_block_length > spot_stream::TradesStreamEvent::Trade::IS_BUYER_MAKER_OFFSET;
+}
+
+inline LevelGroup level_group(const spot_stream::PriceLevels &levels) {
+    return LevelGroup{static_cast<std::size_t>(levels.offset()), levels.actingBlockLength(), levels.count()};
+}
+
+// `data` points just past the MessageHeader, `block_length` is the header's
+// blockLength. `out` is only complete when the parser returns None.
+[[nodiscard]] inline ParseError parse_trade_frame(const char *data, std::size_t data_size, uint16_t block_length,
+                                                  TradeFrame &out) noexcept {
+    spot_stream::TradesStreamEvent msg;
+    if (const auto error = msg.wrapForDecode(data, data_size, block_length);
+        error != spot_stream::DecodeError::None) [[unlikely]] {
+        return to_parse_error(error);
+    }
+    const auto &trades = msg.trades();
+    if (trades.actingBlockLength() == 0 || trades.count() == 0) [[unlikely]] {
+        return ParseError::EmptyTrades;
+    }
+
+    out.event_time_us = static_cast<uint64_t>(msg.eventTime());
+    out.trade_time_us = static_cast<uint64_t>(msg.transactTime());
+    out.price_exponent = msg.priceExponent();
+    out.qty_exponent = msg.qtyExponent();
+    out.group_header_offset = trades.offset() - spot_stream::GroupSizeEncoding::ENCODED_LENGTH;
+    out.group_block_length = trades.actingBlockLength();
+    out.num_in_group = trades.count();
+    out.group_start = trades.offset();
+
+    const char *first_entry = data + trades.offset();
+    const TradeEntry first = trade_entries_have_buyer_maker(out.group_block_length)
+                                 ? load_trade_entry<true>(first_entry)
+                                 : load_trade_entry<false>(first_entry);
+    out.trade_id = first.trade_id;
+    out.price_mantissa = first.price_mantissa;
+    out.qty_mantissa = first.qty_mantissa;
+    out.is_buyer_maker = first.is_buyer_maker;
+    out.symbol = symbol_or_default(msg.getSymbolAsStringView());
+    return ParseError::None;
+}
+
+// Visit every entry of a trades group already validated by parse_trade_frame
+template <typename Fn>
+void for_each_trade_entry(const char *data, std::size_t /*data_size*/, const TradeFrame &frame, Fn &&fn) {
+    const auto visit = [&]<bool WithBuyerMaker>() {
+        const char *entry = data + frame.group_start;
+        for (uint32_t i = 0; i < frame.num_in_group; ++i, entry += frame.group_block_length) {
+            fn(load_trade_entry<WithBuyerMaker>(entry));
+        }
+    };
+    if (trade_entries_have_buyer_maker(frame.group_block_length)) [[likely]] {
+        visit.template operator()<true>();
+    } else {
+        visit.template operator()<false>();
+    }
+}
+
+[[nodiscard]] inline ParseError parse_best_bid_ask_frame(const char *data, std::size_t data_size,
+                                                         uint16_t block_length, BestBidAskFrame &out) noexcept {
+    spot_stream::BestBidAskStreamEvent msg;
+    if (const auto error = msg.wrapForDecode(data, data_size, block_length);
+        error != spot_stream::DecodeError::None) [[unlikely]] {
+        return to_parse_error(error);
+    }
+    out.event_time_us = static_cast<uint64_t>(msg.eventTime());
+    out.book_update_id = static_cast<uint64_t>(msg.bookUpdateId());
+    out.price_exponent = msg.priceExponent();
+    out.qty_exponent = msg.qtyExponent();
+    out.bid_price_mantissa = msg.bidPrice();
+    out.bid_qty_mantissa = msg.bidQty();
+    out.ask_price_mantissa = msg.askPrice();
+    out.ask_qty_mantissa = msg.askQty();
+    out.symbol = symbol_or_default(msg.getSymbolAsStringView());
+    return ParseError::None;
+}
+
+[[nodiscard]] inline ParseError parse_depth_diff_frame(const char *data, std::size_t data_size,
+                                                       uint16_t block_length, DepthDiffFrame &out) noexcept {
+    spot_stream::DepthDiffStreamEvent msg;
+    if (const auto error = msg.wrapForDecode(data, data_size, block_length);
+        error != spot_stream::DecodeError::None) [[unlikely]] {
+        return to_parse_error(error);
+    }
+    out.event_time_us = static_cast<uint64_t>(msg.eventTime());
+    out.first_update_id = static_cast<uint64_t>(msg.firstBookUpdateId());
+    out.final_update_id = static_cast<uint64_t>(msg.lastBookUpdateId());
+    out.price_exponent = msg.priceExponent();
+    out.qty_exponent = msg.qtyExponent();
+    out.bids = level_group(msg.bids());
+    out.asks = level_group(msg.asks());
+    out.symbol = symbol_or_default(msg.getSymbolAsStringView());
+    return ParseError::None;
+}
+
+[[nodiscard]] inline ParseError parse_depth_snapshot_frame(const char *data, std::size_t data_size,
+                                                           uint16_t block_length, DepthSnapshotFrame &out) noexcept {
+    spot_stream::DepthSnapshotStreamEvent msg;
+    if (const auto error = msg.wrapForDecode(data, data_size, block_length);
+        error != spot_stream::DecodeError::None) [[unlikely]] {
+        return to_parse_error(error);
+    }
+    out.event_time_us = static_cast<uint64_t>(msg.eventTime());
+    out.book_update_id = static_cast<uint64_t>(msg.bookUpdateId());
+    out.price_exponent = msg.priceExponent();
+    out.qty_exponent = msg.qtyExponent();
+    out.bids = level_group(msg.bids());
+    out.asks = level_group(msg.asks());
+    out.symbol = symbol_or_default(msg.getSymbolAsStringView());
+    return ParseError::None;
+}
+
+// Symbol of a stream event body, for routing frames before decoding them,
+// in `symbol`. Empty for templates without a symbol.
+[[nodiscard]] inline ParseError stream_frame_symbol(uint16_t template_id, const char *data, std::size_t data_size,
+                                                    uint16_t block_length, std::string_view &symbol) noexcept {
+    ParseError error = ParseError::None;
+    symbol = {};
+    switch (template_id) {
+    case TRADES_STREAM_EVENT: {
+        TradeFrame frame;
+        error = parse_trade_frame(data, data_size, block_length, frame);
+        symbol = frame.symbol;
+        break;
+    }
+    case BEST_BID_ASK_STREAM_EVENT: {
+        BestBidAskFrame frame;
+        error = parse_best_bid_ask_frame(data, data_size, block_length, frame);
+        symbol = frame.symbol;
+        break;
+    }
+    case DEPTH_SNAPSHOT_STREAM_EVENT: {
+        DepthSnapshotFrame frame;
+        error = parse_depth_snapshot_frame(data, data_size, block_length, frame);
+        symbol = frame.symbol;
+        break;
+    }
+    case DEPTH_DIFF_STREAM_EVENT: {
+        DepthDiffFrame frame;
+        error = parse_depth_diff_frame(data, data_size, block_length, frame);
+        symbol = frame.symbol;
+        break;
+    }
+    default:
+        break;
+    }
+    return error;
+}
+
+// Visit every level of a group already validated by a parse_depth_* call
+template <typename Fn>
+void for_each_level(const char *data, const LevelGroup &group, Fn &&fn) {
+    const char *entry = data + group.offset;
+    for (uint16_t i = 0; i < group.count; ++i, entry += group.block_length) {
+        const spot_stream::PriceLevel level(entry, group.block_length);
+        fn(LevelMantissa{level.price(), level.qty()});
+    }
+}
+
+template <typename Levels>
+void decode_levels(const char *data, const LevelGroup &group, int8_t price_exponent, int8_t qty_exponent,
+                   Levels &out) {
+    out.reserve(out.size() + group.count);
+    for_each_level(data, group, [&](const LevelMantissa &level) {
+        out.push_back(PriceLevel{decode_decimal(level.price, price_exponent),
+                                 decode_decimal(level.qty, qty_exponent)});
+    });
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * Typed, decoded stream events.
+ *
+ * Plain value types bound to Python as read-only attributes (see
+ * sbe_decoder.cpp). Reading an attribute is a struct member load, so
+ * consumers avoid the per-key string hashing of the legacy dict results.
+ * Timestamps are milliseconds, matching the dict API; ingest_ts_us carries
+ * the full-resolution ingest clock reading. symbol_id is the symbol's
+ * interned ID (symbol_table.h).
+ */
+
+#ifndef _SBE_STREAM_EVENTS_H_
+#define _SBE_STREAM_EVENTS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "stream_decode.h"
+#include "symbol_table.h"
+
+struct TradeEvent {
+    std::string symbol;
+    SymbolId symbol_id = INVALID_SYMBOL_ID;
+    uint64_t event_ts = 0;
+    uint64_t trade_time = 0;
+    uint64_t ingest_ts = 0;
+    uint64_t ingest_ts_us = 0;
+    uint64_t trade_id = 0;
+    double price = 0.0;
+    double qty = 0.0;
+    bool is_buyer_maker = false;
+    int64_t price_mantissa = 0;
+    int64_t qty_mantissa = 0;
+    int price_exponent = 0;
+    int qty_exponent = 0;
+};
+
+struct BestBidAskEvent {
+    std::string symbol;
+    SymbolId symbol_id = INVALID_SYMBOL_ID;
+    uint64_t event_ts = 0;
+    uint64_t ingest_ts = 0;
+    uint64_t ingest_ts_us = 0;
+    uint64_t book_update_id = 0;
+    double bid_px = 0.0;
+    double bid_sz = 0.0;
+    double ask_px = 0.0;
+    double ask_sz = 0.0;
+    int price_exponent = 0;
+    int qty_exponent = 0;
+};
+
+struct DepthDiffEvent {
+    std::string symbol;
+    SymbolId symbol_id = INVALID_SYMBOL_ID;
+    uint64_t event_ts = 0;
+    uint64_t ingest_ts = 0;
+    uint64_t ingest_ts_us = 0;
+    uint64_t first_update_id = 0;
+    uint64_t final_update_id = 0;
+    std::vector<PriceLevel> bids;
+    std::vector<PriceLevel> asks;
+};
+
+inline TradeEvent make_trade_event(const TradeFrame &frame, uint64_t ingest_ts_us) {
+    TradeEvent event;
+    event.symbol.assign(frame.symbol);
+    event.symbol_id = symbol_table().intern(frame.symbol);
+    event.event_ts = micros_to_millis(frame.event_time_us);
+    event.trade_time = micros_to_millis(frame.trade_time_us);
+    event.ingest_ts = micros_to_millis(ingest_ts_us);
+    event.ingest_ts_us = ingest_ts_us;
+    event.trade_id = frame.trade_id;
+    event.price = decode_decimal(frame.price_mantissa, frame.price_exponent);
+    event.qty = decode_decimal(frame.qty_mantissa, frame.qty_exponent);
+    event.is_buyer_maker = frame.is_buyer_maker;
+    event.price_mantissa = frame.price_mantissa;
+    event.qty_mantissa = frame.qty_mantissa;
+    event.price_exponent = frame.price_exponent;
+    event.qty_exponent = frame.qty_exponent;
+    return event;
+}
+
+inline BestBidAskEvent make_best_bid_ask_event(const BestBidAskFrame &frame, uint64_t ingest_ts_us) {
+    BestBidAskEvent event;
+    event.symbol.assign(frame.symbol);
+    event.symbol_id = symbol_table().intern(frame.symbol);
+    event.event_ts = micros_to_millis(frame.event_time_us);
+    event.ingest_ts = micros_to_millis(ingest_ts_us);
+    event.ingest_ts_us = ingest_ts_us;
+    event.book_update_id = frame.book_update_id;
+    event.bid_px = decode_decimal(frame.bid_price_mantissa, frame.price_exponent);
+    event.bid_sz = decode_decimal(frame.bid_qty_mantissa, frame.qty_exponent);
+    event.ask_px = decode_decimal(frame.ask_price_mantissa, frame.price_exponent);
+    event.ask_sz = decode_decimal(frame.ask_qty_mantissa, frame.qty_exponent);
+    event.price_exponent = frame.price_exponent;
+    event.qty_exponent = frame.qty_exponent;
+    return event;
+}
+
+inline DepthDiffEvent make_depth_diff_event(const char *data, const DepthDiffFrame &frame, uint64_t ingest_ts_us) {
+    DepthDiffEvent event;
+    event.symbol.assign(frame.symbol);
+    event.symbol_id = symbol_table().intern(frame.symbol);
+    event.event_ts = micros_to_millis(frame.event_time_us);
+    event.ingest_ts = micros_to_millis(ingest_ts_us);
+    event.ingest_ts_us = ingest_ts_us;
+    event.first_update_id = frame.first_update_id;
+    event.final_update_id = frame.final_update_id;
+    decode_levels(data, frame.bids, frame.price_exponent, frame.qty_exponent, event.bids);
+    decode_levels(data, frame.asks, frame.price_exponent, frame.qty_exponent, event.asks);
+    return event;
+}
+
+#endif
@@ -0,0 +1,373 @@
+/*
+ * Local WebSocket server that plays a SyntheticStream (synthetic_stream.h)
+ * to the ingestor at a target rate, for finding saturation points without
+ * the exchange.
+ *
+ * The server speaks just enough RFC 6455 for a stream client: it answers
+ * the upgrade handshake on any path, then sends every frame of the stream
+ * as one unmasked binary message, the way the exchange's SBE stream
+ * endpoint does. Whatever the client sends afterwards (pongs, close) is
+ * read and dropped.
+ *
+ * One sender thread paces the stream against the wall clock: the clock
+ * starts when the first client connects, and a frame is due `speed` times
+ * faster than its event time says (speed 10 replays ten minutes of market
+ * in one; speed 0 sends as fast as the sockets take it). Frames that are
+ * due are coalesced into one buffer and written to every client with a
+ * blocking send, so a client that cannot keep up holds the stream back
+ * rather than losing frames. behind_us, how late the last batch went out,
+ * is the saturation signal: it stays near zero while the receiver keeps
+ * up and grows once it does not. A client whose socket stays full for
+ * send_timeout_ms, or that hangs up, is dropped.
+ *
+ * Clients that connect later join the stream where it is. With max_frames
+ * set, the server sends a close frame after that many frames and stops
+ * sending; finished() turns true.
+ */
+
+#ifndef _SBE_STREAM_LOAD_SERVER_H_
+#define _SBE_STREAM_LOAD_SERVER_H_
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "synthetic_stream.h"
+#include "ws_client.h"
+
+struct StreamLoadServerConfig {
+    std::string host = "127.0.0.1";
+    // 0 picks a free port; port() says which
+    uint16_t port = 0;
+    // Event time runs this many times faster than the wall clock; 0 sends
+    // without pacing
+    double speed = 1.0;
+    // Close the stream after this many frames; 0 never does
+    uint64_t max_frames = 0;
+    // A client whose socket stays full this long is dropped
+    int send_timeout_ms = 5000;
+    // Upper bound on one coalesced write
+    std::size_t max_batch_bytes = 64 * 1024;
+};
+
+struct StreamLoadServerStats {
+    std::atomic<uint64_t> clients{0};
+    std::atomic<uint64_t> connections{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> frames_sent{0};
+    std::atomic<uint64_t> bytes_sent{0};
+    std::atomic<uint64_t> batches{0};
+    // How late the last batch went out, and the worst so far
+    std::atomic<int64_t> behind_us{0};
+    std::atomic<int64_t> max_behind_us{0};
+};
+
+// Header of an unmasked (server) binary or close frame; returns its size
+inline std::size_t ws_encode_server_header(WsOpcode opcode, uint64_t payload_length, uint8_t out[10]) {
+    std::size_t size = 0;
+    out[size++] = static_cast<uint8_t>(0x80 | static_cast<uint8_t>(opcode));
+    if (payload_length < 126) {
+        out[size++] = static_cast<uint8_t>(payload_length);
+    } else if (payload_length <= 0xFFFF) {
+        out[size++] = 126;
+        out[size++] = static_cast<uint8_t>(payload_length >> 8);
+        out[size++] = static_cast<uint8_t>(payload_length);
+    } else {
+        out[size++] = 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out[size++] = static_cast<uint8_t>(payload_length >> shift);
+        }
+    }
+    return size;
+}
+
+class StreamLoadServer {
+public:
+    StreamLoadServer(SyntheticStream stream, StreamLoadServerConfig config)
+        : stream_(std::move(stream)), config_(std::move(config)) {
+        if (config_.speed < 0) {
+            throw std::invalid_argument("StreamLoadServer: speed must not be negative");
+        }
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(config_.port);
+        if (inet_pton(AF_INET, config_.host.c_str(), &address.sin_addr) != 1) {
+            throw std::invalid_argument("StreamLoadServer: host must be an IPv4 address, got " + config_.host);
+        }
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            throw std::runtime_error(std::string("StreamLoadServer: socket failed: ") + std::strerror(errno));
+        }
+        const int on = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        socklen_t length = sizeof(address);
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::listen(listen_fd_, 16) != 0 ||
+            ::getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+            const std::string error = std::strerror(errno);
+            ::close(listen_fd_);
+            throw std::runtime_error("StreamLoadServer: cannot listen on " + config_.host + ":" +
+                                     std::to_string(config_.port) + ": " + error);
+        }
+        port_ = ntohs(address.sin_port);
+    }
+
+    StreamLoadServer(const StreamLoadServer &) = delete;
+    StreamLoadServer &operator=(const StreamLoadServer &) = delete;
+
+    ~StreamLoadServer() {
+        stop();
+        ::close(listen_fd_);
+    }
+
+    void start() {
+        if (running_.exchange(true)) {
+            return;
+        }
+        accept_thread_ = std::thread([this] { accept_loop(); });
+        send_thread_ = std::thread([this] { send_loop(); });
+    }
+
+    void stop() {
+        running_ = false;
+        if (accept_thread_.joinable()) {
+            accept_thread_.join();
+        }
+        if (send_thread_.joinable()) {
+            send_thread_.join();
+        }
+        std::lock_guard lock(mutex_);
+        for (const int fd : joining_) {
+            ::close(fd);
+        }
+        joining_.clear();
+    }
+
+    uint16_t port() const { return port_; }
+    const std::string &host() const { return config_.host; }
+    bool finished() const { return finished_; }
+    const StreamLoadServerStats &stats() const { return stats_; }
+
+    // The stream's own counts; only meaningful once stop() has returned
+    const SyntheticStream &stream() const { return stream_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void accept_loop() {
+        while (running_) {
+            pollfd listen_poll{listen_fd_, POLLIN, 0};
+            if (::poll(&listen_poll, 1, 100) <= 0) {
+                continue;
+            }
+            const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            if (!handshake(fd)) {
+                ::close(fd);
+                continue;
+            }
+            ++stats_.connections;
+            std::lock_guard lock(mutex_);
+            joining_.push_back(fd);
+        }
+    }
+
+    // Reads the upgrade request and answers 101; false drops the client
+    bool handshake(int fd) {
+        timeval timeout{2, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        std::string request;
+        char chunk[1024];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+            if (request.size() > 16 * 1024) {
+                return false;
+            }
+            const ssize_t got = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (got <= 0) {
+                return false;
+            }
+            request.append(chunk, static_cast<std::size_t>(got));
+        }
+        std::string lower = request;
+        std::transform(lower.begin(), lower.end(), lower.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        const std::size_t field = lower.find("\r\nsec-websocket-key:");
+        if (field == std::string::npos) {
+            return false;
+        }
+        std::size_t begin = field + std::strlen("\r\nsec-websocket-key:");
+        const std::size_t end = request.find("\r\n", begin);
+        while (begin < end && request[begin] == ' ') {
+            ++begin;
+        }
+        const std::string response = "HTTP/1.1 101 Switching Protocols\r\n"
+                                     "Upgrade: websocket\r\n"
+                                     "Connection: Upgrade\r\n"
+                                     "Sec-WebSocket-Accept: " +
+                                     ws_accept_key(request.substr(begin, end - begin)) + "\r\n\r\n";
+        if (!send_all(fd, response.data(), response.size())) {
+            return false;
+        }
+        const int on = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        const timeval send_timeout{config_.send_timeout_ms / 1000, (config_.send_timeout_ms % 1000) * 1000};
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+        return true;
+    }
+
+    static bool send_all(int fd, const char *data, std::size_t size) {
+        while (size > 0) {
+            const ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                return false;
+            }
+            data += sent;
+            size -= static_cast<std::size_t>(sent);
+        }
+        return true;
+    }
+
+    // Discards what the client sent; false once it hung up
+    static bool drain(int fd) {
+        char sink[4096];
+        for (;;) {
+            const ssize_t got = ::recv(fd, sink, sizeof(sink), MSG_DONTWAIT);
+            if (got > 0) {
+                continue;
+            }
+            return got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+        }
+    }
+
+    void take_joining() {
+        std::lock_guard lock(mutex_);
+        clients_.insert(clients_.end(), joining_.begin(), joining_.end());
+        joining_.clear();
+        stats_.clients = clients_.size();
+    }
+
+    // Writes `batch` to every client, dropping the ones that fail
+    void broadcast(const std::vector<char> &batch) {
+        std::erase_if(clients_, [&](int fd) {
+            if (drain(fd) && send_all(fd, batch.data(), batch.size())) {
+                return false;
+            }
+            ::close(fd);
+            ++stats_.dropped;
+            return true;
+        });
+        stats_.clients = clients_.size();
+    }
+
+    void close_clients() {
+        uint8_t close_frame[4];
+        const std::size_t header = ws_encode_server_header(WsOpcode::Close, 2, close_frame);
+        close_frame[header] = 1000 >> 8;
+        close_frame[header + 1] = 1000 & 0xFF;
+        for (const int fd : clients_) {
+            send_all(fd, reinterpret_cast<const char *>(close_frame), header + 2);
+            ::close(fd);
+        }
+        clients_.clear();
+        stats_.clients = 0;
+    }
+
+    void send_loop() {
+        // The clock starts with the first client
+        while (running_ && clients_.empty()) {
+            take_joining();
+            if (clients_.empty()) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+        const Clock::time_point start = Clock::now();
+        const uint64_t stream_start_us = stream_.next_event_us();
+        const auto due = [&](uint64_t event_us) {
+            if (config_.speed == 0) {
+                return start;
+            }
+            const double offset_us = static_cast<double>(event_us - stream_start_us) / config_.speed;
+            return start + std::chrono::microseconds(static_cast<int64_t>(offset_us));
+        };
+        std::vector<char> batch;
+        std::vector<char> frame;
+        uint64_t sent = 0;
+        while (running_ && (config_.max_frames == 0 || sent < config_.max_frames)) {
+            take_joining();
+            const Clock::time_point first_due = due(stream_.next_event_us());
+            Clock::time_point now = Clock::now();
+            if (first_due > now) {
+                // Sleep in short steps so stop() is not kept waiting
+                std::this_thread::sleep_for(std::min<Clock::duration>(first_due - now, std::chrono::milliseconds(50)));
+                continue;
+            }
+            batch.clear();
+            uint64_t frames = 0;
+            while (batch.size() < config_.max_batch_bytes &&
+                   (config_.max_frames == 0 || sent + frames < config_.max_frames) &&
+                   due(stream_.next_event_us()) <= now) {
+                frame.clear();
+                stream_.next(frame);
+                uint8_t header[10];
+                const std::size_t header_size = ws_encode_server_header(WsOpcode::Binary, frame.size(), header);
+                batch.insert(batch.end(), header, header + header_size);
+                batch.insert(batch.end(), frame.begin(), frame.end());
+                ++frames;
+            }
+            const int64_t behind =
+                std::chrono::duration_cast<std::chrono::microseconds>(now - first_due).count();
+            stats_.behind_us = behind;
+            if (behind > stats_.max_behind_us) {
+                stats_.max_behind_us = behind;
+            }
+            broadcast(batch);
+            sent += frames;
+            stats_.frames_sent += frames;
+            stats_.bytes_sent += batch.size();
+            ++stats_.batches;
+        }
+        if (config_.max_frames != 0 && sent >= config_.max_frames) {
+            finished_ = true;
+        }
+        close_clients();
+    }
+
+    SyntheticStream stream_;
+    StreamLoadServerConfig config_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> finished_{false};
+    std::mutex mutex_;
+    // Handshaken by the accept thread, not yet picked up by the sender
+    std::vector<int> joining_;
+    // Owned by the sender thread
+    std::vector<int> clients_;
+    StreamLoadServerStats stats_;
+    std::thread accept_thread_;
+    std::thread send_thread_;
+};
+
+#endif
@@ -0,0 +1,1173 @@
+/*
+ * Native receiver for the Binance SBE market-data streams.
+ *
+ * Each connection owns one WebSocket on its own thread: it subscribes to
+ * its share of the streams, keeps the connection alive with pings,
+ * reconnects with exponential backoff, and decodes every binary frame
+ * straight into an SPSC ring of EventRecords (see event_ring.h). The
+ * consumer drains all connections' rings in bulk into one BatchColumns, so
+ * Python only wakes once per batch instead of once per message. Receive
+ * threads never wait on the consumer: frames that do not fit a ring are
+ * dropped and counted in ReceiverStats.
+ *
+ * Streams are spread over several connections by symbol, so one slow
+ * socket only stalls its own symbols and no connection exceeds the
+ * exchange's per-connection stream cap. Every connection has its own ring
+ * (keeping each one single-producer), and receive threads can be pinned to
+ * cores. A pinned connection can have its ring, journal files and event log
+ * backed by huge pages and placed on its core's NUMA node (page_memory.h),
+ * each component configured on its own.
+ *
+ * How a receive thread waits for its socket is configurable. Block sleeps
+ * in poll() until data arrives (the default). Spin polls without sleeping,
+ * which burns the thread's core but skips the wake-up on every frame, and
+ * SpinYield spins for spin_us after each frame and then yields the core
+ * between polls. The spinning modes are meant for receive threads pinned
+ * to isolated cores. Either way busy_poll_us can also make the socket
+ * busy poll the NIC queue (SO_BUSY_POLL), and use_io_uring receives
+ * through a multishot io_uring recv into registered buffers instead of
+ * recv() (see uring_recv.h).
+ *
+ * With a journal directory configured, every binary frame is also copied
+ * into the connection's memory-mapped capture journal (capture_journal.h)
+ * before it is staged, so frames the ring drops are still captured.
+ *
+ * A binary message holding several SBE messages back to back (see
+ * message_walk.h) is journaled once and staged as one frame per message.
+ *
+ * Each connection gap-checks its depth diffs while staging them
+ * (depth_sequence.h); gaps come out of drain() as depthGaps rows.
+ *
+ * Once a ClockSync has synced exchange_clock() (exchange_clock.h), each
+ * stream frame's exchange-to-receive latency, corrected for the offset
+ * between the two clocks, also goes into its connection's histogram.
+ *
+ * With an event log directory configured, each connection also publishes
+ * its decoded records to a shared-memory event log (event_log.h) for
+ * co-located consumers. Frames are decoded once, into the log, and the
+ * ring gets a copy of the same records.
+ *
+ * A SubscriptionMask (subscription_mask.h) keeps frames of templates or
+ * symbols the consumer does not want out of the rings, checked on the
+ * receive thread before they are decoded. The journal and the event log
+ * still get every frame, since they serve other readers.
+ *
+ * With a conflation interval set for bestBidAsk or depth, those frames go
+ * to the connection's Conflator (conflation.h) instead, and each symbol's
+ * latest quote or book is staged once per interval as a frame of its own.
+ *
+ * A consumer on an event loop can wait on the receiver's eventfd instead
+ * of polling drain() (ready_notifier.h): every connection notifies after
+ * staging, and the consumer is woken once per arm, not once per frame.
+ * With micro-batching configured (micro_batch.h), drain() holds records
+ * back until a batch's worth is waiting or the oldest has waited long
+ * enough, so each crossing into Python carries more of them.
+ *
+ * With feed_lines above one, every group of streams is received on that
+ * many redundant connections (A/B lines), optionally to different hosts.
+ * Each copy of a message goes through the group's FeedArbiter
+ * (feed_arbiter.h) and only the first is staged, by the group's first
+ * connection and into its ring, so a group still has one ring, one depth
+ * gap check and one order per symbol whichever line won. A line that
+ * disconnects only stops winning races while the others carry the stream.
+ *
+ * With a FrameSink set (an IngestPipeline, ingest_pipeline.h), receive
+ * threads hand every SBE message to the sink instead, and the sink's
+ * queues and overflow policies replace the ring, event log and conflator.
+ * A sink may block the receive thread to push back on the exchange.
+ *
+ * With executor_threads set, connections are not given threads of their
+ * own: each runs as a coroutine on the receiver's IoExecutor
+ * (io_executor.h), waiting on its socket through the executor's epoll and
+ * connecting on a short-lived thread, so hundreds of connections share a
+ * few threads. A connection yields its thread after a burst of messages,
+ * and a message already arriving is still read to its end. The wait
+ * strategy and per-connection pinning do not apply; executor_cpu_affinity
+ * pins the workers instead.
+ */
+
+#ifndef _SBE_STREAM_RECEIVER_H_
+#define _SBE_STREAM_RECEIVER_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "batch_decode.h"
+#include "capture_journal.h"
+#include "conflation.h"
+#include "event_log.h"
+#include "event_ring.h"
+#include "exchange_clock.h"
+#include "feed_arbiter.h"
+#include "ingest_clock.h"
+#include "io_executor.h"
+#include "memory_accounting.h"
+#include "message_walk.h"
+#include "micro_batch.h"
+#include "native_log.h"
+#include "native_metrics.h"
+#include "page_memory.h"
+#include "ready_notifier.h"
+#include "subscription_mask.h"
+#include "trace_stamps.h"
+#include "ws_client.h"
+
+enum class WaitStrategy : uint8_t {
+    Block = 0,
+    Spin,
+    SpinYield,
+};
+
+// Config names, in WaitStrategy order
+constexpr std::array<const char *, 3> WAIT_STRATEGY_NAMES = {"block", "spin", "spin_yield"};
+
+struct ReceiverConfig {
+    std::string host = "stream-sbe.binance.com";
+    uint16_t port = 9443;
+    bool use_tls = true;
+    std::vector<std::string> symbols;
+    std::vector<std::string> stream_types = {"trade", "bestBidAsk", "depth"};
+    std::string api_key;
+    std::string user_agent = "bitcoin-pipeline-sbe/1.0";
+    bool raw_mantissa = false;
+    int ping_interval_ms = 20000;
+    // Reconnect when nothing (data or pong) arrives for this long
+    int idle_timeout_ms = 30000;
+    int reconnect_initial_ms = 1000;
+    int reconnect_max_ms = 60000;
+    std::size_t max_message_size = 1 << 20;
+    // Ring slots per connection (decoded records, not frames); rounded up
+    // to a power of two
+    std::size_t ring_capacity = 1 << 16;
+    // Minimum connection count; raised as needed to respect the stream cap
+    std::size_t connections = 1;
+    std::size_t max_streams_per_connection = 1024;
+    // Core for connection i's receive thread; missing or negative = unpinned
+    std::vector<int> cpu_affinity;
+    WaitStrategy wait = WaitStrategy::Block;
+    // SpinYield: how long to spin after the last frame before yielding
+    int spin_us = 50;
+    // SO_BUSY_POLL on each socket; 0 = off
+    int busy_poll_us = 0;
+    // Receive through io_uring where the kernel allows it
+    bool use_io_uring = false;
+    UringConfig uring;
+    // Raw frame capture; off unless journal.directory is set
+    JournalConfig journal;
+    // Shared-memory event log per connection; off unless set
+    std::string event_log_dir;
+    // Records per connection's log; rounded up to a power of two
+    std::size_t event_log_capacity = 1 << 20;
+    // Per-symbol conflation of bestBidAsk and depth; off unless an interval is set
+    ConflationConfig conflation;
+    // Redundant connections (lines) per group of streams, arbitrated first
+    // copy wins; 1 = no redundancy
+    std::size_t feed_lines = 1;
+    // "host" or "host:port" of line i, cycled; empty = host and port for
+    // every line
+    std::vector<std::string> feed_hosts;
+    // Huge pages and NUMA-local placement (on the node of the connection's
+    // cpu_affinity core) for each connection's ring, journal files and
+    // event log
+    ComponentMemory ring_memory;
+    ComponentMemory journal_memory;
+    ComponentMemory event_log_memory;
+    // drain() hands off after this many records or this long; off by default
+    MicroBatchConfig micro_batch;
+    // Frames this receiver's consumer takes from the rings; all by default
+    SubscriptionMask subscription;
+    // Run the connections as tasks on this many shared threads; 0 gives
+    // each connection its own receive thread
+    std::size_t executor_threads = 0;
+    // Core for executor worker i; missing or negative = unpinned
+    std::vector<int> executor_cpu_affinity;
+};
+
+struct ReceiverStats {
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> text_messages{0};
+    std::atomic<uint64_t> connects{0};
+    std::atomic<uint64_t> disconnects{0};
+    std::atomic<uint64_t> dropped_frames{0};
+    std::atomic<uint64_t> dropped_bytes{0};
+    // Spin modes: empty polls of the socket, and how many of them yielded
+    std::atomic<uint64_t> idle_polls{0};
+    std::atomic<uint64_t> yields{0};
+    std::atomic<bool> connected{false};
+    // The current connection receives through io_uring
+    std::atomic<bool> io_uring{false};
+    // Exchange-to-receive latencies below zero (within the clock offset's
+    // error), recorded as zero
+    std::atomic<uint64_t> skewed_latencies{0};
+    // Frames the subscription mask kept out of the ring
+    std::atomic<uint64_t> filtered_frames{0};
+};
+
+inline std::string lower_symbol(std::string symbol) {
+    std::transform(symbol.begin(), symbol.end(), symbol.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return symbol;
+}
+
+// Stream names per connection. Symbols are dealt round-robin so all of a
+// symbol's streams share one connection (and one ring, keeping its order).
+inline std::vector<std::vector<std::string>> partition_streams(const ReceiverConfig &config) {
+    const std::size_t per_symbol = std::max<std::size_t>(config.stream_types.size(), 1);
+    const std::size_t symbols_per_connection = std::max<std::size_t>(config.max_streams_per_connection / per_symbol, 1);
+    const std::size_t needed = (config.symbols.size() + symbols_per_connection - 1) / symbols_per_connection;
+    const std::size_t count =
+        std::min(std::max({config.connections, needed, std::size_t{1}}), std::max<std::size_t>(config.symbols.size(), 1));
+
+    std::vector<std::vector<std::string>> streams(count);
+    for (std::size_t i = 0; i < config.symbols.size(); ++i) {
+        const std::string symbol = lower_symbol(config.symbols[i]);
+        for (const auto &type : config.stream_types) {
+            streams[i % count].push_back(symbol + "@" + type);
+        }
+    }
+    return streams;
+}
+
+// Combined-stream path, the same stream names the Python client subscribes to
+inline std::string build_stream_path(const std::vector<std::string> &streams) {
+    std::string path = "/stream?streams=";
+    for (std::size_t i = 0; i < streams.size(); ++i) {
+        if (i > 0) {
+            path += '/';
+        }
+        path += streams[i];
+    }
+    return path;
+}
+
+// Host and port of a feed_hosts entry, "host" or "host:port"
+inline std::pair<std::string, uint16_t> feed_endpoint(const std::string &spec, uint16_t default_port) {
+    const std::size_t colon = spec.rfind(':');
+    if (colon == std::string::npos) {
+        return {spec, default_port};
+    }
+    const std::string port = spec.substr(colon + 1);
+    char *end = nullptr;
+    const unsigned long value = std::strtoul(port.c_str(), &end, 10);
+    if (colon == 0 || port.empty() || *end != '\0' || value == 0 || value > UINT16_MAX) {
+        throw std::runtime_error("StreamReceiver: bad feed host '" + spec + "'");
+    }
+    return {spec.substr(0, colon), static_cast<uint16_t>(value)};
+}
+
+// Event log of connection `id` under `directory`
+inline std::string event_log_path(const std::string &directory, uint16_t id) {
+    return directory + "/events-" + std::to_string(id) + ".log";
+}
+
+inline const LogFormat RECEIVER_ERROR_LOG{LogLevel::Warning, "receiver", "connection {}: {}"};
+inline const LogFormat RECEIVER_RECONNECT_LOG{LogLevel::Warning, "receiver",
+                                              "connection {} disconnected, reconnecting in {} ms"};
+
+// Takes the receive threads' frames in place of the rings (see IngestPipeline)
+struct FrameSink {
+    virtual ~FrameSink() = default;
+    // Called on a receive thread for every SBE message, which is only valid
+    // during the call. False when the sink dropped it.
+    virtual bool accept(std::span<const char> frame, uint64_t received_us) = 0;
+};
+
+class StreamConnection;
+
+// Redundant lines receiving the same streams. Their receive threads
+// arbitrate under `mutex`, which also serializes staging into the primary.
+struct FeedGroup {
+    explicit FeedGroup(std::size_t lines) : arbiter(lines) {}
+
+    std::mutex mutex;
+    FeedArbiter arbiter;
+    // Line 0, which stages every winning copy
+    StreamConnection *primary = nullptr;
+    std::vector<StreamConnection *> lines;
+};
+
+// One WebSocket, its receive thread and its ring
+class StreamConnection {
+public:
+    // `group` and `line` place the connection in a redundant feed (null: a
+    // feed of its own); a non-empty `host` and its `port` override config's
+    StreamConnection(const ReceiverConfig &config, std::vector<std::string> streams, uint16_t id, int cpu,
+                     ReadyNotifier *notifier = nullptr, FeedGroup *group = nullptr, std::size_t line = 0,
+                     std::string host = {}, uint16_t port = 0)
+        : config_(config), path_(build_stream_path(streams)), streams_(std::move(streams)), id_(id), cpu_(cpu),
+          notifier_(notifier), group_(group), line_(line), host_(host.empty() ? config.host : std::move(host)),
+          port_(port == 0 ? config.port : port),
+          // Other lines stage into the primary's ring, never their own
+          ring_(line == 0 ? config.ring_capacity : 2, component_placement(config.ring_memory, cpu)) {
+        if (config.journal.enabled()) {
+            JournalConfig journal = config.journal;
+            journal.placement = component_placement(config.journal_memory, cpu);
+            journal_node_ = journal.placement.numa_node;
+            journal_ = std::make_unique<JournalWriter>(std::move(journal), id);
+        }
+        if (line > 0) {
+            return;
+        }
+        if (!config.event_log_dir.empty()) {
+            const MemoryPlacement placement = component_placement(config.event_log_memory, cpu);
+            event_log_ = std::make_unique<EventLog>(
+                EventLog::create(event_log_path(config.event_log_dir, id), config.event_log_capacity, placement));
+        }
+        if (config.conflation.enabled()) {
+            conflator_ = std::make_unique<Conflator>(config.conflation, ingest_time_us());
+        }
+    }
+
+    ~StreamConnection() { stop(); }
+
+    StreamConnection(const StreamConnection &) = delete;
+    StreamConnection &operator=(const StreamConnection &) = delete;
+
+    // Receive on a thread of its own, or as a task on `executor`
+    void start(IoExecutor *executor = nullptr) {
+        if (running_.exchange(true)) {
+            return;
+        }
+        if (executor != nullptr) {
+            task_done_.store(false);
+            executor->spawn(run_task(*executor));
+            return;
+        }
+        worker_ = std::thread([this] { run(); });
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        if (worker_.joinable()) {
+            worker_.join();
+        }
+        // A task returns within a poll slice, or once its connect does
+        task_done_.wait(false);
+    }
+
+    bool running() const { return running_.load(); }
+
+    // Before start() only (null: back to the ring)
+    void set_frame_sink(FrameSink *sink) { sink_.store(sink, std::memory_order_release); }
+
+    EventRing &ring() { return ring_; }
+    const EventRing &ring() const { return ring_; }
+    const ReceiverStats &stats() const { return stats_; }
+    const DepthSequence &depth_sequence() const { return depth_sequence_; }
+    // Offset-corrected exchange-to-receive latency of stream frames, in
+    // microseconds; empty until exchange_clock() is synced
+    const LatencyHistogram &exchange_latency() const { return exchange_latency_; }
+    const std::string &path() const { return path_; }
+    const std::vector<std::string> &streams() const { return streams_; }
+    uint16_t id() const { return id_; }
+    int cpu() const { return cpu_; }
+    const std::string &host() const { return host_; }
+    uint16_t port() const { return port_; }
+    // Null outside a redundant feed
+    const FeedGroup *feed_group() const { return group_; }
+    std::size_t line() const { return line_; }
+    // Null when capture is off
+    JournalWriter *journal() const { return journal_.get(); }
+    // Null without an event log
+    const EventLog *event_log() const { return event_log_.get(); }
+    // Null without conflation
+    const Conflator *conflator() const { return conflator_.get(); }
+
+    std::string last_error() const {
+        std::lock_guard lock(mutex_);
+        return last_error_;
+    }
+
+private:
+    static constexpr int POLL_SLICE_MS = 100;
+    // Messages a task reads back to back before letting other tasks run
+    static constexpr std::size_t TASK_BURST_MESSAGES = 64;
+
+    // Ping and idleness bookkeeping of one connection's receive loop
+    struct ReceiveState {
+        using Clock = std::chrono::steady_clock;
+
+        explicit ReceiveState(const ReceiverConfig &config)
+            : ping_interval(config.ping_interval_ms), idle_timeout(config.idle_timeout_ms),
+              last_activity(Clock::now()), next_ping(last_activity + ping_interval) {}
+
+        const std::chrono::milliseconds ping_interval;
+        const std::chrono::milliseconds idle_timeout;
+        Clock::time_point last_activity;
+        Clock::time_point next_ping;
+        std::vector<char> message;
+    };
+
+    WsEndpoint endpoint() const {
+        WsEndpoint ep;
+        ep.host = host_;
+        ep.port = port_;
+        ep.path = path_;
+        ep.use_tls = config_.use_tls;
+        ep.max_message_size = config_.max_message_size;
+        ep.busy_poll_us = config_.busy_poll_us;
+        ep.use_io_uring = config_.use_io_uring;
+        ep.uring = config_.uring;
+        ep.headers.emplace_back("User-Agent", config_.user_agent);
+        if (!config_.api_key.empty()) {
+            ep.headers.emplace_back("X-MBX-APIKEY", config_.api_key);
+        }
+        return ep;
+    }
+
+    void set_error(std::string error) {
+        native_log(RECEIVER_ERROR_LOG, id_, error);
+        std::lock_guard lock(mutex_);
+        last_error_ = std::move(error);
+    }
+
+    void run() {
+        if (cpu_ >= 0) {
+            // Unpinned is still a working receiver, so only report it
+            if (std::string error = pin_current_thread(cpu_); !error.empty()) {
+                set_error(std::move(error));
+            }
+        }
+        // Journal files take their page cache from the writing thread's
+        // policy, not the mapping's
+        if (std::string error = prefer_numa_node(journal_node_); !error.empty()) {
+            set_error(std::move(error));
+        }
+
+        int backoff_ms = config_.reconnect_initial_ms;
+        while (running_.load()) {
+            WebSocketClient ws;
+            try {
+                ws.connect(endpoint());
+                on_connected(ws);
+                backoff_ms = config_.reconnect_initial_ms;
+                receive_loop(ws);
+            } catch (const std::exception &e) {
+                set_error(e.what());
+            }
+            on_disconnected(ws, backoff_ms);
+
+            // Sleep out the backoff, waking early on stop()
+            const auto resume = std::chrono::steady_clock::now() + std::chrono::milliseconds(backoff_ms);
+            while (running_.load() && std::chrono::steady_clock::now() < resume) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(POLL_SLICE_MS));
+            }
+            backoff_ms = std::min(backoff_ms * 2, config_.reconnect_max_ms);
+        }
+    }
+
+    // run() as a task on `executor`: connects through run_blocking, then
+    // waits on the socket through the executor instead of poll()
+    IoTask run_task(IoExecutor &executor) {
+        using Clock = std::chrono::steady_clock;
+        int backoff_ms = config_.reconnect_initial_ms;
+        while (running_.load()) {
+            {
+                WebSocketClient ws;
+                try {
+                    co_await executor.run_blocking([&] { ws.connect(endpoint()); });
+                    on_connected(ws);
+                    backoff_ms = config_.reconnect_initial_ms;
+                    ReceiveState state(config_);
+                    std::size_t burst = 0;
+                    while (running_.load()) {
+                        if (ws.wait_readable(0) || co_await executor.readable(ws.poll_fd(), POLL_SLICE_MS)) {
+                            receive_message(ws, state);
+                            if (++burst == TASK_BURST_MESSAGES) {
+                                burst = 0;
+                                co_await executor.yield();
+                            }
+                        } else {
+                            idle_slice(ws, state);
+                        }
+                    }
+                } catch (const std::exception &e) {
+                    set_error(e.what());
+                }
+                on_disconnected(ws, backoff_ms);
+            }
+
+            const auto resume = Clock::now() + std::chrono::milliseconds(backoff_ms);
+            for (auto now = Clock::now(); running_.load() && now < resume; now = Clock::now()) {
+                const auto left = std::chrono::ceil<std::chrono::milliseconds>(resume - now);
+                co_await executor.sleep_for(std::min(left, std::chrono::milliseconds(POLL_SLICE_MS)));
+            }
+            backoff_ms = std::min(backoff_ms * 2, config_.reconnect_max_ms);
+        }
+        task_done_.store(true);
+        task_done_.notify_all();
+    }
+
+    void on_connected(const WebSocketClient &ws) {
+        if (!ws.warning().empty()) {
+            set_error(ws.warning());
+        }
+        stats_.io_uring.store(ws.io_uring());
+        stats_.connects.fetch_add(1, std::memory_order_relaxed);
+        stats_.connected.store(true);
+    }
+
+    void on_disconnected(WebSocketClient &ws, int backoff_ms) {
+        if (stats_.connected.exchange(false)) {
+            stats_.disconnects.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (running_.load()) {
+            native_log(RECEIVER_RECONNECT_LOG, id_, backoff_ms);
+        }
+        ws.close();
+    }
+
+    void receive_loop(WebSocketClient &ws) {
+        ReceiveState state(config_);
+        while (running_.load()) {
+            if (wait_readable(ws)) {
+                receive_message(ws, state);
+            } else {
+                idle_slice(ws, state);
+            }
+        }
+    }
+
+    // A poll slice passed without data: flush what is due, then ping or
+    // give up on a socket that has gone quiet
+    void idle_slice(WebSocketClient &ws, ReceiveState &state) {
+        flush_conflated(ingest_time_us());
+        notify_ready();
+        const auto now = ReceiveState::Clock::now();
+        if (now - state.last_activity > state.idle_timeout) {
+            throw std::runtime_error("ws idle timeout");
+        }
+        if (now >= state.next_ping) {
+            ws.send_ping();
+            state.next_ping = now + state.ping_interval;
+        }
+    }
+
+    // Read and handle the next message, which has started arriving
+    void receive_message(WebSocketClient &ws, ReceiveState &state) {
+        std::vector<char> &message = state.message;
+        const WsOpcode opcode = ws.read_message(message);
+        const uint64_t received_us = ingest_time_us();
+        state.last_activity = ReceiveState::Clock::now();
+
+        switch (opcode) {
+        case WsOpcode::Binary:
+            stats_.messages.fetch_add(1, std::memory_order_relaxed);
+            stats_.bytes.fetch_add(message.size(), std::memory_order_relaxed);
+            append_frame(message, received_us);
+            flush_conflated(received_us);
+            notify_ready();
+            break;
+        case WsOpcode::Text:
+            // Subscription acks and errors; SBE payloads are always binary
+            stats_.text_messages.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case WsOpcode::Close:
+            throw std::runtime_error("ws closed by server");
+        default:
+            // Ping (already answered) or pong: only counts as activity
+            break;
+        }
+    }
+
+    // Wait for the socket per config_.wait; false once a poll slice passes
+    // without data, so the caller can ping and check for idleness
+    bool wait_readable(WebSocketClient &ws) {
+        if (config_.wait == WaitStrategy::Block) {
+            return ws.wait_readable(POLL_SLICE_MS);
+        }
+
+        using Clock = std::chrono::steady_clock;
+        const auto start = Clock::now();
+        const auto yield_after = start + std::chrono::microseconds(config_.spin_us);
+        const auto slice_end = start + std::chrono::milliseconds(POLL_SLICE_MS);
+        uint64_t idle = 0;
+        uint64_t yields = 0;
+        bool readable = false;
+        while (running_.load(std::memory_order_relaxed)) {
+            if (ws.wait_readable(0)) {
+                readable = true;
+                break;
+            }
+            ++idle;
+            const auto now = Clock::now();
+            if (now >= slice_end) {
+                break;
+            }
+            if (config_.wait == WaitStrategy::SpinYield && now >= yield_after) {
+                std::this_thread::yield();
+                ++yields;
+            }
+        }
+        stats_.idle_polls.fetch_add(idle, std::memory_order_relaxed);
+        stats_.yields.fetch_add(yields, std::memory_order_relaxed);
+        return readable;
+    }
+
+    // Journal the message as received, then stage each SBE message it
+    // holds as a frame of its own
+    void append_frame(std::vector<char> &message, uint64_t received_us) {
+        if (journal_) {
+            // In a redundant feed the primary's frame_seq_ belongs to the group
+            journal_->append(std::span<const char>(message.data(), message.size()), received_us,
+                             group_ != nullptr ? line_seq_ : frame_seq_);
+        }
+        frames_.clear();
+        split_messages(std::span<char>(message.data(), message.size()), frames_);
+        for (const std::span<char> frame : frames_) {
+            stage_message(frame, received_us);
+        }
+    }
+
+    // In a redundant feed, only the first copy is staged, by the primary
+    void stage_message(std::span<char> frame, uint64_t received_us) {
+        if (group_ == nullptr) {
+            stage_admitted(frame, received_us);
+            return;
+        }
+        ++line_seq_;
+        std::lock_guard lock(group_->mutex);
+        if (group_->arbiter.admit(frame, line_, received_us)) {
+            group_->primary->stage_admitted(frame, received_us);
+        }
+    }
+
+    void stage_admitted(std::span<char> frame, uint64_t received_us) {
+        const uint64_t seq = frame_seq_++;
+        record_exchange_latency(frame, received_us);
+        if (FrameSink *sink = sink_.load(std::memory_order_acquire); sink != nullptr) {
+            if (!sink->accept(frame, received_us)) {
+                stats_.dropped_frames.fetch_add(1, std::memory_order_relaxed);
+                stats_.dropped_bytes.fetch_add(frame.size(), std::memory_order_relaxed);
+            }
+            return;
+        }
+        if (conflator_ && conflator_->absorb(frame, received_us)) {
+            return;
+        }
+        const bool wanted = config_.subscription.admits(frame);
+        if (!wanted) {
+            stats_.filtered_frames.fetch_add(1, std::memory_order_relaxed);
+        }
+        bool staged = false;
+        if (event_log_) {
+            // The log serves every reader; the mask only applies to the ring
+            staged = ::append_frame(*event_log_, frame, seq, received_us, &depth_sequence_) &&
+                     (!wanted || copy_frame(ring_, event_log_->last_frame()));
+        } else if (wanted) {
+            staged = stage_frame(ring_, frame, seq, received_us, &depth_sequence_);
+        } else {
+            return;
+        }
+        if (!staged) {
+            stats_.dropped_frames.fetch_add(1, std::memory_order_relaxed);
+            stats_.dropped_bytes.fetch_add(frame.size(), std::memory_order_relaxed);
+        }
+    }
+
+    void record_exchange_latency(std::span<const char> frame, uint64_t received_us) {
+        const ExchangeClock &clock = exchange_clock();
+        if (!clock.synced() || frame.size() < spot_sbe::MessageHeader::encodedLength()) {
+            return;
+        }
+        switch (spot_sbe::MessageHeader(const_cast<char *>(frame.data()), frame.size()).templateId()) {
+        case TRADES_STREAM_EVENT:
+        case BEST_BID_ASK_STREAM_EVENT:
+        case DEPTH_DIFF_STREAM_EVENT:
+        case DEPTH_SNAPSHOT_STREAM_EVENT:
+            break;
+        default:
+            return;
+        }
+        const std::size_t header = spot_sbe::MessageHeader::encodedLength();
+        const uint64_t event_us = trace_event_time_us(frame.data() + header, frame.size() - header);
+        if (event_us == 0) {
+            return;
+        }
+        const int64_t latency = clock.exchange_latency_us(event_us, received_us);
+        if (latency < 0) {
+            stats_.skewed_latencies.fetch_add(1, std::memory_order_relaxed);
+        }
+        exchange_latency_.record(static_cast<uint64_t>(std::max<int64_t>(latency, 0)));
+    }
+
+    void notify_ready() {
+        if (notifier_ != nullptr) {
+            notifier_->notify();
+        }
+    }
+
+    // Stage the conflated frames due by `now_us`, numbered after the frames
+    // received so far. Any line of a redundant feed flushes the primary's,
+    // so conflated frames keep flowing while the primary reconnects.
+    void flush_conflated(uint64_t now_us) {
+        if (group_ == nullptr) {
+            flush_own_conflated(now_us);
+            return;
+        }
+        if (!group_->primary->conflator_) {
+            return;
+        }
+        std::lock_guard lock(group_->mutex);
+        group_->primary->flush_own_conflated(now_us);
+    }
+
+    void flush_own_conflated(uint64_t now_us) {
+        if (!conflator_) {
+            return;
+        }
+        conflator_->flush_due(now_us, [this](std::span<EventRecord> records) {
+            const uint64_t seq = frame_seq_++;
+            for (EventRecord &record : records) {
+                record.frame_seq = seq;
+            }
+            bool staged = false;
+            if (event_log_) {
+                if (copy_frame(*event_log_, records)) {
+                    staged = copy_frame(ring_, event_log_->last_frame());
+                } else {
+                    event_log_->count_dropped_frame();
+                }
+            } else {
+                staged = copy_frame(ring_, records);
+            }
+            if (!staged) {
+                stats_.dropped_frames.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    const ReceiverConfig &config_;
+    const std::string path_;
+    const std::vector<std::string> streams_;
+    const uint16_t id_;
+    const int cpu_;
+    ReadyNotifier *const notifier_;
+    FeedGroup *const group_;
+    const std::size_t line_;
+    const std::string host_;
+    const uint16_t port_;
+    std::atomic<FrameSink *> sink_{nullptr};
+
+    ReceiverStats stats_;
+    std::atomic<bool> running_{false};
+    std::thread worker_;
+    // False while a task on an executor runs this connection
+    std::atomic<bool> task_done_{true};
+
+    EventRing ring_;
+    uint64_t frame_seq_ = 0;
+    // Frames this line received, in a redundant feed (receive thread only)
+    uint64_t line_seq_ = 0;
+    // The current message's SBE messages (receive thread only)
+    std::vector<std::span<char>> frames_;
+    // Receive thread (in a redundant feed, the group's lock) only, apart
+    // from its atomic gap count
+    DepthSequence depth_sequence_;
+    // Written like depth_sequence_, read through its atomics
+    LatencyHistogram exchange_latency_;
+    std::unique_ptr<JournalWriter> journal_;
+    std::unique_ptr<EventLog> event_log_;
+    // Preferred node of the receive thread's allocations; -1 for none
+    int journal_node_ = -1;
+    std::unique_ptr<Conflator> conflator_;
+
+    mutable std::mutex mutex_;
+    std::string last_error_;
+};
+
+class StreamReceiver {
+public:
+    explicit StreamReceiver(ReceiverConfig config) : config_(std::move(config)), batcher_(config_.micro_batch) {
+        if (config_.symbols.empty() || config_.stream_types.empty()) {
+            throw std::runtime_error("StreamReceiver needs at least one symbol and stream type");
+        }
+        if (config_.executor_threads > 0) {
+            executor_ = std::make_unique<IoExecutor>(config_.executor_threads, config_.executor_cpu_affinity);
+        }
+        const std::size_t lines = std::max<std::size_t>(config_.feed_lines, 1);
+        for (auto &group_streams : partition_streams(config_)) {
+            FeedGroup *group = nullptr;
+            if (lines > 1) {
+                group = feed_groups_.emplace_back(std::make_unique<FeedGroup>(lines)).get();
+            }
+            for (std::size_t line = 0; line < lines; ++line) {
+                const std::size_t i = connections_.size();
+                const int cpu = i < config_.cpu_affinity.size() ? config_.cpu_affinity[i] : -1;
+                const std::vector<std::string> &hosts = config_.feed_hosts;
+                auto [host, port] = hosts.empty() ? std::pair{config_.host, config_.port}
+                                                  : feed_endpoint(hosts[line % hosts.size()], config_.port);
+                auto &connection = connections_.emplace_back(std::make_unique<StreamConnection>(
+                    config_, group_streams, static_cast<uint16_t>(i), cpu, &notifier_, group, line, std::move(host),
+                    port));
+                if (group != nullptr) {
+                    group->lines.push_back(connection.get());
+                    group->primary = group->lines.front();
+                }
+            }
+        }
+        if (config_.journal.enabled()) {
+            std::vector<JournalWriter *> writers;
+            for (const auto &connection : connections_) {
+                writers.push_back(connection->journal());
+            }
+            syncer_ = std::make_unique<JournalSyncer>(std::move(writers), config_.journal.sync_interval_ms);
+        }
+        metrics_.publish([this](MetricsWriter &out) { write_metrics(out); });
+        memory_.publish([this](MemoryReport &out) { report_memory(out); });
+    }
+
+    ~StreamReceiver() { stop(); }
+
+    StreamReceiver(const StreamReceiver &) = delete;
+    StreamReceiver &operator=(const StreamReceiver &) = delete;
+
+    void start() {
+        for (auto &connection : connections_) {
+            connection->start(executor_.get());
+        }
+        if (syncer_) {
+            syncer_->start();
+        }
+    }
+
+    void stop() {
+        for (auto &connection : connections_) {
+            connection->stop();
+        }
+        // After the receive threads, so the final sync covers their last frames
+        if (syncer_) {
+            syncer_->stop();
+        }
+    }
+
+    bool running() const {
+        return std::any_of(connections_.begin(), connections_.end(),
+                           [](const auto &connection) { return connection->running(); });
+    }
+
+    // Every stream is being received: each connection is up, or with
+    // redundant feeds at least one line of each group
+    bool connected() const {
+        if (feed_groups_.empty()) {
+            return std::all_of(connections_.begin(), connections_.end(),
+                               [](const auto &connection) { return connection->stats().connected.load(); });
+        }
+        return std::all_of(feed_groups_.begin(), feed_groups_.end(), [](const auto &group) {
+            return std::any_of(group->lines.begin(), group->lines.end(),
+                               [](const StreamConnection *line) { return line->stats().connected.load(); });
+        });
+    }
+
+    // Stage only the frames `subscription` admits into the rings. Before
+    // start() only.
+    void set_subscription(SubscriptionMask subscription) {
+        if (running()) {
+            throw std::runtime_error("StreamReceiver.set_subscription: the receiver is running");
+        }
+        config_.subscription = std::move(subscription);
+    }
+
+    // Hand every frame to `sink` (not owned) instead of the rings, which
+    // then stay empty. Before start() only. A sink that blocks must be
+    // unblocked (IngestPipeline::stop) before stop() can join the receive
+    // threads.
+    void set_frame_sink(FrameSink *sink) {
+        if (running()) {
+            throw std::runtime_error("StreamReceiver.set_frame_sink: the receiver is running");
+        }
+        for (auto &connection : connections_) {
+            connection->set_frame_sink(sink);
+        }
+    }
+
+    // Wait up to `timeout_ms` for at least one record, then move up to
+    // `max_records` of them (whole frames) from the connections' rings into
+    // `out`. With micro-batching, the first record may then be held up to
+    // micro_batch.max_delay_us for more to arrive; with a timeout of 0 the
+    // drain does not wait for that either but returns 0 and leaves the
+    // wait in pending_wait_us(), for an event loop to sleep on. Rings are
+    // visited starting one further along on every call so none is starved.
+    // Returns the number of records drained; 0 on timeout. Consumer side,
+    // one thread at a time.
+    std::size_t drain(BatchColumns &out, std::size_t max_records, int timeout_ms) {
+        out.raw_mantissa = config_.raw_mantissa;
+        pending_wait_us_ = 0;
+        batch_limit_ = max_records;
+        if (!wait_for_events([this] { return any_readable(); }, timeout_ms)) {
+            return 0;
+        }
+        const std::size_t waiting = wait_for_batch(max_records, timeout_ms > 0);
+        if (waiting == 0) {
+            return 0;
+        }
+
+        std::size_t drained = 0;
+        const std::size_t count = connections_.size();
+        for (std::size_t i = 0; i < count && drained < max_records; ++i) {
+            auto &connection = *connections_[(next_drain_ + i) % count];
+            drained += drain_events(connection.ring(), out, max_records - drained);
+        }
+        next_drain_ = (next_drain_ + 1) % count;
+        batcher_.handed_off(drained, waiting, max_records);
+        return drained;
+    }
+
+    // eventfd that becomes readable when records arrive after arm_notify()
+    int notify_fd() const { return notifier_.fd(); }
+
+    // Ask for a wake-up on notify_fd(); false when records are already
+    // waiting, so drain() again instead of sleeping. While a micro-batch
+    // fills, each record arriving wakes the consumer to check it again, and
+    // false means the batch is ready. Consumer side.
+    bool arm_notify() {
+        return notifier_.arm([this] { return any_readable() && pending_batch(batch_limit_).wait_us == 0; });
+    }
+
+    // Microseconds the last non-blocking drain() left its records waiting
+    // for the micro-batch to fill; 0 when it drained or found nothing
+    uint64_t pending_wait_us() const { return pending_wait_us_; }
+
+    // Reset notify_fd() after a wake-up
+    uint64_t clear_notify() { return notifier_.clear(); }
+
+    const ReadyNotifier &notifier() const { return notifier_; }
+    const MicroBatcher &micro_batcher() const { return batcher_; }
+
+    const std::vector<std::unique_ptr<StreamConnection>> &connections() const { return connections_; }
+    // Empty without redundant feeds
+    const std::vector<std::unique_ptr<FeedGroup>> &feed_groups() const { return feed_groups_; }
+
+    const ReceiverConfig &config() const { return config_; }
+
+    // Null unless executor_threads is set
+    const IoExecutor *executor() const { return executor_.get(); }
+
+private:
+    // Sleep between checks while a micro-batch fills
+    static constexpr uint64_t MICRO_BATCH_POLL_US = 20;
+
+    // Prometheus families, per connection; runs on the scrape thread
+    void write_metrics(MetricsWriter &out) const {
+        using Type = MetricType;
+        for (const auto &connection : connections_) {
+            const auto &stats = connection->stats();
+            const std::string id = std::to_string(connection->id());
+            const MetricLabels labels = {{"receiver", metrics_.instance()}, {"connection", id}};
+            const auto counter = [&](std::string_view family, std::string_view help, const std::atomic<uint64_t> &v) {
+                out.sample(family, Type::Counter, help, labels, v.load(std::memory_order_relaxed));
+            };
+            counter("sbe_receiver_messages_total", "Binary frames received", stats.messages);
+            counter("sbe_receiver_bytes_total", "Binary frame bytes received", stats.bytes);
+            counter("sbe_receiver_text_messages_total", "Text frames received (subscription replies)",
+                    stats.text_messages);
+            counter("sbe_receiver_connects_total", "Successful connects", stats.connects);
+            counter("sbe_receiver_disconnects_total", "Disconnects", stats.disconnects);
+            counter("sbe_receiver_dropped_frames_total", "Frames dropped on a full ring", stats.dropped_frames);
+            counter("sbe_receiver_filtered_frames_total", "Frames the subscription mask kept out of the ring",
+                    stats.filtered_frames);
+            counter("sbe_receiver_dropped_bytes_total", "Bytes dropped on a full ring", stats.dropped_bytes);
+            counter("sbe_receiver_idle_polls_total", "Spinning receive polls that found no data", stats.idle_polls);
+            counter("sbe_receiver_yields_total", "Spinning receive polls that yielded the core", stats.yields);
+            out.sample("sbe_receiver_depth_gaps_total", Type::Counter, "Depth diffs that skipped updates", labels,
+                       connection->depth_sequence().gaps());
+            out.sample("sbe_receiver_connected", Type::Gauge, "1 while the connection is up", labels,
+                       uint64_t{stats.connected.load(std::memory_order_relaxed)});
+            out.sample("sbe_receiver_io_uring", Type::Gauge, "1 while the connection receives through io_uring",
+                       labels, uint64_t{stats.io_uring.load(std::memory_order_relaxed)});
+            out.sample("sbe_receiver_ring_capacity", Type::Gauge, "Event ring slots", labels,
+                       uint64_t{connection->ring().capacity()});
+            out.sample("sbe_receiver_ring_high_water", Type::Gauge, "Most event ring slots ever in use", labels,
+                       uint64_t{connection->ring().high_water()});
+            out.sample("sbe_receiver_ring_huge_pages", Type::Gauge, "1 when the event ring is backed by huge pages",
+                       labels, uint64_t{connection->ring().memory().backing() != PageBacking::Normal});
+            if (const LatencyHistogram::Summary latency = connection->exchange_latency().summary(); latency.count > 0) {
+                out.summary("sbe_receiver_exchange_latency_seconds",
+                            "Exchange event to receive, corrected for the exchange clock's offset", labels,
+                            {{"0.5", latency.p50 * 1e-6},
+                             {"0.99", latency.p99 * 1e-6},
+                             {"0.999", latency.p999 * 1e-6},
+                             {"1", latency.max * 1e-6}},
+                            latency.sum * 1e-6, latency.count);
+                counter("sbe_receiver_skewed_latencies_total",
+                        "Exchange-to-receive latencies below zero within the clock offset's error",
+                        stats.skewed_latencies);
+            }
+            if (const EventLog *log = connection->event_log()) {
+                const auto &log_stats = log->stats();
+                counter("sbe_event_log_frames_total", "Frames published to the event log", log_stats.frames);
+                counter("sbe_event_log_records_total", "Records published to the event log", log_stats.records);
+                counter("sbe_event_log_dropped_frames_total", "Frames too large for the event log",
+                        log_stats.dropped_frames);
+            }
+            if (const Conflator *conflator = connection->conflator()) {
+                const auto &conflation_stats = conflator->stats();
+                counter("sbe_conflation_updates_total", "Frames absorbed by conflation", conflation_stats.updates);
+                counter("sbe_conflation_frames_total", "Conflated frames staged", conflation_stats.frames);
+                counter("sbe_conflation_resyncs_total", "Conflated books reseeded after a gap",
+                        conflation_stats.resyncs);
+            }
+            if (const JournalWriter *journal = connection->journal()) {
+                const auto &journal_stats = journal->stats();
+                counter("sbe_journal_records_total", "Frames written to the capture journal", journal_stats.records);
+                counter("sbe_journal_bytes_total", "Capture journal bytes written", journal_stats.bytes);
+                counter("sbe_journal_dropped_total", "Frames the capture journal could not write",
+                        journal_stats.dropped);
+            }
+        }
+        for (std::size_t g = 0; g < feed_groups_.size(); ++g) {
+            const FeedArbiter &arbiter = feed_groups_[g]->arbiter;
+            const std::string group = std::to_string(g);
+            for (std::size_t line = 0; line < arbiter.lines(); ++line) {
+                const FeedLineStats &stats = arbiter.stats(line);
+                const std::string line_id = std::to_string(line);
+                const MetricLabels labels = {
+                    {"receiver", metrics_.instance()}, {"group", group}, {"line", line_id}};
+                const auto counter = [&](std::string_view family, std::string_view help,
+                                         const std::atomic<uint64_t> &v) {
+                    out.sample(family, Type::Counter, help, labels, v.load(std::memory_order_relaxed));
+                };
+                counter("sbe_feed_frames_total", "Frames the line received", stats.frames);
+                counter("sbe_feed_wins_total", "Frames the line delivered first", stats.wins);
+                counter("sbe_feed_duplicates_total", "Frames another line delivered first", stats.duplicates);
+                counter("sbe_feed_fills_total", "Wins that filled a hole another line skipped", stats.fills);
+                counter("sbe_feed_lag_samples_total", "Duplicates timed against the winning copy",
+                        stats.lag_samples);
+                counter("sbe_feed_lag_microseconds_total", "Time duplicates trailed the winning copy",
+                        stats.lag_us_total);
+                out.sample("sbe_feed_lag_max_microseconds", Type::Gauge, "Most a duplicate trailed the winning copy",
+                           labels, stats.lag_us_max.load(std::memory_order_relaxed));
+            }
+            const MetricLabels labels = {{"receiver", metrics_.instance()}, {"group", group}};
+            out.sample("sbe_feed_abandoned_holes_total", Type::Counter, "ID holes no line filled in time", labels,
+                       arbiter.abandoned_holes());
+        }
+        const MetricLabels labels = {{"receiver", metrics_.instance()}};
+        if (executor_) {
+            const IoExecutorStats &stats = executor_->stats();
+            const auto counter = [&](std::string_view family, std::string_view help, const std::atomic<uint64_t> &v) {
+                out.sample(family, Type::Counter, help, labels, v.load(std::memory_order_relaxed));
+            };
+            counter("sbe_executor_resumes_total", "Connection tasks resumed by the executor's workers",
+                    stats.resumes);
+            counter("sbe_executor_polls_total", "epoll waits by the executor's workers", stats.polls);
+            counter("sbe_executor_timeouts_total", "Socket waits that ran out a poll slice", stats.timeouts);
+            counter("sbe_executor_blocking_calls_total", "Connects run off the executor's workers",
+                    stats.blocking_calls);
+            out.sample("sbe_executor_threads", Type::Gauge, "Executor worker threads", labels,
+                       uint64_t{executor_->threads()});
+        }
+        out.sample("sbe_receiver_notify_arms_total", Type::Counter, "Times the consumer armed the eventfd to sleep",
+                   labels, notifier_.arms());
+        out.sample("sbe_receiver_notify_wakeups_total", Type::Counter, "eventfd wake-ups sent to the consumer",
+                   labels, notifier_.wakeups());
+        if (config_.micro_batch.enabled()) {
+            const MicroBatchStats &batches = batcher_.stats();
+            const auto handoffs = [&](std::string_view reason, const std::atomic<uint64_t> &v) {
+                out.sample("sbe_receiver_micro_batches_total", Type::Counter,
+                           "Drains handed off, by what ended the wait",
+                           {{"receiver", metrics_.instance()}, {"reason", reason}}, v.load(std::memory_order_relaxed));
+            };
+            handoffs("full", batches.full);
+            handoffs("timed_out", batches.timed_out);
+            out.sample("sbe_receiver_micro_batch_target", Type::Gauge, "Records a drain currently waits for", labels,
+                       uint64_t{batcher_.target()});
+        }
+    }
+
+    struct PendingBatch {
+        std::size_t waiting = 0;
+        uint64_t wait_us = 0;
+    };
+
+    // Records waiting and how long the batcher would still hold them
+    PendingBatch pending_batch(std::size_t max_records) {
+        PendingBatch pending;
+        uint64_t oldest_us = UINT64_MAX;
+        for (auto &connection : connections_) {
+            EventRing &ring = connection->ring();
+            // Past any cached view, so records staged meanwhile count
+            if (const std::size_t ready = ring.readable(SIZE_MAX); ready > 0) {
+                pending.waiting += ready;
+                oldest_us = std::min(oldest_us, ring.read_slot(0).ingest_ts_us);
+            }
+        }
+        const uint64_t now_us = ingest_time_us();
+        const uint64_t age_us = now_us > oldest_us ? now_us - oldest_us : 0;
+        pending.wait_us = batcher_.wait_us(pending.waiting, age_us, max_records);
+        return pending;
+    }
+
+    // Hold a drain until the batcher's target is waiting or the oldest
+    // record has waited out max_delay_us; returns the records then waiting.
+    // Without `block`, returns 0 at once if the batch is not ready and
+    // leaves the wait in pending_wait_us_.
+    std::size_t wait_for_batch(std::size_t max_records, bool block) {
+        while (true) {
+            const PendingBatch pending = pending_batch(max_records);
+            if (pending.wait_us == 0) {
+                return pending.waiting;
+            }
+            if (!block) {
+                pending_wait_us_ = pending.wait_us;
+                return 0;
+            }
+            std::this_thread::sleep_for(
+                std::chrono::microseconds(std::min<uint64_t>(pending.wait_us, MICRO_BATCH_POLL_US)));
+        }
+    }
+
+    // A connection's ring, journal and event log carry all its streams'
+    // symbols, so they are reported under none
+    void report_memory(MemoryReport &out) const {
+        for (const auto &connection : connections_) {
+            out.add("receiver_ring", "", connection->ring().memory_usage());
+            if (const JournalWriter *journal = connection->journal()) {
+                out.add("capture_journal", "", journal->memory_usage());
+            }
+            if (const EventLog *log = connection->event_log()) {
+                out.add("event_log", "", log->memory_usage());
+            }
+        }
+    }
+
+    bool any_readable() {
+        return std::any_of(connections_.begin(), connections_.end(),
+                           [](const auto &connection) { return connection->ring().readable() > 0; });
+    }
+
+    ReceiverConfig config_;
+    // Before the connections, so their tasks have returned (stop()) by the
+    // time it waits for them
+    std::unique_ptr<IoExecutor> executor_;
+    // Before the connections, which keep a pointer to it
+    ReadyNotifier notifier_;
+    // Before the connections, which keep pointers to their group
+    std::vector<std::unique_ptr<FeedGroup>> feed_groups_;
+    std::vector<std::unique_ptr<StreamConnection>> connections_;
+    std::unique_ptr<JournalSyncer> syncer_;
+    std::size_t next_drain_ = 0;
+    MicroBatcher batcher_;
+    // max_records of the last drain(), for arm_notify()'s batch check
+    std::size_t batch_limit_ = SIZE_MAX;
+    uint64_t pending_wait_us_ = 0;
+    MetricsRegistration metrics_;
+    MemoryRegistration memory_;
+};
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ * A consumer's filter of SBE frames by template and symbol.
+ *
+ * Consumers rarely want every frame: a gap detector only reads depth, a
+ * quote monitor only best bid/ask. Filtering in Python means every frame
+ * has already been decoded and turned into objects before it is thrown
+ * away. A SubscriptionMask is checked in native code before any of that.
+ *
+ * The 8-byte MessageHeader is read first and its template ID tested
+ * against a bitset, so a frame of an unwanted template costs one header
+ * load and one bit test and is never decoded, staged or copied. Only a
+ * mask that also names symbols reads further: the symbol comes out of the
+ * body (stream_frame_symbol, as DecoderPool routes frames) and its
+ * interned ID is tested against a second bitset.
+ *
+ * A mask restricts nothing until templates or symbols are allowed, and
+ * each of the two only restricts once it has an entry. Frames too short
+ * for a header pass, as do frames whose symbol cannot be read, so the
+ * decoder still reports them as errors; frames of templates without a
+ * symbol pass the symbol test.
+ */
+
+#ifndef _SBE_SUBSCRIPTION_MASK_H_
+#define _SBE_SUBSCRIPTION_MASK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+#include "symbol_table.h"
+
+class SubscriptionMask {
+public:
+    // Admit frames of `template_id` (and, once any are allowed, no others)
+    void allow_template(uint16_t template_id) { set_bit(templates_, template_id); }
+
+    // Admit frames of `symbol`, interning it; throws std::runtime_error
+    // when the symbol table is full
+    void allow_symbol(std::string_view symbol) {
+        const SymbolId id = symbol_table().intern(symbol);
+        if (id == INVALID_SYMBOL_ID) {
+            throw std::runtime_error("SubscriptionMask: symbol table is full");
+        }
+        set_bit(symbols_, id);
+    }
+
+    bool restricts_templates() const { return !templates_.empty(); }
+    bool restricts_symbols() const { return !symbols_.empty(); }
+    bool restricts() const { return restricts_templates() || restricts_symbols(); }
+
+    bool admits_template(uint16_t template_id) const {
+        return !restricts_templates() || test_bit(templates_, template_id);
+    }
+
+    bool admits(std::span<const char> frame) const {
+        using spot_sbe::MessageHeader;
+        if (!restricts() || frame.size() < MessageHeader::encodedLength()) {
+            return true;
+        }
+        MessageHeader header{const_cast<char *>(frame.data()), frame.size()};
+        const uint16_t template_id = header.templateId();
+        if (!admits_template(template_id)) {
+            return false;
+        }
+        if (!restricts_symbols()) {
+            return true;
+        }
+        std::string_view symbol;
+        if (stream_frame_symbol(template_id, frame.data() + MessageHeader::encodedLength(),
+                                frame.size() - MessageHeader::encodedLength(), header.blockLength(),
+                                symbol) != ParseError::None ||
+            symbol.empty()) {
+            return true;
+        }
+        const SymbolId id = symbol_table().find(symbol);
+        return id != INVALID_SYMBOL_ID && test_bit(symbols_, id);
+    }
+
+    // Allowed template IDs, ascending; empty when templates are not restricted
+    std::vector<uint16_t> templates() const { return bits_of(templates_); }
+    // Allowed symbol IDs, ascending
+    std::vector<uint16_t> symbol_ids() const { return bits_of(symbols_); }
+
+private:
+    static void set_bit(std::vector<uint64_t> &bits, std::size_t index) {
+        if (index / 64 >= bits.size()) {
+            bits.resize(index / 64 + 1);
+        }
+        bits[index / 64] |= uint64_t{1} << (index % 64);
+    }
+
+    static bool test_bit(const std::vector<uint64_t> &bits, std::size_t index) {
+        return index / 64 < bits.size() && (bits[index / 64] >> (index % 64) & 1) != 0;
+    }
+
+    static std::vector<uint16_t> bits_of(const std::vector<uint64_t> &bits) {
+        std::vector<uint16_t> out;
+        for (std::size_t i = 0; i < bits.size() * 64; ++i) {
+            if (test_bit(bits, i)) {
+                out.push_back(static_cast<uint16_t>(i));
+            }
+        }
+        return out;
+    }
+
+    // Bitsets sized to the highest allowed ID; empty admits every ID
+    std::vector<uint64_t> templates_;
+    std::vector<uint64_t> symbols_;
+};
+
+#endif
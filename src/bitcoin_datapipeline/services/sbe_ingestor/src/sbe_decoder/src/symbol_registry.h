@@ -0,0 +1,148 @@
+/*
+ * Per-symbol state blocks indexed by interned SymbolId.
+ *
+ * Books, windows, rings and sequence trackers for each symbol used to sit
+ * in string-keyed maps, hashed and compared on every message and rehashed
+ * as symbols arrive. A SymbolRegistry<T> holds one T per SymbolId
+ * (symbol_table.h) instead, in chunks of cache-line-aligned blocks, so a
+ * lookup is two loads and neighbouring symbols never share a line. Chunks
+ * are allocated once and never move: a T's address is stable for the life
+ * of the registry, and chunks for the expected symbol count can be
+ * preallocated up front.
+ *
+ * find() is lock-free. Creating a symbol's block takes a mutex, constructs
+ * the T in place and publishes it with a release store, so a thread adding
+ * a symbol at runtime never blocks threads working on the others. A block
+ * is never destroyed before the registry, so a pointer from find() stays
+ * valid; synchronising access to the T itself is up to the caller.
+ */
+
+#ifndef _SBE_SYMBOL_REGISTRY_H_
+#define _SBE_SYMBOL_REGISTRY_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include "symbol_table.h"
+
+template <typename T>
+class SymbolRegistry {
+public:
+    static constexpr std::size_t CACHE_LINE = 64;
+    static constexpr std::size_t CHUNK_SIZE = 64;
+    static constexpr std::size_t CHUNK_COUNT = SymbolTable::MAX_SYMBOLS / CHUNK_SIZE;
+
+    // Preallocate the blocks of the first `symbols` IDs
+    explicit SymbolRegistry(std::size_t symbols = 0) {
+        std::lock_guard create(create_);
+        for (std::size_t chunk = 0; chunk * CHUNK_SIZE < symbols && chunk < CHUNK_COUNT; ++chunk) {
+            chunk_for(static_cast<SymbolId>(chunk * CHUNK_SIZE));
+        }
+    }
+
+    SymbolRegistry(const SymbolRegistry &) = delete;
+    SymbolRegistry &operator=(const SymbolRegistry &) = delete;
+
+    ~SymbolRegistry() {
+        for (auto &chunk : chunks_) {
+            Chunk *blocks = chunk.load(std::memory_order_relaxed);
+            if (blocks == nullptr) {
+                continue;
+            }
+            for (Block &block : blocks->blocks) {
+                if (block.ready.load(std::memory_order_relaxed)) {
+                    block.value()->~T();
+                }
+            }
+            delete blocks;
+        }
+    }
+
+    // The symbol's T, or nullptr before emplace()
+    T *find(SymbolId id) const {
+        if (id >= SymbolTable::MAX_SYMBOLS) {
+            return nullptr;
+        }
+        Chunk *chunk = chunks_[id / CHUNK_SIZE].load(std::memory_order_acquire);
+        if (chunk == nullptr) {
+            return nullptr;
+        }
+        Block &block = chunk->blocks[id % CHUNK_SIZE];
+        return block.ready.load(std::memory_order_acquire) ? block.value() : nullptr;
+    }
+
+    // The symbol's T, constructed from `args` if it has none yet; the bool
+    // is true when this call constructed it
+    template <typename... Args>
+    std::pair<T *, bool> emplace(SymbolId id, Args &&...args) {
+        if (T *existing = find(id)) {
+            return {existing, false};
+        }
+        if (id >= SymbolTable::MAX_SYMBOLS) {
+            throw std::out_of_range("SymbolRegistry: invalid symbol ID");
+        }
+        std::lock_guard create(create_);
+        Block &block = chunk_for(id)->blocks[id % CHUNK_SIZE];
+        if (block.ready.load(std::memory_order_relaxed)) {
+            return {block.value(), false};
+        }
+        ::new (static_cast<void *>(block.storage)) T(std::forward<Args>(args)...);
+        block.ready.store(true, std::memory_order_release);
+        if (id >= end_.load(std::memory_order_relaxed)) {
+            end_.store(static_cast<std::size_t>(id) + 1, std::memory_order_release);
+        }
+        count_.fetch_add(1, std::memory_order_release);
+        return {block.value(), true};
+    }
+
+    // fn(SymbolId, T &) for every symbol with a block, in ID order
+    template <typename Fn>
+    void for_each(Fn &&fn) const {
+        const std::size_t end = end_.load(std::memory_order_acquire);
+        for (std::size_t id = 0; id < end; ++id) {
+            if (T *value = find(static_cast<SymbolId>(id))) {
+                fn(static_cast<SymbolId>(id), *value);
+            }
+        }
+    }
+
+    std::size_t size() const { return count_.load(std::memory_order_acquire); }
+
+private:
+    // One symbol's T on cache lines of its own
+    struct alignas(CACHE_LINE) Block {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::atomic<bool> ready{false};
+
+        T *value() { return std::launder(reinterpret_cast<T *>(storage)); }
+    };
+
+    struct Chunk {
+        std::array<Block, CHUNK_SIZE> blocks;
+    };
+
+    // With create_ held
+    Chunk *chunk_for(SymbolId id) {
+        auto &slot = chunks_[id / CHUNK_SIZE];
+        Chunk *chunk = slot.load(std::memory_order_relaxed);
+        if (chunk == nullptr) {
+            chunk = new Chunk();
+            slot.store(chunk, std::memory_order_release);
+        }
+        return chunk;
+    }
+
+    std::array<std::atomic<Chunk *>, CHUNK_COUNT> chunks_{};
+    std::atomic<std::size_t> end_{0};
+    std::atomic<std::size_t> count_{0};
+    std::mutex create_;
+};
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ * Per-symbol trading rules from exchangeInfo (ExchangeInfoResponse, template
+ * 103), flattened for the hot path.
+ *
+ * official/exchange_info.h models the response as nested vectors with each
+ * filter a std::variant, so a symbol's tick size is a linear scan plus a
+ * visit. SymbolRulesTable keeps one fixed-size SymbolRules row per symbol
+ * instead (PRICE_FILTER, LOT_SIZE and MIN_NOTIONAL/NOTIONAL as integer
+ * mantissas with their exponents) in a vector indexed by the symbol's
+ * interned ID (symbol_table.h), the same ID the decoded columns and order
+ * books carry. A caller resolves its symbol once and every later check is
+ * one acquire load of the current snapshot plus an indexed read.
+ *
+ * A refresh decodes the whole response into a new snapshot and publishes it
+ * with a single pointer swap, so readers never block and never see a
+ * half-applied refresh. A replaced snapshot is freed only after
+ * RETIRED_SNAPSHOTS further refreshes; readers must not keep a rules pointer
+ * across refreshes (exchangeInfo changes on the order of hours).
+ */
+
+#ifndef _SBE_SYMBOL_RULES_H_
+#define _SBE_SYMBOL_RULES_H_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "official/util.h"
+#include "spot_sbe/ExchangeInfoResponse.h"
+#include "spot_sbe/LotSizeFilter.h"
+#include "spot_sbe/MessageHeader.h"
+#include "spot_sbe/MinNotionalFilter.h"
+#include "spot_sbe/NotionalFilter.h"
+#include "spot_sbe/PriceFilter.h"
+#include "spot_sbe/SymbolStatus.h"
+#include "stream_decode.h"
+#include "symbol_table.h"
+
+// Why SymbolRules::check rejected an order
+enum class RuleCheck : uint8_t {
+    Ok,
+    NotListed,    // symbol absent from the latest exchangeInfo
+    PriceRange,   // outside [min_price, max_price]
+    PriceTick,    // not on the tick grid
+    QtyRange,     // outside [min_qty, max_qty]
+    QtyStep,      // not on the step grid
+    MinNotional,  // price * qty below min_notional
+};
+
+// One symbol's rules. Every bound is a mantissa at its filter's exponent;
+// a zero bound or step is "no constraint", as on the exchange.
+struct SymbolRules {
+    // PRICE_FILTER, at price_exponent
+    int64_t min_price = 0;
+    int64_t max_price = 0;
+    int64_t tick_size = 0;
+    // LOT_SIZE, at qty_exponent
+    int64_t min_qty = 0;
+    int64_t max_qty = 0;
+    int64_t step_size = 0;
+    // MIN_NOTIONAL or NOTIONAL minimum, at notional_exponent
+    int64_t min_notional = 0;
+    int8_t price_exponent = 0;
+    int8_t qty_exponent = 0;
+    int8_t notional_exponent = 0;
+    spot_sbe::SymbolStatus::Value status = spot_sbe::SymbolStatus::NULL_VALUE;
+    bool listed = false;
+
+    // Round down onto the tick / step grid (mantissas at price_exponent /
+    // qty_exponent)
+    int64_t floor_to_tick(int64_t price) const {
+        return tick_size > 0 ? price - floor_mod(price - min_price, tick_size) : price;
+    }
+
+    int64_t floor_to_step(int64_t qty) const {
+        return step_size > 0 ? qty - floor_mod(qty - min_qty, step_size) : qty;
+    }
+
+    // Check a limit order's price and quantity, given as mantissas at
+    // price_exponent and qty_exponent
+    RuleCheck check(int64_t price, int64_t qty) const {
+        if (!listed) {
+            return RuleCheck::NotListed;
+        }
+        if (price < min_price || (max_price > 0 && price > max_price)) {
+            return RuleCheck::PriceRange;
+        }
+        if (tick_size > 0 && (price - min_price) % tick_size != 0) {
+            return RuleCheck::PriceTick;
+        }
+        if (qty < min_qty || (max_qty > 0 && qty > max_qty)) {
+            return RuleCheck::QtyRange;
+        }
+        if (step_size > 0 && (qty - min_qty) % step_size != 0) {
+            return RuleCheck::QtyStep;
+        }
+        if (min_notional > 0 && !meets_min_notional(price, qty)) {
+            return RuleCheck::MinNotional;
+        }
+        return RuleCheck::Ok;
+    }
+
+private:
+    static int64_t floor_mod(int64_t value, int64_t divisor) {
+        const int64_t rem = value % divisor;
+        return rem < 0 ? rem + divisor : rem;
+    }
+
+    // price * qty (at price_exponent + qty_exponent) >= min_notional (at
+    // notional_exponent), compared at the finer of the two exponents
+    bool meets_min_notional(int64_t price, int64_t qty) const {
+        const int notional_exponent_of_order = price_exponent + qty_exponent;
+        __int128 order = static_cast<__int128>(price) * qty;
+        __int128 minimum = min_notional;
+        if (notional_exponent_of_order > notional_exponent) {
+            order *= pow10_i64(notional_exponent_of_order - notional_exponent);
+        } else {
+            minimum *= pow10_i64(notional_exponent - notional_exponent_of_order);
+        }
+        return order >= minimum;
+    }
+};
+
+class SymbolRulesTable {
+public:
+    // Snapshots replaced by a refresh but not yet freed
+    static constexpr std::size_t RETIRED_SNAPSHOTS = 4;
+
+    SymbolRulesTable() {
+        snapshots_.push_back(std::make_unique<Snapshot>());
+        current_.store(snapshots_.back().get(), std::memory_order_release);
+    }
+
+    SymbolRulesTable(const SymbolRulesTable &) = delete;
+    SymbolRulesTable &operator=(const SymbolRulesTable &) = delete;
+
+    // Decode an ExchangeInfoResponse frame (message header included) and
+    // publish its rules. Symbols missing from it keep their ID but are no
+    // longer listed. Returns the number of symbols in the response; throws
+    // std::runtime_error (table unchanged) on a malformed frame.
+    std::size_t load_exchange_info(std::span<char> payload) {
+        using spot_sbe::MessageHeader;
+        if (payload.size() < MessageHeader::encodedLength()) {
+            throw std::runtime_error("Buffer too short for message header");
+        }
+        MessageHeader header(payload.data(), payload.size());
+        if (header.schemaId() != EXPECTED_SCHEMA_ID) {
+            throw std::runtime_error("Unexpected schema id " + std::to_string(header.schemaId()));
+        }
+        if (header.templateId() != spot_sbe::ExchangeInfoResponse::sbeTemplateId()) {
+            throw std::runtime_error("Expected ExchangeInfoResponse (template 103), got template " +
+                                     std::to_string(header.templateId()));
+        }
+
+        std::lock_guard refresh(refresh_);
+        const Snapshot &previous = *current_.load(std::memory_order_relaxed);
+        auto next = std::make_unique<Snapshot>();
+        next->known = previous.known;
+        next->rules.resize(previous.rules.size());
+        next->listed_count = previous.listed_count;
+        next->generation = previous.generation + 1;
+
+        // Groups and var data must be read in schema order
+        auto response = message_from_header<spot_sbe::ExchangeInfoResponse>(payload, header);
+        response.rateLimits().forEach([](auto &limit) { limit.skip(); });
+        response.exchangeFilters().forEach([](auto &filter) { filter.skip(); });
+        std::size_t loaded = 0;
+        response.symbols().forEach([&](auto &symbol) {
+            SymbolRules rules;
+            rules.status = static_cast<spot_sbe::SymbolStatus::Value>(symbol.statusRaw());
+            symbol.filters().forEach([&](auto &filter) { apply_filter(rules, filter.getFilterAsStringView()); });
+            symbol.permissions().forEach([](auto &permission) { permission.skip(); });
+            const std::string_view name = symbol.getSymbolAsStringView();
+            symbol.skipBaseAsset();
+            symbol.skipQuoteAsset();
+
+            rules.listed = true;
+            next->row(name) = rules;
+            ++loaded;
+        });
+
+        current_.store(next.get(), std::memory_order_release);
+        snapshots_.push_back(std::move(next));
+        while (snapshots_.size() > RETIRED_SNAPSHOTS + 1) {
+            snapshots_.pop_front();
+        }
+        return loaded;
+    }
+
+    // Interned ID of `symbol`, or INVALID_SYMBOL_ID if it has never been
+    // listed
+    SymbolId id_of(std::string_view symbol) const {
+        const Snapshot &snapshot = *current_.load(std::memory_order_acquire);
+        const SymbolId id = symbol_table().find(symbol);
+        return snapshot.has_row(id) ? id : INVALID_SYMBOL_ID;
+    }
+
+    // Rules of a symbol's ID, or nullptr if it has never been listed
+    const SymbolRules *rules(SymbolId id) const {
+        const Snapshot &snapshot = *current_.load(std::memory_order_acquire);
+        return snapshot.has_row(id) ? &snapshot.rules[id] : nullptr;
+    }
+
+    const SymbolRules *find(std::string_view symbol) const { return rules(symbol_table().find(symbol)); }
+
+    // Symbols ever listed, listed now or not
+    std::size_t size() const { return current_.load(std::memory_order_acquire)->listed_count; }
+
+    // Number of refreshes published so far
+    uint64_t generation() const { return current_.load(std::memory_order_acquire)->generation; }
+
+private:
+    struct Snapshot {
+        // Both indexed by SymbolId; known[id] once the symbol has been listed
+        std::vector<SymbolRules> rules;
+        std::vector<uint8_t> known;
+        std::size_t listed_count = 0;
+        uint64_t generation = 0;
+
+        bool has_row(SymbolId id) const { return id < known.size() && known[id]; }
+
+        SymbolRules &row(std::string_view symbol) {
+            const SymbolId id = symbol_table().intern(symbol);
+            if (id == INVALID_SYMBOL_ID) {
+                throw std::runtime_error("Symbol table is full");
+            }
+            if (id >= rules.size()) {
+                rules.resize(id + 1);
+                known.resize(id + 1);
+            }
+            if (!known[id]) {
+                known[id] = 1;
+                ++listed_count;
+            }
+            return rules[id];
+        }
+    };
+
+    // A symbol filter is itself an SBE message (header + block); the ones
+    // without a rules column are skipped
+    static void apply_filter(SymbolRules &rules, std::string_view encoded) {
+        using spot_sbe::MessageHeader;
+        if (encoded.size() < MessageHeader::encodedLength()) {
+            throw std::runtime_error("Symbol filter shorter than its message header");
+        }
+        const std::span<char> filter(const_cast<char *>(encoded.data()), encoded.size());
+        MessageHeader header(filter.data(), filter.size());
+        switch (header.templateId()) {
+        case spot_sbe::PriceFilter::sbeTemplateId(): {
+            auto msg = message_from_header<spot_sbe::PriceFilter>(filter, header);
+            rules.price_exponent = msg.priceExponent();
+            rules.min_price = msg.minPrice();
+            rules.max_price = msg.maxPrice();
+            rules.tick_size = msg.tickSize();
+            break;
+        }
+        case spot_sbe::LotSizeFilter::sbeTemplateId(): {
+            auto msg = message_from_header<spot_sbe::LotSizeFilter>(filter, header);
+            rules.qty_exponent = msg.qtyExponent();
+            rules.min_qty = msg.minQty();
+            rules.max_qty = msg.maxQty();
+            rules.step_size = msg.stepSize();
+            break;
+        }
+        case spot_sbe::MinNotionalFilter::sbeTemplateId(): {
+            auto msg = message_from_header<spot_sbe::MinNotionalFilter>(filter, header);
+            rules.notional_exponent = msg.priceExponent();
+            rules.min_notional = msg.minNotional();
+            break;
+        }
+        case spot_sbe::NotionalFilter::sbeTemplateId(): {
+            auto msg = message_from_header<spot_sbe::NotionalFilter>(filter, header);
+            rules.notional_exponent = msg.priceExponent();
+            rules.min_notional = msg.minNotional();
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    std::mutex refresh_;
+    std::atomic<const Snapshot *> current_{nullptr};
+    // Current snapshot at the back, retired ones in front of it
+    std::deque<std::unique_ptr<const Snapshot>> snapshots_;
+};
+
+#endif
@@ -0,0 +1,814 @@
+/*
+ * Splitting the symbol universe over several ingest nodes, with each
+ * symbol owned through a lease in Redis.
+ *
+ * ShardRing places every node at `vnodes` points of a 64-bit hash ring and
+ * gives a symbol to the node at the first point at or after the symbol's
+ * own hash. A node joining or leaving only moves the symbols of the arcs
+ * its points take or give back, about symbols / nodes of them, and each
+ * node ends up with close to an equal share. Hashes are FNV-1a finished
+ * with a 64-bit mixer over the upper-cased symbol, so every node computes
+ * the same ring from the same member list.
+ *
+ * The ring says who should own a symbol; a lease says who does. A
+ * ShardLeaseManager renews its node's leases on its own thread every
+ * interval_ms, independent of the event loop and the GIL, in one round of
+ * Lua scripts, so each step is atomic on the server:
+ *
+ *   membership  the node's entry in a sorted set scored by expiry (Redis
+ *               time), stale entries dropped; the live members make the
+ *               ring
+ *   renew       every lease still holding this node's token gets lease_ms
+ *               more; one holding anything else is lost
+ *   releasing   a held symbol the ring now gives to another node is
+ *               reported, and its lease kept renewed, until the caller has
+ *               stopped its streams, checkpointed its book and called
+ *               release()
+ *   release     the lease becomes "released:<ms>" for one lease period,
+ *               so the next owner takes it at once and learns when the
+ *               stream stopped
+ *   acquire     a symbol the ring gives this node is taken if its lease is
+ *               free or released, and otherwise tried again next round
+ *
+ * So a symbol is never leased to two nodes: the next owner waits for the
+ * release or, when the owner died, for its lease to expire. The lease's
+ * holder must also stop by then when it can no longer renew (Redis
+ * unreachable or slow). A renewal sent at local time t keeps the lease on
+ * the server until at least t + lease_ms, so the lease is reported lost at
+ * t + lease_ms - stop_budget_ms, which leaves the caller stop_budget_ms to
+ * stop the symbol's streams before anyone else can take it. A fence thread
+ * of its own reports it on time even while the round is blocked in a
+ * Redis call. The constructor rejects a lease that leaves no margin past
+ * interval_ms, a connect timeout, a send and a receive timeout and the
+ * stop budget, the longest a healthy node goes between renewals. Acquired,
+ * releasing and lost symbols queue up as ShardChanges for the caller to
+ * take; wait_changes() blocks until there are some.
+ *
+ * All keys share the key prefix's hash tag, so the multi-key scripts also
+ * run on Redis Cluster. Every node must be given the same symbol list and
+ * vnodes. The Redis transport can be replaced (tests). Thread-safe; tick()
+ * is not to be mixed with a running start(), and without start() leases are
+ * only fenced at the start of a tick().
+ */
+
+#ifndef _SBE_SYMBOL_SHARD_H_
+#define _SBE_SYMBOL_SHARD_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "native_metrics.h"
+#include "redis_connection.h"
+
+// Symbols are sharded and leased by their upper-case name
+inline std::string shard_symbol(std::string_view symbol) {
+    std::string out(symbol);
+    std::transform(out.begin(), out.end(), out.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return out;
+}
+
+inline uint64_t shard_hash(std::string_view text) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char c : text) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    // FNV-1a alone leaves names differing in their last byte close together
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+class ShardRing {
+public:
+    explicit ShardRing(std::vector<std::string> nodes = {}, uint32_t vnodes = 128) : vnodes_(vnodes) {
+        if (vnodes_ == 0) {
+            throw std::runtime_error("ShardRing: vnodes must be positive");
+        }
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        nodes_ = std::move(nodes);
+        points_.reserve(nodes_.size() * vnodes_);
+        for (uint32_t node = 0; node < nodes_.size(); ++node) {
+            if (nodes_[node].empty()) {
+                throw std::runtime_error("ShardRing: empty node id");
+            }
+            for (uint32_t i = 0; i < vnodes_; ++i) {
+                points_.push_back({shard_hash(nodes_[node] + "#" + std::to_string(i)), node});
+            }
+        }
+        std::sort(points_.begin(), points_.end());
+    }
+
+    const std::vector<std::string> &nodes() const { return nodes_; }
+    uint32_t vnodes() const { return vnodes_; }
+    bool empty() const { return nodes_.empty(); }
+
+    // Node owning `symbol`; throws std::runtime_error on an empty ring
+    const std::string &owner(std::string_view symbol) const {
+        if (points_.empty()) {
+            throw std::runtime_error("ShardRing: no nodes");
+        }
+        const uint64_t hash = shard_hash(shard_symbol(symbol));
+        auto it = std::lower_bound(points_.begin(), points_.end(), Point{hash, 0});
+        if (it == points_.end()) {
+            it = points_.begin();
+        }
+        return nodes_[it->node];
+    }
+
+    // The upper-cased symbols of `symbols` that `node` owns, in their order
+    std::vector<std::string> owned(std::span<const std::string> symbols, std::string_view node) const {
+        std::vector<std::string> out;
+        if (points_.empty()) {
+            return out;
+        }
+        for (const std::string &symbol : symbols) {
+            if (owner(symbol) == node) {
+                out.push_back(shard_symbol(symbol));
+            }
+        }
+        return out;
+    }
+
+private:
+    struct Point {
+        uint64_t hash;
+        uint32_t node;
+        auto operator<=>(const Point &) const = default;
+    };
+
+    uint32_t vnodes_;
+    // Sorted, unique
+    std::vector<std::string> nodes_;
+    std::vector<Point> points_;
+};
+
+namespace shard_detail {
+
+// KEYS[1] the member set; ARGV node id, lease ms. Returns {now ms, members}
+inline constexpr const char *MEMBERS_SCRIPT = R"lua(
+local t = redis.call('TIME')
+local now = tonumber(t[1]) * 1000 + math.floor(tonumber(t[2]) / 1000)
+redis.call('ZADD', KEYS[1], now + tonumber(ARGV[2]), ARGV[1])
+redis.call('ZREMRANGEBYSCORE', KEYS[1], '-inf', now)
+return {now, redis.call('ZRANGE', KEYS[1], 0, -1)}
+)lua";
+
+// KEYS leases; ARGV token, lease ms. Returns 1 per lease renewed, else 0
+inline constexpr const char *RENEW_SCRIPT = R"lua(
+local out = {}
+for i, key in ipairs(KEYS) do
+  if redis.call('GET', key) == ARGV[1] then
+    out[i] = redis.call('PEXPIRE', key, ARGV[2])
+  else
+    out[i] = 0
+  end
+end
+return out
+)lua";
+
+// KEYS leases; ARGV token, lease ms. Per lease, its previous value when
+// taken ("" if free) or nil while another node holds it
+inline constexpr const char *ACQUIRE_SCRIPT = R"lua(
+local out = {}
+for i, key in ipairs(KEYS) do
+  local v = redis.call('GET', key)
+  if not v or v == ARGV[1] or string.sub(v, 1, 9) == 'released:' then
+    redis.call('SET', key, ARGV[1], 'PX', ARGV[2])
+    out[i] = v or ''
+  else
+    out[i] = false
+  end
+end
+return out
+)lua";
+
+// KEYS leases; ARGV token, lease ms. Returns the leases released
+inline constexpr const char *RELEASE_SCRIPT = R"lua(
+local t = redis.call('TIME')
+local marker = 'released:' .. t[1] .. string.format('%03d', math.floor(tonumber(t[2]) / 1000))
+local n = 0
+for i, key in ipairs(KEYS) do
+  if redis.call('GET', key) == ARGV[1] then
+    redis.call('SET', key, marker, 'PX', ARGV[2])
+    n = n + 1
+  end
+end
+return n
+)lua";
+
+inline constexpr std::string_view RELEASED_PREFIX = "released:";
+
+inline uint64_t steady_us() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+}  // namespace shard_detail
+
+struct ShardLeaseConfig {
+    RedisEndpoint redis;
+    std::string node_id;
+    // The symbol universe, the same on every node
+    std::vector<std::string> symbols;
+    // Ends in a hash tag so every key lands in one cluster slot
+    std::string key_prefix = "{sbe-shard}:";
+    uint32_t vnodes = 128;
+    int lease_ms = 10000;
+    int interval_ms = 500;
+    // Time the caller needs to stop a lost symbol's streams
+    int stop_budget_ms = 1000;
+};
+
+struct ShardAcquired {
+    std::string symbol;
+    // Redis time the previous owner released the lease; 0 when it was free
+    // or had expired (the previous owner's stop time is unknown)
+    uint64_t released_ms = 0;
+    uint64_t acquired_ms = 0;
+};
+
+struct ShardChanges {
+    std::vector<ShardAcquired> acquired;
+    // Symbols to hand off: stop their streams, checkpoint, then release()
+    std::vector<std::string> releasing;
+    // Leases lost without a release: stop their streams now
+    std::vector<std::string> lost;
+
+    bool empty() const { return acquired.empty() && releasing.empty() && lost.empty(); }
+};
+
+// Written by the renewing thread, readable from any thread
+struct ShardLeaseStats {
+    std::atomic<uint64_t> ticks{0};
+    // Rounds that failed (Redis unreachable, script errors)
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> connects{0};
+    std::atomic<uint64_t> renewals{0};
+    std::atomic<uint64_t> acquired{0};
+    std::atomic<uint64_t> released{0};
+    std::atomic<uint64_t> lost{0};
+    // Member list changes
+    std::atomic<uint64_t> rebalances{0};
+};
+
+class ShardLeaseManager {
+public:
+    // One command and its reply; the default is the manager's own
+    // RedisConnection. Error replies throw std::runtime_error.
+    using Transport = std::function<RedisReply(const std::vector<std::string> &)>;
+
+    explicit ShardLeaseManager(ShardLeaseConfig config, Transport transport = {})
+        : config_(std::move(config)), transport_(std::move(transport)) {
+        if (config_.node_id.empty()) {
+            throw std::invalid_argument("ShardLeaseManager needs a node id");
+        }
+        if (config_.interval_ms < 1 || config_.stop_budget_ms < 0) {
+            throw std::invalid_argument("ShardLeaseManager needs a positive interval and a stop budget");
+        }
+        // The longest a healthy node goes between renewals: the wait, then
+        // a connect, a send and a receive
+        const int64_t round_ms = int64_t{config_.interval_ms} + config_.redis.connect_timeout_ms +
+                                 2 * int64_t{config_.redis.io_timeout_ms};
+        if (int64_t{config_.lease_ms} - config_.stop_budget_ms <= round_ms) {
+            throw std::invalid_argument("ShardLeaseManager: lease must exceed interval, the Redis connect and I/O "
+                                        "timeouts and the stop budget together");
+        }
+        if (config_.vnodes == 0) {
+            throw std::invalid_argument("ShardLeaseManager needs positive vnodes");
+        }
+        std::set<std::string> seen;
+        for (const std::string &symbol : config_.symbols) {
+            std::string name = shard_symbol(symbol);
+            if (!name.empty() && seen.insert(name).second) {
+                symbols_.push_back(std::move(name));
+            }
+        }
+        std::random_device random;
+        const uint64_t instance = (static_cast<uint64_t>(random()) << 32) | random();
+        char hex[17];
+        const auto end = std::to_chars(hex, hex + 16, instance, 16).ptr;
+        token_ = config_.node_id + "/" + std::string(hex, end);
+        members_key_ = config_.key_prefix + "nodes";
+        if (!transport_) {
+            transport_ = [this](const std::vector<std::string> &args) { return connection_command(args); };
+        }
+        metrics_.publish([this](MetricsWriter &out) { write_metrics(out); });
+    }
+
+    ~ShardLeaseManager() { stop(false); }
+
+    ShardLeaseManager(const ShardLeaseManager &) = delete;
+    ShardLeaseManager &operator=(const ShardLeaseManager &) = delete;
+
+    // Run a round now and then every interval_ms on a background thread,
+    // and fence leases on another
+    void start() {
+        std::lock_guard lock(mutex_);
+        if (thread_.joinable()) {
+            return;
+        }
+        stopping_ = false;
+        thread_ = std::thread([this] { run(); });
+        fence_thread_ = std::thread([this] { run_fence(); });
+    }
+
+    // Stop renewing; with `release`, also release every lease held and
+    // leave the member set, so the other nodes take over at once (the
+    // caller checkpoints its books first). Without it the leases expire.
+    void stop(bool release = true) {
+        std::thread thread;
+        std::thread fence_thread;
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+            thread = std::move(thread_);
+            fence_thread = std::move(fence_thread_);
+        }
+        wake_.notify_all();
+        fence_wake_.notify_all();
+        changed_.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        if (fence_thread.joinable()) {
+            fence_thread.join();
+        }
+        if (release) {
+            release_all();
+        }
+    }
+
+    bool running() const {
+        std::lock_guard lock(mutex_);
+        return thread_.joinable() && !stopping_;
+    }
+
+    // One round on the calling thread; false when it failed. Not to be
+    // mixed with a running start().
+    bool tick() {
+        stats_.ticks.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard lock(mutex_);
+            fence_locked();
+        }
+        std::vector<std::string> releases;
+        {
+            std::lock_guard lock(mutex_);
+            releases.swap(pending_release_);
+        }
+        try {
+            release_leases(releases);
+        } catch (const std::exception &e) {
+            std::lock_guard lock(mutex_);
+            pending_release_.insert(pending_release_.end(), releases.begin(), releases.end());
+            return fail(e.what());
+        }
+        try {
+            renew();
+            const uint64_t now_ms = refresh_members();
+            hand_off();
+            acquire(now_ms);
+        } catch (const std::exception &e) {
+            return fail(e.what());
+        }
+        return true;
+    }
+
+    // Release the leases of symbols reported as releasing, once their
+    // streams are stopped and their books checkpointed; done next round
+    void release(const std::vector<std::string> &symbols) {
+        {
+            std::lock_guard lock(mutex_);
+            for (const std::string &symbol : symbols) {
+                pending_release_.push_back(shard_symbol(symbol));
+            }
+            woken_ = true;
+        }
+        wake_.notify_all();
+    }
+
+    ShardChanges take_changes() {
+        std::lock_guard lock(mutex_);
+        return std::exchange(changes_, ShardChanges{});
+    }
+
+    // Wait up to timeout_ms for changes; true when there are some
+    bool wait_changes(int timeout_ms) {
+        std::unique_lock lock(mutex_);
+        changed_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                          [this] { return !changes_.empty() || stopping_; });
+        return !changes_.empty();
+    }
+
+    // Symbols leased to this node and not being handed off
+    std::vector<std::string> owned() const { return held_where(false); }
+    std::vector<std::string> releasing() const { return held_where(true); }
+
+    std::vector<std::string> members() const {
+        std::lock_guard lock(mutex_);
+        return ring_.nodes();
+    }
+
+    const std::vector<std::string> &symbols() const { return symbols_; }
+    const ShardLeaseConfig &config() const { return config_; }
+    const std::string &token() const { return token_; }
+    const ShardLeaseStats &stats() const { return stats_; }
+
+    std::string last_error() const {
+        std::lock_guard lock(mutex_);
+        return last_error_;
+    }
+
+private:
+    struct Lease {
+        // Steady time the lease must be given up by without a renewal
+        uint64_t valid_until_us = 0;
+        bool releasing = false;
+    };
+
+    void run() {
+        while (true) {
+            tick();
+            std::unique_lock lock(mutex_);
+            wake_.wait_for(lock, std::chrono::milliseconds(config_.interval_ms),
+                           [this] { return stopping_ || woken_; });
+            if (stopping_) {
+                return;
+            }
+            woken_ = false;
+        }
+    }
+
+    // Report each lease lost as its deadline passes, whatever the round
+    // thread is doing
+    void run_fence() {
+        std::unique_lock lock(mutex_);
+        while (!stopping_) {
+            fence_locked();
+            uint64_t next = UINT64_MAX;
+            for (const auto &[symbol, lease] : held_) {
+                next = std::min(next, lease.valid_until_us);
+            }
+            fence_pending_ = false;
+            const auto woken = [this] { return stopping_ || fence_pending_; };
+            if (next == UINT64_MAX) {
+                fence_wake_.wait(lock, woken);
+            } else {
+                const uint64_t now = shard_detail::steady_us();
+                fence_wake_.wait_for(lock, std::chrono::microseconds(next > now ? next - now : 0), woken);
+            }
+        }
+    }
+
+    RedisReply connection_command(const std::vector<std::string> &args) {
+        if (!connection_.connected()) {
+            connection_.connect(config_.redis);
+            stats_.connects.fetch_add(1, std::memory_order_relaxed);
+        }
+        return connection_.command(args);
+    }
+
+    RedisReply eval(const char *script, const std::vector<std::string> &keys, std::vector<std::string> argv) {
+        std::vector<std::string> args = {"EVAL", script, std::to_string(keys.size())};
+        args.insert(args.end(), keys.begin(), keys.end());
+        args.insert(args.end(), std::make_move_iterator(argv.begin()), std::make_move_iterator(argv.end()));
+        return transport_(args);
+    }
+
+    std::string lease_key(const std::string &symbol) const { return config_.key_prefix + "lease:" + symbol; }
+
+    std::vector<std::string> lease_keys(const std::vector<std::string> &symbols) const {
+        std::vector<std::string> keys;
+        keys.reserve(symbols.size());
+        for (const std::string &symbol : symbols) {
+            keys.push_back(lease_key(symbol));
+        }
+        return keys;
+    }
+
+    static const RedisReply &array_reply(const RedisReply &reply, std::size_t size, const char *script) {
+        if (reply.type != RedisReply::Type::Array || reply.elements.size() != size) {
+            throw std::runtime_error(std::string("ShardLeaseManager: unexpected reply to the ") + script + " script");
+        }
+        return reply;
+    }
+
+    // A renewal sent at sent_us holds the lease on the server until at
+    // least sent_us + lease_ms; the caller gets stop_budget_ms of that
+    uint64_t lease_deadline(uint64_t sent_us) const {
+        return sent_us + static_cast<uint64_t>(config_.lease_ms - config_.stop_budget_ms) * 1000;
+    }
+
+    // Leases past their local deadline are lost. Under mutex_.
+    void fence_locked() {
+        const uint64_t now = shard_detail::steady_us();
+        std::size_t lapsed = 0;
+        for (auto it = held_.begin(); it != held_.end();) {
+            if (now >= it->second.valid_until_us) {
+                changes_.lost.push_back(it->first);
+                it = held_.erase(it);
+                ++lapsed;
+            } else {
+                ++it;
+            }
+        }
+        if (lapsed > 0) {
+            stats_.lost.fetch_add(lapsed, std::memory_order_relaxed);
+            changed_.notify_all();
+        }
+    }
+
+    // Symbols still held are lost (the fence may have got there first)
+    void lose(const std::vector<std::string> &symbols) {
+        std::size_t lost = 0;
+        {
+            std::lock_guard lock(mutex_);
+            for (const std::string &symbol : symbols) {
+                if (held_.erase(symbol) > 0) {
+                    changes_.lost.push_back(symbol);
+                    ++lost;
+                }
+            }
+        }
+        if (lost > 0) {
+            stats_.lost.fetch_add(lost, std::memory_order_relaxed);
+            changed_.notify_all();
+        }
+    }
+
+    // The symbols held, under mutex_, since the fence thread may drop some
+    std::vector<std::string> held_symbols() const {
+        std::lock_guard lock(mutex_);
+        std::vector<std::string> symbols;
+        symbols.reserve(held_.size());
+        for (const auto &[symbol, lease] : held_) {
+            symbols.push_back(symbol);
+        }
+        return symbols;
+    }
+
+    void release_leases(const std::vector<std::string> &requested) {
+        std::vector<std::string> symbols;
+        {
+            std::lock_guard lock(mutex_);
+            for (const std::string &symbol : requested) {
+                const auto it = held_.find(symbol);
+                if (it != held_.end() && it->second.releasing &&
+                    std::find(symbols.begin(), symbols.end(), symbol) == symbols.end()) {
+                    symbols.push_back(symbol);
+                }
+            }
+        }
+        if (symbols.empty()) {
+            return;
+        }
+        eval(shard_detail::RELEASE_SCRIPT, lease_keys(symbols), {token_, std::to_string(config_.lease_ms)});
+        {
+            std::lock_guard lock(mutex_);
+            for (const std::string &symbol : symbols) {
+                held_.erase(symbol);
+            }
+        }
+        stats_.released.fetch_add(symbols.size(), std::memory_order_relaxed);
+    }
+
+    void renew() {
+        const std::vector<std::string> symbols = held_symbols();
+        if (symbols.empty()) {
+            return;
+        }
+        const uint64_t sent = shard_detail::steady_us();
+        const RedisReply reply = array_reply(
+            eval(shard_detail::RENEW_SCRIPT, lease_keys(symbols), {token_, std::to_string(config_.lease_ms)}),
+            symbols.size(), "renew");
+        std::vector<std::string> lost;
+        {
+            std::lock_guard lock(mutex_);
+            for (std::size_t i = 0; i < symbols.size(); ++i) {
+                if (reply.elements[i].integer == 1) {
+                    if (const auto it = held_.find(symbols[i]); it != held_.end()) {
+                        it->second.valid_until_us = lease_deadline(sent);
+                    }
+                } else {
+                    lost.push_back(symbols[i]);
+                }
+            }
+        }
+        stats_.renewals.fetch_add(symbols.size() - lost.size(), std::memory_order_relaxed);
+        lose(lost);
+    }
+
+    // Redis time in ms
+    uint64_t refresh_members() {
+        const RedisReply reply =
+            array_reply(eval(shard_detail::MEMBERS_SCRIPT, {members_key_},
+                             {config_.node_id, std::to_string(config_.lease_ms)}),
+                        2, "members");
+        const RedisReply &list = reply.elements[1];
+        if (reply.elements[0].type != RedisReply::Type::Integer || list.type != RedisReply::Type::Array) {
+            throw std::runtime_error("ShardLeaseManager: unexpected reply to the members script");
+        }
+        std::vector<std::string> members;
+        for (const RedisReply &member : list.elements) {
+            members.push_back(member.text);
+        }
+        // The script sorts members by expiry, the ring by name
+        std::sort(members.begin(), members.end());
+        if (members != ring_.nodes()) {
+            ShardRing ring(std::move(members), config_.vnodes);
+            std::lock_guard lock(mutex_);
+            ring_ = std::move(ring);
+            if (ticks_with_members_++ > 0) {
+                stats_.rebalances.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        return static_cast<uint64_t>(reply.elements[0].integer);
+    }
+
+    std::set<std::string> wanted() const {
+        const std::vector<std::string> owned = ring_.owned(symbols_, config_.node_id);
+        return {owned.begin(), owned.end()};
+    }
+
+    // Report held symbols the ring has moved elsewhere
+    void hand_off() {
+        const std::set<std::string> want = wanted();
+        bool reported = false;
+        {
+            std::lock_guard lock(mutex_);
+            for (auto &[symbol, lease] : held_) {
+                if (!lease.releasing && !want.contains(symbol)) {
+                    lease.releasing = true;
+                    changes_.releasing.push_back(symbol);
+                    reported = true;
+                }
+            }
+        }
+        if (reported) {
+            changed_.notify_all();
+        }
+    }
+
+    void acquire(uint64_t now_ms) {
+        std::vector<std::string> symbols;
+        {
+            std::lock_guard lock(mutex_);
+            for (const std::string &symbol : wanted()) {
+                if (!held_.contains(symbol)) {
+                    symbols.push_back(symbol);
+                }
+            }
+        }
+        if (symbols.empty()) {
+            return;
+        }
+        const uint64_t sent = shard_detail::steady_us();
+        const RedisReply reply = array_reply(
+            eval(shard_detail::ACQUIRE_SCRIPT, lease_keys(symbols), {token_, std::to_string(config_.lease_ms)}),
+            symbols.size(), "acquire");
+        std::size_t taken = 0;
+        {
+            std::lock_guard lock(mutex_);
+            for (std::size_t i = 0; i < symbols.size(); ++i) {
+                const RedisReply &previous = reply.elements[i];
+                if (previous.nil()) {
+                    continue;
+                }
+                held_[symbols[i]] = Lease{lease_deadline(sent), false};
+                ShardAcquired acquired{symbols[i], 0, now_ms};
+                const std::string_view text = previous.text;
+                if (text.starts_with(shard_detail::RELEASED_PREFIX)) {
+                    const std::string_view ms = text.substr(shard_detail::RELEASED_PREFIX.size());
+                    std::from_chars(ms.data(), ms.data() + ms.size(), acquired.released_ms);
+                }
+                changes_.acquired.push_back(std::move(acquired));
+                ++taken;
+            }
+            fence_pending_ = taken > 0;
+        }
+        if (taken > 0) {
+            stats_.acquired.fetch_add(taken, std::memory_order_relaxed);
+            fence_wake_.notify_all();
+            changed_.notify_all();
+        }
+    }
+
+    void release_all() {
+        const std::vector<std::string> symbols = held_symbols();
+        try {
+            if (!symbols.empty()) {
+                eval(shard_detail::RELEASE_SCRIPT, lease_keys(symbols), {token_, std::to_string(config_.lease_ms)});
+                stats_.released.fetch_add(symbols.size(), std::memory_order_relaxed);
+            }
+            transport_({"ZREM", members_key_, config_.node_id});
+        } catch (const std::exception &e) {
+            set_error(e.what());
+        }
+        std::lock_guard lock(mutex_);
+        held_.clear();
+    }
+
+    bool fail(const std::string &error) {
+        stats_.failures.fetch_add(1, std::memory_order_relaxed);
+        set_error(error);
+        connection_.close();
+        std::lock_guard lock(mutex_);
+        fence_locked();
+        return false;
+    }
+
+    std::vector<std::string> held_where(bool releasing) const {
+        std::lock_guard lock(mutex_);
+        std::vector<std::string> out;
+        for (const auto &[symbol, lease] : held_) {
+            if (lease.releasing == releasing) {
+                out.push_back(symbol);
+            }
+        }
+        return out;
+    }
+
+    void set_error(std::string error) {
+        std::lock_guard lock(mutex_);
+        last_error_ = std::move(error);
+    }
+
+    void write_metrics(MetricsWriter &out) const {
+        using Type = MetricType;
+        const MetricLabels labels = {{"shard_node", config_.node_id}, {"shard_leases", metrics_.instance()}};
+        const auto counter = [&](std::string_view family, std::string_view help, const std::atomic<uint64_t> &v) {
+            out.sample(family, Type::Counter, help, labels, v.load(std::memory_order_relaxed));
+        };
+        counter("sbe_shard_rounds_total", "Lease renewal rounds", stats_.ticks);
+        counter("sbe_shard_round_failures_total", "Lease rounds that failed", stats_.failures);
+        counter("sbe_shard_leases_acquired_total", "Symbol leases acquired", stats_.acquired);
+        counter("sbe_shard_leases_released_total", "Symbol leases released after a handoff", stats_.released);
+        counter("sbe_shard_leases_lost_total", "Symbol leases lost without a release", stats_.lost);
+        counter("sbe_shard_rebalances_total", "Changes of the ring's member list", stats_.rebalances);
+        std::size_t held = 0;
+        std::size_t members = 0;
+        {
+            std::lock_guard lock(mutex_);
+            held = held_.size();
+            members = ring_.nodes().size();
+        }
+        out.sample("sbe_shard_leases", Type::Gauge, "Symbol leases held", labels, static_cast<double>(held));
+        out.sample("sbe_shard_members", Type::Gauge, "Live nodes in the ring", labels, static_cast<double>(members));
+    }
+
+    const ShardLeaseConfig config_;
+    // Upper-cased, unique, in configured order
+    std::vector<std::string> symbols_;
+    std::string token_;
+    std::string members_key_;
+    Transport transport_;
+    RedisConnection connection_;
+    ShardLeaseStats stats_;
+    uint64_t ticks_with_members_ = 0;
+
+    // Changed only by the round's thread, under mutex_ so others can read
+    mutable std::mutex mutex_;
+    std::map<std::string, Lease> held_;
+    ShardRing ring_;
+    ShardChanges changes_;
+    std::vector<std::string> pending_release_;
+    std::condition_variable wake_;
+    std::condition_variable changed_;
+    // Wakes the fence thread for new leases or stop()
+    std::condition_variable fence_wake_;
+    bool fence_pending_ = false;
+    // release() asked for a round before the interval is up
+    bool woken_ = false;
+    bool stopping_ = false;
+    std::string last_error_;
+    std::thread thread_;
+    std::thread fence_thread_;
+    MetricsRegistration metrics_;
+};
+
+#endif
@@ -0,0 +1,129 @@
+/*
+ * Process-wide symbol interning: wire symbol -> dense uint16_t SymbolId.
+ *
+ * Every symbol gets the next ID the first time any decoder sees it, and
+ * keeps it for the life of the process, so per-symbol state (order books,
+ * trading rules, cached Python strings) can be a flat array indexed by ID
+ * and decoded batches can carry a symbol_id column next to the fixed-width
+ * symbol codes.
+ *
+ * Lookups are lock-free: an open-addressed table of 32-bit slots, each the
+ * symbol's hash tag plus ID + 1, published with a release store after the
+ * name it points at. Only inserting a new symbol takes the mutex, which
+ * after warm-up is never. Names live in fixed chunks that never move, so a
+ * name_of() view stays valid for the life of the table.
+ */
+
+#ifndef _SBE_SYMBOL_TABLE_H_
+#define _SBE_SYMBOL_TABLE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+using SymbolId = uint16_t;
+constexpr SymbolId INVALID_SYMBOL_ID = UINT16_MAX;
+
+class SymbolTable {
+public:
+    static constexpr std::size_t MAX_SYMBOLS = 1 << 15;
+
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable &) = delete;
+    SymbolTable &operator=(const SymbolTable &) = delete;
+
+    ~SymbolTable() {
+        for (auto &chunk : chunks_) {
+            delete[] chunk.load(std::memory_order_relaxed);
+        }
+    }
+
+    // ID of `symbol`, assigning the next one on first sight. Returns
+    // INVALID_SYMBOL_ID only once MAX_SYMBOLS distinct symbols are taken.
+    SymbolId intern(std::string_view symbol) {
+        const std::size_t hash = hash_of(symbol);
+        if (const SymbolId id = probe(symbol, hash); id != INVALID_SYMBOL_ID) {
+            return id;
+        }
+
+        std::lock_guard insert(insert_);
+        std::size_t slot = hash & SLOT_MASK;
+        for (uint32_t entry; (entry = slots_[slot].load(std::memory_order_acquire)) != 0;
+             slot = (slot + 1) & SLOT_MASK) {
+            if (matches(entry, symbol, hash)) {
+                return entry_id(entry);
+            }
+        }
+        const uint32_t count = size_.load(std::memory_order_relaxed);
+        if (count == MAX_SYMBOLS) {
+            return INVALID_SYMBOL_ID;
+        }
+        const auto id = static_cast<SymbolId>(count);
+        auto &chunk = chunks_[id / CHUNK_SIZE];
+        if (chunk.load(std::memory_order_relaxed) == nullptr) {
+            chunk.store(new std::string[CHUNK_SIZE], std::memory_order_release);
+        }
+        chunk.load(std::memory_order_relaxed)[id % CHUNK_SIZE].assign(symbol);
+        slots_[slot].store(make_entry(id, hash), std::memory_order_release);
+        size_.store(count + 1, std::memory_order_release);
+        return id;
+    }
+
+    // ID of an already interned symbol, or INVALID_SYMBOL_ID; never inserts
+    SymbolId find(std::string_view symbol) const { return probe(symbol, hash_of(symbol)); }
+
+    // Name of an ID returned by intern() or find()
+    std::string_view name_of(SymbolId id) const {
+        return chunks_[id / CHUNK_SIZE].load(std::memory_order_acquire)[id % CHUNK_SIZE];
+    }
+
+    std::size_t size() const { return size_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr std::size_t SLOT_COUNT = MAX_SYMBOLS * 2;
+    static constexpr std::size_t SLOT_MASK = SLOT_COUNT - 1;
+    static constexpr std::size_t CHUNK_SIZE = 256;
+
+    static std::size_t hash_of(std::string_view symbol) { return std::hash<std::string_view>{}(symbol); }
+
+    // Upper 16 bits: hash tag, so most mismatches never touch the name;
+    // lower 16 bits: ID + 1 (0 is an empty slot)
+    static uint32_t make_entry(SymbolId id, std::size_t hash) {
+        return (static_cast<uint32_t>(hash >> 48) << 16) | (static_cast<uint32_t>(id) + 1);
+    }
+
+    static SymbolId entry_id(uint32_t entry) { return static_cast<SymbolId>((entry & 0xffff) - 1); }
+
+    bool matches(uint32_t entry, std::string_view symbol, std::size_t hash) const {
+        return (entry >> 16) == static_cast<uint32_t>(hash >> 48) && name_of(entry_id(entry)) == symbol;
+    }
+
+    SymbolId probe(std::string_view symbol, std::size_t hash) const {
+        for (std::size_t slot = hash & SLOT_MASK;; slot = (slot + 1) & SLOT_MASK) {
+            const uint32_t entry = slots_[slot].load(std::memory_order_acquire);
+            if (entry == 0) {
+                return INVALID_SYMBOL_ID;
+            }
+            if (matches(entry, symbol, hash)) {
+                return entry_id(entry);
+            }
+        }
+    }
+
+    std::array<std::atomic<uint32_t>, SLOT_COUNT> slots_{};
+    std::array<std::atomic<std::string *>, MAX_SYMBOLS / CHUNK_SIZE> chunks_{};
+    std::atomic<uint32_t> size_{0};
+    std::mutex insert_;
+};
+
+// The table every decoder, book and serializer shares
+inline SymbolTable &symbol_table() {
+    static SymbolTable table;
+    return table;
+}
+
+#endif
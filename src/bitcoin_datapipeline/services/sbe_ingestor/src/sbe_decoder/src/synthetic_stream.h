@@ -0,0 +1,488 @@
+/*
+ * Synthetic market-data streams in the SBE stream schema, for load tests.
+ *
+ * Live Binance caps a load test at whatever the market happens to do.
+ * SyntheticStream encodes the four stream templates (trades 10000,
+ * bestBidAsk 10001, partial depth 10002, depth diff 10003) from a seeded
+ * simulation instead, per symbol:
+ *
+ *   - the mid price is a Gaussian random walk in ticks, `volatility` ticks
+ *     per square-root second, and the book is a map of levels on either
+ *     side of it; levels the mid walks through are deleted and the touch
+ *     is quoted again, so the spread stays one tick
+ *   - trade events arrive as a Poisson process at trade_rate per second,
+ *     each one fill at the touch plus a geometric number of sweep fills
+ *     walking into the book, with exponential quantities
+ *   - bestBidAsk updates are Poisson at bba_rate and carry the book's top
+ *   - every depth_interval_ms a diff carries a Poisson(depth_churn) number
+ *     of level changes, clustered near the touch, plus the deletions the
+ *     walk caused; update IDs run without gaps, so a decoder's book stays
+ *     in sync with the simulated one
+ *   - every partial_depth_interval_ms (when set) a depth<N> snapshot
+ *     carries the top partial_depth_levels of each side
+ *
+ * Frames come out in event-time order across symbols and streams, with
+ * event times on the simulation's clock (start_us onwards), so the same
+ * seed replays the same stream. Feed them to the decoder directly, or to
+ * a WebSocket client through StreamLoadServer (stream_load_server.h),
+ * which paces them against the wall clock. Not thread-safe.
+ */
+
+#ifndef _SBE_SYNTHETIC_STREAM_H_
+#define _SBE_SYNTHETIC_STREAM_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <queue>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "spot_sbe/MessageHeader.h"
+#include "spot_stream/BestBidAskStreamEvent.h"
+#include "spot_stream/DepthDiffStreamEvent.h"
+#include "spot_stream/DepthSnapshotStreamEvent.h"
+#include "spot_stream/TradesStreamEvent.h"
+
+struct SyntheticStreamConfig {
+    std::vector<std::string> symbols{"BTCUSDT"};
+    uint64_t seed = 1;
+    // Event time of the stream's start
+    uint64_t start_us = 1'700'000'000'000'000;
+    // Trade events (10000 frames) per second and symbol
+    double trade_rate = 50.0;
+    // Mean extra fills per trade event (geometric); a sweep walks the book
+    double sweep_fills = 0.3;
+    // bestBidAsk frames per second and symbol; 0 turns the stream off
+    double bba_rate = 100.0;
+    // Depth diff cadence; 0 turns the stream off
+    int depth_interval_ms = 100;
+    // Mean level changes per diff
+    double depth_churn = 20.0;
+    // depth<N> snapshot cadence; 0 (the default) turns the stream off
+    int partial_depth_interval_ms = 0;
+    std::size_t partial_depth_levels = 20;
+    // Levels the simulated book keeps per side; the farthest go beyond it
+    std::size_t book_levels = 200;
+    // Opening mid, as a price mantissa
+    int64_t start_price = 6'500'000;
+    // Random-walk standard deviation of the mid in ticks per sqrt(second)
+    double volatility = 50.0;
+    int8_t price_exponent = -2;
+    int8_t qty_exponent = -8;
+    // Mean quantity mantissa of a fill or level
+    int64_t mean_qty = 50'000'000;
+};
+
+struct SyntheticStreamStats {
+    uint64_t trades = 0;
+    uint64_t best_bid_ask = 0;
+    uint64_t depth_diffs = 0;
+    uint64_t partial_depth = 0;
+    uint64_t bytes = 0;
+};
+
+class SyntheticStream {
+public:
+    explicit SyntheticStream(SyntheticStreamConfig config) : config_(std::move(config)), rng_(config_.seed) {
+        if (config_.symbols.empty()) {
+            throw std::invalid_argument("SyntheticStream: at least one symbol is required");
+        }
+        for (const std::string &symbol : config_.symbols) {
+            if (symbol.empty() || symbol.size() > 255) {
+                throw std::invalid_argument("SyntheticStream: symbols must be 1 to 255 characters");
+            }
+        }
+        if (config_.trade_rate < 0 || config_.bba_rate < 0 || config_.depth_churn < 0 || config_.sweep_fills < 0 ||
+            config_.volatility < 0 || config_.depth_interval_ms < 0 || config_.partial_depth_interval_ms < 0) {
+            throw std::invalid_argument("SyntheticStream: rates, intervals and volatility must not be negative");
+        }
+        if (config_.start_price <= static_cast<int64_t>(config_.book_levels) || config_.mean_qty <= 0) {
+            throw std::invalid_argument("SyntheticStream: start_price must exceed book_levels ticks and "
+                                        "mean_qty must be positive");
+        }
+        symbols_.resize(config_.symbols.size());
+        for (uint32_t i = 0; i < symbols_.size(); ++i) {
+            SymbolState &state = symbols_[i];
+            state.mid = static_cast<double>(config_.start_price);
+            state.last_us = config_.start_us;
+            state.update_id = 1'000'000;
+            state.trade_id = 1'000'000;
+            seed_book(state);
+            if (config_.trade_rate > 0) {
+                schedule(i, Kind::Trade, config_.start_us + poisson_gap_us(config_.trade_rate));
+            }
+            if (config_.bba_rate > 0) {
+                schedule(i, Kind::BestBidAsk, config_.start_us + poisson_gap_us(config_.bba_rate));
+            }
+            if (config_.depth_interval_ms > 0) {
+                schedule(i, Kind::DepthDiff, config_.start_us + interval_us(config_.depth_interval_ms));
+            }
+            if (config_.partial_depth_interval_ms > 0) {
+                schedule(i, Kind::PartialDepth, config_.start_us + interval_us(config_.partial_depth_interval_ms));
+            }
+        }
+        if (events_.empty()) {
+            throw std::invalid_argument("SyntheticStream: every stream is turned off");
+        }
+    }
+
+    const SyntheticStreamConfig &config() const { return config_; }
+    const SyntheticStreamStats &stats() const { return stats_; }
+
+    // Event time of the frame next() produces
+    uint64_t next_event_us() const { return events_.top().at_us; }
+
+    // Frames per second of event time, on average, across every stream
+    double rate() const {
+        double per_symbol = config_.trade_rate + config_.bba_rate;
+        if (config_.depth_interval_ms > 0) {
+            per_symbol += 1000.0 / config_.depth_interval_ms;
+        }
+        if (config_.partial_depth_interval_ms > 0) {
+            per_symbol += 1000.0 / config_.partial_depth_interval_ms;
+        }
+        return per_symbol * static_cast<double>(symbols_.size());
+    }
+
+    // Appends the next frame (message header included) to `out` and
+    // returns its event time
+    uint64_t next(std::vector<char> &out) {
+        const Event event = events_.top();
+        events_.pop();
+        SymbolState &state = symbols_[event.symbol];
+        walk(state, event.at_us);
+        const std::size_t start = out.size();
+        switch (event.kind) {
+        case Kind::Trade:
+            encode_trades(state, event, out);
+            ++stats_.trades;
+            schedule(event.symbol, Kind::Trade, event.at_us + poisson_gap_us(config_.trade_rate));
+            break;
+        case Kind::BestBidAsk:
+            encode_best_bid_ask(state, event, out);
+            ++stats_.best_bid_ask;
+            schedule(event.symbol, Kind::BestBidAsk, event.at_us + poisson_gap_us(config_.bba_rate));
+            break;
+        case Kind::DepthDiff:
+            encode_depth_diff(state, event, out);
+            ++stats_.depth_diffs;
+            schedule(event.symbol, Kind::DepthDiff, event.at_us + interval_us(config_.depth_interval_ms));
+            break;
+        case Kind::PartialDepth:
+            encode_partial_depth(state, event, out);
+            ++stats_.partial_depth;
+            schedule(event.symbol, Kind::PartialDepth, event.at_us + interval_us(config_.partial_depth_interval_ms));
+            break;
+        }
+        stats_.bytes += out.size() - start;
+        return event.at_us;
+    }
+
+private:
+    enum class Kind : uint8_t { Trade, BestBidAsk, DepthDiff, PartialDepth };
+
+    struct Event {
+        uint64_t at_us = 0;
+        uint32_t symbol = 0;
+        Kind kind = Kind::Trade;
+
+        // Earliest first; ties in a fixed order so a seed always replays alike
+        bool operator>(const Event &other) const {
+            if (at_us != other.at_us) {
+                return at_us > other.at_us;
+            }
+            if (symbol != other.symbol) {
+                return symbol > other.symbol;
+            }
+            return kind > other.kind;
+        }
+    };
+
+    struct LevelChange {
+        int64_t before = 0;
+        int64_t after = 0;
+    };
+
+    struct SymbolState {
+        // Exact mid in ticks; levels sit on whole ticks around it
+        double mid = 0;
+        uint64_t last_us = 0;
+        uint64_t update_id = 0;
+        uint64_t trade_id = 0;
+        std::map<int64_t, int64_t, std::greater<>> bids;
+        std::map<int64_t, int64_t> asks;
+        // Levels changed since the last diff, by price; a quantity of 0 is
+        // no level. Until a diff publishes them, snapshots show `before`.
+        std::map<int64_t, LevelChange> bid_changes;
+        std::map<int64_t, LevelChange> ask_changes;
+    };
+
+    // Little-endian field writes into a frame being built at the end of `out`
+    class FrameWriter {
+    public:
+        FrameWriter(std::vector<char> &out, uint16_t template_id, uint16_t block_length)
+            : out_(out), start_(out.size()) {
+            out_.resize(start_ + spot_sbe::MessageHeader::encodedLength() + block_length);
+            put<uint16_t>(0, block_length);
+            put<uint16_t>(2, template_id);
+            put<uint16_t>(4, spot_stream::SBE_SCHEMA_ID);
+            put<uint16_t>(6, spot_stream::SBE_SCHEMA_VERSION);
+        }
+
+        // A root block field at `offset`
+        template <typename T>
+        void field(std::size_t offset, T value) {
+            put<T>(spot_sbe::MessageHeader::encodedLength() + offset, value);
+        }
+
+        template <typename T>
+        void append(T value) {
+            const std::size_t at = out_.size() - start_;
+            out_.resize(out_.size() + sizeof(T));
+            put<T>(at, value);
+        }
+
+        void append_symbol(const std::string &symbol) {
+            append<uint8_t>(static_cast<uint8_t>(symbol.size()));
+            out_.insert(out_.end(), symbol.begin(), symbol.end());
+        }
+
+    private:
+        template <typename T>
+        void put(std::size_t at, T value) {
+            std::memcpy(out_.data() + start_ + at, &value, sizeof(T));
+        }
+
+        std::vector<char> &out_;
+        const std::size_t start_;
+    };
+
+    static uint64_t interval_us(int ms) { return static_cast<uint64_t>(ms) * 1000; }
+
+    void schedule(uint32_t symbol, Kind kind, uint64_t at_us) { events_.push(Event{at_us, symbol, kind}); }
+
+    uint64_t poisson_gap_us(double rate) {
+        return 1 + static_cast<uint64_t>(std::exponential_distribution<double>(rate)(rng_) * 1e6);
+    }
+
+    int64_t random_qty() {
+        return 1 + static_cast<int64_t>(
+                       std::exponential_distribution<double>(1.0 / static_cast<double>(config_.mean_qty))(rng_));
+    }
+
+    // Ticks from the touch for a changed level: mostly close, occasionally deep
+    int64_t level_distance() {
+        const double mean = std::max(1.0, static_cast<double>(config_.book_levels) / 8.0);
+        return std::min<int64_t>(static_cast<int64_t>(config_.book_levels) - 1,
+                                 std::geometric_distribution<int64_t>(1.0 / mean)(rng_));
+    }
+
+    int64_t best_bid(const SymbolState &state) const {
+        return state.bids.empty() ? static_cast<int64_t>(std::floor(state.mid)) - 1 : state.bids.begin()->first;
+    }
+
+    int64_t best_ask(const SymbolState &state) const {
+        return state.asks.empty() ? static_cast<int64_t>(std::floor(state.mid)) + 2 : state.asks.begin()->first;
+    }
+
+    void seed_book(SymbolState &state) {
+        const auto mid = static_cast<int64_t>(state.mid);
+        for (std::size_t i = 0; i < config_.book_levels; ++i) {
+            state.bids[mid - 1 - static_cast<int64_t>(i)] = random_qty();
+            state.asks[mid + 1 + static_cast<int64_t>(i)] = random_qty();
+        }
+    }
+
+    template <typename Side>
+    static void set_level(Side &side, std::map<int64_t, LevelChange> &changes, int64_t price, int64_t qty) {
+        const auto it = side.find(price);
+        const int64_t before = it != side.end() ? it->second : 0;
+        if (before == qty) {
+            return;
+        }
+        if (qty == 0) {
+            side.erase(it);
+        } else {
+            side[price] = qty;
+        }
+        // The first change since the last diff keeps the published quantity
+        changes.try_emplace(price, LevelChange{before, 0}).first->second.after = qty;
+    }
+
+    // The side as the last diff left it: the live levels with unpublished
+    // changes undone
+    template <typename Side>
+    static Side published(const Side &side, const std::map<int64_t, LevelChange> &changes) {
+        Side levels = side;
+        for (const auto &[price, change] : changes) {
+            if (change.before == 0) {
+                levels.erase(price);
+            } else {
+                levels[price] = change.before;
+            }
+        }
+        return levels;
+    }
+
+    // A side's unpublished changes as levels, best first; changes that
+    // cancelled out are left out
+    template <typename Levels>
+    static Levels changed_levels(const std::map<int64_t, LevelChange> &changes) {
+        Levels levels;
+        for (const auto &[price, change] : changes) {
+            if (change.before != change.after) {
+                levels.emplace(price, change.after);
+            }
+        }
+        return levels;
+    }
+
+    // Moves the mid to `now_us`, deletes the levels it crossed and quotes
+    // the touch again, as market makers would: the spread stays one tick
+    void walk(SymbolState &state, uint64_t now_us) {
+        if (now_us > state.last_us && config_.volatility > 0) {
+            const double seconds = static_cast<double>(now_us - state.last_us) / 1e6;
+            state.mid += std::normal_distribution<double>(0.0, config_.volatility * std::sqrt(seconds))(rng_);
+            state.mid = std::max(state.mid, static_cast<double>(config_.book_levels) + 2.0);
+        }
+        state.last_us = std::max(state.last_us, now_us);
+        const auto mid = static_cast<int64_t>(std::floor(state.mid));
+        while (!state.bids.empty() && state.bids.begin()->first > mid) {
+            set_level(state.bids, state.bid_changes, state.bids.begin()->first, 0);
+        }
+        while (!state.asks.empty() && state.asks.begin()->first <= mid) {
+            set_level(state.asks, state.ask_changes, state.asks.begin()->first, 0);
+        }
+        if (state.bids.empty() || state.bids.begin()->first < mid) {
+            set_level(state.bids, state.bid_changes, mid, random_qty());
+        }
+        if (state.asks.empty() || state.asks.begin()->first > mid + 1) {
+            set_level(state.asks, state.ask_changes, mid + 1, random_qty());
+        }
+    }
+
+    // One level change near the touch of a random side, then the far end
+    // trimmed back to book_levels
+    void churn(SymbolState &state) {
+        const auto mid = static_cast<int64_t>(std::floor(state.mid));
+        const int64_t distance = level_distance();
+        const bool delete_level = std::bernoulli_distribution(0.25)(rng_);
+        if (std::bernoulli_distribution(0.5)(rng_)) {
+            set_level(state.bids, state.bid_changes, mid - distance, delete_level ? 0 : random_qty());
+            while (state.bids.size() > config_.book_levels) {
+                set_level(state.bids, state.bid_changes, std::prev(state.bids.end())->first, 0);
+            }
+        } else {
+            set_level(state.asks, state.ask_changes, mid + 1 + distance, delete_level ? 0 : random_qty());
+            while (state.asks.size() > config_.book_levels) {
+                set_level(state.asks, state.ask_changes, std::prev(state.asks.end())->first, 0);
+            }
+        }
+    }
+
+    void encode_trades(SymbolState &state, const Event &event, std::vector<char> &out) {
+        using spot_stream::TradesStreamEvent;
+        const auto fills = 1 + static_cast<uint32_t>(std::min<int64_t>(
+                                   std::geometric_distribution<int64_t>(1.0 / (1.0 + config_.sweep_fills))(rng_), 64));
+        // A buyer taking the asks when the buyer is not the maker
+        const bool buyer_maker = std::bernoulli_distribution(0.5)(rng_);
+        FrameWriter frame(out, TradesStreamEvent::SBE_TEMPLATE_ID, TradesStreamEvent::SBE_BLOCK_LENGTH);
+        frame.field<int64_t>(TradesStreamEvent::EVENT_TIME_OFFSET, static_cast<int64_t>(event.at_us));
+        frame.field<int64_t>(TradesStreamEvent::TRANSACT_TIME_OFFSET, static_cast<int64_t>(event.at_us) - 150);
+        frame.field<int8_t>(TradesStreamEvent::PRICE_EXPONENT_OFFSET, config_.price_exponent);
+        frame.field<int8_t>(TradesStreamEvent::QTY_EXPONENT_OFFSET, config_.qty_exponent);
+        frame.append<uint16_t>(TradesStreamEvent::Trade::SBE_BLOCK_LENGTH);
+        frame.append<uint32_t>(fills);
+        const int64_t touch = buyer_maker ? best_bid(state) : best_ask(state);
+        for (uint32_t i = 0; i < fills; ++i) {
+            frame.append<int64_t>(static_cast<int64_t>(++state.trade_id));
+            frame.append<int64_t>(buyer_maker ? touch - i : touch + i);
+            frame.append<int64_t>(random_qty());
+            frame.append<uint8_t>(buyer_maker ? 1 : 0);
+        }
+        frame.append_symbol(config_.symbols[event.symbol]);
+    }
+
+    void encode_best_bid_ask(SymbolState &state, const Event &event, std::vector<char> &out) {
+        using spot_stream::BestBidAskStreamEvent;
+        const auto qty_at = [&](const auto &side, int64_t price) {
+            const auto it = side.find(price);
+            return it != side.end() ? it->second : random_qty();
+        };
+        const int64_t bid = best_bid(state);
+        const int64_t ask = best_ask(state);
+        FrameWriter frame(out, BestBidAskStreamEvent::SBE_TEMPLATE_ID, BestBidAskStreamEvent::SBE_BLOCK_LENGTH);
+        frame.field<int64_t>(BestBidAskStreamEvent::EVENT_TIME_OFFSET, static_cast<int64_t>(event.at_us));
+        frame.field<int64_t>(BestBidAskStreamEvent::BOOK_UPDATE_ID_OFFSET, static_cast<int64_t>(state.update_id));
+        frame.field<int8_t>(BestBidAskStreamEvent::PRICE_EXPONENT_OFFSET, config_.price_exponent);
+        frame.field<int8_t>(BestBidAskStreamEvent::QTY_EXPONENT_OFFSET, config_.qty_exponent);
+        frame.field<int64_t>(BestBidAskStreamEvent::BID_PRICE_OFFSET, bid);
+        frame.field<int64_t>(BestBidAskStreamEvent::BID_QTY_OFFSET, qty_at(state.bids, bid));
+        frame.field<int64_t>(BestBidAskStreamEvent::ASK_PRICE_OFFSET, ask);
+        frame.field<int64_t>(BestBidAskStreamEvent::ASK_QTY_OFFSET, qty_at(state.asks, ask));
+        frame.append_symbol(config_.symbols[event.symbol]);
+    }
+
+    template <typename Levels>
+    static void append_levels(FrameWriter &frame, const Levels &levels, std::size_t limit) {
+        const auto count = static_cast<uint16_t>(std::min<std::size_t>({levels.size(), limit, UINT16_MAX}));
+        frame.append<uint16_t>(spot_stream::PriceLevel::SBE_BLOCK_LENGTH);
+        frame.append<uint16_t>(count);
+        auto it = levels.begin();
+        for (uint16_t i = 0; i < count; ++i, ++it) {
+            frame.append<int64_t>(it->first);
+            frame.append<int64_t>(it->second);
+        }
+    }
+
+    void encode_depth_diff(SymbolState &state, const Event &event, std::vector<char> &out) {
+        using spot_stream::DepthDiffStreamEvent;
+        std::poisson_distribution<int> changes(config_.depth_churn);
+        for (int i = std::max(1, changes(rng_)); i > 0; --i) {
+            churn(state);
+        }
+        const auto bids = changed_levels<std::map<int64_t, int64_t, std::greater<>>>(state.bid_changes);
+        const auto asks = changed_levels<std::map<int64_t, int64_t>>(state.ask_changes);
+        const uint64_t first_id = state.update_id + 1;
+        // One update ID per changed level, as the exchange numbers them
+        state.update_id += std::max<std::size_t>(1, bids.size() + asks.size());
+        FrameWriter frame(out, DepthDiffStreamEvent::SBE_TEMPLATE_ID, DepthDiffStreamEvent::SBE_BLOCK_LENGTH);
+        frame.field<int64_t>(DepthDiffStreamEvent::EVENT_TIME_OFFSET, static_cast<int64_t>(event.at_us));
+        frame.field<int64_t>(DepthDiffStreamEvent::FIRST_BOOK_UPDATE_ID_OFFSET, static_cast<int64_t>(first_id));
+        frame.field<int64_t>(DepthDiffStreamEvent::LAST_BOOK_UPDATE_ID_OFFSET, static_cast<int64_t>(state.update_id));
+        frame.field<int8_t>(DepthDiffStreamEvent::PRICE_EXPONENT_OFFSET, config_.price_exponent);
+        frame.field<int8_t>(DepthDiffStreamEvent::QTY_EXPONENT_OFFSET, config_.qty_exponent);
+        append_levels(frame, bids, UINT16_MAX);
+        append_levels(frame, asks, UINT16_MAX);
+        frame.append_symbol(config_.symbols[event.symbol]);
+        state.bid_changes.clear();
+        state.ask_changes.clear();
+    }
+
+    void encode_partial_depth(SymbolState &state, const Event &event, std::vector<char> &out) {
+        using spot_stream::DepthSnapshotStreamEvent;
+        FrameWriter frame(out, DepthSnapshotStreamEvent::SBE_TEMPLATE_ID, DepthSnapshotStreamEvent::SBE_BLOCK_LENGTH);
+        frame.field<int64_t>(DepthSnapshotStreamEvent::EVENT_TIME_OFFSET, static_cast<int64_t>(event.at_us));
+        frame.field<int64_t>(DepthSnapshotStreamEvent::BOOK_UPDATE_ID_OFFSET, static_cast<int64_t>(state.update_id));
+        frame.field<int8_t>(DepthSnapshotStreamEvent::PRICE_EXPONENT_OFFSET, config_.price_exponent);
+        frame.field<int8_t>(DepthSnapshotStreamEvent::QTY_EXPONENT_OFFSET, config_.qty_exponent);
+        // As of book_update_id: the changes since the last diff belong to the next one
+        append_levels(frame, published(state.bids, state.bid_changes), config_.partial_depth_levels);
+        append_levels(frame, published(state.asks, state.ask_changes), config_.partial_depth_levels);
+        frame.append_symbol(config_.symbols[event.symbol]);
+    }
+
+    SyntheticStreamConfig config_;
+    std::mt19937_64 rng_;
+    std::vector<SymbolState> symbols_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<>> events_;
+    SyntheticStreamStats stats_;
+};
+
+#endif
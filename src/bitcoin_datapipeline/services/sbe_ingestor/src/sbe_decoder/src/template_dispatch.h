@@ -0,0 +1,76 @@
+/*
+ * Template-ID dispatch table.
+ *
+ * Binance template IDs fall in two dense ranges: REST / WebSocket API
+ * responses (below 512) and market-data stream events (10000 and up). The
+ * table folds both ranges into one small array, so a lookup is a range
+ * check plus an index rather than a branch per template. Tables are built
+ * by constexpr functions and add() plugs further templates in at startup.
+ */
+
+#ifndef _SBE_TEMPLATE_DISPATCH_H_
+#define _SBE_TEMPLATE_DISPATCH_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+template <typename Entry>
+class TemplateTable {
+public:
+    static constexpr uint16_t RESPONSE_RANGE = 512;
+    static constexpr uint16_t STREAM_BASE = 10000;
+    static constexpr uint16_t STREAM_RANGE = 64;
+    static constexpr std::size_t SLOT_COUNT = RESPONSE_RANGE + STREAM_RANGE;
+    static constexpr std::size_t NO_SLOT = SLOT_COUNT;
+
+    static constexpr std::size_t slot(uint16_t template_id) {
+        if (template_id < RESPONSE_RANGE) {
+            return template_id;
+        }
+        if (template_id >= STREAM_BASE && template_id - STREAM_BASE < STREAM_RANGE) {
+            return RESPONSE_RANGE + (template_id - STREAM_BASE);
+        }
+        return NO_SLOT;
+    }
+
+    static constexpr uint16_t template_at(std::size_t index) {
+        return index < RESPONSE_RANGE ? static_cast<uint16_t>(index)
+                                      : static_cast<uint16_t>(STREAM_BASE + (index - RESPONSE_RANGE));
+    }
+
+    // Register (or replace) the entry for `template_id`. Returns false for
+    // IDs outside both ranges.
+    constexpr bool add(uint16_t template_id, const Entry &entry) {
+        const std::size_t index = slot(template_id);
+        if (index == NO_SLOT) {
+            return false;
+        }
+        entries_[index] = entry;
+        present_[index] = true;
+        return true;
+    }
+
+    constexpr const Entry *find(uint16_t template_id) const {
+        const std::size_t index = slot(template_id);
+        if (index == NO_SLOT || !present_[index]) {
+            return nullptr;
+        }
+        return &entries_[index];
+    }
+
+    template <typename Fn>
+    void for_each(Fn &&fn) const {
+        for (std::size_t i = 0; i < SLOT_COUNT; ++i) {
+            if (present_[i]) {
+                fn(template_at(i), entries_[i]);
+            }
+        }
+    }
+
+private:
+    std::array<Entry, SLOT_COUNT> entries_{};
+    std::array<bool, SLOT_COUNT> present_{};
+};
+
+#endif
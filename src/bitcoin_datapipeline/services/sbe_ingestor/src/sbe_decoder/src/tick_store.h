@@ -0,0 +1,1049 @@
+/*
+ * Columnar on-disk tick store for training data.
+ *
+ * Training data otherwise goes S3 JSON -> data_connector -> Postgres, one
+ * row insert and one SQL row at a time. The tick store keeps decoded ticks
+ * in append-only files instead, one per stream, symbol and UTC day:
+ *
+ *   {root}/{stream}/{symbol}/{YYYY-MM-DD}.tick
+ *
+ * with a row per trade (trades), per quote (bba), per level of a depth
+ * diff (depth) and per level of a partial depth snapshot (book). Columns
+ * are fixed per stream (tick_columns()).
+ *
+ * A file is a 64-byte TickFileHeader and then blocks of up to block_rows
+ * rows. A block is a 64-byte TickBlockHeader (row count, whole block size,
+ * min/max event time and min/max update or trade ID), a 16-byte chunk
+ * descriptor per column (codec, stored size), and the column chunks one
+ * after another, each 8-byte aligned:
+ *
+ *   RAW         the values as a little-endian array
+ *   ZSTD        a zstd frame of that array
+ *   DELTA_ZSTD  int64 columns: first value, then differences, as a zstd
+ *               frame; timestamps and IDs shrink to a few bits per row
+ *
+ * A chunk that does not shrink is stored RAW, and compression "none"
+ * stores every chunk RAW, so a reader can hand out views of the mapped
+ * file without copying. Each block is written with one write() once full
+ * (or on flush/close); a block cut short by a crash fails its size check,
+ * readers stop before it and a writer reopening the file truncates it.
+ *
+ * Next to each file, {file}.idx is its sparse block index (sparse_index.h):
+ * the writer appends a block's entry right after the block, and rewrites
+ * the index whole when it reopens a file. Range reads binary-search it and
+ * decode only the blocks whose event times or IDs overlap the range.
+ *
+ * TickStoreWriter routes SBE stream messages (live frames or capture
+ * journal records) to the right file by symbol and event-time day; it is
+ * single-threaded. TickFileReader maps one file read-only; it is not
+ * thread-safe either (one zstd context), but separate readers of a file
+ * are independent.
+ */
+
+#ifndef _SBE_TICK_STORE_H_
+#define _SBE_TICK_STORE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <zstd.h>
+
+#include "capture_journal.h"
+#include "ingest_clock.h"
+#include "journal_replay.h"
+#include "message_walk.h"
+#include "record_codec.h"
+#include "sparse_index.h"
+#include "spot_sbe/MessageHeader.h"
+#include "stream_decode.h"
+
+static_assert(std::endian::native == std::endian::little, "tick files are written in host byte order");
+
+constexpr char TICK_FILE_MAGIC[8] = {'B', 'T', 'C', 'T', 'I', 'C', 'K', '1'};
+constexpr uint32_t TICK_FILE_VERSION = 1;
+constexpr uint32_t TICK_BLOCK_MAGIC = 0x4B4C4254; // "TBLK"
+constexpr std::size_t TICK_CHUNK_ALIGN = 8;
+constexpr std::size_t TICK_DEFAULT_BLOCK_ROWS = 65536;
+constexpr int64_t TICK_US_PER_DAY = 86'400'000'000;
+
+enum class TickStream : uint8_t { Trades = 0, BestBidAsk = 1, Depth = 2, Book = 3 };
+
+enum class TickColumnType : uint8_t { Int64 = 0, Float64 = 1, UInt8 = 2, Bool = 3 };
+
+enum class TickCodec : uint8_t { Raw = 0, Zstd = 1, DeltaZstd = 2 };
+
+struct TickColumnSpec {
+    const char *name;
+    TickColumnType type;
+};
+
+struct TickFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint8_t stream;
+    uint8_t columns;
+    uint16_t reserved;
+    // UTC day of the file's rows, in days since the epoch
+    int32_t day;
+    char symbol[16];
+    uint64_t created_us;
+    char padding[16];
+};
+static_assert(sizeof(TickFileHeader) == 64);
+
+struct TickBlockHeader {
+    uint32_t magic;
+    uint32_t rows;
+    // Whole block: this header, descriptors and chunks, padding included
+    uint64_t size;
+    int64_t min_ts_us;
+    int64_t max_ts_us;
+    int64_t min_id;
+    int64_t max_id;
+    uint32_t columns;
+    uint32_t reserved;
+    uint64_t reserved2;
+};
+static_assert(sizeof(TickBlockHeader) == 64);
+
+struct TickChunkDescriptor {
+    uint8_t codec;
+    uint8_t reserved[7];
+    uint64_t stored_size;
+};
+static_assert(sizeof(TickChunkDescriptor) == 16);
+
+// Every stream's first column is event_time_us and its ID column (the
+// block's min/max_id) is update_id or trade_id
+constexpr TickColumnSpec TICK_TRADE_COLUMNS[] = {
+    {"event_time_us", TickColumnType::Int64}, {"ingest_ts_us", TickColumnType::Int64},
+    {"trade_id", TickColumnType::Int64},      {"price", TickColumnType::Float64},
+    {"qty", TickColumnType::Float64},         {"is_buyer_maker", TickColumnType::Bool},
+};
+constexpr TickColumnSpec TICK_BBA_COLUMNS[] = {
+    {"event_time_us", TickColumnType::Int64}, {"ingest_ts_us", TickColumnType::Int64},
+    {"update_id", TickColumnType::Int64},     {"bid_price", TickColumnType::Float64},
+    {"bid_qty", TickColumnType::Float64},     {"ask_price", TickColumnType::Float64},
+    {"ask_qty", TickColumnType::Float64},
+};
+// side: 0 bid, 1 ask
+constexpr TickColumnSpec TICK_DEPTH_COLUMNS[] = {
+    {"event_time_us", TickColumnType::Int64},   {"ingest_ts_us", TickColumnType::Int64},
+    {"first_update_id", TickColumnType::Int64}, {"update_id", TickColumnType::Int64},
+    {"side", TickColumnType::UInt8},            {"price", TickColumnType::Float64},
+    {"qty", TickColumnType::Float64},
+};
+constexpr TickColumnSpec TICK_BOOK_COLUMNS[] = {
+    {"event_time_us", TickColumnType::Int64}, {"ingest_ts_us", TickColumnType::Int64},
+    {"update_id", TickColumnType::Int64},     {"side", TickColumnType::UInt8},
+    {"price", TickColumnType::Float64},       {"qty", TickColumnType::Float64},
+};
+
+inline std::span<const TickColumnSpec> tick_columns(TickStream stream) {
+    switch (stream) {
+    case TickStream::Trades:
+        return TICK_TRADE_COLUMNS;
+    case TickStream::BestBidAsk:
+        return TICK_BBA_COLUMNS;
+    case TickStream::Depth:
+        return TICK_DEPTH_COLUMNS;
+    case TickStream::Book:
+        return TICK_BOOK_COLUMNS;
+    }
+    throw std::invalid_argument("unknown tick stream");
+}
+
+inline std::size_t tick_id_column(TickStream stream) { return stream == TickStream::Depth ? 3 : 2; }
+
+inline const char *tick_stream_name(TickStream stream) {
+    switch (stream) {
+    case TickStream::Trades:
+        return "trades";
+    case TickStream::BestBidAsk:
+        return "bba";
+    case TickStream::Depth:
+        return "depth";
+    case TickStream::Book:
+        return "book";
+    }
+    return "unknown";
+}
+
+inline std::size_t tick_column_width(TickColumnType type) {
+    return type == TickColumnType::Int64 || type == TickColumnType::Float64 ? 8 : 1;
+}
+
+inline int32_t tick_day(int64_t event_time_us) {
+    // Floor, for times before the epoch
+    const int64_t day = event_time_us / TICK_US_PER_DAY - (event_time_us % TICK_US_PER_DAY < 0 ? 1 : 0);
+    return static_cast<int32_t>(day);
+}
+
+// "YYYY-MM-DD" of a day since the epoch
+inline std::string tick_day_name(int32_t day) {
+    const std::time_t seconds = static_cast<std::time_t>(day) * 86400;
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    char buf[16];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d", &utc);
+    return buf;
+}
+
+// Days since the epoch of a "YYYY-MM-DD" name
+inline int32_t tick_day_parse(const std::string &name) {
+    std::tm utc{};
+    const char *end = strptime(name.c_str(), "%Y-%m-%d", &utc);
+    if (end == nullptr || *end != '\0') {
+        throw std::invalid_argument("not a YYYY-MM-DD day: " + name);
+    }
+    return tick_day(static_cast<int64_t>(timegm(&utc)) * 1'000'000);
+}
+
+inline std::string tick_file_path(const std::string &root, TickStream stream, std::string_view symbol, int32_t day) {
+    return root + "/" + tick_stream_name(stream) + "/" + std::string(symbol) + "/" + tick_day_name(day) + ".tick";
+}
+
+inline std::size_t tick_align(std::size_t size) { return (size + TICK_CHUNK_ALIGN - 1) & ~(TICK_CHUNK_ALIGN - 1); }
+
+struct TickStoreConfig {
+    std::string root;
+    std::size_t block_rows = TICK_DEFAULT_BLOCK_ROWS;
+    // false stores every chunk RAW, for zero-copy reads
+    bool compress = true;
+    int level = 3;
+};
+
+struct TickStoreStats {
+    uint64_t messages = 0;
+    uint64_t rows = 0;
+    uint64_t blocks = 0;
+    uint64_t bytes_written = 0;
+    // Messages of other templates, or that did not parse
+    uint64_t skipped = 0;
+    uint64_t files_opened = 0;
+    // Partial blocks a crash left at the end of a reopened file
+    uint64_t truncated_blocks = 0;
+};
+
+// Walk the complete blocks of a mapped tick file from `offset`; fn(offset,
+// header) sees each one. Returns the end of the last complete block.
+template <typename Fn>
+std::size_t walk_tick_blocks(const char *base, std::size_t size, std::size_t offset, std::size_t columns, Fn &&fn) {
+    while (offset + sizeof(TickBlockHeader) <= size) {
+        TickBlockHeader header;
+        std::memcpy(&header, base + offset, sizeof(header));
+        const std::size_t minimum = sizeof(TickBlockHeader) + columns * sizeof(TickChunkDescriptor);
+        if (header.magic != TICK_BLOCK_MAGIC || header.columns != columns || header.size < minimum ||
+            header.size > size - offset) {
+            break;
+        }
+        fn(offset, header);
+        offset += header.size;
+    }
+    return offset;
+}
+
+inline SparseIndexEntry tick_index_entry(std::size_t offset, const TickBlockHeader &header) {
+    return {offset, header.size, header.rows, header.min_ts_us, header.max_ts_us, header.min_id, header.max_id};
+}
+
+namespace tick_store_detail {
+
+inline void write_all(int fd, const char *data, std::size_t size, const std::string &path) {
+    while (size > 0) {
+        const ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(journal_errno_message("cannot write tick file", path));
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+}
+
+inline int64_t load_i64(const std::vector<char> &column, std::size_t row) {
+    int64_t value;
+    std::memcpy(&value, column.data() + row * sizeof(value), sizeof(value));
+    return value;
+}
+
+} // namespace tick_store_detail
+
+// One open tick file being appended to
+class TickFileWriter {
+public:
+    TickFileWriter(const std::string &path, TickStream stream, std::string_view symbol, int32_t day,
+                   const TickStoreConfig &config, ZSTD_CCtx *zstd, TickStoreStats &stats)
+        : path_(path), stream_(stream), specs_(tick_columns(stream)), config_(config), zstd_(zstd), stats_(stats),
+          columns_(specs_.size()) {
+        if (symbol.size() > sizeof(TickFileHeader::symbol)) {
+            throw std::invalid_argument("tick store: symbol longer than 16 bytes: " + std::string(symbol));
+        }
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error(journal_errno_message("cannot open tick file", path));
+        }
+        try {
+            resume_or_create(symbol, day);
+        } catch (...) {
+            close_files();
+            throw;
+        }
+        stats_.files_opened++;
+    }
+
+    ~TickFileWriter() {
+        try {
+            flush();
+        } catch (const std::exception &) {
+            // Already reported by an explicit flush/close when it matters
+        }
+        close_files();
+    }
+
+    TickFileWriter(const TickFileWriter &) = delete;
+    TickFileWriter &operator=(const TickFileWriter &) = delete;
+
+    template <typename T>
+    void put(std::size_t column, T value) {
+        std::vector<char> &out = columns_[column];
+        const std::size_t at = out.size();
+        out.resize(at + sizeof(T));
+        std::memcpy(out.data() + at, &value, sizeof(T));
+    }
+
+    // Count the row just put, writing the block once it is full
+    void end_row() {
+        ++rows_;
+        stats_.rows++;
+        if (rows_ >= config_.block_rows) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (rows_ == 0) {
+            return;
+        }
+        const std::size_t columns = specs_.size();
+        block_.assign(sizeof(TickBlockHeader) + columns * sizeof(TickChunkDescriptor), '\0');
+        for (std::size_t c = 0; c < columns; ++c) {
+            block_.resize(tick_align(block_.size()));
+            const TickChunkDescriptor descriptor = append_chunk(specs_[c].type, columns_[c]);
+            std::memcpy(block_.data() + sizeof(TickBlockHeader) + c * sizeof(TickChunkDescriptor), &descriptor,
+                        sizeof(descriptor));
+        }
+        block_.resize(tick_align(block_.size()));
+
+        TickBlockHeader header{};
+        header.magic = TICK_BLOCK_MAGIC;
+        header.rows = static_cast<uint32_t>(rows_);
+        header.size = block_.size();
+        header.columns = static_cast<uint32_t>(columns);
+        header.min_ts_us = header.min_id = std::numeric_limits<int64_t>::max();
+        header.max_ts_us = header.max_id = std::numeric_limits<int64_t>::min();
+        const std::vector<char> &ts = columns_[0];
+        const std::vector<char> &ids = columns_[tick_id_column(stream_)];
+        for (std::size_t r = 0; r < rows_; ++r) {
+            header.min_ts_us = std::min(header.min_ts_us, tick_store_detail::load_i64(ts, r));
+            header.max_ts_us = std::max(header.max_ts_us, tick_store_detail::load_i64(ts, r));
+            header.min_id = std::min(header.min_id, tick_store_detail::load_i64(ids, r));
+            header.max_id = std::max(header.max_id, tick_store_detail::load_i64(ids, r));
+        }
+        std::memcpy(block_.data(), &header, sizeof(header));
+
+        tick_store_detail::write_all(fd_, block_.data(), block_.size(), path_);
+        const SparseIndexEntry entry = tick_index_entry(offset_, header);
+        tick_store_detail::write_all(index_fd_, reinterpret_cast<const char *>(&entry), sizeof(entry),
+                                     sparse_index_path(path_));
+        offset_ += block_.size();
+        stats_.blocks++;
+        stats_.bytes_written += block_.size();
+        for (std::vector<char> &column : columns_) {
+            column.clear();
+        }
+        rows_ = 0;
+    }
+
+    int32_t day() const { return day_; }
+    const std::string &path() const { return path_; }
+
+private:
+    // Validate an existing file and drop a partial last block, or write the
+    // header of a new one; either way the index is rewritten to match
+    void resume_or_create(std::string_view symbol, int32_t day) {
+        std::vector<SparseIndexEntry> entries;
+        resume_or_create_data(symbol, day, entries);
+        const std::string index_path = sparse_index_path(path_);
+        write_sparse_index(index_path, entries);
+        index_fd_ = ::open(index_path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (index_fd_ < 0) {
+            throw std::runtime_error(journal_errno_message("cannot open tick index", index_path));
+        }
+    }
+
+    void resume_or_create_data(std::string_view symbol, int32_t day, std::vector<SparseIndexEntry> &entries) {
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0) {
+            throw std::runtime_error(journal_errno_message("cannot stat tick file", path_));
+        }
+        day_ = day;
+        const auto size = static_cast<std::size_t>(st.st_size);
+        if (size == 0) {
+            TickFileHeader header{};
+            std::memcpy(header.magic, TICK_FILE_MAGIC, sizeof(TICK_FILE_MAGIC));
+            header.version = TICK_FILE_VERSION;
+            header.header_size = sizeof(TickFileHeader);
+            header.stream = static_cast<uint8_t>(stream_);
+            header.columns = static_cast<uint8_t>(specs_.size());
+            header.day = day;
+            std::memcpy(header.symbol, symbol.data(), symbol.size());
+            header.created_us = ingest_time_us();
+            tick_store_detail::write_all(fd_, reinterpret_cast<const char *>(&header), sizeof(header), path_);
+            stats_.bytes_written += sizeof(header);
+            offset_ = sizeof(header);
+            return;
+        }
+        std::vector<char> data(size);
+        if (::pread(fd_, data.data(), size, 0) != static_cast<ssize_t>(size)) {
+            throw std::runtime_error(journal_errno_message("cannot read tick file", path_));
+        }
+        TickFileHeader header;
+        if (size < sizeof(header)) {
+            throw std::runtime_error("not a tick file: " + path_);
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (std::memcmp(header.magic, TICK_FILE_MAGIC, sizeof(TICK_FILE_MAGIC)) != 0 ||
+            header.version != TICK_FILE_VERSION || header.stream != static_cast<uint8_t>(stream_) ||
+            header.columns != specs_.size() || header.day != day || header.header_size < sizeof(header)) {
+            throw std::runtime_error("tick file does not match its stream, symbol or day: " + path_);
+        }
+        const std::size_t end = walk_tick_blocks(
+            data.data(), size, header.header_size, specs_.size(),
+            [&](std::size_t offset, const TickBlockHeader &block) {
+                entries.push_back(tick_index_entry(offset, block));
+            });
+        if (end != size) {
+            if (::ftruncate(fd_, static_cast<off_t>(end)) != 0) {
+                throw std::runtime_error(journal_errno_message("cannot truncate tick file", path_));
+            }
+            stats_.truncated_blocks++;
+        }
+        if (::lseek(fd_, static_cast<off_t>(end), SEEK_SET) < 0) {
+            throw std::runtime_error(journal_errno_message("cannot seek tick file", path_));
+        }
+        offset_ = end;
+    }
+
+    void close_files() {
+        ::close(fd_);
+        if (index_fd_ >= 0) {
+            ::close(index_fd_);
+        }
+    }
+
+    // Append one column chunk to block_ and return its descriptor
+    TickChunkDescriptor append_chunk(TickColumnType type, const std::vector<char> &raw) {
+        const std::size_t at = block_.size();
+        TickChunkDescriptor descriptor{};
+        if (config_.compress && !raw.empty()) {
+            const char *source = raw.data();
+            TickCodec codec = TickCodec::Zstd;
+            if (type == TickColumnType::Int64) {
+                delta_.resize(raw.size());
+                int64_t previous = 0;
+                for (std::size_t r = 0; r < raw.size() / sizeof(int64_t); ++r) {
+                    const int64_t value = tick_store_detail::load_i64(raw, r);
+                    const uint64_t delta = static_cast<uint64_t>(value) - static_cast<uint64_t>(previous);
+                    std::memcpy(delta_.data() + r * sizeof(delta), &delta, sizeof(delta));
+                    previous = value;
+                }
+                source = delta_.data();
+                codec = TickCodec::DeltaZstd;
+            }
+            block_.resize(at + ZSTD_compressBound(raw.size()));
+            const std::size_t stored = record_codec_detail::check(
+                ZSTD_compress2(zstd_, block_.data() + at, block_.size() - at, source, raw.size()), "tick store");
+            if (stored < raw.size()) {
+                block_.resize(at + stored);
+                descriptor.codec = static_cast<uint8_t>(codec);
+                descriptor.stored_size = stored;
+                return descriptor;
+            }
+            block_.resize(at);
+        }
+        block_.insert(block_.end(), raw.begin(), raw.end());
+        descriptor.codec = static_cast<uint8_t>(TickCodec::Raw);
+        descriptor.stored_size = raw.size();
+        return descriptor;
+    }
+
+    const std::string path_;
+    const TickStream stream_;
+    const std::span<const TickColumnSpec> specs_;
+    const TickStoreConfig &config_;
+    ZSTD_CCtx *zstd_;
+    TickStoreStats &stats_;
+    int fd_ = -1;
+    int index_fd_ = -1;
+    // Where the next block goes
+    std::size_t offset_ = 0;
+    int32_t day_ = 0;
+    std::vector<std::vector<char>> columns_;
+    std::size_t rows_ = 0;
+    std::vector<char> block_;
+    std::vector<char> delta_;
+};
+
+class TickStoreWriter {
+public:
+    explicit TickStoreWriter(TickStoreConfig config) : config_(std::move(config)) {
+        if (config_.root.empty()) {
+            throw std::invalid_argument("tick store: root directory is required");
+        }
+        if (config_.block_rows == 0 || config_.block_rows > std::numeric_limits<uint32_t>::max()) {
+            throw std::invalid_argument("tick store: block_rows must be positive");
+        }
+        zstd_.reset(ZSTD_createCCtx());
+        if (!zstd_) {
+            throw std::runtime_error("tick store: cannot create zstd context");
+        }
+        record_codec_detail::check(ZSTD_CCtx_setParameter(zstd_.get(), ZSTD_c_compressionLevel, config_.level),
+                                   "tick store");
+    }
+
+    TickStoreWriter(const TickStoreWriter &) = delete;
+    TickStoreWriter &operator=(const TickStoreWriter &) = delete;
+
+    // Store the rows of one SBE stream message; false when it is not a
+    // stream event or does not parse
+    bool append_message(std::span<const char> message, uint64_t ingest_us) {
+        using spot_sbe::MessageHeader;
+        stats_.messages++;
+        if (message.size() < MessageHeader::encodedLength()) {
+            stats_.skipped++;
+            return false;
+        }
+        MessageHeader header{const_cast<char *>(message.data()), message.size()};
+        const char *data = message.data() + MessageHeader::encodedLength();
+        const std::size_t size = message.size() - MessageHeader::encodedLength();
+        const uint16_t block_length = header.blockLength();
+        const auto ingest = static_cast<int64_t>(ingest_us);
+        switch (header.templateId()) {
+        case TRADES_STREAM_EVENT: {
+            TradeFrame trade;
+            if (parse_trade_frame(data, size, block_length, trade) != ParseError::None) {
+                break;
+            }
+            const auto event = static_cast<int64_t>(trade.event_time_us);
+            TickFileWriter *file = file_for(TickStream::Trades, trade.symbol, event);
+            if (file == nullptr) {
+                break;
+            }
+            for_each_trade_entry(data, size, trade, [&](const TradeEntry &entry) {
+                file->put(0, event);
+                file->put(1, ingest);
+                file->put(2, static_cast<int64_t>(entry.trade_id));
+                file->put(3, decode_decimal(entry.price_mantissa, trade.price_exponent));
+                file->put(4, decode_decimal(entry.qty_mantissa, trade.qty_exponent));
+                file->put(5, static_cast<uint8_t>(entry.is_buyer_maker));
+                file->end_row();
+            });
+            return true;
+        }
+        case BEST_BID_ASK_STREAM_EVENT: {
+            BestBidAskFrame bba;
+            if (parse_best_bid_ask_frame(data, size, block_length, bba) != ParseError::None) {
+                break;
+            }
+            const auto event = static_cast<int64_t>(bba.event_time_us);
+            TickFileWriter *file = file_for(TickStream::BestBidAsk, bba.symbol, event);
+            if (file == nullptr) {
+                break;
+            }
+            file->put(0, event);
+            file->put(1, ingest);
+            file->put(2, static_cast<int64_t>(bba.book_update_id));
+            file->put(3, decode_decimal(bba.bid_price_mantissa, bba.price_exponent));
+            file->put(4, decode_decimal(bba.bid_qty_mantissa, bba.qty_exponent));
+            file->put(5, decode_decimal(bba.ask_price_mantissa, bba.price_exponent));
+            file->put(6, decode_decimal(bba.ask_qty_mantissa, bba.qty_exponent));
+            file->end_row();
+            return true;
+        }
+        case DEPTH_DIFF_STREAM_EVENT: {
+            DepthDiffFrame diff;
+            if (parse_depth_diff_frame(data, size, block_length, diff) != ParseError::None) {
+                break;
+            }
+            const auto event = static_cast<int64_t>(diff.event_time_us);
+            TickFileWriter *file = file_for(TickStream::Depth, diff.symbol, event);
+            if (file == nullptr) {
+                break;
+            }
+            const auto put_levels = [&](const LevelGroup &group, uint8_t side) {
+                for_each_level(data, group, [&](const LevelMantissa &level) {
+                    file->put(0, event);
+                    file->put(1, ingest);
+                    file->put(2, static_cast<int64_t>(diff.first_update_id));
+                    file->put(3, static_cast<int64_t>(diff.final_update_id));
+                    file->put(4, side);
+                    file->put(5, decode_decimal(level.price, diff.price_exponent));
+                    file->put(6, decode_decimal(level.qty, diff.qty_exponent));
+                    file->end_row();
+                });
+            };
+            put_levels(diff.bids, 0);
+            put_levels(diff.asks, 1);
+            return true;
+        }
+        case DEPTH_SNAPSHOT_STREAM_EVENT: {
+            DepthSnapshotFrame snapshot;
+            if (parse_depth_snapshot_frame(data, size, block_length, snapshot) != ParseError::None) {
+                break;
+            }
+            const auto event = static_cast<int64_t>(snapshot.event_time_us);
+            TickFileWriter *file = file_for(TickStream::Book, snapshot.symbol, event);
+            if (file == nullptr) {
+                break;
+            }
+            const auto put_levels = [&](const LevelGroup &group, uint8_t side) {
+                for_each_level(data, group, [&](const LevelMantissa &level) {
+                    file->put(0, event);
+                    file->put(1, ingest);
+                    file->put(2, static_cast<int64_t>(snapshot.book_update_id));
+                    file->put(3, side);
+                    file->put(4, decode_decimal(level.price, snapshot.price_exponent));
+                    file->put(5, decode_decimal(level.qty, snapshot.qty_exponent));
+                    file->end_row();
+                });
+            };
+            put_levels(snapshot.bids, 0);
+            put_levels(snapshot.asks, 1);
+            return true;
+        }
+        default:
+            break;
+        }
+        stats_.skipped++;
+        return false;
+    }
+
+    // Store every message of a buffer holding one or more back to back
+    // (a websocket frame or journal record); returns how many were stored
+    std::size_t append_buffer(std::span<const char> buffer, uint64_t ingest_us) {
+        // split_messages takes char* like the generated codecs, but never writes
+        messages_.clear();
+        split_messages(std::span<char>(const_cast<char *>(buffer.data()), buffer.size()), messages_);
+        std::size_t stored = 0;
+        for (const std::span<char> message : messages_) {
+            stored += append_message(message, ingest_us);
+        }
+        return stored;
+    }
+
+    // Store every record of the capture journals named by `paths`
+    // (directories expand to their *.sbej files), merged by receive time as
+    // JournalReplay does, so each file's rows come in arrival order. Returns
+    // the number of journal records read.
+    uint64_t append_journals(const std::vector<std::string> &paths) {
+        struct Source {
+            std::unique_ptr<JournalReader> reader;
+            JournalRecord head{};
+            bool live = false;
+        };
+        std::vector<Source> sources;
+        for (const std::string &file : journal_files(paths)) {
+            Source source{std::make_unique<JournalReader>(file)};
+            source.live = source.reader->next(source.head);
+            sources.push_back(std::move(source));
+        }
+        uint64_t records = 0;
+        while (true) {
+            Source *next = nullptr;
+            for (Source &source : sources) {
+                if (source.live && (next == nullptr || source.head.header->received_us <
+                                                           next->head.header->received_us)) {
+                    next = &source;
+                }
+            }
+            if (next == nullptr) {
+                return records;
+            }
+            append_buffer(next->head.frame, next->head.header->received_us);
+            ++records;
+            next->live = next->reader->next(next->head);
+        }
+    }
+
+    // Write every partial block
+    void flush() {
+        for (auto &[key, file] : files_) {
+            file->flush();
+        }
+    }
+
+    // Flush and close every file; later appends reopen them
+    void close() {
+        flush();
+        files_.clear();
+    }
+
+    // Files written to since the writer was created, in first-write order
+    const std::vector<std::string> &paths() const { return paths_; }
+    const TickStoreStats &stats() const { return stats_; }
+    const TickStoreConfig &config() const { return config_; }
+
+private:
+    // The open file for a stream and symbol, switching to the event's day:
+    // one file per stream and symbol stays open, so a late event of the
+    // previous day reopens that day's file for the one block. nullptr for a
+    // symbol that cannot name a directory.
+    TickFileWriter *file_for(TickStream stream, std::string_view symbol, int64_t event_time_us) {
+        if (symbol.empty() || symbol.size() > sizeof(TickFileHeader::symbol) || symbol.front() == '.' ||
+            symbol.find('/') != std::string_view::npos) {
+            return nullptr;
+        }
+        key_.assign(1, static_cast<char>(stream));
+        key_.append(symbol);
+        const int32_t day = tick_day(event_time_us);
+        auto found = files_.find(key_);
+        if (found != files_.end() && found->second->day() == day) {
+            return found->second.get();
+        }
+        if (found != files_.end()) {
+            found->second->flush();
+            files_.erase(found);
+        }
+        const std::string path = tick_file_path(config_.root, stream, symbol, day);
+        auto file = std::make_unique<TickFileWriter>(path, stream, symbol, day, config_, zstd_.get(), stats_);
+        if (std::find(paths_.begin(), paths_.end(), path) == paths_.end()) {
+            paths_.push_back(path);
+        }
+        return files_.emplace(key_, std::move(file)).first->second.get();
+    }
+
+    const TickStoreConfig config_;
+    TickStoreStats stats_;
+    record_codec_detail::ZstdPtr<ZSTD_CCtx> zstd_;
+    std::unordered_map<std::string, std::unique_ptr<TickFileWriter>> files_;
+    std::vector<std::string> paths_;
+    std::vector<std::span<char>> messages_;
+    std::string key_;
+};
+
+// A column chunk as stored in the mapped file
+struct TickChunk {
+    TickCodec codec = TickCodec::Raw;
+    const char *data = nullptr;
+    std::size_t size = 0;
+};
+
+// Rows and blocks a range read touched
+struct TickRangeRead {
+    uint64_t rows = 0;
+    std::size_t blocks = 0;
+};
+
+// Read-only map of one tick file. Blocks come from the file's sparse index
+// where it matches the file and from a walk of the block headers past it,
+// so opening a file touches only the index and the unindexed tail.
+class TickFileReader {
+public:
+    explicit TickFileReader(const std::string &path) : path_(path) {
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            throw std::runtime_error(journal_errno_message("cannot open tick file", path));
+        }
+        struct stat st {};
+        if (::fstat(fd_, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(TickFileHeader)) {
+            ::close(fd_);
+            throw std::runtime_error("not a tick file: " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        void *base = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error(journal_errno_message("cannot map tick file", path));
+        }
+        base_ = static_cast<const char *>(base);
+        try {
+            load();
+        } catch (...) {
+            close();
+            throw;
+        }
+    }
+
+    ~TickFileReader() { close(); }
+
+    TickFileReader(const TickFileReader &) = delete;
+    TickFileReader &operator=(const TickFileReader &) = delete;
+
+    TickStream stream() const { return static_cast<TickStream>(header_.stream); }
+    std::string_view symbol() const { return {header_.symbol, strnlen(header_.symbol, sizeof(header_.symbol))}; }
+    int32_t day() const { return header_.day; }
+    std::span<const TickColumnSpec> columns() const { return tick_columns(stream()); }
+    const SparseIndex &index() const { return index_; }
+    std::size_t blocks() const { return index_.size(); }
+    // Blocks found in the index file rather than by walking the data
+    std::size_t indexed_blocks() const { return indexed_blocks_; }
+    uint64_t rows() const { return rows_; }
+    // Bytes after the last complete block: a block still being written or
+    // cut short by a crash
+    std::size_t trailing_bytes() const { return size_ - end_; }
+    const std::string &path() const { return path_; }
+
+    const SparseIndexEntry &block(std::size_t block) const {
+        if (block >= index_.size()) {
+            throw std::out_of_range("tick block out of range");
+        }
+        return index_[block];
+    }
+
+    std::size_t column_index(std::string_view name) const {
+        const std::span<const TickColumnSpec> specs = columns();
+        for (std::size_t c = 0; c < specs.size(); ++c) {
+            if (name == specs[c].name) {
+                return c;
+            }
+        }
+        throw std::invalid_argument("tick file has no column '" + std::string(name) + "'");
+    }
+
+    // The ID column a SparseKey::Id range is checked against
+    std::size_t id_column() const { return tick_id_column(stream()); }
+
+    // A block's chunk of one column, checked against the block
+    TickChunk chunk(std::size_t block, std::size_t column) const {
+        const SparseIndexEntry &entry = this->block(block);
+        const std::span<const TickColumnSpec> specs = columns();
+        if (column >= specs.size()) {
+            throw std::out_of_range("tick column out of range");
+        }
+        TickBlockHeader header;
+        std::memcpy(&header, base_ + entry.offset, sizeof(header));
+        if (header.magic != TICK_BLOCK_MAGIC || header.size != entry.size || header.rows != entry.rows ||
+            header.columns != specs.size()) {
+            throw std::runtime_error("index does not match tick file " + path_);
+        }
+        const std::size_t descriptors = entry.offset + sizeof(TickBlockHeader);
+        const std::size_t block_end = entry.offset + entry.size;
+        std::size_t at = descriptors + specs.size() * sizeof(TickChunkDescriptor);
+        TickChunkDescriptor descriptor;
+        for (std::size_t c = 0;; ++c) {
+            at = tick_align(at);
+            std::memcpy(&descriptor, base_ + descriptors + c * sizeof(descriptor), sizeof(descriptor));
+            if (descriptor.stored_size > block_end - at) {
+                throw std::runtime_error("corrupt block in tick file " + path_);
+            }
+            if (c == column) {
+                break;
+            }
+            at += descriptor.stored_size;
+        }
+        const auto codec = static_cast<TickCodec>(descriptor.codec);
+        if (codec == TickCodec::Raw && descriptor.stored_size != entry.rows * tick_column_width(specs[column].type)) {
+            throw std::runtime_error("corrupt block in tick file " + path_);
+        }
+        return {codec, base_ + at, descriptor.stored_size};
+    }
+
+    // The chunk's values in place, when it is stored RAW
+    bool column_view(std::size_t block, std::size_t column, std::span<const char> &out) const {
+        const TickChunk stored = chunk(block, column);
+        if (stored.codec != TickCodec::Raw) {
+            return false;
+        }
+        out = {stored.data, stored.size};
+        return true;
+    }
+
+    // Decode a chunk into `out`, which holds rows * width bytes
+    void read_column(std::size_t block, std::size_t column, char *out) {
+        const TickChunk stored = chunk(block, column);
+        const uint64_t rows = index_[block].rows;
+        const std::size_t expected = rows * tick_column_width(columns()[column].type);
+        switch (stored.codec) {
+        case TickCodec::Raw:
+            std::memcpy(out, stored.data, expected);
+            return;
+        case TickCodec::Zstd:
+        case TickCodec::DeltaZstd: {
+            if (!dctx_) {
+                dctx_.reset(ZSTD_createDCtx());
+                if (!dctx_) {
+                    throw std::runtime_error("tick store: cannot create zstd context");
+                }
+            }
+            const std::size_t size = record_codec_detail::check(
+                ZSTD_decompressDCtx(dctx_.get(), out, expected, stored.data, stored.size), "tick store");
+            if (size != expected) {
+                throw std::runtime_error("corrupt column chunk in tick file " + path_);
+            }
+            if (stored.codec == TickCodec::DeltaZstd) {
+                uint64_t value = 0;
+                for (std::size_t r = 0; r < rows; ++r) {
+                    uint64_t delta;
+                    std::memcpy(&delta, out + r * sizeof(delta), sizeof(delta));
+                    value += delta;
+                    std::memcpy(out + r * sizeof(value), &value, sizeof(value));
+                }
+            }
+            return;
+        }
+        }
+        throw std::runtime_error("unknown column codec in tick file " + path_);
+    }
+
+    // Blocks whose event times (or IDs) overlap [from, to], in file order
+    std::vector<std::size_t> range_blocks(SparseKey key, int64_t from, int64_t to) const {
+        std::vector<std::size_t> blocks;
+        const auto [begin, end] = index_.span(key, from, to);
+        for (std::size_t b = begin; b < end; ++b) {
+            if (SparseIndex::overlaps(index_[b], key, from, to)) {
+                blocks.push_back(b);
+            }
+        }
+        return blocks;
+    }
+
+    // The rows whose event time (or ID) lies in [from, to], in file order:
+    // out[k] receives the values of column selection[k]. Only the blocks
+    // range_blocks() names are decoded, and a block wholly inside the
+    // range is decoded straight into `out`.
+    TickRangeRead read_range(SparseKey key, int64_t from, int64_t to, std::span<const std::size_t> selection,
+                             std::vector<std::vector<char>> &out) {
+        out.assign(selection.size(), {});
+        TickRangeRead result;
+        const std::size_t key_column = key == SparseKey::Time ? 0 : id_column();
+        for (const std::size_t b : range_blocks(key, from, to)) {
+            const uint64_t rows = index_[b].rows;
+            const bool covered = SparseIndex::covered(index_[b], key, from, to);
+            keep_.clear();
+            if (!covered) {
+                scratch_.resize(rows * sizeof(int64_t));
+                read_column(b, key_column, scratch_.data());
+                for (uint32_t r = 0; r < rows; ++r) {
+                    const int64_t value = tick_store_detail::load_i64(scratch_, r);
+                    if (value >= from && value <= to) {
+                        keep_.push_back(r);
+                    }
+                }
+            }
+            const std::size_t kept = covered ? rows : keep_.size();
+            for (std::size_t k = 0; k < selection.size(); ++k) {
+                const std::size_t width = tick_column_width(columns()[selection[k]].type);
+                std::vector<char> &column = out[k];
+                const std::size_t at = column.size();
+                column.resize(at + kept * width);
+                if (covered) {
+                    read_column(b, selection[k], column.data() + at);
+                    continue;
+                }
+                scratch_.resize(rows * width);
+                read_column(b, selection[k], scratch_.data());
+                for (std::size_t i = 0; i < kept; ++i) {
+                    std::memcpy(column.data() + at + i * width, scratch_.data() + keep_[i] * width, width);
+                }
+            }
+            result.rows += kept;
+            result.blocks++;
+        }
+        return result;
+    }
+
+private:
+    void load() {
+        std::memcpy(&header_, base_, sizeof(header_));
+        if (std::memcmp(header_.magic, TICK_FILE_MAGIC, sizeof(TICK_FILE_MAGIC)) != 0 ||
+            header_.version != TICK_FILE_VERSION || header_.header_size < sizeof(header_) ||
+            header_.header_size > size_ || header_.stream > static_cast<uint8_t>(TickStream::Book) ||
+            header_.columns != tick_columns(stream()).size()) {
+            throw std::runtime_error("not a tick file: " + path_);
+        }
+        std::vector<SparseIndexEntry> entries;
+        read_sparse_index(sparse_index_path(path_), entries);
+        const std::size_t indexed = sparse_index_chain(entries, header_.header_size, size_);
+        indexed_blocks_ = entries.size();
+        end_ = walk_tick_blocks(
+            base_, size_, indexed, columns().size(),
+            [&](std::size_t offset, const TickBlockHeader &header) {
+                entries.push_back(tick_index_entry(offset, header));
+            });
+        for (const SparseIndexEntry &entry : entries) {
+            rows_ += entry.rows;
+        }
+        index_ = SparseIndex(std::move(entries));
+    }
+
+    void close() {
+        if (base_ != nullptr) {
+            ::munmap(const_cast<char *>(base_), size_);
+            base_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    const char *base_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t end_ = 0;
+    TickFileHeader header_{};
+    SparseIndex index_;
+    std::size_t indexed_blocks_ = 0;
+    uint64_t rows_ = 0;
+    record_codec_detail::ZstdPtr<ZSTD_DCtx> dctx_;
+    std::vector<uint32_t> keep_;
+    std::vector<char> scratch_;
+};
+
+// Every value of the named columns of a tick file, decoded block by block
+inline std::vector<std::vector<char>> tick_read_columns(TickFileReader &reader,
+                                                       std::initializer_list<const char *> names) {
+    std::vector<std::size_t> selection;
+    for (const char *name : names) {
+        selection.push_back(reader.column_index(name));
+    }
+    std::vector<std::vector<char>> columns;
+    reader.read_range(SparseKey::Time, std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(),
+                      selection, columns);
+    return columns;
+}
+
+template <typename T>
+T tick_value(const std::vector<char> &column, std::size_t row) {
+    T value;
+    std::memcpy(&value, column.data() + row * sizeof(T), sizeof(T));
+    return value;
+}
+
+#endif
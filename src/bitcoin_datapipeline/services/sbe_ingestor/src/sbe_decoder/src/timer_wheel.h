@@ -0,0 +1,339 @@
+/*
+ * Hierarchical timer wheel for periodic work on a fixed time grid.
+ *
+ * A timer fires at every multiple of its period (offset by a phase) in
+ * microseconds since the Unix epoch, so every process using the same
+ * period fires for the same timestamps: features snapshotted every 2 s
+ * line up with the 2 s grid training data was built on, however late the
+ * loop wakes. The wheel only moves when advance() is called, from the one
+ * thread that owns it; it never fires early, and reports how late each
+ * timer fired. A timer that missed several grid points fires once, for the
+ * latest of them, and the rest are counted as skipped.
+ *
+ * Levels of 64 slots each cover ticks in powers of 64: level 0 holds the
+ * timers due in the current rotation of 64 ticks, level 1 those due in the
+ * current rotation of 4096, and so on. Each level keeps a bitmap of
+ * occupied slots, so advance() jumps straight to the next occupied slot
+ * (moving timers down a level as their rotation comes up) and an idle
+ * wheel costs nothing per tick.
+ */
+
+#ifndef _SBE_TIMER_WHEEL_H_
+#define _SBE_TIMER_WHEEL_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "decode_stats.h"
+
+using TimerId = uint32_t;
+
+constexpr TimerId INVALID_TIMER_ID = UINT32_MAX;
+
+struct TimerFired {
+    TimerId id = INVALID_TIMER_ID;
+    // Grid time the timer fired for, and how far advance() ran past it
+    uint64_t due_us = 0;
+    uint64_t lag_us = 0;
+};
+
+struct TimerWheelStats {
+    uint64_t fired = 0;
+    // Grid points passed over because a later one was already due
+    uint64_t skipped = 0;
+    // Microseconds between each firing's grid time and advance()'s now
+    LatencyHistogram lag;
+};
+
+class TimerWheel {
+public:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr std::size_t SLOTS = std::size_t{1} << SLOT_BITS;
+    static constexpr int LEVELS = 4;
+    // Ticks the wheel spans; periods over half of it are refused, so a
+    // timer never lands in the top level's current slot
+    static constexpr uint64_t SPAN_TICKS = uint64_t{1} << (SLOT_BITS * LEVELS);
+
+    explicit TimerWheel(uint64_t tick_us = 1000, uint64_t now_us = 0) : tick_us_(tick_us) {
+        if (tick_us_ == 0) {
+            throw std::invalid_argument("TimerWheel: tick_us must be positive");
+        }
+        now_us_ = now_us;
+        now_tick_ = now_us / tick_us_;
+    }
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    // Fire every `period_us`, at times t with t % period_us == phase_us,
+    // starting with the first at or after now
+    TimerId add(uint64_t period_us, uint64_t phase_us = 0) {
+        if (period_us == 0 || period_us / tick_us_ >= SPAN_TICKS / 2) {
+            throw std::invalid_argument("TimerWheel: period must be positive and within the wheel's span");
+        }
+        phase_us %= period_us;
+        TimerId id;
+        if (free_.empty()) {
+            id = static_cast<TimerId>(timers_.size());
+            timers_.emplace_back();
+        } else {
+            id = free_.back();
+            free_.pop_back();
+        }
+        Timer &timer = timers_[id];
+        timer = Timer{};
+        timer.period_us = period_us;
+        timer.phase_us = phase_us;
+        timer.due_us = grid_at_or_after(now_us_, period_us, phase_us);
+        timer.active = true;
+        ++active_;
+        insert(id);
+        return id;
+    }
+
+    // False for an unknown or already cancelled timer
+    bool cancel(TimerId id) {
+        if (id >= timers_.size() || !timers_[id].active) {
+            return false;
+        }
+        unlink(id);
+        timers_[id].active = false;
+        // IDs cancelled by a fire callback are reused only once the rest of
+        // the firings are out
+        (firing_ ? retired_ : free_).push_back(id);
+        --active_;
+        return true;
+    }
+
+    // Move the wheel to `now_us`, then call fire(const TimerFired &) for
+    // each timer that came due, in due order; periodic timers are already
+    // rescheduled, and fire may add or cancel timers (a timer cancelled
+    // before its turn does not fire). Time never runs
+    // backwards: an earlier `now_us` fires nothing.
+    template <typename Fire>
+    std::size_t advance(uint64_t now_us, Fire &&fire) {
+        if (now_us <= now_us_) {
+            return 0;
+        }
+        now_us_ = now_us;
+        const uint64_t target = now_us / tick_us_;
+        fired_.clear();
+        while (true) {
+            expire();
+            const uint64_t next = next_occupied_tick();
+            if (next > target) {
+                break;
+            }
+            now_tick_ = next;
+            cascade();
+        }
+        now_tick_ = target;
+        std::size_t count = 0;
+        firing_ = true;
+        for (const TimerFired &fired : fired_) {
+            if (timers_[fired.id].active) {
+                ++count;
+                fire(fired);
+            }
+        }
+        firing_ = false;
+        free_.insert(free_.end(), retired_.begin(), retired_.end());
+        retired_.clear();
+        return count;
+    }
+
+    // Grid time of the next timer to fire, or UINT64_MAX with none; for
+    // sleeping until exactly then
+    uint64_t next_due_us() const {
+        // Timers held back within the current tick come first, then the
+        // levels in order
+        TimerId head = slots_[0][slot_index(now_tick_, 0)];
+        for (int level = 0; head == INVALID_TIMER_ID && level < LEVELS; ++level) {
+            uint64_t start;
+            std::size_t slot;
+            if (next_slot(level, start, slot)) {
+                head = slots_[level][slot];
+            }
+        }
+        uint64_t due = UINT64_MAX;
+        for (TimerId id = head; id != INVALID_TIMER_ID; id = timers_[id].next) {
+            due = std::min(due, timers_[id].due_us);
+        }
+        return due;
+    }
+
+    uint64_t tick_us() const { return tick_us_; }
+    uint64_t now_us() const { return now_us_; }
+    std::size_t size() const { return active_; }
+    const TimerWheelStats &stats() const { return stats_; }
+
+private:
+    struct Timer {
+        uint64_t period_us = 0;
+        uint64_t phase_us = 0;
+        uint64_t due_us = 0;
+        TimerId next = INVALID_TIMER_ID;
+        TimerId prev = INVALID_TIMER_ID;
+        uint8_t level = 0;
+        uint8_t slot = 0;
+        bool active = false;
+    };
+
+    static uint64_t grid_at_or_after(uint64_t t, uint64_t period_us, uint64_t phase_us) {
+        if (t <= phase_us) {
+            return phase_us;
+        }
+        return phase_us + (t - phase_us + period_us - 1) / period_us * period_us;
+    }
+
+    // The tick a due time falls in; expire() holds back the timers of the
+    // current tick that are not due yet
+    uint64_t tick_of(uint64_t due_us) const { return due_us / tick_us_; }
+
+    static std::size_t slot_index(uint64_t tick, int level) {
+        return static_cast<std::size_t>((tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    }
+
+    // First occupied slot of `level` after the current one, and the tick it
+    // starts at. Lower levels hold only their current rotation; the top
+    // level wraps into its next one.
+    bool next_slot(int level, uint64_t &start, std::size_t &slot) const {
+        const int shift = SLOT_BITS * level;
+        const std::size_t current = slot_index(now_tick_, level);
+        uint64_t rotation = now_tick_ >> (shift + SLOT_BITS) << (shift + SLOT_BITS);
+        uint64_t occupied = current + 1 >= SLOTS ? 0 : occupied_[level] & (~uint64_t{0} << (current + 1));
+        if (occupied == 0 && level == LEVELS - 1 && occupied_[level] != 0) {
+            occupied = occupied_[level];
+            rotation += SPAN_TICKS;
+        }
+        if (occupied == 0) {
+            return false;
+        }
+        slot = static_cast<std::size_t>(std::countr_zero(occupied));
+        start = rotation | static_cast<uint64_t>(slot) << shift;
+        return true;
+    }
+
+    // The first tick after now_tick_ with work: a level-0 slot to expire, or
+    // the start of a higher level's occupied slot to cascade
+    uint64_t next_occupied_tick() const {
+        for (int level = 0; level < LEVELS; ++level) {
+            uint64_t start;
+            std::size_t slot;
+            if (next_slot(level, start, slot)) {
+                return start;
+            }
+        }
+        return UINT64_MAX;
+    }
+
+    void insert(TimerId id) {
+        Timer &timer = timers_[id];
+        const uint64_t tick = std::max(tick_of(timer.due_us), now_tick_);
+        // The lowest level whose current rotation contains the tick
+        int level = 0;
+        while (level < LEVELS - 1 && (tick ^ now_tick_) >> (SLOT_BITS * (level + 1)) != 0) {
+            ++level;
+        }
+        const std::size_t slot = slot_index(tick, level);
+        timer.level = static_cast<uint8_t>(level);
+        timer.slot = static_cast<uint8_t>(slot);
+        timer.prev = INVALID_TIMER_ID;
+        timer.next = slots_[level][slot];
+        if (timer.next != INVALID_TIMER_ID) {
+            timers_[timer.next].prev = id;
+        }
+        slots_[level][slot] = id;
+        occupied_[level] |= uint64_t{1} << slot;
+    }
+
+    void unlink(TimerId id) {
+        Timer &timer = timers_[id];
+        if (timer.prev != INVALID_TIMER_ID) {
+            timers_[timer.prev].next = timer.next;
+        } else {
+            slots_[timer.level][timer.slot] = timer.next;
+        }
+        if (timer.next != INVALID_TIMER_ID) {
+            timers_[timer.next].prev = timer.prev;
+        }
+        if (slots_[timer.level][timer.slot] == INVALID_TIMER_ID) {
+            occupied_[timer.level] &= ~(uint64_t{1} << timer.slot);
+        }
+    }
+
+    // Take a whole slot's list, leaving the slot empty
+    TimerId take_slot(int level, std::size_t slot) {
+        const TimerId head = slots_[level][slot];
+        slots_[level][slot] = INVALID_TIMER_ID;
+        occupied_[level] &= ~(uint64_t{1} << slot);
+        return head;
+    }
+
+    // At the start of a rotation, move the higher levels' timers due in it
+    // down to where they now belong
+    void cascade() {
+        for (int level = 1; level < LEVELS; ++level) {
+            if (slot_index(now_tick_, level - 1) != 0) {
+                break;
+            }
+            for (TimerId id = take_slot(level, slot_index(now_tick_, level)); id != INVALID_TIMER_ID;) {
+                const TimerId next = timers_[id].next;
+                insert(id);
+                id = next;
+            }
+        }
+    }
+
+    // Fire the current tick's slot into fired_. The slot is emptied first,
+    // so timers reinserted into it are not walked again.
+    void expire() {
+        TimerId id = take_slot(0, slot_index(now_tick_, 0));
+        while (id != INVALID_TIMER_ID) {
+            Timer &timer = timers_[id];
+            const TimerId next = timer.next;
+            if (timer.due_us > now_us_) {
+                // Due later within this tick
+                insert(id);
+                id = next;
+                continue;
+            }
+            // The latest grid point already due
+            const uint64_t missed = (now_us_ - timer.due_us) / timer.period_us;
+            const uint64_t due = timer.due_us + missed * timer.period_us;
+            stats_.skipped += missed;
+            ++stats_.fired;
+            stats_.lag.record(now_us_ - due);
+            timer.due_us = due + timer.period_us;
+            insert(id);
+            fired_.push_back(TimerFired{id, due, now_us_ - due});
+            id = next;
+        }
+    }
+
+    const uint64_t tick_us_;
+    uint64_t now_us_ = 0;
+    uint64_t now_tick_ = 0;
+    std::vector<Timer> timers_;
+    std::vector<TimerId> free_;
+    std::vector<TimerId> retired_;
+    bool firing_ = false;
+    std::size_t active_ = 0;
+    std::array<std::array<TimerId, SLOTS>, LEVELS> slots_ = [] {
+        std::array<std::array<TimerId, SLOTS>, LEVELS> slots;
+        for (auto &level : slots) {
+            level.fill(INVALID_TIMER_ID);
+        }
+        return slots;
+    }();
+    std::array<uint64_t, LEVELS> occupied_{};
+    // Firings of the advance() in progress
+    std::vector<TimerFired> fired_;
+    TimerWheelStats stats_;
+};
+
+#endif
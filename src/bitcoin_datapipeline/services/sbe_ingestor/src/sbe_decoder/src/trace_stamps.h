@@ -0,0 +1,121 @@
+/*
+ * End-to-end latency trace stamps.
+ *
+ * A trace is one microsecond Unix timestamp per pipeline stage, in stage
+ * order: the exchange's event time (before micros_to_millis truncates it),
+ * socket receive, decode done, enqueue into the Kinesis producer's batch,
+ * Kinesis put (the record's arrival time at the stream), aggregator consume
+ * and feature publish. Zero means the stage was not stamped.
+ *
+ * Native code stamps the first stages. SBEDecoder with trace=True fills in
+ * event, receive and decode. A StreamReceiver drain returns
+ * frame_ingest_ts_us plus one drain_ts_us that stands for decode done: its
+ * frames are decoded into the ring within a microsecond of receive, and
+ * the wait to be drained is what matters there. The block travels on as a
+ * list of TRACE_STAGE_COUNT ints in the record's "trace" field and each
+ * later stage fills its slot with ingest_clock_us(). At the end a
+ * TraceCollector turns it into one latency histogram per hop, from the
+ * nearest earlier stamped stage, plus one for the whole trace. Hops whose
+ * clocks disagree (the exchange's event time ahead of our receive) count
+ * as zero and are tallied as skewed. Once a ClockSync runs, the decoder
+ * stamps the event time moved onto our clock (exchange_clock.h), so the
+ * receive hop is the network delay rather than that plus the offset.
+ */
+
+#ifndef _SBE_TRACE_STAMPS_H_
+#define _SBE_TRACE_STAMPS_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include "decode_stats.h"
+
+enum TraceStage : std::size_t {
+    TRACE_EVENT = 0,
+    TRACE_RECEIVE,
+    TRACE_DECODE,
+    TRACE_ENQUEUE,
+    TRACE_KINESIS_PUT,
+    TRACE_CONSUME,
+    TRACE_PUBLISH,
+    TRACE_STAGE_COUNT,
+};
+
+// Stats keys and the "trace" list order, in TraceStage order
+constexpr std::array<const char *, TRACE_STAGE_COUNT> TRACE_STAGE_NAMES = {
+    "event", "receive", "decode", "enqueue", "kinesis_put", "consume", "publish",
+};
+
+struct TraceStamps {
+    std::array<uint64_t, TRACE_STAGE_COUNT> us{};
+};
+
+// Event time of a stream event body: every stream template starts with
+// eventTime (int64 microseconds). Zero if the body is too short.
+inline uint64_t trace_event_time_us(const char *body, std::size_t body_size) {
+    int64_t event_time = 0;
+    if (body_size >= sizeof(event_time)) {
+        std::memcpy(&event_time, body, sizeof(event_time));
+    }
+    return event_time > 0 ? static_cast<uint64_t>(event_time) : 0;
+}
+
+// Per-hop latency histograms of finished traces, in microseconds.
+// Single writer, like LatencyHistogram.
+class TraceCollector {
+public:
+    void record(const TraceStamps &trace) {
+        std::size_t first = TRACE_STAGE_COUNT;
+        std::size_t previous = TRACE_STAGE_COUNT;
+        for (std::size_t stage = 0; stage < TRACE_STAGE_COUNT; ++stage) {
+            const uint64_t at = trace.us[stage];
+            if (at == 0) {
+                continue;
+            }
+            if (previous == TRACE_STAGE_COUNT) {
+                first = stage;
+            } else {
+                hops_[stage].record(elapsed(trace.us[previous], at));
+            }
+            previous = stage;
+        }
+        if (previous != TRACE_STAGE_COUNT && previous != first) {
+            total_.record(elapsed(trace.us[first], trace.us[previous]));
+        }
+        ++traces_;
+    }
+
+    void reset() {
+        for (auto &hop : hops_) {
+            hop.reset();
+        }
+        total_.reset();
+        traces_ = 0;
+        skewed_ = 0;
+    }
+
+    // Latency into `stage` from the stamped stage before it; TRACE_EVENT's
+    // stays empty
+    const LatencyHistogram &hop(TraceStage stage) const { return hops_[stage]; }
+    // First to last stamped stage
+    const LatencyHistogram &total() const { return total_; }
+    uint64_t traces() const { return traces_; }
+    uint64_t skewed() const { return skewed_; }
+
+private:
+    uint64_t elapsed(uint64_t from, uint64_t to) {
+        if (to < from) {
+            ++skewed_;
+            return 0;
+        }
+        return to - from;
+    }
+
+    std::array<LatencyHistogram, TRACE_STAGE_COUNT> hops_;
+    LatencyHistogram total_;
+    uint64_t traces_ = 0;
+    uint64_t skewed_ = 0;
+};
+
+#endif
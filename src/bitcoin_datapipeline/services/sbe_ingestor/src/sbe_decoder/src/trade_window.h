@@ -0,0 +1,254 @@
+/*
+ * Incremental trade features over a sliding time window.
+ *
+ * FeatureBuilder._build_trade_features rebuilds price/volume/timestamp lists
+ * for every aggregation and runs min, max, mean, stdev and the VWAP sum over
+ * the whole window. A TradeWindow keeps those statistics up to date as trades
+ * arrive and leave instead: running sums for volume, notional and buy/sell
+ * volume, Welford mean/variance with removal for the price, and monotonic
+ * deques for the min and max. add() and eviction are O(1) amortized and
+ * features() is a constant-time read whatever the window length.
+ *
+ * Timestamps are milliseconds (the trade_time column of decode_batch), and a
+ * trade stays in the window while its timestamp is within window_ms of the
+ * newest one. Removal makes the running sums drift, so they are recomputed
+ * from the retained trades once as many trades have left as remain, which
+ * keeps the amortized cost O(1).
+ *
+ * Not thread-safe; the binding uses it with the GIL held.
+ */
+
+#ifndef _SBE_TRADE_WINDOW_H_
+#define _SBE_TRADE_WINDOW_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+
+// Same names and definitions as the Python trade features
+struct TradeFeatures {
+    double price = 0;
+    double volume = 0;
+    double vwap = 0;
+    double price_change = 0;
+    double price_change_pct = 0;
+    double min_price = 0;
+    double max_price = 0;
+    double avg_price = 0;
+    double price_volatility = 0;
+    uint64_t trade_count = 0;
+    double trades_per_second = 0;
+    double buy_volume = 0;
+    double sell_volume = 0;
+    double volume_imbalance = 0;
+    double avg_trade_size = 0;
+    double time_span_seconds = 0;
+};
+
+// Window aggregates the features derive from, however they were gathered
+struct TradeSummary {
+    std::size_t count = 0;
+    int64_t first_ts_ms = 0;
+    int64_t last_ts_ms = 0;
+    double first_price = 0;
+    double last_price = 0;
+    double min_price = 0;
+    double max_price = 0;
+    double mean_price = 0;
+    // Sample variance (n - 1)
+    double price_variance = 0;
+    double volume = 0;
+    // Σ price·qty
+    double notional = 0;
+    double buy_volume = 0;
+};
+
+// The Python builder's formulas, in O(1); `summary.count` must be positive
+inline TradeFeatures trade_features(const TradeSummary &summary) {
+    TradeFeatures f;
+    const double count = static_cast<double>(summary.count);
+    f.price = summary.last_price;
+    f.volume = summary.volume;
+    f.trade_count = summary.count;
+    f.min_price = summary.min_price;
+    f.max_price = summary.max_price;
+    f.avg_price = summary.mean_price;
+    f.vwap = summary.volume > 0 ? summary.notional / summary.volume : summary.mean_price;
+    f.buy_volume = summary.buy_volume;
+    f.sell_volume = summary.volume - summary.buy_volume;
+    f.time_span_seconds =
+        summary.count > 1 ? static_cast<double>(summary.last_ts_ms - summary.first_ts_ms) / 1000 : 1;
+    f.trades_per_second = count / std::max(f.time_span_seconds, 1.0);
+    f.price_change = summary.count > 1 ? summary.last_price - summary.first_price : 0;
+    f.price_change_pct = f.price_change / summary.first_price * 100;
+    // Sample standard deviation, as statistics.stdev
+    f.price_volatility = std::sqrt(summary.price_variance);
+    f.volume_imbalance = (f.buy_volume - f.sell_volume) / std::max(summary.volume, 1.0);
+    f.avg_trade_size = summary.volume / count;
+    return f;
+}
+
+class TradeWindow {
+public:
+    explicit TradeWindow(int64_t window_ms) : window_ms_(window_ms) {
+        if (window_ms_ <= 0) {
+            throw std::runtime_error("TradeWindow: window must be positive");
+        }
+    }
+
+    // Add one trade and evict the trades that fall out of the window. Trades
+    // without a positive price and qty are ignored, as in the Python builder.
+    // A timestamp older than the newest trade is treated as the newest, so
+    // the window never evicts out of order.
+    void add(int64_t ts_ms, double price, double qty, bool is_buyer_maker) {
+        if (!(price > 0) || !(qty > 0)) {
+            return;
+        }
+        if (!trades_.empty()) {
+            ts_ms = std::max(ts_ms, trades_.back().ts_ms);
+        }
+        const Trade trade{ts_ms, price, qty, seq_++, is_buyer_maker};
+        trades_.push_back(trade);
+        include(trade);
+
+        while (!min_.empty() && min_.back().price >= price) {
+            min_.pop_back();
+        }
+        min_.push_back(trade);
+        while (!max_.empty() && max_.back().price <= price) {
+            max_.pop_back();
+        }
+        max_.push_back(trade);
+
+        evict_before(ts_ms - window_ms_);
+    }
+
+    // Evict the trades older than window_ms before `now_ms`, so an idle
+    // symbol's features age out without new trades
+    void advance(int64_t now_ms) { evict_before(now_ms - window_ms_); }
+
+    TradeFeatures features() const {
+        if (trades_.empty()) {
+            return {};
+        }
+        TradeSummary summary;
+        summary.count = trades_.size();
+        summary.first_ts_ms = trades_.front().ts_ms;
+        summary.last_ts_ms = trades_.back().ts_ms;
+        summary.first_price = trades_.front().price;
+        summary.last_price = trades_.back().price;
+        summary.min_price = min_.front().price;
+        summary.max_price = max_.front().price;
+        summary.mean_price = mean_;
+        summary.price_variance =
+            trades_.size() > 1 ? std::max(m2_, 0.0) / static_cast<double>(trades_.size() - 1) : 0;
+        summary.volume = volume_;
+        summary.notional = notional_;
+        summary.buy_volume = buy_volume_;
+        return trade_features(summary);
+    }
+
+    std::size_t size() const { return trades_.size(); }
+    int64_t window_ms() const { return window_ms_; }
+
+    void clear() {
+        trades_.clear();
+        min_.clear();
+        max_.clear();
+        reset_sums();
+    }
+
+private:
+    struct Trade {
+        int64_t ts_ms;
+        double price;
+        double qty;
+        // Arrival order, to match min/max deque entries to evicted trades
+        uint64_t seq;
+        bool is_buyer_maker;
+    };
+
+    void include(const Trade &trade) {
+        volume_ += trade.qty;
+        notional_ += trade.price * trade.qty;
+        if (!trade.is_buyer_maker) {
+            buy_volume_ += trade.qty;
+        }
+        const double n = static_cast<double>(trades_.size());
+        const double delta = trade.price - mean_;
+        mean_ += delta / n;
+        m2_ += delta * (trade.price - mean_);
+    }
+
+    // Welford's update run backwards; `trade` has already left trades_
+    void exclude(const Trade &trade) {
+        volume_ -= trade.qty;
+        notional_ -= trade.price * trade.qty;
+        if (!trade.is_buyer_maker) {
+            buy_volume_ -= trade.qty;
+        }
+        const double n = static_cast<double>(trades_.size());
+        const double delta = trade.price - mean_;
+        mean_ -= delta / n;
+        m2_ -= delta * (trade.price - mean_);
+    }
+
+    void evict_before(int64_t cutoff_ms) {
+        while (!trades_.empty() && trades_.front().ts_ms <= cutoff_ms) {
+            const Trade trade = trades_.front();
+            trades_.pop_front();
+            if (min_.front().seq == trade.seq) {
+                min_.pop_front();
+            }
+            if (max_.front().seq == trade.seq) {
+                max_.pop_front();
+            }
+            if (trades_.empty()) {
+                reset_sums();
+                return;
+            }
+            exclude(trade);
+            ++evicted_;
+        }
+        if (evicted_ > trades_.size() + REFRESH_MIN) {
+            recompute();
+        }
+    }
+
+    // Exact sums over the retained trades
+    void recompute() {
+        reset_sums();
+        std::deque<Trade> retained;
+        retained.swap(trades_);
+        for (const Trade &trade : retained) {
+            trades_.push_back(trade);
+            include(trade);
+        }
+    }
+
+    void reset_sums() {
+        volume_ = notional_ = buy_volume_ = mean_ = m2_ = 0;
+        evicted_ = 0;
+    }
+
+    // Evictions drift the sums by a few ulps each; don't recompute small
+    // windows after every couple of trades
+    static constexpr std::size_t REFRESH_MIN = 1024;
+
+    int64_t window_ms_;
+    std::deque<Trade> trades_;
+    // Candidates for the min (prices increasing) and max (decreasing)
+    std::deque<Trade> min_;
+    std::deque<Trade> max_;
+    uint64_t seq_ = 0;
+    std::size_t evicted_ = 0;
+    double volume_ = 0;
+    double notional_ = 0;
+    double buy_volume_ = 0;
+    double mean_ = 0;
+    double m2_ = 0;
+};
+
+#endif
@@ -0,0 +1,674 @@
+/*
+ * Prefetching loader of training minibatches from the tick store.
+ *
+ * Training otherwise assembles features in Python, and the trainer waits on
+ * that between steps. TrainingLoader reads a set of symbols and days from
+ * the tick store (tick_store.h) and does the whole assembly on background
+ * threads:
+ *
+ *   1. Per symbol and day, the trades and bba files are replayed onto a
+ *      grid of step_ms steps through the aggregator's own kernels. A step's
+ *      quotes go through a QuoteRing (message_ring.h) that is then cleared,
+ *      as an aggregation interval does, and every trade goes into a
+ *      MultiHorizonWindow whose horizons give the "{name}_{horizon}" trade
+ *      features of StreamAggregator._horizon_features. A step is one
+ *      float32 row: TRAINING_QUOTE_FEATURES, then the horizon features.
+ *      A step without quotes repeats the last quote features with no
+ *      updates and no change; steps before the day's first quote have none.
+ *      The grid ends at the day's last event.
+ *   2. A sample is the `window` rows ending at a step, labelled with the
+ *      mid-price return label_horizon_ms later (forward_labels.h, the
+ *      kernel offline evaluation uses). Window and label stay inside one
+ *      symbol and day, after its first quote.
+ *   3. Each epoch shuffles the samples (seed + epoch number), and the
+ *      threads gather batches of batch_size into a fixed pool of
+ *      prefetch + 1 buffers, handed out in batch order.
+ *
+ * Buffers are page-aligned and mlock()ed where RLIMIT_MEMLOCK allows, so
+ * they stay resident, and the pool is fixed, so a CUDA trainer can register
+ * it as pinned memory once. A batch is lent, not copied: its buffer goes
+ * back to the pool when released. Workers wait for a free buffer, so a
+ * trainer holding on to every one would stall the loader; next() throws
+ * instead of waiting forever.
+ *
+ * next() is for one consumer thread.
+ */
+
+#ifndef _SBE_TRAINING_LOADER_H_
+#define _SBE_TRAINING_LOADER_H_
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "float_bits.h"
+#include "forward_labels.h"
+#include "message_ring.h"
+#include "multi_horizon.h"
+#include "sparse_index.h"
+#include "tick_store.h"
+#include "trade_window.h"
+
+// Per-step quote features, QuoteRing::features() fields of the same name
+inline constexpr std::array<const char *, 9> TRAINING_QUOTE_FEATURES = {
+    "mid_price",      "spread",         "spread_pct",        "bid_size",     "ask_size",
+    "size_imbalance", "mid_change_pct", "spread_volatility", "update_count",
+};
+
+// Per-horizon trade features, as StreamAggregator._horizon_features flattens them
+inline constexpr std::array<const char *, 6> TRAINING_TRADE_FEATURES = {
+    "vwap", "volume", "trade_count", "price_change_pct", "price_volatility", "volume_imbalance",
+};
+
+struct TrainingLoaderConfig {
+    std::string root;
+    std::vector<std::string> symbols;
+    // UTC days, "YYYY-MM-DD"
+    std::vector<std::string> days;
+    std::vector<int64_t> horizons_ms{1000, 2000, 10000, 60000};
+    int64_t step_ms = 1000;
+    std::size_t window = 32;
+    int64_t label_horizon_ms = 10000;
+    std::size_t batch_size = 256;
+    std::size_t prefetch = 4;
+    std::size_t threads = 2;
+    bool shuffle = true;
+    uint64_t seed = 1;
+    // Leave out the last, partial batch of an epoch
+    bool drop_last = true;
+    // QuoteRing capacity: quotes per step past it keep only the newest
+    std::size_t quote_capacity = 1000;
+};
+
+struct TrainingLoaderStats {
+    std::atomic<uint64_t> units{0};
+    std::atomic<uint64_t> steps{0};
+    std::atomic<uint64_t> trades{0};
+    std::atomic<uint64_t> quotes{0};
+    std::atomic<uint64_t> batches{0};
+    // Time next() spent waiting for a batch: near zero when training is
+    // compute-bound
+    std::atomic<uint64_t> wait_us{0};
+    // Time workers spent waiting for a free buffer
+    std::atomic<uint64_t> stall_us{0};
+};
+
+// One lent batch: `rows` samples of window x features float32 values, a
+// float32 label, the step's grid time and the index of its symbol
+struct TrainingBatch {
+    std::size_t slot = 0;
+    std::size_t rows = 0;
+    const float *features = nullptr;
+    const float *labels = nullptr;
+    const int64_t *timestamps_us = nullptr;
+    const uint16_t *symbols = nullptr;
+};
+
+// The loader's fixed set of batch buffers. Shared with whatever batches are
+// still lent, so buffers released after the loader is gone stay valid.
+class TrainingBatchPool {
+public:
+    TrainingBatchPool(std::size_t slots, std::size_t rows, std::size_t values_per_row) : rows_(rows) {
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        features_bytes_ = align(rows * values_per_row * sizeof(float), page);
+        labels_bytes_ = align(rows * sizeof(float), 64);
+        timestamps_bytes_ = align(rows * sizeof(int64_t), 64);
+        symbols_bytes_ = align(rows * sizeof(uint16_t), 64);
+        slot_bytes_ = align(features_bytes_ + labels_bytes_ + timestamps_bytes_ + symbols_bytes_, page);
+        memory_ = static_cast<char *>(std::aligned_alloc(page, slot_bytes_ * slots));
+        if (memory_ == nullptr) {
+            throw std::runtime_error("training loader: cannot allocate batch buffers");
+        }
+        std::memset(memory_, 0, slot_bytes_ * slots);
+        locked_ = ::mlock(memory_, slot_bytes_ * slots) == 0;
+        for (std::size_t s = slots; s-- > 0;) {
+            free_.push_back(s);
+        }
+        slots_ = slots;
+    }
+
+    ~TrainingBatchPool() {
+        if (locked_) {
+            ::munlock(memory_, slot_bytes_ * slots_);
+        }
+        std::free(memory_);
+    }
+
+    TrainingBatchPool(const TrainingBatchPool &) = delete;
+    TrainingBatchPool &operator=(const TrainingBatchPool &) = delete;
+
+    // A free buffer, waiting for one; false once `stop` is set
+    bool acquire(std::size_t &slot, const std::atomic<bool> &stop) {
+        std::unique_lock lock(mutex_);
+        freed_.wait(lock, [&] { return !free_.empty() || stop.load(); });
+        if (stop.load()) {
+            return false;
+        }
+        slot = free_.back();
+        free_.pop_back();
+        return true;
+    }
+
+    // Mark a buffer as handed to the trainer
+    void lend() { lent_.fetch_add(1, std::memory_order_relaxed); }
+
+    // Return a buffer lent to the trainer
+    void release(std::size_t slot) {
+        lent_.fetch_sub(1, std::memory_order_relaxed);
+        recycle(slot);
+    }
+
+    // Return a buffer that was never lent
+    void recycle(std::size_t slot) {
+        {
+            std::lock_guard lock(mutex_);
+            free_.push_back(slot);
+        }
+        freed_.notify_one();
+    }
+
+    void wake_all() {
+        std::lock_guard lock(mutex_);
+        freed_.notify_all();
+    }
+
+    std::size_t lent() const { return lent_.load(std::memory_order_relaxed); }
+
+    float *features(std::size_t slot) const { return reinterpret_cast<float *>(memory_ + slot * slot_bytes_); }
+    float *labels(std::size_t slot) const {
+        return reinterpret_cast<float *>(memory_ + slot * slot_bytes_ + features_bytes_);
+    }
+    int64_t *timestamps_us(std::size_t slot) const {
+        return reinterpret_cast<int64_t *>(memory_ + slot * slot_bytes_ + features_bytes_ + labels_bytes_);
+    }
+    uint16_t *symbols(std::size_t slot) const {
+        return reinterpret_cast<uint16_t *>(memory_ + slot * slot_bytes_ + features_bytes_ + labels_bytes_ +
+                                            timestamps_bytes_);
+    }
+
+    std::size_t slots() const { return slots_; }
+    std::size_t rows() const { return rows_; }
+    // Whether mlock() kept the buffers resident
+    bool locked() const { return locked_; }
+
+private:
+    static std::size_t align(std::size_t size, std::size_t to) { return (size + to - 1) / to * to; }
+
+    const std::size_t rows_;
+    std::size_t slots_ = 0;
+    std::size_t features_bytes_ = 0;
+    std::size_t labels_bytes_ = 0;
+    std::size_t timestamps_bytes_ = 0;
+    std::size_t symbols_bytes_ = 0;
+    std::size_t slot_bytes_ = 0;
+    char *memory_ = nullptr;
+    bool locked_ = false;
+    std::atomic<std::size_t> lent_{0};
+    mutable std::mutex mutex_;
+    std::condition_variable freed_;
+    std::vector<std::size_t> free_;
+};
+
+namespace training_loader_detail {
+
+// One symbol and day on the step grid
+struct Unit {
+    uint16_t symbol = 0;
+    int32_t day = 0;
+    // Grid time of step 0; step k ends at start_us + k * step
+    int64_t start_us = 0;
+    std::size_t steps = 0;
+    // First step with quote features; steps before it have no row
+    std::size_t first_valid = 0;
+    std::vector<float> rows;
+    // Forward mid return of each step, NaN without one
+    std::vector<double> labels;
+};
+
+struct Sample {
+    uint32_t unit;
+    uint32_t step;
+};
+
+} // namespace training_loader_detail
+
+class TrainingLoader {
+public:
+    explicit TrainingLoader(TrainingLoaderConfig config) : config_(std::move(config)) {
+        if (config_.root.empty() || config_.symbols.empty() || config_.days.empty()) {
+            throw std::invalid_argument("training loader: root, symbols and days are required");
+        }
+        if (config_.symbols.size() > std::numeric_limits<uint16_t>::max()) {
+            throw std::invalid_argument("training loader: too many symbols");
+        }
+        if (config_.step_ms <= 0 || config_.label_horizon_ms <= 0 || config_.label_horizon_ms % config_.step_ms != 0) {
+            throw std::invalid_argument("training loader: label_horizon_ms must be a positive multiple of step_ms");
+        }
+        if (config_.window == 0 || config_.batch_size == 0 || config_.prefetch == 0 || config_.threads == 0 ||
+            config_.quote_capacity == 0) {
+            throw std::invalid_argument("training loader: window, batch_size, prefetch, threads and "
+                                        "quote_capacity must be positive");
+        }
+        for (const std::string &day : config_.days) {
+            days_.push_back(tick_day_parse(day));
+        }
+        // Validates the horizons the way the aggregator's windows do
+        const MultiHorizonWindow shape(config_.horizons_ms, 0);
+        for (const char *name : TRAINING_QUOTE_FEATURES) {
+            names_.emplace_back(name);
+        }
+        for (const int64_t horizon : config_.horizons_ms) {
+            char label[32];
+            std::snprintf(label, sizeof(label), "%gs", static_cast<double>(horizon) / 1e3);
+            for (const char *name : TRAINING_TRADE_FEATURES) {
+                names_.push_back(std::string(name) + "_" + label);
+            }
+        }
+        pool_ = std::make_shared<TrainingBatchPool>(config_.prefetch + 1, config_.batch_size,
+                                                    config_.window * names_.size());
+        units_.resize(config_.symbols.size() * days_.size());
+        try {
+            for (std::size_t t = 0; t < config_.threads; ++t) {
+                workers_.emplace_back([this] { run(); });
+            }
+        } catch (...) {
+            shutdown();
+            throw;
+        }
+    }
+
+    ~TrainingLoader() { shutdown(); }
+
+    TrainingLoader(const TrainingLoader &) = delete;
+    TrainingLoader &operator=(const TrainingLoader &) = delete;
+
+    // The next batch of the epoch, in order; false at the end of the epoch,
+    // after which the next call starts the following one. The batch's
+    // buffer is the caller's until pool()->release(batch.slot).
+    bool next(TrainingBatch &batch) {
+        const auto started = std::chrono::steady_clock::now();
+        std::unique_lock lock(mutex_);
+        changed_.wait(lock, [&] { return assembled_ || error_; });
+        rethrow_locked();
+        if (epoch_done_) {
+            start_epoch_locked(epoch_ + 1);
+            changed_.notify_all();
+        }
+        if (delivered_ == batches_) {
+            epoch_done_ = true;
+            return false;
+        }
+        while (true) {
+            const auto found = std::find_if(ready_.begin(), ready_.end(),
+                                            [&](const Ready &ready) { return ready.index == delivered_; });
+            if (found != ready_.end()) {
+                batch = found->batch;
+                ready_.erase(found);
+                ++delivered_;
+                break;
+            }
+            rethrow_locked();
+            if (pool_->lent() == pool_->slots()) {
+                throw std::runtime_error("training loader: every batch buffer is still in use; release batches "
+                                         "before asking for more than prefetch + 1");
+            }
+            changed_.wait_for(lock, std::chrono::milliseconds(100));
+        }
+        pool_->lend();
+        stats_.batches.fetch_add(1, std::memory_order_relaxed);
+        stats_.wait_us.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                            std::chrono::steady_clock::now() - started)
+                                                            .count()),
+                                 std::memory_order_relaxed);
+        return true;
+    }
+
+    // Wait until every unit is assembled; rethrows an assembly error
+    void wait_ready() {
+        std::unique_lock lock(mutex_);
+        changed_.wait(lock, [&] { return assembled_ || error_; });
+        rethrow_locked();
+    }
+
+    const std::shared_ptr<TrainingBatchPool> &pool() const { return pool_; }
+    const std::vector<std::string> &feature_names() const { return names_; }
+    const TrainingLoaderConfig &config() const { return config_; }
+    const TrainingLoaderStats &stats() const { return stats_; }
+
+    // After wait_ready()
+    std::size_t samples() const {
+        std::lock_guard lock(mutex_);
+        return samples_.size();
+    }
+
+    std::size_t batches_per_epoch() const {
+        std::lock_guard lock(mutex_);
+        return batches_;
+    }
+
+    uint64_t epoch() const {
+        std::lock_guard lock(mutex_);
+        return epoch_;
+    }
+
+private:
+    struct Ready {
+        std::size_t index;
+        TrainingBatch batch;
+    };
+
+    void shutdown() {
+        {
+            std::lock_guard lock(mutex_);
+            stop_.store(true);
+        }
+        changed_.notify_all();
+        pool_->wake_all();
+        for (std::thread &worker : workers_) {
+            worker.join();
+        }
+        // Batches gathered but never taken go back to the pool
+        for (const Ready &ready : ready_) {
+            pool_->recycle(ready.batch.slot);
+        }
+        ready_.clear();
+    }
+
+    void run() {
+        try {
+            assemble();
+            gather();
+        } catch (...) {
+            {
+                std::lock_guard lock(mutex_);
+                if (!error_) {
+                    error_ = std::current_exception();
+                }
+                stop_.store(true);
+            }
+            changed_.notify_all();
+            pool_->wake_all();
+        }
+    }
+
+    // Phase 1: units off a shared counter; the last worker to finish lists
+    // the samples and starts epoch 0
+    void assemble() {
+        for (std::size_t u = next_unit_.fetch_add(1); u < units_.size() && !stop_.load();
+             u = next_unit_.fetch_add(1)) {
+            build_unit(u, units_[u]);
+            stats_.units.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::lock_guard lock(mutex_);
+        if (++assembled_workers_ < config_.threads || error_) {
+            return;
+        }
+        for (std::size_t u = 0; u < units_.size(); ++u) {
+            list_samples(u);
+        }
+        assembled_ = true;
+        start_epoch_locked(0);
+        changed_.notify_all();
+    }
+
+    void build_unit(std::size_t u, training_loader_detail::Unit &unit) {
+        const std::size_t symbol = u / days_.size();
+        unit.symbol = static_cast<uint16_t>(symbol);
+        unit.day = days_[u % days_.size()];
+        const std::string &name = config_.symbols[symbol];
+        const std::string quotes_path = tick_file_path(config_.root, TickStream::BestBidAsk, name, unit.day);
+        const std::string trades_path = tick_file_path(config_.root, TickStream::Trades, name, unit.day);
+        if (!std::filesystem::exists(quotes_path)) {
+            return;
+        }
+        std::vector<std::vector<char>> quotes;
+        {
+            TickFileReader reader(quotes_path);
+            quotes = tick_read_columns(reader, {"event_time_us", "bid_price", "bid_qty", "ask_price", "ask_qty"});
+        }
+        std::vector<std::vector<char>> trades(4);
+        if (std::filesystem::exists(trades_path)) {
+            TickFileReader reader(trades_path);
+            trades = tick_read_columns(reader, {"event_time_us", "price", "qty", "is_buyer_maker"});
+        }
+        const std::size_t quote_rows = quotes[0].size() / sizeof(int64_t);
+        const std::size_t trade_rows = trades[0].size() / sizeof(int64_t);
+        if (quote_rows == 0) {
+            return;
+        }
+
+        // The grid runs from midnight to the step of the day's last event
+        const int64_t step_us = config_.step_ms * 1000;
+        unit.start_us = static_cast<int64_t>(unit.day) * TICK_US_PER_DAY;
+        int64_t last_us = tick_value<int64_t>(quotes[0], quote_rows - 1);
+        if (trade_rows > 0) {
+            last_us = std::max(last_us, tick_value<int64_t>(trades[0], trade_rows - 1));
+        }
+        unit.steps = static_cast<std::size_t>(
+            std::clamp<int64_t>((last_us - unit.start_us) / step_us + 1, 0, TICK_US_PER_DAY / step_us));
+        const std::size_t width = names_.size();
+        unit.rows.assign(unit.steps * width, 0.0f);
+        std::vector<double> mids(unit.steps, std::numeric_limits<double>::quiet_NaN());
+        unit.first_valid = unit.steps;
+
+        QuoteRing ring(config_.quote_capacity);
+        MultiHorizonWindow window(config_.horizons_ms, 0);
+        std::array<float, TRAINING_QUOTE_FEATURES.size()> last_quote{};
+        bool quoted = false;
+        std::size_t q = 0, t = 0;
+        TradeSummary summary;
+        for (std::size_t k = 0; k < unit.steps; ++k) {
+            // Step k holds what happened before its grid time
+            const int64_t end_us = unit.start_us + static_cast<int64_t>(k + 1) * step_us;
+            for (; q < quote_rows && tick_value<int64_t>(quotes[0], q) < end_us; ++q) {
+                ring.push(tick_value<int64_t>(quotes[0], q), tick_value<double>(quotes[1], q),
+                          tick_value<double>(quotes[2], q), tick_value<double>(quotes[3], q),
+                          tick_value<double>(quotes[4], q));
+            }
+            for (; t < trade_rows && tick_value<int64_t>(trades[0], t) < end_us; ++t) {
+                window.add(tick_value<int64_t>(trades[0], t) / 1000, tick_value<double>(trades[1], t),
+                           tick_value<double>(trades[2], t), tick_value<uint8_t>(trades[3], t) != 0);
+            }
+            if (ring.size() > 0) {
+                const QuoteFeatures f = ring.features();
+                last_quote = {static_cast<float>(f.mid_price),         static_cast<float>(f.spread),
+                              static_cast<float>(f.spread_pct),        static_cast<float>(f.bid_size),
+                              static_cast<float>(f.ask_size),          static_cast<float>(f.size_imbalance),
+                              static_cast<float>(f.mid_change_pct),    static_cast<float>(f.spread_volatility),
+                              static_cast<float>(f.update_count)};
+                mids[k] = f.mid_price;
+                ring.clear();
+                if (!quoted) {
+                    unit.first_valid = k;
+                    quoted = true;
+                }
+            } else if (quoted) {
+                // No updates: the last quote stands, unchanged
+                last_quote[6] = 0;
+                last_quote[8] = 0;
+                mids[k] = mids[k - 1];
+            }
+            if (!quoted) {
+                continue;
+            }
+            float *row = unit.rows.data() + k * width;
+            std::copy(last_quote.begin(), last_quote.end(), row);
+            row += last_quote.size();
+            window.advance(end_us / 1000 - 1);
+            for (std::size_t h = 0; h < config_.horizons_ms.size(); ++h) {
+                if (window.combine(h, summary) == 0) {
+                    row += TRAINING_TRADE_FEATURES.size();
+                    continue;
+                }
+                const TradeFeatures f = trade_features(summary);
+                *row++ = static_cast<float>(f.vwap);
+                *row++ = static_cast<float>(f.volume);
+                *row++ = static_cast<float>(f.trade_count);
+                *row++ = static_cast<float>(f.price_change_pct);
+                *row++ = static_cast<float>(f.price_volatility);
+                *row++ = static_cast<float>(f.volume_imbalance);
+            }
+        }
+        label_unit(unit, mids);
+        stats_.steps.fetch_add(unit.steps, std::memory_order_relaxed);
+        stats_.quotes.fetch_add(quote_rows, std::memory_order_relaxed);
+        stats_.trades.fetch_add(trade_rows, std::memory_order_relaxed);
+    }
+
+    // Steps from the first quote on, at their grid times
+    void label_unit(training_loader_detail::Unit &unit, const std::vector<double> &mids) const {
+        unit.labels.assign(unit.steps, std::numeric_limits<double>::quiet_NaN());
+        if (unit.first_valid >= unit.steps) {
+            return;
+        }
+        const std::size_t rows = unit.steps - unit.first_valid;
+        const int64_t step_us = config_.step_ms * 1000;
+        std::vector<int64_t> times(rows);
+        for (std::size_t k = 0; k < rows; ++k) {
+            times[k] = unit.start_us + static_cast<int64_t>(unit.first_valid + k + 1) * step_us;
+        }
+        const int64_t horizon_us = config_.label_horizon_ms * 1000;
+        const std::vector<ForwardLabelColumns> labels =
+            forward_labels(times.data(), mids.data() + unit.first_valid, rows, std::span(&horizon_us, 1));
+        std::copy(labels[0].forward_return.begin(), labels[0].forward_return.end(),
+                  unit.labels.begin() + static_cast<std::ptrdiff_t>(unit.first_valid));
+    }
+
+    // Caller holds mutex_
+    void list_samples(std::size_t u) {
+        const training_loader_detail::Unit &unit = units_[u];
+        for (std::size_t k = unit.first_valid + config_.window - 1; k < unit.steps; ++k) {
+            if (finite_bits(unit.labels[k])) {
+                samples_.push_back({static_cast<uint32_t>(u), static_cast<uint32_t>(k)});
+            }
+        }
+    }
+
+    // Caller holds mutex_
+    void start_epoch_locked(uint64_t epoch) {
+        epoch_ = epoch;
+        order_.resize(samples_.size());
+        std::iota(order_.begin(), order_.end(), 0);
+        if (config_.shuffle) {
+            std::mt19937_64 random(config_.seed + epoch);
+            std::shuffle(order_.begin(), order_.end(), random);
+        }
+        batches_ = config_.drop_last ? samples_.size() / config_.batch_size
+                                     : (samples_.size() + config_.batch_size - 1) / config_.batch_size;
+        next_batch_ = 0;
+        delivered_ = 0;
+        epoch_done_ = false;
+    }
+
+    // Caller holds mutex_
+    void rethrow_locked() const {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+    // Phase 2: take a free buffer, then the epoch's next batch number, so
+    // the batch next() waits for always has a buffer
+    void gather() {
+        const std::size_t width = names_.size();
+        const std::size_t sample_values = config_.window * width;
+        while (!stop_.load()) {
+            const auto waited = std::chrono::steady_clock::now();
+            std::size_t slot = 0;
+            if (!pool_->acquire(slot, stop_)) {
+                return;
+            }
+            stats_.stall_us.fetch_add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                                 std::chrono::steady_clock::now() - waited)
+                                                                 .count()),
+                                      std::memory_order_relaxed);
+            std::size_t index = 0;
+            std::size_t first = 0;
+            std::size_t rows = 0;
+            {
+                std::unique_lock lock(mutex_);
+                changed_.wait(lock, [&] { return stop_.load() || (assembled_ && next_batch_ < batches_); });
+                if (stop_.load()) {
+                    lock.unlock();
+                    pool_->recycle(slot);
+                    return;
+                }
+                index = next_batch_++;
+                first = index * config_.batch_size;
+                rows = std::min(config_.batch_size, samples_.size() - first);
+            }
+            float *features = pool_->features(slot);
+            float *labels = pool_->labels(slot);
+            int64_t *timestamps = pool_->timestamps_us(slot);
+            uint16_t *symbols = pool_->symbols(slot);
+            for (std::size_t r = 0; r < rows; ++r) {
+                const training_loader_detail::Sample sample = samples_[order_[first + r]];
+                const training_loader_detail::Unit &unit = units_[sample.unit];
+                // The window's rows are contiguous in the unit
+                std::memcpy(features + r * sample_values,
+                            unit.rows.data() + (sample.step + 1 - config_.window) * width,
+                            sample_values * sizeof(float));
+                labels[r] = static_cast<float>(unit.labels[sample.step]);
+                timestamps[r] = unit.start_us + static_cast<int64_t>(sample.step + 1) * config_.step_ms * 1000;
+                symbols[r] = unit.symbol;
+            }
+            {
+                std::lock_guard lock(mutex_);
+                ready_.push_back({index, TrainingBatch{slot, rows, features, labels, timestamps, symbols}});
+            }
+            changed_.notify_all();
+        }
+    }
+
+    const TrainingLoaderConfig config_;
+    std::vector<int32_t> days_;
+    std::vector<std::string> names_;
+    std::shared_ptr<TrainingBatchPool> pool_;
+    TrainingLoaderStats stats_;
+
+    // Written by one worker each until assembled_, then read-only
+    std::vector<training_loader_detail::Unit> units_;
+    std::atomic<std::size_t> next_unit_{0};
+    std::atomic<bool> stop_{false};
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::size_t assembled_workers_ = 0;
+    bool assembled_ = false;
+    std::exception_ptr error_;
+    // Fixed once assembled_
+    std::vector<training_loader_detail::Sample> samples_;
+    // The epoch's sample order; only changed while no batch is in progress
+    std::vector<std::size_t> order_;
+    uint64_t epoch_ = 0;
+    std::size_t batches_ = 0;
+    std::size_t next_batch_ = 0;
+    std::size_t delivered_ = 0;
+    bool epoch_done_ = false;
+    std::vector<Ready> ready_;
+    std::vector<std::thread> workers_;
+};
+
+#endif
@@ -0,0 +1,352 @@
+/*
+ * io_uring receive path for one connected socket.
+ *
+ * A single multishot IORING_OP_RECV stays armed on the socket and the
+ * kernel picks a buffer for each completion from a provided buffer ring
+ * (IORING_REGISTER_PBUF_RING): buffer_count buffers of buffer_size bytes
+ * in one mapping registered with the ring, so received bytes land in
+ * memory set up once per connection and one recv submission covers the
+ * whole connection. Readers copy straight out of the completed buffers
+ * (or let OpenSSL decrypt from them, see ws_client.h), and each buffer goes
+ * back to the kernel once read to the end. When the kernel runs out of
+ * buffers the multishot recv stops, and the next wait() re-arms it after
+ * the reader has handed some back.
+ *
+ * Talks to the kernel with raw syscalls (no liburing) and needs 6.0+ for
+ * multishot recv. The constructor throws std::runtime_error if the ring
+ * cannot be set up, so callers can fall back to plain recv. One thread
+ * only: the receive thread that created it.
+ */
+
+#ifndef _SBE_URING_RECV_H_
+#define _SBE_URING_RECV_H_
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct UringConfig {
+    // Rounded up to a power of two
+    unsigned buffer_count = 64;
+    std::size_t buffer_size = 16 * 1024;
+};
+
+class UringRecv {
+public:
+    UringRecv(int fd, const UringConfig &config)
+        : socket_fd_(fd), buffer_size_(config.buffer_size),
+          buffer_count_(std::bit_ceil(std::max(config.buffer_count, 2u))) {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_COOP_TASKRUN;
+        ring_fd_ = setup(RING_ENTRIES, params);
+        if (ring_fd_ < 0 && errno == EINVAL) {
+            // Kernels that predate the flags
+            params = {};
+            ring_fd_ = setup(RING_ENTRIES, params);
+        }
+        if (ring_fd_ < 0) {
+            throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+        }
+        try {
+            map_rings(params);
+            register_buffers();
+        } catch (...) {
+            release();
+            throw;
+        }
+        ready_.resize(buffer_count_);
+    }
+
+    ~UringRecv() { release(); }
+
+    UringRecv(const UringRecv &) = delete;
+    UringRecv &operator=(const UringRecv &) = delete;
+
+    // True when received bytes (or the end of the stream) are ready within
+    // `timeout_ms`; negative waits indefinitely, 0 only polls
+    bool wait(int timeout_ms) {
+        if (ready()) {
+            return true;
+        }
+        reap();
+        if (ready()) {
+            return true;
+        }
+        unsigned submit = 0;
+        if (!armed_) {
+            queue_recv();
+            submit = 1;
+        }
+        enter(submit, timeout_ms);
+        reap();
+        return ready();
+    }
+
+    // Copy up to `size` received bytes into `dst`, waiting for some if none
+    // are ready. Returns 0 at the end of the stream; throws on socket errors.
+    std::size_t read(char *dst, std::size_t size) {
+        while (!ready()) {
+            wait(-1);
+        }
+        if (ready_count_ == 0 && error_ != 0) {
+            throw std::runtime_error(std::string("ws read failed: ") + std::strerror(error_));
+        }
+        std::size_t copied = 0;
+        while (copied < size && ready_count_ > 0) {
+            Completion &front = ready_[ready_head_];
+            const std::size_t n = std::min(size - copied, std::size_t{front.size - front.offset});
+            std::memcpy(dst + copied, buffer(front.id) + front.offset, n);
+            copied += n;
+            front.offset += static_cast<uint32_t>(n);
+            if (front.offset == front.size) {
+                recycle(front.id);
+                ready_head_ = (ready_head_ + 1) & (buffer_count_ - 1);
+                --ready_count_;
+            }
+        }
+        return copied;
+    }
+
+    // Received bytes not yet read
+    std::size_t buffered() const {
+        std::size_t bytes = 0;
+        for (unsigned i = 0; i < ready_count_; ++i) {
+            const Completion &c = ready_[(ready_head_ + i) & (buffer_count_ - 1)];
+            bytes += c.size - c.offset;
+        }
+        return bytes;
+    }
+
+    bool eof() const { return eof_ && ready_count_ == 0; }
+    // errno of a failed recv, 0 if none
+    int error() const { return error_; }
+    // recv submissions so far: 1 plus one per re-arm after running out of buffers
+    uint64_t submissions() const { return submissions_; }
+    // The ring, which polls readable while completions are waiting
+    int fd() const { return ring_fd_; }
+
+private:
+    static constexpr unsigned RING_ENTRIES = 4;
+    static constexpr uint16_t BUFFER_GROUP = 0;
+    static constexpr uint64_t RECV_TAG = 1;
+
+    // A completed recv: `size` bytes in buffer `id`, `offset` of them read
+    struct Completion {
+        uint16_t id;
+        uint32_t size;
+        uint32_t offset;
+    };
+
+    static int setup(unsigned entries, io_uring_params &params) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    }
+
+    bool ready() const { return ready_count_ > 0 || eof_ || error_ != 0; }
+
+    char *buffer(uint16_t id) const { return buffers_ + std::size_t{id} * buffer_size_; }
+
+    void map_rings(const io_uring_params &params) {
+        sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+        }
+        sq_map_ = map(sq_map_size_, IORING_OFF_SQ_RING);
+        cq_map_ = params.features & IORING_FEAT_SINGLE_MMAP ? sq_map_ : map(cq_map_size_, IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(map(sqes_size_, IORING_OFF_SQES));
+
+        char *sq = static_cast<char *>(sq_map_);
+        char *cq = static_cast<char *>(cq_map_);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    void *map(std::size_t size, off_t offset) {
+        void *base = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+        if (base == MAP_FAILED) {
+            throw std::runtime_error(std::string("io_uring mmap failed: ") + std::strerror(errno));
+        }
+        return base;
+    }
+
+    // One anonymous mapping: the buffer ring's page, then the buffers
+    void register_buffers() {
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        ring_bytes_ = (buffer_count_ * sizeof(io_uring_buf) + page - 1) / page * page;
+        buffers_size_ = ring_bytes_ + std::size_t{buffer_count_} * buffer_size_;
+        void *base = ::mmap(nullptr, buffers_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+                            -1, 0);
+        if (base == MAP_FAILED) {
+            buffers_size_ = 0;
+            throw std::runtime_error(std::string("io_uring buffer mmap failed: ") + std::strerror(errno));
+        }
+        buffers_base_ = base;
+        // Not io_uring_buf_ring::bufs: its flex-array wrapper holds an empty
+        // struct, which takes a byte in C++ and moves bufs to offset 8. The
+        // kernel's layout is plain slots with the tail in slot 0's resv.
+        buf_slots_ = static_cast<io_uring_buf *>(base);
+        buf_ring_tail_ = &buf_slots_[0].resv;
+        buffers_ = static_cast<char *>(base) + ring_bytes_;
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(base);
+        reg.ring_entries = buffer_count_;
+        reg.bgid = BUFFER_GROUP;
+        if (::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            throw std::runtime_error(std::string("io_uring buffer ring registration failed: ") + std::strerror(errno));
+        }
+        for (unsigned id = 0; id < buffer_count_; ++id) {
+            recycle(static_cast<uint16_t>(id));
+        }
+    }
+
+    // Hand buffer `id` back to the kernel
+    void recycle(uint16_t id) {
+        io_uring_buf &slot = buf_slots_[buf_tail_ & (buffer_count_ - 1)];
+        slot.addr = reinterpret_cast<uint64_t>(buffer(id));
+        slot.len = static_cast<uint32_t>(buffer_size_);
+        slot.bid = id;
+        ++buf_tail_;
+        std::atomic_ref<uint16_t>(*buf_ring_tail_).store(buf_tail_, std::memory_order_release);
+    }
+
+    void queue_recv() {
+        const unsigned tail = *sq_tail_;
+        const unsigned index = tail & sq_mask_;
+        io_uring_sqe &sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_RECV;
+        sqe.fd = socket_fd_;
+        sqe.ioprio = IORING_RECV_MULTISHOT;
+        sqe.flags = IOSQE_BUFFER_SELECT;
+        sqe.buf_group = BUFFER_GROUP;
+        sqe.user_data = RECV_TAG;
+        sq_array_[index] = index;
+        std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1, std::memory_order_release);
+        armed_ = true;
+        ++submissions_;
+    }
+
+    // Submit and wait for one completion, up to timeout_ms
+    void enter(unsigned submit, int timeout_ms) {
+        unsigned flags = IORING_ENTER_GETEVENTS;
+        unsigned min_complete = 0;
+        __kernel_timespec timeout{};
+        io_uring_getevents_arg arg{};
+        void *argp = nullptr;
+        std::size_t argsz = 0;
+        if (timeout_ms != 0) {
+            min_complete = 1;
+            if (timeout_ms > 0) {
+                timeout.tv_sec = timeout_ms / 1000;
+                timeout.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+                arg.sigmask_sz = _NSIG / 8;
+                arg.ts = reinterpret_cast<uint64_t>(&timeout);
+                flags |= IORING_ENTER_EXT_ARG;
+                argp = &arg;
+                argsz = sizeof(arg);
+            }
+        }
+        if (::syscall(__NR_io_uring_enter, ring_fd_, submit, min_complete, flags, argp, argsz) < 0 && errno != ETIME &&
+            errno != EINTR && errno != EBUSY) {
+            throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+        }
+    }
+
+    void reap() {
+        unsigned head = *cq_head_;
+        const unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+            if ((cqe.flags & IORING_CQE_F_MORE) == 0) {
+                armed_ = false;
+            }
+            if (cqe.res > 0) {
+                const auto id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                ready_[(ready_head_ + ready_count_) & (buffer_count_ - 1)] = {id, static_cast<uint32_t>(cqe.res), 0};
+                ++ready_count_;
+            } else if (cqe.res == 0) {
+                eof_ = true;
+            } else if (cqe.res != -ENOBUFS) {
+                // Out of buffers only pauses the recv until the reader hands some back
+                error_ = -cqe.res;
+            }
+        }
+        std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+    }
+
+    void release() {
+        if (buffers_size_ > 0) {
+            ::munmap(buffers_base_, buffers_size_);
+        }
+        if (sqes_ != nullptr) {
+            ::munmap(sqes_, sqes_size_);
+        }
+        if (cq_map_ != nullptr && cq_map_ != sq_map_) {
+            ::munmap(cq_map_, cq_map_size_);
+        }
+        if (sq_map_ != nullptr) {
+            ::munmap(sq_map_, sq_map_size_);
+        }
+        // Closing the ring cancels the armed recv
+        if (ring_fd_ >= 0) {
+            ::close(ring_fd_);
+        }
+    }
+
+    const int socket_fd_;
+    const std::size_t buffer_size_;
+    const unsigned buffer_count_;
+    int ring_fd_ = -1;
+
+    void *sq_map_ = nullptr;
+    void *cq_map_ = nullptr;
+    std::size_t sq_map_size_ = 0;
+    std::size_t cq_map_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+
+    void *buffers_base_ = nullptr;
+    std::size_t buffers_size_ = 0;
+    std::size_t ring_bytes_ = 0;
+    io_uring_buf *buf_slots_ = nullptr;
+    uint16_t *buf_ring_tail_ = nullptr;
+    char *buffers_ = nullptr;
+    uint16_t buf_tail_ = 0;
+
+    // Completed recvs in arrival order; at most one per buffer
+    std::vector<Completion> ready_;
+    unsigned ready_head_ = 0;
+    unsigned ready_count_ = 0;
+    bool armed_ = false;
+    bool eof_ = false;
+    int error_ = 0;
+    uint64_t submissions_ = 0;
+};
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Binary checkpoints of MultiHorizonWindow state for warm restarts.
+ *
+ * A window's features depend on up to its longest horizon of trades, so a
+ * restarted aggregator would publish wrong features until its windows had
+ * refilled. A checkpoint stores every window's panes as they sit in the
+ * ring, with its horizons, pane width, newest pane and late-drop count,
+ * plus an opaque metadata blob the caller uses for its stream position
+ * (e.g. Kinesis sequence numbers as JSON). Restoring copies the panes back
+ * and the caller resumes reading after the saved position, so only the
+ * tail since the checkpoint is replayed and no trade is counted twice.
+ *
+ * Layout: a 64-byte WindowCheckpointHeader, `windows` 80-byte
+ * WindowCheckpointEntry records, the horizons of every window as int64
+ * milliseconds, their panes as MultiHorizonWindow::Pane, then the metadata.
+ * Files are replaced atomically and read in place (checkpoint_file.h).
+ */
+
+#ifndef _SBE_WINDOW_CHECKPOINT_H_
+#define _SBE_WINDOW_CHECKPOINT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "checkpoint_file.h"
+#include "multi_horizon.h"
+
+constexpr char WINDOW_CHECKPOINT_MAGIC[8] = {'S', 'B', 'E', 'W', 'I', 'N', 'D', '1'};
+constexpr uint32_t WINDOW_CHECKPOINT_VERSION = 1;
+
+struct WindowCheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t written_us;
+    uint32_t windows;
+    uint32_t entry_size;
+    // Totals of the horizon and pane arrays after the entries
+    uint64_t horizons;
+    uint64_t panes;
+    uint32_t pane_size;
+    uint32_t reserved;
+    // Metadata bytes after the panes
+    uint64_t meta_size;
+};
+static_assert(sizeof(WindowCheckpointHeader) == 64);
+
+struct WindowCheckpointEntry {
+    // NUL-padded
+    char key[32];
+    int64_t pane_ms;
+    int64_t current_pane;
+    uint64_t late_drops;
+    // Indexes into the horizon and pane arrays
+    uint64_t first_horizon;
+    uint32_t horizon_count;
+    uint32_t pane_count;
+    uint64_t first_pane;
+};
+static_assert(sizeof(WindowCheckpointEntry) == 80);
+static_assert(std::is_trivially_copyable_v<MultiHorizonWindow::Pane>);
+
+struct WindowCheckpointItem {
+    std::string_view key;
+    const MultiHorizonWindow *window;
+};
+
+// Write `windows` and `meta` to `path`. Throws std::runtime_error on I/O
+// errors or a key over 32 bytes.
+inline void write_window_checkpoint(const std::string &path, std::span<const WindowCheckpointItem> windows,
+                                    std::span<const char> meta, uint64_t written_us) {
+    using Pane = MultiHorizonWindow::Pane;
+    uint64_t horizons = 0;
+    uint64_t panes = 0;
+    for (const auto &item : windows) {
+        if (item.key.size() > sizeof(WindowCheckpointEntry::key)) {
+            throw std::runtime_error("window checkpoint: key longer than 32 bytes: " + std::string(item.key));
+        }
+        horizons += item.window->horizons_ms().size();
+        panes += item.window->pane_count();
+    }
+
+    WindowCheckpointHeader header{};
+    std::memcpy(header.magic, WINDOW_CHECKPOINT_MAGIC, sizeof(WINDOW_CHECKPOINT_MAGIC));
+    header.version = WINDOW_CHECKPOINT_VERSION;
+    header.header_size = sizeof(WindowCheckpointHeader);
+    header.written_us = written_us;
+    header.windows = static_cast<uint32_t>(windows.size());
+    header.entry_size = sizeof(WindowCheckpointEntry);
+    header.horizons = horizons;
+    header.panes = panes;
+    header.pane_size = sizeof(Pane);
+    header.meta_size = meta.size();
+
+    std::vector<char> out(sizeof(WindowCheckpointHeader) + windows.size() * sizeof(WindowCheckpointEntry) +
+                          horizons * sizeof(int64_t) + panes * sizeof(Pane) + meta.size());
+    std::memcpy(out.data(), &header, sizeof(header));
+    auto *entry = reinterpret_cast<WindowCheckpointEntry *>(out.data() + sizeof(WindowCheckpointHeader));
+    auto *horizon_out = reinterpret_cast<int64_t *>(entry + windows.size());
+    auto *pane_out = reinterpret_cast<Pane *>(horizon_out + horizons);
+    uint64_t next_horizon = 0;
+    uint64_t next_pane = 0;
+    for (const auto &item : windows) {
+        const MultiHorizonWindow &window = *item.window;
+        *entry = WindowCheckpointEntry{};
+        std::memcpy(entry->key, item.key.data(), item.key.size());
+        entry->pane_ms = window.pane_ms();
+        entry->current_pane = window.current_pane();
+        entry->late_drops = window.late_drops();
+        entry->first_horizon = next_horizon;
+        entry->horizon_count = static_cast<uint32_t>(window.horizons_ms().size());
+        entry->pane_count = static_cast<uint32_t>(window.pane_count());
+        entry->first_pane = next_pane;
+        for (const int64_t horizon : window.horizons_ms()) {
+            horizon_out[next_horizon++] = horizon;
+        }
+        std::memcpy(pane_out + next_pane, window.panes().data(), window.pane_count() * sizeof(Pane));
+        next_pane += window.pane_count();
+        ++entry;
+    }
+    if (!meta.empty()) {
+        std::memcpy(pane_out + panes, meta.data(), meta.size());
+    }
+    write_checkpoint_file(path, out);
+}
+
+// Read-only view of a window checkpoint file
+class WindowCheckpoint {
+public:
+    using Pane = MultiHorizonWindow::Pane;
+
+    // Map and validate `path`; throws std::runtime_error if it is missing
+    // or not a complete checkpoint
+    explicit WindowCheckpoint(const std::string &path) : file_(path, sizeof(WindowCheckpointHeader)) {
+        const WindowCheckpointHeader &h = header();
+        if (std::memcmp(h.magic, WINDOW_CHECKPOINT_MAGIC, sizeof(WINDOW_CHECKPOINT_MAGIC)) != 0 ||
+            h.version != WINDOW_CHECKPOINT_VERSION || h.header_size != sizeof(WindowCheckpointHeader) ||
+            h.entry_size != sizeof(WindowCheckpointEntry) || h.pane_size != sizeof(Pane)) {
+            throw std::runtime_error("not a window checkpoint: " + path);
+        }
+        // Each array must fit in what is left of the file after the ones before
+        uint64_t left = file_.size() - sizeof(WindowCheckpointHeader);
+        const auto take = [&](uint64_t count, uint64_t size) {
+            if (count > left / size) {
+                throw std::runtime_error("truncated window checkpoint: " + path);
+            }
+            left -= count * size;
+        };
+        take(h.windows, sizeof(WindowCheckpointEntry));
+        take(h.horizons, sizeof(int64_t));
+        take(h.panes, sizeof(Pane));
+        take(h.meta_size, 1);
+        for (const auto &e : entries()) {
+            if (e.first_horizon > h.horizons || e.horizon_count > h.horizons - e.first_horizon ||
+                e.first_pane > h.panes || e.pane_count > h.panes - e.first_pane) {
+                throw std::runtime_error("corrupt window checkpoint: " + path);
+            }
+        }
+    }
+
+    const WindowCheckpointHeader &header() const {
+        return *reinterpret_cast<const WindowCheckpointHeader *>(file_.data());
+    }
+    uint64_t written_us() const { return header().written_us; }
+    std::size_t size() const { return header().windows; }
+
+    std::span<const WindowCheckpointEntry> entries() const {
+        return {reinterpret_cast<const WindowCheckpointEntry *>(file_.data() + sizeof(WindowCheckpointHeader)),
+                size()};
+    }
+
+    static std::string_view key_of(const WindowCheckpointEntry &entry) {
+        return {entry.key, strnlen(entry.key, sizeof(entry.key))};
+    }
+
+    // Index of `key`'s entry, or -1
+    int64_t find(std::string_view key) const {
+        const auto all = entries();
+        for (std::size_t i = 0; i < all.size(); ++i) {
+            if (key_of(all[i]) == key) {
+                return static_cast<int64_t>(i);
+            }
+        }
+        return -1;
+    }
+
+    std::span<const int64_t> horizons_ms(std::size_t index) const {
+        const WindowCheckpointEntry &entry = entries()[index];
+        return {horizon_array() + entry.first_horizon, entry.horizon_count};
+    }
+
+    // Entry `index` was saved from a window of `window`'s horizons and pane
+    bool matches(std::size_t index, const MultiHorizonWindow &window) const {
+        const WindowCheckpointEntry &entry = entries()[index];
+        const auto saved = horizons_ms(index);
+        return entry.pane_ms == window.pane_ms() && entry.pane_count == window.pane_count() &&
+               std::equal(saved.begin(), saved.end(), window.horizons_ms().begin(), window.horizons_ms().end());
+    }
+
+    // Restore entry `index` into `window`; false, leaving it untouched,
+    // unless it matches()
+    bool load(std::size_t index, MultiHorizonWindow &window) const {
+        if (!matches(index, window)) {
+            return false;
+        }
+        const WindowCheckpointEntry &entry = entries()[index];
+        window.restore(entry.current_pane, entry.late_drops, {pane_array() + entry.first_pane, entry.pane_count});
+        return true;
+    }
+
+    std::span<const char> meta() const {
+        return {reinterpret_cast<const char *>(pane_array() + header().panes), header().meta_size};
+    }
+
+private:
+    const int64_t *horizon_array() const {
+        return reinterpret_cast<const int64_t *>(file_.data() + sizeof(WindowCheckpointHeader) +
+                                                 size() * sizeof(WindowCheckpointEntry));
+    }
+    const Pane *pane_array() const { return reinterpret_cast<const Pane *>(horizon_array() + header().horizons); }
+
+    MappedCheckpoint file_;
+};
+
+#endif
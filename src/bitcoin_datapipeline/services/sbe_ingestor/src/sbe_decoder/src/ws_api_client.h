@@ -0,0 +1,524 @@
+/*
+ * Pipelined client for the Binance WebSocket API with SBE responses.
+ *
+ * Backfill (depth snapshots, aggTrades and klines pages) used to cost one
+ * REST round trip per page. WsApiClient keeps one WebSocket API connection
+ * open (WebSocketClient, see ws_client.h) and up to max_in_flight requests
+ * outstanding on it, so pages come back at the connection's bandwidth
+ * rather than one per round trip:
+ *
+ *   - submit() sends {"id":N,"method":...,"params":{...}} as a text frame;
+ *     the id carries the index of the request's pending slot in its low 16
+ *     bits, so a response finds its request without a lookup table
+ *   - with responseFormat=sbe each response is a binary WebSocketResponse
+ *     (template 50): a status, the rate limits the request counted against
+ *     with their current usage, the request id, and the result, an SBE
+ *     message of its own (DepthResponse, AggTradesResponse, KlinesResponse,
+ *     ErrorResponse when the status is not 200)
+ *   - parse_ws_api_envelope() reads that envelope in place: the id and the
+ *     result are views into the frame, and a WsApiResponse takes the frame
+ *     buffer over instead of copying it, so the result reaches the decoder
+ *     without a copy
+ *
+ * Responses arrive in whatever order the server finishes them; fetch_all()
+ * keeps the window full over a list of requests and hands the responses
+ * back in request order. A request the server could not parse is answered
+ * in JSON even in SBE mode; it comes back with json set and the text as
+ * its result. Failures throw std::runtime_error; the caller owns
+ * reconnecting and resubmitting what was in flight. Calls are serialized
+ * by a mutex, since reading may answer a ping on the same socket.
+ *
+ * A governed client (the default) paces its requests through the
+ * process-wide rate_governor() (rate_governor.h), charging each request's
+ * weight before sending it, and reports every response's rate-limit usage
+ * and any 429/418 retry-after back to it. fetch_all() keeps reading
+ * responses while the governor holds the next request back.
+ */
+
+#ifndef _SBE_WS_API_CLIENT_H_
+#define _SBE_WS_API_CLIENT_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "official/util.h"
+#include "rate_governor.h"
+#include "spot_sbe/ErrorResponse.h"
+#include "spot_sbe/GroupSize16Encoding.h"
+#include "spot_sbe/MessageHeader.h"
+#include "spot_sbe/WebSocketResponse.h"
+#include "stream_decode.h"
+#include "ws_client.h"
+
+constexpr uint16_t WS_API_RESPONSE_TEMPLATE = spot_sbe::WebSocketResponse::SBE_TEMPLATE_ID;
+// A request counts against a handful of limits; entries past this are skipped
+constexpr std::size_t WS_API_MAX_RATE_LIMITS = 8;
+// Request ids keep the pending slot in their low bits
+constexpr int WS_API_SLOT_BITS = 16;
+constexpr std::size_t WS_API_MAX_IN_FLIGHT = std::size_t{1} << WS_API_SLOT_BITS;
+
+struct WsApiRateLimit {
+    spot_sbe::RateLimitType::Value type = spot_sbe::RateLimitType::NULL_VALUE;
+    spot_sbe::RateLimitInterval::Value interval = spot_sbe::RateLimitInterval::NULL_VALUE;
+    uint8_t interval_num = 0;
+    int64_t limit = 0;
+    int64_t current = 0;
+};
+
+// One WebSocketResponse, viewing the frame it was read from
+struct WsApiEnvelope {
+    uint16_t status = 0;
+    std::array<WsApiRateLimit, WS_API_MAX_RATE_LIMITS> rate_limits{};
+    std::size_t rate_limit_count = 0;
+    std::string_view id;
+    // The embedded SBE message, its header included
+    std::span<char> result;
+};
+
+// The envelope of the WebSocketResponse in `frame` (message header
+// included). Throws std::runtime_error if the frame is not a
+// WebSocketResponse of the expected schema or is truncated.
+inline WsApiEnvelope parse_ws_api_envelope(std::span<char> frame) {
+    using spot_sbe::WebSocketResponse;
+    if (frame.size() < spot_sbe::MessageHeader::encodedLength()) {
+        throw std::runtime_error("Buffer too short for message header");
+    }
+    spot_sbe::MessageHeader header(frame.data(), frame.size());
+    if (header.schemaId() != EXPECTED_SCHEMA_ID) {
+        throw std::runtime_error("Unexpected schema id " + std::to_string(header.schemaId()));
+    }
+    if (header.templateId() != WS_API_RESPONSE_TEMPLATE) {
+        throw std::runtime_error("Expected WebSocketResponse (template 50), got template " +
+                                 std::to_string(header.templateId()));
+    }
+    if (frame.size() < spot_sbe::MessageHeader::encodedLength() + header.blockLength() ||
+        header.blockLength() < WebSocketResponse::sbeBlockLength()) {
+        throw std::runtime_error("WebSocketResponse shorter than its block");
+    }
+    auto response = message_from_header<WebSocketResponse>(frame, header);
+
+    WsApiEnvelope envelope;
+    envelope.status = response.status();
+    // The group's fields are read at fixed offsets, so its entries must be
+    // at least as long as this schema's
+    const spot_sbe::GroupSize16Encoding dimensions(frame.data(), response.sbePosition(), frame.size(),
+                                                   header.version());
+    if (dimensions.numInGroup() > 0 && dimensions.blockLength() < WebSocketResponse::RateLimits::sbeBlockLength()) {
+        throw std::runtime_error("WebSocketResponse rate limit entries shorter than their block");
+    }
+    auto &limits = response.rateLimits();
+    while (limits.hasNext()) {
+        limits.next();
+        if (envelope.rate_limit_count < WS_API_MAX_RATE_LIMITS) {
+            envelope.rate_limits[envelope.rate_limit_count++] = {limits.rateLimitType(), limits.interval(),
+                                                                 limits.intervalNum(), limits.rateLimit(),
+                                                                 limits.current()};
+        }
+    }
+    envelope.id = response.getIdAsStringView();
+    const std::string_view result = response.getResultAsStringView();
+    envelope.result = {const_cast<char *>(result.data()), result.size()};
+    return envelope;
+}
+
+// The retryAfter (epoch ms) of an ErrorResponse result, 0 if it has none
+// or is not one
+inline int64_t ws_api_retry_after_ms(std::span<char> result) {
+    using spot_sbe::ErrorResponse;
+    if (result.size() < spot_sbe::MessageHeader::encodedLength()) {
+        return 0;
+    }
+    spot_sbe::MessageHeader header(result.data(), result.size());
+    if (header.templateId() != ErrorResponse::SBE_TEMPLATE_ID ||
+        header.blockLength() < ErrorResponse::sbeBlockLength() ||
+        result.size() < spot_sbe::MessageHeader::encodedLength() + header.blockLength()) {
+        return 0;
+    }
+    const int64_t retry_after = message_from_header<ErrorResponse>(result, header).retryAfter();
+    return retry_after == ErrorResponse::retryAfterNullValue() ? 0 : retry_after;
+}
+
+// One answered request. Owns the frame its envelope views; moving keeps
+// the views valid, copying would not, so it is move-only.
+struct WsApiResponse {
+    uint64_t request_id = 0;
+    // fetch_all(): the request's index in its list
+    std::size_t index = 0;
+    // Submit to response
+    int64_t latency_us = 0;
+    // A JSON error answer rather than a WebSocketResponse; result is its text
+    bool json = false;
+    WsApiEnvelope envelope;
+    std::vector<char> frame;
+
+    WsApiResponse() = default;
+    WsApiResponse(WsApiResponse &&) = default;
+    WsApiResponse &operator=(WsApiResponse &&) = default;
+    WsApiResponse(const WsApiResponse &) = delete;
+    WsApiResponse &operator=(const WsApiResponse &) = delete;
+
+    uint16_t status() const { return envelope.status; }
+    std::span<const char> result() const { return envelope.result; }
+};
+
+struct WsApiRequest {
+    std::string method;
+    // The params object as JSON text; empty sends none
+    std::string params;
+    // Request weight charged to the rate governor
+    int64_t weight = 1;
+};
+
+struct WsApiConfig {
+    std::string host = "ws-api.binance.com";
+    uint16_t port = 443;
+    std::string path = "/ws-api/v3?responseFormat=sbe&sbeSchemaId=" +
+                       std::to_string(spot_sbe::WebSocketResponse::SBE_SCHEMA_ID) +
+                       "&sbeSchemaVersion=" + std::to_string(spot_sbe::WebSocketResponse::SBE_SCHEMA_VERSION);
+    bool use_tls = true;
+    std::string api_key;
+    std::string user_agent = "bitcoin-pipeline-sbe/1.0";
+    std::size_t max_in_flight = 32;
+    std::size_t max_message_size = 16 << 20;
+    // Longest wait for the next response before giving up on the connection
+    int response_timeout_ms = 10000;
+    // Pace requests through rate_governor() and report usage back to it
+    bool governed = true;
+};
+
+// Written under the client's mutex, readable from any thread
+struct WsApiStats {
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> responses{0};
+    // Status other than 200, or a JSON error answer
+    std::atomic<uint64_t> errors{0};
+    // Answers whose id matches no pending request
+    std::atomic<uint64_t> unmatched{0};
+    std::atomic<uint64_t> bytes_received{0};
+    std::atomic<std::size_t> in_flight{0};
+    std::atomic<std::size_t> max_in_flight_seen{0};
+};
+
+class WsApiClient {
+public:
+    explicit WsApiClient(WsApiConfig config) : config_(std::move(config)) {
+        if (config_.max_in_flight == 0 || config_.max_in_flight > WS_API_MAX_IN_FLIGHT) {
+            throw std::invalid_argument("max_in_flight must be between 1 and " +
+                                        std::to_string(WS_API_MAX_IN_FLIGHT));
+        }
+        slots_.resize(config_.max_in_flight);
+        free_slots_.reserve(config_.max_in_flight);
+        for (std::size_t slot = config_.max_in_flight; slot-- > 0;) {
+            free_slots_.push_back(static_cast<uint32_t>(slot));
+        }
+    }
+
+    WsApiClient(const WsApiClient &) = delete;
+    WsApiClient &operator=(const WsApiClient &) = delete;
+
+    const WsApiConfig &config() const { return config_; }
+
+    void connect() {
+        std::lock_guard lock(mutex_);
+        WsEndpoint endpoint;
+        endpoint.host = config_.host;
+        endpoint.port = config_.port;
+        endpoint.path = config_.path;
+        endpoint.use_tls = config_.use_tls;
+        endpoint.max_message_size = config_.max_message_size;
+        endpoint.headers.emplace_back("User-Agent", config_.user_agent);
+        if (!config_.api_key.empty()) {
+            endpoint.headers.emplace_back("X-MBX-APIKEY", config_.api_key);
+        }
+        abandon_pending();
+        ws_.connect(endpoint);
+    }
+
+    bool connected() const { return ws_.connected(); }
+
+    // Drops the connection; requests still in flight are forgotten
+    void close() {
+        std::lock_guard lock(mutex_);
+        ws_.close();
+        abandon_pending();
+    }
+
+    std::size_t in_flight() const { return stats_.in_flight.load(std::memory_order_relaxed); }
+    bool window_full() const { return in_flight() == slots_.size(); }
+    const WsApiStats &stats() const { return stats_; }
+
+    // Sends a request and returns its id, first waiting for the governor to
+    // grant its weight. Throws std::runtime_error when the window is full
+    // (receive() first) and std::invalid_argument for a method name that is
+    // not plain [A-Za-z0-9.].
+    uint64_t submit(std::string_view method, std::string_view params, int64_t weight = 1) {
+        std::lock_guard lock(mutex_);
+        check_submit(method);
+        while (const int64_t wait = reserve(weight)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+        }
+        return send_locked(method, params, 0);
+    }
+
+    // The next response, or std::nullopt if none arrived within timeout_ms
+    std::optional<WsApiResponse> receive(int timeout_ms) {
+        std::lock_guard lock(mutex_);
+        return receive_locked(timeout_ms);
+    }
+
+    // Every request's response, in request order, keeping up to
+    // max_in_flight of them outstanding. Throws std::runtime_error if the
+    // server goes quiet for response_timeout_ms with requests pending.
+    std::vector<WsApiResponse> fetch_all(std::span<const WsApiRequest> requests) {
+        std::lock_guard lock(mutex_);
+        for (const WsApiRequest &request : requests) {
+            check_submit(request.method);
+        }
+        std::vector<WsApiResponse> responses(requests.size());
+        std::size_t next = 0;
+        std::size_t done = 0;
+        auto last_response = Clock::now();
+        while (done < requests.size()) {
+            int64_t held_ms = 0;
+            while (next < requests.size() && !free_slots_.empty()) {
+                if ((held_ms = reserve(requests[next].weight)) > 0) {
+                    break;
+                }
+                send_locked(requests[next].method, requests[next].params, next);
+                ++next;
+            }
+            if (free_slots_.size() == slots_.size()) {
+                // Nothing in flight: only the governor is holding the next request
+                std::this_thread::sleep_for(std::chrono::milliseconds(held_ms));
+                last_response = Clock::now();
+                continue;
+            }
+            const int timeout_ms =
+                held_ms > 0 ? static_cast<int>(std::min<int64_t>(held_ms, config_.response_timeout_ms))
+                            : config_.response_timeout_ms;
+            std::optional<WsApiResponse> response = receive_locked(timeout_ms);
+            if (!response) {
+                if (Clock::now() - last_response < std::chrono::milliseconds(config_.response_timeout_ms)) {
+                    continue;
+                }
+                throw std::runtime_error("ws api: no response within " + std::to_string(config_.response_timeout_ms) +
+                                         " ms, " + std::to_string(slots_.size() - free_slots_.size()) +
+                                         " requests pending");
+            }
+            last_response = Clock::now();
+            if (response->request_id != 0) {
+                const std::size_t index = response->index;
+                responses[index] = std::move(*response);
+                ++done;
+            }
+        }
+        return responses;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        uint64_t request_id = 0; // 0 while the slot is free
+        std::size_t index = 0;
+        Clock::time_point sent;
+    };
+
+    static bool plain_method(std::string_view method) {
+        return !method.empty() && std::all_of(method.begin(), method.end(), [](char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.';
+        });
+    }
+
+    void check_submit(std::string_view method) const {
+        if (!plain_method(method)) {
+            throw std::invalid_argument("ws api: invalid method name '" + std::string(method) + "'");
+        }
+        if (free_slots_.empty()) {
+            throw std::runtime_error("ws api: " + std::to_string(slots_.size()) + " requests already in flight");
+        }
+    }
+
+    // 0 once the governor has charged `weight`, else the ms it is held back
+    int64_t reserve(int64_t weight) {
+        return config_.governed ? rate_governor().reserve(weight, rate_governor_now_ms()) : 0;
+    }
+
+    // Reports a response's usage, and a rate-limit refusal's retry-after,
+    // to the governor
+    void report(const WsApiResponse &response) {
+        if (!config_.governed) {
+            return;
+        }
+        RateGovernor &governor = rate_governor();
+        const int64_t now_ms = rate_governor_now_ms();
+        const WsApiEnvelope &envelope = response.envelope;
+        for (std::size_t i = 0; i < envelope.rate_limit_count; ++i) {
+            const WsApiRateLimit &limit = envelope.rate_limits[i];
+            governor.observe({limit.type, limit.interval, limit.interval_num, limit.limit}, limit.current, now_ms);
+        }
+        if (envelope.status == 429 || envelope.status == 418) {
+            int64_t retry_after = 0;
+            if (response.json) {
+                const std::string_view text = json_digits({envelope.result.data(), envelope.result.size()},
+                                                          "\"retryAfter\":");
+                std::from_chars(text.data(), text.data() + text.size(), retry_after);
+            } else {
+                retry_after = ws_api_retry_after_ms(envelope.result);
+            }
+            if (retry_after > now_ms) {
+                governor.back_off(retry_after);
+            }
+        }
+    }
+
+    uint64_t send_locked(std::string_view method, std::string_view params, std::size_t index) {
+        const uint32_t slot = free_slots_.back();
+        const uint64_t request_id = (++sequence_ << WS_API_SLOT_BITS) | slot;
+
+        request_.clear();
+        request_ += "{\"id\":";
+        char digits[24];
+        request_.append(digits, std::to_chars(digits, digits + sizeof(digits), request_id).ptr);
+        request_ += ",\"method\":\"";
+        request_ += method;
+        request_ += '"';
+        if (!params.empty()) {
+            request_ += ",\"params\":";
+            request_ += params;
+        }
+        request_ += '}';
+        ws_.send_text(request_);
+
+        free_slots_.pop_back();
+        slots_[slot] = {request_id, index, Clock::now()};
+        const std::size_t in_flight = slots_.size() - free_slots_.size();
+        stats_.in_flight.store(in_flight, std::memory_order_relaxed);
+        stats_.requests.fetch_add(1, std::memory_order_relaxed);
+        if (in_flight > stats_.max_in_flight_seen.load(std::memory_order_relaxed)) {
+            stats_.max_in_flight_seen.store(in_flight, std::memory_order_relaxed);
+        }
+        return request_id;
+    }
+
+    std::optional<WsApiResponse> receive_locked(int timeout_ms) {
+        const auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (true) {
+            const auto remaining =
+                std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            if (!ws_.wait_readable(static_cast<int>(std::max<int64_t>(remaining, 0)))) {
+                return std::nullopt;
+            }
+            const WsOpcode opcode = ws_.read_message(buffer_);
+            if (opcode == WsOpcode::Close) {
+                throw std::runtime_error("ws api: connection closed by server");
+            }
+            if (opcode != WsOpcode::Binary && opcode != WsOpcode::Text) {
+                continue; // ping (answered inside read_message) or pong
+            }
+            stats_.bytes_received.fetch_add(buffer_.size(), std::memory_order_relaxed);
+
+            WsApiResponse response;
+            response.frame = std::move(buffer_);
+            buffer_ = std::vector<char>{};
+            const std::span<char> frame{response.frame.data(), response.frame.size()};
+            if (opcode == WsOpcode::Binary) {
+                response.envelope = parse_ws_api_envelope(frame);
+            } else {
+                response.json = true;
+                response.envelope = json_envelope(frame);
+            }
+            stats_.responses.fetch_add(1, std::memory_order_relaxed);
+            if (response.json || response.envelope.status != 200) {
+                stats_.errors.fetch_add(1, std::memory_order_relaxed);
+            }
+            match(response);
+            report(response);
+            return response;
+        }
+    }
+
+    // Pairs a response with its pending request; an unknown id is counted
+    // and passed on with request_id 0
+    void match(WsApiResponse &response) {
+        uint64_t request_id = 0;
+        const std::string_view id = response.envelope.id;
+        const auto parsed = std::from_chars(id.data(), id.data() + id.size(), request_id);
+        const std::size_t slot = request_id & (WS_API_MAX_IN_FLIGHT - 1);
+        if (parsed.ec != std::errc{} || parsed.ptr != id.data() + id.size() || request_id == 0 ||
+            slot >= slots_.size() || slots_[slot].request_id != request_id) {
+            stats_.unmatched.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Pending &pending = slots_[slot];
+        response.request_id = request_id;
+        response.index = pending.index;
+        response.latency_us =
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - pending.sent).count();
+        pending.request_id = 0;
+        free_slots_.push_back(static_cast<uint32_t>(slot));
+        stats_.in_flight.store(slots_.size() - free_slots_.size(), std::memory_order_relaxed);
+    }
+
+    // The digits after `"name":` in a JSON answer (quoted or not), empty if
+    // there are none
+    static std::string_view json_digits(std::string_view json, std::string_view name) {
+        const std::size_t key = json.find(name);
+        if (key == std::string_view::npos) {
+            return {};
+        }
+        const std::size_t begin = json.find_first_not_of(" \"", key + name.size());
+        if (begin == std::string_view::npos) {
+            return {};
+        }
+        const std::size_t end = std::min(json.find_first_not_of("0123456789", begin), json.size());
+        return json.substr(begin, end - begin);
+    }
+
+    // The id and status of a JSON answer, found by key; the result is the
+    // whole text
+    static WsApiEnvelope json_envelope(std::span<char> text) {
+        const std::string_view json{text.data(), text.size()};
+        WsApiEnvelope envelope;
+        envelope.result = text;
+        envelope.id = json_digits(json, "\"id\":");
+        const std::string_view status = json_digits(json, "\"status\":");
+        std::from_chars(status.data(), status.data() + status.size(), envelope.status);
+        return envelope;
+    }
+
+    void abandon_pending() {
+        free_slots_.clear();
+        for (std::size_t slot = slots_.size(); slot-- > 0;) {
+            slots_[slot].request_id = 0;
+            free_slots_.push_back(static_cast<uint32_t>(slot));
+        }
+        stats_.in_flight.store(0, std::memory_order_relaxed);
+    }
+
+    WsApiConfig config_;
+    WebSocketClient ws_;
+    std::mutex mutex_;
+    std::vector<Pending> slots_;
+    // Free slot indexes, used from the back
+    std::vector<uint32_t> free_slots_;
+    uint64_t sequence_ = 0;
+    std::string request_;
+    std::vector<char> buffer_;
+    WsApiStats stats_;
+};
+
+#endif
@@ -0,0 +1,580 @@
+/*
+ * Minimal blocking WebSocket client (RFC 6455) over TLS, for the native
+ * stream receiver.
+ *
+ * Only what the Binance market-data endpoints need: a client handshake with
+ * extra headers, binary/text messages with fragmentation, ping/pong and
+ * close. No compression extensions are negotiated. All failures throw
+ * std::runtime_error; the caller owns reconnecting. Plain TCP (use_tls =
+ * false) is kept for local gateways and tests.
+ *
+ * busy_poll_us sets SO_BUSY_POLL on the socket so reads spin on the NIC
+ * queue instead of sleeping for the interrupt. Raising it needs
+ * CAP_NET_ADMIN; without that the connection still works and warning()
+ * says why it is not busy polling.
+ *
+ * With use_io_uring, reads after the handshake come from a UringRecv
+ * (uring_recv.h) instead of recv(): plain frames are read straight out of
+ * its registered buffers, and TLS records are decrypted from them through
+ * a BIO that reads the buffers directly. Writes (pongs, pings, close) stay
+ * on the socket. A kernel without io_uring support falls back to recv()
+ * and says so in warning().
+ */
+
+#ifndef _SBE_WS_CLIENT_H_
+#define _SBE_WS_CLIENT_H_
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/sha.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "uring_recv.h"
+
+enum class WsOpcode : uint8_t {
+    Continuation = 0x0,
+    Text = 0x1,
+    Binary = 0x2,
+    Close = 0x8,
+    Ping = 0x9,
+    Pong = 0xA,
+};
+
+struct WsEndpoint {
+    std::string host;
+    uint16_t port = 443;
+    std::string path = "/";
+    bool use_tls = true;
+    std::vector<std::pair<std::string, std::string>> headers;
+    int connect_timeout_ms = 10000;
+    std::size_t max_message_size = 1 << 20;
+    // SO_BUSY_POLL budget in microseconds; 0 leaves the socket alone
+    int busy_poll_us = 0;
+    // Receive through io_uring once the handshake is done
+    bool use_io_uring = false;
+    UringConfig uring;
+};
+
+inline std::string ws_base64(const unsigned char *data, std::size_t size) {
+    std::string out(4 * ((size + 2) / 3), '\0');
+    const int written = EVP_EncodeBlock(reinterpret_cast<unsigned char *>(out.data()), data, static_cast<int>(size));
+    out.resize(static_cast<std::size_t>(written));
+    return out;
+}
+
+// Sec-WebSocket-Accept for a handshake key (RFC 6455 section 4.2.2)
+inline std::string ws_accept_key(const std::string &key) {
+    static constexpr char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    const std::string input = key + GUID;
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    SHA1(reinterpret_cast<const unsigned char *>(input.data()), input.size(), digest);
+    return ws_base64(digest, sizeof(digest));
+}
+
+// Frame header as it appears on the wire
+struct WsFrameHeader {
+    bool fin = false;
+    WsOpcode opcode = WsOpcode::Continuation;
+    bool masked = false;
+    uint64_t payload_length = 0;
+    uint8_t mask[4] = {0, 0, 0, 0};
+};
+
+// Serialize a client frame header (always masked) into `out`; returns its size
+inline std::size_t ws_encode_header(WsOpcode opcode, uint64_t payload_length, const uint8_t mask[4],
+                                    uint8_t out[14]) {
+    std::size_t size = 0;
+    out[size++] = static_cast<uint8_t>(0x80 | static_cast<uint8_t>(opcode));
+    if (payload_length < 126) {
+        out[size++] = static_cast<uint8_t>(0x80 | payload_length);
+    } else if (payload_length <= 0xFFFF) {
+        out[size++] = 0x80 | 126;
+        out[size++] = static_cast<uint8_t>(payload_length >> 8);
+        out[size++] = static_cast<uint8_t>(payload_length);
+    } else {
+        out[size++] = 0x80 | 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            out[size++] = static_cast<uint8_t>(payload_length >> shift);
+        }
+    }
+    std::memcpy(out + size, mask, 4);
+    return size + 4;
+}
+
+class WebSocketClient {
+public:
+    WebSocketClient() = default;
+    ~WebSocketClient() { reset(); }
+
+    WebSocketClient(const WebSocketClient &) = delete;
+    WebSocketClient &operator=(const WebSocketClient &) = delete;
+
+    void connect(const WsEndpoint &endpoint) {
+        reset();
+        max_message_size_ = endpoint.max_message_size;
+        open_socket(endpoint);
+        if (endpoint.use_tls) {
+            start_tls(endpoint.host);
+        }
+        handshake(endpoint);
+        if (endpoint.use_io_uring) {
+            start_uring(endpoint.uring);
+        }
+    }
+
+    bool connected() const { return fd_ >= 0; }
+
+    // True when reads go through io_uring
+    bool io_uring() const { return uring_ != nullptr; }
+
+    // Socket options that could not be applied on the last connect; empty if all were
+    const std::string &warning() const { return warning_; }
+
+    // True when bytes are available within `timeout_ms`, counting data
+    // already buffered by TLS or left over from the handshake.
+    bool wait_readable(int timeout_ms) {
+        if (read_pos_ < read_buf_.size() || (ssl_ != nullptr && SSL_pending(ssl_) > 0)) {
+            return true;
+        }
+        if (uring_ != nullptr) {
+            return uring_->wait(timeout_ms);
+        }
+        pollfd pfd{fd_, POLLIN, 0};
+        const int rc = ::poll(&pfd, 1, timeout_ms);
+        if (rc < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("ws poll failed: ") + std::strerror(errno));
+        }
+        return rc > 0;
+    }
+
+    // What to poll for readability once wait_readable(0) (which arms an
+    // io_uring recv) says nothing is buffered: the ring or the socket
+    int poll_fd() const { return uring_ != nullptr ? uring_->fd() : fd_; }
+
+    // Read the next message into `out` (replacing its contents). Data
+    // messages are reassembled from their fragments. Control frames are
+    // returned as they arrive so the caller never blocks behind one: pings
+    // are answered before returning Ping, and a close is echoed.
+    WsOpcode read_message(std::vector<char> &out) {
+        out.clear();
+        WsOpcode message_opcode = WsOpcode::Continuation;
+        while (true) {
+            const WsFrameHeader header = read_frame_header();
+            if (header.masked) {
+                throw std::runtime_error("ws protocol error: masked server frame");
+            }
+            const bool control = (static_cast<uint8_t>(header.opcode) & 0x8) != 0;
+            if (control) {
+                if (header.payload_length > 125 || !header.fin) {
+                    throw std::runtime_error("ws protocol error: invalid control frame");
+                }
+                control_payload_.resize(header.payload_length);
+                read_exact(control_payload_.data(), control_payload_.size());
+                // Mid-message control frames are handled inline so the
+                // fragments read so far are kept
+                const bool mid_message = message_opcode != WsOpcode::Continuation;
+                switch (header.opcode) {
+                case WsOpcode::Ping:
+                    send_frame(WsOpcode::Pong, control_payload_.data(), control_payload_.size());
+                    if (mid_message) {
+                        continue;
+                    }
+                    return WsOpcode::Ping;
+                case WsOpcode::Pong:
+                    if (mid_message) {
+                        continue;
+                    }
+                    return WsOpcode::Pong;
+                default:
+                    // Echo the close and report it
+                    send_frame(WsOpcode::Close, control_payload_.data(), control_payload_.size());
+                    return WsOpcode::Close;
+                }
+            }
+
+            if (header.opcode == WsOpcode::Continuation) {
+                if (message_opcode == WsOpcode::Continuation) {
+                    throw std::runtime_error("ws protocol error: unexpected continuation frame");
+                }
+            } else {
+                if (message_opcode != WsOpcode::Continuation) {
+                    throw std::runtime_error("ws protocol error: interleaved data frames");
+                }
+                message_opcode = header.opcode;
+            }
+
+            if (out.size() + header.payload_length > max_message_size_) {
+                throw std::runtime_error("ws message exceeds max size");
+            }
+            const std::size_t offset = out.size();
+            out.resize(offset + header.payload_length);
+            read_exact(out.data() + offset, header.payload_length);
+            if (header.fin) {
+                return message_opcode;
+            }
+        }
+    }
+
+    void send_ping() { send_frame(WsOpcode::Ping, nullptr, 0); }
+
+    void send_text(const std::string &text) { send_frame(WsOpcode::Text, text.data(), text.size()); }
+
+    // Best-effort close handshake, then drop the connection
+    void close() {
+        if (fd_ >= 0) {
+            try {
+                const uint8_t normal[2] = {0x03, 0xE8}; // 1000
+                send_frame(WsOpcode::Close, reinterpret_cast<const char *>(normal), sizeof(normal));
+            } catch (const std::exception &) {
+            }
+        }
+        reset();
+    }
+
+private:
+    void reset() {
+        // Before the socket it receives on
+        uring_.reset();
+        if (ssl_ != nullptr) {
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+        }
+        if (ctx_ != nullptr) {
+            SSL_CTX_free(ctx_);
+            ctx_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        read_buf_.clear();
+        read_pos_ = 0;
+        warning_.clear();
+    }
+
+    void open_socket(const WsEndpoint &endpoint) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *results = nullptr;
+        const std::string port = std::to_string(endpoint.port);
+        if (const int rc = ::getaddrinfo(endpoint.host.c_str(), port.c_str(), &hints, &results); rc != 0) {
+            throw std::runtime_error("ws resolve failed for " + endpoint.host + ": " + ::gai_strerror(rc));
+        }
+
+        std::string last_error = "no addresses";
+        for (addrinfo *ai = results; ai != nullptr; ai = ai->ai_next) {
+            const int fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0) {
+                last_error = std::strerror(errno);
+                continue;
+            }
+            timeval timeout{endpoint.connect_timeout_ms / 1000, (endpoint.connect_timeout_ms % 1000) * 1000};
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+                const int one = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                const int busy_poll_us = endpoint.busy_poll_us;
+                if (busy_poll_us > 0 &&
+                    ::setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us, sizeof(busy_poll_us)) != 0) {
+                    warning_ = std::string("SO_BUSY_POLL not set: ") + std::strerror(errno);
+                }
+                fd_ = fd;
+                break;
+            }
+            last_error = std::strerror(errno);
+            ::close(fd);
+        }
+        ::freeaddrinfo(results);
+        if (fd_ < 0) {
+            throw std::runtime_error("ws connect to " + endpoint.host + " failed: " + last_error);
+        }
+    }
+
+    // Reads from here on go through io_uring; any failure leaves recv() in place
+    void start_uring(const UringConfig &config) {
+        try {
+            uring_ = std::make_unique<UringRecv>(fd_, config);
+        } catch (const std::exception &e) {
+            warning_ = std::string(e.what()) + "; receiving with recv()";
+            return;
+        }
+        if (ssl_ != nullptr) {
+            BIO *bio = BIO_new(uring_bio_method());
+            if (bio == nullptr) {
+                uring_.reset();
+                warning_ = "io_uring BIO: " + ssl_error_string() + "; receiving with recv()";
+                return;
+            }
+            BIO_set_data(bio, uring_.get());
+            BIO_set_init(bio, 1);
+            // The socket BIO stays on as the write side
+            SSL_set0_rbio(ssl_, bio);
+        }
+    }
+
+    // Source BIO over a UringRecv, so OpenSSL decrypts straight from its buffers
+    static BIO_METHOD *uring_bio_method() {
+        static BIO_METHOD *method = [] {
+            BIO_METHOD *m = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "io_uring recv");
+            BIO_meth_set_read_ex(m, [](BIO *bio, char *dst, size_t size, size_t *read) {
+                BIO_clear_retry_flags(bio);
+                try {
+                    *read = static_cast<UringRecv *>(BIO_get_data(bio))->read(dst, size);
+                } catch (const std::exception &) {
+                    // The error stays on the UringRecv for read_some to report
+                    *read = 0;
+                }
+                return *read > 0 ? 1 : 0;
+            });
+            BIO_meth_set_ctrl(m, [](BIO *, int cmd, long, void *) -> long { return cmd == BIO_CTRL_FLUSH ? 1 : 0; });
+            return m;
+        }();
+        return method;
+    }
+
+    static std::string ssl_error_string() {
+        char buf[256];
+        ERR_error_string_n(ERR_get_error(), buf, sizeof(buf));
+        return buf;
+    }
+
+    void start_tls(const std::string &host) {
+        ctx_ = SSL_CTX_new(TLS_client_method());
+        if (ctx_ == nullptr) {
+            throw std::runtime_error("ws TLS context: " + ssl_error_string());
+        }
+        SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+        SSL_CTX_set_default_verify_paths(ctx_);
+        SSL_CTX_set_verify(ctx_, SSL_VERIFY_PEER, nullptr);
+
+        ssl_ = SSL_new(ctx_);
+        SSL_set_fd(ssl_, fd_);
+        SSL_set_tlsext_host_name(ssl_, host.c_str());
+        SSL_set1_host(ssl_, host.c_str());
+        if (SSL_connect(ssl_) != 1) {
+            throw std::runtime_error("ws TLS handshake with " + host + " failed: " + ssl_error_string());
+        }
+    }
+
+    void handshake(const WsEndpoint &endpoint) {
+        unsigned char nonce[16];
+        RAND_bytes(nonce, sizeof(nonce));
+        const std::string key = ws_base64(nonce, sizeof(nonce));
+
+        std::string request = "GET " + endpoint.path + " HTTP/1.1\r\n";
+        request += "Host: " + endpoint.host + ":" + std::to_string(endpoint.port) + "\r\n";
+        request += "Upgrade: websocket\r\nConnection: Upgrade\r\n";
+        request += "Sec-WebSocket-Key: " + key + "\r\n";
+        request += "Sec-WebSocket-Version: 13\r\n";
+        for (const auto &[name, value] : endpoint.headers) {
+            request += name + ": " + value + "\r\n";
+        }
+        request += "\r\n";
+        write_all(request.data(), request.size());
+
+        // Read the response head; anything after it is already frame data
+        std::string response;
+        char chunk[1024];
+        std::size_t head_end = std::string::npos;
+        while ((head_end = response.find("\r\n\r\n")) == std::string::npos) {
+            if (response.size() > 16 * 1024) {
+                throw std::runtime_error("ws handshake response too large");
+            }
+            response.append(chunk, read_some(chunk, sizeof(chunk)));
+        }
+        read_buf_.assign(response.begin() + static_cast<std::ptrdiff_t>(head_end + 4), response.end());
+        read_pos_ = 0;
+        response.resize(head_end);
+
+        if (response.compare(0, 12, "HTTP/1.1 101") != 0) {
+            throw std::runtime_error("ws handshake rejected: " + response.substr(0, response.find("\r\n")));
+        }
+        if (header_value(response, "sec-websocket-accept") != ws_accept_key(key)) {
+            throw std::runtime_error("ws handshake: bad Sec-WebSocket-Accept");
+        }
+    }
+
+    // Value of an HTTP response header; `name` must be lower case
+    static std::string header_value(const std::string &head, const std::string &name) {
+        std::size_t line = head.find("\r\n");
+        while (line != std::string::npos) {
+            line += 2;
+            const std::size_t end = std::min(head.find("\r\n", line), head.size());
+            const std::size_t colon = head.find(':', line);
+            if (colon < end && colon - line == name.size()) {
+                bool match = true;
+                for (std::size_t i = 0; i < name.size() && match; ++i) {
+                    match = std::tolower(static_cast<unsigned char>(head[line + i])) == name[i];
+                }
+                if (match) {
+                    std::size_t value = colon + 1;
+                    while (value < end && (head[value] == ' ' || head[value] == '\t')) {
+                        ++value;
+                    }
+                    return head.substr(value, end - value);
+                }
+            }
+            line = end < head.size() ? end : std::string::npos;
+        }
+        return {};
+    }
+
+    WsFrameHeader read_frame_header() {
+        uint8_t head[2];
+        read_exact(reinterpret_cast<char *>(head), sizeof(head));
+        WsFrameHeader header;
+        header.fin = (head[0] & 0x80) != 0;
+        if ((head[0] & 0x70) != 0) {
+            throw std::runtime_error("ws protocol error: reserved bits set");
+        }
+        header.opcode = static_cast<WsOpcode>(head[0] & 0x0F);
+        header.masked = (head[1] & 0x80) != 0;
+        header.payload_length = head[1] & 0x7F;
+        if (header.payload_length == 126) {
+            uint8_t ext[2];
+            read_exact(reinterpret_cast<char *>(ext), sizeof(ext));
+            header.payload_length = (static_cast<uint64_t>(ext[0]) << 8) | ext[1];
+        } else if (header.payload_length == 127) {
+            uint8_t ext[8];
+            read_exact(reinterpret_cast<char *>(ext), sizeof(ext));
+            header.payload_length = 0;
+            for (uint8_t byte : ext) {
+                header.payload_length = (header.payload_length << 8) | byte;
+            }
+        }
+        if (header.masked) {
+            read_exact(reinterpret_cast<char *>(header.mask), sizeof(header.mask));
+        }
+        return header;
+    }
+
+    void send_frame(WsOpcode opcode, const char *payload, std::size_t size) {
+        uint8_t mask[4];
+        RAND_bytes(mask, sizeof(mask));
+        uint8_t head[14];
+        const std::size_t head_size = ws_encode_header(opcode, size, mask, head);
+
+        send_buf_.resize(head_size + size);
+        std::memcpy(send_buf_.data(), head, head_size);
+        for (std::size_t i = 0; i < size; ++i) {
+            send_buf_[head_size + i] = static_cast<char>(payload[i] ^ mask[i & 3]);
+        }
+        write_all(send_buf_.data(), send_buf_.size());
+    }
+
+    std::size_t read_some(char *dst, std::size_t size) {
+        if (ssl_ != nullptr) {
+            const int n = SSL_read(ssl_, dst, static_cast<int>(size));
+            if (n <= 0) {
+                if (uring_ != nullptr && uring_->eof()) {
+                    throw std::runtime_error("ws connection closed");
+                }
+                if (uring_ != nullptr && uring_->error() != 0) {
+                    throw std::runtime_error(std::string("ws read failed: ") + std::strerror(uring_->error()));
+                }
+                throw std::runtime_error("ws TLS read failed: " + ssl_error_string());
+            }
+            return static_cast<std::size_t>(n);
+        }
+        if (uring_ != nullptr) {
+            const std::size_t n = uring_->read(dst, size);
+            if (n == 0) {
+                throw std::runtime_error("ws connection closed");
+            }
+            return n;
+        }
+        ssize_t n = 0;
+        do {
+            n = ::recv(fd_, dst, size, 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            throw std::runtime_error(n == 0 ? "ws connection closed" : std::string("ws read failed: ") + std::strerror(errno));
+        }
+        return static_cast<std::size_t>(n);
+    }
+
+    void read_exact(char *dst, std::size_t size) {
+        while (size > 0) {
+            if (read_pos_ < read_buf_.size()) {
+                const std::size_t n = std::min(size, read_buf_.size() - read_pos_);
+                std::memcpy(dst, read_buf_.data() + read_pos_, n);
+                read_pos_ += n;
+                dst += n;
+                size -= n;
+                continue;
+            }
+            // Refill the staging buffer for small reads, read large payloads
+            // directly; plain io_uring reads are already out of its buffers
+            if (size >= sizeof(staging_) || (uring_ != nullptr && ssl_ == nullptr)) {
+                const std::size_t n = read_some(dst, size);
+                dst += n;
+                size -= n;
+            } else {
+                const std::size_t n = read_some(staging_, sizeof(staging_));
+                read_buf_.assign(staging_, staging_ + n);
+                read_pos_ = 0;
+            }
+        }
+    }
+
+    void write_all(const char *data, std::size_t size) {
+        while (size > 0) {
+            std::size_t written = 0;
+            if (ssl_ != nullptr) {
+                const int n = SSL_write(ssl_, data, static_cast<int>(size));
+                if (n <= 0) {
+                    throw std::runtime_error("ws TLS write failed: " + ssl_error_string());
+                }
+                written = static_cast<std::size_t>(n);
+            } else {
+                const ssize_t n = ::send(fd_, data, size, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::runtime_error(std::string("ws write failed: ") + std::strerror(errno));
+                }
+                written = static_cast<std::size_t>(n);
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    int fd_ = -1;
+    SSL_CTX *ctx_ = nullptr;
+    SSL *ssl_ = nullptr;
+    std::size_t max_message_size_ = 1 << 20;
+    std::vector<char> read_buf_;
+    std::size_t read_pos_ = 0;
+    char staging_[16 * 1024];
+    std::vector<char> send_buf_;
+    std::vector<char> control_payload_;
+    std::string warning_;
+    std::unique_ptr<UringRecv> uring_;
+};
+
+#endif
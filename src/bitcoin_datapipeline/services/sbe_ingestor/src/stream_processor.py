@@ -11,10 +11,15 @@ from .clients.binance_sbe import BinanceSBEClient
 from .clients.kinesis_client import KinesisProducer
 from .config.settings import SBEIngestorConfig
 from .config.aws_config import AWSClientManager
+from .sbe_decoder.sbe_decoder_cpp import TRACE_STAGES, ingest_clock_us, native_logger
+from .utils.logging import forward_native_logs
 
 
 logger = logging.getLogger(__name__)
 
+# Slot of the Kinesis producer hand-off in a traced message's "trace" block
+TRACE_ENQUEUE = TRACE_STAGES.index("enqueue")
+
 
 class SBEStreamProcessor:
     """Processes SBE streams and publishes to Kinesis."""
@@ -37,6 +42,7 @@ class SBEStreamProcessor:
         }
         
         self._running = False
+        self._native_log_task: Optional[asyncio.Task] = None
         logger.info("SBEStreamProcessor initialized")
     
     async def start(self):
@@ -45,6 +51,11 @@ class SBEStreamProcessor:
         logger.info("Starting SBE stream processor")
         
         try:
+            # Native warnings (reconnects, rejected frames) go through the
+            # Python sinks without the native threads ever taking the GIL
+            native_logger().start(level=self.config.logging.native_level, forward=True)
+            self._native_log_task = asyncio.create_task(forward_native_logs(native_logger()))
+
             # Initialize Kinesis producers
             await self._init_kinesis_producers()
             
@@ -87,8 +98,21 @@ class SBEStreamProcessor:
         # Close Kinesis producers
         for producer in self.kinesis_producers.values():
             await producer.close()
-        
+
+        await self._stop_native_log()
         logger.info("SBE stream processor stopped")
+
+    async def _stop_native_log(self):
+        """Write out the native log and stop forwarding it."""
+        if self._native_log_task is None:
+            return
+        native_logger().stop()
+        self._native_log_task.cancel()
+        try:
+            await self._native_log_task
+        except asyncio.CancelledError:
+            pass
+        self._native_log_task = None
     
     async def _init_kinesis_producers(self):
         """Initialize Kinesis producers for each stream type."""
@@ -130,6 +154,11 @@ class SBEStreamProcessor:
                 # Create partition key for even distribution
                 partition_key = f"{symbol}_{message_type}"
                 
+                # Traced messages (decoder_trace) stamp the hand-off
+                trace = enhanced_message.get("trace")
+                if trace is not None:
+                    trace[TRACE_ENQUEUE] = ingest_clock_us()
+                
                 # Send to Kinesis
                 await producer.put_record(
                     data=enhanced_message,
@@ -173,8 +202,8 @@ class SBEStreamProcessor:
             except Exception as e:
                 logger.error(f"Error flushing producer: {e}")
     
-    async def health_check(self) -> Dict[str, Any]:
-        """Perform health check on the stream processor."""
+    async def health_check(self, dump_frames: bool = False) -> Dict[str, Any]:
+        """Perform health check on the stream processor; dump_frames adds the SBE client's captured frames."""
         health_status = {
             "status": "healthy",
             "timestamp": datetime.utcnow().isoformat(),
@@ -186,7 +215,7 @@ class SBEStreamProcessor:
         # Check SBE client health
         if self.sbe_client:
             try:
-                sbe_health = await self.sbe_client.health_check()
+                sbe_health = await self.sbe_client.health_check(dump_frames=dump_frames)
                 health_status["components"]["sbe_client"] = sbe_health
                 
                 if sbe_health.get("status") != "healthy":
@@ -1,5 +1,6 @@
 """Structured logging setup for the ingestor service."""
 
+import asyncio
 import logging
 import logging.config
 import json
@@ -140,6 +141,50 @@ def get_logger(name: str) -> logging.Logger:
     return logging.getLogger(name)
 
 
+async def forward_native_logs(native_logger, prefix: str = "native", max_lines: int = 1024,
+                              poll_timeout: float = 1.0) -> None:
+    """
+    Emit the native components' log lines through the Python logging sinks.
+
+    native_logger is the extension's NativeLogger, started with forward=True.
+    Its writer thread formats the records the native threads log and queues
+    the lines; this drains them on the logger's eventfd (loop.add_reader)
+    and logs each through "<prefix>.<component>" at its own level, with the
+    native timestamp as native_ts_us. Runs until cancelled, then emits the
+    lines still queued (stop the logger first to have all of them).
+    """
+    loop = asyncio.get_running_loop()
+    ready = asyncio.Event()
+
+    def emit(lines):
+        for time_us, level, component, message in lines:
+            logging.getLogger(f"{prefix}.{component}").log(level, message, extra={'native_ts_us': time_us})
+
+    def on_ready():
+        native_logger.clear_notify()
+        ready.set()
+
+    loop.add_reader(native_logger.notify_fd, on_ready)
+    try:
+        while True:
+            lines = native_logger.drain(max_lines)
+            if not lines:
+                ready.clear()
+                if native_logger.arm_notify():
+                    try:
+                        await asyncio.wait_for(ready.wait(), poll_timeout)
+                    except asyncio.TimeoutError:
+                        pass
+                continue
+            emit(lines)
+            # Let the loop run between bursts
+            await asyncio.sleep(0)
+    finally:
+        loop.remove_reader(native_logger.notify_fd)
+        while lines := native_logger.drain(max_lines):
+            emit(lines)
+
+
 def log_with_context(logger: logging.Logger, level: int, message: str, **context):
     """Log a message with additional context."""
     
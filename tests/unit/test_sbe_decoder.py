@@ -0,0 +1,2954 @@
+#!/usr/bin/env python3
+"""
+Unit tests for the native SBE decoder extension (sbe_decoder_cpp).
+
+Frames are built by hand with struct so the tests run without a Binance
+connection. Skipped when the extension has not been built:
+    cd src/bitcoin_datapipeline/services/sbe_ingestor && ./build_sbe_decoder_test.sh
+"""
+
+import glob
+import json
+import logging
+import math
+import os
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+import pytest
+
+sys.path.insert(0, os.path.join(
+    os.path.dirname(__file__), '..', '..',
+    'src', 'bitcoin_datapipeline', 'services', 'sbe_ingestor', 'src', 'sbe_decoder'
+))
+sbe_decoder_cpp = pytest.importorskip("sbe_decoder_cpp")
+
+pytestmark = pytest.mark.unit
+
+SCHEMA_ID = 1
+SCHEMA_VERSION = 0
+
+
+def sbe_header(block_length: int, template_id: int) -> bytes:
+    return struct.pack('<HHHH', block_length, template_id, SCHEMA_ID, SCHEMA_VERSION)
+
+
+def trade_frame(trades, symbol: bytes = b"BTCUSDT", event_time_us: int = 1_700_000_000_123_456,
+                price_exponent: int = -2, qty_exponent: int = -5) -> bytes:
+    """TradesStreamEvent (10000): fixed block, trades group, symbol varString8."""
+    body = struct.pack('<qqbb', event_time_us, event_time_us - 100, price_exponent, qty_exponent)
+    body += struct.pack('<HI', 25, len(trades))
+    for trade_id, price, qty, is_buyer_maker in trades:
+        body += struct.pack('<qqqB', trade_id, price, qty, 1 if is_buyer_maker else 0)
+    body += struct.pack('<B', len(symbol)) + symbol
+    return sbe_header(18, 10000) + body
+
+
+@pytest.fixture
+def decoder():
+    return sbe_decoder_cpp.SBEDecoder()
+
+
+def test_decode_trade_from_bytes(decoder):
+    decoded = decoder.decode_message(trade_frame([(42, 6512345, 150, True)]))
+
+    assert decoded['symbol'] == 'BTCUSDT'
+    assert decoded['trade_id'] == 42
+    assert decoded['price'] == pytest.approx(65123.45)
+    assert decoded['qty'] == pytest.approx(0.0015)
+    assert decoded['is_buyer_maker'] is True
+    assert decoded['event_ts'] == 1_700_000_000_123
+
+
+@pytest.mark.parametrize("wrap", [bytearray, memoryview, lambda b: memoryview(b"xx" + b)[2:]])
+def test_decode_accepts_buffer_protocol(decoder, wrap):
+    frame = trade_frame([(7, 100, 1, False)])
+
+    assert decoder.is_valid_message(wrap(frame))
+    assert decoder.get_message_type(wrap(frame)) == sbe_decoder_cpp.TRADES_STREAM_EVENT
+    assert decoder.decode_message(wrap(frame))['trade_id'] == 7
+
+
+def test_decode_rejects_non_contiguous_buffer(decoder):
+    frame = trade_frame([(7, 100, 1, False)]) * 2
+    with pytest.raises((BufferError, TypeError, ValueError)):
+        decoder.decode_message(memoryview(frame)[::2])
+
+
+def bba_frame(bid_px: int, bid_qty: int, ask_px: int, ask_qty: int, update_id: int = 5,
+              symbol: bytes = b"BTCUSDT", event_time_us: int = 1_700_000_000_000_000) -> bytes:
+    """BestBidAskStreamEvent (10001): fixed block of 50 bytes, symbol varString8."""
+    body = struct.pack('<qqbbqqqq', event_time_us, update_id, -2, -5,
+                       bid_px, bid_qty, ask_px, ask_qty)
+    body += struct.pack('<B', len(symbol)) + symbol
+    return sbe_header(50, 10001) + body
+
+
+def test_decode_batch_returns_columns(decoder):
+    frames = [
+        trade_frame([(1, 6500000, 100, False)]),
+        bba_frame(6499999, 10, 6500001, 20),
+        trade_frame([(2, 6500100, 200, True)], symbol=b"ETHUSDT"),
+        b"\x00\x01",
+    ]
+    batch = decoder.decode_batch(frames)
+
+    trades = batch['trade']
+    assert list(trades['trade_id']) == [1, 2]
+    assert list(trades['frame_index']) == [0, 2]
+    assert list(trades['is_buyer_maker']) == [False, True]
+    assert list(trades['symbol']) == [b"BTCUSDT", b"ETHUSDT"]
+    assert trades['price'][1] == pytest.approx(65001.0)
+    assert list(batch['bestBidAsk']['frame_index']) == [1]
+    assert list(batch['errors']) == [3]
+
+
+def test_symbols_are_interned_across_decoders(decoder):
+    frames = [trade_frame([(1, 1, 1, False)]), trade_frame([(2, 1, 1, False)], symbol=b"ETHUSDT"),
+              trade_frame([(3, 1, 1, False)])]
+    batch = decoder.decode_batch(frames)
+
+    ids = list(batch['trade']['symbol_id'])
+    assert ids[0] == ids[2] != ids[1]
+    first = decoder.decode_message(frames[0])['symbol']
+    assert first == 'BTCUSDT'
+    assert decoder.decode_message(frames[2])['symbol'] is first
+    event = decoder.decode_event(frames[0])
+    assert event.symbol is first and event.symbol_id == ids[0]
+
+
+def test_decode_batch_splits_contiguous_buffer(decoder):
+    np = pytest.importorskip("numpy")
+    first = trade_frame([(10, 1, 1, False)])
+    second = trade_frame([(11, 1, 1, False)])
+    offsets = np.array([0, len(first), len(first) + len(second)], dtype=np.int64)
+
+    batch = decoder.decode_batch(first + second, offsets)
+
+    assert list(batch['trade']['trade_id']) == [10, 11]
+
+
+def test_decode_batch_walks_concatenated_messages(decoder):
+    combined = (trade_frame([(20, 1, 1, False), (21, 1, 1, True)])
+                + depth_frame(1, 2, [(6500000, 5)], [(6500100, 6)])
+                + bba_frame(6499999, 10, 6500001, 20))
+
+    # One buffer, one list item or one offsets slice: every message decodes
+    for frames, base in ((combined, 0), ([combined], 0), ([bba_frame(1, 1, 2, 1), combined], 1)):
+        batch = decoder.decode_batch(frames)
+        assert list(batch['trade']['trade_id']) == [20, 21]
+        assert list(batch['trade']['frame_index']) == [base, base]
+        assert list(batch['depthDiff']['frame_index']) == [base + 1]
+        assert list(batch['depthLevels']['price']) == [pytest.approx(65000.0), pytest.approx(65001.0)]
+        assert list(batch['bestBidAsk']['frame_index'])[-1] == base + 2
+        assert len(batch['errors']) == 0
+
+    # A truncated last message is one error frame; nothing past it is misread
+    batch = decoder.decode_batch([combined[:-4]])
+    assert list(batch['trade']['trade_id']) == [20, 21]
+    assert list(batch['errors']) == [2]
+    assert len(batch['bestBidAsk']['frame_index']) == 0
+
+    np = pytest.importorskip("numpy")
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=2)
+    offsets = np.array([0, len(combined)], dtype=np.int64)
+    assert pool.decode_batch(combined, offsets)['depthDiff']['frame_index'].tolist() == [1]
+    assert pool.book("BTCUSDT")['last_update_id'] == 2
+
+
+def test_decode_trades_returns_every_group_entry(decoder):
+    frame = trade_frame([(100, 6500000, 10, False), (101, 6500050, 20, True), (102, 6499900, 30, False)])
+
+    trades = decoder.decode_trades(frame)
+
+    assert list(trades['trade_id']) == [100, 101, 102]
+    assert list(trades['qty_mantissa']) == [10, 20, 30]
+    assert list(trades['is_buyer_maker']) == [False, True, False]
+    assert trades['price'][2] == pytest.approx(64999.0)
+    # decode_message keeps its one-dict-per-frame contract
+    assert decoder.decode_message(frame)['trade_id'] == 100
+
+
+def test_decode_batch_expands_trade_groups(decoder):
+    batch = decoder.decode_batch([trade_frame([(1, 1, 1, False), (2, 1, 1, False)]),
+                                  trade_frame([(3, 1, 1, False)])])
+
+    assert list(batch['trade']['trade_id']) == [1, 2, 3]
+    assert list(batch['trade']['frame_index']) == [0, 0, 1]
+
+
+def test_subscription_mask_skips_frames_before_decoding(decoder):
+    frames = [trade_frame([(1, 1, 1, False)]), depth_frame(1, 2, [(6500000, 5)], [(6500100, 6)]),
+              trade_frame([(2, 1, 1, False)], symbol=b"ETHUSDT")]
+    depth_only = sbe_decoder_cpp.SubscriptionMask(templates=[sbe_decoder_cpp.DEPTH_DIFF_STREAM_EVENT])
+
+    batch = decoder.decode_batch(frames, subscription=depth_only)
+    assert batch['filtered'] == 2
+    assert len(batch['trade']['trade_id']) == 0
+    assert list(batch['depthDiff']['frame_index']) == [1]
+    assert 'filtered' not in decoder.decode_batch(frames)
+
+    eth = sbe_decoder_cpp.SubscriptionMask(symbols=["ETHUSDT"])
+    assert [eth.admits(frame) for frame in frames] == [False, False, True]
+    assert eth.symbols == ["ETHUSDT"] and eth.templates == [] and eth.restricts
+    assert not sbe_decoder_cpp.SubscriptionMask().restricts
+
+    receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"])
+    receiver.set_subscription(depth_only)
+    assert receiver.stats['filtered_frames'] == 0
+
+
+def test_deduplicator_drops_repeats_within_window(decoder):
+    dedup = sbe_decoder_cpp.Deduplicator(window_seconds=7)
+    assert dedup.is_unique('BTCUSDT', 1, now_us=10_000_000)
+    assert not dedup.is_unique('BTCUSDT', 1, now_us=16_000_000)
+    assert dedup.is_unique('ETHUSDT', 1, now_us=16_000_000)
+    # Forgotten one bucket (window / 7) after the window at the latest
+    assert dedup.is_unique('BTCUSDT', 1, now_us=18_000_000)
+
+    batch = decoder.decode_batch([trade_frame([(5, 1, 1, False), (6, 1, 1, False)]), trade_frame([(6, 1, 1, False)])])
+    mask = dedup.unique_mask(batch['trade']['symbol_id'], batch['trade']['trade_id'], now_us=18_000_000)
+    assert list(mask) == [True, True, False]
+    assert dedup.get_stats()['duplicates_found'] == 2
+
+
+def test_bloom_deduplicator_keeps_its_memory_and_fp_rate(decoder):
+    np = pytest.importorskip("numpy")
+    # A day of 2M trade IDs at 1% fits in a few MB
+    assert sbe_decoder_cpp.BloomDeduplicator(window_seconds=86400, capacity=2_000_000).memory_bytes < 8 << 20
+
+    # Sized for 50k keys per bucket (window / 7)
+    dedup = sbe_decoder_cpp.BloomDeduplicator(window_seconds=7, capacity=350_000, fp_rate=0.01)
+    assert dedup.is_unique('BTCUSDT', 1, now_us=10_000_000)
+    assert not dedup.is_unique('BTCUSDT', 1, now_us=16_000_000)
+    assert dedup.is_unique('BTCUSDT', 1, now_us=18_000_000)
+
+    symbol_id = decoder.decode_batch([trade_frame([(1, 1, 1, False)])])['trade']['symbol_id'][0]
+    symbols = np.full(50_000, symbol_id, dtype=np.uint16)
+    ids = np.arange(1_000, 51_000, dtype=np.int64)
+    first = dedup.unique_mask(symbols, ids, now_us=18_000_000)
+    assert first.mean() > 0.99
+    assert not dedup.unique_mask(symbols, ids, now_us=19_000_000).any()
+    stats = dedup.get_stats()
+    assert stats['target_fp_rate'] == 0.01 and 0 < stats['estimated_fp_rate'] < 0.01
+    assert stats['duplicates_found'] == 1 + (50_000 - first.sum()) + 50_000
+
+
+def test_trade_window_updates_features_incrementally():
+    window = sbe_decoder_cpp.TradeWindow(window_seconds=10)
+    assert window.features() == {}
+    window.add(1_000, 100.0, 1.0, False)
+    window.add(2_000, 102.0, 3.0, True)
+    window.add(3_000, 101.0, 0.0, False)  # zero qty is ignored
+    features = window.features()
+    assert features['trade_count'] == 2
+    assert features['vwap'] == pytest.approx(101.5)
+    assert features['price_volatility'] == pytest.approx(2 ** 0.5)
+    assert (features['buy_volume'], features['sell_volume']) == (1.0, 3.0)
+    assert features['volume_imbalance'] == pytest.approx(-0.5)
+
+    window.add(11_500, 104.0, 2.0, False)  # evicts the trade at 1_000
+    features = window.features()
+    assert (features['trade_count'], features['min_price'], features['max_price']) == (2, 102.0, 104.0)
+    window.advance(30_000)
+    assert len(window) == 0
+
+
+def test_multi_horizon_window_combines_panes_per_horizon():
+    window = sbe_decoder_cpp.MultiHorizonWindow(horizons_seconds=[1, 10])
+    assert window.pane_seconds == 1.0
+    window.add(1_000, 100.0, 1.0, False)
+    window.add(9_500, 102.0, 3.0, True)
+    window.add(10_200, 104.0, 2.0, False)
+    features = window.features()
+    assert features['1s']['trade_count'] == 1
+    assert features['10s']['trade_count'] == 3
+    assert features['10s']['vwap'] == pytest.approx(614.0 / 6)
+    assert features['10s']['price_change'] == 4.0
+
+    window.add(0, 99.0, 1.0, False)  # older than the 10s ring
+    assert window.late_drops == 1
+    window.advance(15_000)
+    assert window.features()['1s'] == {}
+    assert window.features()['10s']['trade_count'] == 2
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.MultiHorizonWindow(horizons_seconds=[1.5], pane_seconds=1)
+
+
+def test_quantile_window_tracks_percentiles_per_horizon(decoder):
+    window = sbe_decoder_cpp.QuantileWindow(horizons_seconds=[10, 60])
+    for i in range(1000):
+        window.add_trade(50_000 + 10 * i, float(i + 1))
+    window.add_quote(55_000, 100.0, 100.01)
+    window.add_quote(55_000, 100.01, 100.0)  # crossed, ignored
+    features = window.features()
+    assert features['10s']['trade_size_p50'] == pytest.approx(500.5, rel=0.01)
+    assert features['10s']['trade_size_p99'] == pytest.approx(990.0, rel=0.01)
+    assert features['10s']['inter_arrival_ms_p90'] == pytest.approx(10.0)
+    assert features['10s']['spread_bps_p50'] == pytest.approx(0.01 / 100.005 * 1e4)
+    assert window.features([0.0, 1.0])['60s']['trade_size_p100'] == 1000.0
+
+    window.add_trade(0, 1.0)  # older than the 60s ring
+    assert window.late_drops == 1
+    window.advance(65_000)
+    assert window.features()['10s'] == {}
+    assert window.features()['60s']['trade_size_p50'] == pytest.approx(500.5, rel=0.01)
+    with pytest.raises(ValueError):
+        window.features([1.5])
+
+    # The ingestor keeps one per symbol over what it routes
+    frames = [trade_frame([(1, 6500000, 100, True), (2, 6500100, 300, False)]),
+              bba_frame(6499999, 10, 6500001, 20)]
+    out = bytearray(4096)
+    result = decoder.serialize_records(frames, out)
+    offsets = result['offsets']
+    records = [{'Data': bytes(out[offsets[i]:offsets[i + 1]]), 'PartitionKey': 'BTCUSDT'}
+               for i in range(result['records'])]
+    ingestor = sbe_decoder_cpp.RecordIngestor(capacity=16, quantile_horizons_seconds=[10])
+    assert ingestor.quantile_window('BTCUSDT') is None
+    ingestor.ingest(records)
+    features = ingestor.quantile_window('BTCUSDT').features()['10s']
+    assert 0.001 <= features['trade_size_p50'] <= 0.003
+    assert features['inter_arrival_ms_p50'] == 0.0
+    assert features['spread_bps_p50'] == pytest.approx(0.02 / 65000.0 * 1e4)
+
+
+def test_quantile_window_ignores_nan_and_inf():
+    window = sbe_decoder_cpp.QuantileWindow(horizons_seconds=[10])
+    for i in range(1000):
+        window.add_trade(50_000 + i, (math.nan, math.inf, 2.0)[i % 3])
+        window.add_quote(50_000 + i, 100.0, (math.inf, math.nan)[i % 2])
+        window.add_quote(50_000 + i, math.nan, 100.01)
+    window.add_quote(51_000, 100.0, 100.01)
+    features = window.features([0.0, 1.0])['10s']
+    assert features['trade_size_p0'] == features['trade_size_p100'] == 2.0
+    assert features['spread_bps_p100'] == pytest.approx(0.01 / 100.005 * 1e4)
+    with pytest.raises(ValueError):
+        window.features([math.nan])
+
+
+def test_window_checkpoint_restores_features_and_meta(tmp_path):
+    path = str(tmp_path / "windows.ckpt")
+    window = sbe_decoder_cpp.MultiHorizonWindow(horizons_seconds=[1, 10])
+    window.add(1_000, 100.0, 1.0, False)
+    window.add(9_500, 102.0, 3.0, True)
+    sbe_decoder_cpp.save_window_checkpoint(path, {"BTCUSDT": window}, b'{"positions": {}}')
+
+    checkpoint = sbe_decoder_cpp.WindowCheckpoint(path)
+    assert checkpoint.keys == ["BTCUSDT"] and checkpoint.meta == b'{"positions": {}}'
+    restored = sbe_decoder_cpp.MultiHorizonWindow(horizons_seconds=[1, 10])
+    assert checkpoint.restore("BTCUSDT", restored)
+    assert restored.features() == window.features()
+    # Other horizons, or an unknown key, leave the window cold
+    assert not checkpoint.restore("BTCUSDT", sbe_decoder_cpp.MultiHorizonWindow(horizons_seconds=[1, 60]))
+    assert not checkpoint.restore("ETHUSDT", restored)
+
+    ingestor = sbe_decoder_cpp.RecordIngestor(capacity=16, horizons_seconds=[1, 10])
+    assert ingestor.restore_windows(checkpoint) == 1
+    [(symbol, kind, ring, adopted)] = ingestor.take_new_buffers()
+    assert (symbol, kind, len(ring)) == ("BTCUSDT", "trade", 0)
+    assert adopted.features() == window.features()
+
+
+def test_trade_ring_overwrites_oldest_and_reads_columns_in_order():
+    ring = sbe_decoder_cpp.TradeRing(capacity=3)
+    assert ring.features() == {}
+    for ts, price in [(1_000, 100.0), (2_000, 101.0), (3_000, 102.0), (4_000, 103.0)]:
+        ring.append(ts, price, 1.0, ts == 4_000)
+    assert (len(ring), ring.overwritten) == (3, 1)
+    assert list(ring.columns()['price']) == [101.0, 102.0, 103.0]
+    features = ring.features()
+    assert (features['min_price'], features['price'], features['trade_count']) == (101.0, 103.0, 3)
+    assert (features['buy_volume'], features['sell_volume']) == (2.0, 1.0)
+    assert features['time_span_seconds'] == 2.0
+
+    quotes = sbe_decoder_cpp.QuoteRing()
+    quotes.append(1_000, 99.0, 1.0, 101.0, 3.0)
+    quotes.append(2_000, 100.0, 1.0, 101.0, 1.0)
+    features = quotes.features()
+    assert (features['spread'], features['max_spread'], features['update_count']) == (1.0, 2.0, 2)
+    assert features['size_imbalance'] == pytest.approx(-1 / 3)
+
+
+def test_feature_record_round_trips_header_and_values():
+    np = pytest.importorskip("numpy")
+    schema_hash = sbe_decoder_cpp.feature_schema_hash(['vwap', 'volume'])
+    assert schema_hash != sbe_decoder_cpp.feature_schema_hash(['volume', 'vwap'])
+    record = sbe_decoder_cpp.encode_feature_record(
+        [60000.5, 1.25], 'BTCUSDT', event_ts_us=1_000, schema_hash=schema_hash, written_ts_us=2_000)
+    assert len(record) == 64 + 2 * 4
+
+    decoded = sbe_decoder_cpp.decode_feature_record(record, schema_hash=schema_hash)
+    assert (decoded['symbol'], decoded['event_ts_us'], decoded['written_ts_us']) == ('BTCUSDT', 1_000, 2_000)
+    assert decoded['values'].dtype == np.float32
+    assert list(decoded['values']) == [60000.5, 1.25]
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.decode_feature_record(record, schema_hash=schema_hash + 1)
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.decode_feature_record(record[:-1])
+
+
+def test_feature_history_appends_and_decodes_interleaved_schemas():
+    np = pytest.importorskip("numpy")
+    chunk = sbe_decoder_cpp.FeatureHistoryChunk()
+    blob = b''
+    for i in range(100):
+        ts_us = 1_700_000_000_000_000 + i * 5_000_000
+        blob += chunk.append(7, ts_us, [60000.0 + i * 0.01, 1.5, float(i % 3)])
+        if i % 2 == 0:
+            blob += chunk.append(9, ts_us, [0.25])
+    assert (chunk.size, chunk.rows, chunk.schemas) == (len(blob), 150, 2)
+    # Grid timestamps and repeated values take a bit or so each
+    assert len(blob) < 150 * 8
+
+    resumed = sbe_decoder_cpp.FeatureHistoryChunk()
+    resumed.resume(blob)
+    assert (resumed.size, resumed.rows) == (chunk.size, chunk.rows)
+    newer = sbe_decoder_cpp.FeatureHistoryChunk()
+    tail = newer.append(7, 1_700_000_500_000_000, [1.0, 2.0, 3.0])
+
+    trades, quotes = sbe_decoder_cpp.decode_feature_history([None, blob, tail])
+    assert (trades['schema_hash'], quotes['schema_hash']) == (7, 9)
+    assert trades['values'].shape == (101, 3) and quotes['values'].shape == (50, 1)
+    assert trades['timestamps_us'][1] - trades['timestamps_us'][0] == 5_000_000
+    assert trades['timestamps_us'][-1] == 1_700_000_500_000_000
+    np.testing.assert_array_equal(trades['values'][:100, 0], 60000.0 + np.arange(100) * 0.01)
+    assert list(trades['values'][-1]) == [1.0, 2.0, 3.0]
+    with pytest.raises(ValueError):
+        chunk.append(7, 0, [1.0])
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.decode_feature_history([blob[:-1]])
+
+
+def test_feature_bus_publishes_latest_values_to_readers(tmp_path):
+    path = str(tmp_path / 'features.bus')
+    writer = sbe_decoder_cpp.FeatureBus.create(path, slots=2, capacity=4, history=2)
+    reader = sbe_decoder_cpp.FeatureBus.open(path)
+    assert reader.latest('BTCUSDT:trade') is None
+    for ts in (1, 2, 3):
+        assert writer.publish('BTCUSDT:trade', [float(ts), 0.5], event_ts_us=ts, schema_hash=9)
+    latest = reader.latest('BTCUSDT:trade')
+    assert (latest['event_ts_us'], latest['schema_hash'], list(latest['values'])) == (3, 9, [3.0, 0.5])
+    assert [entry['event_ts_us'] for entry in reader.history('BTCUSDT:trade', n=5)] == [3, 2]
+
+    assert writer.publish('ETHUSDT:trade', [1.0], event_ts_us=1)
+    assert not writer.publish('SOLUSDT:trade', [1.0], event_ts_us=1)
+    assert reader.keys() == ['BTCUSDT:trade', 'ETHUSDT:trade']
+    with pytest.raises(ValueError):
+        writer.publish('BTCUSDT:trade', [0.0] * 5, event_ts_us=4)
+    with pytest.raises(ValueError):
+        reader.publish('BTCUSDT:trade', [1.0], event_ts_us=4)
+
+
+def test_mlp_model_matches_numpy_and_round_trips_weights():
+    np = pytest.importorskip("numpy")
+    rng = np.random.default_rng(0)
+    w1, b1 = rng.normal(size=(8, 5)).astype(np.float32), rng.normal(size=8).astype(np.float32)
+    w2, b2 = rng.normal(size=(1, 8)).astype(np.float32), rng.normal(size=1).astype(np.float32)
+    mean, scale = np.arange(5, dtype=np.float32), np.full(5, 2.0, dtype=np.float32)
+    model = sbe_decoder_cpp.MlpModel([(w1, b1, 'relu'), (w2, b2, 'identity')], input_mean=mean, input_scale=scale)
+    assert model.layers == [(5, 8, 'relu'), (8, 1, 'identity')]
+
+    x = rng.normal(size=5).astype(np.float32)
+    expected = w2 @ np.maximum(w1 @ ((x - mean) / scale) + b1, 0) + b2
+    assert model.predict(x) == pytest.approx(expected, rel=1e-5)
+    restored = sbe_decoder_cpp.MlpModel.from_bytes(model.to_bytes())
+    assert restored.predict(x) == pytest.approx(expected, rel=1e-5)
+
+    restored.quantize()
+    assert restored.quantized
+    assert restored.predict(x) == pytest.approx(expected, rel=0.05, abs=0.05)
+    with pytest.raises(ValueError):
+        restored.to_bytes()
+    with pytest.raises(ValueError):
+        model.predict(x[:4])
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.MlpModel.from_bytes(model.to_bytes()[:-1])
+
+
+def test_simd_baseline_kernels_match_dispatched_ones():
+    assert sbe_decoder_cpp.SIMD_LEVEL in ('avx512', 'avx2', 'sse4.2', 'sse2', 'neon', 'scalar')
+    assert sbe_decoder_cpp.COLUMN_STATS_KERNEL == sbe_decoder_cpp.MLP_KERNEL == sbe_decoder_cpp.SIMD_LEVEL
+
+    # The level is picked at import, so the baseline runs in a fresh process
+    script = (
+        "import json, sbe_decoder_cpp as m\n"
+        "prices = [65000 + (i * 37 % 101) * 0.5 for i in range(1001)]\n"
+        "qtys = [0.001 * (i % 13 + 1) for i in range(1001)]\n"
+        "model = m.MlpModel([([[0.5, -1.0, 0.25], [1.5, 0.5, -0.75]], [0.1, -0.2], 'relu'),"
+        " ([[1.0, -2.0]], [0.3], 'identity')])\n"
+        "print(json.dumps([m.SIMD_LEVEL, m.column_stats(prices, qtys),"
+        " [float(v) for v in model.predict([0.2, -0.4, 1.0])]]))\n"
+    )
+    module_dir = os.path.dirname(sbe_decoder_cpp.__file__)
+    results = {}
+    for level in ('avx512', 'baseline'):
+        env = dict(os.environ, SBE_DECODER_SIMD=level, PYTHONPATH=module_dir)
+        out = subprocess.run([sys.executable, '-c', script], env=env, capture_output=True, text=True, check=True)
+        results[level] = json.loads(out.stdout)
+    (widest, widest_stats, widest_pred), (baseline, baseline_stats, baseline_pred) = results.values()
+    assert widest == sbe_decoder_cpp.SIMD_LEVEL
+    assert baseline in ('sse4.2', 'sse2', 'neon', 'scalar')
+    for key, value in widest_stats.items():
+        assert baseline_stats[key] == pytest.approx(value, rel=1e-9)
+    assert baseline_pred == pytest.approx(widest_pred, rel=1e-6)
+
+
+def test_mlp_predict_batch_runs_bus_matrix_through_one_forward_pass(tmp_path):
+    np = pytest.importorskip("numpy")
+    rng = np.random.default_rng(1)
+    w1, b1 = rng.normal(size=(6, 3)).astype(np.float32), rng.normal(size=6).astype(np.float32)
+    w2, b2 = rng.normal(size=(2, 6)).astype(np.float32), rng.normal(size=2).astype(np.float32)
+    model = sbe_decoder_cpp.MlpModel([(w1, b1, 'tanh'), (w2, b2, 'identity')])
+
+    bus = sbe_decoder_cpp.FeatureBus.create(str(tmp_path / 'features.bus'), slots=8, capacity=3)
+    keys = [f'SYM{i}:trade' for i in range(6)]
+    for i, key in enumerate(keys[:5]):
+        bus.publish(key, rng.normal(size=3), event_ts_us=i + 1, schema_hash=7)
+    ts, matrix = bus.latest_matrix(keys, 3, schema_hash=7)
+    assert list(ts) == [1, 2, 3, 4, 5, 0]
+    assert np.isnan(matrix[5]).all()
+
+    batch = model.predict_batch(matrix[:5])
+    assert batch.shape == (5, 2)
+    for row, x in zip(batch, matrix[:5]):
+        assert row == pytest.approx(model.predict(x), rel=1e-5)
+    with pytest.raises(ValueError):
+        model.predict_batch(matrix[:, :2])
+
+    record = sbe_decoder_cpp.encode_feature_record([1.0, 2.0, 3.0], 'BTCUSDT', 9, 7)
+    ts, matrix = sbe_decoder_cpp.feature_records_to_matrix([None, record], 3)
+    assert list(ts) == [0, 9] and list(matrix[1]) == [1.0, 2.0, 3.0]
+
+
+def test_feature_assembler_normalizes_bus_and_records_into_model_inputs(tmp_path):
+    trade_names = ['price', 'volume', 'vwap']
+    quote_names = ['imbalance', 'spread']
+    manifest = sbe_decoder_cpp.FeatureManifest.compile(
+        sources=[('trade', trade_names), ('bestBidAsk', quote_names)],
+        inputs=[('bestBidAsk', 'spread', 'standard', 1.0, 0.5),
+                ('trade', 'vwap', 'minmax', 100.0, 200.0, -1.0),
+                ('trade', 'price')])
+    assert len(manifest) == 3
+    assert manifest.sources[0] == ('trade', sbe_decoder_cpp.feature_schema_hash(trade_names), 3)
+    assert manifest.inputs[1] == (0, 2, 'minmax', 100.0, 200.0, -1.0)
+    assert sbe_decoder_cpp.FeatureManifest.from_bytes(manifest.to_bytes()).inputs == manifest.inputs
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.FeatureManifest.compile([('trade', trade_names)], [('trade', 'nope')])
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.FeatureManifest.from_bytes(manifest.to_bytes()[:-1])
+
+    assembler = sbe_decoder_cpp.FeatureAssembler(manifest)
+    bus = sbe_decoder_cpp.FeatureBus.create(str(tmp_path / 'features.bus'), slots=4, capacity=4)
+    bus.publish('BTCUSDT:trade', [150.0, 2.0, 150.0], event_ts_us=1,
+                schema_hash=sbe_decoder_cpp.feature_schema_hash(trade_names))
+    bus.publish('BTCUSDT:bestBidAsk', [float('nan'), 2.0], event_ts_us=2,
+                schema_hash=sbe_decoder_cpp.feature_schema_hash(quote_names))
+    bus.publish('ETHUSDT:bestBidAsk', [0.0, 2.0], event_ts_us=3, schema_hash=42)
+    ts, inputs = assembler.from_bus(bus, ['BTCUSDT', 'ETHUSDT'])
+    assert list(ts) == [2, 0]
+    assert inputs.dtype.name == 'float32'
+    assert list(inputs[0]) == [2.0, 0.5, 150.0]
+    # ETHUSDT has no trade vector and a quote of another schema: fill values
+    assert list(inputs[1]) == [0.0, -1.0, 0.0]
+    assert assembler.stats == {'rows': 2, 'missing': 1, 'schema_mismatches': 1, 'filled': 0}
+
+    one_source = sbe_decoder_cpp.FeatureAssembler(sbe_decoder_cpp.FeatureManifest.compile(
+        [('trade', trade_names)], [('trade', 'volume', 'standard', 1.0, 2.0), ('trade', 'vwap')]))
+    record = sbe_decoder_cpp.encode_feature_record([150.0, 5.0, float('inf')], 'BTCUSDT', 9,
+                                                   sbe_decoder_cpp.feature_schema_hash(trade_names))
+    ts, inputs = one_source.from_records([record, None])
+    assert list(ts) == [9, 0]
+    assert list(inputs[0]) == [2.0, 0.0]
+    assert one_source.stats['filled'] == 1
+    with pytest.raises(ValueError):
+        one_source.from_records([b'not a record'])
+
+def test_mlp_model_maps_aligned_weights_and_hot_swaps_versions(tmp_path):
+    np = pytest.importorskip("numpy")
+    rng = np.random.default_rng(2)
+    layers = [(rng.normal(size=(8, 5)).astype(np.float32), rng.normal(size=8).astype(np.float32), 'relu'),
+              (rng.normal(size=(1, 8)).astype(np.float32), rng.normal(size=1).astype(np.float32), 'identity')]
+    model = sbe_decoder_cpp.MlpModel(layers, input_mean=np.arange(5, dtype=np.float32),
+                                     input_scale=np.full(5, 2.0, dtype=np.float32))
+    x = rng.normal(size=5).astype(np.float32)
+
+    path = tmp_path / 'model.mlp'
+    path.write_bytes(model.to_aligned_bytes(revision=7))
+    mapped = sbe_decoder_cpp.MlpModel.load(str(path), prefault=True)
+    assert (mapped.mapped, mapped.revision, model.mapped) == (True, 7, False)
+    assert list(mapped.predict(x)) == list(model.predict(x))
+    assert mapped.to_bytes() == model.to_bytes()
+    (tmp_path / 'short.mlp').write_bytes(path.read_bytes()[:-64])
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.MlpModel.load(str(tmp_path / 'short.mlp'))
+
+    swap = sbe_decoder_cpp.MlpModelSwap()
+    assert swap.revision is None
+    with pytest.raises(ValueError):
+        swap.predict(x)
+    swap.load(str(path))
+    assert swap.pending
+    assert list(swap.predict(x)) == list(model.predict(x))
+    assert (swap.revision, swap.swaps, swap.pending) == (7, 1, False)
+
+    # A new version replaces the file by rename and is picked up by the
+    # next prediction; a bad file leaves the live model in place
+    retrained = sbe_decoder_cpp.MlpModel([(w * 0.5, b, act) for w, b, act in layers])
+    staging = tmp_path / 'model.mlp.new'
+    staging.write_bytes(retrained.to_aligned_bytes(revision=8))
+    os.replace(staging, path)
+    swap.load(str(path))
+    assert list(swap.predict_batch(x[None, :])[0]) == list(retrained.predict(x))
+    assert (swap.revision, swap.swaps) == (8, 2)
+    with pytest.raises(ValueError):
+        swap.load(str(tmp_path / 'short.mlp'))
+    assert swap.revision == 8 and not swap.pending
+
+def test_kpl_aggregator_round_trips_payloads_within_size_budget():
+    aggregator = sbe_decoder_cpp.KplAggregator(max_bytes=256)
+    payloads = [(f'SYM{i % 2}', b'{"trade_id":%d}' % i) for i in range(30)]
+    records = []
+    for key, payload in payloads:
+        if not aggregator.add(key, payload):
+            records.append(aggregator.finish())
+            assert aggregator.add(key, payload)
+    size = aggregator.size
+    records.append(aggregator.finish())
+    assert len(records) > 1 and len(records[-1]) == size
+    assert all(len(record) <= 256 for record in records)
+
+    unpacked = [pair for record in records for pair in sbe_decoder_cpp.kpl_deaggregate(record)]
+    assert unpacked == payloads
+    assert sbe_decoder_cpp.kpl_deaggregate(b'{"trade_id":1}') is None
+    aggregator.add('SYM0', b'lone')
+    assert aggregator.finish() == b'lone'
+    with pytest.raises(ValueError):
+        aggregator.add('SYM0', b'x' * (2 << 20))
+
+
+def test_record_compressor_round_trips_through_trained_dictionary():
+    samples = [
+        json.dumps({"msg_type": "depth", "symbol": "BTCUSDT", "first_update_id": 1000 + i,
+                    "bids": [[f"{65000 - i % 7 - j}.{i % 100:02d}", f"0.{i % 13}"] for j in range(5)],
+                    "asks": [[f"{65001 + i % 5 + j}.{i % 100:02d}", f"1.{i % 11}"] for j in range(5)]}).encode()
+        for i in range(600)
+    ]
+    dictionary = sbe_decoder_cpp.train_record_dictionary(samples, dict_size=4096)
+    compressor = sbe_decoder_cpp.RecordCompressor(dictionary)
+    decompressor = sbe_decoder_cpp.RecordDecompressor([dictionary])
+    assert decompressor.dictionary_ids == [compressor.dictionary_id] and compressor.dictionary_id != 0
+
+    compressed = [compressor.compress(sample) for sample in samples[:50]]
+    assert all(sbe_decoder_cpp.is_compressed_record(record) for record in compressed)
+    assert sum(map(len, compressed)) * 2 < sum(map(len, samples[:50]))
+    assert [decompressor.decompress(record) for record in compressed] == samples[:50]
+
+    # Payloads that do not shrink, and plain records, pass through
+    assert compressor.compress(b'{}') == b'{}'
+    assert decompressor.decompress(b'{"trade_id":1}') == b'{"trade_id":1}'
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.RecordDecompressor().decompress(compressed[0])
+
+
+def test_parquet_writer_encodes_rows_and_columns():
+    columns = [("symbol", "string"), ("event_ts", "timestamp_ms"), ("trade_id", "int64"),
+               ("price", "float64"), ("is_buyer_maker", "bool")]
+    writer = sbe_decoder_cpp.ParquetWriter(columns, row_group_size=64)
+    rows = [{"symbol": "BTCUSDT", "event_ts": 1_700_000_000_000 + i // 4, "trade_id": i,
+             "price": 65000.0 + i % 7, "is_buyer_maker": i % 3 == 0, "source": "rest"} for i in range(100)]
+    writer.append_rows(rows)
+    writer.append_columns({"symbol": "ETHUSDT", "event_ts": [1, 2], "trade_id": [100, 101],
+                           "price": [3000.5, 3001.0], "is_buyer_maker": [False, True]})
+    assert len(writer) == 102 and writer.columns == columns
+
+    # A failed call keeps nothing
+    with pytest.raises(KeyError):
+        writer.append_rows([{"symbol": "BTCUSDT"}])
+    with pytest.raises(ValueError):
+        writer.append_columns({"symbol": "BTCUSDT", "event_ts": [1], "trade_id": [1, 2], "price": [1.0],
+                               "is_buyer_maker": [True]})
+    assert len(writer) == 102
+
+    data = writer.finish()
+    assert data[:4] == b'PAR1' and data[-4:] == b'PAR1'
+    assert len(writer) == 0
+    footer = struct.unpack('<I', data[-8:-4])[0]
+    assert b'sbe_decoder_cpp' in data[-8 - footer:-8]
+
+    pq = pytest.importorskip("pyarrow.parquet")
+    import pyarrow as pa
+    parquet = pq.ParquetFile(pa.BufferReader(data))
+    assert parquet.metadata.num_rows == 102 and parquet.metadata.num_row_groups == 2
+    table = parquet.read(columns=["trade_id", "symbol"])
+    assert table.column("trade_id").to_pylist() == list(range(102))
+    assert table.column("symbol").to_pylist()[-3:] == ["BTCUSDT", "ETHUSDT", "ETHUSDT"]
+
+
+def test_ndjson_parser_reads_jsonl_into_typed_columns():
+    parser = sbe_decoder_cpp.NdjsonParser([("symbol", "string"), ("event_ts", "timestamp_ms"),
+                                           ("trade_id", "int64"), ("price", "float64"), ("is_buyer_maker", "bool")])
+    lines = [json.dumps({"symbol": "BTCUSDT", "event_ts": 1_700_000_000_000 + i, "trade_id": i,
+                         "price": "65000.5", "is_buyer_maker": i % 2 == 0}) for i in range(1000)]
+    lines[3] = '{"symbol": "BTCUSDT", "trade_id": 3'
+    lines[5] = json.dumps({"symbol": "BTCUSDT", "event_ts": 5, "trade_id": 5, "is_buyer_maker": False})
+    data = ("\n".join(lines) + "\n\n").encode()
+
+    result = parser.parse(data, threads=4)
+    assert result["rows"] == 999 and result["bad_lines"] == 1
+    columns = result["columns"]
+    assert list(columns["trade_id"][:5]) == [0, 1, 2, 4, 5]
+    assert columns["price"][0] == 65000.5 and columns["is_buyer_maker"][0]
+    assert columns["symbol"][0] is columns["symbol"][998]
+    assert list(result["missing"]) == ["price"] and result["missing"]["price"].sum() == 1
+    assert parser.parse(data, threads=1)["columns"]["trade_id"].tolist() == columns["trade_id"].tolist()
+
+    depth = sbe_decoder_cpp.NdjsonParser([("symbol", "string"), ("side", "string"), ("level", "int64"),
+                                          ("price", "float64"), ("qty", "float64")])
+    snapshot = {"symbol": "ETHUSDT", "bids": [["3000.5", "1.0"], ["3000.4", "2.0"]], "asks": [["3000.6", "3.0"]]}
+    levels = depth.parse(json.dumps(snapshot).encode())["columns"]
+    assert levels["side"] == ["bid", "bid", "ask"] and list(levels["level"]) == [0, 1, 0]
+    assert list(levels["qty"]) == [1.0, 2.0, 3.0]
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.NdjsonParser([("side", "string")])
+
+
+def test_pg_copy_writer_encodes_binary_copy_rows():
+    from datetime import datetime
+    from decimal import Decimal
+
+    writer = sbe_decoder_cpp.PgCopyWriter([("symbol", "text"), ("trade_id", "int8"), ("price", "numeric"),
+                                           ("is_buyer_maker", "bool"), ("created_at", "timestamp")])
+    writer.append_columns({"symbol": ["BTCUSDT", None], "trade_id": [7, 8],
+                           "price": [Decimal("65000.50"), float("nan")], "is_buyer_maker": [True, False],
+                           "created_at": [datetime(2000, 1, 1, 0, 0, 1), 946684800_000_000]})
+    with pytest.raises(ValueError):
+        writer.append_columns({"symbol": ["X"], "price": ["not a number"]})
+    assert len(writer) == 2
+
+    data = writer.finish()
+    assert data[:11] == b"PGCOPY\n\xff\r\n\x00" and data[-2:] == b"\xff\xff"
+    row = data[19:]
+    assert struct.unpack(">h", row[:2])[0] == 5
+    assert row[2:17] == struct.pack(">i", 7) + b"BTCUSDT" + struct.pack(">i", 8)
+    # 65000.50: digit groups 6, 5000, 5000 with weight 1 and display scale 2
+    numeric = row[25:25 + 4 + 14]
+    assert numeric == struct.pack(">ihhHhhhh", 14, 3, 1, 0, 2, 6, 5000, 5000)
+    assert row[43:48] == struct.pack(">i", 1) + b"\x01"
+    assert struct.unpack(">iq", row[48:60]) == (8, 1_000_000)
+    assert row[60:62] == struct.pack(">h", 5) and row[62:66] == struct.pack(">i", -1)
+    assert len(writer) == 0
+
+
+def test_parse_decimals_keeps_digits_as_written():
+    values = ["65000.50", "0.00010000", "-1.5e3", "", "1_000", None, 7, b"12.3", "9223372036854775808"]
+    parsed = sbe_decoder_cpp.parse_decimals(values)
+    assert parsed["mantissa"].tolist() == [6500050, 10000, -15, 0, 0, 0, 0, 123, 0]
+    assert parsed["exponent"].tolist() == [-2, -8, 2, 0, 0, 0, 0, -1, 0]
+    assert parsed["valid"].tolist() == [True, True, True, False, False, False, False, True, False]
+    assert parsed["invalid"] == 5
+    # Exponents far past int8 are invalid, including ones whose sum with the
+    # fraction's digits would overflow int
+    edges = sbe_decoder_cpp.parse_decimals(["0.5e-2147483648", "1.5e2147483647", "1e-1001", "1.0e127"])
+    assert edges["valid"].tolist() == [False, False, False, True]
+
+    # Scaled to 10^-8 units; 1.234567891 has a ninth place and is invalid
+    scaled = sbe_decoder_cpp.parse_decimals(["65000.5", "0.0001", "1.234567891"], exponent=-8)
+    assert scaled["value"].tolist() == [6500050000000, 10000, 0]
+    assert scaled["valid"].tolist() == [True, True, False]
+
+
+def test_id_interval_set_plans_minimal_requests():
+    captured = sbe_decoder_cpp.IdIntervalSet()
+    captured.add(10, 20)
+    captured.add(30, 40)
+    captured.add(21, 29)
+    captured.add_ids([50, 46, 45])
+    assert captured.intervals == [(10, 40), (45, 46), (50, 50)]
+    assert captured.count == 34 and 25 in captured and 44 not in captured
+
+    assert captured.missing(0, 60) == [(0, 9), (41, 44), (47, 49), (51, 60)]
+    # The 45-46 and 50 runs are refetched rather than costing requests
+    assert captured.plan(0, 60, limit=10) == [(0, 10), (41, 9), (51, 10)]
+    assert captured.plan(10, 40) == []
+    with pytest.raises(ValueError):
+        captured.add(5, 4)
+
+
+def test_decode_event_returns_typed_objects(decoder):
+    trade = decoder.decode_event(trade_frame([(9, 6500000, 100, True)]))
+    assert isinstance(trade, sbe_decoder_cpp.TradeEvent)
+    assert (trade.msg_type, trade.symbol, trade.trade_id) == ('trade', 'BTCUSDT', 9)
+    assert trade.price == pytest.approx(65000.0)
+    with pytest.raises(AttributeError):
+        trade.price = 1.0
+
+    bba = decoder.decode_event(bba_frame(6499999, 10, 6500001, 20, update_id=77))
+    assert isinstance(bba, sbe_decoder_cpp.BestBidAskEvent)
+    assert bba.book_update_id == 77
+    assert bba.ask_px == pytest.approx(65000.01)
+
+    assert decoder.decode_event(sbe_header(0, 999)) is None
+
+
+def depth_frame(first_update_id: int, final_update_id: int, bids, asks,
+                symbol: bytes = b"BTCUSDT", event_time_us: int = 1_700_000_000_000_000,
+                price_exponent: int = -2, qty_exponent: int = -5) -> bytes:
+    """DepthDiffStreamEvent (10003): fixed block, bids/asks groupSize16 groups, symbol."""
+    body = struct.pack('<qqqbb', event_time_us, first_update_id, final_update_id, price_exponent, qty_exponent)
+    for levels in (bids, asks):
+        body += struct.pack('<HH', 16, len(levels))
+        for price, qty in levels:
+            body += struct.pack('<qq', price, qty)
+    body += struct.pack('<B', len(symbol)) + symbol
+    return sbe_header(26, 10003) + body
+
+
+def test_order_book_applies_depth_diffs():
+    book = sbe_decoder_cpp.OrderBook("BTCUSDT")
+    Status = sbe_decoder_cpp.ApplyStatus
+
+    assert book.apply(depth_frame(1, 5, [(6500000, 100), (6499900, 200)], [(6500100, 300)])) == Status.APPLIED
+    assert book.apply(depth_frame(6, 7, [(6500000, 0)], [(6500050, 10)])) == Status.APPLIED
+    assert book.apply(depth_frame(3, 7, [(1, 1)], [])) == Status.STALE
+    assert book.apply(depth_frame(9, 10, [(1, 1)], [])) == Status.GAP
+
+    assert book.last_update_id == 7
+    assert book.best_bid == pytest.approx((64999.0, 0.002))
+    assert book.top_asks(5) == [pytest.approx((65000.5, 0.0001)), pytest.approx((65001.0, 0.003))]
+    assert book.bid_levels == 1
+
+
+def test_order_book_sums_order_flow_imbalance_per_level():
+    book = sbe_decoder_cpp.OrderBook("BTCUSDT")
+    book.track_order_flow(levels=2)
+    # Seeding the book is not order flow
+    book.apply(depth_frame(1, 5, [(6500000, 100), (6499900, 200)], [(6500100, 300)]))
+    assert book.order_flow['updates'] == 0
+
+    # The best bid grows by 40 and the only ask leaves: both buying pressure
+    book.apply(depth_frame(6, 7, [(6500000, 140)], [(6500100, 0)]))
+    flow = book.take_order_flow()
+    assert list(flow['ofi']) == pytest.approx([0.0004 + 0.003, 0.0])
+    assert (flow['bid_added'], flow['ask_removed'], flow['updates']) == (pytest.approx(0.0004), pytest.approx(0.003), 1)
+    assert book.order_flow['updates'] == 0 and list(book.order_flow['ofi']) == [0.0, 0.0]
+
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=1)
+    pool.set_order_flow_levels(3)
+    assert pool.take_order_flow("BTCUSDT") is None
+    pool.decode_batch([depth_frame(1, 5, [(6500000, 100)], [(6500100, 300)]),
+                       depth_frame(6, 6, [(6500000, 0)], [])])
+    flow = pool.take_order_flow("BTCUSDT")
+    assert len(flow['ofi']) == 3 and flow['ofi'][0] == pytest.approx(-0.001)
+    assert flow['bid_removed'] == pytest.approx(0.001)
+    assert pool.take_order_flow("BTCUSDT")['updates'] == 0
+
+
+def test_order_book_loads_rest_depth_json():
+    body = (b'{"lastUpdateId":1027024,"bids":[["65000.01000000","0.50000000"],["64999.50000000","1.25000000"]],'
+            b'"asks":[["65000.02000000","0.00100000"]]}')
+    book = sbe_decoder_cpp.OrderBook("BTCUSDT")
+    book.load_depth_json(body)
+
+    assert book.last_update_id == 1027024
+    # The coarsest exponents that keep every level exact
+    assert (book.price_exponent, book.qty_exponent) == (-2, -3)
+    assert book.top_bids(5) == [pytest.approx((65000.01, 0.5)), pytest.approx((64999.5, 1.25))]
+    assert book.best_ask == pytest.approx((65000.02, 0.001))
+
+    with pytest.raises(ValueError):
+        book.load_depth_json(b'{"lastUpdateId":5,"bids":[["abc","1"]],"asks":[]}')
+    assert book.last_update_id == 1027024
+    with pytest.raises(ValueError):
+        book.load_depth_json(b'{"code":-1121,"msg":"Invalid symbol."}')
+
+
+def test_order_book_level_arrays_are_read_only_snapshots():
+    book = sbe_decoder_cpp.OrderBook("BTCUSDT")
+    book.apply(depth_frame(1, 5, [(6500000, 100), (6499900, 200)], [(6500100, 300)]))
+    bids = book.bids_array(5)
+    assert bids.dtype.name == 'int64' and bids.shape == (2, 2)
+    assert bids.tolist() == [[6500000, 100], [6499900, 200]]
+    assert not bids.flags.writeable
+    with pytest.raises(ValueError):
+        bids[0, 1] = 1
+    # Between changes every read shares one buffer
+    address = bids.__array_interface__['data'][0]
+    assert book.bids_array(1).__array_interface__['data'][0] == address
+    assert book.asks_array(dtype='float64').tolist() == [pytest.approx([65001.0, 0.003])]
+
+    epoch = book.epoch
+    book.apply(depth_frame(6, 6, [(6500000, 0)], []))
+    assert book.epoch > epoch
+    # A held array keeps the levels it was taken at
+    assert bids.tolist() == [[6500000, 100], [6499900, 200]]
+    assert book.bids_array(5).tolist() == [[6499900, 200]]
+
+    with pytest.raises(ValueError):
+        book.bids_array(5, dtype='float32')
+
+
+def test_order_book_tick_grid_matches_plain_book():
+    plain = sbe_decoder_cpp.OrderBook("BTCUSDT")
+    gridded = sbe_decoder_cpp.OrderBook("BTCUSDT")
+    gridded.set_tick(1, -2)
+    assert gridded.tick_size == pytest.approx(0.01)
+
+    diffs = [
+        ([(6500000, 100), (6499900, 200), (6000000, 5)], [(6500100, 300), (7000000, 5)]),
+        ([(6500000, 0), (6500050, 10)], [(6500050, 0), (6500060, 7)]),
+        ([(6600000, 1)], []),  # the touch jumps far past the window
+        ([(6600000, 0), (6500050, 0)], []),
+    ]
+    for seq, (bids, asks) in enumerate(diffs, start=1):
+        plain.apply(depth_frame(seq, seq, bids, asks))
+        gridded.apply(depth_frame(seq, seq, bids, asks))
+        assert gridded.top_bids(10) == plain.top_bids(10)
+        assert gridded.top_asks(10) == plain.top_asks(10)
+    assert list(gridded.features) == pytest.approx(list(plain.features), nan_ok=True)
+
+
+def test_order_book_refreshes_features_on_each_update():
+    book = sbe_decoder_cpp.OrderBook("BTCUSDT")
+    names = sbe_decoder_cpp.BOOK_FEATURE_NAMES
+    assert all(map(math.isnan, book.features))
+
+    book.load_snapshot(1, [(10000, 100), (9999, 100)], [(10001, 300)], -2, -2)
+    features = dict(zip(names, book.features))
+    assert (features['spread_ticks'], features['bid_depth_5']) == pytest.approx((1.0, 2.0))
+    assert features['microprice'] == pytest.approx((100.0 * 3 + 100.01) / 4)
+    assert features['imbalance_1'] == pytest.approx(-0.5)
+
+    book.apply(depth_frame(2, 2, [(10000, 0)], []))
+    assert dict(zip(names, book.features))['best_bid'] == pytest.approx(99.99)
+
+
+def test_view_reads_fields_lazily(decoder):
+    frame = bytearray(depth_frame(11, 15, [(6500000, 100)], [], symbol=b"ETHUSDT"))
+
+    view = decoder.view(frame)
+
+    assert (view.msg_type, view.template_id, len(view)) == ('depthDiff', 10003, len(frame))
+    assert (view.first_update_id, view.final_update_id, view.book_update_id) == (11, 15, None)
+    assert view.event_ts == 1_700_000_000_000 and view.trade_time is None
+    assert view.symbol == 'ETHUSDT'
+    # The view pins the buffer it reads from
+    with pytest.raises(BufferError):
+        frame.extend(b"x")
+
+    assert decoder.view(trade_frame([(1, 1, 1, False)])).trade_time is not None
+    with pytest.raises(RuntimeError):
+        decoder.view(depth_frame(1, 2, [], [])[:20])
+
+
+def partial_depth_frame(book_update_id: int, bids, asks, symbol: bytes = b"BTCUSDT",
+                        event_time_us: int = 1_700_000_000_000_000) -> bytes:
+    """DepthSnapshotStreamEvent (10002): top-N levels as of book_update_id."""
+    body = struct.pack('<qqbb', event_time_us, book_update_id, -2, -5)
+    for levels in (bids, asks):
+        body += struct.pack('<HH', 16, len(levels))
+        for price, qty in levels:
+            body += struct.pack('<qq', price, qty)
+    body += struct.pack('<B', len(symbol)) + symbol
+    return sbe_header(18, 10002) + body
+
+
+def test_partial_depth_decodes_to_columns_and_resyncs_book(decoder):
+    partial = partial_depth_frame(42, [(6500000, 100), (6499900, 200)], [(6500100, 300)])
+    batch = decoder.decode_batch([partial])
+    assert list(batch['partialDepth']['book_update_id']) == [42]
+    assert list(batch['depthLevels']['is_bid']) == [True, True, False]
+    assert len(batch['unknown']) == 0
+
+    book = sbe_decoder_cpp.OrderBook("BTCUSDT")
+    Status = sbe_decoder_cpp.ApplyStatus
+    assert book.apply(partial) == Status.APPLIED
+    assert book.apply(partial_depth_frame(50, [(1, 1)], [])) == Status.STALE
+    assert book.apply(depth_frame(60, 61, [], [])) == Status.GAP
+    assert book.resync_pending
+    assert book.apply(partial_depth_frame(70, [(6400000, 5)], [(6400100, 6)])) == Status.APPLIED
+    assert not book.resync_pending
+    assert book.last_update_id == 70
+    assert book.best_bid == pytest.approx((64000.0, 0.00005))
+
+
+def depth_response_frame(last_update_id: int, bids, asks) -> bytes:
+    """REST DepthResponse (200): full book as of last_update_id."""
+    body = struct.pack('<qbb', last_update_id, -2, -5)
+    for levels in (bids, asks):
+        body += struct.pack('<HI', 16, len(levels))
+        for price, qty in levels:
+            body += struct.pack('<qq', price, qty)
+    return sbe_header(10, 200) + body
+
+
+def test_decode_depth_snapshot_loads_native_book():
+    frame = depth_response_frame(77, [(6500000, 100), (6499900, 200)], [(6500100, 300)])
+    book = sbe_decoder_cpp.decode_depth_snapshot(frame, symbol="BTCUSDT")
+    assert isinstance(book, sbe_decoder_cpp.OrderBook)
+    assert book.symbol == "BTCUSDT"
+    assert book.last_update_id == 77
+    assert book.bid_levels == 2
+    assert book.best_ask == pytest.approx((65001.0, 0.003))
+    assert book.apply(depth_frame(78, 78, [(6500000, 0)], [])) == sbe_decoder_cpp.ApplyStatus.APPLIED
+    assert book.best_bid == pytest.approx((64999.0, 0.002))
+
+    book.load_depth_response(depth_response_frame(90, [(6400000, 5)], []))
+    assert (book.last_update_id, book.bid_levels, book.ask_levels) == (90, 1, 0)
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.decode_depth_snapshot(depth_frame(1, 1, [], []))
+    with pytest.raises(ValueError):
+        book.load_depth_response(frame[:-8])
+    assert book.resync_pending
+
+
+def test_book_checksum_matches_snapshot_without_compare():
+    snapshot = depth_response_frame(5, [(6500000, 100), (6499900, 200), (6499800, 50)], [(6500100, 300)])
+    book = sbe_decoder_cpp.decode_depth_snapshot(snapshot, symbol="BTCUSDT")
+    assert book.checksum() == sbe_decoder_cpp.depth_snapshot_checksum(snapshot)
+    assert book.checksum(2) == sbe_decoder_cpp.depth_snapshot_checksum(snapshot, depth=2) != book.checksum()
+
+    # Kept up to date by diffs, including one at finer exponents that
+    # rescales the book: levels are compared by value
+    assert book.apply(depth_frame(6, 6, [(6499900, 0), (6500050, 7)], [])) == sbe_decoder_cpp.ApplyStatus.APPLIED
+    finer = depth_frame(7, 7, [(64998000, 500)], [], price_exponent=-3, qty_exponent=-6)
+    assert book.apply(finer) == sbe_decoder_cpp.ApplyStatus.APPLIED
+    current = depth_response_frame(7, [(6500050, 7), (6500000, 100), (6499800, 50)], [(6500100, 300)])
+    assert book.checksum() == sbe_decoder_cpp.depth_snapshot_checksum(current)
+    drifted = depth_response_frame(7, [(6500050, 7), (6500000, 101), (6499800, 50)], [(6500100, 300)])
+    assert book.checksum() != sbe_decoder_cpp.depth_snapshot_checksum(drifted)
+
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=2)
+    assert pool.checksum("BTCUSDT") is None
+    pool.load_depth_response("BTCUSDT", snapshot)
+    assert pool.checksum("BTCUSDT") == sbe_decoder_cpp.depth_snapshot_checksum(snapshot)
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.depth_snapshot_checksum(depth_frame(1, 1, [], []))
+
+
+def test_book_sync_replays_buffered_diffs_onto_snapshot():
+    Status, Sync = sbe_decoder_cpp.ApplyStatus, sbe_decoder_cpp.SyncResult
+    sync = sbe_decoder_cpp.BookSync("BTCUSDT")
+    assert sync.apply(depth_frame(1, 10, [(6500000, 100)], [(6500100, 100)])) == Status.APPLIED
+    assert sync.apply(depth_frame(15, 16, [(6500000, 200)], [])) == Status.GAP
+    assert sync.apply(depth_frame(17, 18, [(6499900, 50)], [])) == Status.BUFFERED
+    assert sync.apply(depth_frame(19, 20, [], [(6500100, 0)])) == Status.BUFFERED
+    assert sync.syncing and sync.buffered == 3
+
+    # Diffs 15..16 start past 12 + 1: this snapshot cannot anchor them
+    old = depth_response_frame(12, [(6400000, 1)], [(6600000, 1)])
+    assert sync.load_depth_response(old) == Sync.SNAPSHOT_TOO_OLD
+    assert sync.book.last_update_id == 10 and sync.buffered == 3
+
+    snapshot = depth_response_frame(17, [(6500000, 300)], [(6500100, 5), (6500200, 7)])
+    assert sync.load_depth_response(snapshot) == Sync.SYNCED
+    assert not sync.syncing
+    assert (sync.buffered, sync.replayed, sync.skipped) == (0, 2, 1)
+    book = sync.book
+    assert book.last_update_id == 20
+    assert book.top_bids(2) == pytest.approx([(65000.0, 0.003), (64999.0, 0.0005)])
+    assert book.best_ask == pytest.approx((65002.0, 0.00007))
+    assert sync.apply(depth_frame(21, 21, [], [])) == Status.APPLIED
+
+    sync.resync()
+    assert sync.apply(depth_frame(30, 31, [(6500000, 9)], [])) == Status.BUFFERED
+    assert sync.load_partial_depth(partial_depth_frame(29, [(6500000, 1)], [(6500100, 1)])) == Sync.SYNCED
+    assert sync.book.last_update_id == 31
+    assert sync.book.best_bid == pytest.approx((65000.0, 0.00009))
+
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=2)
+    pool.decode_batch([depth_frame(1, 2, [(6500000, 100)], [])])
+    result = pool.decode_batch([depth_frame(5, 6, [], [(6500100, 10)]), depth_frame(7, 8, [(6500000, 0)], [])])
+    assert result['book_gaps'] == ['BTCUSDT']
+    assert pool.load_depth_response("BTCUSDT", depth_response_frame(4, [(6499900, 1)], [])) == Sync.SYNCED
+    assert pool.book("BTCUSDT")['last_update_id'] == 8
+
+    # A bad snapshot is rejected before it can touch the published book
+    with pytest.raises(ValueError):
+        pool.load_depth_response("BTCUSDT", depth_frame(9, 9, [], []))
+    assert pool.book("BTCUSDT")['last_update_id'] == 8
+
+
+def agg_trades_frame(trades) -> bytes:
+    """REST AggTradesResponse (202): (agg_id, price, qty, first_id, last_id, time, buyer_maker) rows."""
+    body = struct.pack('<bb', -2, -5) + struct.pack('<HI', 50, len(trades))
+    for agg_id, price, qty, first_id, last_id, time, maker in trades:
+        body += struct.pack('<qqqqqqBB', agg_id, price, qty, first_id, last_id, time, maker, 1)
+    return sbe_header(2, 202) + body
+
+
+def test_agg_trades_page_decodes_to_columns(decoder):
+    page = agg_trades_frame([(7, 6500000, 100, 70, 72, 1_700_000_000_000, True),
+                             (8, 6500100, 250, 73, 73, 1_700_000_000_005, False)])
+    batch = decoder.decode_batch([page, page[:-10]])
+    agg = batch['aggTrades']
+    assert list(agg['agg_trade_id']) == [7, 8]
+    assert list(agg['price']) == [pytest.approx(65000.0), pytest.approx(65001.0)]
+    assert list(agg['last_trade_id']) == [72, 73]
+    assert list(agg['is_buyer_maker']) == [True, False]
+    assert list(batch['errors']) == [1]
+
+    raw = decoder.decode_batch([page], raw=True)['aggTrades']
+    assert list(raw['qty']) == [100, 250]
+    assert list(raw['qty_exponent']) == [-5, -5]
+
+
+def klines_frame(klines) -> bytes:
+    """REST KlinesResponse (203): (open_time, open, high, low, close, volume, num_trades) rows."""
+    body = struct.pack('<bb', -2, -5) + struct.pack('<HI', 120, len(klines))
+    for open_time, o, h, l, c, volume, trades in klines:
+        body += struct.pack('<qqqqq', open_time, o, h, l, c) + volume.to_bytes(16, 'little')
+        body += struct.pack('<q', open_time + 59_999) + (volume * c).to_bytes(16, 'little')
+        body += struct.pack('<q', trades) + bytes(32)
+    return sbe_header(2, 203) + body
+
+
+def test_klines_page_decodes_to_columns(decoder):
+    page = klines_frame([(1_700_000_000_000, 6500000, 6510000, 6490000, 6505000, 150000, 42)])
+    klines = decoder.decode_batch([page])['klines']
+    assert list(klines['open_time']) == [1_700_000_000_000]
+    assert list(klines['close_time']) == [1_700_000_059_999]
+    assert list(klines['high']) == [pytest.approx(65100.0)]
+    assert list(klines['volume']) == [pytest.approx(1.5)]
+    assert list(klines['quote_volume']) == [pytest.approx(97575.0)]
+    assert list(klines['num_trades']) == [42]
+
+    raw = decoder.decode_batch([page], raw=True)['klines']
+    assert list(raw['close']) == [6505000]
+    assert list(raw['price_exponent']) == [-2]
+
+
+def test_decode_batch_raw_mantissas(decoder):
+    batch = decoder.decode_batch([trade_frame([(1, 6512345, 150, False)])], raw=True)
+
+    trades = batch['trade']
+    assert list(trades['price']) == [6512345]
+    assert list(trades['qty']) == [150]
+    assert list(trades['price_exponent']) == [-2]
+    assert list(trades['qty_exponent']) == [-5]
+
+
+def test_decode_batch_exports_arrow_tables(decoder):
+    frames = [trade_frame([(1, 6500000, 100, False), (2, 6500100, 200, True)]),
+              trade_frame([(3, 6500200, 300, False)], symbol=b"ETHUSDT")]
+    batch = decoder.decode_batch(frames, raw=True, format="arrow")
+
+    trades = batch['trade']
+    assert len(trades) == trades.num_rows == 3
+    assert 'price_exponent' in trades.column_names
+    schema, array = trades.__arrow_c_array__()
+    assert schema.__class__.__name__ == 'PyCapsule' and array.__class__.__name__ == 'PyCapsule'
+    with pytest.raises(ValueError):
+        decoder.decode_batch(frames, format="pandas")
+
+    pa = pytest.importorskip("pyarrow")
+    table = pa.record_batch(trades)
+    assert table.column('trade_id').to_pylist() == [1, 2, 3]
+    assert table.column('price').to_pylist() == [6500000, 6500100, 6500200]
+    assert table.column('is_buyer_maker').to_pylist() == [False, True, False]
+    assert table.column('symbol').to_pylist() == ['BTCUSDT', 'BTCUSDT', 'ETHUSDT']
+    assert pa.record_batch(batch['depthDiff']).num_rows == 0
+
+
+def test_debug_fields_only_in_debug_decoder(decoder):
+    frame = trade_frame([(5, 100, 1, False)])
+
+    assert not any(key.startswith('debug_') for key in decoder.decode_message(frame))
+    debug = sbe_decoder_cpp.SBEDecoder(debug=True).decode_message(frame)
+    assert debug['debug_num_in_group'] == 1
+    assert debug['debug_next_16_bytes'].startswith('1900')
+
+
+def test_decode_message_reuses_result_shape_without_stale_keys(decoder):
+    frame = trade_frame([(7, 6500000, 100, False)])
+    first = decoder.decode_message(frame)
+    second = decoder.decode_message(trade_frame([(8, 6500100, 200, True)]))
+    assert list(second) == list(first)
+    assert (second['trade_id'], second['is_buyer_maker']) == (8, True)
+
+    failed = decoder.decode_message(frame[:20])
+    assert failed['symbol'] == 'PARSE_ERROR' and 'parse_error' in failed
+    assert 'price_exponent' not in failed
+    assert list(decoder.decode_message(frame)) == list(first)
+
+
+def test_try_decode_returns_dict_or_status(decoder):
+    Status = sbe_decoder_cpp.DecodeStatus
+
+    decoded = decoder.try_decode(trade_frame([(3, 100, 1, False)]))
+    assert decoded['template_id'] == sbe_decoder_cpp.TRADES_STREAM_EVENT
+    assert decoded['trade_id'] == 3
+
+    assert decoder.try_decode(b"\x00\x01") == Status.TOO_SHORT
+    assert decoder.try_decode(struct.pack('<HHHH', 0, 10000, 7, 0)) == Status.SCHEMA_MISMATCH
+    assert decoder.try_decode(sbe_header(0, 999)) == Status.UNKNOWN_TEMPLATE
+    assert decoder.try_decode(trade_frame([(3, 100, 1, False)])[:20]) == Status.MALFORMED
+
+
+def test_ingest_timestamp_is_shared_and_microsecond(decoder):
+    stamp = sbe_decoder_cpp.ingest_clock_us()
+    batch = decoder.decode_batch([trade_frame([(1, 1, 1, False)])], ingest_ts_us=stamp)
+    assert batch['ingest_ts_us'] == stamp
+    assert batch['ingest_ts'] == stamp // 1000
+
+    decoded = decoder.try_decode(trade_frame([(1, 1, 1, False)]), ingest_ts_us=stamp)
+    assert decoded['ingest_ts_us'] == stamp
+    assert decoder.decode_event(trade_frame([(1, 1, 1, False)]), ingest_ts_us=stamp).ingest_ts_us == stamp
+
+
+def test_dispatch_covers_partial_depth_and_rest_depth(decoder):
+    assert {10000, 10001, 10002, 10003, 200, 201, 202, 203, 212} <= set(decoder.supported_templates())
+
+    body = struct.pack('<qqbb', 1_700_000_000_000_000, 42, -2, -5)
+    body += struct.pack('<HH', 16, 1) + struct.pack('<qq', 6500000, 100)
+    body += struct.pack('<HH', 16, 0)
+    body += struct.pack('<B', 7) + b"BTCUSDT"
+    partial = decoder.try_decode(sbe_header(18, 10002) + body)
+    assert partial['msg_type'] == 'partialDepth'
+    assert partial['book_update_id'] == 42
+    assert partial['bids'] == [[pytest.approx(65000.0), pytest.approx(0.001)]]
+
+    rest = sbe_header(10, 200) + struct.pack('<qbb', 77, -2, -5)
+    rest += struct.pack('<HI', 16, 1) + struct.pack('<qq', 6500100, 300)
+    rest += struct.pack('<HI', 16, 0)
+    snapshot = decoder.decode_message(rest)
+    assert snapshot['msg_type'] == 'depthSnapshot'
+    assert snapshot['last_update_id'] == 77
+    assert snapshot['bids'][0][0] == pytest.approx(65001.0)
+
+
+def test_level_arrays_decoder_returns_level_views():
+    arrays = sbe_decoder_cpp.SBEDecoder(level_arrays=True)
+    frame = depth_frame(10, 12, [(6500000, 100), (6499900, 200)], [(6500100, 300)])
+
+    first = arrays.decode_message(frame)
+    assert first['bids'].shape == (2, 2)
+    assert first['bids'][1, 0] == pytest.approx(64999.0)
+    assert first['asks'].tolist() == [[pytest.approx(65001.0), pytest.approx(0.003)]]
+
+    # Views held by the caller keep their levels; later decodes go past them
+    second = arrays.decode_message(depth_frame(13, 13, [(6400000, 1)], []))
+    assert first['bids'][0, 0] == pytest.approx(65000.0)
+    assert second['bids'][0, 0] == pytest.approx(64000.0)
+    assert arrays.arena_stats()['used'] == 4
+
+    del first, second
+    arrays.decode_message(frame)
+    assert arrays.arena_stats()['used'] == 3
+    assert arrays.arena_stats()['blocks_allocated'] == 1
+
+
+def test_decimal_strings_decoder_formats_levels_exactly():
+    strings = sbe_decoder_cpp.SBEDecoder(decimal_strings=True)
+    frame = depth_frame(10, 12, [(6500000, 100), (6499990, 123456)], [(6500100, 0)])
+
+    result = strings.decode_message(frame)
+    assert result['bids'] == [['65000', '0.001'], ['64999.9', '1.23456']]
+    assert result['asks'] == [['65001', '0']]
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.SBEDecoder(level_arrays=True, decimal_strings=True)
+
+
+def test_stream_msg_types_decoder_emits_published_schema():
+    published = sbe_decoder_cpp.SBEDecoder(decimal_strings=True, stream_msg_types=True)
+    assert published.stream_msg_types
+
+    diff = published.decode_message(depth_frame(10, 12, [(6500000, 100)], [(6500100, 0)]))
+    assert diff['msg_type'] == 'depth'
+    assert diff['source'] == 'sbe'
+    assert diff['symbol'] == 'BTCUSDT'
+    assert isinstance(diff['event_ts'], int)
+    assert diff['bids'] == [['65000', '0.001']]
+    assert published.decode_message(trade_frame([(1, 6500000, 100, True)]))['msg_type'] == 'trade'
+    assert published.decode_message(bba_frame(6500000, 150, 6500100, 200))['msg_type'] == 'bestBidAsk'
+
+    # Templates keep their own names by default
+    assert sbe_decoder_cpp.SBEDecoder().decode_message(depth_frame(10, 12, [], []))['msg_type'] == 'depthDiff'
+
+
+def test_capture_frames_keeps_recent_sampled_and_failed_frames():
+    decoder = sbe_decoder_cpp.SBEDecoder()
+    assert decoder.captured_frames() is None
+
+    decoder.capture_frames(recent=2, sample_every=2, sampled=4, failed=4, max_bytes=16)
+    trade = trade_frame([(1, 6500000, 100, True)])
+    for _ in range(3):
+        decoder.try_decode(trade)
+    decoder.try_decode(sbe_header(0, 998))
+    decoder.try_decode(b"\x01\x02")
+
+    frames = decoder.captured_frames()
+    assert frames['seen'] == 5
+    assert [f['seq'] for f in frames['recent']] == [3, 4]
+    assert [f['seq'] for f in frames['sampled']] == [0, 2, 4]
+    assert [f['status'] for f in frames['failed']] == ['unknown_template', 'too_short']
+    assert frames['failed'][0]['template_id'] == 998
+    assert frames['failed'][1]['template_id'] is None
+
+    first = frames['sampled'][0]
+    assert first['status'] == 'ok'
+    assert first['size'] == len(trade)
+    assert first['truncated']
+    assert first['hex'] == trade[:16].hex()
+
+    decoder.captured_frames(clear=True)
+    cleared = decoder.captured_frames()
+    assert cleared['recent'] == cleared['sampled'] == cleared['failed'] == []
+
+
+def test_native_logger_forwards_rejected_frames():
+    native_log = sbe_decoder_cpp.native_logger()
+    with pytest.raises(ValueError):
+        native_log.start(level="LOUD")
+
+    native_log.start(level="WARNING", forward=True)
+    try:
+        sbe_decoder_cpp.SBEDecoder().try_decode(sbe_header(0, 998))
+        native_log.flush()
+        lines = [line for line in native_log.drain() if line[2] == 'decoder']
+    finally:
+        native_log.stop()
+
+    time_us, level, _, message = lines[-1]
+    assert level == logging.WARNING
+    assert time_us > 0
+    assert 'unknown_template' in message and 'template 998' in message
+    assert native_log.stats['records'] >= 1
+
+    # Stopped: nothing is recorded
+    records = native_log.stats['records']
+    sbe_decoder_cpp.SBEDecoder().try_decode(sbe_header(0, 998))
+    assert native_log.stats['records'] == records
+
+
+def test_serialize_records_writes_kinesis_json(decoder):
+    frames = [trade_frame([(1, 6500000, 100, True), (2, 6500100, 200, False)]),
+              depth_frame(10, 12, [(6500000, 100)], [(6500100, 0)]),
+              b"\x01\x02"]
+    out = bytearray(4096)
+
+    result = decoder.serialize_records(frames, out, ingest_ts_us=1_700_000_000_999_000)
+    assert result['frames_consumed'] == 3
+    assert list(result['template_id']) == [10000, 10000, 10003]
+    assert result['partition_keys'] == ['BTCUSDT'] * 3
+    assert list(result['errors']) == [2]
+
+    offsets = result['offsets']
+    records = [json.loads(out[offsets[i]:offsets[i + 1]]) for i in range(result['records'])]
+    assert records[1]['trade_id'] == 2
+    assert records[1]['price'] == pytest.approx(65001.0)
+    assert records[0]['ingest_ts'] == 1_700_000_000_999
+    assert records[2]['bids'] == [['65000', '0.001']]
+    assert records[2]['asks'] == [['65001', '0']]
+    assert all(record['source'] == 'sbe' for record in records)
+
+    # Frames are never split: a short buffer stops before the one that does not fit
+    partial = decoder.serialize_records(frames, bytearray(int(offsets[2]) + 8))
+    assert partial['frames_consumed'] == 1
+    assert partial['records'] == 2
+
+
+def test_serialize_records_writes_exact_decimal_numbers(decoder):
+    # 19 significant digits: a double would print 12345678901.234568
+    frames = [trade_frame([(1, 1234567890123456789, 100, False), (2, 6500000, 150_000, True)],
+                          price_exponent=-8)]
+    out = bytearray(4096)
+
+    result = decoder.serialize_records(frames, out)
+    offsets = result['offsets']
+    records = [bytes(out[offsets[i]:offsets[i + 1]]) for i in range(result['records'])]
+    assert b'"price":12345678901.23456789,' in records[0]
+    assert b'"qty":0.001,' in records[0]
+    assert b'"price":0.065,"qty":1.5,' in records[1]
+
+
+def test_serialize_records_avro_round_trips(decoder):
+    frames = [trade_frame([(7, 6500000, 100, True)]), depth_frame(10, 12, [(6500000, 100)], [])]
+    out = bytearray(1024)
+
+    result = decoder.serialize_records(frames, out, ingest_ts_us=1_700_000_000_999_000, format='avro')
+    offsets = result['offsets']
+    trade, depth = (sbe_decoder_cpp.decode_avro(out[offsets[i]:offsets[i + 1]]) for i in range(2))
+
+    assert out[:2] == b'\xc3\x01'
+    assert trade['schema'] == 'binance.MarketTrade'
+    assert trade['trade_id'] == 7
+    assert trade['price'] == pytest.approx(65000.0)
+    assert trade['is_buyer_maker'] is True
+    assert trade['ingest_ts'] == 1_700_000_000_999
+    assert depth['schema'] == 'binance.DepthDelta'
+    assert depth['bids'] == [['65000', '0.001']]
+    assert depth['asks'] == []
+
+
+def test_kinesis_producer_publishes_serialized_records(decoder):
+    import base64
+    import threading
+    from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+    received, throttled = [], set()
+
+    class PutRecords(BaseHTTPRequestHandler):
+        protocol_version = "HTTP/1.1"
+
+        def log_message(self, *args):
+            pass
+
+        def do_POST(self):
+            assert self.headers['X-Amz-Target'] == 'Kinesis_20131202.PutRecords'
+            assert self.headers['Authorization'].startswith('AWS4-HMAC-SHA256 Credential=AK/')
+            request = json.loads(self.rfile.read(int(self.headers['Content-Length'])))
+            assert request['StreamName'] == 'trades'
+            results = []
+            for record in request['Records']:
+                data = base64.b64decode(record['Data'])
+                # Every record is throttled once
+                if data not in throttled:
+                    throttled.add(data)
+                    results.append({'ErrorCode': 'ProvisionedThroughputExceededException', 'ErrorMessage': 'slow'})
+                else:
+                    received.append((record['PartitionKey'], json.loads(data)['trade_id']))
+                    results.append({'SequenceNumber': '1', 'ShardId': 'shardId-000000000000'})
+            body = json.dumps({'FailedRecordCount': sum('ErrorCode' in r for r in results),
+                               'Records': results}).encode()
+            self.send_response(200)
+            self.send_header('Content-Length', str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+    server = ThreadingHTTPServer(('127.0.0.1', 0), PutRecords)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+    try:
+        frames = [trade_frame([(i, 6500000 + i, 100, False)], symbol=symbol)
+                  for i in range(40) for symbol in (b"BTCUSDT", b"ETHUSDT")]
+        out = bytearray(1 << 16)
+        result = decoder.serialize_records(frames, out)
+        shards = [('shardId-000000000000', '0', str(2 ** 127 - 1)),
+                  ('shardId-000000000001', str(2 ** 127), str(2 ** 128 - 1))]
+        producer = sbe_decoder_cpp.KinesisProducer('trades', 'us-east-1', 'AK', 'SECRET', shards=shards,
+                                                   host='127.0.0.1', port=server.server_port, use_tls=False,
+                                                   connections=2, linger=0.005)
+        assert producer.shard_count == 2
+        producer.start()
+        assert producer.put_records(out, result['offsets'], result['partition_keys']) == 80
+        assert producer.flush(timeout=30.0)
+        stats = producer.stats
+        assert stats['records_sent'] == 80 and stats['records_throttled'] == 80
+        assert stats['records_dropped'] == 0 and stats['queued_records'] == 0
+        assert stats['connects'] <= 2
+        for symbol in ('BTCUSDT', 'ETHUSDT'):
+            assert sorted(trade_id for key, trade_id in received if key == symbol) == list(range(40))
+        producer.stop()
+
+        with pytest.raises(ValueError):
+            producer.put(b'x', '')
+        with pytest.raises(ValueError):
+            sbe_decoder_cpp.KinesisProducer('trades', 'us-east-1', 'AK', 'SECRET', shards=[('s', '5', '1')])
+    finally:
+        server.shutdown()
+
+
+def test_hot_partitioner_spreads_symbol_and_merger_restores_order():
+    partitioner = sbe_decoder_cpp.HotPartitioner(["BTCUSDT"], buckets=2, run=2)
+    assert partitioner.route("ETHUSDT") is None
+    routed = [partitioner.route("BTCUSDT") for _ in range(8)]
+    assert [key for key, _ in routed] == [f"BTCUSDT#{seq}" for seq in range(8)]
+    # Runs of two records alternate between the buckets' hash keys
+    hash_keys = [hash_key for _, hash_key in routed]
+    assert hash_keys[0] == hash_keys[1] == hash_keys[4] != hash_keys[2] == hash_keys[3]
+    assert (int(hash_keys[2]) - int(hash_keys[0])) % 2 ** 128 == (2 ** 128 - 1) // 2
+    assert partitioner.routed == {"BTCUSDT": 8}
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.HotPartitioner(["BTC#USDT"])
+
+    # Bucket 1's shard read before bucket 0's; a symbol's first records
+    # wait for the shards not read yet
+    merger = sbe_decoder_cpp.SequenceMerger(max_wait=60.0)
+    released = []
+    for seq in (2, 3, 6, 7, 0, 1, 4, 5, 8):
+        released += merger.push(f"BTCUSDT#{seq}", seq)
+    assert released == []
+    assert merger.push("ETHUSDT", "plain") == ["plain"]
+    assert merger.push("BTCUSDT#3", 3) == []
+    assert merger.stats["duplicates"] == 1
+
+    # Flushing starts the symbol at its lowest sequence; a later gap is
+    # skipped and counted
+    assert merger.flush() == list(range(9))
+    merger.push("BTCUSDT#11", 11)
+    assert merger.flush() == [11]
+    assert merger.stats["gaps"] == 1 and merger.stats["skipped"] == 2
+    assert merger.stats["released"] == 10 and merger.stats["buffered"] == 0
+
+
+def test_ingest_pipeline_applies_overflow_policies():
+    pipeline = sbe_decoder_cpp.IngestPipeline(policies={'trade': 'drop_oldest'}, capacity=4,
+                                              capacities={'bestBidAsk': 16})
+    # Queued before start, so the ingress queues hold everything submitted
+    trades = [trade_frame([(i, 6500000 + i, 100, False)]) for i in range(10)]
+    quotes = [bba_frame(6500000 + i, 100, 6500100 + i, 200, update_id=i, symbol=symbol)
+              for i in range(5) for symbol in (b"BTCUSDT", b"ETHUSDT")]
+    assert pipeline.submit(trades) == 10
+    assert pipeline.submit(quotes, received_us=42) == 10
+    assert pipeline.submit([b'\x00' * 4]) == 0
+    stats = pipeline.stats
+    assert stats['trade']['policy'] == 'drop_oldest' and stats['bestBidAsk']['policy'] == 'conflate'
+    assert stats['trade']['ingress']['depth'] == 4 and stats['trade']['ingress']['dropped'] == 6
+    assert stats['bestBidAsk']['ingress']['depth'] == 2 and stats['bestBidAsk']['ingress']['conflated'] == 8
+    assert stats['unrouted'] == 1
+
+    pipeline.start()
+    trade_ids = []
+    while len(trade_ids) < 4:
+        batch = pipeline.take('trade', timeout=5.0)
+        offsets = batch['offsets']
+        trade_ids += [json.loads(batch['payload'][offsets[i]:offsets[i + 1]])['trade_id']
+                      for i in range(batch['records'])]
+    # The oldest six were dropped
+    assert trade_ids == [6, 7, 8, 9]
+
+    latest = {}
+    while len(latest) < 2:
+        batch = pipeline.take('bestBidAsk', timeout=5.0)
+        assert set(batch['received_us']) == {42}
+        for i, key in enumerate(batch['partition_keys']):
+            record = json.loads(batch['payload'][batch['offsets'][i]:batch['offsets'][i + 1]])
+            latest[key] = record['book_update_id']
+    assert latest == {'BTCUSDT': 4, 'ETHUSDT': 4}
+    assert pipeline.take('depth') is None
+
+    pipeline.stop(timeout=5.0)
+    assert pipeline.submit(trades[:1]) == 0
+    assert pipeline.stats['trade']['frames'] == 4
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.IngestPipeline(policies={'trade': 'conflate'})
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.IngestPipeline(policies={'klines': 'block'})
+
+
+def test_ingest_pipeline_lays_out_stages_from_config():
+    pipeline = sbe_decoder_cpp.IngestPipeline(capacity=64, stages={
+        'trade': {'decode': {'capacity': 8, 'cpu': 0}, 'publish': {'capacity': 32}},
+        'depth': {'books': {'capacity': 128}},
+    })
+    stats = pipeline.stats
+    assert stats['trade']['ingress']['capacity'] == 8 and stats['trade']['publish']['capacity'] == 32
+    assert stats['trade']['stages']['decode']['capacity'] == 8 and stats['trade']['stages']['decode']['cpu'] == 0
+    assert stats['depth']['books']['capacity'] == 128 and stats['depth']['ingress']['capacity'] == 64
+    assert stats['bestBidAsk']['stages']['publish']['cpu'] == -1
+
+    pipeline.start()
+    assert pipeline.submit([trade_frame([(i, 6500000 + i, 100, False)]) for i in range(3)]) == 3
+    taken = 0
+    while taken < 3:
+        taken += pipeline.take('trade', timeout=5.0)['records']
+    pipeline.stop(timeout=5.0)
+    decode = pipeline.stats['trade']['stages']['decode']
+    assert decode['items'] == 3 and decode['latency']['count'] == 3
+    assert pipeline.stats['trade']['stages']['publish']['items'] == 0
+    # Core 0 may be outside this process's cpuset; pinning is best effort
+    assert isinstance(pipeline.stats['placement_error'], str)
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.IngestPipeline(stages={'trade': {'parse': {'cpu': 1}}})
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.IngestPipeline(stages={'depth': {'books': {'cores': 2}}})
+
+
+def test_depth_delta_records_rebuild_top_n(decoder):
+    encoder = sbe_decoder_cpp.DepthDeltaEncoder(levels=2, keyframe_interval=2)
+    consumer = sbe_decoder_cpp.DepthDeltaDecoder()
+    frames = [depth_frame(1, 2, [(6500000, 100), (6499900, 200)], [(6500050, 300)]),
+              depth_frame(3, 4, [(6499950, 50)], []),
+              depth_frame(5, 6, [(6480000, 7)], []),
+              depth_frame(7, 8, [(6500000, 0)], [(6500050, 301)])]
+    out = bytearray(4096)
+
+    result = decoder.serialize_records(frames, out, ingest_ts_us=1_700_000_000_999_000, depth_delta=encoder)
+    offsets = result['offsets']
+    payloads = [bytes(out[offsets[i]:offsets[i + 1]]) for i in range(result['records'])]
+    # The third diff only touches a level below the top 2, so it publishes nothing
+    assert result['frames_consumed'] == 4
+    assert len(payloads) == 3
+    assert all(sbe_decoder_cpp.is_depth_delta_record(payload) for payload in payloads)
+    assert encoder.stats['unchanged'] == 1
+
+    records = [consumer.decode(payload) for payload in payloads]
+    assert [record['keyframe'] for record in records] == [True, False, True]
+    assert records[1]['bids'] == [['65000', '0.001'], ['64999.5', '0.0005']]
+    assert records[2]['bids'] == [['64999.5', '0.0005'], ['64999', '0.002']]
+    assert records[2]['asks'] == [['65000.5', '0.00301']]
+    assert records[2]['final_update_id'] == 8
+    assert records[2]['ingest_ts'] == 1_700_000_000_999
+
+    # Deltas are far smaller than the JSON records of the same diffs
+    plain = decoder.serialize_records(frames, bytearray(4096))
+    assert plain['bytes'] > 3 * result['bytes']
+
+    # A lost delta leaves the symbol waiting for its next keyframe
+    top = dict(symbol='ETHUSDT', price_exponent=-2, qty_exponent=-5, event_ts_us=1)
+    keyframe = encoder.encode(bids=[(300000, 5)], asks=[(300100, 5)], **top)
+    lost = encoder.encode(bids=[(300000, 6)], asks=[(300100, 5)], **top)
+    delta = encoder.encode(bids=[(300000, 7)], asks=[(300100, 5)], **top)
+    assert encoder.encode(bids=[(300000, 7)], asks=[(300100, 5)], **top) is None
+    assert consumer.decode(keyframe)['bids'] == [['3000', '0.00005']]
+    assert lost is not None
+    assert consumer.decode(delta) is None
+    assert consumer.stats['refused'] == 1
+    with pytest.raises(ValueError):
+        consumer.decode(keyframe[:5])
+
+
+def test_record_ingestor_routes_get_records_batch_into_rings(decoder):
+    frames = [trade_frame([(1, 6500000, 100, True), (2, 6500100, 200, False)]),
+              bba_frame(6499999, 10, 6500001, 20),
+              depth_frame(10, 12, [(6500000, 100)], [])]
+    out = bytearray(4096)
+    result = decoder.serialize_records(frames, out, ingest_ts_us=1_700_000_000_999_000)
+    offsets = result['offsets']
+    payloads = [bytes(out[offsets[i]:offsets[i + 1]]) for i in range(result['records'])]
+
+    aggregator = sbe_decoder_cpp.KplAggregator()
+    for payload in payloads[:3]:
+        assert aggregator.add('BTCUSDT', payload)
+    records = [{'Data': aggregator.finish(), 'PartitionKey': 'BTCUSDT'},
+               {'Data': payloads[3], 'PartitionKey': 'BTCUSDT'},
+               {'Data': b'{"type":"trade","symbol":"BTCUSDT","price":"x"}', 'PartitionKey': 'BTCUSDT'}]
+
+    ingestor = sbe_decoder_cpp.RecordIngestor(capacity=16)
+    returned = ingestor.ingest(records)
+    assert [key for key, _ in returned] == ['BTCUSDT']
+    assert json.loads(returned[0][1])['msg_type'] == 'depth'
+    counts = ingestor.counts
+    assert (counts['records'], counts['payloads'], counts['aggregated']) == (3, 5, 1)
+    assert (counts['trades'], counts['quotes'], counts['returned'], counts['errors']) == (2, 1, 1, 1)
+
+    buffers = {(symbol, kind): (ring, window) for symbol, kind, ring, window in ingestor.take_new_buffers()}
+    trades, window = buffers[('BTCUSDT', 'trade')]
+    quotes, no_window = buffers[('BTCUSDT', 'bestBidAsk')]
+    assert (len(trades), len(quotes), no_window) == (2, 1, None)
+    assert trades.features()['trade_count'] == 2
+    assert window.features()['1s']['trade_count'] == 2
+    assert ingestor.take_new_buffers() == []
+
+
+def test_record_ingestor_rejects_event_ts_outside_int64():
+    ingestor = sbe_decoder_cpp.RecordIngestor(capacity=16)
+    for ts in ('1e300', '9223372036854775808.0', '-1e19', 'NaN'):
+        payload = b'{"type":"trade","symbol":"BTCUSDT","event_ts":%s,"price":"1","qty":"1"}' % ts.encode()
+        assert ingestor.ingest([{'Data': payload, 'PartitionKey': 'BTCUSDT'}]) == []
+    assert (ingestor.counts['trades'], ingestor.counts['errors']) == (0, 4)
+
+
+def test_symbol_registry_keeps_blocks_in_place_across_runtime_symbols():
+    registry = sbe_decoder_cpp.SymbolRegistry(symbols=64)
+    assert len(registry) == 0 and registry.find(3) is None and registry.address(3) is None
+    btc = {'trades': 0}
+    assert registry.emplace(3, btc) == (btc, True)
+    address = registry.address(3)
+
+    # A later symbol in a chunk of its own neither moves nor replaces the first
+    registry.emplace(5_000, {'trades': 1})
+    registry.emplace(0, {'trades': 2})
+    assert registry.emplace(3, {'trades': 9}) == (btc, False)
+    assert registry.address(3) == address and registry.find(3) is btc
+    assert registry.address(5_000) not in (None, address)
+
+    assert [symbol_id for symbol_id, _ in registry.items()] == [0, 3, 5_000]
+    assert registry.items()[2][1] == {'trades': 1}
+    assert len(registry) == 3
+    with pytest.raises(IndexError):
+        registry.emplace(40_000, {})
+
+
+def test_capture_journal_round_trips_frames(tmp_path):
+    frames = [trade_frame([(1, 6500000, 100, True)]), depth_frame(10, 12, [(6500000, 100)], [])]
+    journal = sbe_decoder_cpp.CaptureJournal(str(tmp_path), connection_id=2)
+    for seq, frame in enumerate(frames):
+        assert journal.append(frame, seq, received_ts_us=1_700_000_000_000_000 + seq)
+    path = journal.path
+    journal.close()
+
+    captured = sbe_decoder_cpp.read_journal(path)
+    assert list(captured['sequence']) == [0, 1]
+    assert list(captured['connection_id']) == [2, 2]
+    assert captured['created_ts_us'] == 1_700_000_000_000_000
+    offsets = captured['offsets']
+    assert [captured['frames'][offsets[i]:offsets[i + 1]] for i in range(2)] == frames
+
+
+def test_journal_replay_merges_files_by_receive_time(tmp_path):
+    trades = sbe_decoder_cpp.CaptureJournal(str(tmp_path), connection_id=0)
+    depth = sbe_decoder_cpp.CaptureJournal(str(tmp_path), connection_id=1)
+    trades.append(trade_frame([(1, 6500000, 100, True)]), 0, received_ts_us=1_000)
+    depth.append(depth_frame(10, 12, [(6500000, 100)], []), 0, received_ts_us=2_000)
+    trades.append(trade_frame([(2, 6500100, 100, False)]), 1, received_ts_us=3_000)
+    trades.close()
+    depth.close()
+
+    replay = sbe_decoder_cpp.JournalReplay([str(tmp_path)], speed=0)
+    assert replay.files == 2
+    replay.start()
+    frames = []
+    while not replay.done:
+        batch = replay.drain(timeout=1.0)
+        if batch is not None:
+            frames.extend(batch['frame_ingest_ts_us'].tolist())
+    replay.stop()
+    assert frames == [1_000, 2_000, 3_000]
+    assert replay.stats['frames'] == 3
+
+
+def test_journal_event_merger_orders_streams_by_event_time(tmp_path):
+    trades = sbe_decoder_cpp.CaptureJournal(str(tmp_path), connection_id=0)
+    book = sbe_decoder_cpp.CaptureJournal(str(tmp_path), connection_id=1)
+    # The book connection reads everything first; its last diff is older
+    # than the quote before it
+    book.append(depth_frame(1, 5, [(6500000, 100)], [], event_time_us=100), 0, received_ts_us=10)
+    book.append(bba_frame(6500000, 10, 6500100, 20, update_id=7, event_time_us=300), 1, received_ts_us=20)
+    book.append(depth_frame(6, 6, [(6500000, 0)], [], event_time_us=200), 2, received_ts_us=30)
+    trades.append(trade_frame([(1, 6500000, 100, True)], event_time_us=100), 0, received_ts_us=50)
+    trades.append(trade_frame([(2, 6500100, 100, False)], event_time_us=300), 1, received_ts_us=60)
+    trades.close()
+    book.close()
+
+    expected = [(100, 10000), (100, 10003), (300, 10000), (300, 10001), (200, 10003)]
+    for _ in range(2):
+        merger = sbe_decoder_cpp.JournalEventMerger([str(tmp_path)])
+        assert merger.files == 2
+        assert len(merger.read(max_n=3)['template_id']) == 3
+        assert len(merger.read()['template_id']) == 2 and merger.read() is None
+        merger = sbe_decoder_cpp.JournalEventMerger([str(tmp_path)])
+        columns = merger.read()
+        assert list(zip(columns['event_ts_us'].tolist(), columns['template_id'].tolist())) == expected
+        assert columns['received_ts_us'].tolist() == [50, 10, 60, 20, 30]
+        assert columns['source'].tolist() == [0, 1, 0, 1, 1]
+        assert merger.stats == {'messages': 5, 'out_of_order': 1}
+
+    replay = sbe_decoder_cpp.JournalReplay([str(tmp_path)], speed=0, order="event")
+    replay.start()
+    frames = []
+    while not replay.done:
+        batch = replay.drain(timeout=1.0)
+        if batch is not None:
+            frames.extend(batch['frame_ingest_ts_us'].tolist())
+    replay.stop()
+    assert frames == [50, 10, 60, 20, 30]
+    assert replay.stats['out_of_order'] == 1
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.JournalReplay([str(tmp_path)], order="arrival")
+
+def test_journal_replay_reports_depth_gaps_inline(tmp_path):
+    journal = sbe_decoder_cpp.CaptureJournal(str(tmp_path), connection_id=0)
+    for seq, (first, final) in enumerate([(1, 5), (6, 9), (12, 15), (16, 18)]):
+        journal.append(depth_frame(first, final, [(6500000, 100)], []), seq, received_ts_us=1_000 + seq)
+    journal.close()
+
+    replay = sbe_decoder_cpp.JournalReplay([str(tmp_path)], speed=0)
+    replay.start()
+    gaps = []
+    while not replay.done:
+        batch = replay.drain(timeout=1.0)
+        if batch is not None:
+            table = batch['depthGaps']
+            gaps.extend(zip(table['expected_first_update_id'].tolist(), table['first_update_id'].tolist()))
+    replay.stop()
+    assert gaps == [(10, 12)]
+    assert replay.stats['depth_gaps'] == 1
+
+
+def test_tick_store_writes_journals_to_daily_column_files(tmp_path):
+    journal = sbe_decoder_cpp.CaptureJournal(str(tmp_path / "capture"), connection_id=0)
+    journal.append(trade_frame([(1, 6500000, 100, True), (2, 6500100, 200, False)]), 0, received_ts_us=1_000)
+    journal.append(depth_frame(10, 12, [(6500000, 100)], [(6500100, 300)]), 1, received_ts_us=2_000)
+    journal.append(trade_frame([(3, 6500200, 100, True)]), 2, received_ts_us=3_000)
+    journal.close()
+
+    root = str(tmp_path / "ticks")
+    writer = sbe_decoder_cpp.TickStoreWriter(root, block_rows=2)
+    assert writer.append_journals([str(tmp_path / "capture")]) == 3
+    writer.close()
+    assert writer.stats['rows'] == 5 and writer.stats['blocks'] == 3
+    trades_path = f"{root}/trades/BTCUSDT/2023-11-14.tick"
+    assert writer.paths == [trades_path, f"{root}/depth/BTCUSDT/2023-11-14.tick"]
+
+    trades = sbe_decoder_cpp.TickFile(trades_path)
+    assert (trades.stream, trades.symbol, trades.day, len(trades), trades.blocks) == \
+        ('trades', 'BTCUSDT', '2023-11-14', 3, 2)
+    columns = trades.read(['trade_id', 'price', 'ingest_ts_us', 'is_buyer_maker'])
+    assert columns['trade_id'].tolist() == [1, 2, 3]
+    assert columns['price'].tolist() == [65000.0, 65001.0, 65002.0]
+    assert columns['ingest_ts_us'].tolist() == [1_000, 1_000, 3_000]
+    assert columns['is_buyer_maker'].tolist() == [True, False, True]
+    assert trades.block_info(0)['min_id'] == 1 and trades.block_info(0)['max_id'] == 2
+
+    depth = sbe_decoder_cpp.TickFile(f"{root}/depth/BTCUSDT/2023-11-14.tick")
+    assert depth.read(['side', 'qty'])['side'].tolist() == [0, 1]
+
+    # Uncompressed blocks read back as views of the mapped file
+    raw = sbe_decoder_cpp.TickStoreWriter(str(tmp_path / "raw"), compression='none')
+    assert raw.append(trade_frame([(7, 6500000, 100, True)]), ingest_ts_us=5) == 1
+    raw.close()
+    block = sbe_decoder_cpp.TickFile(raw.paths[0]).read_block(0)
+    assert block['trade_id'].tolist() == [7] and not block['trade_id'].flags.writeable
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.TickFile(str(tmp_path / "capture" / "missing.tick"))
+
+
+def test_sparse_index_range_reads_decode_only_overlapping_blocks(tmp_path):
+    start = 1_700_000_000_000_000
+    journal = sbe_decoder_cpp.CaptureJournal(str(tmp_path / "capture"), connection_id=0)
+    for i in range(6):
+        frame = trade_frame([(i + 1, 6500000 + i, 100, True)], event_time_us=start + i * 1_000_000)
+        journal.append(frame, i, received_ts_us=1_000 * (i + 1))
+    journal.close()
+    (journal_path,) = glob.glob(str(tmp_path / "capture" / "*.sbej"))
+    assert os.path.exists(journal_path + ".idx")
+    window = sbe_decoder_cpp.read_journal(journal_path, start_ts_us=2_500, end_ts_us=4_000)
+    assert window['sequence'].tolist() == [2, 3]
+
+    writer = sbe_decoder_cpp.TickStoreWriter(str(tmp_path / "ticks"), block_rows=2)
+    assert writer.append_journals([journal_path]) == 6
+    writer.close()
+    trades = sbe_decoder_cpp.TickFile(writer.paths[0])
+    assert trades.blocks == 3 and trades.indexed_blocks == 3
+    assert trades.range_blocks(start + 2_000_000, start + 3_000_000) == [1]
+    assert trades.range_blocks(start + 500_000, start + 2_500_000) == [0, 1]
+    rows = trades.read_range(start + 500_000, start + 2_500_000, columns=['trade_id', 'price'])
+    assert rows['trade_id'].tolist() == [2, 3] and rows['price'].tolist() == pytest.approx([65000.01, 65000.02])
+    assert trades.read_range(5, None, columns=['trade_id'], key='id')['trade_id'].tolist() == [5, 6]
+    assert len(trades.read_range(start + 10_000_000)['trade_id']) == 0
+
+    # Without the index the blocks are found by walking the file
+    os.remove(writer.paths[0] + ".idx")
+    walked = sbe_decoder_cpp.TickFile(writer.paths[0])
+    assert walked.indexed_blocks == 0 and walked.range_blocks(start + 2_000_000, start + 3_000_000) == [1]
+    with pytest.raises(ValueError):
+        walked.read_range(key='sequence')
+
+
+def test_training_loader_batches_windows_with_ahead_labels(tmp_path):
+    start = 1_700_000_000_000_000
+    writer = sbe_decoder_cpp.TickStoreWriter(str(tmp_path), block_rows=16)
+    for s in range(40):
+        t = start + s * 1_000_000 + 500_000
+        writer.append(bba_frame(6500000 + s, 100, 6500002 + s, 100, update_id=s + 1, event_time_us=t),
+                      ingest_ts_us=t)
+        writer.append(trade_frame([(s + 1, 6500001 + s, 100, s % 2 == 0)], event_time_us=t), ingest_ts_us=t)
+    writer.close()
+
+    loader = sbe_decoder_cpp.TrainingLoader(str(tmp_path), ["BTCUSDT", "ETHUSDT"], ["2023-11-14"], window=4,
+                                            batch_size=8, prefetch=2, shuffle=False)
+    # One step per second on the day's grid; a sample needs 4 rows and a
+    # label 10 steps on, so 27 of the 40 steps qualify
+    assert loader.samples == 27 and len(loader) == 3
+    names = loader.feature_names
+    assert names[:2] == ["mid_price", "spread"] and "trade_count_10s" in names and len(names) == 9 + 6 * 4
+
+    batches = 0
+    for batch in loader:
+        assert batch['features'].shape == (8, 4, len(names)) and batch['features'].dtype.name == 'float32'
+        if batches == 0:
+            newest = batch['features'][0, -1]
+            assert newest[names.index("mid_price")] == pytest.approx(65000.04)
+            assert newest[names.index("trade_count_10s")] == 4
+            assert batch['labels'][0] == pytest.approx(0.10 / 65000.04, rel=1e-4)
+            assert batch['timestamp_us'][0] == start + 4_000_000
+        assert batch['symbol'].tolist() == [0] * 8
+        batches += 1
+    assert batches == 3 and loader.epoch == 0
+    assert len(list(loader)) == 3 and loader.epoch == 1
+    assert loader.stats['units'] == 2 and loader.stats['batches'] == 6
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.TrainingLoader(str(tmp_path), ["BTCUSDT"], ["2023-11-14"], label_horizon_seconds=1.5)
+
+
+def test_forward_labels_cover_each_horizon_in_one_pass():
+    np = pytest.importorskip("numpy")
+    ts = np.array([0, 1_000_000, 2_000_000, 2_500_000, 4_000_000, 10_000_000], dtype=np.int64)
+    price = np.array([100.0, 101.0, 99.0, 102.0, 100.0, 100.0])
+    labels = sbe_decoder_cpp.forward_labels(ts, price, horizons_seconds=[2.0, 10.0])
+    assert sorted(labels) == ["10s", "2s"]
+
+    two = labels["2s"]
+    # Row 0 sees rows 1 and 2 within 2 s; row 4 sees nothing until 6 s
+    assert two['forward_price'][:5].tolist() == [99.0, 102.0, 100.0, 100.0, 100.0]
+    assert two['forward_return'][0] == pytest.approx(-0.01)
+    assert two['max_up'][0] == pytest.approx(0.01) and two['max_down'][0] == pytest.approx(-0.01)
+    assert two['max_up'][4] == 0.0 and two['max_down'][4] == 0.0
+    assert np.isnan(two['forward_return'][5])
+    ten = labels["10s"]
+    assert ten['max_up'][0] == pytest.approx(0.02) and np.isnan(ten['forward_price'][1:]).all()
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.forward_labels(ts[::-1].copy(), price)
+
+
+def test_book_sampler_writes_top_levels_from_journal_and_tick_store(tmp_path):
+    np = pytest.importorskip("numpy")
+    start = 1_700_000_000_000_000
+    frames = [partial_depth_frame(10, [(6500000, 100), (6499900, 200)], [(6500100, 300), (6500200, 50)],
+                                  event_time_us=start + 100_000)]
+    for k in range(1, 6):
+        frames.append(depth_frame(10 + k, 10 + k, [(6500000 + k, 10 * k)], [(6500100, 300 - k)],
+                                  event_time_us=start + k * 1_000_000 + 200_000))
+    # Update IDs jump: the book waits for a resync from here on
+    frames.append(depth_frame(100, 101, [(6500000, 1)], [], event_time_us=start + 6_300_000))
+    frames.append(depth_frame(102, 102, [(6500000, 2)], [], event_time_us=start + 8_300_000))
+    journal = sbe_decoder_cpp.CaptureJournal(str(tmp_path / "journal"), connection_id=0)
+    store = sbe_decoder_cpp.TickStoreWriter(str(tmp_path / "ticks"), block_rows=4)
+    for seq, frame in enumerate(frames):
+        received = struct.unpack_from('<q', frame, 8)[0]
+        journal.append(frame, seq, received_ts_us=received)
+        store.append(frame, ingest_ts_us=received)
+    journal.close()
+    store.close()
+
+    tensors = []
+    for source in ("journal", "ticks"):
+        out = np.zeros((10, 2, 3, 2), dtype=np.float32)
+        sampler = sbe_decoder_cpp.BookSampler("BTCUSDT", out, tick_size=0.01)
+        if source == "journal":
+            assert sampler.sample_journals([str(tmp_path / "journal")]) == 8
+        else:
+            assert sampler.sample_tick_store(str(tmp_path / "ticks"), "2023-11-14") == 8
+        # One sample a second from the first whole second after the snapshot,
+        # each the book before that second
+        assert (sampler.timestamp_us - start).tolist() == [s * 1_000_000 for s in range(1, 9)]
+        assert sampler.valid.tolist() == [True] * 6 + [False] * 2
+        assert sampler.mid_price[0] == pytest.approx(65000.50)
+        assert out[0, 0].tolist() == [[-50.0, pytest.approx(0.001)], [-150.0, pytest.approx(0.002)], [0.0, 0.0]]
+        assert out[0, 1, :2, 0].tolist() == [50.0, 150.0]
+        # Bid 65000.01 joined at 1.2 s; the mid moved half a tick up
+        assert out[1, 0, 0].tolist() == [-49.5, pytest.approx(0.0001)]
+        assert not out[6:].any()
+        assert sampler.stats['gaps'] == 2 and sampler.stats['snapshots'] == 1
+        tensors.append(out)
+    assert np.array_equal(tensors[0], tensors[1])
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.BookSampler("BTCUSDT", np.zeros((4, 2, 3, 2)), tick_size=0.01)
+
+
+def test_event_log_broadcasts_decoded_records(tmp_path):
+    path = str(tmp_path / "events-0.log")
+    log = sbe_decoder_cpp.EventLogWriter(path, capacity=8)
+    early = sbe_decoder_cpp.EventLogReader([path], start="earliest")
+    log.append(trade_frame([(1, 6500000, 100, True), (2, 6500100, 100, False)]), 0, received_ts_us=1_000)
+    late = sbe_decoder_cpp.EventLogReader([path])
+    log.append(trade_frame([(3, 6500200, 100, True)]), 1, received_ts_us=2_000)
+
+    batch = early.drain(timeout=0.0)
+    assert batch['trade']['trade_id'].tolist() == [1, 2, 3]
+    assert batch['frame_ingest_ts_us'].tolist() == [1_000, 2_000]
+    assert late.drain(timeout=0.0)['trade']['trade_id'].tolist() == [3]
+
+    # The writer never waits: a reader that falls behind loses whole frames
+    for seq in range(2, 8):
+        log.append(trade_frame([(seq * 2, 6500000, 100, True), (seq * 2 + 1, 6500000, 100, True)]), seq)
+    batch = early.drain(timeout=0.0)
+    assert batch['trade']['trade_id'].tolist() == [10, 11, 12, 13, 14, 15]
+    assert early.stats['lost_records'] == 6
+    assert not log.append(trade_frame([(i, 6500000, 100, True) for i in range(9)]), 8)
+    assert log.stats['event_log_dropped_frames'] == 1
+
+
+def test_get_stats_reports_decode_latency_per_template(decoder):
+    frame = trade_frame([(3, 100, 1, False)])
+    for _ in range(100):
+        decoder.decode_message(frame)
+    assert decoder.try_decode(frame[:20]) == sbe_decoder_cpp.DecodeStatus.MALFORMED
+    assert decoder.try_decode(b"\x00\x01") == sbe_decoder_cpp.DecodeStatus.TOO_SHORT
+
+    stats = decoder.get_stats()
+    trades = stats['templates'][sbe_decoder_cpp.TRADES_STREAM_EVENT]
+    assert trades['messages'] == 101
+    assert trades['bytes'] == 100 * len(frame) + 20
+    assert trades['parse_errors'] == 1
+    assert 0 < trades['p50_ns'] <= trades['p99_ns'] <= trades['p999_ns'] <= trades['max_ns']
+    assert stats['too_short'] == 1
+
+    decoder.reset_stats()
+    assert decoder.get_stats()['templates'][sbe_decoder_cpp.TRADES_STREAM_EVENT]['messages'] == 0
+
+
+def test_parse_errors_are_broken_down_by_cause(decoder):
+    frame = trade_frame([(3, 100, 1, False)])
+    assert decoder.decode_message(frame[:20])['parse_error'] == 'short_block'
+    assert decoder.try_decode(frame[:-1]) == sbe_decoder_cpp.DecodeStatus.MALFORMED
+
+    trades = decoder.get_stats()['templates'][sbe_decoder_cpp.TRADES_STREAM_EVENT]
+    assert trades['parse_errors'] == 2
+    assert trades['parse_error_causes'] == {'short_block': 1, 'symbol_overrun': 1}
+
+    batch = decoder.decode_batch([frame, frame[:30], frame[:40], b"\x00\x01"])
+    assert list(batch['errors']) == [1, 2, 3]
+    causes = [sbe_decoder_cpp.PARSE_ERRORS[cause] for cause in batch['error_causes']]
+    assert causes == ['group_header', 'group_overrun', 'short_header']
+
+
+def test_alloc_accounting_shows_no_heap_allocations_on_warm_decode_path():
+    decoder = sbe_decoder_cpp.SBEDecoder(decimal_strings=True, alloc_accounting=True)
+    assert decoder.alloc_accounting
+    frames = {
+        sbe_decoder_cpp.TRADES_STREAM_EVENT: trade_frame([(3, 100, 1, False)]),
+        sbe_decoder_cpp.BEST_BID_ASK_STREAM_EVENT: bba_frame(6500000, 150, 6500100, 200),
+        sbe_decoder_cpp.DEPTH_DIFF_STREAM_EVENT: depth_frame(10, 12, [(6500000, 150)], [(6500100, 200)]),
+    }
+    # The first frames learn result shapes and intern symbols
+    for frame in frames.values():
+        decoder.decode_message(frame)
+    decoder.reset_stats()
+
+    for _ in range(200):
+        for frame in frames.values():
+            decoder.decode_message(frame)
+    stats = decoder.get_stats()
+    assert stats['alloc_accounting']
+    for template_id in frames:
+        entry = stats['templates'][template_id]
+        assert entry['messages'] == 200
+        assert (entry['allocations'], entry['alloc_bytes']) == (0, 0)
+        assert 'py_allocations' in entry
+
+    plain = sbe_decoder_cpp.SBEDecoder()
+    plain.decode_message(frames[sbe_decoder_cpp.TRADES_STREAM_EVENT])
+    assert 'allocations' not in plain.get_stats()['templates'][sbe_decoder_cpp.TRADES_STREAM_EVENT]
+
+
+def test_perf_sampling_reports_ipc_per_template_or_why_not():
+    decoder = sbe_decoder_cpp.SBEDecoder(perf_sample_every=4)
+    assert decoder.perf_sample_every == 4
+    frame = trade_frame([(3, 100, 1, False)])
+    for _ in range(400):
+        decoder.decode_message(frame)
+
+    stats = decoder.get_stats()
+    perf = stats['perf']
+    assert perf['sample_every'] == 4
+    trades = stats['templates'][sbe_decoder_cpp.TRADES_STREAM_EVENT]
+    if not perf['open']:
+        # No perf_event_open here (seccomp, perf_event_paranoid=3)
+        assert perf['error']
+        assert 'perf_samples' not in trades
+        return
+    # Samples the kernel multiplexed are dropped
+    assert 0 < trades['perf_samples'] <= 100
+    assert trades['cycles_per_msg'] > 0
+    assert trades['ipc'] == pytest.approx(trades['instructions_per_msg'] / trades['cycles_per_msg'])
+    assert 'perf' not in sbe_decoder_cpp.SBEDecoder().get_stats()
+
+
+def test_trace_stamps_flow_into_per_stage_latency():
+    stages = sbe_decoder_cpp.TRACE_STAGES
+    assert stages[:3] == ("event", "receive", "decode")
+    decoder = sbe_decoder_cpp.SBEDecoder(trace=True)
+    received_us = 1_700_000_000_200_000
+    result = decoder.try_decode(trade_frame([(3, 100, 1, False)]), ingest_ts_us=received_us)
+
+    # Event time keeps its microseconds; later stages are not stamped yet
+    trace = result['trace']
+    assert trace[:2] == [1_700_000_000_123_456, received_us]
+    assert trace[2] >= sbe_decoder_cpp.ingest_clock_us() - 1_000_000
+    assert trace[3:] == [0] * (len(stages) - 3)
+    assert 'trace' not in sbe_decoder_cpp.SBEDecoder().decode_message(trade_frame([(3, 100, 1, False)]))
+
+    trace[2] = received_us + 40
+    trace[stages.index("enqueue")] = received_us + 100
+    trace[stages.index("publish")] = received_us + 5_100
+    collector = sbe_decoder_cpp.TraceCollector()
+    collector.record(trace)
+    summary = collector.summary()
+    assert summary['traces'] == 1 and summary['skewed'] == 0
+    assert summary['stages']['receive']['max_us'] == received_us - 1_700_000_000_123_456
+    assert summary['stages']['decode']['max_us'] == 40
+    assert summary['stages']['kinesis_put']['count'] == 0
+    # Unstamped stages are skipped: publish is measured from enqueue
+    assert summary['stages']['publish']['max_us'] == 5_000
+    assert summary['total']['max_us'] == received_us + 5_100 - 1_700_000_000_123_456
+
+    with pytest.raises(ValueError):
+        collector.record([1, 2, 3])
+
+
+def test_exchange_clock_keeps_the_fastest_round_trips_offset():
+    base = 1_700_000_000_000_000
+    clock = sbe_decoder_cpp.ExchangeClock()
+    assert not clock.synced
+    # The exchange runs 2.5 ms ahead; queueing skews the slow round trip's midpoint
+    assert clock.add(base, base + 400, base + 200 + 2_500)
+    assert clock.add(base + 1_000_000, base + 1_004_000, base + 1_000_500 + 2_500)
+    assert not clock.add(base + 10, base, base)
+
+    stats = clock.stats
+    assert stats['synced'] and (stats['samples'], stats['rejected']) == (2, 1)
+    assert (stats['error_us'], stats['min_rtt_us'], stats['window'], stats['filtered']) == (200, 400, 2, 1)
+    assert stats['drift_ppm'] == 0.0
+    assert clock.to_local_us(base + 5_000) == base + 2_500
+    assert clock.exchange_latency_us(base + 3_000, base + 1_500) == 1_000
+
+    # A clock step restarts the window
+    assert clock.add(base + 2_000_000, base + 2_000_400, base + 2_000_200 + 60_000)
+    assert (clock.stats['steps'], clock.stats['window'], clock.stats['offset_us']) == (1, 1, 60_000)
+
+    shared = sbe_decoder_cpp.exchange_clock()
+    try:
+        shared.add(base, base + 400, base + 200 + 2_500)
+        result = sbe_decoder_cpp.SBEDecoder(trace=True).try_decode(trade_frame([(3, 100, 1, False)]),
+                                                                   ingest_ts_us=base + 200_000)
+        assert result['trace'][0] == 1_700_000_000_123_456 - 2_500
+    finally:
+        shared.reset()
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.ClockSync(burst=0)
+    sync = sbe_decoder_cpp.ClockSync(interval=60.0)
+    assert not sync.running and sync.stats['syncs'] == 0
+
+
+def test_timer_wheel_fires_on_the_grid_and_reports_lag():
+    wheel = sbe_decoder_cpp.TimerWheel(now_ts_us=1_700_000_000_300_000)
+    two = wheel.add(2.0)
+    ten = wheel.add(10.0)
+    assert wheel.next_due_us == 1_700_000_002_000_000
+    assert wheel.advance(1_700_000_001_999_999) == []
+    assert wheel.advance(1_700_000_002_000_250) == [(two, 1_700_000_002_000_000, 250)]
+
+    # A late wake fires each timer once, for the latest grid time it passed
+    fired = wheel.advance(1_700_000_010_500_000)
+    assert sorted(fired) == sorted([(two, 1_700_000_010_000_000, 500_000), (ten, 1_700_000_010_000_000, 500_000)])
+    stats = wheel.stats
+    assert (stats['fired'], stats['skipped'], stats['timers']) == (3, 3, 2)
+    assert stats['lag']['max_us'] == 500_000
+
+    assert wheel.cancel(ten) and not wheel.cancel(ten)
+    assert wheel.next_due_us == 1_700_000_012_000_000
+    with pytest.raises(ValueError):
+        wheel.add(0.0)
+
+
+def test_bar_builder_builds_time_and_volume_bars():
+    np = pytest.importorskip("numpy")
+    trade_time = np.array([60_000, 60_500, 119_999, 180_000, 180_001], dtype=np.int64)
+    price = np.array([100.0, 102.0, 99.0, 101.0, 103.0])
+    qty = np.array([1.0, 2.0, 1.0, 3.0, 1.0])
+    is_buyer_maker = np.array([False, True, False, False, True])
+
+    bars = sbe_decoder_cpp.BarBuilder("time", 60.0)
+    bars.add_batch(trade_time, price, qty, is_buyer_maker, "BTCUSDT", trade_id=np.arange(5))
+    closed = bars.drain()
+    # The 2-minute bucket has no trades and no bar; the 3-minute one is open
+    assert list(closed['open_time']) == [60_000] and list(closed['close_time']) == [119_999]
+    assert (closed['open'][0], closed['high'][0], closed['low'][0], closed['close'][0]) == (100.0, 102.0, 99.0, 99.0)
+    assert closed['volume'][0] == 4.0 and closed['vwap'][0] == pytest.approx(403.0 / 4.0)
+    assert (closed['buy_volume'][0], closed['sell_volume'][0], closed['trades'][0]) == (2.0, 2.0, 3)
+    assert closed['symbol'][0] == b'BTCUSDT' and bars.open_bars == 1
+    bars.advance(240_000)
+    assert list(bars.drain()['last_trade_id']) == [4]
+
+    volume = sbe_decoder_cpp.BarBuilder("volume", 3.0)
+    symbols = np.array([b'BTCUSDT', b'ETHUSDT', b'BTCUSDT', b'BTCUSDT', b'ETHUSDT'], dtype='S16')
+    volume.add_batch(trade_time, price, qty, is_buyer_maker, symbols)
+    volume.flush()
+    closed = volume.drain()
+    # The trade that crosses the threshold closes its bar
+    assert list(zip(closed['symbol'], closed['volume'])) == [(b'BTCUSDT', 5.0), (b'ETHUSDT', 3.0)]
+    assert volume.open_bars == 0 and volume.bars == 2
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.BarBuilder("range", 1.0)
+    for threshold in (math.inf, math.nan, 0.0):
+        with pytest.raises(ValueError):
+            sbe_decoder_cpp.BarBuilder("volume", threshold)
+
+
+def test_klines_from_trades_diff_against_rest_klines():
+    np = pytest.importorskip("numpy")
+    trade_time = np.array([60_000, 60_500, 119_999, 180_000], dtype=np.int64)
+    price = np.array([100.0, 102.0, 99.0, 101.0])
+    qty = np.array([1.0, 2.0, 1.0, 3.0])
+    is_buyer_maker = np.array([False, True, False, False])
+    built = sbe_decoder_cpp.klines_from_trades(trade_time, price, qty, is_buyer_maker, "BTCUSDT")
+    assert list(built['open_time']) == [60_000, 180_000] and list(built['num_trades']) == [3, 1]
+    assert list(built['frame_index']) == [-1, -1] and built['quote_volume'][0] == 403.0
+
+    # REST also returns the empty minute in between, and disagrees on the last
+    rest = {name: np.insert(column, 1, column[0]) for name, column in built.items()}
+    rest['num_trades'][1] = 0
+    rest['open_time'][1] = 120_000
+    rest['volume'][2] = 3.5
+    diff = sbe_decoder_cpp.diff_klines(built, rest)
+    assert (diff['compared'], diff['matched'], diff['mismatched']) == (3, 2, 1)
+    assert list(diff['rows']['open_time']) == [180_000]
+    volume_bit = 1 << sbe_decoder_cpp.KLINE_DIFF_FIELDS.index('volume')
+    assert diff['rows']['mismatch'][0] == volume_bit
+
+    diff = sbe_decoder_cpp.diff_klines({name: column[:1] for name, column in built.items()}, rest)
+    assert diff['missing_built'] == 1 and diff['rows']['rest_volume'][-1] == 3.5
+
+
+def test_metrics_server_exports_native_counters(decoder):
+    import urllib.request
+
+    decoder.decode_message(trade_frame([(3, 100, 1, False)]))
+    server = sbe_decoder_cpp.MetricsServer(host="127.0.0.1", port=0)
+    server.start()
+    try:
+        with urllib.request.urlopen(f"http://127.0.0.1:{server.port}/metrics", timeout=5) as response:
+            assert response.headers['Content-Type'].startswith('text/plain; version=0.0.4')
+            body = response.read().decode()
+    finally:
+        server.stop()
+    assert '# TYPE sbe_decoder_messages_total counter' in body
+    assert 'template="10000"' in body
+    assert 'sbe_decoder_decode_seconds{' in body and 'quantile="0.99"' in body
+    assert server.scrapes == 1
+    assert body.count('# TYPE sbe_decoder_messages_total') == sbe_decoder_cpp.render_metrics().count(
+        '# TYPE sbe_decoder_messages_total')
+
+
+def test_register_decoder_handles_unknown_template(decoder):
+    decoder.register_decoder(999, lambda data: {'msg_type': 'custom', 'size': len(bytes(data))})
+
+    assert decoder.try_decode(sbe_header(0, 999)) == {'msg_type': 'custom', 'size': 8}
+    assert decoder.try_decode(sbe_header(0, 998)) == sbe_decoder_cpp.DecodeStatus.UNKNOWN_TEMPLATE
+
+
+def test_decoder_is_shared_safely_between_threads(decoder):
+    import threading
+
+    symbols = [f"SYM{i}USDT".encode() for i in range(8)]
+    # A Python decoder that re-enters the decoder it is registered on
+    decoder.register_decoder(999, lambda data: decoder.decode_message(trade_frame([(1, 100, 1, False)])))
+    errors = []
+
+    def work(symbol):
+        try:
+            for trade_id in range(500):
+                decoded = decoder.decode_message(trade_frame([(trade_id, 100, 1, False)], symbol=symbol))
+                assert (decoded['symbol'], decoded['trade_id']) == (symbol.decode(), trade_id)
+                assert decoder.try_decode(sbe_header(0, 999))['trade_id'] == 1
+        except Exception as exc:
+            errors.append(exc)
+
+    threads = [threading.Thread(target=work, args=(symbol,)) for symbol in symbols]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    assert errors == []
+    assert decoder.get_stats()['templates'][sbe_decoder_cpp.TRADES_STREAM_EVENT]['messages'] == 8 * 500 * 2
+
+
+def test_import_keeps_free_threaded_interpreter_without_gil():
+    import sysconfig
+
+    if not sysconfig.get_config_var("Py_GIL_DISABLED"):
+        pytest.skip("needs a free-threaded (3.13t) interpreter")
+    assert not sys._is_gil_enabled()
+
+
+def test_stream_receiver_subscribes_like_python_client():
+    receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT", "ETHUSDT"], stream_types=["trade", "depth"])
+
+    assert receiver.paths == ["/stream?streams=btcusdt@trade/btcusdt@depth/ethusdt@trade/ethusdt@depth"]
+    assert not receiver.running
+    assert receiver.drain(timeout=0.0) is None
+    assert receiver.stats['connects'] == 0
+
+
+def test_stream_receiver_ring_capacity_is_power_of_two():
+    receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], ring_capacity=1000)
+
+    assert receiver.stats['connections'][0]['ring_capacity'] == 1024
+    assert receiver.stats['dropped_frames'] == 0
+
+
+def test_stream_receiver_spreads_symbols_over_connections():
+    symbols = ["BTCUSDT", "ETHUSDT", "SOLUSDT"]
+    receiver = sbe_decoder_cpp.StreamReceiver(symbols, stream_types=["trade"], connections=2, cpu_affinity=[0])
+
+    assert receiver.paths == ["/stream?streams=btcusdt@trade/solusdt@trade", "/stream?streams=ethusdt@trade"]
+    assert [c['cpu'] for c in receiver.stats['connections']] == [0, -1]
+
+    capped = sbe_decoder_cpp.StreamReceiver(symbols, stream_types=["trade", "depth"], max_streams_per_connection=4)
+    assert len(capped.paths) == 2
+
+
+def test_stream_receiver_wait_strategies():
+    for wait in ("block", "spin", "spin_yield"):
+        receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], wait=wait, spin_us=100, busy_poll_us=50)
+        assert receiver.stats['connections'][0]['idle_polls'] == 0
+        assert receiver.stats['connections'][0]['yields'] == 0
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], wait="sleep")
+
+
+def test_stream_receiver_arms_its_eventfd_only_when_empty():
+    import select
+
+    receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"])
+    assert receiver.notify_fd >= 0
+    assert receiver.arm_notify()
+    # Armed and nothing staged: the fd stays quiet until a receive thread signals
+    assert select.select([receiver.notify_fd], [], [], 0)[0] == []
+    assert receiver.clear_notify() == 0
+    assert (receiver.stats['notify_arms'], receiver.stats['notify_wakeups']) == (1, 0)
+
+
+def test_stream_receiver_io_uring_is_reported_once_connected():
+    receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], io_uring=True, uring_buffers=8, uring_buffer_size=4096)
+
+    assert receiver.stats['connections'][0]['io_uring'] is False
+
+
+def test_stream_receiver_runs_connections_on_shared_executor_threads():
+    import time
+
+    symbols = [f"SYM{i}USDT" for i in range(6)]
+    # Nothing listens on port 1: every connect is refused and retried
+    receiver = sbe_decoder_cpp.StreamReceiver(symbols, stream_types=["trade"], host="127.0.0.1", port=1,
+                                              use_tls=False, connections=6, executor_threads=2)
+    assert receiver.stats['executor']['threads'] == 2
+    assert 'executor' not in sbe_decoder_cpp.StreamReceiver(["BTCUSDT"]).stats
+
+    receiver.start()
+    deadline = time.monotonic() + 5
+    while receiver.stats['executor']['blocking_calls'] < 6 and time.monotonic() < deadline:
+        time.sleep(0.01)
+    receiver.stop()
+
+    stats = receiver.stats
+    assert stats['executor']['blocking_calls'] >= 6
+    assert all('refused' in c['last_error'] for c in stats['connections'])
+    assert stats['connects'] == 0
+
+
+def test_stream_receiver_micro_batching_starts_per_message_when_adaptive():
+    receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], batch_max_records=256, batch_max_delay=0.0005,
+                                              batch_adaptive=True)
+    assert receiver.stats['micro_batch'] == {'batches': 0, 'full': 0, 'timed_out': 0, 'records': 0, 'target': 1}
+    assert receiver.drain(timeout=0.0) is None and receiver.pending_wait == 0.0
+
+    fixed = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], batch_max_records=256, batch_max_delay=0.0005)
+    assert fixed.stats['micro_batch']['target'] == 256
+    assert 'micro_batch' not in sbe_decoder_cpp.StreamReceiver(["BTCUSDT"]).stats
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], batch_max_records=16, batch_max_delay=-1.0)
+
+
+def test_micro_batcher_doubles_on_full_batches_and_shrinks_to_arrivals_on_timeouts():
+    batcher = sbe_decoder_cpp.MicroBatcher(max_records=64, max_delay=0.001, adaptive=True)
+    assert batcher.target() == 1
+    # One record is a full batch at the starting target: hand off at once
+    assert batcher.wait_us(1, 0) == 0
+
+    # Full handoffs double the target up to max_records
+    for expected in (2, 4, 8, 16, 32, 64, 64):
+        waiting = batcher.target()
+        batcher.handed_off(waiting, waiting)
+        assert batcher.target() == expected
+    assert batcher.stats['full'] == 7 and batcher.stats['timed_out'] == 0
+
+    # Short of the target, the rest of max_delay is left to wait; a drain
+    # taking fewer records lowers the target to its limit
+    assert batcher.wait_us(10, 300) == 700
+    assert batcher.wait_us(10, 1_000) == 0
+    assert batcher.wait_us(10, 300, limit=10) == 0 and batcher.target(limit=10) == 10
+
+    # A handoff cut off by the deadline shrinks the target to what arrived
+    batcher.handed_off(10, 10)
+    assert batcher.target() == 10
+    batcher.handed_off(1, 1)
+    assert batcher.target() == 1
+    assert batcher.stats == {'batches': 9, 'full': 7, 'timed_out': 2, 'records': 1 + 2 + 4 + 8 + 16 + 32 + 64 + 11,
+                             'target': 1}
+
+    # min_records bounds the shrink; the fixed mode never moves
+    floored = sbe_decoder_cpp.MicroBatcher(max_records=64, max_delay=0.001, adaptive=True, min_records=8)
+    assert floored.target() == 8
+    floored.handed_off(2, 2)
+    assert floored.target() == 8 and floored.stats['timed_out'] == 1
+    fixed = sbe_decoder_cpp.MicroBatcher(max_records=64, max_delay=0.001)
+    fixed.handed_off(64, 64)
+    fixed.handed_off(3, 3)
+    assert fixed.target() == 64 and fixed.stats['full'] == 1 and fixed.stats['timed_out'] == 1
+
+    # Off (one record or no delay): never waits, counts batches only
+    off = sbe_decoder_cpp.MicroBatcher(max_records=64, max_delay=0.0)
+    assert off.wait_us(1, 0) == 0
+    off.handed_off(5, 5)
+    assert off.stats['batches'] == 1 and off.stats['full'] == 0 and off.stats['timed_out'] == 0
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.MicroBatcher(max_records=64, max_delay=-1.0)
+
+
+def test_native_memory_takes_huge_pages_or_falls_back():
+    receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], ring_capacity=1 << 16, cpu_affinity=[0],
+                                              huge_pages=["ring"], numa_local=["ring", "journal", "event_log"])
+    dedup = sbe_decoder_cpp.BloomDeduplicator(window_seconds=60, capacity=100_000, huge_pages=True)
+    stats = sbe_decoder_cpp.page_memory_stats()
+
+    # Whichever backing the host granted, the memory is mapped and counted
+    mapped = sum(stats['bytes'].values())
+    assert mapped >= receiver.stats['connections'][0]['ring_capacity'] * 64 + dedup.memory_bytes
+    assert stats['huge_page_fallbacks'] >= 0
+    assert dedup.get_stats()['page_backing'] in ("normal", "transparent", "hugetlb")
+    assert dedup.is_unique('BTCUSDT', 1, now_us=1_000_000)
+    assert sbe_decoder_cpp.cpu_numa_node(0) >= -1
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], huge_pages=["books"])
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=1, cpu_affinity=[0], numa_local=True)
+    assert pool.workers == 1
+
+
+def test_feed_lines_forward_the_first_copy_only():
+    arbiter = sbe_decoder_cpp.FeedArbiter(2)
+    first = trade_frame([(1, 6500000, 100, False)])
+    skipped = trade_frame([(2, 6500000, 100, False), (3, 6500100, 50, True)])
+    after = trade_frame([(4, 6500200, 100, False)])
+
+    assert arbiter.admit(first, 0, 1_000)
+    assert not arbiter.admit(first, 1, 1_250)
+    # Line A reconnected past trades 2-3; line B still delivers them
+    assert arbiter.admit(after, 0, 2_000)
+    assert arbiter.admit(skipped, 1, 2_100)
+    assert not arbiter.admit(after, 1, 2_200)
+    assert arbiter.admit(bba_frame(6499900, 10, 6500100, 20, update_id=9), 1, 3_000)
+    assert not arbiter.admit(bba_frame(6499900, 10, 6500100, 20, update_id=9), 0, 3_050)
+    assert not arbiter.admit(bba_frame(6499800, 10, 6500100, 20, update_id=8), 0, 3_100)
+    with pytest.raises(ValueError):
+        arbiter.admit(first, 2)
+
+    a, b = arbiter.stats['lines']
+    assert (a['frames'], a['wins'], a['duplicates'], a['fills']) == (4, 2, 2, 0)
+    assert (b['frames'], b['wins'], b['duplicates'], b['fills']) == (4, 2, 2, 1)
+    assert (b['lag_samples'], b['lag_us_total'], b['lag_us_max']) == (2, 450, 250)
+    assert (a['lag_samples'], a['lag_us_total']) == (1, 50)
+
+    receiver = sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], stream_types=["trade"], feed_lines=2,
+                                              feed_hosts=["a.example:9443", "b.example"], port=443)
+    assert receiver.paths == ["/stream?streams=btcusdt@trade"] * 2
+    assert [(c['host'], c['port'], c['line']) for c in receiver.stats['connections']] == [
+        ("a.example", 9443, 0), ("b.example", 443, 1)]
+    assert len(receiver.stats['feeds'][0]['lines']) == 2
+    assert not receiver.stats['connected']
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.StreamReceiver(["BTCUSDT"], feed_lines=2, feed_hosts=["a.example:http"])
+
+
+def ws_api_response_frame(status: int, request_id, result: bytes, rate_limits=((2, 1, 1, 6000, 40),)) -> bytes:
+    """WebSocket API WebSocketResponse (50): status, rate limits, id, embedded result."""
+    body = struct.pack('<BH', 0, status) + struct.pack('<HH', 19, len(rate_limits))
+    for limit in rate_limits:
+        body += struct.pack('<BBBqq', *limit)
+    request_id = str(request_id).encode()
+    body += struct.pack('<B', len(request_id)) + request_id + struct.pack('<I', len(result)) + result
+    return sbe_header(3, 50) + body
+
+
+def test_ws_api_response_exposes_result_without_copy(decoder):
+    depth = depth_response_frame(77, [(6500000, 100)], [(6500100, 300)])
+    response = sbe_decoder_cpp.parse_ws_api_response(ws_api_response_frame(200, 65537, depth))
+
+    assert (response.status, response.ok, response.id) == (200, True, "65537")
+    assert response.rate_limits == [
+        {'rateLimitType': 'REQUEST_WEIGHT', 'interval': 'MINUTE', 'intervalNum': 1, 'limit': 6000, 'count': 40}]
+    assert bytes(memoryview(response)) == depth
+    assert decoder.decode_message(response)['last_update_id'] == 77
+
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.parse_ws_api_response(depth)
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.parse_ws_api_response(ws_api_response_frame(200, 1, depth)[:-1])
+
+    client = sbe_decoder_cpp.WsApiClient(max_in_flight=4)
+    assert (client.connected, client.in_flight, client.max_in_flight) == (False, 0, 4)
+    assert client.stats['requests'] == 0
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.WsApiClient(max_in_flight=0)
+
+
+def test_rate_governor_paces_weight_and_takes_server_counts():
+    governor = sbe_decoder_cpp.RateGovernor(utilization=0.5)
+    assert not governor.configured
+    governor.configure([{'rateLimitType': 'REQUEST_WEIGHT', 'interval': 'DAY', 'intervalNum': 1, 'limit': 100},
+                        {'rateLimitType': 'ORDERS', 'interval': 'SECOND', 'intervalNum': 10, 'limit': 50}])
+
+    assert governor.reserve(30) == 0.0
+    assert governor.reserve(20) == 0.0
+    assert governor.reserve(1) > 0.0  # 50 of 100 at utilization 0.5: held until the day resets
+    assert governor.limits[0]['count'] == 50 and len(governor.limits) == 2
+    assert not governor.acquire(1, timeout=0.01)
+
+    # The server's count raises the local one, and unknown windows are learned with their limit
+    governor.observe([{'rateLimitType': 'REQUEST_WEIGHT', 'interval': 'DAY', 'intervalNum': 1, 'count': 80},
+                      {'rateLimitType': 'RAW_REQUESTS', 'interval': 'HOUR', 'intervalNum': 1, 'limit': 10,
+                       'count': 2}])
+    assert [w['count'] for w in governor.limits] == [80, 0, 2]
+    assert governor.stats['corrections'] == 2
+
+    governor.configure([{'rateLimitType': 'REQUEST_WEIGHT', 'interval': 'DAY', 'intervalNum': 1, 'limit': 1000}])
+    assert governor.reserve(1) == 0.0  # 81 of a 500 budget
+    governor.back_off(60)
+    assert governor.reserve(1) == pytest.approx(60.0, abs=1.0)
+    assert governor.stats['backoffs'] == 1
+
+    # exchangeInfo (103) as SBE: the rateLimits group leads the message
+    body = struct.pack('<HI', 11, 1) + struct.pack('<BBBq', 2, 1, 1, 6000)
+    shared = sbe_decoder_cpp.rate_governor()
+    assert shared is sbe_decoder_cpp.rate_governor()
+    local = sbe_decoder_cpp.RateGovernor()
+    local.configure_from_exchange_info(sbe_header(0, 103) + body)
+    assert local.limits[0]['limit'] == 6000 and local.limits[0]['interval'] == 'MINUTE'
+    with pytest.raises(ValueError):
+        local.configure_from_exchange_info(sbe_header(0, 103) + body[:-1])
+    with pytest.raises(ValueError):
+        local.configure([{'rateLimitType': 'REQUEST_WEIGHT', 'interval': 'WEEK'}])
+
+
+def price_filter(exponent: int, min_price: int, max_price: int, tick_size: int) -> bytes:
+    """PriceFilter (1), a symbol filter encoded as its own SBE message."""
+    return sbe_header(25, 1) + struct.pack('<bqqq', exponent, min_price, max_price, tick_size)
+
+
+def lot_size_filter(exponent: int, min_qty: int, max_qty: int, step_size: int) -> bytes:
+    """LotSizeFilter (4)."""
+    return sbe_header(25, 4) + struct.pack('<bqqq', exponent, min_qty, max_qty, step_size)
+
+
+def min_notional_filter(exponent: int, min_notional: int) -> bytes:
+    """MinNotionalFilter (5): applyToMarket, avgPriceMins after the minimum."""
+    return sbe_header(14, 5) + struct.pack('<bqBI', exponent, min_notional, 1, 5)
+
+
+def notional_filter(exponent: int, min_notional: int, max_notional: int = 0) -> bytes:
+    """NotionalFilter (6)."""
+    return sbe_header(23, 6) + struct.pack('<bqBqBI', exponent, min_notional, 1, max_notional, 0, 5)
+
+
+def exchange_info_frame(symbols) -> bytes:
+    """ExchangeInfoResponse (103): no rate limits or exchange filters; (name, status, filters) per symbol."""
+    body = struct.pack('<HI', 11, 0) + struct.pack('<HI', 0, 0) + struct.pack('<HI', 16, len(symbols))
+    for name, status, filters in symbols:
+        body += struct.pack('<B', status) + bytes(15)
+        body += struct.pack('<HI', 0, len(filters))
+        for encoded in filters:
+            body += struct.pack('<B', len(encoded)) + encoded
+        body += struct.pack('<HI', 0, 0)  # permissions
+        for text in (name, name[:3], name[3:]):  # symbol, baseAsset, quoteAsset
+            body += struct.pack('<B', len(text)) + text
+    return sbe_header(0, 103) + body + struct.pack('<HI', 0, 0)  # sors
+
+
+def test_symbol_rules_table_loads_exchange_info_and_checks_orders():
+    RuleCheck = sbe_decoder_cpp.RuleCheck
+    frame = exchange_info_frame([
+        (b"BTCUSDT", 1, [price_filter(-2, 10, 100_000_000, 10), lot_size_filter(-5, 1_000, 900_000_000, 1_000),
+                         min_notional_filter(-8, 500_000_000)]),
+        (b"ETHBTC", 1, [price_filter(-8, 1, 0, 1), lot_size_filter(-4, 1, 0, 1), notional_filter(-8, 10_000)]),
+        (b"NEWUSDT", 0, []),
+    ])
+    table = sbe_decoder_cpp.SymbolRulesTable()
+    assert table.load_exchange_info(frame) == 3
+    assert len(table) == 3 and table.generation == 1
+
+    btc = table.get("BTCUSDT")
+    assert btc['id'] == table.id_of("BTCUSDT") and btc['listed'] and btc['status'] == 1
+    assert (btc['price_exponent'], btc['min_price'], btc['max_price'], btc['tick_size']) == (-2, 10, 100_000_000, 10)
+    assert (btc['qty_exponent'], btc['min_qty'], btc['max_qty'], btc['step_size']) == (-5, 1_000, 900_000_000, 1_000)
+    assert (btc['notional_exponent'], btc['min_notional']) == (-8, 500_000_000)
+    assert table.get("ETHBTC")['min_notional'] == 10_000
+    assert table.get("NEWUSDT")['status'] == 0 and table.get("NEWUSDT")['tick_size'] == 0
+    assert table.id_of("XRPUSDT") is None and table.get("XRPUSDT") is None
+
+    # BTCUSDT: price at 1e-2 on a 0.10 grid from 0.10, qty at 1e-5 on a
+    # 0.01 grid, notional at 1e-8 against the order's 1e-7
+    assert table.check("BTCUSDT", 6_500_000, 1_000) == RuleCheck.OK
+    assert table.check("BTCUSDT", 5, 1_000) == RuleCheck.PRICE_RANGE
+    assert table.check("BTCUSDT", 200_000_000, 1_000) == RuleCheck.PRICE_RANGE
+    assert table.check("BTCUSDT", 6_500_005, 1_000) == RuleCheck.PRICE_TICK
+    assert table.check("BTCUSDT", 6_500_000, 500) == RuleCheck.QTY_RANGE
+    assert table.check("BTCUSDT", 6_500_000, 1_500) == RuleCheck.QTY_STEP
+    assert table.check("BTCUSDT", 50_000, 1_000) == RuleCheck.OK  # exactly 5.0
+    assert table.check("BTCUSDT", 49_990, 1_000) == RuleCheck.MIN_NOTIONAL
+    # ETHBTC the other way round (order at 1e-12, minimum at 1e-8), and a
+    # product far past int64
+    assert table.check("ETHBTC", 5_000_000, 20) == RuleCheck.OK
+    assert table.check("ETHBTC", 5_000_000, 19) == RuleCheck.MIN_NOTIONAL
+    assert table.check("ETHBTC", 9_000_000_000_000_000_000, 1_000_000_000) == RuleCheck.OK
+    assert table.check("NEWUSDT", 0, 0) == RuleCheck.OK
+    assert table.check("XRPUSDT", 1, 1) == RuleCheck.NOT_LISTED
+
+    # A refresh keeps the IDs of symbols it no longer lists
+    eth_id = table.id_of("ETHBTC")
+    assert table.load_exchange_info(exchange_info_frame([(b"BTCUSDT", 4, [price_filter(-2, 10, 0, 10)])])) == 1
+    assert table.generation == 2 and len(table) == 3
+    assert table.get("BTCUSDT")['status'] == 4 and table.get("BTCUSDT")['min_qty'] == 0
+    assert table.id_of("ETHBTC") == eth_id and not table.get("ETHBTC")['listed']
+    assert table.check("ETHBTC", 5_000_000, 20) == RuleCheck.NOT_LISTED
+
+    # Malformed frames leave the table as it was
+    for bad in (frame[:-20], depth_frame(1, 1, [], []), b"\x01"):
+        with pytest.raises(ValueError):
+            table.load_exchange_info(bad)
+    assert table.generation == 2
+
+
+def error_response_frame(code: int, msg: bytes, server_time: int = -2**63, retry_after: int = -2**63) -> bytes:
+    """ErrorResponse (100): code, optional serverTime and retryAfter, msg, empty data."""
+    body = struct.pack('<hqq', code, server_time, retry_after)
+    return sbe_header(18, 100) + body + struct.pack('<H', len(msg)) + msg + struct.pack('<I', 0)
+
+
+def test_official_json_writer_prints_exact_decimals_and_escaped_strings():
+    decimal = sbe_decoder_cpp.official_json_decimal
+    assert decimal(12345, -2) == "123.45"
+    assert decimal(100, -2) == "1.00" and decimal(0, -2) == "0.00" and decimal(0, 0) == "0"
+    assert decimal(5, -3) == "0.005" and decimal(-5, -3) == "-0.005"
+    assert decimal(12, 3) == "12000" and decimal(-12, 2) == "-1200"
+    assert decimal(-2**63, 0) == "-9223372036854775808"
+    assert decimal(-2**63, -3) == "-9223372036854775.808"
+    assert decimal(-2**63, -19) == "-0.9223372036854775808"
+    assert decimal(-2**63, -20) == "-0.09223372036854775808"
+    assert decimal(2**63 - 1, -1) == "922337203685477580.7"
+
+    quote = sbe_decoder_cpp.official_json_quote
+    text = 'a"b\\c\n\r\t\x01\x1f\u00e9'
+    assert quote(text) == '"a\\"b\\\\c\\n\\r\\t\\u0001\\u001f\u00e9"'
+    assert json.loads(quote(text)) == text and quote("") == '""'
+
+    # An ErrorResponse through print_json(Error): null times are left out
+    printed = sbe_decoder_cpp.official_error_json(error_response_frame(-1121, b'Invalid symbol "X"\n'))
+    assert json.loads(printed) == {'code': -1121, 'msg': 'Invalid symbol "X"\n'}
+    printed = sbe_decoder_cpp.official_error_json(
+        error_response_frame(-1003, b"Too many requests", server_time=1_700_000_000_000, retry_after=1_700_000_060_000))
+    assert printed == ('{"code":-1003,"serverTime":1700000000000,"retryAfter":1700000060000,'
+                       '"msg":"Too many requests"}')
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.official_error_json(depth_frame(1, 1, [], []))
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.official_error_json(error_response_frame(-1121, b"Invalid symbol")[:-8])
+
+
+def test_backfill_pool_spreads_pages_and_reports_failures():
+    # Nothing listens on port 1: every page comes back as a failed result rather than hanging
+    pool = sbe_decoder_cpp.BackfillPool(workers=2, host='127.0.0.1', port=1, use_tls=False, batch=4,
+                                        max_attempts=1, governed=False)
+    assert pool.workers == 2
+    with pytest.raises(ValueError):
+        pool.add('btc usdt', [(0, 10)])
+    with pytest.raises(ValueError):
+        pool.add('BTCUSDT', [(0, 1001)])
+
+    pages = sbe_decoder_cpp.IdIntervalSet().plan(0, 9_999, 1000)
+    pool.add('BTCUSDT', pages)
+    pool.add('ETHUSDT', [(5, 10)])
+    results = [pool.next_result(timeout=5.0) for _ in range(len(pages) + 1)]
+    assert None not in results and pool.outstanding == 0
+    assert sorted((r.symbol, r.from_id) for r in results) == sorted(
+        [('BTCUSDT', from_id) for from_id, _ in pages] + [('ETHUSDT', 5)])
+    assert all(not r.ok and r.error and r.status == 0 and r.attempts == 1 and r.parquet == b'' for r in results)
+    assert pool.stats['failed'] == 11 and pool.stats['tasks'] == 11
+    pool.stop()
+
+
+def test_synthetic_stream_replays_by_seed_and_decodes(decoder):
+    np = pytest.importorskip("numpy")
+    config = dict(symbols=['BTCUSDT', 'ETHUSDT'], seed=7, start_ts_us=1_000_000, trade_rate=200.0,
+                  bba_rate=400.0, depth_interval=0.05, partial_depth_interval=0.5)
+    stream = sbe_decoder_cpp.SyntheticStream(**config)
+    assert stream.rate == pytest.approx(2 * (200 + 400 + 20 + 2))
+    generated = stream.generate(5000)
+    assert generated['frames'] == sbe_decoder_cpp.SyntheticStream(**config).generate(5000)['frames']
+    assert np.all(np.diff(generated['event_ts_us']) >= 0) and generated['event_ts_us'][0] >= 1_000_000
+    counts = dict(zip(*np.unique(generated['template_id'], return_counts=True)))
+    assert set(counts) == {10000, 10001, 10002, 10003}
+    assert counts[10001] == stream.stats['best_bid_ask'] and counts[10003] == stream.stats['depth_diffs']
+
+    batch = decoder.decode_batch(generated['frames'], generated['offsets'].astype(np.int64))
+    assert len(batch['errors']) == 0 and len(batch['unknown']) == 0
+    bba = batch['bestBidAsk']
+    assert bba['ask_px'] - bba['bid_px'] == pytest.approx(0.01)
+    for symbol in (b'BTCUSDT', b'ETHUSDT'):
+        ids = batch['trade']['trade_id'][batch['trade']['symbol'] == symbol]
+        assert np.all(np.diff(ids) == 1)
+        diffs = batch['depthDiff']
+        mine = diffs['symbol'] == symbol
+        assert np.all(diffs['first_update_id'][mine][1:] == diffs['final_update_id'][mine][:-1] + 1)
+
+
+def test_conflator_keeps_latest_state_and_interval_extremes():
+    conflator = sbe_decoder_cpp.Conflator(bba_interval=2.0, depth_interval=2.0, depth_levels=1, start_ts_us=0)
+    assert conflator.absorb(bba_frame(6499999, 10, 6500001, 20, update_id=5), 1_000)
+    assert conflator.absorb(bba_frame(6499500, 11, 6500300, 21, update_id=6), 2_000)
+    assert not conflator.absorb(trade_frame([(1, 6500000, 100, False)]), 3_000)
+    assert conflator.absorb(depth_frame(1, 5, [(6500000, 100), (6499900, 200)], [(6500100, 300)]), 4_000)
+    assert conflator.absorb(depth_frame(6, 7, [(6500000, 0)], []), 5_000)
+    assert conflator.flush(1_999_999) is None
+
+    batch = conflator.flush(2_000_000)
+    assert list(batch['frame_ingest_ts_us']) == [2_000, 5_000]
+    assert list(batch['bestBidAsk']['book_update_id']) == [6]
+    assert batch['bestBidAsk']['bid_px'][0] == pytest.approx(64995.0)
+    assert list(batch['partialDepth']['book_update_id']) == [7]
+    assert list(batch['depthLevels']['frame_index']) == [1, 1]
+    assert list(batch['depthLevels']['price']) == pytest.approx([64999.0, 65001.0])
+
+    conflation = batch['conflation']
+    assert list(conflation['stream']) == [0, 1]
+    assert list(conflation['updates']) == [2, 2]
+    assert list(conflation['bid_low']) == pytest.approx([64995.0, 64999.0])
+    assert list(conflation['bid_high']) == pytest.approx([64999.99, 65000.0])
+    assert list(conflation['ask_high']) == pytest.approx([65003.0, 65001.0])
+    assert conflator.flush(4_000_000) is None
+    assert conflator.stats['conflation_updates'] == 4
+    assert conflator.stats['conflation_frames'] == 2
+
+
+def test_decoder_pool_shards_by_symbol_and_keeps_order():
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=3)
+    symbols = [b"BTCUSDT", b"ETHUSDT", b"SOLUSDT", b"BNBUSDT"]
+    frames = [trade_frame([(i, 100 + i, 1, False)], symbol=symbols[i % 4]) for i in range(40)]
+    frames.append(depth_frame(1, 2, [(6500000, 100)], [], symbol=b"ETHUSDT"))
+    frames.append(depth_frame(10, 11, [(6500100, 100)], [], symbol=b"ETHUSDT"))
+
+    result = pool.decode_batch(frames)
+
+    trades = result['trade']
+    assert sorted(trades['frame_index'].tolist()) == list(range(40))
+    for symbol in symbols:
+        ids = trades['trade_id'][trades['symbol'] == symbol].tolist()
+        assert ids == sorted(ids)
+    assert result['book_gaps'] == ['ETHUSDT']
+    assert pool.book("ETHUSDT")['last_update_id'] == 2
+    assert pool.book("BTCUSDT") is None
+
+
+def test_decoder_pool_restores_books_from_checkpoint(tmp_path):
+    path = str(tmp_path / "books.ckpt")
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=2)
+    pool.decode_batch([
+        depth_frame(1, 5, [(6500000, 100), (6499900, 200)], [(6500100, 300)]),
+        depth_frame(1, 3, [(310000, 50)], [(310100, 60)], symbol=b"ETHUSDT"),
+    ])
+    assert pool.save_checkpoint(path) == 2
+
+    restarted = sbe_decoder_cpp.SBEDecoderPool(workers=3)
+    Sync = sbe_decoder_cpp.SyncResult
+    assert restarted.restore_checkpoint(path) == {"BTCUSDT": Sync.SYNCED, "ETHUSDT": Sync.SYNCED}
+    assert restarted.book("BTCUSDT")['bids'] == pool.book("BTCUSDT")['bids']
+    assert restarted.book("BTCUSDT")['last_update_id'] == 5
+
+    # Diffs that continue the checkpoint resume it; one past a hole falls
+    # back to a snapshot resync
+    result = restarted.decode_batch([
+        depth_frame(6, 7, [(6500000, 0)], []),
+        depth_frame(9, 12, [(310000, 0)], [], symbol=b"ETHUSDT"),
+    ])
+    assert result['book_gaps'] == ['ETHUSDT']
+    assert restarted.book("BTCUSDT")['last_update_id'] == 7
+    assert restarted.restore_checkpoint(path)["BTCUSDT"] == Sync.IGNORED
+
+    with pytest.raises(ValueError):
+        restarted.restore_checkpoint(str(tmp_path / "missing.ckpt"))
+
+
+def test_shard_ring_moves_only_a_joining_nodes_share_and_hands_books_over(tmp_path):
+    symbols = [f"SYM{i}USDT" for i in range(300)]
+    three = sbe_decoder_cpp.ShardRing(["a", "b", "c"], vnodes=128)
+    four = sbe_decoder_cpp.ShardRing(["d", "c", "b", "a"], vnodes=128)
+    assert four.nodes == ["a", "b", "c", "d"]
+    shares = [len(three.owned(symbols, node)) for node in three.nodes]
+    assert sum(shares) == 300 and min(shares) > 60
+    # A joining node only takes symbols; none move between the others
+    moved = [symbol for symbol in symbols if three.owner(symbol) != four.owner(symbol)]
+    assert 30 < len(moved) < 120
+    assert all(four.owner(symbol) == "d" for symbol in moved)
+    assert three.owner("sym7usdt") == three.owner("SYM7USDT")
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.ShardRing([]).owner("BTCUSDT")
+
+    # The node taking a symbol over restores only its book from the
+    # previous owner's checkpoint
+    path = str(tmp_path / "a.book")
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=2)
+    pool.decode_batch([
+        depth_frame(1, 5, [(6500000, 100)], [(6500100, 300)]),
+        depth_frame(1, 3, [(310000, 50)], [(310100, 60)], symbol=b"ETHUSDT"),
+    ])
+    assert pool.save_checkpoint(path) == 2
+    taker = sbe_decoder_cpp.SBEDecoderPool(workers=2)
+    assert taker.restore_checkpoint(path, ["ETHUSDT"]) == {"ETHUSDT": sbe_decoder_cpp.SyncResult.SYNCED}
+
+    # Without a reachable lease store a round fails and nothing is owned
+    leases = sbe_decoder_cpp.ShardLeaseManager("a", symbols, host="127.0.0.1", port=1, lease=1.0, interval=0.1,
+                                               stop_budget=0.2, timeout=0.1)
+    assert not leases.tick()
+    assert leases.owned == [] and leases.take_changes() == {'acquired': [], 'releasing': [], 'lost': []}
+    assert leases.stats['failures'] == 1 and leases.stats['last_error']
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.ShardLeaseManager("a", symbols, lease=0.5, interval=0.5)
+    # No time left to renew within the lease: interval, stop budget and a
+    # connect, a send and a receive timeout come to more than it
+    with pytest.raises(ValueError):
+        sbe_decoder_cpp.ShardLeaseManager("a", symbols, lease=5.0, interval=2.5, stop_budget=1.0, timeout=2.0)
+
+
+class FakeLeaseRedis:
+    """The lease scripts of symbol_shard.h run against dicts, told apart by their text."""
+
+    def __init__(self):
+        self.values = {}  # key -> (value, expiry ms)
+        self.members = {}  # node -> expiry ms
+        self.calls = []
+
+    @staticmethod
+    def now_ms():
+        return int(time.time() * 1000)
+
+    def get(self, key):
+        value, expiry = self.values.get(key, (None, 0))
+        return value if expiry > self.now_ms() else None
+
+    def __call__(self, args):
+        self.calls.append(args)
+        if args[0] == 'ZREM':
+            return int(self.members.pop(args[2], None) is not None)
+        assert args[0] == 'EVAL'
+        script, count = args[1], int(args[2])
+        keys, argv = args[3:3 + count], args[3 + count:]
+        now = self.now_ms()
+        if 'ZADD' in script:
+            self.members[argv[0]] = now + int(argv[1])
+            self.members = {node: expiry for node, expiry in self.members.items() if expiry > now}
+            return [now, sorted(self.members, key=self.members.get)]
+        token, lease_ms = argv[0], int(argv[1])
+        if 'PEXPIRE' in script:
+            renewed = [int(self.get(key) == token) for key in keys]
+            for key, ok in zip(keys, renewed):
+                if ok:
+                    self.values[key] = (token, now + lease_ms)
+            return renewed
+        if "'released:'" in script and 'marker' in script:
+            mine = [key for key in keys if self.get(key) == token]
+            for key in mine:
+                self.values[key] = (f"released:{now}", now + lease_ms)
+            return len(mine)
+        previous = []
+        for key in keys:
+            value = self.get(key)
+            if value is None or value == token or value.startswith('released:'):
+                self.values[key] = (token, now + lease_ms)
+                previous.append(value or '')
+            else:
+                previous.append(None)
+        return previous
+
+
+def test_shard_leases_hand_off_between_nodes_and_fence_before_expiry():
+    symbols = [f"SYM{i}USDT" for i in range(60)]
+    redis = FakeLeaseRedis()
+    timing = dict(lease=1.0, interval=0.1, stop_budget=0.2, timeout=0.1)
+    a = sbe_decoder_cpp.ShardLeaseManager("a", symbols, transport=redis, **timing)
+    b = sbe_decoder_cpp.ShardLeaseManager("b", symbols, transport=redis, **timing)
+
+    # Alone in the ring, a takes every free lease; b finds them all held
+    assert a.tick()
+    acquired = a.take_changes()['acquired']
+    assert sorted(row['symbol'] for row in acquired) == sorted(symbols)
+    assert all(row['released_ms'] == 0 for row in acquired)
+    assert b.tick() and b.take_changes()['acquired'] == []
+
+    # With b in the ring, a reports b's share as releasing and keeps renewing
+    # it; b gets none of it until a releases
+    assert a.tick()
+    releasing = a.take_changes()['releasing']
+    assert 0 < len(releasing) < len(symbols) and sorted(a.releasing) == sorted(releasing)
+    assert a.stats['renewals'] > 0
+    assert b.tick() and b.take_changes()['acquired'] == []
+    a.release(releasing)
+    assert a.tick() and a.releasing == [] and a.stats['released'] == len(releasing)
+    assert b.tick()
+    handed = b.take_changes()['acquired']
+    assert sorted(row['symbol'] for row in handed) == sorted(releasing)
+    assert all(row['released_ms'] > 0 for row in handed)
+    assert set(a.owned).isdisjoint(b.owned) and sorted(a.owned + b.owned) == sorted(symbols)
+
+    # A lease holding someone else's token is lost, not renewed or taken back
+    stolen = b.owned[0]
+    key = "{sbe-shard}:" + stolen
+    redis.values[key] = ("intruder", redis.now_ms() + 60_000)
+    assert b.tick()
+    changes = b.take_changes()
+    assert changes['lost'] == [stolen] and changes['acquired'] == []
+    assert stolen not in b.owned and b.stats['lost'] == 1
+    a.stop(release=False)
+    b.stop(release=False)
+
+    # Redis hangs past the lease: the fence reports the loss before the
+    # server would expire the lease, though the round is still blocked
+    renewed_at = []
+    hang = threading.Event()
+
+    def transport(args):
+        if hang.is_set():
+            time.sleep(1.5)
+            raise ConnectionError("redis timeout")
+        sent = time.monotonic()
+        reply = redis(args)
+        if 'PEXPIRE' in args[1]:
+            renewed_at.append(sent)
+        return reply
+
+    redis = FakeLeaseRedis()
+    fenced = sbe_decoder_cpp.ShardLeaseManager("c", ["X1USDT", "X2USDT"], transport=transport, **timing)
+    fenced.start()
+    assert fenced.wait_changes(1.0) and len(fenced.take_changes()['acquired']) == 2
+    time.sleep(0.3)
+    hang.set()
+    assert fenced.wait_changes(3.0)
+    lost_at = time.monotonic()
+    assert sorted(fenced.take_changes()['lost']) == ["X1USDT", "X2USDT"]
+    assert renewed_at[-1] + 0.7 <= lost_at < renewed_at[-1] + 1.0
+    hang.clear()
+    fenced.stop(release=False)
+
+
+def test_memory_stats_reports_native_bytes_by_symbol():
+    pool = sbe_decoder_cpp.SBEDecoderPool(workers=2)
+    pool.decode_batch([
+        depth_frame(1, 5, [(6500000, 100), (6499900, 200)], [(6500100, 300)]),
+        depth_frame(1, 3, [(310000, 50)], [(310100, 60)], symbol=b"ETHUSDT"),
+    ])
+    dedup = sbe_decoder_cpp.Deduplicator(window_seconds=7)
+    for record_id in range(10):
+        dedup.is_unique('BTCUSDT', record_id, now_us=1_000_000)
+    dedup.is_unique('ETHUSDT', 1, now_us=1_000_000)
+
+    stats = sbe_decoder_cpp.memory_stats()
+    books = stats['book']['symbols']
+    # Three levels in the working book and three in the copy readers see
+    assert books['BTCUSDT']['live_bytes'] >= 2 * 3 * 16
+    assert books['BTCUSDT']['live_bytes'] > books['ETHUSDT']['live_bytes'] > 0
+    assert books['BTCUSDT']['reserved_bytes'] >= books['BTCUSDT']['live_bytes']
+    windows = stats['dedup_window']['symbols']
+    assert windows['BTCUSDT']['live_bytes'] >= 10 * 16
+    assert windows['']['reserved_bytes'] > 0
+    assert stats['total']['reserved_bytes'] >= stats['book']['reserved_bytes'] + stats['dedup_window']['reserved_bytes']
+
+    # A component's bytes leave the report with it
+    del dedup
+    after = sbe_decoder_cpp.memory_stats().get('dedup_window', {'symbols': {}})['symbols']
+    assert after.get('BTCUSDT', {'live_bytes': 0})['live_bytes'] <= windows['BTCUSDT']['live_bytes'] - 10 * 16